@@ -0,0 +1,224 @@
+#ifndef ALLOC_TRACKER_H
+#define ALLOC_TRACKER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// What the heap is asked for, by which subsystem. The viewer's global operator new and delete go through allocate()
+// and release(), and ImGui's allocator is pointed at them too. Each block carries a 16-byte header with its size and
+// the tag it was counted under, so a block freed on another thread or under another scope is taken back from the tag
+// that made it. The tag is the calling thread's, set by ALLOC_SCOPE for the enclosing block, and untagged
+// allocations count as ALLOC_OTHER. Only allocationCount() is kept all the time. The per-tag counts are off until
+// setEnabled(true), and then each allocation costs a few relaxed atomics on counters the threads share, which is
+// why they are optional. beginFrame() starts a frame's counts and peaks, and lastFrame() holds the frame before it.
+enum AllocTag : uint8_t {
+    ALLOC_OTHER = 0,
+    ALLOC_MODEL_IMPORT,         // Assimp, the imported vertices and the LOD simplification
+    ALLOC_RENDERING,            // building and submitting the frame
+    ALLOC_UI,                   // ImGui and the windows built with it
+    ALLOC_PHYSICS,
+    ALLOC_STREAMING,            // texture and world streaming, the asset loaders' threads
+    ALLOC_TAGS
+};
+
+class AllocTracker
+{
+public:
+    // a tag's numbers: allocations and bytes since counting began or in one frame, what is live and its peak
+    struct Counts
+    {
+        unsigned long long allocations = 0;
+        unsigned long long frees = 0;
+        unsigned long long bytes = 0;       // allocated, frees do not take it back
+        long long liveBytes = 0;            // at the end of the frame, or now
+        long long peakBytes = 0;            // the most live at once, in the frame or since counting began
+    };
+
+    static const char* name(AllocTag tag)
+    {
+        static const char* names[ALLOC_TAGS] = {"other", "model import", "rendering", "ui", "physics", "streaming"};
+        return names[tag];
+    }
+
+    void setEnabled(bool on) { enabled.store(on, std::memory_order_relaxed); }
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    static AllocTag currentTag() { return threadTag(); }
+
+    // every allocation since the start, counted or not
+    unsigned long long allocationCount() const { return allAllocations.load(std::memory_order_relaxed); }
+
+    // align a power of two no less than 16; null when the heap is out of memory
+    void* allocate(size_t size, size_t align = HEADER_SIZE) noexcept
+    {
+        if (align < HEADER_SIZE)
+            align = HEADER_SIZE;
+        uint8_t* raw = static_cast<uint8_t*>(std::malloc(size + align + HEADER_SIZE));
+        if (!raw)
+            return nullptr;
+        const uintptr_t user = (reinterpret_cast<uintptr_t>(raw) + HEADER_SIZE + align - 1) & ~static_cast<uintptr_t>(align - 1);
+        Header* header = reinterpret_cast<Header*>(user) - 1;
+        header->size = size;
+        header->offset = static_cast<uint32_t>(user - reinterpret_cast<uintptr_t>(raw));
+        header->tag = threadTag();
+        header->counted = isEnabled();
+        allAllocations.fetch_add(1, std::memory_order_relaxed);
+        if (header->counted)
+        {
+            Counters& c = counters[header->tag];
+            c.allocations.fetch_add(1, std::memory_order_relaxed);
+            c.bytes.fetch_add(size, std::memory_order_relaxed);
+            const long long live = c.live.fetch_add(static_cast<long long>(size), std::memory_order_relaxed) + static_cast<long long>(size);
+            raise(c.peak, live);
+            raise(c.framePeak, live);
+        }
+        return reinterpret_cast<void*>(user);
+    }
+
+    void release(void* pointer) noexcept
+    {
+        if (!pointer)
+            return;
+        Header* header = static_cast<Header*>(pointer) - 1;
+        if (header->counted)
+        {
+            Counters& c = counters[header->tag];
+            c.frees.fetch_add(1, std::memory_order_relaxed);
+            c.live.fetch_sub(static_cast<long long>(header->size), std::memory_order_relaxed);
+        }
+        std::free(static_cast<uint8_t*>(pointer) - header->offset);
+    }
+
+    // since counting began
+    Counts total(AllocTag tag) const
+    {
+        const Counters& c = counters[tag];
+        Counts counts;
+        counts.allocations = c.allocations.load(std::memory_order_relaxed);
+        counts.frees = c.frees.load(std::memory_order_relaxed);
+        counts.bytes = c.bytes.load(std::memory_order_relaxed);
+        counts.liveBytes = c.live.load(std::memory_order_relaxed);
+        counts.peakBytes = c.peak.load(std::memory_order_relaxed);
+        return counts;
+    }
+
+    // ends a frame and starts the next, on the thread that runs the frames
+    void beginFrame()
+    {
+        frameTotal = Counts();
+        for (unsigned int t = 0; t < ALLOC_TAGS; t++)
+        {
+            const AllocTag tag = static_cast<AllocTag>(t);
+            const Counts now = total(tag);
+            Counts& frame = frames[t];
+            frame.allocations = now.allocations - frameStart[t].allocations;
+            frame.frees = now.frees - frameStart[t].frees;
+            frame.bytes = now.bytes - frameStart[t].bytes;
+            frame.liveBytes = now.liveBytes;
+            frame.peakBytes = counters[t].framePeak.exchange(now.liveBytes, std::memory_order_relaxed);
+            frameStart[t] = now;
+            frameTotal.allocations += frame.allocations;
+            frameTotal.frees += frame.frees;
+            frameTotal.bytes += frame.bytes;
+            frameTotal.liveBytes += frame.liveBytes;
+            frameTotal.peakBytes += frame.peakBytes;
+        }
+    }
+
+    // the last frame beginFrame() ended, by tag and over all of them (the peaks summed)
+    const Counts& lastFrame(AllocTag tag) const { return frames[tag]; }
+    const Counts& lastFrameTotal() const { return frameTotal; }
+
+    // sets the calling thread's tag and returns the one it replaces, for stages of a block ALLOC_SCOPE cannot wrap
+    static AllocTag swapTag(AllocTag tag)
+    {
+        const AllocTag previous = threadTag();
+        threadTag() = tag;
+        return previous;
+    }
+
+    // sets the calling thread's tag for its lifetime, see ALLOC_SCOPE
+    class Scope
+    {
+    public:
+        explicit Scope(AllocTag tag) : previous(threadTag()) { threadTag() = tag; }
+        ~Scope() { threadTag() = previous; }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        AllocTag previous;
+    };
+
+private:
+    static const size_t HEADER_SIZE = 16;
+
+    struct Header
+    {
+        uint64_t size;
+        uint32_t offset;        // from the block malloc returned to the pointer handed out
+        AllocTag tag;
+        bool counted;
+        uint8_t padding[2];
+    };
+    static_assert(sizeof(Header) == HEADER_SIZE, "the header keeps the blocks 16-byte aligned");
+
+    struct Counters
+    {
+        std::atomic<unsigned long long> allocations{0};
+        std::atomic<unsigned long long> frees{0};
+        std::atomic<unsigned long long> bytes{0};
+        std::atomic<long long> live{0};
+        std::atomic<long long> peak{0};
+        std::atomic<long long> framePeak{0};
+    };
+
+    std::atomic<bool> enabled{false};
+    std::atomic<unsigned long long> allAllocations{0};
+    Counters counters[ALLOC_TAGS];
+    Counts frameStart[ALLOC_TAGS];
+    Counts frames[ALLOC_TAGS];
+    Counts frameTotal;
+
+    // thread_local of a trivial type, so reading it from operator new allocates nothing
+    static AllocTag& threadTag()
+    {
+        thread_local AllocTag tag = ALLOC_OTHER;
+        return tag;
+    }
+
+    static void raise(std::atomic<long long>& peak, long long value)
+    {
+        long long seen = peak.load(std::memory_order_relaxed);
+        while (value > seen && !peak.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {}
+    }
+};
+
+// constant-initialized, so it is usable from the first operator new of static initialization on
+inline AllocTracker& allocTracker()
+{
+    static AllocTracker instance;
+    return instance;
+}
+
+// the ImGui::SetAllocatorFunctions pair, counting ImGui's own allocations under ALLOC_UI
+inline void* allocTrackerImGuiAlloc(size_t size, void*)
+{
+    AllocTracker::Scope scope(ALLOC_UI);
+    return allocTracker().allocate(size);
+}
+
+inline void allocTrackerImGuiFree(void* pointer, void*)
+{
+    allocTracker().release(pointer);
+}
+
+#define ALLOC_SCOPE_CONCAT_INNER(a, b) a##b
+#define ALLOC_SCOPE_CONCAT(a, b) ALLOC_SCOPE_CONCAT_INNER(a, b)
+#define ALLOC_SCOPE(tag) AllocTracker::Scope ALLOC_SCOPE_CONCAT(allocScope, __LINE__)(tag)
+
+#endif
@@ -0,0 +1,423 @@
+#ifndef ASSET_ARCHIVE_H
+#define ASSET_ARCHIVE_H
+
+#include <mapped_file.h>
+#include <lz4_block.h>
+
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+// Assets packed into one file, read through a single mapping instead of a lookup and a small read per loose file.
+// The file is a header, the entries' data each at a page boundary (so it can be prefetched or handed out without
+// touching its neighbours), the table of contents sorted by name hash and the names. An entry is stored as it is or
+// as an LZ4 block (lz4_block.h) where that saves at least an eighth. It keeps the modification time and size the
+// source file had when packed, which the cooked caches (ktx2.h, model_cache.h) take as the source's identity.
+//
+// Once mounted, an archive is looked up before the file system by every loader: AssetFile stands in for MappedFile,
+// readAssetFile for reading a whole file, assetStamp for stat. Names are the paths below the archive's root with
+// "." and ".." segments resolved, so "../resources/objects/rock/rock.obj" is "resources/objects/rock/rock.obj" in
+// an archive mounted at "..". Loose files the archive does not have are read from disk as before; one it has is
+// not, editing it takes a repack. Written by packAssetArchive, see src/pack_assets.cpp.
+
+static const char ASSET_ARCHIVE_MAGIC[8] = {'N', 'P', 'S', 'C', 'P', 'A', 'K', 0};
+static const uint32_t ASSET_ARCHIVE_VERSION = 1;
+static const uint64_t ASSET_ARCHIVE_ALIGNMENT = 4096;
+
+enum AssetCompression : uint32_t {
+    ASSET_STORED = 0,
+    ASSET_LZ4 = 1
+};
+
+struct AssetArchiveHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t entryCount;
+    uint64_t tocOffset;
+    uint64_t namesOffset;
+    uint64_t namesBytes;
+    uint64_t fileBytes;
+};
+
+struct AssetArchiveEntry
+{
+    uint64_t nameHash;
+    uint64_t offset;
+    uint64_t storedBytes;
+    uint64_t bytes;             // once decompressed
+    int64_t sourceMtimeNs;
+    uint64_t sourceBytes;
+    uint32_t nameOffset;
+    uint32_t nameBytes;
+    uint32_t compression;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(AssetArchiveHeader) == 48, "the asset archive header is part of the file format");
+static_assert(sizeof(AssetArchiveEntry) == 64, "the asset archive entry is part of the file format");
+
+// path with empty and "." segments dropped and "dir/.." pairs cancelled, leading ".." kept
+inline std::string normalizeAssetPath(const std::string& path)
+{
+    std::vector<std::string> segments;
+    size_t start = 0;
+    while (start <= path.size())
+    {
+        size_t end = path.find('/', start);
+        if (end == std::string::npos)
+            end = path.size();
+        const std::string segment = path.substr(start, end - start);
+        if (segment == "..")
+        {
+            if (!segments.empty() && segments.back() != "..")
+                segments.pop_back();
+            else
+                segments.push_back(segment);
+        }
+        else if (!segment.empty() && segment != ".")
+            segments.push_back(segment);
+        start = end + 1;
+    }
+    std::string normalized = !path.empty() && path[0] == '/' ? "/" : "";
+    for (size_t s = 0; s < segments.size(); s++)
+        normalized += (s > 0 ? "/" : "") + segments[s];
+    return normalized;
+}
+
+// FNV-1a
+inline uint64_t assetNameHash(const std::string& name)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (unsigned char c : name)
+        hash = (hash ^ c) * 0x100000001b3ull;
+    return hash;
+}
+
+class AssetArchive
+{
+public:
+    // maps an archive whose names are below root (its own directory when empty); prefetch reads all of it ahead in
+    // the background, one large sequential read instead of one per asset
+    bool mount(const std::string& path, const std::string& rootPath = std::string(), bool prefetch = true)
+    {
+        unmount();
+        if (!file.open(path.c_str()) || file.size() < sizeof(AssetArchiveHeader))
+            return fail();
+        AssetArchiveHeader header;
+        std::memcpy(&header, file.data(), sizeof(header));
+        const uint64_t size = file.size();
+        if (std::memcmp(header.magic, ASSET_ARCHIVE_MAGIC, sizeof(header.magic)) != 0 || header.version != ASSET_ARCHIVE_VERSION
+            || header.fileBytes != size || header.tocOffset > size
+            || uint64_t(header.entryCount) * sizeof(AssetArchiveEntry) > size - header.tocOffset
+            || header.namesOffset > size || header.namesBytes > size - header.namesOffset)
+            return fail();
+        entries = reinterpret_cast<const AssetArchiveEntry*>(file.data() + header.tocOffset);
+        names = reinterpret_cast<const char*>(file.data() + header.namesOffset);
+        count = header.entryCount;
+        for (uint32_t e = 0; e < count; e++)
+        {
+            const AssetArchiveEntry& entry = entries[e];
+            if (entry.offset > size || entry.storedBytes > size - entry.offset || uint64_t(entry.nameOffset) + entry.nameBytes > header.namesBytes
+                || entry.compression > ASSET_LZ4 || (entry.compression == ASSET_STORED && entry.storedBytes != entry.bytes))
+                return fail();
+        }
+        const size_t slash = path.find_last_of('/');
+        root = normalizeAssetPath(!rootPath.empty() ? rootPath : slash == std::string::npos ? std::string(".") : path.substr(0, slash));
+        if (prefetch)
+            file.prefetch(0, file.size());
+        return true;
+    }
+
+    void unmount()
+    {
+        file.close();
+        entries = nullptr;
+        names = nullptr;
+        count = 0;
+        root.clear();
+    }
+
+    bool mounted() const { return entries != nullptr; }
+    size_t size() const { return count; }
+    size_t bytes() const { return file.size(); }
+
+    // the entry a path names, null if it is outside the root or not in the archive
+    const AssetArchiveEntry* find(const std::string& path) const
+    {
+        if (!mounted())
+            return nullptr;
+        const std::string normalized = normalizeAssetPath(path);
+        std::string name;
+        if (root.empty() || root == ".")
+            name = normalized;
+        else if (normalized.size() > root.size() && normalized.compare(0, root.size(), root) == 0 && normalized[root.size()] == '/')
+            name = normalized.substr(root.size() + 1);
+        else
+            return nullptr;
+        const uint64_t hash = assetNameHash(name);
+        const AssetArchiveEntry* e = std::lower_bound(entries, entries + count, hash,
+                                                      [](const AssetArchiveEntry& entry, uint64_t h) { return entry.nameHash < h; });
+        for (; e != entries + count && e->nameHash == hash; e++)
+            if (e->nameBytes == name.size() && std::memcmp(names + e->nameOffset, name.data(), name.size()) == 0)
+                return e;
+        return nullptr;
+    }
+
+    std::string nameOf(const AssetArchiveEntry& entry) const { return std::string(names + entry.nameOffset, entry.nameBytes); }
+
+    // a stored entry's bytes in the mapping, null for a compressed one
+    const unsigned char* stored(const AssetArchiveEntry& entry) const
+    {
+        return entry.compression == ASSET_STORED ? file.data() + entry.offset : nullptr;
+    }
+
+    // the entry's bytes into out, decompressed; false if its block is corrupt
+    bool extract(const AssetArchiveEntry& entry, unsigned char* out) const
+    {
+        const unsigned char* data = file.data() + entry.offset;
+        if (entry.compression == ASSET_STORED)
+        {
+            std::memcpy(out, data, static_cast<size_t>(entry.bytes));
+            return true;
+        }
+        return lz4::decompress(data, static_cast<size_t>(entry.storedBytes), out, static_cast<size_t>(entry.bytes));
+    }
+
+    // asks the kernel to read these assets in the background, for a batch of loads about to start on workers
+    void prefetch(const std::vector<std::string>& paths) const
+    {
+        for (const std::string& path : paths)
+            if (const AssetArchiveEntry* entry = find(path))
+                file.prefetch(static_cast<size_t>(entry->offset), static_cast<size_t>(entry->storedBytes));
+    }
+
+private:
+    MappedFile file;
+    const AssetArchiveEntry* entries = nullptr;
+    const char* names = nullptr;
+    uint32_t count = 0;
+    std::string root;
+
+    bool fail()
+    {
+        unmount();
+        return false;
+    }
+};
+
+// the archive every loader looks in first; mounted once at startup, before the loading threads start
+inline AssetArchive& assetArchive()
+{
+    static AssetArchive archive;
+    return archive;
+}
+
+// A whole asset in memory as MappedFile gives it: a view into the archive's mapping for a stored entry, the
+// decompressed bytes for a compressed one, the mapped loose file for anything else.
+class AssetFile
+{
+public:
+    AssetFile() = default;
+    AssetFile(const AssetFile&) = delete;
+    AssetFile& operator=(const AssetFile&) = delete;
+
+    bool open(const char* path, bool populate = false)
+    {
+        close();
+        if (const AssetArchiveEntry* entry = assetArchive().find(path))
+        {
+            if (entry->bytes == 0)
+                return false;
+            base = assetArchive().stored(*entry);
+            if (!base)
+            {
+                decompressed.reset(new unsigned char[static_cast<size_t>(entry->bytes)]);
+                if (!assetArchive().extract(*entry, decompressed.get()))
+                {
+                    close();
+                    return false;
+                }
+                base = decompressed.get();
+            }
+            bytes = static_cast<size_t>(entry->bytes);
+            return true;
+        }
+        if (!mapped.open(path, populate))
+            return false;
+        base = mapped.data();
+        bytes = mapped.size();
+        return true;
+    }
+
+    void close()
+    {
+        mapped.close();
+        decompressed.reset();
+        base = nullptr;
+        bytes = 0;
+    }
+
+    void prefetch(size_t offset, size_t length) const
+    {
+        if (mapped.isOpen())
+            mapped.prefetch(offset, length);
+    }
+
+    bool isOpen() const { return base != nullptr; }
+    const unsigned char* data() const { return base; }
+    size_t size() const { return bytes; }
+
+private:
+    MappedFile mapped;
+    std::unique_ptr<unsigned char[]> decompressed;
+    const unsigned char* base = nullptr;
+    size_t bytes = 0;
+};
+
+// a whole asset as text, from the archive or the file
+inline bool readAssetFile(const std::string& path, std::string& text)
+{
+    if (const AssetArchiveEntry* entry = assetArchive().find(path))
+    {
+        text.resize(static_cast<size_t>(entry->bytes));
+        return entry->bytes == 0 || assetArchive().extract(*entry, reinterpret_cast<unsigned char*>(&text[0]));
+    }
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f)
+        return false;
+    text.clear();
+    char buffer[16384];
+    size_t read;
+    while ((read = std::fread(buffer, 1, sizeof(buffer), f)) > 0)
+        text.append(buffer, read);
+    const bool ok = !std::ferror(f);
+    std::fclose(f);
+    return ok;
+}
+
+// stat of an asset: the packed source's modification time and size for one in the archive
+inline bool assetStamp(const std::string& path, int64_t& mtimeNs, uint64_t& bytes)
+{
+    if (const AssetArchiveEntry* entry = assetArchive().find(path))
+    {
+        mtimeNs = entry->sourceMtimeNs;
+        bytes = entry->sourceBytes;
+        return true;
+    }
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+    mtimeNs = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    bytes = static_cast<uint64_t>(st.st_size);
+    return true;
+}
+
+// Packs files, each named by its path below root, into an archive at path. Entries that compress by an eighth or
+// more are stored as LZ4 blocks when compress is set. Written under a temporary name and renamed.
+inline bool packAssetArchive(const std::string& path, const std::string& rootPath, const std::vector<std::string>& files, bool compress,
+                             size_t* compressedCount = nullptr)
+{
+    const std::string root = normalizeAssetPath(rootPath);
+    struct Packed { AssetArchiveEntry entry; std::string name; std::string source; };
+    std::vector<Packed> packed;
+    for (const std::string& source : files)
+    {
+        const std::string normalized = normalizeAssetPath(source);
+        Packed p = {};
+        if (root.empty() || root == ".")
+            p.name = normalized;
+        else if (normalized.size() > root.size() && normalized.compare(0, root.size(), root) == 0 && normalized[root.size()] == '/')
+            p.name = normalized.substr(root.size() + 1);
+        else
+            return false;
+        struct stat st;
+        if (stat(source.c_str(), &st) != 0)
+            return false;
+        p.entry.sourceMtimeNs = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+        p.entry.sourceBytes = static_cast<uint64_t>(st.st_size);
+        p.entry.nameHash = assetNameHash(p.name);
+        p.source = source;
+        packed.push_back(p);
+    }
+    std::sort(packed.begin(), packed.end(), [](const Packed& a, const Packed& b) {
+        return a.entry.nameHash != b.entry.nameHash ? a.entry.nameHash < b.entry.nameHash : a.name < b.name;
+    });
+    for (size_t k = 1; k < packed.size(); k++)
+        if (packed[k].name == packed[k - 1].name)
+            return false;
+
+    const std::string partial = path + ".partial";
+    FILE* out = std::fopen(partial.c_str(), "wb");
+    if (!out)
+        return false;
+    static const unsigned char zeros[ASSET_ARCHIVE_ALIGNMENT] = {};
+    uint64_t at = 0;
+    auto put = [&](const void* data, size_t size) {
+        at += size;
+        return std::fwrite(data, 1, size, out) == size;
+    };
+    auto align = [&]() {
+        const uint64_t padding = (ASSET_ARCHIVE_ALIGNMENT - at % ASSET_ARCHIVE_ALIGNMENT) % ASSET_ARCHIVE_ALIGNMENT;
+        return put(zeros, static_cast<size_t>(padding));
+    };
+    AssetArchiveHeader header = {};
+    bool ok = put(&header, sizeof(header));
+    std::string namesBlob;
+    size_t compressed = 0;
+    for (Packed& p : packed)
+    {
+        std::string data;
+        ok = ok && readAssetFile(p.source, data) && align();
+        if (!ok)
+            break;
+        p.entry.offset = at;
+        p.entry.bytes = data.size();
+        p.entry.compression = ASSET_STORED;
+        std::vector<uint8_t> block;
+        if (compress && data.size() >= 64)
+            block = lz4::compress(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+        if (!block.empty() && block.size() <= data.size() - data.size() / 8)
+        {
+            p.entry.compression = ASSET_LZ4;
+            p.entry.storedBytes = block.size();
+            ok = put(block.data(), block.size());
+            compressed++;
+        }
+        else
+        {
+            p.entry.storedBytes = data.size();
+            ok = put(data.data(), data.size());
+        }
+        p.entry.nameOffset = static_cast<uint32_t>(namesBlob.size());
+        p.entry.nameBytes = static_cast<uint32_t>(p.name.size());
+        namesBlob += p.name;
+    }
+    ok = ok && align();
+    std::memcpy(header.magic, ASSET_ARCHIVE_MAGIC, sizeof(header.magic));
+    header.version = ASSET_ARCHIVE_VERSION;
+    header.entryCount = static_cast<uint32_t>(packed.size());
+    header.tocOffset = at;
+    for (const Packed& p : packed)
+        ok = ok && put(&p.entry, sizeof(p.entry));
+    header.namesOffset = at;
+    header.namesBytes = namesBlob.size();
+    ok = ok && put(namesBlob.data(), namesBlob.size());
+    header.fileBytes = at;
+    ok = ok && std::fseek(out, 0, SEEK_SET) == 0 && std::fwrite(&header, 1, sizeof(header), out) == sizeof(header);
+    ok = std::fclose(out) == 0 && ok;
+    ok = ok && std::rename(partial.c_str(), path.c_str()) == 0;
+    if (!ok)
+        std::remove(partial.c_str());
+    if (compressedCount)
+        *compressedCount = compressed;
+    return ok;
+}
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef ASSET_PRIORITIES_H
+#define ASSET_PRIORITIES_H
+
+#include <glm.hpp>
+
+#include <model_loader.h>
+#include <texture_cache.h>
+#include <instance_data.h>
+
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <cfloat>
+#include <cmath>
+#include <climits>
+
+// What to load first. The viewer's assets form a small graph, a model over its meshes over the textures they bind,
+// and every frame each is ranked by its importance on screen: observe() every instance of a model as a bounding
+// sphere, the model takes the largest projected diameter among those in the frustum, in pixels, and each of its
+// meshes takes the model's (meshes have no bounds of their own). A texture takes the largest of the meshes that
+// bind it, so one shared by a near and a far model comes in with the near one. rank() hands the importances on:
+//   a model still importing    ModelLoader::prioritize, the loaders take the most important queued file first
+//   a resident model           TextureCache::prioritizeStreaming for each of its textures still streaming in,
+//                              and with mip streaming TextureCache::requestExtent, twice the importance in texels:
+//                              the half of a wrapped texture facing the camera spans the projected diameter
+// Importance 0, nothing of the asset in view, cancels what has not started: the import stays queued and the
+// texture's file undecoded (a decoded image of it is freed) until an instance comes back into view. GL thread only.
+class AssetPriorities
+{
+public:
+    typedef size_t AssetId;
+
+    // a model on its way in, ranked through its load until resident()
+    AssetId add(const ModelHandle& load)
+    {
+        Asset asset;
+        asset.load = load;
+        assets.push_back(asset);
+        return assets.size() - 1;
+    }
+
+    // the model has been taken from its load, its meshes and their textures join the graph
+    void resident(AssetId id, const Model& model)
+    {
+        Asset& asset = assets[id];
+        asset.load.reset();
+        asset.meshes.clear();
+        for (const Mesh& mesh : model.meshes)
+        {
+            std::vector<unsigned int> textures;
+            for (const Texture& texture : mesh.textures)
+                textures.push_back(texture.id);
+            asset.meshes.push_back(textures);
+        }
+    }
+
+    // starts a frame's ranking, spheres are then observed in the space frustum was extracted in
+    void begin(const Frustum& view, float viewPixelsPerRadian)
+    {
+        frustum = view;
+        pixelsPerRadian = viewPixelsPerRadian;
+        for (Asset& asset : assets)
+            asset.importance = 0.0f;
+    }
+
+    // one instance of the asset this frame
+    void observe(AssetId id, const glm::vec3& centre, float radius)
+    {
+        if (!frustum.intersectsSphere(centre, radius))
+            return;
+        // from inside the sphere it covers the view
+        const float distance = std::max(glm::length(centre), radius);
+        float& importance = assets[id].importance;
+        importance = std::max(importance, radius * pixelsPerRadian / std::max(distance, 1e-6f));
+    }
+
+    // instances the CPU does not know the place of (the GPU belt), ranked as though they filled the view
+    void observeEverywhere(AssetId id)
+    {
+        assets[id].importance = FLT_MAX;
+    }
+
+    float importance(AssetId id) const { return assets[id].importance; }
+
+    // hands the frame's importances to the loaders
+    void rank()
+    {
+        textureImportance.clear();
+        for (Asset& asset : assets)
+        {
+            if (asset.load)
+            {
+                if (!asset.load->ready())
+                    modelLoader().prioritize(asset.load, asset.importance);
+                continue;
+            }
+            for (const std::vector<unsigned int>& textures : asset.meshes)
+                for (unsigned int texture : textures)
+                {
+                    float& importance = textureImportance[texture];
+                    importance = std::max(importance, asset.importance);
+                }
+        }
+        if (textureCache().mipStreamingEnabled())
+            for (const auto& texture : textureImportance)
+                textureCache().requestExtent(texture.first, texture.second >= 0.5f * static_cast<float>(UINT_MAX) ? UINT_MAX
+                                                           : static_cast<unsigned int>(std::ceil(2.0f * texture.second)));
+        if (textureCache().streamingPending() == 0)
+            return;
+        for (const auto& texture : textureImportance)
+            textureCache().prioritizeStreaming(texture.first, texture.second);
+    }
+
+private:
+    struct Asset
+    {
+        ModelHandle load;                                   // until resident
+        std::vector<std::vector<unsigned int>> meshes;      // the textures each mesh binds
+        float importance = 0.0f;
+    };
+
+    std::vector<Asset> assets;
+    std::unordered_map<unsigned int, float> textureImportance;
+    Frustum frustum;
+    float pixelsPerRadian = 1.0f;
+};
+
+#endif
@@ -0,0 +1,223 @@
+#ifndef ASYNC_PHYSICS_H
+#define ASYNC_PHYSICS_H
+
+#include <glm.hpp>
+
+#include <physics_world.h>
+#include <trajectory_recorder.h>
+#include <profiler.h>
+#include <alloc_tracker.h>
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <vector>
+#include <algorithm>
+
+// Single-producer single-consumer triple buffer. The writer always has a slot of its own, publishing swaps it with
+// the shared middle slot, and the reader takes the middle slot only when a newer one is there. Neither side ever waits.
+template <typename T>
+class TripleBuffer
+{
+public:
+    T& writeSlot() { return slots[back]; }
+
+    void publish()
+    {
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // true if a newer state was taken, readSlot() is valid either way once something was published
+    bool acquire()
+    {
+        if (!(middle.load(std::memory_order_acquire) & FRESH))
+            return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    const T& readSlot() const { return slots[front]; }
+
+private:
+    static const unsigned int FRESH = 4;
+    static const unsigned int INDEX = 3;
+    T slots[3];
+    unsigned int back = 0;
+    std::atomic<unsigned int> middle{1};
+    unsigned int front = 2;
+};
+
+// what the render thread sees of the simulation
+struct PhysicsSnapshot
+{
+    std::vector<glm::dvec3> position;
+    std::vector<uint32_t> id;       // body id per slot, the thread may have reordered since the world was copied
+    double simTime = 0.0;
+    unsigned long stepCount = 0;
+    unsigned int stepsLastBatch = 0;
+    PhysicsStats stats;
+};
+
+// Runs a PhysicsWorld on a dedicated thread with its own fixed-step accumulator, publishing a snapshot after each
+// batch of steps. While it runs the thread owns the world: every edit is posted as a command and applied between
+// steps, and the caller reads positions only from the latest snapshot. The thread uses the engine worker pool for
+// its force loops, so nothing else should call parallelFor while it runs.
+class AsyncPhysics
+{
+public:
+    ~AsyncPhysics()
+    {
+        stopThread();
+    }
+
+    bool running() const { return thread.joinable(); }
+
+    // takes ownership of the world's state until stop()
+    void start(PhysicsWorld& source)
+    {
+        stopThread();
+        world = source;
+        stopRequested = false;
+        {
+            // the first snapshot is the starting state so the renderer never sees an empty one
+            PhysicsSnapshot& slot = snapshots.writeSlot();
+            slot.position.assign(world.bodies.position.begin(), world.bodies.position.end());
+            slot.id = world.bodies.id;
+            slot.simTime = world.simTime;
+            slot.stepCount = world.stepCount;
+            world.stats(slot.stats);
+            snapshots.publish();
+        }
+        thread = std::thread([this]() { run(); });
+    }
+
+    // stops the thread and hands the world back
+    void stop(PhysicsWorld& destination)
+    {
+        if (!running())
+            return;
+        stopThread();
+        applyCommands();
+        destination = world;
+    }
+
+    // fn runs on the physics thread before the next step
+    void post(std::function<void(PhysicsWorld&)> fn)
+    {
+        std::lock_guard<std::mutex> lock(commandMutex);
+        commands.push_back(std::move(fn));
+    }
+
+    void setPacing(float speed, float stepSize, int maxSteps, bool paused)
+    {
+        simulationSpeed.store(speed, std::memory_order_relaxed);
+        this->stepSize.store(stepSize, std::memory_order_relaxed);
+        maxStepsPerBatch.store(std::max(maxSteps, 1), std::memory_order_relaxed);
+        this->paused.store(paused, std::memory_order_relaxed);
+    }
+
+    // the recorder captures on the physics thread while it runs, and start/stop must then be posted
+    void setRecorder(TrajectoryRecorder* r)
+    {
+        if (running())
+            post([this, r](PhysicsWorld&) { recorder = r; });
+        else
+            recorder = r;
+    }
+
+    // true if a newer snapshot is available, latest() stays valid until the next acquire
+    bool acquire() { return snapshots.acquire(); }
+    const PhysicsSnapshot& latest() const { return snapshots.readSlot(); }
+
+private:
+    PhysicsWorld world;
+    std::thread thread;
+    std::atomic<bool> stopRequested{false};
+    std::mutex commandMutex;
+    std::vector<std::function<void(PhysicsWorld&)>> commands;
+    std::vector<std::function<void(PhysicsWorld&)>> pendingCommands;
+    TripleBuffer<PhysicsSnapshot> snapshots;
+    TrajectoryRecorder* recorder = nullptr;
+
+    std::atomic<float> simulationSpeed{1.0f};
+    std::atomic<float> stepSize{1.0f / 120.0f};
+    std::atomic<int> maxStepsPerBatch{8};
+    std::atomic<bool> paused{false};
+
+    void stopThread()
+    {
+        stopRequested = true;
+        if (thread.joinable())
+            thread.join();
+    }
+
+    bool applyCommands()
+    {
+        {
+            std::lock_guard<std::mutex> lock(commandMutex);
+            pendingCommands.swap(commands);
+        }
+        bool any = !pendingCommands.empty();
+        for (auto& fn : pendingCommands)
+            fn(world);
+        pendingCommands.clear();
+        return any;
+    }
+
+    void run()
+    {
+        profiler().nameThread("physics");
+        ALLOC_SCOPE(ALLOC_PHYSICS);
+        using clock = std::chrono::steady_clock;
+        clock::time_point last = clock::now();
+        float accumulator = 0.0f;
+        while (!stopRequested)
+        {
+            bool edited = applyCommands();
+
+            clock::time_point now = clock::now();
+            float wallDt = std::chrono::duration<float>(now - last).count();
+            last = now;
+
+            const float dt = stepSize.load(std::memory_order_relaxed);
+            const int maxSteps = maxStepsPerBatch.load(std::memory_order_relaxed);
+            if (!paused.load(std::memory_order_relaxed))
+                accumulator += wallDt * simulationSpeed.load(std::memory_order_relaxed);
+
+            unsigned int steps = 0;
+            while (dt > 0.0f && accumulator >= dt && static_cast<int>(steps) < maxSteps)
+            {
+                world.step(dt);
+                if (recorder) recorder->capture(world.bodies, world.simTime, world.stepCount);
+                accumulator -= dt;
+                steps++;
+            }
+            // same policy as the render loop: when the cap is hit the backlog is dropped
+            if (static_cast<int>(steps) == maxSteps && accumulator > dt)
+                accumulator = dt;
+
+            if (steps > 0 || edited)
+            {
+                PhysicsSnapshot& slot = snapshots.writeSlot();
+                slot.position.assign(world.bodies.position.begin(), world.bodies.position.end());
+                slot.id = world.bodies.id;
+                slot.simTime = world.simTime;
+                slot.stepCount = world.stepCount;
+                slot.stepsLastBatch = steps;
+                world.stats(slot.stats);
+                snapshots.publish();
+            }
+            else
+            {
+                // nothing due yet, sleep roughly until the next step instead of spinning
+                float speed = simulationSpeed.load(std::memory_order_relaxed);
+                float untilNext = speed > 0.0f ? (dt - accumulator) / speed : 0.002f;
+                std::this_thread::sleep_for(std::chrono::duration<float>(std::clamp(untilNext, 0.0002f, 0.002f)));
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,327 @@
+#ifndef ATMOSPHERE_H
+#define ATMOSPHERE_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <shader.h>
+#include <gpu_memory.h>
+#include <gl_state_cache.h>
+#include <gl_debug.h>
+
+#include <algorithm>
+#include <vector>
+
+// Atmospheres for the planets from precomputed scattering, after Bruneton and Neyret: the light scattered along
+// any view ray through a Rayleigh and Mie atmosphere, to every order, is built once into lookup tables indexed by
+// the ray's height and its angles to the zenith and the sun, so drawing it is a few texture fetches per pixel
+// where marching the ray would be hundreds. rebuild() queues the tables' computation (shaders.2/
+// atmosphere.precompute.cs): transmittance to the top of the atmosphere, the sun's irradiance on the ground,
+// single scattering, then for each further order the light scattered at every point, the ground's irradiance
+// from the sky and the scattering gathered along the ray. update() runs a few of those dispatches a frame, the 3D
+// ones a slice at a time, so changing a parameter does not stall the viewer; ready() says when the tables are
+// whole. draw() lays one planet's atmosphere over the finished scene (shaders.2/atmosphere.fs).
+//
+// Every planet shares the same tables, its atmosphere scaled to its radius: heights and coefficients are in
+// planet radii, the atmosphere many times thicker than Earth's relative to the planet so it shows at the scene's
+// scale, with Earth's optical depths through it.
+class Atmosphere
+{
+public:
+    // the sizes of shaders.2/atmosphere.glsl's tables
+    static const int TRANSMITTANCE_WIDTH = 256;
+    static const int TRANSMITTANCE_HEIGHT = 64;
+    static const int SCATTERING_R = 32;
+    static const int SCATTERING_MU = 128;
+    static const int SCATTERING_MU_S = 32;
+    static const int SCATTERING_NU = 8;
+    static const int IRRADIANCE_WIDTH = 64;
+    static const int IRRADIANCE_HEIGHT = 16;
+
+    struct Parameters
+    {
+        float thickness = 0.08f;            // the top's height over the ground, planet radii
+        glm::vec3 rayleighDepth = glm::vec3(0.0464f, 0.108f, 0.265f);    // optical depth straight up, Earth's
+        float rayleighHeight = 0.125f;      // scale height, of the thickness
+        float mieDepth = 0.0048f;
+        float mieHeight = 0.02f;
+        float mieAlbedo = 0.9f;             // scattering over extinction
+        float mieG = 0.8f;                  // the phase function's asymmetry
+        glm::vec3 groundAlbedo = glm::vec3(0.1f);
+        float sunAngularRadius = 0.00467f;  // radians
+        int scatteringOrders = 4;
+
+        bool operator==(const Parameters& other) const
+        {
+            return thickness == other.thickness && rayleighDepth == other.rayleighDepth
+                && rayleighHeight == other.rayleighHeight && mieDepth == other.mieDepth
+                && mieHeight == other.mieHeight && mieAlbedo == other.mieAlbedo && mieG == other.mieG
+                && groundAlbedo == other.groundAlbedo && sunAngularRadius == other.sunAngularRadius
+                && scatteringOrders == other.scatteringOrders;
+        }
+        bool operator!=(const Parameters& other) const { return !(*this == other); }
+    };
+
+    float brightness = 4.0f;            // the sun's irradiance in the scene's units
+    unsigned int jobsPerFrame = 16;     // dispatches update() runs a frame
+
+    Atmosphere(const char* precomputePath, const char* vertexPath, const char* fragmentPath)
+        : precomputeShader(precomputePath), shader(vertexPath, fragmentPath) {}
+    Atmosphere(const Atmosphere&) = delete;
+    Atmosphere& operator=(const Atmosphere&) = delete;
+
+    ~Atmosphere()
+    {
+        release();
+    }
+
+    Shader& program() { return shader; }
+    // empty, bound for draw()
+    unsigned int vertexArray()
+    {
+        if (emptyVao.id() == 0)
+        {
+            emptyVao.create("atmosphere");
+            glState().bindVertexArray(0);
+        }
+        return emptyVao.id();
+    }
+
+    const Parameters& parameters() const { return current; }
+    bool ready() const { return built && nextJob == jobs.size(); }
+    // of the queued dispatches, done
+    float progress() const { return jobs.empty() ? 1.0f : static_cast<float>(nextJob) / jobs.size(); }
+
+    // queues the tables' computation for parameters, the old tables dropped
+    void rebuild(const Parameters& parameters)
+    {
+        current = parameters;
+        current.scatteringOrders = std::clamp(current.scatteringOrders, 1, 8);
+        allocate();
+        const GLfloat zero[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        glClearTexImage(irradiance.id(), 0, GL_RGBA, GL_FLOAT, zero);
+        setParameters(precomputeShader);
+        setParameters(shader);
+
+        jobs.clear();
+        nextJob = 0;
+        jobs.push_back({STAGE_TRANSMITTANCE, 0, 0});
+        jobs.push_back({STAGE_DIRECT_IRRADIANCE, 0, 0});
+        for (int slice = 0; slice < SCATTERING_R; slice++)
+            jobs.push_back({STAGE_SINGLE_SCATTERING, slice, 1});
+        for (int order = 2; order <= current.scatteringOrders; order++)
+        {
+            for (int slice = 0; slice < SCATTERING_R; slice++)
+                jobs.push_back({STAGE_SCATTERING_DENSITY, slice, order});
+            jobs.push_back({STAGE_INDIRECT_IRRADIANCE, 0, order});
+            for (int slice = 0; slice < SCATTERING_R; slice++)
+                jobs.push_back({STAGE_MULTIPLE_SCATTERING, slice, order});
+        }
+        built = true;
+    }
+
+    // runs the next of the queued dispatches, before the draws
+    void update()
+    {
+        if (!built || nextJob == jobs.size())
+            return;
+        GL_DEBUG_GROUP("atmosphere precompute");
+        precomputeShader.use();
+        bind2D(0, transmittance);
+        bind3D(1, deltaScattering);
+        bind3D(2, singleMie);
+        bind3D(3, deltaScattering);
+        bind2D(4, deltaIrradiance);
+        bind3D(5, scatteringDensity);
+        glBindImageTexture(0, transmittance.id(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+        glBindImageTexture(1, deltaIrradiance.id(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+        glBindImageTexture(2, irradiance.id(), 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+        glBindImageTexture(3, deltaScattering.id(), 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+        glBindImageTexture(4, singleMie.id(), 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+        glBindImageTexture(5, scattering.id(), 0, GL_TRUE, 0, GL_READ_WRITE, GL_RGBA32F);
+        glBindImageTexture(6, scatteringDensity.id(), 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+
+        for (unsigned int n = 0; n < std::max(jobsPerFrame, 1u) && nextJob < jobs.size(); n++, nextJob++)
+        {
+            const Job& job = jobs[nextJob];
+            precomputeShader.setInt("stage", job.stage);
+            precomputeShader.setInt("slice", job.slice);
+            precomputeShader.setInt("order", job.order);
+            if (job.stage == STAGE_TRANSMITTANCE)
+                glDispatchCompute((TRANSMITTANCE_WIDTH + 7) / 8, (TRANSMITTANCE_HEIGHT + 7) / 8, 1);
+            else if (job.stage == STAGE_DIRECT_IRRADIANCE || job.stage == STAGE_INDIRECT_IRRADIANCE)
+                glDispatchCompute((IRRADIANCE_WIDTH + 7) / 8, (IRRADIANCE_HEIGHT + 7) / 8, 1);
+            else
+                glDispatchCompute((SCATTERING_NU * SCATTERING_MU_S + 7) / 8, (SCATTERING_MU + 7) / 8, 1);
+            // a slice reads its neighbours' results of the stage before, never its own stage's
+            if (nextJob + 1 == jobs.size() || jobs[nextJob + 1].stage != job.stage)
+                glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+        }
+        for (GLuint unit = 0; unit < 7; unit++)
+            glBindImageTexture(unit, 0, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+        for (GLenum unit = 0; unit < 6; unit++)
+        {
+            glState().activeTexture(GL_TEXTURE0 + unit);
+            glState().bindTexture(unit == 0 || unit == 4 ? GL_TEXTURE_2D : GL_TEXTURE_3D, 0);
+        }
+        glState().activeTexture(GL_TEXTURE0);
+
+        // the intermediates are only needed while building
+        if (nextJob == jobs.size())
+        {
+            deltaIrradiance.release();
+            deltaScattering.release();
+            scatteringDensity.release();
+        }
+    }
+
+    // one planet's atmosphere over the screen, with the shader in use and vertexArray() bound: its center and the
+    // direction to the sun from it in view space. Depth is tested but not written, and only the first colour
+    // attachment is written.
+    void draw(const glm::mat4& projection, const glm::vec3& planetCenter, float planetRadius, const glm::vec3& sunDirection)
+    {
+        if (!ready())
+            return;
+        bind2D(0, transmittance);
+        bind3D(1, scattering);
+        bind3D(2, singleMie);
+        bind2D(3, irradiance);
+        glState().activeTexture(GL_TEXTURE0);
+        shader.setMat4("projection", projection);
+        shader.setMat4("inverseProjection", glm::inverse(projection));
+        shader.setVec3("planetCenter", planetCenter);
+        shader.setFloat("planetRadius", planetRadius);
+        shader.setVec3("sunDirection", glm::normalize(sunDirection));
+        shader.setFloat("brightness", brightness);
+        // what is behind is dimmed by the transmittance in alpha, the scattered light added over it
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_SRC_ALPHA);
+        glDepthMask(GL_FALSE);
+        glDisable(GL_CULL_FACE);
+        glColorMaski(1, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glColorMaski(1, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glEnable(GL_CULL_FACE);
+        glDepthMask(GL_TRUE);
+        glDisable(GL_BLEND);
+    }
+
+    void release()
+    {
+        transmittance.release();
+        scattering.release();
+        singleMie.release();
+        irradiance.release();
+        deltaIrradiance.release();
+        deltaScattering.release();
+        scatteringDensity.release();
+        emptyVao.release();
+        jobs.clear();
+        nextJob = 0;
+        built = false;
+    }
+
+private:
+    enum Stage
+    {
+        STAGE_TRANSMITTANCE,
+        STAGE_DIRECT_IRRADIANCE,
+        STAGE_SINGLE_SCATTERING,
+        STAGE_SCATTERING_DENSITY,
+        STAGE_INDIRECT_IRRADIANCE,
+        STAGE_MULTIPLE_SCATTERING
+    };
+
+    struct Job
+    {
+        int stage;
+        int slice;
+        int order;
+    };
+
+    Shader precomputeShader;
+    Shader shader;
+    GlTexture transmittance{GPU_MEMORY_RENDER_TARGETS};
+    GlTexture scattering{GPU_MEMORY_RENDER_TARGETS};       // every order's Rayleigh and multiple, over the Rayleigh phase
+    GlTexture singleMie{GPU_MEMORY_RENDER_TARGETS};
+    GlTexture irradiance{GPU_MEMORY_RENDER_TARGETS};       // the sky's on the ground, the sun's direct left out
+    GlTexture deltaIrradiance{GPU_MEMORY_RENDER_TARGETS};  // the last order's
+    GlTexture deltaScattering{GPU_MEMORY_RENDER_TARGETS};
+    GlTexture scatteringDensity{GPU_MEMORY_RENDER_TARGETS};
+    GlVertexArray emptyVao;
+    Parameters current;
+    std::vector<Job> jobs;
+    size_t nextJob = 0;
+    bool built = false;
+
+    // the coefficients from the optical depths, per planet radius
+    void setParameters(Shader& program) const
+    {
+        const float rayleighHeight = std::max(current.rayleighHeight * current.thickness, 1e-4f);
+        const float mieHeight = std::max(current.mieHeight * current.thickness, 1e-4f);
+        const glm::vec3 mieScattering(current.mieDepth / mieHeight);
+        program.use();
+        program.setFloat("topRadius", 1.0f + std::max(current.thickness, 1e-3f));
+        program.setVec3("rayleighScattering", current.rayleighDepth / rayleighHeight);
+        program.setFloat("rayleighScaleHeight", rayleighHeight);
+        program.setVec3("mieScattering", mieScattering);
+        program.setVec3("mieExtinction", mieScattering / std::clamp(current.mieAlbedo, 0.01f, 1.0f));
+        program.setFloat("mieScaleHeight", mieHeight);
+        program.setFloat("miePhaseG", std::clamp(current.mieG, -0.99f, 0.99f));
+        program.setVec3("groundAlbedo", current.groundAlbedo);
+        program.setVec3("solarIrradiance", glm::vec3(1.0f));
+        program.setFloat("sunAngularRadius", current.sunAngularRadius);
+        program.setFloat("muSMin", -0.5f);
+    }
+
+    void allocate()
+    {
+        GL_DEBUG_GROUP("atmosphere tables");
+        allocate2D(transmittance, "atmosphere transmittance", TRANSMITTANCE_WIDTH, TRANSMITTANCE_HEIGHT);
+        allocate2D(irradiance, "atmosphere irradiance", IRRADIANCE_WIDTH, IRRADIANCE_HEIGHT);
+        allocate2D(deltaIrradiance, "atmosphere delta irradiance", IRRADIANCE_WIDTH, IRRADIANCE_HEIGHT);
+        allocate3D(scattering, "atmosphere scattering", GL_RGBA32F);
+        allocate3D(singleMie, "atmosphere single mie", GL_RGBA16F);
+        allocate3D(deltaScattering, "atmosphere delta scattering", GL_RGBA32F);
+        allocate3D(scatteringDensity, "atmosphere scattering density", GL_RGBA32F);
+    }
+
+    static void allocate2D(GlTexture& texture, const char* label, int width, int height)
+    {
+        texture.create(GL_TEXTURE_2D, label);
+        texture.storage2D(1, GL_RGBA32F, width, height);
+        sampling(GL_TEXTURE_2D);
+        glState().bindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    static void allocate3D(GlTexture& texture, const char* label, GLenum format)
+    {
+        texture.create(GL_TEXTURE_3D, label);
+        texture.storage3D(1, format, SCATTERING_NU * SCATTERING_MU_S, SCATTERING_MU, SCATTERING_R);
+        sampling(GL_TEXTURE_3D);
+        glState().bindTexture(GL_TEXTURE_3D, 0);
+    }
+
+    static void sampling(GLenum target)
+    {
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    }
+
+    static void bind2D(GLenum unit, const GlTexture& texture)
+    {
+        glState().activeTexture(GL_TEXTURE0 + unit);
+        glState().bindTexture(GL_TEXTURE_2D, texture.id());
+    }
+
+    static void bind3D(GLenum unit, const GlTexture& texture)
+    {
+        glState().activeTexture(GL_TEXTURE0 + unit);
+        glState().bindTexture(GL_TEXTURE_3D, texture.id());
+    }
+};
+
+#endif
@@ -0,0 +1,262 @@
+#ifndef BARNES_HUT_H
+#define BARNES_HUT_H
+
+#include <glm.hpp>
+
+#include <force_kernels.h>
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <type_traits>
+
+// Barnes-Hut octree for approximate O(N log N) gravity.
+// The tree is rebuilt from scratch every step: bodies are partitioned into octants by index (no per-node allocations),
+// so each leaf owns a contiguous range of the index array and can be summed directly.
+class BarnesHutTree
+{
+public:
+    struct Node
+    {
+        glm::vec3 center;       // geometric center of the cell
+        float halfSize;         // half the edge length of the (cubic) cell
+        glm::vec3 centerOfMass;
+        float mass;
+        int firstChild;         // index of the first of this node's children in nodes, -1 for leaves
+        unsigned int childCount;
+        unsigned int begin;     // range into indices covered by this node
+        unsigned int end;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<unsigned int> indices;
+
+    unsigned int leafCapacity = 8;  // bodies a leaf may hold before it is split
+    unsigned int maxDepth = 32;     // guards against coincident bodies recursing forever
+
+    // builds the tree over count bodies. Positions and masses are read through a stride so the tree
+    // can index straight into whatever storage the caller uses.
+    void build(const glm::vec3* positions, const float* masses, size_t count,
+               size_t positionStride = sizeof(glm::vec3), size_t massStride = sizeof(float))
+    {
+        nodes.clear();
+        indices.resize(count);
+        this->positions = positions;
+        this->masses = masses;
+        this->positionStride = positionStride;
+        this->massStride = massStride;
+        if (count == 0)
+            return;
+
+        glm::vec3 minCorner = positionOf(0);
+        glm::vec3 maxCorner = minCorner;
+        for (unsigned int i = 0; i < count; i++)
+        {
+            indices[i] = i;
+            minCorner = glm::min(minCorner, positionOf(i));
+            maxCorner = glm::max(maxCorner, positionOf(i));
+        }
+        glm::vec3 extent = maxCorner - minCorner;
+        float halfSize = 0.5f * std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-3f));
+        // a tree over N bodies with small leaves needs roughly N/4 nodes, reserving avoids regrowth during the build
+        nodes.reserve(count / 2 + 16);
+        nodes.push_back(Node());
+        scratch.resize(count);
+        buildNode(0, 0, static_cast<unsigned int>(count), 0.5f * (minCorner + maxCorner), halfSize * 1.0001f, 0);
+    }
+
+    // acceleration of a body at pos due to every body in the tree (G is applied by the caller), under the force law
+    // and precision of force_kernels.h. A tree body's own term is zero at zero separation, so it needs no skipping
+    // and a probe that is not a tree body is treated the same. If interactions is given, the number of body and cell
+    // terms summed is added to it, if potential is given the potential of the same terms is written to it.
+    glm::vec3 accelerationAt(const glm::vec3& pos, float theta, float epsilonSq, unsigned long long* interactions = nullptr,
+                             float* potential = nullptr, ForceLaw law = FORCE_NEWTONIAN, ForcePrecision precision = PRECISION_FLOAT) const
+    {
+        if (potential)
+            *potential = 0.0f;
+        if (nodes.empty())
+            return glm::vec3(0.0f);
+        glm::vec3 acc(0.0f);
+        withForcePolicies(law, precision, epsilonSq, [&](const auto& forceLaw, auto precisionPolicy) {
+            typedef typename std::decay<decltype(forceLaw)>::type Law;
+            typedef decltype(precisionPolicy) Precision;
+            if (potential)
+                acc = traverse<Law, Precision, true>(forceLaw, pos, theta, interactions, potential);
+            else
+                acc = traverse<Law, Precision, false>(forceLaw, pos, theta, interactions, potential);
+        });
+        return acc;
+    }
+
+    static glm::vec3 pairAcceleration(const glm::vec3& pos, const glm::vec3& other, float mass, float epsilonSq)
+    {
+        glm::vec3 r_vec = other - pos;
+        float r_mag_sq = std::max(glm::dot(r_vec, r_vec), epsilonSq);
+        float inv_r = 1.0f / sqrt(r_mag_sq);
+        return r_vec * (mass * inv_r * inv_r * inv_r);
+    }
+
+    static float pairPotential(const glm::vec3& pos, const glm::vec3& other, float mass, float epsilonSq)
+    {
+        glm::vec3 r_vec = other - pos;
+        return -mass / sqrt(std::max(glm::dot(r_vec, r_vec), epsilonSq));
+    }
+
+private:
+    const glm::vec3* positions = nullptr;
+    const float* masses = nullptr;
+    size_t positionStride = sizeof(glm::vec3);
+    size_t massStride = sizeof(float);
+    std::vector<unsigned int> scratch;
+
+    // accelerationAt for one combination of the policies, a cell's monopole summed as a leaf of one body
+    template <typename Law, typename Precision, bool Potential>
+    glm::vec3 traverse(const Law& law, const glm::vec3& pos, float theta, unsigned long long* interactions, float* potential) const
+    {
+        typedef typename Precision::Real Real;
+        typedef typename Precision::Accum Accum;
+        const Real x = static_cast<Real>(pos.x), y = static_cast<Real>(pos.y), z = static_cast<Real>(pos.z);
+        Accum ax = Accum(0), ay = Accum(0), az = Accum(0), phi = Accum(0);
+        const float thetaSq = theta * theta;
+        unsigned long long terms = 0;
+        unsigned int stack[8 * 64];
+        unsigned int stackSize = 0;
+        stack[stackSize++] = 0;
+        while (stackSize > 0)
+        {
+            const Node& node = nodes[stack[--stackSize]];
+            if (node.mass <= 0.0f)
+                continue;
+
+            if (node.firstChild < 0)
+            {
+                // leaf: sum its bodies directly
+                const TreeLeaf leaf{indices.data(), reinterpret_cast<const char*>(positions), reinterpret_cast<const char*>(masses),
+                                    positionStride, massStride, node.begin, node.end};
+                sumSources<Law, Precision, Potential>(law, leaf, x, y, z, ax, ay, az, phi);
+                terms += node.end - node.begin;
+                continue;
+            }
+
+            glm::vec3 d = node.centerOfMass - pos;
+            float distSq = glm::dot(d, d);
+            float size = 2.0f * node.halfSize;
+            // cells that contain the probe are always opened, otherwise they would be approximated by a
+            // center of mass the probe itself contributes to
+            glm::vec3 offset = glm::abs(pos - node.center);
+            bool containsProbe = offset.x <= node.halfSize && offset.y <= node.halfSize && offset.z <= node.halfSize;
+            if (!containsProbe && size * size < thetaSq * distSq)
+            {
+                const SourceRun monopole{&node.centerOfMass.x, &node.centerOfMass.y, &node.centerOfMass.z, &node.mass, 0, 1};
+                sumSources<Law, Precision, Potential>(law, monopole, x, y, z, ax, ay, az, phi);
+                terms++;
+            }
+            else
+            {
+                for (unsigned int c = 0; c < node.childCount; c++)
+                    stack[stackSize++] = static_cast<unsigned int>(node.firstChild) + c;
+            }
+        }
+        if (interactions)
+            *interactions += terms;
+        if (Potential)
+            *potential = static_cast<float>(phi);
+        return glm::vec3(static_cast<float>(ax), static_cast<float>(ay), static_cast<float>(az));
+    }
+
+    const glm::vec3& positionOf(unsigned int i) const
+    {
+        return *reinterpret_cast<const glm::vec3*>(reinterpret_cast<const char*>(positions) + i * positionStride);
+    }
+    float massOf(unsigned int i) const
+    {
+        return *reinterpret_cast<const float*>(reinterpret_cast<const char*>(masses) + i * massStride);
+    }
+
+    static unsigned int octantOf(const glm::vec3& p, const glm::vec3& center)
+    {
+        return (p.x >= center.x ? 1u : 0u) | (p.y >= center.y ? 2u : 0u) | (p.z >= center.z ? 4u : 0u);
+    }
+
+    void buildNode(unsigned int nodeIndex, unsigned int begin, unsigned int end, glm::vec3 center, float halfSize, unsigned int depth)
+    {
+        {
+            Node& node = nodes[nodeIndex];
+            node.center = center;
+            node.halfSize = halfSize;
+            node.firstChild = -1;
+            node.childCount = 0;
+            node.begin = begin;
+            node.end = end;
+        }
+
+        if (end - begin <= leafCapacity || depth >= maxDepth)
+        {
+            float mass = 0.0f;
+            glm::vec3 weighted(0.0f);
+            for (unsigned int k = begin; k < end; k++)
+            {
+                float m = massOf(indices[k]);
+                mass += m;
+                weighted += m * positionOf(indices[k]);
+            }
+            Node& node = nodes[nodeIndex];
+            node.mass = mass;
+            node.centerOfMass = mass > 0.0f ? weighted / mass : center;
+            return;
+        }
+
+        // counting sort of the range by octant
+        unsigned int counts[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+        for (unsigned int k = begin; k < end; k++)
+            counts[octantOf(positionOf(indices[k]), center)]++;
+        unsigned int offsets[8];
+        unsigned int running = begin;
+        for (unsigned int o = 0; o < 8; o++)
+        {
+            offsets[o] = running;
+            running += counts[o];
+        }
+        for (unsigned int k = begin; k < end; k++)
+        {
+            unsigned int i = indices[k];
+            scratch[offsets[octantOf(positionOf(i), center)]++] = i;
+        }
+        std::copy(scratch.begin() + begin, scratch.begin() + end, indices.begin() + begin);
+
+        // children of a node are stored consecutively, empty octants are skipped
+        unsigned int childCount = 0;
+        for (unsigned int o = 0; o < 8; o++)
+            if (counts[o] > 0) childCount++;
+        unsigned int firstChild = static_cast<unsigned int>(nodes.size());
+        nodes.resize(nodes.size() + childCount);
+        nodes[nodeIndex].firstChild = static_cast<int>(firstChild);
+        nodes[nodeIndex].childCount = childCount;
+
+        float childHalf = 0.5f * halfSize;
+        unsigned int child = firstChild;
+        unsigned int childBegin = begin;
+        for (unsigned int o = 0; o < 8; o++)
+        {
+            if (counts[o] == 0)
+                continue;
+            glm::vec3 childCenter = center + childHalf * glm::vec3((o & 1) ? 1.0f : -1.0f, (o & 2) ? 1.0f : -1.0f, (o & 4) ? 1.0f : -1.0f);
+            buildNode(child, childBegin, childBegin + counts[o], childCenter, childHalf, depth + 1);
+            childBegin += counts[o];
+            child++;
+        }
+
+        float mass = 0.0f;
+        glm::vec3 weighted(0.0f);
+        for (unsigned int c = firstChild; c < firstChild + childCount; c++)
+        {
+            mass += nodes[c].mass;
+            weighted += nodes[c].mass * nodes[c].centerOfMass;
+        }
+        Node& node = nodes[nodeIndex];
+        node.mass = mass;
+        node.centerOfMass = mass > 0.0f ? weighted / mass : center;
+    }
+};
+
+#endif
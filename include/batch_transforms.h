@@ -0,0 +1,223 @@
+#ifndef BATCH_TRANSFORMS_H
+#define BATCH_TRANSFORMS_H
+
+#include <glm.hpp>
+#include <gtc/quaternion.hpp>
+
+#include <vector>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define BATCH_TRANSFORMS_X86 1
+#endif
+
+// Model matrices of many bodies at once, from a translation, a unit quaternion and a uniform scale each, for the
+// instance lists the CPU still fills. The matrix is written out in closed form, the rotation's nine terms times the
+// scale and the translation as the last column, instead of glm::translate * mat4_cast * scale and its three 4x4
+// products. The AVX variant takes 8 bodies at a time from the TransformBatch's separate arrays, transposes the
+// 8 matrices in registers and stores each one whole, so it can write straight into a mapped instance ring at any
+// record stride. Like gravity_kernels.h it is compiled with a target attribute and picked at runtime.
+
+// one body's model matrix, translate(at) * mat4_cast(orientation) * scale(scale)
+inline glm::mat4 composeTransform(const glm::vec3& at, const glm::quat& q, float scale)
+{
+    const float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    const float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    const float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+    const float s2 = 2.0f * scale;
+    return glm::mat4(scale - s2 * (yy + zz), s2 * (xy + wz), s2 * (xz - wy), 0.0f,
+                     s2 * (xy - wz), scale - s2 * (xx + zz), s2 * (yz + wx), 0.0f,
+                     s2 * (xz + wy), s2 * (yz - wx), scale - s2 * (xx + yy), 0.0f,
+                     at.x, at.y, at.z, 1.0f);
+}
+
+// the bodies' placements as separate arrays, entry k of each for body k
+struct TransformBatch
+{
+    std::vector<float> x, y, z;         // translation
+    std::vector<float> qx, qy, qz, qw;  // unit orientation
+    std::vector<float> s;               // uniform scale
+
+    size_t size() const { return s.size(); }
+
+    void clear()
+    {
+        for (std::vector<float>* v : { &x, &y, &z, &qx, &qy, &qz, &qw, &s })
+            v->clear();
+    }
+
+    void push(const glm::vec3& at, const glm::quat& q, float scale)
+    {
+        x.push_back(at.x); y.push_back(at.y); z.push_back(at.z);
+        qx.push_back(q.x); qy.push_back(q.y); qz.push_back(q.z); qw.push_back(q.w);
+        s.push_back(scale);
+    }
+};
+
+inline bool batchTransformsAVX()
+{
+#ifdef BATCH_TRANSFORMS_X86
+    static const bool supported = __builtin_cpu_supports("avx");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+// the model matrices of bodies [begin, end), body k's at out + (k - begin) * stride bytes
+inline void composeTransformsScalar(const TransformBatch& batch, size_t begin, size_t end, void* out, size_t stride)
+{
+    unsigned char* record = static_cast<unsigned char*>(out);
+    for (size_t k = begin; k < end; k++, record += stride)
+    {
+        const glm::mat4 m = composeTransform(glm::vec3(batch.x[k], batch.y[k], batch.z[k]),
+                                             glm::quat(batch.qw[k], batch.qx[k], batch.qy[k], batch.qz[k]), batch.s[k]);
+        std::memcpy(record, &m, sizeof(m));
+    }
+}
+
+// normal matrices for the same bodies, mat3_cast(orientation) / scale, which the uniform scale makes the inverse
+// transpose of the model matrix's upper 3x3. Columns are padded to vec4 as std140 and std430 lay a mat3 out.
+inline void normalMatricesScalar(const TransformBatch& batch, size_t begin, size_t end, void* out, size_t stride)
+{
+    unsigned char* record = static_cast<unsigned char*>(out);
+    for (size_t k = begin; k < end; k++, record += stride)
+    {
+        const glm::mat4 m = composeTransform(glm::vec3(0.0f), glm::quat(batch.qw[k], batch.qx[k], batch.qy[k], batch.qz[k]),
+                                             1.0f / batch.s[k]);
+        float columns[12];
+        for (int c = 0; c < 3; c++)
+        {
+            columns[4 * c] = m[c][0]; columns[4 * c + 1] = m[c][1]; columns[4 * c + 2] = m[c][2]; columns[4 * c + 3] = 0.0f;
+        }
+        std::memcpy(record, columns, sizeof(columns));
+    }
+}
+
+#ifdef BATCH_TRANSFORMS_X86
+// rows[i] lane j to rows[j] lane i
+__attribute__((target("avx")))
+inline void batchTranspose8(__m256 rows[8])
+{
+    const __m256 t0 = _mm256_unpacklo_ps(rows[0], rows[1]), t1 = _mm256_unpackhi_ps(rows[0], rows[1]);
+    const __m256 t2 = _mm256_unpacklo_ps(rows[2], rows[3]), t3 = _mm256_unpackhi_ps(rows[2], rows[3]);
+    const __m256 t4 = _mm256_unpacklo_ps(rows[4], rows[5]), t5 = _mm256_unpackhi_ps(rows[4], rows[5]);
+    const __m256 t6 = _mm256_unpacklo_ps(rows[6], rows[7]), t7 = _mm256_unpackhi_ps(rows[6], rows[7]);
+    const __m256 u0 = _mm256_shuffle_ps(t0, t2, 0x44), u1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+    const __m256 u2 = _mm256_shuffle_ps(t1, t3, 0x44), u3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+    const __m256 u4 = _mm256_shuffle_ps(t4, t6, 0x44), u5 = _mm256_shuffle_ps(t4, t6, 0xEE);
+    const __m256 u6 = _mm256_shuffle_ps(t5, t7, 0x44), u7 = _mm256_shuffle_ps(t5, t7, 0xEE);
+    rows[0] = _mm256_permute2f128_ps(u0, u4, 0x20);
+    rows[1] = _mm256_permute2f128_ps(u1, u5, 0x20);
+    rows[2] = _mm256_permute2f128_ps(u2, u6, 0x20);
+    rows[3] = _mm256_permute2f128_ps(u3, u7, 0x20);
+    rows[4] = _mm256_permute2f128_ps(u0, u4, 0x31);
+    rows[5] = _mm256_permute2f128_ps(u1, u5, 0x31);
+    rows[6] = _mm256_permute2f128_ps(u2, u6, 0x31);
+    rows[7] = _mm256_permute2f128_ps(u3, u7, 0x31);
+}
+
+// the rotation's nine terms of 8 bodies times scale, column-major: the column c, row r term in terms[3 * c + r]
+__attribute__((target("avx")))
+inline void batchRotation8(const TransformBatch& batch, size_t k, const __m256& scale, __m256 terms[9])
+{
+    const __m256 x = _mm256_loadu_ps(&batch.qx[k]), y = _mm256_loadu_ps(&batch.qy[k]);
+    const __m256 z = _mm256_loadu_ps(&batch.qz[k]), w = _mm256_loadu_ps(&batch.qw[k]);
+    const __m256 s2 = _mm256_add_ps(scale, scale);
+    const __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+    const __m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+    const __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+    terms[0] = _mm256_sub_ps(scale, _mm256_mul_ps(s2, _mm256_add_ps(yy, zz)));
+    terms[1] = _mm256_mul_ps(s2, _mm256_add_ps(xy, wz));
+    terms[2] = _mm256_mul_ps(s2, _mm256_sub_ps(xz, wy));
+    terms[3] = _mm256_mul_ps(s2, _mm256_sub_ps(xy, wz));
+    terms[4] = _mm256_sub_ps(scale, _mm256_mul_ps(s2, _mm256_add_ps(xx, zz)));
+    terms[5] = _mm256_mul_ps(s2, _mm256_add_ps(yz, wx));
+    terms[6] = _mm256_mul_ps(s2, _mm256_add_ps(xz, wy));
+    terms[7] = _mm256_mul_ps(s2, _mm256_sub_ps(yz, wx));
+    terms[8] = _mm256_sub_ps(scale, _mm256_mul_ps(s2, _mm256_add_ps(xx, yy)));
+}
+
+__attribute__((target("avx")))
+inline void composeTransformsAVX(const TransformBatch& batch, size_t begin, size_t end, void* out, size_t stride)
+{
+    unsigned char* record = static_cast<unsigned char*>(out);
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+    size_t k = begin;
+    for (; k + 8 <= end; k += 8, record += 8 * stride)
+    {
+        __m256 r[9];
+        batchRotation8(batch, k, _mm256_loadu_ps(&batch.s[k]), r);
+        // each matrix's first two columns, then its last two
+        __m256 low[8] = { r[0], r[1], r[2], zero, r[3], r[4], r[5], zero };
+        __m256 high[8] = { r[6], r[7], r[8], zero, _mm256_loadu_ps(&batch.x[k]), _mm256_loadu_ps(&batch.y[k]), _mm256_loadu_ps(&batch.z[k]), one };
+        batchTranspose8(low);
+        batchTranspose8(high);
+        for (int b = 0; b < 8; b++)
+        {
+            float* m = reinterpret_cast<float*>(record + b * stride);
+            _mm256_storeu_ps(m, low[b]);
+            _mm256_storeu_ps(m + 8, high[b]);
+        }
+    }
+    composeTransformsScalar(batch, k, end, record, stride);
+}
+
+__attribute__((target("avx")))
+inline void normalMatricesAVX(const TransformBatch& batch, size_t begin, size_t end, void* out, size_t stride)
+{
+    unsigned char* record = static_cast<unsigned char*>(out);
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+    size_t k = begin;
+    for (; k + 8 <= end; k += 8, record += 8 * stride)
+    {
+        __m256 r[9];
+        batchRotation8(batch, k, _mm256_div_ps(one, _mm256_loadu_ps(&batch.s[k])), r);
+        __m256 low[8] = { r[0], r[1], r[2], zero, r[3], r[4], r[5], zero };
+        __m256 high[8] = { r[6], r[7], r[8], zero, zero, zero, zero, zero };
+        batchTranspose8(low);
+        batchTranspose8(high);
+        for (int b = 0; b < 8; b++)
+        {
+            float* m = reinterpret_cast<float*>(record + b * stride);
+            _mm256_storeu_ps(m, low[b]);
+            _mm_storeu_ps(m + 8, _mm256_castps256_ps128(high[b]));
+        }
+    }
+    normalMatricesScalar(batch, k, end, record, stride);
+}
+#endif
+
+// the model matrices of bodies [begin, end) of batch, body k's 64 bytes at out + (k - begin) * stride bytes
+inline void composeTransforms(const TransformBatch& batch, size_t begin, size_t end, void* out, size_t stride = sizeof(glm::mat4))
+{
+    if (begin >= end)
+        return;
+#ifdef BATCH_TRANSFORMS_X86
+    if (batchTransformsAVX())
+    {
+        composeTransformsAVX(batch, begin, end, out, stride);
+        return;
+    }
+#endif
+    composeTransformsScalar(batch, begin, end, out, stride);
+}
+
+// their normal matrices, 48 bytes each (three vec4 columns) at the same kind of stride
+inline void normalMatrices(const TransformBatch& batch, size_t begin, size_t end, void* out, size_t stride = 3 * sizeof(glm::vec4))
+{
+    if (begin >= end)
+        return;
+#ifdef BATCH_TRANSFORMS_X86
+    if (batchTransformsAVX())
+    {
+        normalMatricesAVX(batch, begin, end, out, stride);
+        return;
+    }
+#endif
+    normalMatricesScalar(batch, begin, end, out, stride);
+}
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef BELT_SECTORS_H
+#define BELT_SECTORS_H
+
+#include <glm.hpp>
+#include <gtc/constants.hpp>
+
+#include <body_store.h>
+#include <thread_pool.h>
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+// The belt cut into angularCount x radialCount sectors around the sun (angle about its y axis, cylindrical radius
+// between the extremes of the belt), each with a rate level: a sector on level l gets the full force sum every 2^l
+// steps, and its asteroids follow their heliocentric two-body orbit in between. Sectors that come near the focus,
+// the viewer's camera or wherever the analysis looks, are on level 0, every doubling of the distance past
+// focusRadius goes one level down to maxLevel, and pinned sectors stay at full rate wherever they are. The force
+// work of a step then follows the region of interest instead of the size of the belt.
+//
+// Only the partition and the rates live here, PhysicsWorld::stepSectors moves the bodies.
+class BeltSectors
+{
+public:
+    struct Sector
+    {
+        float angleBegin, angleEnd;     // radians about the sun's y axis, from +x toward +z
+        float radiusBegin, radiusEnd;   // cylindrical, from the sun
+        unsigned int level = 0;         // the full force sum every 2^level steps
+        unsigned int bodies = 0;        // asteroids in it at the last assign()
+    };
+
+    unsigned int angularCount = 16;
+    unsigned int radialCount = 4;
+    unsigned int maxLevel = 3;          // with the belt at level 3 the error is about plain leapfrog's at full rate
+    float focusRadius = 150.0f;         // 0 leaves only the pinned sectors at full rate
+    glm::dvec3 focus{0.0};
+    std::vector<uint8_t> pinned;        // per sector, radial ring r and angle a at r * angularCount + a
+
+    size_t count() const { return static_cast<size_t>(angularCount) * radialCount; }
+    const std::vector<Sector>& sectors() const { return sectorList; }
+    // sector of asteroid k of the range as of the last assign()
+    unsigned int sectorOfAsteroid(size_t k) const { return sectorOf[k]; }
+
+    unsigned int stride(unsigned int s) const { return 1u << sectorList[s].level; }
+    // the sectors of one level take turns, so the slow part of the belt costs about the same every step
+    bool due(unsigned int s, unsigned long step) const { return ((step + s) & (stride(s) - 1)) == 0; }
+
+    // the layout is taken again from the belt's extent when the body count or the grid changes
+    void invalidate() { layoutAsteroids = SIZE_MAX; }
+
+    unsigned int sectorAt(const glm::dvec3& heliocentric) const
+    {
+        double angle = std::atan2(heliocentric.z, heliocentric.x);
+        if (angle < 0.0) angle += glm::two_pi<double>();
+        const double radius = std::sqrt(heliocentric.x * heliocentric.x + heliocentric.z * heliocentric.z);
+        const unsigned int a = std::min(angularCount - 1, static_cast<unsigned int>(angle * angularCount / glm::two_pi<double>()));
+        const double ring = outerRadius > innerRadius ? (radius - innerRadius) / (outerRadius - innerRadius) : 0.0;
+        const unsigned int r = static_cast<unsigned int>(std::clamp(ring * radialCount, 0.0, static_cast<double>(radialCount - 1)));
+        return r * angularCount + a;
+    }
+
+    // pins or unpins the sector holding a point relative to the sun, once assign() has laid the grid out
+    void togglePinAt(const glm::dvec3& heliocentric)
+    {
+        if (!sectorList.empty() && pinned.size() == count())
+            pinned[sectorAt(heliocentric)] ^= 1;
+    }
+
+    // puts every asteroid in its sector from its position relative to the sun and sets each sector's level
+    void assign(const BodyStore& bodies, const glm::dvec3& sun, unsigned int threads)
+    {
+        angularCount = std::max(angularCount, 1u);
+        radialCount = std::max(radialCount, 1u);
+        const BodyRange asteroids = bodies.range(BODY_ASTEROID);
+        const glm::dvec3* position = bodies.position.data();
+        if (layoutAsteroids != asteroids.size() || sectorList.size() != count())
+            layout(bodies, sun);
+
+        sectorOf.resize(asteroids.size());
+        sliceCounts.resize(workerPool().size());
+        for (std::vector<unsigned int>& c : sliceCounts) c.assign(count(), 0);
+        workerPool().parallelFor(asteroids.begin, asteroids.end, [&](size_t begin, size_t end, unsigned int slice) {
+            std::vector<unsigned int>& counts = sliceCounts[slice];
+            for (size_t i = begin; i < end; ++i) {
+                const unsigned int s = sectorAt(position[i] - sun);
+                sectorOf[i - asteroids.begin] = static_cast<uint16_t>(s);
+                counts[s]++;
+            }
+        }, threads);
+
+        const glm::dvec3 toFocus = focus - sun;
+        for (unsigned int s = 0; s < sectorList.size(); s++) {
+            Sector& sector = sectorList[s];
+            sector.bodies = 0;
+            for (const std::vector<unsigned int>& c : sliceCounts) sector.bodies += c[s];
+            if (s < pinned.size() && pinned[s])
+                sector.level = 0;
+            else if (focusRadius <= 0.0f)
+                sector.level = maxLevel;
+            else {
+                const double d = distanceTo(sector, toFocus);
+                sector.level = d <= focusRadius ? 0u : std::min(maxLevel, 1u + static_cast<unsigned int>(std::log2(d / focusRadius)));
+            }
+        }
+    }
+
+private:
+    std::vector<Sector> sectorList;
+    std::vector<uint16_t> sectorOf;
+    std::vector<std::vector<unsigned int>> sliceCounts;
+    size_t layoutAsteroids = SIZE_MAX;
+    double innerRadius = 0.0, outerRadius = 0.0;
+    double lowest = 0.0, highest = 0.0;     // the belt's extent in y from the sun
+
+    void layout(const BodyStore& bodies, const glm::dvec3& sun)
+    {
+        const BodyRange asteroids = bodies.range(BODY_ASTEROID);
+        // a sector index has to fit the per-asteroid uint16_t
+        while (count() > 65536) angularCount = std::max(1u, angularCount / 2);
+        innerRadius = lowest = INFINITY;
+        outerRadius = highest = -INFINITY;
+        for (size_t i = asteroids.begin; i < asteroids.end; ++i) {
+            const glm::dvec3 h = bodies.position[i] - sun;
+            const double radius = std::sqrt(h.x * h.x + h.z * h.z);
+            innerRadius = std::min(innerRadius, radius);
+            outerRadius = std::max(outerRadius, radius);
+            lowest = std::min(lowest, h.y);
+            highest = std::max(highest, h.y);
+        }
+        if (asteroids.size() == 0)
+            innerRadius = outerRadius = lowest = highest = 0.0;
+        sectorList.assign(count(), Sector{});
+        for (unsigned int r = 0; r < radialCount; r++)
+            for (unsigned int a = 0; a < angularCount; a++) {
+                Sector& sector = sectorList[r * angularCount + a];
+                sector.angleBegin = static_cast<float>(glm::two_pi<double>() * a / angularCount);
+                sector.angleEnd = static_cast<float>(glm::two_pi<double>() * (a + 1) / angularCount);
+                sector.radiusBegin = static_cast<float>(innerRadius + (outerRadius - innerRadius) * r / radialCount);
+                sector.radiusEnd = static_cast<float>(innerRadius + (outerRadius - innerRadius) * (r + 1) / radialCount);
+            }
+        // a new grid numbers the sectors differently
+        if (pinned.size() != count()) pinned.assign(count(), 0);
+        layoutAsteroids = asteroids.size();
+    }
+
+    // from p (relative to the sun) to the nearest point of the sector's box in angle, radius and height, near enough
+    // to pick a rate
+    double distanceTo(const Sector& sector, const glm::dvec3& p) const
+    {
+        double angle = std::atan2(p.z, p.x);
+        if (angle < 0.0) angle += glm::two_pi<double>();
+        if (angle < sector.angleBegin || angle > sector.angleEnd) {
+            auto apart = [&](double edge) {
+                const double d = std::abs(angle - edge);
+                return std::min(d, glm::two_pi<double>() - d);
+            };
+            angle = apart(sector.angleBegin) < apart(sector.angleEnd) ? sector.angleBegin : sector.angleEnd;
+        }
+        const double radius = std::clamp(std::sqrt(p.x * p.x + p.z * p.z), static_cast<double>(sector.radiusBegin),
+                                         static_cast<double>(sector.radiusEnd));
+        const glm::dvec3 nearest(radius * std::cos(angle), std::clamp(p.y, lowest, highest), radius * std::sin(angle));
+        return glm::length(p - nearest);
+    }
+};
+
+#endif
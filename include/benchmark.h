@@ -0,0 +1,104 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+// Every sample of one per-frame measurement over a benchmark run, summarized as mean and nearest-rank
+// percentiles: p99 is the frame 99% of frames are no slower than, which is where hitches show.
+class FrameSeries
+{
+public:
+    struct Summary
+    {
+        size_t count = 0;
+        double mean = 0.0;
+        double min = 0.0;
+        double max = 0.0;
+        double p50 = 0.0;
+        double p95 = 0.0;
+        double p99 = 0.0;
+    };
+
+    void reserve(size_t frames) { samples.reserve(frames); }
+    void push(float value) { samples.push_back(value); }
+    size_t size() const { return samples.size(); }
+    const std::vector<float>& values() const { return samples; }
+
+    Summary summary() const
+    {
+        Summary s;
+        s.count = samples.size();
+        if (samples.empty())
+            return s;
+        std::vector<float> sorted = samples;
+        std::sort(sorted.begin(), sorted.end());
+        double sum = 0.0;
+        for (float v : sorted)
+            sum += v;
+        s.mean = sum / sorted.size();
+        s.min = sorted.front();
+        s.max = sorted.back();
+        s.p50 = percentile(sorted, 0.50);
+        s.p95 = percentile(sorted, 0.95);
+        s.p99 = percentile(sorted, 0.99);
+        return s;
+    }
+
+    // {"count":..,"avg":..,"p50":..} for the JSON report
+    std::string json() const
+    {
+        const Summary s = summary();
+        char text[256];
+        std::snprintf(text, sizeof(text), "{\"count\": %zu, \"avg\": %.4f, \"min\": %.4f, \"max\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f}",
+                      s.count, s.mean, s.min, s.max, s.p50, s.p95, s.p99);
+        return text;
+    }
+
+private:
+    std::vector<float> samples;
+
+    static double percentile(const std::vector<float>& sorted, double q)
+    {
+        const size_t rank = static_cast<size_t>(std::ceil(q * sorted.size()));
+        return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+    }
+};
+
+// A benchmark's results as one JSON object: its settings as strings or numbers already formatted, then the
+// series, so runs before and after a change can be diffed or loaded side by side.
+struct BenchmarkReport
+{
+    std::vector<std::pair<std::string, std::string>> settings;     // name, JSON value
+    std::vector<std::pair<std::string, const FrameSeries*>> series;
+    std::vector<std::pair<std::string, const FrameSeries*>> gpuPasses;
+
+    void text(const std::string& name, const std::string& value) { settings.emplace_back(name, "\"" + value + "\""); }
+    void number(const std::string& name, double value) { settings.emplace_back(name, std::to_string(value)); }
+    void flag(const std::string& name, bool value) { settings.emplace_back(name, value ? "true" : "false"); }
+
+    bool write(const std::string& path) const
+    {
+        std::ofstream file(path);
+        if (!file)
+            return false;
+        file << "{\n  \"settings\": {";
+        for (size_t i = 0; i < settings.size(); i++)
+            file << (i ? ", " : "") << "\"" << settings[i].first << "\": " << settings[i].second;
+        file << "},\n";
+        for (const auto& s : series)
+            file << "  \"" << s.first << "\": " << s.second->json() << ",\n";
+        file << "  \"gpuPassMs\": {";
+        for (size_t i = 0; i < gpuPasses.size(); i++)
+            file << (i ? ",\n    " : "\n    ") << "\"" << gpuPasses[i].first << "\": " << gpuPasses[i].second->json();
+        file << "\n  }\n}\n";
+        return static_cast<bool>(file);
+    }
+};
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef BINDLESS_TEXTURES_H
+#define BINDLESS_TEXTURES_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <unordered_map>
+
+// GL_ARB_bindless_texture, loaded by hand since the bundled glad is core 4.6 without extensions. A texture's
+// 64-bit handle is made resident once and then sampled from any shader that reads it out of a buffer, so draws
+// need no glActiveTexture/glBindTexture and are not limited to the bound units. Everything here is a no-op when
+// the extension is missing, callers check available() and keep their bound-texture path.
+class BindlessTextures
+{
+public:
+    // looks for the extension and its entry points, call once after gladLoadGLLoader with the same loader
+    static bool load(GLADloadproc loader)
+    {
+        State& s = state();
+        s.available = false;
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        bool listed = false;
+        for (GLint e = 0; e < count && !listed; e++)
+        {
+            const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(e)));
+            listed = name && std::strcmp(name, "GL_ARB_bindless_texture") == 0;
+        }
+        if (!listed)
+            return false;
+        s.getTextureHandle = reinterpret_cast<GetTextureHandle>(loader("glGetTextureHandleARB"));
+        s.makeResident = reinterpret_cast<MakeHandleResident>(loader("glMakeTextureHandleResidentARB"));
+        s.makeNonResident = reinterpret_cast<MakeHandleResident>(loader("glMakeTextureHandleNonResidentARB"));
+        s.available = s.getTextureHandle && s.makeResident && s.makeNonResident;
+        return s.available;
+    }
+
+    static bool available() { return state().available; }
+
+    // the resident handle of a texture, 0 without the extension. Handles are immutable once taken, so the
+    // texture must be complete (data and sampler state) before the first call.
+    static GLuint64 residentHandle(GLuint texture)
+    {
+        State& s = state();
+        if (!s.available || texture == 0)
+            return 0;
+        auto found = s.handles.find(texture);
+        if (found != s.handles.end())
+            return found->second;
+        const GLuint64 handle = s.getTextureHandle(texture);
+        if (handle != 0)
+            s.makeResident(handle);
+        s.handles.emplace(texture, handle);
+        return handle;
+    }
+
+    // before the textures are deleted
+    static void releaseAll()
+    {
+        State& s = state();
+        for (const auto& entry : s.handles)
+            if (entry.second != 0)
+                s.makeNonResident(entry.second);
+        s.handles.clear();
+    }
+
+private:
+    typedef GLuint64 (APIENTRYP GetTextureHandle)(GLuint texture);
+    typedef void (APIENTRYP MakeHandleResident)(GLuint64 handle);
+
+    struct State
+    {
+        bool available = false;
+        GetTextureHandle getTextureHandle = nullptr;
+        MakeHandleResident makeResident = nullptr;
+        MakeHandleResident makeNonResident = nullptr;
+        std::unordered_map<GLuint, GLuint64> handles;
+    };
+
+    static State& state()
+    {
+        static State s;
+        return s;
+    }
+};
+
+#endif
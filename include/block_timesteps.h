@@ -0,0 +1,154 @@
+#ifndef BLOCK_TIMESTEPS_H
+#define BLOCK_TIMESTEPS_H
+
+#include <glm.hpp>
+
+#include <body_store.h>
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+// Hierarchical (power-of-two) block timesteps on top of a KDK leapfrog. Each body sits on a level l and advances
+// with dt / 2^l, chosen from its acceleration and jerk. A block step of dt is split into 2^maxLevel ticks: positions
+// drift for everyone at each event, but only the bodies whose own step ends on that tick ("active") get a force
+// evaluation and a kick. With most of the belt far from the sun, most ticks touch a small fraction of the bodies.
+class BlockTimestepper
+{
+public:
+    float eta = 0.02f;              // accuracy parameter, the step is eta times the body's acceleration timescale
+    unsigned int maxLevel = 8;      // deepest level, the finest step is dt / 2^maxLevel
+
+    // statistics of the last block step
+    unsigned long forceEvaluations = 0;     // active bodies summed over every event
+    unsigned int eventsLastStep = 0;
+    std::vector<unsigned int> levelHistogram;
+
+    // level and acceleration caches belong to one set of bodies, anything that replaces or edits them calls this
+    void invalidate() { haveAccelerations = false; }
+
+    // advances every body by dt. computeFor(active) must overwrite bodies.acceleration[i] for the listed (sorted)
+    // indices using the current positions of all bodies, other entries are left alone.
+    template <typename ForceFn>
+    void step(BodyStore& bodies, float dt, ForceFn&& computeFor)
+    {
+        const size_t n = bodies.size();
+        forceEvaluations = 0;
+        eventsLastStep = 0;
+        if (n == 0 || dt <= 0.0f)
+            return;
+
+        const unsigned int ticks = 1u << maxLevel;
+        const float tickDt = dt / static_cast<float>(ticks);
+
+        if (!haveAccelerations || level.size() != n)
+        {
+            level.assign(n, 0);
+            jerk.assign(n, glm::vec3(0.0f));
+            stepStart.assign(n, 0);
+            active.clear();
+            for (size_t i = 0; i < n; i++)
+                active.push_back(static_cast<unsigned int>(i));
+            computeFor(active);
+            forceEvaluations += active.size();
+            for (size_t i = 0; i < n; i++)
+                level[i] = levelFor(bodies, i, dt, false);
+            haveAccelerations = true;
+        }
+
+        // opening half kick for every body, each with its own step
+        std::fill(stepStart.begin(), stepStart.end(), 0);
+        for (size_t i = 0; i < n; i++)
+            kick(bodies, i, 0.5f * bodyDt(i, dt));
+
+        unsigned int now = 0;
+        while (now < ticks)
+        {
+            // next tick on which any body's step ends
+            unsigned int next = ticks;
+            for (size_t i = 0; i < n; i++)
+                next = std::min(next, stepStart[i] + stride(i));
+
+            const double driftDt = static_cast<double>(next - now) * tickDt;
+            const uint8_t* flags = bodies.flags.data();
+            for (size_t i = 0; i < n; i++)
+                if (!(flags[i] & BODY_FLAG_STATIC)) bodies.position[i] += bodies.velocity[i] * driftDt;
+            now = next;
+
+            active.clear();
+            for (size_t i = 0; i < n; i++)
+                if (stepStart[i] + stride(i) == now) active.push_back(static_cast<unsigned int>(i));
+
+            previousAcceleration.resize(active.size());
+            for (size_t k = 0; k < active.size(); k++)
+                previousAcceleration[k] = bodies.acceleration[active[k]];
+            computeFor(active);
+            forceEvaluations += active.size();
+            eventsLastStep++;
+
+            for (size_t k = 0; k < active.size(); k++)
+            {
+                unsigned int i = active[k];
+                float ownDt = bodyDt(i, dt);
+                jerk[i] = (bodies.acceleration[i] - previousAcceleration[k]) / ownDt;
+                // closing half kick of the step that just ended
+                kick(bodies, i, 0.5f * ownDt);
+                if (now == ticks)
+                    continue;
+                // a finer level can start anywhere, a coarser one only on a tick aligned to its step
+                unsigned int wanted = levelFor(bodies, i, dt, true);
+                while (wanted < level[i] && now % (ticks >> wanted) != 0)
+                    wanted++;
+                level[i] = wanted;
+                stepStart[i] = now;
+                kick(bodies, i, 0.5f * bodyDt(i, dt));
+            }
+        }
+
+        // everyone is synchronised again, pick next block's levels from the fresh accelerations and jerks
+        levelHistogram.assign(maxLevel + 1, 0);
+        for (size_t i = 0; i < n; i++)
+        {
+            level[i] = levelFor(bodies, i, dt, true);
+            levelHistogram[level[i]]++;
+        }
+    }
+
+private:
+    bool haveAccelerations = false;
+    std::vector<uint8_t> level;
+    std::vector<glm::vec3> jerk;
+    std::vector<unsigned int> stepStart;
+    std::vector<unsigned int> active;
+    std::vector<glm::vec3> previousAcceleration;
+
+    unsigned int stride(size_t i) const { return 1u << (maxLevel - level[i]); }
+    float bodyDt(size_t i, float dt) const { return dt / static_cast<float>(1u << level[i]); }
+
+    static void kick(BodyStore& bodies, size_t i, float dt)
+    {
+        if (!(bodies.flags[i] & BODY_FLAG_STATIC)) bodies.velocity[i] += bodies.acceleration[i] * dt;
+    }
+
+    // Aarseth-style eta * |a| / |da/dt|, before any jerk is known the orbital timescale |v| / |a| stands in for it
+    uint8_t levelFor(const BodyStore& bodies, size_t i, float dt, bool haveJerk) const
+    {
+        if (bodies.flags[i] & BODY_FLAG_STATIC)
+            return 0;
+        float a = glm::length(bodies.acceleration[i]);
+        if (a <= 0.0f)
+            return 0;
+        float j = glm::length(jerk[i]);
+        float timescale = haveJerk && j > 0.0f ? a / j : static_cast<float>(glm::length(bodies.velocity[i])) / a;
+        float wanted = eta * timescale;
+        if (!(wanted < dt))
+            return 0;
+        if (wanted <= 0.0f)
+            return static_cast<uint8_t>(maxLevel);
+        int l = static_cast<int>(std::ceil(std::log2(dt / wanted)));
+        return static_cast<uint8_t>(std::min(std::max(l, 0), static_cast<int>(maxLevel)));
+    }
+};
+
+#endif
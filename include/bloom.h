@@ -0,0 +1,101 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <shader.h>
+#include <gpu_memory.h>
+#include <frame_graph.h>
+
+#include <algorithm>
+
+// The glow around whatever is brighter than white, the sun mostly, built in compute over an R11F_G11F_B10F mip
+// chain: the HDR scene is filtered down level by level to MAX_LEVELS (shaders.2/bloom.downsample.cs, the first
+// level thresholded) and back up (shaders.2/bloom.upsample.cs), each level adding the blurred one below it.
+// Level 0, at half the scene's resolution, is what the tone mapping adds back. The chain is the caller's, a
+// transient of SceneTarget's frame graph (chainDesc()), and so is the barrier before it is read.
+class Bloom
+{
+public:
+    static const unsigned int MAX_LEVELS = 6;
+
+    float threshold = 1.0f;     // linear brightness where the bloom starts
+    float knee = 0.5f;          // how far below the threshold it fades in
+    float radius = 1.0f;        // of the upsample tent, in texels
+
+    Bloom(const char* downsamplePath, const char* upsamplePath) : downsampleShader(downsamplePath), upsampleShader(upsamplePath) {}
+
+    // levels in the last chain built
+    unsigned int levels() const { return levelCount; }
+
+    // the chain for a source of sourceWidth x sourceHeight
+    static FrameGraph::TextureDesc chainDesc(int sourceWidth, int sourceHeight)
+    {
+        FrameGraph::TextureDesc desc;
+        desc.width = std::max(sourceWidth / 2, 1);
+        desc.height = std::max(sourceHeight / 2, 1);
+        desc.levels = 1;
+        while (desc.levels < MAX_LEVELS && (std::min(desc.width, desc.height) >> desc.levels) > 0)
+            desc.levels++;
+        desc.format = GL_R11F_G11F_B10F;
+        desc.filter = GL_LINEAR_MIPMAP_NEAREST;
+        return desc;
+    }
+
+    // the chain of source, the scene's colour at sourceWidth x sourceHeight, into chainTexture of chainDesc()
+    void build(unsigned int source, int sourceWidth, int sourceHeight, unsigned int chainTexture)
+    {
+        GL_DEBUG_GROUP("bloom");
+        const FrameGraph::TextureDesc desc = chainDesc(sourceWidth, sourceHeight);
+        chain = chainTexture;
+        chainWidth = desc.width;
+        chainHeight = desc.height;
+        levelCount = desc.levels;
+        glState().activeTexture(GL_TEXTURE0);
+
+        downsampleShader.use();
+        downsampleShader.setInt("source", 0);
+        downsampleShader.setFloat("threshold", threshold);
+        downsampleShader.setFloat("knee", std::max(knee, 1e-3f));
+        for (unsigned int level = 0; level < levelCount; level++)
+        {
+            glState().bindTexture(GL_TEXTURE_2D, level == 0 ? source : chain);
+            downsampleShader.setInt("sourceLod", level == 0 ? 0 : static_cast<int>(level) - 1);
+            downsampleShader.setInt("prefilter", level == 0 ? 1 : 0);
+            dispatch(level, GL_WRITE_ONLY, levelCount > 1);
+        }
+
+        upsampleShader.use();
+        upsampleShader.setInt("source", 0);
+        upsampleShader.setFloat("radius", radius);
+        glState().bindTexture(GL_TEXTURE_2D, chain);
+        for (unsigned int level = levelCount - 1; level > 0; level--)
+        {
+            upsampleShader.setInt("sourceLod", static_cast<int>(level));
+            dispatch(level - 1, GL_READ_WRITE, level > 1);
+        }
+        glState().bindTexture(GL_TEXTURE_2D, 0);
+    }
+
+private:
+    Shader downsampleShader;
+    Shader upsampleShader;
+    unsigned int chain = 0;
+    int chainWidth = 0;
+    int chainHeight = 0;
+    unsigned int levelCount = 0;
+
+    // one level written from the bound source, and a barrier so the next level reads it; the last level's is
+    // the frame graph's
+    void dispatch(unsigned int level, GLenum access, bool barrier)
+    {
+        glBindImageTexture(0, chain, static_cast<GLint>(level), GL_FALSE, 0, access, GL_R11F_G11F_B10F);
+        const glm::ivec2 size = glm::max(glm::ivec2(chainWidth, chainHeight) >> static_cast<int>(level), glm::ivec2(1));
+        glDispatchCompute((size.x + 7) / 8, (size.y + 7) / 8, 1);
+        if (barrier)
+            glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+};
+
+#endif
@@ -0,0 +1,166 @@
+#ifndef BODY_MEMORY_H
+#define BODY_MEMORY_H
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <thread_pool.h>
+
+#include <vector>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Where the body store's hot arrays get their memory (POSIX). Blocks of at least MIN_MAPPED_BYTES are mapped with
+// their own mmap, optionally backed by huge pages, so the force loop's sweep over gigabytes of positions takes a TLB
+// entry per 2 MB or 1 GB instead of per 4 KB:
+//   BODY_PAGES_2M   transparent huge pages, madvise(MADV_HUGEPAGE) on a 2 MB aligned mapping; needs THP set to
+//                   madvise or always, nothing reserved
+//   BODY_PAGES_1G   hugetlbfs pages (MAP_HUGETLB with MAP_HUGE_1GB), which have to be reserved at boot; without
+//                   them the block falls back to 2 MB
+// With firstTouch a new block's pages are written once by the worker pool, each slice of the pool touching the
+// part of the block that the same slice of a parallelFor over the elements will own, so on a NUMA machine every
+// page lands on the node of the worker that reads it (see ThreadPool::pin). It has to happen at allocation, the
+// kernel places a page at its first write and the store then fills the arrays from one thread. Smaller blocks come
+// from operator new as before.
+enum BodyPages {
+    BODY_PAGES_DEFAULT = 0,
+    BODY_PAGES_2M = 1,
+    BODY_PAGES_1G = 2
+};
+
+struct BodyMemoryOptions
+{
+    BodyPages pages = BODY_PAGES_DEFAULT;
+    bool firstTouch = false;
+    unsigned int threads = 0;       // the slices the force loop splits the bodies into, 0 for the whole pool
+};
+
+inline BodyMemoryOptions& bodyMemory()
+{
+    static BodyMemoryOptions options;
+    return options;
+}
+
+namespace body_memory_detail {
+
+const size_t MIN_MAPPED_BYTES = size_t(1) << 20;
+const size_t HUGE_2M = size_t(2) << 20;
+const size_t HUGE_1G = size_t(1) << 30;
+// in front of every mapped block, its mapping's extent; keeps the elements 64-byte aligned
+const size_t HEADER_BYTES = 64;
+
+struct Header
+{
+    void* base;
+    size_t length;
+};
+
+inline size_t roundUp(size_t bytes, size_t to) { return (bytes + to - 1) / to * to; }
+
+inline void* mapAnonymous(size_t length, int extraFlags)
+{
+    void* p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | extraFlags, -1, 0);
+    return p == MAP_FAILED ? nullptr : p;
+}
+
+// a mapping of at least bytes in the configured pages, its base and length in header
+inline bool mapBlock(size_t bytes, Header& header)
+{
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+    if (bodyMemory().pages == BODY_PAGES_1G)
+    {
+        header.length = roundUp(bytes, HUGE_1G);
+        header.base = mapAnonymous(header.length, MAP_HUGETLB | (30 << MAP_HUGE_SHIFT));
+        if (header.base)
+            return true;
+    }
+#endif
+    if (bodyMemory().pages == BODY_PAGES_DEFAULT)
+    {
+        header.length = roundUp(bytes, static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+        header.base = mapAnonymous(header.length, 0);
+        return header.base != nullptr;
+    }
+    // a 2 MB more, then the unaligned ends cut off, so every huge page of the block is whole
+    header.length = roundUp(bytes, HUGE_2M);
+    unsigned char* raw = static_cast<unsigned char*>(mapAnonymous(header.length + HUGE_2M, 0));
+    if (!raw)
+        return false;
+    unsigned char* aligned = reinterpret_cast<unsigned char*>(roundUp(reinterpret_cast<uintptr_t>(raw), HUGE_2M));
+    if (aligned > raw)
+        munmap(raw, static_cast<size_t>(aligned - raw));
+    const size_t tail = static_cast<size_t>(raw + header.length + HUGE_2M - (aligned + header.length));
+    if (tail > 0)
+        munmap(aligned + header.length, tail);
+    header.base = aligned;
+#ifdef MADV_HUGEPAGE
+    madvise(aligned, header.length, MADV_HUGEPAGE);
+#endif
+    return true;
+}
+
+// the first write to every page of count elements of size bytes at data, by the slice that owns them
+inline void touch(unsigned char* data, size_t count, size_t size)
+{
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    workerPool().parallelFor(0, count, [&](size_t begin, size_t end, unsigned int) {
+        unsigned char* first = data + begin * size;
+        unsigned char* last = data + end * size;
+        for (unsigned char* p = first; p < last; p = reinterpret_cast<unsigned char*>(roundUp(reinterpret_cast<uintptr_t>(p) + 1, page)))
+            *p = 0;
+    }, bodyMemory().threads);
+}
+
+}
+
+// std::vector's allocator for the body arrays, stateless: bodyMemory() at the time of each allocation decides
+template <typename T>
+struct BodyAllocator
+{
+    typedef T value_type;
+
+    BodyAllocator() = default;
+    template <typename U>
+    BodyAllocator(const BodyAllocator<U>&) {}
+
+    T* allocate(size_t n)
+    {
+        using namespace body_memory_detail;
+        const size_t bytes = n * sizeof(T);
+        if (bytes < MIN_MAPPED_BYTES)
+            return static_cast<T*>(::operator new(bytes));
+        Header header;
+        if (!mapBlock(bytes + HEADER_BYTES, header))
+            throw std::bad_alloc();
+        unsigned char* data = static_cast<unsigned char*>(header.base) + HEADER_BYTES;
+        std::memcpy(static_cast<unsigned char*>(header.base), &header, sizeof(header));
+        if (bodyMemory().firstTouch)
+            touch(data, n, sizeof(T));
+        return reinterpret_cast<T*>(data);
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        using namespace body_memory_detail;
+        if (n * sizeof(T) < MIN_MAPPED_BYTES)
+        {
+            ::operator delete(p);
+            return;
+        }
+        Header header;
+        std::memcpy(&header, reinterpret_cast<unsigned char*>(p) - HEADER_BYTES, sizeof(header));
+        munmap(header.base, header.length);
+    }
+
+    template <typename U>
+    bool operator==(const BodyAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const BodyAllocator<U>&) const { return false; }
+};
+
+template <typename T>
+using BodyArray = std::vector<T, BodyAllocator<T>>;
+
+#endif
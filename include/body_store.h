@@ -0,0 +1,367 @@
+#ifndef BODY_STORE_H
+#define BODY_STORE_H
+
+#include <glm.hpp>
+#include <gtc/matrix_transform.hpp>
+#include <gtc/quaternion.hpp>
+
+#include <batch_transforms.h>
+#include <body_memory.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+#include <type_traits>
+#include <algorithm>
+
+class Model;
+class Mesh;
+
+// body categories, bodies of one type are always stored as one dense range in this order
+enum BodyType {
+    BODY_SUN = 0,
+    BODY_PLANET = 1,
+    BODY_ASTEROID = 2,
+    BODY_TYPE_COUNT = 3
+};
+
+enum BodyFlags : uint8_t {
+    BODY_FLAG_STATIC = 1 << 0
+};
+
+// render-only data, never touched by the force or integration loops
+struct BodyRenderData {
+    glm::quat orientation;
+    float radiusScale;
+    Model* modelPtr;
+    Mesh* meshPtr;
+    glm::vec4 spin = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);    // body-frame axis xyz, w radians per sim second
+};
+
+// every tumble rate is a whole number of turns per this many sim seconds, so the shader can take the time modulo it
+constexpr double TUMBLE_PERIOD = 1024.0;
+
+// a tumble picked from the stable id, so snapshots and replays get the same spin back without storing it
+inline glm::vec4 tumbleFor(uint32_t bodyId)
+{
+    auto next = [](uint32_t& h) {
+        h ^= h >> 16; h *= 0x7feb352du; h ^= h >> 15; h *= 0x846ca68bu; h ^= h >> 16;
+        return static_cast<float>(h >> 8) * (1.0f / 16777216.0f);
+    };
+    uint32_t h = bodyId * 0x9e3779b9u + 0x632be5abu;
+    // uniform direction from a random z and azimuth
+    const float z = 2.0f * next(h) - 1.0f;
+    const float phi = 6.2831853f * next(h);
+    const float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+    // roughly 0.2 to 1.5 radians per sim second, and few enough turns to fit the quantized instance's byte
+    const float turns = std::floor(32.0f + 223.0f * next(h));
+    const float rate = turns * static_cast<float>(6.283185307179586 / TUMBLE_PERIOD);
+    return glm::vec4(r * std::cos(phi), r * std::sin(phi), z, rate);
+}
+
+struct BodyRange {
+    size_t begin;
+    size_t end;
+    size_t size() const { return end - begin; }
+};
+
+// reorders v[begin, begin + order.size()) so slot k holds what was at begin + order[k]
+template <typename T, typename A>
+void applyOrder(std::vector<T, A>& v, size_t begin, const std::vector<uint32_t>& order, std::vector<unsigned char>& scratch)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "bodies are moved with memcpy");
+    const size_t n = order.size();
+    if (n == 0 || begin + n > v.size())
+        return;
+    scratch.resize(n * sizeof(T));
+    T* out = reinterpret_cast<T*>(scratch.data());
+    for (size_t k = 0; k < n; k++)
+        std::memcpy(&out[k], &v[begin + order[k]], sizeof(T));
+    std::memcpy(&v[begin], out, n * sizeof(T));
+}
+
+// removes the elements at the sorted, unique indices and closes the gaps, keeping the order of the rest
+template <typename T, typename A>
+void eraseIndices(std::vector<T, A>& v, const std::vector<uint32_t>& sortedIndices)
+{
+    if (sortedIndices.empty())
+        return;
+    size_t out = sortedIndices[0], next = 0;
+    for (size_t k = sortedIndices[0]; k < v.size(); k++)
+    {
+        if (next < sortedIndices.size() && sortedIndices[next] == k)
+        {
+            next++;
+            continue;
+        }
+        v[out++] = v[k];
+    }
+    v.resize(out);
+}
+
+// grows v to newStart[BODY_TYPE_COUNT] and moves each type's range from oldStart up to newStart, leaving the gap at
+// the end of each range for new bodies. Ranges only ever move up, so the last one goes first.
+template <typename T, typename A>
+void spreadRanges(std::vector<T, A>& v, const size_t* oldStart, const size_t* newStart)
+{
+    v.resize(newStart[BODY_TYPE_COUNT]);
+    for (int t = BODY_TYPE_COUNT - 1; t >= 0; t--)
+        if (newStart[t] != oldStart[t])
+            std::move_backward(v.begin() + oldStart[t], v.begin() + oldStart[t + 1],
+                               v.begin() + newStart[t] + (oldStart[t + 1] - oldStart[t]));
+}
+
+// Structure-of-arrays body storage. The hot fields (position, velocity, acceleration, mass, flags) each live in
+// their own contiguous array so the physics kernels stream only what they read, the render data sits in a cold array.
+// Position and velocity are double precision so large systems keep their resolution far from the origin, forces are
+// summed in float from positions relative to a nearby origin and rendering converts relative to the camera.
+// The hot arrays take their memory from BodyAllocator, huge pages and first touch by the workers if asked
+// (body_memory.h).
+class BodyStore
+{
+public:
+    BodyArray<glm::dvec3> position;
+    BodyArray<glm::dvec3> velocity;
+    BodyArray<glm::vec3> acceleration;
+    BodyArray<float> mass;
+    std::vector<uint8_t> flags;
+    std::vector<BodyRenderData> render;
+    std::vector<uint32_t> id;               // stable across reordering, use it for anything that must follow a body
+
+    static constexpr uint32_t INVALID_INDEX = 0xffffffffu;
+
+    size_t size() const { return position.size(); }
+    bool empty() const { return position.empty(); }
+
+    void clear()
+    {
+        position.clear(); velocity.clear(); acceleration.clear();
+        mass.clear(); flags.clear(); render.clear();
+        id.clear(); slotOfId.clear();
+        nextId = 0;
+        for (unsigned int t = 0; t <= BODY_TYPE_COUNT; t++)
+            typeStart[t] = 0;
+    }
+
+    void reserve(size_t count)
+    {
+        position.reserve(count); velocity.reserve(count); acceleration.reserve(count);
+        mass.reserve(count); flags.reserve(count); render.reserve(count);
+        id.reserve(count);
+    }
+
+    // adds a body at the end of its type's range and returns its index. Appending the last type is O(1),
+    // adding to an earlier type shifts the later ranges up by one.
+    size_t add(BodyType type, glm::dvec3 pos, glm::dvec3 vel, float m, float rScale,
+               Model* mod = nullptr, Mesh* mesh = nullptr,
+               glm::quat orient = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), bool isStatic = false)
+    {
+        size_t index = typeStart[type + 1];
+        position.insert(position.begin() + index, pos);
+        velocity.insert(velocity.begin() + index, vel);
+        acceleration.insert(acceleration.begin() + index, glm::vec3(0.0f));
+        mass.insert(mass.begin() + index, m);
+        flags.insert(flags.begin() + index, isStatic ? BODY_FLAG_STATIC : 0);
+        render.insert(render.begin() + index, BodyRenderData{orient, rScale, mod, mesh});
+        id.insert(id.begin() + index, nextId);
+        slotOfId.push_back(0);
+        nextId++;
+        for (size_t k = index; k < id.size(); k++)
+            slotOfId[id[k]] = static_cast<uint32_t>(k);
+        for (unsigned int t = type + 1; t <= BODY_TYPE_COUNT; t++)
+            typeStart[t]++;
+        return index;
+    }
+
+    // adds count bodies in one pass, each at the end of its type's range in the order given, and writes their ids to
+    // ids if not null. Costs O(size + count) however the types are mixed, where add() would shift the later ranges per
+    // body. rScale may be null for 1. Types past BODY_ASTEROID are the caller's to reject.
+    void addBatch(size_t count, const uint8_t* types, const glm::dvec3* pos, const glm::dvec3* vel, const float* m,
+                  const float* rScale, uint32_t* ids = nullptr)
+    {
+        if (count == 0)
+            return;
+        size_t added[BODY_TYPE_COUNT] = {0, 0, 0};
+        for (size_t k = 0; k < count; k++)
+            added[types[k]]++;
+        size_t oldStart[BODY_TYPE_COUNT + 1];
+        std::copy(typeStart, typeStart + BODY_TYPE_COUNT + 1, oldStart);
+        for (unsigned int t = 0; t < BODY_TYPE_COUNT; t++)
+            typeStart[t + 1] = typeStart[t] + (oldStart[t + 1] - oldStart[t]) + added[t];
+        spreadRanges(position, oldStart, typeStart);
+        spreadRanges(velocity, oldStart, typeStart);
+        spreadRanges(acceleration, oldStart, typeStart);
+        spreadRanges(mass, oldStart, typeStart);
+        spreadRanges(flags, oldStart, typeStart);
+        spreadRanges(render, oldStart, typeStart);
+        spreadRanges(id, oldStart, typeStart);
+
+        size_t next[BODY_TYPE_COUNT];
+        for (unsigned int t = 0; t < BODY_TYPE_COUNT; t++)
+            next[t] = typeStart[t] + (oldStart[t + 1] - oldStart[t]);
+        for (size_t k = 0; k < count; k++)
+        {
+            const size_t slot = next[types[k]]++;
+            position[slot] = pos[k];
+            velocity[slot] = vel[k];
+            acceleration[slot] = glm::vec3(0.0f);
+            mass[slot] = m[k];
+            flags[slot] = 0;
+            render[slot] = BodyRenderData{glm::quat(1.0f, 0.0f, 0.0f, 0.0f), rScale ? rScale[k] : 1.0f, nullptr, nullptr};
+            id[slot] = nextId;
+            if (ids) ids[k] = nextId;
+            nextId++;
+        }
+        slotOfId.resize(nextId, INVALID_INDEX);
+        unsigned int first = 0;
+        while (added[first] == 0) first++;
+        for (size_t k = oldStart[first + 1]; k < id.size(); k++)
+            slotOfId[id[k]] = static_cast<uint32_t>(k);
+    }
+
+    // makes room for count bodies at the end of a type's range and returns the index of the first. They get fresh
+    // ids and zero state for the caller to fill in, from as many threads as it likes.
+    size_t extend(BodyType type, size_t count)
+    {
+        const size_t first = typeStart[type + 1];
+        if (count == 0)
+            return first;
+        size_t oldStart[BODY_TYPE_COUNT + 1];
+        std::copy(typeStart, typeStart + BODY_TYPE_COUNT + 1, oldStart);
+        for (unsigned int t = type + 1; t <= BODY_TYPE_COUNT; t++)
+            typeStart[t] += count;
+        spreadRanges(position, oldStart, typeStart);
+        spreadRanges(velocity, oldStart, typeStart);
+        spreadRanges(acceleration, oldStart, typeStart);
+        spreadRanges(mass, oldStart, typeStart);
+        spreadRanges(flags, oldStart, typeStart);
+        spreadRanges(render, oldStart, typeStart);
+        spreadRanges(id, oldStart, typeStart);
+        for (size_t k = first; k < first + count; k++)
+        {
+            position[k] = velocity[k] = glm::dvec3(0.0);
+            acceleration[k] = glm::vec3(0.0f);
+            mass[k] = 0.0f;
+            flags[k] = 0;
+            render[k] = BodyRenderData{glm::quat(1.0f, 0.0f, 0.0f, 0.0f), 1.0f, nullptr, nullptr};
+            id[k] = nextId++;
+        }
+        slotOfId.resize(nextId, INVALID_INDEX);
+        for (size_t k = first; k < id.size(); k++)
+            slotOfId[id[k]] = static_cast<uint32_t>(k);
+        return first;
+    }
+
+    // drops the bodies past the first newCount of a type, the earlier bodies keep their indices and state
+    void truncate(BodyType type, size_t newCount)
+    {
+        size_t first = typeStart[type] + newCount, end = typeStart[type + 1];
+        if (first >= end)
+            return;
+        position.erase(position.begin() + first, position.begin() + end);
+        velocity.erase(velocity.begin() + first, velocity.begin() + end);
+        acceleration.erase(acceleration.begin() + first, acceleration.begin() + end);
+        mass.erase(mass.begin() + first, mass.begin() + end);
+        flags.erase(flags.begin() + first, flags.begin() + end);
+        render.erase(render.begin() + first, render.begin() + end);
+        for (size_t k = first; k < end; k++)
+            slotOfId[id[k]] = INVALID_INDEX;
+        id.erase(id.begin() + first, id.begin() + end);
+        for (size_t k = first; k < id.size(); k++)
+            slotOfId[id[k]] = static_cast<uint32_t>(k);
+        for (unsigned int t = type + 1; t <= BODY_TYPE_COUNT; t++)
+            typeStart[t] -= end - first;
+    }
+
+    // removes the bodies at the sorted, unique indices in one compaction pass. The others keep their order and ids,
+    // their indices shift down past each removed body.
+    void remove(const std::vector<uint32_t>& sortedIndices)
+    {
+        if (sortedIndices.empty())
+            return;
+        size_t removed[BODY_TYPE_COUNT] = {0, 0, 0};
+        for (uint32_t k : sortedIndices)
+        {
+            slotOfId[id[k]] = INVALID_INDEX;
+            removed[typeOf(k)]++;
+        }
+        for (unsigned int t = 0; t < BODY_TYPE_COUNT; t++)
+            for (unsigned int later = t + 1; later <= BODY_TYPE_COUNT; later++)
+                typeStart[later] -= removed[t];
+        eraseIndices(position, sortedIndices);
+        eraseIndices(velocity, sortedIndices);
+        eraseIndices(acceleration, sortedIndices);
+        eraseIndices(mass, sortedIndices);
+        eraseIndices(flags, sortedIndices);
+        eraseIndices(render, sortedIndices);
+        eraseIndices(id, sortedIndices);
+        for (size_t k = sortedIndices[0]; k < id.size(); k++)
+            slotOfId[id[k]] = static_cast<uint32_t>(k);
+    }
+
+    // permutes the bodies of one type, slot k of the range receives the body that was at range.begin + order[k]
+    void reorder(BodyType type, const std::vector<uint32_t>& order)
+    {
+        const size_t begin = typeStart[type];
+        if (order.size() != count(type))
+            return;
+        applyOrder(position, begin, order, scratch);
+        applyOrder(velocity, begin, order, scratch);
+        applyOrder(acceleration, begin, order, scratch);
+        applyOrder(mass, begin, order, scratch);
+        applyOrder(flags, begin, order, scratch);
+        applyOrder(render, begin, order, scratch);
+        applyOrder(id, begin, order, scratch);
+        for (size_t k = begin; k < begin + order.size(); k++)
+            slotOfId[id[k]] = static_cast<uint32_t>(k);
+    }
+
+    // sets the type ranges and ids for typeCounts bodies per type, used to restore a saved state. The caller then
+    // assigns every per-body array to the new size directly, which skips a zero-fill of each.
+    void assignLayout(const size_t typeCounts[BODY_TYPE_COUNT], const uint32_t* ids)
+    {
+        typeStart[0] = 0;
+        for (unsigned int t = 0; t < BODY_TYPE_COUNT; t++)
+            typeStart[t + 1] = typeStart[t] + typeCounts[t];
+        const size_t n = typeStart[BODY_TYPE_COUNT];
+        id.assign(ids, ids + n);
+        nextId = 0;
+        for (size_t k = 0; k < n; k++)
+            nextId = std::max(nextId, id[k] + 1);
+        slotOfId.assign(nextId, INVALID_INDEX);
+        for (size_t k = 0; k < n; k++)
+            slotOfId[id[k]] = static_cast<uint32_t>(k);
+    }
+
+    // current index of a body id, INVALID_INDEX once the body was removed
+    uint32_t indexOf(uint32_t bodyId) const { return bodyId < slotOfId.size() ? slotOfId[bodyId] : INVALID_INDEX; }
+
+    BodyRange range(BodyType type) const { return BodyRange{typeStart[type], typeStart[type + 1]}; }
+    size_t count(BodyType type) const { return typeStart[type + 1] - typeStart[type]; }
+    BodyType typeOf(size_t i) const
+    {
+        unsigned int t = 0;
+        while (i >= typeStart[t + 1]) t++;
+        return static_cast<BodyType>(t);
+    }
+    bool isStatic(size_t i) const { return (flags[i] & BODY_FLAG_STATIC) != 0; }
+
+    // render data is assembled on demand instead of being cached per body. at is the float position to draw at,
+    // relative to the camera in the viewer
+    glm::mat4 modelMatrix(size_t i, const glm::vec3& at) const
+    {
+        const BodyRenderData& r = render[i];
+        return composeTransform(at, r.orientation, r.radiusScale);
+    }
+
+private:
+    // typeStart[t] is the first index of type t, typeStart[BODY_TYPE_COUNT] is the total count
+    size_t typeStart[BODY_TYPE_COUNT + 1] = {0, 0, 0, 0};
+    std::vector<uint32_t> slotOfId;
+    uint32_t nextId = 0;
+    std::vector<unsigned char> scratch;
+};
+
+#endif
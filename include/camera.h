@@ -5,6 +5,8 @@
 #include <glm.hpp>
 #include <gtc/matrix_transform.hpp>
 
+#include <algorithm>
+
 // Defines several possible options for camera movement. Used as abstraction to stay away from window-system specific input methods
 enum Camera_Movement {
     FORWARD,
@@ -27,8 +29,8 @@ const float ZOOM        =  45.0f;
 class Camera
 {
 public:
-    // camera Attributes
-    glm::vec3 Position;
+    // camera Attributes, the position is double so the camera can sit far from the origin without jitter
+    glm::dvec3 Position;
     glm::vec3 Front;
     glm::vec3 Up;
     glm::vec3 Right;
@@ -63,7 +65,14 @@ public:
     // returns the view matrix calculated using Euler Angles and the LookAt Matrix
     glm::mat4 GetViewMatrix()
     {
-        return glm::lookAt(Position, Position + Front, Up);
+        glm::vec3 position(Position);
+        return glm::lookAt(position, position + Front, Up);
+    }
+
+    // view matrix for geometry already placed relative to the camera, i.e. just the rotation
+    glm::mat4 GetCameraRelativeViewMatrix()
+    {
+        return glm::lookAt(glm::vec3(0.0f), Front, Up);
     }
 
     // processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
@@ -106,6 +115,14 @@ public:
         updateCameraVectors();
     }
 
+    // points the camera along the given Euler angles, in degrees
+    void SetOrientation(float yaw, float pitch)
+    {
+        Yaw = yaw;
+        Pitch = std::max(std::min(pitch, 89.0f), -89.0f);
+        updateCameraVectors();
+    }
+
     // processes input received from a mouse scroll-wheel event. Only requires input on the vertical wheel-axis
     void ProcessMouseScroll(float yoffset)
     {
@@ -0,0 +1,150 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include <glm.hpp>
+#include <gtc/constants.hpp>
+
+#include <camera.h>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+
+// A camera flight through keyframes of position and look-at target, interpolated with a Catmull-Rom spline so
+// the camera passes through every key without corners. Keys are saved one per line as
+// "time px py pz tx ty tz", which is what the viewer records and the benchmark plays back.
+class CameraPath
+{
+public:
+    struct Key
+    {
+        double time;
+        glm::dvec3 position;
+        glm::dvec3 target;
+    };
+
+    struct Pose
+    {
+        glm::dvec3 position;
+        glm::dvec3 target;
+    };
+
+    // keys must come in increasing time
+    void add(double time, const glm::dvec3& position, const glm::dvec3& target)
+    {
+        keys.push_back(Key{time, position, target});
+    }
+
+    bool empty() const { return keys.empty(); }
+    size_t size() const { return keys.size(); }
+    double duration() const { return keys.empty() ? 0.0 : keys.back().time - keys.front().time; }
+    double startTime() const { return keys.empty() ? 0.0 : keys.front().time; }
+    double endTime() const { return keys.empty() ? 0.0 : keys.back().time; }
+
+    // the pose at time t, held at the first and last key outside them
+    Pose sample(double t) const
+    {
+        if (keys.empty())
+            return Pose{glm::dvec3(0.0), glm::dvec3(0.0, 0.0, -1.0)};
+        if (keys.size() == 1 || t <= keys.front().time)
+            return Pose{keys.front().position, keys.front().target};
+        if (t >= keys.back().time)
+            return Pose{keys.back().position, keys.back().target};
+        size_t i = static_cast<size_t>(std::upper_bound(keys.begin(), keys.end(), t,
+                                                        [](double value, const Key& key) { return value < key.time; }) - keys.begin()) - 1;
+        const Key& k1 = keys[i];
+        const Key& k2 = keys[i + 1];
+        const Key& k0 = keys[i > 0 ? i - 1 : i];
+        const Key& k3 = keys[std::min(i + 2, keys.size() - 1)];
+        const double u = (t - k1.time) / std::max(k2.time - k1.time, 1e-9);
+        return Pose{catmullRom(k0.position, k1.position, k2.position, k3.position, u),
+                    catmullRom(k0.target, k1.target, k2.target, k3.target, u)};
+    }
+
+    // points the camera along the pose
+    static void apply(const Pose& pose, Camera& camera)
+    {
+        camera.Position = pose.position;
+        const glm::dvec3 direction = pose.target - pose.position;
+        const double length = glm::length(direction);
+        if (length <= 0.0)
+            return;
+        const glm::dvec3 d = direction / length;
+        camera.SetOrientation(static_cast<float>(glm::degrees(std::atan2(d.z, d.x))),
+                              static_cast<float>(glm::degrees(std::asin(std::clamp(d.y, -1.0, 1.0)))));
+    }
+
+    bool load(const std::string& path)
+    {
+        std::ifstream file(path);
+        if (!file)
+            return false;
+        std::vector<Key> loaded;
+        std::string line;
+        while (std::getline(file, line))
+        {
+            if (line.empty() || line[0] == '#')
+                continue;
+            std::istringstream stream(line);
+            Key key;
+            if (!(stream >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.target.x >> key.target.y >> key.target.z))
+                return false;
+            if (!loaded.empty() && key.time <= loaded.back().time)
+                return false;
+            loaded.push_back(key);
+        }
+        keys.swap(loaded);
+        return true;
+    }
+
+    bool save(const std::string& path) const
+    {
+        std::ofstream file(path);
+        if (!file)
+            return false;
+        file.precision(17);
+        file << "# time position.xyz target.xyz\n";
+        for (const Key& key : keys)
+            file << key.time << ' ' << key.position.x << ' ' << key.position.y << ' ' << key.position.z << ' '
+                 << key.target.x << ' ' << key.target.y << ' ' << key.target.z << '\n';
+        return static_cast<bool>(file);
+    }
+
+    // Once around the belt between its radii, bobbing through its thickness and looking ahead along the orbit,
+    // then up over it looking down at the sun and out across the whole belt, secondsPerKey apart.
+    static CameraPath beltFlythrough(double innerRadius, double outerRadius, double height, double secondsPerKey = 1.5)
+    {
+        CameraPath path;
+        const int around = 16;
+        const double radius = 0.5 * (innerRadius + outerRadius);
+        double time = 0.0;
+        for (int k = 0; k <= around; k++)
+        {
+            const double angle = glm::two_pi<double>() * k / around;
+            const double ahead = angle + 0.35;
+            const double y = height * 0.6 * std::sin(angle * 3.0);
+            path.add(time, glm::dvec3(radius * std::cos(angle), y, radius * std::sin(angle)),
+                     glm::dvec3(radius * 0.95 * std::cos(ahead), 0.0, radius * 0.95 * std::sin(ahead)));
+            time += secondsPerKey;
+        }
+        path.add(time, glm::dvec3(outerRadius * 1.2, outerRadius * 0.5, 0.0), glm::dvec3(0.0));
+        time += secondsPerKey * 2.0;
+        path.add(time, glm::dvec3(0.0, outerRadius * 1.6, outerRadius * 0.4), glm::dvec3(0.0));
+        return path;
+    }
+
+private:
+    std::vector<Key> keys;
+
+    static glm::dvec3 catmullRom(const glm::dvec3& p0, const glm::dvec3& p1, const glm::dvec3& p2, const glm::dvec3& p3, double u)
+    {
+        const double u2 = u * u;
+        const double u3 = u2 * u;
+        return 0.5 * ((2.0 * p1) + (p2 - p0) * u + (2.0 * p0 - 5.0 * p1 + 4.0 * p2 - p3) * u2 + (3.0 * p1 - p0 - 3.0 * p2 + p3) * u3);
+    }
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef CAMERA_UNIFORMS_H
+#define CAMERA_UNIFORMS_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <uniform_ring.h>
+
+// The Matrices block (projection, then view, then each eye's projection and view) out of a UniformRing of its own,
+// RECORDS slots a frame, so the camera can be rewritten within a frame, for the reflection probe's faces or to
+// latch it late, without glBufferSubData and without touching what earlier draws of the frame still read. write
+// puts the matrices into the next slot and binds it. The eyes are read only by instanced stereo draws
+// (shaders.2/stereo.glsl, include/stereo_camera.h); a mono write gives both eyes the camera itself. The block's
+// first two matrices are all most shaders declare.
+class CameraUniforms
+{
+public:
+    static const unsigned int RECORDS = 32;     // writes per frame before one has to wait for the GPU, stereo writes each eye's for every pass
+
+    explicit CameraUniforms(unsigned int binding = 0) : binding(binding) {}
+    CameraUniforms(const CameraUniforms&) = delete;
+    CameraUniforms& operator=(const CameraUniforms&) = delete;
+
+    void create(const char* label = "Matrices block")
+    {
+        ring.create(RECORDS * SLOT_BYTES, label);
+    }
+
+    // once per frame before its first write
+    void beginFrame()
+    {
+        ring.beginFrame();
+    }
+
+    // the camera every later draw reads until the next write
+    void write(const glm::mat4& projection, const glm::mat4& view)
+    {
+        const glm::mat4 eyeProjection[2] = { projection, projection };
+        const glm::mat4 eyeView[2] = { view, view };
+        write(projection, view, eyeProjection, eyeView);
+    }
+
+    // the same with two eyes, the left one first
+    void write(const glm::mat4& projection, const glm::mat4& view, const glm::mat4 eyeProjection[2], const glm::mat4 eyeView[2])
+    {
+        UniformRing::Slice slice = ring.allocate(BLOCK_BYTES);
+        if (!slice.data)
+            return;
+        glm::mat4* block = static_cast<glm::mat4*>(slice.data);
+        block[0] = projection;
+        block[1] = view;
+        for (int eye = 0; eye < 2; eye++)
+        {
+            block[2 + eye] = eyeProjection[eye];
+            block[4 + eye] = eyeView[eye];
+        }
+        ring.bind(binding, slice);
+    }
+
+    unsigned int writesLastFrame() const { return ring.slicesLastFrame(); }
+    bool valid() const { return ring.valid(); }
+
+    void release()
+    {
+        ring.release();
+    }
+
+private:
+    static const size_t BLOCK_BYTES = 6 * sizeof(glm::mat4);
+    static const size_t SLOT_BYTES = 512;       // a block rounded up to 256, the largest UBO offset alignment there is
+
+    UniformRing ring;
+    unsigned int binding;
+};
+
+#endif
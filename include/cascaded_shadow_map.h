@@ -0,0 +1,499 @@
+#ifndef CASCADED_SHADOW_MAP_H
+#define CASCADED_SHADOW_MAP_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+#include <gtc/matrix_transform.hpp>
+
+#include <shader.h>
+#include <gpu_memory.h>
+#include <moment_shadows.h>
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+// Cascaded shadow maps for a directional light: the view frustum is split in depth (a blend of uniform and
+// logarithmic splits) and each slice gets its own orthographic depth map, one layer of a texture array, so near
+// shadows get as many texels as far ones. A cascade bounds its slice with a sphere and snaps its origin to whole
+// texels, so its texels stay put while the camera turns or moves and shadow edges do not shimmer.
+//
+// The cascades are cached: each keeps the matrix it was last fitted with and is fitted again only every farRefresh
+// frames, when the camera strays out of the margin its sphere was padded with, when the light turns, or, the first
+// one, which has no margin, as soon as its snapped matrix changes. Between fits the static casters stay in a cached
+// copy of each layer, drawn again only in the TILES x TILES tiles a moved static caster reported through
+// invalidate() reaches. The casters that move every frame are reported through addDynamicCaster() and composited
+// instead: the tiles they cover now or covered last frame are copied back from the cache and only the dynamic casters
+// drawn over them. Usage per frame: update() and addDynamicCaster(), then for every cascade with needsRender(i)
+// draw the static casters with lightMatrix(i) for each beginStatic(i, r) that returns true, then the dynamic ones
+// if composite(i) does, then end(); the receivers compare in the shader against the matrices setUniforms() uploads.
+// Filtered, each cascade's casters also write their depth moments into a second array that end() blurs for the
+// cascades just composited (moment_shadows.h), and the receivers take one bilinear sample of it in place of a 3x3
+// block of comparisons; the blur reaches past any tile, so a filtered layer is composited whole.
+class CascadedShadowMap
+{
+public:
+    static const unsigned int MAX_CASCADES = 4;     // MAX_CASCADES of csm.shadow_mapping.fs
+    static const unsigned int TILES = 8;            // a side of a layer's invalidation grid
+    static const unsigned int MAX_REGIONS = 4;      // scissor rectangles a layer's tiles are drawn in, else their bounds
+
+    // without blurPath (shaders.2/shadow.blur.cs) the cascades cannot be filtered
+    explicit CascadedShadowMap(unsigned int resolution = 2048, unsigned int cascades = MAX_CASCADES, const char* blurPath = nullptr)
+        : size(resolution), count(std::min(std::max(cascades, 1u), MAX_CASCADES))
+    {
+        if (blurPath)
+            blur = new MomentBlur(blurPath, false);
+    }
+
+    ~CascadedShadowMap()
+    {
+        release();
+        delete blur;
+    }
+
+    unsigned int cascadeCount() const { return count; }
+    unsigned int resolution() const { return size; }
+
+    // how often the cascades past the first are fitted again at least, 1 every frame, 0 only when they must
+    void setFarRefresh(unsigned int frames) { farRefresh = frames; }
+    // 0 uniform splits, 1 logarithmic
+    void setSplitLambda(float lambda) { splitLambda = lambda; }
+    // how far behind a cascade's slice, toward the light, casters are still drawn
+    void setCasterDistance(float distance) { casterDistance = distance; }
+    // moments blurred over radius texels either side instead of depths compared, every cascade rendered again
+    void setFiltered(bool on)
+    {
+        on = on && blur;
+        if (on != filtered)
+            release();
+        filtered = on;
+    }
+    bool isFiltered() const { return filtered; }
+    void setBlurRadius(unsigned int texels) { blurRadius = std::min(texels, MomentBlur::MAX_RADIUS); }
+    // 0 to 1, how much of Chebyshev's bound is cut off against light bleeding between overlapping casters
+    void setLightBleedReduction(float amount) { bleedReduction = std::min(std::max(amount, 0.0f), 0.95f); }
+
+    // the cascades for this frame's camera and light. view is the camera's view matrix, the projection is given by
+    // its vertical field of view in radians, aspect and clip planes.
+    void update(const glm::mat4& view, float fovY, float aspect, float nearPlane, float farPlane, const glm::vec3& lightDirection)
+    {
+        prepare();
+        const glm::vec3 direction = glm::normalize(lightDirection);
+        const bool lightTurned = glm::dot(direction, light) < 0.99999f;
+        light = direction;
+        const glm::mat4 inverseView = glm::inverse(view);
+        const float tanY = std::tan(fovY * 0.5f);
+        const float tanX = tanY * aspect;
+
+        float sliceNear = nearPlane;
+        for (unsigned int c = 0; c < count; c++)
+        {
+            Cascade& cascade = cascades[c];
+            const float t = float(c + 1) / float(count);
+            const float logarithmic = nearPlane * std::pow(farPlane / nearPlane, t);
+            const float uniform = nearPlane + (farPlane - nearPlane) * t;
+            const float sliceFar = splitLambda * logarithmic + (1.0f - splitLambda) * uniform;
+            cascade.splitFar = sliceFar;
+
+            // the slice's bounding sphere, in view space on the axis where it touches the far corners
+            const float k = tanX * tanX + tanY * tanY;
+            float z = std::min(0.5f * (sliceNear + sliceFar) * (1.0f + k), sliceFar);
+            const float radius = std::sqrt((sliceFar - z) * (sliceFar - z) + sliceFar * sliceFar * k);
+            const glm::vec3 center = glm::vec3(inverseView * glm::vec4(0.0f, 0.0f, -z, 1.0f));
+            sliceNear = sliceFar;
+
+            cascade.previousDynamicTiles = cascade.dynamicTiles;
+            cascade.dynamicTiles = 0;
+            cascade.render = false;
+            // the first cascade follows the camera exactly, the cached ones get room to move in
+            bool refit;
+            glm::mat4 matrix;
+            if (c == 0)
+            {
+                matrix = snappedMatrix(center, radius);
+                refit = !cascade.valid || lightTurned || matrix != cascade.matrix;
+            }
+            else
+            {
+                const bool strayed = glm::length(center - cascade.center) + radius > cascade.radius;
+                const bool due = farRefresh > 0 && cascade.age + 1 >= farRefresh;
+                refit = !cascade.valid || lightTurned || strayed || due;
+                if (refit)
+                    matrix = snappedMatrix(center, radius * (1.0f + CACHE_MARGIN));
+            }
+            cascade.age = refit ? 0 : cascade.age + 1;
+            if (!refit)
+                continue;
+            cascade.center = center;
+            cascade.radius = c == 0 ? radius : radius * (1.0f + CACHE_MARGIN);
+            cascade.matrix = matrix;
+            cascade.valid = true;
+            cascade.staticTiles = ALL_TILES;
+        }
+    }
+
+    // a static caster moved through this world-space sphere, the tiles of the cached layers it reaches are drawn
+    // again; before or after update(), a cascade fitted again is drawn whole anyway
+    void invalidate(const glm::vec3& center, float radius)
+    {
+        for (unsigned int c = 0; c < count; c++)
+            if (cascades[c].valid)
+                cascades[c].staticTiles |= tilesOf(cascades[c], center, radius);
+    }
+
+    // a caster that moves every frame is in this world-space sphere this frame, after update()
+    void addDynamicCaster(const glm::vec3& center, float radius)
+    {
+        for (unsigned int c = 0; c < count; c++)
+            if (cascades[c].valid)
+                cascades[c].dynamicTiles |= tilesOf(cascades[c], center, radius);
+    }
+
+    // whether anything in the cascade's layer changes this frame
+    bool needsRender(unsigned int cascade) const { return cascade < count && compositeTiles(cascades[cascade]) != 0; }
+    const glm::mat4& lightMatrix(unsigned int cascade) const { return cascades[cascade].matrix; }
+    float splitFar(unsigned int cascade) const { return cascades[cascade].splitFar; }
+
+    // binds the cached layer of the cascade and clears its region-th rectangle of stale tiles for the static
+    // casters, false once there are no more; the casters are drawn once for each, clipped to it
+    bool beginStatic(unsigned int cascade, unsigned int region)
+    {
+        Cascade& target = cascades[cascade];
+        if (region == 0)
+            target.staticRegions = regions(target.staticTiles, target.staticRegion);
+        if (region >= target.staticRegions)
+            return false;
+        bindLayer(cachedFbo, cachedDepth, cachedMoments, cascade);
+        const glm::ivec4& r = target.staticRegion[region];
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(r.x, r.y, r.z, r.w);
+        if (filtered)
+        {
+            const float clearMoments[4] = {1.0f, 1.0f, 0.0f, 0.0f};
+            glClearBufferfv(GL_COLOR, 0, clearMoments);
+        }
+        glClear(GL_DEPTH_BUFFER_BIT);
+        return true;
+    }
+
+    // copies the cached static casters into the cascade's layer wherever it changes this frame and binds that for
+    // the dynamic casters, true when there are any to draw over it
+    bool composite(unsigned int cascade)
+    {
+        Cascade& target = cascades[cascade];
+        const uint64_t tiles = compositeTiles(target);
+        target.staticTiles = 0;
+        target.staticRegions = 0;
+        if (tiles == 0)
+            return false;
+        target.render = true;
+        compositedTiles += static_cast<unsigned int>(popCount(tiles));
+        glDisable(GL_SCISSOR_TEST);
+        const GLint layer = static_cast<GLint>(cascade);
+        glm::ivec4 rects[MAX_REGIONS];
+        const glm::ivec4 whole(0, 0, size, size);
+        const unsigned int n = filtered ? 1 : regions(tiles, rects);
+        for (unsigned int i = 0; i < n; i++)
+        {
+            const glm::ivec4& r = filtered ? whole : rects[i];
+            glCopyImageSubData(cachedDepth.id(), GL_TEXTURE_2D_ARRAY, 0, r.x, r.y, layer,
+                               depthArray.id(), GL_TEXTURE_2D_ARRAY, 0, r.x, r.y, layer, r.z, r.w, 1);
+            if (filtered)
+                glCopyImageSubData(cachedMoments.id(), GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer,
+                                   momentArray.id(), GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, size, size, 1);
+        }
+        if (target.dynamicTiles == 0)
+            return false;
+        bindLayer(fbo, depthArray, momentArray, cascade);
+        // the casters stay inside their tiles, which were all copied back
+        const glm::ivec4 bounds = tileBounds(target.dynamicTiles);
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(bounds.x, bounds.y, bounds.z, bounds.w);
+        return true;
+    }
+
+    // back to the scene's framebuffer, the default one unless it is drawn offscreen, blurring what was composited
+    void end(int viewportWidth, int viewportHeight, unsigned int framebuffer = 0)
+    {
+        glDisable(GL_SCISSOR_TEST);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, viewportWidth, viewportHeight);
+        if (!filtered)
+            return;
+        for (unsigned int c = 0; c < count; c++)
+            if (cascades[c].render)
+                blur->blur(momentArray, size, c, 1, blurRadius);
+    }
+
+    // the depths at unit and, filtered, the moments at unit + 1
+    void bind(unsigned int unit) const
+    {
+        glState().activeTexture(GL_TEXTURE0 + unit);
+        glState().bindTexture(GL_TEXTURE_2D_ARRAY, depthArray.id());
+        if (filtered)
+        {
+            glState().activeTexture(GL_TEXTURE0 + unit + 1);
+            glState().bindTexture(GL_TEXTURE_2D_ARRAY, momentArray.id());
+        }
+        glState().activeTexture(GL_TEXTURE0);
+    }
+
+    // cascadeMatrices, cascadeSplits and cascadeCount of a receiver, the program in use
+    void setUniforms(const Shader& shader) const
+    {
+        for (unsigned int c = 0; c < count; c++)
+        {
+            const std::string index = "[" + std::to_string(c) + "]";
+            shader.setMat4("cascadeMatrices" + index, cascades[c].matrix);
+            shader.setFloat("cascadeSplits" + index, cascades[c].splitFar);
+        }
+        shader.setInt("cascadeCount", static_cast<int>(count));
+        shader.setFloat("cascadeTexel", 1.0f / size);
+        shader.setBool("filteredShadows", filtered);
+        shader.setFloat("bleedReduction", bleedReduction);
+    }
+
+    // cascades composited since the last update, for statistics
+    unsigned int renderedCount() const
+    {
+        unsigned int rendered = 0;
+        for (unsigned int c = 0; c < count; c++)
+            rendered += cascades[c].render ? 1u : 0u;
+        return rendered;
+    }
+
+    // tiles copied back from the cache over every composite() so far, for statistics
+    unsigned int compositedTileCount() const { return compositedTiles; }
+
+    void release()
+    {
+        unsigned int* framebuffers[] = {&fbo, &cachedFbo};
+        for (unsigned int* framebuffer : framebuffers)
+        {
+            if (*framebuffer != 0) glDeleteFramebuffers(1, framebuffer);
+            *framebuffer = 0;
+        }
+        depthArray.release();
+        momentArray.release();
+        cachedDepth.release();
+        cachedMoments.release();
+        if (blur)
+            blur->release();
+        for (Cascade& cascade : cascades)
+            cascade = Cascade();
+    }
+
+private:
+    static constexpr float CACHE_MARGIN = 0.15f;    // of a cached cascade's radius
+    static const uint64_t ALL_TILES = ~0ull;        // one bit a tile, row by row from the layer's first texel
+
+    struct Cascade
+    {
+        glm::mat4 matrix = glm::mat4(1.0f);     // light projection * view it was last rendered with
+        glm::vec3 center = glm::vec3(0.0f);
+        float radius = 0.0f;
+        float splitFar = 0.0f;                  // view-space distance the cascade covers up to
+        unsigned int age = 0;                   // frames since it was fitted
+        bool valid = false;
+        bool render = false;                    // composited this frame
+        uint64_t staticTiles = 0;               // of the cached layer, stale
+        uint64_t dynamicTiles = 0;              // under this frame's dynamic casters
+        uint64_t previousDynamicTiles = 0;      // and last frame's, which are copied back over
+        glm::ivec4 staticRegion[MAX_REGIONS];   // what beginStatic() clears, in texels
+        unsigned int staticRegions = 0;
+    };
+
+    unsigned int size;
+    unsigned int count;
+    unsigned int farRefresh = 8;
+    float splitLambda = 0.75f;
+    float casterDistance = 50.0f;
+    glm::vec3 light = glm::vec3(0.0f);
+    Cascade cascades[MAX_CASCADES];
+    unsigned int fbo = 0;
+    unsigned int cachedFbo = 0;
+    GlTexture depthArray{GPU_MEMORY_RENDER_TARGETS};
+    GlTexture momentArray{GPU_MEMORY_RENDER_TARGETS};
+    // the static casters alone, the unblurred moments too
+    GlTexture cachedDepth{GPU_MEMORY_RENDER_TARGETS};
+    GlTexture cachedMoments{GPU_MEMORY_RENDER_TARGETS};
+    unsigned int compositedTiles = 0;
+    MomentBlur* blur = nullptr;
+    bool filtered = false;
+    unsigned int blurRadius = 2;
+    float bleedReduction = 0.2f;
+
+    // an orthographic light matrix around the sphere, its origin moved to a whole texel
+    glm::mat4 snappedMatrix(const glm::vec3& center, float radius) const
+    {
+        const glm::vec3 up = std::abs(light.y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        const glm::mat4 lightView = glm::lookAt(center - light * (radius + casterDistance), center, up);
+        glm::mat4 lightProjection = glm::ortho(-radius, radius, -radius, radius, 0.0f, 2.0f * radius + casterDistance);
+        const glm::vec4 origin = lightProjection * lightView * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f) * (size * 0.5f);
+        const glm::vec2 offset = (glm::round(glm::vec2(origin)) - glm::vec2(origin)) * (2.0f / size);
+        lightProjection[3][0] += offset.x;
+        lightProjection[3][1] += offset.y;
+        return lightProjection * lightView;
+    }
+
+    static uint64_t compositeTiles(const Cascade& cascade)
+    {
+        return cascade.staticTiles | cascade.dynamicTiles | cascade.previousDynamicTiles;
+    }
+
+    static int popCount(uint64_t bits)
+    {
+        int n = 0;
+        for (; bits != 0; bits &= bits - 1)
+            n++;
+        return n;
+    }
+
+    // the tiles a world-space sphere casts onto: the cascade's box across the light, and anything toward the light
+    // from it, a texel wider for the rasterization
+    uint64_t tilesOf(const Cascade& cascade, const glm::vec3& center, float radius) const
+    {
+        const glm::vec4 p = cascade.matrix * glm::vec4(center, 1.0f);
+        const float r = radius / cascade.radius + 2.0f / size;
+        if (std::abs(p.x) > 1.0f + r || std::abs(p.y) > 1.0f + r || p.z > 1.0f + r)
+            return 0;
+        const auto tile = [](float ndc) {
+            return std::min(std::max(static_cast<int>(std::floor((ndc * 0.5f + 0.5f) * TILES)), 0), static_cast<int>(TILES) - 1);
+        };
+        const int x0 = tile(p.x - r), x1 = tile(p.x + r), y0 = tile(p.y - r), y1 = tile(p.y + r);
+        uint64_t tiles = 0;
+        for (int y = y0; y <= y1; y++)
+            for (int x = x0; x <= x1; x++)
+                tiles |= 1ull << (y * TILES + x);
+        return tiles;
+    }
+
+    // tile t's first texel along a side
+    int tileEdge(unsigned int t) const { return static_cast<int>(t * size / TILES); }
+
+    // the bounding rectangle of the tiles, in texels: offset in xy and size in zw
+    glm::ivec4 tileBounds(uint64_t tiles) const
+    {
+        unsigned int x0 = TILES, y0 = TILES, x1 = 0, y1 = 0;
+        for (unsigned int t = 0; t < TILES * TILES; t++)
+        {
+            if ((tiles >> t & 1ull) == 0)
+                continue;
+            x0 = std::min(x0, t % TILES);
+            y0 = std::min(y0, t / TILES);
+            x1 = std::max(x1, t % TILES + 1);
+            y1 = std::max(y1, t / TILES + 1);
+        }
+        if (x0 >= x1)
+            return glm::ivec4(0);
+        return glm::ivec4(tileEdge(x0), tileEdge(y0), tileEdge(x1) - tileEdge(x0), tileEdge(y1) - tileEdge(y0));
+    }
+
+    // the tiles as few rectangles: the runs along each row, each joined with the same run in the row below, and
+    // their bounding rectangle once there are more than MAX_REGIONS
+    unsigned int regions(uint64_t tiles, glm::ivec4 (&out)[MAX_REGIONS]) const
+    {
+        if (tiles == 0)
+            return 0;
+        glm::uvec4 runs[TILES * TILES / 2];     // first and last column past, first and last row past
+        unsigned int n = 0;
+        for (unsigned int y = 0; y < TILES; y++)
+        {
+            for (unsigned int x = 0; x < TILES;)
+            {
+                if ((tiles >> (y * TILES + x) & 1ull) == 0)
+                {
+                    x++;
+                    continue;
+                }
+                const unsigned int first = x;
+                while (x < TILES && (tiles >> (y * TILES + x) & 1ull) != 0)
+                    x++;
+                bool joined = false;
+                for (unsigned int i = 0; i < n && !joined; i++)
+                    if (runs[i].w == y && runs[i].x == first && runs[i].y == x)
+                    {
+                        runs[i].w = y + 1;
+                        joined = true;
+                    }
+                if (!joined)
+                    runs[n++] = glm::uvec4(first, x, y, y + 1);
+            }
+        }
+        if (n > MAX_REGIONS)
+        {
+            out[0] = tileBounds(tiles);
+            return 1;
+        }
+        for (unsigned int i = 0; i < n; i++)
+            out[i] = glm::ivec4(tileEdge(runs[i].x), tileEdge(runs[i].z), tileEdge(runs[i].y) - tileEdge(runs[i].x),
+                                tileEdge(runs[i].w) - tileEdge(runs[i].z));
+        return n;
+    }
+
+    void bindLayer(unsigned int framebuffer, const GlTexture& depth, const GlTexture& moments, unsigned int cascade) const
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depth.id(), 0, static_cast<GLint>(cascade));
+        if (filtered)
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, moments.id(), 0, static_cast<GLint>(cascade));
+        glViewport(0, 0, size, size);
+    }
+
+    void prepare()
+    {
+        if (fbo != 0)
+            return;
+        depthArray.create(GL_TEXTURE_2D_ARRAY, "shadow cascades");
+        depthArray.storage3D(1, GL_DEPTH_COMPONENT32F, size, size, count);
+        // compared in hardware, and lit outside every cascade
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        const float border[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+        glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        glState().bindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        // the cache is only drawn into and copied from
+        cachedDepth.create(GL_TEXTURE_2D_ARRAY, "cached shadow cascades");
+        cachedDepth.storage3D(1, GL_DEPTH_COMPONENT32F, size, size, count);
+        if (filtered)
+        {
+            MomentBlur::createTarget(momentArray, false, size, count, "shadow cascade moments");
+            MomentBlur::createTarget(cachedMoments, false, size, count, "cached shadow cascade moments");
+        }
+        fbo = layerFramebuffer(depthArray, momentArray, "shadow cascades");
+        cachedFbo = layerFramebuffer(cachedDepth, cachedMoments, "cached shadow cascades");
+        for (Cascade& cascade : cascades)
+            cascade.staticTiles = ALL_TILES;
+    }
+
+    unsigned int layerFramebuffer(const GlTexture& depth, const GlTexture& moments, const char* label) const
+    {
+        unsigned int framebuffer = 0;
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        labelObject(GL_FRAMEBUFFER, framebuffer, label);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depth.id(), 0, 0);
+        if (filtered)
+        {
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, moments.id(), 0, 0);
+            glDrawBuffer(GL_COLOR_ATTACHMENT0);
+        }
+        else
+            glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::CASCADED_SHADOW_MAP:: Framebuffer is not complete" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return framebuffer;
+    }
+};
+
+#endif
@@ -0,0 +1,220 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <body_store.h>
+#include <snapshot.h>
+
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <cerrno>
+
+#ifdef __unix__
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
+// Periodic snapshots of a long run, taken without stopping the integrator. Each checkpoint forks: the child has
+// the bodies as they were at the fork, copy-on-write, and writes them out as a snapshot while the parent keeps
+// stepping, so the parent pays for the fork (the page tables) and for the pages it touches before the child is
+// done, at most one more copy of the body arrays, never for a copy of the state up front. The file appears under
+// its name only once complete (written beside it and renamed), so after a crash the path holds the last checkpoint
+// that finished and the run restarts from it with --load. A checkpoint due while the previous one is still being
+// written is taken at the next step after it finished.
+//
+// The child only uses system calls, no allocation: the parent's threads are gone in it and may have held the
+// allocator's locks. Where there is no fork() the state is copied into a SnapshotWriter's image instead.
+class Checkpoints
+{
+public:
+    std::string path;
+    unsigned long interval = 0;     // steps between checkpoints, 0 for none
+
+    ~Checkpoints()
+    {
+        finish();
+    }
+
+    bool enabled() const { return interval > 0 && !path.empty(); }
+
+    // after every step; starts a checkpoint when one is due and none is being written
+    void step(const BodyStore& bodies, const SnapshotInfo& info)
+    {
+        if (!enabled())
+            return;
+        poll();
+        if (!counting)
+        {
+            // the first one interval after the run started, a resumed run's included
+            counting = true;
+            lastStep = info.stepCount;
+        }
+        if (info.stepCount < lastStep + interval || busy())
+            return;
+        lastStep = info.stepCount;
+        start(bodies, info);
+    }
+
+    // waits for the checkpoint being written
+    void finish()
+    {
+#ifdef __unix__
+        if (child > 0)
+        {
+            int status = 0;
+            while (waitpid(child, &status, 0) < 0 && errno == EINTR) {}
+            completed(status);
+        }
+#else
+        writer.wait();
+#endif
+    }
+
+    bool busy() const
+    {
+#ifdef __unix__
+        return child > 0;
+#else
+        return writer.busy();
+#endif
+    }
+
+    unsigned long written() const { return writtenCount; }
+    unsigned long failed() const { return failedCount; }
+
+private:
+    bool counting = false;
+    unsigned long lastStep = 0;
+    unsigned long writtenCount = 0;
+    unsigned long failedCount = 0;
+#ifdef __unix__
+    pid_t child = -1;
+#else
+    SnapshotWriter writer;
+    bool pending = false;
+#endif
+
+    void poll()
+    {
+#ifdef __unix__
+        if (child <= 0)
+            return;
+        int status = 0;
+        if (waitpid(child, &status, WNOHANG) == child)
+            completed(status);
+#else
+        if (pending && !writer.busy())
+        {
+            writer.wait();
+            pending = false;
+            if (writer.lastSucceeded()) writtenCount++;
+            else failedCount++;
+        }
+#endif
+    }
+
+    void start(const BodyStore& bodies, const SnapshotInfo& info)
+    {
+#ifdef __unix__
+        const std::string partial = path + ".partial";
+        const pid_t pid = fork();
+        if (pid == 0)
+        {
+            // the parent's shutdown signals are for the parent
+            signal(SIGINT, SIG_IGN);
+            signal(SIGTERM, SIG_IGN);
+            _exit(writeSnapshot(partial.c_str(), path.c_str(), bodies, info) ? 0 : 1);
+        }
+        if (pid < 0)
+        {
+            failedCount++;
+            return;
+        }
+        child = pid;
+#else
+        pending = writer.write(path, bodies, info);
+#endif
+    }
+
+#ifdef __unix__
+    void completed(int status)
+    {
+        child = -1;
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0) writtenCount++;
+        else failedCount++;
+    }
+
+    static bool writeAll(int fd, const void* data, size_t bytes)
+    {
+        const unsigned char* at = static_cast<const unsigned char*>(data);
+        while (bytes > 0)
+        {
+            const ssize_t done = write(fd, at, std::min<size_t>(bytes, size_t(1) << 30));
+            if (done < 0 && errno == EINTR)
+                continue;
+            if (done <= 0)
+                return false;
+            at += done;
+            bytes -= static_cast<size_t>(done);
+        }
+        return true;
+    }
+
+    // the snapshot file of buildSnapshotImage, streamed from the arrays with a stack buffer for the render fields
+    static bool writeSnapshot(const char* partial, const char* target, const BodyStore& bodies, const SnapshotInfo& info)
+    {
+        if (!snapshotHostIsLittleEndian())
+            return false;
+        const int fd = open(partial, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            return false;
+        const SnapshotHeader header = buildSnapshotHeader(bodies, info);
+        const size_t n = bodies.size();
+        const void* arrays[SNAPSHOT_ARRAY_COUNT] = {bodies.position.data(), bodies.velocity.data(), bodies.mass.data(),
+                                                    bodies.flags.data(), nullptr, nullptr, bodies.id.data()};
+        bool ok = writeAll(fd, &header, sizeof(header));
+        uint64_t at = sizeof(header);
+        static const unsigned char zeros[64] = {};
+        for (unsigned int a = 0; a < SNAPSHOT_ARRAY_COUNT && ok; a++)
+        {
+            ok = writeAll(fd, zeros, static_cast<size_t>(header.arrayOffset[a] - at));
+            if (arrays[a])
+                ok = ok && writeAll(fd, arrays[a], static_cast<size_t>(header.arrayBytes[a]));
+            else
+            {
+                // orientation and radius scale are fields of the render records
+                const size_t CHUNK = 1024;
+                unsigned char buffer[CHUNK * sizeof(glm::quat)];
+                for (size_t first = 0; first < n && ok; first += CHUNK)
+                {
+                    const size_t count = std::min(CHUNK, n - first);
+                    for (size_t k = 0; k < count; k++)
+                    {
+                        const BodyRenderData& render = bodies.render[first + k];
+                        if (a == SNAPSHOT_ORIENTATION)
+                            std::memcpy(buffer + k * sizeof(glm::quat), &render.orientation, sizeof(glm::quat));
+                        else
+                            std::memcpy(buffer + k * sizeof(float), &render.radiusScale, sizeof(float));
+                    }
+                    ok = writeAll(fd, buffer, count * (a == SNAPSHOT_ORIENTATION ? sizeof(glm::quat) : sizeof(float)));
+                }
+            }
+            at = header.arrayOffset[a] + header.arrayBytes[a];
+        }
+        ok = ok && writeAll(fd, zeros, static_cast<size_t>(header.fileBytes - at));
+        ok = fsync(fd) == 0 && ok;
+        ok = close(fd) == 0 && ok;
+        ok = ok && rename(partial, target) == 0;
+        if (!ok)
+            unlink(partial);
+        return ok;
+    }
+#endif
+};
+
+#endif
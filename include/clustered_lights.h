@@ -0,0 +1,159 @@
+#ifndef CLUSTERED_LIGHTS_H
+#define CLUSTERED_LIGHTS_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+#include <gtc/matrix_transform.hpp>
+
+#include <shader.h>
+#include <gpu_memory.h>
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// Clustered forward lighting: the view frustum is cut into GRID_X x GRID_Y screen tiles times GRID_Z depth
+// slices, and a compute pass (shaders.2/light.cluster.cs) bins every point light into the clusters its range
+// reaches. The lit fragment shaders compiled with CLUSTERED_LIGHTS then loop over their cluster's lights only
+// (shaders.2/lights.glsl), so a fragment's cost follows the lights near it rather than all of them. Lights
+// beyond MAX_LIGHTS_PER_CLUSTER in one cluster are dropped there.
+class ClusteredLights
+{
+public:
+    static const unsigned int GRID_X = 16;
+    static const unsigned int GRID_Y = 9;
+    static const unsigned int GRID_Z = 24;
+    static const unsigned int MAX_LIGHTS_PER_CLUSTER = 64;     // CLUSTER_MAX_LIGHTS of clusters.glsl
+
+    enum Binding {
+        BINDING_PARAMS = 2,     // uniform block
+        BINDING_LIGHTS = 12,
+        BINDING_COUNTS = 13,
+        BINDING_INDICES = 14
+    };
+
+    // ClusterLight of clusters.glsl, std430
+    struct Light
+    {
+        glm::vec4 position;     // camera-relative, range in w
+        glm::vec4 attenuation;  // constant, linear, quadratic
+        glm::vec4 ambient;
+        glm::vec4 diffuse;
+        glm::vec4 specular;
+    };
+
+    explicit ClusteredLights(const char* cullPath) : cullShader(cullPath) {}
+
+    ~ClusteredLights()
+    {
+        release();
+    }
+
+    // how far a light with these attenuation terms reaches before its brightest channel falls below cutoff
+    static float range(float constant, float linear, float quadratic, float peak, float cutoff = 1.0f / 256.0f)
+    {
+        // peak / (c + l d + q d^2) = cutoff
+        const float c = constant - peak / cutoff;
+        if (c >= 0.0f)
+            return 0.0f;
+        if (quadratic <= 0.0f)
+            return linear > 0.0f ? -c / linear : 1e30f;
+        return (-linear + std::sqrt(linear * linear - 4.0f * quadratic * c)) / (2.0f * quadratic);
+    }
+
+    // a light of LightData's PointLight layout, its range from the attenuation and brightest colour
+    static Light light(const glm::vec3& position, float constant, float linear, float quadratic, const glm::vec3& ambient,
+                       const glm::vec3& diffuse, const glm::vec3& specular)
+    {
+        const float peak = std::max({ambient.x, ambient.y, ambient.z, diffuse.x, diffuse.y, diffuse.z, specular.x, specular.y, specular.z});
+        return Light{glm::vec4(position, range(constant, linear, quadratic, peak)), glm::vec4(constant, linear, quadratic, 0.0f),
+                     glm::vec4(ambient, 0.0f), glm::vec4(diffuse, 0.0f), glm::vec4(specular, 0.0f)};
+    }
+
+    // rebins lights for this frame's camera. The Matrices UBO must hold the view, projection is the one it holds.
+    // With views side by side (the stereo eyes) the grid covers one, viewportWidth wide, and every view looks up
+    // its clusters in it.
+    void build(const std::vector<Light>& lights, const glm::mat4& projection, float nearPlane, float farPlane, int viewportWidth, int viewportHeight,
+               unsigned int views = 1)
+    {
+        GL_DEBUG_GROUP("light clustering");
+        prepare(lights.size());
+        if (!lights.empty())
+            glNamedBufferSubData(lightBuffer.id(), 0, lights.size() * sizeof(Light), lights.data());
+
+        Params params;
+        params.grid = glm::uvec4(GRID_X, GRID_Y, GRID_Z, static_cast<unsigned int>(lights.size()));
+        const float logDepth = std::log(farPlane / nearPlane);
+        params.tile = glm::vec4(std::max(viewportWidth, 1) / float(GRID_X), std::max(viewportHeight, 1) / float(GRID_Y),
+                                GRID_Z / logDepth, -float(GRID_Z) * std::log(nearPlane) / logDepth);
+        params.depth = glm::vec4(nearPlane, farPlane, views > 1 ? static_cast<float>(std::max(viewportWidth, 1)) : 0.0f, 0.0f);
+        glNamedBufferSubData(paramsBuffer.id(), 0, sizeof(Params), &params);
+        bind();
+
+        cullShader.use();
+        cullShader.setMat4("inverseProjection", glm::inverse(projection));
+        glDispatchCompute((CLUSTER_COUNT + 127) / 128, 1, 1);
+        // the lists are read by the fragment shaders
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    // the buffers at the bindings the lit shaders read, build() binds them too
+    void bind() const
+    {
+        glState().bindBufferBase(GL_UNIFORM_BUFFER, BINDING_PARAMS, paramsBuffer.id());
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_LIGHTS, lightBuffer.id());
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_COUNTS, countBuffer.id());
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_INDICES, indexBuffer.id());
+    }
+
+    void release()
+    {
+        paramsBuffer.release();
+        lightBuffer.release();
+        countBuffer.release();
+        indexBuffer.release();
+        lightCapacity = 0;
+    }
+
+private:
+    static const unsigned int CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+
+    // ClusterParams of clusters.glsl, std140
+    struct Params
+    {
+        glm::uvec4 grid;
+        glm::vec4 tile;
+        glm::vec4 depth;
+    };
+
+    Shader cullShader;
+    GlBuffer paramsBuffer{GPU_MEMORY_OTHER};
+    GlBuffer lightBuffer{GPU_MEMORY_OTHER};
+    GlBuffer countBuffer{GPU_MEMORY_OTHER};
+    GlBuffer indexBuffer{GPU_MEMORY_OTHER};
+    size_t lightCapacity = 0;
+
+    void prepare(size_t lightCount)
+    {
+        if (!paramsBuffer.valid())
+        {
+            paramsBuffer.create(GL_UNIFORM_BUFFER, "cluster params");
+            paramsBuffer.storage(sizeof(Params), nullptr, GL_DYNAMIC_STORAGE_BIT);
+            glState().bindBuffer(GL_UNIFORM_BUFFER, 0);
+            countBuffer.create(GL_SHADER_STORAGE_BUFFER, "cluster light counts");
+            countBuffer.storage(CLUSTER_COUNT * sizeof(unsigned int), nullptr, 0);
+            indexBuffer.create(GL_SHADER_STORAGE_BUFFER, "cluster light indices");
+            indexBuffer.storage(size_t(CLUSTER_COUNT) * MAX_LIGHTS_PER_CLUSTER * sizeof(unsigned int), nullptr, 0);
+            glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        }
+        // grows by doubling, a buffer of at least one light so the binding is never empty
+        if (lightBuffer.valid() && lightCount <= lightCapacity)
+            return;
+        lightCapacity = std::max<size_t>(std::max<size_t>(lightCapacity * 2, lightCount), 1);
+        lightBuffer.create(GL_SHADER_STORAGE_BUFFER, "cluster lights");
+        lightBuffer.storage(lightCapacity * sizeof(Light), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+};
+
+#endif
@@ -0,0 +1,222 @@
+#ifndef CUBE_SHADOW_MAP_H
+#define CUBE_SHADOW_MAP_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+#include <gtc/matrix_transform.hpp>
+
+#include <shader.h>
+#include <gpu_memory.h>
+#include <moment_shadows.h>
+
+#include <string>
+#include <iostream>
+#include <algorithm>
+
+// An omnidirectional shadow for one point light, the sun: a depth cube map filled in a single layered pass, the
+// casters' geometry shader (shaders.2/shadow.cube.gs) runs once per face and sends each triangle to the faces its
+// caster's bounding sphere reaches, so every vertex is transformed once for all six. The lit shaders compiled with
+// SUN_SHADOWS compare against it (shaders.2/shadows.glsl) through the SunShadow block this publishes. Filtered, the
+// pass also writes the distances' moments into a colour cube that end() blurs (moment_shadows.h), and the lit
+// shaders take one bilinear sample of it for a shadow softened over the blur radius instead of a 2x2 comparison.
+class CubeShadowMap
+{
+public:
+    static const unsigned int TEXTURE_UNIT = 16;    // layout(binding) of sunShadowMap, clear of batchTextures
+    static const unsigned int MOMENTS_UNIT = 22;    // of sunShadowMoments, past the virtual texture's
+
+    enum Binding {
+        BINDING_PARAMS = 3      // uniform block
+    };
+
+    // without blurPath (shaders.2/shadow.blur.cs) the map cannot be filtered
+    explicit CubeShadowMap(unsigned int resolution = 1024, const char* blurPath = nullptr) : size(resolution)
+    {
+        if (blurPath)
+            blur = new MomentBlur(blurPath, true);
+    }
+
+    ~CubeShadowMap()
+    {
+        release();
+        delete blur;
+    }
+
+    unsigned int resolution() const { return size; }
+    // a face's size from the next begin(), the map made again when it changes
+    void setResolution(unsigned int texels)
+    {
+        texels = std::max(texels, 16u);
+        if (texels != size)
+            release();
+        size = texels;
+    }
+    // whether the faces hold casters, that is begin() ran since the map was last made
+    bool rendered() const { return drawn; }
+
+    // moments blurred over radius texels either side instead of depths compared, from the next begin()
+    void setFiltered(bool on) { wantFiltered = on && blur; }
+    bool isFiltered() const { return wantFiltered; }
+    void setBlurRadius(unsigned int texels) { blurRadius = std::min(texels, MomentBlur::MAX_RADIUS); }
+    unsigned int blurRadiusTexels() const { return blurRadius; }
+    // 0 to 1, how much of Chebyshev's bound is cut off against light bleeding between overlapping casters
+    void setLightBleedReduction(float amount) { bleedReduction = std::min(std::max(amount, 0.0f), 0.95f); }
+
+    // the six faces of a cube map about the origin, in GL_TEXTURE_CUBE_MAP_POSITIVE_X + i order
+    static void faceMatrices(float nearPlane, float farPlane, glm::mat4 (&faces)[6])
+    {
+        const glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, nearPlane, farPlane);
+        const glm::vec3 origin(0.0f);
+        faces[0] = projection * glm::lookAt(origin, glm::vec3( 1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f));
+        faces[1] = projection * glm::lookAt(origin, glm::vec3(-1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f));
+        faces[2] = projection * glm::lookAt(origin, glm::vec3( 0.0f,  1.0f,  0.0f), glm::vec3(0.0f,  0.0f,  1.0f));
+        faces[3] = projection * glm::lookAt(origin, glm::vec3( 0.0f, -1.0f,  0.0f), glm::vec3(0.0f,  0.0f, -1.0f));
+        faces[4] = projection * glm::lookAt(origin, glm::vec3( 0.0f,  0.0f,  1.0f), glm::vec3(0.0f, -1.0f,  0.0f));
+        faces[5] = projection * glm::lookAt(origin, glm::vec3( 0.0f,  0.0f, -1.0f), glm::vec3(0.0f, -1.0f,  0.0f));
+    }
+
+    // binds and clears the cube for the casters around lightPosition (camera-relative), see setCaster
+    void begin(const glm::vec3& lightPosition, float nearPlane, float farPlane)
+    {
+        prepare();
+        light = lightPosition;
+        far = farPlane;
+        drawn = true;
+        faceMatrices(nearPlane, farPlane, faces);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glViewport(0, 0, size, size);
+        if (filtered)
+        {
+            // far away and flat where nothing is drawn
+            const float clearMoments[4] = {1.0f, 1.0f, 0.0f, 0.0f};
+            glClearBufferfv(GL_COLOR, 0, clearMoments);
+        }
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+
+    // keeps the faces drawn earlier for a light now at lightPosition, camera-relative: they hold distances from the
+    // light, so they only go stale with what moved since
+    void follow(const glm::vec3& lightPosition)
+    {
+        light = lightPosition;
+    }
+
+    // the faces for a caster program between begin and end, the program in use
+    void setCaster(const Shader& shader) const
+    {
+        for (int f = 0; f < 6; f++)
+            shader.setMat4("faceMatrices[" + std::to_string(f) + "]", faces[f]);
+        shader.setVec3("lightPosition", light);
+        shader.setFloat("farPlane", far);
+    }
+
+    // back to the scene's framebuffer, the default one unless it is drawn offscreen, blurring the moments first
+    void end(int viewportWidth, int viewportHeight, unsigned int framebuffer = 0)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, viewportWidth, viewportHeight);
+        if (filtered)
+            blur->blur(moments, size, 0, 6, blurRadius);
+    }
+
+    // publishes the SunShadow block for this frame's camera-relative view and binds the map, disabled the lit
+    // shaders skip the lookup
+    void bind(const glm::mat4& view, bool enabled)
+    {
+        prepare();
+        Params params;
+        params.inverseView = glm::inverse(view);
+        params.light = glm::vec4(light, enabled ? far : 0.0f);
+        // two thousandths of the distance off, and out along the normal by 1.5 texels of a face at the point's distance
+        params.bias = glm::vec4(0.002f, 3.0f / size, filtered ? 1.0f : 0.0f, bleedReduction);
+        glNamedBufferSubData(paramsBuffer.id(), 0, sizeof(Params), &params);
+        glState().bindBufferBase(GL_UNIFORM_BUFFER, BINDING_PARAMS, paramsBuffer.id());
+        glState().activeTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+        glState().bindTexture(GL_TEXTURE_CUBE_MAP, cube.id());
+        if (filtered)
+        {
+            glState().activeTexture(GL_TEXTURE0 + MOMENTS_UNIT);
+            glState().bindTexture(GL_TEXTURE_CUBE_MAP, moments.id());
+        }
+        glState().activeTexture(GL_TEXTURE0);
+    }
+
+    void release()
+    {
+        if (fbo != 0) glDeleteFramebuffers(1, &fbo);
+        fbo = 0;
+        drawn = false;
+        cube.release();
+        moments.release();
+        paramsBuffer.release();
+        if (blur)
+            blur->release();
+    }
+
+private:
+    // SunShadow of shadows.glsl, std140
+    struct Params
+    {
+        glm::mat4 inverseView;
+        glm::vec4 light;
+        glm::vec4 bias;
+    };
+
+    unsigned int size;
+    unsigned int fbo = 0;
+    GlTexture cube{GPU_MEMORY_RENDER_TARGETS};
+    GlTexture moments{GPU_MEMORY_RENDER_TARGETS};
+    MomentBlur* blur = nullptr;
+    bool wantFiltered = false;
+    bool filtered = false;                  // what the targets were made for
+    unsigned int blurRadius = 3;
+    float bleedReduction = 0.3f;
+    GlBuffer paramsBuffer{GPU_MEMORY_OTHER};
+    glm::vec3 light = glm::vec3(0.0f);
+    float far = 1.0f;
+    bool drawn = false;
+    glm::mat4 faces[6];
+
+    void prepare()
+    {
+        if (fbo != 0 && filtered == wantFiltered)
+            return;
+        release();
+        filtered = wantFiltered;
+        cube.create(GL_TEXTURE_CUBE_MAP, "sun shadow cube");
+        cube.storage2D(1, GL_DEPTH_COMPONENT32F, size, size);
+        // compared in hardware, bilinear over the four nearest texels
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        glState().bindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+        // the whole cube attached, layered: gl_Layer picks the face
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        labelObject(GL_FRAMEBUFFER, fbo, "sun shadow");
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cube.id(), 0);
+        if (filtered)
+        {
+            MomentBlur::createTarget(moments, true, size, 6, "sun shadow moments");
+            glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, moments.id(), 0);
+            glDrawBuffer(GL_COLOR_ATTACHMENT0);
+        }
+        else
+            glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::CUBE_SHADOW_MAP:: Framebuffer is not complete" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        paramsBuffer.create(GL_UNIFORM_BUFFER, "sun shadow params");
+        paramsBuffer.storage(sizeof(Params), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        glState().bindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+};
+
+#endif
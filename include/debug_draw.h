@@ -0,0 +1,247 @@
+#ifndef DEBUG_DRAW_H
+#define DEBUG_DRAW_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <streaming_buffer.h>
+#include <shader.h>
+#include <gpu_memory.h>
+#include <gl_state_cache.h>
+#include <profiler.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+
+// Immediate-mode lines, boxes and spheres for looking at what the simulation and the culling do, gathered anywhere
+// in the frame and flushed at the end in two draws per layer: the lines as a GL_LINES list, the boxes and spheres as
+// one instanced draw whose vertex shader makes each outline from gl_VertexID, so a shape costs the CPU a 32-byte
+// record whatever its size on screen. Positions are world space in double and stored camera-relative. Everything
+// goes up through one StreamingBuffer segment per frame, copied in a single pass, which keeps 100k primitives to a
+// few milliseconds of CPU and their own GPU scope rather than spreading over the passes they are shown for. Past
+// MAX_LINES or MAX_SHAPES a frame's extra primitives are dropped and counted.
+class DebugDraw
+{
+public:
+    enum Layer { DEPTH_TESTED = 0, OVERLAY = 1, LAYERS = 2 };
+
+    static const size_t MAX_LINES = 1u << 20;
+    static const size_t MAX_SHAPES = 1u << 18;
+    static const unsigned int SHAPE_VERTICES = 96;     // a sphere's three circles of 16 segments, a box uses 24
+
+    struct LineVertex
+    {
+        glm::vec3 position;     // camera-relative
+        uint32_t color;         // RGBA8
+    };
+
+    struct Shape
+    {
+        glm::vec3 center;       // camera-relative
+        float kind;             // SHAPE_BOX or SHAPE_SPHERE
+        glm::vec3 extent;       // a box's half extents, a sphere's radius in x
+        uint32_t color;
+    };
+
+    DebugDraw(const char* lineVertexPath, const char* shapeVertexPath, const char* fragmentPath)
+        : lineShader(lineVertexPath, fragmentPath), shapeShader(shapeVertexPath, fragmentPath) {}
+    DebugDraw(const DebugDraw&) = delete;
+    DebugDraw& operator=(const DebugDraw&) = delete;
+
+    Shader& lineProgram() { return lineShader; }
+    Shader& shapeProgram() { return shapeShader; }
+    unsigned int lineVertexArray() const { return lineVao.id(); }
+    unsigned int shapeVertexArray() const { return shapeVao.id(); }
+
+    static uint32_t color(const glm::vec3& rgb, float alpha = 1.0f)
+    {
+        const glm::uvec4 c(glm::clamp(glm::vec4(rgb, alpha), 0.0f, 1.0f) * 255.0f + 0.5f);
+        return c.r | (c.g << 8) | (c.b << 16) | (c.a << 24);
+    }
+
+    // empties the lists for a frame seen from camera
+    void begin(const glm::dvec3& camera)
+    {
+        origin = camera;
+        for (unsigned int layer = 0; layer < LAYERS; layer++)
+        {
+            lines[layer].clear();
+            shapes[layer].clear();
+            lineRanges[layer] = Range();
+            shapeRanges[layer] = Range();
+        }
+        dropped = 0;
+    }
+
+    void line(const glm::dvec3& a, const glm::dvec3& b, uint32_t rgba, Layer layer = DEPTH_TESTED)
+    {
+        if (lineCount() >= MAX_LINES)
+        {
+            dropped++;
+            return;
+        }
+        lines[layer].push_back(LineVertex{glm::vec3(a - origin), rgba});
+        lines[layer].push_back(LineVertex{glm::vec3(b - origin), rgba});
+    }
+
+    // a line from at along vector, the velocities
+    void arrow(const glm::dvec3& at, const glm::dvec3& vector, uint32_t rgba, Layer layer = DEPTH_TESTED)
+    {
+        line(at, at + vector, rgba, layer);
+    }
+
+    // axis-aligned, halfExtent on each side of center
+    void box(const glm::dvec3& center, const glm::vec3& halfExtent, uint32_t rgba, Layer layer = DEPTH_TESTED)
+    {
+        addShape(center, SHAPE_BOX, halfExtent, rgba, layer);
+    }
+
+    void sphere(const glm::dvec3& center, float radius, uint32_t rgba, Layer layer = DEPTH_TESTED)
+    {
+        addShape(center, SHAPE_SPHERE, glm::vec3(radius, 0.0f, 0.0f), rgba, layer);
+    }
+
+    size_t lineCount() const { return (lines[DEPTH_TESTED].size() + lines[OVERLAY].size()) / 2; }
+    size_t shapeCount() const { return shapes[DEPTH_TESTED].size() + shapes[OVERLAY].size(); }
+    size_t primitiveCount() const { return lineCount() + shapeCount(); }
+    size_t droppedCount() const { return dropped; }
+    bool empty(Layer layer) const { return lineRanges[layer].count == 0 && shapeRanges[layer].count == 0; }
+
+    // copies the frame's primitives into the next stream segment, waiting only if the GPU is a full ring behind
+    void flush()
+    {
+        PROFILE_SCOPE("debug draw flush");
+        const size_t lineVertices = lines[DEPTH_TESTED].size() + lines[OVERLAY].size();
+        const size_t shapeRecords = shapeCount();
+        if (lineVertices == 0 && shapeRecords == 0)
+            return;
+        reserve(lineVertices, shapeRecords);
+        uint8_t* out = static_cast<uint8_t*>(stream.beginWrite());
+        if (!out)
+            return;
+        const size_t segment = stream.readOffset();
+        size_t vertex = 0;
+        for (unsigned int layer = 0; layer < LAYERS; layer++)
+        {
+            std::memcpy(out + vertex * sizeof(LineVertex), lines[layer].data(), lines[layer].size() * sizeof(LineVertex));
+            lineRanges[layer] = Range{segment / sizeof(LineVertex) + vertex, lines[layer].size()};
+            vertex += lines[layer].size();
+        }
+        size_t record = 0;
+        for (unsigned int layer = 0; layer < LAYERS; layer++)
+        {
+            std::memcpy(out + shapeOffset + record * sizeof(Shape), shapes[layer].data(), shapes[layer].size() * sizeof(Shape));
+            shapeRanges[layer] = Range{(segment + shapeOffset) / sizeof(Shape) + record, shapes[layer].size()};
+            record += shapes[layer].size();
+        }
+    }
+
+    // a layer's lines with lineProgram() in use and lineVertexArray() bound
+    void drawLines(Layer layer)
+    {
+        const Range& range = lineRanges[layer];
+        if (range.count == 0)
+            return;
+        glDepthMask(GL_FALSE);
+        glDrawArrays(GL_LINES, static_cast<GLint>(range.first), static_cast<GLsizei>(range.count));
+        glDepthMask(GL_TRUE);
+        stream.fenceRead();
+    }
+
+    // a layer's boxes and spheres with shapeProgram() in use and shapeVertexArray() bound
+    void drawShapes(Layer layer)
+    {
+        const Range& range = shapeRanges[layer];
+        if (range.count == 0)
+            return;
+        glDepthMask(GL_FALSE);
+        glDrawArraysInstancedBaseInstance(GL_LINES, 0, SHAPE_VERTICES, static_cast<GLsizei>(range.count), static_cast<GLuint>(range.first));
+        glDepthMask(GL_TRUE);
+        stream.fenceRead();
+    }
+
+    void release()
+    {
+        stream.release();
+        lineVao.release();
+        shapeVao.release();
+        lineCapacity = shapeCapacity = 0;
+        shapeOffset = 0;
+    }
+
+private:
+    // the kinds of debug.shape.vs
+    static constexpr float SHAPE_BOX = 0.0f;
+    static constexpr float SHAPE_SPHERE = 1.0f;
+
+    struct Range
+    {
+        size_t first = 0;       // vertex or instance in the whole buffer
+        size_t count = 0;
+    };
+
+    Shader lineShader;
+    Shader shapeShader;
+    StreamingBuffer stream{GPU_MEMORY_OTHER};
+    GlVertexArray lineVao;
+    GlVertexArray shapeVao;
+    size_t lineCapacity = 0;        // vertices per segment
+    size_t shapeCapacity = 0;       // records per segment
+    size_t shapeOffset = 0;         // bytes into a segment where its records start
+    glm::dvec3 origin = glm::dvec3(0.0);
+    std::vector<LineVertex> lines[LAYERS];
+    std::vector<Shape> shapes[LAYERS];
+    Range lineRanges[LAYERS];
+    Range shapeRanges[LAYERS];
+    size_t dropped = 0;
+
+    void addShape(const glm::dvec3& center, float kind, const glm::vec3& extent, uint32_t rgba, Layer layer)
+    {
+        if (shapeCount() >= MAX_SHAPES)
+        {
+            dropped++;
+            return;
+        }
+        shapes[layer].push_back(Shape{glm::vec3(center - origin), kind, extent, rgba});
+    }
+
+    // segments for at least this many, doubling so a growing scene reallocates a few times. The records sit at a
+    // multiple of their size into each segment, and segments are a multiple of it, so a record's instance index is
+    // its byte offset in the buffer over its size.
+    void reserve(size_t lineVertices, size_t shapeRecords)
+    {
+        if (lineVertices <= lineCapacity && shapeRecords <= shapeCapacity && stream.valid())
+            return;
+        lineCapacity = std::max(lineVertices, 2 * lineCapacity);
+        lineCapacity += lineCapacity & 1u;
+        shapeCapacity = std::max(shapeRecords, 2 * shapeCapacity);
+        shapeOffset = lineCapacity * sizeof(LineVertex);
+        stream.create(shapeOffset + shapeCapacity * sizeof(Shape), "debug draw");
+
+        lineVao.create("debug draw lines");
+        glState().bindBuffer(GL_ARRAY_BUFFER, stream.buffer());
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(LineVertex), (void*)offsetof(LineVertex, position));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(LineVertex), (void*)offsetof(LineVertex, color));
+
+        shapeVao.create("debug draw shapes");
+        glState().bindBuffer(GL_ARRAY_BUFFER, stream.buffer());
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Shape), (void*)offsetof(Shape, center));
+        glVertexAttribDivisor(0, 1);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Shape), (void*)offsetof(Shape, extent));
+        glVertexAttribDivisor(1, 1);
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Shape), (void*)offsetof(Shape, color));
+        glVertexAttribDivisor(2, 1);
+        glState().bindBuffer(GL_ARRAY_BUFFER, 0);
+        glState().bindVertexArray(0);
+    }
+};
+
+#endif
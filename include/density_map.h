@@ -0,0 +1,169 @@
+#ifndef DENSITY_MAP_H
+#define DENSITY_MAP_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <shader.h>
+#include <gpu_nbody.h>
+#include <gpu_memory.h>
+#include <gl_state_cache.h>
+#include <gl_debug.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+
+// A belt too dense to see as rocks, drawn as how many bodies there are instead: a heat map on the ecliptic. Each
+// update() counts GpuNBody's bodies into a resolution x resolution grid over the XZ plane around center with an
+// atomicAdd per body (shaders.2/density.splat.cs), blurs the counts with a separable Gaussian into an R32F texture
+// (shaders.2/density.blur.cs) and draw() lays that over the plane as one camera-relative quad, log-scaled through a
+// colour map and alpha blended over the scene (shaders.2/density.plane.fs). The cost is a pass over the positions
+// and two over the grid, where the instanced rocks cull, sort and shade every body; nothing per body passes the
+// CPU. Bodies off the grid are not counted.
+class DensityMap
+{
+public:
+    static const unsigned int MAX_RADIUS = 16;
+
+    unsigned int resolution = 512;  // texels along each side
+    float extent = 250.0f;          // half the side of the grid, world units
+    glm::vec3 center = glm::vec3(0.0f);
+    float blurRadius = 3.0f;        // of the Gaussian, texels
+    float exposure = 1.0f;          // log-scaled counts per unit of the colour map
+    float opacity = 0.85f;
+
+    DensityMap(const char* splatPath, const char* blurPath, const char* vertexPath, const char* fragmentPath)
+        : splatShader(splatPath), blurShader(blurPath), shader(vertexPath, fragmentPath) {}
+    DensityMap(const DensityMap&) = delete;
+    DensityMap& operator=(const DensityMap&) = delete;
+
+    ~DensityMap()
+    {
+        release();
+    }
+
+    Shader& program() { return shader; }
+    // empty, bound for draw()
+    unsigned int vertexArray()
+    {
+        if (emptyVao.id() == 0)
+        {
+            emptyVao.create("density map");
+            glState().bindVertexArray(0);
+        }
+        return emptyVao.id();
+    }
+
+    // counts and blurs nbody's bodies from first on; before the draws that read the map
+    void update(const GpuNBody& nbody, unsigned int first)
+    {
+        if (first >= nbody.bodyCount)
+            return;
+        GL_DEBUG_GROUP("density map");
+        prepare();
+        const GLuint zero = 0;
+        glClearNamedBufferData(counts.id(), GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        nbody.bind();
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_COUNTS, counts.id());
+        splatShader.use();
+        splatShader.setUInt("first", first);
+        splatShader.setUInt("bodyCount", nbody.bodyCount);
+        splatShader.setUInt("resolution", gridSize);
+        splatShader.setVec3("center", center);
+        splatShader.setFloat("extent", std::max(extent, 1e-3f));
+        glDispatchCompute((nbody.bodyCount - first + 255) / 256, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        // across from the counts into the first texture, then down into the second
+        const int radius = std::clamp(static_cast<int>(std::ceil(2.0f * blurRadius)), 0, static_cast<int>(MAX_RADIUS));
+        blurShader.use();
+        blurShader.setUInt("resolution", gridSize);
+        blurShader.setInt("radius", radius);
+        blurShader.setFloat("sigma", std::max(blurRadius, 0.5f));
+        for (int pass = 0; pass < 2; pass++)
+        {
+            blurShader.setInt("vertical", pass);
+            glBindImageTexture(0, blurred[0].id(), 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+            glBindImageTexture(1, blurred[1].id(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+            glDispatchCompute((gridSize + 7) / 8, (gridSize + 7) / 8, 1);
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+        }
+    }
+
+    // the map over the plane, with the shader in use and vertexArray() bound. Depth is tested but not written, and
+    // only the first colour attachment is written.
+    void draw(const glm::vec3& origin)
+    {
+        if (!blurred[1].valid())
+            return;
+        glState().activeTexture(GL_TEXTURE0);
+        glState().bindTexture(GL_TEXTURE_2D, blurred[1].id());
+        shader.setInt("density", 0);
+        shader.setVec3("origin", origin);
+        shader.setVec3("center", center);
+        shader.setFloat("extent", std::max(extent, 1e-3f));
+        shader.setFloat("exposure", exposure);
+        shader.setFloat("opacity", opacity);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDepthMask(GL_FALSE);
+        glDisable(GL_CULL_FACE);
+        glColorMaski(1, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        glColorMaski(1, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glEnable(GL_CULL_FACE);
+        glDepthMask(GL_TRUE);
+        glDisable(GL_BLEND);
+        glState().bindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    void release()
+    {
+        counts.release();
+        blurred[0].release();
+        blurred[1].release();
+        emptyVao.release();
+        gridSize = 0;
+    }
+
+private:
+    static const GLuint BINDING_COUNTS = 5;
+
+    Shader splatShader;
+    Shader blurShader;
+    Shader shader;
+    GlBuffer counts{GPU_MEMORY_SIMULATION};
+    GlTexture blurred[2] = {GlTexture(GPU_MEMORY_RENDER_TARGETS), GlTexture(GPU_MEMORY_RENDER_TARGETS)};
+    GlVertexArray emptyVao;
+    unsigned int gridSize = 0;      // the resolution the grid was allocated at
+
+    // (re)allocates the grid when the resolution changed
+    void prepare()
+    {
+        const unsigned int size = std::clamp(resolution, 16u, 4096u);
+        if (gridSize == size && counts.valid())
+            return;
+        counts.release();
+        blurred[0].release();
+        blurred[1].release();
+        gridSize = size;
+        counts.create(GL_SHADER_STORAGE_BUFFER, "density counts");
+        counts.storage(size_t(size) * size * sizeof(uint32_t), nullptr, 0);
+        glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        for (unsigned int k = 0; k < 2; k++)
+        {
+            blurred[k].create(GL_TEXTURE_2D, k == 0 ? "density blur" : "density map");
+            blurred[k].storage2D(1, GL_R32F, static_cast<GLsizei>(size), static_cast<GLsizei>(size));
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+        glState().bindTexture(GL_TEXTURE_2D, 0);
+    }
+};
+
+#endif
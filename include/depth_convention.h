@@ -0,0 +1,118 @@
+#ifndef DEPTH_CONVENTION_H
+#define DEPTH_CONVENTION_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+#include <gtc/matrix_transform.hpp>
+
+#include <shader.h>
+#include <gl_state_cache.h>
+
+#include <cmath>
+
+// How the camera's depth is laid out. The standard way is GL's: the near and far planes go to -1 and 1 and the
+// window depth to [0, 1], and a depth buffer spends nearly all its precision just past the near plane, so a larger
+// world z-fights far away unless it is drawn in several depth partitions. Reverse-Z with an infinite far plane puts
+// the near plane at depth 1 and infinity at 0 under glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE); in a float depth
+// buffer the exponent then follows the 1/z falloff, the relative precision is about the same at every distance and
+// nothing is clipped at the far end, a scene of any scale draws in one geometry pass.
+//
+// The convention is chosen once, before the first program is built. enable() sets the clip control and the clear
+// depth, turns the state cache's depth functions around (GL_LESS reaches GL as GL_GREATER, "nearer" keeps its
+// meaning for every pass) and compiles every program with REVERSE_Z, which the helpers of shaders.2/depth.glsl
+// follow. perspective() is the camera's projection and depthFormat() what its depth targets are. Passes with
+// projections of their own in GL's convention, the shadow maps, draw inside a StandardDepth scope.
+class DepthConvention
+{
+public:
+    bool reversed() const { return reversedZ; }
+
+    // once, with the context current and before any program is built
+    void enable(bool reverse)
+    {
+        reversedZ = reverse;
+        if (reverse)
+            Shader::sharedDefines().push_back({"REVERSE_Z", ""});
+        apply(reverse);
+    }
+
+    // the camera's projection: reversed with no far plane, or glm::perspective's
+    glm::mat4 perspective(float fovy, float aspect, float nearPlane, float farPlane) const
+    {
+        if (!reversedZ)
+            return glm::perspective(fovy, aspect, nearPlane, farPlane);
+        // z_clip = near and w = distance, so depth = near / distance
+        const float f = 1.0f / std::tan(0.5f * fovy);
+        glm::mat4 m(0.0f);
+        m[0][0] = f / aspect;
+        m[1][1] = f;
+        m[2][3] = -1.0f;
+        m[3][2] = nearPlane;
+        return m;
+    }
+
+    // glm::frustum's window with the same treatment, for off-axis cameras (stereo_camera.h)
+    glm::mat4 frustum(float left, float right, float bottom, float top, float nearPlane, float farPlane) const
+    {
+        glm::mat4 m = glm::frustum(left, right, bottom, top, nearPlane, farPlane);
+        if (!reversedZ)
+            return m;
+        m[2][2] = 0.0f;
+        m[3][2] = nearPlane;
+        return m;
+    }
+
+    // window depth of the cleared buffer, and of the points at infinity
+    float farDepth() const { return reversedZ ? 0.0f : 1.0f; }
+    // normalized device z of the near plane, and of a point past it that still unprojects to a finite one
+    float nearNdc() const { return reversedZ ? 1.0f : -1.0f; }
+    float beyondNdc() const { return reversedZ ? 0.5f : 1.0f; }
+
+    GLenum depthFormat(bool stencil = true) const
+    {
+        if (reversedZ)
+            return stencil ? GL_DEPTH32F_STENCIL8 : GL_DEPTH_COMPONENT32F;
+        return stencil ? GL_DEPTH24_STENCIL8 : GL_DEPTH_COMPONENT24;
+    }
+
+    // GL's own convention for as long as it lives, e.g. around a shadow pass
+    class StandardDepth
+    {
+    public:
+        explicit StandardDepth(DepthConvention& convention) : convention(convention)
+        {
+            if (convention.reversed())
+                convention.apply(false);
+        }
+        StandardDepth(const StandardDepth&) = delete;
+        StandardDepth& operator=(const StandardDepth&) = delete;
+        ~StandardDepth()
+        {
+            if (convention.reversed())
+                convention.apply(true);
+        }
+
+    private:
+        DepthConvention& convention;
+    };
+
+private:
+    bool reversedZ = false;
+
+    void apply(bool reverse)
+    {
+        // an ES context without GL_EXT_clip_control is only ever in GL's convention
+        if (glClipControl)
+            glClipControl(GL_LOWER_LEFT, reverse ? GL_ZERO_TO_ONE : GL_NEGATIVE_ONE_TO_ONE);
+        glClearDepth(reverse ? 0.0 : 1.0);
+        glState().setDepthReversed(reverse);
+    }
+};
+
+inline DepthConvention& depthConvention()
+{
+    static DepthConvention convention;
+    return convention;
+}
+
+#endif
@@ -0,0 +1,476 @@
+#ifndef DISTRIBUTED_NBODY_H
+#define DISTRIBUTED_NBODY_H
+
+#include <mpi.h>
+#include <glm.hpp>
+
+#include <body_store.h>
+#include <barnes_hut.h>
+#include <morton.h>
+#include <thread_pool.h>
+#include <profiler.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+
+// one body as ranks exchange it, plain data sent as bytes
+struct DistributedBody
+{
+    glm::dvec3 position;
+    glm::dvec3 velocity;
+    glm::vec3 acceleration;     // with G, from the last force pass
+    float mass;
+    float cost;                 // seconds its last force evaluation took on its rank, what the decomposition balances
+    uint32_t id;
+    uint32_t flags;
+};
+
+// a body or a whole cell's monopole, sent to the ranks that need it but no more of it
+struct LetParticle
+{
+    glm::vec3 position;
+    float mass;
+};
+
+// Barnes-Hut gravity across the ranks of an MPI communicator, every rank owning the bodies of one run of the Z-order
+// curve. The runs are cut so that they carry equal measured cost: each body keeps the time its force evaluation took
+// (its tree terms times its rank's seconds per term, so a slow node or a dense clump counts for more), and the curve
+// is re-cut from a global histogram of that cost whenever the slowest rank's force pass is imbalanceThreshold times
+// the mean, every rebalanceInterval steps, or once a body leaves the grid. In between the cuts stay and bodies that
+// cross one migrate to the rank owning their key.
+//
+// Each step every rank sends every other its part of the locally essential tree: a walk of its own tree that stops
+// at cells far enough from the other rank's bounding box to be accepted by the opening criterion anywhere in it,
+// sending their monopole, and sends the bodies of the leaves it reaches. A rank then builds one tree over its bodies
+// and everything imported and sums its bodies' forces from it alone. Kick-drift-kick leapfrog; G, softening and theta
+// are PhysicsWorld's, there is no other solver or integrator. Positions in the trees are floats relative to the
+// centre of the grid, like PhysicsWorld's relative to the sun.
+class DistributedNBody
+{
+public:
+    struct StepStats
+    {
+        double decomposeSeconds = 0.0;  // keys, cuts and moving bodies to their owners
+        double letSeconds = 0.0;        // walking the trees for the other ranks and the exchange
+        double treeSeconds = 0.0;
+        double forceSeconds = 0.0;
+        double totalSeconds = 0.0;
+        size_t migrated = 0;            // bodies this rank sent to another one
+        size_t imported = 0;            // LET particles it received
+        size_t bytesSent = 0;
+        unsigned long long interactions = 0;
+        double imbalance = 1.0;         // slowest force pass over the mean, over every rank
+        bool rebalanced = false;
+    };
+
+    float G = 1000.0f;
+    float epsilonSq = 1e-4f;
+    float theta = 0.5f;
+    unsigned int threads = 0;                   // of workerPool(), 0 for all
+    double imbalanceThreshold = 1.1;
+    unsigned int rebalanceInterval = 32;
+
+    std::vector<DistributedBody> local;         // this rank's bodies, in no particular order
+    double simTime = 0.0;
+    unsigned long stepCount = 0;
+
+    explicit DistributedNBody(MPI_Comm communicator) : comm(communicator)
+    {
+        MPI_Comm_rank(comm, &rankIndex);
+        MPI_Comm_size(comm, &rankCount);
+        splits.assign(rankCount + 1, 0);
+    }
+
+    int rank() const { return rankIndex; }
+    int ranks() const { return rankCount; }
+
+    // collective: the first rank's bodies dealt out in index order, the others pass nullptr; the first step's cut
+    // takes it from there
+    void scatter(const BodyStore* bodies)
+    {
+        unsigned long long total = bodies && rankIndex == 0 ? bodies->size() : 0;
+        MPI_Bcast(&total, 1, MPI_UNSIGNED_LONG_LONG, 0, comm);
+        std::vector<int> counts(rankCount), offsets(rankCount);
+        for (int r = 0; r < rankCount; r++)
+        {
+            const size_t begin = static_cast<size_t>(total * r / rankCount), end = static_cast<size_t>(total * (r + 1) / rankCount);
+            counts[r] = static_cast<int>((end - begin) * sizeof(DistributedBody));
+            offsets[r] = static_cast<int>(begin * sizeof(DistributedBody));
+        }
+        std::vector<DistributedBody> all;
+        if (rankIndex == 0 && bodies)
+        {
+            all.resize(bodies->size());
+            for (size_t i = 0; i < all.size(); i++)
+                all[i] = fromStore(*bodies, i);
+        }
+        local.resize(counts[rankIndex] / sizeof(DistributedBody));
+        MPI_Scatterv(all.data(), counts.data(), offsets.data(), MPI_BYTE, local.data(), counts[rankIndex], MPI_BYTE, 0, comm);
+        reset();
+    }
+
+    // this rank's share taken from its own store, the ids offset to keep them unique across ranks
+    void assign(const BodyStore& bodies, size_t begin, size_t end, uint32_t idOffset)
+    {
+        local.clear();
+        for (size_t i = begin; i < end; i++)
+        {
+            local.push_back(fromStore(bodies, i));
+            local.back().id += idOffset;
+        }
+        reset();
+    }
+
+    // collective: positions and velocities back into the first rank's store, matched by id
+    void gather(BodyStore* bodies) const
+    {
+        const int bytes = static_cast<int>(local.size() * sizeof(DistributedBody));
+        std::vector<int> counts(rankCount), offsets(rankCount);
+        MPI_Gather(&bytes, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, comm);
+        std::vector<DistributedBody> all;
+        if (rankIndex == 0)
+        {
+            int running = 0;
+            for (int r = 0; r < rankCount; r++)
+            {
+                offsets[r] = running;
+                running += counts[r];
+            }
+            all.resize(running / sizeof(DistributedBody));
+        }
+        MPI_Gatherv(local.data(), bytes, MPI_BYTE, all.data(), counts.data(), offsets.data(), MPI_BYTE, 0, comm);
+        if (rankIndex != 0 || !bodies)
+            return;
+        for (const DistributedBody& b : all)
+        {
+            const uint32_t i = bodies->indexOf(b.id);
+            if (i == BodyStore::INVALID_INDEX)
+                continue;
+            bodies->position[i] = b.position;
+            bodies->velocity[i] = b.velocity;
+            bodies->acceleration[i] = b.acceleration;
+        }
+    }
+
+    // collective
+    unsigned long long globalCount() const
+    {
+        unsigned long long n = local.size(), total = 0;
+        MPI_Allreduce(&n, &total, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+        return total;
+    }
+
+    // collective: advances every body by dt
+    void step(float dt)
+    {
+        PROFILE_SCOPE("DistributedNBody::step");
+        const double start = MPI_Wtime();
+        stats = StepStats();
+        if (!haveAccelerations)
+        {
+            decompose();
+            computeForces();
+            haveAccelerations = true;
+        }
+        const double halfDt = 0.5 * static_cast<double>(dt);
+        for (DistributedBody& b : local)
+        {
+            if (b.flags & BODY_FLAG_STATIC) continue;
+            b.velocity += glm::dvec3(b.acceleration) * halfDt;
+            b.position += b.velocity * static_cast<double>(dt);
+        }
+        decompose();
+        computeForces();
+        for (DistributedBody& b : local)
+            if (!(b.flags & BODY_FLAG_STATIC))
+                b.velocity += glm::dvec3(b.acceleration) * halfDt;
+        simTime += dt;
+        stepCount++;
+        stats.totalSeconds = MPI_Wtime() - start;
+    }
+
+    const StepStats& lastStep() const { return stats; }
+    unsigned long rebalanceCount() const { return rebalances; }
+
+private:
+    static const unsigned int KEY_BITS = 30;
+    static const unsigned int HISTOGRAM_BITS = 16;     // the cuts fall on 2^16 runs of the curve
+
+    MPI_Comm comm;
+    int rankIndex = 0;
+    int rankCount = 1;
+    std::vector<uint32_t> splits;       // rank r owns keys [splits[r], splits[r + 1])
+    glm::dvec3 gridLow{0.0};
+    double gridScale = 0.0;             // grid cells per world unit
+    glm::dvec3 origin{0.0};             // the grid's centre, what tree positions are relative to
+    bool haveGrid = false;
+    bool haveAccelerations = false;
+    double lastImbalance = 1.0;
+    unsigned long stepsSinceCut = 0;
+    unsigned long rebalances = 0;
+    StepStats stats;
+
+    std::vector<uint32_t> keys;
+    std::vector<int> owners;
+    std::vector<glm::vec3> treePositions;
+    std::vector<float> treeMasses;
+    std::vector<unsigned long long> terms;
+    BarnesHutTree tree;
+    std::vector<std::vector<LetParticle>> outgoing;
+    std::vector<LetParticle> incoming;
+    std::vector<glm::vec3> boxes;       // every rank's bounding box in tree coordinates, low and high
+
+    static DistributedBody fromStore(const BodyStore& bodies, size_t i)
+    {
+        DistributedBody b;
+        b.position = bodies.position[i];
+        b.velocity = bodies.velocity[i];
+        b.acceleration = glm::vec3(0.0f);
+        b.mass = bodies.mass[i];
+        b.cost = 1.0f;
+        b.id = bodies.id[i];
+        b.flags = bodies.flags[i];
+        return b;
+    }
+
+    void reset()
+    {
+        haveGrid = false;
+        haveAccelerations = false;
+        lastImbalance = 1.0;
+        stepsSinceCut = 0;
+    }
+
+    uint32_t keyOf(const glm::dvec3& p) const
+    {
+        const glm::dvec3 q = glm::clamp((p - gridLow) * gridScale, glm::dvec3(0.0), glm::dvec3(1023.0));
+        return mortonKey(static_cast<uint32_t>(q.x), static_cast<uint32_t>(q.y), static_cast<uint32_t>(q.z));
+    }
+
+    int ownerOf(uint32_t key) const
+    {
+        return static_cast<int>(std::upper_bound(splits.begin() + 1, splits.end() - 1, key) - (splits.begin() + 1));
+    }
+
+    // the grid over every body with a margin, and cuts of equal cost along its curve
+    void cut()
+    {
+        glm::dvec3 low(1e300), high(-1e300);
+        for (const DistributedBody& b : local)
+        {
+            low = glm::min(low, b.position);
+            high = glm::max(high, b.position);
+        }
+        double bounds[6] = {-low.x, -low.y, -low.z, high.x, high.y, high.z};
+        MPI_Allreduce(MPI_IN_PLACE, bounds, 6, MPI_DOUBLE, MPI_MAX, comm);
+        low = -glm::dvec3(bounds[0], bounds[1], bounds[2]);
+        high = glm::dvec3(bounds[3], bounds[4], bounds[5]);
+        const double size = std::max(std::max(high.x - low.x, high.y - low.y), std::max(high.z - low.z, 1e-3)) * 1.1;
+        origin = 0.5 * (low + high);
+        gridLow = origin - glm::dvec3(0.5 * size);
+        gridScale = 1024.0 / size;
+        haveGrid = true;
+
+        std::vector<double> histogram(size_t(1) << HISTOGRAM_BITS, 0.0);
+        for (const DistributedBody& b : local)
+            histogram[keyOf(b.position) >> (KEY_BITS - HISTOGRAM_BITS)] += b.cost;
+        MPI_Allreduce(MPI_IN_PLACE, histogram.data(), static_cast<int>(histogram.size()), MPI_DOUBLE, MPI_SUM, comm);
+        double total = 0.0;
+        for (double c : histogram) total += c;
+        splits.assign(rankCount + 1, 1u << KEY_BITS);
+        splits[0] = 0;
+        double running = 0.0;
+        int next = 1;
+        for (size_t bucket = 0; bucket < histogram.size() && next < rankCount; bucket++)
+        {
+            running += histogram[bucket];
+            while (next < rankCount && running >= total * next / rankCount)
+                splits[next++] = static_cast<uint32_t>((bucket + 1) << (KEY_BITS - HISTOGRAM_BITS));
+        }
+        stepsSinceCut = 0;
+        rebalances++;
+        stats.rebalanced = true;
+    }
+
+    // sends every body to the rank owning its key, re-cutting first when the balance or the grid calls for it
+    void decompose()
+    {
+        PROFILE_SCOPE("DistributedNBody::decompose");
+        const double start = MPI_Wtime();
+        int outside = 0;
+        if (haveGrid)
+            for (const DistributedBody& b : local)
+            {
+                const glm::dvec3 q = (b.position - gridLow) * gridScale;
+                if (q.x < 0.0 || q.y < 0.0 || q.z < 0.0 || q.x >= 1024.0 || q.y >= 1024.0 || q.z >= 1024.0) { outside = 1; break; }
+            }
+        MPI_Allreduce(MPI_IN_PLACE, &outside, 1, MPI_INT, MPI_MAX, comm);
+        // a new cut is only judged once a step has measured it
+        stepsSinceCut++;
+        if (!haveGrid || outside || (lastImbalance > imbalanceThreshold && stepsSinceCut > 1) || stepsSinceCut >= rebalanceInterval)
+            cut();
+
+        const size_t n = local.size();
+        owners.resize(n);
+        std::vector<int> sendCounts(rankCount, 0);
+        for (size_t i = 0; i < n; i++)
+        {
+            owners[i] = ownerOf(keyOf(local[i].position));
+            sendCounts[owners[i]]++;
+        }
+        std::vector<int> cursor(rankCount);
+        int running = 0;
+        for (int r = 0; r < rankCount; r++)
+        {
+            cursor[r] = running;
+            running += sendCounts[r];
+        }
+        std::vector<DistributedBody> sorted(n);
+        for (size_t i = 0; i < n; i++)
+            sorted[cursor[owners[i]]++] = local[i];
+        stats.migrated = n - static_cast<size_t>(sendCounts[rankIndex]);
+        for (int r = 0; r < rankCount; r++)
+            sendCounts[r] *= static_cast<int>(sizeof(DistributedBody));
+        exchange(sorted, sendCounts, local);
+        stats.decomposeSeconds = MPI_Wtime() - start;
+    }
+
+    // MPI_Alltoallv of byte counts per rank, items of T
+    template <typename T>
+    void exchange(const std::vector<T>& send, std::vector<int>& sendCounts, std::vector<T>& receive)
+    {
+        std::vector<int> receiveCounts(rankCount), sendOffsets(rankCount), receiveOffsets(rankCount);
+        MPI_Alltoall(sendCounts.data(), 1, MPI_INT, receiveCounts.data(), 1, MPI_INT, comm);
+        int sent = 0, received = 0;
+        for (int r = 0; r < rankCount; r++)
+        {
+            sendOffsets[r] = sent;
+            receiveOffsets[r] = received;
+            sent += sendCounts[r];
+            received += receiveCounts[r];
+        }
+        stats.bytesSent += static_cast<size_t>(sent - sendCounts[rankIndex]);
+        receive.resize(static_cast<size_t>(received) / sizeof(T));
+        MPI_Alltoallv(send.data(), sendCounts.data(), sendOffsets.data(), MPI_BYTE,
+                      receive.data(), receiveCounts.data(), receiveOffsets.data(), MPI_BYTE, comm);
+    }
+
+    static float distanceSqToBox(const glm::vec3& p, const glm::vec3& low, const glm::vec3& high)
+    {
+        const glm::vec3 d = glm::max(glm::max(low - p, p - high), glm::vec3(0.0f));
+        return glm::dot(d, d);
+    }
+
+    // what of this rank's tree a probe anywhere in [low, high] would read: cells that pass the opening criterion
+    // from the box's nearest point as monopoles, the bodies of the leaves reached
+    void essentialParticles(const glm::vec3& low, const glm::vec3& high, std::vector<LetParticle>& out) const
+    {
+        out.clear();
+        if (tree.nodes.empty() || low.x > high.x)
+            return;
+        const float thetaSq = theta * theta;
+        std::vector<unsigned int> stack(1, 0);
+        while (!stack.empty())
+        {
+            const BarnesHutTree::Node& node = tree.nodes[stack.back()];
+            stack.pop_back();
+            if (node.mass <= 0.0f)
+                continue;
+            if (node.firstChild < 0)
+            {
+                for (unsigned int k = node.begin; k < node.end; k++)
+                {
+                    const unsigned int j = tree.indices[k];
+                    out.push_back(LetParticle{treePositions[j], treeMasses[j]});
+                }
+                continue;
+            }
+            const float size = 2.0f * node.halfSize;
+            const float distSq = distanceSqToBox(node.centerOfMass, low, high);
+            // the cell must also not overlap the box, a probe inside it always opens it
+            const glm::vec3 nodeLow = node.center - glm::vec3(node.halfSize), nodeHigh = node.center + glm::vec3(node.halfSize);
+            const bool overlaps = glm::all(glm::lessThanEqual(nodeLow, high)) && glm::all(glm::lessThanEqual(low, nodeHigh));
+            if (!overlaps && size * size < thetaSq * distSq)
+                out.push_back(LetParticle{node.centerOfMass, node.mass});
+            else
+                for (unsigned int c = 0; c < node.childCount; c++)
+                    stack.push_back(static_cast<unsigned int>(node.firstChild) + c);
+        }
+    }
+
+    void computeForces()
+    {
+        PROFILE_SCOPE("DistributedNBody::computeForces");
+        const size_t n = local.size();
+        double start = MPI_Wtime();
+        treePositions.resize(n);
+        treeMasses.resize(n);
+        glm::vec3 low(1e30f), high(-1e30f);
+        for (size_t i = 0; i < n; i++)
+        {
+            treePositions[i] = glm::vec3(local[i].position - origin);
+            treeMasses[i] = local[i].mass;
+            low = glm::min(low, treePositions[i]);
+            high = glm::max(high, treePositions[i]);
+        }
+        tree.build(treePositions.data(), treeMasses.data(), n);
+
+        // every rank's box, then the part of the local tree each of the others needs
+        boxes.resize(2 * rankCount);
+        const glm::vec3 box[2] = {low, high};
+        MPI_Allgather(box, static_cast<int>(sizeof(box)), MPI_BYTE, boxes.data(), static_cast<int>(sizeof(box)), MPI_BYTE, comm);
+        outgoing.resize(rankCount);
+        workerPool().parallelFor(0, static_cast<size_t>(rankCount), [&](size_t begin, size_t end, unsigned int) {
+            for (size_t r = begin; r < end; r++)
+            {
+                if (static_cast<int>(r) == rankIndex) outgoing[r].clear();
+                else essentialParticles(boxes[2 * r], boxes[2 * r + 1], outgoing[r]);
+            }
+        }, threads);
+        std::vector<LetParticle> send;
+        std::vector<int> sendCounts(rankCount);
+        for (int r = 0; r < rankCount; r++)
+        {
+            send.insert(send.end(), outgoing[r].begin(), outgoing[r].end());
+            sendCounts[r] = static_cast<int>(outgoing[r].size() * sizeof(LetParticle));
+        }
+        exchange(send, sendCounts, incoming);
+        stats.imported = incoming.size();
+        stats.letSeconds = MPI_Wtime() - start;
+
+        // one tree over the local bodies, first so their index is their tree index, and everything imported
+        start = MPI_Wtime();
+        treePositions.resize(n + incoming.size());
+        treeMasses.resize(n + incoming.size());
+        for (size_t k = 0; k < incoming.size(); k++)
+        {
+            treePositions[n + k] = incoming[k].position;
+            treeMasses[n + k] = incoming[k].mass;
+        }
+        tree.build(treePositions.data(), treeMasses.data(), treePositions.size());
+        stats.treeSeconds = MPI_Wtime() - start;
+
+        start = MPI_Wtime();
+        terms.assign(n, 0);
+        workerPool().parallelFor(0, n, [&](size_t begin, size_t end, unsigned int) {
+            for (size_t i = begin; i < end; i++)
+                local[i].acceleration = G * tree.accelerationAt(treePositions[i], theta, epsilonSq, &terms[i]);
+        }, threads);
+        stats.forceSeconds = MPI_Wtime() - start;
+        for (unsigned long long t : terms) stats.interactions += t;
+        const double secondsPerTerm = stats.interactions > 0 ? stats.forceSeconds / stats.interactions : 0.0;
+        for (size_t i = 0; i < n; i++)
+            local[i].cost = static_cast<float>(terms[i] * secondsPerTerm);
+
+        double times[2] = {stats.forceSeconds, stats.forceSeconds};
+        MPI_Allreduce(MPI_IN_PLACE, times, 1, MPI_DOUBLE, MPI_MAX, comm);
+        MPI_Allreduce(MPI_IN_PLACE, times + 1, 1, MPI_DOUBLE, MPI_SUM, comm);
+        const double mean = times[1] / rankCount;
+        lastImbalance = stats.imbalance = mean > 0.0 ? times[0] / mean : 1.0;
+    }
+};
+
+#endif
@@ -0,0 +1,248 @@
+#ifndef EPHEMERIS_H
+#define EPHEMERIS_H
+
+#include <glm.hpp>
+#include <gtc/constants.hpp>
+
+#include <body_store.h>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <functional>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+// Planet positions looked up instead of integrated, the way JPL's DE files store them: each target's time span is
+// cut into equal segments and every coordinate over a segment is a Chebyshev series in the time scaled to [-1, 1].
+// position() sums it by the recurrence and velocity() by its derivative's, so a target costs the same few dozen
+// multiply-adds at any time in the span, one step or a million from the last. Outside the span the series is
+// evaluated at the nearest end.
+//
+// The file is a header, the target table and the coefficients as doubles, per target segment after segment and
+// within a segment the x, then the y, then the z series. A target names the body it stands for by type and ordinal
+// within the type (the first planet is BODY_PLANET 0), the same bodies whether they came from the built-in scene,
+// a scenario file or a snapshot. fit() makes the coefficients from any function of time, sampled at each
+// segment's Chebyshev nodes, where the interpolating series is close to the best one of its degree.
+class Ephemeris
+{
+public:
+    static const uint32_t MAX_COEFFICIENTS = 32;
+
+    struct Target
+    {
+        std::string name;
+        BodyType type = BODY_PLANET;
+        uint32_t ordinal = 0;
+        uint32_t coefficients = 0;  // per coordinate per segment, the degree plus one
+        uint32_t segments = 0;
+        double mass = 0.0;          // the mass it was fitted with, for reference
+        size_t offset = 0;          // first coefficient in coefficients()
+    };
+
+    double start = 0.0;
+    double end = 0.0;
+
+    bool empty() const { return targets.empty(); }
+    size_t targetCount() const { return targets.size(); }
+    const Target& target(size_t k) const { return targets[k]; }
+    // the target standing for the ordinal-th body of type, or -1
+    int targetFor(BodyType type, uint32_t ordinal) const
+    {
+        for (size_t k = 0; k < targets.size(); k++)
+            if (targets[k].type == type && targets[k].ordinal == ordinal)
+                return static_cast<int>(k);
+        return -1;
+    }
+    double segmentLength(size_t k) const { return (end - start) / targets[k].segments; }
+    size_t bytes() const { return coefficientData.size() * sizeof(double); }
+
+    void clear()
+    {
+        targets.clear();
+        coefficientData.clear();
+        start = end = 0.0;
+    }
+
+    glm::dvec3 position(size_t k, double t) const
+    {
+        glm::dvec3 p, v;
+        evaluate(k, t, p, v, false);
+        return p;
+    }
+
+    void evaluate(size_t k, double t, glm::dvec3& position, glm::dvec3& velocity) const
+    {
+        evaluate(k, t, position, velocity, true);
+    }
+
+    // appends a target and fits coefficients - 1 degree series to sample(time) over segments equal parts of
+    // [start, end), which have to be set first
+    void fit(const std::string& name, BodyType type, uint32_t ordinal, double mass, uint32_t coefficients, uint32_t segments,
+             const std::function<glm::dvec3(double)>& sample)
+    {
+        Target target;
+        target.name = name;
+        target.type = type;
+        target.ordinal = ordinal;
+        target.mass = mass;
+        target.coefficients = std::clamp(coefficients, 2u, MAX_COEFFICIENTS);
+        target.segments = std::max(segments, 1u);
+        target.offset = coefficientData.size();
+        const uint32_t n = target.coefficients;
+        const double length = (end - start) / target.segments;
+        coefficientData.resize(target.offset + static_cast<size_t>(target.segments) * 3 * n, 0.0);
+        std::vector<glm::dvec3> values(n);
+        std::vector<double> nodes(n);
+        for (uint32_t j = 0; j < n; j++)
+            nodes[j] = std::cos(glm::pi<double>() * (j + 0.5) / n);
+        for (uint32_t s = 0; s < target.segments; s++)
+        {
+            const double mid = start + (s + 0.5) * length;
+            for (uint32_t j = 0; j < n; j++)
+                values[j] = sample(mid + 0.5 * length * nodes[j]);
+            // c_i = 2/n sum_j f(x_j) T_i(x_j), the first halved; T_i(cos a) = cos(i a)
+            double* c = coefficientData.data() + target.offset + static_cast<size_t>(s) * 3 * n;
+            for (uint32_t i = 0; i < n; i++)
+            {
+                glm::dvec3 sum(0.0);
+                for (uint32_t j = 0; j < n; j++)
+                    sum += values[j] * std::cos(glm::pi<double>() * i * (j + 0.5) / n);
+                sum *= (i == 0 ? 1.0 : 2.0) / n;
+                c[i] = sum.x;
+                c[n + i] = sum.y;
+                c[2 * n + i] = sum.z;
+            }
+        }
+        targets.push_back(target);
+    }
+
+    bool write(const std::string& path) const
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+        Header header{};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.targets = static_cast<uint32_t>(targets.size());
+        header.start = start;
+        header.end = end;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const Target& t : targets)
+        {
+            TargetRecord record{};
+            std::strncpy(record.name, t.name.c_str(), sizeof(record.name) - 1);
+            record.type = t.type;
+            record.ordinal = t.ordinal;
+            record.coefficients = t.coefficients;
+            record.segments = t.segments;
+            record.mass = t.mass;
+            record.offset = t.offset;
+            out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        }
+        out.write(reinterpret_cast<const char*>(coefficientData.data()), static_cast<std::streamsize>(bytes()));
+        return static_cast<bool>(out);
+    }
+
+    // false, leaving it empty, if the file cannot be read or its table does not match its coefficients
+    bool load(const std::string& path)
+    {
+        clear();
+        std::ifstream in(path, std::ios::binary);
+        Header header{};
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+            || !(header.end > header.start))
+            return false;
+        std::vector<Target> table(header.targets);
+        size_t total = 0;
+        for (Target& t : table)
+        {
+            TargetRecord record{};
+            if (!in.read(reinterpret_cast<char*>(&record), sizeof(record)) || record.type >= BODY_TYPE_COUNT
+                || record.coefficients < 2 || record.coefficients > MAX_COEFFICIENTS || record.segments == 0
+                || record.offset != total)
+                return false;
+            record.name[sizeof(record.name) - 1] = '\0';
+            t.name = record.name;
+            t.type = static_cast<BodyType>(record.type);
+            t.ordinal = record.ordinal;
+            t.coefficients = record.coefficients;
+            t.segments = record.segments;
+            t.mass = record.mass;
+            t.offset = static_cast<size_t>(record.offset);
+            total += static_cast<size_t>(t.segments) * 3 * t.coefficients;
+        }
+        std::vector<double> data(total);
+        if (!in.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(total * sizeof(double))))
+            return false;
+        targets.swap(table);
+        coefficientData.swap(data);
+        start = header.start;
+        end = header.end;
+        return true;
+    }
+
+private:
+    static constexpr char MAGIC[8] = {'N', 'P', 'S', 'C', 'E', 'P', 'H', '1'};
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t targets;
+        uint32_t reserved;
+        double start;
+        double end;
+    };
+
+    struct TargetRecord
+    {
+        char name[24];
+        uint32_t type;
+        uint32_t ordinal;
+        uint32_t coefficients;
+        uint32_t segments;
+        double mass;
+        uint64_t offset;        // in doubles from the start of the coefficients
+    };
+
+    static_assert(sizeof(Header) == 32 && sizeof(TargetRecord) == 56, "ephemeris layout");
+
+    std::vector<Target> targets;
+    std::vector<double> coefficientData;
+
+    // T_i and T_i' by T_i = 2x T_(i-1) - T_(i-2) and T_i' = 2 T_(i-1) + 2x T_(i-1)' - T_(i-2)'
+    void evaluate(size_t k, double t, glm::dvec3& position, glm::dvec3& velocity, bool withVelocity) const
+    {
+        const Target& target = targets[k];
+        const uint32_t n = target.coefficients;
+        const double length = (end - start) / target.segments;
+        const double clamped = std::clamp(t, start, end);
+        const uint32_t s = std::min(static_cast<uint32_t>((clamped - start) / length), target.segments - 1);
+        const double x = 2.0 * (clamped - start - s * length) / length - 1.0;
+        const double* c = coefficientData.data() + target.offset + static_cast<size_t>(s) * 3 * n;
+        double T[MAX_COEFFICIENTS], dT[MAX_COEFFICIENTS];
+        T[0] = 1.0;
+        T[1] = x;
+        dT[0] = 0.0;
+        dT[1] = 1.0;
+        for (uint32_t i = 2; i < n; i++)
+        {
+            T[i] = 2.0 * x * T[i - 1] - T[i - 2];
+            dT[i] = 2.0 * T[i - 1] + 2.0 * x * dT[i - 1] - dT[i - 2];
+        }
+        position = glm::dvec3(0.0);
+        velocity = glm::dvec3(0.0);
+        for (uint32_t i = 0; i < n; i++)
+            position += T[i] * glm::dvec3(c[i], c[n + i], c[2 * n + i]);
+        if (!withVelocity)
+            return;
+        for (uint32_t i = 1; i < n; i++)
+            velocity += dT[i] * glm::dvec3(c[i], c[n + i], c[2 * n + i]);
+        // dx/dt of the scaled time
+        velocity *= 2.0 / length;
+    }
+};
+
+#endif
@@ -0,0 +1,424 @@
+#ifndef FMM_H
+#define FMM_H
+
+#include <glm.hpp>
+
+#include <barnes_hut.h>
+#include <thread_pool.h>
+
+#include <vector>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+
+// Fast multipole method for O(N) gravity, built on the Barnes-Hut octree.
+// Cells carry Cartesian Taylor expansions up to a configurable order: multipoles about the cell's center of mass
+// (built leaf to root), and local expansions of the far field inside the cell (pushed root to leaf). A dual tree
+// walk decides per pair of cells whether they are far enough apart to interact through their expansions or have
+// to be opened, leaf pairs that are too close are summed directly with the same softened pair term as the tree.
+// The walk is split into independent subtrees, one task per subtree of targets, so no two tasks write one cell.
+//
+// Conventions: for a multi-index n = (nx, ny, nz), x^n = x^nx y^ny z^nz and n! = nx! ny! nz!.
+// Multipoles are M_n = sum_j m_j (x_j - z)^n / n!, the potential (without G) is phi(x) = -sum_n (-1)^|n| M_n D_n(x - z)
+// with D_n the derivatives of 1/r, and the local expansion about w is phi(w + y) = sum_k L_k y^k / k!.
+class FastMultipole
+{
+public:
+    static constexpr unsigned int MAX_ORDER = 8;
+
+    unsigned int order = 4;             // highest total degree of the expansions
+    float theta = 0.5f;                 // cells interact when (r_a + r_b) < theta * distance
+    unsigned int leafCapacity = 64;     // much larger leaves than Barnes-Hut, the near field loops are contiguous
+
+    BarnesHutTree tree;
+
+    // writes the acceleration (without G) of every body into accelerations, and its potential -sum m/r into
+    // potentials if given. Positions are the tree's float positions, the expansions are accumulated in double.
+    void evaluate(const glm::vec3* positions, const float* masses, size_t count, float epsilonSq,
+                  glm::vec3* accelerations, unsigned int maxThreads, unsigned long long* interactions = nullptr,
+                  float* potentials = nullptr)
+    {
+        tree.leafCapacity = leafCapacity;
+        tree.build(positions, masses, count);
+        if (tree.nodes.empty())
+            return;
+        setOrder(std::clamp(order, 1u, MAX_ORDER));
+        epsSq = epsilonSq;
+        withPotential = potentials != nullptr;
+
+        // bodies are copied into tree order, so every cell's bodies are one contiguous run of each array
+        x.resize(count); y.resize(count); z.resize(count); m.resize(count);
+        ax.assign(count, 0.0f); ay.assign(count, 0.0f); az.assign(count, 0.0f);
+        if (withPotential) phi.assign(count, 0.0f);
+        for (size_t k = 0; k < count; k++)
+        {
+            const unsigned int i = tree.indices[k];
+            x[k] = positions[i].x; y[k] = positions[i].y; z[k] = positions[i].z;
+            m[k] = masses[i];
+        }
+
+        const size_t nodeCount = tree.nodes.size();
+        multipole.assign(nodeCount * terms.size(), 0.0);
+        local.assign(nodeCount * terms.size(), 0.0);
+        expansionCenter.resize(nodeCount);
+        radius.resize(nodeCount);
+        splitTasks(std::max(maxThreads, 1u));
+
+        // upward pass: each task subtree on its own, then the few cells above them
+        workerPool().parallelFor(0, tasks.size(), [&](size_t begin, size_t end, unsigned int) {
+            for (size_t t = begin; t < end; t++)
+                upward(tasks[t]);
+        }, maxThreads);
+        for (size_t k = topCells.size(); k-- > 0;)
+            combineChildren(topCells[k]);
+
+        // every target subtree walks against the whole tree, then pushes its locals down to its bodies
+        sliceTerms.assign(workerPool().size(), 0);
+        workerPool().parallelFor(0, tasks.size(), [&](size_t begin, size_t end, unsigned int slice) {
+            std::vector<double> derivatives(terms.size());
+            for (size_t t = begin; t < end; t++)
+            {
+                interact(tasks[t], 0, derivatives, sliceTerms[slice]);
+                downward(tasks[t]);
+            }
+        }, maxThreads);
+        for (size_t k = 0; k < count; k++)
+            accelerations[tree.indices[k]] = glm::vec3(ax[k], ay[k], az[k]);
+        if (withPotential)
+            for (size_t k = 0; k < count; k++)
+                potentials[tree.indices[k]] = phi[k];
+        if (interactions)
+            for (unsigned long long c : sliceTerms) *interactions += c;
+    }
+
+private:
+    struct Term
+    {
+        unsigned int i[3];
+        unsigned int degree;
+    };
+    // a term pair of one of the shift sums below, as indices into terms
+    struct Split
+    {
+        unsigned int a, b;
+    };
+
+    static constexpr unsigned int MAX_TERMS = (MAX_ORDER + 1) * (MAX_ORDER + 2) * (MAX_ORDER + 3) / 6;
+
+    unsigned int currentOrder = 0;
+    std::vector<Term> terms;                    // all multi-indices with degree <= order, by increasing degree
+    std::vector<double> inverseFactorial;       // 1 / n! per term
+    unsigned int termIndex[MAX_ORDER + 1][MAX_ORDER + 1][MAX_ORDER + 1];
+    // per term n, the pairs (j, n - j) with j <= n componentwise (M2M)
+    std::vector<std::vector<Split>> shiftUp;
+    // per term k, the pairs (n, n + k) with |n| + |k| <= order (M2L), and (j, k + j) for L2L
+    std::vector<std::vector<Split>> shiftAcross;
+    std::vector<double> sign;                   // (-1)^|n|
+
+    float epsSq = 0.0f;
+    bool withPotential = false;
+    std::vector<float> x, y, z, m;              // bodies in tree order
+    std::vector<float> ax, ay, az, phi;
+
+    std::vector<double> multipole, local;
+    std::vector<glm::dvec3> expansionCenter;
+    std::vector<double> radius;                 // distance from the expansion center to the farthest body
+    std::vector<unsigned int> tasks;            // roots of the independent target subtrees
+    std::vector<unsigned int> topCells;         // cells above the task roots, parents before children
+    std::vector<unsigned long long> sliceTerms;
+
+    void setOrder(unsigned int p)
+    {
+        if (p == currentOrder)
+            return;
+        currentOrder = p;
+        terms.clear();
+        inverseFactorial.clear();
+        sign.clear();
+        for (unsigned int d = 0; d <= p; d++)
+            for (unsigned int x = d + 1; x-- > 0;)
+                for (unsigned int y = d - x + 1; y-- > 0;)
+                {
+                    unsigned int z = d - x - y;
+                    termIndex[x][y][z] = static_cast<unsigned int>(terms.size());
+                    terms.push_back(Term{{x, y, z}, d});
+                    inverseFactorial.push_back(1.0 / (factorial(x) * factorial(y) * factorial(z)));
+                    sign.push_back(d % 2 ? -1.0 : 1.0);
+                }
+        const size_t t = terms.size();
+        shiftUp.assign(t, {});
+        shiftAcross.assign(t, {});
+        for (size_t n = 0; n < t; n++)
+            for (size_t j = 0; j < t; j++)
+            {
+                const Term& a = terms[n];
+                const Term& b = terms[j];
+                if (b.i[0] <= a.i[0] && b.i[1] <= a.i[1] && b.i[2] <= a.i[2])
+                    shiftUp[n].push_back(Split{static_cast<unsigned int>(j), index(a.i[0] - b.i[0], a.i[1] - b.i[1], a.i[2] - b.i[2])});
+                if (a.degree + b.degree <= p)
+                    shiftAcross[n].push_back(Split{static_cast<unsigned int>(j), index(a.i[0] + b.i[0], a.i[1] + b.i[1], a.i[2] + b.i[2])});
+            }
+    }
+
+    static double factorial(unsigned int n)
+    {
+        double f = 1.0;
+        for (unsigned int k = 2; k <= n; k++) f *= k;
+        return f;
+    }
+
+    unsigned int index(unsigned int x, unsigned int y, unsigned int z) const { return termIndex[x][y][z]; }
+
+    // d^n / n! for every term
+    void monomials(const glm::dvec3& d, double* out) const
+    {
+        double px[MAX_ORDER + 1], py[MAX_ORDER + 1], pz[MAX_ORDER + 1];
+        px[0] = py[0] = pz[0] = 1.0;
+        for (unsigned int k = 1; k <= currentOrder; k++)
+        {
+            px[k] = px[k - 1] * d.x;
+            py[k] = py[k - 1] * d.y;
+            pz[k] = pz[k - 1] * d.z;
+        }
+        for (size_t n = 0; n < terms.size(); n++)
+            out[n] = px[terms[n].i[0]] * py[terms[n].i[1]] * pz[terms[n].i[2]] * inverseFactorial[n];
+    }
+
+    // D_n(r) = d^n (1/|r|) for every term, from the recurrence obtained by differentiating r^2 d_i(1/r) = -r_i / r
+    void derivatives(const glm::dvec3& r, double* out) const
+    {
+        const double invRSq = 1.0 / glm::dot(r, r);
+        out[0] = std::sqrt(invRSq);
+        for (size_t n = 1; n < terms.size(); n++)
+        {
+            const unsigned int* e = terms[n].i;
+            unsigned int axis = e[0] > 0 ? 0 : e[1] > 0 ? 1 : 2;
+            double sum = 0.0;
+            for (unsigned int j = 0; j < 3; j++)
+            {
+                if (e[j] == 0)
+                    continue;
+                unsigned int m[3] = {e[0], e[1], e[2]};
+                m[j] -= 1;
+                double once = (j == axis ? 2.0 * e[j] - 1.0 : 2.0 * e[j]) * r[j] * out[index(m[0], m[1], m[2])];
+                double twice = 0.0;
+                if (e[j] >= 2)
+                {
+                    m[j] -= 1;
+                    double c = j == axis ? (e[j] - 1.0) * (e[j] - 1.0) : e[j] * (e[j] - 1.0);
+                    twice = c * out[index(m[0], m[1], m[2])];
+                }
+                sum += once + twice;
+            }
+            out[n] = -sum * invRSq;
+        }
+    }
+
+    // breadth-first split of the tree into enough subtrees to keep every thread busy
+    void splitTasks(unsigned int threads)
+    {
+        const size_t wanted = threads > 1 ? 8 * static_cast<size_t>(threads) : 1;
+        tasks.assign(1, 0);
+        topCells.clear();
+        while (tasks.size() < wanted)
+        {
+            std::vector<unsigned int> next;
+            bool split = false;
+            for (unsigned int c : tasks)
+            {
+                const BarnesHutTree::Node& node = tree.nodes[c];
+                if (node.firstChild < 0)
+                {
+                    next.push_back(c);
+                    continue;
+                }
+                topCells.push_back(c);
+                for (unsigned int k = 0; k < node.childCount; k++)
+                    next.push_back(static_cast<unsigned int>(node.firstChild) + k);
+                split = true;
+            }
+            tasks.swap(next);
+            if (!split)
+                break;
+        }
+    }
+
+    void upward(unsigned int c)
+    {
+        const BarnesHutTree::Node& node = tree.nodes[c];
+        if (node.firstChild < 0)
+        {
+            // P2M
+            const glm::dvec3 center = node.mass > 0.0f ? glm::dvec3(node.centerOfMass) : glm::dvec3(node.center);
+            expansionCenter[c] = center;
+            double* M = &multipole[c * terms.size()];
+            double mono[MAX_TERMS];
+            double r = 0.0;
+            for (unsigned int k = node.begin; k < node.end; k++)
+            {
+                glm::dvec3 d = glm::dvec3(x[k], y[k], z[k]) - center;
+                r = std::max(r, glm::length(d));
+                monomials(d, mono);
+                for (size_t n = 0; n < terms.size(); n++)
+                    M[n] += m[k] * mono[n];
+            }
+            radius[c] = r;
+            return;
+        }
+        for (unsigned int k = 0; k < node.childCount; k++)
+            upward(static_cast<unsigned int>(node.firstChild) + k);
+        combineChildren(c);
+    }
+
+    // M2M: shifts the children's multipoles to this cell's center
+    void combineChildren(unsigned int c)
+    {
+        const BarnesHutTree::Node& node = tree.nodes[c];
+        const glm::dvec3 center = node.mass > 0.0f ? glm::dvec3(node.centerOfMass) : glm::dvec3(node.center);
+        expansionCenter[c] = center;
+        double* M = &multipole[c * terms.size()];
+        double mono[MAX_TERMS];
+        double r = 0.0;
+        for (unsigned int k = 0; k < node.childCount; k++)
+        {
+            const unsigned int child = static_cast<unsigned int>(node.firstChild) + k;
+            const glm::dvec3 d = expansionCenter[child] - center;
+            r = std::max(r, glm::length(d) + radius[child]);
+            monomials(d, mono);
+            const double* Mc = &multipole[child * terms.size()];
+            for (size_t n = 0; n < terms.size(); n++)
+            {
+                double sum = 0.0;
+                for (const Split& s : shiftUp[n])
+                    sum += mono[s.a] * Mc[s.b];
+                M[n] += sum;
+            }
+        }
+        radius[c] = r;
+    }
+
+    // dual tree walk, accumulates into the locals of target cell t and the accelerations of its bodies
+    void interact(unsigned int t, unsigned int s, std::vector<double>& D, unsigned long long& count)
+    {
+        const BarnesHutTree::Node& target = tree.nodes[t];
+        const BarnesHutTree::Node& source = tree.nodes[s];
+        if (source.mass <= 0.0f)
+            return;
+        const glm::dvec3 R = expansionCenter[t] - expansionCenter[s];
+        const double distSq = glm::dot(R, R);
+        const double reach = radius[t] + radius[s];
+        if (t != s && reach * reach < static_cast<double>(theta) * theta * distSq)
+        {
+            // M2L
+            derivatives(R, D.data());
+            const double* M = &multipole[s * terms.size()];
+            double* L = &local[t * terms.size()];
+            for (size_t k = 0; k < terms.size(); k++)
+            {
+                double sum = 0.0;
+                for (const Split& p : shiftAcross[k])
+                    sum += sign[p.a] * M[p.a] * D[p.b];
+                L[k] -= sum;
+            }
+            count++;
+            return;
+        }
+        const bool targetLeaf = target.firstChild < 0, sourceLeaf = source.firstChild < 0;
+        if (targetLeaf && sourceLeaf)
+        {
+            // P2P, the same softened term as BarnesHutTree::pairAcceleration over contiguous runs. A body meets
+            // itself at zero separation, which is masked out rather than branched on so the loop vectorizes.
+            for (unsigned int a = target.begin; a < target.end; a++)
+            {
+                const float xi = x[a], yi = y[a], zi = z[a];
+                float sx = 0.0f, sy = 0.0f, sz = 0.0f;
+                for (unsigned int b = source.begin; b < source.end; b++)
+                {
+                    const float dx = x[b] - xi, dy = y[b] - yi, dz = z[b] - zi;
+                    const float distSq = dx * dx + dy * dy + dz * dz;
+                    const float invR = 1.0f / std::sqrt(std::max(distSq, epsSq));
+                    const float f = distSq > 0.0f ? m[b] * invR * invR * invR : 0.0f;
+                    sx += dx * f; sy += dy * f; sz += dz * f;
+                }
+                ax[a] += sx; ay[a] += sy; az[a] += sz;
+            }
+            if (withPotential)
+                for (unsigned int a = target.begin; a < target.end; a++)
+                {
+                    float sum = 0.0f;
+                    for (unsigned int b = source.begin; b < source.end; b++)
+                    {
+                        const float dx = x[b] - x[a], dy = y[b] - y[a], dz = z[b] - z[a];
+                        const float distSq = dx * dx + dy * dy + dz * dz;
+                        sum -= distSq > 0.0f ? m[b] / std::sqrt(std::max(distSq, epsSq)) : 0.0f;
+                    }
+                    phi[a] += sum;
+                }
+            count += static_cast<unsigned long long>(target.end - target.begin) * (source.end - source.begin);
+            return;
+        }
+        // open the larger cell, or the one that is not a leaf
+        if (sourceLeaf || (!targetLeaf && radius[t] >= radius[s]))
+        {
+            for (unsigned int k = 0; k < target.childCount; k++)
+                interact(static_cast<unsigned int>(target.firstChild) + k, s, D, count);
+        }
+        else
+        {
+            for (unsigned int k = 0; k < source.childCount; k++)
+                interact(t, static_cast<unsigned int>(source.firstChild) + k, D, count);
+        }
+    }
+
+    // L2L down to the leaves, then L2P: a = -grad phi
+    void downward(unsigned int c)
+    {
+        const BarnesHutTree::Node& node = tree.nodes[c];
+        const double* L = &local[c * terms.size()];
+        double mono[MAX_TERMS];
+        if (node.firstChild >= 0)
+        {
+            for (unsigned int k = 0; k < node.childCount; k++)
+            {
+                const unsigned int child = static_cast<unsigned int>(node.firstChild) + k;
+                monomials(expansionCenter[child] - expansionCenter[c], mono);
+                double* Lc = &local[child * terms.size()];
+                for (size_t n = 0; n < terms.size(); n++)
+                {
+                    double sum = 0.0;
+                    for (const Split& p : shiftAcross[n])
+                        sum += L[p.b] * mono[p.a];
+                    Lc[n] += sum;
+                }
+                downward(child);
+            }
+            return;
+        }
+        for (unsigned int k = node.begin; k < node.end; k++)
+        {
+            monomials(glm::dvec3(x[k], y[k], z[k]) - expansionCenter[c], mono);
+            glm::dvec3 gradient(0.0);
+            if (withPotential)
+            {
+                double value = 0.0;
+                for (size_t n = 0; n < terms.size(); n++)
+                    value += L[n] * mono[n];
+                phi[k] += static_cast<float>(value);
+            }
+            for (size_t n = 0; n < terms.size(); n++)
+            {
+                const Term& e = terms[n];
+                if (e.degree == currentOrder)
+                    break;
+                gradient.x += L[index(e.i[0] + 1, e.i[1], e.i[2])] * mono[n];
+                gradient.y += L[index(e.i[0], e.i[1] + 1, e.i[2])] * mono[n];
+                gradient.z += L[index(e.i[0], e.i[1], e.i[2] + 1)] * mono[n];
+            }
+            ax[k] -= static_cast<float>(gradient.x);
+            ay[k] -= static_cast<float>(gradient.y);
+            az[k] -= static_cast<float>(gradient.z);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,223 @@
+#ifndef FORCE_KERNELS_H
+#define FORCE_KERNELS_H
+
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+
+// Pairwise gravity put together from three policies at compile time, so each combination is its own inner loop with
+// the law, the arithmetic and the walk over the sources inlined and nothing tested per pair:
+//   force law      what a squared separation does to the pull: Newtonian with r^2 floored at the softening, Plummer
+//                  (r^2 + eps^2) or the cubic spline of Monaghan and Lattanzio, exactly Newtonian beyond its kernel
+//   precision      the type a pair is worked out in and the one its terms are summed in
+//   interaction    the sources of a target: a contiguous run of SoA arrays (every pair of a range, or the compact
+//                  massive-only list) or a tree leaf's bodies through its index range
+// A body meets itself at zero separation, where each law's factor is finite and the separation zero, so its own
+// term vanishes without an i == j test; the potential drops it with a select on d2 > 0. ForceLaw and ForcePrecision
+// are the runtime choices, dispatched once per call outside the loops (gravity_kernels.h, barnes_hut.h).
+
+enum ForceLaw {
+    FORCE_NEWTONIAN = 0,
+    FORCE_PLUMMER = 1,
+    FORCE_SPLINE = 2,
+    FORCE_LAWS = 3
+};
+
+enum ForcePrecision {
+    PRECISION_FLOAT = 0,
+    PRECISION_DOUBLE = 1,
+    PRECISION_MIXED = 2,        // pairs in float, sums in double
+    FORCE_PRECISIONS = 3
+};
+
+inline const char* forceLawName(ForceLaw law)
+{
+    static const char* names[FORCE_LAWS] = {"newtonian", "plummer", "spline"};
+    return names[law];
+}
+
+inline const char* forcePrecisionName(ForcePrecision precision)
+{
+    static const char* names[FORCE_PRECISIONS] = {"float", "double", "mixed"};
+    return names[precision];
+}
+
+struct FloatPrecision
+{
+    typedef float Real;
+    typedef float Accum;
+};
+
+struct DoublePrecision
+{
+    typedef double Real;
+    typedef double Accum;
+};
+
+// a target summing thousands of small terms against a few large ones keeps the small ones
+struct MixedPrecision
+{
+    typedef float Real;
+    typedef double Accum;
+};
+
+// evaluate() gives the factor the separation is scaled by per unit source mass, and with Potential the potential
+// per unit mass; the laws are built once per call from the world's epsilonSq
+
+// 1/r^3 with r^2 floored at epsilonSq, the engine's own law. A zero softening keeps a floor small enough to change
+// nothing and large enough that the self pair's 1/r^3 stays finite in float.
+template <typename Real>
+struct NewtonianLaw
+{
+    Real floor;
+
+    explicit NewtonianLaw(float epsilonSq) : floor(static_cast<Real>(std::max(epsilonSq, 1e-20f))) {}
+
+    template <bool Potential>
+    void evaluate(Real d2, Real& factor, Real& potential) const
+    {
+        const Real invR = Real(1) / std::sqrt(std::max(d2, floor));
+        factor = invR * invR * invR;
+        if (Potential) potential = -invR;
+    }
+};
+
+// r^2 + epsilonSq everywhere, the pull of a Plummer sphere of scale sqrt(epsilonSq)
+template <typename Real>
+struct PlummerLaw
+{
+    Real epsilonSq;
+
+    explicit PlummerLaw(float epsilonSq) : epsilonSq(static_cast<Real>(std::max(epsilonSq, 1e-20f))) {}
+
+    template <bool Potential>
+    void evaluate(Real d2, Real& factor, Real& potential) const
+    {
+        const Real invR = Real(1) / std::sqrt(d2 + epsilonSq);
+        factor = invR * invR * invR;
+        if (Potential) potential = -invR;
+    }
+};
+
+// the cubic spline kernel of extent h = 2.8 sqrt(epsilonSq), the same potential depth at the centre as a Plummer
+// softening of epsilon and exactly Newtonian from h out. The three pieces are all evaluated and selected, each on
+// arguments clamped to its own range so none overflows where it is not used.
+template <typename Real>
+struct SplineLaw
+{
+    Real h, invH, invH3;
+
+    explicit SplineLaw(float epsilonSq)
+        : h(static_cast<Real>(2.8 * std::sqrt(std::max(static_cast<double>(epsilonSq), 1e-20)))), invH(Real(1) / h),
+          invH3(invH * invH * invH) {}
+
+    template <bool Potential>
+    void evaluate(Real d2, Real& factor, Real& potential) const
+    {
+        const Real r = std::sqrt(d2);
+        const Real u = r * invH;
+        const Real uOuter = std::max(u, Real(0.5));
+        const Real u3 = uOuter * uOuter * uOuter;
+        const Real inner = invH3 * (Real(10.666666666667) + u * u * (Real(32.0) * u - Real(38.4)));
+        const Real outer = invH3 * (Real(21.333333333333) - Real(48.0) * uOuter + Real(38.4) * uOuter * uOuter -
+                                    Real(10.666666666667) * u3 - Real(0.066666666667) / u3);
+        const Real invR = Real(1) / std::max(r, h);
+        factor = u >= Real(1) ? invR * invR * invR : (u < Real(0.5) ? inner : outer);
+        if (Potential)
+        {
+            const Real innerPotential = invH * (Real(-2.8) + u * u * (Real(5.333333333333) + u * u * (Real(6.4) * u - Real(9.6))));
+            const Real outerPotential = invH * (Real(-3.2) + Real(0.066666666667) / uOuter +
+                                                uOuter * uOuter * (Real(10.666666666667) + uOuter * (Real(-16.0) + uOuter * (Real(9.6) - Real(2.133333333333) * uOuter))));
+            potential = u >= Real(1) ? -invR : (u < Real(0.5) ? innerPotential : outerPotential);
+        }
+    }
+};
+
+// sources [begin, end) of separate x/y/z/m arrays, a GravitySoA's
+struct SourceRun
+{
+    const float* x;
+    const float* y;
+    const float* z;
+    const float* m;
+    size_t begin;
+    size_t end;
+
+    size_t first() const { return begin; }
+    size_t last() const { return end; }
+    float px(size_t k) const { return x[k]; }
+    float py(size_t k) const { return y[k]; }
+    float pz(size_t k) const { return z[k]; }
+    float mass(size_t k) const { return m[k]; }
+};
+
+// the bodies of a tree leaf, indices[begin, end) into strided position and mass storage (barnes_hut.h)
+struct TreeLeaf
+{
+    const unsigned int* indices;
+    const char* positions;      // three floats at each stride
+    const char* masses;
+    size_t positionStride;
+    size_t massStride;
+    size_t begin;
+    size_t end;
+
+    size_t first() const { return begin; }
+    size_t last() const { return end; }
+    const float* position(size_t k) const { return reinterpret_cast<const float*>(positions + indices[k] * positionStride); }
+    float px(size_t k) const { return position(k)[0]; }
+    float py(size_t k) const { return position(k)[1]; }
+    float pz(size_t k) const { return position(k)[2]; }
+    float mass(size_t k) const { return *reinterpret_cast<const float*>(masses + indices[k] * massStride); }
+};
+
+// adds to a target at (x, y, z) the acceleration (without G) and with Potential the potential of every source
+template <typename Law, typename Precision, bool Potential, typename Sources>
+inline void sumSources(const Law& law, const Sources& sources, typename Precision::Real x, typename Precision::Real y,
+                       typename Precision::Real z, typename Precision::Accum& ax, typename Precision::Accum& ay,
+                       typename Precision::Accum& az, typename Precision::Accum& potential)
+{
+    typedef typename Precision::Real Real;
+    typedef typename Precision::Accum Accum;
+    for (size_t k = sources.first(); k < sources.last(); k++)
+    {
+        const Real dx = static_cast<Real>(sources.px(k)) - x;
+        const Real dy = static_cast<Real>(sources.py(k)) - y;
+        const Real dz = static_cast<Real>(sources.pz(k)) - z;
+        const Real d2 = dx * dx + dy * dy + dz * dz;
+        const Real m = static_cast<Real>(sources.mass(k));
+        Real factor, phi = Real(0);
+        law.template evaluate<Potential>(d2, factor, phi);
+        const Real s = m * factor;
+        ax += static_cast<Accum>(dx * s);
+        ay += static_cast<Accum>(dy * s);
+        az += static_cast<Accum>(dz * s);
+        if (Potential) potential += static_cast<Accum>(d2 > Real(0) ? m * phi : Real(0));
+    }
+}
+
+// calls fn with the law and precision policies for the runtime choice, an instantiation of fn per combination
+template <typename Fn>
+inline void withForcePolicies(ForceLaw law, ForcePrecision precision, float epsilonSq, const Fn& fn)
+{
+    switch (law)
+    {
+    case FORCE_PLUMMER:
+        if (precision == PRECISION_DOUBLE) fn(PlummerLaw<double>(epsilonSq), DoublePrecision());
+        else if (precision == PRECISION_MIXED) fn(PlummerLaw<float>(epsilonSq), MixedPrecision());
+        else fn(PlummerLaw<float>(epsilonSq), FloatPrecision());
+        break;
+    case FORCE_SPLINE:
+        if (precision == PRECISION_DOUBLE) fn(SplineLaw<double>(epsilonSq), DoublePrecision());
+        else if (precision == PRECISION_MIXED) fn(SplineLaw<float>(epsilonSq), MixedPrecision());
+        else fn(SplineLaw<float>(epsilonSq), FloatPrecision());
+        break;
+    default:
+        if (precision == PRECISION_DOUBLE) fn(NewtonianLaw<double>(epsilonSq), DoublePrecision());
+        else if (precision == PRECISION_MIXED) fn(NewtonianLaw<float>(epsilonSq), MixedPrecision());
+        else fn(NewtonianLaw<float>(epsilonSq), FloatPrecision());
+        break;
+    }
+}
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <algorithm>
+
+// Linear bump allocator for data that lives at most one frame. allocate() is a pointer bump, reset() at the top of
+// the frame releases everything at once. When a frame needs more than the block holds, the extra comes from
+// overflow blocks and the next reset() grows the block to the frame's high-water mark, so a steady-state frame
+// ends up touching the heap not at all. Nothing allocated here has its destructor run, and it is single-threaded.
+class FrameArena
+{
+public:
+    explicit FrameArena(size_t initialBytes = 64 * 1024)
+    {
+        grow(initialBytes);
+    }
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t))
+    {
+        uintptr_t base = reinterpret_cast<uintptr_t>(block.get());
+        size_t aligned = ((base + offset + alignment - 1) & ~(alignment - 1)) - base;
+        if (aligned + bytes <= capacity)
+        {
+            offset = aligned + bytes;
+            used += bytes;
+            return block.get() + aligned;
+        }
+        // does not fit this frame, served from its own block until the next reset makes room
+        overflow.emplace_back(new unsigned char[bytes + alignment]);
+        used += bytes;
+        uintptr_t raw = reinterpret_cast<uintptr_t>(overflow.back().get());
+        return reinterpret_cast<void*>((raw + alignment - 1) & ~(alignment - 1));
+    }
+
+    // uninitialized storage for n objects, only for types that need no destructor
+    template <typename T>
+    T* allocateArray(size_t n)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "frame arena memory is never destroyed");
+        return static_cast<T*>(allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void reset()
+    {
+        highWater = std::max(highWater, used);
+        if (!overflow.empty())
+        {
+            overflow.clear();
+            grow(highWater + highWater / 2);
+        }
+        offset = 0;
+        used = 0;
+    }
+
+    size_t usedBytes() const { return used; }
+    size_t capacityBytes() const { return capacity; }
+    size_t highWaterBytes() const { return std::max(highWater, used); }
+
+private:
+    std::unique_ptr<unsigned char[]> block;
+    size_t capacity = 0;
+    size_t offset = 0;
+    size_t used = 0;
+    size_t highWater = 0;
+    std::vector<std::unique_ptr<unsigned char[]>> overflow;
+
+    void grow(size_t bytes)
+    {
+        block.reset(new unsigned char[bytes]);
+        capacity = bytes;
+        offset = 0;
+    }
+};
+
+// the render thread's arena, reset by the main loop at the top of every frame
+inline FrameArena& frameArena()
+{
+    static FrameArena arena(1024 * 1024);
+    return arena;
+}
+
+#endif
@@ -0,0 +1,444 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <glad/glad.h>
+
+#include <gpu_memory.h>
+#include <gl_state_cache.h>
+#include <gl_debug.h>
+#include <profiler.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+// PNG files of 8-bit RGB images, written without compression (stored deflate blocks): a 4K screenshot is some
+// 25 MB but costs the writer thread a copy and two checksums, nothing it could fall behind on.
+namespace png {
+
+inline uint32_t crc(const unsigned char* data, size_t length, uint32_t crc = 0)
+{
+    static uint32_t table[256];
+    static bool filled = false;
+    if (!filled)
+    {
+        for (uint32_t n = 0; n < 256; n++)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++)
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+        filled = true;
+    }
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+inline void putBigEndian(std::vector<unsigned char>& out, uint32_t value)
+{
+    for (int shift = 24; shift >= 0; shift -= 8)
+        out.push_back(static_cast<unsigned char>(value >> shift));
+}
+
+inline void chunk(std::vector<unsigned char>& out, const char type[4], const unsigned char* data, size_t length)
+{
+    putBigEndian(out, static_cast<uint32_t>(length));
+    const size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + length);
+    putBigEndian(out, crc(out.data() + start, length + 4));
+}
+
+// rows are the image's rows top first, each width * 3 bytes
+inline bool write(const std::string& path, int width, int height, const std::vector<const unsigned char*>& rows)
+{
+    static const unsigned char SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    std::vector<unsigned char> file(SIGNATURE, SIGNATURE + 8);
+    std::vector<unsigned char> header;
+    putBigEndian(header, static_cast<uint32_t>(width));
+    putBigEndian(header, static_cast<uint32_t>(height));
+    const unsigned char format[5] = {8, 2, 0, 0, 0};    // 8 bits, RGB, deflate, no filter, no interlace
+    header.insert(header.end(), format, format + 5);
+    chunk(file, "IHDR", header.data(), header.size());
+
+    // the filtered image (filter 0 before every row) in stored blocks of at most 65535 bytes
+    const size_t rowBytes = static_cast<size_t>(width) * 3 + 1;
+    const size_t raw = rowBytes * height;
+    std::vector<unsigned char> data = {0x78, 0x01};
+    data.reserve(raw + raw / 65535 * 5 + 16);
+    uint32_t a = 1, b = 0;
+    size_t left = raw, row = 0, column = 0;
+    while (left > 0)
+    {
+        const size_t block = std::min<size_t>(left, 65535);
+        data.push_back(block == left ? 1 : 0);
+        data.push_back(static_cast<unsigned char>(block));
+        data.push_back(static_cast<unsigned char>(block >> 8));
+        data.push_back(static_cast<unsigned char>(~block));
+        data.push_back(static_cast<unsigned char>(~block >> 8));
+        for (size_t i = 0; i < block; i++)
+        {
+            const unsigned char byte = column == 0 ? 0 : rows[row][column - 1];
+            data.push_back(byte);
+            a = (a + byte) % 65521;
+            b = (b + a) % 65521;
+            if (++column == rowBytes)
+            {
+                column = 0;
+                row++;
+            }
+        }
+        left -= block;
+    }
+    putBigEndian(data, (b << 16) | a);
+    chunk(file, "IDAT", data.data(), data.size());
+    chunk(file, "IEND", nullptr, 0);
+
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f)
+        return false;
+    const bool ok = std::fwrite(file.data(), 1, file.size(), f) == file.size();
+    return std::fclose(f) == 0 && ok;
+}
+
+} // namespace png
+
+// In-engine screenshots and video of a framebuffer without stalling on the GPU. Each captured frame is read
+// into the next of SLOTS persistently mapped pixel buffers and fenced; READ_DELAY frames later, when the GPU is
+// long past it, the slot goes to a writer thread that encodes straight out of the mapping (PNG for a
+// screenshot, raw frames for a video) and hands the slot back. The render thread only ever waits when the
+// writer falls SLOTS frames behind, which stalls() counts. A video whose path ends in .mp4, .mkv,
+// .mov or .webm is piped to ffmpeg (which must be on the PATH), anything else gets raw BGRA frames, top row first.
+class FrameCapture
+{
+public:
+    static const unsigned int SLOTS = 4;
+    static const unsigned int READ_DELAY = 2;
+
+    FrameCapture()
+    {
+        writer = std::thread([this]() { writeLoop(); });
+    }
+
+    ~FrameCapture()
+    {
+        stopRecording();
+        flush();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        writer.join();
+        closeVideo();
+        release();
+    }
+
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    bool recording() const { return videoOpen; }
+    bool active() const { return videoOpen || screenshotPending; }
+    // frames handed to the writer since the recording started, and how often the render thread waited for it
+    unsigned long frames() const { return capturedFrames; }
+    unsigned long stalls() const { return stallCount; }
+    const std::string& status() const { return lastStatus; }
+
+    // the next captured frame is also written to path as a PNG
+    void screenshot(const std::string& path)
+    {
+        screenshotPath = path;
+        screenshotPending = true;
+        lastStatus = "screenshot " + path;
+    }
+
+    // every captured frame from now on goes to path, fps is what ffmpeg is told the video runs at
+    bool startRecording(const std::string& path, int fps = 60)
+    {
+        stopRecording();
+        videoPath = path;
+        videoFps = std::max(fps, 1);
+        videoWidth = videoHeight = 0;
+        videoOpen = true;
+        videoFailed = false;
+        capturedFrames = 0;
+        stallCount = 0;
+        lastStatus = "recording " + path;
+        return true;
+    }
+
+    // the frames in flight are still written
+    void stopRecording()
+    {
+        if (!videoOpen)
+            return;
+        flush();
+        videoOpen = false;
+        waitForWriter();
+        closeVideo();
+        lastStatus = videoFailed ? "video write failed" : "recorded " + std::to_string(capturedFrames) + " frames to " + videoPath;
+    }
+
+    // after the frame's final image is in framebuffer, width x height pixels, before the UI is drawn over it. Does
+    // nothing unless a screenshot is pending or a video is recording, except hand over the frames in flight.
+    void capture(unsigned int framebuffer, int width, int height)
+    {
+        handOver(false);
+        if (!active() || width <= 0 || height <= 0)
+            return;
+        PROFILE_SCOPE("FrameCapture::capture");
+        if (videoOpen && videoWidth != 0 && (width != videoWidth || height != videoHeight))
+        {
+            // a video keeps the size it started with
+            stopRecording();
+            lastStatus = "window resized, recorded " + std::to_string(capturedFrames) + " frames to " + videoPath;
+            if (!screenshotPending)
+                return;
+        }
+        if (videoOpen && videoWidth == 0)
+        {
+            videoWidth = width;
+            videoHeight = height;
+        }
+
+        Slot& slot = slots[head];
+        if (slot.fence)
+            handOver(true);     // SLOTS frames in flight, the oldest goes out first
+        if (slot.busy.load(std::memory_order_acquire))
+        {
+            stallCount++;
+            waitForSlot(slot);
+        }
+        prepare(slot, width, height);
+
+        GL_DEBUG_GROUP("frame capture");
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glState().bindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo.id());
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(0, 0, width, height, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+        glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.age = 0;
+        slot.video = videoOpen;
+        slot.screenshot = screenshotPending ? screenshotPath : std::string();
+        screenshotPending = false;
+        head = (head + 1) % SLOTS;
+    }
+
+    // hands every frame in flight to the writer, waiting on the GPU for them
+    void flush()
+    {
+        for (unsigned int s = 0; s < SLOTS; s++)
+            handOver(true);
+    }
+
+private:
+    struct Slot
+    {
+        GlBuffer pbo{GPU_MEMORY_RENDER_TARGETS};
+        const unsigned char* pixels = nullptr;      // the persistent mapping
+        int width = 0;
+        int height = 0;
+        GLsync fence = nullptr;
+        unsigned int age = 0;                       // captures since the read
+        bool video = false;
+        std::string screenshot;
+        std::atomic<bool> busy{false};              // the writer has it
+    };
+
+    Slot slots[SLOTS];
+    unsigned int head = 0;
+    unsigned int tail = 0;      // the oldest slot with a read in flight
+
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable released;
+    std::deque<Slot*> queue;
+    bool stopping = false;
+
+    bool screenshotPending = false;
+    std::string screenshotPath;
+    bool videoOpen = false;
+    std::string videoPath;
+    int videoFps = 60;
+    int videoWidth = 0;
+    int videoHeight = 0;
+    FILE* video = nullptr;      // written on the writer thread only
+    bool videoPipe = false;
+    std::atomic<bool> videoFailed{false};
+    unsigned long capturedFrames = 0;
+    unsigned long stallCount = 0;
+    std::string lastStatus;
+
+    // the oldest read in flight to the writer once it is READ_DELAY captures old, or now with force
+    void handOver(bool force)
+    {
+        for (unsigned int s = 0; s < SLOTS; s++)
+            if (slots[s].fence)
+                slots[s].age += force ? 0 : 1;
+        Slot& slot = slots[tail];
+        if (!slot.fence || (!force && slot.age < READ_DELAY))
+            return;
+        // a frame or two old, this is almost never a wait
+        glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+        if (slot.video)
+            capturedFrames++;
+        slot.busy.store(true, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(&slot);
+        }
+        wake.notify_one();
+        tail = (tail + 1) % SLOTS;
+    }
+
+    void waitForSlot(Slot& slot)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        released.wait(lock, [&]() { return !slot.busy.load(std::memory_order_acquire); });
+    }
+
+    void waitForWriter()
+    {
+        for (Slot& slot : slots)
+            waitForSlot(slot);
+    }
+
+    // a buffer of the frame's size, mapped for good; the writer is not using it
+    void prepare(Slot& slot, int width, int height)
+    {
+        if (slot.pbo.valid() && slot.width == width && slot.height == height)
+            return;
+        const size_t bytes = static_cast<size_t>(width) * height * 4;
+        const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        slot.pbo.create(GL_PIXEL_PACK_BUFFER, "frame capture");
+        slot.pbo.storage(bytes, nullptr, flags);
+        slot.pixels = static_cast<const unsigned char*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(bytes), flags));
+        glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.width = width;
+        slot.height = height;
+    }
+
+    void release()
+    {
+        for (Slot& slot : slots)
+        {
+            if (slot.fence)
+                glDeleteSync(slot.fence);
+            slot.fence = nullptr;
+            slot.pbo.release();     // unmaps it
+            slot.pixels = nullptr;
+            slot.width = slot.height = 0;
+        }
+    }
+
+    void closeVideo()
+    {
+        if (!video)
+            return;
+        const bool ok = (videoPipe ? pclose(video) : std::fclose(video)) == 0;
+        if (!ok)
+            videoFailed = true;
+        video = nullptr;
+    }
+
+    static bool piped(const std::string& path)
+    {
+        for (const char* extension : {".mp4", ".mkv", ".mov", ".webm"})
+        {
+            const size_t length = std::strlen(extension);
+            if (path.size() > length && path.compare(path.size() - length, length, extension) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    void writeLoop()
+    {
+        profiler().nameThread("frame capture");
+        std::vector<unsigned char> rgb;
+        for (;;)
+        {
+            Slot* slot = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&]() { return stopping || !queue.empty(); });
+                if (queue.empty())
+                    return;
+                slot = queue.front();
+                queue.pop_front();
+            }
+            write(*slot, rgb);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                slot->busy.store(false, std::memory_order_release);
+            }
+            released.notify_all();
+        }
+    }
+
+    // the slot's pixels are bottom row first, both outputs want the top first
+    void write(const Slot& slot, std::vector<unsigned char>& rgb)
+    {
+        PROFILE_SCOPE("FrameCapture::write");
+        const size_t rowBytes = static_cast<size_t>(slot.width) * 4;
+        if (slot.video && !videoFailed)
+        {
+            if (!video)
+            {
+                videoPipe = piped(videoPath);
+                if (videoPipe)
+                {
+                    const std::string command = "ffmpeg -loglevel error -y -f rawvideo -pix_fmt bgra -s " + std::to_string(slot.width) + "x" +
+                                                std::to_string(slot.height) + " -r " + std::to_string(videoFps) +
+                                                " -i - -pix_fmt yuv420p \"" + videoPath + "\"";
+                    video = popen(command.c_str(), "w");
+                }
+                else
+                    video = std::fopen(videoPath.c_str(), "wb");
+                if (!video)
+                    videoFailed = true;
+            }
+            for (int y = slot.height - 1; y >= 0 && video; y--)
+                if (std::fwrite(slot.pixels + y * rowBytes, 1, rowBytes, video) != rowBytes)
+                {
+                    videoFailed = true;
+                    break;
+                }
+        }
+        if (!slot.screenshot.empty())
+        {
+            rgb.resize(static_cast<size_t>(slot.width) * slot.height * 3);
+            std::vector<const unsigned char*> rows(slot.height);
+            for (int y = 0; y < slot.height; y++)
+            {
+                const unsigned char* in = slot.pixels + (slot.height - 1 - y) * rowBytes;
+                unsigned char* out = rgb.data() + static_cast<size_t>(y) * slot.width * 3;
+                for (int x = 0; x < slot.width; x++)
+                {
+                    out[x * 3] = in[x * 4 + 2];
+                    out[x * 3 + 1] = in[x * 4 + 1];
+                    out[x * 3 + 2] = in[x * 4];
+                }
+                rows[y] = out;
+            }
+            png::write(slot.screenshot, slot.width, slot.height, rows);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,499 @@
+#ifndef FRAME_GRAPH_H
+#define FRAME_GRAPH_H
+
+#include <glad/glad.h>
+
+#include <gpu_memory.h>
+#include <gl_state_cache.h>
+#include <gl_debug.h>
+#include <frame_arena.h>
+
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Render passes declared with what they read and write, instead of ordered by hand. Each frame the graph is
+// rebuilt: reset(), the textures from outside imported, addPass() for each pass, whose setup runs at once against
+// a Builder to create transient textures and declare its accesses, then execute(). Before running anything the
+// graph
+//   culls the passes nothing needs: walking back from the imported outputs and the passes kept for their side
+//        effects, a pass survives only if a surviving pass reads what it writes
+//   places the transient textures: each lives from the first surviving pass that uses it to the last, and those
+//        whose lives do not overlap share one allocation from a pool kept across frames. GL has no placed
+//        resources, so the memory is shared through texture views, which alias any format of the same texel size
+//        (GL's view classes) at the same dimensions; a pooled allocation nothing used for IDLE_FRAMES is freed.
+//        Without views (an ES context lacking GL_EXT_texture_view) only one format and filter share an allocation
+//   puts in the barriers: only an image store has to be made visible by hand, so a pass gets a glMemoryBarrier
+//        with the bits its reads need of earlier image stores not yet covered, one call at most
+// Passes run in the order they were added. Transient contents are undefined when a pass first writes them.
+class FrameGraph
+{
+public:
+    typedef unsigned int Resource;
+    static const Resource NO_RESOURCE = ~0u;
+    static const unsigned int IDLE_FRAMES = 120;
+
+    enum Access {
+        READ_TEXTURE = 0,   // sampled
+        READ_IMAGE,         // imageLoad
+        WRITE_ATTACHMENT,   // drawn or blitted into
+        WRITE_IMAGE         // imageStore
+    };
+
+    struct TextureDesc
+    {
+        int width = 1;
+        int height = 1;
+        unsigned int levels = 1;
+        GLenum format = GL_RGBA8;
+        GLint filter = GL_LINEAR;       // minification; magnification is its linear or nearest
+    };
+
+    struct Stats
+    {
+        unsigned int passes = 0;
+        unsigned int culled = 0;
+        unsigned int transients = 0;
+        unsigned int allocations = 0;   // pooled textures the transients took this frame
+        unsigned int barriers = 0;
+        size_t transientBytes = 0;      // what the transients would take each on its own
+        size_t allocatedBytes = 0;      // what they took
+        size_t pooledBytes = 0;         // the whole pool, idle allocations included
+    };
+
+    // handed to a pass's setup, which runs inside addPass()
+    class Builder
+    {
+    public:
+        Resource create(const char* name, const TextureDesc& desc) { return graph.transient(name, desc); }
+        Resource read(Resource resource, Access access = READ_TEXTURE) { graph.use(pass, resource, access); return resource; }
+        Resource write(Resource resource, Access access = WRITE_ATTACHMENT) { graph.use(pass, resource, access); return resource; }
+        // never culled, for a pass whose effect is not a texture of the graph's
+        void keep() { graph.passes[pass].keep = true; }
+
+    private:
+        friend class FrameGraph;
+        Builder(FrameGraph& owner, unsigned int index) : graph(owner), pass(index) {}
+        FrameGraph& graph;
+        unsigned int pass;
+    };
+
+    // handed to a pass's execute
+    class Context
+    {
+    public:
+        GLuint texture(Resource resource) const { return graph.resources[resource].texture; }
+        // a framebuffer with the texture's first level as its colour attachment
+        GLuint framebuffer(Resource resource) { return graph.framebufferOf(resource); }
+        const TextureDesc& desc(Resource resource) const { return graph.resources[resource].desc; }
+
+    private:
+        friend class FrameGraph;
+        explicit Context(FrameGraph& owner) : graph(owner) {}
+        FrameGraph& graph;
+    };
+
+    FrameGraph() = default;
+    FrameGraph(const FrameGraph&) = delete;
+    FrameGraph& operator=(const FrameGraph&) = delete;
+
+    ~FrameGraph()
+    {
+        release();
+    }
+
+    const Stats& stats() const { return lastStats; }
+
+    // drops last frame's passes and resources, the pool stays
+    void reset()
+    {
+        for (Pass& pass : passes)
+            pass.uses.clear();
+        passCount = 0;
+        resources.clear();
+        callables.reset();
+    }
+
+    // a texture the graph does not own, with its framebuffer if it has one. An output is what the frame is for,
+    // or is kept for the next: the passes writing it are never culled.
+    Resource import(const char* name, GLuint texture, GLuint framebuffer, const TextureDesc& desc, bool output = false)
+    {
+        ResourceEntry entry;
+        entry.name = name;
+        entry.desc = desc;
+        entry.texture = texture;
+        entry.framebuffer = framebuffer;
+        entry.imported = true;
+        entry.output = output;
+        resources.push_back(entry);
+        return static_cast<Resource>(resources.size() - 1);
+    }
+
+    // setup(Builder&) runs now, execute(Context&) from execute() if the pass survives
+    template <typename Setup, typename Execute>
+    void addPass(const char* name, Setup&& setup, Execute&& execute)
+    {
+        typedef typename std::decay<Execute>::type Callable;
+        static_assert(std::is_trivially_destructible<Callable>::value, "pass callables live in the graph's arena and are never destroyed");
+        if (passCount == passes.size())
+            passes.emplace_back();
+        const unsigned int index = static_cast<unsigned int>(passCount++);
+        Pass& pass = passes[index];
+        pass.name = name;
+        pass.callable = new (callables.allocate(sizeof(Callable), alignof(Callable))) Callable(std::forward<Execute>(execute));
+        pass.invoke = &invokePass<Callable>;
+        pass.keep = false;
+        Builder builder(*this, index);
+        setup(builder);
+    }
+
+    // culls, places and runs the passes
+    void execute()
+    {
+        frame++;
+        compile();
+        Context context(*this);
+        for (size_t p = 0; p < passCount; p++)
+        {
+            Pass& pass = passes[p];
+            if (!pass.alive)
+                continue;
+            if (pass.barrier != 0)
+                glMemoryBarrier(pass.barrier);
+            GL_DEBUG_GROUP(pass.name);
+            pass.invoke(pass.callable, context);
+        }
+        idle();
+    }
+
+    void release()
+    {
+        for (std::unique_ptr<Allocation>& allocation : pool)
+            freeAllocation(*allocation);
+        pool.clear();
+        reset();
+        lastStats = Stats();
+    }
+
+private:
+    struct Use
+    {
+        Resource resource;
+        Access access;
+    };
+
+    struct Pass
+    {
+        const char* name = nullptr;
+        void* callable = nullptr;
+        void (*invoke)(void*, Context&) = nullptr;
+        std::vector<Use> uses;
+        bool keep = false;
+        bool alive = false;
+        GLbitfield barrier = 0;
+    };
+
+    struct ResourceEntry
+    {
+        const char* name = nullptr;
+        TextureDesc desc;
+        GLuint texture = 0;
+        GLuint framebuffer = 0;
+        bool imported = false;
+        bool output = false;
+        bool needed = false;
+        size_t first = 0;           // surviving passes using it, a transient's life
+        size_t last = 0;
+        bool used = false;
+        unsigned int allocation = 0;
+    };
+
+    struct View
+    {
+        GLenum format;
+        GLint filter;
+        GLuint texture;
+        GLuint framebuffer;
+    };
+
+    // one pooled texture and the views the transients placed on it took
+    struct Allocation
+    {
+        GlTexture storage{GPU_MEMORY_RENDER_TARGETS};
+        int width = 0;
+        int height = 0;
+        unsigned int levels = 0;
+        unsigned int viewClass = 0;
+        GLenum format = GL_NONE;    // of the storage
+        std::vector<View> views;
+        unsigned long long lastFrame = 0;
+        size_t freeAfter = 0;       // this frame, the last pass of its current holder
+        bool taken = false;
+    };
+
+    std::vector<Pass> passes;
+    size_t passCount = 0;
+    std::vector<ResourceEntry> resources;
+    std::vector<std::unique_ptr<Allocation>> pool;
+    FrameArena callables{4 * 1024};
+    unsigned long long frame = 0;
+    Stats lastStats;
+
+    template <typename Callable>
+    static void invokePass(void* callable, Context& context)
+    {
+        (*static_cast<Callable*>(callable))(context);
+    }
+
+    Resource transient(const char* name, const TextureDesc& desc)
+    {
+        ResourceEntry entry;
+        entry.name = name;
+        entry.desc = desc;
+        entry.desc.width = std::max(desc.width, 1);
+        entry.desc.height = std::max(desc.height, 1);
+        entry.desc.levels = std::max(desc.levels, 1u);
+        resources.push_back(entry);
+        return static_cast<Resource>(resources.size() - 1);
+    }
+
+    void use(unsigned int pass, Resource resource, Access access)
+    {
+        if (resource < resources.size())
+            passes[pass].uses.push_back({resource, access});
+    }
+
+    static bool writes(Access access) { return access == WRITE_ATTACHMENT || access == WRITE_IMAGE; }
+
+    // texture views alias formats of one class; 0 for a format only aliased with itself
+    static unsigned int viewClass(GLenum format)
+    {
+        if (!glTextureView)
+            return 0;
+        switch (format)
+        {
+        case GL_RGBA32F: case GL_RGBA32UI: case GL_RGBA32I: return 128;
+        case GL_RGBA16F: case GL_RG32F: case GL_RGBA16: case GL_RGBA16UI: case GL_RG32UI: return 64;
+        case GL_RGBA8: case GL_SRGB8_ALPHA8: case GL_RGB10_A2: case GL_R11F_G11F_B10F: case GL_RG16F:
+        case GL_R32F: case GL_R32UI: case GL_RG16: case GL_RG16UI: return 32;
+        case GL_RG8: case GL_R16F: case GL_R16: case GL_R16UI: return 16;
+        case GL_R8: case GL_R8UI: return 8;
+        default: return 0;
+        }
+    }
+
+    static size_t descBytes(const TextureDesc& desc)
+    {
+        size_t total = 0;
+        for (unsigned int l = 0; l < desc.levels; l++)
+            total += static_cast<size_t>(std::max(desc.width >> l, 1)) * static_cast<size_t>(std::max(desc.height >> l, 1));
+        return total * texelBytes(desc.format);
+    }
+
+    void compile()
+    {
+        Stats stats;
+        stats.passes = static_cast<unsigned int>(passCount);
+
+        // back from the outputs: a pass lives if it is kept or writes something needed, and then needs its reads
+        for (ResourceEntry& resource : resources)
+            resource.needed = resource.output;
+        for (size_t p = passCount; p-- > 0;)
+        {
+            Pass& pass = passes[p];
+            pass.alive = pass.keep;
+            for (const Use& use : pass.uses)
+                if (writes(use.access) && resources[use.resource].needed)
+                    pass.alive = true;
+            if (!pass.alive)
+            {
+                stats.culled++;
+                continue;
+            }
+            for (const Use& use : pass.uses)
+                if (!writes(use.access))
+                    resources[use.resource].needed = true;
+        }
+
+        // the transients' lives, then the barriers each surviving pass needs
+        std::vector<GLbitfield> unsynced(resources.size(), 0);
+        for (size_t p = 0; p < passCount; p++)
+        {
+            Pass& pass = passes[p];
+            pass.barrier = 0;
+            if (!pass.alive)
+                continue;
+            for (const Use& use : pass.uses)
+            {
+                ResourceEntry& resource = resources[use.resource];
+                if (!resource.used)
+                    resource.first = p;
+                resource.last = p;
+                resource.used = true;
+                pass.barrier |= unsynced[use.resource] & barrierFor(use.access);
+            }
+            if (pass.barrier != 0)
+            {
+                stats.barriers++;
+                for (GLbitfield& bits : unsynced)
+                    bits &= ~pass.barrier;
+            }
+            for (const Use& use : pass.uses)
+                if (use.access == WRITE_IMAGE)
+                    unsynced[use.resource] = GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT;
+        }
+
+        // in pass order each transient takes a pooled texture free by its first pass, or a new one
+        for (std::unique_ptr<Allocation>& allocation : pool)
+            allocation->taken = false;
+        for (size_t p = 0; p < passCount; p++)
+        {
+            if (!passes[p].alive)
+                continue;
+            for (Resource r = 0; r < resources.size(); r++)
+            {
+                ResourceEntry& resource = resources[r];
+                if (resource.imported || !resource.used || resource.first != p)
+                    continue;
+                place(resource);
+            }
+        }
+        for (const ResourceEntry& resource : resources)
+            if (!resource.imported && resource.used)
+            {
+                stats.transients++;
+                stats.transientBytes += descBytes(resource.desc);
+            }
+        for (const std::unique_ptr<Allocation>& allocation : pool)
+        {
+            stats.pooledBytes += allocation->storage.bytes();
+            if (allocation->lastFrame == frame)
+            {
+                stats.allocations++;
+                stats.allocatedBytes += allocation->storage.bytes();
+            }
+        }
+        lastStats = stats;
+    }
+
+    static GLbitfield barrierFor(Access access)
+    {
+        switch (access)
+        {
+        case READ_TEXTURE: return GL_TEXTURE_FETCH_BARRIER_BIT;
+        case READ_IMAGE: case WRITE_IMAGE: return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+        case WRITE_ATTACHMENT: return GL_FRAMEBUFFER_BARRIER_BIT;
+        }
+        return 0;
+    }
+
+    void place(ResourceEntry& resource)
+    {
+        const TextureDesc& desc = resource.desc;
+        const unsigned int cls = viewClass(desc.format);
+        Allocation* chosen = nullptr;
+        for (size_t a = 0; a < pool.size() && !chosen; a++)
+        {
+            Allocation& allocation = *pool[a];
+            const bool fits = allocation.width == desc.width && allocation.height == desc.height && allocation.levels == desc.levels &&
+                              allocation.viewClass == cls && (cls != 0 || allocation.format == desc.format) &&
+                              (glTextureView || allocation.views.empty() || allocation.views.front().filter == desc.filter);
+            if (fits && (!allocation.taken || allocation.freeAfter < resource.first))
+            {
+                chosen = &allocation;
+                resource.allocation = static_cast<unsigned int>(a);
+            }
+        }
+        if (!chosen)
+        {
+            pool.push_back(std::make_unique<Allocation>());
+            chosen = pool.back().get();
+            resource.allocation = static_cast<unsigned int>(pool.size() - 1);
+            chosen->width = desc.width;
+            chosen->height = desc.height;
+            chosen->levels = desc.levels;
+            chosen->viewClass = cls;
+            chosen->format = desc.format;
+            chosen->storage.create(GL_TEXTURE_2D, "frame graph transient");
+            chosen->storage.storage2D(static_cast<GLsizei>(desc.levels), desc.format, desc.width, desc.height);
+            glState().bindTexture(GL_TEXTURE_2D, 0);
+        }
+        chosen->taken = true;
+        chosen->freeAfter = resource.last;
+        chosen->lastFrame = frame;
+        resource.texture = viewOf(*chosen, desc).texture;
+        resource.framebuffer = 0;
+    }
+
+    // the allocation seen as desc's format and filter, made the first time it is asked for
+    View& viewOf(Allocation& allocation, const TextureDesc& desc)
+    {
+        for (View& view : allocation.views)
+            if (view.format == desc.format && view.filter == desc.filter)
+                return view;
+        View view{desc.format, desc.filter, allocation.storage.id(), 0};
+        // a view's name must never have been bound before glTextureView; without views the storage is its own
+        if (glTextureView)
+        {
+            glGenTextures(1, &view.texture);
+            glTextureView(view.texture, GL_TEXTURE_2D, allocation.storage.id(), desc.format, 0, desc.levels, 0, 1);
+            labelObject(GL_TEXTURE, view.texture, "frame graph view");
+        }
+        const bool nearest = desc.filter == GL_NEAREST || desc.filter == GL_NEAREST_MIPMAP_NEAREST || desc.filter == GL_NEAREST_MIPMAP_LINEAR;
+        glState().bindTexture(GL_TEXTURE_2D, view.texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, desc.filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, nearest ? GL_NEAREST : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glState().bindTexture(GL_TEXTURE_2D, 0);
+        allocation.views.push_back(view);
+        return allocation.views.back();
+    }
+
+    GLuint framebufferOf(Resource r)
+    {
+        ResourceEntry& resource = resources[r];
+        if (resource.framebuffer != 0 || resource.imported)
+            return resource.framebuffer;
+        for (View& view : pool[resource.allocation]->views)
+            if (view.texture == resource.texture)
+            {
+                if (view.framebuffer == 0)
+                {
+                    glGenFramebuffers(1, &view.framebuffer);
+                    glBindFramebuffer(GL_FRAMEBUFFER, view.framebuffer);
+                    labelObject(GL_FRAMEBUFFER, view.framebuffer, resource.name);
+                    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, view.texture, 0);
+                }
+                resource.framebuffer = view.framebuffer;
+            }
+        return resource.framebuffer;
+    }
+
+    // frees the allocations nothing has placed on for a while
+    void idle()
+    {
+        for (size_t a = pool.size(); a-- > 0;)
+        {
+            if (frame - pool[a]->lastFrame <= IDLE_FRAMES)
+                continue;
+            freeAllocation(*pool[a]);
+            pool.erase(pool.begin() + static_cast<std::ptrdiff_t>(a));
+        }
+    }
+
+    void freeAllocation(Allocation& allocation)
+    {
+        for (View& view : allocation.views)
+        {
+            if (view.framebuffer != 0) glDeleteFramebuffers(1, &view.framebuffer);
+            if (view.texture != allocation.storage.id()) glState().deleteTextures(1, &view.texture);
+        }
+        allocation.views.clear();
+        allocation.storage.release();
+    }
+};
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef FRAME_PACING_H
+#define FRAME_PACING_H
+
+#include <glad/glad.h>
+
+#include <profiler.h>
+
+#include <chrono>
+#include <thread>
+#include <string>
+#include <algorithm>
+
+// how the swap chain presents: on the refresh (interval 1), on it unless the frame is late, which then tears
+// instead of waiting a whole refresh (interval -1, EXT_swap_control_tear), or as soon as the frame is done
+enum PresentMode
+{
+    PRESENT_VSYNC = 0,
+    PRESENT_ADAPTIVE,
+    PRESENT_UNCAPPED,
+    PRESENT_MODES
+};
+
+inline const char* presentModeName(PresentMode mode)
+{
+    static const char* names[PRESENT_MODES] = {"vsync", "adaptive", "uncapped"};
+    return mode < PRESENT_MODES ? names[mode] : "?";
+}
+
+inline int swapInterval(PresentMode mode)
+{
+    return mode == PRESENT_VSYNC ? 1 : mode == PRESENT_ADAPTIVE ? -1 : 0;
+}
+
+// Keeps the frames even: a limiter that starts frames no faster than a target rate, sleeping until shortly before
+// the deadline and spinning the rest so the OS timer's granularity does not show, and a cap on the frames the CPU
+// may submit ahead of the GPU, a fence per frame. Both wait at the top of the loop, before input is read, so that
+// waiting makes the frame's input younger rather than older.
+class FramePacer
+{
+public:
+    static const unsigned int MAX_FRAMES_IN_FLIGHT = 4;
+    static constexpr double SPIN_SECONDS = 0.0015;     // left to spin after the sleep, above a timer tick
+
+    double fpsLimit = 0.0;                      // 0 for no limit
+    unsigned int framesInFlight = 2;            // at most this many frames queued on the GPU, 0 for no cap
+
+    FramePacer() = default;
+    FramePacer(const FramePacer&) = delete;
+    FramePacer& operator=(const FramePacer&) = delete;
+
+    ~FramePacer()
+    {
+        release();
+    }
+
+    // waits for the GPU to be within framesInFlight frames and then for the limiter's deadline, once per frame
+    void beginFrame()
+    {
+        PROFILE_SCOPE("FramePacer::beginFrame");
+        const Clock::time_point start = Clock::now();
+        waitForQueue();
+        const Clock::time_point queued = Clock::now();
+        limit(queued);
+        const Clock::time_point end = Clock::now();
+        lastQueueMs = std::chrono::duration<float, std::milli>(queued - start).count();
+        lastLimiterMs = std::chrono::duration<float, std::milli>(end - queued).count();
+    }
+
+    // closes the frame's GL commands, after the swap
+    void endFrame()
+    {
+        GLsync& fence = fences[head];
+        if (fence) glDeleteSync(fence);
+        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        head = (head + 1) % MAX_FRAMES_IN_FLIGHT;
+    }
+
+    // what the last beginFrame spent waiting on each
+    float queueWaitMs() const { return lastQueueMs; }
+    float limiterWaitMs() const { return lastLimiterMs; }
+
+    void release()
+    {
+        for (GLsync& fence : fences)
+        {
+            if (fence) glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    GLsync fences[MAX_FRAMES_IN_FLIGHT] = {};
+    unsigned int head = 0;
+    Clock::time_point deadline{};
+    float lastQueueMs = 0.0f;
+    float lastLimiterMs = 0.0f;
+
+    // the fence of the frame framesInFlight frames back must have passed before another one starts
+    void waitForQueue()
+    {
+        if (framesInFlight == 0)
+            return;
+        const unsigned int depth = std::min(framesInFlight, MAX_FRAMES_IN_FLIGHT);
+        GLsync& fence = fences[(head + MAX_FRAMES_IN_FLIGHT - depth) % MAX_FRAMES_IN_FLIGHT];
+        if (!fence)
+            return;
+        GLbitfield waitFlags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        for (;;)
+        {
+            const GLenum result = glClientWaitSync(fence, waitFlags, 1000000);
+            if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED)
+                break;
+            waitFlags = 0;
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    void limit(Clock::time_point now)
+    {
+        if (fpsLimit <= 0.0 || deadline == Clock::time_point())
+        {
+            deadline = now;
+            return;
+        }
+        const auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / fpsLimit));
+        // the next deadline follows the last one so the rate holds on average, unless the frame was a period or
+        // more late, which is not made up with a burst of short frames
+        deadline = std::max(deadline + period, now - period);
+        if (deadline <= now)
+            return;
+        const auto spin = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(SPIN_SECONDS));
+        if (deadline - now > spin)
+            std::this_thread::sleep_until(deadline - spin);
+        while (Clock::now() < deadline)
+            std::this_thread::yield();
+    }
+};
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef GALAXY_H
+#define GALAXY_H
+
+#include <glm.hpp>
+#include <gtc/constants.hpp>
+
+#include <body_store.h>
+
+#include <vector>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+// Initial conditions for galaxy encounters in the restricted style of Toomre & Toomre (1972): each galaxy's mass
+// sits in one core body whose softened pull, G M r / (r^2 + a^2)^(3/2), is exactly that of a Plummer sphere of scale
+// a, and the stars are test particles on orbits in it. With the test-particle solver a step costs one core per
+// star, which is what lets the GPU backend move millions of stars. Each galaxy has three populations:
+//   disk   exponential in radius (R e^(-R/h), sampled as the sum of two exponentials) and sech^2 in height,
+//          rotating at the circular speed with a small random part
+//   bulge  Hernquist in radius, each star on a circular orbit in a random plane, which a spherical potential keeps
+//   halo   Plummer in radius, circular orbits in random planes like the bulge, a sparse and faint tracer
+// The stars carry a tiny mass only so nothing divides by zero; their radius scale is a luminosity for the point
+// rendering (include/point_cloud.h), which colours above 1 blue and below warm.
+struct GalaxyConfig
+{
+    glm::dvec3 position = glm::dvec3(0.0);
+    glm::dvec3 velocity = glm::dvec3(0.0);
+    glm::dvec3 spinAxis = glm::dvec3(0.0, 1.0, 0.0);    // the disk's normal, it rotates counter-clockwise about it
+
+    float mass = 60000.0f;          // all of it in the core
+    float coreRadiusScale = 2.0f;
+
+    unsigned int diskStars = 0;
+    float diskScale = 25.0f;        // exponential scale length
+    float diskRadius = 150.0f;      // truncation
+    float diskHeight = 1.5f;        // sech^2 scale height
+    float diskDispersion = 0.08f;   // random velocity as a fraction of the circular speed
+
+    unsigned int bulgeStars = 0;
+    float bulgeScale = 5.0f;        // Hernquist scale
+    float bulgeRadius = 40.0f;
+
+    unsigned int haloStars = 0;
+    float haloScale = 60.0f;        // Plummer scale of the tracers, not of the potential
+    float haloRadius = 300.0f;
+
+    unsigned int stars() const { return diskStars + bulgeStars + haloStars; }
+};
+
+struct GalaxySetup
+{
+    std::vector<GalaxyConfig> galaxies;
+    float softening = 30.0f;        // Plummer scale of every core's potential, the world's softening length
+    unsigned int seed = 1;
+
+    unsigned int stars() const
+    {
+        unsigned int n = 0;
+        for (const GalaxyConfig& g : galaxies)
+            n += g.stars();
+        return n;
+    }
+};
+
+// circular speed at r around a core of mass m softened by a
+inline double plummerCircularSpeed(double G, double m, double r, double a)
+{
+    const double s = r * r + a * a;
+    return std::sqrt(G * m * r * r / (s * std::sqrt(s)));
+}
+
+// two disks on a parabolic orbit with pericentre distance pericentre, starting separation apart in the x-z plane
+// with the smaller one's disk tilted by tiltDegrees about the line joining them. stars are split 8:3 between them
+// and within each 80% disk, 15% bulge and 5% halo.
+inline GalaxySetup galaxyCollision(unsigned int stars, float G, unsigned int seed = 1, float separation = 700.0f,
+                                   float pericentre = 120.0f, float tiltDegrees = 60.0f)
+{
+    GalaxySetup setup;
+    setup.seed = seed;
+    GalaxyConfig big, small;
+    small.mass = big.mass * 0.375f;
+    small.diskScale = big.diskScale * 0.6f;
+    small.diskRadius = big.diskRadius * 0.6f;
+    small.bulgeScale = big.bulgeScale * 0.6f;
+    small.bulgeRadius = big.bulgeRadius * 0.6f;
+    small.haloScale = big.haloScale * 0.6f;
+    small.haloRadius = big.haloRadius * 0.6f;
+    small.coreRadiusScale = big.coreRadiusScale * 0.7f;
+    const double tilt = glm::radians(static_cast<double>(tiltDegrees));
+    small.spinAxis = glm::dvec3(0.0, std::cos(tilt), std::sin(tilt));
+
+    const unsigned int bigStars = static_cast<unsigned int>(stars * (8.0 / 11.0));
+    const unsigned int counts[2] = {bigStars, stars - bigStars};
+    GalaxyConfig* both[2] = {&big, &small};
+    for (int k = 0; k < 2; k++)
+    {
+        both[k]->bulgeStars = counts[k] * 15 / 100;
+        both[k]->haloStars = counts[k] * 5 / 100;
+        both[k]->diskStars = counts[k] - both[k]->bulgeStars - both[k]->haloStars;
+    }
+
+    // the relative orbit: parabolic speed at the separation, with the angular momentum of the pericentre
+    const double total = static_cast<double>(big.mass) + small.mass;
+    const double speed = std::sqrt(2.0 * G * total / separation);
+    const double h = std::sqrt(2.0 * G * total * pericentre);
+    const double sinAngle = std::min(1.0, h / (separation * speed));
+    const glm::dvec3 relativePosition(separation, 0.0, 0.0);
+    const glm::dvec3 relativeVelocity = speed * glm::dvec3(-std::sqrt(1.0 - sinAngle * sinAngle), 0.0, sinAngle);
+    // about the centre of mass
+    const double smallShare = small.mass / total;
+    big.position = -smallShare * relativePosition;
+    big.velocity = -smallShare * relativeVelocity;
+    small.position = (1.0 - smallShare) * relativePosition;
+    small.velocity = (1.0 - smallShare) * relativeVelocity;
+
+    setup.galaxies.push_back(big);
+    setup.galaxies.push_back(small);
+    return setup;
+}
+
+// replaces the bodies with the setup's: every core first as a sun, then every galaxy's stars as asteroids
+inline void generateGalaxies(BodyStore& bodies, const GalaxySetup& setup, float G, Mesh* coreMesh = nullptr)
+{
+    bodies.clear();
+    bodies.reserve(setup.galaxies.size() + setup.stars());
+    for (const GalaxyConfig& g : setup.galaxies)
+        bodies.add(BODY_SUN, g.position, g.velocity, g.mass, g.coreRadiusScale, nullptr, coreMesh, glm::quat(1.0f, 0, 0, 0), false);
+
+    std::mt19937 rng(setup.seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    const double a = setup.softening;
+    // (0, 1], for logs
+    auto open = [&]() { return 1.0 - uniform(rng); };
+    auto randomDirection = [&]() {
+        const double z = 2.0 * uniform(rng) - 1.0;
+        const double phi = glm::two_pi<double>() * uniform(rng);
+        const double s = std::sqrt(std::max(0.0, 1.0 - z * z));
+        return glm::dvec3(s * std::cos(phi), s * std::sin(phi), z);
+    };
+    // a circular orbit at r in a random plane, for the spherical populations
+    auto addSpheroidStar = [&](const GalaxyConfig& g, double r, float luminosity, float starMass) {
+        const glm::dvec3 n = randomDirection();
+        glm::dvec3 t = glm::cross(n, randomDirection());
+        const double tl = glm::length(t);
+        t = tl > 1e-9 ? t / tl : glm::dvec3(-n.y, n.x, 0.0) / std::max(1e-9, std::sqrt(n.x * n.x + n.y * n.y));
+        const double v = plummerCircularSpeed(G, g.mass, r, a);
+        bodies.add(BODY_ASTEROID, g.position + r * n, g.velocity + v * t, starMass, luminosity, nullptr, nullptr,
+                   glm::quat(1.0f, 0, 0, 0), false);
+    };
+
+    for (const GalaxyConfig& g : setup.galaxies)
+    {
+        const float starMass = g.mass * 1e-9f;
+        // the disk's frame: e1 and e2 span the plane, e1 x e2 along the spin axis
+        const glm::dvec3 up = glm::normalize(g.spinAxis);
+        const glm::dvec3 e1 = glm::normalize(glm::cross(up, std::abs(up.x) < 0.9 ? glm::dvec3(1, 0, 0) : glm::dvec3(0, 0, 1)));
+        const glm::dvec3 e2 = glm::cross(e1, up);
+        for (unsigned int i = 0; i < g.diskStars; i++)
+        {
+            double R;
+            do R = -g.diskScale * std::log(open() * open());
+            while (R > g.diskRadius);
+            const double phi = glm::two_pi<double>() * uniform(rng);
+            const double z = g.diskHeight * std::atanh(std::clamp(2.0 * uniform(rng) - 1.0, -0.999999, 0.999999));
+            const glm::dvec3 radial = std::cos(phi) * e1 + std::sin(phi) * e2;
+            const glm::dvec3 tangent = glm::cross(up, radial);
+            const double v = plummerCircularSpeed(G, g.mass, R, a);
+            const glm::dvec3 random(normal(rng), normal(rng) * 0.5, normal(rng));
+            const glm::dvec3 vel = v * tangent + g.diskDispersion * v * (random.x * radial + random.y * up + random.z * tangent);
+            // a few in a hundred young and bright
+            const float luminosity = uniform(rng) < 0.04 ? static_cast<float>(2.0 + 2.0 * uniform(rng))
+                                                         : static_cast<float>(0.5 + 0.5 * uniform(rng));
+            bodies.add(BODY_ASTEROID, g.position + R * radial + z * up, g.velocity + vel, starMass, luminosity, nullptr,
+                       nullptr, glm::quat(1.0f, 0, 0, 0), false);
+        }
+        for (unsigned int i = 0; i < g.bulgeStars; i++)
+        {
+            // the Hernquist cumulative mass inverted, M(<r) / M = r^2 / (r + b)^2
+            double r;
+            do
+            {
+                const double s = std::sqrt(uniform(rng));
+                r = g.bulgeScale * s / std::max(1e-9, 1.0 - s);
+            } while (r > g.bulgeRadius);
+            addSpheroidStar(g, r, 0.7f, starMass);
+        }
+        for (unsigned int i = 0; i < g.haloStars; i++)
+        {
+            // the Plummer cumulative mass inverted, M(<r) / M = r^3 / (r^2 + b^2)^(3/2)
+            double r;
+            do r = g.haloScale / std::sqrt(std::pow(open(), -2.0 / 3.0) - 1.0 + 1e-12);
+            while (r > g.haloRadius);
+            addSpheroidStar(g, r, 0.15f, starMass);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <shader.h>
+#include <gpu_memory.h>
+
+#include <algorithm>
+#include <iostream>
+
+// Deferred shading: the lit shaders compiled with GBUFFER_OUTPUT write their surface into these targets instead of
+// lighting it (shaders.2/gbuffer.glsl), and light() then shades every covered pixel once with a fullscreen pass
+// (shaders.2/deferred.lighting.fs), so overdraw of the dense belt costs a G-buffer write rather than the lighting.
+// Packed to 8 bytes a pixel plus depth: RGBA8 albedo with the specular intensity, RGB10_A2 octahedral normal with
+// the shininess, and a 32-bit float depth the view position is rebuilt from. Single-sampled, the lit geometry of
+// the deferred path is not multisampled.
+class GBuffer
+{
+public:
+    enum Unit {
+        UNIT_ALBEDO_SPECULAR = 0,
+        UNIT_NORMAL_SHININESS = 1,
+        UNIT_DEPTH = 2
+    };
+
+    GBuffer(const char* lightingVertexPath, const char* lightingFragmentPath, const ShaderDefines& defines = ShaderDefines())
+        : lightingShader(lightingVertexPath, lightingFragmentPath, defines) {}
+
+    ~GBuffer()
+    {
+        release();
+    }
+
+    int width() const { return targetWidth; }
+    int height() const { return targetHeight; }
+    unsigned int framebuffer() const { return fbo; }
+
+    // (re)allocates the targets when the viewport changed size
+    void resize(int w, int h)
+    {
+        w = std::max(w, 1);
+        h = std::max(h, 1);
+        if (fbo != 0 && w == targetWidth && h == targetHeight)
+            return;
+        releaseTargets();
+        targetWidth = w;
+        targetHeight = h;
+        target(albedoSpecular, GL_RGBA8, "g-buffer albedo specular");
+        target(normalShininess, GL_RGB10_A2, "g-buffer normal shininess");
+        target(depth, GL_DEPTH_COMPONENT32F, "g-buffer depth");
+
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        labelObject(GL_FRAMEBUFFER, fbo, "g-buffer");
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoSpecular.id(), 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalShininess.id(), 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth.id(), 0);
+        const GLenum attachments[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+        glDrawBuffers(2, attachments);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::GBUFFER:: Framebuffer is not complete" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // binds and clears the targets for the geometry pass, sized to the viewport
+    void bindGeometry(int w, int h)
+    {
+        resize(w, h);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glViewport(0, 0, targetWidth, targetHeight);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    // shades the G-buffer into framebuffer (the default one, or the scene target of the same size), depth included
+    // so what is drawn later still tests against the geometry. The LightData block and the light clusters must be
+    // bound as for the forward shaders.
+    void light(const glm::mat4& projection, const glm::mat4& view, unsigned int framebuffer = 0)
+    {
+        GL_DEBUG_GROUP("deferred lighting");
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, targetWidth, targetHeight);
+        if (emptyVAO == 0)
+            glGenVertexArrays(1, &emptyVAO);
+        bindTextures();
+        lightingShader.use();
+        lightingShader.setInt("gAlbedoSpecular", UNIT_ALBEDO_SPECULAR);
+        lightingShader.setInt("gNormalShininess", UNIT_NORMAL_SHININESS);
+        lightingShader.setInt("gDepth", UNIT_DEPTH);
+        lightingShader.setMat4("inverseProjection", glm::inverse(projection));
+        lightingShader.setMat4("viewMat", view);
+        glState().depthFunc(GL_ALWAYS);
+        glState().bindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glState().bindVertexArray(0);
+        glState().depthFunc(GL_LESS);
+        glState().activeTexture(GL_TEXTURE0);
+    }
+
+    void bindTextures() const
+    {
+        glState().activeTexture(GL_TEXTURE0 + UNIT_ALBEDO_SPECULAR);
+        glState().bindTexture(GL_TEXTURE_2D, albedoSpecular.id());
+        glState().activeTexture(GL_TEXTURE0 + UNIT_NORMAL_SHININESS);
+        glState().bindTexture(GL_TEXTURE_2D, normalShininess.id());
+        glState().activeTexture(GL_TEXTURE0 + UNIT_DEPTH);
+        glState().bindTexture(GL_TEXTURE_2D, depth.id());
+    }
+
+    void release()
+    {
+        releaseTargets();
+        if (emptyVAO != 0) glState().deleteVertexArrays(1, &emptyVAO);
+        emptyVAO = 0;
+    }
+
+private:
+    Shader lightingShader;
+    unsigned int fbo = 0;
+    GlTexture albedoSpecular{GPU_MEMORY_RENDER_TARGETS};
+    GlTexture normalShininess{GPU_MEMORY_RENDER_TARGETS};
+    GlTexture depth{GPU_MEMORY_RENDER_TARGETS};
+    unsigned int emptyVAO = 0;
+    int targetWidth = 0;
+    int targetHeight = 0;
+
+    // an immutable single-level target, read texel for texel by the lighting pass
+    void target(GlTexture& texture, GLenum format, const char* label) const
+    {
+        texture.create(GL_TEXTURE_2D, label);
+        texture.storage2D(1, format, targetWidth, targetHeight);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glState().bindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    void releaseTargets()
+    {
+        if (fbo != 0) glDeleteFramebuffers(1, &fbo);
+        fbo = 0;
+        albedoSpecular.release();
+        normalShininess.release();
+        depth.release();
+    }
+};
+
+#endif
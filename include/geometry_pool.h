@@ -0,0 +1,228 @@
+#ifndef GEOMETRY_POOL_H
+#define GEOMETRY_POOL_H
+
+#include <glad/glad.h>
+
+#include <gl_state_cache.h>
+#include <vertex_layout.h>
+#include <gl_debug.h>
+#include <gpu_memory.h>
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <algorithm>
+
+// where a mesh lives in the pool: its vertices start at baseVertex, its indices at firstIndex
+struct GeometryRange
+{
+    int32_t baseVertex;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+};
+
+// One vertex buffer per vertex layout and one shared index buffer that meshes are sub-allocated from, with one
+// VAO per layout. Meshes in the same layout then draw without switching VAO or buffers, each with
+// glDrawElementsBaseVertex (or one indirect command) over its range, which is what a multi-draw over several
+// models needs. Allocations only grow: a full buffer is reallocated at twice the size and the old contents are
+// copied over on the GPU, the VAOs are re-pointed at the new buffers. A layout can also have a position-only buffer
+// in step with its vertex buffer, same base vertices, with a VAO of its own for the depth passes; only the meshes
+// that asked for it (addPositions) have theirs filled in.
+class GeometryPool
+{
+public:
+    GeometryPool() = default;
+    GeometryPool(const GeometryPool&) = delete;
+    GeometryPool& operator=(const GeometryPool&) = delete;
+
+    ~GeometryPool()
+    {
+        release();
+    }
+
+    // appends the vertices in layout and their indices, the indices stay relative to the mesh's own vertices
+    GeometryRange add(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, VertexLayout layout)
+    {
+        Layout& l = layouts[layout];
+        if (l.vao == 0)
+            createLayout(layout);
+        const std::vector<uint8_t> bytes = packVertices(vertices, layout);
+        reserveVertices(layout, l.vertexCount + vertices.size());
+        glNamedBufferSubData(l.vertexBuffer, static_cast<GLintptr>(l.vertexCount * vertexSize(layout)), bytes.size(), bytes.data());
+        GeometryRange range{static_cast<int32_t>(l.vertexCount), addIndices(indices), static_cast<uint32_t>(indices.size())};
+        l.vertexCount += vertices.size();
+        return range;
+    }
+
+    // more indices over vertices already in the pool (a coarser level of detail), returns their first index
+    uint32_t addIndices(const std::vector<unsigned int>& indices)
+    {
+        const uint32_t first = static_cast<uint32_t>(indexCount);
+        reserveIndices(indexCount + indices.size());
+        glNamedBufferSubData(indexBuffer, static_cast<GLintptr>(indexCount * sizeof(unsigned int)), indices.size() * sizeof(unsigned int), indices.data());
+        indexCount += indices.size();
+        return first;
+    }
+
+    // the positions of a mesh already added at range, into the layout's position-only buffer
+    void addPositions(VertexLayout layout, const GeometryRange& range, const std::vector<Vertex>& vertices)
+    {
+        Layout& l = layouts[layout];
+        if (l.positionVao == 0)
+        {
+            glGenVertexArrays(1, &l.positionVao);
+            glState().bindVertexArray(l.positionVao);
+            glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+            glState().bindVertexArray(0);
+            labelObject(GL_VERTEX_ARRAY, l.positionVao, "geometry pool positions VAO, layout " + std::to_string(layout));
+        }
+        const std::vector<glm::vec3> positions = packPositions(vertices);
+        reservePositions(layout, static_cast<size_t>(range.baseVertex) + positions.size());
+        glNamedBufferSubData(l.positionBuffer, static_cast<GLintptr>(range.baseVertex * sizeof(glm::vec3)), positions.size() * sizeof(glm::vec3), positions.data());
+    }
+
+    // the VAO of a layout, with the pool's index buffer as its element buffer
+    unsigned int vao(VertexLayout layout) const { return layouts[layout].vao; }
+    // the same over the layout's positions alone, 0 before any addPositions
+    unsigned int positionVao(VertexLayout layout) const { return layouts[layout].positionVao; }
+    unsigned int indices() const { return indexBuffer; }
+    // the vertex buffer of a layout, for compute passes reading the vertices themselves
+    unsigned int vertices(VertexLayout layout) const { return layouts[layout].vertexBuffer; }
+    size_t vertexBytes() const
+    {
+        size_t bytes = 0;
+        for (unsigned int l = 0; l < LAYOUT_COUNT; l++)
+            bytes += layouts[l].vertexCount * vertexSize(static_cast<VertexLayout>(l));
+        return bytes;
+    }
+    size_t indexBytes() const { return indexCount * sizeof(unsigned int); }
+
+    void release()
+    {
+        for (Layout& l : layouts)
+        {
+            if (l.vao != 0) glState().deleteVertexArrays(1, &l.vao);
+            if (l.vertexBuffer != 0) glState().deleteBuffers(1, &l.vertexBuffer);
+            if (l.positionVao != 0) glState().deleteVertexArrays(1, &l.positionVao);
+            if (l.positionBuffer != 0) glState().deleteBuffers(1, &l.positionBuffer);
+            l = Layout{};
+        }
+        if (indexBuffer != 0) glState().deleteBuffers(1, &indexBuffer);
+        indexBuffer = 0;
+        indexCount = indexCapacity = 0;
+        indexAllocation.reset();
+    }
+
+private:
+    static constexpr unsigned int LAYOUT_COUNT = 3;
+    static constexpr size_t INITIAL_VERTICES = 1 << 16;
+    static constexpr size_t INITIAL_INDICES = 1 << 18;
+
+    struct Layout
+    {
+        unsigned int vao = 0;
+        unsigned int vertexBuffer = 0;
+        size_t vertexCount = 0;
+        size_t vertexCapacity = 0;
+        GpuAllocation allocation{GPU_MEMORY_GEOMETRY};
+        unsigned int positionVao = 0;
+        unsigned int positionBuffer = 0;
+        size_t positionCapacity = 0;
+        GpuAllocation positionAllocation{GPU_MEMORY_GEOMETRY};
+    };
+
+    Layout layouts[LAYOUT_COUNT];
+    unsigned int indexBuffer = 0;
+    size_t indexCount = 0;
+    size_t indexCapacity = 0;
+    GpuAllocation indexAllocation{GPU_MEMORY_GEOMETRY};
+
+    void createLayout(VertexLayout layout)
+    {
+        glGenVertexArrays(1, &layouts[layout].vao);
+        reserveVertices(layout, INITIAL_VERTICES);
+        reserveIndices(INITIAL_INDICES);
+        glState().bindVertexArray(layouts[layout].vao);
+        glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        glState().bindVertexArray(0);
+        labelObject(GL_VERTEX_ARRAY, layouts[layout].vao, "geometry pool VAO, layout " + std::to_string(layout));
+    }
+
+    // a buffer of the given size holding the first keepBytes of the old one, its storage immutable and written
+    // with glNamedBufferSubData as meshes are added
+    static unsigned int grow(unsigned int old, size_t keepBytes, size_t bytes)
+    {
+        unsigned int buffer = 0;
+        glCreateBuffers(1, &buffer);
+        glNamedBufferStorage(buffer, static_cast<GLsizeiptr>(bytes), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        if (old != 0)
+        {
+            if (keepBytes > 0)
+                glCopyNamedBufferSubData(old, buffer, 0, 0, static_cast<GLsizeiptr>(keepBytes));
+            glState().deleteBuffers(1, &old);
+        }
+        return buffer;
+    }
+
+    void reserveVertices(VertexLayout layout, size_t count)
+    {
+        Layout& l = layouts[layout];
+        if (count <= l.vertexCapacity)
+            return;
+        l.vertexCapacity = std::max(count, 2 * l.vertexCapacity);
+        l.vertexBuffer = grow(l.vertexBuffer, l.vertexCount * vertexSize(layout), l.vertexCapacity * vertexSize(layout));
+        l.allocation.set(l.vertexCapacity * vertexSize(layout));
+        labelObject(GL_BUFFER, l.vertexBuffer, "geometry pool vertices, layout " + std::to_string(layout));
+        glState().bindVertexArray(l.vao);
+        glState().bindBuffer(GL_ARRAY_BUFFER, l.vertexBuffer);
+        setVertexAttributes(layout);
+        glState().bindVertexArray(0);
+        glState().bindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void reservePositions(VertexLayout layout, size_t count)
+    {
+        Layout& l = layouts[layout];
+        if (count <= l.positionCapacity)
+            return;
+        const size_t keep = l.positionCapacity;
+        l.positionCapacity = std::max({count, l.vertexCapacity, 2 * l.positionCapacity});
+        l.positionBuffer = grow(l.positionBuffer, keep * sizeof(glm::vec3), l.positionCapacity * sizeof(glm::vec3));
+        l.positionAllocation.set(l.positionCapacity * sizeof(glm::vec3));
+        labelObject(GL_BUFFER, l.positionBuffer, "geometry pool positions, layout " + std::to_string(layout));
+        glState().bindVertexArray(l.positionVao);
+        glState().bindBuffer(GL_ARRAY_BUFFER, l.positionBuffer);
+        setPositionAttribute();
+        glState().bindVertexArray(0);
+        glState().bindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void reserveIndices(size_t count)
+    {
+        if (count <= indexCapacity)
+            return;
+        indexCapacity = std::max(count, 2 * indexCapacity);
+        indexBuffer = grow(indexBuffer, indexCount * sizeof(unsigned int), indexCapacity * sizeof(unsigned int));
+        indexAllocation.set(indexCapacity * sizeof(unsigned int));
+        labelObject(GL_BUFFER, indexBuffer, "geometry pool indices");
+        // the element buffer is VAO state, every layout draws from the new one
+        for (const Layout& l : layouts)
+            for (unsigned int vao : {l.vao, l.positionVao})
+            {
+                if (vao == 0)
+                    continue;
+                glState().bindVertexArray(vao);
+                glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+            }
+        glState().bindVertexArray(0);
+    }
+};
+
+// the pool Model and SphereCreator allocate from when asked to, release it before the GL context goes
+inline GeometryPool& geometryPool()
+{
+    static GeometryPool pool;
+    return pool;
+}
+
+#endif
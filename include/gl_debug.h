@@ -0,0 +1,84 @@
+#ifndef GL_DEBUG_H
+#define GL_DEBUG_H
+
+#include <glad/glad.h>
+
+#include <string>
+
+// Names for frame captures in RenderDoc or Nsight: GL objects labelled with the file they came from and passes
+// wrapped in debug groups (KHR_debug, core since 4.3). Release builds (NDEBUG) compile all of it away unless
+// GL_DEBUG_LABELS is defined; DISABLE_GL_DEBUG_LABELS turns it off everywhere. An object only exists once it has
+// been bound, so label it after its first bind.
+#if !defined(GL_DEBUG_LABELS) && !defined(NDEBUG) && !defined(DISABLE_GL_DEBUG_LABELS)
+#define GL_DEBUG_LABELS
+#endif
+#if defined(GL_DEBUG_LABELS) && defined(DISABLE_GL_DEBUG_LABELS)
+#undef GL_DEBUG_LABELS
+#endif
+
+// identifier is GL_BUFFER, GL_VERTEX_ARRAY, GL_TEXTURE, GL_PROGRAM, GL_FRAMEBUFFER, ...; name 0 is skipped
+inline void labelObject(GLenum identifier, GLuint name, const char* label)
+{
+#ifdef GL_DEBUG_LABELS
+    // GL_MAX_LABEL_LENGTH is at least 256, the end of a long path is the part worth keeping
+    static const size_t MAX_LABEL = 255;
+    if (name == 0 || !glObjectLabel || !label)
+        return;
+    const std::string text(label);
+    const std::string kept = text.size() > MAX_LABEL ? text.substr(text.size() - MAX_LABEL) : text;
+    glObjectLabel(identifier, name, -1, kept.c_str());
+#else
+    (void)identifier; (void)name; (void)label;
+#endif
+}
+
+inline void labelObject(GLenum identifier, GLuint name, const std::string& label)
+{
+    labelObject(identifier, name, label.c_str());
+}
+
+// the file name of a path, what labels are made of
+inline std::string labelOf(const std::string& path)
+{
+    const size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+inline void pushDebugGroup(const char* name)
+{
+#ifdef GL_DEBUG_LABELS
+    if (glPushDebugGroup)
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+#else
+    (void)name;
+#endif
+}
+
+inline void popDebugGroup()
+{
+#ifdef GL_DEBUG_LABELS
+    if (glPopDebugGroup)
+        glPopDebugGroup();
+#endif
+}
+
+// a debug group for the enclosing block
+class GlDebugGroup
+{
+public:
+    explicit GlDebugGroup(const char* name) { pushDebugGroup(name); }
+    ~GlDebugGroup() { popDebugGroup(); }
+
+    GlDebugGroup(const GlDebugGroup&) = delete;
+    GlDebugGroup& operator=(const GlDebugGroup&) = delete;
+};
+
+#define GL_DEBUG_GROUP_CONCAT_INNER(a, b) a##b
+#define GL_DEBUG_GROUP_CONCAT(a, b) GL_DEBUG_GROUP_CONCAT_INNER(a, b)
+#ifdef GL_DEBUG_LABELS
+#define GL_DEBUG_GROUP(name) GlDebugGroup GL_DEBUG_GROUP_CONCAT(glDebugGroup, __LINE__)(name)
+#else
+#define GL_DEBUG_GROUP(name) ((void)0)
+#endif
+
+#endif
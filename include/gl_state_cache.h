@@ -0,0 +1,423 @@
+#ifndef GL_STATE_CACHE_H
+#define GL_STATE_CACHE_H
+
+#include <glad/glad.h>
+
+#include <iostream>
+
+// The binds the program has made, so a bind of what is already bound is filtered out before it reaches the driver.
+// Every program, vertex array, texture and buffer bind, and every delete of those, goes through glState() for
+// this to hold; the element buffer is VAO state and is passed straight through. Third-party code that binds
+// behind its back must restore what it found (the ImGui backend does) or be followed by invalidate().
+//
+// With validation on, every filtered bind is checked against glGet first and a stale entry is reported and bound
+// anyway, and validate() compares the whole view. Both stall the pipeline, they are a debugging aid.
+class GlStateCache
+{
+public:
+    static const unsigned int MAX_UNITS = 32;
+    static const unsigned int MAX_INDEXED = 32;     // uniform and shader storage binding points tracked
+
+    struct Stats
+    {
+        unsigned int issued = 0;    // calls that reached GL
+        unsigned int filtered = 0;  // calls that would have bound what was already bound
+        unsigned int stale = 0;     // filtered calls validation found GL disagreeing with
+    };
+
+    GlStateCache()
+    {
+        invalidate();
+    }
+
+    // forgets everything, the next call of each kind goes to GL
+    void invalidate()
+    {
+        program = vertexArray = activeUnit = depth = colorWrite = UNKNOWN;
+        for (unsigned int u = 0; u < MAX_UNITS; u++)
+            for (unsigned int t = 0; t < TEXTURE_TARGETS; t++)
+                textures[u][t] = UNKNOWN;
+        for (unsigned int b = 0; b < BUFFER_TARGETS; b++)
+            buffers[b] = UNKNOWN;
+        for (unsigned int i = 0; i < MAX_INDEXED; i++)
+            uniformBlocks[i] = storageBlocks[i] = UNKNOWN;
+    }
+
+    void setValidation(bool on) { validating = on; }
+    bool validation() const { return validating; }
+
+    void useProgram(GLuint id)
+    {
+        if (filter(program, id, GL_CURRENT_PROGRAM))
+            return;
+        glUseProgram(id);
+        program = id;
+    }
+
+    void bindVertexArray(GLuint id)
+    {
+        if (filter(vertexArray, id, GL_VERTEX_ARRAY_BINDING))
+            return;
+        glBindVertexArray(id);
+        vertexArray = id;
+    }
+
+    // GL_TEXTURE0 + unit, as glActiveTexture
+    void activeTexture(GLenum texture)
+    {
+        const unsigned int unit = texture - GL_TEXTURE0;
+        if (filter(activeUnit, unit, GL_ACTIVE_TEXTURE, texture))
+            return;
+        glActiveTexture(texture);
+        activeUnit = unit;
+    }
+
+    // to the active unit, as glBindTexture
+    void bindTexture(GLenum target, GLuint id)
+    {
+        const int t = textureTarget(target);
+        if (t < 0 || activeUnit >= MAX_UNITS)
+        {
+            issue();
+            glBindTexture(target, id);
+            return;
+        }
+        if (filter(textures[activeUnit][t], id, textureBindingQuery(t)))
+            return;
+        glBindTexture(target, id);
+        textures[activeUnit][t] = id;
+    }
+
+    void bindBuffer(GLenum target, GLuint id)
+    {
+        const int b = bufferTarget(target);
+        if (b < 0)
+        {
+            issue();
+            glBindBuffer(target, id);
+            return;
+        }
+        if (filter(buffers[b], id, bufferBindingQuery(b)))
+            return;
+        glBindBuffer(target, id);
+        buffers[b] = id;
+    }
+
+    // also binds the generic point, as GL does
+    void bindBufferBase(GLenum target, GLuint index, GLuint id)
+    {
+        unsigned int* slot = indexedSlot(target, index);
+        if (slot && filter(*slot, id, target == GL_UNIFORM_BUFFER ? GL_UNIFORM_BUFFER_BINDING : GL_SHADER_STORAGE_BUFFER_BINDING, 0, index))
+        {
+            bindBuffer(target, id);
+            return;
+        }
+        if (!slot)
+            issue();
+        glBindBufferBase(target, index, id);
+        if (slot)
+            *slot = id;
+        setGenericBuffer(target, id);
+    }
+
+    // always reaches GL, the range is not tracked: the next bindBufferBase of the point goes through
+    void bindBufferRange(GLenum target, GLuint index, GLuint id, GLintptr offset, GLsizeiptr size)
+    {
+        issue();
+        glBindBufferRange(target, index, id, offset, size);
+        if (unsigned int* slot = indexedSlot(target, index))
+            *slot = RANGED;
+        setGenericBuffer(target, id);
+    }
+
+    // under reversed depth (depth_convention.h) the comparison is turned around on the way to GL, GL_LESS still
+    // passing what is nearer
+    void depthFunc(GLenum func)
+    {
+        if (reversedDepth)
+            func = flippedDepthFunc(func);
+        if (filter(depth, func, GL_DEPTH_FUNC))
+            return;
+        glDepthFunc(func);
+        depth = func;
+    }
+
+    // the function last asked for keeps its meaning across the switch
+    void setDepthReversed(bool reversed)
+    {
+        if (reversed == reversedDepth)
+            return;
+        reversedDepth = reversed;
+        if (depth != UNKNOWN)
+        {
+            depth = flippedDepthFunc(depth);
+            issue();
+            glDepthFunc(depth);
+        }
+    }
+    bool depthReversed() const { return reversedDepth; }
+
+    static GLenum flippedDepthFunc(GLenum func)
+    {
+        switch (func)
+        {
+            case GL_LESS: return GL_GREATER;
+            case GL_LEQUAL: return GL_GEQUAL;
+            case GL_GREATER: return GL_LESS;
+            case GL_GEQUAL: return GL_LEQUAL;
+            default: return func;
+        }
+    }
+
+    // all four channels alike
+    void colorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha)
+    {
+        const unsigned int mask = (red ? 1u : 0u) | (green ? 2u : 0u) | (blue ? 4u : 0u) | (alpha ? 8u : 0u);
+        if (filter(colorWrite, mask, GL_COLOR_WRITEMASK))
+            return;
+        glColorMask(red, green, blue, alpha);
+        colorWrite = mask;
+    }
+
+    // deleting a bound object binds 0 in its place, and its name may come back from the next glGen
+    void deleteVertexArrays(GLsizei n, const GLuint* ids)
+    {
+        for (GLsizei i = 0; i < n; i++)
+            if (ids[i] != 0 && vertexArray == ids[i])
+                vertexArray = 0;
+        glDeleteVertexArrays(n, ids);
+    }
+
+    void deleteBuffers(GLsizei n, const GLuint* ids)
+    {
+        for (GLsizei i = 0; i < n; i++)
+        {
+            if (ids[i] == 0)
+                continue;
+            for (unsigned int b = 0; b < BUFFER_TARGETS; b++)
+                if (buffers[b] == ids[i])
+                    buffers[b] = 0;
+            for (unsigned int k = 0; k < MAX_INDEXED; k++)
+            {
+                if (uniformBlocks[k] == ids[i]) uniformBlocks[k] = 0;
+                if (storageBlocks[k] == ids[i]) storageBlocks[k] = 0;
+            }
+        }
+        // a deleted buffer leaves the ranges that held it too, and which ones is not known
+        for (unsigned int k = 0; k < MAX_INDEXED; k++)
+        {
+            if (uniformBlocks[k] == RANGED) uniformBlocks[k] = UNKNOWN;
+            if (storageBlocks[k] == RANGED) storageBlocks[k] = UNKNOWN;
+        }
+        glDeleteBuffers(n, ids);
+    }
+
+    void deleteTextures(GLsizei n, const GLuint* ids)
+    {
+        for (GLsizei i = 0; i < n; i++)
+            for (unsigned int u = 0; u < MAX_UNITS && ids[i] != 0; u++)
+                for (unsigned int t = 0; t < TEXTURE_TARGETS; t++)
+                    if (textures[u][t] == ids[i])
+                        textures[u][t] = 0;
+        glDeleteTextures(n, ids);
+    }
+
+    // a program in use outlives its deletion and keeps its name until replaced, using it again must reach GL
+    void deleteProgram(GLuint id)
+    {
+        if (id != 0 && program == id)
+            program = UNKNOWN;
+        glDeleteProgram(id);
+    }
+
+    // compares everything known against glGet, reporting and forgetting what disagrees. False on any mismatch.
+    bool validate()
+    {
+        bool agree = true;
+        agree &= agrees(program, GL_CURRENT_PROGRAM, "program");
+        agree &= agrees(vertexArray, GL_VERTEX_ARRAY_BINDING, "vertex array");
+        agree &= agrees(depth, GL_DEPTH_FUNC, "depth func");
+        for (unsigned int b = 0; b < BUFFER_TARGETS; b++)
+            agree &= agrees(buffers[b], bufferBindingQuery(b), "buffer");
+        for (unsigned int k = 0; k < MAX_INDEXED; k++)
+        {
+            agree &= agreesIndexed(uniformBlocks[k], GL_UNIFORM_BUFFER_BINDING, k, "uniform block");
+            agree &= agreesIndexed(storageBlocks[k], GL_SHADER_STORAGE_BUFFER_BINDING, k, "storage block");
+        }
+        GLint active = 0;
+        glGetIntegerv(GL_ACTIVE_TEXTURE, &active);
+        if (activeUnit != UNKNOWN && static_cast<unsigned int>(active) - GL_TEXTURE0 != activeUnit)
+        {
+            report("active texture");
+            activeUnit = UNKNOWN;
+            agree = false;
+        }
+        for (unsigned int u = 0; u < MAX_UNITS; u++)
+        {
+            glActiveTexture(GL_TEXTURE0 + u);
+            for (unsigned int t = 0; t < TEXTURE_TARGETS; t++)
+                agree &= agrees(textures[u][t], textureBindingQuery(t), "texture");
+        }
+        glActiveTexture(static_cast<GLenum>(active));
+        return agree;
+    }
+
+    const Stats& statistics() const { return stats; }
+    void resetStatistics() { stats = Stats(); }
+
+private:
+    static const unsigned int UNKNOWN = 0xFFFFFFFFu;
+    static const unsigned int RANGED = 0xFFFFFFFEu;     // an indexed point bound to part of a buffer
+    static const unsigned int TEXTURE_TARGETS = 3;
+    static const unsigned int BUFFER_TARGETS = 7;
+
+    unsigned int program;
+    unsigned int vertexArray;
+    unsigned int activeUnit;
+    unsigned int depth;
+    unsigned int colorWrite;
+    unsigned int textures[MAX_UNITS][TEXTURE_TARGETS];
+    unsigned int buffers[BUFFER_TARGETS];
+    unsigned int uniformBlocks[MAX_INDEXED];
+    unsigned int storageBlocks[MAX_INDEXED];
+    bool validating = false;
+    bool reversedDepth = false;
+    Stats stats;
+
+    static int textureTarget(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_TEXTURE_2D: return 0;
+        case GL_TEXTURE_CUBE_MAP: return 1;
+        case GL_TEXTURE_2D_ARRAY: return 2;
+        default: return -1;
+        }
+    }
+
+    static GLenum textureBindingQuery(int t)
+    {
+        static const GLenum queries[TEXTURE_TARGETS] = {GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_CUBE_MAP, GL_TEXTURE_BINDING_2D_ARRAY};
+        return queries[t];
+    }
+
+    static int bufferTarget(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_ARRAY_BUFFER: return 0;
+        case GL_UNIFORM_BUFFER: return 1;
+        case GL_SHADER_STORAGE_BUFFER: return 2;
+        case GL_DRAW_INDIRECT_BUFFER: return 3;
+        case GL_COPY_READ_BUFFER: return 4;
+        case GL_COPY_WRITE_BUFFER: return 5;
+        case GL_PIXEL_UNPACK_BUFFER: return 6;
+        default: return -1;
+        }
+    }
+
+    static GLenum bufferBindingQuery(int b)
+    {
+        static const GLenum queries[BUFFER_TARGETS] = {GL_ARRAY_BUFFER_BINDING, GL_UNIFORM_BUFFER_BINDING, GL_SHADER_STORAGE_BUFFER_BINDING,
+                                                       GL_DRAW_INDIRECT_BUFFER_BINDING, GL_COPY_READ_BUFFER_BINDING, GL_COPY_WRITE_BUFFER_BINDING,
+                                                       GL_PIXEL_UNPACK_BUFFER_BINDING};
+        return queries[b];
+    }
+
+    unsigned int* indexedSlot(GLenum target, GLuint index)
+    {
+        if (index >= MAX_INDEXED)
+            return nullptr;
+        if (target == GL_UNIFORM_BUFFER)
+            return &uniformBlocks[index];
+        if (target == GL_SHADER_STORAGE_BUFFER)
+            return &storageBlocks[index];
+        return nullptr;
+    }
+
+    void setGenericBuffer(GLenum target, GLuint id)
+    {
+        const int b = bufferTarget(target);
+        if (b >= 0)
+            buffers[b] = id;
+    }
+
+    void issue()
+    {
+        stats.issued++;
+    }
+
+    // true when the call can be dropped: what it binds is what the cache holds, and with validation GL agrees.
+    // expected is what the query returns for it when that is not the value itself (the active texture).
+    bool filter(unsigned int& cached, unsigned int value, GLenum query, GLint expected = 0, GLuint index = UNKNOWN)
+    {
+        if (cached != value)
+        {
+            stats.issued++;
+            return false;
+        }
+        if (validating)
+        {
+            GLint actual[4] = {0, 0, 0, 0};
+            const bool mask = query == GL_COLOR_WRITEMASK;
+            GLboolean channels[4] = {GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE};
+            if (mask)
+                glGetBooleanv(query, channels);
+            else if (index != UNKNOWN)
+                glGetIntegeri_v(query, index, actual);
+            else
+                glGetIntegerv(query, actual);
+            const unsigned int seen = mask ? (channels[0] ? 1u : 0u) | (channels[1] ? 2u : 0u) | (channels[2] ? 4u : 0u) | (channels[3] ? 8u : 0u)
+                                           : static_cast<unsigned int>(actual[0]);
+            if (seen != (expected != 0 ? static_cast<unsigned int>(expected) : value))
+            {
+                report("bind");
+                stats.stale++;
+                stats.issued++;
+                return false;
+            }
+        }
+        stats.filtered++;
+        return true;
+    }
+
+    bool agrees(unsigned int& cached, GLenum query, const char* what)
+    {
+        if (cached == UNKNOWN)
+            return true;
+        GLint actual = 0;
+        glGetIntegerv(query, &actual);
+        if (static_cast<unsigned int>(actual) == cached)
+            return true;
+        report(what);
+        cached = UNKNOWN;
+        return false;
+    }
+
+    bool agreesIndexed(unsigned int& cached, GLenum query, unsigned int index, const char* what)
+    {
+        if (cached == UNKNOWN || cached == RANGED)
+            return true;
+        GLint actual = 0;
+        glGetIntegeri_v(query, index, &actual);
+        if (static_cast<unsigned int>(actual) == cached)
+            return true;
+        report(what);
+        cached = UNKNOWN;
+        return false;
+    }
+
+    static void report(const char* what)
+    {
+        std::cout << "ERROR::GL_STATE_CACHE:: " << what << " binding out of date, something bound behind the cache" << std::endl;
+    }
+};
+
+// the cache of the one GL context the program makes
+inline GlStateCache& glState()
+{
+    static GlStateCache cache;
+    return cache;
+}
+
+#endif
@@ -0,0 +1,913 @@
+#ifndef GLES_COMPAT_H
+#define GLES_COMPAT_H
+
+#include <glad/glad.h>
+
+#include <gl_state_cache.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// What an OpenGL ES 3.1/3.2 context is missing of the desktop 4.6 the renderer is written against, filled in
+// once the context is current. The bundled glad is generated for desktop GL, and on an ES context it reads
+// "OpenGL ES 3.2" as version 3.2 and loads nothing named after a later core version, although ES has most of
+// those under the same name (compute, images, storage, program interfaces, texture storage, separate vertex
+// formats, debug groups). load() asks the loader for them again, and for the extension-suffixed ones (EXT, OES,
+// KHR) of what ES only has as an extension: clip control, base instance, texture views, buffer storage, timer
+// queries, texture clears.
+//
+// What ES has no form of is emulated on top of what it has. Direct state access binds the object, edits it and
+// puts back what was bound: buffers on the copy targets through the state cache, textures on the active unit under
+// the target they were created with, framebuffers, renderbuffers and vertex arrays each on their own binding. The
+// multi-draws are loops of single draws, the indirect ones reading their commands back from the bound indirect
+// buffer, which waits for the GPU when it wrote them; gl_BaseInstance and gl_DrawID become the glesBaseInstance and
+// glesDrawId uniforms (Shader::sourceProfile), set on the current program around each draw, and without
+// GL_EXT_base_instance a draw's instanced vertex bindings are moved along by its base instance instead.
+class GlesCompat
+{
+public:
+    // with the context current, after gladLoadGLLoader and with the same loader
+    static void load(GLADloadproc loader)
+    {
+        State& s = state();
+        s.loaded = true;
+
+        // ES core under names glad skipped, or under a suffix on a 3.1 context
+        resolve(glFenceSync, loader, "glFenceSync");
+        resolve(glDeleteSync, loader, "glDeleteSync");
+        resolve(glClientWaitSync, loader, "glClientWaitSync");
+        resolve(glWaitSync, loader, "glWaitSync");
+        resolve(glGetInteger64i_v, loader, "glGetInteger64i_v");
+        resolve(glGetBufferParameteri64v, loader, "glGetBufferParameteri64v");
+        resolve(glDrawElementsBaseVertex, loader, "glDrawElementsBaseVertex");
+        resolve(glDrawElementsInstancedBaseVertex, loader, "glDrawElementsInstancedBaseVertex");
+        resolve(glFramebufferTexture, loader, "glFramebufferTexture");
+        resolve(glColorMaski, loader, "glColorMaski");
+        resolve(glVertexAttribDivisor, loader, "glVertexAttribDivisor");
+        resolve(glPatchParameteri, loader, "glPatchParameteri");
+        resolve(glGetProgramBinary, loader, "glGetProgramBinary");
+        resolve(glProgramBinary, loader, "glProgramBinary");
+        resolve(glProgramParameteri, loader, "glProgramParameteri");
+        resolve(glClearDepthf, loader, "glClearDepthf");
+        resolve(glBindImageTexture, loader, "glBindImageTexture");
+        resolve(glMemoryBarrier, loader, "glMemoryBarrier");
+        resolve(glTexStorage2D, loader, "glTexStorage2D");
+        resolve(glTexStorage3D, loader, "glTexStorage3D");
+        resolve(glGetInternalformativ, loader, "glGetInternalformativ");
+        resolve(glGetTexLevelParameteriv, loader, "glGetTexLevelParameteriv");
+        resolve(glDispatchCompute, loader, "glDispatchCompute");
+        resolve(glGetProgramResourceIndex, loader, "glGetProgramResourceIndex");
+        resolve(glGetProgramResourceName, loader, "glGetProgramResourceName");
+        resolve(glGetProgramResourceiv, loader, "glGetProgramResourceiv");
+        resolve(glVertexAttribFormat, loader, "glVertexAttribFormat");
+        resolve(glVertexAttribIFormat, loader, "glVertexAttribIFormat");
+        resolve(glVertexAttribBinding, loader, "glVertexAttribBinding");
+        resolve(glVertexBindingDivisor, loader, "glVertexBindingDivisor");
+        resolve(glBindVertexBuffer, loader, "glBindVertexBuffer");
+        resolve(glObjectLabel, loader, "glObjectLabel");
+        resolve(glPushDebugGroup, loader, "glPushDebugGroup");
+        resolve(glPopDebugGroup, loader, "glPopDebugGroup");
+
+        // desktop names ES only has as extensions, whatever the loader handed glad for them
+        glClipControl = nullptr;
+        glTextureView = nullptr;
+        glClearTexImage = nullptr;
+        glGetQueryObjectiv = nullptr;
+        resolveSuffixed(glClipControl, loader, "glClipControl");
+        resolveSuffixed(glTextureView, loader, "glTextureView");
+        resolveSuffixed(glClearTexImage, loader, "glClearTexImage");
+        resolveSuffixed(glGetQueryObjectiv, loader, "glGetQueryObjectiv");
+        resolveSuffixed(glGetQueryObjectui64v, loader, "glGetQueryObjectui64v");
+        resolveSuffixed(glQueryCounter, loader, "glQueryCounter");
+        s.timerQueries = glGetQueryObjectiv && glGetQueryObjectui64v && glQueryCounter;
+        if (!s.timerQueries)
+        {
+            // without GL_EXT_disjoint_timer_query every time reads as 0 and is always there
+            s.beginQuery = glBeginQuery;
+            s.endQuery = glEndQuery;
+            glBeginQuery = beginQuery;
+            glEndQuery = endQuery;
+            glQueryCounter = queryCounter;
+            glGetQueryObjectiv = getQueryObjectiv;
+            glGetQueryObjectui64v = getQueryObjectui64v;
+        }
+        glClearDepth = clearDepth;
+        glDrawBuffer = drawBuffer;
+
+        // the extensions' entry points the draws go through
+        s.bufferStorage = nullptr;
+        resolveSuffixed(s.bufferStorage, loader, "glBufferStorage");
+        s.arraysBaseInstance = nullptr;
+        s.elementsBaseInstance = nullptr;
+        resolveSuffixed(s.arraysBaseInstance, loader, "glDrawArraysInstancedBaseInstance");
+        resolveSuffixed(s.elementsBaseInstance, loader, "glDrawElementsInstancedBaseVertexBaseInstance");
+        GLint bindings = 0;
+        glGetIntegerv(GL_MAX_VERTEX_ATTRIB_BINDINGS, &bindings);
+        s.vertexBindings = static_cast<GLuint>(std::min<GLint>(std::max<GLint>(bindings, 0), MAX_VERTEX_BINDINGS));
+
+        // the base instance and the draw parameters are passed to the shaders, so these are never the driver's
+        glDrawArraysInstancedBaseInstance = drawArraysInstancedBaseInstance;
+        glDrawElementsInstancedBaseVertexBaseInstance = drawElementsInstancedBaseVertexBaseInstance;
+        glMultiDrawArrays = multiDrawArrays;
+        glDrawArraysIndirect = drawArraysIndirect;
+        glDrawElementsIndirect = drawElementsIndirect;
+        glMultiDrawArraysIndirect = multiDrawArraysIndirect;
+        glMultiDrawElementsIndirect = multiDrawElementsIndirect;
+        if (!glClearTexImage)
+            glClearTexImage = clearTexImage;
+
+        // direct state access
+        glCreateBuffers = createBuffers;
+        glNamedBufferStorage = namedBufferStorage;
+        glNamedBufferSubData = namedBufferSubData;
+        glCopyNamedBufferSubData = copyNamedBufferSubData;
+        glClearNamedBufferData = clearNamedBufferData;
+        glGetNamedBufferSubData = getNamedBufferSubData;
+        glUnmapNamedBuffer = unmapNamedBuffer;
+        glCreateTextures = createTextures;
+        glTextureStorage2D = textureStorage2D;
+        glTextureStorage3D = textureStorage3D;
+        glTextureSubImage2D = textureSubImage2D;
+        glTextureSubImage3D = textureSubImage3D;
+        glCompressedTextureSubImage2D = compressedTextureSubImage2D;
+        glCompressedTextureSubImage3D = compressedTextureSubImage3D;
+        glGenerateTextureMipmap = generateTextureMipmap;
+        glCreateFramebuffers = createFramebuffers;
+        glNamedFramebufferTexture = namedFramebufferTexture;
+        glNamedFramebufferRenderbuffer = namedFramebufferRenderbuffer;
+        glNamedFramebufferDrawBuffer = namedFramebufferDrawBuffer;
+        glNamedFramebufferDrawBuffers = namedFramebufferDrawBuffers;
+        glNamedFramebufferReadBuffer = namedFramebufferReadBuffer;
+        glBlitNamedFramebuffer = blitNamedFramebuffer;
+        glClearNamedFramebufferuiv = clearNamedFramebufferuiv;
+        glCheckNamedFramebufferStatus = checkNamedFramebufferStatus;
+        glCreateRenderbuffers = createRenderbuffers;
+        glNamedRenderbufferStorage = namedRenderbufferStorage;
+        glNamedRenderbufferStorageMultisample = namedRenderbufferStorageMultisample;
+        glVertexArrayAttribBinding = vertexArrayAttribBinding;
+        glVertexArrayAttribFormat = vertexArrayAttribFormat;
+        glVertexArrayAttribIFormat = vertexArrayAttribIFormat;
+        glVertexArrayBindingDivisor = vertexArrayBindingDivisor;
+        glVertexArrayVertexBuffer = vertexArrayVertexBuffer;
+        glEnableVertexArrayAttrib = enableVertexArrayAttrib;
+        glDisableVertexArrayAttrib = disableVertexArrayAttrib;
+    }
+
+    static bool loaded() { return state().loaded; }
+    // what the context has of the extensions, once loaded
+    static bool baseInstance() { return state().arraysBaseInstance && state().elementsBaseInstance; }
+    static bool bufferStorage() { return state().bufferStorage != nullptr; }
+    static bool timerQueries() { return state().timerQueries; }
+
+    static bool hasExtension(const char* extension)
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint e = 0; e < count; e++)
+        {
+            const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(e)));
+            if (name && std::strcmp(name, extension) == 0)
+                return true;
+        }
+        return false;
+    }
+
+private:
+    static const GLuint MAX_VERTEX_BINDINGS = 16;
+    static const size_t CLEAR_CHUNK = 64 * 1024;
+
+    typedef void (APIENTRYP BufferStorage)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+    typedef void (APIENTRYP ArraysBaseInstance)(GLenum mode, GLint first, GLsizei count, GLsizei instancecount, GLuint baseinstance);
+    typedef void (APIENTRYP ElementsBaseInstance)(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount,
+                                                  GLint basevertex, GLuint baseinstance);
+
+    // the layouts of GL's indirect commands
+    struct ArraysCommand
+    {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint first;
+        GLuint baseInstance;
+    };
+
+    struct ElementsCommand
+    {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    struct DrawParameterLocations
+    {
+        GLint baseInstance;
+        GLint drawId;
+    };
+
+    struct State
+    {
+        bool loaded = false;
+        bool timerQueries = false;
+        BufferStorage bufferStorage = nullptr;
+        ArraysBaseInstance arraysBaseInstance = nullptr;
+        ElementsBaseInstance elementsBaseInstance = nullptr;
+        PFNGLBEGINQUERYPROC beginQuery = nullptr;
+        PFNGLENDQUERYPROC endQuery = nullptr;
+        GLuint vertexBindings = 0;
+        GLuint clearFramebuffer = 0;
+        std::unordered_map<GLuint, GLenum> textureTargets;                 // of the names glCreateTextures made
+        std::unordered_map<GLuint, DrawParameterLocations> locations;      // per program, programs are not deleted
+        std::vector<unsigned char> commands;
+    };
+
+    static State& state()
+    {
+        static State s;
+        return s;
+    }
+
+    // the entry point under its own name, then under the suffixes ES extensions give it
+    template <typename F>
+    static void resolve(F& pointer, GLADloadproc loader, const char* name)
+    {
+        if (!pointer)
+            pointer = reinterpret_cast<F>(loader(name));
+        if (!pointer)
+            resolveSuffixed(pointer, loader, name);
+    }
+
+    template <typename F>
+    static void resolveSuffixed(F& pointer, GLADloadproc loader, const char* name)
+    {
+        static const char* suffixes[] = {"EXT", "OES", "KHR"};
+        for (const char* suffix : suffixes)
+            if (!pointer)
+                pointer = reinterpret_cast<F>(loader((std::string(name) + suffix).c_str()));
+    }
+
+    // bytes of a pixel of format and type, 0 for a packed or unknown one
+    static size_t pixelBytes(GLenum format, GLenum type)
+    {
+        size_t components = 0;
+        switch (format)
+        {
+        case GL_RED: case GL_RED_INTEGER: case GL_DEPTH_COMPONENT: components = 1; break;
+        case GL_RG: case GL_RG_INTEGER: components = 2; break;
+        case GL_RGB: case GL_RGB_INTEGER: components = 3; break;
+        case GL_RGBA: case GL_RGBA_INTEGER: components = 4; break;
+        default: return 0;
+        }
+        switch (type)
+        {
+        case GL_UNSIGNED_BYTE: case GL_BYTE: return components;
+        case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT: return 2 * components;
+        case GL_UNSIGNED_INT: case GL_INT: case GL_FLOAT: return 4 * components;
+        default: return 0;
+        }
+    }
+
+    static GLenum textureBinding(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_TEXTURE_CUBE_MAP: return GL_TEXTURE_BINDING_CUBE_MAP;
+        case GL_TEXTURE_2D_ARRAY: return GL_TEXTURE_BINDING_2D_ARRAY;
+        case GL_TEXTURE_3D: return GL_TEXTURE_BINDING_3D;
+        case GL_TEXTURE_CUBE_MAP_ARRAY: return GL_TEXTURE_BINDING_CUBE_MAP_ARRAY;
+        case GL_TEXTURE_2D_MULTISAMPLE: return GL_TEXTURE_BINDING_2D_MULTISAMPLE;
+        default: return GL_TEXTURE_BINDING_2D;
+        }
+    }
+
+    static GLenum targetOf(GLuint texture)
+    {
+        const auto found = state().textureTargets.find(texture);
+        return found == state().textureTargets.end() ? GL_TEXTURE_2D : found->second;
+    }
+
+    // the texture bound to the active unit while it lives, what was there before bound again after
+    class TextureScope
+    {
+    public:
+        explicit TextureScope(GLuint texture) : target(targetOf(texture))
+        {
+            glGetIntegerv(textureBinding(target), &previous);
+            glState().bindTexture(target, texture);
+        }
+        ~TextureScope() { glState().bindTexture(target, static_cast<GLuint>(previous)); }
+        TextureScope(const TextureScope&) = delete;
+        TextureScope& operator=(const TextureScope&) = delete;
+
+        const GLenum target;
+
+    private:
+        GLint previous = 0;
+    };
+
+    // the same for a framebuffer target, GL_FRAMEBUFFER taken as the draw one
+    class FramebufferScope
+    {
+    public:
+        FramebufferScope(GLenum target, GLuint framebuffer) : target(target == GL_READ_FRAMEBUFFER ? GL_READ_FRAMEBUFFER : GL_DRAW_FRAMEBUFFER)
+        {
+            glGetIntegerv(this->target == GL_READ_FRAMEBUFFER ? GL_READ_FRAMEBUFFER_BINDING : GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+            glBindFramebuffer(this->target, framebuffer);
+        }
+        ~FramebufferScope() { glBindFramebuffer(target, static_cast<GLuint>(previous)); }
+        FramebufferScope(const FramebufferScope&) = delete;
+        FramebufferScope& operator=(const FramebufferScope&) = delete;
+
+        const GLenum target;
+
+    private:
+        GLint previous = 0;
+    };
+
+    class RenderbufferScope
+    {
+    public:
+        explicit RenderbufferScope(GLuint renderbuffer)
+        {
+            glGetIntegerv(GL_RENDERBUFFER_BINDING, &previous);
+            glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+        }
+        ~RenderbufferScope() { glBindRenderbuffer(GL_RENDERBUFFER, static_cast<GLuint>(previous)); }
+        RenderbufferScope(const RenderbufferScope&) = delete;
+        RenderbufferScope& operator=(const RenderbufferScope&) = delete;
+
+    private:
+        GLint previous = 0;
+    };
+
+    class VertexArrayScope
+    {
+    public:
+        explicit VertexArrayScope(GLuint vertexArray)
+        {
+            glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previous);
+            glState().bindVertexArray(vertexArray);
+        }
+        ~VertexArrayScope() { glState().bindVertexArray(static_cast<GLuint>(previous)); }
+        VertexArrayScope(const VertexArrayScope&) = delete;
+        VertexArrayScope& operator=(const VertexArrayScope&) = delete;
+
+    private:
+        GLint previous = 0;
+    };
+
+    // buffers
+
+    static void APIENTRY createBuffers(GLsizei n, GLuint* buffers)
+    {
+        glGenBuffers(n, buffers);
+        // a name is only a buffer once bound
+        for (GLsizei i = 0; i < n; i++)
+            glState().bindBuffer(GL_COPY_WRITE_BUFFER, buffers[i]);
+    }
+
+    // Mutable storage for what is not mapped persistently, which every edit and map below is allowed on.
+    // GL_EXT_buffer_storage only where the persistent map needs it, with the bits the emulated edits use as well.
+    static void APIENTRY namedBufferStorage(GLuint buffer, GLsizeiptr size, const void* data, GLbitfield flags)
+    {
+        glState().bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        if ((flags & GL_MAP_PERSISTENT_BIT) && state().bufferStorage)
+            state().bufferStorage(GL_COPY_WRITE_BUFFER, size, data, flags | GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT | GL_MAP_WRITE_BIT);
+        else
+            glBufferData(GL_COPY_WRITE_BUFFER, size, data, flags & (GL_DYNAMIC_STORAGE_BIT | GL_MAP_WRITE_BIT) ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
+    }
+
+    static void APIENTRY namedBufferSubData(GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data)
+    {
+        glState().bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+    }
+
+    static void APIENTRY copyNamedBufferSubData(GLuint readBuffer, GLuint writeBuffer, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size)
+    {
+        glState().bindBuffer(GL_COPY_READ_BUFFER, readBuffer);
+        glState().bindBuffer(GL_COPY_WRITE_BUFFER, writeBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, readOffset, writeOffset, size);
+    }
+
+    // the whole buffer, the pattern repeated into a chunk that is written over it piece by piece
+    static void APIENTRY clearNamedBufferData(GLuint buffer, GLenum, GLenum format, GLenum type, const void* data)
+    {
+        const size_t element = std::max<size_t>(pixelBytes(format, type), 1);
+        std::vector<unsigned char> chunk(CLEAR_CHUNK / element * element, 0);
+        if (data)
+            for (size_t at = 0; at < chunk.size(); at += element)
+                std::memcpy(chunk.data() + at, data, element);
+        glState().bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        GLint64 size = 0;
+        glGetBufferParameteri64v(GL_COPY_WRITE_BUFFER, GL_BUFFER_SIZE, &size);
+        for (GLint64 at = 0; at < size; at += static_cast<GLint64>(chunk.size()))
+            glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(at),
+                            static_cast<GLsizeiptr>(std::min<GLint64>(size - at, static_cast<GLint64>(chunk.size()))), chunk.data());
+    }
+
+    static void APIENTRY getNamedBufferSubData(GLuint buffer, GLintptr offset, GLsizeiptr size, void* data)
+    {
+        glState().bindBuffer(GL_COPY_READ_BUFFER, buffer);
+        const void* mapped = glMapBufferRange(GL_COPY_READ_BUFFER, offset, size, GL_MAP_READ_BIT);
+        if (!mapped)
+            return;
+        std::memcpy(data, mapped, static_cast<size_t>(size));
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+    }
+
+    static GLboolean APIENTRY unmapNamedBuffer(GLuint buffer)
+    {
+        glState().bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        return glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    }
+
+    // textures
+
+    static void APIENTRY createTextures(GLenum target, GLsizei n, GLuint* textures)
+    {
+        glGenTextures(n, textures);
+        for (GLsizei i = 0; i < n; i++)
+        {
+            state().textureTargets[textures[i]] = target;
+            TextureScope scope(textures[i]);
+        }
+    }
+
+    static void APIENTRY textureStorage2D(GLuint texture, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height)
+    {
+        TextureScope scope(texture);
+        glTexStorage2D(scope.target, levels, internalformat, width, height);
+    }
+
+    static void APIENTRY textureStorage3D(GLuint texture, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth)
+    {
+        TextureScope scope(texture);
+        glTexStorage3D(scope.target, levels, internalformat, width, height, depth);
+    }
+
+    static void APIENTRY textureSubImage2D(GLuint texture, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height,
+                                           GLenum format, GLenum type, const void* pixels)
+    {
+        TextureScope scope(texture);
+        glTexSubImage2D(scope.target, level, xoffset, yoffset, width, height, format, type, pixels);
+    }
+
+    // a cube map's faces are its layers to DSA, to ES each face is a 2D target of its own
+    static void APIENTRY textureSubImage3D(GLuint texture, GLint level, GLint xoffset, GLint yoffset, GLint zoffset, GLsizei width,
+                                           GLsizei height, GLsizei depth, GLenum format, GLenum type, const void* pixels)
+    {
+        TextureScope scope(texture);
+        if (scope.target != GL_TEXTURE_CUBE_MAP)
+        {
+            glTexSubImage3D(scope.target, level, xoffset, yoffset, zoffset, width, height, depth, format, type, pixels);
+            return;
+        }
+        const size_t faceBytes = pixelBytes(format, type) * static_cast<size_t>(width) * static_cast<size_t>(height);
+        for (GLsizei f = 0; f < depth; f++)
+            glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + zoffset + f, level, xoffset, yoffset, width, height, format, type,
+                            static_cast<const unsigned char*>(pixels) + f * faceBytes);
+    }
+
+    static void APIENTRY compressedTextureSubImage2D(GLuint texture, GLint level, GLint xoffset, GLint yoffset, GLsizei width,
+                                                     GLsizei height, GLenum format, GLsizei imageSize, const void* data)
+    {
+        TextureScope scope(texture);
+        glCompressedTexSubImage2D(scope.target, level, xoffset, yoffset, width, height, format, imageSize, data);
+    }
+
+    static void APIENTRY compressedTextureSubImage3D(GLuint texture, GLint level, GLint xoffset, GLint yoffset, GLint zoffset,
+                                                     GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLsizei imageSize,
+                                                     const void* data)
+    {
+        TextureScope scope(texture);
+        if (scope.target != GL_TEXTURE_CUBE_MAP)
+        {
+            glCompressedTexSubImage3D(scope.target, level, xoffset, yoffset, zoffset, width, height, depth, format, imageSize, data);
+            return;
+        }
+        const GLsizei faceBytes = depth > 0 ? imageSize / depth : 0;
+        for (GLsizei f = 0; f < depth; f++)
+            glCompressedTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + zoffset + f, level, xoffset, yoffset, width, height, format,
+                                      faceBytes, static_cast<const unsigned char*>(data) + f * faceBytes);
+    }
+
+    static void APIENTRY generateTextureMipmap(GLuint texture)
+    {
+        TextureScope scope(texture);
+        glGenerateMipmap(scope.target);
+    }
+
+    // GL_EXT_clear_texture's absence: a level attached to a framebuffer of its own and cleared, layer by layer
+    static void APIENTRY clearTexImage(GLuint texture, GLint level, GLenum format, GLenum type, const void* data)
+    {
+        State& s = state();
+        const GLenum target = targetOf(texture);
+        GLint layers = 1;
+        if (target == GL_TEXTURE_CUBE_MAP)
+            layers = 6;
+        else if (target == GL_TEXTURE_2D_ARRAY || target == GL_TEXTURE_3D)
+        {
+            TextureScope scope(texture);
+            glGetTexLevelParameteriv(target, level, GL_TEXTURE_DEPTH, &layers);
+        }
+        if (s.clearFramebuffer == 0)
+            glGenFramebuffers(1, &s.clearFramebuffer);
+        FramebufferScope scope(GL_DRAW_FRAMEBUFFER, s.clearFramebuffer);
+        const GLboolean scissor = glIsEnabled(GL_SCISSOR_TEST);
+        if (scissor)
+            glDisable(GL_SCISSOR_TEST);
+        const bool integer = format == GL_RED_INTEGER || format == GL_RG_INTEGER || format == GL_RGB_INTEGER || format == GL_RGBA_INTEGER;
+        const size_t components = std::max<size_t>(pixelBytes(format, GL_UNSIGNED_BYTE), 1);
+        GLuint uintValue[4] = {0, 0, 0, 0};
+        GLint intValue[4] = {0, 0, 0, 0};
+        GLfloat floatValue[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        for (size_t c = 0; data && c < components && c < 4; c++)
+        {
+            if (type == GL_UNSIGNED_INT)
+                uintValue[c] = static_cast<const GLuint*>(data)[c];
+            else if (type == GL_INT)
+                intValue[c] = static_cast<const GLint*>(data)[c];
+            else if (type == GL_FLOAT)
+                floatValue[c] = static_cast<const GLfloat*>(data)[c];
+            else if (type == GL_UNSIGNED_BYTE)
+                floatValue[c] = static_cast<const GLubyte*>(data)[c] / 255.0f;
+        }
+        for (GLint layer = 0; layer < layers; layer++)
+        {
+            if (target == GL_TEXTURE_CUBE_MAP)
+                glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + layer, texture, level);
+            else if (target == GL_TEXTURE_2D_ARRAY || target == GL_TEXTURE_3D)
+                glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture, level, layer);
+            else
+                glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, target, texture, level);
+            if (integer && type == GL_INT)
+                glClearBufferiv(GL_COLOR, 0, intValue);
+            else if (integer)
+                glClearBufferuiv(GL_COLOR, 0, uintValue);
+            else
+                glClearBufferfv(GL_COLOR, 0, floatValue);
+        }
+        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+        if (scissor)
+            glEnable(GL_SCISSOR_TEST);
+    }
+
+    // framebuffers and renderbuffers
+
+    static void APIENTRY createFramebuffers(GLsizei n, GLuint* framebuffers)
+    {
+        glGenFramebuffers(n, framebuffers);
+        for (GLsizei i = 0; i < n; i++)
+            FramebufferScope scope(GL_DRAW_FRAMEBUFFER, framebuffers[i]);
+    }
+
+    // a 2D level as it is, a cube map or array layered where ES 3.2 can and by its first layer where it cannot
+    static void APIENTRY namedFramebufferTexture(GLuint framebuffer, GLenum attachment, GLuint texture, GLint level)
+    {
+        FramebufferScope scope(GL_DRAW_FRAMEBUFFER, framebuffer);
+        const GLenum target = texture ? targetOf(texture) : GL_TEXTURE_2D;
+        if (target == GL_TEXTURE_2D || target == GL_TEXTURE_2D_MULTISAMPLE)
+            glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, attachment, target, texture, level);
+        else if (glFramebufferTexture)
+            glFramebufferTexture(GL_DRAW_FRAMEBUFFER, attachment, texture, level);
+        else if (target == GL_TEXTURE_CUBE_MAP)
+            glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, attachment, GL_TEXTURE_CUBE_MAP_POSITIVE_X, texture, level);
+        else
+            glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, attachment, texture, level, 0);
+    }
+
+    static void APIENTRY namedFramebufferRenderbuffer(GLuint framebuffer, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer)
+    {
+        FramebufferScope scope(GL_DRAW_FRAMEBUFFER, framebuffer);
+        glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, attachment, renderbuffertarget, renderbuffer);
+    }
+
+    static void APIENTRY namedFramebufferDrawBuffer(GLuint framebuffer, GLenum buf)
+    {
+        FramebufferScope scope(GL_DRAW_FRAMEBUFFER, framebuffer);
+        glDrawBuffers(1, &buf);
+    }
+
+    static void APIENTRY namedFramebufferDrawBuffers(GLuint framebuffer, GLsizei n, const GLenum* bufs)
+    {
+        FramebufferScope scope(GL_DRAW_FRAMEBUFFER, framebuffer);
+        glDrawBuffers(n, bufs);
+    }
+
+    static void APIENTRY namedFramebufferReadBuffer(GLuint framebuffer, GLenum src)
+    {
+        FramebufferScope scope(GL_READ_FRAMEBUFFER, framebuffer);
+        glReadBuffer(src);
+    }
+
+    static void APIENTRY blitNamedFramebuffer(GLuint readFramebuffer, GLuint drawFramebuffer, GLint srcX0, GLint srcY0, GLint srcX1,
+                                              GLint srcY1, GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter)
+    {
+        FramebufferScope read(GL_READ_FRAMEBUFFER, readFramebuffer);
+        FramebufferScope draw(GL_DRAW_FRAMEBUFFER, drawFramebuffer);
+        glBlitFramebuffer(srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter);
+    }
+
+    static void APIENTRY clearNamedFramebufferuiv(GLuint framebuffer, GLenum buffer, GLint drawbuffer, const GLuint* value)
+    {
+        FramebufferScope scope(GL_DRAW_FRAMEBUFFER, framebuffer);
+        glClearBufferuiv(buffer, drawbuffer, value);
+    }
+
+    static GLenum APIENTRY checkNamedFramebufferStatus(GLuint framebuffer, GLenum target)
+    {
+        FramebufferScope scope(target, framebuffer);
+        return glCheckFramebufferStatus(scope.target);
+    }
+
+    static void APIENTRY createRenderbuffers(GLsizei n, GLuint* renderbuffers)
+    {
+        glGenRenderbuffers(n, renderbuffers);
+        for (GLsizei i = 0; i < n; i++)
+            RenderbufferScope scope(renderbuffers[i]);
+    }
+
+    static void APIENTRY namedRenderbufferStorage(GLuint renderbuffer, GLenum internalformat, GLsizei width, GLsizei height)
+    {
+        RenderbufferScope scope(renderbuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, internalformat, width, height);
+    }
+
+    static void APIENTRY namedRenderbufferStorageMultisample(GLuint renderbuffer, GLsizei samples, GLenum internalformat, GLsizei width,
+                                                             GLsizei height)
+    {
+        RenderbufferScope scope(renderbuffer);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, internalformat, width, height);
+    }
+
+    // vertex arrays
+
+    static void APIENTRY vertexArrayAttribBinding(GLuint vaobj, GLuint attribindex, GLuint bindingindex)
+    {
+        VertexArrayScope scope(vaobj);
+        glVertexAttribBinding(attribindex, bindingindex);
+    }
+
+    static void APIENTRY vertexArrayAttribFormat(GLuint vaobj, GLuint attribindex, GLint size, GLenum type, GLboolean normalized,
+                                                 GLuint relativeoffset)
+    {
+        VertexArrayScope scope(vaobj);
+        glVertexAttribFormat(attribindex, size, type, normalized, relativeoffset);
+    }
+
+    static void APIENTRY vertexArrayAttribIFormat(GLuint vaobj, GLuint attribindex, GLint size, GLenum type, GLuint relativeoffset)
+    {
+        VertexArrayScope scope(vaobj);
+        glVertexAttribIFormat(attribindex, size, type, relativeoffset);
+    }
+
+    static void APIENTRY vertexArrayBindingDivisor(GLuint vaobj, GLuint bindingindex, GLuint divisor)
+    {
+        VertexArrayScope scope(vaobj);
+        glVertexBindingDivisor(bindingindex, divisor);
+    }
+
+    static void APIENTRY vertexArrayVertexBuffer(GLuint vaobj, GLuint bindingindex, GLuint buffer, GLintptr offset, GLsizei stride)
+    {
+        VertexArrayScope scope(vaobj);
+        glBindVertexBuffer(bindingindex, buffer, offset, stride);
+    }
+
+    static void APIENTRY enableVertexArrayAttrib(GLuint vaobj, GLuint index)
+    {
+        VertexArrayScope scope(vaobj);
+        glEnableVertexAttribArray(index);
+    }
+
+    static void APIENTRY disableVertexArrayAttrib(GLuint vaobj, GLuint index)
+    {
+        VertexArrayScope scope(vaobj);
+        glDisableVertexAttribArray(index);
+    }
+
+    // desktop-only state
+
+    static void APIENTRY clearDepth(GLdouble depth)
+    {
+        glClearDepthf(static_cast<GLfloat>(depth));
+    }
+
+    static void APIENTRY drawBuffer(GLenum buf)
+    {
+        glDrawBuffers(1, &buf);
+    }
+
+    static void APIENTRY beginQuery(GLenum target, GLuint id)
+    {
+        if (target != GL_TIME_ELAPSED)
+            state().beginQuery(target, id);
+    }
+
+    static void APIENTRY endQuery(GLenum target)
+    {
+        if (target != GL_TIME_ELAPSED)
+            state().endQuery(target);
+    }
+
+    static void APIENTRY queryCounter(GLuint, GLenum) {}
+
+    static void APIENTRY getQueryObjectiv(GLuint, GLenum pname, GLint* params)
+    {
+        *params = pname == GL_QUERY_RESULT_AVAILABLE ? 1 : 0;
+    }
+
+    static void APIENTRY getQueryObjectui64v(GLuint, GLenum, GLuint64* params)
+    {
+        *params = 0;
+    }
+
+    // draws
+
+    // glesBaseInstance and glesDrawId of the current program, where it reads them
+    static void setDrawParameters(GLint baseInstance, GLint drawId)
+    {
+        GLint program = 0;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+        if (program == 0)
+            return;
+        State& s = state();
+        auto found = s.locations.find(static_cast<GLuint>(program));
+        if (found == s.locations.end())
+        {
+            const DrawParameterLocations locations{glGetUniformLocation(program, "glesBaseInstance"), glGetUniformLocation(program, "glesDrawId")};
+            found = s.locations.emplace(static_cast<GLuint>(program), locations).first;
+        }
+        if (found->second.baseInstance >= 0)
+            glUniform1i(found->second.baseInstance, baseInstance);
+        if (found->second.drawId >= 0)
+            glUniform1i(found->second.drawId, drawId);
+    }
+
+    // Without GL_EXT_base_instance the bound vertex array's instanced bindings are moved on by the base instance
+    // for the draw, and without base vertex draws its per-vertex ones by the base vertex. False when nothing
+    // needed moving, true when restore() has to put the bindings back.
+    struct ShiftedBinding
+    {
+        GLuint index;
+        GLint buffer;
+        GLint64 offset;
+        GLint stride;
+    };
+
+    static unsigned int shiftBindings(GLuint baseInstance, GLint baseVertex, ShiftedBinding* shifted)
+    {
+        unsigned int count = 0;
+        if (baseInstance == 0 && baseVertex == 0)
+            return 0;
+        for (GLuint b = 0; b < state().vertexBindings; b++)
+        {
+            GLint divisor = 0;
+            glGetIntegeri_v(GL_VERTEX_BINDING_DIVISOR, b, &divisor);
+            const GLint64 by = divisor > 0 ? static_cast<GLint64>(baseInstance / static_cast<GLuint>(divisor)) : baseVertex;
+            if (by == 0)
+                continue;
+            ShiftedBinding& binding = shifted[count];
+            binding.index = b;
+            glGetIntegeri_v(GL_VERTEX_BINDING_BUFFER, b, &binding.buffer);
+            glGetInteger64i_v(GL_VERTEX_BINDING_OFFSET, b, &binding.offset);
+            glGetIntegeri_v(GL_VERTEX_BINDING_STRIDE, b, &binding.stride);
+            if (binding.buffer == 0)
+                continue;
+            glBindVertexBuffer(b, static_cast<GLuint>(binding.buffer), static_cast<GLintptr>(binding.offset + by * binding.stride), binding.stride);
+            count++;
+        }
+        return count;
+    }
+
+    static void restoreBindings(const ShiftedBinding* shifted, unsigned int count)
+    {
+        for (unsigned int i = 0; i < count; i++)
+            glBindVertexBuffer(shifted[i].index, static_cast<GLuint>(shifted[i].buffer), static_cast<GLintptr>(shifted[i].offset), shifted[i].stride);
+    }
+
+    static void drawArrays(GLenum mode, GLint first, GLsizei count, GLsizei instances, GLuint baseInstance, GLint drawId)
+    {
+        const bool parameters = baseInstance != 0 || drawId != 0;
+        if (parameters)
+            setDrawParameters(static_cast<GLint>(baseInstance), drawId);
+        if (baseInstance != 0 && state().arraysBaseInstance)
+            state().arraysBaseInstance(mode, first, count, instances, baseInstance);
+        else
+        {
+            ShiftedBinding shifted[MAX_VERTEX_BINDINGS];
+            const unsigned int moved = shiftBindings(baseInstance, 0, shifted);
+            glDrawArraysInstanced(mode, first, count, instances);
+            restoreBindings(shifted, moved);
+        }
+        if (parameters)
+            setDrawParameters(0, 0);
+    }
+
+    static void drawElements(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instances, GLint baseVertex,
+                             GLuint baseInstance, GLint drawId)
+    {
+        const bool parameters = baseInstance != 0 || drawId != 0;
+        if (parameters)
+            setDrawParameters(static_cast<GLint>(baseInstance), drawId);
+        if (baseInstance != 0 && state().elementsBaseInstance)
+            state().elementsBaseInstance(mode, count, type, indices, instances, baseVertex, baseInstance);
+        else
+        {
+            ShiftedBinding shifted[MAX_VERTEX_BINDINGS];
+            const bool baseVertexDraws = glDrawElementsInstancedBaseVertex != nullptr;
+            const unsigned int moved = shiftBindings(baseInstance, baseVertexDraws ? 0 : baseVertex, shifted);
+            if (baseVertexDraws)
+                glDrawElementsInstancedBaseVertex(mode, count, type, indices, instances, baseVertex);
+            else
+                glDrawElementsInstanced(mode, count, type, indices, instances);
+            restoreBindings(shifted, moved);
+        }
+        if (parameters)
+            setDrawParameters(0, 0);
+    }
+
+    static void APIENTRY drawArraysInstancedBaseInstance(GLenum mode, GLint first, GLsizei count, GLsizei instancecount, GLuint baseinstance)
+    {
+        drawArrays(mode, first, count, instancecount, baseinstance, 0);
+    }
+
+    static void APIENTRY drawElementsInstancedBaseVertexBaseInstance(GLenum mode, GLsizei count, GLenum type, const void* indices,
+                                                                     GLsizei instancecount, GLint basevertex, GLuint baseinstance)
+    {
+        drawElements(mode, count, type, indices, instancecount, basevertex, baseinstance, 0);
+    }
+
+    static void APIENTRY multiDrawArrays(GLenum mode, const GLint* first, const GLsizei* count, GLsizei drawcount)
+    {
+        for (GLsizei i = 0; i < drawcount; i++)
+            drawArrays(mode, first[i], count[i], 1, 0, i);
+    }
+
+    // drawcount commands stride apart from indirect in the bound indirect buffer, copied out of it
+    static const unsigned char* readCommands(const void* indirect, GLsizei drawcount, GLsizei stride, size_t size)
+    {
+        if (drawcount <= 0)
+            return nullptr;
+        const size_t step = stride > 0 ? static_cast<size_t>(stride) : size;
+        const size_t bytes = (static_cast<size_t>(drawcount) - 1) * step + size;
+        const void* mapped = glMapBufferRange(GL_DRAW_INDIRECT_BUFFER, static_cast<GLintptr>(reinterpret_cast<uintptr_t>(indirect)),
+                                              static_cast<GLsizeiptr>(bytes), GL_MAP_READ_BIT);
+        if (!mapped)
+            return nullptr;
+        std::vector<unsigned char>& commands = state().commands;
+        commands.resize(bytes);
+        std::memcpy(commands.data(), mapped, bytes);
+        glUnmapBuffer(GL_DRAW_INDIRECT_BUFFER);
+        return commands.data();
+    }
+
+    static size_t indexBytes(GLenum type)
+    {
+        return type == GL_UNSIGNED_BYTE ? 1 : type == GL_UNSIGNED_SHORT ? 2 : 4;
+    }
+
+    static void APIENTRY multiDrawArraysIndirect(GLenum mode, const void* indirect, GLsizei drawcount, GLsizei stride)
+    {
+        const unsigned char* commands = readCommands(indirect, drawcount, stride, sizeof(ArraysCommand));
+        const size_t step = stride > 0 ? static_cast<size_t>(stride) : sizeof(ArraysCommand);
+        for (GLsizei i = 0; commands && i < drawcount; i++)
+        {
+            ArraysCommand c;
+            std::memcpy(&c, commands + i * step, sizeof(c));
+            if (c.count > 0 && c.instanceCount > 0)
+                drawArrays(mode, static_cast<GLint>(c.first), static_cast<GLsizei>(c.count), static_cast<GLsizei>(c.instanceCount), c.baseInstance, i);
+        }
+    }
+
+    static void APIENTRY multiDrawElementsIndirect(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride)
+    {
+        const unsigned char* commands = readCommands(indirect, drawcount, stride, sizeof(ElementsCommand));
+        const size_t step = stride > 0 ? static_cast<size_t>(stride) : sizeof(ElementsCommand);
+        for (GLsizei i = 0; commands && i < drawcount; i++)
+        {
+            ElementsCommand c;
+            std::memcpy(&c, commands + i * step, sizeof(c));
+            if (c.count > 0 && c.instanceCount > 0)
+                drawElements(mode, static_cast<GLsizei>(c.count), type, reinterpret_cast<const void*>(c.firstIndex * indexBytes(type)),
+                             static_cast<GLsizei>(c.instanceCount), c.baseVertex, c.baseInstance, i);
+        }
+    }
+
+    // ES reserves the base instance of its own indirect commands, so even single ones are read back
+    static void APIENTRY drawArraysIndirect(GLenum mode, const void* indirect)
+    {
+        multiDrawArraysIndirect(mode, indirect, 1, 0);
+    }
+
+    static void APIENTRY drawElementsIndirect(GLenum mode, GLenum type, const void* indirect)
+    {
+        multiDrawElementsIndirect(mode, type, indirect, 1, 0);
+    }
+};
+
+#endif
@@ -0,0 +1,691 @@
+#ifndef GLTF_H
+#define GLTF_H
+
+#include <glm.hpp>
+#include <gtc/matrix_transform.hpp>
+#include <gtc/type_ptr.hpp>
+#include <gtc/quaternion.hpp>
+
+#include <model_cache.h>
+#include <asset_archive.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <cstddef>
+#include <cctype>
+
+// A native reader of glTF 2.0 for the import (importModel), which otherwise goes through Assimp's text parsers.
+// A .glb is memory-mapped and its accessors are read in place out of the binary chunk, a .gltf's buffers are
+// mapped from the .bin files next to it; each attribute is copied into the mesh's Vertex array in one strided pass
+// of its own, with no per-vertex conversion in between. Static, triangulated meshes only: a file with skins or
+// animations, embedded (data: URI or buffer view) images or primitives other than triangles is left to Assimp,
+// which reads glTF too, by returning false. Nothing here touches GL.
+namespace gltf {
+
+// a JSON value, just what a glTF document needs: objects keep their members in file order
+struct Value
+{
+    enum Type { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT } type = NUL;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<Value> items;
+    std::vector<std::pair<std::string, Value>> members;
+
+    // the member of that name, or a null value
+    const Value& operator[](const char* name) const
+    {
+        for (const auto& member : members)
+            if (member.first == name)
+                return member.second;
+        return null();
+    }
+    const Value& operator[](size_t i) const { return i < items.size() ? items[i] : null(); }
+    const Value& operator[](int i) const { return i >= 0 ? (*this)[static_cast<size_t>(i)] : null(); }
+
+    bool has(const char* name) const { return (*this)[name].type != NUL; }
+    size_t size() const { return items.size(); }
+    double numberOr(double fallback) const { return type == NUMBER ? number : fallback; }
+    int64_t intOr(int64_t fallback) const { return type == NUMBER ? static_cast<int64_t>(number) : fallback; }
+
+    static const Value& null()
+    {
+        static const Value none;
+        return none;
+    }
+};
+
+// recursive descent over the JSON chunk, false on anything malformed
+class Parser
+{
+public:
+    Parser(const char* begin, const char* end) : at(begin), end(end) {}
+
+    bool parse(Value& value)
+    {
+        if (!parseValue(value, 0))
+            return false;
+        skipSpace();
+        return at == end || *at == '\0';
+    }
+
+private:
+    static const int MAX_DEPTH = 64;
+    const char* at;
+    const char* end;
+
+    void skipSpace()
+    {
+        while (at < end && (*at == ' ' || *at == '\t' || *at == '\n' || *at == '\r'))
+            at++;
+    }
+
+    bool literal(const char* word)
+    {
+        const size_t length = std::strlen(word);
+        if (static_cast<size_t>(end - at) < length || std::strncmp(at, word, length) != 0)
+            return false;
+        at += length;
+        return true;
+    }
+
+    bool parseString(std::string& out)
+    {
+        if (at >= end || *at != '"')
+            return false;
+        at++;
+        out.clear();
+        while (at < end && *at != '"')
+        {
+            char c = *at++;
+            if (c != '\\')
+            {
+                out.push_back(c);
+                continue;
+            }
+            if (at >= end)
+                return false;
+            c = *at++;
+            switch (c)
+            {
+            case 'n': out.push_back('\n'); break;
+            case 't': out.push_back('\t'); break;
+            case 'r': out.push_back('\r'); break;
+            case 'b': out.push_back('\b'); break;
+            case 'f': out.push_back('\f'); break;
+            case 'u':
+            {
+                if (end - at < 4)
+                    return false;
+                const unsigned long code = std::strtoul(std::string(at, 4).c_str(), nullptr, 16);
+                at += 4;
+                // UTF-8 of the basic plane, names and URIs rarely need more
+                if (code < 0x80)
+                    out.push_back(static_cast<char>(code));
+                else if (code < 0x800)
+                {
+                    out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+                    out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+                }
+                else
+                {
+                    out.push_back(static_cast<char>(0xE0 | (code >> 12)));
+                    out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+                    out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+                }
+                break;
+            }
+            default: out.push_back(c); break;
+            }
+        }
+        if (at >= end)
+            return false;
+        at++;
+        return true;
+    }
+
+    bool parseValue(Value& value, int depth)
+    {
+        if (depth > MAX_DEPTH)
+            return false;
+        skipSpace();
+        if (at >= end)
+            return false;
+        if (*at == '{')
+        {
+            value.type = Value::OBJECT;
+            at++;
+            skipSpace();
+            if (at < end && *at == '}')
+            {
+                at++;
+                return true;
+            }
+            for (;;)
+            {
+                skipSpace();
+                std::pair<std::string, Value> member;
+                if (!parseString(member.first))
+                    return false;
+                skipSpace();
+                if (at >= end || *at++ != ':')
+                    return false;
+                if (!parseValue(member.second, depth + 1))
+                    return false;
+                value.members.push_back(std::move(member));
+                skipSpace();
+                if (at < end && *at == ',')
+                {
+                    at++;
+                    continue;
+                }
+                if (at < end && *at == '}')
+                {
+                    at++;
+                    return true;
+                }
+                return false;
+            }
+        }
+        if (*at == '[')
+        {
+            value.type = Value::ARRAY;
+            at++;
+            skipSpace();
+            if (at < end && *at == ']')
+            {
+                at++;
+                return true;
+            }
+            for (;;)
+            {
+                value.items.emplace_back();
+                if (!parseValue(value.items.back(), depth + 1))
+                    return false;
+                skipSpace();
+                if (at < end && *at == ',')
+                {
+                    at++;
+                    continue;
+                }
+                if (at < end && *at == ']')
+                {
+                    at++;
+                    return true;
+                }
+                return false;
+            }
+        }
+        if (*at == '"')
+        {
+            value.type = Value::STRING;
+            return parseString(value.string);
+        }
+        if (literal("true"))
+        {
+            value.type = Value::BOOLEAN;
+            value.boolean = true;
+            return true;
+        }
+        if (literal("false"))
+        {
+            value.type = Value::BOOLEAN;
+            return true;
+        }
+        if (literal("null"))
+            return true;
+        // strtod stops at the number's end, the chunk is not terminated so it is copied out first
+        const char* start = at;
+        while (at < end && (std::strchr("+-.eE", *at) || (*at >= '0' && *at <= '9')))
+            at++;
+        if (at == start)
+            return false;
+        value.type = Value::NUMBER;
+        value.number = std::strtod(std::string(start, at).c_str(), nullptr);
+        return true;
+    }
+};
+
+static const uint32_t GLB_MAGIC = 0x46546C67;           // "glTF"
+static const uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+static const uint32_t GLB_CHUNK_BIN = 0x004E4942;
+
+enum ComponentType {
+    COMPONENT_BYTE = 5120,
+    COMPONENT_UNSIGNED_BYTE = 5121,
+    COMPONENT_SHORT = 5122,
+    COMPONENT_UNSIGNED_SHORT = 5123,
+    COMPONENT_UNSIGNED_INT = 5125,
+    COMPONENT_FLOAT = 5126
+};
+
+inline size_t componentSize(int64_t type)
+{
+    switch (type)
+    {
+    case COMPONENT_BYTE: case COMPONENT_UNSIGNED_BYTE: return 1;
+    case COMPONENT_SHORT: case COMPONENT_UNSIGNED_SHORT: return 2;
+    case COMPONENT_UNSIGNED_INT: case COMPONENT_FLOAT: return 4;
+    default: return 0;
+    }
+}
+
+inline unsigned int componentCount(const std::string& type)
+{
+    if (type == "SCALAR") return 1;
+    if (type == "VEC2") return 2;
+    if (type == "VEC3") return 3;
+    if (type == "VEC4" || type == "MAT2") return 4;
+    if (type == "MAT3") return 9;
+    if (type == "MAT4") return 16;
+    return 0;
+}
+
+// an accessor resolved to bytes in a mapped buffer: element i starts at data + i * stride
+struct View
+{
+    const unsigned char* data = nullptr;
+    size_t count = 0;
+    size_t stride = 0;
+    unsigned int components = 0;
+    int64_t componentType = 0;
+    bool normalized = false;
+
+    bool valid() const { return data != nullptr; }
+
+    // component c of element i as a float, normalized integers to [0, 1] or [-1, 1] as the spec has them
+    float component(size_t i, unsigned int c) const
+    {
+        const unsigned char* p = data + i * stride + c * componentSize(componentType);
+        switch (componentType)
+        {
+        case COMPONENT_FLOAT: { float f; std::memcpy(&f, p, 4); return f; }
+        case COMPONENT_UNSIGNED_BYTE: return normalized ? *p / 255.0f : static_cast<float>(*p);
+        case COMPONENT_BYTE: { const int8_t v = static_cast<int8_t>(*p); return normalized ? std::max(v / 127.0f, -1.0f) : v; }
+        case COMPONENT_UNSIGNED_SHORT: { uint16_t v; std::memcpy(&v, p, 2); return normalized ? v / 65535.0f : v; }
+        case COMPONENT_SHORT: { int16_t v; std::memcpy(&v, p, 2); return normalized ? std::max(v / 32767.0f, -1.0f) : v; }
+        case COMPONENT_UNSIGNED_INT: { uint32_t v; std::memcpy(&v, p, 4); return static_cast<float>(v); }
+        default: return 0.0f;
+        }
+    }
+
+    uint32_t index(size_t i) const
+    {
+        const unsigned char* p = data + i * stride;
+        switch (componentType)
+        {
+        case COMPONENT_UNSIGNED_BYTE: return *p;
+        case COMPONENT_UNSIGNED_SHORT: { uint16_t v; std::memcpy(&v, p, 2); return v; }
+        case COMPONENT_UNSIGNED_INT: { uint32_t v; std::memcpy(&v, p, 4); return v; }
+        default: return 0;
+        }
+    }
+};
+
+// A parsed document and the mapped buffers its accessors point into, kept open while the meshes are read
+class Document
+{
+public:
+    Value json;
+    std::string directory;
+
+    bool open(const std::string& path)
+    {
+        directory = path.substr(0, path.find_last_of('/'));
+        files.emplace_back(new AssetFile());
+        AssetFile& file = *files.back();
+        if (!file.open(path.c_str(), true))
+            return false;
+        const unsigned char* bytes = file.data();
+        uint32_t magic = 0;
+        if (file.size() >= 4)
+            std::memcpy(&magic, bytes, 4);
+        if (magic != GLB_MAGIC)
+            return Parser(reinterpret_cast<const char*>(bytes), reinterpret_cast<const char*>(bytes) + file.size()).parse(json)
+                && mapBuffers(nullptr, 0);
+
+        // header (magic, version, length), then chunks of (length, type, data) padded to four bytes
+        uint32_t header[3];
+        if (file.size() < sizeof(header))
+            return false;
+        std::memcpy(header, bytes, sizeof(header));
+        if (header[1] != 2 || header[2] > file.size())
+            return false;
+        const unsigned char* binary = nullptr;
+        size_t binaryLength = 0;
+        bool parsed = false;
+        for (size_t offset = sizeof(header); offset + 8 <= header[2];)
+        {
+            uint32_t chunk[2];
+            std::memcpy(chunk, bytes + offset, sizeof(chunk));
+            const size_t begin = offset + 8;
+            if (begin + chunk[0] > header[2])
+                return false;
+            if (chunk[1] == GLB_CHUNK_JSON && !parsed)
+            {
+                const char* text = reinterpret_cast<const char*>(bytes + begin);
+                parsed = Parser(text, text + chunk[0]).parse(json);
+                if (!parsed)
+                    return false;
+            }
+            else if (chunk[1] == GLB_CHUNK_BIN && !binary)
+            {
+                binary = bytes + begin;
+                binaryLength = chunk[0];
+            }
+            offset = begin + ((chunk[0] + 3u) & ~3u);
+        }
+        return parsed && mapBuffers(binary, binaryLength);
+    }
+
+    // accessor a resolved, invalid when it is sparse, out of its buffer or of an unknown type
+    View view(int64_t a) const
+    {
+        View view;
+        const Value& accessor = json["accessors"][static_cast<size_t>(a)];
+        if (accessor.type != Value::OBJECT || accessor.has("sparse") || !accessor.has("bufferView"))
+            return view;
+        const Value& bufferView = json["bufferViews"][static_cast<size_t>(accessor["bufferView"].intOr(-1))];
+        const size_t b = static_cast<size_t>(bufferView["buffer"].intOr(-1));
+        if (bufferView.type != Value::OBJECT || b >= buffers.size() || !buffers[b].first)
+            return view;
+        view.componentType = accessor["componentType"].intOr(0);
+        view.components = componentCount(accessor["type"].string);
+        view.count = static_cast<size_t>(accessor["count"].intOr(0));
+        view.normalized = accessor["normalized"].boolean;
+        const size_t elementSize = componentSize(view.componentType) * view.components;
+        view.stride = static_cast<size_t>(bufferView["byteStride"].intOr(0));
+        if (view.stride == 0)
+            view.stride = elementSize;
+        const size_t viewOffset = static_cast<size_t>(bufferView["byteOffset"].intOr(0));
+        const size_t viewLength = static_cast<size_t>(bufferView["byteLength"].intOr(0));
+        const size_t offset = static_cast<size_t>(accessor["byteOffset"].intOr(0));
+        const size_t span = view.count == 0 ? 0 : (view.count - 1) * view.stride + elementSize;
+        if (elementSize == 0 || viewOffset + viewLength > buffers[b].second || offset + span > viewLength)
+            return view;
+        view.data = buffers[b].first + viewOffset + offset;
+        return view;
+    }
+
+private:
+    std::vector<std::unique_ptr<AssetFile>> files;
+    std::vector<std::pair<const unsigned char*, size_t>> buffers;
+
+    // buffer 0 of a .glb without a uri is its binary chunk, the others are files next to the document
+    bool mapBuffers(const unsigned char* binary, size_t binaryLength)
+    {
+        const Value& list = json["buffers"];
+        buffers.assign(list.size(), std::make_pair(nullptr, 0));
+        for (size_t b = 0; b < list.size(); b++)
+        {
+            const Value& uri = list[b]["uri"];
+            if (uri.type != Value::STRING)
+            {
+                if (b == 0)
+                    buffers[b] = std::make_pair(binary, binaryLength);
+                continue;
+            }
+            if (uri.string.compare(0, 5, "data:") == 0)
+                return false;
+            files.emplace_back(new AssetFile());
+            if (!files.back()->open((directory + "/" + decodeUri(uri.string)).c_str(), true))
+                return false;
+            buffers[b] = std::make_pair(files.back()->data(), files.back()->size());
+        }
+        return true;
+    }
+
+public:
+    // %XX escapes of a relative URI as the file name they stand for
+    static std::string decodeUri(const std::string& uri)
+    {
+        std::string path;
+        for (size_t i = 0; i < uri.size(); i++)
+        {
+            if (uri[i] == '%' && i + 2 < uri.size())
+            {
+                path.push_back(static_cast<char>(std::strtoul(uri.substr(i + 1, 2).c_str(), nullptr, 16)));
+                i += 2;
+            }
+            else
+                path.push_back(uri[i]);
+        }
+        return path;
+    }
+};
+
+// the file name of a material texture (a textureInfo object), empty when it has none or it is embedded
+inline std::string texturePath(const Document& document, const Value& info)
+{
+    if (!info.has("index"))
+        return std::string();
+    const Value& texture = document.json["textures"][static_cast<size_t>(info["index"].intOr(-1))];
+    const Value& image = document.json["images"][static_cast<size_t>(texture["source"].intOr(-1))];
+    if (image["uri"].type != Value::STRING || image["uri"].string.compare(0, 5, "data:") == 0)
+        return std::string();
+    return Document::decodeUri(image["uri"].string);
+}
+
+// the smooth normals and tangents Assimp would have generated (aiProcess_GenSmoothNormals, CalcTangentSpace) for
+// what the file leaves out, area-weighted over each vertex's triangles
+inline void generateTangentSpace(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, bool normals, bool tangents)
+{
+    std::vector<glm::vec3> normalSums(normals ? vertices.size() : 0, glm::vec3(0.0f));
+    std::vector<glm::vec3> tangentSums(tangents ? vertices.size() : 0, glm::vec3(0.0f));
+    std::vector<glm::vec3> bitangentSums(tangents ? vertices.size() : 0, glm::vec3(0.0f));
+    for (size_t t = 0; t + 2 < indices.size(); t += 3)
+    {
+        const Vertex& a = vertices[indices[t]];
+        const Vertex& b = vertices[indices[t + 1]];
+        const Vertex& c = vertices[indices[t + 2]];
+        const glm::vec3 e1 = b.Position - a.Position, e2 = c.Position - a.Position;
+        const glm::vec3 areaNormal = glm::cross(e1, e2);
+        const glm::vec2 d1 = b.TexCoords - a.TexCoords, d2 = c.TexCoords - a.TexCoords;
+        const float det = d1.x * d2.y - d2.x * d1.y;
+        const float r = det != 0.0f ? 1.0f / det : 0.0f;
+        const glm::vec3 tangent = (e1 * d2.y - e2 * d1.y) * r;
+        const glm::vec3 bitangent = (e2 * d1.x - e1 * d2.x) * r;
+        for (unsigned int k = 0; k < 3; k++)
+        {
+            const unsigned int v = indices[t + k];
+            if (normals)
+                normalSums[v] += areaNormal;
+            if (tangents)
+            {
+                tangentSums[v] += tangent;
+                bitangentSums[v] += bitangent;
+            }
+        }
+    }
+    for (size_t v = 0; v < vertices.size(); v++)
+    {
+        if (normals && glm::length(normalSums[v]) > 0.0f)
+            vertices[v].Normal = glm::normalize(normalSums[v]);
+        if (tangents)
+        {
+            // orthogonal to the normal, as CalcTangentSpace leaves them
+            const glm::vec3& n = vertices[v].Normal;
+            const glm::vec3 tangent = tangentSums[v] - n * glm::dot(n, tangentSums[v]);
+            const glm::vec3 bitangent = bitangentSums[v] - n * glm::dot(n, bitangentSums[v]);
+            vertices[v].Tangent = glm::length(tangent) > 0.0f ? glm::normalize(tangent) : glm::vec3(0.0f);
+            vertices[v].Bitangent = glm::length(bitangent) > 0.0f ? glm::normalize(bitangent) : glm::vec3(0.0f);
+        }
+    }
+}
+
+// one triangle primitive as an ImportedMesh, false when it cannot be read here
+inline bool readPrimitive(const Document& document, const Value& primitive, ImportedMesh& mesh)
+{
+    if (primitive["mode"].intOr(4) != 4)
+        return false;
+    const Value& attributes = primitive["attributes"];
+    const View positions = document.view(attributes["POSITION"].intOr(-1));
+    if (!positions.valid() || positions.components != 3)
+        return false;
+    const size_t count = positions.count;
+    Vertex blank{};
+    for (int b = 0; b < MAX_BONE_INFLUENCE; b++)
+        blank.m_BoneIDs[b] = -1;
+    mesh.vertices.assign(count, blank);
+
+    // one strided pass per attribute, floats copied as they are
+    auto copy = [&](const View& view, size_t fieldOffset, unsigned int components) {
+        if (!view.valid() || view.count != count || view.components < components)
+            return false;
+        unsigned char* out = reinterpret_cast<unsigned char*>(mesh.vertices.data()) + fieldOffset;
+        if (view.componentType == COMPONENT_FLOAT)
+            for (size_t v = 0; v < count; v++)
+                std::memcpy(out + v * sizeof(Vertex), view.data + v * view.stride, components * sizeof(float));
+        else
+            for (size_t v = 0; v < count; v++)
+                for (unsigned int c = 0; c < components; c++)
+                {
+                    const float f = view.component(v, c);
+                    std::memcpy(out + v * sizeof(Vertex) + c * sizeof(float), &f, sizeof(float));
+                }
+        return true;
+    };
+    copy(positions, offsetof(Vertex, Position), 3);
+    const bool hasNormals = copy(document.view(attributes["NORMAL"].intOr(-1)), offsetof(Vertex, Normal), 3);
+    const bool hasTexCoords = copy(document.view(attributes["TEXCOORD_0"].intOr(-1)), offsetof(Vertex, TexCoords), 2);
+    const View tangents = document.view(attributes["TANGENT"].intOr(-1));
+    const bool hasTangents = hasNormals && copy(tangents, offsetof(Vertex, Tangent), 3);
+    if (hasTangents)
+        // the bitangent from the handedness in w
+        for (size_t v = 0; v < count; v++)
+        {
+            Vertex& vertex = mesh.vertices[v];
+            vertex.Bitangent = glm::cross(vertex.Normal, vertex.Tangent) * (tangents.components > 3 ? tangents.component(v, 3) : 1.0f);
+        }
+
+    if (primitive.has("indices"))
+    {
+        const View indices = document.view(primitive["indices"].intOr(-1));
+        if (!indices.valid() || indices.components != 1)
+            return false;
+        mesh.indices.resize(indices.count);
+        if (indices.componentType == COMPONENT_UNSIGNED_INT && indices.stride == sizeof(uint32_t))
+            std::memcpy(mesh.indices.data(), indices.data, indices.count * sizeof(uint32_t));
+        else
+            for (size_t i = 0; i < indices.count; i++)
+                mesh.indices[i] = indices.index(i);
+        for (unsigned int i : mesh.indices)
+            if (i >= count)
+                return false;
+    }
+    else
+    {
+        mesh.indices.resize(count);
+        for (size_t i = 0; i < count; i++)
+            mesh.indices[i] = static_cast<unsigned int>(i);
+    }
+    mesh.indices.resize(mesh.indices.size() / 3 * 3);
+    if (!hasNormals || (hasTexCoords && !hasTangents))
+        generateTangentSpace(mesh.vertices, mesh.indices, !hasNormals, hasTexCoords && !hasTangents);
+
+    // the sampler names of processMesh: base colour as diffuse, the normal map as normal
+    const Value& material = document.json["materials"][static_cast<size_t>(primitive["material"].intOr(-1))];
+    const std::string diffuse = texturePath(document, material["pbrMetallicRoughness"]["baseColorTexture"]);
+    if (!diffuse.empty())
+        mesh.textures.push_back(Texture{0, "texture_diffuse", diffuse});
+    const std::string normal = texturePath(document, material["normalTexture"]);
+    if (!normal.empty())
+        mesh.textures.push_back(Texture{0, "texture_normal", normal});
+    return true;
+}
+
+// a node's transform relative to its parent, from its matrix or its translation, rotation and scale
+inline glm::mat4 nodeTransform(const Value& node)
+{
+    const Value& matrix = node["matrix"];
+    if (matrix.size() == 16)
+    {
+        float m[16];
+        for (size_t i = 0; i < 16; i++)
+            m[i] = static_cast<float>(matrix[i].numberOr(0.0));
+        return glm::make_mat4(m);    // column-major in the file, as glm has it
+    }
+    const Value& t = node["translation"];
+    const Value& r = node["rotation"];
+    const Value& s = node["scale"];
+    glm::mat4 transform(1.0f);
+    if (t.size() == 3)
+        transform = glm::translate(transform, glm::vec3(t[0].numberOr(0.0), t[1].numberOr(0.0), t[2].numberOr(0.0)));
+    if (r.size() == 4)
+        transform *= glm::mat4_cast(glm::quat(static_cast<float>(r[3].numberOr(1.0)), static_cast<float>(r[0].numberOr(0.0)),
+                                              static_cast<float>(r[1].numberOr(0.0)), static_cast<float>(r[2].numberOr(0.0))));
+    if (s.size() == 3)
+        transform = glm::scale(transform, glm::vec3(s[0].numberOr(1.0), s[1].numberOr(1.0), s[2].numberOr(1.0)));
+    return transform;
+}
+
+inline bool readNode(const Document& document, size_t n, int32_t parent, std::vector<ImportedMesh>& meshes, std::vector<ImportedNode>& nodes, int depth)
+{
+    const Value& node = document.json["nodes"][n];
+    if (node.type != Value::OBJECT || depth > 64)
+        return false;
+    const int32_t self = static_cast<int32_t>(nodes.size());
+    nodes.push_back(ImportedNode{parent, static_cast<uint32_t>(meshes.size()), 0, nodeTransform(node)});
+    if (node.has("mesh"))
+    {
+        const Value& primitives = document.json["meshes"][static_cast<size_t>(node["mesh"].intOr(-1))]["primitives"];
+        for (size_t p = 0; p < primitives.size(); p++)
+        {
+            meshes.emplace_back();
+            if (!readPrimitive(document, primitives[p], meshes.back()))
+                return false;
+        }
+        nodes[self].meshCount = static_cast<uint32_t>(primitives.size());
+    }
+    const Value& children = node["children"];
+    for (size_t c = 0; c < children.size(); c++)
+        if (!readNode(document, static_cast<size_t>(children[c].intOr(-1)), self, meshes, nodes, depth + 1))
+            return false;
+    return true;
+}
+
+// whether path names a glTF file by its extension
+inline bool isGltfPath(const std::string& path)
+{
+    const size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos)
+        return false;
+    std::string extension = path.substr(dot + 1);
+    for (char& c : extension)
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return extension == "glb" || extension == "gltf";
+}
+
+// the default scene's meshes and nodes, under one untransformed root when the scene has several. False, with
+// meshes and nodes left empty, for anything the import should hand to Assimp instead.
+inline bool importGltf(const std::string& path, std::vector<ImportedMesh>& meshes, std::vector<ImportedNode>& nodes)
+{
+    Document document;
+    if (!document.open(path))
+        return false;
+    const Value& json = document.json;
+    if (json["asset"]["version"].string.compare(0, 1, "2") != 0 || json.has("skins") || json.has("animations"))
+        return false;
+    const Value& scene = json["scenes"][static_cast<size_t>(json["scene"].intOr(0))];
+    const Value& roots = scene["nodes"];
+    nodes.push_back(ImportedNode{-1, 0, 0, glm::mat4(1.0f)});
+    bool read = true;
+    for (size_t r = 0; r < roots.size() && read; r++)
+        read = readNode(document, static_cast<size_t>(roots[r].intOr(-1)), 0, meshes, nodes, 0);
+    if (!read || meshes.empty())
+    {
+        meshes.clear();
+        nodes.clear();
+        return false;
+    }
+    return true;
+}
+
+} // namespace gltf
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef GPU_BARNES_HUT_H
+#define GPU_BARNES_HUT_H
+
+#include <glad/glad.h>
+
+#include <shader.h>
+#include <gpu_nbody.h>
+#include <gpu_memory.h>
+#include <gpu_radix_sort.h>
+#include <gl_state_cache.h>
+#include <gl_debug.h>
+
+#include <algorithm>
+#include <cstdint>
+
+// Barnes-Hut gravity for the GPU n-body backend, kicking GpuNBody's velocities in place, its tree rebuilt every
+// step on the GPU with nothing read back. The asteroids get 30-bit Morton codes over their bounding cube and are
+// radix sorted by them (gpu_radix_sort.h); over the sorted codes every internal node of a binary radix tree finds
+// its range and split on its own (Karras, "Maximizing parallelism in the construction of BVHs, octrees and k-d
+// trees"), and the leaves climb to the root merging mass, centre of mass and bounds, the second child to arrive at
+// a node doing its parent (shaders.2/nbody.tree.cs). The kick (shaders.2/nbody.barnes_hut.cs) walks the tree per
+// body with a stack, taking a node whole where its bounds' largest side is under theta times the distance to its
+// centre of mass.
+//
+// The tree holds the asteroids only. The sun and planets are few and far heavier: every body sums them directly,
+// which keeps their pull exact, and they feel the asteroids through the tree. Asteroids skip the tree without
+// self-gravity, the same pairs as GpuNBody::step.
+class GpuBarnesHut
+{
+public:
+    static const unsigned int BINDING_BOUNDS = 52;
+    static const unsigned int BINDING_KEYS = 53;
+    static const unsigned int BINDING_ORDER = 54;
+    static const unsigned int BINDING_NODES = 55;
+
+    GpuBarnesHut(const char* treePath, const char* kickPath, GpuRadixSort& sorter)
+        : treeShader(treePath), kickShader(kickPath), radix(sorter) {}
+    GpuBarnesHut(const GpuBarnesHut&) = delete;
+    GpuBarnesHut& operator=(const GpuBarnesHut&) = delete;
+
+    ~GpuBarnesHut()
+    {
+        release();
+    }
+
+    // nodes of the last tree built, leaves included
+    unsigned int nodeCount() const { return lastLeaves > 1 ? 2 * lastLeaves - 1 : lastLeaves; }
+    size_t gpuBytes() const { return bounds.bytes() + keys.bytes() + order.bytes() + nodes.bytes(); }
+
+    // velocity += G a dt for every body of nbody, a the tree's approximation at opening angle theta
+    void kick(GpuNBody& nbody, float dt, float G, float epsilonSq, float theta, bool asteroidSelfGravity)
+    {
+        if (nbody.bodyCount == 0)
+            return;
+        GL_DEBUG_GROUP("barnes-hut");
+        const unsigned int first = nbody.massiveCount, count = nbody.bodyCount - first;
+        lastLeaves = count;
+        nbody.bind();
+        if (count >= 2)
+            build(first, count);
+
+        kickShader.use();
+        kickShader.setUInt("bodyCount", nbody.bodyCount);
+        kickShader.setUInt("massiveCount", nbody.massiveCount);
+        kickShader.setUInt("leafCount", count);
+        kickShader.setBool("asteroidSelfGravity", asteroidSelfGravity);
+        kickShader.setFloat("thetaSq", theta * theta);
+        kickShader.setFloat("G", G);
+        kickShader.setFloat("dt", dt);
+        kickShader.setFloat("epsilonSq", epsilonSq);
+        glDispatchCompute((nbody.bodyCount + 255) / 256, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    void release()
+    {
+        bounds.release();
+        keys.release();
+        order.release();
+        nodes.release();
+        capacity = 0;
+        lastLeaves = 0;
+    }
+
+private:
+    // TreeNode of nbody.tree.cs: mass and centre, the bounds, children and parent
+    static const size_t NODE_BYTES = 64;
+
+    Shader treeShader;
+    Shader kickShader;
+    GpuRadixSort& radix;
+    GlBuffer bounds{GPU_MEMORY_SIMULATION};
+    GlBuffer keys{GPU_MEMORY_SIMULATION};
+    GlBuffer order{GPU_MEMORY_SIMULATION};
+    GlBuffer nodes{GPU_MEMORY_SIMULATION};
+    unsigned int capacity = 0;      // leaves the buffers hold
+    unsigned int lastLeaves = 0;
+
+    // bounds, keys, the sort, the internal nodes and then the bottom-up pass, a dispatch each
+    void build(unsigned int first, unsigned int count)
+    {
+        reserve(count);
+        const GLuint initial[6] = {0xffffffffu, 0xffffffffu, 0xffffffffu, 0u, 0u, 0u};
+        glNamedBufferSubData(bounds.id(), 0, sizeof(initial), initial);
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        bindBuffers();
+        treeShader.use();
+        treeShader.setUInt("first", first);
+        treeShader.setUInt("count", count);
+        const GLuint groups = (count + 255) / 256;
+        for (int stage = 0; stage < 2; stage++)
+        {
+            treeShader.setInt("stage", stage);
+            glDispatchCompute(groups, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+        radix.sort(keys.id(), order.id(), count, 30);
+        treeShader.use();
+        for (int stage = 2; stage < 4; stage++)
+        {
+            treeShader.setInt("stage", stage);
+            glDispatchCompute(groups, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+    }
+
+    void bindBuffers()
+    {
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_BOUNDS, bounds.id());
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_KEYS, keys.id());
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_ORDER, order.id());
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_NODES, nodes.id());
+    }
+
+    void reserve(unsigned int count)
+    {
+        if (!bounds.valid())
+        {
+            bounds.create(GL_SHADER_STORAGE_BUFFER, "barnes-hut bounds");
+            bounds.storage(6 * sizeof(GLuint), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        }
+        if (count > capacity)
+        {
+            capacity = std::max(count, 2 * capacity);
+            keys.release();
+            order.release();
+            nodes.release();
+            keys.create(GL_SHADER_STORAGE_BUFFER, "barnes-hut keys");
+            keys.storage(static_cast<size_t>(capacity) * sizeof(uint32_t), nullptr, 0);
+            order.create(GL_SHADER_STORAGE_BUFFER, "barnes-hut order");
+            order.storage(static_cast<size_t>(capacity) * sizeof(uint32_t), nullptr, 0);
+            nodes.create(GL_SHADER_STORAGE_BUFFER, "barnes-hut nodes");
+            nodes.storage((2 * static_cast<size_t>(capacity) - 1) * NODE_BYTES, nullptr, 0);
+        }
+        glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+};
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef GPU_BELT_H
+#define GPU_BELT_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <shader.h>
+#include <gpu_nbody.h>
+
+// A purely visual asteroid belt that lives entirely on the GPU. A spawn compute pass fills the rocks from a hash
+// of their index, an orbit pass moves them every frame along circular orbits around the sun, and the instanced
+// draw reads the results from SSBOs. Nothing is uploaded per rock and the CPU physics never sees the belt, so
+// its CPU cost does not depend on the rock count. The output buffers share GpuNBody's bindings and layout, so
+// the GPU N-body instanced vertex shader draws it with instanceOffset 0 and tumble off, the orbit pass spins them.
+class GpuBelt
+{
+public:
+    enum Binding {
+        BINDING_ROCKS = 5      // per-rock orbit and spin state, see shaders.2/belt.spawn.cs
+    };
+
+    struct Params
+    {
+        unsigned int count = 1000000;
+        unsigned int seed = 1;
+        float innerRadius = 100.0f;
+        float outerRadius = 180.0f;
+        float height = 10.0f;
+        float minScale = 0.05f;
+        float maxScale = 0.25f;
+    };
+
+    GpuBelt(const char* spawnPath, const char* orbitPath) : spawnShader(spawnPath), orbitShader(orbitPath) {}
+
+    ~GpuBelt()
+    {
+        release();
+    }
+
+    unsigned int rockCount() const { return count; }
+    // vec4 position per rock, w 0
+    unsigned int positionBuffer() const { return buffers[SLOT_POSITION]; }
+
+    // (re)creates the buffers and spawns every rock on the GPU, the buffers are allocated without data
+    void spawn(const Params& params)
+    {
+        GL_DEBUG_GROUP("belt spawn");
+        if (params.count != count)
+        {
+            release();
+            count = params.count;
+            if (count == 0)
+                return;
+            glCreateBuffers(4, buffers);
+            createBuffer(SLOT_POSITION, count * sizeof(glm::vec4), "belt positions");
+            createBuffer(SLOT_ORIENTATION, count * sizeof(glm::vec4), "belt orientations");
+            createBuffer(SLOT_SCALE, count * sizeof(float), "belt scales");
+            createBuffer(SLOT_ROCKS, count * 2 * sizeof(glm::vec4), "belt orbits");
+        }
+        if (count == 0)
+            return;
+        bind();
+        spawnShader.use();
+        spawnShader.setUInt("rockCount", count);
+        spawnShader.setUInt("seed", params.seed * 2654435761u);
+        spawnShader.setFloat("innerRadius", params.innerRadius);
+        spawnShader.setFloat("outerRadius", params.outerRadius);
+        spawnShader.setFloat("height", params.height);
+        spawnShader.setFloat("minScale", params.minScale);
+        spawnShader.setFloat("maxScale", params.maxScale);
+        glDispatchCompute((count + 255) / 256, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        // positions and orientations for the first draw
+        advance(0.0f, 0.0f, glm::vec3(0.0f));
+    }
+
+    // moves every rock dt of sim time along its orbit around center, mu is G times the sun's mass
+    void advance(float dt, float mu, const glm::vec3& center)
+    {
+        GL_DEBUG_GROUP("belt orbit");
+        if (count == 0)
+            return;
+        bind();
+        orbitShader.use();
+        orbitShader.setUInt("rockCount", count);
+        orbitShader.setFloat("dt", dt);
+        orbitShader.setFloat("mu", mu);
+        orbitShader.setVec3("center", center);
+        glDispatchCompute((count + 255) / 256, 1, 1);
+        // read by the next orbit pass and by the instanced vertex shader
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    }
+
+    // binds the output where the instanced shader expects GpuNBody's buffers, call before drawing
+    void bind() const
+    {
+        if (buffers[SLOT_POSITION] == 0)
+            return;
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, GpuNBody::BINDING_POSITION_MASS, buffers[SLOT_POSITION]);
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, GpuNBody::BINDING_ORIENTATION, buffers[SLOT_ORIENTATION]);
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, GpuNBody::BINDING_SCALE, buffers[SLOT_SCALE]);
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_ROCKS, buffers[SLOT_ROCKS]);
+    }
+
+    void release()
+    {
+        if (buffers[0] != 0)
+            glState().deleteBuffers(4, buffers);
+        for (unsigned int b = 0; b < 4; b++)
+            buffers[b] = 0;
+        memory.reset();
+        count = 0;
+    }
+
+private:
+    enum Slot { SLOT_POSITION = 0, SLOT_ORIENTATION = 1, SLOT_SCALE = 2, SLOT_ROCKS = 3 };
+
+    Shader spawnShader;
+    Shader orbitShader;
+    unsigned int buffers[4] = {0, 0, 0, 0};
+    GpuAllocation memory{GPU_MEMORY_SIMULATION};   // all of buffers
+    unsigned int count = 0;
+
+    void createBuffer(unsigned int slot, size_t size, const char* label)
+    {
+        // written by the spawn and orbit shaders alone
+        labelObject(GL_BUFFER, buffers[slot], label);
+        glNamedBufferStorage(buffers[slot], static_cast<GLsizeiptr>(size), nullptr, 0);
+        memory.set(memory.bytes() + size);
+    }
+};
+
+#endif
@@ -0,0 +1,313 @@
+#ifndef GPU_CULL_H
+#define GPU_CULL_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <shader.h>
+#include <gpu_memory.h>
+#include <model.h>
+#include <hiz.h>
+#include <rock_variants.h>
+#include <gpu_radix_sort.h>
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <string>
+
+// GPU frustum culling for instances whose positions live in the GpuNBody layout (the N-body backend and the
+// visual belt). A compute pass tests each instance's bounding sphere against the frustum of the Matrices UBO,
+// picks a level of detail from its projected size and compacts the visible indices into one list per level,
+// counted into one DrawElementsIndirectCommand per level and mesh. The draws read those counts on the GPU, so
+// vertex work follows the visible instances at their level and nothing is read back. The vertex shader fetches
+// its body through the lists when "culled" is set, each level's commands carry its list offset as baseInstance.
+// Rocks beyond the impostor distance go to one more list, drawn as points by drawImpostors. Given a captured HiZ,
+// instances behind the depth of the frame it was captured from are culled too. With several variants of the model
+// (rock_variants.h) each level's list is split by variant, every body in the run of its rockVariant, and there is one
+// command per level, variant and mesh; when the variants are pooled together all of them are one multi-draw.
+// With views set to 2 every visible instance is counted twice, for an instanced stereo draw (shaders.2/stereo.glsl).
+// Given a radix sort in frontToBack, every list is ordered nearest first so early-Z rejects the rocks behind: the cull
+// appends the visible bodies keyed by list and distance, the sort orders them and asteroid.order.cs puts them back
+// in their lists, all on the GPU.
+class GpuCuller
+{
+public:
+    unsigned int views = 1;
+    GpuRadixSort* frontToBack = nullptr;    // null leaves the lists in the order the cull found them
+
+    enum Binding {
+        BINDING_VISIBLE = 7,
+        BINDING_COMMANDS = 8,
+        BINDING_IMPOSTORS = 9,
+        BINDING_SORT_KEYS = 44,
+        BINDING_SORT_VALUES = 45,
+        BINDING_SORT_COUNT = 46
+    };
+
+    struct DrawElementsIndirectCommand
+    {
+        uint32_t count;
+        uint32_t instanceCount;
+        uint32_t firstIndex;
+        int32_t baseVertex;
+        uint32_t baseInstance;
+    };
+
+    struct DrawArraysIndirectCommand
+    {
+        uint32_t count;
+        uint32_t instanceCount;
+        uint32_t first;
+        uint32_t baseInstance;
+    };
+
+    GpuCuller(const char* cullPath, const char* orderPath) : cullShader(cullPath), orderShader(orderPath) {}
+
+    ~GpuCuller()
+    {
+        release();
+    }
+
+    // the positions and scales must already be bound (GpuNBody::bind or GpuBelt::bind). lodPixels holds the
+    // MAX_MESH_LODS - 1 projected diameters in pixels below which the next coarser level is used, an
+    // impostorDistance of 0 leaves every rock a mesh. occluders is last frame's pyramid, null or not yet captured
+    // for no occlusion culling.
+    void cull(const Model& model, unsigned int firstInstance, unsigned int instanceCount, const glm::vec3& cameraPosition,
+              float viewportHeight, const float* lodPixels, float impostorDistance = 0.0f, const HiZ* occluders = nullptr)
+    {
+        const Model* single = &model;
+        cull(&single, 1, firstInstance, instanceCount, cameraPosition, viewportHeight, lodPixels, impostorDistance, occluders);
+    }
+
+    // the same for variantCount variants of a model, which all have as many meshes
+    void cull(const Model* const* variants, unsigned int variantCount, unsigned int firstInstance, unsigned int instanceCount,
+              const glm::vec3& cameraPosition, float viewportHeight, const float* lodPixels, float impostorDistance = 0.0f,
+              const HiZ* occluders = nullptr)
+    {
+        GL_DEBUG_GROUP("asteroid cull");
+        meshCount = variantCount > 0 ? static_cast<unsigned int>(variants[0]->meshes.size()) : 0;
+        if (instanceCount == 0 || meshCount == 0)
+            return;
+        prepare(variants, variantCount, firstInstance, instanceCount);
+
+        // counts start at zero every frame, the shader adds the visible instances
+        glNamedBufferSubData(commandBuffer.id(), 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+        const DrawArraysIndirectCommand points{1, 0, 0, lodCount * visibleCapacity};
+        glNamedBufferSubData(impostorBuffer.id(), 0, sizeof(points), &points);
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_VISIBLE, visibleBuffer.id());
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_COMMANDS, commandBuffer.id());
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_IMPOSTORS, impostorBuffer.id());
+        // the sort keys hold the list in their upper byte
+        const unsigned int runs = lodCount * static_cast<unsigned int>(preparedVariants.size());
+        const bool sorted = frontToBack && runs + 1 <= 256;
+        if (sorted)
+        {
+            const GLuint zero = 0;
+            glNamedBufferSubData(sortCount.id(), 0, sizeof(zero), &zero);
+            glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_SORT_KEYS, sortKeys.id());
+            glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_SORT_VALUES, sortValues.id());
+            glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_SORT_COUNT, sortCount.id());
+        }
+
+        cullShader.use();
+        cullShader.setUInt("firstInstance", firstInstance);
+        cullShader.setUInt("instanceCount", instanceCount);
+        cullShader.setUInt("meshCount", meshCount);
+        cullShader.setUInt("variantCount", static_cast<unsigned int>(preparedVariants.size()));
+        cullShader.setVec3("cameraPosition", cameraPosition);
+        cullShader.setFloat("modelRadius", modelRadius);
+        cullShader.setUInt("lodCount", lodCount);
+        cullShader.setFloat("viewportHeight", viewportHeight);
+        cullShader.setFloat("impostorDistance", impostorDistance);
+        cullShader.setUInt("views", std::max(views, 1u));
+        cullShader.setBool("frontToBack", sorted);
+        for (unsigned int l = 0; l + 1 < MAX_MESH_LODS; l++)
+            cullShader.setFloat("lodPixels[" + std::to_string(l) + "]", lodPixels[l]);
+        const bool occlusion = occluders && occluders->valid();
+        cullShader.setBool("occlusion", occlusion);
+        if (occlusion)
+            occluders->apply(cullShader, cameraPosition);
+        glDispatchCompute((instanceCount + 255) / 256, 1, 1);
+        if (sorted)
+        {
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+            // list and 16 bits of distance, every instance appended at most once
+            frontToBack->sortIndirect(sortKeys.id(), sortValues.id(), sortCount.id(), instanceCount, 24);
+            glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_VISIBLE, visibleBuffer.id());
+            glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_COMMANDS, commandBuffer.id());
+            glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_IMPOSTORS, impostorBuffer.id());
+            glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_SORT_KEYS, sortKeys.id());
+            glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_SORT_VALUES, sortValues.id());
+            glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_SORT_COUNT, sortCount.id());
+            orderShader.use();
+            orderShader.setUInt("meshCount", meshCount);
+            orderShader.setUInt("runCount", runs);
+            orderShader.setUInt("views", std::max(views, 1u));
+            glDispatchCompute((instanceCount + 255) / 256, 1, 1);
+        }
+        // the list is read by the vertex shader, the counts by the indirect draw
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+    }
+
+    // draws every level of every mesh of model with the counts of the last cull, the shader in use must have
+    // "culled" set
+    void draw(const Model& model) const
+    {
+        const Model* single = &model;
+        draw(&single, 1);
+    }
+
+    // every level of every mesh of every variant, as culled; variants as given to cull
+    void draw(const Model* const* variants, unsigned int variantCount) const
+    {
+        if (!commandBuffer.valid() || variantCount != preparedVariants.size())
+            return;
+        glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer.id());
+        if (sharedVertexArray != 0)
+        {
+            glState().bindVertexArray(sharedVertexArray);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(commands.size()), 0);
+        }
+        else
+        {
+            for (unsigned int v = 0; v < variantCount; v++)
+                for (unsigned int i = 0; i < variants[v]->meshes.size() && i < meshCount; i++)
+                {
+                    glState().bindVertexArray(variants[v]->meshes[i].VAO);
+                    for (unsigned int l = 0; l < lodCount; l++)
+                        glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<const void*>(commandIndex(l, v, i) * sizeof(DrawElementsIndirectCommand)));
+                }
+        }
+        glState().bindVertexArray(0);
+        glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    // one point per rock of the impostor list, with the impostor variant of the instanced shader in use
+    void drawImpostors(const Model& model) const
+    {
+        if (!impostorBuffer.valid() || model.meshes.empty())
+            return;
+        glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, impostorBuffer.id());
+        glState().bindVertexArray(model.meshes[0].VAO);
+        glDrawArraysIndirect(GL_POINTS, nullptr);
+        glState().bindVertexArray(0);
+        glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    void release()
+    {
+        visibleBuffer.release();
+        commandBuffer.release();
+        impostorBuffer.release();
+        sortKeys.release();
+        sortValues.release();
+        sortCount.release();
+        visibleCapacity = 0;
+        preparedVariants.clear();
+    }
+
+    // farthest vertex from the model origin, the instance scale multiplies it
+    static float boundingRadius(const Model& model)
+    {
+        float radius = 0.0f;
+        for (const Mesh& mesh : model.meshes)
+            radius = std::max(radius, mesh.boundingRadius);
+        return radius;
+    }
+
+private:
+    Shader cullShader;
+    Shader orderShader;
+    GlBuffer visibleBuffer{GPU_MEMORY_INSTANCES};
+    GlBuffer commandBuffer{GPU_MEMORY_INSTANCES};
+    GlBuffer impostorBuffer{GPU_MEMORY_INSTANCES};
+    GlBuffer sortKeys{GPU_MEMORY_INSTANCES};
+    GlBuffer sortValues{GPU_MEMORY_INSTANCES};
+    GlBuffer sortCount{GPU_MEMORY_INSTANCES};
+    unsigned int visibleCapacity = 0;
+    unsigned int meshCount = 0;
+    unsigned int lodCount = 1;
+    std::vector<const Model*> preparedVariants;
+    unsigned int preparedFirst = 0;
+    unsigned int preparedCount = 0;
+    std::vector<uint32_t> variantStarts;    // where each variant's run begins in a level's list
+    unsigned int sharedVertexArray = 0;     // the VAO of every mesh of every variant, 0 if they differ
+    float modelRadius = 0.0f;
+    std::vector<DrawElementsIndirectCommand> commands;
+
+    // level, then variant, then mesh, as asteroid.cull.cs counts them
+    size_t commandIndex(unsigned int level, unsigned int variant, unsigned int mesh) const
+    {
+        return (static_cast<size_t>(level) * preparedVariants.size() + variant) * meshCount + mesh;
+    }
+
+    // grows the visible lists geometrically, one full-size list per level plus the impostors' so no list can
+    // overflow into the next, and rebuilds the commands when the variants, the instances or the list offsets change
+    void prepare(const Model* const* variants, unsigned int variantCount, unsigned int firstInstance, unsigned int instanceCount)
+    {
+        unsigned int levels = MAX_MESH_LODS;
+        for (unsigned int v = 0; v < variantCount; v++)
+            levels = std::min(levels, variants[v]->lodCount());
+        const bool grow = instanceCount > visibleCapacity;
+        if (grow || levels != lodCount)
+        {
+            visibleCapacity = std::max(instanceCount, grow ? 2 * visibleCapacity : visibleCapacity);
+            lodCount = levels;
+            // immutable storage, so a new capacity is new buffers: the lists are the shader's alone, the commands
+            // and the count are reset from here
+            visibleBuffer.create(GL_SHADER_STORAGE_BUFFER, "cull visible instances");
+            visibleBuffer.storage(static_cast<size_t>(visibleCapacity) * (lodCount + 1) * sizeof(uint32_t), nullptr, 0);
+            impostorBuffer.create(GL_SHADER_STORAGE_BUFFER, "cull impostor command");
+            impostorBuffer.storage(sizeof(DrawArraysIndirectCommand), nullptr, GL_DYNAMIC_STORAGE_BIT);
+            // the front-to-back keys, one list of every visible instance
+            sortKeys.create(GL_SHADER_STORAGE_BUFFER, "cull sort keys");
+            sortKeys.storage(static_cast<size_t>(visibleCapacity) * sizeof(uint32_t), nullptr, 0);
+            sortValues.create(GL_SHADER_STORAGE_BUFFER, "cull sort values");
+            sortValues.storage(static_cast<size_t>(visibleCapacity) * sizeof(uint32_t), nullptr, 0);
+            sortCount.create(GL_SHADER_STORAGE_BUFFER, "cull sort count");
+            sortCount.storage(sizeof(uint32_t), nullptr, GL_DYNAMIC_STORAGE_BIT);
+            glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+            preparedVariants.clear();
+        }
+        if (preparedVariants.size() == variantCount && std::equal(preparedVariants.begin(), preparedVariants.end(), variants)
+            && preparedFirst == firstInstance && preparedCount == instanceCount)
+            return;
+        preparedVariants.assign(variants, variants + variantCount);
+        preparedFirst = firstInstance;
+        preparedCount = instanceCount;
+
+        // the bodies of each variant, counted once per change of the instances as the shader will bin them
+        variantStarts.assign(variantCount + 1, 0);
+        if (variantCount > 1)
+            for (unsigned int i = 0; i < instanceCount; i++)
+                variantStarts[rockVariant(firstInstance + i, variantCount) + 1]++;
+        else
+            variantStarts[1] = instanceCount;
+        for (unsigned int v = 0; v < variantCount; v++)
+            variantStarts[v + 1] += variantStarts[v];
+
+        modelRadius = 0.0f;
+        sharedVertexArray = variants[0]->meshes[0].VAO;
+        for (unsigned int v = 0; v < variantCount; v++)
+        {
+            modelRadius = std::max(modelRadius, boundingRadius(*variants[v]));
+            for (const Mesh& mesh : variants[v]->meshes)
+                if (!mesh.pooled || mesh.VAO != sharedVertexArray)
+                    sharedVertexArray = 0;
+        }
+        commands.clear();
+        for (unsigned int l = 0; l < lodCount; l++)
+            for (unsigned int v = 0; v < variantCount; v++)
+                for (const Mesh& mesh : variants[v]->meshes)
+                {
+                    const MeshLod lod = mesh.lod(l);
+                    commands.push_back(DrawElementsIndirectCommand{lod.count, 0, lod.firstIndex, mesh.baseVertex(), l * visibleCapacity + variantStarts[v]});
+                }
+        commandBuffer.create(GL_SHADER_STORAGE_BUFFER, "cull draw commands");
+        commandBuffer.storage(commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_DYNAMIC_STORAGE_BIT);
+        glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+};
+
+#endif
@@ -0,0 +1,356 @@
+#ifndef GPU_MEMORY_H
+#define GPU_MEMORY_H
+
+#include <glad/glad.h>
+
+#include <gl_state_cache.h>
+#include <gl_debug.h>
+
+#include <atomic>
+#include <cstring>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+
+// What VRAM the engine holds, by what it is for. GL objects made through GlBuffer, GlTexture and GlVertexArray
+// add their storage here while they exist and give it back when they are released or destroyed; memory owned some
+// other way is entered with a GpuAllocation. The sizes are what was asked for, the driver pads and aligns on top,
+// so its own report (driver()) is shown next to them where it gives one.
+enum GpuMemoryCategory {
+    GPU_MEMORY_GEOMETRY = 0,        // vertex and index buffers, the geometry pool
+    GPU_MEMORY_TEXTURES,
+    GPU_MEMORY_INSTANCES,           // per-instance streams and the GPU cull's lists
+    GPU_MEMORY_RENDER_TARGETS,      // G-buffer, shadow maps, the Hi-Z pyramid
+    GPU_MEMORY_SIMULATION,          // the GPU n-body and visual belt state
+    GPU_MEMORY_OTHER,               // uniform and parameter buffers
+    GPU_MEMORY_CATEGORIES
+};
+
+class GpuMemoryTracker
+{
+public:
+    // the driver's own numbers in KB, -1 for any it does not report
+    struct DriverMemory
+    {
+        long long totalKB = -1;         // dedicated video memory
+        long long availableKB = -1;     // free right now
+        long long evictedKB = -1;       // moved out to system memory since startup (NVIDIA only)
+        const char* source = "none";
+    };
+
+    static const char* name(GpuMemoryCategory category)
+    {
+        static const char* names[GPU_MEMORY_CATEGORIES] = {"geometry", "textures", "instance streams", "render targets",
+                                                           "simulation", "other"};
+        return names[category];
+    }
+
+    void add(GpuMemoryCategory category, long long bytes, int objectDelta = 0)
+    {
+        totals[category].bytes.fetch_add(bytes, std::memory_order_relaxed);
+        totals[category].objects.fetch_add(objectDelta, std::memory_order_relaxed);
+    }
+
+    long long bytes(GpuMemoryCategory category) const { return totals[category].bytes.load(std::memory_order_relaxed); }
+    long long objects(GpuMemoryCategory category) const { return totals[category].objects.load(std::memory_order_relaxed); }
+
+    long long totalBytes() const
+    {
+        long long sum = 0;
+        for (unsigned int c = 0; c < GPU_MEMORY_CATEGORIES; c++)
+            sum += bytes(static_cast<GpuMemoryCategory>(c));
+        return sum;
+    }
+
+    // GL_NVX_gpu_memory_info or GL_ATI_meminfo, on the GL thread; the extension is looked for on the first call
+    DriverMemory driver()
+    {
+        if (driverSource < 0)
+        {
+            driverSource = 0;
+            GLint extensions = 0;
+            glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+            for (GLint e = 0; e < extensions && driverSource == 0; e++)
+            {
+                const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, e));
+                if (!extension)
+                    continue;
+                if (!std::strcmp(extension, "GL_NVX_gpu_memory_info")) driverSource = 1;
+                else if (!std::strcmp(extension, "GL_ATI_meminfo")) driverSource = 2;
+            }
+        }
+        DriverMemory memory;
+        GLint kb[4] = {-1, -1, -1, -1};
+        if (driverSource == 1)
+        {
+            memory.source = "GL_NVX_gpu_memory_info";
+            glGetIntegerv(0x9047, kb);      // GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX
+            memory.totalKB = kb[0];
+            glGetIntegerv(0x9049, kb);      // GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX
+            memory.availableKB = kb[0];
+            glGetIntegerv(0x904B, kb);      // GPU_MEMORY_INFO_EVICTED_MEMORY_NVX
+            memory.evictedKB = kb[0];
+        }
+        else if (driverSource == 2)
+        {
+            // the first of four values is the total free in the pool
+            memory.source = "GL_ATI_meminfo";
+            glGetIntegerv(0x87FB, kb);      // VBO_FREE_MEMORY_ATI
+            memory.availableKB = kb[0];
+        }
+        return memory;
+    }
+
+private:
+    struct Total
+    {
+        std::atomic<long long> bytes{0};
+        std::atomic<long long> objects{0};
+    };
+    Total totals[GPU_MEMORY_CATEGORIES];
+    int driverSource = -1;      // 0 none, 1 NVX, 2 ATI
+};
+
+// never destroyed, global GL objects give their bytes back during static destruction
+inline GpuMemoryTracker& gpuMemory()
+{
+    static GpuMemoryTracker* tracker = new GpuMemoryTracker();
+    return *tracker;
+}
+
+// bytes entered into one category for as long as this lives, re-entered on each set()
+class GpuAllocation
+{
+public:
+    explicit GpuAllocation(GpuMemoryCategory category = GPU_MEMORY_OTHER) : category(category) {}
+    ~GpuAllocation() { reset(); }
+
+    GpuAllocation(const GpuAllocation&) = delete;
+    GpuAllocation& operator=(const GpuAllocation&) = delete;
+
+    GpuAllocation(GpuAllocation&& other) noexcept : category(other.category), size(std::exchange(other.size, 0)) {}
+    GpuAllocation& operator=(GpuAllocation&& other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            category = other.category;
+            size = std::exchange(other.size, 0);
+        }
+        return *this;
+    }
+
+    void set(size_t bytes)
+    {
+        if (bytes == size)
+            return;
+        gpuMemory().add(category, static_cast<long long>(bytes) - static_cast<long long>(size), size == 0 && bytes > 0 ? 1 : bytes == 0 && size > 0 ? -1 : 0);
+        size = bytes;
+    }
+
+    void reset() { set(0); }
+    size_t bytes() const { return size; }
+
+private:
+    GpuMemoryCategory category;
+    size_t size = 0;
+};
+
+// bytes per texel of the sized internal formats the engine allocates, 0 for others (compressed data is tracked
+// by what was uploaded instead)
+inline size_t texelBytes(GLenum format)
+{
+    switch (format)
+    {
+    case GL_R8: case GL_R8UI: return 1;
+    case GL_RG8: case GL_R16F: return 2;
+    case GL_RGB8: case GL_SRGB8: return 3;
+    case GL_RGBA8: case GL_SRGB8_ALPHA8: case GL_RGB10_A2: case GL_R11F_G11F_B10F: case GL_RG16F:
+    case GL_R32F: case GL_R32UI: case GL_RG16UI: case GL_DEPTH24_STENCIL8: case GL_DEPTH_COMPONENT24: case GL_DEPTH_COMPONENT32F: return 4;
+    case GL_RGBA16F: case GL_RG32F: case GL_DEPTH32F_STENCIL8: return 8;
+    case GL_RGBA32F: return 16;
+    default: return 0;
+    }
+}
+
+// A buffer name with its storage entered into the tracker. Move-only, deleted with the owner: release it (or its
+// owner) before the GL context goes.
+class GlBuffer
+{
+public:
+    explicit GlBuffer(GpuMemoryCategory category = GPU_MEMORY_OTHER) : allocation(category) {}
+    ~GlBuffer() { release(); }
+
+    GlBuffer(const GlBuffer&) = delete;
+    GlBuffer& operator=(const GlBuffer&) = delete;
+    GlBuffer(GlBuffer&& other) noexcept : name(std::exchange(other.name, 0u)), allocation(std::move(other.allocation)) {}
+    GlBuffer& operator=(GlBuffer&& other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            name = std::exchange(other.name, 0u);
+            allocation = std::move(other.allocation);
+        }
+        return *this;
+    }
+
+    GLuint id() const { return name; }
+    bool valid() const { return name != 0; }
+    size_t bytes() const { return allocation.bytes(); }
+
+    // a new name bound to target, the old one deleted. The buffer exists once created, so it can be given its
+    // storage and filled by name without being bound again
+    GLuint create(GLenum target, const char* label)
+    {
+        release();
+        glCreateBuffers(1, &name);
+        glState().bindBuffer(target, name);
+        labelObject(GL_BUFFER, name, label);
+        return name;
+    }
+
+    // immutable storage, once per name: flags are GL_DYNAMIC_STORAGE_BIT for what is updated with
+    // glNamedBufferSubData, the map bits for what is mapped, 0 for what only the GPU writes after this. A buffer
+    // that grows is created again. An empty one gets a byte, GL refusing storage of none
+    void storage(size_t size, const void* contents, GLbitfield flags)
+    {
+        glNamedBufferStorage(name, static_cast<GLsizeiptr>(std::max<size_t>(size, 1)), size > 0 ? contents : nullptr, flags);
+        allocation.set(size);
+    }
+
+    void release()
+    {
+        if (name != 0)
+            glState().deleteBuffers(1, &name);
+        name = 0;
+        allocation.reset();
+    }
+
+private:
+    GLuint name = 0;
+    GpuAllocation allocation;
+};
+
+// a texture name with its storage entered into the tracker, the same rules as GlBuffer
+class GlTexture
+{
+public:
+    explicit GlTexture(GpuMemoryCategory category = GPU_MEMORY_TEXTURES) : allocation(category) {}
+    ~GlTexture() { release(); }
+
+    GlTexture(const GlTexture&) = delete;
+    GlTexture& operator=(const GlTexture&) = delete;
+    GlTexture(GlTexture&& other) noexcept
+        : name(std::exchange(other.name, 0u)), target(other.target), allocation(std::move(other.allocation)) {}
+    GlTexture& operator=(GlTexture&& other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            name = std::exchange(other.name, 0u);
+            target = other.target;
+            allocation = std::move(other.allocation);
+        }
+        return *this;
+    }
+
+    GLuint id() const { return name; }
+    bool valid() const { return name != 0; }
+    size_t bytes() const { return allocation.bytes(); }
+
+    // a new name bound to textureTarget, the old one deleted
+    GLuint create(GLenum textureTarget, const char* label)
+    {
+        release();
+        target = textureTarget;
+        glCreateTextures(target, 1, &name);
+        glState().bindTexture(target, name);
+        labelObject(GL_TEXTURE, name, label);
+        return name;
+    }
+
+    // immutable storage, a cube map counting its six faces
+    void storage2D(GLsizei levels, GLenum format, GLsizei width, GLsizei height)
+    {
+        glTextureStorage2D(name, levels, format, width, height);
+        allocation.set(mipChainBytes(levels, format, width, height, target == GL_TEXTURE_CUBE_MAP ? 6 : 1));
+    }
+
+    void storage3D(GLsizei levels, GLenum format, GLsizei width, GLsizei height, GLsizei layers)
+    {
+        glTextureStorage3D(name, levels, format, width, height, layers);
+        allocation.set(mipChainBytes(levels, format, width, height, layers));
+    }
+
+    // for storage specified some other way, e.g. compressed levels
+    void track(size_t bytes) { allocation.set(bytes); }
+
+    void release()
+    {
+        if (name != 0)
+            glState().deleteTextures(1, &name);
+        name = 0;
+        allocation.reset();
+    }
+
+private:
+    GLuint name = 0;
+    GLenum target = GL_TEXTURE_2D;
+    GpuAllocation allocation;
+
+    static size_t mipChainBytes(GLsizei levels, GLenum format, GLsizei width, GLsizei height, GLsizei layers)
+    {
+        size_t total = 0;
+        for (GLsizei l = 0; l < levels; l++)
+            total += texelBytes(format) * static_cast<size_t>(std::max(width >> l, 1)) * static_cast<size_t>(std::max(height >> l, 1));
+        return total * static_cast<size_t>(layers);
+    }
+};
+
+// a vertex array name, counted but holding no storage of its own
+class GlVertexArray
+{
+public:
+    GlVertexArray() = default;
+    ~GlVertexArray() { release(); }
+
+    GlVertexArray(const GlVertexArray&) = delete;
+    GlVertexArray& operator=(const GlVertexArray&) = delete;
+    GlVertexArray(GlVertexArray&& other) noexcept : name(std::exchange(other.name, 0u)) {}
+    GlVertexArray& operator=(GlVertexArray&& other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            name = std::exchange(other.name, 0u);
+        }
+        return *this;
+    }
+
+    GLuint id() const { return name; }
+
+    GLuint create(const char* label)
+    {
+        release();
+        glGenVertexArrays(1, &name);
+        glState().bindVertexArray(name);
+        labelObject(GL_VERTEX_ARRAY, name, label);
+        gpuMemory().add(GPU_MEMORY_GEOMETRY, 0, 1);
+        return name;
+    }
+
+    void release()
+    {
+        if (name == 0)
+            return;
+        glState().deleteVertexArrays(1, &name);
+        gpuMemory().add(GPU_MEMORY_GEOMETRY, 0, -1);
+        name = 0;
+    }
+
+private:
+    GLuint name = 0;
+};
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef GPU_MORTON_H
+#define GPU_MORTON_H
+
+#include <glad/glad.h>
+
+#include <shader.h>
+#include <body_store.h>
+#include <gpu_nbody.h>
+#include <gpu_memory.h>
+#include <gpu_readback.h>
+#include <gpu_radix_sort.h>
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+// The Z-order re-sort of the asteroids (PhysicsWorld's MortonSorter) for the GPU backends, whose bodies never come
+// back to the CPU. check() computes 63-bit keys of the asteroids on a grid over their bounding box and counts the
+// neighbouring pairs out of order (shaders.2/nbody.morton.cs); the count comes back through the readback ring a
+// frame or two late. sort() computes the keys again, radix sorts them on the GPU (gpu_radix_sort.h) and permutes
+// GpuNBody's buffers by the result. The order is read back once per sort to permute the CPU store the same way, so
+// a slot still holds the same body on both sides: ids, the selection and downloads keep following their bodies.
+class GpuMortonOrder
+{
+public:
+    float disorder = 0.0f;          // out-of-order fraction at the last check that came back
+
+    GpuMortonOrder(const char* mortonPath, const char* gatherPath, GpuRadixSort& sorter)
+        : mortonShader(mortonPath), gatherShader(gatherPath), radix(sorter) {}
+    GpuMortonOrder(const GpuMortonOrder&) = delete;
+    GpuMortonOrder& operator=(const GpuMortonOrder&) = delete;
+
+    ~GpuMortonOrder()
+    {
+        release();
+    }
+
+    // keys of nbody's asteroids and a request for their disorder, which lands in disorder from a later poll()
+    void check(const GpuNBody& nbody, GpuReadback& readback)
+    {
+        const unsigned int count = nbody.bodyCount - nbody.massiveCount;
+        if (nbody.bodyCount <= nbody.massiveCount || count < 2)
+            return;
+        GL_DEBUG_GROUP("morton check");
+        computeKeys(nbody, true);
+        readback.request(bounds.id(), 6 * sizeof(GLuint), sizeof(GLuint), [this, count](const void* data, size_t bytes, unsigned int) {
+            if (bytes < sizeof(uint32_t)) return;
+            const uint32_t descents = *static_cast<const uint32_t*>(data);
+            disorder = static_cast<float>(descents) / static_cast<float>(count - 1);
+        });
+    }
+
+    // sorts nbody's asteroids by their current keys, and bodies' the same way
+    void sort(GpuNBody& nbody, BodyStore& bodies)
+    {
+        const unsigned int count = nbody.bodyCount - nbody.massiveCount;
+        if (nbody.bodyCount <= nbody.massiveCount || count < 2 || bodies.count(BODY_ASTEROID) != count
+            || bodies.range(BODY_ASTEROID).begin != nbody.massiveCount)
+            return;
+        GL_DEBUG_GROUP("morton sort");
+        computeKeys(nbody, false);
+        radix.sort(keys.id(), order.id(), count, 63);
+        // the one wait on the GPU, once per sort
+        std::vector<uint32_t> sorted(count);
+        glGetNamedBufferSubData(order.id(), 0, count * sizeof(uint32_t), sorted.data());
+        nbody.reorder(gatherShader, order.id(), sorted, nbody.massiveCount);
+        bodies.reorder(BODY_ASTEROID, sorted);
+        disorder = 0.0f;
+    }
+
+    void release()
+    {
+        bounds.release();
+        keys.release();
+        order.release();
+        capacity = 0;
+    }
+
+private:
+    static const GLuint BINDING_BOUNDS = 47;
+    static const GLuint BINDING_KEYS = 48;
+    static const GLuint BINDING_ORDER = 49;
+
+    Shader mortonShader;
+    Shader gatherShader;
+    GpuRadixSort& radix;
+    GlBuffer bounds{GPU_MEMORY_SIMULATION};
+    GlBuffer keys{GPU_MEMORY_SIMULATION};
+    GlBuffer order{GPU_MEMORY_SIMULATION};
+    unsigned int capacity = 0;
+
+    // the bounds, then the keys with the identity order, then with countDescents how many pairs are out of order
+    void computeKeys(const GpuNBody& nbody, bool countDescents)
+    {
+        const unsigned int first = nbody.massiveCount, count = nbody.bodyCount - first;
+        reserve(count);
+        const GLuint initial[7] = {0xffffffffu, 0xffffffffu, 0xffffffffu, 0u, 0u, 0u, 0u};
+        glNamedBufferSubData(bounds.id(), 0, sizeof(initial), initial);
+        nbody.bind();
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_BOUNDS, bounds.id());
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_KEYS, keys.id());
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_ORDER, order.id());
+        mortonShader.use();
+        mortonShader.setUInt("first", first);
+        mortonShader.setUInt("count", count);
+        const GLuint groups = (count + 255) / 256;
+        for (int stage = 0; stage < (countDescents ? 3 : 2); stage++)
+        {
+            mortonShader.setInt("stage", stage);
+            glDispatchCompute(groups, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+    }
+
+    void reserve(unsigned int count)
+    {
+        if (!bounds.valid())
+        {
+            bounds.create(GL_SHADER_STORAGE_BUFFER, "morton bounds");
+            bounds.storage(7 * sizeof(GLuint), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        }
+        if (count > capacity)
+        {
+            capacity = std::max(count, 2 * capacity);
+            keys.release();
+            order.release();
+            keys.create(GL_SHADER_STORAGE_BUFFER, "morton keys");
+            keys.storage(static_cast<size_t>(capacity) * 2 * sizeof(uint32_t), nullptr, 0);
+            order.create(GL_SHADER_STORAGE_BUFFER, "morton order");
+            order.storage(static_cast<size_t>(capacity) * sizeof(uint32_t), nullptr, 0);
+        }
+        glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+};
+
+#endif
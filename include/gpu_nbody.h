@@ -0,0 +1,237 @@
+#ifndef GPU_NBODY_H
+#define GPU_NBODY_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+#include <gtc/quaternion.hpp>
+
+#include <shader.h>
+#include <body_store.h>
+#include <gpu_memory.h>
+#include <gpu_readback.h>
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+// N-body backend that keeps positions and velocities in SSBOs and integrates them with compute shaders.
+// The buffers are bound to fixed SSBO binding points so the instanced asteroid vertex shader can read
+// positions directly, nothing goes back through the CPU except the few massive bodies needed for lighting, and
+// those through the readback ring (gpu_readback.h) a frame or two late.
+// The buffers stay single precision, the double CPU state is rounded on upload.
+class GpuNBody
+{
+public:
+    enum Binding {
+        BINDING_POSITION_MASS = 0,
+        BINDING_VELOCITY = 1,
+        BINDING_ORIENTATION = 2,
+        BINDING_SCALE = 3,
+        BINDING_SPIN = 4
+    };
+
+    unsigned int bodyCount = 0;
+    unsigned int massiveCount = 0;
+    double totalMass = 0.0;             // of every body, kept current by setMass
+
+    GpuNBody(const char* forcePath, const char* driftPath) : forceShader(forcePath), driftShader(driftPath) {}
+
+    ~GpuNBody()
+    {
+        release();
+    }
+
+    // uploads the full body store, recreating the buffers
+    void upload(const BodyStore& bodies)
+    {
+        release();
+        bodyCount = static_cast<unsigned int>(bodies.size());
+        massiveCount = static_cast<unsigned int>(bodies.range(BODY_ASTEROID).begin);
+        if (bodyCount == 0)
+            return;
+
+        std::vector<glm::vec4> posMass(bodyCount), velocity(bodyCount), orientation(bodyCount), spin(bodyCount);
+        std::vector<float> scale(bodyCount);
+        masses.assign(bodies.mass.begin(), bodies.mass.end());
+        totalMass = 0.0;
+        for (unsigned int i = 0; i < bodyCount; i++)
+        {
+            totalMass += bodies.mass[i];
+            posMass[i] = glm::vec4(glm::vec3(bodies.position[i]), bodies.mass[i]);
+            velocity[i] = glm::vec4(glm::vec3(bodies.velocity[i]), bodies.isStatic(i) ? 0.0f : 1.0f);
+            const glm::quat& q = bodies.render[i].orientation;
+            orientation[i] = glm::vec4(q.x, q.y, q.z, q.w);
+            scale[i] = bodies.render[i].radiusScale;
+            spin[i] = bodies.render[i].spin;
+        }
+
+        glCreateBuffers(5, buffers);
+        createBuffer(BINDING_POSITION_MASS, posMass.size() * sizeof(glm::vec4), posMass.data(), "n-body positions");
+        createBuffer(BINDING_VELOCITY, velocity.size() * sizeof(glm::vec4), velocity.data(), "n-body velocities");
+        createBuffer(BINDING_ORIENTATION, orientation.size() * sizeof(glm::vec4), orientation.data(), "n-body orientations");
+        createBuffer(BINDING_SCALE, scale.size() * sizeof(float), scale.data(), "n-body scales");
+        createBuffer(BINDING_SPIN, spin.size() * sizeof(glm::vec4), spin.data(), "n-body spins");
+        bind();
+    }
+
+    // vec4 position and mass per body, the buffer at BINDING_POSITION_MASS
+    unsigned int positionBuffer() const { return buffers[BINDING_POSITION_MASS]; }
+    unsigned int buffer(Binding binding) const { return buffers[binding]; }
+
+    void bind() const
+    {
+        for (unsigned int b = 0; b < 5; b++)
+            if (buffers[b] != 0) glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, b, buffers[b]);
+    }
+
+    // one semi-implicit Euler step: kick every velocity, then drift every position
+    void step(float dt, float G, float epsilonSq, bool asteroidSelfGravity, bool testParticles = false)
+    {
+        GL_DEBUG_GROUP("n-body step");
+        if (bodyCount == 0)
+            return;
+        bind();
+        unsigned int groups = (bodyCount + 255) / 256;
+
+        forceShader.use();
+        forceShader.setUInt("bodyCount", bodyCount);
+        forceShader.setUInt("massiveCount", massiveCount);
+        forceShader.setBool("asteroidSelfGravity", asteroidSelfGravity);
+        forceShader.setBool("testParticles", testParticles);
+        forceShader.setFloat("G", G);
+        forceShader.setFloat("dt", dt);
+        forceShader.setFloat("epsilonSq", epsilonSq);
+        glDispatchCompute(groups, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        drift(dt);
+    }
+
+    // the drift half of step(), after velocities were kicked some other way (gpu_particle_mesh.h)
+    void drift(float dt)
+    {
+        if (bodyCount == 0)
+            return;
+        bind();
+        driftShader.use();
+        driftShader.setUInt("bodyCount", bodyCount);
+        driftShader.setFloat("dt", dt);
+        glDispatchCompute((bodyCount + 255) / 256, 1, 1);
+        // positions are consumed by the next step and by the instanced vertex shader
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    }
+
+    // queues a copy of the massive bodies' (sun, planets) vec4 positions and masses, done gets them from a later
+    // readback.poll() so CPU-side drawing and lighting can follow them without a synchronization point
+    bool requestMassive(GpuReadback& readback, GpuReadback::Callback done) const
+    {
+        if (massiveCount == 0)
+            return false;
+        return readback.request(buffers[BINDING_POSITION_MASS], 0, massiveCount * sizeof(glm::vec4), std::move(done));
+    }
+
+    // copies the full state back, used when handing the simulation back to a CPU backend
+    void download(BodyStore& bodies) const
+    {
+        if (bodyCount == 0 || bodyCount != bodies.size())
+            return;
+        std::vector<glm::vec4> posMass(bodyCount), velocity(bodyCount);
+        glGetNamedBufferSubData(buffers[BINDING_POSITION_MASS], 0, bodyCount * sizeof(glm::vec4), posMass.data());
+        glGetNamedBufferSubData(buffers[BINDING_VELOCITY], 0, bodyCount * sizeof(glm::vec4), velocity.data());
+        for (unsigned int i = 0; i < bodyCount; i++)
+        {
+            bodies.position[i] = glm::dvec3(glm::vec3(posMass[i]));
+            bodies.velocity[i] = glm::dvec3(glm::vec3(velocity[i]));
+        }
+    }
+
+    // pushes a changed mass for one body without re-uploading the rest
+    void setMass(unsigned int index, float mass)
+    {
+        if (index >= bodyCount)
+            return;
+        totalMass += static_cast<double>(mass) - masses[index];
+        masses[index] = mass;
+        glNamedBufferSubData(buffers[BINDING_POSITION_MASS], index * sizeof(glm::vec4) + 3 * sizeof(float), sizeof(float), &mass);
+    }
+
+    void setScale(unsigned int index, float scale)
+    {
+        if (index >= bodyCount)
+            return;
+        glNamedBufferSubData(buffers[BINDING_SCALE], index * sizeof(float), sizeof(float), &scale);
+    }
+
+    // permutes the bodies [first, first + order.size()): slot first + k receives the body that was at
+    // first + order[k], orderBuffer a GPU copy of order. Each buffer is replaced by a permuted copy with gatherShader
+    // (shaders.2/nbody.gather.cs), the rest of it copied as it was.
+    void reorder(Shader& gatherShader, GLuint orderBuffer, const std::vector<uint32_t>& order, unsigned int first)
+    {
+        const unsigned int count = static_cast<unsigned int>(order.size());
+        if (bodyCount == 0 || count < 2 || first + count > bodyCount)
+            return;
+        GL_DEBUG_GROUP("n-body reorder");
+        static const char* const labels[5] = {"n-body positions", "n-body velocities", "n-body orientations", "n-body scales", "n-body spins"};
+        unsigned int permuted[5] = {0, 0, 0, 0, 0};
+        glCreateBuffers(5, permuted);
+        gatherShader.use();
+        gatherShader.setUInt("first", first);
+        gatherShader.setUInt("count", count);
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, 49, orderBuffer);
+        for (unsigned int b = 0; b < 5; b++)
+        {
+            const size_t words = b == BINDING_SCALE ? 1 : 4;
+            const size_t size = bodyCount * words * sizeof(float);
+            labelObject(GL_BUFFER, permuted[b], labels[b]);
+            glNamedBufferStorage(permuted[b], static_cast<GLsizeiptr>(size), nullptr, storageFlags(b));
+            glCopyNamedBufferSubData(buffers[b], permuted[b], 0, 0, size);
+            gatherShader.setUInt("words", static_cast<unsigned int>(words));
+            glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, 50, buffers[b]);
+            glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, 51, permuted[b]);
+            glDispatchCompute((count + 255) / 256, 1, 1);
+        }
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+        glState().deleteBuffers(5, buffers);
+        for (unsigned int b = 0; b < 5; b++)
+            buffers[b] = permuted[b];
+        std::vector<float> reordered(count);
+        for (unsigned int k = 0; k < count; k++)
+            reordered[k] = masses[first + order[k]];
+        std::copy(reordered.begin(), reordered.end(), masses.begin() + first);
+        bind();
+    }
+
+    void release()
+    {
+        if (buffers[0] != 0)
+            glState().deleteBuffers(5, buffers);
+        for (unsigned int b = 0; b < 5; b++)
+            buffers[b] = 0;
+        memory.reset();
+        bodyCount = 0;
+        massiveCount = 0;
+        totalMass = 0.0;
+        masses.clear();
+    }
+
+private:
+    Shader forceShader;
+    Shader driftShader;
+    unsigned int buffers[5] = {0, 0, 0, 0, 0};
+    std::vector<float> masses;                      // CPU copy, for totalMass
+    GpuAllocation memory{GPU_MEMORY_SIMULATION};   // all of buffers
+
+    // setMass and setScale write single bodies into theirs, the shaders alone write the rest
+    static GLbitfield storageFlags(unsigned int binding)
+    {
+        return binding == BINDING_POSITION_MASS || binding == BINDING_SCALE ? GL_DYNAMIC_STORAGE_BIT : 0;
+    }
+
+    void createBuffer(unsigned int binding, size_t size, const void* data, const char* label)
+    {
+        labelObject(GL_BUFFER, buffers[binding], label);
+        glNamedBufferStorage(buffers[binding], static_cast<GLsizeiptr>(size), data, storageFlags(binding));
+        memory.set(memory.bytes() + size);
+    }
+};
+
+#endif
@@ -0,0 +1,174 @@
+#ifndef GPU_PARTICLE_MESH_H
+#define GPU_PARTICLE_MESH_H
+
+#include <glad/glad.h>
+
+#include <shader.h>
+#include <gpu_nbody.h>
+#include <particle_mesh.h>
+#include <gpu_memory.h>
+#include <gl_state_cache.h>
+#include <gl_debug.h>
+
+#include <string>
+#include <cmath>
+#include <algorithm>
+
+// The particle-mesh solver of particle_mesh.h for the GPU n-body backend, kicking GpuNBody's velocities in place.
+// A pass finds the bodies' bounds, the masses go onto the nodes with integer atomics in fixed point (scaled so the
+// total mass fits in 32 bits), and the convolution runs as one workgroup per line in shared memory over the same
+// pruned passes as on the CPU, the z pass transforming, multiplying by the spectrum and transforming back in one
+// go. The spectrum is the CPU solver's, uploaded whenever the grid or the split changes. Nothing comes back, the
+// frame is read from the bounds buffer by every pass that needs it.
+//
+// With P3M only the massive bodies' short-range pull is summed pair by pair; asteroid pairs closer than a few
+// cells keep the mesh's smoothed force, a neighbour search over a million bodies would cost more than the mesh.
+class GpuParticleMesh
+{
+public:
+    static const unsigned int BINDING_BOUNDS = 33;
+    static const unsigned int BINDING_MASS = 34;
+    static const unsigned int BINDING_WORK = 35;
+    static const unsigned int BINDING_SPECTRUM = 36;
+
+    explicit GpuParticleMesh(const std::string& shaderDirectory)
+        : boundsShader((shaderDirectory + "pm.bounds.cs").c_str()), depositShader((shaderDirectory + "pm.deposit.cs").c_str()),
+          loadShader((shaderDirectory + "pm.load.cs").c_str()), fftShader((shaderDirectory + "pm.fft.cs").c_str()),
+          kickShader((shaderDirectory + "pm.kick.cs").c_str()) {}
+    GpuParticleMesh(const GpuParticleMesh&) = delete;
+    GpuParticleMesh& operator=(const GpuParticleMesh&) = delete;
+
+    size_t gpuBytes() const { return bounds.bytes() + nodeMass.bytes() + work.bytes() + spectrum.bytes(); }
+
+    // velocity += G a dt for every body of nbody, a the mesh acceleration with settings' grid and split
+    void kick(GpuNBody& nbody, const ParticleMesh& settings, float dt, float G, float epsilonSq)
+    {
+        if (nbody.bodyCount == 0 || nbody.totalMass <= 0.0)
+            return;
+        GL_DEBUG_GROUP("particle mesh");
+        const unsigned int n = ParticleMesh::gridSize(settings.grid);
+        if (n != size || settings.shortRange != spectrumShortRange || settings.splitCells != spectrumSplit)
+            prepare(n, settings);
+        const unsigned int m = 2 * n;
+        const unsigned int groups = (nbody.bodyCount + 255) / 256;
+        const float massScale = static_cast<float>(4.0e9 / nbody.totalMass);
+        nbody.bind();
+        bindBuffers();
+
+        const GLuint initial[6] = {0xffffffffu, 0xffffffffu, 0xffffffffu, 0u, 0u, 0u};
+        glNamedBufferSubData(bounds.id(), 0, sizeof(initial), initial);
+        const GLuint zero = 0;
+        glClearNamedBufferData(nodeMass.id(), GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+        boundsShader.use();
+        boundsShader.setUInt("bodyCount", nbody.bodyCount);
+        glDispatchCompute(groups, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        depositShader.use();
+        depositShader.setUInt("grid", n);
+        depositShader.setUInt("bodyCount", nbody.bodyCount);
+        depositShader.setFloat("massScale", massScale);
+        glDispatchCompute(groups, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        loadShader.use();
+        loadShader.setUInt("grid", n);
+        loadShader.setFloat("massScale", massScale);
+        glDispatchCompute((m + 63) / 64, m, m);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        // x where y, z < n, y where z < n, every z line through the spectrum, then back the same way
+        const unsigned int plane = m * m;
+        fftShader.use();
+        fftShader.setUInt("grid", n);
+        fftShader.setUInt("lineLength", m);
+        fftShader.setUInt("bits", static_cast<unsigned int>(std::lround(std::log2(static_cast<double>(m)))));
+        transformLines(1, m, plane, n, n, false, false);
+        transformLines(m, 1, plane, m, n, false, false);
+        transformLines(plane, 1, m, m, m, false, true);
+        transformLines(m, 1, plane, m, n, true, false);
+        transformLines(1, m, plane, n, n, true, false);
+
+        kickShader.use();
+        kickShader.setUInt("grid", n);
+        kickShader.setUInt("bodyCount", nbody.bodyCount);
+        kickShader.setUInt("massiveCount", nbody.massiveCount);
+        kickShader.setBool("shortRange", settings.shortRange);
+        // the cell size is only known on the GPU, the split goes in as cells and the shader scales it there
+        kickShader.setFloat("splitCells", settings.splitCells);
+        kickShader.setFloat("cutoffSplits", settings.cutoffSplits);
+        kickShader.setFloat("G", G);
+        kickShader.setFloat("dt", dt);
+        kickShader.setFloat("epsilonSq", epsilonSq);
+        glDispatchCompute(groups, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    void release()
+    {
+        bounds.release();
+        nodeMass.release();
+        work.release();
+        spectrum.release();
+        size = 0;
+    }
+
+private:
+    Shader boundsShader;
+    Shader depositShader;
+    Shader loadShader;
+    Shader fftShader;
+    Shader kickShader;
+    GlBuffer bounds{GPU_MEMORY_SIMULATION};
+    GlBuffer nodeMass{GPU_MEMORY_SIMULATION};
+    GlBuffer work{GPU_MEMORY_SIMULATION};
+    GlBuffer spectrum{GPU_MEMORY_SIMULATION};
+    unsigned int size = 0;
+    bool spectrumShortRange = false;
+    float spectrumSplit = 0.0f;
+
+    void prepare(unsigned int n, const ParticleMesh& settings)
+    {
+        release();
+        size = n;
+        spectrumShortRange = settings.shortRange;
+        spectrumSplit = settings.splitCells;
+        const size_t m = 2 * n;
+        const std::vector<float> values = ParticleMesh::kernelSpectrum(n, settings.shortRange, settings.splitCells,
+                                                                       static_cast<unsigned int>(workerPool().size()));
+        bounds.create(GL_SHADER_STORAGE_BUFFER, "particle mesh bounds");
+        bounds.storage(6 * sizeof(GLuint), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        nodeMass.create(GL_SHADER_STORAGE_BUFFER, "particle mesh masses");
+        nodeMass.storage(static_cast<size_t>(n) * n * n * sizeof(GLuint), nullptr, 0);
+        work.create(GL_SHADER_STORAGE_BUFFER, "particle mesh transform");
+        work.storage(m * m * m * 2 * sizeof(float), nullptr, 0);
+        spectrum.create(GL_SHADER_STORAGE_BUFFER, "particle mesh spectrum");
+        spectrum.storage(values.size() * sizeof(float), values.data(), 0);
+        glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    void bindBuffers()
+    {
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_BOUNDS, bounds.id());
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_MASS, nodeMass.id());
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_WORK, work.id());
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_SPECTRUM, spectrum.id());
+    }
+
+    // firstCount x secondCount lines, one workgroup each
+    void transformLines(unsigned int stride, unsigned int firstStride, unsigned int secondStride, unsigned int firstCount,
+                        unsigned int secondCount, bool inverse, bool convolve)
+    {
+        fftShader.setUInt("stride", stride);
+        fftShader.setUInt("firstStride", firstStride);
+        fftShader.setUInt("secondStride", secondStride);
+        fftShader.setBool("inverse", inverse);
+        fftShader.setBool("convolve", convolve);
+        glDispatchCompute(firstCount, secondCount, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+};
+
+#endif
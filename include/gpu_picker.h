@@ -0,0 +1,200 @@
+#ifndef GPU_PICKER_H
+#define GPU_PICKER_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <gpu_memory.h>
+
+#include <algorithm>
+#include <cstdint>
+
+// Picking by what was drawn instead of a ray test against the bodies. The lit passes write a 32-bit id per pixel
+// (shaders.2/picking.glsl) to an R32UI attachment of the framebuffer they draw into, multisampled with it if need
+// be, and a click reads a REGION x REGION square around the cursor back through a pixel buffer. The read is
+// queued after the frame's draws and collected with a fence once the GPU got to it, a frame or two later, so it
+// never waits on the pipeline; the nearest non-zero id in the square wins, so a rock a pixel wide can be hit.
+// Every draw into the framebuffer while the ids are attached must write them (0 when not pickable): what an
+// attachment gets from a fragment shader without that output is undefined.
+class GpuPicker
+{
+public:
+    static const uint32_t PICK_BODY = 0x40000000u;      // low bits a body's slot in the body store
+    static const uint32_t PICK_RECORD = 0x80000000u;    // low bits an instance record of the drawn stream
+    static const uint32_t PICK_INDEX = 0x3FFFFFFFu;
+    static const int REGION = 5;                        // odd, centred on the click
+
+    GpuPicker() = default;
+
+    ~GpuPicker()
+    {
+        release();
+    }
+
+    GpuPicker(const GpuPicker&) = delete;
+    GpuPicker& operator=(const GpuPicker&) = delete;
+
+    bool pending() const { return fence != nullptr; }
+    // frames the last read took to arrive
+    unsigned int latency() const { return lastLatency; }
+
+    // the ids as colour attachment `attachment` of framebuffer, a width x height one with samples samples, drawn
+    // into from now on and cleared. Call it every frame after the framebuffer's own clear, which leaves integer
+    // attachments undefined.
+    void attach(unsigned int framebuffer, unsigned int attachment, int width, int height, int samples)
+    {
+        prepare(std::max(width, 1), std::max(height, 1), std::max(samples, 1));
+        if (framebuffer != attachedFbo || attachment != attachedIndex)
+            detach();
+        glNamedFramebufferRenderbuffer(framebuffer, GL_COLOR_ATTACHMENT0 + attachment, GL_RENDERBUFFER, ids);
+        glNamedFramebufferDrawBuffers(framebuffer, static_cast<GLsizei>(attachment + 1), DRAW_BUFFERS);
+        const GLuint zero[4] = {0, 0, 0, 0};
+        glClearNamedFramebufferuiv(framebuffer, GL_COLOR, static_cast<GLint>(attachment), zero);
+        attachedFbo = framebuffer;
+        attachedIndex = attachment;
+    }
+
+    // takes the ids off the framebuffer they were attached to, which draws into the attachments before them alone
+    void detach()
+    {
+        if (attachedFbo != 0 && glIsFramebuffer(attachedFbo))
+        {
+            glNamedFramebufferRenderbuffer(attachedFbo, GL_COLOR_ATTACHMENT0 + attachedIndex, GL_RENDERBUFFER, 0);
+            glNamedFramebufferDrawBuffers(attachedFbo, static_cast<GLsizei>(std::max(attachedIndex, 1u)), DRAW_BUFFERS);
+        }
+        attachedFbo = 0;
+    }
+
+    // queues the read around (x, y), pixels of the attached framebuffer from its lower left, once this frame's
+    // draws are done. False while an earlier read is still on its way or nothing is attached.
+    bool request(int x, int y)
+    {
+        if (pending() || attachedFbo == 0)
+            return false;
+        GL_DEBUG_GROUP("pick readback");
+        const int half = REGION / 2;
+        const int x0 = std::clamp(x - half, 0, targetWidth - 1), y0 = std::clamp(y - half, 0, targetHeight - 1);
+        const int x1 = std::clamp(x + half + 1, 1, targetWidth), y1 = std::clamp(y + half + 1, 1, targetHeight);
+        readWidth = std::max(x1 - x0, 1);
+        readHeight = std::max(y1 - y0, 1);
+        centerX = x - x0;
+        centerY = y - y0;
+
+        // resolved into a small single-sampled target (one sample per pixel for integers), then into the buffer
+        glNamedFramebufferReadBuffer(attachedFbo, GL_COLOR_ATTACHMENT0 + attachedIndex);
+        glBlitNamedFramebuffer(attachedFbo, resolveFbo, x0, y0, x0 + readWidth, y0 + readHeight, 0, 0, readWidth, readHeight,
+                               GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glNamedFramebufferReadBuffer(attachedFbo, GL_COLOR_ATTACHMENT0);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, resolveFbo);
+        glState().bindBuffer(GL_PIXEL_PACK_BUFFER, pbo.id());
+        glReadPixels(0, 0, readWidth, readHeight, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, attachedFbo);
+        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        framesWaited = 0;
+        return true;
+    }
+
+    // true once the queued read arrived, with the id nearest the click (0 for none); never blocks, call it each frame
+    bool poll(uint32_t& id)
+    {
+        if (!pending())
+            return false;
+        framesWaited++;
+        const GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            return false;
+        glDeleteSync(fence);
+        fence = nullptr;
+        lastLatency = framesWaited;
+
+        uint32_t values[REGION * REGION];
+        glGetNamedBufferSubData(pbo.id(), 0, static_cast<GLsizeiptr>(readWidth * readHeight * sizeof(uint32_t)), values);
+        id = 0;
+        int best = 1 << 30;
+        for (int y = 0; y < readHeight; y++)
+            for (int x = 0; x < readWidth; x++)
+            {
+                const uint32_t value = values[y * readWidth + x];
+                const int distance = (x - centerX) * (x - centerX) + (y - centerY) * (y - centerY);
+                if (value != 0 && distance < best)
+                {
+                    best = distance;
+                    id = value;
+                }
+            }
+        return true;
+    }
+
+    void release()
+    {
+        detach();
+        if (fence) glDeleteSync(fence);
+        fence = nullptr;
+        if (ids != 0) glDeleteRenderbuffers(1, &ids);
+        if (resolveIds != 0) glDeleteRenderbuffers(1, &resolveIds);
+        if (resolveFbo != 0) glDeleteFramebuffers(1, &resolveFbo);
+        ids = resolveIds = resolveFbo = 0;
+        pbo.release();
+        idsMemory.reset();
+        targetWidth = targetHeight = targetSamples = 0;
+    }
+
+private:
+    static constexpr GLenum DRAW_BUFFERS[3] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
+
+    unsigned int ids = 0;
+    unsigned int resolveIds = 0;
+    unsigned int resolveFbo = 0;
+    GlBuffer pbo{GPU_MEMORY_RENDER_TARGETS};
+    GpuAllocation idsMemory{GPU_MEMORY_RENDER_TARGETS};
+    unsigned int attachedFbo = 0;
+    unsigned int attachedIndex = 0;
+    int targetWidth = 0;
+    int targetHeight = 0;
+    int targetSamples = 0;
+    GLsync fence = nullptr;
+    int readWidth = 0;
+    int readHeight = 0;
+    int centerX = 0;
+    int centerY = 0;
+    unsigned int framesWaited = 0;
+    unsigned int lastLatency = 0;
+
+    // (re)allocates the ids when the framebuffer changed size or sample count; by name, so whatever framebuffer is
+    // bound stays bound
+    void prepare(int w, int h, int samples)
+    {
+        if (resolveFbo == 0)
+        {
+            glCreateRenderbuffers(1, &resolveIds);
+            labelObject(GL_RENDERBUFFER, resolveIds, "pick readback");
+            glNamedRenderbufferStorage(resolveIds, GL_R32UI, REGION, REGION);
+            glCreateFramebuffers(1, &resolveFbo);
+            labelObject(GL_FRAMEBUFFER, resolveFbo, "pick readback");
+            glNamedFramebufferRenderbuffer(resolveFbo, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, resolveIds);
+            pbo.create(GL_PIXEL_PACK_BUFFER, "pick readback");
+            pbo.storage(REGION * REGION * sizeof(uint32_t), nullptr, GL_CLIENT_STORAGE_BIT);
+            glState().bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+        if (ids != 0 && w == targetWidth && h == targetHeight && samples == targetSamples)
+            return;
+        if (ids != 0)
+        {
+            detach();
+            glDeleteRenderbuffers(1, &ids);
+        }
+        glCreateRenderbuffers(1, &ids);
+        labelObject(GL_RENDERBUFFER, ids, "pick ids");
+        if (samples > 1)
+            glNamedRenderbufferStorageMultisample(ids, samples, GL_R32UI, w, h);
+        else
+            glNamedRenderbufferStorage(ids, GL_R32UI, w, h);
+        idsMemory.set(static_cast<size_t>(w) * h * 4 * samples);
+        targetWidth = w;
+        targetHeight = h;
+        targetSamples = samples;
+    }
+};
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef GPU_RADIX_SORT_H
+#define GPU_RADIX_SORT_H
+
+#include <glad/glad.h>
+
+#include <shader.h>
+#include <gpu_memory.h>
+#include <gl_state_cache.h>
+#include <gl_debug.h>
+
+#include <algorithm>
+#include <cstdint>
+
+// Stable key/value sort of GPU buffers, an LSD radix sort in compute with nothing read back. Each 4-bit digit is
+// three passes over 256-element tiles (shaders.2/radix.*.cs): a histogram of the digit per tile, one exclusive scan
+// of all of them digit-major, and a scatter of every element to its tile's start for the digit plus its rank among
+// the same digit in the tile. Keys are 32-bit uints or 64-bit ones as two uints, the low word first, and only their
+// low keyBits take part (rounded up to a whole byte); values are one uint each, typically the index of what is
+// being ordered. The passes ping-pong between the caller's buffers and the sort's own, an even number of them, so
+// the result ends up in the caller's. The element count can come from a GPU buffer, for lists a compute pass
+// filled, with the dispatches sized for the capacity and the tiles past the count doing nothing.
+class GpuRadixSort
+{
+public:
+    static const unsigned int DIGIT_BITS = 4;
+    static const unsigned int RADIX = 1u << DIGIT_BITS;
+    static const unsigned int TILE = 256;
+
+    GpuRadixSort(const char* histogramPath, const char* scanPath, const char* scatterPath)
+        : histogramShader(histogramPath), scanShader(scanPath), scatterShader(scatterPath) {}
+    GpuRadixSort(const GpuRadixSort&) = delete;
+    GpuRadixSort& operator=(const GpuRadixSort&) = delete;
+
+    ~GpuRadixSort()
+    {
+        release();
+    }
+
+    // sorts count elements of keys (one uint each up to 32 keyBits, two up to 64) with their values
+    void sort(GLuint keys, GLuint values, unsigned int count, unsigned int keyBits = 32)
+    {
+        run(keys, values, 0, count, keyBits);
+    }
+
+    // the same for as many elements as the uint at the start of countBuffer holds, at most capacity, once the
+    // writes to it are visible to shader storage reads
+    void sortIndirect(GLuint keys, GLuint values, GLuint countBuffer, unsigned int capacity, unsigned int keyBits = 32)
+    {
+        run(keys, values, countBuffer, capacity, keyBits);
+    }
+
+    size_t gpuBytes() const { return keyScratch.bytes() + valueScratch.bytes() + histograms.bytes(); }
+
+    void release()
+    {
+        keyScratch.release();
+        valueScratch.release();
+        histograms.release();
+        capacity = 0;
+        words = 0;
+    }
+
+private:
+    enum Binding {
+        BINDING_KEYS_IN = 38,
+        BINDING_VALUES_IN = 39,
+        BINDING_KEYS_OUT = 40,
+        BINDING_VALUES_OUT = 41,
+        BINDING_HISTOGRAMS = 42,
+        BINDING_COUNT = 43
+    };
+
+    Shader histogramShader;
+    Shader scanShader;
+    Shader scatterShader;
+    GlBuffer keyScratch{GPU_MEMORY_SIMULATION};
+    GlBuffer valueScratch{GPU_MEMORY_SIMULATION};
+    GlBuffer histograms{GPU_MEMORY_SIMULATION};
+    unsigned int capacity = 0;      // elements the scratch holds
+    unsigned int words = 0;         // key words per element the scratch was allocated for
+
+    void run(GLuint keys, GLuint values, GLuint countBuffer, unsigned int count, unsigned int keyBits)
+    {
+        if (count < 2 || keys == 0 || values == 0)
+            return;
+        GL_DEBUG_GROUP("radix sort");
+        const unsigned int bits = (std::clamp(keyBits, 1u, 64u) + 7) / 8 * 8;
+        const unsigned int keyWords = bits > 32 ? 2 : 1;
+        reserve(count, keyWords);
+        const unsigned int tiles = (count + TILE - 1) / TILE;
+        const bool countOnGpu = countBuffer != 0;
+        if (countOnGpu)
+            glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_COUNT, countBuffer);
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_HISTOGRAMS, histograms.id());
+        const GLuint keyBuffers[2] = {keys, keyScratch.id()};
+        const GLuint valueBuffers[2] = {values, valueScratch.id()};
+        for (Shader* shader : {&histogramShader, &scanShader, &scatterShader})
+        {
+            shader->use();
+            shader->setUInt("count", count);
+            shader->setBool("countOnGpu", countOnGpu);
+            shader->setUInt("keyWords", keyWords);
+        }
+        // a whole number of bytes is an even number of digits, the last pass writes the caller's buffers
+        for (unsigned int pass = 0; pass < bits / DIGIT_BITS; pass++)
+        {
+            const unsigned int from = pass & 1u, to = from ^ 1u;
+            glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_KEYS_IN, keyBuffers[from]);
+            glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_VALUES_IN, valueBuffers[from]);
+            glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_KEYS_OUT, keyBuffers[to]);
+            glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_VALUES_OUT, valueBuffers[to]);
+
+            histogramShader.use();
+            histogramShader.setUInt("shift", pass * DIGIT_BITS);
+            glDispatchCompute(tiles, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+            scanShader.use();
+            scanShader.setUInt("histogramCount", tiles * RADIX);
+            glDispatchCompute(1, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+            scatterShader.use();
+            scatterShader.setUInt("shift", pass * DIGIT_BITS);
+            glDispatchCompute(tiles, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+    }
+
+    // grows the scratch geometrically, for count elements of keyWords words and a histogram per tile
+    void reserve(unsigned int count, unsigned int keyWords)
+    {
+        if (count <= capacity && keyWords <= words && keyScratch.valid())
+            return;
+        capacity = std::max(count, 2 * capacity);
+        words = std::max(keyWords, words);
+        const size_t tiles = (static_cast<size_t>(capacity) + TILE - 1) / TILE;
+        keyScratch.release();
+        valueScratch.release();
+        histograms.release();
+        keyScratch.create(GL_SHADER_STORAGE_BUFFER, "radix sort keys");
+        keyScratch.storage(static_cast<size_t>(capacity) * words * sizeof(uint32_t), nullptr, 0);
+        valueScratch.create(GL_SHADER_STORAGE_BUFFER, "radix sort values");
+        valueScratch.storage(static_cast<size_t>(capacity) * sizeof(uint32_t), nullptr, 0);
+        histograms.create(GL_SHADER_STORAGE_BUFFER, "radix sort histograms");
+        histograms.storage(tiles * RADIX * sizeof(uint32_t), nullptr, 0);
+        glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+};
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef GPU_READBACK_H
+#define GPU_READBACK_H
+
+#include <glad/glad.h>
+
+#include <gl_state_cache.h>
+#include <gl_debug.h>
+#include <gpu_memory.h>
+
+#include <functional>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Reads of GPU buffers for the CPU that never wait on the pipeline. request() queues a copy of a buffer range into
+// a persistently mapped readback ring behind the work already issued, endFrame() fences the frame's copies, and
+// poll() hands every range whose fence has signalled to its callback, a frame or two later, pointing straight into
+// the mapped ring. Nothing is delivered out of order and a callback's pointer is only good during the call. The
+// ring is allocated first in, first out; a request that does not fit beside what is in flight, or a frame past
+// FRAMES in flight, is refused and can be asked for again the next frame.
+class GpuReadback
+{
+public:
+    static const unsigned int FRAMES = 4;
+
+    // the range's bytes and the frames they took to arrive
+    typedef std::function<void(const void* data, size_t bytes, unsigned int latency)> Callback;
+
+    GpuReadback() = default;
+    GpuReadback(const GpuReadback&) = delete;
+    GpuReadback& operator=(const GpuReadback&) = delete;
+
+    ~GpuReadback()
+    {
+        release();
+    }
+
+    void create(size_t bytes, const char* label = "readback ring")
+    {
+        release();
+        capacity = bytes;
+        if (bytes == 0)
+            return;
+        const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        storage.create(GL_COPY_WRITE_BUFFER, label);
+        storage.storage(bytes, nullptr, flags | GL_CLIENT_STORAGE_BIT);
+        mapped = static_cast<const uint8_t*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, bytes, flags));
+        glState().bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        for (Frame& frame : frames)
+            frame.requests.reserve(16);
+    }
+
+    bool valid() const { return mapped != nullptr; }
+
+    // copies bytes of buffer at offset once the GPU gets here, done gets them from a later poll(); false when the
+    // ring has no room for them
+    bool request(GLuint buffer, size_t offset, size_t bytes, Callback done)
+    {
+        Frame& frame = frames[current];
+        if (!mapped || buffer == 0 || bytes == 0 || frame.fence)
+            return false;
+        const size_t aligned = (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        size_t start = head, charge = aligned;
+        if (start + aligned > capacity)
+        {
+            // the tail end is skipped and charged to this request, freed with it
+            charge += capacity - start;
+            start = 0;
+        }
+        if (used + charge > capacity)
+        {
+            refused++;
+            return false;
+        }
+        GL_DEBUG_GROUP("readback copy");
+        if (frame.requests.empty())
+            glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);   // copies read what shaders wrote
+        glCopyNamedBufferSubData(buffer, storage.id(), static_cast<GLintptr>(offset), static_cast<GLintptr>(start),
+                                 static_cast<GLsizeiptr>(bytes));
+        used += charge;
+        head = start + aligned;
+        Request r;
+        r.offset = start;
+        r.bytes = bytes;
+        r.charge = charge;
+        r.done = std::move(done);
+        frame.requests.push_back(std::move(r));
+        return true;
+    }
+
+    // fences the copies requested since the last call, once a frame
+    void endFrame()
+    {
+        Frame& frame = frames[current];
+        if (frame.requests.empty() || frame.fence)
+            return;
+        frame.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        frame.framesWaited = 0;
+        // with every slot in flight the next frame's requests are refused until the oldest arrives
+        current = (current + 1) % FRAMES;
+    }
+
+    // delivers, oldest first, every fenced frame the GPU has finished; never blocks
+    void poll()
+    {
+        for (Frame& frame : frames)
+            if (frame.fence)
+                frame.framesWaited++;
+        // the slot requests go to next is the oldest when it is still in flight
+        for (unsigned int k = 0; k < FRAMES; k++)
+        {
+            Frame& frame = frames[(current + k) % FRAMES];
+            if (!frame.fence)
+                continue;
+            const GLenum status = glClientWaitSync(frame.fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                break;
+            glDeleteSync(frame.fence);
+            frame.fence = nullptr;
+            lastLatency = frame.framesWaited;
+            for (Request& r : frame.requests)
+            {
+                r.done(mapped + r.offset, r.bytes, frame.framesWaited);
+                used -= r.charge;
+            }
+            frame.requests.clear();
+        }
+        if (used == 0)
+            head = 0;
+    }
+
+    unsigned int latency() const { return lastLatency; }
+    size_t bytesInFlight() const { return used; }
+    unsigned long refusedCount() const { return refused; }
+
+    // drops everything in flight without delivering it
+    void release()
+    {
+        for (Frame& frame : frames)
+        {
+            if (frame.fence) glDeleteSync(frame.fence);
+            frame.fence = nullptr;
+            frame.requests.clear();
+        }
+        if (mapped)
+        {
+            glUnmapNamedBuffer(storage.id());
+            mapped = nullptr;
+        }
+        storage.release();
+        capacity = used = head = 0;
+        current = 0;
+    }
+
+private:
+    static const size_t ALIGNMENT = 16;
+
+    struct Request
+    {
+        size_t offset = 0;
+        size_t bytes = 0;
+        size_t charge = 0;      // ring bytes freed with it, a skipped tail end included
+        Callback done;
+    };
+
+    struct Frame
+    {
+        GLsync fence = nullptr;
+        unsigned int framesWaited = 0;
+        std::vector<Request> requests;
+    };
+
+    GlBuffer storage{GPU_MEMORY_OTHER};
+    const uint8_t* mapped = nullptr;
+    size_t capacity = 0;
+    size_t used = 0;            // ring bytes of the requests not yet delivered
+    size_t head = 0;            // where the next copy goes
+    Frame frames[FRAMES];
+    unsigned int current = 0;   // the frame requests go to
+    unsigned int lastLatency = 0;
+    unsigned long refused = 0;
+};
+
+#endif
@@ -0,0 +1,308 @@
+#ifndef GPU_SPH_H
+#define GPU_SPH_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <shader.h>
+#include <gpu_memory.h>
+#include <gpu_radix_sort.h>
+#include <gl_state_cache.h>
+#include <gl_debug.h>
+
+#include <string>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// A gas disk of smoothed particles around the sun, stepped entirely in compute (shaders.2/sph.*.cs) next to
+// whichever N-body backend moves the bodies. The neighbours come from a hashed grid of cells one kernel support
+// (2h) on a side, rebuilt every substep: each particle's cell is hashed into a table of a power of two entries,
+// the hashes are sorted with the particles' indices as values by the radix sort (gpu_radix_sort.h), and a pass
+// over the sorted list gathers the particles into that order and writes every table entry's range of it. The
+// density and force passes then walk the 27 cells around each particle through those ranges, over contiguous
+// memory, dropping the particles another cell hashed into the same entry.
+//
+// The gas is locally isothermal, the sound speed aspectRatio times the Keplerian speed at the particle's distance
+// from the sun, so the disk keeps the thickness it was spawned with; pressure forces are the symmetric SPH form
+// with Monaghan's artificial viscosity on approaching pairs, on the M4 cubic spline kernel of a fixed smoothing
+// length. Gravity couples the gas to the massive bodies (the sun and planets) both ways: every particle is pulled
+// by them, and with sourceVelocities given (the GPU compute backend's buffer) they are kicked by the whole disk in
+// return, a workgroup per body. Where the massive bodies live on the CPU or in the hybrid backend's double copy
+// the gas follows them but does not pull, their velocities being out of reach. The asteroids and the gas do not
+// see each other, and the gas has no self-gravity, a disk of a percent of the sun's mass being far from
+// Toomre-unstable. Particles that fall within accretionRadius of the sun are taken out: massless, still and
+// unlit, left in place so no buffer is compacted.
+//
+// Each step's dt is split into as many substeps as the Courant condition at the inner edge asks for, at most
+// MAX_SUBSTEPS. The positions and luminosities (density over the spawn's mean, for PointCloud::draw) are in
+// buffers laid out like GpuNBody's, vec4 position and mass and a float.
+class GpuSph
+{
+public:
+    static const unsigned int BINDING_POSITION_MASS = 57;
+    static const unsigned int BINDING_VELOCITY = 58;
+    static const unsigned int BINDING_LUMINOSITY = 59;
+    static const unsigned int BINDING_KEYS = 60;
+    static const unsigned int BINDING_ORDER = 61;
+    static const unsigned int BINDING_SORTED = 62;
+    static const unsigned int BINDING_STATE = 63;
+    static const unsigned int BINDING_CELLS = 64;
+    static const unsigned int BINDING_SOURCES = 65;
+    static const unsigned int BINDING_SOURCE_VELOCITY = 66;
+    static const unsigned int MAX_SUBSTEPS = 16;
+    static const unsigned int MAX_SOURCES = 256;    // massive bodies uploaded from the CPU
+
+    struct Params
+    {
+        unsigned int count = 200000;
+        unsigned int seed = 1;
+        float innerRadius = 60.0f;
+        float outerRadius = 220.0f;
+        float aspectRatio = 0.05f;      // scale height over radius
+        float diskMass = 200.0f;        // a percent of the default sun
+    };
+
+    float alpha = 1.0f;                 // linear artificial viscosity
+    float beta = 2.0f;                  // quadratic, for shocks
+    float courant = 0.3f;
+    float accretionRadius = 10.0f;
+    unsigned int substepsLastStep = 0;
+
+    explicit GpuSph(const std::string& shaderDirectory, GpuRadixSort& sorter)
+        : spawnShader((shaderDirectory + "sph.spawn.cs").c_str()), gridShader((shaderDirectory + "sph.grid.cs").c_str()),
+          densityShader((shaderDirectory + "sph.density.cs").c_str()), forceShader((shaderDirectory + "sph.force.cs").c_str()),
+          coupleShader((shaderDirectory + "sph.couple.cs").c_str()), radix(sorter) {}
+    GpuSph(const GpuSph&) = delete;
+    GpuSph& operator=(const GpuSph&) = delete;
+
+    ~GpuSph()
+    {
+        release();
+    }
+
+    unsigned int particleCount() const { return count; }
+    float smoothingLength() const { return h; }
+    // vec4 position and mass per particle, and a float luminosity
+    GLuint positionBuffer() const { return positionMass.id(); }
+    GLuint luminosityBuffer() const { return luminosity.id(); }
+
+    size_t gpuBytes() const
+    {
+        return positionMass.bytes() + velocity.bytes() + luminosity.bytes() + keys.bytes() + order.bytes() + sorted.bytes()
+               + state.bytes() + cells.bytes() + cpuSources.bytes();
+    }
+
+    // (re)creates the buffers and spawns the disk on the GPU around a sun at center moving at centerVelocity, mu
+    // its G M: a surface density falling as 1/r between the radii, a Gaussian of the scale height across the plane
+    // and circular orbits slowed by the disk's pressure support
+    void spawn(const Params& params, const glm::vec3& center, const glm::vec3& centerVelocity, float mu)
+    {
+        GL_DEBUG_GROUP("sph spawn");
+        if (params.count != count)
+        {
+            release();
+            count = params.count;
+            if (count == 0)
+                return;
+            allocate();
+        }
+        if (count == 0)
+            return;
+        inner = std::max(params.innerRadius, 1e-3f);
+        const float outer = std::max(params.outerRadius, inner);
+        aspect = params.aspectRatio;
+        // the disk's volume within a scale height either side, and the spacing its particles have in it
+        const float meanHeight = aspect * 0.5f * (inner + outer);
+        const float volume = 3.14159265f * (outer * outer - inner * inner) * 2.0f * std::max(meanHeight, 1e-3f);
+        h = 1.2f * std::cbrt(volume / static_cast<float>(count));
+        referenceDensity = std::max(params.diskMass, 1e-20f) / volume;
+        bindBuffers();
+        spawnShader.use();
+        spawnShader.setUInt("gasCount", count);
+        spawnShader.setUInt("seed", params.seed * 2654435761u);
+        spawnShader.setFloat("innerRadius", inner);
+        spawnShader.setFloat("outerRadius", outer);
+        spawnShader.setFloat("aspectRatio", aspect);
+        spawnShader.setFloat("particleMass", params.diskMass / static_cast<float>(count));
+        spawnShader.setFloat("mu", mu);
+        spawnShader.setVec3("center", center);
+        spawnShader.setVec3("centerVelocity", centerVelocity);
+        glDispatchCompute((count + 255) / 256, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    // the massive bodies as vec4 position and mass into a buffer of the gas's own, for backends that keep them on
+    // the CPU; the buffer to pass step() as sources
+    GLuint uploadSources(const std::vector<glm::vec4>& bodies)
+    {
+        if (!cpuSources.valid())
+        {
+            cpuSources.create(GL_SHADER_STORAGE_BUFFER, "sph sources");
+            cpuSources.storage(MAX_SOURCES * sizeof(glm::vec4), nullptr, GL_DYNAMIC_STORAGE_BIT);
+            glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        }
+        const size_t n = std::min<size_t>(bodies.size(), MAX_SOURCES);
+        if (n > 0)
+            glNamedBufferSubData(cpuSources.id(), 0, static_cast<GLsizeiptr>(n * sizeof(glm::vec4)), bodies.data());
+        return cpuSources.id();
+    }
+
+    // dt of sim time against sourceCount massive bodies, vec4 position and mass in sources with the sun first; mu
+    // is the sun's G M for the Courant limit. With sourceVelocities the disk's pull kicks the bodies' velocities
+    // there (w 0 for the static ones), the kick then taken into their next drift.
+    void step(float dt, float G, float epsilonSq, GLuint sources, GLuint sourceVelocities, unsigned int sourceCount, float mu)
+    {
+        substepsLastStep = 0;
+        if (count == 0 || sources == 0 || sourceCount == 0 || dt <= 0.0f)
+            return;
+        GL_DEBUG_GROUP("sph step");
+        // the fastest signal is at the inner edge, the sound speed and the viscosity's share of it
+        const float innerSound = aspect * std::sqrt(std::max(mu, 0.0f) / inner);
+        const float limit = courant * h / std::max(innerSound * (1.0f + 1.2f * alpha), 1e-6f);
+        const unsigned int substeps = std::clamp(static_cast<unsigned int>(std::ceil(dt / limit)), 1u, MAX_SUBSTEPS);
+        const float subDt = dt / static_cast<float>(substeps);
+        const unsigned int groups = (count + 255) / 256;
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_SOURCES, sources);
+        if (sourceVelocities != 0)
+            glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_SOURCE_VELOCITY, sourceVelocities);
+        for (Shader* shader : {&gridShader, &densityShader, &forceShader, &coupleShader})
+        {
+            shader->use();
+            shader->setUInt("gasCount", count);
+            shader->setUInt("tableMask", tableSize - 1);
+            shader->setFloat("smoothingLength", h);
+            shader->setUInt("sourceCount", sourceCount);
+            shader->setFloat("G", G);
+            shader->setFloat("epsilonSq", epsilonSq);
+            shader->setFloat("dt", subDt);
+        }
+        densityShader.use();
+        densityShader.setFloat("aspectRatio", aspect);
+        densityShader.setFloat("referenceDensity", referenceDensity);
+        forceShader.use();
+        forceShader.setFloat("alpha", alpha);
+        forceShader.setFloat("beta", beta);
+        forceShader.setFloat("accretionRadius", accretionRadius);
+
+        for (unsigned int s = 0; s < substeps; s++)
+        {
+            bindBuffers();
+            // the cells' hashes with the identity order, sorted, then the particles gathered and the ranges found
+            const GLuint zero = 0;
+            glClearNamedBufferData(cells.id(), GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+            gridShader.use();
+            gridShader.setInt("stage", 0);
+            glDispatchCompute(groups, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+            radix.sort(keys.id(), order.id(), count, tableBits);
+            bindBuffers();
+            gridShader.use();
+            gridShader.setInt("stage", 1);
+            glDispatchCompute(groups, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+            densityShader.use();
+            glDispatchCompute(groups, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+            // the kick of gas and bodies at the same positions, then the gas's drift
+            forceShader.use();
+            forceShader.setInt("stage", 0);
+            glDispatchCompute(groups, 1, 1);
+            if (sourceVelocities != 0)
+            {
+                coupleShader.use();
+                glDispatchCompute(sourceCount, 1, 1);
+            }
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+            forceShader.use();
+            forceShader.setInt("stage", 1);
+            glDispatchCompute(groups, 1, 1);
+            // positions and luminosities are drawn by the point cloud's vertex shader
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+        }
+        substepsLastStep = substeps;
+    }
+
+    void release()
+    {
+        positionMass.release();
+        velocity.release();
+        luminosity.release();
+        keys.release();
+        order.release();
+        sorted.release();
+        state.release();
+        cells.release();
+        cpuSources.release();
+        count = 0;
+        tableSize = 0;
+        tableBits = 0;
+    }
+
+private:
+    Shader spawnShader;
+    Shader gridShader;
+    Shader densityShader;
+    Shader forceShader;
+    Shader coupleShader;
+    GpuRadixSort& radix;
+    GlBuffer positionMass{GPU_MEMORY_SIMULATION};
+    GlBuffer velocity{GPU_MEMORY_SIMULATION};
+    GlBuffer luminosity{GPU_MEMORY_SIMULATION};
+    GlBuffer keys{GPU_MEMORY_SIMULATION};
+    GlBuffer order{GPU_MEMORY_SIMULATION};
+    GlBuffer sorted{GPU_MEMORY_SIMULATION};     // position and mass, velocity, in grid order
+    GlBuffer state{GPU_MEMORY_SIMULATION};      // density, pressure over density squared, sound speed, in grid order
+    GlBuffer cells{GPU_MEMORY_SIMULATION};      // the sorted range of each table entry
+    GlBuffer cpuSources{GPU_MEMORY_SIMULATION};
+    unsigned int count = 0;
+    unsigned int tableSize = 0;
+    unsigned int tableBits = 0;
+    float h = 1.0f;
+    float inner = 1.0f;
+    float aspect = 0.05f;
+    float referenceDensity = 1.0f;
+
+    // a table of twice as many entries as particles keeps the shared entries to a few percent of the cells
+    void allocate()
+    {
+        tableBits = 1;
+        while ((1u << tableBits) < 2 * count && tableBits < 30)
+            tableBits++;
+        tableSize = 1u << tableBits;
+        const size_t n = count;
+        positionMass.create(GL_SHADER_STORAGE_BUFFER, "sph positions");
+        positionMass.storage(n * sizeof(glm::vec4), nullptr, 0);
+        velocity.create(GL_SHADER_STORAGE_BUFFER, "sph velocities");
+        velocity.storage(n * sizeof(glm::vec4), nullptr, 0);
+        luminosity.create(GL_SHADER_STORAGE_BUFFER, "sph luminosities");
+        luminosity.storage(n * sizeof(float), nullptr, 0);
+        keys.create(GL_SHADER_STORAGE_BUFFER, "sph cell hashes");
+        keys.storage(n * sizeof(GLuint), nullptr, 0);
+        order.create(GL_SHADER_STORAGE_BUFFER, "sph cell order");
+        order.storage(n * sizeof(GLuint), nullptr, 0);
+        sorted.create(GL_SHADER_STORAGE_BUFFER, "sph sorted particles");
+        sorted.storage(n * 2 * sizeof(glm::vec4), nullptr, 0);
+        state.create(GL_SHADER_STORAGE_BUFFER, "sph particle state");
+        state.storage(n * sizeof(glm::vec4), nullptr, 0);
+        cells.create(GL_SHADER_STORAGE_BUFFER, "sph cells");
+        cells.storage(static_cast<size_t>(tableSize) * 2 * sizeof(GLuint), nullptr, 0);
+        glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    void bindBuffers()
+    {
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_POSITION_MASS, positionMass.id());
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_VELOCITY, velocity.id());
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_LUMINOSITY, luminosity.id());
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_KEYS, keys.id());
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_ORDER, order.id());
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_SORTED, sorted.id());
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_STATE, state.id());
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_CELLS, cells.id());
+    }
+};
+
+#endif
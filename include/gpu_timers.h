@@ -0,0 +1,299 @@
+#ifndef GPU_TIMERS_H
+#define GPU_TIMERS_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdint>
+
+// the last SAMPLES values of something measured once a frame, oldest first from next, for ImGui::PlotHistogram
+struct TimeHistory
+{
+    static const unsigned int SAMPLES = 120;
+
+    float samples[SAMPLES] = {};
+    unsigned int next = 0;
+    unsigned int filled = 0;
+
+    void push(float value)
+    {
+        samples[next] = value;
+        next = (next + 1) % SAMPLES;
+        filled = std::min(filled + 1, SAMPLES);
+    }
+
+    float latest() const { return filled > 0 ? samples[(next + SAMPLES - 1) % SAMPLES] : 0.0f; }
+
+    float average() const
+    {
+        float sum = 0.0f;
+        for (unsigned int i = 0; i < filled; i++)
+            sum += samples[i];
+        return filled > 0 ? sum / filled : 0.0f;
+    }
+
+    float peak() const
+    {
+        float most = 0.0f;
+        for (unsigned int i = 0; i < filled; i++)
+            most = std::max(most, samples[i]);
+        return most;
+    }
+};
+
+// GPU time per named scope from GL_TIME_ELAPSED queries, the frame's span from a pair of GL_TIMESTAMPs and the
+// primitives it generated. The queries of a frame are read LATENCY frames later and only once their results are
+// there, so reading never waits for the GPU; a frame the GPU is still that far behind on is dropped from the
+// histories rather than waited for. Elapsed-time queries do not nest: begin() ends the scope that is open, so
+// scopes are the consecutive pieces of a frame. A scope can be entered more than once a frame, its pieces add up.
+//
+// With statistics on, each piece also counts what the pipeline did for it with the pipeline statistics queries
+// (GL_ARB_pipeline_statistics_query, core in 4.6): vertex shader invocations, primitives submitted, primitives in
+// and out of clipping and fragment shader invocations, read back and kept per scope the same way as the times.
+class GpuTimers
+{
+public:
+    static const unsigned int MAX_SCOPES = 16;
+    static const unsigned int MAX_PIECES = 64;      // begin() calls per frame, later ones go untimed
+    static const unsigned int LATENCY = 4;          // frames in flight before a frame's queries are read
+
+    enum Statistic
+    {
+        VERTEX_INVOCATIONS = 0,
+        PRIMITIVES_SUBMITTED,
+        CLIPPING_INPUT,
+        CLIPPING_OUTPUT,
+        FRAGMENT_INVOCATIONS,
+        STATISTICS
+    };
+
+    bool statistics = false;        // takes effect from the next beginFrame()
+
+    static const char* statisticName(unsigned int statistic)
+    {
+        static const char* names[STATISTICS] = {"vertices", "primitives", "clip in", "clip out", "fragments"};
+        return names[std::min(statistic, STATISTICS - 1u)];
+    }
+
+    ~GpuTimers()
+    {
+        release();
+    }
+
+    // a scope to time, registered once up front. The name must outlive the timers.
+    unsigned int scope(const char* name)
+    {
+        if (registered == MAX_SCOPES)
+            return MAX_SCOPES - 1;
+        names[registered] = name;
+        return registered++;
+    }
+
+    unsigned int scopeCount() const { return registered; }
+    const char* name(unsigned int scope) const { return names[scope]; }
+    const TimeHistory& history(unsigned int scope) const { return scopeHistory[scope]; }
+    const TimeHistory& frameHistory() const { return gpuFrame; }
+    const TimeHistory& primitiveHistory() const { return primitives; }
+    // a scope's count per frame of a statistic, over the frames that had statistics on
+    const TimeHistory& statisticHistory(unsigned int scope, unsigned int statistic) const { return scopeStatistics[scope][statistic]; }
+    unsigned int droppedFrames() const { return dropped; }
+    // frames whose results reached the histories, a change means each history's latest() is a new frame's
+    unsigned long long collectedFrames() const { return collected; }
+
+    // reads the slot about to be reused, LATENCY frames old, and opens the new frame's span
+    void beginFrame()
+    {
+        prepare();
+        slot = (slot + 1) % LATENCY;
+        collect(frames[slot]);
+        Frame& frame = frames[slot];
+        frame.pieceCount = 0;
+        frame.statistics = statistics;
+        if (statistics)
+            prepareStatistics();
+        glQueryCounter(frame.start, GL_TIMESTAMP);
+        glBeginQuery(GL_PRIMITIVES_GENERATED, frame.primitives);
+        frame.issued = true;
+    }
+
+    // everything submitted until the next begin() or end() counts toward the scope
+    void begin(unsigned int scope)
+    {
+        end();
+        Frame& frame = frames[slot];
+        if (!frame.issued || frame.pieceCount == MAX_PIECES || scope >= registered)
+            return;
+        Piece& piece = frame.pieces[frame.pieceCount++];
+        piece.scope = scope;
+        glBeginQuery(GL_TIME_ELAPSED, piece.query);
+        if (frame.statistics)
+            for (unsigned int s = 0; s < STATISTICS; s++)
+                glBeginQuery(statisticTarget(s), piece.statisticQueries[s]);
+        open = true;
+    }
+
+    void end()
+    {
+        if (!open)
+            return;
+        glEndQuery(GL_TIME_ELAPSED);
+        if (frames[slot].statistics)
+            for (unsigned int s = 0; s < STATISTICS; s++)
+                glEndQuery(statisticTarget(s));
+        open = false;
+    }
+
+    void endFrame()
+    {
+        end();
+        Frame& frame = frames[slot];
+        if (!frame.issued)
+            return;
+        glEndQuery(GL_PRIMITIVES_GENERATED);
+        glQueryCounter(frame.finish, GL_TIMESTAMP);
+    }
+
+    void release()
+    {
+        for (Frame& frame : frames)
+        {
+            if (frame.start == 0)
+                continue;
+            for (Piece& piece : frame.pieces)
+            {
+                glDeleteQueries(1, &piece.query);
+                if (piece.statisticQueries[0] != 0)
+                    glDeleteQueries(STATISTICS, piece.statisticQueries);
+            }
+            glDeleteQueries(1, &frame.start);
+            glDeleteQueries(1, &frame.finish);
+            glDeleteQueries(1, &frame.primitives);
+            frame = Frame();
+        }
+        open = false;
+    }
+
+private:
+    struct Piece
+    {
+        unsigned int query = 0;
+        unsigned int scope = 0;
+        unsigned int statisticQueries[STATISTICS] = {};
+    };
+
+    struct Frame
+    {
+        Piece pieces[MAX_PIECES];
+        unsigned int pieceCount = 0;
+        unsigned int start = 0;
+        unsigned int finish = 0;
+        unsigned int primitives = 0;
+        bool issued = false;
+        bool statistics = false;
+    };
+
+    const char* names[MAX_SCOPES] = {};
+    unsigned int registered = 0;
+    TimeHistory scopeHistory[MAX_SCOPES];
+    TimeHistory gpuFrame;
+    TimeHistory primitives;
+    TimeHistory scopeStatistics[MAX_SCOPES][STATISTICS];
+    Frame frames[LATENCY];
+    unsigned int slot = 0;
+    unsigned int dropped = 0;
+    unsigned long long collected = 0;
+    bool open = false;
+
+    static bool available(unsigned int query)
+    {
+        GLint done = 0;
+        glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &done);
+        return done != 0;
+    }
+
+    static uint64_t result(unsigned int query)
+    {
+        GLuint64 value = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &value);
+        return value;
+    }
+
+    // the frame's results into the histories, all of them or, when any is not there yet, none
+    void collect(Frame& frame)
+    {
+        if (!frame.issued)
+            return;
+        frame.issued = false;
+        // the end timestamp is the last one the GPU reaches
+        if (!available(frame.finish))
+        {
+            dropped++;
+            return;
+        }
+        for (unsigned int p = 0; p < frame.pieceCount; p++)
+            if (!available(frame.pieces[p].query))
+            {
+                dropped++;
+                return;
+            }
+        float ms[MAX_SCOPES] = {};
+        for (unsigned int p = 0; p < frame.pieceCount; p++)
+            ms[frame.pieces[p].scope] += result(frame.pieces[p].query) * 1e-6f;
+        for (unsigned int s = 0; s < registered; s++)
+            scopeHistory[s].push(ms[s]);
+        gpuFrame.push((result(frame.finish) - result(frame.start)) * 1e-6f);
+        primitives.push(static_cast<float>(result(frame.primitives)));
+        collected++;
+        if (frame.statistics)
+            collectStatistics(frame);
+    }
+
+    static GLenum statisticTarget(unsigned int statistic)
+    {
+        static const GLenum targets[STATISTICS] = {GL_VERTEX_SHADER_INVOCATIONS, GL_PRIMITIVES_SUBMITTED, GL_CLIPPING_INPUT_PRIMITIVES,
+                                                   GL_CLIPPING_OUTPUT_PRIMITIVES, GL_FRAGMENT_SHADER_INVOCATIONS};
+        return targets[statistic];
+    }
+
+    // the counts of a frame whose times were collected, skipped whole when any is not there yet
+    void collectStatistics(const Frame& frame)
+    {
+        for (unsigned int p = 0; p < frame.pieceCount; p++)
+            for (unsigned int s = 0; s < STATISTICS; s++)
+                if (!available(frame.pieces[p].statisticQueries[s]))
+                    return;
+        double counts[MAX_SCOPES][STATISTICS] = {};
+        for (unsigned int p = 0; p < frame.pieceCount; p++)
+            for (unsigned int s = 0; s < STATISTICS; s++)
+                counts[frame.pieces[p].scope][s] += static_cast<double>(result(frame.pieces[p].statisticQueries[s]));
+        for (unsigned int scope = 0; scope < registered; scope++)
+            for (unsigned int s = 0; s < STATISTICS; s++)
+                scopeStatistics[scope][s].push(static_cast<float>(counts[scope][s]));
+    }
+
+    // the statistics' queries, made the first time they are asked for
+    void prepareStatistics()
+    {
+        if (frames[0].pieces[0].statisticQueries[0] != 0)
+            return;
+        for (Frame& frame : frames)
+            for (Piece& piece : frame.pieces)
+                glGenQueries(STATISTICS, piece.statisticQueries);
+    }
+
+    void prepare()
+    {
+        if (frames[0].start != 0)
+            return;
+        for (Frame& frame : frames)
+        {
+            for (Piece& piece : frame.pieces)
+                glGenQueries(1, &piece.query);
+            glGenQueries(1, &frame.start);
+            glGenQueries(1, &frame.finish);
+            glGenQueries(1, &frame.primitives);
+        }
+    }
+};
+
+#endif
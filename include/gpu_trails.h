@@ -0,0 +1,170 @@
+#ifndef GPU_TRAILS_H
+#define GPU_TRAILS_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <shader.h>
+#include <streaming_buffer.h>
+#include <gpu_memory.h>
+#include <gl_state_cache.h>
+#include <gl_debug.h>
+
+#include <algorithm>
+#include <cstdint>
+
+// Motion trails for many bodies, kept on the GPU: one SSBO holds a ring of the last length positions per body,
+// body-major, and a capture pass (shaders.2/trail.capture.cs) writes every body's current position into the ring's
+// head slot. The trails are one instanced draw of line strips without vertex buffers (trail.vs), instance i is body
+// i's ring read back from the head, fading out. With the bodies on the GPU (GpuNBody, GpuBelt) the source is their
+// position buffer, so a capture and a draw are a dispatch and a draw call whatever the count and length. The CPU
+// backend writes its positions into a streamed upload instead, one vec4 per body by body id, so the rings follow
+// the bodies through the asteroid reordering; w 0 marks an id that is gone.
+class GpuTrails
+{
+public:
+    static const unsigned int BINDING_TRAILS = 26;
+    static const unsigned int BINDING_SOURCE = 27;
+
+    GpuTrails(const char* capturePath, const char* vertexPath, const char* fragmentPath)
+        : captureShader(capturePath), drawShader(vertexPath, fragmentPath) {}
+    GpuTrails(const GpuTrails&) = delete;
+    GpuTrails& operator=(const GpuTrails&) = delete;
+
+    ~GpuTrails()
+    {
+        release();
+    }
+
+    Shader& program() { return drawShader; }
+    // empty, bound for draw()
+    unsigned int vertexArray() const { return emptyVao.id(); }
+    unsigned int bodyCount() const { return bodies; }
+    unsigned int length() const { return trailLength; }
+    unsigned int samples() const { return filled; }
+    size_t bytes() const { return static_cast<size_t>(bodies) * trailLength * sizeof(glm::vec4); }
+
+    // rings for count bodies of length samples each, emptied; nothing is reallocated if neither changed
+    void resize(unsigned int count, unsigned int length)
+    {
+        length = std::max(length, 2u);
+        if (count == bodies && length == trailLength && (count == 0 || rings.valid()))
+            return;
+        bodies = count;
+        trailLength = length;
+        clear();
+        rings.release();
+        upload.release();
+        if (count == 0)
+            return;
+        if (emptyVao.id() == 0)
+        {
+            emptyVao.create("trails");
+            glState().bindVertexArray(0);
+        }
+        rings.create(GL_SHADER_STORAGE_BUFFER, "trail rings");
+        rings.storage(bytes(), nullptr, 0);
+        glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    // forgets every trail, the next capture starts them over from where the bodies are
+    void clear()
+    {
+        head = 0;
+        filled = 0;
+    }
+
+    // the next capture's source from the CPU: bodyCount() vec4s to fill, xyz a position and w 1, or w 0 for a body
+    // that is not there. Null before resize().
+    glm::vec4* beginUpload()
+    {
+        if (bodies == 0)
+            return nullptr;
+        if (!upload.valid())
+            upload.create(bodies * sizeof(glm::vec4), "trail upload");
+        return static_cast<glm::vec4*>(upload.beginWrite());
+    }
+
+    // a sample from what beginUpload was given
+    void captureUpload()
+    {
+        if (!upload.valid())
+            return;
+        glState().bindBufferRange(GL_SHADER_STORAGE_BUFFER, BINDING_SOURCE, upload.buffer(), upload.readOffset(),
+                                  bodies * sizeof(glm::vec4));
+        capture(true);
+        upload.fenceRead();
+    }
+
+    // a sample from a buffer of vec4 positions in body order, GpuNBody's or GpuBelt's; the first bodyCount() are read
+    void captureBuffer(unsigned int positionBuffer)
+    {
+        if (positionBuffer == 0)
+            return;
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_SOURCE, positionBuffer);
+        capture(false);
+    }
+
+    // every trail with the draw shader in use and vertexArray() bound, color added onto the target. Depth is
+    // tested but not written, and only the first colour attachment is written.
+    void draw(const glm::vec3& origin, const glm::vec3& color)
+    {
+        if (filled < 2 || !rings.valid())
+            return;
+        drawShader.setUInt("trailLength", trailLength);
+        drawShader.setUInt("head", head);
+        drawShader.setUInt("filled", filled);
+        drawShader.setVec3("origin", origin);
+        drawShader.setVec3("color", color);
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_TRAILS, rings.id());
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        glDepthMask(GL_FALSE);
+        glColorMaski(1, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDrawArraysInstanced(GL_LINE_STRIP, 0, static_cast<GLsizei>(filled), static_cast<GLsizei>(bodies));
+        glColorMaski(1, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthMask(GL_TRUE);
+        glDisable(GL_BLEND);
+    }
+
+    void release()
+    {
+        rings.release();
+        upload.release();
+        emptyVao.release();
+        bodies = 0;
+        clear();
+    }
+
+private:
+    Shader captureShader;
+    Shader drawShader;
+    GlBuffer rings{GPU_MEMORY_SIMULATION};
+    StreamingBuffer upload{GPU_MEMORY_SIMULATION};
+    GlVertexArray emptyVao;
+    unsigned int bodies = 0;
+    unsigned int trailLength = 0;
+    unsigned int head = 0;          // the newest sample's slot
+    unsigned int filled = 0;
+
+    // the source is bound at BINDING_SOURCE
+    void capture(bool validInW)
+    {
+        if (!rings.valid())
+            return;
+        GL_DEBUG_GROUP("trail capture");
+        head = filled == 0 ? 0 : (head + 1) % trailLength;
+        filled = std::min(filled + 1, trailLength);
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_TRAILS, rings.id());
+        captureShader.use();
+        captureShader.setUInt("bodyCount", bodies);
+        captureShader.setUInt("trailLength", trailLength);
+        captureShader.setUInt("head", head);
+        captureShader.setBool("validInW", validInW);
+        glDispatchCompute((bodies + 255) / 256, 1, 1);
+        // read by the next frame's draw
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+};
+
+#endif
@@ -0,0 +1,290 @@
+#ifndef GRAVITY_KERNELS_H
+#define GRAVITY_KERNELS_H
+
+#include <glm.hpp>
+
+#include <force_kernels.h>
+
+#include <vector>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <type_traits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define GRAVITY_KERNELS_X86 1
+#endif
+
+// Explicitly vectorized pairwise gravity. Targets are processed 8 (AVX2) or 16 (AVX-512) at a time against a
+// broadcast source, with rsqrt plus one Newton step replacing the sqrt and divide of the scalar loop.
+// The SIMD variants are compiled with per-function target attributes and picked at runtime, so the
+// executable still runs on machines without them. Each can also sum the potential -m/r per target for energy
+// diagnostics, instantiated separately so the plain force loop pays nothing for it. The scalar loop is the policy
+// kernel (force_kernels.h) of the Newtonian law in float, and the other laws and precisions run its instantiations.
+
+enum GravityKernel {
+    KERNEL_SCALAR = 0,
+    KERNEL_AVX2 = 1,
+    KERNEL_AVX512 = 2
+};
+
+// bodies repacked into separate x/y/z/m arrays
+struct GravitySoA
+{
+    std::vector<float> x, y, z, m;
+    std::vector<float> ax, ay, az;
+    std::vector<float> pot;         // potential without G, only written by kernels run with potential set
+    size_t count = 0;
+
+    // positions are stored relative to origin, the kernels only ever use differences so any nearby point works
+    // and keeps float resolution where the bodies are
+    void load(const glm::dvec3* positions, const float* masses, size_t n, const glm::dvec3& origin = glm::dvec3(0.0))
+    {
+        count = n;
+        x.resize(n); y.resize(n); z.resize(n); m.resize(n);
+        ax.assign(n, 0.0f); ay.assign(n, 0.0f); az.assign(n, 0.0f); pot.assign(n, 0.0f);
+        for (size_t i = 0; i < n; i++)
+        {
+            glm::vec3 p(positions[i] - origin);
+            x[i] = p.x; y[i] = p.y; z[i] = p.z;
+            m[i] = masses[i];
+        }
+    }
+
+    // packs only the listed bodies, entry k holds body indices[k]
+    void gather(const glm::dvec3* positions, const float* masses, const unsigned int* indices, size_t n,
+                const glm::dvec3& origin = glm::dvec3(0.0))
+    {
+        count = n;
+        x.resize(n); y.resize(n); z.resize(n); m.resize(n);
+        ax.assign(n, 0.0f); ay.assign(n, 0.0f); az.assign(n, 0.0f); pot.assign(n, 0.0f);
+        for (size_t k = 0; k < n; k++)
+        {
+            glm::vec3 p(positions[indices[k]] - origin);
+            x[k] = p.x; y[k] = p.y; z[k] = p.z;
+            m[k] = masses[indices[k]];
+        }
+    }
+};
+
+inline bool gravityKernelSupported(GravityKernel kernel)
+{
+#ifdef GRAVITY_KERNELS_X86
+    if (kernel == KERNEL_AVX2) return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    if (kernel == KERNEL_AVX512) return __builtin_cpu_supports("avx512f");
+#endif
+    return kernel == KERNEL_SCALAR;
+}
+
+inline GravityKernel bestGravityKernel()
+{
+    if (gravityKernelSupported(KERNEL_AVX512)) return KERNEL_AVX512;
+    if (gravityKernelSupported(KERNEL_AVX2)) return KERNEL_AVX2;
+    return KERNEL_SCALAR;
+}
+
+// the arrays of src's sources [begin, end) as a force_kernels.h interaction set
+inline SourceRun sourceRun(const GravitySoA& src, size_t begin, size_t end)
+{
+    return SourceRun{src.x.data(), src.y.data(), src.z.data(), src.m.data(), begin, end};
+}
+
+// accumulates into soa.ax/ay/az (without G), and with Potential into soa.pot, the pull on targets [tBegin, tEnd) of
+// sources under law, worked and summed in Precision's types
+template <typename Law, typename Precision, bool Potential, typename Sources>
+inline void policyForceTargets(GravitySoA& soa, size_t tBegin, size_t tEnd, const Sources& sources, const Law& law)
+{
+    typedef typename Precision::Real Real;
+    typedef typename Precision::Accum Accum;
+    for (size_t i = tBegin; i < tEnd; i++)
+    {
+        Accum axi = Accum(0), ayi = Accum(0), azi = Accum(0), poti = Accum(0);
+        sumSources<Law, Precision, Potential>(law, sources, static_cast<Real>(soa.x[i]), static_cast<Real>(soa.y[i]),
+                                              static_cast<Real>(soa.z[i]), axi, ayi, azi, poti);
+        soa.ax[i] += static_cast<float>(axi); soa.ay[i] += static_cast<float>(ayi); soa.az[i] += static_cast<float>(azi);
+        if (Potential) soa.pot[i] += static_cast<float>(poti);
+    }
+}
+
+// accumulates into soa.ax/ay/az (without G) the acceleration of targets [tBegin, tEnd) due to sources [sBegin, sEnd) of src.
+// src is usually soa itself, a separate target set lets a gathered subset of bodies be evaluated against everything.
+// A body acting on itself contributes exactly zero because of the softening clamp, so no i == j test is needed.
+// The potential -m/r into soa.pot does need one, pairs at zero separation are masked out of it.
+template <bool Potential>
+inline void gravityKernelScalarImpl(GravitySoA& soa, size_t tBegin, size_t tEnd, const GravitySoA& src, size_t sBegin, size_t sEnd, float epsilonSq)
+{
+    policyForceTargets<NewtonianLaw<float>, FloatPrecision, Potential>(soa, tBegin, tEnd, sourceRun(src, sBegin, sEnd),
+                                                                        NewtonianLaw<float>(epsilonSq));
+}
+
+inline void gravityKernelScalar(GravitySoA& soa, size_t tBegin, size_t tEnd, const GravitySoA& src, size_t sBegin, size_t sEnd,
+                                float epsilonSq, bool potential = false)
+{
+    if (potential)
+        gravityKernelScalarImpl<true>(soa, tBegin, tEnd, src, sBegin, sEnd, epsilonSq);
+    else
+        gravityKernelScalarImpl<false>(soa, tBegin, tEnd, src, sBegin, sEnd, epsilonSq);
+}
+
+#ifdef GRAVITY_KERNELS_X86
+template <bool Potential>
+__attribute__((target("avx2,fma")))
+inline void gravityKernelAVX2Impl(GravitySoA& soa, size_t tBegin, size_t tEnd, const GravitySoA& src, size_t sBegin, size_t sEnd, float epsilonSq)
+{
+    const __m256 eps = _mm256_set1_ps(epsilonSq);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 threeHalves = _mm256_set1_ps(1.5f);
+    size_t i = tBegin;
+    for (; i + 8 <= tEnd; i += 8)
+    {
+        __m256 xi = _mm256_loadu_ps(&soa.x[i]), yi = _mm256_loadu_ps(&soa.y[i]), zi = _mm256_loadu_ps(&soa.z[i]);
+        __m256 axi = _mm256_setzero_ps(), ayi = _mm256_setzero_ps(), azi = _mm256_setzero_ps(), poti = _mm256_setzero_ps();
+        for (size_t j = sBegin; j < sEnd; j++)
+        {
+            __m256 dx = _mm256_sub_ps(_mm256_set1_ps(src.x[j]), xi);
+            __m256 dy = _mm256_sub_ps(_mm256_set1_ps(src.y[j]), yi);
+            __m256 dz = _mm256_sub_ps(_mm256_set1_ps(src.z[j]), zi);
+            __m256 d2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz)));
+            __m256 r2 = _mm256_max_ps(d2, eps);
+            // 12-bit estimate refined by one Newton-Raphson step: y' = y * (1.5 - 0.5 * r2 * y^2)
+            __m256 y = _mm256_rsqrt_ps(r2);
+            y = _mm256_mul_ps(y, _mm256_fnmadd_ps(_mm256_mul_ps(half, r2), _mm256_mul_ps(y, y), threeHalves));
+            __m256 s = _mm256_mul_ps(_mm256_set1_ps(src.m[j]), _mm256_mul_ps(y, _mm256_mul_ps(y, y)));
+            axi = _mm256_fmadd_ps(dx, s, axi);
+            ayi = _mm256_fmadd_ps(dy, s, ayi);
+            azi = _mm256_fmadd_ps(dz, s, azi);
+            if (Potential)
+            {
+                __m256 selfMask = _mm256_cmp_ps(d2, _mm256_setzero_ps(), _CMP_GT_OQ);
+                poti = _mm256_sub_ps(poti, _mm256_and_ps(selfMask, _mm256_mul_ps(_mm256_set1_ps(src.m[j]), y)));
+            }
+        }
+        _mm256_storeu_ps(&soa.ax[i], _mm256_add_ps(_mm256_loadu_ps(&soa.ax[i]), axi));
+        _mm256_storeu_ps(&soa.ay[i], _mm256_add_ps(_mm256_loadu_ps(&soa.ay[i]), ayi));
+        _mm256_storeu_ps(&soa.az[i], _mm256_add_ps(_mm256_loadu_ps(&soa.az[i]), azi));
+        if (Potential) _mm256_storeu_ps(&soa.pot[i], _mm256_add_ps(_mm256_loadu_ps(&soa.pot[i]), poti));
+    }
+    // fewer than 8 targets left, the scalar loop finishes them without touching neighbouring bodies
+    gravityKernelScalarImpl<Potential>(soa, i, tEnd, src, sBegin, sEnd, epsilonSq);
+}
+
+// GCC 12 reports its own _mm512_undefined_ps() placeholders as maybe-uninitialized
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+template <bool Potential>
+__attribute__((target("avx512f")))
+inline void gravityKernelAVX512Impl(GravitySoA& soa, size_t tBegin, size_t tEnd, const GravitySoA& src, size_t sBegin, size_t sEnd, float epsilonSq)
+{
+    const __m512 eps = _mm512_set1_ps(epsilonSq);
+    const __m512 half = _mm512_set1_ps(0.5f);
+    const __m512 threeHalves = _mm512_set1_ps(1.5f);
+    size_t i = tBegin;
+    for (; i + 16 <= tEnd; i += 16)
+    {
+        __m512 xi = _mm512_loadu_ps(&soa.x[i]), yi = _mm512_loadu_ps(&soa.y[i]), zi = _mm512_loadu_ps(&soa.z[i]);
+        __m512 axi = _mm512_setzero_ps(), ayi = _mm512_setzero_ps(), azi = _mm512_setzero_ps(), poti = _mm512_setzero_ps();
+        for (size_t j = sBegin; j < sEnd; j++)
+        {
+            __m512 dx = _mm512_sub_ps(_mm512_set1_ps(src.x[j]), xi);
+            __m512 dy = _mm512_sub_ps(_mm512_set1_ps(src.y[j]), yi);
+            __m512 dz = _mm512_sub_ps(_mm512_set1_ps(src.z[j]), zi);
+            __m512 d2 = _mm512_fmadd_ps(dx, dx, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dz, dz)));
+            __m512 r2 = _mm512_max_ps(d2, eps);
+            // 14-bit estimate, one Newton-Raphson step brings it to full float precision
+            __m512 y = _mm512_rsqrt14_ps(r2);
+            y = _mm512_mul_ps(y, _mm512_fnmadd_ps(_mm512_mul_ps(half, r2), _mm512_mul_ps(y, y), threeHalves));
+            __m512 s = _mm512_mul_ps(_mm512_set1_ps(src.m[j]), _mm512_mul_ps(y, _mm512_mul_ps(y, y)));
+            axi = _mm512_fmadd_ps(dx, s, axi);
+            ayi = _mm512_fmadd_ps(dy, s, ayi);
+            azi = _mm512_fmadd_ps(dz, s, azi);
+            if (Potential)
+            {
+                __mmask16 selfMask = _mm512_cmp_ps_mask(d2, _mm512_setzero_ps(), _CMP_GT_OQ);
+                poti = _mm512_mask_sub_ps(poti, selfMask, poti, _mm512_mul_ps(_mm512_set1_ps(src.m[j]), y));
+            }
+        }
+        _mm512_storeu_ps(&soa.ax[i], _mm512_add_ps(_mm512_loadu_ps(&soa.ax[i]), axi));
+        _mm512_storeu_ps(&soa.ay[i], _mm512_add_ps(_mm512_loadu_ps(&soa.ay[i]), ayi));
+        _mm512_storeu_ps(&soa.az[i], _mm512_add_ps(_mm512_loadu_ps(&soa.az[i]), azi));
+        if (Potential) _mm512_storeu_ps(&soa.pot[i], _mm512_add_ps(_mm512_loadu_ps(&soa.pot[i]), poti));
+    }
+    gravityKernelAVX2Impl<Potential>(soa, i, tEnd, src, sBegin, sEnd, epsilonSq);
+}
+#pragma GCC diagnostic pop
+
+inline void gravityKernelAVX2(GravitySoA& soa, size_t tBegin, size_t tEnd, const GravitySoA& src, size_t sBegin, size_t sEnd,
+                              float epsilonSq, bool potential = false)
+{
+    if (potential)
+        gravityKernelAVX2Impl<true>(soa, tBegin, tEnd, src, sBegin, sEnd, epsilonSq);
+    else
+        gravityKernelAVX2Impl<false>(soa, tBegin, tEnd, src, sBegin, sEnd, epsilonSq);
+}
+
+inline void gravityKernelAVX512(GravitySoA& soa, size_t tBegin, size_t tEnd, const GravitySoA& src, size_t sBegin, size_t sEnd,
+                                float epsilonSq, bool potential = false)
+{
+    if (potential)
+        gravityKernelAVX512Impl<true>(soa, tBegin, tEnd, src, sBegin, sEnd, epsilonSq);
+    else
+        gravityKernelAVX512Impl<false>(soa, tBegin, tEnd, src, sBegin, sEnd, epsilonSq);
+}
+#endif
+
+// runs the requested kernel, falling back to the scalar loop if the CPU lacks the instruction set
+inline void gravityKernel(GravityKernel kernel, GravitySoA& soa, size_t tBegin, size_t tEnd,
+                          const GravitySoA& src, size_t sBegin, size_t sEnd, float epsilonSq, bool potential = false)
+{
+    if (tBegin >= tEnd || sBegin >= sEnd)
+        return;
+#ifdef GRAVITY_KERNELS_X86
+    if (kernel == KERNEL_AVX512 && gravityKernelSupported(KERNEL_AVX512))
+    {
+        gravityKernelAVX512(soa, tBegin, tEnd, src, sBegin, sEnd, epsilonSq, potential);
+        return;
+    }
+    if (kernel == KERNEL_AVX2 && gravityKernelSupported(KERNEL_AVX2))
+    {
+        gravityKernelAVX2(soa, tBegin, tEnd, src, sBegin, sEnd, epsilonSq, potential);
+        return;
+    }
+#endif
+    gravityKernelScalar(soa, tBegin, tEnd, src, sBegin, sEnd, epsilonSq, potential);
+}
+
+// the SIMD kernels for the Newtonian law in float they implement, the policy kernel of law and precision otherwise
+inline void gravityKernel(GravityKernel kernel, ForceLaw law, ForcePrecision precision, GravitySoA& soa, size_t tBegin,
+                          size_t tEnd, const GravitySoA& src, size_t sBegin, size_t sEnd, float epsilonSq, bool potential = false)
+{
+    if (law == FORCE_NEWTONIAN && precision == PRECISION_FLOAT)
+    {
+        gravityKernel(kernel, soa, tBegin, tEnd, src, sBegin, sEnd, epsilonSq, potential);
+        return;
+    }
+    if (tBegin >= tEnd || sBegin >= sEnd)
+        return;
+    const SourceRun sources = sourceRun(src, sBegin, sEnd);
+    withForcePolicies(law, precision, epsilonSq, [&](const auto& forceLaw, auto precisionPolicy) {
+        typedef typename std::decay<decltype(forceLaw)>::type Law;
+        typedef decltype(precisionPolicy) Precision;
+        if (potential)
+            policyForceTargets<Law, Precision, true>(soa, tBegin, tEnd, sources, forceLaw);
+        else
+            policyForceTargets<Law, Precision, false>(soa, tBegin, tEnd, sources, forceLaw);
+    });
+}
+
+// targets and sources from the same set
+inline void gravityKernel(GravityKernel kernel, GravitySoA& soa, size_t tBegin, size_t tEnd, size_t sBegin, size_t sEnd,
+                          float epsilonSq, bool potential = false)
+{
+    gravityKernel(kernel, soa, tBegin, tEnd, soa, sBegin, sEnd, epsilonSq, potential);
+}
+
+inline void gravityKernelScalar(GravitySoA& soa, size_t tBegin, size_t tEnd, size_t sBegin, size_t sEnd, float epsilonSq)
+{
+    gravityKernelScalar(soa, tBegin, tEnd, soa, sBegin, sEnd, epsilonSq);
+}
+
+#endif
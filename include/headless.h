@@ -0,0 +1,266 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <glad/glad.h>
+
+#include <gpu_memory.h>
+#include <gl_debug.h>
+
+#include <dlfcn.h>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <iostream>
+
+// A GL 4.6 core context without a window or a display server, for rendering on GPU servers: EGL on one of the
+// machine's devices (EGL_EXT_device_enumeration and EGL_EXT_platform_device, so each process of a farm can take
+// its own GPU), or the default display when no device is asked for and there is one. It is surfaceless where the
+// display has EGL_KHR_surfaceless_context and otherwise current on a 1x1 pbuffer, either way everything is drawn
+// into a HeadlessFramebuffer. libEGL is opened at run time like the GL extensions in bindless_textures.h are
+// loaded, so the viewer has no link dependency on it and the types and enums below are EGL 1.5's own.
+class EglContext
+{
+public:
+    EglContext() = default;
+    ~EglContext() { release(); }
+
+    EglContext(const EglContext&) = delete;
+    EglContext& operator=(const EglContext&) = delete;
+
+    // makes a context current on device (an index into the EGL devices, -1 for the default display or else the
+    // first device); false with error() telling why
+    bool create(int device)
+    {
+        release();
+        message.clear();
+        library = dlopen("libEGL.so.1", RTLD_NOW | RTLD_LOCAL);
+        if (!library)
+            library = dlopen("libEGL.so", RTLD_NOW | RTLD_LOCAL);
+        if (!library)
+            return fail("libEGL.so.1 not found");
+        if (!loadEntryPoints())
+            return fail("libEGL lacks EGL 1.5 entry points");
+
+        display = device < 0 ? egl.getDisplay(nullptr) : deviceDisplay(device);
+        int32_t major = 0, minor = 0;
+        initialized = display && egl.initialize(display, &major, &minor);
+        if (!initialized && device < 0)
+        {
+            // the default display needs a display server, without one the first device is the machine's
+            device = 0;
+            display = deviceDisplay(device);
+            initialized = display && egl.initialize(display, &major, &minor);
+        }
+        if (!display)
+            return message.empty() ? fail("no EGL display") : false;
+        if (!initialized)
+            return fail("eglInitialize failed");
+        if (!egl.bindAPI(EGL_OPENGL_API))
+            return fail("the EGL display has no desktop OpenGL");
+
+        const int32_t configAttributes[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                                            EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8, EGL_NONE};
+        void* config = nullptr;
+        int32_t configs = 0;
+        if (!egl.chooseConfig(display, configAttributes, &config, 1, &configs) || configs == 0)
+            return fail("no EGL config renders OpenGL");
+        const int32_t contextAttributes[] = {EGL_CONTEXT_MAJOR_VERSION, 4, EGL_CONTEXT_MINOR_VERSION, 6,
+                                             EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE};
+        context = egl.createContext(display, config, nullptr, contextAttributes);
+        if (!context)
+            return fail("no OpenGL 4.6 core context on the EGL display");
+
+        if (!hasExtension(egl.queryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context"))
+        {
+            const int32_t pbufferAttributes[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+            surface = egl.createPbufferSurface(display, config, pbufferAttributes);
+            if (!surface)
+                return fail("neither surfaceless contexts nor a pbuffer");
+        }
+        if (!egl.makeCurrent(display, surface, surface, context))
+            return fail("eglMakeCurrent failed");
+        std::cout << "EGL " << major << "." << minor << (device < 0 ? " on the default display" : " on device " + std::to_string(device))
+                  << (surface ? ", pbuffer" : ", surfaceless") << std::endl;
+        return true;
+    }
+
+    const std::string& error() const { return message; }
+
+    // for gladLoadGLLoader and the extension loaders; only valid while a context was created
+    static void* getProcAddress(const char* name)
+    {
+        return activeLoader ? reinterpret_cast<void*>(activeLoader(name)) : nullptr;
+    }
+
+    void release()
+    {
+        if (display)
+        {
+            egl.makeCurrent(display, nullptr, nullptr, nullptr);
+            if (surface)
+                egl.destroySurface(display, surface);
+            if (context)
+                egl.destroyContext(display, context);
+            if (initialized)
+                egl.terminate(display);
+        }
+        if (activeLoader == egl.getProcAddress)
+            activeLoader = nullptr;
+        if (library)
+            dlclose(library);
+        library = display = context = surface = nullptr;
+        initialized = false;
+        egl = EntryPoints();
+    }
+
+private:
+    static const int32_t EGL_NONE = 0x3038;
+    static const int32_t EGL_ALPHA_SIZE = 0x3021;
+    static const int32_t EGL_BLUE_SIZE = 0x3022;
+    static const int32_t EGL_GREEN_SIZE = 0x3023;
+    static const int32_t EGL_RED_SIZE = 0x3024;
+    static const int32_t EGL_SURFACE_TYPE = 0x3033;
+    static const int32_t EGL_PBUFFER_BIT = 0x0001;
+    static const int32_t EGL_RENDERABLE_TYPE = 0x3040;
+    static const int32_t EGL_OPENGL_BIT = 0x0008;
+    static const int32_t EGL_EXTENSIONS = 0x3055;
+    static const int32_t EGL_HEIGHT = 0x3056;
+    static const int32_t EGL_WIDTH = 0x3057;
+    static const int32_t EGL_CONTEXT_MAJOR_VERSION = 0x3098;
+    static const int32_t EGL_CONTEXT_MINOR_VERSION = 0x30FB;
+    static const int32_t EGL_CONTEXT_OPENGL_PROFILE_MASK = 0x30FD;
+    static const int32_t EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT = 0x0001;
+    static const unsigned int EGL_OPENGL_API = 0x30A2;
+    static const unsigned int EGL_PLATFORM_DEVICE_EXT = 0x313F;
+
+    typedef void (*Proc)();
+    struct EntryPoints
+    {
+        Proc (*getProcAddress)(const char*) = nullptr;
+        void* (*getDisplay)(void*) = nullptr;
+        unsigned int (*initialize)(void*, int32_t*, int32_t*) = nullptr;
+        unsigned int (*terminate)(void*) = nullptr;
+        unsigned int (*bindAPI)(unsigned int) = nullptr;
+        unsigned int (*chooseConfig)(void*, const int32_t*, void**, int32_t, int32_t*) = nullptr;
+        void* (*createContext)(void*, void*, void*, const int32_t*) = nullptr;
+        unsigned int (*destroyContext)(void*, void*) = nullptr;
+        void* (*createPbufferSurface)(void*, void*, const int32_t*) = nullptr;
+        unsigned int (*destroySurface)(void*, void*) = nullptr;
+        unsigned int (*makeCurrent)(void*, void*, void*, void*) = nullptr;
+        const char* (*queryString)(void*, int32_t) = nullptr;
+        // EGL_EXT_device_enumeration and EGL_EXT_platform_base, through eglGetProcAddress
+        unsigned int (*queryDevices)(int32_t, void**, int32_t*) = nullptr;
+        void* (*getPlatformDisplay)(unsigned int, void*, const int32_t*) = nullptr;
+    };
+
+    template <typename F>
+    bool symbol(F& entry, const char* name)
+    {
+        entry = reinterpret_cast<F>(dlsym(library, name));
+        return entry != nullptr;
+    }
+
+    bool loadEntryPoints()
+    {
+        const bool core = symbol(egl.getProcAddress, "eglGetProcAddress") && symbol(egl.getDisplay, "eglGetDisplay")
+                       && symbol(egl.initialize, "eglInitialize") && symbol(egl.terminate, "eglTerminate")
+                       && symbol(egl.bindAPI, "eglBindAPI") && symbol(egl.chooseConfig, "eglChooseConfig")
+                       && symbol(egl.createContext, "eglCreateContext") && symbol(egl.destroyContext, "eglDestroyContext")
+                       && symbol(egl.createPbufferSurface, "eglCreatePbufferSurface") && symbol(egl.destroySurface, "eglDestroySurface")
+                       && symbol(egl.makeCurrent, "eglMakeCurrent") && symbol(egl.queryString, "eglQueryString");
+        if (!core)
+            return false;
+        activeLoader = egl.getProcAddress;
+        egl.queryDevices = reinterpret_cast<decltype(egl.queryDevices)>(egl.getProcAddress("eglQueryDevicesEXT"));
+        egl.getPlatformDisplay = reinterpret_cast<decltype(egl.getPlatformDisplay)>(egl.getProcAddress("eglGetPlatformDisplayEXT"));
+        return true;
+    }
+
+    // the display of the device-th EGL device
+    void* deviceDisplay(int device)
+    {
+        static const int32_t MAX_DEVICES = 32;
+        void* devices[MAX_DEVICES] = {};
+        int32_t count = 0;
+        if (!egl.queryDevices || !egl.getPlatformDisplay)
+        {
+            fail("EGL_EXT_device_enumeration is missing, only the default display can be used");
+            return nullptr;
+        }
+        if (!egl.queryDevices(MAX_DEVICES, devices, &count) || device >= count)
+        {
+            fail("no EGL device " + std::to_string(device) + ", the machine has " + std::to_string(count));
+            return nullptr;
+        }
+        void* platformDisplay = egl.getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, devices[device], nullptr);
+        if (!platformDisplay)
+            fail("no display on EGL device " + std::to_string(device));
+        return platformDisplay;
+    }
+
+    static bool hasExtension(const char* list, const char* name)
+    {
+        const size_t length = std::strlen(name);
+        for (const char* at = list; at && (at = std::strstr(at, name)); at += length)
+            if ((at == list || at[-1] == ' ') && (at[length] == ' ' || at[length] == '\0'))
+                return true;
+        return false;
+    }
+
+    bool fail(const std::string& text)
+    {
+        message = text;
+        return false;
+    }
+
+    static inline Proc (*activeLoader)(const char*) = nullptr;
+
+    EntryPoints egl;
+    void* library = nullptr;
+    void* display = nullptr;
+    void* context = nullptr;
+    void* surface = nullptr;
+    bool initialized = false;
+    std::string message;
+};
+
+// what stands in for the default framebuffer without a window: an RGBA8 colour target the scene is presented into
+// and frame capture reads back. Nothing has to be drawn after the present, so there is no depth.
+class HeadlessFramebuffer
+{
+public:
+    HeadlessFramebuffer(int width, int height) : frameWidth(width), frameHeight(height)
+    {
+        color.create(GL_TEXTURE_2D, "Headless colour");
+        color.storage2D(1, GL_RGBA8, width, height);
+        glState().bindTexture(GL_TEXTURE_2D, 0);
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        labelObject(GL_FRAMEBUFFER, fbo, "Headless");
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color.id(), 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::HEADLESS:: Framebuffer is not complete" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    ~HeadlessFramebuffer()
+    {
+        glDeleteFramebuffers(1, &fbo);
+        color.release();
+    }
+
+    HeadlessFramebuffer(const HeadlessFramebuffer&) = delete;
+    HeadlessFramebuffer& operator=(const HeadlessFramebuffer&) = delete;
+
+    unsigned int id() const { return fbo; }
+    int width() const { return frameWidth; }
+    int height() const { return frameHeight; }
+
+private:
+    GlTexture color{GPU_MEMORY_RENDER_TARGETS};
+    unsigned int fbo = 0;
+    int frameWidth;
+    int frameHeight;
+};
+
+#endif
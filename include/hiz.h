@@ -0,0 +1,155 @@
+#ifndef HIZ_H
+#define HIZ_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <shader.h>
+#include <gpu_memory.h>
+#include <depth_convention.h>
+
+#include <algorithm>
+
+// A hierarchical-Z pyramid of a frame's depth, for occlusion culling the next frame's instances: capture() copies
+// the default framebuffer's depth and reduces it to a mip chain of the farthest depth under each texel
+// (shaders.2/hiz.downsample.cs), level 0 at half resolution. The camera it was captured with is kept so the cull
+// can reproject into it (GpuCuller::cull). An object that only just came into view is culled against last frame's
+// occluders for that one frame.
+class HiZ
+{
+public:
+    static const unsigned int TEXTURE_UNIT = 7;     // clear of the units the rock shaders sample
+
+    explicit HiZ(const char* downsamplePath) : downsampleShader(downsamplePath) {}
+
+    ~HiZ()
+    {
+        release();
+    }
+
+    bool valid() const { return captured; }
+    unsigned int levels() const { return levelCount; }
+    glm::ivec2 size() const { return glm::ivec2(pyramidWidth, pyramidHeight); }    // of level 0
+    const glm::mat4& projection() const { return capturedProjection; }
+    const glm::mat4& view() const { return capturedView; }
+    const glm::vec3& cameraPosition() const { return capturedCamera; }
+
+    // builds the pyramid from the depth of framebuffer (the default one, or the offscreen scene), which must be
+    // viewportWidth x viewportHeight and drawn with projection and camera-relative view from cameraPosition, and
+    // binds it again
+    void capture(int viewportWidth, int viewportHeight, const glm::mat4& projection, const glm::mat4& view, const glm::vec3& cameraPosition,
+                 unsigned int framebuffer = 0)
+    {
+        GL_DEBUG_GROUP("hi-z capture");
+        prepare(std::max(viewportWidth, 1), std::max(viewportHeight, 1));
+        // multisampled depth resolves to one sample per pixel, the formats must match (depthConvention()'s, which
+        // SceneTarget's is; GLFW's default framebuffer only matches the standard convention's 24-bit depth)
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, depthFBO);
+        glBlitFramebuffer(0, 0, depthWidth, depthHeight, 0, 0, depthWidth, depthHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+        downsampleShader.use();
+        downsampleShader.setInt("source", 0);
+        glState().activeTexture(GL_TEXTURE0);
+        for (unsigned int level = 0; level < levelCount; level++)
+        {
+            glState().bindTexture(GL_TEXTURE_2D, level == 0 ? depthTexture.id() : pyramid.id());
+            downsampleShader.setInt("sourceLod", level == 0 ? 0 : static_cast<int>(level) - 1);
+            glBindImageTexture(0, pyramid.id(), level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+            const glm::ivec2 levelSize = glm::max(glm::ivec2(pyramidWidth, pyramidHeight) >> static_cast<int>(level), glm::ivec2(1));
+            glDispatchCompute((levelSize.x + 7) / 8, (levelSize.y + 7) / 8, 1);
+            // the next level fetches this one
+            glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        }
+        glState().bindTexture(GL_TEXTURE_2D, 0);
+
+        capturedProjection = projection;
+        capturedView = view;
+        capturedCamera = cameraPosition;
+        captured = true;
+    }
+
+    void bind() const
+    {
+        glState().activeTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+        glState().bindTexture(GL_TEXTURE_2D, pyramid.id());
+        glState().activeTexture(GL_TEXTURE0);
+    }
+
+    // binds the pyramid and sets the uniforms of shaders.2/hiz.glsl on shader, which is in use, for a cull from
+    // cameraPosition
+    void apply(Shader& shader, const glm::vec3& cameraPosition) const
+    {
+        bind();
+        shader.setInt("hiz", TEXTURE_UNIT);
+        shader.setInt("hizLevels", static_cast<int>(levelCount));
+        shader.setMat4("hizProjection", capturedProjection);
+        shader.setMat4("hizView", capturedView);
+        shader.setVec3("hizCameraOffset", cameraPosition - capturedCamera);
+    }
+
+    // the next cull tests nothing, e.g. after the camera jumped
+    void invalidate() { captured = false; }
+
+    void release()
+    {
+        if (depthFBO != 0) glDeleteFramebuffers(1, &depthFBO);
+        depthFBO = 0;
+        depthTexture.release();
+        pyramid.release();
+        depthWidth = depthHeight = pyramidWidth = pyramidHeight = 0;
+        levelCount = 0;
+        captured = false;
+    }
+
+private:
+    Shader downsampleShader;
+    unsigned int depthFBO = 0;
+    GlTexture depthTexture{GPU_MEMORY_RENDER_TARGETS};
+    GlTexture pyramid{GPU_MEMORY_RENDER_TARGETS};
+    int depthWidth = 0;
+    int depthHeight = 0;
+    int pyramidWidth = 0;
+    int pyramidHeight = 0;
+    unsigned int levelCount = 0;
+    bool captured = false;
+    glm::mat4 capturedProjection = glm::mat4(1.0f);
+    glm::mat4 capturedView = glm::mat4(1.0f);
+    glm::vec3 capturedCamera = glm::vec3(0.0f);
+
+    // (re)allocates the depth copy and the pyramid when the viewport changed size
+    void prepare(int w, int h)
+    {
+        if (depthFBO != 0 && w == depthWidth && h == depthHeight)
+            return;
+        release();
+        depthWidth = w;
+        depthHeight = h;
+        pyramidWidth = std::max(w / 2, 1);
+        pyramidHeight = std::max(h / 2, 1);
+        levelCount = 1;
+        while ((std::max(pyramidWidth, pyramidHeight) >> levelCount) > 0)
+            levelCount++;
+
+        depthTexture.create(GL_TEXTURE_2D, "hi-z depth copy");
+        depthTexture.storage2D(1, depthConvention().depthFormat(), depthWidth, depthHeight);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        pyramid.create(GL_TEXTURE_2D, "hi-z pyramid");
+        pyramid.storage2D(levelCount, GL_R32F, pyramidWidth, pyramidHeight);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glState().bindTexture(GL_TEXTURE_2D, 0);
+
+        glGenFramebuffers(1, &depthFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, depthFBO);
+        labelObject(GL_FRAMEBUFFER, depthFBO, "hi-z depth copy");
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture.id(), 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+};
+
+#endif
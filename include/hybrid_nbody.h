@@ -0,0 +1,186 @@
+#ifndef HYBRID_NBODY_H
+#define HYBRID_NBODY_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <shader.h>
+#include <body_store.h>
+#include <gpu_nbody.h>
+#include <gpu_memory.h>
+#include <std140.h>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+const unsigned int HYBRID_MAX_MASSIVE = 64;     // MAX_MASSIVE of nbody.hybrid.cs
+
+typedef Std140Array<glm::vec4, HYBRID_MAX_MASSIVE> HybridSources;
+// MassiveBodies of nbody.hybrid.cs, the massive bodies at both ends of a step, xyz position and w mass
+#define HYBRID_MASSIVE_MEMBERS(M) M(HybridSources, before) M(HybridSources, after) M(unsigned int, massiveCount)
+STD140_STRUCT(HybridMassive, HYBRID_MASSIVE_MEMBERS);
+
+// Hybrid backend: the few massive bodies (sun, planets) are integrated on the CPU in double precision and the
+// asteroids on the GPU as test particles, in GpuNBody's buffers so everything drawing them from there still works.
+// Each step the CPU takes its KDK leapfrog step of the massive bodies, split into as many substeps as their closest
+// pair needs (a tenth of the pair's two-body time sqrt(r^3 / G(m1 + m2)) at most, so a moon's pass at a planet is
+// resolved while the belt keeps the frame's step), and publishes their positions before and after it, 2 KB, into a
+// uniform block. One dispatch then takes the particles' leapfrog step against the two: a half kick at the start
+// positions, the drift, a half kick at the end positions, and writes the end positions into the massive bodies'
+// entries of the position buffer. Nothing comes back, the CPU has the massive bodies already. Asteroids pull on
+// nothing, whatever the solver.
+class HybridNBody
+{
+public:
+    static const unsigned int BINDING_MASSIVE = 5;  // uniform block binding
+    static const unsigned int MAX_SUBSTEPS = 256;
+
+    unsigned int substepsLastStep = 0;
+
+    explicit HybridNBody(const char* particlePath) : particleShader(particlePath) {}
+
+    ~HybridNBody()
+    {
+        release();
+    }
+
+    // takes the massive bodies of bodies in double, false when there are more than the block holds; the particles
+    // are the GpuNBody upload of the same store
+    bool upload(const BodyStore& bodies)
+    {
+        release();
+        const size_t count = bodies.range(BODY_ASTEROID).begin;
+        if (count > HYBRID_MAX_MASSIVE)
+            return false;
+        position.assign(bodies.position.begin(), bodies.position.begin() + count);
+        velocity.assign(bodies.velocity.begin(), bodies.velocity.begin() + count);
+        mass.assign(bodies.mass.begin(), bodies.mass.begin() + count);
+        dynamic.resize(count);
+        for (size_t i = 0; i < count; i++)
+            dynamic[i] = bodies.isStatic(i) ? 0.0 : 1.0;
+        acceleration.assign(count, glm::dvec3(0.0));
+        if (!block.valid())
+        {
+            block.create(GL_UNIFORM_BUFFER, "hybrid massive bodies");
+            block.storage(sizeof(HybridMassive), nullptr, GL_DYNAMIC_STORAGE_BIT);
+            glState().bindBuffer(GL_UNIFORM_BUFFER, 0);
+        }
+        return true;
+    }
+
+    unsigned int massiveCount() const { return static_cast<unsigned int>(position.size()); }
+
+    // one step of dt for both sides
+    void step(GpuNBody& particles, double dt, double G, double epsilonSq)
+    {
+        GL_DEBUG_GROUP("hybrid n-body step");
+        HybridMassive published;
+        const unsigned int count = massiveCount();
+        published.massiveCount = count;
+        for (unsigned int i = 0; i < count; i++)
+            published.before[i] = glm::vec4(glm::vec3(position[i]), static_cast<float>(mass[i]));
+
+        substepsLastStep = substeps(dt, G);
+        const double h = dt / substepsLastStep;
+        accelerate(G, epsilonSq);
+        for (unsigned int s = 0; s < substepsLastStep; s++)
+        {
+            for (unsigned int i = 0; i < count; i++)
+            {
+                velocity[i] += 0.5 * h * dynamic[i] * acceleration[i];
+                position[i] += h * dynamic[i] * velocity[i];
+            }
+            accelerate(G, epsilonSq);
+            for (unsigned int i = 0; i < count; i++)
+                velocity[i] += 0.5 * h * dynamic[i] * acceleration[i];
+        }
+        for (unsigned int i = 0; i < count; i++)
+            published.after[i] = glm::vec4(glm::vec3(position[i]), static_cast<float>(mass[i]));
+
+        glNamedBufferSubData(block.id(), 0, sizeof(HybridMassive), &published);
+        glState().bindBufferBase(GL_UNIFORM_BUFFER, BINDING_MASSIVE, block.id());
+
+        if (particles.bodyCount == 0)
+            return;
+        particles.bind();
+        particleShader.use();
+        particleShader.setUInt("bodyCount", particles.bodyCount);
+        particleShader.setFloat("G", static_cast<float>(G));
+        particleShader.setFloat("dt", static_cast<float>(dt));
+        particleShader.setFloat("epsilonSq", static_cast<float>(epsilonSq));
+        glDispatchCompute((particles.bodyCount + 255) / 256, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    }
+
+    // the massive bodies' state into bodies, which the CPU draws and lights them from
+    void readMassive(BodyStore& bodies) const
+    {
+        for (size_t i = 0; i < position.size() && i < bodies.size(); i++)
+        {
+            bodies.position[i] = position[i];
+            bodies.velocity[i] = velocity[i];
+        }
+    }
+
+    void setMass(unsigned int index, double m)
+    {
+        if (index >= mass.size())
+            return;
+        mass[index] = m;
+    }
+
+    void release()
+    {
+        block.release();
+        position.clear();
+        velocity.clear();
+        mass.clear();
+        dynamic.clear();
+        acceleration.clear();
+        substepsLastStep = 0;
+    }
+
+private:
+    Shader particleShader;
+    GlBuffer block{GPU_MEMORY_SIMULATION};
+    std::vector<glm::dvec3> position, velocity, acceleration;
+    std::vector<double> mass;
+    std::vector<double> dynamic;        // 0 for static bodies
+
+    // direct sum over the pairs, in double
+    void accelerate(double G, double epsilonSq)
+    {
+        const size_t count = position.size();
+        std::fill(acceleration.begin(), acceleration.end(), glm::dvec3(0.0));
+        for (size_t i = 0; i < count; i++)
+            for (size_t j = i + 1; j < count; j++)
+            {
+                const glm::dvec3 r = position[j] - position[i];
+                const double r2 = std::max(glm::dot(r, r), epsilonSq);
+                const glm::dvec3 f = G * r / (r2 * std::sqrt(r2));
+                acceleration[i] += mass[j] * f;
+                acceleration[j] -= mass[i] * f;
+            }
+    }
+
+    // substeps for dt, each at most a tenth of the tightest pair's two-body time
+    unsigned int substeps(double dt, double G) const
+    {
+        double shortest = std::abs(dt);
+        const size_t count = position.size();
+        for (size_t i = 0; i < count; i++)
+            for (size_t j = i + 1; j < count; j++)
+            {
+                const double gm = G * (mass[i] + mass[j]);
+                const glm::dvec3 r = position[j] - position[i];
+                const double r2 = glm::dot(r, r);
+                if (gm > 0.0 && r2 > 0.0)
+                    shortest = std::min(shortest, 0.1 * std::sqrt(r2 * std::sqrt(r2) / gm));
+            }
+        const double n = std::ceil(std::abs(dt) / std::max(shortest, 1e-12));
+        return static_cast<unsigned int>(std::min(std::max(n, 1.0), static_cast<double>(MAX_SUBSTEPS)));
+    }
+};
+
+#endif
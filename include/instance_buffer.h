@@ -0,0 +1,124 @@
+#ifndef INSTANCE_BUFFER_H
+#define INSTANCE_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <gpu_memory.h>
+
+#include <vector>
+#include <cstddef>
+
+// Per-instance attributes start at location 8, clear of every VertexLayout's 0 to 6, and are fed from vertex
+// buffer binding point INSTANCE_BINDING, which glVertexAttribPointer (binding i for attribute i) never touches.
+// A mesh's own vertex format is left as it is however many instance layouts it is drawn with.
+#define INSTANCE_FIRST_LOCATION 8
+#define INSTANCE_BINDING 15
+
+// one attribute of an instance record
+struct InstanceAttribute
+{
+    GLuint location;
+    GLint components;
+    GLenum type;
+    bool normalized;        // for fixed-point types read as float
+    bool integer;           // read as int or uint (glVertexAttribIFormat), normalized is ignored then
+    GLuint offset;          // into the record
+};
+
+// what an instance record looks like to the vertex shader
+struct InstanceLayout
+{
+    const char* name;
+    GLsizei stride;
+    std::vector<InstanceAttribute> attributes;
+};
+
+// Records of an InstanceLayout in a buffer, either one this owns (upload) or someone else's, e.g. a stream
+// ring (use). Each change of buffer gets a new version, so meshes drawn with it know to re-point their VAO.
+class InstanceBuffer
+{
+public:
+    explicit InstanceBuffer(const InstanceLayout& layout) : instanceLayout(&layout) {}
+
+    InstanceBuffer(const InstanceBuffer&) = delete;
+    InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+
+    const InstanceLayout& layout() const { return *instanceLayout; }
+    GLuint buffer() const { return name; }
+    GLintptr offset() const { return byteOffset; }
+    unsigned int version() const { return currentVersion; }
+    bool valid() const { return name != 0; }
+
+    // the records come from buffer at offset bytes, the buffer stays its owner's. Call it again after the
+    // buffer was recreated, even under the same name.
+    void use(GLuint buffer, GLintptr offset = 0)
+    {
+        storage.release();
+        name = buffer;
+        byteOffset = offset;
+        currentVersion = nextVersion();
+    }
+
+    // a different record format, for the buffer set next
+    void setLayout(const InstanceLayout& layout)
+    {
+        instanceLayout = &layout;
+        currentVersion = nextVersion();
+    }
+
+    // count records into a buffer of this one's own, its storage flags GL_DYNAMIC_STORAGE_BIT if it is to be
+    // rewritten in place
+    void upload(const void* records, size_t count, GLbitfield flags = 0, const char* label = "instances")
+    {
+        storage.create(GL_ARRAY_BUFFER, label);
+        storage.storage(count * static_cast<size_t>(instanceLayout->stride), records, flags);
+        glState().bindBuffer(GL_ARRAY_BUFFER, 0);
+        name = storage.id();
+        byteOffset = 0;
+        currentVersion = nextVersion();
+    }
+
+    void release()
+    {
+        storage.release();
+        name = 0;
+        byteOffset = 0;
+        currentVersion = nextVersion();
+    }
+
+    // points vao's instance attributes at the records, and turns off those of layout previous (null for none)
+    // that this layout does not have
+    void attach(GLuint vao, const InstanceLayout* previous) const
+    {
+        if (previous)
+            for (const InstanceAttribute& attribute : previous->attributes)
+                glDisableVertexArrayAttrib(vao, attribute.location);
+        for (const InstanceAttribute& attribute : instanceLayout->attributes)
+        {
+            glEnableVertexArrayAttrib(vao, attribute.location);
+            if (attribute.integer)
+                glVertexArrayAttribIFormat(vao, attribute.location, attribute.components, attribute.type, attribute.offset);
+            else
+                glVertexArrayAttribFormat(vao, attribute.location, attribute.components, attribute.type,
+                                          attribute.normalized ? GL_TRUE : GL_FALSE, attribute.offset);
+            glVertexArrayAttribBinding(vao, attribute.location, INSTANCE_BINDING);
+        }
+        glVertexArrayVertexBuffer(vao, INSTANCE_BINDING, name, byteOffset, instanceLayout->stride);
+        glVertexArrayBindingDivisor(vao, INSTANCE_BINDING, 1);
+    }
+
+private:
+    const InstanceLayout* instanceLayout;
+    GlBuffer storage{GPU_MEMORY_INSTANCES};
+    GLuint name = 0;
+    GLintptr byteOffset = 0;
+    unsigned int currentVersion = nextVersion();
+
+    static unsigned int nextVersion()
+    {
+        static unsigned int counter = 0;
+        return ++counter;
+    }
+};
+
+#endif
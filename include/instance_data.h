@@ -0,0 +1,173 @@
+#ifndef INSTANCE_DATA_H
+#define INSTANCE_DATA_H
+
+#include <glm.hpp>
+#include <gtc/quaternion.hpp>
+#include <gtc/packing.hpp>
+
+#include <body_store.h>
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+// Per-instance record for the asteroid draw, 40 bytes. The vertex shader rebuilds the model matrix from it, and since
+// the scale is uniform the rotation doubles as the normal matrix, so no inverse is needed anywhere. The tumble is
+// evaluated in the shader from the sim time, the record only carries the constant axis and rate.
+struct AsteroidInstance
+{
+    glm::vec3 position;
+    float scale;
+    glm::vec4 orientation;  // quaternion as xyzw, the order the shader expects
+    uint32_t spinAxis;      // body-frame axis as snorm 10-10-10-2
+    float spinRate;         // radians per sim second
+};
+static_assert(sizeof(AsteroidInstance) == 40, "instance layout must match the vertex attributes");
+
+inline AsteroidInstance packInstance(const BodyStore& bodies, size_t i, const glm::vec3& at)
+{
+    const BodyRenderData& r = bodies.render[i];
+    const glm::quat& q = r.orientation;
+    return AsteroidInstance{at, r.radiusScale, glm::vec4(q.x, q.y, q.z, q.w),
+                            glm::packSnorm3x10_1x2(glm::vec4(glm::vec3(r.spin), 0.0f)), r.spin.w};
+}
+
+// view frustum as six inward planes, for skipping instances while they are packed
+struct Frustum
+{
+    glm::vec4 planes[6];
+
+    // Gribb-Hartmann extraction from projection * view, normalized so the sphere test is in world units
+    void fromMatrix(const glm::mat4& m)
+    {
+        const glm::mat4 t = glm::transpose(m);
+        planes[0] = t[3] + t[0]; planes[1] = t[3] - t[0];
+        planes[2] = t[3] + t[1]; planes[3] = t[3] - t[1];
+        planes[4] = t[3] + t[2]; planes[5] = t[3] - t[2];
+        for (glm::vec4& p : planes)
+            p /= glm::length(glm::vec3(p));
+    }
+
+    bool intersectsSphere(const glm::vec3& center, float radius) const
+    {
+        for (const glm::vec4& p : planes)
+            if (glm::dot(glm::vec3(p), center) + p.w < -radius)
+                return false;
+        return true;
+    }
+};
+
+// Quantized record, 16 bytes. Instances come in chunks of INSTANCE_CHUNK consecutive records and the position and
+// scale are stored relative to their chunk's bounds, which the shader reads from a small SSBO. Morton-sorted
+// asteroids make a chunk a compact cluster, so 16 bits per axis leave sub-millimetre steps at belt scale.
+static const unsigned int INSTANCE_CHUNK = 256;
+static const unsigned int INSTANCE_CHUNK_BINDING = 6;    // SSBO binding of the chunk table
+
+struct QuantizedInstance
+{
+    uint32_t orientation;   // smallest three 10:10:10, the top 2 bits name the dropped component
+    uint32_t spinAxis;      // body-frame axis as snorm 10-10-10-2
+    uint16_t position[3];   // unorm inside the chunk bounds
+    uint16_t scaleSpin;     // low byte unorm scale inside the chunk range, high byte whole turns per TUMBLE_PERIOD
+};
+static_assert(sizeof(QuantizedInstance) == 16, "instance layout must match the vertex attributes");
+
+// std430 layout, matches the shader's chunk table
+struct InstanceChunk
+{
+    glm::vec4 origin;       // xyz lowest corner, w smallest scale
+    glm::vec4 extent;       // xyz size of the bounds, w scale range
+};
+
+// the largest component is dropped and rebuilt from the unit length, the other three lie in [-1/sqrt2, 1/sqrt2]
+inline uint32_t packSmallestThree(const glm::quat& q)
+{
+    const float c[4] = {q.x, q.y, q.z, q.w};
+    unsigned int largest = 0;
+    for (unsigned int k = 1; k < 4; k++)
+        if (std::fabs(c[k]) > std::fabs(c[largest])) largest = k;
+    // q and -q are the same rotation, flip so the dropped component is positive
+    const float sign = c[largest] < 0.0f ? -1.0f : 1.0f;
+    uint32_t packed = static_cast<uint32_t>(largest) << 30;
+    unsigned int shift = 20;
+    for (unsigned int k = 0; k < 4; k++)
+    {
+        if (k == largest) continue;
+        const float v = std::clamp(sign * c[k] * 0.70710678f + 0.5f, 0.0f, 1.0f);
+        packed |= static_cast<uint32_t>(v * 1023.0f + 0.5f) << shift;
+        shift -= 10;
+    }
+    return packed;
+}
+
+inline uint16_t quantizeUnorm16(float v)
+{
+    return static_cast<uint16_t>(std::clamp(v, 0.0f, 1.0f) * 65535.0f + 0.5f);
+}
+
+// Collects instances until a chunk is full, then writes its bounds and the quantized records. add() takes the same
+// arguments as packInstance, finish() flushes the last partial chunk.
+class QuantizedInstanceWriter
+{
+public:
+    QuantizedInstanceWriter(QuantizedInstance* records, InstanceChunk* chunks) : records(records), chunks(chunks) {}
+
+    void add(const BodyStore& bodies, size_t i, const glm::vec3& at)
+    {
+        index[pending] = i;
+        position[pending] = at;
+        if (++pending == INSTANCE_CHUNK)
+            flush(bodies);
+    }
+
+    void finish(const BodyStore& bodies)
+    {
+        if (pending > 0)
+            flush(bodies);
+    }
+
+private:
+    QuantizedInstance* records;
+    InstanceChunk* chunks;
+    unsigned int pending = 0;
+    size_t index[INSTANCE_CHUNK];
+    glm::vec3 position[INSTANCE_CHUNK];
+
+    void flush(const BodyStore& bodies)
+    {
+        glm::vec3 low = position[0], high = position[0];
+        float smallest = bodies.render[index[0]].radiusScale, largest = smallest;
+        for (unsigned int k = 1; k < pending; k++)
+        {
+            low = glm::min(low, position[k]);
+            high = glm::max(high, position[k]);
+            smallest = std::min(smallest, bodies.render[index[k]].radiusScale);
+            largest = std::max(largest, bodies.render[index[k]].radiusScale);
+        }
+        const glm::vec3 extent = high - low;
+        const float scaleRange = largest - smallest;
+        *chunks++ = InstanceChunk{glm::vec4(low, smallest), glm::vec4(extent, scaleRange)};
+        // a flat axis would divide by zero, any step size reproduces it
+        const glm::vec3 inverse(extent.x > 0.0f ? 1.0f / extent.x : 0.0f, extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+                                extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
+        const float inverseScale = scaleRange > 0.0f ? 1.0f / scaleRange : 0.0f;
+        const float turnsPerRadian = static_cast<float>(TUMBLE_PERIOD / 6.283185307179586);
+        for (unsigned int k = 0; k < pending; k++)
+        {
+            const BodyRenderData& r = bodies.render[index[k]];
+            const glm::vec3 unit = (position[k] - low) * inverse;
+            const unsigned int scale = static_cast<unsigned int>(std::clamp((r.radiusScale - smallest) * inverseScale, 0.0f, 1.0f) * 255.0f + 0.5f);
+            const unsigned int turns = static_cast<unsigned int>(std::clamp(r.spin.w * turnsPerRadian + 0.5f, 0.0f, 255.0f));
+            QuantizedInstance& out = *records++;
+            out.orientation = packSmallestThree(r.orientation);
+            out.spinAxis = glm::packSnorm3x10_1x2(glm::vec4(glm::vec3(r.spin), 0.0f));
+            out.position[0] = quantizeUnorm16(unit.x);
+            out.position[1] = quantizeUnorm16(unit.y);
+            out.position[2] = quantizeUnorm16(unit.z);
+            out.scaleSpin = static_cast<uint16_t>(scale | turns << 8);
+        }
+        pending = 0;
+    }
+};
+
+#endif
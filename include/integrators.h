@@ -0,0 +1,151 @@
+#ifndef INTEGRATORS_H
+#define INTEGRATORS_H
+
+#include <glm.hpp>
+
+#include <body_store.h>
+
+#include <cmath>
+#include <vector>
+
+// Time integrators over a BodyStore. All of them share one force evaluation interface: a callable that
+// overwrites bodies.acceleration from the current positions. The symplectic schemes keep energy error
+// bounded instead of drifting, which allows much larger steps than explicit Euler for the same accuracy.
+enum IntegratorType {
+    INTEGRATOR_SEMI_IMPLICIT_EULER = 0,
+    INTEGRATOR_LEAPFROG_KDK = 1,
+    INTEGRATOR_VELOCITY_VERLET = 2,
+    INTEGRATOR_YOSHIDA4 = 3,
+    INTEGRATOR_COUNT = 4
+};
+
+inline const char* integratorName(IntegratorType type)
+{
+    switch (type)
+    {
+        case INTEGRATOR_SEMI_IMPLICIT_EULER: return "Semi-implicit Euler";
+        case INTEGRATOR_LEAPFROG_KDK: return "Leapfrog (KDK)";
+        case INTEGRATOR_VELOCITY_VERLET: return "Velocity Verlet";
+        case INTEGRATOR_YOSHIDA4: return "Yoshida 4th order";
+        default: return "Unknown";
+    }
+}
+
+// force evaluations each scheme needs per step once its cached accelerations are valid
+inline unsigned int forceEvaluationsPerStep(IntegratorType type)
+{
+    return type == INTEGRATOR_YOSHIDA4 ? 3 : 1;
+}
+
+class Integrator
+{
+public:
+    IntegratorType type = INTEGRATOR_SEMI_IMPLICIT_EULER;
+    // sim time since the start of the step that the positions are at, for forces that depend on time
+    double stageTime = 0.0;
+
+    // leapfrog and Verlet reuse the accelerations from the end of the previous step. Anything that changes
+    // forces without moving bodies (reset, mass or G edits) has to call this so they are recomputed.
+    void invalidate() { haveAccelerations = false; }
+
+    template <typename ForceFn>
+    void step(BodyStore& bodies, float dt, ForceFn&& computeAccelerations)
+    {
+        stageTime = 0.0;
+        switch (type)
+        {
+            case INTEGRATOR_SEMI_IMPLICIT_EULER:
+                computeAccelerations();
+                kick(bodies, dt);
+                drift(bodies, dt);
+                stageTime = dt;
+                haveAccelerations = false;
+                break;
+            case INTEGRATOR_LEAPFROG_KDK:
+                if (!haveAccelerations) computeAccelerations();
+                kick(bodies, 0.5f * dt);
+                drift(bodies, dt);
+                stageTime = dt;
+                computeAccelerations();
+                kick(bodies, 0.5f * dt);
+                haveAccelerations = true;
+                break;
+            case INTEGRATOR_VELOCITY_VERLET:
+                stepVelocityVerlet(bodies, dt, computeAccelerations);
+                break;
+            case INTEGRATOR_YOSHIDA4:
+                stepYoshida4(bodies, dt, computeAccelerations);
+                break;
+            default:
+                break;
+        }
+    }
+
+    static void kick(BodyStore& bodies, float dt)
+    {
+        const size_t n = bodies.size();
+        const uint8_t* flags = bodies.flags.data();
+        const glm::vec3* acceleration = bodies.acceleration.data();
+        glm::dvec3* velocity = bodies.velocity.data();
+        for (size_t i = 0; i < n; i++)
+            if (!(flags[i] & BODY_FLAG_STATIC)) velocity[i] += acceleration[i] * dt;
+    }
+
+    static void drift(BodyStore& bodies, float dt)
+    {
+        const size_t n = bodies.size();
+        const uint8_t* flags = bodies.flags.data();
+        const glm::dvec3* velocity = bodies.velocity.data();
+        glm::dvec3* position = bodies.position.data();
+        const double step = dt;
+        for (size_t i = 0; i < n; i++)
+            if (!(flags[i] & BODY_FLAG_STATIC)) position[i] += velocity[i] * step;
+    }
+
+private:
+    bool haveAccelerations = false;
+    BodyArray<glm::vec3> previousAcceleration;
+
+    // x += v dt + a dt^2 / 2, then v += (a_old + a_new) dt / 2
+    template <typename ForceFn>
+    void stepVelocityVerlet(BodyStore& bodies, float dt, ForceFn&& computeAccelerations)
+    {
+        if (!haveAccelerations) computeAccelerations();
+        const size_t n = bodies.size();
+        const uint8_t* flags = bodies.flags.data();
+        const double step = dt;
+        for (size_t i = 0; i < n; i++)
+            if (!(flags[i] & BODY_FLAG_STATIC))
+                bodies.position[i] += bodies.velocity[i] * step + glm::dvec3(bodies.acceleration[i]) * (0.5 * step * step);
+        stageTime = dt;
+        previousAcceleration = bodies.acceleration;
+        computeAccelerations();
+        for (size_t i = 0; i < n; i++)
+            if (!(flags[i] & BODY_FLAG_STATIC))
+                bodies.velocity[i] += (previousAcceleration[i] + bodies.acceleration[i]) * (0.5f * dt);
+        haveAccelerations = true;
+    }
+
+    // Yoshida's 4th-order composition of three leapfrog drift-kick stages
+    template <typename ForceFn>
+    void stepYoshida4(BodyStore& bodies, float dt, ForceFn&& computeAccelerations)
+    {
+        const double cbrt2 = std::cbrt(2.0);
+        const float w1 = static_cast<float>(1.0 / (2.0 - cbrt2));
+        const float w0 = static_cast<float>(-cbrt2 / (2.0 - cbrt2));
+        const float c[4] = {0.5f * w1, 0.5f * (w0 + w1), 0.5f * (w0 + w1), 0.5f * w1};
+        const float d[3] = {w1, w0, w1};
+        for (unsigned int k = 0; k < 3; k++)
+        {
+            drift(bodies, c[k] * dt);
+            stageTime += static_cast<double>(c[k]) * dt;
+            computeAccelerations();
+            kick(bodies, d[k] * dt);
+        }
+        drift(bodies, c[3] * dt);
+        stageTime = dt;
+        haveAccelerations = false;
+    }
+};
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef KEPLER_H
+#define KEPLER_H
+
+#include <glm.hpp>
+
+#include <cmath>
+
+// Analytic two-body propagation with the universal variable formulation (Vallado, Ch. 2). One Newton solve per
+// call handles elliptic, parabolic and hyperbolic orbits alike, and the cost does not depend on dt.
+
+// Stumpff functions c2(z) and c3(z), with series near z = 0 where the closed forms cancel badly. The series is
+// taken up to |z| < 0.1, which is every short step of a bound orbit (z is about (n dt)^2), and is good to about
+// 1e-16 there; its terms are cheaper than the trigonometry.
+inline void stumpff(double z, double& c2, double& c3)
+{
+    if (std::abs(z) < 0.1)
+    {
+        c2 = 0.5 + z * (-1.0 / 24.0 + z * (1.0 / 720.0 + z * (-1.0 / 40320.0 + z * (1.0 / 3628800.0 + z * (-1.0 / 479001600.0)))));
+        c3 = 1.0 / 6.0 + z * (-1.0 / 120.0 + z * (1.0 / 5040.0 + z * (-1.0 / 362880.0 + z * (1.0 / 39916800.0 + z * (-1.0 / 6227020800.0)))));
+    }
+    else if (z > 0.0)
+    {
+        double s = std::sqrt(z);
+        c2 = (1.0 - std::cos(s)) / z;
+        c3 = (s - std::sin(s)) / (s * s * s);
+    }
+    else
+    {
+        double s = std::sqrt(-z);
+        c2 = (1.0 - std::cosh(s)) / z;
+        c3 = (std::sinh(s) - s) / (s * s * s);
+    }
+}
+
+// advances the relative state (r, v) of a test particle around a point mass with gravitational parameter mu.
+// Returns false (leaving r and v alone) if the solve does not converge, e.g. for a collision orbit.
+inline bool keplerPropagate(glm::dvec3& r, glm::dvec3& v, double mu, double dt)
+{
+    const double r0 = glm::length(r);
+    if (mu <= 0.0 || r0 <= 0.0)
+        return false;
+    if (dt == 0.0)
+        return true;
+    const double sqrtMu = std::sqrt(mu);
+    const double vr0 = glm::dot(r, v) / r0;
+    const double alpha = 2.0 / r0 - glm::dot(v, v) / mu;   // reciprocal semi-major axis
+
+    // a short step starts from chi's Taylor series in dt (dchi/dt = sqrt(mu) / r), which leaves Newton a step or two;
+    // longer ones from the elliptic guess, also a reasonable start for near-parabolic and hyperbolic orbits
+    const double radialStep = vr0 * dt / r0;
+    double chi = sqrtMu * dt / r0 * (1.0 - 0.5 * radialStep);
+    if (std::abs(alpha) * chi * chi > 0.1 || std::abs(radialStep) > 0.5)
+    {
+        chi = sqrtMu * std::abs(alpha) * dt;
+        if (std::abs(alpha) < 1e-12 || std::abs(chi) > 1e6)
+            chi = sqrtMu * dt / r0;
+    }
+
+    double c2 = 0.5, c3 = 1.0 / 6.0;
+    bool converged = false;
+    for (int it = 0; it < 50; it++)
+    {
+        double chiSq = chi * chi;
+        double z = alpha * chiSq;
+        stumpff(z, c2, c3);
+        double f = r0 * vr0 / sqrtMu * chiSq * c2 + (1.0 - alpha * r0) * chiSq * chi * c3 + r0 * chi - sqrtMu * dt;
+        double df = r0 * vr0 / sqrtMu * chi * (1.0 - z * c3) + (1.0 - alpha * r0) * chiSq * c2 + r0;
+        if (df == 0.0)
+            break;
+        double delta = f / df;
+        chi -= delta;
+        if (std::abs(delta) <= 1e-12 * std::max(1.0, std::abs(chi)))
+        {
+            converged = true;
+            break;
+        }
+    }
+    if (!converged || !std::isfinite(chi))
+        return false;
+
+    double chiSq = chi * chi;
+    stumpff(alpha * chiSq, c2, c3);
+    double f = 1.0 - chiSq / r0 * c2;
+    double g = dt - chiSq * chi / sqrtMu * c3;
+    glm::dvec3 rNew = f * r + g * v;
+    double rn = glm::length(rNew);
+    if (rn <= 0.0)
+        return false;
+    double fDot = sqrtMu / (rn * r0) * (alpha * chiSq * chi * c3 - chi);
+    double gDot = 1.0 - chiSq / rn * c2;
+    v = fDot * r + gDot * v;
+    r = rNew;
+    return true;
+}
+
+#endif
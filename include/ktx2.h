@@ -0,0 +1,254 @@
+#ifndef KTX2_H
+#define KTX2_H
+
+#include <texture_compress.h>
+#include <asset_archive.h>
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+// KTX2 files of one block-compressed 2D image with its mip levels, no supercompression, which is what the texture
+// cache writes and reads back. The data format descriptor is the basic block for BC4, BC5 or BC7, and one
+// key/value entry (KTX2_SOURCE_KEY) names the source image a file was cooked from, so a stale file is ignored.
+// Levels are stored smallest first, as the format asks, each 16-byte aligned.
+namespace ktx2 {
+
+static const uint8_t IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+static const char SOURCE_KEY[] = "NPSCsource";
+
+enum VkFormat : uint32_t {
+    VK_FORMAT_BC4_UNORM_BLOCK = 139,
+    VK_FORMAT_BC5_UNORM_BLOCK = 141,
+    VK_FORMAT_BC7_UNORM_BLOCK = 145,
+    VK_FORMAT_BC7_SRGB_BLOCK = 146
+};
+
+struct Header
+{
+    uint8_t identifier[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+};
+
+struct LevelIndex
+{
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+};
+
+static_assert(sizeof(Header) == 80 && sizeof(LevelIndex) == 24, "KTX2 header layout");
+
+inline uint32_t vkFormatFor(GLenum internalFormat)
+{
+    switch (internalFormat)
+    {
+    case GL_COMPRESSED_RED_RGTC1: return VK_FORMAT_BC4_UNORM_BLOCK;
+    case GL_COMPRESSED_RG_RGTC2: return VK_FORMAT_BC5_UNORM_BLOCK;
+    case GL_COMPRESSED_RGBA_BPTC_UNORM: return VK_FORMAT_BC7_UNORM_BLOCK;
+    case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM: return VK_FORMAT_BC7_SRGB_BLOCK;
+    default: return 0;
+    }
+}
+
+inline GLenum glFormatFor(uint32_t vkFormat)
+{
+    switch (vkFormat)
+    {
+    case VK_FORMAT_BC4_UNORM_BLOCK: return GL_COMPRESSED_RED_RGTC1;
+    case VK_FORMAT_BC5_UNORM_BLOCK: return GL_COMPRESSED_RG_RGTC2;
+    case VK_FORMAT_BC7_UNORM_BLOCK: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    case VK_FORMAT_BC7_SRGB_BLOCK: return GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+    default: return 0;
+    }
+}
+
+inline void append(std::vector<uint8_t>& out, const void* data, size_t bytes)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    out.insert(out.end(), p, p + bytes);
+}
+
+// the basic data format descriptor of a 4x4 block format: colour model, transfer function, one sample per channel
+inline std::vector<uint8_t> dataFormatDescriptor(uint32_t vkFormat)
+{
+    const bool bc4 = vkFormat == VK_FORMAT_BC4_UNORM_BLOCK, bc5 = vkFormat == VK_FORMAT_BC5_UNORM_BLOCK;
+    const uint32_t samples = bc5 ? 2 : 1;
+    const uint8_t colorModel = bc4 ? 131 : bc5 ? 132 : 134;                   // KHR_DF_MODEL_BC4, BC5, BC7
+    const uint8_t transfer = vkFormat == VK_FORMAT_BC7_SRGB_BLOCK ? 2 : 1;    // KHR_DF_TRANSFER_SRGB, LINEAR
+    const uint32_t blockSize = 24 + 16 * samples;
+    std::vector<uint8_t> dfd;
+    const uint32_t total = 4 + blockSize;
+    append(dfd, &total, 4);
+    const uint32_t vendorAndType = 0;                           // Khronos, basic descriptor
+    append(dfd, &vendorAndType, 4);
+    const uint16_t version = 2, size = static_cast<uint16_t>(blockSize);
+    append(dfd, &version, 2);
+    append(dfd, &size, 2);
+    const uint8_t model[4] = {colorModel, 1, transfer, 0};     // BT.709 primaries, straight alpha
+    append(dfd, model, 4);
+    const uint8_t blockDimension[4] = {3, 3, 0, 0};           // 4x4x1x1, stored minus one
+    append(dfd, blockDimension, 4);
+    const uint8_t bytesPlane[8] = {static_cast<uint8_t>(bc4 ? 8 : 16), 0, 0, 0, 0, 0, 0, 0};
+    append(dfd, bytesPlane, 8);
+    for (uint32_t s = 0; s < samples; s++)
+    {
+        const uint16_t bitOffset = static_cast<uint16_t>(64 * s);
+        const uint8_t bitLength = bc4 || bc5 ? 63 : 127;
+        const uint8_t channel = static_cast<uint8_t>(s);         // red then green, the one colour channel of BC7
+        const uint8_t position[4] = {0, 0, 0, 0};
+        const uint32_t lower = 0, upper = 0xFFFFFFFFu;
+        append(dfd, &bitOffset, 2);
+        append(dfd, &bitLength, 1);
+        append(dfd, &channel, 1);
+        append(dfd, position, 4);
+        append(dfd, &lower, 4);
+        append(dfd, &upper, 4);
+    }
+    return dfd;
+}
+
+// writes image under path (through a temporary file), source is the value stored under SOURCE_KEY
+inline bool write(const std::string& path, const CompressedImage& image, const std::string& source)
+{
+    const uint32_t vkFormat = vkFormatFor(image.internalFormat);
+    if (vkFormat == 0 || image.levels.empty())
+        return false;
+    const std::vector<uint8_t> dfd = dataFormatDescriptor(vkFormat);
+    std::vector<uint8_t> kvd;
+    const uint32_t entryBytes = static_cast<uint32_t>(sizeof(SOURCE_KEY) + source.size() + 1);
+    append(kvd, &entryBytes, 4);
+    append(kvd, SOURCE_KEY, sizeof(SOURCE_KEY));
+    append(kvd, source.c_str(), source.size() + 1);
+    kvd.resize((kvd.size() + 3) & ~size_t(3), 0);
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.identifier, IDENTIFIER, sizeof(IDENTIFIER));
+    header.vkFormat = vkFormat;
+    header.typeSize = 1;
+    header.pixelWidth = static_cast<uint32_t>(image.width);
+    header.pixelHeight = static_cast<uint32_t>(image.height);
+    header.faceCount = 1;
+    header.levelCount = static_cast<uint32_t>(image.levels.size());
+    header.dfdByteOffset = static_cast<uint32_t>(sizeof(Header) + image.levels.size() * sizeof(LevelIndex));
+    header.dfdByteLength = static_cast<uint32_t>(dfd.size());
+    header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+    header.kvdByteLength = static_cast<uint32_t>(kvd.size());
+
+    std::vector<LevelIndex> levels(image.levels.size());
+    uint64_t offset = header.kvdByteOffset + header.kvdByteLength;
+    for (size_t l = image.levels.size(); l-- > 0;)
+    {
+        offset = (offset + 15) & ~uint64_t(15);
+        levels[l].byteOffset = offset;
+        levels[l].byteLength = levels[l].uncompressedByteLength = image.levels[l].size();
+        offset += image.levels[l].size();
+    }
+
+    std::vector<uint8_t> file;
+    file.reserve(offset);
+    append(file, &header, sizeof(header));
+    append(file, levels.data(), levels.size() * sizeof(LevelIndex));
+    append(file, dfd.data(), dfd.size());
+    append(file, kvd.data(), kvd.size());
+    for (size_t l = image.levels.size(); l-- > 0;)
+    {
+        file.resize(levels[l].byteOffset, 0);
+        append(file, image.levels[l].data(), image.levels[l].size());
+    }
+
+    const std::string partial = path + ".partial";
+    FILE* f = std::fopen(partial.c_str(), "wb");
+    if (!f)
+        return false;
+    bool ok = std::fwrite(file.data(), 1, file.size(), f) == file.size();
+    ok = std::fclose(f) == 0 && ok;
+    ok = ok && std::rename(partial.c_str(), path.c_str()) == 0;
+    if (!ok)
+        std::remove(partial.c_str());
+    return ok;
+}
+
+// the value of SOURCE_KEY in a mapped file's key/value data, empty if it has none
+inline std::string sourceOf(const AssetFile& file, const Header& header)
+{
+    const uint8_t* kvd = file.data() + header.kvdByteOffset;
+    size_t pos = 0;
+    while (pos + 4 <= header.kvdByteLength)
+    {
+        uint32_t entryBytes;
+        std::memcpy(&entryBytes, kvd + pos, 4);
+        if (entryBytes > header.kvdByteLength - pos - 4)
+            break;
+        const char* entry = reinterpret_cast<const char*>(kvd + pos + 4);
+        if (entryBytes > sizeof(SOURCE_KEY) && std::memcmp(entry, SOURCE_KEY, sizeof(SOURCE_KEY)) == 0)
+            return std::string(entry + sizeof(SOURCE_KEY), strnlen(entry + sizeof(SOURCE_KEY), entryBytes - sizeof(SOURCE_KEY)));
+        pos = (pos + 4 + entryBytes + 3) & ~size_t(3);
+    }
+    return std::string();
+}
+
+// reads a file written by write() back, false if it is missing, not one of ours, or cooked from another source.
+// With a maxExtent only the levels from firstLevelWithin on are copied out of the mapping, the finer ones stay empty.
+inline bool read(const std::string& path, const std::string& source, CompressedImage& image, unsigned int maxExtent = 0)
+{
+    AssetFile file;
+    if (!file.open(path.c_str(), true) || file.size() < sizeof(Header))
+        return false;
+    Header header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    const GLenum format = glFormatFor(header.vkFormat);
+    const uint64_t size = file.size();
+    if (std::memcmp(header.identifier, IDENTIFIER, sizeof(IDENTIFIER)) != 0 || format == 0 || header.faceCount != 1
+        || header.layerCount > 1 || header.pixelDepth > 1 || header.supercompressionScheme != 0 || header.levelCount == 0
+        || header.pixelWidth == 0 || header.pixelHeight == 0
+        || sizeof(Header) + uint64_t(header.levelCount) * sizeof(LevelIndex) > size
+        || uint64_t(header.kvdByteOffset) + header.kvdByteLength > size)
+        return false;
+    if (sourceOf(file, header) != source)
+        return false;
+
+    image = CompressedImage();
+    image.internalFormat = format;
+    image.width = static_cast<int>(header.pixelWidth);
+    image.height = static_cast<int>(header.pixelHeight);
+    image.blockBytes = format == GL_COMPRESSED_RED_RGTC1 ? 8 : 16;
+    image.firstLevel = firstLevelWithin(image.width, image.height, header.levelCount, maxExtent);
+    int w = image.width, h = image.height;
+    for (uint32_t l = 0; l < header.levelCount; l++)
+    {
+        LevelIndex level;
+        std::memcpy(&level, file.data() + sizeof(Header) + l * sizeof(LevelIndex), sizeof(level));
+        const uint64_t expected = uint64_t((w + 3) / 4) * ((h + 3) / 4) * image.blockBytes;
+        if (level.byteOffset > size || level.byteLength != expected || level.byteLength > size - level.byteOffset)
+            return false;
+        if (l < image.firstLevel)
+            image.levels.emplace_back();
+        else
+            image.levels.emplace_back(file.data() + level.byteOffset, file.data() + level.byteOffset + level.byteLength);
+        w = std::max(w / 2, 1);
+        h = std::max(h / 2, 1);
+    }
+    return true;
+}
+
+} // namespace ktx2
+
+#endif
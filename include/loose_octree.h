@@ -0,0 +1,304 @@
+#ifndef LOOSE_OCTREE_H
+#define LOOSE_OCTREE_H
+
+#include <glm.hpp>
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+// A sphere for forEachIntersecting, in the same terms as a Frustum (instance_data.h)
+struct BoundingSphere
+{
+    glm::vec3 center;
+    float radius;
+
+    bool intersectsSphere(const glm::vec3& c, float r) const
+    {
+        const glm::vec3 d = c - center;
+        return glm::dot(d, d) <= (radius + r) * (radius + r);
+    }
+};
+
+// Bounding spheres keyed by stable ids in a loose octree (looseness 2): a sphere of radius r sits in the deepest
+// node whose cell is at least r across on each side of its centre and holds the centre, so the node's bounds doubled
+// hold the whole sphere and a sphere never straddles nodes. The depth follows from the radius and the cell from the
+// centre, so update() on a sphere that stayed in its cell only stores it, and one that left unlinks and relinks it
+// down a single path of at most maxDepth nodes, creating the nodes it needs; nodes that empty are freed on the way
+// back up. Queries descend only into nodes whose loose bounds they meet. Spheres whose centre is outside the root's
+// cell are kept in the root, which every query visits.
+class LooseOctree
+{
+public:
+    static constexpr uint32_t NONE = 0xffffffffu;
+    static const unsigned int MAX_DEPTH = 16;
+
+    // drops every sphere; the root cell is halfSize on each side of center
+    void reset(const glm::vec3& center, float halfSize, unsigned int maxDepth = 10)
+    {
+        nodes.clear();
+        freeNodes.clear();
+        entries.clear();
+        tracked = 0;
+        generation = 0;
+        depthLimit = std::min(maxDepth, MAX_DEPTH);
+        Node root;
+        root.center = center;
+        root.halfSize = halfSize;
+        nodes.push_back(root);
+    }
+
+    size_t size() const { return tracked; }
+    size_t nodeCount() const { return nodes.size() - freeNodes.size(); }
+    bool contains(uint32_t id) const { return id < entries.size() && entries[id].node != NONE; }
+
+    // puts id's sphere at center, moving it to another node only if it left its own's cell or changed size enough
+    // to belong at another depth
+    void update(uint32_t id, const glm::vec3& center, float radius)
+    {
+        if (nodes.empty())
+            reset(glm::vec3(0.0f), 1.0f);
+        if (id >= entries.size())
+            entries.resize(id + 1);
+        Entry& entry = entries[id];
+        entry.center = center;
+        entry.radius = radius;
+        entry.stamp = generation;
+        if (entry.node != NONE && fits(entry.node, center, radius))
+            return;
+        if (entry.node != NONE)
+            unlink(id);
+        else
+            tracked++;
+        link(id, nodeFor(center, radius));
+    }
+
+    void remove(uint32_t id)
+    {
+        if (!contains(id))
+            return;
+        unlink(id);
+        tracked--;
+    }
+
+    // removes every sphere not updated since the last call, for callers that update all of them each frame and
+    // let the ones that are gone drop out
+    void removeStale()
+    {
+        for (uint32_t id = 0; id < entries.size(); id++)
+            if (entries[id].node != NONE && entries[id].stamp != generation)
+                remove(id);
+        generation++;
+    }
+
+    // id's sphere as last updated
+    BoundingSphere sphere(uint32_t id) const
+    {
+        return BoundingSphere{entries[id].center, entries[id].radius};
+    }
+
+    // visits the id of every sphere volume intersects, volume.intersectsSphere(centre - origin, radius) deciding for
+    // the nodes' loose bounds and then for each sphere; origin moves a camera-relative frustum to the tree's space
+    template <typename Volume, typename F>
+    void forEachIntersecting(const Volume& volume, const glm::vec3& origin, const F& visit) const
+    {
+        forEachNode([&](const Node& node) { return volume.intersectsSphere(node.center - origin, looseRadius(node)); },
+                    [&](uint32_t id) {
+                        const Entry& entry = entries[id];
+                        if (volume.intersectsSphere(entry.center - origin, entry.radius))
+                            visit(id);
+                    });
+    }
+
+    // visits the id of every sphere the ray from origin along the unit direction passes through within maxDistance
+    template <typename F>
+    void forEachOnRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, const F& visit) const
+    {
+        forEachNode([&](const Node& node) { return rayMeets(origin, direction, maxDistance, node.center, looseRadius(node)); },
+                    [&](uint32_t id) {
+                        const Entry& entry = entries[id];
+                        if (rayMeets(origin, direction, maxDistance, entry.center, entry.radius))
+                            visit(id);
+                    });
+    }
+
+    // visits every node's cell as (center, halfSize, spheres in its subtree), the debug view of the tree
+    template <typename F>
+    void forEachCell(const F& visit) const
+    {
+        for (size_t n = 0; n < nodes.size(); n++)
+            if (n == 0 || nodes[n].parent != NONE)
+                visit(nodes[n].center, nodes[n].halfSize, nodes[n].count);
+    }
+
+private:
+    struct Node
+    {
+        glm::vec3 center = glm::vec3(0.0f);
+        float halfSize = 0.0f;              // of the cell, the loose bounds are twice it
+        uint32_t parent = NONE;
+        uint32_t children[8] = {NONE, NONE, NONE, NONE, NONE, NONE, NONE, NONE};
+        uint32_t first = NONE;              // the node's own spheres, linked through the entries
+        uint32_t count = 0;                 // spheres in the subtree
+        unsigned int depth = 0;
+        unsigned int slot = 0;              // in the parent's children
+    };
+
+    struct Entry
+    {
+        glm::vec3 center = glm::vec3(0.0f);
+        float radius = 0.0f;
+        uint32_t node = NONE;
+        uint32_t prev = NONE, next = NONE;
+        uint32_t stamp = 0;
+    };
+
+    std::vector<Node> nodes;                // the root is nodes[0]
+    std::vector<uint32_t> freeNodes;
+    std::vector<Entry> entries;
+    size_t tracked = 0;
+    uint32_t generation = 0;
+    unsigned int depthLimit = 10;
+
+    static float looseRadius(const Node& node)
+    {
+        return 2.0f * node.halfSize * 1.7320508f;
+    }
+
+    static bool rayMeets(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, const glm::vec3& center, float radius)
+    {
+        const glm::vec3 toCenter = center - origin;
+        const float along = glm::dot(toCenter, direction);
+        const float missSq = glm::dot(toCenter, toCenter) - along * along;
+        return missSq <= radius * radius && along + radius >= 0.0f && along - radius <= maxDistance;
+    }
+
+    // the depth a sphere of radius belongs at: the deepest whose cells are at least radius on each side
+    unsigned int depthFor(float radius) const
+    {
+        unsigned int depth = 0;
+        float half = nodes[0].halfSize;
+        while (depth < depthLimit && radius <= 0.5f * half)
+        {
+            half *= 0.5f;
+            depth++;
+        }
+        return depth;
+    }
+
+    bool insideCell(const Node& node, const glm::vec3& p) const
+    {
+        const glm::vec3 d = glm::abs(p - node.center);
+        return d.x <= node.halfSize && d.y <= node.halfSize && d.z <= node.halfSize;
+    }
+
+    bool fits(uint32_t n, const glm::vec3& center, float radius) const
+    {
+        const Node& node = nodes[n];
+        if (n == 0)
+            return !insideCell(node, center) || depthFor(radius) == 0;
+        return node.depth == depthFor(radius) && insideCell(node, center);
+    }
+
+    // the node for a sphere, made along with those above it where they are missing
+    uint32_t nodeFor(const glm::vec3& center, float radius)
+    {
+        if (!insideCell(nodes[0], center))
+            return 0;
+        const unsigned int depth = depthFor(radius);
+        uint32_t n = 0;
+        while (nodes[n].depth < depth)
+        {
+            const glm::vec3 c = nodes[n].center;
+            const unsigned int slot = (center.x >= c.x ? 1u : 0u) | (center.y >= c.y ? 2u : 0u) | (center.z >= c.z ? 4u : 0u);
+            uint32_t child = nodes[n].children[slot];
+            if (child == NONE)
+            {
+                child = allocateNode();
+                Node& made = nodes[child];
+                const float half = 0.5f * nodes[n].halfSize;
+                made.center = c + glm::vec3(slot & 1u ? half : -half, slot & 2u ? half : -half, slot & 4u ? half : -half);
+                made.halfSize = half;
+                made.parent = n;
+                made.depth = nodes[n].depth + 1;
+                made.slot = slot;
+                nodes[n].children[slot] = child;
+            }
+            n = child;
+        }
+        return n;
+    }
+
+    uint32_t allocateNode()
+    {
+        if (!freeNodes.empty())
+        {
+            const uint32_t n = freeNodes.back();
+            freeNodes.pop_back();
+            nodes[n] = Node();
+            return n;
+        }
+        nodes.push_back(Node());
+        return static_cast<uint32_t>(nodes.size() - 1);
+    }
+
+    void link(uint32_t id, uint32_t n)
+    {
+        Entry& entry = entries[id];
+        entry.node = n;
+        entry.prev = NONE;
+        entry.next = nodes[n].first;
+        if (entry.next != NONE)
+            entries[entry.next].prev = id;
+        nodes[n].first = id;
+        for (uint32_t m = n; m != NONE; m = nodes[m].parent)
+            nodes[m].count++;
+    }
+
+    // takes id out of its node and frees the nodes that are left empty, never the root
+    void unlink(uint32_t id)
+    {
+        Entry& entry = entries[id];
+        const uint32_t n = entry.node;
+        if (entry.prev != NONE)
+            entries[entry.prev].next = entry.next;
+        else
+            nodes[n].first = entry.next;
+        if (entry.next != NONE)
+            entries[entry.next].prev = entry.prev;
+        entry.node = entry.prev = entry.next = NONE;
+        for (uint32_t m = n; m != NONE; m = nodes[m].parent)
+            nodes[m].count--;
+        for (uint32_t m = n; m != 0 && nodes[m].count == 0;)
+        {
+            const uint32_t parent = nodes[m].parent;
+            nodes[parent].children[nodes[m].slot] = NONE;
+            nodes[m].parent = NONE;
+            freeNodes.push_back(m);
+            m = parent;
+        }
+    }
+
+    // depth first from the root, into the nodes enter accepts; the root is always entered
+    template <typename Enter, typename Visit>
+    void forEachNode(const Enter& enter, const Visit& visit) const
+    {
+        if (nodes.empty() || nodes[0].count == 0)
+            return;
+        uint32_t stack[7 * MAX_DEPTH + 8];
+        unsigned int top = 0;
+        stack[top++] = 0;
+        while (top > 0)
+        {
+            const Node& node = nodes[stack[--top]];
+            for (uint32_t id = node.first; id != NONE; id = entries[id].next)
+                visit(id);
+            for (uint32_t child : node.children)
+                if (child != NONE && enter(nodes[child]))
+                    stack[top++] = child;
+        }
+    }
+};
+
+#endif
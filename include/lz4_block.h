@@ -0,0 +1,135 @@
+#ifndef LZ4_BLOCK_H
+#define LZ4_BLOCK_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// The LZ4 block format (sequences of a token, literals and a 16-bit back reference), so files packed here decode
+// with any LZ4 implementation and the other way around. compress() is a greedy single-probe hash matcher, about what
+// LZ4's fast mode does: it is run once when packing. decompress() checks every length and offset against the
+// buffers, a corrupt block fails instead of reading or writing outside them.
+namespace lz4 {
+
+static const size_t MIN_MATCH = 4;
+static const size_t LAST_LITERALS = 5;      // a block always ends in at least this many literals
+static const size_t MATCH_LIMIT = 12;       // and its last match starts at least this far from the end
+static const size_t MAX_OFFSET = 65535;
+
+inline uint32_t read32(const uint8_t* p)
+{
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// a length of 15 or more continues in bytes of 255 and a last one below
+inline void writeLength(std::vector<uint8_t>& out, size_t length)
+{
+    for (; length >= 255; length -= 255)
+        out.push_back(255);
+    out.push_back(static_cast<uint8_t>(length));
+}
+
+inline void writeSequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t literalCount, size_t offset, size_t matchLength)
+{
+    const size_t match = matchLength >= MIN_MATCH ? matchLength - MIN_MATCH : 0;
+    out.push_back(static_cast<uint8_t>(((literalCount < 15 ? literalCount : 15) << 4) | (match < 15 ? match : 15)));
+    if (literalCount >= 15)
+        writeLength(out, literalCount - 15);
+    out.insert(out.end(), literals, literals + literalCount);
+    if (matchLength == 0)
+        return;
+    out.push_back(static_cast<uint8_t>(offset & 0xff));
+    out.push_back(static_cast<uint8_t>(offset >> 8));
+    if (match >= 15)
+        writeLength(out, match - 15);
+}
+
+// one block of bytes[0, n)
+inline std::vector<uint8_t> compress(const uint8_t* bytes, size_t n)
+{
+    static const unsigned int HASH_BITS = 16;
+    std::vector<uint8_t> out;
+    out.reserve(n / 2 + 16);
+    std::vector<uint32_t> table(size_t(1) << HASH_BITS, UINT32_MAX);
+    size_t anchor = 0, i = 0;
+    const size_t limit = n > MATCH_LIMIT ? n - MATCH_LIMIT : 0;
+    while (i < limit)
+    {
+        const uint32_t sequence = read32(bytes + i);
+        const uint32_t h = (sequence * 2654435761u) >> (32 - HASH_BITS);
+        const uint32_t candidate = table[h];
+        table[h] = static_cast<uint32_t>(i);
+        if (candidate == UINT32_MAX || i - candidate > MAX_OFFSET || read32(bytes + candidate) != sequence)
+        {
+            i++;
+            continue;
+        }
+        size_t length = MIN_MATCH;
+        const size_t longest = n - LAST_LITERALS - i;
+        while (length < longest && bytes[candidate + length] == bytes[i + length])
+            length++;
+        writeSequence(out, bytes + anchor, i - anchor, i - candidate, length);
+        i += length;
+        anchor = i;
+    }
+    writeSequence(out, bytes + anchor, n - anchor, 0, 0);
+    return out;
+}
+
+// a block into exactly bytes of out, false if it is corrupt or decodes to any other size
+inline bool decompress(const uint8_t* block, size_t blockBytes, uint8_t* out, size_t bytes)
+{
+    const uint8_t* in = block;
+    const uint8_t* const inEnd = block + blockBytes;
+    uint8_t* op = out;
+    uint8_t* const outEnd = out + bytes;
+    auto readLength = [&](size_t& length) {
+        uint8_t b = 255;
+        while (b == 255)
+        {
+            if (in >= inEnd)
+                return false;
+            b = *in++;
+            length += b;
+        }
+        return true;
+    };
+    while (in < inEnd)
+    {
+        const uint8_t token = *in++;
+        size_t literals = token >> 4;
+        if (literals == 15 && !readLength(literals))
+            return false;
+        if (literals > static_cast<size_t>(inEnd - in) || literals > static_cast<size_t>(outEnd - op))
+            return false;
+        std::memcpy(op, in, literals);
+        in += literals;
+        op += literals;
+        // the last sequence is literals only
+        if (in == inEnd)
+            break;
+        if (inEnd - in < 2)
+            return false;
+        const size_t offset = static_cast<size_t>(in[0]) | (static_cast<size_t>(in[1]) << 8);
+        in += 2;
+        size_t length = token & 15;
+        if (length == 15 && !readLength(length))
+            return false;
+        length += MIN_MATCH;
+        if (offset == 0 || offset > static_cast<size_t>(op - out) || length > static_cast<size_t>(outEnd - op))
+            return false;
+        // byte by byte, a match may overlap what it copies
+        const uint8_t* from = op - offset;
+        for (size_t k = 0; k < length; k++)
+            op[k] = from[k];
+        op += length;
+    }
+    return op == outEnd;
+}
+
+} // namespace lz4
+
+#endif
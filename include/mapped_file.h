@@ -0,0 +1,169 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// Read-only memory mapping of a whole file (POSIX). The pages are faulted in by the kernel as they are touched,
+// populate asks for all of them up front, which is much cheaper when the whole file will be read anyway.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile()
+    {
+        close();
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const char* path, bool populate = false)
+    {
+        close();
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size <= 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        int mapFlags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+        if (populate) mapFlags |= MAP_POPULATE;
+#else
+        (void)populate;
+#endif
+        void* mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, mapFlags, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED)
+            return false;
+        bytes = static_cast<size_t>(st.st_size);
+        base = static_cast<const unsigned char*>(mapped);
+        return true;
+    }
+
+    void close()
+    {
+        if (base)
+            munmap(const_cast<unsigned char*>(base), bytes);
+        base = nullptr;
+        bytes = 0;
+    }
+
+    // hints that [offset, offset + length) is read soon, the kernel starts reading it in the background
+    void prefetch(size_t offset, size_t length) const
+    {
+        if (!base || offset >= bytes)
+            return;
+        const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+        uintptr_t begin = reinterpret_cast<uintptr_t>(base + offset) & ~(page - 1);
+        uintptr_t end = reinterpret_cast<uintptr_t>(base + (offset + length < bytes ? offset + length : bytes));
+        madvise(reinterpret_cast<void*>(begin), end - begin, MADV_WILLNEED);
+    }
+
+    bool isOpen() const { return base != nullptr; }
+    const unsigned char* data() const { return base; }
+    size_t size() const { return bytes; }
+
+private:
+    const unsigned char* base = nullptr;
+    size_t bytes = 0;
+};
+
+// Shared read-write mapping of a file made to a given size (POSIX), what a process works on in place when the data
+// is larger than its memory: stores go to the page cache and from there to the file, and the kernel evicts clean
+// pages under pressure. flush starts the write-back so the pages it covers become cheap to evict.
+class MappedWritableFile
+{
+public:
+    MappedWritableFile() = default;
+    ~MappedWritableFile()
+    {
+        close();
+    }
+
+    MappedWritableFile(const MappedWritableFile&) = delete;
+    MappedWritableFile& operator=(const MappedWritableFile&) = delete;
+
+    // creates or truncates path to size bytes, which read as zero until written
+    bool create(const char* path, size_t size)
+    {
+        close();
+        if (size == 0)
+            return false;
+        int fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            return false;
+        if (ftruncate(fd, static_cast<off_t>(size)) != 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED)
+            return false;
+        bytes = size;
+        base = static_cast<unsigned char*>(mapped);
+        return true;
+    }
+
+    void close()
+    {
+        if (base)
+            munmap(base, bytes);
+        base = nullptr;
+        bytes = 0;
+    }
+
+    // asynchronous write-back of [offset, offset + length)
+    void flush(size_t offset, size_t length) const
+    {
+        advise(offset, length, -1);
+    }
+
+    // as MappedFile::prefetch
+    void prefetch(size_t offset, size_t length) const
+    {
+        advise(offset, length, MADV_WILLNEED);
+    }
+
+    // the whole mapping is about to be read front to back (or not), so the kernel reads ahead further
+    void sequential(bool on) const
+    {
+        if (base)
+            madvise(base, bytes, on ? MADV_SEQUENTIAL : MADV_NORMAL);
+    }
+
+    bool isOpen() const { return base != nullptr; }
+    unsigned char* data() const { return base; }
+    size_t size() const { return bytes; }
+
+private:
+    unsigned char* base = nullptr;
+    size_t bytes = 0;
+
+    // madvise over the whole pages of the range, msync for advice -1
+    void advise(size_t offset, size_t length, int advice) const
+    {
+        if (!base || offset >= bytes || length == 0)
+            return;
+        const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+        uintptr_t begin = reinterpret_cast<uintptr_t>(base + offset) & ~(page - 1);
+        uintptr_t end = reinterpret_cast<uintptr_t>(base + (offset + length < bytes ? offset + length : bytes));
+        if (advice < 0)
+            msync(reinterpret_cast<void*>(begin), end - begin, MS_ASYNC);
+        else
+            madvise(reinterpret_cast<void*>(begin), end - begin, advice);
+    }
+};
+
+#endif
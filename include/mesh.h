@@ -5,21 +5,28 @@
 #include <gtc/matrix_transform.hpp>
 
 #include <shader.h>
+#include <vertex_layout.h>
+#include <geometry_pool.h>
+#include <gpu_memory.h>
+#include <instance_buffer.h>
+#include <mesh_simplify.h>
+#include <mesh_optimize.h>
+#include <meshlet.h>
+#include <mesh_bvh.h>
 
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <utility>
 
-#define MAX_BONE_INFLUENCE 4
+#define MAX_MESH_LODS 4
 
-struct Vertex
+// one level of detail, a range of the mesh's element buffer
+struct MeshLod
 {
-    glm::vec3 Position;
-    glm::vec3 Normal;
-    glm::vec2 TexCoords;
-    glm::vec3 Tangent;
-    glm::vec3 Bitangent;
-    int m_BoneIDs[MAX_BONE_INFLUENCE];
-    float m_Weights[MAX_BONE_INFLUENCE];
+    unsigned int firstIndex;
+    unsigned int count;
 };
 
 struct Texture
@@ -29,95 +36,420 @@ struct Texture
     std::string path;
 };
 
+// a texture unit of a mesh and what is bound to it, resolved once when the mesh is made
+struct TextureBinding
+{
+    unsigned int unit;
+    unsigned int id;
+};
+
+// the box around the vertices and the farthest one from the origin, left as they are for no vertices
+inline void vertexBounds(const std::vector<Vertex>& vertices, glm::vec3& boundsMin, glm::vec3& boundsMax, float& boundingRadius)
+{
+    if (vertices.empty())
+        return;
+    boundsMin = boundsMax = vertices[0].Position;
+    boundingRadius = 0.0f;
+    for (const Vertex& v : vertices)
+    {
+        boundsMin = glm::min(boundsMin, v.Position);
+        boundsMax = glm::max(boundsMax, v.Position);
+        boundingRadius = std::max(boundingRadius, glm::length(v.Position));
+    }
+}
+
 class Mesh
 {
 public:
+    // CPU copies of what was uploaded, empty after releaseCpuData; the counts and bounds below stay valid
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
     std::vector<Texture> textures;
+    unsigned int vertexCount = 0;
+    unsigned int indexCount = 0;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    float boundingRadius = 0.0f;    // farthest vertex from the mesh origin
+    bool retainCpuData = false;     // picking or collision reads the vertices, releaseCpuData keeps them
+    MeshBvh bvh;                    // over the triangles of the full level for ray queries, keeps its own copy of them
+    MeshletSet meshlets;            // of the full level, for the mesh-shader path (meshlet_renderer.h)
+    std::vector<MeshLod> lods;      // lods[0] is indices itself, coarser levels follow it in the element buffer
     unsigned int VAO;
+    // positions alone over the same indices, for depth and shadow passes (createPositionStream), 0 without them
+    unsigned int positionVAO = 0;
+    VertexLayout layout = VERTEX_LAYOUT_FULL;
+    // a pooled mesh lives in geometryPool() and VAO is the pool's for its layout, draws offset by range. Meshes
+    // that get per-instance attributes on their VAO (the asteroids) need their own.
+    bool pooled = false;
+    GeometryRange range{0, 0, 0};
+    // of the element buffer; GL_UNSIGNED_SHORT only for an unpooled mesh made with compactIndices, which then must
+    // be drawn through drawElements (or with indexType and indexSize) rather than assuming 32-bit indices
+    GLenum indexType = GL_UNSIGNED_INT;
 
-    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures)
+    // takes the vectors over, pass them with std::move. compactIndices uploads 16-bit indices when every vertex
+    // can be reached with them and the mesh is not pooled (the pool's element buffer is 32-bit).
+    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, VertexLayout layout = VERTEX_LAYOUT_FULL,
+         bool pooled = false, bool compactIndices = false)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
+        this->textures = std::move(textures);
+        this->layout = layout;
+        this->pooled = pooled;
+        vertexCount = static_cast<unsigned int>(this->vertices.size());
+        indexCount = static_cast<unsigned int>(this->indices.size());
+        indexType = compactIndices && !pooled && vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        computeBounds();
 
         setupMesh();
+        resolveTextureBindings();
     }
 
-    Mesh() : VAO(0), VBO(0), EBO(0) {}
+    Mesh() : VAO(0) {}
+
+    // a mesh owns GL names, so it only moves: a copy would alias them, a moved-from mesh is left empty
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
+    Mesh(Mesh&& other) noexcept : VAO(0)
+    {
+        *this = std::move(other);
+    }
+
+    Mesh& operator=(Mesh&& other) noexcept
+    {
+        if (this == &other)
+            return *this;
+        vertices = std::move(other.vertices);
+        indices = std::move(other.indices);
+        textures = std::move(other.textures);
+        vertexCount = std::exchange(other.vertexCount, 0u);
+        indexCount = std::exchange(other.indexCount, 0u);
+        boundsMin = other.boundsMin;
+        boundsMax = other.boundsMax;
+        boundingRadius = other.boundingRadius;
+        retainCpuData = other.retainCpuData;
+        bvh = std::move(other.bvh);
+        meshlets = std::move(other.meshlets);
+        lods = std::move(other.lods);
+        VAO = std::exchange(other.VAO, 0u);
+        positionVAO = std::exchange(other.positionVAO, 0u);
+        layout = other.layout;
+        pooled = other.pooled;
+        range = other.range;
+        indexType = other.indexType;
+        instanceLayout = std::exchange(other.instanceLayout, nullptr);
+        instanceVersion = std::exchange(other.instanceVersion, 0u);
+        ownVao = std::move(other.ownVao);
+        vbo = std::move(other.vbo);
+        positionVao = std::move(other.positionVao);
+        positionVbo = std::move(other.positionVbo);
+        ebo = std::move(other.ebo);
+        textureBindings = std::move(other.textureBindings);
+        samplerNames = std::move(other.samplerNames);
+        samplerLayout = other.samplerLayout;
+        return *this;
+    }
+
+    // adds coarser levels after the full mesh, each with about ratio times the triangles of the one before,
+    // and re-uploads the element buffer with all of them (a pooled mesh appends them to the pool)
+    void generateLods(unsigned int levels, float ratio)
+    {
+        // simplification needs the CPU copies
+        if (!hasCpuData())
+            return;
+        adoptLods(simplifyLods(vertices, indices, levels, ratio));
+    }
+
+    // the index lists of the levels below the full mesh, coarsest last. Touches no GL, a loader thread can call it
+    // on a mesh before it is made and hand the result to adoptLods.
+    static std::vector<std::vector<unsigned int>> simplifyLods(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+                                                               unsigned int levels, float ratio)
+    {
+        std::vector<std::vector<unsigned int>> coarser;
+        coarser.reserve(MAX_MESH_LODS);     // previous points into it
+        const std::vector<unsigned int>* previous = &indices;
+        for (unsigned int level = 1; level < levels && level < MAX_MESH_LODS; level++)
+        {
+            std::vector<unsigned int> next = simplifyMesh(vertices, *previous, static_cast<size_t>(previous->size() / 3 * ratio));
+            // stop once the surface will not simplify any further
+            if (next.empty() || next.size() >= previous->size())
+                break;
+            // the collapses leave the triangles in the full level's order, which the cache no longer suits
+            next = optimizeVertexCache(next, vertices.size());
+            coarser.push_back(std::move(next));
+            previous = &coarser.back();
+        }
+        return coarser;
+    }
+
+    // uploads levels simplified from this mesh's indices after the full mesh, see simplifyLods
+    void adoptLods(const std::vector<std::vector<unsigned int>>& coarser)
+    {
+        lods.assign(1, MeshLod{firstIndex(), indexCount});
+        if (coarser.empty())
+            return;
+        std::vector<unsigned int> all = indices;
+        for (const std::vector<unsigned int>& level : coarser)
+        {
+            const unsigned int first = pooled ? geometryPool().addIndices(level) : static_cast<unsigned int>(all.size());
+            lods.push_back(MeshLod{first, static_cast<unsigned int>(level.size())});
+            if (!pooled)
+                all.insert(all.end(), level.begin(), level.end());
+        }
+        if (pooled)
+            return;
+        // a new element buffer, the storage being immutable, bound into both vertex arrays in place of the old
+        glState().bindVertexArray(VAO);
+        uploadIndices(all);
+        if (positionVAO != 0)
+        {
+            glState().bindVertexArray(positionVAO);
+            glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo.id());
+        }
+        glState().bindVertexArray(0);
+    }
+
+    // A second vertex stream of the positions alone, 12 bytes a vertex against the layout's 24 to 88, so passes that
+    // only write depth fetch a fraction of the bytes: positionVAO draws the same indices and levels with it, and
+    // instances bound to the mesh are bound to both. A pooled mesh's go into the pool's position buffer for its
+    // layout. Needs the CPU copies, make it before releaseCpuData.
+    void createPositionStream()
+    {
+        if (positionVAO != 0 || !hasCpuData())
+            return;
+        if (pooled)
+        {
+            geometryPool().addPositions(layout, range, vertices);
+            positionVAO = geometryPool().positionVao(layout);
+            return;
+        }
+        positionVAO = positionVao.create(nullptr);
+        positionVbo.create(GL_ARRAY_BUFFER, nullptr);
+        const std::vector<glm::vec3> positions = packPositions(vertices);
+        positionVbo.storage(positions.size() * sizeof(glm::vec3), positions.data(), 0);
+        setPositionAttribute();
+        glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo.id());
+        glState().bindVertexArray(0);
+        instanceVersion = 0;    // the next bindInstances attaches to both
+    }
+
+    // what a depth-only pass binds, the position stream where there is one
+    unsigned int depthVAO() const { return positionVAO != 0 ? positionVAO : VAO; }
+
+    // the requested level, or the coarsest there is. firstIndex counts from the start of VAO's element buffer.
+    MeshLod lod(unsigned int level) const
+    {
+        if (lods.empty())
+            return MeshLod{firstIndex(), indexCount};
+        return lods[std::min<size_t>(level, lods.size() - 1)];
+    }
+
+    // deletes the mesh's own GL names, a pooled mesh's geometry stays in the pool
+    void releaseGpuData()
+    {
+        ownVao.release();
+        vbo.release();
+        ebo.release();
+        positionVao.release();
+        positionVbo.release();
+        VAO = 0;
+        positionVAO = 0;
+    }
+
+    bool hasCpuData() const { return !indices.empty() || vertexCount == 0; }
+
+    // frees the CPU copies once everything that needs them (LODs, batches, bounds) is built, unless retainCpuData
+    void releaseCpuData()
+    {
+        if (retainCpuData)
+            return;
+        std::vector<Vertex>().swap(vertices);
+        std::vector<unsigned int>().swap(indices);
+    }
+
+    // what the mesh's indices are added to, 0 unless it is pooled
+    int baseVertex() const { return pooled ? range.baseVertex : 0; }
+    // the buffer the vertices are in, in layout, from baseVertex() on; for compute passes reading them (skinning)
+    unsigned int vertexBuffer() const { return pooled ? geometryPool().vertices(layout) : vbo.id(); }
+    unsigned int firstIndex() const { return pooled ? range.firstIndex : 0; }
+    size_t indexSize() const { return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int); }
 
     void Draw(Shader &shader)
+    {
+        bindSamplers(shader);
+        bindTextures();
+        glState().bindVertexArray(VAO);
+        drawElements();
+    }
+
+    // depth only, from the position stream when there is one; no samplers or textures
+    void DrawDepth() const
+    {
+        glState().bindVertexArray(depthVAO());
+        drawElements();
+    }
+
+    // count instances of a level of detail, records from baseInstance on, the VAO pointed at them first. A
+    // pooled mesh shares its VAO with every mesh of its layout, which then all read the same instances.
+    void DrawInstanced(Shader &shader, const InstanceBuffer& instances, unsigned int count, unsigned int baseInstance = 0, unsigned int level = 0)
+    {
+        bindSamplers(shader);
+        bindTextures();
+        bindInstances(instances);
+        glState().bindVertexArray(VAO);
+        drawElementsInstanced(count, baseInstance, level);
+    }
+
+    // points the VAO's instance attributes at instances unless they already are, see InstanceBuffer
+    void bindInstances(const InstanceBuffer& instances)
+    {
+        if (instanceVersion == instances.version() || VAO == 0)
+            return;
+        instances.attach(VAO, instanceLayout);
+        if (positionVAO != 0 && positionVAO != VAO)
+            instances.attach(positionVAO, instanceLayout);
+        instanceLayout = &instances.layout();
+        instanceVersion = instances.version();
+    }
+
+    // what Draw binds, for a caller binding it itself (RenderQueue)
+    const std::vector<TextureBinding>& bindings() const { return textureBindings; }
+
+    // the sampler uniforms are program state, they only need setting when the shader was last pointed at a
+    // different layout (most meshes of a model share one). The shader must be in use.
+    // names the mesh's vertex array and buffers in frame captures, pooled meshes share the pool's
+    void label(const std::string& name) const
+    {
+        if (pooled)
+            return;
+        labelObject(GL_VERTEX_ARRAY, VAO, name + " VAO");
+        labelObject(GL_BUFFER, vbo.id(), name + " vertices");
+        labelObject(GL_BUFFER, ebo.id(), name + " indices");
+        if (positionVbo.valid())
+        {
+            labelObject(GL_VERTEX_ARRAY, positionVAO, name + " positions VAO");
+            labelObject(GL_BUFFER, positionVbo.id(), name + " positions");
+        }
+    }
+
+    void bindTextures() const
+    {
+        for (const TextureBinding& binding : textureBindings)
+        {
+            glState().activeTexture(GL_TEXTURE0 + binding.unit);
+            glState().bindTexture(GL_TEXTURE_2D, binding.id);
+        }
+    }
+
+    void bindSamplers(Shader &shader) const
+    {
+        if (shader.samplerLayout == samplerLayout)
+            return;
+        shader.samplerLayout = samplerLayout;
+        for (size_t i = 0; i < textureBindings.size(); i++)
+            shader.setInt(samplerNames[i], static_cast<int>(textureBindings[i].unit));
+    }
+
+    // the draw call alone, with VAO and the textures already bound, of a level of detail (see lod)
+    void drawElements(unsigned int level = 0) const
+    {
+        const MeshLod drawn = lod(level);
+        glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(drawn.count), indexType,
+                                 reinterpret_cast<const void*>(static_cast<size_t>(drawn.firstIndex) * indexSize()), baseVertex());
+    }
+
+    // the same for count instances, with the instances bound as well (bindInstances)
+    void drawElementsInstanced(unsigned int count, unsigned int baseInstance = 0, unsigned int level = 0) const
+    {
+        const MeshLod drawn = lod(level);
+        glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, static_cast<GLsizei>(drawn.count), indexType,
+                                                      reinterpret_cast<const void*>(static_cast<size_t>(drawn.firstIndex) * indexSize()),
+                                                      static_cast<GLsizei>(count), baseVertex(), baseInstance);
+    }
+
+private:
+    // the names of an unpooled mesh, VAO is ownVao's id then. Freed with the mesh, which must go before the context.
+    GlVertexArray ownVao;
+    GlBuffer vbo{GPU_MEMORY_GEOMETRY};
+    GlBuffer ebo{GPU_MEMORY_GEOMETRY};
+    GlVertexArray positionVao;                  // positionVAO of an unpooled mesh
+    GlBuffer positionVbo{GPU_MEMORY_GEOMETRY};
+    std::vector<TextureBinding> textureBindings;
+    std::vector<std::string> samplerNames;      // texture_diffuse1, texture_specular1, ... by binding
+    int samplerLayout = -1;                     // the same number for every mesh with the same names and units
+    const InstanceLayout* instanceLayout = nullptr;     // last attached to VAO, null for none
+    unsigned int instanceVersion = 0;           // of the InstanceBuffer it came from
+
+    // a small number per distinct sampler naming, so meshes can tell whether a shader is already set up for them
+    static int internSamplerLayout(const std::vector<std::string>& names)
+    {
+        static std::vector<std::vector<std::string>> layouts;
+        for (size_t k = 0; k < layouts.size(); k++)
+            if (layouts[k] == names)
+                return static_cast<int>(k);
+        layouts.push_back(names);
+        return static_cast<int>(layouts.size() - 1);
+    }
+
+    // numbers the textures of each type in order, named texture_diffuseN and so on, one unit each
+    void resolveTextureBindings()
     {
         unsigned int diffuseNr = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr = 1;
         unsigned int heightNr = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
+        textureBindings.clear();
+        samplerNames.clear();
+        for (unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i);
-            std::string number;
-            std::string name = textures[i].type;
+            const std::string& name = textures[i].type;
+            unsigned int number = 0;
             if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
+                number = diffuseNr++;
             else if(name == "texture_specular")
-                number = std::to_string(specularNr++);
+                number = specularNr++;
             else if(name == "texture_normal")
-                number = std::to_string(normalNr++);
+                number = normalNr++;
             else if(name == "texture_height")
-                number = std::to_string(heightNr++);
-
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+                number = heightNr++;
+            textureBindings.push_back(TextureBinding{i, textures[i].id});
+            samplerNames.push_back(number > 0 ? name + std::to_string(number) : name);
         }
-
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        glActiveTexture(GL_TEXTURE0);
+        samplerLayout = internSamplerLayout(samplerNames);
     }
 
-private:
-    unsigned int VBO, EBO;
+    void computeBounds()
+    {
+        vertexBounds(vertices, boundsMin, boundsMax, boundingRadius);
+    }
 
     void setupMesh()
     {
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // vertex Positions
-        glEnableVertexAttribArray(0);	
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);	
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);	
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-		// ids
-		glEnableVertexAttribArray(5);
-		glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
-
-		// weights
-		glEnableVertexAttribArray(6);
-		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
-        glBindVertexArray(0);
+        if (pooled)
+        {
+            range = geometryPool().add(vertices, indices, layout);
+            VAO = geometryPool().vao(layout);
+            return;
+        }
+        VAO = ownVao.create(nullptr);
+        vbo.create(GL_ARRAY_BUFFER, nullptr);
+        uploadVertices(vbo, vertices, layout);
+        uploadIndices(indices);
+        glState().bindVertexArray(0);
+    }
+
+    // into a new element buffer bound to the bound VAO, narrowed when the mesh has 16-bit indices
+    void uploadIndices(const std::vector<unsigned int>& source)
+    {
+        ebo.create(GL_ELEMENT_ARRAY_BUFFER, nullptr);
+        if (indexType == GL_UNSIGNED_SHORT)
+        {
+            const std::vector<uint16_t> narrow(source.begin(), source.end());
+            ebo.storage(narrow.size() * sizeof(uint16_t), narrow.data(), 0);
+        }
+        else
+            ebo.storage(source.size() * sizeof(unsigned int), source.data(), 0);
     }
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,652 @@
+#ifndef MESH_BVH_H
+#define MESH_BVH_H
+
+#include <glm.hpp>
+
+#include <vertex_layout.h>
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define MESH_BVH_X86 1
+#endif
+
+// A bounding volume hierarchy over a mesh's triangles for ray queries on the CPU: picking without the GPU's id
+// buffer, and segment tests of moving bodies against a surface. Built top-down with the surface area heuristic
+// over BINS centroid bins per axis, leaves of up to MAX_LEAF triangles. The triangles are copied in leaf order as
+// a corner and two edges, so a built tree needs neither the mesh's vertices nor its indices any more, and the
+// cooked model cache keeps the nodes and that order (model_cache.h) so a launch with a cache does no build.
+// Queries are a single ray, nearest child first, or a packet of 8 rays through one traversal, AVX2 when the CPU
+// has it (picked at runtime like gravity_kernels.h) and one ray at a time otherwise; the nearest point to a point
+// and a ray's crossing count are what the signed distance bake (mesh_sdf.h) asks.
+
+// a node's box and either its children, a pair at first and first + 1 (count 0), or its triangles first to
+// first + count in leaf order. Part of the model cache format.
+struct BvhNode
+{
+    float boundsMin[3];
+    uint32_t first;
+    float boundsMax[3];
+    uint32_t count;
+};
+static_assert(sizeof(BvhNode) == 32, "BVH nodes are part of the model cache format");
+
+// from origin along direction, hits up to tMax parameters away; direction need not be normalized, a segment from
+// a to b is a ray from a along b - a with tMax 1
+struct BvhRay
+{
+    glm::vec3 origin;
+    glm::vec3 direction;
+    float tMax;
+};
+
+struct BvhHit
+{
+    static constexpr uint32_t NONE = 0xFFFFFFFFu;
+
+    float t = INFINITY;
+    uint32_t triangle = NONE;   // into the mesh's index list, every three indices one triangle
+    float u = 0.0f;             // barycentrics of the second and third corner
+    float v = 0.0f;
+
+    bool hit() const { return triangle != NONE; }
+};
+
+// 8 rays traversed together, lanes side by side as the SIMD path loads them. t is the farthest a lane may hit
+// going in and its nearest hit coming out; a lane with t below 0 takes no part.
+struct alignas(32) BvhRayPacket
+{
+    static const unsigned int SIZE = 8;
+
+    float ox[SIZE], oy[SIZE], oz[SIZE];
+    float dx[SIZE], dy[SIZE], dz[SIZE];
+    float t[SIZE];
+    uint32_t triangle[SIZE];
+    float u[SIZE], v[SIZE];
+
+    BvhRayPacket()
+    {
+        for (unsigned int lane = 0; lane < SIZE; lane++)
+            set(lane, BvhRay{glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f), -1.0f});
+    }
+
+    void set(unsigned int lane, const BvhRay& ray)
+    {
+        ox[lane] = ray.origin.x; oy[lane] = ray.origin.y; oz[lane] = ray.origin.z;
+        dx[lane] = ray.direction.x; dy[lane] = ray.direction.y; dz[lane] = ray.direction.z;
+        t[lane] = ray.tMax;
+        triangle[lane] = BvhHit::NONE;
+        u[lane] = v[lane] = 0.0f;
+    }
+
+    BvhRay ray(unsigned int lane) const
+    {
+        return BvhRay{glm::vec3(ox[lane], oy[lane], oz[lane]), glm::vec3(dx[lane], dy[lane], dz[lane]), t[lane]};
+    }
+
+    BvhHit hit(unsigned int lane) const { return BvhHit{t[lane], triangle[lane], u[lane], v[lane]}; }
+};
+
+inline bool bvhPacketSimdSupported()
+{
+#ifdef MESH_BVH_X86
+    static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+class MeshBvh
+{
+public:
+    static const unsigned int BINS = 16;
+    static const unsigned int MAX_LEAF = 4;
+    static const unsigned int MAX_DEPTH = 60;      // below the traversal stacks, however unbalanced the mesh
+
+    bool empty() const { return nodes.empty(); }
+    size_t nodeCount() const { return nodes.size(); }
+    size_t triangleCount() const { return order.size(); }
+    // what the cache stores: the nodes, and the mesh triangle each leaf slot holds
+    const std::vector<BvhNode>& nodeArray() const { return nodes; }
+    const std::vector<uint32_t>& triangleOrder() const { return order; }
+
+    // the tree over every three indices of a mesh, replacing whatever was built before
+    void build(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices)
+    {
+        const size_t n = indices.size() / 3;
+        nodes.clear();
+        order.resize(n);
+        std::iota(order.begin(), order.end(), 0u);
+        triangles.clear();
+        if (n == 0)
+            return;
+        std::vector<glm::vec3> boxMin(n), boxMax(n), centroid(n);
+        for (size_t k = 0; k < n; k++)
+        {
+            const glm::vec3& a = vertices[indices[3 * k]].Position;
+            const glm::vec3& b = vertices[indices[3 * k + 1]].Position;
+            const glm::vec3& c = vertices[indices[3 * k + 2]].Position;
+            boxMin[k] = glm::min(a, glm::min(b, c));
+            boxMax[k] = glm::max(a, glm::max(b, c));
+            centroid[k] = (a + b + c) / 3.0f;
+        }
+
+        struct Pending { uint32_t node; unsigned int depth; };
+        std::vector<Pending> pending;
+        nodes.reserve(2 * n);
+        nodes.push_back(BvhNode{{0, 0, 0}, 0, {0, 0, 0}, static_cast<uint32_t>(n)});
+        pending.push_back(Pending{0, 0});
+        while (!pending.empty())
+        {
+            const Pending p = pending.back();
+            pending.pop_back();
+            const uint32_t first = nodes[p.node].first, count = nodes[p.node].count;
+            glm::vec3 lo(INFINITY), hi(-INFINITY), centroidLo(INFINITY), centroidHi(-INFINITY);
+            for (uint32_t k = first; k < first + count; k++)
+            {
+                lo = glm::min(lo, boxMin[order[k]]);
+                hi = glm::max(hi, boxMax[order[k]]);
+                centroidLo = glm::min(centroidLo, centroid[order[k]]);
+                centroidHi = glm::max(centroidHi, centroid[order[k]]);
+            }
+            setBounds(nodes[p.node], lo, hi);
+            if (count <= MAX_LEAF || p.depth >= MAX_DEPTH)
+                continue;
+
+            int axis = -1;
+            float split = 0.0f;
+            if (!findSplit(first, count, lo, hi, centroidLo, centroidHi, boxMin, boxMax, centroid, axis, split))
+                continue;
+            const auto middle = std::partition(order.begin() + first, order.begin() + first + count,
+                                               [&](uint32_t k) { return centroid[k][axis] < split; });
+            const uint32_t leftCount = static_cast<uint32_t>(middle - (order.begin() + first));
+            if (leftCount == 0 || leftCount == count)
+                continue;
+            const uint32_t left = static_cast<uint32_t>(nodes.size());
+            nodes.push_back(BvhNode{{0, 0, 0}, first, {0, 0, 0}, leftCount});
+            nodes.push_back(BvhNode{{0, 0, 0}, first + leftCount, {0, 0, 0}, count - leftCount});
+            nodes[p.node].first = left;
+            nodes[p.node].count = 0;
+            pending.push_back(Pending{left, p.depth + 1});
+            pending.push_back(Pending{left + 1, p.depth + 1});
+        }
+        nodes.shrink_to_fit();
+        gatherTriangles(vertices, indices);
+    }
+
+    // a tree the cache kept for these vertices and indices, see nodeArray and triangleOrder
+    void adopt(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const BvhNode* cachedNodes,
+               size_t nodeCount, const uint32_t* cachedOrder)
+    {
+        nodes.assign(cachedNodes, cachedNodes + nodeCount);
+        order.assign(cachedOrder, cachedOrder + indices.size() / 3);
+        gatherTriangles(vertices, indices);
+    }
+
+    // the nearest hit along the ray closer than hit.t if there is one: hit is updated and true returned, so one
+    // hit can be carried across several meshes
+    bool intersect(const BvhRay& ray, BvhHit& hit) const
+    {
+        if (nodes.empty())
+            return false;
+        const glm::vec3 inverse = 1.0f / ray.direction;
+        const uint32_t before = hit.triangle;
+        hit.t = std::min(hit.t, ray.tMax);
+        struct Entry { uint32_t node; float distance; };
+        Entry stack[MAX_DEPTH + 4];
+        unsigned int top = 0;
+        uint32_t node = 0;
+        if (boxDistance(nodes[0], ray.origin, inverse, hit.t) == INFINITY)
+            return false;
+        for (;;)
+        {
+            const BvhNode& current = nodes[node];
+            if (current.count > 0)
+            {
+                for (uint32_t k = current.first; k < current.first + current.count; k++)
+                    intersectTriangle(k, ray.origin, ray.direction, hit);
+            }
+            else
+            {
+                uint32_t nearChild = current.first, farChild = current.first + 1;
+                float nearDistance = boxDistance(nodes[nearChild], ray.origin, inverse, hit.t);
+                float farDistance = boxDistance(nodes[farChild], ray.origin, inverse, hit.t);
+                if (farDistance < nearDistance)
+                {
+                    std::swap(nearChild, farChild);
+                    std::swap(nearDistance, farDistance);
+                }
+                if (nearDistance != INFINITY)
+                {
+                    if (farDistance != INFINITY)
+                        stack[top++] = Entry{farChild, farDistance};
+                    node = nearChild;
+                    continue;
+                }
+            }
+            // the next box still in front of the nearest hit so far
+            while (top > 0 && stack[top - 1].distance >= hit.t)
+                top--;
+            if (top == 0)
+                break;
+            node = stack[--top].node;
+        }
+        return hit.triangle != before;
+    }
+
+    // the nearest point of the triangles to p if it is closer than sqrt(distanceSq): point and distanceSq are updated
+    // and true returned, so one search can be carried across several meshes like intersect's hit
+    bool closestPoint(const glm::vec3& p, float& distanceSq, glm::vec3& point) const
+    {
+        if (nodes.empty())
+            return false;
+        bool found = false;
+        struct Entry { uint32_t node; float distanceSq; };
+        Entry stack[MAX_DEPTH + 4];
+        unsigned int top = 0;
+        stack[top++] = Entry{0, boxDistanceSq(nodes[0], p)};
+        while (top > 0)
+        {
+            const Entry entry = stack[--top];
+            if (entry.distanceSq >= distanceSq)
+                continue;
+            const BvhNode& current = nodes[entry.node];
+            if (current.count > 0)
+            {
+                for (uint32_t k = current.first; k < current.first + current.count; k++)
+                {
+                    const glm::vec3 q = closestOnTriangle(k, p);
+                    const float dSq = glm::dot(q - p, q - p);
+                    if (dSq < distanceSq)
+                    {
+                        distanceSq = dSq;
+                        point = q;
+                        found = true;
+                    }
+                }
+                continue;
+            }
+            uint32_t nearChild = current.first, farChild = current.first + 1;
+            float nearDistance = boxDistanceSq(nodes[nearChild], p), farDistance = boxDistanceSq(nodes[farChild], p);
+            if (farDistance < nearDistance)
+            {
+                std::swap(nearChild, farChild);
+                std::swap(nearDistance, farDistance);
+            }
+            // the nearer child pops first
+            stack[top++] = Entry{farChild, farDistance};
+            stack[top++] = Entry{nearChild, nearDistance};
+        }
+        return found;
+    }
+
+    // how many triangles the ray crosses before tMax, both faces: odd from a point inside a closed mesh, unless the
+    // ray grazes an edge or a corner, so callers cast it a slightly skewed direction
+    unsigned int crossings(const BvhRay& ray) const
+    {
+        if (nodes.empty())
+            return 0;
+        const glm::vec3 inverse = 1.0f / ray.direction;
+        unsigned int count = 0;
+        uint32_t stack[MAX_DEPTH + 4];
+        unsigned int top = 0;
+        stack[top++] = 0;
+        while (top > 0)
+        {
+            const BvhNode& current = nodes[stack[--top]];
+            if (boxDistance(current, ray.origin, inverse, ray.tMax) == INFINITY)
+                continue;
+            if (current.count > 0)
+            {
+                for (uint32_t k = current.first; k < current.first + current.count; k++)
+                {
+                    BvhHit hit;
+                    hit.t = ray.tMax;
+                    intersectTriangle(k, ray.origin, ray.direction, hit);
+                    if (hit.hit())
+                        count++;
+                }
+                continue;
+            }
+            stack[top++] = current.first;
+            stack[top++] = current.first + 1;
+        }
+        return count;
+    }
+
+    // every lane's nearest hit closer than its t, see BvhRayPacket. One traversal for all 8 when the CPU has AVX2,
+    // the rays should then start near each other and point about the same way or it visits the union of their paths.
+    void intersect(BvhRayPacket& packet) const
+    {
+        if (nodes.empty())
+            return;
+#ifdef MESH_BVH_X86
+        if (bvhPacketSimdSupported())
+        {
+            intersectPacketAVX2(packet);
+            return;
+        }
+#endif
+        intersectPacketScalar(packet);
+    }
+
+    // one ray at a time, what the packet query falls back to
+    void intersectPacketScalar(BvhRayPacket& packet) const
+    {
+        for (unsigned int lane = 0; lane < BvhRayPacket::SIZE; lane++)
+        {
+            if (packet.t[lane] < 0.0f)
+                continue;
+            BvhHit hit{packet.t[lane], packet.triangle[lane], packet.u[lane], packet.v[lane]};
+            intersect(packet.ray(lane), hit);
+            packet.t[lane] = hit.t;
+            packet.triangle[lane] = hit.triangle;
+            packet.u[lane] = hit.u;
+            packet.v[lane] = hit.v;
+        }
+    }
+
+private:
+    // a leaf slot's triangle as one corner and the edges to the other two, what Moller-Trumbore reads
+    struct Triangle
+    {
+        glm::vec3 v0, e1, e2;
+    };
+
+    std::vector<BvhNode> nodes;
+    std::vector<uint32_t> order;        // the mesh triangle of each leaf slot
+    std::vector<Triangle> triangles;    // in leaf order
+
+    static void setBounds(BvhNode& node, const glm::vec3& lo, const glm::vec3& hi)
+    {
+        node.boundsMin[0] = lo.x; node.boundsMin[1] = lo.y; node.boundsMin[2] = lo.z;
+        node.boundsMax[0] = hi.x; node.boundsMax[1] = hi.y; node.boundsMax[2] = hi.z;
+    }
+
+    static float area(const glm::vec3& lo, const glm::vec3& hi)
+    {
+        const glm::vec3 e = glm::max(hi - lo, glm::vec3(0.0f));
+        return e.x * e.y + e.y * e.z + e.z * e.x;
+    }
+
+    // the cheapest binned plane over the node's centroids, false when keeping the node a leaf costs less. A split
+    // costs a traversal step (as much as one triangle test) plus each side's triangles by its share of the area.
+    bool findSplit(uint32_t first, uint32_t count, const glm::vec3& lo, const glm::vec3& hi, const glm::vec3& centroidLo,
+                   const glm::vec3& centroidHi, const std::vector<glm::vec3>& triangleLo, const std::vector<glm::vec3>& triangleHi,
+                   const std::vector<glm::vec3>& centroid, int& bestAxis, float& bestSplit) const
+    {
+        float bestCost = area(lo, hi) * static_cast<float>(count);
+        const float traversal = area(lo, hi);
+        bestAxis = -1;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            const float extent = centroidHi[axis] - centroidLo[axis];
+            if (!(extent > 0.0f))
+                continue;
+            glm::vec3 binLo[BINS], binHi[BINS];
+            uint32_t binCount[BINS] = {};
+            for (unsigned int b = 0; b < BINS; b++)
+            {
+                binLo[b] = glm::vec3(INFINITY);
+                binHi[b] = glm::vec3(-INFINITY);
+            }
+            const float scale = BINS / extent;
+            for (uint32_t k = first; k < first + count; k++)
+            {
+                const uint32_t t = order[k];
+                const unsigned int b = std::min(static_cast<unsigned int>((centroid[t][axis] - centroidLo[axis]) * scale), BINS - 1);
+                binCount[b]++;
+                binLo[b] = glm::min(binLo[b], triangleLo[t]);
+                binHi[b] = glm::max(binHi[b], triangleHi[t]);
+            }
+            // areas and counts left of each plane, then swept from the right
+            float leftArea[BINS - 1];
+            uint32_t leftCount[BINS - 1];
+            glm::vec3 sweepLo(INFINITY), sweepHi(-INFINITY);
+            uint32_t sweepCount = 0;
+            for (unsigned int b = 0; b + 1 < BINS; b++)
+            {
+                sweepLo = glm::min(sweepLo, binLo[b]);
+                sweepHi = glm::max(sweepHi, binHi[b]);
+                sweepCount += binCount[b];
+                leftArea[b] = area(sweepLo, sweepHi);
+                leftCount[b] = sweepCount;
+            }
+            sweepLo = glm::vec3(INFINITY);
+            sweepHi = glm::vec3(-INFINITY);
+            sweepCount = 0;
+            for (unsigned int b = BINS - 1; b > 0; b--)
+            {
+                sweepLo = glm::min(sweepLo, binLo[b]);
+                sweepHi = glm::max(sweepHi, binHi[b]);
+                sweepCount += binCount[b];
+                if (leftCount[b - 1] == 0 || sweepCount == 0)
+                    continue;
+                const float cost = traversal + leftArea[b - 1] * leftCount[b - 1] + area(sweepLo, sweepHi) * sweepCount;
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = centroidLo[axis] + extent * static_cast<float>(b) / BINS;
+                }
+            }
+        }
+        return bestAxis >= 0;
+    }
+
+    void gatherTriangles(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices)
+    {
+        triangles.resize(order.size());
+        for (size_t k = 0; k < order.size(); k++)
+        {
+            const size_t t = order[k];
+            const glm::vec3& a = vertices[indices[3 * t]].Position;
+            triangles[k] = Triangle{a, vertices[indices[3 * t + 1]].Position - a, vertices[indices[3 * t + 2]].Position - a};
+        }
+    }
+
+    // where the ray enters the node's box, INFINITY if it misses it or only gets there past tMax
+    static float boxDistance(const BvhNode& node, const glm::vec3& origin, const glm::vec3& inverse, float tMax)
+    {
+        const glm::vec3 t1 = (glm::vec3(node.boundsMin[0], node.boundsMin[1], node.boundsMin[2]) - origin) * inverse;
+        const glm::vec3 t2 = (glm::vec3(node.boundsMax[0], node.boundsMax[1], node.boundsMax[2]) - origin) * inverse;
+        const glm::vec3 near = glm::min(t1, t2), far = glm::max(t1, t2);
+        const float enter = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+        const float exit = std::min(std::min(far.x, far.y), std::min(far.z, tMax));
+        return enter <= exit ? enter : INFINITY;
+    }
+
+    // squared distance from p to the node's box, 0 inside it
+    static float boxDistanceSq(const BvhNode& node, const glm::vec3& p)
+    {
+        const glm::vec3 lo(node.boundsMin[0], node.boundsMin[1], node.boundsMin[2]);
+        const glm::vec3 hi(node.boundsMax[0], node.boundsMax[1], node.boundsMax[2]);
+        const glm::vec3 d = glm::max(glm::max(lo - p, p - hi), glm::vec3(0.0f));
+        return glm::dot(d, d);
+    }
+
+    // the point of a leaf slot's triangle nearest p, by the Voronoi regions of its corners and edges
+    glm::vec3 closestOnTriangle(uint32_t slot, const glm::vec3& p) const
+    {
+        const Triangle& tri = triangles[slot];
+        const glm::vec3 a = tri.v0, b = tri.v0 + tri.e1, c = tri.v0 + tri.e2;
+        const glm::vec3 ap = p - a;
+        const float d1 = glm::dot(tri.e1, ap), d2 = glm::dot(tri.e2, ap);
+        if (d1 <= 0.0f && d2 <= 0.0f)
+            return a;
+        const glm::vec3 bp = p - b;
+        const float d3 = glm::dot(tri.e1, bp), d4 = glm::dot(tri.e2, bp);
+        if (d3 >= 0.0f && d4 <= d3)
+            return b;
+        const float vc = d1 * d4 - d3 * d2;
+        if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+            return a + tri.e1 * (d1 / (d1 - d3));
+        const glm::vec3 cp = p - c;
+        const float d5 = glm::dot(tri.e1, cp), d6 = glm::dot(tri.e2, cp);
+        if (d6 >= 0.0f && d5 <= d6)
+            return c;
+        const float vb = d5 * d2 - d1 * d6;
+        if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+            return a + tri.e2 * (d2 / (d2 - d6));
+        const float va = d3 * d6 - d5 * d4;
+        if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+            return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+        const float denominator = 1.0f / (va + vb + vc);
+        return a + tri.e1 * (vb * denominator) + tri.e2 * (vc * denominator);
+    }
+
+    // Moller-Trumbore, both faces, hits in front of the origin only
+    void intersectTriangle(uint32_t slot, const glm::vec3& origin, const glm::vec3& direction, BvhHit& hit) const
+    {
+        const Triangle& tri = triangles[slot];
+        const glm::vec3 p = glm::cross(direction, tri.e2);
+        const float det = glm::dot(tri.e1, p);
+        if (std::fabs(det) < 1e-12f)
+            return;
+        const float inverse = 1.0f / det;
+        const glm::vec3 s = origin - tri.v0;
+        const float u = glm::dot(s, p) * inverse;
+        if (u < 0.0f || u > 1.0f)
+            return;
+        const glm::vec3 q = glm::cross(s, tri.e1);
+        const float v = glm::dot(direction, q) * inverse;
+        if (v < 0.0f || u + v > 1.0f)
+            return;
+        const float t = glm::dot(tri.e2, q) * inverse;
+        if (t > 0.0f && t < hit.t)
+            hit = BvhHit{t, order[slot], u, v};
+    }
+
+#ifdef MESH_BVH_X86
+    // the lanes whose slabs overlap the node's box in front of them and before their t
+    __attribute__((target("avx2,fma")))
+    static __m256 packetBox(const BvhNode& node, __m256 ox, __m256 oy, __m256 oz, __m256 ix, __m256 iy, __m256 iz, __m256 t, __m256& enter)
+    {
+        const __m256 x1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.boundsMin[0]), ox), ix);
+        const __m256 x2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.boundsMax[0]), ox), ix);
+        const __m256 y1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.boundsMin[1]), oy), iy);
+        const __m256 y2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.boundsMax[1]), oy), iy);
+        const __m256 z1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.boundsMin[2]), oz), iz);
+        const __m256 z2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.boundsMax[2]), oz), iz);
+        enter = _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(x1, x2), _mm256_min_ps(y1, y2)),
+                              _mm256_max_ps(_mm256_min_ps(z1, z2), _mm256_setzero_ps()));
+        const __m256 exit = _mm256_min_ps(_mm256_min_ps(_mm256_max_ps(x1, x2), _mm256_max_ps(y1, y2)),
+                                          _mm256_min_ps(_mm256_max_ps(z1, z2), t));
+        return _mm256_cmp_ps(enter, exit, _CMP_LE_OQ);
+    }
+
+    // the smallest entry distance of the lanes in mask
+    __attribute__((target("avx2,fma")))
+    static float packetNearest(__m256 enter, __m256 mask)
+    {
+        const __m256 masked = _mm256_blendv_ps(_mm256_set1_ps(INFINITY), enter, mask);
+        __m128 m = _mm_min_ps(_mm256_castps256_ps128(masked), _mm256_extractf128_ps(masked, 1));
+        m = _mm_min_ps(m, _mm_movehl_ps(m, m));
+        m = _mm_min_ss(m, _mm_shuffle_ps(m, m, 1));
+        return _mm_cvtss_f32(m);
+    }
+
+    __attribute__((target("avx2,fma")))
+    void intersectPacketAVX2(BvhRayPacket& packet) const
+    {
+        const __m256 ox = _mm256_load_ps(packet.ox), oy = _mm256_load_ps(packet.oy), oz = _mm256_load_ps(packet.oz);
+        const __m256 dx = _mm256_load_ps(packet.dx), dy = _mm256_load_ps(packet.dy), dz = _mm256_load_ps(packet.dz);
+        const __m256 one = _mm256_set1_ps(1.0f), zero = _mm256_setzero_ps();
+        const __m256 ix = _mm256_div_ps(one, dx), iy = _mm256_div_ps(one, dy), iz = _mm256_div_ps(one, dz);
+        const __m256 epsilon = _mm256_set1_ps(1e-12f);
+        const __m256 signBit = _mm256_set1_ps(-0.0f);
+        __m256 t = _mm256_load_ps(packet.t);
+        __m256i triangle = _mm256_load_si256(reinterpret_cast<const __m256i*>(packet.triangle));
+        __m256 u = _mm256_load_ps(packet.u), v = _mm256_load_ps(packet.v);
+
+        uint32_t stack[MAX_DEPTH + 4];
+        unsigned int top = 0;
+        uint32_t node = 0;
+        __m256 enter;
+        if (_mm256_movemask_ps(packetBox(nodes[0], ox, oy, oz, ix, iy, iz, t, enter)) == 0)
+            return;
+        for (;;)
+        {
+            const BvhNode& current = nodes[node];
+            if (current.count > 0)
+            {
+                for (uint32_t k = current.first; k < current.first + current.count; k++)
+                {
+                    const Triangle& tri = triangles[k];
+                    const __m256 e1x = _mm256_set1_ps(tri.e1.x), e1y = _mm256_set1_ps(tri.e1.y), e1z = _mm256_set1_ps(tri.e1.z);
+                    const __m256 e2x = _mm256_set1_ps(tri.e2.x), e2y = _mm256_set1_ps(tri.e2.y), e2z = _mm256_set1_ps(tri.e2.z);
+                    const __m256 px = _mm256_fmsub_ps(dy, e2z, _mm256_mul_ps(dz, e2y));
+                    const __m256 py = _mm256_fmsub_ps(dz, e2x, _mm256_mul_ps(dx, e2z));
+                    const __m256 pz = _mm256_fmsub_ps(dx, e2y, _mm256_mul_ps(dy, e2x));
+                    const __m256 det = _mm256_fmadd_ps(e1x, px, _mm256_fmadd_ps(e1y, py, _mm256_mul_ps(e1z, pz)));
+                    const __m256 inverse = _mm256_div_ps(one, det);
+                    const __m256 sx = _mm256_sub_ps(ox, _mm256_set1_ps(tri.v0.x));
+                    const __m256 sy = _mm256_sub_ps(oy, _mm256_set1_ps(tri.v0.y));
+                    const __m256 sz = _mm256_sub_ps(oz, _mm256_set1_ps(tri.v0.z));
+                    const __m256 hu = _mm256_mul_ps(_mm256_fmadd_ps(sx, px, _mm256_fmadd_ps(sy, py, _mm256_mul_ps(sz, pz))), inverse);
+                    const __m256 qx = _mm256_fmsub_ps(sy, e1z, _mm256_mul_ps(sz, e1y));
+                    const __m256 qy = _mm256_fmsub_ps(sz, e1x, _mm256_mul_ps(sx, e1z));
+                    const __m256 qz = _mm256_fmsub_ps(sx, e1y, _mm256_mul_ps(sy, e1x));
+                    const __m256 hv = _mm256_mul_ps(_mm256_fmadd_ps(dx, qx, _mm256_fmadd_ps(dy, qy, _mm256_mul_ps(dz, qz))), inverse);
+                    const __m256 ht = _mm256_mul_ps(_mm256_fmadd_ps(e2x, qx, _mm256_fmadd_ps(e2y, qy, _mm256_mul_ps(e2z, qz))), inverse);
+                    __m256 accept = _mm256_cmp_ps(_mm256_andnot_ps(signBit, det), epsilon, _CMP_GE_OQ);
+                    accept = _mm256_and_ps(accept, _mm256_cmp_ps(hu, zero, _CMP_GE_OQ));
+                    accept = _mm256_and_ps(accept, _mm256_cmp_ps(hv, zero, _CMP_GE_OQ));
+                    accept = _mm256_and_ps(accept, _mm256_cmp_ps(_mm256_add_ps(hu, hv), one, _CMP_LE_OQ));
+                    accept = _mm256_and_ps(accept, _mm256_cmp_ps(ht, zero, _CMP_GT_OQ));
+                    accept = _mm256_and_ps(accept, _mm256_cmp_ps(ht, t, _CMP_LT_OQ));
+                    if (_mm256_movemask_ps(accept) == 0)
+                        continue;
+                    t = _mm256_blendv_ps(t, ht, accept);
+                    u = _mm256_blendv_ps(u, hu, accept);
+                    v = _mm256_blendv_ps(v, hv, accept);
+                    triangle = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(triangle),
+                                                                    _mm256_castsi256_ps(_mm256_set1_epi32(static_cast<int>(order[k]))), accept));
+                }
+            }
+            else
+            {
+                __m256 nearEnter, farEnter;
+                uint32_t nearChild = current.first, farChild = current.first + 1;
+                const __m256 nearMask = packetBox(nodes[nearChild], ox, oy, oz, ix, iy, iz, t, nearEnter);
+                const __m256 farMask = packetBox(nodes[farChild], ox, oy, oz, ix, iy, iz, t, farEnter);
+                const bool nearHit = _mm256_movemask_ps(nearMask) != 0, farHit = _mm256_movemask_ps(farMask) != 0;
+                if (nearHit && farHit)
+                {
+                    if (packetNearest(farEnter, farMask) < packetNearest(nearEnter, nearMask))
+                        std::swap(nearChild, farChild);
+                    stack[top++] = farChild;
+                    node = nearChild;
+                    continue;
+                }
+                if (nearHit || farHit)
+                {
+                    node = nearHit ? nearChild : farChild;
+                    continue;
+                }
+            }
+            // the next box some lane still reaches before its nearest hit so far
+            bool found = false;
+            while (top > 0 && !found)
+            {
+                node = stack[--top];
+                found = _mm256_movemask_ps(packetBox(nodes[node], ox, oy, oz, ix, iy, iz, t, enter)) != 0;
+            }
+            if (!found)
+                break;
+        }
+        _mm256_store_ps(packet.t, t);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(packet.triangle), triangle);
+        _mm256_store_ps(packet.u, u);
+        _mm256_store_ps(packet.v, v);
+    }
+#endif
+};
+
+#endif
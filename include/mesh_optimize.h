@@ -0,0 +1,260 @@
+#ifndef MESH_OPTIMIZE_H
+#define MESH_OPTIMIZE_H
+
+#include <glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <cstdint>
+
+// Import-time reordering of a mesh for the GPU, none of which changes what is drawn: triangles in an order the
+// post-transform vertex cache hits (Tipsify, Sander, Nehab and Barczak 2007), then its clusters ordered so the
+// ones likely to hide others come first, for less overdraw, and last the vertices in the order the triangles first
+// use them, so fetches walk the vertex buffer forwards. The FIFO of VERTEX_CACHE_SIZE vertices below stands in for
+// whatever cache the hardware has; the order is good for any size around it.
+static const unsigned int VERTEX_CACHE_SIZE = 16;
+
+namespace mesh_optimize {
+
+// which triangles use each vertex, as offsets into one list
+struct Adjacency
+{
+    std::vector<uint32_t> offsets;      // vertexCount + 1
+    std::vector<uint32_t> triangles;
+
+    Adjacency(const std::vector<unsigned int>& indices, size_t vertexCount) : offsets(vertexCount + 1, 0), triangles(indices.size())
+    {
+        for (unsigned int v : indices)
+            offsets[v + 1]++;
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+            triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+};
+
+} // namespace mesh_optimize
+
+// the vertex cache misses per triangle of indices through a FIFO cache, 3 at worst and about 0.5 at best
+inline float vertexCacheMissRatio(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize = VERTEX_CACHE_SIZE)
+{
+    if (indices.size() < 3)
+        return 0.0f;
+    // a vertex is cached while fewer than cacheSize misses came after its own
+    std::vector<uint32_t> missedAt(vertexCount, 0);
+    uint32_t misses = 0;
+    for (unsigned int v : indices)
+        if (missedAt[v] == 0 || misses - missedAt[v] >= cacheSize)
+            missedAt[v] = ++misses;
+    return static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+}
+
+// Tipsify: fans around one vertex at a time, moving on to the neighbour of the last triangles that will still be in
+// the cache once its remaining triangles are drawn. clusterStarts gets the first triangle of every stretch after
+// the walk had to jump, the hard boundaries optimizeOverdraw may not reorder across.
+inline std::vector<unsigned int> optimizeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount,
+                                                     std::vector<uint32_t>* clusterStarts = nullptr, unsigned int cacheSize = VERTEX_CACHE_SIZE)
+{
+    const size_t triangleCount = indices.size() / 3;
+    std::vector<unsigned int> result;
+    result.reserve(triangleCount * 3);
+    if (clusterStarts)
+        clusterStarts->clear();
+    if (triangleCount == 0 || vertexCount == 0)
+        return result;
+    const mesh_optimize::Adjacency adjacency(indices, vertexCount);
+    std::vector<uint32_t> live(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+    std::vector<uint32_t> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    uint32_t time = cacheSize + 1;
+    size_t cursor = 0;
+
+    // the first vertex with triangles left, from the dead-end stack or else in index order
+    auto skipDeadEnd = [&]() -> int64_t {
+        while (!deadEnd.empty())
+        {
+            const uint32_t v = deadEnd.back();
+            deadEnd.pop_back();
+            if (live[v] > 0)
+                return v;
+        }
+        for (; cursor < vertexCount; cursor++)
+            if (live[cursor] > 0)
+                return static_cast<int64_t>(cursor);
+        return -1;
+    };
+
+    int64_t fan = skipDeadEnd();
+    bool jumped = true;
+    while (fan >= 0)
+    {
+        candidates.clear();
+        for (uint32_t a = adjacency.offsets[fan]; a < adjacency.offsets[fan + 1]; a++)
+        {
+            const uint32_t t = adjacency.triangles[a];
+            if (emitted[t])
+                continue;
+            emitted[t] = true;
+            if (jumped && clusterStarts)
+                clusterStarts->push_back(static_cast<uint32_t>(result.size() / 3));
+            jumped = false;
+            for (unsigned int c = 0; c < 3; c++)
+            {
+                const unsigned int v = indices[t * 3 + c];
+                result.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - cacheTime[v] > cacheSize)
+                    cacheTime[v] = time++;
+            }
+        }
+        // the candidate longest in the cache that stays there through its own fan, else a jump
+        int64_t next = -1;
+        int64_t best = -1;
+        for (uint32_t v : candidates)
+        {
+            if (live[v] == 0)
+                continue;
+            int64_t priority = 0;
+            if (time - cacheTime[v] + 2 * live[v] <= cacheSize)
+                priority = time - cacheTime[v];
+            if (priority > best)
+            {
+                best = priority;
+                next = v;
+            }
+        }
+        if (next < 0)
+        {
+            next = skipDeadEnd();
+            jumped = true;
+        }
+        fan = next;
+    }
+    return result;
+}
+
+// Reorders the clusters of an index list from optimizeVertexCache so those facing out from the mesh's centre come
+// first: drawn early they hide more of the rest from shading. Each hard cluster is cut further wherever its misses
+// so far stay within threshold of its own ratio, so the cache order costs at most about that much.
+template <typename V>
+std::vector<unsigned int> optimizeOverdraw(const std::vector<unsigned int>& indices, const std::vector<V>& vertices,
+                                           const std::vector<uint32_t>& clusterStarts, float threshold = 1.05f,
+                                           unsigned int cacheSize = VERTEX_CACHE_SIZE)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0 || clusterStarts.empty())
+        return indices;
+
+    // soft boundaries inside the hard clusters, each simulated from a cold cache: a vertex missed before base
+    // is not in it, so the one array serves every cluster
+    std::vector<uint32_t> starts;
+    std::vector<uint32_t> missedAt(vertices.size(), 0);
+    uint32_t misses = 0;
+    auto miss = [&](unsigned int v, uint32_t base) {
+        if (missedAt[v] > base && misses - missedAt[v] < cacheSize)
+            return false;
+        missedAt[v] = ++misses;
+        return true;
+    };
+    for (size_t c = 0; c < clusterStarts.size(); c++)
+    {
+        const uint32_t begin = clusterStarts[c];
+        const uint32_t end = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : static_cast<uint32_t>(triangleCount);
+        uint32_t base = misses;
+        for (uint32_t i = begin * 3; i < end * 3; i++)
+            miss(indices[i], base);
+        const float clusterRatio = static_cast<float>(misses - base) / static_cast<float>(end - begin);
+        starts.push_back(begin);
+        base = misses;
+        uint32_t soft = 0, softTriangles = 0;
+        for (uint32_t t = begin; t < end; t++)
+        {
+            for (unsigned int k = 0; k < 3; k++)
+                soft += miss(indices[t * 3 + k], base) ? 1 : 0;
+            softTriangles++;
+            if (t + 1 < end && softTriangles >= cacheSize && static_cast<float>(soft) <= clusterRatio * threshold * softTriangles)
+            {
+                starts.push_back(t + 1);
+                soft = softTriangles = 0;
+            }
+        }
+    }
+
+    // occlusion potential: how far out along its own normal a cluster sits
+    glm::dvec3 meshCentroid(0.0);
+    for (unsigned int v : indices)
+        meshCentroid += glm::dvec3(vertices[v].Position);
+    meshCentroid /= static_cast<double>(indices.size());
+    std::vector<double> potential(starts.size());
+    for (size_t c = 0; c < starts.size(); c++)
+    {
+        const uint32_t end = c + 1 < starts.size() ? starts[c + 1] : static_cast<uint32_t>(triangleCount);
+        glm::dvec3 centroid(0.0), normal(0.0);
+        double area = 0.0;
+        for (uint32_t t = starts[c]; t < end; t++)
+        {
+            const glm::dvec3 a(vertices[indices[t * 3]].Position);
+            const glm::dvec3 b(vertices[indices[t * 3 + 1]].Position);
+            const glm::dvec3 d(vertices[indices[t * 3 + 2]].Position);
+            const glm::dvec3 areaNormal = glm::cross(b - a, d - a);     // twice the area long
+            const double triangleArea = glm::length(areaNormal);
+            centroid += (a + b + d) * (triangleArea / 3.0);
+            normal += areaNormal;
+            area += triangleArea;
+        }
+        const double facing = glm::length(normal);
+        potential[c] = area > 0.0 && facing > 0.0 ? glm::dot(centroid / area - meshCentroid, normal / facing) : 0.0;
+    }
+    std::vector<uint32_t> order(starts.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return potential[a] > potential[b]; });
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (uint32_t c : order)
+    {
+        const uint32_t end = c + 1 < starts.size() ? starts[c + 1] : static_cast<uint32_t>(triangleCount);
+        result.insert(result.end(), indices.begin() + starts[c] * 3, indices.begin() + end * 3);
+    }
+    return result;
+}
+
+// renumbers the vertices in the order indices first reference them, dropping those none does; indices are
+// rewritten to match
+template <typename V>
+void optimizeVertexFetch(std::vector<V>& vertices, std::vector<unsigned int>& indices)
+{
+    const uint32_t NONE = 0xFFFFFFFFu;
+    std::vector<uint32_t> remap(vertices.size(), NONE);
+    std::vector<V> ordered;
+    ordered.reserve(vertices.size());
+    for (unsigned int& v : indices)
+    {
+        if (remap[v] == NONE)
+        {
+            remap[v] = static_cast<uint32_t>(ordered.size());
+            ordered.push_back(vertices[v]);
+        }
+        v = remap[v];
+    }
+    vertices.swap(ordered);
+}
+
+// all three, as the import runs them
+template <typename V>
+void optimizeMesh(std::vector<V>& vertices, std::vector<unsigned int>& indices)
+{
+    std::vector<uint32_t> clusters;
+    indices = optimizeVertexCache(indices, vertices.size(), &clusters);
+    indices = optimizeOverdraw(indices, vertices, clusters);
+    optimizeVertexFetch(vertices, indices);
+}
+
+#endif
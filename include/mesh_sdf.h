@@ -0,0 +1,104 @@
+#ifndef MESH_SDF_H
+#define MESH_SDF_H
+
+#include <glm.hpp>
+
+#include <model_cache.h>
+#include <signed_distance_field.h>
+#include <thread_pool.h>
+#include <profiler.h>
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+// samples per axis of the field every imported model is baked with, 128 KB of floats
+static const uint32_t MODEL_SDF_RESOLUTION = 32;
+
+// the model-space transform of each mesh, from the nodes holding them; identity for a flat model
+inline std::vector<glm::mat4> importedMeshTransforms(size_t meshCount, const std::vector<ImportedNode>& nodes)
+{
+    std::vector<glm::mat4> meshes(meshCount, glm::mat4(1.0f));
+    std::vector<glm::mat4> world(nodes.size());
+    for (size_t n = 0; n < nodes.size(); n++)
+    {
+        world[n] = nodes[n].parent < 0 ? nodes[n].transform : world[nodes[n].parent] * nodes[n].transform;
+        for (uint32_t m = nodes[n].firstMesh; m < nodes[n].firstMesh + nodes[n].meshCount && m < meshCount; m++)
+            meshes[m] = world[n];
+    }
+    return meshes;
+}
+
+// The signed distance field of a model's surface in model space, through its meshes' BVHs: each sample is the
+// distance to the nearest triangle of any mesh, negative where rays cast from it in three skewed directions cross
+// the surface an odd number of times in at least two of them, so a mesh with small holes still gets an inside. The
+// grid is a cube over the bounds padded by two cells, which keeps the surface off its border. Empty for a model
+// without triangles.
+inline SignedDistanceField bakeSignedDistanceField(const std::vector<ImportedMesh>& meshes, const std::vector<ImportedNode>& nodes,
+                                                   uint32_t resolution = MODEL_SDF_RESOLUTION)
+{
+    PROFILE_SCOPE("bakeSignedDistanceField");
+    SignedDistanceField field;
+    const std::vector<glm::mat4> transforms = importedMeshTransforms(meshes.size(), nodes);
+    std::vector<glm::mat4> inverses(meshes.size());
+    glm::vec3 lo(INFINITY), hi(-INFINITY);
+    for (size_t m = 0; m < meshes.size(); m++)
+    {
+        inverses[m] = glm::inverse(transforms[m]);
+        if (meshes[m].bvh.empty())
+            continue;
+        for (const Vertex& v : meshes[m].vertices)
+        {
+            const glm::vec3 p = glm::vec3(transforms[m] * glm::vec4(v.Position, 1.0f));
+            lo = glm::min(lo, p);
+            hi = glm::max(hi, p);
+        }
+    }
+    if (resolution < 4 || !(lo.x <= hi.x))
+        return field;
+
+    const glm::vec3 extent = hi - lo;
+    const float size = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f));
+    field.resolution = resolution;
+    field.cellSize = size / static_cast<float>(resolution - 5);
+    field.origin = 0.5f * (lo + hi) - glm::vec3(0.5f * field.cellSize * static_cast<float>(resolution - 1));
+    field.values.resize(static_cast<size_t>(resolution) * resolution * resolution);
+
+    static const glm::vec3 RAYS[3] = {glm::vec3(1.0f, 0.0137f, 0.0291f), glm::vec3(0.0173f, 1.0f, -0.0219f),
+                                      glm::vec3(-0.0241f, 0.0113f, 1.0f)};
+    workerPool().parallelFor(0, resolution, [&](size_t zBegin, size_t zEnd, unsigned int) {
+        for (size_t z = zBegin; z < zEnd; z++)
+            for (uint32_t y = 0; y < resolution; y++)
+                for (uint32_t x = 0; x < resolution; x++)
+                {
+                    const glm::vec3 p = field.origin + glm::vec3(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z)) * field.cellSize;
+                    float nearestSq = INFINITY;
+                    unsigned int odd = 0;
+                    unsigned int hits[3] = {0, 0, 0};
+                    for (size_t m = 0; m < meshes.size(); m++)
+                    {
+                        const MeshBvh& bvh = meshes[m].bvh;
+                        if (bvh.empty())
+                            continue;
+                        const glm::vec3 local = glm::vec3(inverses[m] * glm::vec4(p, 1.0f));
+                        float localSq = INFINITY;
+                        glm::vec3 point;
+                        if (bvh.closestPoint(local, localSq, point))
+                        {
+                            const glm::vec3 d = glm::vec3(transforms[m] * glm::vec4(point, 1.0f)) - p;
+                            nearestSq = std::min(nearestSq, glm::dot(d, d));
+                        }
+                        for (unsigned int r = 0; r < 3; r++)
+                            hits[r] += bvh.crossings(BvhRay{local, glm::vec3(inverses[m] * glm::vec4(RAYS[r], 0.0f)), INFINITY});
+                    }
+                    for (unsigned int r = 0; r < 3; r++)
+                        odd += hits[r] & 1u;
+                    const float distance = std::sqrt(nearestSq);
+                    field.values[(z * resolution + y) * resolution + x] = odd >= 2 ? -distance : distance;
+                }
+    });
+    return field;
+}
+
+#endif
@@ -0,0 +1,273 @@
+#ifndef MESH_SIMPLIFY_H
+#define MESH_SIMPLIFY_H
+
+#include <glm.hpp>
+
+#include <vector>
+#include <queue>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+
+// Quadric error simplification (Garland and Heckbert) by half-edge collapse: every vertex sums the planes of its
+// triangles, an edge u->v costs the squared distance of v to u's and v's planes, and the cheapest edge is collapsed
+// until the target triangle count is reached. Collapsing onto an existing vertex means the result only re-indexes
+// the original vertex buffer, so a LOD is just another index range. Vertices split at UV seams are welded by
+// position for the topology, each triangle corner then keeps the copy whose UV is closest to the one it had.
+// Boundary edges get a perpendicular plane so open borders keep their outline, and collapses that would flip a
+// triangle or pinch the surface (the link condition) are refused.
+namespace mesh_simplify {
+
+struct Quadric
+{
+    double q[10] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};     // upper triangle of the 4x4 plane outer product
+
+    void addPlane(const glm::dvec3& n, double d, double weight)
+    {
+        q[0] += weight * n.x * n.x; q[1] += weight * n.x * n.y; q[2] += weight * n.x * n.z; q[3] += weight * n.x * d;
+        q[4] += weight * n.y * n.y; q[5] += weight * n.y * n.z; q[6] += weight * n.y * d;
+        q[7] += weight * n.z * n.z; q[8] += weight * n.z * d;
+        q[9] += weight * d * d;
+    }
+
+    void add(const Quadric& o)
+    {
+        for (int k = 0; k < 10; k++) q[k] += o.q[k];
+    }
+
+    double error(const glm::dvec3& p) const
+    {
+        return q[0] * p.x * p.x + 2 * q[1] * p.x * p.y + 2 * q[2] * p.x * p.z + 2 * q[3] * p.x
+             + q[4] * p.y * p.y + 2 * q[5] * p.y * p.z + 2 * q[6] * p.y
+             + q[7] * p.z * p.z + 2 * q[8] * p.z
+             + q[9];
+    }
+};
+
+struct Candidate
+{
+    double cost;
+    uint32_t from, to;
+    uint32_t fromVersion, toVersion;
+    bool operator<(const Candidate& o) const { return cost > o.cost; }     // min-heap
+};
+
+} // namespace mesh_simplify
+
+// Returns an index buffer of at most targetTriangles triangles (fewer collapses if the surface does not allow them)
+// that references the given vertices. V needs Position (vec3) and TexCoords (vec2).
+template <typename V>
+std::vector<unsigned int> simplifyMesh(const std::vector<V>& vertices, const std::vector<unsigned int>& indices, size_t targetTriangles)
+{
+    using namespace mesh_simplify;
+
+    // weld by exact position
+    std::vector<uint32_t> weld(vertices.size());
+    std::vector<glm::dvec3> position;
+    std::vector<std::vector<uint32_t>> copies;
+    {
+        struct Key
+        {
+            uint32_t bits[3];
+            bool operator==(const Key& o) const { return std::memcmp(bits, o.bits, sizeof(bits)) == 0; }
+        };
+        struct KeyHash
+        {
+            size_t operator()(const Key& k) const { return (k.bits[0] * 73856093u) ^ (k.bits[1] * 19349663u) ^ (k.bits[2] * 83492791u); }
+        };
+        std::unordered_map<Key, uint32_t, KeyHash> ids;
+        for (size_t v = 0; v < vertices.size(); v++)
+        {
+            Key key;
+            std::memcpy(key.bits, &vertices[v].Position, sizeof(key.bits));
+            auto found = ids.emplace(key, static_cast<uint32_t>(position.size()));
+            if (found.second)
+            {
+                position.push_back(glm::dvec3(vertices[v].Position));
+                copies.emplace_back();
+            }
+            weld[v] = found.first->second;
+            copies[weld[v]].push_back(static_cast<uint32_t>(v));
+        }
+    }
+    const size_t vertexCount = position.size();
+
+    // triangles over welded ids, each corner remembers the original vertex it draws with
+    std::vector<uint32_t> tri, corner;
+    for (size_t t = 0; t + 2 < indices.size(); t += 3)
+    {
+        uint32_t a = weld[indices[t]], b = weld[indices[t + 1]], c = weld[indices[t + 2]];
+        if (a == b || b == c || a == c)
+            continue;
+        tri.insert(tri.end(), {a, b, c});
+        corner.insert(corner.end(), {indices[t], indices[t + 1], indices[t + 2]});
+    }
+    const size_t triangleCount = tri.size() / 3;
+    std::vector<bool> triangleAlive(triangleCount, true);
+    std::vector<std::vector<uint32_t>> trianglesOf(vertexCount);
+    for (size_t t = 0; t < triangleCount; t++)
+        for (int k = 0; k < 3; k++)
+            trianglesOf[tri[3 * t + k]].push_back(static_cast<uint32_t>(t));
+
+    // plane quadrics weighted by area, plus a heavily weighted side plane along every boundary edge
+    std::vector<Quadric> quadric(vertexCount);
+    std::unordered_map<uint64_t, int> edgeUse;
+    auto edgeKey = [](uint32_t a, uint32_t b) { return a < b ? (uint64_t(a) << 32 | b) : (uint64_t(b) << 32 | a); };
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        const glm::dvec3 &p0 = position[tri[3 * t]], &p1 = position[tri[3 * t + 1]], &p2 = position[tri[3 * t + 2]];
+        glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+        const double area = glm::length(n);
+        if (area <= 0.0)
+            continue;
+        n /= area;
+        for (int k = 0; k < 3; k++)
+        {
+            quadric[tri[3 * t + k]].addPlane(n, -glm::dot(n, p0), area);
+            edgeUse[edgeKey(tri[3 * t + k], tri[3 * t + (k + 1) % 3])]++;
+        }
+    }
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        const glm::dvec3 &p0 = position[tri[3 * t]], &p1 = position[tri[3 * t + 1]], &p2 = position[tri[3 * t + 2]];
+        const glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+        for (int k = 0; k < 3; k++)
+        {
+            uint32_t a = tri[3 * t + k], b = tri[3 * t + (k + 1) % 3];
+            if (edgeUse[edgeKey(a, b)] != 1)
+                continue;
+            const glm::dvec3 edge = position[b] - position[a];
+            glm::dvec3 side = glm::cross(edge, n);
+            const double length = glm::length(side);
+            if (length <= 0.0)
+                continue;
+            side /= length;
+            const double weight = 10.0 * glm::dot(edge, edge);
+            quadric[a].addPlane(side, -glm::dot(side, position[a]), weight);
+            quadric[b].addPlane(side, -glm::dot(side, position[a]), weight);
+        }
+    }
+
+    std::vector<uint32_t> version(vertexCount, 0);
+    std::vector<bool> vertexAlive(vertexCount, true);
+    std::priority_queue<Candidate> heap;
+    auto push = [&](uint32_t from, uint32_t to) {
+        Quadric q = quadric[from];
+        q.add(quadric[to]);
+        heap.push(Candidate{q.error(position[to]), from, to, version[from], version[to]});
+    };
+    auto neighbours = [&](uint32_t v, std::vector<uint32_t>& out) {
+        out.clear();
+        for (uint32_t t : trianglesOf[v])
+        {
+            if (!triangleAlive[t]) continue;
+            for (int k = 0; k < 3; k++)
+                if (tri[3 * t + k] != v) out.push_back(tri[3 * t + k]);
+        }
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+    };
+    for (size_t t = 0; t < triangleCount; t++)
+        for (int k = 0; k < 3; k++)
+        {
+            push(tri[3 * t + k], tri[3 * t + (k + 1) % 3]);
+            push(tri[3 * t + (k + 1) % 3], tri[3 * t + k]);
+        }
+
+    size_t live = triangleCount;
+    std::vector<uint32_t> aroundFrom, aroundTo, shared;
+    while (live > targetTriangles && !heap.empty())
+    {
+        const Candidate c = heap.top();
+        heap.pop();
+        if (!vertexAlive[c.from] || !vertexAlive[c.to] || version[c.from] != c.fromVersion || version[c.to] != c.toVersion)
+            continue;
+
+        // link condition: the vertices around both ends are only the ones across the edge's own triangles
+        neighbours(c.from, aroundFrom);
+        neighbours(c.to, aroundTo);
+        if (!std::binary_search(aroundFrom.begin(), aroundFrom.end(), c.to))
+            continue;
+        shared.clear();
+        std::set_intersection(aroundFrom.begin(), aroundFrom.end(), aroundTo.begin(), aroundTo.end(), std::back_inserter(shared));
+        size_t edgeTriangles = 0;
+        for (uint32_t t : trianglesOf[c.from])
+            if (triangleAlive[t] && (tri[3 * t] == c.to || tri[3 * t + 1] == c.to || tri[3 * t + 2] == c.to))
+                edgeTriangles++;
+        if (shared.size() != edgeTriangles)
+            continue;
+
+        // refuse collapses that turn a remaining triangle over
+        bool flips = false;
+        for (uint32_t t : trianglesOf[c.from])
+        {
+            if (!triangleAlive[t]) continue;
+            glm::dvec3 before[3], after[3];
+            bool touchesTo = false;
+            for (int k = 0; k < 3; k++)
+            {
+                before[k] = after[k] = position[tri[3 * t + k]];
+                if (tri[3 * t + k] == c.from) after[k] = position[c.to];
+                if (tri[3 * t + k] == c.to) touchesTo = true;
+            }
+            if (touchesTo) continue;
+            const glm::dvec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+            const glm::dvec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+            if (glm::dot(n0, n1) <= 0.0) { flips = true; break; }
+        }
+        if (flips)
+            continue;
+
+        for (uint32_t t : trianglesOf[c.from])
+        {
+            if (!triangleAlive[t]) continue;
+            int slot = -1;
+            bool touchesTo = false;
+            for (int k = 0; k < 3; k++)
+            {
+                if (tri[3 * t + k] == c.from) slot = k;
+                if (tri[3 * t + k] == c.to) touchesTo = true;
+            }
+            if (touchesTo)
+            {
+                triangleAlive[t] = false;
+                live--;
+                continue;
+            }
+            // the corner moves onto the copy of the target that keeps its texture coordinate best
+            const glm::vec2 uv = vertices[corner[3 * t + slot]].TexCoords;
+            uint32_t best = copies[c.to][0];
+            float bestDistance = 1e30f;
+            for (uint32_t copy : copies[c.to])
+            {
+                const glm::vec2 d = vertices[copy].TexCoords - uv;
+                if (glm::dot(d, d) < bestDistance) { bestDistance = glm::dot(d, d); best = copy; }
+            }
+            tri[3 * t + slot] = c.to;
+            corner[3 * t + slot] = best;
+            trianglesOf[c.to].push_back(t);
+        }
+        vertexAlive[c.from] = false;
+        trianglesOf[c.from].clear();
+        quadric[c.to].add(quadric[c.from]);
+        version[c.to]++;
+        neighbours(c.to, aroundTo);
+        // only the edges at the target changed cost, the version bump drops their old entries
+        for (uint32_t w : aroundTo)
+        {
+            push(c.to, w);
+            push(w, c.to);
+        }
+    }
+
+    std::vector<unsigned int> result;
+    result.reserve(live * 3);
+    for (size_t t = 0; t < triangleCount; t++)
+        if (triangleAlive[t])
+            result.insert(result.end(), {corner[3 * t], corner[3 * t + 1], corner[3 * t + 2]});
+    return result;
+}
+
+#endif
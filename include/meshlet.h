@@ -0,0 +1,166 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <glm.hpp>
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+// A mesh split into meshlets for the mesh-shader path (meshlet_renderer.h): runs of at most MESHLET_MAX_TRIANGLES
+// triangles over at most MESHLET_MAX_VERTICES vertices, each with a bounding sphere and a normal cone so a task
+// shader can drop a whole cluster that is off screen, facing away or hidden. Built greedily along the index order,
+// which mesh_optimize.h has already made local, so neighbouring triangles share a meshlet. The limits are the ones
+// NVIDIA recommends for GL_NV_mesh_shader (126 primitives, rounded down to a multiple of four for packed writes).
+// Cooked into the model cache next to the BVH.
+static const unsigned int MESHLET_MAX_VERTICES = 64;
+static const unsigned int MESHLET_MAX_TRIANGLES = 124;
+
+// one cluster as the shaders read it (std430: sphere, cone, range). The cone culls when the eye sees every
+// triangle from behind: dot(center - eye, coneAxis) >= coneCutoff * |center - eye| + radius; a cutoff of 1 never
+// culls. Part of the model cache format.
+struct Meshlet
+{
+    float center[3];
+    float radius;
+    float coneAxis[3];
+    float coneCutoff;
+    uint32_t vertexOffset;      // into MeshletSet::vertices
+    uint32_t triangleOffset;    // into MeshletSet::triangles
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+};
+static_assert(sizeof(Meshlet) == 48, "meshlets are part of the model cache format");
+
+// every meshlet of a mesh. vertices are the mesh's vertex indices a meshlet uses, triangles three bytes (low
+// first) indexing into the meshlet's own run of them.
+struct MeshletSet
+{
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> vertices;
+    std::vector<uint32_t> triangles;
+
+    bool empty() const { return meshlets.empty(); }
+    size_t bytes() const { return meshlets.size() * sizeof(Meshlet) + (vertices.size() + triangles.size()) * sizeof(uint32_t); }
+
+    // whether the eye at eye (in the mesh's space) sees any triangle of meshlet m from the front, as the task
+    // shader decides it
+    bool facing(size_t m, const glm::vec3& eye) const
+    {
+        const Meshlet& meshlet = meshlets[m];
+        const glm::vec3 toCenter = glm::vec3(meshlet.center[0], meshlet.center[1], meshlet.center[2]) - eye;
+        return glm::dot(toCenter, glm::vec3(meshlet.coneAxis[0], meshlet.coneAxis[1], meshlet.coneAxis[2]))
+             < meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius;
+    }
+};
+
+namespace meshlet_detail {
+
+// the sphere and cone of the triangles of one meshlet, from their positions
+template <typename V>
+void bound(Meshlet& meshlet, const std::vector<V>& vertices, const std::vector<uint32_t>& local, const std::vector<uint32_t>& triangles)
+{
+    glm::vec3 lo(INFINITY), hi(-INFINITY);
+    for (uint32_t v = 0; v < meshlet.vertexCount; v++)
+    {
+        lo = glm::min(lo, vertices[local[meshlet.vertexOffset + v]].Position);
+        hi = glm::max(hi, vertices[local[meshlet.vertexOffset + v]].Position);
+    }
+    const glm::vec3 center = (lo + hi) * 0.5f;
+    float radius = 0.0f;
+    for (uint32_t v = 0; v < meshlet.vertexCount; v++)
+        radius = std::max(radius, glm::length(vertices[local[meshlet.vertexOffset + v]].Position - center));
+
+    // the normals' mean as the axis, the cone as wide as the one farthest from it
+    std::vector<glm::vec3> normals;
+    normals.reserve(meshlet.triangleCount);
+    glm::vec3 axis(0.0f);
+    for (uint32_t t = 0; t < meshlet.triangleCount; t++)
+    {
+        const uint32_t packed = triangles[meshlet.triangleOffset + t];
+        const glm::vec3& a = vertices[local[meshlet.vertexOffset + (packed & 0xFF)]].Position;
+        const glm::vec3& b = vertices[local[meshlet.vertexOffset + ((packed >> 8) & 0xFF)]].Position;
+        const glm::vec3& c = vertices[local[meshlet.vertexOffset + ((packed >> 16) & 0xFF)]].Position;
+        const glm::vec3 normal = glm::cross(b - a, c - a);
+        const float length = glm::length(normal);
+        if (length <= 0.0f)
+            continue;
+        normals.push_back(normal / length);
+        axis += normals.back();
+    }
+    float cutoff = 1.0f;
+    const float axisLength = glm::length(axis);
+    if (axisLength > 0.0f)
+    {
+        axis /= axisLength;
+        float minDot = 1.0f;
+        for (const glm::vec3& normal : normals)
+            minDot = std::min(minDot, glm::dot(normal, axis));
+        // a cone wider than a hemisphere culls nothing
+        if (minDot > 0.0f)
+            cutoff = std::sqrt(1.0f - minDot * minDot);
+    }
+    else
+        axis = glm::vec3(0.0f, 0.0f, 1.0f);
+    for (int k = 0; k < 3; k++)
+    {
+        meshlet.center[k] = center[k];
+        meshlet.coneAxis[k] = axis[k];
+    }
+    meshlet.radius = radius;
+    meshlet.coneCutoff = cutoff;
+}
+
+} // namespace meshlet_detail
+
+// the meshlets of a mesh, its triangles in index order; V needs Position (vec3)
+template <typename V>
+MeshletSet buildMeshlets(const std::vector<V>& vertices, const std::vector<unsigned int>& indices)
+{
+    const uint32_t NONE = 0xFFFFFFFFu;
+    MeshletSet set;
+    std::vector<uint32_t> owner(vertices.size(), NONE);     // the meshlet a vertex was last given a slot in
+    std::vector<uint8_t> slot(vertices.size(), 0);
+    Meshlet current{};
+
+    auto finish = [&]() {
+        if (current.triangleCount == 0)
+            return;
+        meshlet_detail::bound(current, vertices, set.vertices, set.triangles);
+        set.meshlets.push_back(current);
+        current = Meshlet{};
+        current.vertexOffset = static_cast<uint32_t>(set.vertices.size());
+        current.triangleOffset = static_cast<uint32_t>(set.triangles.size());
+    };
+
+    for (size_t t = 0; t + 2 < indices.size(); t += 3)
+    {
+        const uint32_t id = static_cast<uint32_t>(set.meshlets.size());
+        unsigned int fresh = 0;
+        for (unsigned int k = 0; k < 3; k++)
+            fresh += owner[indices[t + k]] != id ? 1 : 0;
+        // corners repeated within the triangle are counted twice, which only ends a meshlet a little early
+        if (current.vertexCount + fresh > MESHLET_MAX_VERTICES || current.triangleCount + 1 > MESHLET_MAX_TRIANGLES)
+            finish();
+        const uint32_t meshletId = static_cast<uint32_t>(set.meshlets.size());
+        uint32_t packed = 0;
+        for (unsigned int k = 0; k < 3; k++)
+        {
+            const unsigned int v = indices[t + k];
+            if (owner[v] != meshletId)
+            {
+                owner[v] = meshletId;
+                slot[v] = static_cast<uint8_t>(current.vertexCount++);
+                set.vertices.push_back(v);
+            }
+            packed |= static_cast<uint32_t>(slot[v]) << (8 * k);
+        }
+        set.triangles.push_back(packed);
+        current.triangleCount++;
+    }
+    finish();
+    return set;
+}
+
+#endif
@@ -0,0 +1,226 @@
+#ifndef MESHLET_RENDERER_H
+#define MESHLET_RENDERER_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <model.h>
+#include <shader.h>
+#include <hiz.h>
+#include <meshlet.h>
+#include <gpu_memory.h>
+#include <gl_state_cache.h>
+#include <gl_debug.h>
+#include <profiler.h>
+
+#include <cstring>
+#include <vector>
+#include <string>
+
+// GL_NV_mesh_shader, loaded by hand like bindless_textures.h: the bundled glad is core 4.6 without extensions.
+// Only glDrawMeshTasksNV is needed, the stages themselves are compiled through Shader with the enums below.
+class MeshShaders
+{
+public:
+    static const GLenum TASK_SHADER = 0x955A;   // GL_TASK_SHADER_NV
+    static const GLenum MESH_SHADER = 0x9559;   // GL_MESH_SHADER_NV
+
+    // looks for the extension and its entry point, call once after gladLoadGLLoader with the same loader
+    static bool load(GLADloadproc loader)
+    {
+        State& s = state();
+        s.available = false;
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        bool listed = false;
+        for (GLint e = 0; e < count && !listed; e++)
+        {
+            const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(e)));
+            listed = name && std::strcmp(name, "GL_NV_mesh_shader") == 0;
+        }
+        if (!listed)
+            return false;
+        s.drawMeshTasks = reinterpret_cast<DrawMeshTasks>(loader("glDrawMeshTasksNV"));
+        s.available = s.drawMeshTasks != nullptr;
+        return s.available;
+    }
+
+    static bool available() { return state().available; }
+
+    // count task workgroups from first on, with the program in use
+    static void drawMeshTasks(GLuint first, GLuint count)
+    {
+        if (state().available)
+            state().drawMeshTasks(first, count);
+    }
+
+private:
+    typedef void (APIENTRYP DrawMeshTasks)(GLuint first, GLuint count);
+
+    struct State
+    {
+        bool available = false;
+        DrawMeshTasks drawMeshTasks = nullptr;
+    };
+
+    static State& state()
+    {
+        static State s;
+        return s;
+    }
+};
+
+// Draws a static model's meshes as meshlets (meshlet.h) through task and mesh shaders: every task workgroup tests
+// TASK_MESHLETS meshlets against the view frustum, their normal cone and, with a captured HiZ, last frame's depth,
+// and launches a mesh workgroup for each that survives, which reads the mesh's own vertex buffer. The model must
+// be in VERTEX_LAYOUT_FULL and its meshes come with meshlets from the import or the model cache. Construct it only
+// when MeshShaders::available(); a model without meshlets is drawn through Mesh::Draw with fallback instead.
+class MeshletRenderer
+{
+public:
+    static const unsigned int MESHLET_SSBO = 21;
+    static const unsigned int MESHLET_VERTEX_SSBO = 22;
+    static const unsigned int MESHLET_TRIANGLE_SSBO = 23;
+    static const unsigned int VERTEX_SSBO = 24;     // the mesh's vertex buffer, read as words
+    static const unsigned int STATS_SSBO = 25;
+    static const unsigned int TASK_MESHLETS = 32;   // local_size_x of shaders.2/meshlet.task
+
+    bool coneCulling = true;
+    bool frustumCulling = true;
+
+    MeshletRenderer(const char* taskPath, const char* meshPath, const char* fragmentPath)
+        : shader({{MeshShaders::TASK_SHADER, taskPath}, {MeshShaders::MESH_SHADER, meshPath}, {GL_FRAGMENT_SHADER, fragmentPath}})
+    {
+        stats.create(GL_SHADER_STORAGE_BUFFER, "Meshlet stats");
+        const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        const uint32_t zero = 0;
+        stats.storage(sizeof(uint32_t), &zero, flags);
+        counter = static_cast<volatile uint32_t*>(glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, sizeof(uint32_t), flags));
+    }
+
+    ~MeshletRenderer()
+    {
+        if (fence)
+            glDeleteSync(fence);
+    }
+
+    MeshletRenderer(const MeshletRenderer&) = delete;
+    MeshletRenderer& operator=(const MeshletRenderer&) = delete;
+
+    // the program, for the fragment stage's uniforms; draw leaves it in use
+    Shader& program() { return shader; }
+
+    // uploads the meshlets of model's meshes once, later calls only add meshes that are new
+    void upload(const Model& model)
+    {
+        for (size_t m = buffers.size(); m < model.meshes.size(); m++)
+        {
+            const MeshletSet& set = model.meshes[m].meshlets;
+            MeshBuffers gpu;
+            gpu.count = static_cast<unsigned int>(set.meshlets.size());
+            if (!set.empty())
+            {
+                const std::string label = "Meshlets " + std::to_string(m);
+                gpu.meshlets.create(GL_SHADER_STORAGE_BUFFER, label.c_str());
+                gpu.meshlets.storage(set.meshlets.size() * sizeof(Meshlet), set.meshlets.data(), 0);
+                gpu.vertices.create(GL_SHADER_STORAGE_BUFFER, (label + " vertices").c_str());
+                gpu.vertices.storage(set.vertices.size() * sizeof(uint32_t), set.vertices.data(), 0);
+                gpu.triangles.create(GL_SHADER_STORAGE_BUFFER, (label + " triangles").c_str());
+                gpu.triangles.storage(set.triangles.size() * sizeof(uint32_t), set.triangles.data(), 0);
+            }
+            buffers.push_back(std::move(gpu));
+        }
+    }
+
+    // draws model at modelMatrix, which must scale uniformly for the spheres and cones to hold. occluders culls
+    // against last frame's depth when it is captured. The Matrices block holds this frame's camera.
+    void draw(Model& model, const glm::mat4& modelMatrix, const glm::vec3& cameraPosition, const HiZ* occluders, Shader& fallback)
+    {
+        PROFILE_SCOPE("MeshletRenderer::draw");
+        GL_DEBUG_GROUP("Meshlets");
+        upload(model);
+        readStats();
+
+        const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(modelMatrix)));
+        shader.use();
+        shader.setMat4("model", modelMatrix);
+        shader.setMat3("normalMatrix", normalMatrix);
+        shader.setFloat("modelScale", glm::length(glm::vec3(modelMatrix[0])));
+        shader.setVec3("cameraPosition", cameraPosition);
+        shader.setBool("coneCulling", coneCulling);
+        shader.setBool("frustumCulling", frustumCulling);
+        const bool occlusion = occluders && occluders->valid();
+        shader.setBool("occlusion", occlusion);
+        if (occlusion)
+            occluders->apply(shader, cameraPosition);
+        // the counter is only added to while no earlier frame's total is still being waited for
+        const bool counting = fence == nullptr;
+        shader.setBool("countVisible", counting);
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, STATS_SSBO, stats.id());
+
+        drawnMeshlets = 0;
+        for (size_t m = 0; m < model.meshes.size(); m++)
+        {
+            Mesh& mesh = model.meshes[m];
+            const MeshBuffers& gpu = buffers[m];
+            if (gpu.count == 0)
+            {
+                fallback.use();
+                fallback.setMat4("model", modelMatrix);
+                fallback.setMat3("normalMatrix", normalMatrix);
+                mesh.Draw(fallback);
+                shader.use();
+                continue;
+            }
+            mesh.bindSamplers(shader);
+            mesh.bindTextures();
+            glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, MESHLET_SSBO, gpu.meshlets.id());
+            glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, MESHLET_VERTEX_SSBO, gpu.vertices.id());
+            glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, MESHLET_TRIANGLE_SSBO, gpu.triangles.id());
+            glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, VERTEX_SSBO, mesh.vertexBuffer());
+            shader.setInt("firstVertex", mesh.baseVertex());
+            shader.setInt("meshletCount", static_cast<int>(gpu.count));
+            MeshShaders::drawMeshTasks(0, (gpu.count + TASK_MESHLETS - 1) / TASK_MESHLETS);
+            drawnMeshlets += gpu.count;
+        }
+        if (counting)
+            fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    // meshlets submitted by the last draw, and how many of them survived culling in the latest frame read back
+    unsigned int submittedMeshlets() const { return drawnMeshlets; }
+    unsigned int visibleMeshlets() const { return lastVisible; }
+
+private:
+    struct MeshBuffers
+    {
+        GlBuffer meshlets{GPU_MEMORY_GEOMETRY};
+        GlBuffer vertices{GPU_MEMORY_GEOMETRY};
+        GlBuffer triangles{GPU_MEMORY_GEOMETRY};
+        unsigned int count = 0;
+    };
+
+    // takes the count of the frame the fence closed once the GPU is past it, without waiting
+    void readStats()
+    {
+        if (fence == nullptr)
+            return;
+        const GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            return;
+        glDeleteSync(fence);
+        fence = nullptr;
+        lastVisible = *counter;
+        *counter = 0;
+    }
+
+    Shader shader;
+    std::vector<MeshBuffers> buffers;
+    GlBuffer stats{GPU_MEMORY_OTHER};
+    volatile uint32_t* counter = nullptr;
+    GLsync fence = nullptr;
+    unsigned int drawnMeshlets = 0;
+    unsigned int lastVisible = 0;
+};
+
+#endif
@@ -4,13 +4,25 @@
 #include <glad/glad.h>
 #include <glm.hpp>
 #include <gtc/matrix_transform.hpp>
+#include <gtc/type_ptr.hpp>
 #include <stb_image.h>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#include <assimp/DefaultIOSystem.h>
+#include <assimp/MemoryIOWrapper.h>
 
 #include <mesh.h>
+#include <model_cache.h>
+#include <mesh_sdf.h>
+#include <gltf.h>
+#include <scene_graph.h>
+#include <skeletal_animation.h>
+#include <texture_cache.h>
 #include <shader.h>
+#include <thread_pool.h>
+#include <profiler.h>
+#include <alloc_tracker.h>
 
 #include <string>
 #include <fstream>
@@ -18,236 +30,627 @@
 #include <iostream>
 #include <map>
 #include <vector>
+#include <unordered_map>
+#include <algorithm>
 
 using namespace std;
 
 unsigned int TextureFromFile(char const * path, const string &directory, bool gammaCorrection);
 
-class Model 
-{
-public:
-    // model data 
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
-    vector<Mesh>    meshes;
-    string directory;
-    bool gammaCorrection;
+// what every model is imported with, part of the key of its cooked cache. Joining identical vertices is what
+// lets the vertex cache reuse them at all, every corner of an OBJ face is a vertex of its own without it.
+static const unsigned int MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals | aiProcess_FlipUVs |
+                                               aiProcess_CalcTangentSpace;
+
+// The Assimp side of an import: the scene's meshes as ImportedMesh, textures by type and path only. Nothing here
+// touches GL.
+namespace model_import {
 
-    // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+// all material textures of a given type, by type name and path. Model loads them when it uploads the mesh.
+inline vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+{
+    vector<Texture> textures;
+    for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
     {
-        loadModel(path);
+        aiString str;
+        mat->GetTexture(type, i, &str);
+        textures.push_back(Texture{0, typeName, str.C_Str()});
     }
+    return textures;
+}
 
-    // draws the model, and thus all its meshes
-    void Draw(Shader &shader)
+// what Assimp's row-major matrices are in glm
+inline glm::mat4 toGlm(const aiMatrix4x4& m)
+{
+    return glm::transpose(glm::make_mat4(&m.a1));
+}
+
+// the mesh's bone weights into its vertices, bones named into skeleton's model-wide table. A vertex keeps its
+// MAX_BONE_INFLUENCE heaviest bones, weights renormalized to one.
+inline void loadBoneWeights(aiMesh *mesh, vector<Vertex>& vertices, Skeleton& skeleton)
+{
+    for (unsigned int b = 0; b < mesh->mNumBones; b++)
     {
-        for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
-    }
-    
-private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
-    {
-        // read file via ASSIMP
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-        // check for errors
-        if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+        const aiBone* bone = mesh->mBones[b];
+        const int id = static_cast<int>(skeleton.addBone(bone->mName.C_Str(), toGlm(bone->mOffsetMatrix)));
+        for (unsigned int w = 0; w < bone->mNumWeights; w++)
         {
-            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
+            const aiVertexWeight& weight = bone->mWeights[w];
+            if (weight.mVertexId >= vertices.size() || weight.mWeight <= 0.0f)
+                continue;
+            Vertex& vertex = vertices[weight.mVertexId];
+            int slot = 0;
+            for (int i = 1; i < MAX_BONE_INFLUENCE; i++)
+                if (vertex.m_Weights[i] < vertex.m_Weights[slot])
+                    slot = i;
+            if (vertex.m_Weights[slot] < weight.mWeight)
+            {
+                vertex.m_BoneIDs[slot] = id;
+                vertex.m_Weights[slot] = weight.mWeight;
+            }
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
-
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
     }
+    for (Vertex& vertex : vertices)
+    {
+        float sum = 0.0f;
+        for (int i = 0; i < MAX_BONE_INFLUENCE; i++)
+            sum += vertex.m_Weights[i];
+        if (sum > 0.0f)
+            for (int i = 0; i < MAX_BONE_INFLUENCE; i++)
+                vertex.m_Weights[i] /= sum;
+    }
+}
 
-    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+// skeleton is null when the caller does not want the bones, the vertices are left unskinned then
+inline ImportedMesh processMesh(aiMesh *mesh, const aiScene *scene, Skeleton* skeleton = nullptr)
+{
+    // data to fill, sized up front: aiProcess_Triangulate leaves three indices per face
+    ImportedMesh imported;
+    vector<Vertex>& vertices = imported.vertices;
+    vector<unsigned int>& indices = imported.indices;
+    vector<Texture>& textures = imported.textures;
+    vertices.reserve(mesh->mNumVertices);
+    indices.reserve(static_cast<size_t>(mesh->mNumFaces) * 3);
+
+    // walk through each of the mesh's vertices
+    for(unsigned int i = 0; i < mesh->mNumVertices; i++)
     {
-        // process each mesh located at the current node
-        for(unsigned int i = 0; i < node->mNumMeshes; i++)
+        Vertex vertex;
+        // no bone until loadBoneWeights gives it some, id -1 weight 0 in every slot
+        for (int b = 0; b < MAX_BONE_INFLUENCE; b++)
+        {
+            vertex.m_BoneIDs[b] = -1;
+            vertex.m_Weights[b] = 0.0f;
+        }
+        glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
+        // positions
+        vector.x = mesh->mVertices[i].x;
+        vector.y = mesh->mVertices[i].y;
+        vector.z = mesh->mVertices[i].z;
+        vertex.Position = vector;
+        // normals
+        if (mesh->HasNormals())
         {
-            // the node object only contains indices to index the actual objects in the scene. 
-            // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            vector.x = mesh->mNormals[i].x;
+            vector.y = mesh->mNormals[i].y;
+            vector.z = mesh->mNormals[i].z;
+            vertex.Normal = vector;
         }
-        // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
-        for(unsigned int i = 0; i < node->mNumChildren; i++)
+        // texture coordinates
+        if(mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
         {
-            processNode(node->mChildren[i], scene);
+            glm::vec2 vec;
+            // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't 
+            // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
+            vec.x = mesh->mTextureCoords[0][i].x; 
+            vec.y = mesh->mTextureCoords[0][i].y;
+            vertex.TexCoords = vec;
+            // tangent
+            vector.x = mesh->mTangents[i].x;
+            vector.y = mesh->mTangents[i].y;
+            vector.z = mesh->mTangents[i].z;
+            vertex.Tangent = vector;
+            // bitangent
+            vector.x = mesh->mBitangents[i].x;
+            vector.y = mesh->mBitangents[i].y;
+            vector.z = mesh->mBitangents[i].z;
+            vertex.Bitangent = vector;
         }
+        else
+            vertex.TexCoords = glm::vec2(0.0f, 0.0f);
 
+        vertices.push_back(vertex);
+    }
+    // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
+    for(unsigned int i = 0; i < mesh->mNumFaces; i++)
+    {
+        aiFace face = mesh->mFaces[i];
+        // retrieve all indices of the face and store them in the indices vector
+        for(unsigned int j = 0; j < face.mNumIndices; j++)
+            indices.push_back(face.mIndices[j]);        
     }
+    if (skeleton && mesh->mNumBones > 0)
+        loadBoneWeights(mesh, vertices, *skeleton);
+    // process materials
+    aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];    
+    // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
+    // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
+    // Same applies to other texture as the following list summarizes:
+    // diffuse: texture_diffuseN
+    // specular: texture_specularN
+    // normal: texture_normalN
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    // 1. diffuse maps
+    vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
+    textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+    // 2. specular maps
+    vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
+    textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+    // 3. normal maps
+    std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
+    textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+    // 4. height maps
+    std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
+    textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+    
+    return imported;
+}
+
+// processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
+// The node itself goes into nodes under parent, with its transform, so the hierarchy survives the flattening. With a
+// skeleton the meshes' bones are collected into it and the node names listed in nodeNames, for loadSkeleton.
+inline void processNode(aiNode *node, const aiScene *scene, vector<ImportedMesh>& meshes, vector<ImportedNode>& nodes, int32_t parent = -1,
+                        Skeleton* skeleton = nullptr, vector<string>* nodeNames = nullptr)
+{
+    const int32_t self = static_cast<int32_t>(nodes.size());
+    nodes.push_back(ImportedNode{parent, static_cast<uint32_t>(meshes.size()), node->mNumMeshes, toGlm(node->mTransformation)});
+    if (nodeNames)
+        nodeNames->push_back(node->mName.C_Str());
+    // process each mesh located at the current node
+    for(unsigned int i = 0; i < node->mNumMeshes; i++)
     {
-        // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        // the node object only contains indices to index the actual objects in the scene. 
+        // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
+        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+        meshes.push_back(processMesh(mesh, scene, skeleton));
+    }
+    // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
+    for(unsigned int i = 0; i < node->mNumChildren; i++)
+    {
+        processNode(node->mChildren[i], scene, meshes, nodes, self, skeleton, nodeNames);
+    }
+
+}
 
-        // walk through each of the mesh's vertices
-        for(unsigned int i = 0; i < mesh->mNumVertices; i++)
+// the hierarchy the bones hang from and the scene's animations, bones and channels resolved to nodes by name.
+// Channels of nodes the hierarchy does not have are dropped, ticks become seconds (25 per second when the file
+// does not say).
+inline void loadSkeleton(const aiScene *scene, const vector<ImportedNode>& nodes, const vector<string>& nodeNames, Skeleton& skeleton,
+                         vector<AnimationClip>& animations)
+{
+    unordered_map<string, uint32_t> nodeIndex;
+    for (size_t n = 0; n < nodeNames.size(); n++)
+        nodeIndex.emplace(nodeNames[n], static_cast<uint32_t>(n));
+    skeleton.nodeParent.resize(nodes.size());
+    skeleton.nodeRest.resize(nodes.size());
+    for (size_t n = 0; n < nodes.size(); n++)
+    {
+        skeleton.nodeParent[n] = nodes[n].parent;
+        skeleton.nodeRest[n] = nodes[n].transform;
+    }
+    if (!nodes.empty())
+        skeleton.globalInverse = glm::inverse(nodes[0].transform);
+    for (size_t b = 0; b < skeleton.boneCount(); b++)
+    {
+        auto found = nodeIndex.find(skeleton.boneNames[b]);
+        if (found == nodeIndex.end())
+            cout << "Model: bone " << skeleton.boneNames[b] << " has no node, it stays at the root" << endl;
+        skeleton.boneNode[b] = found != nodeIndex.end() ? found->second : 0;
+    }
+
+    for (unsigned int a = 0; a < scene->mNumAnimations; a++)
+    {
+        const aiAnimation* animation = scene->mAnimations[a];
+        const double ticksPerSecond = animation->mTicksPerSecond > 0.0 ? animation->mTicksPerSecond : 25.0;
+        const float secondsPerTick = static_cast<float>(1.0 / ticksPerSecond);
+        AnimationClip clip;
+        clip.name = animation->mName.C_Str();
+        clip.duration = static_cast<float>(animation->mDuration / ticksPerSecond);
+        for (unsigned int c = 0; c < animation->mNumChannels; c++)
         {
-            Vertex vertex;
-            glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
-            // positions
-            vector.x = mesh->mVertices[i].x;
-            vector.y = mesh->mVertices[i].y;
-            vector.z = mesh->mVertices[i].z;
-            vertex.Position = vector;
-            // normals
-            if (mesh->HasNormals())
+            const aiNodeAnim* keys = animation->mChannels[c];
+            auto found = nodeIndex.find(keys->mNodeName.C_Str());
+            if (found == nodeIndex.end())
+                continue;
+            AnimationChannel channel;
+            channel.node = found->second;
+            for (unsigned int k = 0; k < keys->mNumPositionKeys; k++)
             {
-                vector.x = mesh->mNormals[i].x;
-                vector.y = mesh->mNormals[i].y;
-                vector.z = mesh->mNormals[i].z;
-                vertex.Normal = vector;
+                const aiVectorKey& key = keys->mPositionKeys[k];
+                channel.positionTimes.push_back(static_cast<float>(key.mTime) * secondsPerTick);
+                channel.positions.push_back(glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
             }
-            // texture coordinates
-            if(mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
+            for (unsigned int k = 0; k < keys->mNumRotationKeys; k++)
             {
-                glm::vec2 vec;
-                // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't 
-                // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
-                vec.x = mesh->mTextureCoords[0][i].x; 
-                vec.y = mesh->mTextureCoords[0][i].y;
-                vertex.TexCoords = vec;
-                // tangent
-                vector.x = mesh->mTangents[i].x;
-                vector.y = mesh->mTangents[i].y;
-                vector.z = mesh->mTangents[i].z;
-                vertex.Tangent = vector;
-                // bitangent
-                vector.x = mesh->mBitangents[i].x;
-                vector.y = mesh->mBitangents[i].y;
-                vector.z = mesh->mBitangents[i].z;
-                vertex.Bitangent = vector;
+                const aiQuatKey& key = keys->mRotationKeys[k];
+                channel.rotationTimes.push_back(static_cast<float>(key.mTime) * secondsPerTick);
+                channel.rotations.push_back(glm::quat(key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z));
             }
-            else
-                vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-
-            vertices.push_back(vertex);
+            for (unsigned int k = 0; k < keys->mNumScalingKeys; k++)
+            {
+                const aiVectorKey& key = keys->mScalingKeys[k];
+                channel.scaleTimes.push_back(static_cast<float>(key.mTime) * secondsPerTick);
+                channel.scales.push_back(glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+            }
+            clip.channels.push_back(std::move(channel));
         }
-        // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
-        for(unsigned int i = 0; i < mesh->mNumFaces; i++)
+        animations.push_back(std::move(clip));
+    }
+}
+
+// Assimp's file access through the asset archive (asset_archive.h), so a model and what it references (an OBJ's
+// .mtl) come out of it; files it does not have are opened as usual
+class ArchiveIOSystem : public Assimp::DefaultIOSystem
+{
+public:
+    bool Exists(const char* path) const override
+    {
+        return assetArchive().find(path) != nullptr || Assimp::DefaultIOSystem::Exists(path);
+    }
+
+    Assimp::IOStream* Open(const char* path, const char* mode = "rb") override
+    {
+        const AssetArchiveEntry* entry = assetArchive().find(path);
+        if (!entry || (mode && std::strchr(mode, 'w')))
+            return Assimp::DefaultIOSystem::Open(path, mode);
+        if (const unsigned char* stored = assetArchive().stored(*entry))
+            return new Assimp::MemoryIOStream(stored, static_cast<size_t>(entry->bytes));
+        // the stream owns and frees the decompressed copy
+        uint8_t* bytes = new uint8_t[entry->bytes > 0 ? static_cast<size_t>(entry->bytes) : 1];
+        if (!assetArchive().extract(*entry, bytes))
         {
-            aiFace face = mesh->mFaces[i];
-            // retrieve all indices of the face and store them in the indices vector
-            for(unsigned int j = 0; j < face.mNumIndices; j++)
-                indices.push_back(face.mIndices[j]);        
+            delete[] bytes;
+            return nullptr;
         }
-        // process materials
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];    
-        // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
-        // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
-        // Same applies to other texture as the following list summarizes:
-        // diffuse: texture_diffuseN
-        // specular: texture_specularN
-        // normal: texture_normalN
-
-        // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-        // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-        // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-        // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-        
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
-    }
-
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
-    {
-        vector<Texture> textures;
-        for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+        return new Assimp::MemoryIOStream(bytes, static_cast<size_t>(entry->bytes), true);
+    }
+};
+
+} // namespace model_import
+
+// a model in CPU memory, imported and not uploaded yet
+struct ModelData
+{
+    string path;
+    string directory;
+    vector<ImportedMesh> meshes;
+    vector<ImportedNode> nodes;     // empty for a flat model, all meshes under one untransformed root
+    SignedDistanceField sdf;        // of the surface in model space, see mesh_sdf.h
+    Skeleton skeleton;              // empty for a model without bones
+    vector<AnimationClip> animations;
+};
+
+// Imports a model with supported ASSIMP extensions, static glTF 2.0 (.glb, .gltf) natively through gltf.h. A
+// cooked cache of the same source and import flags is used instead when there is one, see model_cache.h,
+// otherwise the import and the meshes' BVHs (built here, so the build stays off the GL thread) are cooked for the
+// next launch. With lodLevels above 1 the coarser levels are simplified too, see Mesh::simplifyLods. GL-free, so it
+// runs on any thread: Model uploads the result on the GL thread.
+inline ModelData importModel(string const &path, unsigned int lodLevels = 1, float lodRatio = 0.35f)
+{
+    PROFILE_SCOPE_DETAIL("importModel", path);
+    ALLOC_SCOPE(ALLOC_MODEL_IMPORT);
+    ModelData data;
+    data.path = path;
+    // retrieve the directory path of the filepath
+    data.directory = path.substr(0, path.find_last_of('/'));
+    ModelCacheKey key;
+    const bool keyed = modelCacheKey(path, MODEL_IMPORT_FLAGS, key);
+    if (!keyed || !readModelCache(modelCachePath(path), key, data.meshes, data.nodes, data.sdf))
+    {
+        // static glTF straight from its buffers (gltf.h), anything else and what that declines through Assimp
+        if (!gltf::isGltfPath(path) || !gltf::importGltf(path, data.meshes, data.nodes))
         {
-            aiString str;
-            mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
+            // read file via ASSIMP
+            Assimp::Importer importer;
+            // the importer owns its IO handler
+            if (assetArchive().mounted())
+                importer.SetIOHandler(new model_import::ArchiveIOSystem());
+            const aiScene* scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
+            // check for errors
+            if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
             {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory, this->gammaCorrection);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
+                cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+                return data;
             }
+            // process ASSIMP's root node recursively, nodes usually reference each mesh once
+            data.meshes.reserve(scene->mNumMeshes);
+            vector<string> nodeNames;
+            model_import::processNode(scene->mRootNode, scene, data.meshes, data.nodes, -1, &data.skeleton, &nodeNames);
+            model_import::loadSkeleton(scene, data.nodes, nodeNames, data.skeleton, data.animations);
+        }
+        // reordered for the vertex cache, overdraw and fetches (mesh_optimize.h) once here, the cache keeps the order
+        for (ImportedMesh& mesh : data.meshes)
+        {
+            optimizeMesh(mesh.vertices, mesh.indices);
+            mesh.bvh.build(mesh.vertices, mesh.indices);
+            mesh.meshlets = buildMeshlets(mesh.vertices, mesh.indices);
         }
-        return textures;
+        // the cache has no place for bones or clips, an animated model is imported through Assimp every time. A
+        // read-only resource directory only costs the cache, the model itself is loaded. A field of the bind pose
+        // would not follow the skin, animated models go without.
+        const bool animated = !data.skeleton.empty() || !data.animations.empty();
+        if (!animated)
+            data.sdf = bakeSignedDistanceField(data.meshes, data.nodes);
+        if (keyed && !animated && !writeModelCache(modelCachePath(path), key, data.meshes, data.nodes, data.sdf))
+            cout << "Model: could not write the cooked cache of " << path << endl;
     }
-};
+    if (lodLevels > 1)
+        for (ImportedMesh& mesh : data.meshes)
+            mesh.lods = Mesh::simplifyLods(mesh.vertices, mesh.indices, lodLevels, lodRatio);
+    return data;
+}
 
-unsigned int TextureFromFile(char const * path, const string &directory, bool gammaCorrection)
+class Model 
 {
-    string filename = string(path);
-    filename = directory + '/' + filename;
+public:
+    // model data 
+    vector<Texture> textures_loaded;	// the model's textures, each holds one reference in textureCache()
+    vector<Mesh>    meshes;
+    string directory;
+    bool gammaCorrection;
+    VertexLayout vertexLayout;      // how every mesh of the model stores its vertices on the GPU
+    bool pooled;                    // the meshes live in geometryPool() instead of buffers of their own
+    SceneGraph nodes;               // the file's node hierarchy, one untransformed root for a flat model
+    vector<uint32_t> meshNodes;     // the node of each mesh
+    Skeleton skeleton;              // the bones a skinned model's vertices hang from, empty when it has none
+    vector<AnimationClip> animations;
+    SignedDistanceField sdf;        // of the surface in model space for contact queries, kept through releaseCpuData
+
+    // constructor, expects a filepath to a 3D model. Static models can pick a smaller vertex layout.
+    Model(string const &path, bool gamma = false, VertexLayout layout = VERTEX_LAYOUT_FULL, bool pooled = false)
+        : Model(importModel(path), gamma, layout, pooled)
+    {
+    }
+
+    // uploads a model imported elsewhere, e.g. by ModelLoader on a loader thread
+    Model(ModelData data, bool gamma = false, VertexLayout layout = VERTEX_LAYOUT_FULL, bool pooled = false)
+        : gammaCorrection(gamma), vertexLayout(layout), pooled(pooled)
+    {
+        build(data);
+    }
+
+    // gives the textures back to textureCache(), which deletes those no other model uses
+    ~Model()
+    {
+        for (const Texture& texture : textures_loaded)
+            textureCache().release(texture.id);
+    }
+
+    Model(Model&&) = default;
+    Model& operator=(Model&&) = delete;
+
+    // simplified levels of detail for every mesh, see Mesh::generateLods
+    void generateLods(unsigned int levels, float ratio = 0.35f)
+    {
+        for (Mesh& mesh : meshes)
+            mesh.generateLods(levels, ratio);
+    }
+
+    // a position-only stream for every mesh's depth passes, see Mesh::createPositionStream
+    void createPositionStreams()
+    {
+        for (Mesh& mesh : meshes)
+            mesh.createPositionStream();
+    }
+
+    // drops the meshes' CPU copies, except for those flagged retainCpuData. LODs and a ModelBatch of a model
+    // that is not pooled need them, build those first.
+    void releaseCpuData()
+    {
+        for (Mesh& mesh : meshes)
+            mesh.releaseCpuData();
+    }
+
+    // levels every mesh has
+    unsigned int lodCount() const
+    {
+        unsigned int count = MAX_MESH_LODS;
+        for (const Mesh& mesh : meshes)
+            count = std::min<unsigned int>(count, static_cast<unsigned int>(std::max<size_t>(mesh.lods.size(), 1)));
+        return meshes.empty() ? 1 : count;
+    }
+
+    // where a mesh sits in the model, the product of its node's transforms
+    const glm::mat4& meshTransform(size_t mesh) const { return nodes.world(meshNodes[mesh]); }
+    // whether any mesh sits anywhere else than the model origin, ModelBatch cannot draw those
+    bool hasNodeTransforms() const { return nodeTransforms; }
+    // whether the vertices are skinned to bones, drawn through a bone palette (see SkinnedCrowd) and not the node
+    // transforms, which the palette includes; needs VERTEX_LAYOUT_FULL for the bone ids and weights
+    bool skinned() const { return !skeleton.empty(); }
+
+    // re-poses a node, with its number in the import's depth-first order, and everything below it
+    void setNodeTransform(uint32_t node, const glm::mat4& local)
+    {
+        nodes.setLocal(node, local);
+        nodes.update();
+        nodeTransforms = true;
+    }
+
+    // the nearest hit of a ray in model space on any mesh's triangles closer than hit.t, through their BVHs: hit is
+    // updated (with the mesh in *mesh) and true returned. t is along the ray as given, whatever the node transforms.
+    bool intersect(const BvhRay& ray, BvhHit& hit, size_t* mesh = nullptr) const
+    {
+        bool found = false;
+        for (size_t m = 0; m < meshes.size(); m++)
+        {
+            BvhRay local = ray;
+            if (nodeTransforms)
+            {
+                const glm::mat4 inverse = glm::inverse(meshTransform(m));
+                local.origin = glm::vec3(inverse * glm::vec4(ray.origin, 1.0f));
+                local.direction = glm::vec3(inverse * glm::vec4(ray.direction, 0.0f));
+            }
+            if (!meshes[m].bvh.intersect(local, hit))
+                continue;
+            found = true;
+            if (mesh)
+                *mesh = m;
+        }
+        return found;
+    }
+
+    // draws the model, and thus all its meshes
+    void Draw(Shader &shader)
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].Draw(shader);
+    }
+
+    // depth only, every mesh from its position stream where it has one
+    void DrawDepth() const
+    {
+        for (const Mesh& mesh : meshes)
+            mesh.DrawDepth();
+    }
+
+    // count instances of the model, records from baseInstance on, at a level of detail. Any model can be
+    // instanced this way, its vertex format is left alone (see InstanceBuffer).
+    void DrawInstanced(Shader &shader, const InstanceBuffer& instances, unsigned int count, unsigned int baseInstance = 0, unsigned int level = 0)
+    {
+        for (Mesh& mesh : meshes)
+            mesh.DrawInstanced(shader, instances, count, baseInstance, level);
+    }
+
+    // points every mesh's VAO at instances ahead of drawing them with Mesh::drawElementsInstanced
+    void bindInstances(const InstanceBuffer& instances)
+    {
+        for (Mesh& mesh : meshes)
+            mesh.bindInstances(instances);
+    }
     
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+private:
+    unordered_map<string, unsigned int> decodedTextures;    // uploaded by decodeTextures during a load, by path
+    bool nodeTransforms = false;
+    unordered_map<string, size_t> loadedByPath;             // index into textures_loaded
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+    // makes the meshes, after decoding every texture they reference up front in parallel, and adopts the levels
+    // of detail that were simplified with the import
+    void build(ModelData& data)
     {
-        GLenum internalFormat;
-        GLenum dataFormat;
-        if (nrComponents == 1)
+        PROFILE_SCOPE_DETAIL("Model::build", data.path);
+        directory = data.directory;
+        vector<pair<string, TextureUsage>> texturePaths;
+        for (const ImportedMesh& mesh : data.meshes)
+            for (const Texture& texture : mesh.textures)
+                texturePaths.emplace_back(texture.path, usageOf(texture.type));
+        decodeTextures(texturePaths);
+        const size_t firstMesh = meshes.size();
+        meshes.reserve(meshes.size() + data.meshes.size());
+        for (ImportedMesh& imported : data.meshes)
         {
-            internalFormat = dataFormat = GL_RED;
+            vector<Texture> textures;
+            textures.reserve(imported.textures.size());
+            for (const Texture& texture : imported.textures)
+                textures.push_back(loadTexture(texture.path.c_str(), texture.type));
+            meshes.emplace_back(std::move(imported.vertices), std::move(imported.indices), std::move(textures), vertexLayout, pooled);
+            meshes.back().label(labelOf(data.path) + " mesh " + to_string(meshes.size() - 1));
+            meshes.back().bvh = std::move(imported.bvh);
+            meshes.back().meshlets = std::move(imported.meshlets);
+            if (!imported.lods.empty())
+                meshes.back().adoptLods(imported.lods);
         }
-        else if (nrComponents == 3)
+        decodedTextures.clear();
+        buildNodes(data.nodes, firstMesh);
+        skeleton = std::move(data.skeleton);
+        animations = std::move(data.animations);
+        sdf = std::move(data.sdf);
+    }
+
+    // the import's nodes as the scene graph, their meshes from firstMesh on
+    void buildNodes(const vector<ImportedNode>& imported, size_t firstMesh)
+    {
+        meshNodes.resize(meshes.size(), 0);
+        if (imported.empty())
         {
-            internalFormat = gammaCorrection ? GL_SRGB : GL_RGB;
-            dataFormat = GL_RGB;
+            const uint32_t root = nodes.add(glm::mat4(1.0f));
+            for (size_t m = firstMesh; m < meshes.size(); m++)
+                meshNodes[m] = root;
         }
-        else if (nrComponents == 4)
+        vector<uint32_t> ids(imported.size());
+        for (size_t n = 0; n < imported.size(); n++)
         {
-            internalFormat = gammaCorrection ? GL_SRGB_ALPHA : GL_RGBA;
-            dataFormat = GL_RGBA;
+            const ImportedNode& node = imported[n];
+            ids[n] = nodes.add(node.transform, node.parent < 0 ? SceneGraph::NO_PARENT : ids[node.parent]);
+            for (uint32_t m = node.firstMesh; m < node.firstMesh + node.meshCount && firstMesh + m < meshes.size(); m++)
+                meshNodes[firstMesh + m] = ids[n];
         }
+        nodes.update(nullptr);
+        for (size_t m = firstMesh; m < meshes.size(); m++)
+            nodeTransforms = nodeTransforms || meshTransform(m) != glm::mat4(1.0f);
+    }
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, dataFormat, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT); 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // Decodes the images neither this model nor textureCache() has yet across workerPool() and uploads them here,
+    // on the GL thread, into decodedTextures for loadTexture to pick up. stb_image decodes (and block compression
+    // on a first run) are independent, the uploads are not (one context), so only the decode is split. A path
+    // keeps the usage of its first reference, as loadTexture does.
+    void decodeTextures(const vector<pair<string, TextureUsage>>& references)
+    {
+        PROFILE_SCOPE("Model::decodeTextures");
+        // streamed textures are decoded on the cache's loader threads instead, loadTexture only queues them
+        if (textureCache().streaming())
+            return;
+        vector<string> paths;
+        vector<TextureOptions> options;
+        for (const auto& reference : references)
+        {
+            const TextureOptions o = textureCache().options(gammaCorrection, reference.second);
+            if (loadedByPath.count(reference.first) != 0 || std::find(paths.begin(), paths.end(), reference.first) != paths.end()
+                || textureCache().contains(directory + '/' + reference.first, o))
+                continue;
+            paths.push_back(reference.first);
+            options.push_back(o);
+        }
+        vector<DecodedImage> images(paths.size());
+        // one slice per image, big images dominate and would serialize a slice holding several
+        workerPool().parallelFor(0, paths.size(), [&](size_t begin, size_t end, unsigned int) {
+            for (size_t i = begin; i < end; i++)
+                images[i] = DecodeTextureFile(directory + '/' + paths[i], options[i]);
+        }, static_cast<unsigned int>(paths.size()));
+        for (size_t i = 0; i < paths.size(); i++)
+            decodedTextures[paths[i]] = textureCache().acquire(directory + '/' + paths[i], options[i], images[i]);
+    }
 
-        stbi_image_free(data);
+    // normal maps are compressed to two channels, everything else keeps its colour
+    static TextureUsage usageOf(const string& typeName)
+    {
+        return typeName == "texture_normal" ? TEXTURE_NORMAL : TEXTURE_COLOR;
     }
-    else
+
+    // a texture of the model by its path relative to the directory. The model takes one reference per path, other
+    // models with the same file share the GL texture through textureCache().
+    Texture loadTexture(const char* path, const string& typeName)
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        // check if texture was loaded before and if so, skip loading a new texture
+        auto loaded = loadedByPath.find(path);
+        if (loaded != loadedByPath.end())
+            return textures_loaded[loaded->second];
+        Texture texture;
+        auto decoded = decodedTextures.find(path);
+        texture.id = decoded != decodedTextures.end() ? decoded->second : textureCache().acquire(this->directory + '/' + path, textureCache().options(this->gammaCorrection, usageOf(typeName)));
+        texture.type = typeName;
+        texture.path = path;
+        loadedByPath.emplace(texture.path, textures_loaded.size());
+        textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
+        return texture;
     }
+};
 
-    return textureID;
+// a texture of its own with the cache's defaults, not shared through textureCache()
+unsigned int TextureFromFile(char const * path, const string &directory, bool gammaCorrection)
+{
+    PROFILE_SCOPE_DETAIL("TextureFromFile", path);
+    const TextureOptions options = textureCache().options(gammaCorrection);
+    DecodedImage image = DecodeTextureFile(directory + '/' + string(path), options);
+    return UploadTexture(image, path, gammaCorrection);
 }
 #endif
@@ -0,0 +1,233 @@
+#ifndef MODEL_BATCH_H
+#define MODEL_BATCH_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <shader.h>
+#include <model.h>
+#include <bindless_textures.h>
+#include <gpu_memory.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <iostream>
+
+#define MAX_BATCH_TEXTURES 16
+
+// Every mesh of a model packed into one vertex and one element buffer (or, for a pooled model, the ranges it
+// already has in geometryPool()), drawn with a single
+// glMultiDrawElementsIndirect instead of one Mesh::Draw per mesh. Each mesh is one indirect command whose
+// baseVertex and firstIndex point at its slice of the shared buffers. The textures are bound once to consecutive
+// units behind a sampler array, and the vertex shader looks up the mesh's material (which units it samples) by
+// gl_DrawID, see shaders.2/batched.object.model.shader.vs. A model with more distinct textures than
+// MAX_BATCH_TEXTURES is not batched, valid() is false and Model::Draw is the way to draw it. With bindless
+// textures the materials hold resident texture handles instead, nothing is bound and there is no texture limit;
+// draw it with batched.bindless.object.model.shader.fs.
+class ModelBatch
+{
+public:
+    enum Binding {
+        BINDING_MATERIALS = 10
+    };
+
+    struct DrawElementsIndirectCommand
+    {
+        uint32_t count;
+        uint32_t instanceCount;
+        uint32_t firstIndex;
+        int32_t baseVertex;
+        uint32_t baseInstance;
+    };
+
+    // std430 uvec4, what one mesh samples: texture unit + 1, or a bindless handle. 0 when it has no texture of that kind.
+    struct Material
+    {
+        uint64_t diffuse;
+        uint64_t specular;
+    };
+
+    // bindless is ignored when the extension is not there
+    explicit ModelBatch(const Model& model, bool bindless = false) : bindlessHandles(bindless && BindlessTextures::available())
+    {
+        build(model);
+    }
+
+    ~ModelBatch()
+    {
+        release();
+    }
+
+    ModelBatch(const ModelBatch&) = delete;
+    ModelBatch& operator=(const ModelBatch&) = delete;
+
+    bool valid() const { return VAO != 0; }
+    bool bindless() const { return bindlessHandles; }
+    unsigned int drawCount() const { return static_cast<unsigned int>(commandCount); }
+
+    // one multi-draw for the whole model, the shader's per-object uniforms must already be set
+    void Draw(Shader& shader) const
+    {
+        if (!valid())
+            return;
+        if (!bindlessHandles)
+            bindTextures(shader);
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_MATERIALS, materialBuffer.id());
+        glState().bindVertexArray(VAO);
+        glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer.id());
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(commandCount), 0);
+        glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        glState().bindVertexArray(0);
+    }
+
+    void release()
+    {
+        if (VAO != 0 && !sharedGeometry)
+            glState().deleteVertexArrays(1, &VAO);
+        VAO = 0;
+        vertexBuffer.release();
+        indexBuffer.release();
+        commandBuffer.release();
+        materialBuffer.release();
+        sharedGeometry = false;
+        commandCount = 0;
+        textures.clear();
+    }
+
+private:
+    bool bindlessHandles;
+    bool sharedGeometry = false;                // VAO is geometryPool()'s, not ours to delete
+    unsigned int VAO = 0;
+    GlBuffer vertexBuffer{GPU_MEMORY_GEOMETRY};
+    GlBuffer indexBuffer{GPU_MEMORY_GEOMETRY};
+    GlBuffer commandBuffer{GPU_MEMORY_GEOMETRY};
+    GlBuffer materialBuffer{GPU_MEMORY_GEOMETRY};
+    size_t commandCount = 0;
+    std::vector<unsigned int> textures;         // GL names, bound to units 0..size-1
+    int textureUnits[MAX_BATCH_TEXTURES];
+
+    void bindTextures(Shader& shader) const
+    {
+        for (size_t unit = 0; unit < textures.size(); unit++)
+        {
+            glState().activeTexture(GL_TEXTURE0 + static_cast<GLenum>(unit));
+            glState().bindTexture(GL_TEXTURE_2D, textures[unit]);
+        }
+        glUniform1iv(shader.location("batchTextures"), MAX_BATCH_TEXTURES, textureUnits);
+        glState().activeTexture(GL_TEXTURE0);
+    }
+
+    // the unit of a texture, added on first use, -1 once the units run out
+    int unitFor(unsigned int id)
+    {
+        for (size_t unit = 0; unit < textures.size(); unit++)
+            if (textures[unit] == id)
+                return static_cast<int>(unit);
+        if (textures.size() >= MAX_BATCH_TEXTURES)
+            return -1;
+        textures.push_back(id);
+        return static_cast<int>(textures.size() - 1);
+    }
+
+    void build(const Model& model)
+    {
+        for (int unit = 0; unit < MAX_BATCH_TEXTURES; unit++)
+            textureUnits[unit] = unit;
+        if (model.meshes.empty())
+            return;
+        // one draw's meshes share the model matrix, the batch has no per-mesh transform to give them
+        if (model.hasNodeTransforms())
+        {
+            std::cout << "ModelBatch: " << model.directory << " places its meshes with node transforms, drawing per mesh" << std::endl;
+            return;
+        }
+
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        std::vector<DrawElementsIndirectCommand> commands;
+        std::vector<Material> materials;
+        for (const Mesh& mesh : model.meshes)
+        {
+            if (mesh.indexCount == 0)
+                continue;
+            // a pooled model is already in shared buffers, its commands point at the meshes' own ranges
+            if (model.pooled)
+            {
+                commands.push_back(DrawElementsIndirectCommand{mesh.indexCount, 1, mesh.firstIndex(), mesh.baseVertex(), 0});
+            }
+            else if (!mesh.hasCpuData())
+            {
+                std::cout << "ModelBatch: " << model.directory << " has released its CPU mesh data, drawing per mesh" << std::endl;
+                textures.clear();
+                return;
+            }
+            else
+            {
+                commands.push_back(DrawElementsIndirectCommand{mesh.indexCount, 1, static_cast<uint32_t>(indices.size()),
+                                                               static_cast<int32_t>(vertices.size()), 0});
+                vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+                indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.end());
+            }
+
+            // the first texture of each kind, what texture_diffuse1 and texture_specular1 are in Mesh::Draw
+            Material material{0, 0};
+            for (const Texture& texture : mesh.textures)
+            {
+                uint64_t* slot = texture.type == "texture_diffuse" ? &material.diffuse : texture.type == "texture_specular" ? &material.specular : nullptr;
+                if (slot == nullptr || *slot != 0)
+                    continue;
+                if (bindlessHandles)
+                {
+                    *slot = BindlessTextures::residentHandle(texture.id);
+                    continue;
+                }
+                const int unit = unitFor(texture.id);
+                *slot = static_cast<uint64_t>(unit + 1);
+                if (unit < 0)
+                {
+                    std::cout << "ModelBatch: more than " << MAX_BATCH_TEXTURES << " textures in " << model.directory << ", drawing per mesh" << std::endl;
+                    textures.clear();
+                    return;
+                }
+            }
+            materials.push_back(material);
+        }
+        commandCount = commands.size();
+        if (commandCount == 0)
+            return;
+
+        if (model.pooled)
+        {
+            sharedGeometry = true;
+            VAO = geometryPool().vao(model.vertexLayout);
+        }
+        else
+        {
+            glGenVertexArrays(1, &VAO);
+            glState().bindVertexArray(VAO);
+            labelObject(GL_VERTEX_ARRAY, VAO, "batch " + labelOf(model.directory) + " VAO");
+            vertexBuffer.create(GL_ARRAY_BUFFER, nullptr);
+            labelObject(GL_BUFFER, vertexBuffer.id(), "batch " + labelOf(model.directory) + " vertices");
+            // in the model's own vertex layout
+            uploadVertices(vertexBuffer, vertices, model.vertexLayout);
+            indexBuffer.create(GL_ELEMENT_ARRAY_BUFFER, nullptr);
+            labelObject(GL_BUFFER, indexBuffer.id(), "batch " + labelOf(model.directory) + " indices");
+            indexBuffer.storage(indices.size() * sizeof(unsigned int), indices.data(), 0);
+            glState().bindVertexArray(0);
+            glState().bindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+
+        commandBuffer.create(GL_DRAW_INDIRECT_BUFFER, nullptr);
+        labelObject(GL_BUFFER, commandBuffer.id(), "batch " + labelOf(model.directory) + " commands");
+        commandBuffer.storage(commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), 0);
+        glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        materialBuffer.create(GL_SHADER_STORAGE_BUFFER, nullptr);
+        labelObject(GL_BUFFER, materialBuffer.id(), "batch " + labelOf(model.directory) + " materials");
+        materialBuffer.storage(materials.size() * sizeof(Material), materials.data(), 0);
+        glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+};
+
+#endif
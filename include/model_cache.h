@@ -0,0 +1,538 @@
+#ifndef MODEL_CACHE_H
+#define MODEL_CACHE_H
+
+#include <mesh.h>
+#include <meshlet.h>
+#include <asset_archive.h>
+#include <signed_distance_field.h>
+
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+// A model as Assimp left it after import, cooked into one little-endian file next to the source (source path +
+// ".cooked") so later launches map it and build the meshes without parsing anything. The file is a 128-byte header,
+// a table of mesh records, a table of texture records, the node hierarchy, the texture records' type and path
+// strings in one blob, then the vertex and index arrays, the triangle BVH (nodes, then the triangle order, see
+// mesh_bvh.h) and the meshlets (records, vertices, triangles, see meshlet.h) of every mesh, each 64-byte aligned,
+// and last the model's signed distance field (a record and its samples, see mesh_sdf.h). Vertices are the CPU-side Vertex as is: Mesh keeps it
+// for LOD generation and packs it into the model's VertexLayout on upload, so one cache serves every layout.
+// The cache is only used while the source's mtime and size and the import flags match the ones it was cooked
+// with; bump MODEL_CACHE_VERSION whenever the format or Vertex changes. Models with bones or animations are not
+// cooked, there is no place for those here.
+static const char MODEL_CACHE_MAGIC[8] = {'N', 'M', 'O', 'D', 'E', 'L', 'C', 'K'};
+static const uint32_t MODEL_CACHE_VERSION = 7;     // 4: vertices without bones have id -1, weight 0; 5: optimized order; 6: meshlets; 7: SDF
+
+// identifies what a cache was cooked from
+struct ModelCacheKey
+{
+    int64_t sourceMtimeNs;
+    uint64_t sourceBytes;
+    uint32_t importFlags;
+};
+
+struct ModelCacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerBytes;
+    uint64_t fileBytes;
+    int64_t sourceMtimeNs;
+    uint64_t sourceBytes;
+    uint32_t importFlags;
+    uint32_t vertexStride;      // sizeof(Vertex) it was written with
+    uint32_t meshCount;
+    uint32_t textureCount;
+    uint64_t meshOffset;
+    uint64_t textureOffset;
+    uint64_t stringOffset;
+    uint64_t stringBytes;
+    uint32_t nodeCount;
+    uint32_t reserved0;
+    uint64_t nodeOffset;
+    uint64_t sdfOffset;         // 0 for a model without a field
+    unsigned char reserved[128 - 112];
+};
+
+// one mesh, in the order Model lists them. The bounds let tools size a model without touching its vertices, the
+// BVH's triangle order (indexCount / 3 entries) follows its nodes, the meshlets' vertex and triangle arrays follow
+// their records.
+struct CookedMeshRecord
+{
+    uint64_t vertexOffset;
+    uint64_t vertexCount;
+    uint64_t indexOffset;
+    uint64_t indexCount;
+    float boundsMin[3];
+    float boundsMax[3];
+    float boundingRadius;
+    uint32_t firstTexture;
+    uint32_t textureCount;
+    uint32_t bvhNodeCount;
+    uint64_t bvhOffset;
+    uint32_t meshletCount;
+    uint32_t meshletVertexCount;
+    uint32_t meshletTriangleCount;
+    uint32_t reserved;
+    uint64_t meshletOffset;
+};
+
+// a texture of a mesh, its sampler type ("texture_diffuse", ...) and its path relative to the model's directory
+struct CookedTextureRecord
+{
+    uint32_t typeOffset;
+    uint32_t typeBytes;
+    uint32_t pathOffset;
+    uint32_t pathBytes;
+};
+
+// a node of the scene, parents before children: its transform relative to the parent, column-major, and the run
+// of meshes it holds
+struct CookedNodeRecord
+{
+    int32_t parent;         // -1 for the root
+    uint32_t firstMesh;
+    uint32_t meshCount;
+    uint32_t reserved;
+    float transform[16];
+};
+
+// the model's signed distance field, resolution^3 floats follow it
+struct CookedSdfRecord
+{
+    float origin[3];
+    float cellSize;
+    uint32_t resolution;
+    uint32_t reserved[3];
+};
+
+static_assert(sizeof(ModelCacheHeader) == 128, "the model cache header is part of the file format");
+static_assert(sizeof(CookedMeshRecord) == 104 && sizeof(CookedTextureRecord) == 16 && sizeof(CookedNodeRecord) == 80
+              && sizeof(CookedSdfRecord) == 32, "model cache records are part of the file format");
+
+// a mesh as imported, before anything of it is on the GPU: what a cache holds, and what Model uploads
+struct ImportedMesh
+{
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<Texture> textures;                      // type and path, the GL names come with the upload
+    std::vector<std::vector<unsigned int>> lods;        // coarser levels if they were simplified ahead, not cooked
+    MeshBvh bvh;                                        // over the full level's triangles
+    MeshletSet meshlets;                                // of the full level
+};
+
+// a node of the imported scene, in depth-first order so parents come first. Its meshes are a contiguous run of
+// the imported meshes, a mesh the scene references twice is imported twice.
+struct ImportedNode
+{
+    int32_t parent;         // -1 for the root
+    uint32_t firstMesh;
+    uint32_t meshCount;
+    glm::mat4 transform;    // relative to the parent
+};
+
+inline std::string modelCachePath(const std::string& source)
+{
+    return source + ".cooked";
+}
+
+// false when the source cannot be stat'ed, there is nothing to cook or check against then
+inline bool modelCacheKey(const std::string& source, uint32_t importFlags, ModelCacheKey& key)
+{
+    int64_t mtimeNs = 0;
+    uint64_t bytes = 0;
+    if (!assetStamp(source, mtimeNs, bytes))
+        return false;
+    key.sourceMtimeNs = mtimeNs;
+    key.sourceBytes = bytes;
+    key.importFlags = importFlags;
+    return true;
+}
+
+inline bool modelCacheHostIsLittleEndian()
+{
+    const uint32_t probe = 1;
+    unsigned char first;
+    std::memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+// Cooks imported meshes. The file is written under a temporary name and renamed, so a reader never maps a
+// half-written cache.
+inline bool writeModelCache(const std::string& path, const ModelCacheKey& key, const std::vector<ImportedMesh>& meshes,
+                            const std::vector<ImportedNode>& nodes, const SignedDistanceField& sdf)
+{
+    if (!modelCacheHostIsLittleEndian())
+        return false;
+
+    std::vector<CookedMeshRecord> records(meshes.size());
+    std::vector<CookedTextureRecord> textures;
+    std::string strings;
+    for (size_t m = 0; m < meshes.size(); m++)
+    {
+        std::memset(&records[m], 0, sizeof(CookedMeshRecord));
+        records[m].firstTexture = static_cast<uint32_t>(textures.size());
+        records[m].textureCount = static_cast<uint32_t>(meshes[m].textures.size());
+        for (const Texture& texture : meshes[m].textures)
+        {
+            CookedTextureRecord record;
+            record.typeOffset = static_cast<uint32_t>(strings.size());
+            record.typeBytes = static_cast<uint32_t>(texture.type.size());
+            strings += texture.type;
+            record.pathOffset = static_cast<uint32_t>(strings.size());
+            record.pathBytes = static_cast<uint32_t>(texture.path.size());
+            strings += texture.path;
+            textures.push_back(record);
+        }
+    }
+
+    std::vector<CookedNodeRecord> nodeRecords(nodes.size());
+    for (size_t n = 0; n < nodes.size(); n++)
+    {
+        std::memset(&nodeRecords[n], 0, sizeof(CookedNodeRecord));
+        nodeRecords[n].parent = nodes[n].parent;
+        nodeRecords[n].firstMesh = nodes[n].firstMesh;
+        nodeRecords[n].meshCount = nodes[n].meshCount;
+        std::memcpy(nodeRecords[n].transform, &nodes[n].transform, sizeof(nodeRecords[n].transform));
+    }
+
+    ModelCacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MODEL_CACHE_MAGIC, sizeof(header.magic));
+    header.version = MODEL_CACHE_VERSION;
+    header.headerBytes = sizeof(ModelCacheHeader);
+    header.sourceMtimeNs = key.sourceMtimeNs;
+    header.sourceBytes = key.sourceBytes;
+    header.importFlags = key.importFlags;
+    header.vertexStride = sizeof(Vertex);
+    header.meshCount = static_cast<uint32_t>(meshes.size());
+    header.textureCount = static_cast<uint32_t>(textures.size());
+    header.meshOffset = sizeof(ModelCacheHeader);
+    header.textureOffset = header.meshOffset + records.size() * sizeof(CookedMeshRecord);
+    header.nodeCount = static_cast<uint32_t>(nodeRecords.size());
+    header.nodeOffset = header.textureOffset + textures.size() * sizeof(CookedTextureRecord);
+    header.stringOffset = header.nodeOffset + nodeRecords.size() * sizeof(CookedNodeRecord);
+    header.stringBytes = strings.size();
+    uint64_t offset = (header.stringOffset + header.stringBytes + 63) & ~uint64_t(63);
+    for (size_t m = 0; m < meshes.size(); m++)
+    {
+        const ImportedMesh& mesh = meshes[m];
+        CookedMeshRecord& record = records[m];
+        record.vertexCount = mesh.vertices.size();
+        record.indexCount = mesh.indices.size();
+        record.vertexOffset = offset;
+        offset = (offset + record.vertexCount * sizeof(Vertex) + 63) & ~uint64_t(63);
+        record.indexOffset = offset;
+        offset = (offset + record.indexCount * sizeof(unsigned int) + 63) & ~uint64_t(63);
+        record.bvhNodeCount = static_cast<uint32_t>(mesh.bvh.nodeCount());
+        record.bvhOffset = offset;
+        offset = (offset + record.bvhNodeCount * sizeof(BvhNode) + mesh.bvh.triangleCount() * sizeof(uint32_t) + 63) & ~uint64_t(63);
+        record.meshletCount = static_cast<uint32_t>(mesh.meshlets.meshlets.size());
+        record.meshletVertexCount = static_cast<uint32_t>(mesh.meshlets.vertices.size());
+        record.meshletTriangleCount = static_cast<uint32_t>(mesh.meshlets.triangles.size());
+        record.meshletOffset = offset;
+        offset = (offset + mesh.meshlets.bytes() + 63) & ~uint64_t(63);
+        glm::vec3 boundsMin(0.0f), boundsMax(0.0f);
+        vertexBounds(mesh.vertices, boundsMin, boundsMax, record.boundingRadius);
+        std::memcpy(record.boundsMin, &boundsMin, sizeof(record.boundsMin));
+        std::memcpy(record.boundsMax, &boundsMax, sizeof(record.boundsMax));
+    }
+    if (!sdf.empty())
+    {
+        header.sdfOffset = offset;
+        offset = (offset + sizeof(CookedSdfRecord) + sdf.values.size() * sizeof(float) + 63) & ~uint64_t(63);
+    }
+    header.fileBytes = offset;
+
+    std::vector<unsigned char> image(offset, 0);
+    std::memcpy(image.data(), &header, sizeof(header));
+    if (!records.empty())
+        std::memcpy(&image[header.meshOffset], records.data(), records.size() * sizeof(CookedMeshRecord));
+    if (!textures.empty())
+        std::memcpy(&image[header.textureOffset], textures.data(), textures.size() * sizeof(CookedTextureRecord));
+    if (!nodeRecords.empty())
+        std::memcpy(&image[header.nodeOffset], nodeRecords.data(), nodeRecords.size() * sizeof(CookedNodeRecord));
+    if (!strings.empty())
+        std::memcpy(&image[header.stringOffset], strings.data(), strings.size());
+    for (size_t m = 0; m < meshes.size(); m++)
+    {
+        if (records[m].vertexCount != 0)
+            std::memcpy(&image[records[m].vertexOffset], meshes[m].vertices.data(), records[m].vertexCount * sizeof(Vertex));
+        if (records[m].indexCount != 0)
+            std::memcpy(&image[records[m].indexOffset], meshes[m].indices.data(), records[m].indexCount * sizeof(unsigned int));
+        if (records[m].bvhNodeCount != 0)
+        {
+            const MeshBvh& bvh = meshes[m].bvh;
+            std::memcpy(&image[records[m].bvhOffset], bvh.nodeArray().data(), bvh.nodeCount() * sizeof(BvhNode));
+            std::memcpy(&image[records[m].bvhOffset + bvh.nodeCount() * sizeof(BvhNode)], bvh.triangleOrder().data(),
+                        bvh.triangleCount() * sizeof(uint32_t));
+        }
+        if (records[m].meshletCount != 0)
+        {
+            const MeshletSet& set = meshes[m].meshlets;
+            unsigned char* out = &image[records[m].meshletOffset];
+            std::memcpy(out, set.meshlets.data(), set.meshlets.size() * sizeof(Meshlet));
+            out += set.meshlets.size() * sizeof(Meshlet);
+            std::memcpy(out, set.vertices.data(), set.vertices.size() * sizeof(uint32_t));
+            out += set.vertices.size() * sizeof(uint32_t);
+            std::memcpy(out, set.triangles.data(), set.triangles.size() * sizeof(uint32_t));
+        }
+    }
+    if (header.sdfOffset != 0)
+    {
+        CookedSdfRecord record;
+        std::memset(&record, 0, sizeof(record));
+        std::memcpy(record.origin, &sdf.origin, sizeof(record.origin));
+        record.cellSize = sdf.cellSize;
+        record.resolution = sdf.resolution;
+        std::memcpy(&image[header.sdfOffset], &record, sizeof(record));
+        std::memcpy(&image[header.sdfOffset + sizeof(record)], sdf.values.data(), sdf.values.size() * sizeof(float));
+    }
+
+    const std::string partial = path + ".partial";
+    FILE* f = std::fopen(partial.c_str(), "wb");
+    if (!f)
+        return false;
+    bool ok = std::fwrite(image.data(), 1, image.size(), f) == image.size();
+    ok = std::fclose(f) == 0 && ok;
+    ok = ok && std::rename(partial.c_str(), path.c_str()) == 0;
+    if (!ok)
+        std::remove(partial.c_str());
+    return ok;
+}
+
+// A cooked model mapped read-only. open() checks the header against the key and every table and array against
+// the file size; after that the vertex and index arrays are read in place.
+class MappedModelCache
+{
+public:
+    bool open(const char* path, const ModelCacheKey& key)
+    {
+        close();
+        // everything is copied out into the meshes, so it is mapped populated
+        if (!modelCacheHostIsLittleEndian() || !file.open(path, true))
+            return false;
+        if (file.size() < sizeof(ModelCacheHeader) || !validate(key))
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+        file.close();
+    }
+
+    bool isOpen() const { return file.isOpen(); }
+    const ModelCacheHeader& header() const { return *reinterpret_cast<const ModelCacheHeader*>(file.data()); }
+    uint32_t meshCount() const { return header().meshCount; }
+    uint32_t nodeCount() const { return header().nodeCount; }
+
+    const CookedMeshRecord& mesh(uint32_t m) const
+    {
+        return reinterpret_cast<const CookedMeshRecord*>(file.data() + header().meshOffset)[m];
+    }
+    const Vertex* vertices(uint32_t m) const { return reinterpret_cast<const Vertex*>(file.data() + mesh(m).vertexOffset); }
+    const unsigned int* indices(uint32_t m) const { return reinterpret_cast<const unsigned int*>(file.data() + mesh(m).indexOffset); }
+    const BvhNode* bvhNodes(uint32_t m) const { return reinterpret_cast<const BvhNode*>(file.data() + mesh(m).bvhOffset); }
+    const uint32_t* bvhOrder(uint32_t m) const { return reinterpret_cast<const uint32_t*>(bvhNodes(m) + mesh(m).bvhNodeCount); }
+    const Meshlet* meshlets(uint32_t m) const { return reinterpret_cast<const Meshlet*>(file.data() + mesh(m).meshletOffset); }
+    const uint32_t* meshletVertices(uint32_t m) const { return reinterpret_cast<const uint32_t*>(meshlets(m) + mesh(m).meshletCount); }
+    const uint32_t* meshletTriangles(uint32_t m) const { return meshletVertices(m) + mesh(m).meshletVertexCount; }
+
+    bool hasSdf() const { return header().sdfOffset != 0; }
+    const CookedSdfRecord& sdf() const { return *reinterpret_cast<const CookedSdfRecord*>(file.data() + header().sdfOffset); }
+    const float* sdfValues() const { return reinterpret_cast<const float*>(&sdf() + 1); }
+
+    const CookedTextureRecord& texture(uint32_t t) const
+    {
+        return reinterpret_cast<const CookedTextureRecord*>(file.data() + header().textureOffset)[t];
+    }
+    const CookedNodeRecord& node(uint32_t n) const
+    {
+        return reinterpret_cast<const CookedNodeRecord*>(file.data() + header().nodeOffset)[n];
+    }
+    std::string textureType(uint32_t t) const { return string(texture(t).typeOffset, texture(t).typeBytes); }
+    std::string texturePath(uint32_t t) const { return string(texture(t).pathOffset, texture(t).pathBytes); }
+
+private:
+    AssetFile file;
+
+    std::string string(uint32_t offset, uint32_t bytes) const
+    {
+        return std::string(reinterpret_cast<const char*>(file.data() + header().stringOffset + offset), bytes);
+    }
+
+    bool validate(const ModelCacheKey& key) const
+    {
+        const ModelCacheHeader& h = header();
+        const uint64_t size = file.size();
+        if (std::memcmp(h.magic, MODEL_CACHE_MAGIC, sizeof(h.magic)) != 0 || h.version != MODEL_CACHE_VERSION
+            || h.headerBytes != sizeof(ModelCacheHeader) || h.fileBytes != size || h.vertexStride != sizeof(Vertex))
+            return false;
+        if (h.sourceMtimeNs != key.sourceMtimeNs || h.sourceBytes != key.sourceBytes || h.importFlags != key.importFlags)
+            return false;
+        if (h.meshOffset > size || h.meshCount > (size - h.meshOffset) / sizeof(CookedMeshRecord)
+            || h.textureOffset > size || h.textureCount > (size - h.textureOffset) / sizeof(CookedTextureRecord)
+            || h.nodeOffset > size || h.nodeCount > (size - h.nodeOffset) / sizeof(CookedNodeRecord)
+            || h.stringOffset > size || h.stringBytes > size - h.stringOffset)
+            return false;
+        if (h.sdfOffset != 0)
+        {
+            if (h.sdfOffset % alignof(CookedSdfRecord) != 0 || h.sdfOffset > size || sizeof(CookedSdfRecord) > size - h.sdfOffset)
+                return false;
+            const CookedSdfRecord& r = sdf();
+            if (r.resolution < 2 || r.resolution > 512 || !(r.cellSize > 0.0f)
+                || uint64_t(r.resolution) * r.resolution * r.resolution * sizeof(float) > size - h.sdfOffset - sizeof(CookedSdfRecord))
+                return false;
+        }
+        for (uint32_t n = 0; n < h.nodeCount; n++)
+        {
+            const CookedNodeRecord& r = node(n);
+            if ((r.parent >= 0 && static_cast<uint32_t>(r.parent) >= n) || (n > 0 && r.parent < 0)
+                || uint64_t(r.firstMesh) + r.meshCount > h.meshCount)
+                return false;
+        }
+        for (uint32_t t = 0; t < h.textureCount; t++)
+        {
+            const CookedTextureRecord& r = texture(t);
+            if (uint64_t(r.typeOffset) + r.typeBytes > h.stringBytes || uint64_t(r.pathOffset) + r.pathBytes > h.stringBytes)
+                return false;
+        }
+        for (uint32_t m = 0; m < h.meshCount; m++)
+        {
+            const CookedMeshRecord& r = mesh(m);
+            if (r.vertexOffset > size || r.vertexCount > (size - r.vertexOffset) / sizeof(Vertex)
+                || r.indexOffset > size || r.indexCount > (size - r.indexOffset) / sizeof(unsigned int)
+                || uint64_t(r.firstTexture) + r.textureCount > h.textureCount)
+                return false;
+            // an index past the mesh's vertices would read outside its range on the GPU
+            const unsigned int* index = indices(m);
+            for (uint64_t i = 0; i < r.indexCount; i++)
+                if (index[i] >= r.vertexCount)
+                    return false;
+            if (r.bvhNodeCount != 0 && !validateBvh(r, size))
+                return false;
+            if (r.meshletCount != 0 && !validateMeshlets(m, size))
+                return false;
+        }
+        return true;
+    }
+
+    // every meshlet inside the arrays and the mesh, within the limits the mesh shader's outputs are sized for
+    bool validateMeshlets(uint32_t m, uint64_t size) const
+    {
+        const CookedMeshRecord& r = mesh(m);
+        if (r.meshletOffset > size || r.meshletOffset % alignof(Meshlet) != 0
+            || uint64_t(r.meshletCount) * sizeof(Meshlet) + (uint64_t(r.meshletVertexCount) + r.meshletTriangleCount) * sizeof(uint32_t)
+                   > size - r.meshletOffset)
+            return false;
+        const Meshlet* meshlet = meshlets(m);
+        const uint32_t* vertices = meshletVertices(m);
+        const uint32_t* triangles = meshletTriangles(m);
+        for (uint32_t v = 0; v < r.meshletVertexCount; v++)
+            if (vertices[v] >= r.vertexCount)
+                return false;
+        for (uint32_t k = 0; k < r.meshletCount; k++)
+        {
+            const Meshlet& l = meshlet[k];
+            if (l.vertexCount > MESHLET_MAX_VERTICES || l.triangleCount > MESHLET_MAX_TRIANGLES
+                || uint64_t(l.vertexOffset) + l.vertexCount > r.meshletVertexCount
+                || uint64_t(l.triangleOffset) + l.triangleCount > r.meshletTriangleCount)
+                return false;
+            for (uint32_t t = l.triangleOffset; t < l.triangleOffset + l.triangleCount; t++)
+                if ((triangles[t] & 0xFF) >= l.vertexCount || ((triangles[t] >> 8) & 0xFF) >= l.vertexCount
+                    || ((triangles[t] >> 16) & 0xFF) >= l.vertexCount)
+                    return false;
+        }
+        return true;
+    }
+
+    // every node inside the tables and every triangle inside the mesh; children come after their parent and no
+    // deeper than MeshBvh::MAX_DEPTH, which the traversal stacks are sized for
+    bool validateBvh(const CookedMeshRecord& r, uint64_t size) const
+    {
+        const uint64_t triangles = r.indexCount / 3;
+        if (r.bvhOffset > size || r.bvhOffset % alignof(BvhNode) != 0
+            || uint64_t(r.bvhNodeCount) * sizeof(BvhNode) + triangles * sizeof(uint32_t) > size - r.bvhOffset)
+            return false;
+        const BvhNode* node = reinterpret_cast<const BvhNode*>(file.data() + r.bvhOffset);
+        const uint32_t* order = reinterpret_cast<const uint32_t*>(node + r.bvhNodeCount);
+        std::vector<uint32_t> depth(r.bvhNodeCount, 0);
+        for (uint32_t n = 0; n < r.bvhNodeCount; n++)
+        {
+            if (node[n].count == 0)
+            {
+                if (node[n].first <= n || uint64_t(node[n].first) + 1 >= r.bvhNodeCount || depth[n] >= MeshBvh::MAX_DEPTH)
+                    return false;
+                depth[node[n].first] = std::max(depth[node[n].first], depth[n] + 1);
+                depth[node[n].first + 1] = std::max(depth[node[n].first + 1], depth[n] + 1);
+            }
+            else if (uint64_t(node[n].first) + node[n].count > triangles)
+                return false;
+        }
+        for (uint64_t t = 0; t < triangles; t++)
+            if (order[t] >= triangles)
+                return false;
+        return true;
+    }
+};
+
+// the meshes, nodes and distance field of a cooked cache copied out, false (and nothing added) if there is none for
+// this key or it does not validate
+inline bool readModelCache(const std::string& path, const ModelCacheKey& key, std::vector<ImportedMesh>& meshes,
+                           std::vector<ImportedNode>& nodes, SignedDistanceField& sdf)
+{
+    MappedModelCache cache;
+    if (!cache.open(path.c_str(), key))
+        return false;
+    meshes.reserve(meshes.size() + cache.meshCount());
+    for (uint32_t m = 0; m < cache.meshCount(); m++)
+    {
+        const CookedMeshRecord& record = cache.mesh(m);
+        ImportedMesh mesh;
+        mesh.vertices.assign(cache.vertices(m), cache.vertices(m) + record.vertexCount);
+        mesh.indices.assign(cache.indices(m), cache.indices(m) + record.indexCount);
+        if (record.bvhNodeCount != 0)
+            mesh.bvh.adopt(mesh.vertices, mesh.indices, cache.bvhNodes(m), record.bvhNodeCount, cache.bvhOrder(m));
+        else
+            mesh.bvh.build(mesh.vertices, mesh.indices);
+        if (record.meshletCount != 0)
+        {
+            mesh.meshlets.meshlets.assign(cache.meshlets(m), cache.meshlets(m) + record.meshletCount);
+            mesh.meshlets.vertices.assign(cache.meshletVertices(m), cache.meshletVertices(m) + record.meshletVertexCount);
+            mesh.meshlets.triangles.assign(cache.meshletTriangles(m), cache.meshletTriangles(m) + record.meshletTriangleCount);
+        }
+        else
+            mesh.meshlets = buildMeshlets(mesh.vertices, mesh.indices);
+        mesh.textures.reserve(record.textureCount);
+        for (uint32_t t = record.firstTexture; t < record.firstTexture + record.textureCount; t++)
+            mesh.textures.push_back(Texture{0, cache.textureType(t), cache.texturePath(t)});
+        meshes.push_back(std::move(mesh));
+    }
+    nodes.reserve(nodes.size() + cache.nodeCount());
+    for (uint32_t n = 0; n < cache.nodeCount(); n++)
+    {
+        const CookedNodeRecord& record = cache.node(n);
+        ImportedNode node{record.parent, record.firstMesh, record.meshCount, glm::mat4(1.0f)};
+        std::memcpy(&node.transform, record.transform, sizeof(record.transform));
+        nodes.push_back(node);
+    }
+    if (cache.hasSdf())
+    {
+        const CookedSdfRecord& record = cache.sdf();
+        std::memcpy(&sdf.origin, record.origin, sizeof(record.origin));
+        sdf.cellSize = record.cellSize;
+        sdf.resolution = record.resolution;
+        sdf.values.assign(cache.sdfValues(), cache.sdfValues() + size_t(record.resolution) * record.resolution * record.resolution);
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,249 @@
+#ifndef MODEL_LOADER_H
+#define MODEL_LOADER_H
+
+#include <model.h>
+#include <profiler.h>
+#include <alloc_tracker.h>
+#include <startup_trace.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cfloat>
+
+// A model on its way in. ready() once ModelLoader has uploaded it, take() then hands it over, the caller deletes it
+// as it would a Model it made itself. One that is never taken is deleted with the handle, on the GL thread.
+class ModelLoad
+{
+public:
+    ~ModelLoad()
+    {
+        delete model;
+    }
+
+    const std::string& path() const { return request.path; }
+    bool imported() const { return done.load(std::memory_order_acquire); }
+    bool ready() const { return model != nullptr || taken; }
+
+    Model* take()
+    {
+        taken = taken || model != nullptr;
+        Model* m = model;
+        model = nullptr;
+        return m;
+    }
+
+private:
+    friend class ModelLoader;
+
+    struct Request
+    {
+        std::string path;
+        bool gamma;
+        VertexLayout layout;
+        bool pooled;
+        unsigned int lodLevels;
+        float lodRatio;
+    };
+
+    Request request;
+    float priority = FLT_MAX;       // under the loader's mutex; unranked loads go first, in order, 0 holds it back
+    ModelData data;                 // the loader's until done
+    std::atomic<bool> done{false};
+    Model* model = nullptr;
+    bool taken = false;
+};
+
+typedef std::shared_ptr<ModelLoad> ModelHandle;
+
+// Loads models in the background: load() returns a handle at once, loader threads import the file (cooked cache
+// or Assimp, then the LOD simplification, see importModel) and poll() or wait() on the GL thread uploads what they
+// finished into a Model. Several models import side by side instead of one after the other, the most important
+// queued one first (prioritize(), see asset_priorities.h). The meshes are made on
+// the GL thread rather than on a loader with a shared context: VAOs are not shared between contexts and
+// geometryPool() belongs to the main one, and the upload is a few buffer copies next to the import. Textures
+// stream in through textureCache() as usual.
+class ModelLoader
+{
+public:
+    ModelLoader() = default;
+    ModelLoader(const ModelLoader&) = delete;
+    ModelLoader& operator=(const ModelLoader&) = delete;
+
+    ~ModelLoader()
+    {
+        stop();
+    }
+
+    void start(unsigned int threads)
+    {
+        stop();
+        stopping = false;
+        for (unsigned int t = 0; t < std::max(threads, 1u); t++)
+            loaders.emplace_back([this]() { loaderLoop(); });
+    }
+
+    // joins the loaders, what they have not started stays unloaded (its handle never gets ready)
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            queue.clear();
+        }
+        wake.notify_all();
+        finished.notify_all();
+        for (std::thread& t : loaders)
+            t.join();
+        loaders.clear();
+        loads.clear();
+    }
+
+    bool running() const { return !loaders.empty(); }
+
+    // queues a model, with the arguments of the Model constructor and the levels of detail to simplify (1 for
+    // none). Without loader threads it is imported here and uploaded by the next poll().
+    ModelHandle load(const std::string& path, bool gamma = false, VertexLayout layout = VERTEX_LAYOUT_FULL, bool pooled = false,
+                     unsigned int lodLevels = 1, float lodRatio = 0.35f)
+    {
+        ModelHandle handle = std::make_shared<ModelLoad>();
+        handle->request = ModelLoad::Request{path, gamma, layout, pooled, lodLevels, lodRatio};
+        loads.push_back(handle);
+        if (!running())
+        {
+            handle->data = importModel(path, lodLevels, lodRatio);
+            handle->done.store(true, std::memory_order_release);
+            return handle;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(handle);
+        }
+        wake.notify_one();
+        return handle;
+    }
+
+    // Ranks a queued load, the loaders take the highest first; 0 or less cancels it until it is ranked above 0 again
+    // (or waited for). A load already importing finishes either way.
+    void prioritize(const ModelHandle& handle, float importance)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            handle->priority = std::max(importance, 0.0f);
+        }
+        if (importance > 0.0f)
+            wake.notify_one();
+    }
+
+    // GL thread, once per frame: uploads every model whose import finished
+    void poll()
+    {
+        for (size_t i = 0; i < loads.size();)
+        {
+            if (loads[i]->imported())
+            {
+                upload(*loads[i]);
+                loads.erase(loads.begin() + i);
+            }
+            else
+            {
+                i++;
+            }
+        }
+    }
+
+    // GL thread, blocks until the model is imported and uploads it. Returns at once if the loaders were stopped
+    // before they got to it.
+    void wait(const ModelHandle& handle)
+    {
+        if (handle->ready())
+            return;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            // a cancelled load is needed after all
+            handle->priority = FLT_MAX;
+            wake.notify_one();
+            finished.wait(lock, [this, &handle]() { return handle->imported() || stopping; });
+        }
+        if (!handle->imported())
+            return;
+        upload(*handle);
+        loads.erase(std::remove(loads.begin(), loads.end(), handle), loads.end());
+    }
+
+    // loads not uploaded yet
+    size_t pending() const { return loads.size(); }
+
+private:
+    std::vector<std::thread> loaders;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    std::deque<ModelHandle> queue;
+    bool stopping = false;
+    std::vector<ModelHandle> loads;     // GL thread only
+
+    // the queued load to import next, queue.end() while none is ranked above 0; under the mutex
+    std::deque<ModelHandle>::iterator next()
+    {
+        std::deque<ModelHandle>::iterator best = queue.end();
+        for (auto it = queue.begin(); it != queue.end(); ++it)
+            if ((*it)->priority > 0.0f && (best == queue.end() || (*it)->priority > (*best)->priority))
+                best = it;
+        return best;
+    }
+
+    static void upload(ModelLoad& load)
+    {
+        const ModelLoad::Request& r = load.request;
+        load.model = new Model(std::move(load.data), r.gamma, r.layout, r.pooled);
+        load.data = ModelData();
+    }
+
+    void loaderLoop()
+    {
+        profiler().nameThread("model loader");
+        ALLOC_SCOPE(ALLOC_STREAMING);
+        startupTrace().nameThread("model loader");
+        for (;;)
+        {
+            ModelHandle load;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this]() { return stopping || next() != queue.end(); });
+                if (stopping)
+                    return;
+                auto it = next();
+                load = std::move(*it);
+                queue.erase(it);
+            }
+            ModelData data;
+            {
+                StartupScope phase("model import", load->request.path);
+                data = importModel(load->request.path, load->request.lodLevels, load->request.lodRatio);
+            }
+            {
+                // under the lock, so wait() cannot miss the notification between its check and its sleep
+                std::lock_guard<std::mutex> lock(mutex);
+                load->data = std::move(data);
+                load->done.store(true, std::memory_order_release);
+            }
+            finished.notify_all();
+        }
+    }
+};
+
+// the loader the viewer loads its models through
+inline ModelLoader& modelLoader()
+{
+    static ModelLoader loader;
+    return loader;
+}
+
+#endif
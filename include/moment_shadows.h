@@ -0,0 +1,96 @@
+#ifndef MOMENT_SHADOWS_H
+#define MOMENT_SHADOWS_H
+
+#include <glad/glad.h>
+
+#include <shader.h>
+#include <gpu_memory.h>
+#include <gl_debug.h>
+#include <gl_state_cache.h>
+
+#include <algorithm>
+
+// The filtered half of the variance shadow maps (Donnelly and Lauritzen): a caster pass that writes each texel's
+// depth and depth squared into an RG32F target, blurred here with a separable Gaussian in compute
+// (shaders.2/shadow.blur.cs), so the receivers take one bilinear sample of the two moments and bound the lit part
+// with Chebyshev's inequality (shaders.2/moment_shadows.glsl) where percentage-closer filtering would compare a
+// 3x3 or wider block of depths. One MomentBlur serves a cube map (cube is true, the faces blurred each on its own
+// and clamped at their edges) or a 2D array, with a scratch texture of the same shape for the pass between the two
+// directions.
+class MomentBlur
+{
+public:
+    static const GLenum FORMAT = GL_RG32F;
+    static const unsigned int MAX_RADIUS = 8;       // taps either side, MAX_RADIUS of shadow.blur.cs
+
+    MomentBlur(const char* blurPath, bool cube)
+        : shader(blurPath, cube ? ShaderDefines{{"CUBE_MAP", ""}} : ShaderDefines()), cubeMap(cube) {}
+    MomentBlur(const MomentBlur&) = delete;
+    MomentBlur& operator=(const MomentBlur&) = delete;
+
+    // a moments texture of size x size and layers (6 for a cube), filtered bilinearly and clamped at its edges;
+    // outside a 2D array's layers it reads as far away, lit
+    static void createTarget(GlTexture& texture, bool cube, unsigned int size, unsigned int layers, const char* label)
+    {
+        const GLenum target = cube ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D_ARRAY;
+        texture.create(target, label);
+        if (cube)
+            texture.storage2D(1, FORMAT, size, size);
+        else
+            texture.storage3D(1, FORMAT, size, size, layers);
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        const GLint wrap = cube ? GL_CLAMP_TO_EDGE : GL_CLAMP_TO_BORDER;
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, wrap);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, wrap);
+        glTexParameteri(target, GL_TEXTURE_WRAP_R, wrap);
+        const float border[4] = {1.0f, 1.0f, 0.0f, 0.0f};
+        glTexParameterfv(target, GL_TEXTURE_BORDER_COLOR, border);
+        glState().bindTexture(target, 0);
+    }
+
+    // blurs layers [firstLayer, firstLayer + layers) of moments, size on a side, radius texels either side; the
+    // receivers may sample it once this returns
+    void blur(const GlTexture& moments, unsigned int size, unsigned int firstLayer, unsigned int layers, unsigned int radius)
+    {
+        radius = std::min(radius, MAX_RADIUS);
+        if (radius == 0 || layers == 0)
+            return;
+        GL_DEBUG_GROUP("moment blur");
+        const unsigned int scratchLayers = cubeMap ? 6u : firstLayer + layers;
+        if (!scratch.valid() || scratchSize != size || scratchCapacity < scratchLayers)
+        {
+            createTarget(scratch, cubeMap, size, scratchLayers, "moment blur scratch");
+            scratchSize = size;
+            scratchCapacity = scratchLayers;
+        }
+        shader.use();
+        shader.setInt("radius", static_cast<int>(radius));
+        shader.setFloat("sigma", 0.5f * static_cast<float>(radius) + 0.5f);
+        shader.setInt("firstLayer", static_cast<int>(firstLayer));
+        // across from the moments into the scratch, then down from it back
+        for (int vertical = 0; vertical < 2; vertical++)
+        {
+            shader.setInt("vertical", vertical);
+            glBindImageTexture(0, vertical ? scratch.id() : moments.id(), 0, GL_TRUE, 0, GL_READ_ONLY, FORMAT);
+            glBindImageTexture(1, vertical ? moments.id() : scratch.id(), 0, GL_TRUE, 0, GL_WRITE_ONLY, FORMAT);
+            glDispatchCompute((size + 7) / 8, (size + 7) / 8, layers);
+            glMemoryBarrier(vertical ? GL_TEXTURE_FETCH_BARRIER_BIT : GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        }
+    }
+
+    void release()
+    {
+        scratch.release();
+        scratchSize = scratchCapacity = 0;
+    }
+
+private:
+    Shader shader;
+    bool cubeMap;
+    GlTexture scratch{GPU_MEMORY_RENDER_TARGETS};
+    unsigned int scratchSize = 0;
+    unsigned int scratchCapacity = 0;
+};
+
+#endif
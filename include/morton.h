@@ -0,0 +1,133 @@
+#ifndef MORTON_H
+#define MORTON_H
+
+#include <glm.hpp>
+
+#include <thread_pool.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+// spreads the low 10 bits of v so there are two zero bits between each
+inline uint32_t mortonExpandBits(uint32_t v)
+{
+    v &= 0x3ffu;
+    v = (v | (v << 16)) & 0x030000ffu;
+    v = (v | (v << 8)) & 0x0300f00fu;
+    v = (v | (v << 4)) & 0x030c30c3u;
+    v = (v | (v << 2)) & 0x09249249u;
+    return v;
+}
+
+// 30-bit Z-order key of a point quantized to a 1024^3 grid
+inline uint32_t mortonKey(uint32_t x, uint32_t y, uint32_t z)
+{
+    return (mortonExpandBits(x) << 2) | (mortonExpandBits(y) << 1) | mortonExpandBits(z);
+}
+
+// Computes Z-order keys for a set of points and a stable LSD radix sort over them, three 10-bit passes. Each pass
+// counts digits per slice, prefix-sums the slice histograms and scatters every slice in parallel, which keeps
+// the result identical for any thread count.
+class MortonSorter
+{
+public:
+    // keys of positions[0, n) on a grid spanning their bounding box
+    void computeKeys(const glm::dvec3* positions, size_t n)
+    {
+        keys.resize(n);
+        if (n == 0)
+            return;
+        glm::dvec3 lo = positions[0], hi = positions[0];
+        for (size_t i = 1; i < n; i++)
+        {
+            lo = glm::min(lo, positions[i]);
+            hi = glm::max(hi, positions[i]);
+        }
+        glm::dvec3 extent = hi - lo;
+        double size = std::max(extent.x, std::max(extent.y, extent.z));
+        double scale = size > 0.0 ? 1023.0 / size : 0.0;
+        for (size_t i = 0; i < n; i++)
+        {
+            glm::dvec3 q = (positions[i] - lo) * scale;
+            keys[i] = mortonKey(static_cast<uint32_t>(q.x), static_cast<uint32_t>(q.y), static_cast<uint32_t>(q.z));
+        }
+    }
+
+    // fraction of neighbouring pairs out of key order, 0 right after a sort
+    float disorder() const
+    {
+        if (keys.size() < 2)
+            return 0.0f;
+        size_t descents = 0;
+        for (size_t i = 1; i < keys.size(); i++)
+            if (keys[i] < keys[i - 1]) descents++;
+        return static_cast<float>(descents) / static_cast<float>(keys.size() - 1);
+    }
+
+    // sorts the computed keys, sortedOrder()[k] is then the index of the point that belongs in slot k
+    void sort(unsigned int maxThreads)
+    {
+        const size_t n = keys.size();
+        order.resize(n);
+        for (size_t i = 0; i < n; i++)
+            order[i] = static_cast<uint32_t>(i);
+        keysAlt.resize(n);
+        orderAlt.resize(n);
+        unsigned int slices = std::max(1u, std::min(maxThreads == 0 ? workerPool().size() : maxThreads, workerPool().size()));
+        slices = static_cast<unsigned int>(std::max<size_t>(1, std::min<size_t>(slices, n / 4096 + 1)));
+        const size_t chunk = (n + slices - 1) / slices;
+        histograms.assign(static_cast<size_t>(slices) * RADIX, 0);
+
+        for (unsigned int pass = 0; pass < 3; pass++)
+        {
+            const unsigned int shift = pass * BITS;
+            std::fill(histograms.begin(), histograms.end(), 0u);
+            workerPool().parallelFor(0, slices, [&](size_t sBegin, size_t sEnd, unsigned int) {
+                for (size_t s = sBegin; s < sEnd; s++)
+                {
+                    uint32_t* h = &histograms[s * RADIX];
+                    for (size_t i = s * chunk; i < std::min(n, (s + 1) * chunk); i++)
+                        h[(keys[i] >> shift) & (RADIX - 1)]++;
+                }
+            }, slices);
+
+            // exclusive offsets, digit-major then slice, so equal digits keep their slice order
+            uint32_t running = 0;
+            for (unsigned int d = 0; d < RADIX; d++)
+                for (unsigned int s = 0; s < slices; s++)
+                {
+                    uint32_t count = histograms[s * RADIX + d];
+                    histograms[s * RADIX + d] = running;
+                    running += count;
+                }
+
+            workerPool().parallelFor(0, slices, [&](size_t sBegin, size_t sEnd, unsigned int) {
+                for (size_t s = sBegin; s < sEnd; s++)
+                {
+                    uint32_t* offset = &histograms[s * RADIX];
+                    for (size_t i = s * chunk; i < std::min(n, (s + 1) * chunk); i++)
+                    {
+                        uint32_t slot = offset[(keys[i] >> shift) & (RADIX - 1)]++;
+                        keysAlt[slot] = keys[i];
+                        orderAlt[slot] = order[i];
+                    }
+                }
+            }, slices);
+            keys.swap(keysAlt);
+            order.swap(orderAlt);
+        }
+    }
+
+    const std::vector<uint32_t>& sortedOrder() const { return order; }
+
+private:
+    static const unsigned int BITS = 10;
+    static const unsigned int RADIX = 1u << BITS;
+    std::vector<uint32_t> keys, keysAlt;
+    std::vector<uint32_t> order, orderAlt;
+    std::vector<uint32_t> histograms;
+};
+
+#endif
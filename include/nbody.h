@@ -0,0 +1,185 @@
+#ifndef NBODY_H
+#define NBODY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* C interface to the physics library (PhysicsWorld), for driving the simulation from other languages and tools
+   without touching the viewer. Every call works on whole arrays: bodies are added, read and written in batches from
+   caller-owned structure-of-arrays buffers, positions and velocities as x y z doubles per body, so a step of a
+   million bodies costs one call and not a million. Functions returning int return NBODY_OK or a negative
+   nbody_status; nbody_error() then says why. A world is not thread-safe, but separate worlds are independent (they
+   share the process's worker threads). Bodies are kept with each type in one contiguous range, sun, planets, then
+   asteroids, and steps may reorder the asteroids for locality: the id of a body is what stays, its index is only
+   valid until the next step or change. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32) && defined(NBODY_BUILD)
+#define NBODY_API __declspec(dllexport)
+#elif defined(_WIN32)
+#define NBODY_API __declspec(dllimport)
+#else
+#define NBODY_API __attribute__((visibility("default")))
+#endif
+
+#define NBODY_API_VERSION 1
+
+typedef struct nbody_world nbody_world;
+
+typedef enum nbody_status
+{
+    NBODY_OK = 0,
+    NBODY_ERROR_ARGUMENT = -1,      /* a null world or buffer, a bad count, type or setting */
+    NBODY_ERROR_MEMORY = -2,
+    NBODY_ERROR_IO = -3,            /* a snapshot that could not be read or written */
+    NBODY_ERROR_CAPACITY = -4       /* a caller buffer smaller than the body count */
+} nbody_status;
+
+enum nbody_body_type
+{
+    NBODY_SUN = 0,
+    NBODY_PLANET = 1,
+    NBODY_ASTEROID = 2
+};
+
+enum nbody_solver
+{
+    NBODY_SOLVER_BRUTE_FORCE = 0,
+    NBODY_SOLVER_BARNES_HUT = 1,
+    NBODY_SOLVER_TEST_PARTICLES = 2,
+    NBODY_SOLVER_FMM = 3,
+    NBODY_SOLVER_PARTICLE_MESH = 4
+};
+
+enum nbody_integrator
+{
+    NBODY_INTEGRATOR_EULER = 0,
+    NBODY_INTEGRATOR_LEAPFROG = 1,
+    NBODY_INTEGRATOR_VERLET = 2,
+    NBODY_INTEGRATOR_YOSHIDA4 = 3
+};
+
+/* which arrays nbody_read and nbody_write touch */
+enum nbody_field
+{
+    NBODY_FIELD_POSITION = 1 << 0,
+    NBODY_FIELD_VELOCITY = 1 << 1,
+    NBODY_FIELD_ACCELERATION = 1 << 2,  /* float x y z, from the last force pass */
+    NBODY_FIELD_MASS = 1 << 3,
+    NBODY_FIELD_ID = 1 << 4,
+    NBODY_FIELD_TYPE = 1 << 5,
+    NBODY_FIELD_RADIUS = 1 << 6
+};
+
+/* struct_size is sizeof(nbody_settings) as the caller was compiled, so later versions can append fields */
+typedef struct nbody_settings
+{
+    uint32_t struct_size;
+    float G;
+    float softening_sq;
+    int32_t solver;                 /* nbody_solver */
+    float theta;                    /* Barnes-Hut opening angle */
+    int32_t integrator;             /* nbody_integrator */
+    int32_t threads;                /* worker threads a step may use */
+    int32_t asteroid_self_gravity;  /* the brute-force solver's asteroid-asteroid term */
+    int32_t collisions;             /* merge touching bodies */
+    int32_t morton_sort;            /* reorder asteroids by Z-order key for locality */
+    int32_t block_timesteps;
+    int32_t kepler_asteroids;
+    uint32_t fmm_order;
+    float fmm_theta;
+} nbody_settings;
+
+/* the viewer's sun, planet and belt; the bodies it creates replace any the world had */
+typedef struct nbody_scenario
+{
+    uint32_t struct_size;
+    float sun_mass;
+    float planet_mass;
+    float planet_orbit_radius;
+    uint32_t asteroid_count;
+    float asteroid_mass;
+    float belt_inner_radius;
+    float belt_outer_radius;
+    float belt_height;
+    uint32_t seed;
+} nbody_scenario;
+
+/* caller-owned arrays, each either null (not read or written) or holding capacity bodies */
+typedef struct nbody_buffers
+{
+    size_t capacity;
+    double* position;               /* 3 per body */
+    double* velocity;               /* 3 per body */
+    float* acceleration;            /* 3 per body */
+    float* mass;
+    uint32_t* id;
+    uint8_t* type;
+    float* radius;
+} nbody_buffers;
+
+/* pointers straight into the world's arrays, no copy; valid until the next call that steps or changes the world */
+typedef struct nbody_view
+{
+    size_t count;
+    size_t type_begin[3];           /* bodies of type t are [type_begin[t], type_begin[t] + type_count[t]) */
+    size_t type_count[3];
+    const double* position;
+    const double* velocity;
+    const float* acceleration;
+    const float* mass;
+    const uint32_t* id;
+} nbody_view;
+
+NBODY_API uint32_t nbody_api_version(void);
+
+NBODY_API void nbody_default_settings(nbody_settings* settings);
+NBODY_API void nbody_default_scenario(nbody_scenario* scenario);
+
+/* settings may be null for the defaults; null when out of memory */
+NBODY_API nbody_world* nbody_create(const nbody_settings* settings);
+NBODY_API void nbody_destroy(nbody_world* world);
+/* why the last failing call on world failed, empty before one did */
+NBODY_API const char* nbody_error(const nbody_world* world);
+
+NBODY_API int nbody_get_settings(const nbody_world* world, nbody_settings* settings);
+NBODY_API int nbody_set_settings(nbody_world* world, const nbody_settings* settings);
+
+NBODY_API int nbody_init_scenario(nbody_world* world, const nbody_scenario* scenario);
+NBODY_API int nbody_clear(nbody_world* world);
+
+/* appends count bodies, each to the end of its type's range. types, positions, velocities and masses are required,
+   radii may be null (1 each); ids_out, when given, receives the new bodies' ids in the order they were passed */
+NBODY_API int nbody_add_bodies(nbody_world* world, size_t count, const uint8_t* types, const double* positions,
+                               const double* velocities, const float* masses, const float* radii, uint32_t* ids_out);
+/* removes the bodies with the given ids, unknown ids are skipped */
+NBODY_API int nbody_remove_bodies(nbody_world* world, size_t count, const uint32_t* ids);
+
+/* steps times dt of sim time */
+NBODY_API int nbody_step(nbody_world* world, float dt, uint32_t steps);
+
+NBODY_API size_t nbody_body_count(const nbody_world* world);
+NBODY_API double nbody_sim_time(const nbody_world* world);
+NBODY_API uint64_t nbody_step_count(const nbody_world* world);
+/* pair or tree-cell terms the last step summed */
+NBODY_API uint64_t nbody_interactions(const nbody_world* world);
+/* kinetic plus potential energy by direct summation, O(N^2) */
+NBODY_API double nbody_total_energy(const nbody_world* world);
+
+/* copies the fields in the mask into the buffers, in index order; NBODY_ERROR_CAPACITY if they are too small */
+NBODY_API int nbody_read(const nbody_world* world, uint32_t fields, const nbody_buffers* buffers);
+/* overwrites position, velocity and mass from the buffers, in index order, for all bodies; other fields are ignored */
+NBODY_API int nbody_write(nbody_world* world, uint32_t fields, const nbody_buffers* buffers);
+NBODY_API int nbody_view_state(const nbody_world* world, nbody_view* view);
+
+NBODY_API int nbody_load_snapshot(nbody_world* world, const char* path);
+NBODY_API int nbody_save_snapshot(const nbody_world* world, const char* path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef ORBIT_LINES_H
+#define ORBIT_LINES_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <orbit_predictor.h>
+#include <streaming_buffer.h>
+#include <shader.h>
+#include <gpu_memory.h>
+#include <gl_state_cache.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+// Draws an OrbitPredictor's paths as line strips. The points are written camera-relative every frame into a
+// StreamingBuffer segment, so only the few thousand vertices of the paths go up and nothing the GPU still reads
+// is touched, and all paths are one glMultiDrawArrays. Each path starts at where its body is drawn this frame and
+// follows the samples past the clock, fading out toward the horizon.
+class OrbitLines
+{
+public:
+    static const unsigned int MAX_PATHS = 16;
+
+    struct LineVertex
+    {
+        glm::vec3 position;     // camera-relative
+        uint32_t color;         // RGBA8, alpha the fade
+    };
+
+    OrbitLines(const char* vertexPath, const char* fragmentPath) : shader(vertexPath, fragmentPath) {}
+    OrbitLines(const OrbitLines&) = delete;
+    OrbitLines& operator=(const OrbitLines&) = delete;
+
+    Shader& program() { return shader; }
+    unsigned int vertexArray() const { return vao.id(); }
+    size_t pathCount() const { return counts.size(); }
+    size_t vertexCount() const { return vertices; }
+
+    // writes the paths of prediction from simTime on; drawnAt(id, position) gives where a body is drawn this frame and
+    // returns false to leave its path out, colorOf(id) its RGB. Waits only if the GPU is a full ring behind.
+    template <typename DrawnAt, typename ColorOf>
+    void upload(const OrbitPredictor::Prediction& prediction, double simTime, const glm::dvec3& camera,
+                const DrawnAt& drawnAt, const ColorOf& colorOf)
+    {
+        firsts.clear();
+        counts.clear();
+        vertices = 0;
+        const size_t paths = std::min<size_t>(prediction.paths.size(), MAX_PATHS);
+        const size_t perPath = prediction.samples() + 1;
+        if (paths == 0 || prediction.interval <= 0.0)
+            return;
+        reserve(paths * perPath);
+        LineVertex* out = static_cast<LineVertex*>(stream.beginWrite());
+        if (!out)
+            return;
+        const GLint base = static_cast<GLint>(stream.readSegment() * capacity);
+        const size_t firstAhead = static_cast<size_t>(std::max(0.0, std::ceil((simTime - prediction.firstTime) / prediction.interval)));
+        for (size_t k = 0; k < paths; k++)
+        {
+            glm::dvec3 now;
+            if (!drawnAt(prediction.ids[k], now))
+                continue;
+            const glm::vec3 rgb = glm::clamp(colorOf(prediction.ids[k]), glm::vec3(0.0f), glm::vec3(1.0f));
+            const size_t start = vertices;
+            out[vertices++] = LineVertex{glm::vec3(now - camera), pack(rgb, 1.0f)};
+            const std::vector<glm::dvec3>& p = prediction.paths[k];
+            for (size_t s = firstAhead; s < p.size(); s++)
+            {
+                const double ahead = prediction.firstTime + prediction.interval * static_cast<double>(s) - simTime;
+                const float fade = 1.0f - static_cast<float>(std::clamp(ahead / prediction.horizon, 0.0, 1.0));
+                out[vertices++] = LineVertex{glm::vec3(p[s] - camera), pack(rgb, fade)};
+            }
+            if (vertices - start < 2)
+            {
+                vertices = start;
+                continue;
+            }
+            firsts.push_back(base + static_cast<GLint>(start));
+            counts.push_back(static_cast<GLsizei>(vertices - start));
+        }
+    }
+
+    // the uploaded paths with the shader in use and vertexArray() bound; fences the segment for the next upload
+    void draw(float brightness)
+    {
+        if (counts.empty())
+            return;
+        shader.setFloat("brightness", brightness);
+        glMultiDrawArrays(GL_LINE_STRIP, firsts.data(), counts.data(), static_cast<GLsizei>(counts.size()));
+        stream.fenceRead();
+    }
+
+    void release()
+    {
+        stream.release();
+        vao.release();
+        capacity = 0;
+        firsts.clear();
+        counts.clear();
+        vertices = 0;
+    }
+
+private:
+    Shader shader;
+    StreamingBuffer stream{GPU_MEMORY_OTHER};
+    GlVertexArray vao;
+    size_t capacity = 0;            // vertices per segment
+    size_t vertices = 0;
+    std::vector<GLint> firsts;
+    std::vector<GLsizei> counts;
+
+    static uint32_t pack(const glm::vec3& rgb, float alpha)
+    {
+        const glm::uvec4 c(glm::vec4(rgb, alpha) * 255.0f + 0.5f);
+        return c.r | (c.g << 8) | (c.b << 16) | (c.a << 24);
+    }
+
+    // a segment for at least count vertices, doubling so a growing horizon reallocates a few times
+    void reserve(size_t count)
+    {
+        if (count <= capacity && stream.valid())
+            return;
+        capacity = std::max(count, 2 * capacity);
+        stream.create(capacity * sizeof(LineVertex), "orbit prediction lines");
+        vao.create("orbit prediction lines");
+        glState().bindBuffer(GL_ARRAY_BUFFER, stream.buffer());
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(LineVertex), (void*)offsetof(LineVertex, position));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(LineVertex), (void*)offsetof(LineVertex, color));
+        glState().bindBuffer(GL_ARRAY_BUFFER, 0);
+        glState().bindVertexArray(0);
+    }
+};
+
+#endif
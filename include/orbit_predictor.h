@@ -0,0 +1,402 @@
+#ifndef ORBIT_PREDICTOR_H
+#define ORBIT_PREDICTOR_H
+
+#include <glm.hpp>
+
+#include <body_store.h>
+#include <kepler.h>
+#include <async_physics.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+// Predicted future paths of a few bodies, the planets and picked asteroids, computed on a thread of its own. Only
+// the sun and planets are integrated, the tracked asteroids are test particles in their field, so a prediction
+// costs the same for a belt of ten bodies as for a million. update() hands the worker the current state of those
+// few bodies and it extends the prediction to horizon sim seconds past the clock: samples behind the clock are
+// dropped and new ones integrated at the far end from where the last one left off, so sim time moving on one frame
+// costs one frame's worth of steps. A prediction is recomputed from the given state only when it no longer fits,
+// the tracked set or G changed, the clock left the predicted span, or a body strayed more than tolerance of its
+// distance from the sun off its path (asteroid pulls, a collision). With the sun as the only massive body, or
+// kepler set, every path is a two-body orbit around the sun and the samples come from keplerPropagate, otherwise
+// from leapfrog at interval / substeps.
+class OrbitPredictor
+{
+public:
+    struct Settings
+    {
+        double horizon = 8.0;           // sim seconds ahead of the clock
+        unsigned int samples = 512;     // points per path over the horizon
+        unsigned int substeps = 4;      // leapfrog steps per sample
+        double tolerance = 2e-3;        // stray, relative to the distance from the sun, that forces a recompute
+        bool kepler = false;            // two-body orbits around the sun even with planets
+
+        bool operator==(const Settings& o) const
+        {
+            return horizon == o.horizon && samples == o.samples && substeps == o.substeps && tolerance == o.tolerance &&
+                   kepler == o.kepler;
+        }
+        bool operator!=(const Settings& o) const { return !(*this == o); }
+    };
+
+    // one published prediction: sample k of every path is at sim time firstTime + k * interval
+    struct Prediction
+    {
+        std::vector<uint32_t> ids;                  // body id per path
+        std::vector<std::vector<glm::dvec3>> paths;
+        double firstTime = 0.0;
+        double interval = 0.0;
+        double horizon = 0.0;
+        unsigned long generation = 0;               // bumped by every recompute
+
+        size_t samples() const { return paths.empty() ? 0 : paths[0].size(); }
+        double lastTime() const { return firstTime + interval * static_cast<double>(samples() > 0 ? samples() - 1 : 0); }
+
+        // a path's position at sim time t, linear between samples; false outside the predicted span
+        bool at(size_t path, double t, glm::dvec3& out) const
+        {
+            const std::vector<glm::dvec3>& p = paths[path];
+            if (p.empty() || interval <= 0.0 || t < firstTime || t > lastTime())
+                return false;
+            const double u = (t - firstTime) / interval;
+            const size_t k = std::min(static_cast<size_t>(u), p.size() - 1);
+            const size_t next = std::min(k + 1, p.size() - 1);
+            out = glm::mix(p[k], p[next], u - static_cast<double>(k));
+            return true;
+        }
+    };
+
+    ~OrbitPredictor()
+    {
+        stop();
+    }
+
+    // the current state of the massive bodies and of the bodies with the given ids (unknown ones are skipped) at
+    // simTime. Copies O(massive + ids) and returns, any thread may call it, one at a time.
+    void update(const BodyStore& bodies, double simTime, const std::vector<uint32_t>& ids, float G, float epsilonSq,
+                const Settings& settings)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Request& r = request;
+        const BodyRange massive{0, bodies.range(BODY_ASTEROID).begin};
+        r.massPos.assign(bodies.position.begin() + massive.begin, bodies.position.begin() + massive.end);
+        r.massVel.assign(bodies.velocity.begin() + massive.begin, bodies.velocity.begin() + massive.end);
+        r.mass.assign(bodies.mass.begin() + massive.begin, bodies.mass.begin() + massive.end);
+        r.massStatic.resize(massive.size());
+        for (size_t i = massive.begin; i < massive.end; i++)
+            r.massStatic[i] = bodies.isStatic(i);
+        r.massIds.assign(bodies.id.begin() + massive.begin, bodies.id.begin() + massive.end);
+        r.ids.clear();
+        r.pos.clear();
+        r.vel.clear();
+        for (uint32_t id : ids)
+        {
+            const uint32_t i = bodies.indexOf(id);
+            if (i == BodyStore::INVALID_INDEX || std::find(r.ids.begin(), r.ids.end(), id) != r.ids.end())
+                continue;
+            r.ids.push_back(id);
+            r.pos.push_back(bodies.position[i]);
+            r.vel.push_back(bodies.velocity[i]);
+        }
+        r.simTime = simTime;
+        r.G = G;
+        r.epsilonSq = epsilonSq;
+        r.settings = settings;
+        r.settings.samples = std::max(r.settings.samples, 2u);
+        r.settings.substeps = std::max(r.settings.substeps, 1u);
+        pending = true;
+        if (!thread.joinable())
+        {
+            stopping = false;
+            thread = std::thread([this]() { run(); });
+        }
+        wake.notify_one();
+    }
+
+    // the render thread's side: true if a newer prediction was taken, latest() is valid once one was
+    bool acquire()
+    {
+        if (!published)
+            return false;
+        const bool fresh = buffer.acquire();
+        if (fresh) have = true;
+        return fresh;
+    }
+    bool ready() const { return have; }
+    const Prediction& latest() const { return buffer.readSlot(); }
+
+    // forgets the prediction and ends the thread, the next update() starts over
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            wake.notify_one();
+        }
+        if (thread.joinable())
+            thread.join();
+        pending = false;
+        valid = false;
+        have = false;
+        published.store(false, std::memory_order_relaxed);
+    }
+
+    // worker statistics, approximate while it runs
+    unsigned long recomputes() const { return recomputeCount.load(std::memory_order_relaxed); }
+    unsigned long samplesComputed() const { return sampleCount.load(std::memory_order_relaxed); }
+    float workerMsLastUpdate() const { return workerMs.load(std::memory_order_relaxed); }
+
+private:
+    struct Request
+    {
+        std::vector<glm::dvec3> massPos, massVel;
+        std::vector<float> mass;
+        std::vector<uint8_t> massStatic;
+        std::vector<uint32_t> massIds;
+        std::vector<uint32_t> ids;
+        std::vector<glm::dvec3> pos, vel;
+        double simTime = 0.0;
+        float G = 0.0f, epsilonSq = 0.0f;
+        Settings settings;
+    };
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    bool pending = false;
+    Request request;                // written by update(), taken by the worker
+    TripleBuffer<Prediction> buffer;
+    std::atomic<bool> published{false};
+    bool have = false;
+    std::atomic<unsigned long> recomputeCount{0};
+    std::atomic<unsigned long> sampleCount{0};
+    std::atomic<float> workerMs{0.0f};
+
+    // the worker's own: the request it works from, the integrator state at the last sample and the samples
+    Request current;
+    bool valid = false;
+    std::vector<glm::dvec3> massPos, massVel, massAcc;
+    std::vector<glm::dvec3> pos, vel, acc;
+    std::vector<int> massiveSlot;   // per path, the massive body it follows or -1 for a test particle
+    Prediction prediction;
+
+    void run()
+    {
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this]() { return stopping || pending; });
+                if (stopping)
+                    return;
+                std::swap(current, request);
+                pending = false;
+            }
+            const auto start = std::chrono::steady_clock::now();
+            bool changed = false;
+            if (needsRecompute())
+            {
+                recompute();
+                changed = true;
+            }
+            changed = advanceTo(current.simTime) || changed;
+            if (changed)
+            {
+                buffer.writeSlot() = prediction;
+                buffer.publish();
+                published.store(true, std::memory_order_release);
+            }
+            workerMs.store(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count(),
+                           std::memory_order_relaxed);
+        }
+    }
+
+    bool useKepler() const
+    {
+        return !current.mass.empty() && (current.settings.kepler || current.mass.size() == 1);
+    }
+
+    // whether the prediction no longer describes what the request says
+    bool needsRecompute() const
+    {
+        if (!valid || current.settings != settingsUsed || current.G != gUsed || current.epsilonSq != epsilonUsed ||
+            current.massIds != massIdsUsed || current.ids != prediction.ids)
+            return true;
+        const double t = current.simTime;
+        if (t < prediction.firstTime || t > prediction.lastTime())
+            return true;
+        const glm::dvec3 sun = current.massPos.empty() ? glm::dvec3(0.0) : current.massPos[0];
+        for (size_t k = 0; k < current.ids.size(); k++)
+        {
+            glm::dvec3 predicted;
+            if (!prediction.at(k, t, predicted))
+                return true;
+            const double scale = std::max(glm::length(current.pos[k] - sun), 1e-6);
+            if (glm::length(predicted - current.pos[k]) > current.settings.tolerance * scale)
+                return true;
+        }
+        return false;
+    }
+
+    Settings settingsUsed;
+    float gUsed = 0.0f, epsilonUsed = 0.0f;
+    std::vector<uint32_t> massIdsUsed;
+
+    // starts the paths over from the request's state, one sample at its time
+    void recompute()
+    {
+        settingsUsed = current.settings;
+        gUsed = current.G;
+        epsilonUsed = current.epsilonSq;
+        massIdsUsed = current.massIds;
+        massPos = current.massPos;
+        massVel = current.massVel;
+        massAcc.assign(massPos.size(), glm::dvec3(0.0));
+        pos.clear();
+        vel.clear();
+        massiveSlot.clear();
+        prediction.ids = current.ids;
+        prediction.paths.assign(current.ids.size(), std::vector<glm::dvec3>());
+        for (size_t k = 0; k < current.ids.size(); k++)
+        {
+            auto massive = std::find(current.massIds.begin(), current.massIds.end(), current.ids[k]);
+            massiveSlot.push_back(massive == current.massIds.end() ? -1 : static_cast<int>(massive - current.massIds.begin()));
+            pos.push_back(current.pos[k]);
+            vel.push_back(current.vel[k]);
+            prediction.paths[k].reserve(current.settings.samples + 1);
+            prediction.paths[k].push_back(current.pos[k]);
+        }
+        acc.assign(pos.size(), glm::dvec3(0.0));
+        accelerations();
+        prediction.firstTime = current.simTime;
+        prediction.interval = current.settings.horizon / static_cast<double>(current.settings.samples - 1);
+        prediction.horizon = current.settings.horizon;
+        prediction.generation++;
+        valid = true;
+        recomputeCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // drops the samples more than one interval behind t and integrates new ones until the horizon past t is
+    // covered; true if anything changed
+    bool advanceTo(double t)
+    {
+        if (!valid || prediction.paths.empty() || prediction.interval <= 0.0)
+            return false;
+        bool changed = false;
+        const size_t behind = static_cast<size_t>(std::max(0.0, (t - prediction.firstTime) / prediction.interval));
+        if (behind > 1)
+        {
+            const size_t drop = std::min(behind - 1, prediction.samples() - 1);
+            for (std::vector<glm::dvec3>& p : prediction.paths)
+                p.erase(p.begin(), p.begin() + static_cast<std::ptrdiff_t>(drop));
+            prediction.firstTime += prediction.interval * static_cast<double>(drop);
+            changed = true;
+        }
+        const double until = t + prediction.horizon;
+        while (prediction.lastTime() < until)
+        {
+            nextSample(prediction.interval);
+            changed = true;
+        }
+        return changed;
+    }
+
+    void nextSample(double interval)
+    {
+        if (useKepler())
+            keplerSample(interval);
+        else
+        {
+            const double h = interval / static_cast<double>(current.settings.substeps);
+            for (unsigned int s = 0; s < current.settings.substeps; s++)
+                leapfrog(h);
+        }
+        for (size_t k = 0; k < prediction.paths.size(); k++)
+            prediction.paths[k].push_back(massiveSlot[k] >= 0 ? massPos[massiveSlot[k]] : pos[k]);
+        sampleCount.fetch_add(prediction.paths.size(), std::memory_order_relaxed);
+    }
+
+    // everything but the sun on a two-body orbit around it, the sun drifting at its own velocity. An orbit the
+    // solve cannot follow (one into the sun) stops where it is.
+    void keplerSample(double dt)
+    {
+        const double mu = static_cast<double>(current.G) * static_cast<double>(current.mass[0]);
+        const glm::dvec3 sunVel = current.massStatic[0] ? glm::dvec3(0.0) : massVel[0];
+        for (size_t i = 1; i < massPos.size(); i++)
+        {
+            // a planet's relative orbit feels both masses
+            const double muPair = mu + static_cast<double>(current.G) * static_cast<double>(current.mass[i]);
+            glm::dvec3 r = massPos[i] - massPos[0], v = massVel[i] - sunVel;
+            if (keplerPropagate(r, v, muPair, dt))
+            {
+                massPos[i] = massPos[0] + sunVel * dt + r;
+                massVel[i] = sunVel + v;
+            }
+        }
+        for (size_t k = 0; k < pos.size(); k++)
+        {
+            if (massiveSlot[k] >= 0)
+                continue;
+            glm::dvec3 r = pos[k] - massPos[0], v = vel[k] - sunVel;
+            if (keplerPropagate(r, v, mu, dt))
+            {
+                pos[k] = massPos[0] + sunVel * dt + r;
+                vel[k] = sunVel + v;
+            }
+        }
+        massPos[0] += sunVel * dt;
+    }
+
+    // one kick-drift-kick step of the massive bodies and the test particles together
+    void leapfrog(double h)
+    {
+        const double half = 0.5 * h;
+        for (size_t i = 0; i < massPos.size(); i++)
+        {
+            if (current.massStatic[i]) continue;
+            massVel[i] += massAcc[i] * half;
+            massPos[i] += massVel[i] * h;
+        }
+        for (size_t k = 0; k < pos.size(); k++)
+        {
+            if (massiveSlot[k] >= 0) continue;
+            vel[k] += acc[k] * half;
+            pos[k] += vel[k] * h;
+        }
+        accelerations();
+        for (size_t i = 0; i < massPos.size(); i++)
+            if (!current.massStatic[i]) massVel[i] += massAcc[i] * half;
+        for (size_t k = 0; k < pos.size(); k++)
+            if (massiveSlot[k] < 0) vel[k] += acc[k] * half;
+    }
+
+    glm::dvec3 pullAt(const glm::dvec3& at, size_t skip) const
+    {
+        glm::dvec3 a(0.0);
+        const double eps = static_cast<double>(current.epsilonSq);
+        for (size_t j = 0; j < massPos.size(); j++)
+        {
+            if (j == skip) continue;
+            const glm::dvec3 d = massPos[j] - at;
+            const double r2 = glm::dot(d, d) + eps;
+            a += d * (static_cast<double>(current.mass[j]) / (r2 * std::sqrt(r2)));
+        }
+        return a * static_cast<double>(current.G);
+    }
+
+    void accelerations()
+    {
+        for (size_t i = 0; i < massPos.size(); i++)
+            massAcc[i] = pullAt(massPos[i], i);
+        for (size_t k = 0; k < pos.size(); k++)
+            if (massiveSlot[k] < 0) acc[k] = pullAt(pos[k], massPos.size());
+    }
+};
+
+#endif
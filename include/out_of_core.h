@@ -0,0 +1,982 @@
+#ifndef OUT_OF_CORE_H
+#define OUT_OF_CORE_H
+
+#include <glm.hpp>
+
+#include <body_store.h>
+#include <physics_world.h>
+#include <barnes_hut.h>
+#include <morton.h>
+#include <mapped_file.h>
+#include <thread_pool.h>
+#include <philox.h>
+#include <profiler.h>
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+// one body of a chunk file as it moves through the sort
+struct ChunkBody
+{
+    glm::dvec3 position;
+    glm::dvec3 velocity;
+    glm::vec3 acceleration;     // with G, from the last force pass
+    float mass;
+    uint32_t id;
+    uint32_t flags;
+};
+
+// the fields of a chunk file, for prefetch, touch and flush
+enum ChunkField
+{
+    CHUNK_POSITION = 1 << 0,
+    CHUNK_VELOCITY = 1 << 1,
+    CHUNK_ACCELERATION = 1 << 2,
+    CHUNK_MASS = 1 << 3,
+    CHUNK_ID = 1 << 4,
+    CHUNK_FLAGS = 1 << 5,
+    CHUNK_ALL = (1 << 6) - 1
+};
+
+// The bodies [0, size) of an out-of-core run in files of a fixed number of bodies each, every file a page of header
+// and then BodyStore's fields one array after the other, so a pass over a run of bodies streams just the fields it
+// touches. The files are mapped shared: the kernel pages them in as they are touched and writes them back, and only
+// the pages being worked on need to be in memory.
+class ChunkFileSet
+{
+public:
+    static const size_t HEADER_BYTES = 4096;
+    static const size_t BYTES_PER_BODY = 2 * sizeof(glm::dvec3) + sizeof(glm::vec3) + sizeof(float) + 2 * sizeof(uint32_t);
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t reserved;
+        uint64_t firstBody;
+        uint64_t bodies;        // in this file
+        uint64_t capacity;
+        double simTime;
+    };
+
+    // the arrays of one file
+    struct Chunk
+    {
+        glm::dvec3* position;
+        glm::dvec3* velocity;
+        glm::vec3* acceleration;
+        float* mass;
+        uint32_t* id;
+        uint32_t* flags;
+    };
+
+    ChunkFileSet() = default;
+    ~ChunkFileSet()
+    {
+        close(false);
+    }
+
+    ChunkFileSet(const ChunkFileSet&) = delete;
+    ChunkFileSet& operator=(const ChunkFileSet&) = delete;
+
+    // directory/name.NNNNN.bodies for count bodies, chunkBodies to a file; the files read as zero until written
+    bool create(const std::string& directory, const std::string& name, size_t count, size_t chunkBodies)
+    {
+        close(true);
+        capacity = std::max<size_t>(1, chunkBodies);
+        bodies = count;
+        const size_t fileCount = (count + capacity - 1) / capacity;
+        for (size_t f = 0; f < fileCount; f++)
+        {
+            char suffix[32];
+            std::snprintf(suffix, sizeof(suffix), ".%05zu.bodies", f);
+            paths.push_back(directory + "/" + name + suffix);
+            files.emplace_back(new MappedWritableFile());
+            if (!files.back()->create(paths.back().c_str(), HEADER_BYTES + capacity * BYTES_PER_BODY))
+            {
+                close(true);
+                return false;
+            }
+            unsigned char* base = files.back()->data();
+            Header header = {};
+            std::memcpy(header.magic, "NBCHUNK", 8);
+            header.version = 1;
+            header.firstBody = f * capacity;
+            header.bodies = std::min(capacity, count - f * capacity);
+            header.capacity = capacity;
+            std::memcpy(base, &header, sizeof(header));
+
+            Chunk chunk;
+            size_t offset = HEADER_BYTES;
+            chunk.position = reinterpret_cast<glm::dvec3*>(base + offset);
+            offset += capacity * sizeof(glm::dvec3);
+            chunk.velocity = reinterpret_cast<glm::dvec3*>(base + offset);
+            offset += capacity * sizeof(glm::dvec3);
+            chunk.acceleration = reinterpret_cast<glm::vec3*>(base + offset);
+            offset += capacity * sizeof(glm::vec3);
+            chunk.mass = reinterpret_cast<float*>(base + offset);
+            offset += capacity * sizeof(float);
+            chunk.id = reinterpret_cast<uint32_t*>(base + offset);
+            offset += capacity * sizeof(uint32_t);
+            chunk.flags = reinterpret_cast<uint32_t*>(base + offset);
+            chunks.push_back(chunk);
+        }
+        return true;
+    }
+
+    // unmaps the files, deleting them with removeFiles
+    void close(bool removeFiles)
+    {
+        files.clear();
+        chunks.clear();
+        if (removeFiles)
+            for (const std::string& path : paths)
+                std::remove(path.c_str());
+        paths.clear();
+        bodies = 0;
+    }
+
+    size_t size() const { return bodies; }
+    size_t chunkCapacity() const { return capacity; }
+    size_t fileCount() const { return files.size(); }
+    size_t fileBytes() const { return files.size() * (HEADER_BYTES + capacity * BYTES_PER_BODY); }
+    const std::string& path(size_t file) const { return paths[file]; }
+
+    const Chunk& chunkOf(size_t i) const { return chunks[i / capacity]; }
+
+    ChunkBody load(size_t i) const
+    {
+        const Chunk& c = chunkOf(i);
+        const size_t s = i % capacity;
+        return ChunkBody{c.position[s], c.velocity[s], c.acceleration[s], c.mass[s], c.id[s], c.flags[s]};
+    }
+
+    void store(size_t i, const ChunkBody& body) const
+    {
+        const Chunk& c = chunkOf(i);
+        const size_t s = i % capacity;
+        c.position[s] = body.position;
+        c.velocity[s] = body.velocity;
+        c.acceleration[s] = body.acceleration;
+        c.mass[s] = body.mass;
+        c.id[s] = body.id;
+        c.flags[s] = body.flags;
+    }
+
+    // fn(chunk, slotBegin, slotEnd, firstBody) over the pieces of [begin, end) in each file, in order
+    template <typename Fn>
+    void forEachSegment(size_t begin, size_t end, const Fn& fn) const
+    {
+        end = std::min(end, bodies);
+        while (begin < end)
+        {
+            const size_t file = begin / capacity;
+            const size_t slot = begin - file * capacity;
+            const size_t count = std::min(end - begin, capacity - slot);
+            fn(chunks[file], slot, slot + count, begin);
+            begin += count;
+        }
+    }
+
+    // asks the kernel to start reading the fields of [begin, end)
+    void prefetch(size_t begin, size_t end, unsigned int fields) const
+    {
+        forEachRange(begin, end, fields, [](const MappedWritableFile& file, size_t offset, size_t length) {
+            file.prefetch(offset, length);
+        });
+    }
+
+    // faults the pages of the fields of [begin, end) in by reading a byte of each
+    void touch(size_t begin, size_t end, unsigned int fields) const
+    {
+        const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        forEachRange(begin, end, fields, [page](const MappedWritableFile& file, size_t offset, size_t length) {
+            const volatile unsigned char* bytes = file.data();
+            unsigned char sink = 0;
+            for (size_t b = offset - offset % page; b < offset + length; b += page)
+                sink ^= bytes[b];
+            (void)sink;
+        });
+    }
+
+    // starts the write-back of the fields of [begin, end)
+    void flush(size_t begin, size_t end, unsigned int fields) const
+    {
+        forEachRange(begin, end, fields, [](const MappedWritableFile& file, size_t offset, size_t length) {
+            file.flush(offset, length);
+        });
+    }
+
+    void sequential(bool on) const
+    {
+        for (const std::unique_ptr<MappedWritableFile>& file : files)
+            file->sequential(on);
+    }
+
+    void setSimTime(double simTime) const
+    {
+        for (const std::unique_ptr<MappedWritableFile>& file : files)
+            std::memcpy(file->data() + offsetof(Header, simTime), &simTime, sizeof(simTime));
+    }
+
+private:
+    std::vector<std::unique_ptr<MappedWritableFile>> files;
+    std::vector<Chunk> chunks;
+    std::vector<std::string> paths;
+    size_t capacity = 1;
+    size_t bodies = 0;
+
+    // fn(file, byteOffset, byteLength) for each field of fields over each file's piece of [begin, end)
+    template <typename Fn>
+    void forEachRange(size_t begin, size_t end, unsigned int fields, const Fn& fn) const
+    {
+        static const size_t fieldBytes[] = {sizeof(glm::dvec3), sizeof(glm::dvec3), sizeof(glm::vec3), sizeof(float),
+                                            sizeof(uint32_t), sizeof(uint32_t)};
+        end = std::min(end, bodies);
+        while (begin < end)
+        {
+            const size_t file = begin / capacity;
+            const size_t slot = begin - file * capacity;
+            const size_t count = std::min(end - begin, capacity - slot);
+            size_t fieldOffset = HEADER_BYTES;
+            for (unsigned int f = 0; f < 6; f++)
+            {
+                if (fields & (1u << f))
+                    fn(*files[file], fieldOffset + slot * fieldBytes[f], count * fieldBytes[f]);
+                fieldOffset += capacity * fieldBytes[f];
+            }
+            begin += count;
+        }
+    }
+};
+
+// Threads that fault file pages in ahead of the pass that will read them: a requested range is advised to the
+// kernel and then touched a page at a time, so the force pass finds it resident instead of stalling on each fault.
+// The queue keeps the latest requests, one that falls too far behind is dropped.
+class ChunkReadAhead
+{
+public:
+    ChunkReadAhead() = default;
+    ~ChunkReadAhead()
+    {
+        stop();
+    }
+
+    ChunkReadAhead(const ChunkReadAhead&) = delete;
+    ChunkReadAhead& operator=(const ChunkReadAhead&) = delete;
+
+    void start(unsigned int threadCount)
+    {
+        stop();
+        stopping = false;
+        for (unsigned int t = 0; t < threadCount; t++)
+            workers.emplace_back([this]() { loop(); });
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            queue.clear();
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+        workers.clear();
+    }
+
+    void request(const ChunkFileSet& set, size_t begin, size_t end, unsigned int fields)
+    {
+        if (workers.empty() || begin >= end)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (queue.size() >= MAX_QUEUED)
+                queue.pop_front();
+            queue.push_back(Range{&set, begin, end, fields});
+        }
+        wake.notify_one();
+    }
+
+    // drops what has not started and waits for what has, before a set is closed or rewritten
+    void cancel()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        queue.clear();
+        idle.wait(lock, [this]() { return running == 0; });
+    }
+
+private:
+    static const size_t MAX_QUEUED = 256;
+
+    struct Range
+    {
+        const ChunkFileSet* set;
+        size_t begin;
+        size_t end;
+        unsigned int fields;
+    };
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    std::deque<Range> queue;
+    unsigned int running = 0;
+    bool stopping = false;
+
+    void loop()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            wake.wait(lock, [this]() { return stopping || !queue.empty(); });
+            if (stopping)
+                return;
+            Range range = queue.front();
+            queue.pop_front();
+            running++;
+            lock.unlock();
+            range.set->prefetch(range.begin, range.end, range.fields);
+            range.set->touch(range.begin, range.end, range.fields);
+            lock.lock();
+            if (--running == 0)
+                idle.notify_all();
+        }
+    }
+};
+
+// Barnes-Hut over more bodies than fit in memory. The bodies live in memory-mapped chunk files (ChunkFileSet) in
+// Z-order, so a cell of space is a contiguous run of every file array, and only a summary of the top of the octree
+// stays resident: the nonempty cells of level TOP_LEVELS ("buckets", each a run of the files) and the nodes above
+// them, with bounds, centre of mass and mass refreshed in the drift pass from the bodies' new positions.
+//
+// The force pass goes over target groups, the top-tree nodes of at most groupBodies bodies. For a group, a walk of
+// the top tree accepts the nodes far enough from the group's bounding box as monopoles and collects the buckets it
+// has to open; their bodies and the group's are gathered from the files into an in-memory BarnesHutTree, walked for
+// each target as PhysicsWorld's would. While a group computes, ChunkReadAhead faults in the runs the next one needs.
+// Kick-drift-kick leapfrog, G, softening and theta are PhysicsWorld's. Bodies drift out of Z-order as they move;
+// every resortInterval steps an external bucket sort writes them in order into the second set of files, which are
+// swapped with the first.
+class OutOfCoreNBody
+{
+public:
+    struct StepStats
+    {
+        double driftSeconds = 0.0;      // kick, drift and the bucket summaries, one pass over the files
+        double forceSeconds = 0.0;
+        double sortSeconds = 0.0;       // the re-sort, on the steps that have one
+        double totalSeconds = 0.0;
+        size_t groups = 0;
+        size_t nearBodies = 0;          // gathered into memory, over every group
+        size_t farNodes = 0;            // accepted as monopoles, over every group
+        unsigned long long interactions = 0;
+        bool resorted = false;
+    };
+
+    float G = 1000.0f;
+    float epsilonSq = 1e-4f;
+    float theta = 0.5f;
+    unsigned int threads = 0;                       // of workerPool(), 0 for all
+    size_t chunkBodies = size_t(1) << 20;           // bodies to a file
+    size_t groupBodies = size_t(1) << 15;
+    unsigned int resortInterval = 64;               // 0 for never
+    unsigned int readAheadThreads = 2;
+
+    double simTime = 0.0;
+    unsigned long stepCount = 0;
+
+    OutOfCoreNBody() = default;
+    ~OutOfCoreNBody()
+    {
+        close(false);
+    }
+
+    OutOfCoreNBody(const OutOfCoreNBody&) = delete;
+    OutOfCoreNBody& operator=(const OutOfCoreNBody&) = delete;
+
+    // seed's bodies followed by asteroids of scenario's belt around seed's first body, written to two sets of chunk
+    // files in directory, sorted, and their first forces summed. False, with error(), if the files cannot be made.
+    bool create(const std::string& directory, const BodyStore& seed, const ScenarioConfig& scenario, size_t asteroids)
+    {
+        PROFILE_SCOPE("OutOfCoreNBody::create");
+        close(false);
+        const size_t n = seed.size() + asteroids;
+        if (n == 0 || n > UINT32_MAX)
+        {
+            failure = "body count out of range";
+            return false;
+        }
+        if (!sets[0].create(directory, "bodies-a", n, chunkBodies) || !sets[1].create(directory, "bodies-b", n, chunkBodies))
+        {
+            failure = "cannot create chunk files in " + directory;
+            close(false);
+            return false;
+        }
+        current = 0;
+        readAhead.start(readAheadThreads);
+
+        for (size_t i = 0; i < seed.size(); i++)
+            sets[0].store(i, ChunkBody{seed.position[i], seed.velocity[i], glm::vec3(0.0f), seed.mass[i],
+                                       static_cast<uint32_t>(i), seed.flags[i]});
+        const glm::dvec3 sunPos = seed.size() > 0 ? seed.position[0] : glm::dvec3(0.0);
+        const glm::dvec3 sunVel = seed.size() > 0 ? seed.velocity[0] : glm::dvec3(0.0);
+        const float sunMass = seed.size() > 0 ? seed.mass[0] : 0.0f;
+        const size_t first = seed.size();
+        workerPool().parallelFor(0, asteroids, [&](size_t begin, size_t end, unsigned int) {
+            for (size_t k = begin; k < end; k++)
+            {
+                philox::Stream rng(scenario.seed, k);
+                const BeltAsteroid asteroid = beltAsteroid(scenario, G, sunMass, rng);
+                sets[0].store(first + k, ChunkBody{asteroid.position + sunPos, asteroid.velocity + sunVel, glm::vec3(0.0f),
+                                                   asteroid.mass, static_cast<uint32_t>(first + k), 0});
+            }
+            sets[0].flush(first + begin, first + end, CHUNK_ALL);
+        }, threads);
+
+        resort();
+        computeForces(0.0);
+        return true;
+    }
+
+    // advances every body by dt
+    void step(float dt)
+    {
+        PROFILE_SCOPE("OutOfCoreNBody::step");
+        const auto start = std::chrono::steady_clock::now();
+        stats = StepStats();
+        kickDrift(dt);
+        computeForces(0.5 * static_cast<double>(dt));
+        simTime += dt;
+        stepCount++;
+        if (resortInterval > 0 && stepCount % resortInterval == 0)
+        {
+            resort();
+            stats.resorted = true;
+        }
+        stats.totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // unmaps the files, deleting the spare set and, unless keepState, the current one
+    void close(bool keepState)
+    {
+        readAhead.stop();
+        if (sets[current].size() > 0)
+            sets[current].setSimTime(simTime);
+        sets[current].close(!keepState);
+        sets[1 - current].close(true);
+        buckets.clear();
+        nodes.clear();
+        groups.clear();
+    }
+
+    size_t size() const { return sets[current].size(); }
+    ChunkBody body(size_t i) const { return sets[current].load(i); }
+    const ChunkFileSet& files() const { return sets[current]; }
+    size_t fileBytes() const { return sets[0].fileBytes() + sets[1].fileBytes(); }
+    size_t bucketCount() const { return buckets.size(); }
+    size_t topNodeCount() const { return nodes.size(); }
+    size_t groupCount() const { return groups.size(); }
+    const StepStats& lastStep() const { return stats; }
+    const std::string& error() const { return failure; }
+
+    // what the run keeps in memory besides the file pages it is working on
+    size_t residentBytes() const
+    {
+        return buckets.capacity() * sizeof(Bucket) + nodes.capacity() * sizeof(TopNode) + groups.capacity() * sizeof(unsigned int)
+             + localPositions.capacity() * sizeof(glm::vec3) + localMasses.capacity() * sizeof(float)
+             + localTree.nodes.capacity() * sizeof(BarnesHutTree::Node) + localTree.indices.capacity() * sizeof(unsigned int) * 2
+             + (near[0].capacity() + near[1].capacity()) * sizeof(Run) + (far[0].capacity() + far[1].capacity()) * sizeof(Monopole);
+    }
+
+private:
+    static const unsigned int TOP_LEVELS = 6;                       // of the 10 of the keys
+    static const unsigned int BUCKET_SHIFT = 3 * (10 - TOP_LEVELS);
+    static const uint32_t BUCKETS = 1u << (3 * TOP_LEVELS);
+
+    // a nonempty cell of level TOP_LEVELS: bodies [begin, end) of the current set
+    struct Bucket
+    {
+        uint32_t key;
+        size_t begin;
+        size_t end;
+        glm::vec3 lo;
+        glm::vec3 hi;
+        glm::vec3 centerOfMass;
+        float mass;
+    };
+
+    struct TopNode
+    {
+        glm::vec3 lo;           // bounds of the node's bodies, not of its cell
+        glm::vec3 hi;
+        glm::vec3 centerOfMass;
+        float mass;
+        size_t begin;
+        size_t end;
+        int firstChild;         // -1 for buckets
+        unsigned int childCount;
+        int bucket;             // index into buckets for leaves, -1 otherwise
+    };
+
+    // running sums for a bucket's summary, merged where a pass splits a bucket between slices
+    struct Summary
+    {
+        glm::vec3 lo = glm::vec3(INFINITY);
+        glm::vec3 hi = glm::vec3(-INFINITY);
+        glm::dvec3 weighted = glm::dvec3(0.0);
+        double mass = 0.0;
+
+        void add(const glm::vec3& p, float m)
+        {
+            lo = glm::min(lo, p);
+            hi = glm::max(hi, p);
+            weighted += glm::dvec3(p) * static_cast<double>(m);
+            mass += m;
+        }
+
+        void merge(const Summary& other)
+        {
+            lo = glm::min(lo, other.lo);
+            hi = glm::max(hi, other.hi);
+            weighted += other.weighted;
+            mass += other.mass;
+        }
+
+        void writeTo(Bucket& bucket) const
+        {
+            bucket.lo = lo;
+            bucket.hi = hi;
+            bucket.mass = static_cast<float>(mass);
+            bucket.centerOfMass = mass > 0.0 ? glm::vec3(weighted / mass) : 0.5f * (lo + hi);
+        }
+    };
+
+    struct Run
+    {
+        size_t begin;
+        size_t end;
+    };
+
+    struct Monopole
+    {
+        glm::vec3 position;
+        float mass;
+    };
+
+    ChunkFileSet sets[2];
+    unsigned int current = 0;
+    ChunkReadAhead readAhead;
+    glm::dvec3 origin = glm::dvec3(0.0);        // centre of the key grid, the trees' positions are relative to it
+    double halfSize = 1.0;
+    std::vector<Bucket> buckets;
+    std::vector<TopNode> nodes;
+    std::vector<unsigned int> groups;           // target groups, as top-tree nodes in Z-order
+    std::vector<Run> near[2];                   // the current group's interaction lists and the next one's
+    std::vector<Monopole> far[2];
+    std::vector<glm::vec3> localPositions;
+    std::vector<float> localMasses;
+    BarnesHutTree localTree;
+    StepStats stats;
+    std::string failure;
+
+    unsigned int slices() const
+    {
+        return std::max(1u, std::min(threads == 0 ? workerPool().size() : threads, workerPool().size()));
+    }
+
+    glm::vec3 relative(const glm::dvec3& p) const
+    {
+        return glm::vec3(p - origin);
+    }
+
+    uint32_t keyOf(const glm::dvec3& p) const
+    {
+        const glm::dvec3 q = (p - origin + halfSize) * (1024.0 / (2.0 * halfSize));
+        auto cell = [](double v) { return static_cast<uint32_t>(std::min(1023.0, std::max(0.0, v))); };
+        return mortonKey(cell(q.x), cell(q.y), cell(q.z));
+    }
+
+    // External bucket sort into the spare set: the grid is fitted to the bodies, a counting pass over the current
+    // set sizes the buckets, a scatter pass writes each body at its bucket's next slot, and each bucket, which fits
+    // in memory unless the bodies crowd into a few of 2^18 cells, is sorted by its full key in place.
+    void resort()
+    {
+        PROFILE_SCOPE("OutOfCoreNBody::resort");
+        const auto start = std::chrono::steady_clock::now();
+        readAhead.cancel();
+        const ChunkFileSet& from = sets[current];
+        const ChunkFileSet& to = sets[1 - current];
+        const size_t n = from.size();
+        const unsigned int sliceCount = static_cast<unsigned int>(std::max<size_t>(1, std::min<size_t>(std::min(slices(), 16u), n / 4096 + 1)));
+        const size_t sliceBodies = (n + sliceCount - 1) / sliceCount;
+        from.sequential(true);
+
+        std::vector<glm::dvec3> lo(sliceCount, glm::dvec3(INFINITY)), hi(sliceCount, glm::dvec3(-INFINITY));
+        workerPool().parallelFor(0, sliceCount, [&](size_t sBegin, size_t sEnd, unsigned int) {
+            for (size_t s = sBegin; s < sEnd; s++)
+                from.forEachSegment(s * sliceBodies, (s + 1) * sliceBodies, [&](const ChunkFileSet::Chunk& c, size_t b, size_t e, size_t) {
+                    for (size_t i = b; i < e; i++)
+                    {
+                        lo[s] = glm::min(lo[s], c.position[i]);
+                        hi[s] = glm::max(hi[s], c.position[i]);
+                    }
+                });
+        }, sliceCount);
+        glm::dvec3 boundsLo = lo[0], boundsHi = hi[0];
+        for (unsigned int s = 1; s < sliceCount; s++)
+        {
+            boundsLo = glm::min(boundsLo, lo[s]);
+            boundsHi = glm::max(boundsHi, hi[s]);
+        }
+        origin = 0.5 * (boundsLo + boundsHi);
+        const glm::dvec3 extent = boundsHi - boundsLo;
+        halfSize = std::max(0.5 * std::max(extent.x, std::max(extent.y, extent.z)) * 1.001, 1e-3);
+
+        // counts per slice, then offsets digit-major so equal buckets keep their slice order
+        std::vector<uint32_t> histograms(static_cast<size_t>(sliceCount) * BUCKETS, 0);
+        workerPool().parallelFor(0, sliceCount, [&](size_t sBegin, size_t sEnd, unsigned int) {
+            for (size_t s = sBegin; s < sEnd; s++)
+            {
+                uint32_t* h = &histograms[s * BUCKETS];
+                from.forEachSegment(s * sliceBodies, (s + 1) * sliceBodies, [&](const ChunkFileSet::Chunk& c, size_t b, size_t e, size_t) {
+                    for (size_t i = b; i < e; i++)
+                        h[keyOf(c.position[i]) >> BUCKET_SHIFT]++;
+                });
+            }
+        }, sliceCount);
+        buckets.clear();
+        uint32_t running = 0;
+        for (uint32_t d = 0; d < BUCKETS; d++)
+        {
+            const uint32_t bucketBegin = running;
+            for (unsigned int s = 0; s < sliceCount; s++)
+            {
+                const uint32_t count = histograms[s * BUCKETS + d];
+                histograms[s * BUCKETS + d] = running;
+                running += count;
+            }
+            if (running > bucketBegin)
+                buckets.push_back(Bucket{d, bucketBegin, running, glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f), 0.0f});
+        }
+
+        workerPool().parallelFor(0, sliceCount, [&](size_t sBegin, size_t sEnd, unsigned int) {
+            for (size_t s = sBegin; s < sEnd; s++)
+            {
+                uint32_t* offset = &histograms[s * BUCKETS];
+                for (size_t i = s * sliceBodies; i < std::min(n, (s + 1) * sliceBodies); i++)
+                {
+                    const ChunkBody body = from.load(i);
+                    to.store(offset[keyOf(body.position) >> BUCKET_SHIFT]++, body);
+                }
+                from.flush(s * sliceBodies, (s + 1) * sliceBodies, CHUNK_ALL);
+            }
+        }, sliceCount);
+        from.sequential(false);
+        std::vector<uint32_t>().swap(histograms);
+
+        workerPool().parallelFor(0, buckets.size(), [&](size_t bBegin, size_t bEnd, unsigned int) {
+            std::vector<ChunkBody> scratch;
+            std::vector<std::pair<uint32_t, uint32_t>> keys;
+            for (size_t b = bBegin; b < bEnd; b++)
+            {
+                Bucket& bucket = buckets[b];
+                const size_t count = bucket.end - bucket.begin;
+                scratch.resize(count);
+                keys.resize(count);
+                for (size_t k = 0; k < count; k++)
+                {
+                    scratch[k] = to.load(bucket.begin + k);
+                    keys[k] = std::make_pair(keyOf(scratch[k].position), static_cast<uint32_t>(k));
+                }
+                std::sort(keys.begin(), keys.end());
+                Summary summary;
+                for (size_t k = 0; k < count; k++)
+                {
+                    const ChunkBody& body = scratch[keys[k].second];
+                    to.store(bucket.begin + k, body);
+                    summary.add(relative(body.position), body.mass);
+                }
+                summary.writeTo(bucket);
+                to.flush(bucket.begin, bucket.end, CHUNK_ALL);
+            }
+        }, threads);
+
+        current = 1 - current;
+        buildTopTree();
+        summarizeTopTree();
+        stats.sortSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void buildTopTree()
+    {
+        nodes.clear();
+        groups.clear();
+        if (buckets.empty())
+            return;
+        nodes.push_back(TopNode());
+        buildTopNode(0, 0, buckets.size(), 0);
+        collectGroups(0);
+    }
+
+    void buildTopNode(size_t index, size_t first, size_t last, unsigned int level)
+    {
+        TopNode& node = nodes[index];
+        node.begin = buckets[first].begin;
+        node.end = buckets[last - 1].end;
+        node.firstChild = -1;
+        node.childCount = 0;
+        node.bucket = -1;
+        if (level == TOP_LEVELS)
+        {
+            node.bucket = static_cast<int>(first);
+            return;
+        }
+        const unsigned int shift = 3 * (TOP_LEVELS - level - 1);
+        size_t splits[9];
+        unsigned int childCount = 0;
+        for (size_t b = first; b < last; b++)
+            if (b == first || ((buckets[b].key >> shift) & 7) != ((buckets[b - 1].key >> shift) & 7))
+                splits[childCount++] = b;
+        splits[childCount] = last;
+        const size_t firstChild = nodes.size();
+        nodes[index].firstChild = static_cast<int>(firstChild);
+        nodes[index].childCount = childCount;
+        nodes.resize(nodes.size() + childCount);
+        for (unsigned int c = 0; c < childCount; c++)
+            buildTopNode(firstChild + c, splits[c], splits[c + 1], level + 1);
+    }
+
+    void collectGroups(unsigned int index)
+    {
+        const TopNode& node = nodes[index];
+        if (node.bucket >= 0 || node.end - node.begin <= groupBodies)
+        {
+            groups.push_back(index);
+            return;
+        }
+        for (unsigned int c = 0; c < node.childCount; c++)
+            collectGroups(static_cast<unsigned int>(node.firstChild) + c);
+    }
+
+    // children come after their parent, so a reverse pass sees every child before it is summed
+    void summarizeTopTree()
+    {
+        for (size_t i = nodes.size(); i-- > 0;)
+        {
+            TopNode& node = nodes[i];
+            if (node.bucket >= 0)
+            {
+                const Bucket& bucket = buckets[node.bucket];
+                node.lo = bucket.lo;
+                node.hi = bucket.hi;
+                node.centerOfMass = bucket.centerOfMass;
+                node.mass = bucket.mass;
+                continue;
+            }
+            node.lo = glm::vec3(INFINITY);
+            node.hi = glm::vec3(-INFINITY);
+            glm::dvec3 weighted(0.0);
+            double mass = 0.0;
+            for (unsigned int c = 0; c < node.childCount; c++)
+            {
+                const TopNode& child = nodes[node.firstChild + c];
+                node.lo = glm::min(node.lo, child.lo);
+                node.hi = glm::max(node.hi, child.hi);
+                weighted += glm::dvec3(child.centerOfMass) * static_cast<double>(child.mass);
+                mass += child.mass;
+            }
+            node.mass = static_cast<float>(mass);
+            node.centerOfMass = mass > 0.0 ? glm::vec3(weighted / mass) : 0.5f * (node.lo + node.hi);
+        }
+    }
+
+    // the first half kick and the drift, one pass over the files in order, summing the buckets' new summaries;
+    // slices cut buckets at their ends, those pieces are merged after the pass
+    void kickDrift(float dt)
+    {
+        PROFILE_SCOPE("OutOfCoreNBody::kickDrift");
+        const auto start = std::chrono::steady_clock::now();
+        const ChunkFileSet& set = sets[current];
+        const double h = static_cast<double>(dt), halfDt = 0.5 * h;
+        const unsigned int sliceCount = slices();
+        std::vector<std::vector<std::pair<size_t, Summary>>> pieces(sliceCount);
+        set.sequential(true);
+        workerPool().parallelFor(0, set.size(), [&](size_t begin, size_t end, unsigned int slice) {
+            size_t b = static_cast<size_t>(std::upper_bound(buckets.begin(), buckets.end(), begin,
+                [](size_t i, const Bucket& bucket) { return i < bucket.end; }) - buckets.begin());
+            for (; b < buckets.size() && buckets[b].begin < end; b++)
+            {
+                Bucket& bucket = buckets[b];
+                const size_t first = std::max(begin, bucket.begin), last = std::min(end, bucket.end);
+                Summary summary;
+                set.forEachSegment(first, last, [&](const ChunkFileSet::Chunk& c, size_t sb, size_t se, size_t) {
+                    for (size_t s = sb; s < se; s++)
+                    {
+                        if (!(c.flags[s] & BODY_FLAG_STATIC))
+                        {
+                            c.velocity[s] += glm::dvec3(c.acceleration[s]) * halfDt;
+                            c.position[s] += c.velocity[s] * h;
+                        }
+                        summary.add(relative(c.position[s]), c.mass[s]);
+                    }
+                });
+                if (first == bucket.begin && last == bucket.end)
+                    summary.writeTo(bucket);
+                else
+                    pieces[slice].push_back(std::make_pair(b, summary));
+            }
+            set.flush(begin, end, CHUNK_POSITION | CHUNK_VELOCITY);
+        }, sliceCount);
+        set.sequential(false);
+
+        std::vector<std::pair<size_t, Summary>> merged;
+        for (const std::vector<std::pair<size_t, Summary>>& slicePieces : pieces)
+            for (const std::pair<size_t, Summary>& piece : slicePieces)
+            {
+                if (!merged.empty() && merged.back().first == piece.first)
+                    merged.back().second.merge(piece.second);
+                else
+                    merged.push_back(piece);
+            }
+        for (const std::pair<size_t, Summary>& piece : merged)
+            piece.second.writeTo(buckets[piece.first]);
+        summarizeTopTree();
+        stats.driftSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // a walk of the top tree for target group node: monopoles of the nodes its box accepts into farList, the runs
+    // of the buckets it opens outside the group into nearList, adjacent runs joined
+    void interactionLists(unsigned int group, std::vector<Run>& nearList, std::vector<Monopole>& farList) const
+    {
+        nearList.clear();
+        farList.clear();
+        const TopNode& target = nodes[group];
+        const float thetaSq = theta * theta;
+        std::vector<unsigned int> stack(1, 0);
+        while (!stack.empty())
+        {
+            const TopNode& node = nodes[stack.back()];
+            stack.pop_back();
+            const bool overlapsTarget = node.begin < target.end && target.begin < node.end;
+            if (node.mass <= 0.0f && !overlapsTarget)
+                continue;
+            if (!overlapsTarget)
+            {
+                const glm::vec3 extent = node.hi - node.lo;
+                const float size = std::max(extent.x, std::max(extent.y, extent.z));
+                const glm::vec3 d = node.centerOfMass - glm::clamp(node.centerOfMass, target.lo, target.hi);
+                if (size * size < thetaSq * glm::dot(d, d))
+                {
+                    farList.push_back(Monopole{node.centerOfMass, node.mass});
+                    continue;
+                }
+            }
+            if (node.bucket >= 0)
+            {
+                if (overlapsTarget)
+                    continue;
+                if (!nearList.empty() && nearList.back().end == node.begin)
+                    nearList.back().end = node.end;
+                else
+                    nearList.push_back(Run{node.begin, node.end});
+                continue;
+            }
+            // pushed in reverse so children pop in Z-order and their runs come out ascending
+            for (unsigned int c = node.childCount; c-- > 0;)
+                stack.push_back(static_cast<unsigned int>(node.firstChild) + c);
+        }
+    }
+
+    void requestReadAhead(unsigned int group, const std::vector<Run>& nearList)
+    {
+        const ChunkFileSet& set = sets[current];
+        readAhead.request(set, nodes[group].begin, nodes[group].end, CHUNK_ALL);
+        for (const Run& run : nearList)
+            readAhead.request(set, run.begin, run.end, CHUNK_POSITION | CHUNK_MASS);
+    }
+
+    void gather(size_t begin, size_t end)
+    {
+        sets[current].forEachSegment(begin, end, [&](const ChunkFileSet::Chunk& c, size_t sb, size_t se, size_t) {
+            for (size_t s = sb; s < se; s++)
+            {
+                localPositions.push_back(relative(c.position[s]));
+                localMasses.push_back(c.mass[s]);
+            }
+        });
+    }
+
+    // the accelerations of every body, group by group, and the closing half kick of halfDt
+    void computeForces(double halfDt)
+    {
+        PROFILE_SCOPE("OutOfCoreNBody::computeForces");
+        const auto start = std::chrono::steady_clock::now();
+        const ChunkFileSet& set = sets[current];
+        const unsigned int sliceCount = slices();
+        std::vector<unsigned long long> terms(sliceCount, 0);
+        if (!groups.empty())
+            interactionLists(groups[0], near[0], far[0]);
+        for (size_t g = 0; g < groups.size(); g++)
+        {
+            std::vector<Run>& nearList = near[g & 1];
+            const std::vector<Monopole>& farList = far[g & 1];
+            if (g + 1 < groups.size())
+            {
+                interactionLists(groups[g + 1], near[(g + 1) & 1], far[(g + 1) & 1]);
+                requestReadAhead(groups[g + 1], near[(g + 1) & 1]);
+            }
+
+            // the group first, so target k is local body k
+            const TopNode& target = nodes[groups[g]];
+            localPositions.clear();
+            localMasses.clear();
+            gather(target.begin, target.end);
+            for (const Run& run : nearList)
+                gather(run.begin, run.end);
+            localTree.build(localPositions.data(), localMasses.data(), localPositions.size());
+            stats.nearBodies += localPositions.size() - (target.end - target.begin);
+            stats.farNodes += farList.size();
+
+            workerPool().parallelFor(target.begin, target.end, [&](size_t begin, size_t end, unsigned int slice) {
+                unsigned long long count = 0;
+                set.forEachSegment(begin, end, [&](const ChunkFileSet::Chunk& c, size_t sb, size_t se, size_t firstBody) {
+                    for (size_t s = sb; s < se; s++)
+                    {
+                        const size_t k = firstBody + (s - sb) - target.begin;
+                        const glm::vec3 p = localPositions[k];
+                        glm::vec3 a = localTree.accelerationAt(p, theta, epsilonSq, &count);
+                        for (const Monopole& m : farList)
+                            a += BarnesHutTree::pairAcceleration(p, m.position, m.mass, epsilonSq);
+                        count += farList.size();
+                        a *= G;
+                        c.acceleration[s] = a;
+                        if (!(c.flags[s] & BODY_FLAG_STATIC))
+                            c.velocity[s] += glm::dvec3(a) * halfDt;
+                    }
+                });
+                terms[slice] += count;
+            }, sliceCount);
+            set.flush(target.begin, target.end, CHUNK_VELOCITY | CHUNK_ACCELERATION);
+        }
+        for (unsigned long long t : terms)
+            stats.interactions += t;
+        stats.groups = groups.size();
+        stats.forceSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+#endif
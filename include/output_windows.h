@@ -0,0 +1,144 @@
+#ifndef OUTPUT_WINDOWS_H
+#define OUTPUT_WINDOWS_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm.hpp>
+
+#include <string>
+#include <vector>
+
+// Further windows beside the main one, a wall of projectors driven from one process. Every window's context shares
+// the main one's objects, so the models, the textures, the buffers and the physics exist once. The scene is drawn
+// once as well, the panels side by side in the scene target through one frustum as wide as the wall, and culled
+// once against it; each window then blits its panel of the finished frame into its own framebuffer. Framebuffers
+// and vertex arrays are not shared between contexts, so every window keeps a read framebuffer of its own around
+// the shared texture. The main window's swap keeps the pace, the others swap without waiting for the vblank.
+class OutputWindows
+{
+public:
+    OutputWindows() = default;
+    OutputWindows(const OutputWindows&) = delete;
+    OutputWindows& operator=(const OutputWindows&) = delete;
+
+    ~OutputWindows()
+    {
+        close();
+    }
+
+    // count windows sharing main's context, fullscreen on the monitors after the primary where there are any,
+    // otherwise width x height; false when one could not be made, those before it stay open
+    bool open(GLFWwindow* main, unsigned int count, int width, int height)
+    {
+        mainWindow = main;
+        int monitorCount = 0;
+        GLFWmonitor** monitors = glfwGetMonitors(&monitorCount);
+        bool opened = true;
+        for (unsigned int i = 0; i < count && opened; i++)
+        {
+            GLFWmonitor* monitor = static_cast<int>(i) + 1 < monitorCount ? monitors[i + 1] : nullptr;
+            int w = width, h = height;
+            if (monitor)
+            {
+                const GLFWvidmode* mode = glfwGetVideoMode(monitor);
+                w = mode->width;
+                h = mode->height;
+            }
+            const std::string title = "Solar System Sim - output " + std::to_string(i + 1);
+            Output output;
+            output.window = glfwCreateWindow(w, h, title.c_str(), monitor, main);
+            opened = output.window != nullptr;
+            if (!opened)
+                break;
+            glfwMakeContextCurrent(output.window);
+            glfwSwapInterval(0);
+            glCreateFramebuffers(1, &output.readFbo);
+            outputs.push_back(output);
+        }
+        glfwMakeContextCurrent(main);
+        return opened;
+    }
+
+    // the panels across the scene target, the main window's among them
+    unsigned int panels() const { return static_cast<unsigned int>(outputs.size()) + 1; }
+    // the main window's, the middle one or the one left of the middle
+    unsigned int mainPanel() const { return (panels() - 1) / 2; }
+    // panel p's part of the target for SceneTarget::present, offset and size as fractions
+    glm::vec4 region(unsigned int p) const { return glm::vec4(static_cast<float>(p) / panels(), 0.0f, 1.0f / panels(), 1.0f); }
+
+    // closes the windows their users closed, the wall narrows by as many panels
+    void poll()
+    {
+        bool closed = false;
+        for (size_t o = 0; o < outputs.size();)
+        {
+            if (!glfwWindowShouldClose(outputs[o].window)) { o++; continue; }
+            destroy(outputs[o]);
+            outputs.erase(outputs.begin() + static_cast<std::ptrdiff_t>(o));
+            closed = true;
+        }
+        if (closed)
+            glfwMakeContextCurrent(mainWindow);
+    }
+
+    // shows every window its panel of texture, the finished frame of width x height; the main context is current
+    // before and after
+    void present(unsigned int texture, int width, int height)
+    {
+        if (outputs.empty() || texture == 0)
+            return;
+        // the other contexts wait on the GPU for the frame, the fence has to be flushed for them to see it
+        GLsync finished = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+        const float panelWidth = static_cast<float>(width) / panels();
+        for (size_t o = 0; o < outputs.size(); o++)
+        {
+            const Output& output = outputs[o];
+            const unsigned int p = static_cast<unsigned int>(o) < mainPanel() ? static_cast<unsigned int>(o) : static_cast<unsigned int>(o) + 1;
+            glfwMakeContextCurrent(output.window);
+            glWaitSync(finished, 0, GL_TIMEOUT_IGNORED);
+            // attached every frame, a resize may have put a new texture under the same name
+            glNamedFramebufferTexture(output.readFbo, GL_COLOR_ATTACHMENT0, texture, 0);
+            int w = 0, h = 0;
+            glfwGetFramebufferSize(output.window, &w, &h);
+            if (w > 0 && h > 0)
+                glBlitNamedFramebuffer(output.readFbo, 0, static_cast<int>(p * panelWidth + 0.5f), 0, static_cast<int>((p + 1) * panelWidth + 0.5f), height,
+                                       0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+            glfwSwapBuffers(output.window);
+        }
+        glfwMakeContextCurrent(mainWindow);
+        glDeleteSync(finished);
+    }
+
+    void close()
+    {
+        if (outputs.empty())
+            return;
+        for (Output& output : outputs)
+            destroy(output);
+        outputs.clear();
+        glfwMakeContextCurrent(mainWindow);
+    }
+
+private:
+    struct Output
+    {
+        GLFWwindow* window = nullptr;
+        unsigned int readFbo = 0;       // of the window's own context
+    };
+
+    GLFWwindow* mainWindow = nullptr;
+    std::vector<Output> outputs;
+
+    static void destroy(Output& output)
+    {
+        glfwMakeContextCurrent(output.window);
+        if (output.readFbo != 0) glDeleteFramebuffers(1, &output.readFbo);
+        glfwMakeContextCurrent(nullptr);
+        glfwDestroyWindow(output.window);
+        output.window = nullptr;
+        output.readFbo = 0;
+    }
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef PARALLEL_SHADER_COMPILE_H
+#define PARALLEL_SHADER_COMPILE_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+
+// GL_KHR_parallel_shader_compile (or its ARB twin), loaded by hand like BindlessTextures. With it the driver
+// compiles and links on threads of its own and GL_COMPLETION_STATUS tells whether a shader or program is done
+// without waiting for it. Shader's deferred mode works without the extension too, the status queries then just
+// block where they would have anyway.
+class ParallelShaderCompile
+{
+public:
+    static const GLenum COMPLETION_STATUS = 0x91B1;     // GL_COMPLETION_STATUS_KHR and _ARB
+
+    // looks for the extension, call once after gladLoadGLLoader with the same loader. The driver is allowed as
+    // many compiler threads as it likes.
+    static bool load(GLADloadproc loader)
+    {
+        State& s = state();
+        s.available = false;
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        const char* entryPoint = nullptr;
+        for (GLint e = 0; e < count && !entryPoint; e++)
+        {
+            const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(e)));
+            if (name && std::strcmp(name, "GL_KHR_parallel_shader_compile") == 0)
+                entryPoint = "glMaxShaderCompilerThreadsKHR";
+            else if (name && std::strcmp(name, "GL_ARB_parallel_shader_compile") == 0)
+                entryPoint = "glMaxShaderCompilerThreadsARB";
+        }
+        if (!entryPoint)
+            return false;
+        MaxShaderCompilerThreads maxThreads = reinterpret_cast<MaxShaderCompilerThreads>(loader(entryPoint));
+        if (!maxThreads)
+            return false;
+        maxThreads(0xFFFFFFFFu);     // implementation-chosen
+        s.available = true;
+        return true;
+    }
+
+    static bool available() { return state().available; }
+
+    // whether the driver is done with a program, true without the extension (asking would block)
+    static bool programDone(GLuint program)
+    {
+        if (!available())
+            return true;
+        GLint done = 0;
+        glGetProgramiv(program, COMPLETION_STATUS, &done);
+        return done != 0;
+    }
+
+private:
+    typedef void (APIENTRYP MaxShaderCompilerThreads)(GLuint count);
+
+    struct State
+    {
+        bool available = false;
+    };
+
+    static State& state()
+    {
+        static State s;
+        return s;
+    }
+};
+
+#endif
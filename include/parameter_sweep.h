@@ -0,0 +1,152 @@
+#ifndef PARAMETER_SWEEP_H
+#define PARAMETER_SWEEP_H
+
+#include <physics_world.h>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+
+// A parameter sweep: the cartesian product of a few scenario and physics parameters, each given as a list of
+// values. The spec is a text file with one parameter per line, '#' starts a comment:
+//
+//     sunMass = 10000, 20000, 40000
+//     planetOrbitRadius = 150:250:5        # linspace, 5 values from 150 to 250
+//     G = 1000
+//
+// Runs are numbered so the last parameter varies fastest, point(run) gives the values of one run.
+
+// the parameters a sweep can vary, names as in ScenarioConfig and PhysicsWorld
+inline bool applySweepParameter(const std::string& name, double value, ScenarioConfig& scenario, PhysicsSettings& settings)
+{
+    const float f = static_cast<float>(value);
+    if (name == "sunMass") scenario.sunMass = f;
+    else if (name == "planetMass") scenario.planetMass = f;
+    else if (name == "planetOrbitRadius") scenario.planetOrbitRadius = f;
+    else if (name == "planetInitialAngle") scenario.planetInitialAngle = f;
+    else if (name == "asteroidAmount") scenario.asteroidAmount = static_cast<unsigned int>(std::max(value, 0.0));
+    else if (name == "avgAsteroidMass") scenario.avgAsteroidMass = f;
+    else if (name == "asteroidBeltInnerRadius") scenario.asteroidBeltInnerRadius = f;
+    else if (name == "asteroidBeltOuterRadius") scenario.asteroidBeltOuterRadius = f;
+    else if (name == "asteroidBeltHeight") scenario.asteroidBeltHeight = f;
+    else if (name == "seed") scenario.seed = static_cast<unsigned int>(std::max(value, 0.0));
+    else if (name == "G") settings.G = f;
+    else if (name == "epsilonSq") settings.epsilonSq = f;
+    else if (name == "theta") settings.theta = f;
+    else return false;
+    return true;
+}
+
+struct SweepAxis
+{
+    std::string name;
+    std::vector<double> values;
+};
+
+class SweepSpec
+{
+public:
+    std::vector<SweepAxis> axes;
+
+    size_t runCount() const
+    {
+        size_t n = 1;
+        for (const SweepAxis& a : axes) n *= a.values.size();
+        return n;
+    }
+
+    // the value of every axis for one run, in axis order
+    void point(size_t run, std::vector<double>& values) const
+    {
+        values.resize(axes.size());
+        for (size_t k = axes.size(); k-- > 0;)
+        {
+            const size_t count = axes[k].values.size();
+            values[k] = axes[k].values[run % count];
+            run /= count;
+        }
+    }
+
+    // false with a message naming the line on a syntax error or an unknown parameter
+    bool load(const char* path, std::string& error)
+    {
+        std::ifstream in(path);
+        if (!in)
+        {
+            error = std::string("cannot open ") + path;
+            return false;
+        }
+        axes.clear();
+        std::string line;
+        for (unsigned int number = 1; std::getline(in, line); number++)
+        {
+            line = line.substr(0, line.find('#'));
+            if (line.find_first_not_of(" \t\r") == std::string::npos)
+                continue;
+            size_t eq = line.find('=');
+            SweepAxis axis;
+            axis.name = trim(line.substr(0, eq));
+            ScenarioConfig scenario;
+            PhysicsSettings settings{};
+            if (eq == std::string::npos || !applySweepParameter(axis.name, 0.0, scenario, settings) ||
+                !parseValues(line.substr(eq + 1), axis.values))
+            {
+                error = std::string(path) + ":" + std::to_string(number) + ": cannot parse '" + trim(line) + "'";
+                return false;
+            }
+            axes.push_back(axis);
+        }
+        return true;
+    }
+
+private:
+    static std::string trim(const std::string& s)
+    {
+        size_t b = s.find_first_not_of(" \t\r"), e = s.find_last_not_of(" \t\r");
+        return b == std::string::npos ? std::string() : s.substr(b, e - b + 1);
+    }
+
+    static bool parseNumber(const std::string& s, double& out)
+    {
+        std::string t = trim(s);
+        char* end = nullptr;
+        out = std::strtod(t.c_str(), &end);
+        return !t.empty() && end == t.c_str() + t.size();
+    }
+
+    // "a, b, c" or "start:stop:count"
+    static bool parseValues(const std::string& text, std::vector<double>& values)
+    {
+        values.clear();
+        size_t c1 = text.find(':');
+        if (c1 != std::string::npos)
+        {
+            size_t c2 = text.find(':', c1 + 1);
+            double start, stop, count;
+            if (c2 == std::string::npos || !parseNumber(text.substr(0, c1), start) ||
+                !parseNumber(text.substr(c1 + 1, c2 - c1 - 1), stop) || !parseNumber(text.substr(c2 + 1), count) ||
+                count < 1.0 || count != std::floor(count))
+                return false;
+            const size_t n = static_cast<size_t>(count);
+            for (size_t k = 0; k < n; k++)
+                values.push_back(n > 1 ? start + (stop - start) * static_cast<double>(k) / (n - 1) : start);
+            return true;
+        }
+        std::stringstream list(text);
+        std::string item;
+        while (std::getline(list, item, ','))
+        {
+            double v;
+            if (!parseNumber(item, v))
+                return false;
+            values.push_back(v);
+        }
+        return !values.empty();
+    }
+};
+
+#endif
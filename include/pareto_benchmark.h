@@ -0,0 +1,188 @@
+#ifndef PARETO_BENCHMARK_H
+#define PARETO_BENCHMARK_H
+
+#include <physics_world.h>
+#include <scenario_file.h>
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cmath>
+#include <algorithm>
+
+// Accuracy against cost of the solver and integrator combinations, to pick settings from data rather than by feel.
+// Every combination of paretoConfigs() runs every scenario of paretoScenarios() for the same steps of the same dt,
+// and is scored against a reference run of the same scenario: the direct sum with the scalar kernel and the
+// 4th-order Yoshida integrator at a PARETO_REFERENCE_SUBSTEPS times smaller step. A run's errors are how far its energy and
+// momentum drifted from their start and the RMS distance of its final positions from the reference's (by body id),
+// over the RMS spread of the reference about its centre of mass. markParetoFront() flags the runs no other run of
+// the scenario beats at once on time per step and on positional error.
+//
+// Every solver sums asteroid-asteroid gravity here, the direct ones included, so all of them and the reference
+// integrate the same forces. The Keplerian mode only differs where there is a belt about a sun, it runs there only.
+
+static const unsigned int PARETO_REFERENCE_SUBSTEPS = 4;
+
+// one solver and integrator combination
+struct ParetoConfig
+{
+    std::string label;
+    int solver = SOLVER_BRUTE_FORCE;
+    float theta = 0.5f;
+    IntegratorType integrator = INTEGRATOR_LEAPFROG_KDK;
+    bool kepler = false;
+    bool needsBelt = false;     // skipped where the scenario has no asteroids about a sun
+
+    void apply(PhysicsSettings& settings) const
+    {
+        settings.solver = solver;
+        settings.theta = theta;
+        settings.integrator = integrator;
+        settings.keplerAsteroids = kepler;
+        settings.asteroidSelfGravity = true;
+        // nothing on top of the solver and integrator being compared
+        settings.blockTimesteps = false;
+        settings.closeEncounters = false;
+        settings.beltSectors = false;
+        settings.collisions = false;
+        settings.diagnosticsInterval = 0;
+        settings.validateForceKernel = false;
+        settings.fmmValidationSample = 0;
+    }
+};
+
+// brute force, Barnes-Hut at three opening angles, FMM and PM, each with Euler, leapfrog and Yoshida; Kepler once
+inline std::vector<ParetoConfig> paretoConfigs()
+{
+    struct Solver { const char* name; int solver; float theta; };
+    static const Solver solvers[] = {
+        {"brute", SOLVER_BRUTE_FORCE, 0.5f},
+        {"barnes-hut 0.3", SOLVER_BARNES_HUT, 0.3f},
+        {"barnes-hut 0.5", SOLVER_BARNES_HUT, 0.5f},
+        {"barnes-hut 0.8", SOLVER_BARNES_HUT, 0.8f},
+        {"fmm", SOLVER_FMM, 0.5f},
+        {"pm", SOLVER_PARTICLE_MESH, 0.5f},
+    };
+    struct Scheme { const char* name; IntegratorType type; };
+    static const Scheme schemes[] = {
+        {"euler", INTEGRATOR_SEMI_IMPLICIT_EULER},
+        {"leapfrog", INTEGRATOR_LEAPFROG_KDK},
+        {"yoshida4", INTEGRATOR_YOSHIDA4},
+    };
+    std::vector<ParetoConfig> configs;
+    for (const Solver& s : solvers)
+        for (const Scheme& i : schemes)
+        {
+            ParetoConfig c;
+            c.label = std::string(s.name) + " / " + i.name;
+            c.solver = s.solver;
+            c.theta = s.theta;
+            c.integrator = i.type;
+            configs.push_back(c);
+        }
+    ParetoConfig kepler;
+    kepler.label = "kepler / leapfrog";
+    kepler.kepler = true;
+    kepler.needsBelt = true;
+    configs.push_back(kepler);
+    return configs;
+}
+
+struct ParetoScenario
+{
+    std::string name;
+    bool hasBelt = false;
+    std::function<void(PhysicsWorld&)> build;   // replaces the world's bodies, its settings already applied
+};
+
+// a lone planet about the sun, the sun and planet with a belt of bodies asteroids, and a Plummer cluster of bodies
+// equal masses about a unit total mass with nothing at its centre
+inline std::vector<ParetoScenario> paretoScenarios(unsigned int bodies, unsigned int seed)
+{
+    std::vector<ParetoScenario> scenarios;
+    ScenarioConfig twoBody;
+    twoBody.seed = seed;
+    scenarios.push_back({"two-body", false, [twoBody](PhysicsWorld& world) { world.initialize(twoBody); }});
+
+    ScenarioConfig belt = twoBody;
+    belt.asteroidAmount = bodies;
+    scenarios.push_back({"sun+planet+belt", true, [belt](PhysicsWorld& world) { world.initialize(belt); }});
+
+    ScenarioFile cluster;
+    cluster.seed = seed;
+    cluster.softening = 0.5f;
+    ScenarioGenerator plummer;
+    plummer.kind = GENERATOR_CLUSTER;
+    plummer.count = bodies;
+    plummer.mass = 1.0f / static_cast<float>(std::max(bodies, 1u));
+    plummer.scaleLength = 10.0f;
+    plummer.outer = 100.0f;
+    cluster.generators.push_back(plummer);
+    scenarios.push_back({"plummer", false, [cluster](PhysicsWorld& world) { world.initializeScenario(cluster); }});
+    return scenarios;
+}
+
+struct ParetoResult
+{
+    std::string scenario;
+    std::string config;
+    size_t bodies = 0;
+    double secondsPerStep = 0.0;
+    double energyError = 0.0;       // |relative drift| of the total energy
+    double momentumError = 0.0;     // drift of the linear momentum, relative where it is not zero
+    double positionError = 0.0;     // RMS distance from the reference over the reference's RMS spread
+    bool front = false;
+};
+
+// RMS distance of run's bodies from the same ids in reference, over the RMS distance of reference's from their
+// centre of mass; bodies missing from either are left out
+inline double paretoPositionError(const BodyStore& run, const BodyStore& reference)
+{
+    glm::dvec3 centre(0.0);
+    double mass = 0.0;
+    for (size_t i = 0; i < reference.size(); i++)
+    {
+        centre += static_cast<double>(reference.mass[i]) * reference.position[i];
+        mass += reference.mass[i];
+    }
+    if (mass > 0.0) centre /= mass;
+    double error = 0.0, spread = 0.0;
+    size_t matched = 0;
+    for (size_t i = 0; i < reference.size(); i++)
+    {
+        const uint32_t k = run.indexOf(reference.id[i]);
+        if (k == BodyStore::INVALID_INDEX)
+            continue;
+        const glm::dvec3 d = run.position[k] - reference.position[i], r = reference.position[i] - centre;
+        error += glm::dot(d, d);
+        spread += glm::dot(r, r);
+        matched++;
+    }
+    if (matched == 0)
+        return 0.0;
+    return spread > 0.0 ? std::sqrt(error / spread) : std::sqrt(error / static_cast<double>(matched));
+}
+
+// flags, within each scenario, the results no other result is at least as good as on both time and positional
+// error while better on one
+inline void markParetoFront(std::vector<ParetoResult>& results)
+{
+    for (ParetoResult& r : results)
+    {
+        r.front = true;
+        for (const ParetoResult& o : results)
+        {
+            if (&o == &r || o.scenario != r.scenario)
+                continue;
+            const bool noWorse = o.secondsPerStep <= r.secondsPerStep && o.positionError <= r.positionError;
+            const bool better = o.secondsPerStep < r.secondsPerStep || o.positionError < r.positionError;
+            if (noWorse && better)
+            {
+                r.front = false;
+                break;
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,456 @@
+#ifndef PARTICLE_MESH_H
+#define PARTICLE_MESH_H
+
+#include <glm.hpp>
+
+#include <spatial_hash.h>
+#include <thread_pool.h>
+
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+// Particle-mesh gravity, O(N + G^3 log G) for G cells per side, built for dense and fairly uniform distributions
+// where a tree opens too many cells. Masses are spread onto a cube of G^3 nodes around the bodies with cloud-in-cell
+// weights, the potential is the convolution with a sampled 1/r done by FFT on a zero-padded (2G)^3 grid, so the
+// boundary is isolated rather than periodic, and the acceleration is its four-point gradient at the nodes,
+// interpolated back with the same weights. Only the nonzero octant is transformed going in and only the octant
+// that is read comes back, 7 of the 12 line passes a plain 3D transform takes.
+//
+// The mesh smooths everything below a few cells. With shortRange (P3M) the kernel is split at splitCells: the
+// mesh carries erf(r / 2r_s) / r and the pairs within cutoffSplits r_s, found with a spatial hash, add the rest
+// directly with the softened pair term, so close pairs see Newtonian gravity again. The grid covers the bounding
+// cube of the bodies, one far outlier coarsens it for everyone.
+class ParticleMesh
+{
+public:
+    static constexpr unsigned int MIN_GRID = 16;
+    static constexpr unsigned int MAX_GRID = 128;   // 256^3 complex floats, 128 MB, for the transform
+
+    unsigned int grid = 64;         // nodes per side, a power of two
+    bool shortRange = false;        // P3M pair correction
+    float splitCells = 1.25f;       // r_s of the split, in cells
+    float cutoffSplits = 4.5f;      // pairs within this many r_s, erfc(2.25) leaves 0.15% of the pair force
+
+    // last evaluation
+    float cellSize = 0.0f;
+    unsigned long long shortRangePairs = 0;
+
+    // the mesh's first node sits at origin, spacing cellSize, bodies land at least MARGIN nodes inside
+    glm::vec3 origin{0.0f};
+
+    // writes the acceleration (without G) of every body into accelerations, and its potential -sum m/r into
+    // potentials if given. Positions are floats relative to a nearby origin.
+    void evaluate(const glm::vec3* positions, const float* masses, size_t count, float epsilonSq,
+                  glm::vec3* accelerations, unsigned int maxThreads, unsigned long long* interactions = nullptr,
+                  float* potentials = nullptr)
+    {
+        shortRangePairs = 0;
+        if (count == 0)
+            return;
+        const unsigned int n = gridSize(grid);
+        if (n != size || shortRange != spectrumShortRange || splitCells != spectrumSplit)
+            prepare(n);
+        frame(positions, count);
+        deposit(positions, masses, count, maxThreads);
+        convolve(maxThreads);
+        gradient(maxThreads);
+        interpolate(positions, masses, count, accelerations, potentials, maxThreads);
+        if (shortRange)
+            addShortRange(positions, masses, count, epsilonSq, accelerations, potentials, maxThreads);
+        if (interactions)
+            *interactions += count + shortRangePairs;
+    }
+
+    // the grid size evaluate() runs at for a requested one
+    static unsigned int gridSize(unsigned int requested)
+    {
+        unsigned int n = MIN_GRID;
+        while (n < requested && n < MAX_GRID)
+            n *= 2;
+        return n;
+    }
+
+    // nodes kept clear between the bodies and the edge, for the weights and the gradient stencil
+    static constexpr unsigned int MARGIN = 3;
+
+    // the kernel in cell units, 1/r or the long-range erf(r / 2r_s) / r, at the wrapped offsets of the padded
+    // (2n)^3 grid, transformed and divided by (2n)^3. It is even, so the spectrum is real. The GPU variant
+    // (gpu_particle_mesh.h) uploads the same one.
+    static std::vector<float> kernelSpectrum(unsigned int n, bool longRangeOnly, float split, unsigned int maxThreads)
+    {
+        const unsigned int m = 2 * n;
+        const size_t total = static_cast<size_t>(m) * m * m;
+        std::vector<std::complex<float>> data(total);
+        workerPool().parallelFor(0, m, [&](size_t begin, size_t end, unsigned int) {
+            for (size_t z = begin; z < end; z++)
+                for (unsigned int y = 0; y < m; y++)
+                    for (unsigned int x = 0; x < m; x++)
+                    {
+                        const double dx = wrapped(x, n), dy = wrapped(y, n), dz = wrapped(static_cast<unsigned int>(z), n);
+                        data[(z * m + y) * m + x] = static_cast<float>(kernelAt(std::sqrt(dx * dx + dy * dy + dz * dz), longRangeOnly, split));
+                    }
+        }, maxThreads);
+        LineFft fft;
+        fft.init(m);
+        transformAxis(data, m, 0, m, m, false, fft, maxThreads);
+        transformAxis(data, m, 1, m, m, false, fft, maxThreads);
+        transformAxis(data, m, 2, m, m, false, fft, maxThreads);
+        std::vector<float> spectrum(total);
+        const float scale = 1.0f / static_cast<float>(total);
+        for (size_t k = 0; k < total; k++)
+            spectrum[k] = data[k].real() * scale;
+        return spectrum;
+    }
+
+    // g(r) in cell units; at r = 0 the mean of 1/r over a cell for the plain kernel
+    static double kernelAt(double r, bool longRangeOnly, float split)
+    {
+        if (longRangeOnly)
+            return r > 0.0 ? std::erf(r / (2.0 * split)) / r : 1.0 / (std::sqrt(3.14159265358979) * split);
+        return r > 0.0 ? 1.0 / r : 2.38;
+    }
+
+private:
+    // radix-2 transform of one line of m values
+    struct LineFft
+    {
+        unsigned int m = 0;
+        std::vector<std::complex<float>> twiddle;
+        std::vector<unsigned int> reversed;
+
+        void init(unsigned int size)
+        {
+            m = size;
+            unsigned int bits = 0;
+            while ((1u << bits) < m)
+                bits++;
+            reversed.resize(m);
+            for (unsigned int i = 0; i < m; i++)
+            {
+                unsigned int r = 0;
+                for (unsigned int b = 0; b < bits; b++)
+                    r |= ((i >> b) & 1u) << (bits - 1 - b);
+                reversed[i] = r;
+            }
+            twiddle.resize(m / 2);
+            for (unsigned int k = 0; k < m / 2; k++)
+            {
+                const double angle = -2.0 * 3.14159265358979 * k / m;
+                twiddle[k] = std::complex<float>(static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle)));
+            }
+        }
+
+        // in place and unnormalized, the inverse with conjugated twiddles
+        void run(std::complex<float>* line, bool inverse) const
+        {
+            for (unsigned int i = 0; i < m; i++)
+                if (i < reversed[i])
+                    std::swap(line[i], line[reversed[i]]);
+            for (unsigned int half = 1; half < m; half *= 2)
+            {
+                const unsigned int step = m / (2 * half);
+                for (unsigned int start = 0; start < m; start += 2 * half)
+                    for (unsigned int k = 0; k < half; k++)
+                    {
+                        // spelled out, std::complex's product checks for infinities
+                        const float wr = twiddle[k * step].real(), wi = inverse ? -twiddle[k * step].imag() : twiddle[k * step].imag();
+                        const std::complex<float> x = line[start + k + half];
+                        const std::complex<float> t(wr * x.real() - wi * x.imag(), wr * x.imag() + wi * x.real());
+                        line[start + k + half] = line[start + k] - t;
+                        line[start + k] += t;
+                    }
+            }
+        }
+    };
+
+    unsigned int size = 0;          // n of the prepared buffers
+    bool spectrumShortRange = false;
+    float spectrumSplit = 0.0f;
+    std::vector<float> spectrum;
+    std::vector<std::complex<float>> work;
+    std::vector<float> density;     // n^3 node masses, then the convolution
+    std::vector<glm::vec3> field;   // n^3 node accelerations in cell units
+    std::vector<unsigned int> slabStart;
+    std::vector<unsigned int> slabOrder;
+    SpatialHash pairs;
+    std::vector<unsigned long long> slicePairs;
+    LineFft fft;
+
+    static double wrapped(unsigned int i, unsigned int n) { return i < n ? static_cast<double>(i) : static_cast<double>(i) - 2.0 * n; }
+
+    void prepare(unsigned int n)
+    {
+        size = n;
+        spectrumShortRange = shortRange;
+        spectrumSplit = splitCells;
+        spectrum = kernelSpectrum(n, shortRange, splitCells, static_cast<unsigned int>(workerPool().size()));
+        const size_t m = 2 * n;
+        work.assign(m * m * m, std::complex<float>(0.0f));
+        density.assign(static_cast<size_t>(n) * n * n, 0.0f);
+        field.assign(density.size(), glm::vec3(0.0f));
+        fft.init(2 * n);
+    }
+
+    // the bounding cube of the bodies, MARGIN nodes clear of either edge
+    void frame(const glm::vec3* positions, size_t count)
+    {
+        glm::vec3 lo(positions[0]), hi(positions[0]);
+        for (size_t i = 1; i < count; i++)
+        {
+            lo = glm::min(lo, positions[i]);
+            hi = glm::max(hi, positions[i]);
+        }
+        const glm::vec3 extent = hi - lo;
+        const float side = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-3f));
+        cellSize = side / static_cast<float>(size - 1 - 2 * MARGIN - 1);
+        origin = 0.5f * (lo + hi) - 0.5f * cellSize * static_cast<float>(size - 1);
+    }
+
+    glm::vec3 gridCoordinate(const glm::vec3& p) const { return (p - origin) / cellSize; }
+
+    size_t node(int x, int y, int z) const { return (static_cast<size_t>(z) * size + y) * size + x; }
+
+    // cloud in cell onto density. Bodies are bucketed by the z of their lower node so that slabs two nodes thick
+    // can be filled in parallel, the even ones and then the odd ones, without two threads writing one node.
+    void deposit(const glm::vec3* positions, const float* masses, size_t count, unsigned int maxThreads)
+    {
+        std::fill(density.begin(), density.end(), 0.0f);
+        slabStart.assign(size + 1, 0);
+        for (size_t i = 0; i < count; i++)
+            slabStart[baseZ(positions[i]) + 1]++;
+        for (unsigned int z = 0; z < size; z++)
+            slabStart[z + 1] += slabStart[z];
+        slabOrder.resize(count);
+        std::vector<unsigned int> fill(slabStart.begin(), slabStart.end() - 1);
+        for (size_t i = 0; i < count; i++)
+            slabOrder[fill[baseZ(positions[i])]++] = static_cast<unsigned int>(i);
+
+        const unsigned int slabs = size / 2;
+        for (unsigned int parity = 0; parity < 2; parity++)
+        {
+            workerPool().parallelFor(0, slabs / 2, [&](size_t begin, size_t end, unsigned int) {
+                for (size_t s = begin; s < end; s++)
+                {
+                    const unsigned int slab = static_cast<unsigned int>(2 * s + parity);
+                    for (unsigned int k = slabStart[2 * slab]; k < slabStart[2 * slab + 2]; k++)
+                    {
+                        const unsigned int i = slabOrder[k];
+                        forEachWeight(positions[i], [&](size_t index, float w) { density[index] += w * masses[i]; });
+                    }
+                }
+            }, maxThreads);
+        }
+    }
+
+    unsigned int baseZ(const glm::vec3& p) const
+    {
+        return static_cast<unsigned int>(std::clamp(static_cast<int>(std::floor(gridCoordinate(p).z)), 0, static_cast<int>(size) - 2));
+    }
+
+    // fn(node index, weight) for the eight nodes around p
+    template <typename Fn>
+    void forEachWeight(const glm::vec3& p, const Fn& fn) const
+    {
+        const glm::vec3 u = gridCoordinate(p);
+        const int limit = static_cast<int>(size) - 2;
+        const int x = std::clamp(static_cast<int>(std::floor(u.x)), 0, limit);
+        const int y = std::clamp(static_cast<int>(std::floor(u.y)), 0, limit);
+        const int z = std::clamp(static_cast<int>(std::floor(u.z)), 0, limit);
+        const glm::vec3 f = glm::clamp(u - glm::vec3(x, y, z), 0.0f, 1.0f);
+        for (int k = 0; k < 8; k++)
+        {
+            const int dx = k & 1, dy = (k >> 1) & 1, dz = k >> 2;
+            const float w = (dx ? f.x : 1.0f - f.x) * (dy ? f.y : 1.0f - f.y) * (dz ? f.z : 1.0f - f.z);
+            fn(node(x + dx, y + dy, z + dz), w);
+        }
+    }
+
+    // density becomes sum m g(r) over the nodes
+    void convolve(unsigned int maxThreads)
+    {
+        const unsigned int n = size, m = 2 * size;
+        workerPool().parallelFor(0, m, [&](size_t begin, size_t end, unsigned int) {
+            for (size_t z = begin; z < end; z++)
+                for (unsigned int y = 0; y < m; y++)
+                {
+                    std::complex<float>* row = &work[(z * m + y) * m];
+                    if (z < n && y < n)
+                    {
+                        for (unsigned int x = 0; x < n; x++)
+                            row[x] = density[node(static_cast<int>(x), static_cast<int>(y), static_cast<int>(z))];
+                        std::fill(row + n, row + m, std::complex<float>(0.0f));
+                    }
+                    else
+                    {
+                        // the padding the forward passes read, the last inverse left results there
+                        std::fill(row, row + m, std::complex<float>(0.0f));
+                    }
+                }
+        }, maxThreads);
+        // forward: x where y, z < n, y where z < n, then every z line, each times the spectrum and back
+        transformAxis(work, m, 0, n, n, false, fft, maxThreads);
+        transformAxis(work, m, 1, m, n, false, fft, maxThreads);
+        transformAxis(work, m, 2, m, m, false, fft, maxThreads, &spectrum);
+        transformAxis(work, m, 1, m, n, true, fft, maxThreads);
+        transformAxis(work, m, 0, n, n, true, fft, maxThreads);
+        workerPool().parallelFor(0, n, [&](size_t begin, size_t end, unsigned int) {
+            for (size_t z = begin; z < end; z++)
+                for (unsigned int y = 0; y < n; y++)
+                    for (unsigned int x = 0; x < n; x++)
+                        density[node(static_cast<int>(x), static_cast<int>(y), static_cast<int>(z))] = work[(z * m + y) * m + x].real();
+        }, maxThreads);
+    }
+
+    // transforms the lines along axis (0 x, 1 y, 2 z) whose other two coordinates, in x, y, z order, are below
+    // firstLimit and secondLimit. With a spectrum each z line is multiplied by it and transformed back in place.
+    static void transformAxis(std::vector<std::complex<float>>& data, unsigned int m, int axis, unsigned int firstLimit,
+                              unsigned int secondLimit, bool inverse, const LineFft& fft, unsigned int maxThreads,
+                              const std::vector<float>* multiply = nullptr)
+    {
+        const size_t strides[3] = {1, m, static_cast<size_t>(m) * m};
+        const size_t stride = strides[axis];
+        const size_t firstStride = strides[axis == 0 ? 1 : 0];
+        const size_t secondStride = strides[axis == 2 ? 1 : 2];
+        // lines across x are gathered eight at a time, a cache line of neighbours per element
+        const unsigned int block = axis == 0 ? 1 : 8;
+        workerPool().parallelFor(0, secondLimit, [&](size_t begin, size_t end, unsigned int) {
+            std::vector<std::complex<float>> lines(static_cast<size_t>(block) * m);
+            for (size_t b = begin; b < end; b++)
+                for (unsigned int a = 0; a < firstLimit; a += block)
+                {
+                    std::complex<float>* base = data.data() + a * firstStride + b * secondStride;
+                    for (unsigned int k = 0; k < m; k++)
+                        for (unsigned int l = 0; l < block; l++)
+                            lines[l * m + k] = base[k * stride + l];
+                    for (unsigned int l = 0; l < block; l++)
+                    {
+                        std::complex<float>* line = &lines[l * m];
+                        fft.run(line, inverse);
+                        if (multiply)
+                        {
+                            const float* s = multiply->data() + (a + l) * firstStride + b * secondStride;
+                            for (unsigned int k = 0; k < m; k++)
+                                line[k] *= s[k * stride];
+                            fft.run(line, true);
+                        }
+                    }
+                    for (unsigned int k = 0; k < m; k++)
+                        for (unsigned int l = 0; l < block; l++)
+                            base[k * stride + l] = lines[l * m + k];
+                }
+        }, maxThreads);
+    }
+
+    // four-point central differences of the convolution, away from the outermost two nodes
+    void gradient(unsigned int maxThreads)
+    {
+        const int n = static_cast<int>(size);
+        workerPool().parallelFor(2, size - 2, [&](size_t begin, size_t end, unsigned int) {
+            for (int z = static_cast<int>(begin); z < static_cast<int>(end); z++)
+                for (int y = 2; y < n - 2; y++)
+                    for (int x = 2; x < n - 2; x++)
+                    {
+                        const auto d = [&](size_t step) {
+                            const size_t c = node(x, y, z);
+                            return (2.0f / 3.0f) * (density[c + step] - density[c - step]) -
+                                   (1.0f / 12.0f) * (density[c + 2 * step] - density[c - 2 * step]);
+                        };
+                        field[node(x, y, z)] = glm::vec3(d(1), d(size), d(static_cast<size_t>(size) * size));
+                    }
+        }, maxThreads);
+    }
+
+    // the convolution of a body's own weights with the kernel, taken out of its potential
+    double selfPotential(const glm::vec3& p) const
+    {
+        const glm::vec3 u = gridCoordinate(p);
+        const glm::vec3 f = glm::clamp(u - glm::floor(u), 0.0f, 1.0f);
+        double g[4];
+        for (int k = 0; k < 4; k++)
+            g[k] = kernelAt(std::sqrt(static_cast<double>(k)), shortRange, splitCells);
+        double sum = 0.0;
+        for (int a = 0; a < 8; a++)
+            for (int b = 0; b < 8; b++)
+            {
+                const int differ = ((a ^ b) & 1) + (((a ^ b) >> 1) & 1) + ((a ^ b) >> 2);
+                const auto w = [&](int k) {
+                    return ((k & 1) ? f.x : 1.0f - f.x) * (((k >> 1) & 1) ? f.y : 1.0f - f.y) * ((k >> 2) ? f.z : 1.0f - f.z);
+                };
+                sum += static_cast<double>(w(a)) * w(b) * g[differ];
+            }
+        return sum;
+    }
+
+    void interpolate(const glm::vec3* positions, const float* masses, size_t count, glm::vec3* accelerations,
+                     float* potentials, unsigned int maxThreads) const
+    {
+        const float forceScale = 1.0f / (cellSize * cellSize);
+        const float potentialScale = -1.0f / cellSize;
+        workerPool().parallelFor(0, count, [&](size_t begin, size_t end, unsigned int) {
+            for (size_t i = begin; i < end; i++)
+            {
+                glm::vec3 a(0.0f);
+                float conv = 0.0f;
+                forEachWeight(positions[i], [&](size_t index, float w) {
+                    a += w * field[index];
+                    conv += w * density[index];
+                });
+                accelerations[i] = a * forceScale;
+                if (potentials)
+                    potentials[i] = potentialScale * static_cast<float>(conv - masses[i] * selfPotential(positions[i]));
+            }
+        }, maxThreads);
+    }
+
+    // the short-range rest of every pair within the cutoff: the pair term times erfc(r / 2r_s) + r / (r_s sqrt pi)
+    // exp(-r^2 / 4r_s^2), the part of the force the long-range kernel leaves out
+    void addShortRange(const glm::vec3* positions, const float* masses, size_t count, float epsilonSq,
+                       glm::vec3* accelerations, float* potentials, unsigned int maxThreads)
+    {
+        const double split = static_cast<double>(splitCells) * cellSize;
+        const double cutoff = cutoffSplits * split;
+        pairs.reset(cutoff);
+        for (size_t i = 0; i < count; i++)
+            pairs.update(static_cast<uint32_t>(i), glm::dvec3(positions[i]));
+        const double cutoffSq = cutoff * cutoff;
+        const double invTwoSplit = 0.5 / split;
+        const double gaussian = 1.0 / (split * std::sqrt(3.14159265358979));
+        slicePairs.assign(workerPool().size(), 0);
+        workerPool().parallelFor(0, count, [&](size_t begin, size_t end, unsigned int slice) {
+            unsigned long long found = 0;
+            for (size_t i = begin; i < end; i++)
+            {
+                const glm::dvec3 p(positions[i]);
+                glm::dvec3 a(0.0);
+                double phi = 0.0;
+                pairs.forEachNear(p, [&](uint32_t j) {
+                    if (j == i)
+                        return;
+                    const glm::dvec3 r = glm::dvec3(positions[j]) - p;
+                    const double d2 = glm::dot(r, r);
+                    if (d2 >= cutoffSq)
+                        return;
+                    const double r2 = std::max(d2, static_cast<double>(epsilonSq));
+                    const double dist = std::sqrt(r2);
+                    const double x = dist * invTwoSplit;
+                    const double tail = std::erfc(x);
+                    a += r * (masses[j] * (tail + dist * gaussian * std::exp(-x * x)) / (r2 * dist));
+                    phi -= masses[j] * tail / dist;
+                    found++;
+                });
+                accelerations[i] += glm::vec3(a);
+                if (potentials)
+                    potentials[i] += static_cast<float>(phi);
+            }
+            slicePairs[slice] += found;
+        }, maxThreads);
+        for (unsigned long long c : slicePairs)
+            shortRangePairs += c;
+    }
+};
+
+#endif
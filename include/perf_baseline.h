@@ -0,0 +1,224 @@
+#ifndef PERF_BASELINE_H
+#define PERF_BASELINE_H
+
+#include <unistd.h>
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <fstream>
+#include <sstream>
+#include <ostream>
+#include <iomanip>
+#include <filesystem>
+#include <random>
+#include <algorithm>
+#include <cmath>
+
+// Stored performance baselines and the comparison against them. A baseline is every sample of every metric of one
+// run, a microbenchmark's repetitions or a benchmark's frames, saved per machine as text, one metric a line:
+// "name<TAB>sample sample ...". comparePerf() bootstraps a confidence interval for each metric's relative change
+// of median, so a metric is only flagged when the whole interval is past zero and the change past the threshold,
+// not when one run happened to be noisy. Samples are times, larger is slower.
+struct PerfSamples
+{
+    std::vector<std::pair<std::string, std::vector<double>>> metrics;
+
+    void add(const std::string& name, std::vector<double> samples)
+    {
+        metrics.emplace_back(name, std::move(samples));
+    }
+
+    const std::vector<double>* find(const std::string& name) const
+    {
+        for (const auto& metric : metrics)
+            if (metric.first == name)
+                return &metric.second;
+        return nullptr;
+    }
+
+    // creates the directories on the way
+    bool save(const std::string& path) const
+    {
+        std::error_code error;
+        const std::filesystem::path parent = std::filesystem::path(path).parent_path();
+        if (!parent.empty())
+            std::filesystem::create_directories(parent, error);
+        std::ofstream file(path);
+        if (!file)
+            return false;
+        file.precision(9);
+        for (const auto& metric : metrics)
+        {
+            file << metric.first << '\t';
+            for (size_t i = 0; i < metric.second.size(); i++)
+                file << (i ? " " : "") << metric.second[i];
+            file << '\n';
+        }
+        return static_cast<bool>(file);
+    }
+
+    bool load(const std::string& path)
+    {
+        std::ifstream file(path);
+        if (!file)
+            return false;
+        std::vector<std::pair<std::string, std::vector<double>>> loaded;
+        std::string line;
+        while (std::getline(file, line))
+        {
+            const size_t tab = line.find('\t');
+            if (line.empty() || tab == std::string::npos)
+                continue;
+            std::istringstream stream(line.substr(tab + 1));
+            std::vector<double> samples;
+            for (double value; stream >> value;)
+                samples.push_back(value);
+            if (!samples.empty())
+                loaded.emplace_back(line.substr(0, tab), std::move(samples));
+        }
+        metrics.swap(loaded);
+        return true;
+    }
+};
+
+// the host name, what baselines are filed under unless another name is given
+inline std::string perfMachineName()
+{
+    char name[256] = {};
+    if (gethostname(name, sizeof(name) - 1) != 0 || name[0] == '\0')
+        return "unknown";
+    return name;
+}
+
+inline std::string perfBaselinePath(const std::string& directory, const std::string& machine, const std::string& name)
+{
+    return directory + "/" + machine + "/" + name + ".baseline";
+}
+
+struct PerfCompareOptions
+{
+    double threshold = 0.03;        // relative change of median below which nothing is flagged
+    double confidence = 0.95;
+    unsigned int resamples = 2000;
+    unsigned int seed = 1;          // the bootstrap's, so the same two runs always give the same interval
+};
+
+struct PerfChange
+{
+    std::string name;
+    double baseline;        // medians
+    double current;
+    double change;          // current / baseline - 1
+    double low;             // confidence interval of change
+    double high;
+    int verdict;            // 1 slower, -1 faster, 0 within noise or threshold
+};
+
+inline double perfMedian(std::vector<double>& values)
+{
+    const size_t middle = values.size() / 2;
+    std::nth_element(values.begin(), values.begin() + middle, values.end());
+    return values[middle];
+}
+
+// every metric of current that baseline has too, in current's order
+inline std::vector<PerfChange> comparePerf(const PerfSamples& baseline, const PerfSamples& current,
+                                           const PerfCompareOptions& options = PerfCompareOptions())
+{
+    std::vector<PerfChange> changes;
+    std::mt19937 rng(options.seed);
+    std::vector<double> scratch, a, b, ratios;
+    for (const auto& metric : current.metrics)
+    {
+        const std::vector<double>* before = baseline.find(metric.first);
+        if (!before || before->empty() || metric.second.empty())
+            continue;
+        PerfChange c;
+        c.name = metric.first;
+        scratch = *before;
+        c.baseline = perfMedian(scratch);
+        scratch = metric.second;
+        c.current = perfMedian(scratch);
+        c.change = c.baseline > 0.0 ? c.current / c.baseline - 1.0 : 0.0;
+        // resample both runs with replacement, the spread of the ratio of their medians is the interval
+        std::uniform_int_distribution<size_t> pickBefore(0, before->size() - 1), pickAfter(0, metric.second.size() - 1);
+        a.resize(before->size());
+        b.resize(metric.second.size());
+        ratios.clear();
+        for (unsigned int r = 0; r < options.resamples; r++)
+        {
+            for (double& v : a) v = (*before)[pickBefore(rng)];
+            for (double& v : b) v = metric.second[pickAfter(rng)];
+            const double m = perfMedian(a);
+            if (m > 0.0)
+                ratios.push_back(perfMedian(b) / m - 1.0);
+        }
+        c.low = c.high = c.change;
+        if (!ratios.empty())
+        {
+            std::sort(ratios.begin(), ratios.end());
+            const double tail = 0.5 * (1.0 - options.confidence);
+            c.low = ratios[static_cast<size_t>(tail * (ratios.size() - 1))];
+            c.high = ratios[static_cast<size_t>((1.0 - tail) * (ratios.size() - 1))];
+        }
+        c.verdict = 0;
+        if (c.low > 0.0 && c.change >= options.threshold)
+            c.verdict = 1;
+        else if (c.high < 0.0 && c.change <= -options.threshold)
+            c.verdict = -1;
+        changes.push_back(c);
+    }
+    return changes;
+}
+
+// The table of changes, then the attribution: when total names a metric that got slower, how much of its change
+// each component metric (one with a '/' in its name, e.g. "gpu/asteroids") accounts for, largest first. Returns
+// the number of regressions.
+inline unsigned int printPerfComparison(std::ostream& out, const std::vector<PerfChange>& changes, const std::string& unit,
+                                        const std::string& total = "")
+{
+    unsigned int slower = 0, faster = 0;
+    out << std::left << std::setw(56) << "metric" << std::right << std::setw(14) << ("base " + unit) << std::setw(14)
+        << ("now " + unit) << std::setw(10) << "change" << std::setw(22) << "95% interval" << '\n'
+        << std::string(116, '-') << '\n';
+    for (const PerfChange& c : changes)
+    {
+        std::ostringstream interval;
+        interval << std::fixed << std::setprecision(1) << "[" << c.low * 100.0 << "%, " << c.high * 100.0 << "%]";
+        out << std::left << std::setw(56) << c.name << std::right << std::fixed << std::setprecision(4) << std::setw(14) << c.baseline
+            << std::setw(14) << c.current << std::setprecision(1) << std::setw(9) << c.change * 100.0 << "%" << std::setw(22)
+            << interval.str() << (c.verdict > 0 ? "  SLOWER" : c.verdict < 0 ? "  faster" : "") << '\n';
+        slower += c.verdict > 0;
+        faster += c.verdict < 0;
+    }
+    out << slower << " slower, " << faster << " faster, " << changes.size() - slower - faster << " unchanged\n";
+
+    const PerfChange* whole = nullptr;
+    for (const PerfChange& c : changes)
+        if (c.name == total)
+            whole = &c;
+    if (whole && whole->verdict > 0)
+    {
+        const double delta = whole->current - whole->baseline;
+        std::vector<const PerfChange*> parts;
+        for (const PerfChange& c : changes)
+            if (c.name.find('/') != std::string::npos && c.current > c.baseline)
+                parts.push_back(&c);
+        std::sort(parts.begin(), parts.end(), [](const PerfChange* x, const PerfChange* y) {
+            return x->current - x->baseline > y->current - y->baseline;
+        });
+        out << total << " is " << std::setprecision(4) << delta << " " << unit << " slower, from:\n";
+        for (const PerfChange* c : parts)
+        {
+            const double added = c->current - c->baseline;
+            out << "  " << std::left << std::setw(54) << c->name << std::right << std::setprecision(4) << std::setw(12) << added
+                << " " << unit << std::setprecision(0) << std::setw(6) << (delta > 0.0 ? added / delta * 100.0 : 0.0) << "%"
+                << (c->verdict > 0 ? "  SLOWER" : "") << '\n';
+        }
+    }
+    out.flush();
+    return slower;
+}
+
+#endif
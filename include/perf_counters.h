@@ -0,0 +1,232 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Hardware counters for the benchmark harnesses, through Linux's perf_event_open. Each counter is opened on its own
+// for the calling thread in user mode with inherit set, so threads started after open() (the worker pool's) count
+// into it as well and a reading is the whole process's; it has to happen before the pool exists. Counters the CPU
+// or the kernel's perf_event_paranoid does not allow are left out, a reading of them is zero and valid() says so,
+// and a counter the kernel multiplexes is scaled up by the time it was enabled over the time it ran. Nothing here
+// needs root: memory traffic is estimated as a cache line per last-level miss, the uncore's memory controller
+// counters being out of reach of an unprivileged process. Off Linux open() fails and readings are empty.
+//
+// PerfScope adds the counts over its lifetime to a named region of perfCounters(), with an optional work counter
+// whose growth over the scope is the region's items (the pair interactions of a force pass); regions nest freely.
+enum PerfCounter {
+    PERF_CYCLES = 0,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_COUNTER_COUNT
+};
+
+inline const char* perfCounterName(PerfCounter counter)
+{
+    static const char* const names[PERF_COUNTER_COUNT] = {"cycles", "instructions", "L1D misses", "LLC misses", "branch misses"};
+    return names[counter];
+}
+
+struct PerfReading
+{
+    uint64_t value[PERF_COUNTER_COUNT] = {};
+    int64_t ns = 0;             // wall clock
+
+    PerfReading operator-(const PerfReading& earlier) const
+    {
+        PerfReading d;
+        for (int c = 0; c < PERF_COUNTER_COUNT; c++)
+            d.value[c] = value[c] - earlier.value[c];
+        d.ns = ns - earlier.ns;
+        return d;
+    }
+
+    PerfReading& operator+=(const PerfReading& other)
+    {
+        for (int c = 0; c < PERF_COUNTER_COUNT; c++)
+            value[c] += other.value[c];
+        ns += other.ns;
+        return *this;
+    }
+
+    double seconds() const { return ns * 1e-9; }
+    double ipc() const { return value[PERF_CYCLES] > 0 ? static_cast<double>(value[PERF_INSTRUCTIONS]) / value[PERF_CYCLES] : 0.0; }
+    // memory traffic as a line per last-level miss
+    double bytes() const { return static_cast<double>(value[PERF_LLC_MISSES]) * PerfReading::CACHE_LINE; }
+
+    static constexpr double CACHE_LINE = 64.0;
+};
+
+class PerfCounters
+{
+public:
+    struct Region
+    {
+        std::string name;
+        unsigned long long entries = 0;
+        double items = 0.0;     // work done inside, 0 when the region has no work counter
+        PerfReading total;
+    };
+
+    PerfCounters() = default;
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    ~PerfCounters()
+    {
+        close();
+    }
+
+    // true when at least one counter opened; error() names the first that did not
+    bool open()
+    {
+        close();
+#ifdef __linux__
+        static const struct { uint32_t type; uint64_t config; } events[PERF_COUNTER_COUNT] = {
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        };
+        for (int c = 0; c < PERF_COUNTER_COUNT; c++)
+        {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = events[c].type;
+            attr.config = events[c].config;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.inherit = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fds[c] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            if (fds[c] < 0 && lastError.empty())
+                lastError = std::string("perf_event_open(") + perfCounterName(static_cast<PerfCounter>(c)) + "): " + std::strerror(errno);
+        }
+#else
+        lastError = "hardware counters need Linux's perf_event_open";
+#endif
+        opened = std::any_of(std::begin(fds), std::end(fds), [](int fd) { return fd >= 0; });
+        return opened;
+    }
+
+    void close()
+    {
+#ifdef __linux__
+        for (int& fd : fds)
+            if (fd >= 0)
+                ::close(fd);
+#endif
+        std::fill(std::begin(fds), std::end(fds), -1);
+        opened = false;
+    }
+
+    bool enabled() const { return opened; }
+    bool valid(PerfCounter counter) const { return fds[counter] >= 0; }
+    const std::string& error() const { return lastError; }
+
+    PerfReading read() const
+    {
+        PerfReading r;
+        r.ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#ifdef __linux__
+        for (int c = 0; c < PERF_COUNTER_COUNT; c++)
+        {
+            uint64_t data[3] = {0, 0, 0};   // value, time enabled, time running
+            if (fds[c] < 0 || ::read(fds[c], data, sizeof(data)) != static_cast<ssize_t>(sizeof(data)))
+                continue;
+            r.value[c] = data[2] > 0 && data[2] < data[1] ? static_cast<uint64_t>(static_cast<double>(data[0]) * data[1] / data[2]) : data[0];
+        }
+#endif
+        return r;
+    }
+
+    void add(const char* name, const PerfReading& delta, double items)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = std::find_if(accumulated.begin(), accumulated.end(), [&](const Region& r) { return r.name == name; });
+        if (it == accumulated.end())
+        {
+            accumulated.push_back(Region());
+            it = accumulated.end() - 1;
+            it->name = name;
+        }
+        it->entries++;
+        it->items += items;
+        it->total += delta;
+    }
+
+    // in the order they were first entered
+    std::vector<Region> regions() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return accumulated;
+    }
+
+    void clearRegions()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        accumulated.clear();
+    }
+
+private:
+    int fds[PERF_COUNTER_COUNT] = {-1, -1, -1, -1, -1};
+    bool opened = false;
+    std::string lastError;
+    mutable std::mutex mutex;
+    std::vector<Region> accumulated;
+};
+
+inline PerfCounters& perfCounters()
+{
+    static PerfCounters instance;
+    return instance;
+}
+
+// the counts of its lifetime into a region of perfCounters(), items the growth of *work if given
+class PerfScope
+{
+public:
+    explicit PerfScope(const char* name, const unsigned long long* work = nullptr)
+        : name(name), work(work), active(perfCounters().enabled())
+    {
+        if (!active)
+            return;
+        workStart = work ? *work : 0;
+        start = perfCounters().read();
+    }
+
+    ~PerfScope()
+    {
+        if (active)
+            perfCounters().add(name, perfCounters().read() - start, work ? static_cast<double>(*work - workStart) : 0.0);
+    }
+
+    PerfScope(const PerfScope&) = delete;
+    PerfScope& operator=(const PerfScope&) = delete;
+
+private:
+    const char* name;
+    const unsigned long long* work;
+    bool active;
+    unsigned long long workStart = 0;
+    PerfReading start;
+};
+
+#endif
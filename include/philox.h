@@ -0,0 +1,66 @@
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <cstdint>
+
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3"), a counter-based generator: the
+// output is a keyed bijection of a 128-bit counter, so the n-th number of any stream is computed directly, with no
+// state carried from the one before. Keying a stream by the seed and counting by item index and draw makes every
+// item's numbers independent of which thread, or how many, generated it, and the rounds are only multiplies and
+// xors, the same in a shader.
+namespace philox {
+
+struct Block
+{
+    uint32_t v[4];
+};
+
+inline Block philox4x32(Block counter, uint32_t key0, uint32_t key1)
+{
+    for (int round = 0; round < 10; round++)
+    {
+        const uint64_t p0 = static_cast<uint64_t>(0xD2511F53u) * counter.v[0];
+        const uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57u) * counter.v[2];
+        counter = Block{{static_cast<uint32_t>(p1 >> 32) ^ counter.v[1] ^ key0, static_cast<uint32_t>(p1),
+                         static_cast<uint32_t>(p0 >> 32) ^ counter.v[3] ^ key1, static_cast<uint32_t>(p0)}};
+        key0 += 0x9E3779B9u;
+        key1 += 0xBB67AE85u;
+    }
+    return counter;
+}
+
+// the numbers of one item of a seeded stream, four per block. domain tells apart streams of one seed that index
+// the same items for different purposes.
+class Stream
+{
+public:
+    Stream(uint64_t seed, uint64_t item, uint32_t domain = 0)
+        : key0(static_cast<uint32_t>(seed)), key1(static_cast<uint32_t>(seed >> 32)),
+          itemLow(static_cast<uint32_t>(item)), itemHigh(static_cast<uint32_t>(item >> 32)), domain(domain) {}
+
+    uint32_t next()
+    {
+        if (used == 4)
+        {
+            block = philox4x32(Block{{itemLow, itemHigh, blockIndex++, domain}}, key0, key1);
+            used = 0;
+        }
+        return block.v[used++];
+    }
+
+    // [0, 1) in steps of 2^-24, what a float holds exactly
+    float uniform() { return static_cast<float>(next() >> 8) * (1.0f / 16777216.0f); }
+    float uniform(float low, float high) { return low + (high - low) * uniform(); }
+
+private:
+    uint32_t key0, key1;
+    uint32_t itemLow, itemHigh;
+    uint32_t domain;
+    uint32_t blockIndex = 0;
+    Block block{};
+    unsigned int used = 4;
+};
+
+} // namespace philox
+
+#endif
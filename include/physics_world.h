@@ -0,0 +1,498 @@
+#ifndef PHYSICS_WORLD_H
+#define PHYSICS_WORLD_H
+
+#include <glm.hpp>
+#include <gtc/constants.hpp>
+
+#include <body_store.h>
+#include <barnes_hut.h>
+#include <fmm.h>
+#include <particle_mesh.h>
+#include <gravity_kernels.h>
+#include <integrators.h>
+#include <block_timesteps.h>
+#include <belt_sectors.h>
+#include <morton.h>
+#include <spatial_hash.h>
+#include <signed_distance_field.h>
+#include <galaxy.h>
+#include <scenario_file.h>
+#include <thread_pool.h>
+#include <philox.h>
+#include <ephemeris.h>
+
+#include <vector>
+#include <random>
+#include <cmath>
+
+// CPU physics without any GL or windowing dependency, shared by the interactive viewer and the headless runner.
+// Settings are plain public members so a UI can bind straight to them. Anything that changes forces without moving
+// bodies (G, masses, solver) should be followed by invalidate() so cached accelerations are recomputed.
+
+enum GravitySolver {
+    SOLVER_BRUTE_FORCE = 0,
+    SOLVER_BARNES_HUT = 1,
+    SOLVER_TEST_PARTICLES = 2,  // asteroids are massless: they feel only the massive bodies and pull on nothing
+    SOLVER_FMM = 3,             // fast multipole method, O(N), every body pulls on every other
+    SOLVER_PARTICLE_MESH = 4    // FFT on a mesh, optionally with P3M pairs, every body pulls on every other
+};
+
+// energy, momentum and angular momentum of the whole system at one instant, in double
+struct ConservedQuantities
+{
+    double simTime = 0.0;
+    double kinetic = 0.0;
+    double potential = 0.0;
+    double total = 0.0;
+    glm::dvec3 momentum{0.0};
+    glm::dvec3 angularMomentum{0.0};
+};
+
+// drift of a sample from a reference, relative where the reference is nonzero
+inline double relativeDrift(double value, double reference)
+{
+    return reference != 0.0 ? (value - reference) / std::abs(reference) : value - reference;
+}
+
+inline double relativeDrift(const glm::dvec3& value, const glm::dvec3& reference)
+{
+    const double len = glm::length(reference);
+    const double delta = glm::length(value - reference);
+    return len > 0.0 ? delta / len : delta;
+}
+
+// the sun / planet / asteroid belt setup the viewer starts from
+struct ScenarioConfig
+{
+    float sunMass = 20000.0f;
+    float sunRadiusScale = 15.0f;
+
+    float planetMass = 200.0f;
+    float planetRadiusScale = 1.0f;
+    float planetOrbitRadius = 200.0f;
+    float planetInitialAngle = 0.0f;    // degrees
+
+    unsigned int asteroidAmount = 0;
+    float avgAsteroidMass = 0.1f;
+    float minAsteroidScale = 0.05f;
+    float maxAsteroidScale = 0.25f;
+    float asteroidBeltInnerRadius = 100.0f;
+    float asteroidBeltOuterRadius = 180.0f;
+    float asteroidBeltHeight = 10.0f;
+
+    unsigned int seed = 1;
+};
+
+// the state asteroid ordinal of a scenario's belt starts in, around a sun of sunMass at rest at the origin. rng is
+// the stream of (seed, ordinal), left where the draws of the asteroid's render data begin.
+struct BeltAsteroid
+{
+    glm::dvec3 position;
+    glm::dvec3 velocity;
+    float mass;
+};
+
+inline BeltAsteroid beltAsteroid(const ScenarioConfig& scenario, float G, float sunMass, philox::Stream& rng)
+{
+    float r = rng.uniform(scenario.asteroidBeltInnerRadius, scenario.asteroidBeltOuterRadius);
+    float angle = rng.uniform(0.0f, 2.0f * glm::pi<float>());
+    float y = rng.uniform(-scenario.asteroidBeltHeight / 2.0f, scenario.asteroidBeltHeight / 2.0f);
+    glm::dvec3 pos(r * cos(angle), y, r * sin(angle));
+
+    float velMag = (sunMass > 0 && r > 0) ? sqrt((G * sunMass) / r) : 0.0f;
+    glm::dvec3 vel(-velMag * sin(angle), 0.0f, velMag * cos(angle));
+    vel.x += rng.uniform(-velMag * 0.1f, velMag * 0.1f);
+    vel.y += rng.uniform(-velMag * 0.1f, velMag * 0.1f) * 0.1f;
+    vel.z += rng.uniform(-velMag * 0.1f, velMag * 0.1f);
+    return BeltAsteroid{pos, vel, scenario.avgAsteroidMass * rng.uniform(0.5f, 1.5f)};
+}
+
+// the tunables of a PhysicsWorld, copied as a unit when another thread owns the world
+struct PhysicsSettings
+{
+    float G;
+    float epsilonSq;
+    int solver;
+    float theta;
+    bool asteroidSelfGravity;
+    int forceKernel;
+    int forceLaw;
+    int forcePrecision;
+    bool validateForceKernel;
+    int threads;
+    IntegratorType integrator;
+    bool blockTimesteps;
+    float blockEta;
+    unsigned int blockMaxLevel;
+    bool keplerAsteroids;
+    float keplerHillFactor;
+    bool mortonSort;
+    float mortonThreshold;
+    unsigned int fmmOrder;
+    float fmmTheta;
+    unsigned int fmmValidationSample;
+    bool collisions;
+    unsigned int diagnosticsInterval;
+    bool closeEncounters;
+    float encounterTimescale;
+    unsigned int meshGrid;
+    bool meshShortRange;
+    bool beltSectors;
+    bool respa;
+    unsigned int respaSteps;
+    unsigned int sectorAngular;
+    unsigned int sectorRadial;
+    unsigned int sectorMaxLevel;
+    float sectorFocusRadius;
+
+    bool operator==(const PhysicsSettings& o) const
+    {
+        return G == o.G && epsilonSq == o.epsilonSq && solver == o.solver && theta == o.theta &&
+               asteroidSelfGravity == o.asteroidSelfGravity && forceKernel == o.forceKernel &&
+               forceLaw == o.forceLaw && forcePrecision == o.forcePrecision &&
+               validateForceKernel == o.validateForceKernel && threads == o.threads && integrator == o.integrator &&
+               blockTimesteps == o.blockTimesteps && blockEta == o.blockEta && blockMaxLevel == o.blockMaxLevel &&
+               keplerAsteroids == o.keplerAsteroids && keplerHillFactor == o.keplerHillFactor &&
+               mortonSort == o.mortonSort && mortonThreshold == o.mortonThreshold && fmmOrder == o.fmmOrder &&
+               fmmTheta == o.fmmTheta && fmmValidationSample == o.fmmValidationSample &&
+               collisions == o.collisions && diagnosticsInterval == o.diagnosticsInterval &&
+               closeEncounters == o.closeEncounters && encounterTimescale == o.encounterTimescale &&
+               meshGrid == o.meshGrid && meshShortRange == o.meshShortRange && beltSectors == o.beltSectors &&
+               respa == o.respa && respaSteps == o.respaSteps &&
+               sectorAngular == o.sectorAngular && sectorRadial == o.sectorRadial &&
+               sectorMaxLevel == o.sectorMaxLevel && sectorFocusRadius == o.sectorFocusRadius;
+    }
+    bool operator!=(const PhysicsSettings& o) const { return !(*this == o); }
+};
+
+// diagnostics of the last step, for display
+struct PhysicsStats
+{
+    unsigned long long interactions = 0;
+    size_t treeNodes = 0;
+    size_t massiveBodies = 0;
+    float forceKernelError = 0.0f;
+    unsigned int blockEvents = 0;
+    unsigned long blockForceEvaluations = 0;
+    std::vector<unsigned int> levelHistogram;
+    size_t keplerBodies = 0;
+    size_t keplerEncounters = 0;
+    size_t closeEncounters = 0;
+    float mortonDisorder = 0.0f;
+    unsigned long mortonSorts = 0;
+    float fmmError = 0.0f;
+    float meshCellSize = 0.0f;
+    unsigned long long meshPairs = 0;
+    unsigned long mergers = 0;
+    unsigned int mergersLastStep = 0;
+    size_t sectorFullRate = 0;
+    size_t sectorTargets = 0;
+    unsigned long respaSlowSums = 0;                // full force sums of the multiple-timestep scheme since the start
+    std::vector<unsigned int> sectorLevelBodies;    // asteroids per rate level
+    size_t ephemerisBodies = 0;
+    bool haveConserved = false;
+    ConservedQuantities conserved;
+    ConservedQuantities conservedReference;
+    std::vector<ConservedQuantities> conservedHistory;
+};
+
+class Model;
+class Mesh;
+struct SnapshotInfo;
+
+class PhysicsWorld
+{
+public:
+    BodyStore bodies;
+
+    float G = 1000.0f;
+    float epsilonSq = 1e-4f;                // softening factor squared
+    int solver = SOLVER_BRUTE_FORCE;
+    float theta = 0.5f;                     // Barnes-Hut opening angle, 0 degenerates to the direct sum
+    bool asteroidSelfGravity = false;       // the tree solver always includes asteroid-asteroid gravity
+    int forceKernel = bestGravityKernel();  // SIMD kernel used by the direct solvers
+    // the pair law and arithmetic of the direct and tree solvers (force_kernels.h); the SIMD kernels only run the
+    // Newtonian law in float, the other combinations take the policy loops. FMM, PM and the GPU keep Newtonian.
+    int forceLaw = FORCE_NEWTONIAN;
+    int forcePrecision = PRECISION_FLOAT;
+    bool validateForceKernel = false;       // recompute a sample with the scalar kernel and report the error
+    int threads = static_cast<int>(ThreadPool::defaultThreadCount());
+
+    Integrator integrator;
+    bool blockTimesteps = false;            // per-body power-of-two steps instead of the integrator
+    BlockTimestepper blockStepper;
+    // Keplerian mode: asteroids are test particles on analytic two-body orbits around the sun, only those within
+    // keplerHillFactor Hill radii of a planet (and the massive bodies) are integrated numerically with leapfrog.
+    // Takes precedence over the integrator and block timesteps.
+    bool keplerAsteroids = false;
+    float keplerHillFactor = 3.0f;
+
+    // Close encounters: an asteroid nearer to the sun or a planet than the radius where their two-body orbit takes
+    // encounterTimescale per radian, sqrt(r^3 / GM) < encounterTimescale, moves on the exact two-body orbit
+    // around that primary during the drift (keplerPropagate) and is kicked by everything else. A pericentre pass
+    // then costs nothing extra, and the global step (time warp's stable step) only has to resolve the bodies
+    // outside every encounter. Steps with no encounter use the integrator; those with one are KDK leapfrog. The
+    // Keplerian mode and block timesteps take precedence.
+    bool closeEncounters = false;
+    float encounterTimescale = 0.1f;
+
+    // Multi-rate belt: the asteroids are split into sectors (belt_sectors.h) that each get the full force sum at
+    // their own rate, every step near the focus and every 2^level steps further out, and follow their heliocentric
+    // two-body orbit in between. The force sum kicks an asteroid by everything but the sun's pull for all the time
+    // since its last kick, the sun and planets take a leapfrog step each step, and an asteroid within
+    // keplerHillFactor Hill radii of a planet is always at full rate. Multi-rate needs a sun; the Keplerian mode
+    // takes precedence, it takes precedence over block timesteps and close encounters.
+    bool beltSectors = false;
+    BeltSectors sectors;
+
+    // Multiple timesteps (reversible RESPA): the pull between the sun and each other body, the force that changes
+    // fastest and costs O(N) to sum, takes a leapfrog step every step. The rest, the planets, the belt's
+    // self-gravity and the far field of the tree or mesh, is the solver's full sum less that fast part: it is summed
+    // once every respaSteps steps, at the end of a cycle, and applied as impulses of half the cycle at each end of
+    // it, so a cycle pays for one full sum. Both parts use the solver's force law. Velocities hold the whole slow
+    // impulse only at a cycle's end, and bodies.acceleration holds the fast part. The Keplerian mode, the multi-rate
+    // belt and block timesteps take precedence, it takes precedence over close encounters. Needs a sun.
+    bool respa = false;
+    unsigned int respaSteps = 4;
+
+    // Asteroids are periodically re-sorted by Z-order key so the force loops and the tree build walk memory in
+    // spatial order. Every mortonCheckInterval steps the keys are recomputed, and the sort only runs when more than
+    // mortonThreshold of neighbouring pairs are out of order. Anything that must follow a body should hold its
+    // bodies.id, not its index.
+    bool mortonSort = true;
+    float mortonThreshold = 0.1f;
+    unsigned int mortonCheckInterval = 64;
+
+    // fast multipole solver: expansion order and acceptance angle live in fmm. With fmmValidationSample > 0 that many
+    // bodies, spread over the index range, are recomputed by direct summation each evaluation and the largest
+    // relative error is reported.
+    FastMultipole fmm;
+    unsigned int fmmValidationSample = 0;
+
+    // particle-mesh solver: grid size and the P3M pair correction live in particleMesh (particle_mesh.h)
+    ParticleMesh particleMesh;
+
+    // Collisions: asteroids closer than the sum of their radius scales merge inelastically into the heavier one,
+    // conserving mass and momentum, and an asteroid touching the sun or a planet is absorbed by it. Asteroid pairs
+    // come from an incremental spatial hash with cells twice the largest asteroid radius, the few massive bodies are
+    // tested against every asteroid. Merged-away bodies are compacted out of the store at the end of the step.
+    bool collisions = false;
+
+    // Surfaces for collisions: the sun or a planet drawn with a model given one here is hit where an asteroid's
+    // radius reaches the model's surface, scaled by the body's radius scale and turned by its orientation, instead
+    // of at the sphere of its radius scale. The test is a trilinear lookup in the model's baked distance field for
+    // the asteroids inside the field's bounding sphere. The world sees the field only, which has to outlive it.
+    void setSurface(const Model* model, const SignedDistanceField* field);
+
+    // Conserved-quantity diagnostics: every diagnosticsInterval steps (0 is off) E, P and L are sampled and their
+    // drift from the reference sample is what tells whether an integrator, step size or theta is good enough. The
+    // potential comes out of the step's own last force pass where the scheme ends on one at the final positions
+    // (leapfrog, Verlet), otherwise it costs one extra pass on that step only.
+    unsigned int diagnosticsInterval = 0;
+    static const size_t CONSERVED_HISTORY = 256;
+    bool haveConserved = false;
+    ConservedQuantities conserved;          // latest sample
+    ConservedQuantities conservedReference; // first sample since the bodies were replaced or resetConservedReference()
+    std::vector<ConservedQuantities> conservedHistory;  // oldest first, at most CONSERVED_HISTORY samples
+
+    // Ephemeris-driven bodies: the sun and planets an ephemeris (ephemeris.h) has a target for are not integrated.
+    // They are static sources at the ephemeris position and velocity, moved to the time of every force evaluation
+    // of the integrator's stages, so they pull on everything else as usual (the test-particle solver's massive
+    // sources among them) at the cost of a Chebyshev sum each. Multi-rate, Keplerian, block and encounter steps see
+    // them where they were at the step's start. Nothing about them limits the step or drifts with it, and setting
+    // simTime anywhere in the ephemeris' span followed by bodiesChanged() puts them where they are then.
+    Ephemeris ephemeris;
+
+    double simTime = 0.0;                   // advanced by step(), restored from snapshots
+    unsigned long stepCount = 0;
+
+    // diagnostics
+    BarnesHutTree tree;                     // positions relative to treeOrigin()
+    GravitySoA massiveSoA;                  // compact sun/planet source list for the test-particle solver
+    float forceKernelError = 0.0f;
+    float fmmError = 0.0f;                  // largest relative error of the sampled bodies, see fmmValidationSample
+    unsigned long long interactionsLastStep = 0;    // pair (or tree cell) terms summed by the last step
+    size_t keplerBodiesLastStep = 0;        // asteroids propagated analytically by the last Keplerian step
+    size_t encountersLastStep = 0;          // asteroids on a two-body orbit around a primary in the last step
+    size_t sectorFullRateLastStep = 0;      // asteroids the last multi-rate step integrated at full rate
+    size_t sectorTargetsLastStep = 0;       // bodies whose force sum the last multi-rate step used, the massive ones included
+    float mortonDisorder = 0.0f;            // out-of-order fraction at the last check
+    unsigned long mortonSorts = 0;
+    bool reorderedLastStep = false;         // the asteroid range was permuted by lastReorder() at the end of the step
+    unsigned long mergers = 0;              // bodies merged away since initialize
+    unsigned int mergersLastStep = 0;       // bodies removed by the last step, listed by lastRemoved()
+
+    // indices (sorted, as they were before the removal) of the bodies the last step merged away. A step that both
+    // removes and re-sorts removes first, lastReorder() then applies to the compacted asteroid range.
+    const std::vector<uint32_t>& lastRemoved() const { return removedIndices; }
+
+    // where the tree's float positions are measured from, the sun at the last tree build
+    const glm::dvec3& treeOrigin() const { return forceOrigin; }
+
+    // slot k of the asteroid range now holds the asteroid that was at range.begin + lastReorder()[k]
+    const std::vector<uint32_t>& lastReorder() const { return morton.sortedOrder(); }
+
+    // replaces the bodies with the scenario. The render pointers are only stored, never dereferenced here.
+    void initialize(const ScenarioConfig& scenario, Mesh* sunMesh = nullptr, Model* planetModel = nullptr, Model* asteroidModel = nullptr);
+
+    // replaces the bodies with galaxies (galaxy.h): a core per galaxy and its stars, with the softening set to the
+    // cores' Plummer scale and the test-particle solver, which the initial conditions assume
+    void initializeGalaxies(const GalaxySetup& setup, Mesh* coreMesh = nullptr);
+
+    // replaces the bodies with a scenario file's (scenario_file.h), taking its G, softening and ephemeris where it
+    // sets them
+    void initializeScenario(const ScenarioFile& file, Mesh* sunMesh = nullptr, Model* planetModel = nullptr, Model* asteroidModel = nullptr);
+
+    // takes the bodies a world built elsewhere was initialized with, and what its initialize set besides them (the
+    // time, G, softening, solver and a scenario's ephemeris); built gets these bodies in exchange
+    void adopt(PhysicsWorld& built);
+
+    // grows or shrinks the belt to scenario.asteroidAmount. Surviving bodies keep their state, new ones are the
+    // ones initialize() would have made at those places in the belt.
+    void setAsteroidCount(const ScenarioConfig& scenario, Model* asteroidModel = nullptr);
+
+    // what a snapshot of this world records next to the bodies (see snapshot.h)
+    SnapshotInfo snapshotInfo() const;
+    // replaces the bodies and sim clock with a snapshot file's, false if it could not be mapped or is not valid
+    bool loadSnapshot(const char* path, Mesh* sunMesh = nullptr, Model* planetModel = nullptr, Model* asteroidModel = nullptr);
+
+    // advances every body by dt of sim time
+    void step(float dt);
+
+    // after bodies were added, removed or overwritten from outside: drops everything cached from the old state
+    void bodiesChanged();
+
+    // reads an ephemeris and drives the bodies it has targets for from the next step on, false (with none) if it
+    // cannot be read
+    bool loadEphemeris(const std::string& path);
+    // the bodies the ephemeris drove are integrated again from where it left them
+    void clearEphemeris();
+    size_t ephemerisBodies() const { return ephemerisIds.size(); }
+
+    void invalidate()
+    {
+        integrator.invalidate();
+        blockStepper.invalidate();
+        encounterForcesCurrent = false;
+        sectorForcesCurrent = false;
+        respaFastCurrent = false;
+        respaSlowCurrent = false;
+    }
+
+    // the multi-rate belt applies to the next step
+    bool sectorsActive() const { return beltSectors && !keplerAsteroids; }
+    // the close-encounter split applies to the next step
+    bool encountersActive() const { return closeEncounters && !keplerAsteroids && !beltSectors && !blockTimesteps && !respaActive(); }
+    // the multiple-timestep split applies to the next step
+    bool respaActive() const { return respa && respaSteps > 1 && !keplerAsteroids && !beltSectors && !blockTimesteps; }
+    // the sun or planet asteroid i is in a close encounter with, the one pulling hardest where there are several,
+    // or BodyStore::INVALID_INDEX. With a lookahead the closest approach of the straight-line relative motion over
+    // that much sim time counts, so a step does not start outside an encounter it ends deep inside.
+    uint32_t encounterPrimaryOf(size_t i, double lookahead = 0.0) const;
+
+    // takes a sample at the current positions right away, with its own force pass
+    void sampleConservedNow() { sampleConserved(false); }
+    // the next sample becomes the reference and the history starts over
+    void resetConservedReference()
+    {
+        haveConserved = false;
+        conservedHistory.clear();
+    }
+
+    PhysicsSettings settings() const;
+    // copies the tunables and drops cached accelerations if anything that affects them changed
+    void applySettings(const PhysicsSettings& s);
+    PhysicsStats stats() const;
+    void stats(PhysicsStats& out) const;    // same, reusing out's storage
+
+    // overwrites bodies.acceleration from the current positions
+    void computeAccelerations();
+    // same for just the listed (sorted) targets
+    void computeAccelerationsFor(const std::vector<unsigned int>& targets);
+
+    // kinetic plus potential energy by direct summation, O(N^2)
+    double totalEnergy() const;
+
+private:
+    GravitySoA soa;
+    GravitySoA activeSoA;                   // gathered active targets for a block-step force evaluation
+    glm::dvec3 forceOrigin{0.0};            // float force sums use positions relative to this (the sun)
+    std::vector<glm::vec3> treePositions;   // float copy relative to forceOrigin for the tree
+    std::vector<glm::vec3> fmmAccelerations;
+    std::vector<glm::vec3> meshAccelerations;
+    std::vector<unsigned int> massiveIndices;
+    std::vector<unsigned long long> sliceInteractions;
+    std::vector<uint8_t> keplerNear;        // per asteroid, inside a planet's encounter sphere this step
+    std::vector<unsigned int> keplerNumerical;
+    std::vector<glm::dvec4> keplerSpheres;  // planet position and squared encounter radius
+    std::vector<uint32_t> encounterPrimary; // per asteroid, its primary for this step or INVALID_INDEX
+    std::vector<glm::dvec3> primaryPositions;
+    std::vector<double> sectorClock;        // per body, sim time up to which its perturbations were kicked in
+    std::vector<uint8_t> sectorRate;        // per asteroid, 2 full rate, 1 kicked at this step's end, 0 drifting
+    std::vector<unsigned int> sectorFull;   // force targets of the opening and closing kicks
+    std::vector<unsigned int> sectorDue;
+    std::vector<uint8_t> sectorRatePrevious;
+    std::vector<unsigned int> sectorMissing;    // full-rate bodies without an acceleration at the step's start
+    bool sectorForcesCurrent = false;       // the last multi-rate step's closing force sums are at the current positions
+    std::vector<glm::vec3> respaSlow;       // per body, the slow acceleration summed at the last cycle's end
+    std::vector<glm::dvec3> respaFast;      // the fast part in double as it is summed
+    std::vector<glm::dvec3> respaReactions; // per slice and sun, the other bodies' pull on the sun
+    unsigned int respaPhase = 0;            // steps into the open cycle, 0 between cycles
+    unsigned int respaCycleSteps = 0;       // respaSteps as the open cycle started
+    double respaElapsed = 0.0;              // sim time the open cycle has run
+    double respaImpulse = 0.0;              // and the sim time its opening slow impulse covered
+    bool respaFastCurrent = false;          // bodies.acceleration is the fast part at the current positions
+    bool respaSlowCurrent = false;          // respaSlow is at the current positions, the last step closed a cycle
+    unsigned long respaSlowSums = 0;
+    std::vector<unsigned char> sortScratch;
+    bool encounterForcesCurrent = false;    // bodies.acceleration is at the current positions from the last encounter step
+    GravitySoA referenceSoA;                // scalar recomputation for validateForceKernel
+    MortonSorter morton;
+    SpatialHash collisionHash;
+    bool collisionHashValid = false;        // dropped whenever bodies are replaced outside of a step
+    std::vector<std::vector<glm::uvec2>> sliceContacts;
+    std::vector<glm::uvec2> contacts;
+    std::vector<uint8_t> mergedAway;
+    std::vector<uint32_t> removedIndices;
+    std::vector<std::pair<const Model*, const SignedDistanceField*>> surfaces;
+    bool wantPotential = false;             // the force pass also fills potential (without G)
+    std::vector<float> potential;
+    BodyArray<glm::vec3> savedAccelerations;
+    std::vector<uint32_t> ephemerisIds;     // bodies.id of the driven bodies
+    std::vector<uint32_t> ephemerisTargets; // and their targets
+    std::vector<uint8_t> ephemerisWasStatic;
+
+    void bindEphemeris();
+    void placeEphemerisBodies(double t);
+    void updateForceOrigin();
+    void loadMassiveSources();
+    // gravityKernel with the world's kernel, law, precision and softening
+    void pairForces(GravitySoA& targets, size_t tBegin, size_t tEnd, const GravitySoA& sources, size_t sBegin, size_t sEnd,
+                    bool potential = false) const;
+    void loadTreePositions();
+    void buildTree();
+    void evaluateMultipole(float* potentials = nullptr);
+    void validateMultipole();
+    void evaluateParticleMesh(float* potentials = nullptr);
+    void testParticleAccelerationsFor(const std::vector<unsigned int>& targets);
+    void keplerEncounterSpheres(size_t sun);
+    void stepKepler(float dt);
+    void stepSectors(float dt);
+    bool stepEncounters(float dt);
+    void stepRespa(float dt);
+    void closeRespaCycle();
+    void respaFastForces();
+    void respaSlowForces();
+    void respaKick(double h, bool slow);
+    void encounterKick(double h);
+    void encounterDrift(double h);
+    void reorderIfDisordered();
+    void resolveCollisions();
+    void sampleConserved(bool potentialCurrent);
+    double potentialEnergy() const;
+    void mergeBodies(size_t keep, size_t gone);
+    void addAsteroids(const ScenarioConfig& scenario, size_t firstOrdinal, size_t count, Model* asteroidModel);
+    unsigned long long directInteractions(size_t massiveTargets, size_t asteroidTargets, size_t asteroidCount) const;
+};
+
+#endif
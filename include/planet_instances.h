@@ -0,0 +1,242 @@
+#ifndef PLANET_INSTANCES_H
+#define PLANET_INSTANCES_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <model.h>
+#include <shader.h>
+#include <streaming_buffer.h>
+#include <texture_cache.h>
+#include <texture_image.h>
+#include <gpu_memory.h>
+#include <gl_state_cache.h>
+#include <profiler.h>
+#include <batch_transforms.h>
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+
+// Every planet and moon in one instanced draw per mesh of the planet model, instead of a draw with its own model
+// and normal matrix uniforms per body. The frame's instances (a camera-relative model matrix, a material layer, the
+// pick id and the reflection settings) go into a persistently mapped ring and are read as an SSBO by
+// shaders.2/planet.instanced.vs. The materials are the layers of one GL_TEXTURE_2D_ARRAY made from the model's
+// diffuse texture: the first as it came, the rest recoloured (PLANET_MATERIALS), so bodies look apart without a
+// texture bind between them. The body drawn first, the scene's planet, keeps layer 0 and is the only one that
+// reflects, the probe is about it; the others take a layer from their id.
+//
+// The instances a view shades come first and the rest after them, so the lit passes draw [0, visibleCount()) and
+// the sun's shadow every instance. Their model matrices are composed from the placements 8 at a time straight into
+// the mapped ring (batch_transforms.h).
+struct PlanetMaterial
+{
+    glm::vec3 tint;
+    float saturation;       // 0 grey, 1 the texture's own colours
+};
+
+static const PlanetMaterial PLANET_MATERIALS[] = {
+    {glm::vec3(1.0f), 1.0f},                        // as it came
+    {glm::vec3(0.95f, 0.95f, 0.92f), 0.0f},         // grey and cratered, a moon
+    {glm::vec3(0.75f, 0.92f, 1.2f), 0.25f},         // icy
+    {glm::vec3(1.2f, 1.0f, 0.7f), 0.5f},            // ochre
+    {glm::vec3(0.7f, 1.05f, 0.85f), 0.35f},         // green
+    {glm::vec3(0.6f, 0.75f, 1.3f), 0.4f},           // ocean blue
+    {glm::vec3(1.3f, 0.8f, 0.6f), 0.8f},            // deep red
+    {glm::vec3(1.1f, 1.05f, 0.95f), 0.15f},         // pale sand
+};
+static const unsigned int PLANET_MATERIAL_COUNT = sizeof(PLANET_MATERIALS) / sizeof(PLANET_MATERIALS[0]);
+
+// mixes 8-bit pixels toward their luminance by 1 - saturation and scales them by the tint; alpha is left alone
+inline void recolorPixels(unsigned char* pixels, size_t count, int components, const PlanetMaterial& material)
+{
+    if (components < 3)
+        return;
+    for (size_t p = 0; p < count; p++)
+    {
+        unsigned char* c = pixels + p * components;
+        const float grey = 0.2126f * c[0] + 0.7152f * c[1] + 0.0722f * c[2];
+        for (int k = 0; k < 3; k++)
+            c[k] = static_cast<unsigned char>(std::clamp((grey + (c[k] - grey) * material.saturation) * material.tint[k] + 0.5f, 0.0f, 255.0f));
+    }
+}
+
+class PlanetInstances
+{
+public:
+    static const unsigned int BINDING_INSTANCES = 37;
+
+    // PlanetInstance of shaders.2/planet.instanced.vs, std430
+    struct Instance
+    {
+        glm::mat4 model;            // camera-relative
+        uint32_t layer;
+        uint32_t pickId;            // include/gpu_picker.h
+        float reflectivity;
+        float reflectionLod;
+    };
+    static_assert(sizeof(Instance) == 80, "planet instance layout");
+
+    // an Instance but for its model matrix, which upload() composes
+    struct Properties
+    {
+        uint32_t layer;
+        uint32_t pickId;
+        float reflectivity;
+        float reflectionLod;
+    };
+    static_assert(sizeof(Properties) == sizeof(Instance) - offsetof(Instance, layer), "planet instance tail");
+
+    // the texture array from planet's first diffuse texture, none if it has no 8-bit RGB or RGBA one
+    explicit PlanetInstances(const Model& planet)
+    {
+        buildTextures(planet);
+    }
+    PlanetInstances(const PlanetInstances&) = delete;
+    PlanetInstances& operator=(const PlanetInstances&) = delete;
+
+    unsigned int texture() const { return textures.id(); }
+    unsigned int textureLayers() const { return layers; }
+    unsigned int count() const { return static_cast<unsigned int>(shaded.size() + unshaded.size()); }
+    unsigned int visibleCount() const { return static_cast<unsigned int>(shaded.size()); }
+
+    // layer 0 for the scene's planet, otherwise one of the others picked by the body's stable id
+    unsigned int layerOf(uint32_t bodyId, bool primary) const
+    {
+        if (primary || layers <= 1)
+            return 0;
+        return 1 + ((bodyId * 2654435761u) >> 16) % (layers - 1);
+    }
+
+    void begin()
+    {
+        shaded.clear();
+        unshaded.clear();
+        shadedPlacements.clear();
+        unshadedPlacements.clear();
+    }
+
+    // a body at camera-relative at, turned by orientation and scaled by scale; inView puts it among the instances
+    // the lit passes draw, every one casts a shadow
+    void add(const glm::vec3& at, const glm::quat& orientation, float scale, const Properties& properties, bool inView)
+    {
+        (inView ? shaded : unshaded).push_back(properties);
+        (inView ? shadedPlacements : unshadedPlacements).push(at, orientation, scale);
+    }
+
+    // copies the frame's instances into the next segment of the ring, growing it to a power of two when they do not fit
+    void upload()
+    {
+        const size_t n = count();
+        if (n == 0)
+            return;
+        if (n > capacity)
+        {
+            // a power of two of at least 16 instances keeps every segment a multiple of 256 bytes, the largest
+            // SSBO offset alignment there is
+            capacity = 16;
+            while (capacity < n) capacity *= 2;
+            stream.create(capacity * sizeof(Instance), "planet instances");
+        }
+        Instance* out = static_cast<Instance*>(stream.beginWrite());
+        if (!out)
+            return;
+        write(out, shadedPlacements, shaded);
+        write(out + shaded.size(), unshadedPlacements, unshaded);
+    }
+
+    // the ring segment just written as the instances' SSBO
+    void bind() const
+    {
+        if (stream.valid())
+            glState().bindBufferRange(GL_SHADER_STORAGE_BUFFER, BINDING_INSTANCES, stream.buffer(), stream.readOffset(),
+                                      capacity * sizeof(Instance));
+    }
+
+    // the first instances of the model with shader in use: one instanced draw per mesh, each where the model's node
+    // hierarchy puts it. level is the meshes' level of detail.
+    void draw(const Model& planet, Shader& shader, unsigned int instances, unsigned int level = 0) const
+    {
+        if (instances == 0)
+            return;
+        bind();
+        for (size_t m = 0; m < planet.meshes.size(); m++)
+        {
+            const Mesh& mesh = planet.meshes[m];
+            shader.setMat4("meshTransform", planet.meshTransform(m));
+            glState().bindVertexArray(mesh.VAO);
+            mesh.drawElementsInstanced(instances, 0, level);
+        }
+    }
+
+    // call once after the frame's last draw from the instances
+    void fenceRead() { stream.fenceRead(); }
+
+private:
+    StreamingBuffer stream{GPU_MEMORY_INSTANCES};
+    size_t capacity = 0;
+    std::vector<Properties> shaded;
+    std::vector<Properties> unshaded;
+    TransformBatch shadedPlacements;
+    TransformBatch unshadedPlacements;
+    GlTexture textures{GPU_MEMORY_TEXTURES};
+    unsigned int layers = 0;
+
+    // the matrices in one pass over the records, the rest of each record after it
+    static void write(Instance* out, const TransformBatch& placements, const std::vector<Properties>& properties)
+    {
+        composeTransforms(placements, 0, placements.size(), out, sizeof(Instance));
+        for (size_t k = 0; k < properties.size(); k++)
+            std::memcpy(&out[k].layer, &properties[k], sizeof(Properties));
+    }
+
+    // decodes the texture once, uncompressed so it can be recoloured, and fills a layer per material
+    void buildTextures(const Model& planet)
+    {
+        PROFILE_SCOPE("PlanetInstances::buildTextures");
+        const Texture* diffuse = nullptr;
+        for (const Texture& texture : planet.textures_loaded)
+            if (texture.type == "texture_diffuse" && !diffuse)
+                diffuse = &texture;
+        if (!diffuse)
+            return;
+        TextureOptions options = textureCache().options(planet.gammaCorrection);
+        options.compress = false;
+        options.flipVertically = true;
+        DecodedImage image = DecodeTextureFile(planet.directory + '/' + diffuse->path, options);
+        if (!image.data || (image.components != 3 && image.components != 4))
+        {
+            freeImage(image);
+            return;
+        }
+        const GLenum format = planet.gammaCorrection ? (image.components == 4 ? GL_SRGB8_ALPHA8 : GL_SRGB8) : (image.components == 4 ? GL_RGBA8 : GL_RGB8);
+        const GLenum pixelFormat = image.components == 4 ? GL_RGBA : GL_RGB;
+        const GLsizei levels = 1 + static_cast<GLsizei>(std::floor(std::log2(static_cast<float>(std::max(image.width, image.height)))));
+        textures.create(GL_TEXTURE_2D_ARRAY, "planet materials");
+        textures.storage3D(levels, format, image.width, image.height, static_cast<GLsizei>(PLANET_MATERIAL_COUNT));
+        const size_t pixelCount = static_cast<size_t>(image.width) * image.height;
+        std::vector<unsigned char> layer(pixelCount * image.components);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (unsigned int m = 0; m < PLANET_MATERIAL_COUNT; m++)
+        {
+            std::copy(image.data, image.data + layer.size(), layer.begin());
+            if (m > 0)
+                recolorPixels(layer.data(), pixelCount, image.components, PLANET_MATERIALS[m]);
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, static_cast<GLint>(m), image.width, image.height, 1, pixelFormat, GL_UNSIGNED_BYTE, layer.data());
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glState().bindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        layers = PLANET_MATERIAL_COUNT;
+        freeImage(image);
+    }
+};
+
+#endif
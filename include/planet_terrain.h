@@ -0,0 +1,313 @@
+#ifndef PLANET_TERRAIN_H
+#define PLANET_TERRAIN_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+#include <gtc/matrix_transform.hpp>
+#include <gtc/constants.hpp>
+
+#include <shader.h>
+#include <model.h>
+#include <instance_data.h>
+#include <streaming_buffer.h>
+#include <gpu_memory.h>
+#include <gl_state_cache.h>
+#include <gl_debug.h>
+#include <depth_convention.h>
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+// Continuous distance-dependent LOD (CDLOD, Strugar 2010) on a cube sphere, for flying down to a planet whose
+// model is a few hundred vertices. Each cube face is the root of a quadtree; a node is one GRID x GRID patch of a
+// shared grid mesh, placed on the sphere in the vertex shader (shaders.2/planet.terrain.vs) and displaced by a
+// height cube map. The CPU walks the trees every frame and splits a node while its quads would span more than
+// pixelError pixels, after frustum and horizon culling, so a frame draws a few hundred nodes at most from orbit
+// down to the surface, in one instanced draw. Toward the distance at which its parent takes over, a node's
+// vertices morph onto the parent's grid, so levels meet without cracks and change without popping.
+// Both cubes are baked from the model once (bake()): its texture seen from the centre gives the albedo by
+// direction, and the albedo's luminance the heights, there being no elevation data to read.
+class PlanetTerrain
+{
+public:
+    static const unsigned int GRID = 32;            // quads along a node's edge, even for the morph
+    static const unsigned int MAX_NODES = 2048;
+    static const unsigned int BINDING_NODES = 28;   // SSBO of the vertex shader
+    static const unsigned int ALBEDO_UNIT = 18;     // layout(binding) of the cubes, after the reflection probe's
+    static const unsigned int HEIGHT_UNIT = 19;
+
+    // TerrainNode of the vertex shader, std430
+    struct Node
+    {
+        glm::vec4 originSize;       // xy the face coordinates of the node's corner, z its size, w the face
+        glm::vec4 morph;            // x y the object-space distances the morph starts and ends at, z the level
+    };
+
+    float pixelError = 4.0f;        // screen size a quad may have before its node splits
+    unsigned int maxLevel = 16;
+    float heightScale = 0.02f;      // object-space height of white in the height cube
+
+    PlanetTerrain(const char* bakeVertexPath, const char* bakeFragmentPath, unsigned int resolution = 1024)
+        : bakeShader(bakeVertexPath, bakeFragmentPath), size(resolution) {}
+    PlanetTerrain(const PlanetTerrain&) = delete;
+    PlanetTerrain& operator=(const PlanetTerrain&) = delete;
+
+    ~PlanetTerrain()
+    {
+        release();
+    }
+
+    bool baked() const { return albedo.valid(); }
+    float radius() const { return sphereRadius; }
+    unsigned int vertexArray() const { return vao.id(); }
+    size_t nodeCount() const { return nodes.size(); }
+    unsigned int deepestLevel() const { return deepest; }
+    size_t triangles() const { return nodes.size() * GRID * GRID * 2; }
+
+    // the albedo and height cubes of planet, whose object-space surface lies about planetRadius from its origin.
+    // Leaves the framebuffer and viewport to the caller.
+    void bake(Model& planet, float planetRadius)
+    {
+        GL_DEBUG_GROUP("terrain bake");
+        sphereRadius = planetRadius;
+        createGrid();
+        const unsigned int levels = 1 + static_cast<unsigned int>(std::log2(static_cast<float>(size)));
+        albedo.create(GL_TEXTURE_CUBE_MAP, "terrain albedo");
+        albedo.storage2D(levels, GL_RGBA8, size, size);
+        cubeParameters();
+        height.create(GL_TEXTURE_CUBE_MAP, "terrain height");
+        height.storage2D(levels, GL_R16F, size, size);
+        cubeParameters();
+
+        unsigned int fbo = 0;
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        const GLenum targets[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+        glDrawBuffers(2, targets);
+        glViewport(0, 0, size, size);
+        // the inside of the surface, one layer of it from the centre; no depth test, but the clip volume is the camera's
+        glDisable(GL_CULL_FACE);
+        glDisable(GL_DEPTH_TEST);
+        bakeShader.use();
+        const glm::mat4 projection = depthConvention().perspective(glm::radians(90.0f), 1.0f, 0.01f * planetRadius, 10.0f * planetRadius);
+        for (unsigned int f = 0; f < 6; f++)
+        {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + f, albedo.id(), 0);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_CUBE_MAP_POSITIVE_X + f, height.id(), 0);
+            glClear(GL_COLOR_BUFFER_BIT);
+            bakeShader.setMat4("viewProjection", projection * faceView(f));
+            planet.Draw(bakeShader);
+        }
+        glEnable(GL_DEPTH_TEST);
+        glEnable(GL_CULL_FACE);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &fbo);
+        for (GlTexture* cube : {&albedo, &height})
+        {
+            glState().bindTexture(GL_TEXTURE_CUBE_MAP, cube->id());
+            glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+        }
+        glState().bindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    }
+
+    // the nodes for a camera at the origin: model the planet's camera-relative transform (uniform scale),
+    // frustum the camera-relative view volume or null, fovY radians
+    void select(const glm::mat4& model, const Frustum* frustum, float viewportHeight, float fovY)
+    {
+        nodes.clear();
+        deepest = 0;
+        if (!baked())
+            return;
+        const glm::mat4 toObject = glm::inverse(model);
+        camera = glm::vec3(toObject * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+        worldScale = glm::length(glm::vec3(model[0]));
+        view.model = model;
+        view.frustum = frustum;
+        // pixels per unit of size at unit distance; the ratio holds in object space for a uniform scale
+        view.projScale = viewportHeight / (2.0f * std::tan(0.5f * fovY));
+        const float distance = glm::length(camera);
+        // beyond which a point at the top of the relief is behind the planet, as an angle from the camera's direction
+        view.horizon = distance > sphereRadius
+                           ? std::acos(sphereRadius / distance) + std::acos(sphereRadius / (sphereRadius + heightScale))
+                           : glm::pi<float>();
+        for (unsigned int f = 0; f < 6; f++)
+            visit(f, 0, glm::vec2(-1.0f), 2.0f);
+    }
+
+    // the selected nodes with the terrain shader in use and vertexArray() bound; fences the segment for the next
+    void draw(Shader& shader)
+    {
+        if (nodes.empty())
+            return;
+        if (!stream.valid())
+            stream.create(MAX_NODES * sizeof(Node), "terrain nodes");
+        Node* out = static_cast<Node*>(stream.beginWrite());
+        if (!out)
+            return;
+        std::copy(nodes.begin(), nodes.end(), out);
+        glState().bindBufferRange(GL_SHADER_STORAGE_BUFFER, BINDING_NODES, stream.buffer(), stream.readOffset(), nodes.size() * sizeof(Node));
+        bindCubes();
+        shader.setFloat("gridSize", static_cast<float>(GRID));
+        shader.setFloat("radius", sphereRadius);
+        shader.setFloat("heightScale", heightScale);
+        shader.setVec3("cameraObject", camera);
+        // a height texel at about pixelError pixels
+        shader.setFloat("lodScale", pixelError / (heightTexel() * view.projScale));
+        glDrawElementsInstanced(GL_TRIANGLES, GRID * GRID * 6, GL_UNSIGNED_SHORT, nullptr, static_cast<GLsizei>(nodes.size()));
+        stream.fenceRead();
+    }
+
+    // the albedo and height cubes on their units, for other draws of the baked surface (tessellated_sphere.h)
+    void bindCubes() const
+    {
+        glState().activeTexture(GL_TEXTURE0 + ALBEDO_UNIT);
+        glState().bindTexture(GL_TEXTURE_CUBE_MAP, albedo.id());
+        glState().activeTexture(GL_TEXTURE0 + HEIGHT_UNIT);
+        glState().bindTexture(GL_TEXTURE_CUBE_MAP, height.id());
+        glState().activeTexture(GL_TEXTURE0);
+    }
+
+    // object-space size of a texel of the cubes' first level, the faces' texels span pi/2 of the sphere
+    float heightTexel() const { return sphereRadius * glm::half_pi<float>() / static_cast<float>(size); }
+
+    void release()
+    {
+        albedo.release();
+        height.release();
+        stream.release();
+        vao.release();
+        vertices.release();
+        indices.release();
+        nodes.clear();
+    }
+
+    // face coordinates (-1..1, tangent-warped so the quads are near equal on the sphere) to a unit direction,
+    // faces in GL_TEXTURE_CUBE_MAP_POSITIVE_X + f order, as the vertex shader's
+    static glm::vec3 faceDirection(unsigned int face, glm::vec2 uv)
+    {
+        static const glm::vec3 normals[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+        // each cross(tangent, bitangent) is its normal, so the grid's counter-clockwise triangles face out
+        static const glm::vec3 tangents[6] = {{0, 0, -1}, {0, 0, 1}, {1, 0, 0}, {1, 0, 0}, {1, 0, 0}, {-1, 0, 0}};
+        static const glm::vec3 bitangents[6] = {{0, 1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}, {0, 1, 0}, {0, 1, 0}};
+        uv = glm::vec2(std::tan(uv.x * glm::quarter_pi<float>()), std::tan(uv.y * glm::quarter_pi<float>()));
+        return glm::normalize(normals[face] + uv.x * tangents[face] + uv.y * bitangents[face]);
+    }
+
+private:
+    struct View
+    {
+        glm::mat4 model;
+        const Frustum* frustum;
+        float projScale;
+        float horizon;
+    };
+
+    Shader bakeShader;
+    unsigned int size;
+    float sphereRadius = 1.0f;
+    GlTexture albedo{GPU_MEMORY_TEXTURES};
+    GlTexture height{GPU_MEMORY_TEXTURES};
+    GlBuffer vertices{GPU_MEMORY_GEOMETRY};
+    GlBuffer indices{GPU_MEMORY_GEOMETRY};
+    GlVertexArray vao;
+    StreamingBuffer stream{GPU_MEMORY_OTHER};
+    std::vector<Node> nodes;
+    unsigned int deepest = 0;
+    glm::vec3 camera = glm::vec3(0.0f);     // object space
+    float worldScale = 1.0f;
+    View view{};
+
+    void visit(unsigned int face, unsigned int level, const glm::vec2& origin, float nodeSize)
+    {
+        if (nodes.size() >= MAX_NODES)
+            return;
+        // a sphere around the patch: its centre on the surface, out to the corners and edge midpoints plus the relief
+        const glm::vec3 center = faceDirection(face, origin + 0.5f * nodeSize) * sphereRadius;
+        float extent = 0.0f;
+        for (int k = 0; k < 9; k++)
+        {
+            const glm::vec2 at = origin + 0.5f * nodeSize * glm::vec2(static_cast<float>(k % 3), static_cast<float>(k / 3));
+            extent = std::max(extent, glm::length(faceDirection(face, at) * sphereRadius - center));
+        }
+        extent += heightScale;
+
+        const float centerDistance = glm::length(center);
+        const float cameraDistance = glm::length(camera);
+        if (cameraDistance > 0.0f && view.horizon < glm::pi<float>())
+        {
+            const float angle = std::acos(std::clamp(glm::dot(center, camera) / (centerDistance * cameraDistance), -1.0f, 1.0f));
+            if (angle - std::asin(std::min(1.0f, extent / centerDistance)) > view.horizon)
+                return;
+        }
+        if (view.frustum && !view.frustum->intersectsSphere(glm::vec3(view.model * glm::vec4(center, 1.0f)), extent * worldScale))
+            return;
+
+        // the quads' arc length, the face coordinates being linear in angle
+        const float quad = nodeSize / GRID * sphereRadius * glm::quarter_pi<float>();
+        const float splitDistance = quad * view.projScale / std::max(pixelError, 0.1f);
+        const float distance = std::max(0.0f, glm::length(center - camera) - extent);
+        if (level < maxLevel && distance < splitDistance)
+        {
+            const float half = 0.5f * nodeSize;
+            visit(face, level + 1, origin, half);
+            visit(face, level + 1, origin + glm::vec2(half, 0.0f), half);
+            visit(face, level + 1, origin + glm::vec2(0.0f, half), half);
+            visit(face, level + 1, origin + glm::vec2(half), half);
+            return;
+        }
+        // the parent splits inside twice this node's split distance, by then the vertices are on its grid
+        const float morphEnd = level == 0 ? 1e30f : 2.0f * splitDistance;
+        nodes.push_back(Node{glm::vec4(origin, nodeSize, static_cast<float>(face)),
+                             glm::vec4(0.75f * morphEnd, morphEnd, static_cast<float>(level), 0.0f)});
+        deepest = std::max(deepest, level);
+    }
+
+    void createGrid()
+    {
+        if (vao.id() != 0)
+            return;
+        std::vector<glm::vec2> grid;
+        for (unsigned int y = 0; y <= GRID; y++)
+            for (unsigned int x = 0; x <= GRID; x++)
+                grid.emplace_back(static_cast<float>(x), static_cast<float>(y));
+        // each quad split along the diagonal from its (0, 0) corner, which the coarse positions of the morph follow
+        std::vector<uint16_t> order;
+        for (unsigned int y = 0; y < GRID; y++)
+            for (unsigned int x = 0; x < GRID; x++)
+            {
+                const uint16_t v00 = static_cast<uint16_t>(y * (GRID + 1) + x), v10 = v00 + 1;
+                const uint16_t v01 = static_cast<uint16_t>(v00 + GRID + 1), v11 = v01 + 1;
+                order.insert(order.end(), {v00, v10, v11, v00, v11, v01});
+            }
+        vao.create("terrain grid");
+        vertices.create(GL_ARRAY_BUFFER, "terrain grid vertices");
+        vertices.storage(grid.size() * sizeof(glm::vec2), grid.data(), 0);
+        indices.create(GL_ELEMENT_ARRAY_BUFFER, "terrain grid indices");
+        indices.storage(order.size() * sizeof(uint16_t), order.data(), 0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)0);
+        glState().bindVertexArray(0);
+        glState().bindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    static void cubeParameters()
+    {
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    }
+
+    // looking out of the centre through face f, as ReflectionProbe::faceView
+    static glm::mat4 faceView(unsigned int f)
+    {
+        static const glm::vec3 directions[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+        static const glm::vec3 ups[6] = {{0, -1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}, {0, -1, 0}, {0, -1, 0}};
+        return glm::lookAt(glm::vec3(0.0f), directions[f], ups[f]);
+    }
+};
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef POINT_CLOUD_H
+#define POINT_CLOUD_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <shader.h>
+#include <gpu_nbody.h>
+#include <gpu_memory.h>
+#include <gl_state_cache.h>
+
+// Bodies as additive point sprites, for scenes of millions of stars where a Model per body is out of the question.
+// One glDrawArrays of GL_POINTS reads GpuNBody's buffers by vertex id (shaders.2/point.cloud.vs): the position from
+// BINDING_POSITION_MASS and a luminosity from BINDING_SCALE, the radius scale the galaxy generator (galaxy.h) gives
+// its stars. Nothing per body passes the CPU. The sprites are added onto the HDR scene without depth writes or
+// sorting, so overlapping stars sum; the log-luminance tone mapping of SceneTarget keeps both the cores and the
+// faint outskirts in range.
+class PointCloud
+{
+public:
+    float pointSize = 1.5f;         // pixels at luminosity 1
+    float brightness = 0.05f;
+    glm::vec3 warmColor = glm::vec3(1.0f, 0.75f, 0.45f);
+    glm::vec3 coolColor = glm::vec3(0.55f, 0.7f, 1.0f);
+
+    PointCloud(const char* vertexPath, const char* fragmentPath) : shader(vertexPath, fragmentPath) {}
+    PointCloud(const PointCloud&) = delete;
+    PointCloud& operator=(const PointCloud&) = delete;
+
+    ~PointCloud()
+    {
+        emptyVao.release();
+    }
+
+    Shader& program() { return shader; }
+    // empty, bound for draw()
+    unsigned int vertexArray()
+    {
+        if (emptyVao.id() == 0)
+        {
+            emptyVao.create("point cloud");
+            glState().bindVertexArray(0);
+        }
+        return emptyVao.id();
+    }
+
+    // nbody's bodies from first on, with the shader in use and vertexArray() bound. Depth is tested but not
+    // written, and only the first colour attachment is written.
+    void draw(const GpuNBody& nbody, unsigned int first, const glm::vec3& origin)
+    {
+        if (first >= nbody.bodyCount)
+            return;
+        nbody.bind();
+        drawPoints(first, nbody.bodyCount - first, origin);
+    }
+
+    // the same for count points of other buffers laid out like GpuNBody's (the SPH gas, gpu_sph.h), bound in its
+    // place for the draw; GpuNBody::bind() puts the bodies back
+    void draw(GLuint positionMass, GLuint luminosity, unsigned int count, const glm::vec3& origin)
+    {
+        if (count == 0 || positionMass == 0 || luminosity == 0)
+            return;
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, GpuNBody::BINDING_POSITION_MASS, positionMass);
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, GpuNBody::BINDING_SCALE, luminosity);
+        drawPoints(0, count, origin);
+    }
+
+private:
+    Shader shader;
+    GlVertexArray emptyVao;
+
+    void drawPoints(unsigned int first, unsigned int count, const glm::vec3& origin)
+    {
+        shader.setUInt("first", first);
+        shader.setVec3("origin", origin);
+        shader.setFloat("pointSize", pointSize);
+        shader.setFloat("brightness", brightness);
+        shader.setVec3("warmColor", warmColor);
+        shader.setVec3("coolColor", coolColor);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        glDepthMask(GL_FALSE);
+        glColorMaski(1, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(count));
+        glColorMaski(1, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthMask(GL_TRUE);
+        glDisable(GL_BLEND);
+    }
+};
+
+#endif
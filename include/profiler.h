@@ -0,0 +1,243 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Scoped CPU markers for a timeline of the frame, where a single slow frame shows up that an FPS average hides.
+// PROFILE_SCOPE("name") times the enclosing block into a buffer of the calling thread's own, so recording takes
+// no lock: the buffer is a ring of the thread's last CAPACITY events, found through a thread_local pointer after
+// its first use registers it. writeTrace() dumps every thread's ring as Chrome trace JSON, which chrome://tracing
+// and ui.perfetto.dev both open. Names must be string literals (or otherwise outlive the profiler); a detail string
+// is copied, cut at DETAIL_LENGTH. Building with DISABLE_PROFILING compiles the markers away.
+class Profiler
+{
+public:
+    static const unsigned int CAPACITY = 1u << 14;  // events per thread, older ones are overwritten
+    static const unsigned int DETAIL_LENGTH = 47;
+
+    struct Event
+    {
+        const char* name;
+        int64_t startNs;
+        int64_t endNs;
+        char detail[DETAIL_LENGTH + 1];
+    };
+
+    Profiler() : epoch(std::chrono::steady_clock::now()) {}
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    // off, markers return at once and nothing is recorded
+    void setEnabled(bool on) { enabled.store(on, std::memory_order_relaxed); }
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    int64_t now() const
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    // the name of the calling thread's innermost open ProfileScope, null outside any; a thread_local of a trivial
+    // type, so keeping it up costs a scope two plain stores
+    static const char*& currentScope()
+    {
+        thread_local const char* name = nullptr;
+        return name;
+    }
+
+    // the calling thread's name in the trace, e.g. "main"
+    void nameThread(const char* name)
+    {
+        ThreadBuffer& buffer = local();
+        std::lock_guard<std::mutex> lock(mutex);
+        buffer.name = name;
+    }
+
+    void record(const char* name, int64_t startNs, int64_t endNs, const char* detail = nullptr)
+    {
+        ThreadBuffer& buffer = local();
+        const uint64_t index = buffer.written.load(std::memory_order_relaxed);
+        Event& event = buffer.events[index % CAPACITY];
+        event.name = name;
+        event.startNs = startNs;
+        event.endNs = endNs;
+        event.detail[0] = '\0';
+        if (detail)
+        {
+            std::strncpy(event.detail, detail, DETAIL_LENGTH);
+            event.detail[DETAIL_LENGTH] = '\0';
+        }
+        // published after the event is written, a dump reads no further
+        buffer.written.store(index + 1, std::memory_order_release);
+    }
+
+    // Every thread's recorded events as Chrome trace JSON ("X" events in microseconds). Other threads keep
+    // recording meanwhile: an event a thread overwrote while it was copied is left out. False when the file
+    // cannot be written.
+    bool writeTrace(const std::string& path, size_t* eventsWritten = nullptr)
+    {
+        std::FILE* file = std::fopen(path.c_str(), "w");
+        if (!file)
+            return false;
+        std::vector<Event> copy;
+        size_t total = 0;
+        std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        bool first = true;
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t t = 0; t < buffers.size(); t++)
+        {
+            const ThreadBuffer& buffer = *buffers[t];
+            std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%zu,\"args\":{\"name\":\"%s\"}}",
+                         first ? "" : ",\n", t, escaped(buffer.name).c_str());
+            first = false;
+            const uint64_t end = buffer.written.load(std::memory_order_acquire);
+            const uint64_t begin = end > CAPACITY ? end - CAPACITY : 0;
+            copy.assign(buffer.events, buffer.events + CAPACITY);
+            // slots the thread reached while they were copied may hold newer events
+            const uint64_t after = buffer.written.load(std::memory_order_acquire);
+            const uint64_t valid = after > CAPACITY ? std::max(begin, after - CAPACITY) : begin;
+            for (uint64_t i = valid; i < end; i++)
+            {
+                const Event& event = copy[i % CAPACITY];
+                std::fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%zu,\"ts\":%.3f,\"dur\":%.3f",
+                             escaped(event.name).c_str(), t, event.startNs * 1e-3, (event.endNs - event.startNs) * 1e-3);
+                if (event.detail[0] != '\0')
+                    std::fprintf(file, ",\"args\":{\"detail\":\"%s\"}", escaped(event.detail).c_str());
+                std::fputc('}', file);
+                total++;
+            }
+        }
+        std::fprintf(file, "\n]}\n");
+        const bool ok = std::fclose(file) == 0;
+        if (eventsWritten)
+            *eventsWritten = total;
+        return ok;
+    }
+
+private:
+    struct ThreadBuffer
+    {
+        Event events[CAPACITY];
+        std::atomic<uint64_t> written{0};
+        const char* name = "worker";
+    };
+
+    std::chrono::steady_clock::time_point epoch;
+    std::atomic<bool> enabled{true};
+    std::mutex mutex;                                   // guards buffers, never taken by record()
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers; // kept after their threads exit, for the dump
+
+    // the calling thread's buffer, registered on its first event
+    ThreadBuffer& local()
+    {
+        thread_local ThreadBuffer* buffer = nullptr;
+        if (!buffer)
+        {
+            std::unique_ptr<ThreadBuffer> created(new ThreadBuffer());
+            buffer = created.get();
+            std::lock_guard<std::mutex> lock(mutex);
+            buffers.push_back(std::move(created));
+        }
+        return *buffer;
+    }
+
+    static std::string escaped(const char* text)
+    {
+        std::string out;
+        for (const char* c = text ? text : ""; *c; c++)
+        {
+            if (*c == '"' || *c == '\\')
+                out += '\\';
+            if (static_cast<unsigned char>(*c) >= 0x20)
+                out += *c;
+        }
+        return out;
+    }
+};
+
+inline Profiler& profiler()
+{
+    static Profiler instance;
+    return instance;
+}
+
+// times its own lifetime into profiler(), and is the thread's Profiler::currentScope() meanwhile
+class ProfileScope
+{
+public:
+    explicit ProfileScope(const char* name, const char* detail = nullptr)
+        : name(name), detail(detail), startNs(profiler().isEnabled() ? profiler().now() : -1)
+    {
+        if (startNs < 0)
+            return;
+        parent = Profiler::currentScope();
+        Profiler::currentScope() = name;
+    }
+
+    // a std::string detail, copied when the scope ends
+    ProfileScope(const char* name, const std::string& detail) : ProfileScope(name, detail.c_str()) {}
+
+    ~ProfileScope()
+    {
+        if (startNs < 0)
+            return;
+        profiler().record(name, startNs, profiler().now(), detail);
+        Profiler::currentScope() = parent;
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char* name;
+    const char* detail;
+    const char* parent = nullptr;
+    int64_t startNs;
+};
+
+// consecutive stages of a longer block, each timed from the mark before it (or the construction) to its own
+class ProfileStages
+{
+public:
+    ProfileStages() : lastNs(profiler().isEnabled() ? profiler().now() : -1) {}
+
+    void mark(const char* name)
+    {
+        if (!profiler().isEnabled())
+        {
+            lastNs = -1;
+            return;
+        }
+        const int64_t nowNs = profiler().now();
+        if (lastNs >= 0)
+            profiler().record(name, lastNs, nowNs);
+        lastNs = nowNs;
+    }
+
+private:
+    int64_t lastNs;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifdef DISABLE_PROFILING
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_SCOPE_DETAIL(name, detail) ((void)0)
+#else
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+// the detail, a C or std::string, must live until the end of the scope
+#define PROFILE_SCOPE_DETAIL(name, detail) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name, detail)
+#endif
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__func__)
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <mapped_file.h>
+
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+// Linked programs saved with glGetProgramBinary and loaded back with glProgramBinary on the next run, so Shader
+// skips compiling and linking GLSL it has seen before. A program is keyed by a hash of its stages' source text and
+// the driver's vendor, renderer and version strings; a new driver or an edited shader misses and is compiled as
+// usual, and so is a binary the driver refuses (drivers may reject their own binaries after an update). One file
+// per program in PROGRAM_CACHE_DIRECTORY, relative to the working directory like the shader paths are.
+namespace program_cache {
+
+static const char MAGIC[8] = {'N', 'P', 'R', 'O', 'G', 'B', 'I', 'N'};
+static const uint32_t VERSION = 1;
+static const char PROGRAM_CACHE_DIRECTORY[] = "shader_cache";
+
+struct Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerBytes;
+    uint64_t key;
+    uint32_t binaryFormat;
+    uint32_t binaryBytes;
+};
+
+static_assert(sizeof(Header) == 32, "the program cache header is part of the file format");
+
+// a stage of a program and its source text
+typedef std::vector<std::pair<GLenum, std::string>> Sources;
+
+inline uint64_t fnv1a(const void* data, size_t bytes, uint64_t hash)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < bytes; i++)
+        hash = (hash ^ p[i]) * 0x100000001b3ull;
+    return hash;
+}
+
+inline uint64_t hashString(const char* text, uint64_t hash)
+{
+    // the terminator too, so "a"+"bc" and "ab"+"c" differ
+    return text ? fnv1a(text, std::strlen(text) + 1, hash) : fnv1a("", 1, hash);
+}
+
+// the key of a program: its stages and the driver that would compile them
+inline uint64_t keyOf(const Sources& sources)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION})
+        hash = hashString(reinterpret_cast<const char*>(glGetString(name)), hash);
+    for (const auto& stage : sources)
+    {
+        hash = fnv1a(&stage.first, sizeof(stage.first), hash);
+        hash = hashString(stage.second.c_str(), hash);
+    }
+    return hash;
+}
+
+inline std::string pathFor(uint64_t key)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "/%016llx.glbin", static_cast<unsigned long long>(key));
+    return std::string(PROGRAM_CACHE_DIRECTORY) + name;
+}
+
+// off, every program is compiled from source and nothing is saved; for timing the compile itself
+inline bool& enabled()
+{
+    static bool on = true;
+    return on;
+}
+
+// the driver writes no binaries at all when it supports no format
+inline bool supported()
+{
+    if (!enabled())
+        return false;
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+// links program from the cached binary, false if there is none for key or the driver does not take it
+inline bool load(GLuint program, uint64_t key)
+{
+    MappedFile file;
+    if (!file.open(pathFor(key).c_str(), true) || file.size() < sizeof(Header))
+        return false;
+    Header header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || header.headerBytes != sizeof(Header)
+        || header.key != key || header.binaryBytes != file.size() - sizeof(Header))
+        return false;
+    glProgramBinary(program, header.binaryFormat, file.data() + sizeof(Header), static_cast<GLsizei>(header.binaryBytes));
+    GLint linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    return linked != 0;
+}
+
+// saves a linked program under key, through a temporary file. A failure only costs the next run its compile.
+inline void store(GLuint program, uint64_t key)
+{
+    GLint bytes = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &bytes);
+    if (bytes <= 0)
+        return;
+    std::vector<unsigned char> image(sizeof(Header) + static_cast<size_t>(bytes));
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.headerBytes = sizeof(Header);
+    header.key = key;
+    GLsizei written = 0;
+    GLenum format = 0;
+    glGetProgramBinary(program, bytes, &written, &format, image.data() + sizeof(Header));
+    if (written <= 0)
+        return;
+    header.binaryFormat = format;
+    header.binaryBytes = static_cast<uint32_t>(written);
+    std::memcpy(image.data(), &header, sizeof(header));
+    image.resize(sizeof(Header) + static_cast<size_t>(written));
+
+    mkdir(PROGRAM_CACHE_DIRECTORY, 0755);    // fails harmlessly when it exists
+    const std::string path = pathFor(key);
+    const std::string partial = path + ".partial";
+    FILE* f = std::fopen(partial.c_str(), "wb");
+    if (!f)
+        return;
+    bool ok = std::fwrite(image.data(), 1, image.size(), f) == image.size();
+    ok = std::fclose(f) == 0 && ok;
+    ok = ok && std::rename(partial.c_str(), path.c_str()) == 0;
+    if (!ok)
+        std::remove(partial.c_str());
+}
+
+} // namespace program_cache
+
+#endif
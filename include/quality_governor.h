@@ -0,0 +1,232 @@
+#ifndef QUALITY_GOVERNOR_H
+#define QUALITY_GOVERNOR_H
+
+#include <algorithm>
+
+// What the governor lets a frame have, applied over the user's settings: each knob only ever takes quality away
+// from what was chosen, and at level 0 of both ladders every knob is neutral.
+struct QualitySettings
+{
+    float lodPixelScale = 1.0f;             // the LOD thresholds in pixels times this, coarser levels sooner
+    float impostorDistanceScale = 1.0f;     // point impostors from this much of their distance on
+    unsigned int shadowResolutionShift = 0; // the sun's shadow cube at its resolution >> this
+    unsigned int shadowInterval = 1;        // and redrawn every this many frames
+    unsigned int maxSamples = 0;            // MSAA samples at most, 0 for the user's
+    unsigned int maxPhysicsSteps = 0;       // fixed physics steps per frame at most, 0 for the user's
+    float trailLengthScale = 1.0f;
+};
+
+// Holds a frame-time budget by turning quality knobs down and back up, past what dynamic resolution can do alone
+// when the vertices, the shadow or the physics are what is slow. The knobs sit on two ladders of levels, each
+// level a little cheaper than the one before: the GPU's (MSAA, the shadow's update rate and resolution, the LOD
+// and impostor distances) and the CPU's (physics steps per frame, trail length). Each frame the smoothed CPU and GPU
+// times are compared against targetMs, and the side that is over gets one level down after a few frames, two when
+// it is far over, so a spike is answered within a handful of frames. The GPU ladder waits while dynamic resolution
+// still has room to drop, and climbs back only once the resolution is whole again.
+//
+// Coming back is deliberately slow: a ladder climbs one level after holdFrames in a row under raiseBand of the
+// target, and a level it has to give up again within a bounce window doubles the frames the next climb waits,
+// so a level that does not fit is not retried every second; a ladder that has gone long without dropping halves
+// the wait again. After any change a ladder waits for measurements of the new level, the GPU's arriving its
+// latency late.
+class QualityGovernor
+{
+public:
+    static constexpr unsigned int GPU_LEVELS = 8;
+    static constexpr unsigned int CPU_LEVELS = 6;
+
+    bool enabled = false;
+    float targetMs = 15.0f;         // CPU and GPU time per frame to hold, under a 60 Hz frame with some room
+    float raiseBand = 0.7f;         // of the target, below which a ladder may climb
+    unsigned int holdFrames = 120;  // under the band before a climb, doubled by a bounce up to MAX_HOLD_FRAMES
+
+    static constexpr unsigned int MAX_HOLD_FRAMES = 3600;
+
+    struct Ladder
+    {
+        unsigned int level = 0;
+        float smoothedMs = 0.0f;
+        unsigned int measuredFrames = 0;    // since the last change
+        unsigned int overFrames = 0;
+        unsigned int underFrames = 0;
+        unsigned int settle = 0;            // frames before measurements reflect the level
+        unsigned int hold = 0;              // frames under the band this ladder needs to climb
+        unsigned long long raisedAt = 0;    // frame of its last climb
+        unsigned long long loweredAt = 0;   // and of its last drop
+        unsigned int changes = 0;
+    };
+
+    const Ladder& gpuLadder() const { return gpu; }
+    const Ladder& cpuLadder() const { return cpu; }
+    const QualitySettings& settings() const { return current; }
+
+    // what is off at the current levels, for the overlay
+    static const char* gpuLevelName(unsigned int level)
+    {
+        static const char* names[GPU_LEVELS] = {"full", "shadow every 2nd frame", "MSAA 2x", "coarser LODs",
+                                                "half-resolution shadow", "no MSAA, nearer impostors",
+                                                "quarter-resolution shadow", "lowest"};
+        return names[std::min(level, GPU_LEVELS - 1)];
+    }
+
+    static const char* cpuLevelName(unsigned int level)
+    {
+        static const char* names[CPU_LEVELS] = {"full", "4 physics steps", "half trails", "2 physics steps",
+                                                "quarter trails", "1 physics step"};
+        return names[std::min(level, CPU_LEVELS - 1)];
+    }
+
+    // one frame's CPU time and its GPU time as read back (0 when none arrived), latency frames late. gpuHeadroom
+    // is whether dynamic resolution can still drop, gpuFullResolution whether it is back at full scale. True when
+    // the settings changed.
+    bool update(float cpuMs, float gpuMs, unsigned int latency, bool gpuHeadroom, bool gpuFullResolution)
+    {
+        frame++;
+        if (!enabled)
+        {
+            if (gpu.level == 0 && cpu.level == 0)
+                return false;
+            gpu = Ladder();
+            cpu = Ladder();
+            current = QualitySettings();
+            return true;
+        }
+        const bool gpuMeasured = measure(gpu, gpuMs);
+        const bool cpuMeasured = measure(cpu, cpuMs);
+
+        // down: the side furthest over, the other when it is at the bottom already
+        const bool gpuOver = gpuMeasured && !gpuHeadroom && overBudget(gpu);
+        const bool cpuOver = cpuMeasured && overBudget(cpu);
+        bool changed = false;
+        if (gpuOver || cpuOver)
+        {
+            const bool gpuFirst = gpuOver && (!cpuOver || gpu.smoothedMs >= cpu.smoothedMs);
+            Ladder& first = gpuFirst ? gpu : cpu;
+            Ladder& second = gpuFirst ? cpu : gpu;
+            const bool secondOver = gpuFirst ? cpuOver : gpuOver;
+            changed = lower(first, gpuFirst ? GPU_LEVELS : CPU_LEVELS, gpuFirst ? latency + 1 : 1u) ||
+                      (secondOver && lower(second, gpuFirst ? CPU_LEVELS : GPU_LEVELS, gpuFirst ? 1u : latency + 1));
+        }
+        // up: each side on its own, the GPU's once the resolution is whole
+        if (gpuMeasured && gpuFullResolution && !gpuOver)
+            changed = raise(gpu, latency + 1) || changed;
+        if (cpuMeasured && !cpuOver)
+            changed = raise(cpu, 1u) || changed;
+        if (changed)
+            current = settingsFor(gpu.level, cpu.level);
+        return changed;
+    }
+
+    // the knobs at a pair of levels
+    static QualitySettings settingsFor(unsigned int gpuLevel, unsigned int cpuLevel)
+    {
+        //                                               LOD   impostor shift interval samples
+        static const float gpuRows[GPU_LEVELS][5] = {{1.0f, 1.0f,  0.0f, 1.0f, 0.0f},
+                                                     {1.0f, 1.0f,  0.0f, 2.0f, 0.0f},
+                                                     {1.0f, 1.0f,  0.0f, 2.0f, 2.0f},
+                                                     {1.6f, 0.75f, 0.0f, 2.0f, 2.0f},
+                                                     {1.6f, 0.75f, 1.0f, 2.0f, 2.0f},
+                                                     {2.5f, 0.5f,  1.0f, 3.0f, 1.0f},
+                                                     {2.5f, 0.5f,  2.0f, 4.0f, 1.0f},
+                                                     {4.0f, 0.3f,  2.0f, 6.0f, 1.0f}};
+        //                                          steps trails
+        static const float cpuRows[CPU_LEVELS][2] = {{0.0f, 1.0f},
+                                                     {4.0f, 1.0f},
+                                                     {4.0f, 0.5f},
+                                                     {2.0f, 0.5f},
+                                                     {2.0f, 0.25f},
+                                                     {1.0f, 0.25f}};
+        const float* g = gpuRows[std::min(gpuLevel, GPU_LEVELS - 1)];
+        const float* c = cpuRows[std::min(cpuLevel, CPU_LEVELS - 1)];
+        QualitySettings s;
+        s.lodPixelScale = g[0];
+        s.impostorDistanceScale = g[1];
+        s.shadowResolutionShift = static_cast<unsigned int>(g[2]);
+        s.shadowInterval = static_cast<unsigned int>(g[3]);
+        s.maxSamples = static_cast<unsigned int>(g[4]);
+        s.maxPhysicsSteps = static_cast<unsigned int>(c[0]);
+        s.trailLengthScale = c[1];
+        return s;
+    }
+
+private:
+    static constexpr unsigned int OVER_FRAMES = 3;      // in a row over the target before a level goes
+    static constexpr float FAR_OVER = 1.35f;        // of the target, over which two levels go at once
+
+    Ladder gpu;
+    Ladder cpu;
+    QualitySettings current;
+    unsigned long long frame = 0;
+
+    // folds a time into the ladder's average, false while it settles or when there is no time
+    static bool measure(Ladder& ladder, float ms)
+    {
+        if (ms <= 0.0f)
+            return false;
+        if (ladder.settle > 0)
+        {
+            ladder.settle--;
+            return false;
+        }
+        ladder.smoothedMs = ladder.measuredFrames > 0 ? ladder.smoothedMs + 0.3f * (ms - ladder.smoothedMs) : ms;
+        ladder.measuredFrames++;
+        return true;
+    }
+
+    bool overBudget(Ladder& ladder) const
+    {
+        if (ladder.smoothedMs <= targetMs)
+        {
+            ladder.overFrames = 0;
+            return false;
+        }
+        ladder.overFrames++;
+        return ladder.overFrames >= OVER_FRAMES || ladder.smoothedMs > FAR_OVER * targetMs;
+    }
+
+    bool lower(Ladder& ladder, unsigned int levels, unsigned int settle)
+    {
+        if (ladder.level + 1 >= levels)
+            return false;
+        // given up soon after a climb: the level did not fit, wait longer before trying it again
+        const unsigned int base = std::max(holdFrames, 1u);
+        if (ladder.raisedAt > 0 && frame - ladder.raisedAt < 2ull * std::max(ladder.hold, base))
+            ladder.hold = std::min(2 * std::max(ladder.hold, base), MAX_HOLD_FRAMES);
+        const unsigned int steps = ladder.smoothedMs > FAR_OVER * targetMs ? 2u : 1u;
+        ladder.level = std::min(ladder.level + steps, levels - 1);
+        ladder.loweredAt = frame;
+        reset(ladder, settle);
+        return true;
+    }
+
+    bool raise(Ladder& ladder, unsigned int settle)
+    {
+        if (ladder.level == 0)
+            return false;
+        if (ladder.smoothedMs >= raiseBand * targetMs)
+        {
+            ladder.underFrames = 0;
+            return false;
+        }
+        const unsigned int base = std::max(holdFrames, 1u);
+        if (++ladder.underFrames < std::max(ladder.hold, base))
+            return false;
+        if (ladder.hold > base && frame - ladder.loweredAt > 4ull * ladder.hold)
+            ladder.hold = std::max(ladder.hold / 2, base);
+        ladder.level--;
+        ladder.raisedAt = frame;
+        reset(ladder, settle);
+        return true;
+    }
+
+    static void reset(Ladder& ladder, unsigned int settle)
+    {
+        ladder.settle = settle;
+        ladder.measuredFrames = 0;
+        ladder.overFrames = 0;
+        ladder.underFrames = 0;
+        ladder.changes++;
+    }
+};
+
+#endif
@@ -0,0 +1,178 @@
+#ifndef REFLECTION_PROBE_H
+#define REFLECTION_PROBE_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+#include <gtc/matrix_transform.hpp>
+
+#include <shader.h>
+#include <gpu_memory.h>
+#include <depth_convention.h>
+
+#include <algorithm>
+#include <iostream>
+
+// A dynamic environment map: the scene around a point rendered into an R11F_G11F_B10F cube map, facesPerFrame
+// faces at a time in turn, so a full refresh is spread over 6 / facesPerFrame frames. Each time the last face of a
+// round is drawn, the mips are prefiltered in compute (shaders.2/reflection.prefilter.cs) for a roughness rising
+// with the level, which shaders read with textureLod. The first update draws all six faces, so the map is never
+// read half empty.
+class ReflectionProbe
+{
+public:
+    static const unsigned int TEXTURE_UNIT = 17;    // where bind() puts the cube, next to the sun's shadow cube
+    static const unsigned int MAX_SIZE = 1024;
+
+    unsigned int facesPerFrame = 1;     // 0 freezes the probe, 6 redraws it every frame
+    float nearPlane = 0.1f;
+    float farPlane = 2000.0f;
+
+    explicit ReflectionProbe(const char* prefilterPath, unsigned int resolution = 128)
+        : prefilterShader(prefilterPath), size(std::clamp(resolution, 8u, MAX_SIZE)) {}
+
+    ~ReflectionProbe()
+    {
+        release();
+    }
+
+    unsigned int texture() const { return cube.id(); }
+    unsigned int resolution() const { return size; }
+    unsigned int levels() const { return levelCount; }
+    // faces drawn by the last update
+    unsigned int facesDrawn() const { return drawnLastUpdate; }
+
+    // a new face size, the map is redrawn whole on the next update
+    void setResolution(unsigned int resolution)
+    {
+        resolution = std::clamp(resolution, 8u, MAX_SIZE);
+        if (resolution == size)
+            return;
+        release();
+        size = resolution;
+    }
+
+    // the next faces around center (camera-relative) through drawScene(view, projection), then, at the end of a
+    // round, the prefiltered mips. Leaves the framebuffer and viewport to the caller.
+    template <typename F>
+    void update(const glm::vec3& center, const F& drawScene)
+    {
+        drawnLastUpdate = 0;
+        if (facesPerFrame == 0 && complete)
+            return;
+        GL_DEBUG_GROUP("reflection probe");
+        prepare();
+        const unsigned int faces = complete ? std::min(facesPerFrame, 6u) : 6u;
+        const glm::mat4 projection = depthConvention().perspective(glm::radians(90.0f), 1.0f, nearPlane, farPlane);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glViewport(0, 0, size, size);
+        for (unsigned int k = 0; k < faces; k++)
+        {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + nextFace, cube.id(), 0);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            drawScene(faceView(nextFace, center), projection);
+            nextFace = (nextFace + 1) % 6;
+            drawnLastUpdate++;
+            if (nextFace == 0)
+            {
+                complete = true;
+                prefilterPending = true;
+            }
+        }
+        if (prefilterPending)
+            prefilter();
+    }
+
+    // the cube on TEXTURE_UNIT for the shaders that reflect it
+    void bind() const
+    {
+        glState().activeTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+        glState().bindTexture(GL_TEXTURE_CUBE_MAP, cube.id());
+        glState().activeTexture(GL_TEXTURE0);
+    }
+
+    void release()
+    {
+        if (fbo != 0) glDeleteFramebuffers(1, &fbo);
+        fbo = 0;
+        cube.release();
+        depth.release();
+        levelCount = 0;
+        nextFace = 0;
+        complete = false;
+        prefilterPending = false;
+    }
+
+private:
+    Shader prefilterShader;
+    unsigned int size;
+    unsigned int levelCount = 0;
+    unsigned int fbo = 0;
+    GlTexture cube{GPU_MEMORY_RENDER_TARGETS};
+    GlTexture depth{GPU_MEMORY_RENDER_TARGETS};
+    unsigned int nextFace = 0;
+    unsigned int drawnLastUpdate = 0;
+    bool complete = false;
+    bool prefilterPending = false;
+
+    // looking out of center through face f, GL_TEXTURE_CUBE_MAP_POSITIVE_X + f order, as CubeShadowMap::faceMatrices
+    static glm::mat4 faceView(unsigned int f, const glm::vec3& center)
+    {
+        static const glm::vec3 directions[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+        static const glm::vec3 ups[6] = {{0, -1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}, {0, -1, 0}, {0, -1, 0}};
+        return glm::lookAt(center, center + directions[f], ups[f]);
+    }
+
+    // levels 1 and below from the ones above them, every face at once
+    void prefilter()
+    {
+        GL_DEBUG_GROUP("reflection prefilter");
+        prefilterPending = false;
+        prefilterShader.use();
+        prefilterShader.setInt("source", 0);
+        prefilterShader.setInt("levels", static_cast<int>(levelCount));
+        prefilterShader.setFloat("sourceSize", static_cast<float>(size));
+        glState().activeTexture(GL_TEXTURE0);
+        glState().bindTexture(GL_TEXTURE_CUBE_MAP, cube.id());
+        for (unsigned int level = 1; level < levelCount; level++)
+        {
+            const unsigned int levelSize = std::max(size >> level, 1u);
+            prefilterShader.setInt("level", static_cast<int>(level));
+            glBindImageTexture(0, cube.id(), static_cast<GLint>(level), GL_TRUE, 0, GL_WRITE_ONLY, GL_R11F_G11F_B10F);
+            glDispatchCompute((levelSize + 7) / 8, (levelSize + 7) / 8, 6);
+            glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        }
+        glState().bindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    }
+
+    void prepare()
+    {
+        if (fbo != 0)
+            return;
+        // down to 8 texels a face, where the roughest level is all but uniform anyway
+        levelCount = 1;
+        while ((size >> levelCount) >= 8)
+            levelCount++;
+        cube.create(GL_TEXTURE_CUBE_MAP, "reflection probe");
+        cube.storage2D(levelCount, GL_R11F_G11F_B10F, size, size);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glState().bindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        depth.create(GL_TEXTURE_2D, "reflection probe depth");
+        depth.storage2D(1, depthConvention().depthFormat(false), size, size);
+        glState().bindTexture(GL_TEXTURE_2D, 0);
+
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        labelObject(GL_FRAMEBUFFER, fbo, "reflection probe");
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X, cube.id(), 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth.id(), 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::REFLECTION_PROBE:: Framebuffer is not complete" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+};
+
+#endif
@@ -0,0 +1,380 @@
+#ifndef RENDER_DEVICE_H
+#define RENDER_DEVICE_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <shader.h>
+#include <mesh.h>
+#include <gl_state_cache.h>
+#include <gl_debug.h>
+#include <gpu_memory.h>
+#include <thread_pool.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// A thin device under the renderer: buffers, images and pipelines made through it, and command lists that can be
+// recorded on any thread and are submitted to a queue on the thread owning the device. Recording touches no API
+// state, a list is plain data, so the draws of many unique objects can be recorded by the worker pool
+// (recordParallel) and only the submit is serial. Handles are the backend's names; uniform locations in a list
+// must come from Shader::uniform() on the device's thread beforehand, the locations of a pipeline's program.
+//
+// GlRenderDevice is the only backend: a GL context is current on one thread, so its submit replays the lists
+// there through glState(), and its compute queue is the graphics queue. A backend with real queues keeps the
+// interface and submits QUEUE_COMPUTE lists (the N-body and culling dispatches) next to the graphics ones.
+
+enum RenderQueueType {
+    QUEUE_GRAPHICS = 0,
+    QUEUE_COMPUTE = 1
+};
+
+struct DeviceBuffer { uint32_t id = 0; };
+struct DeviceImage { uint32_t id = 0; GLenum target = GL_TEXTURE_2D; };
+struct DevicePipeline { uint32_t id = 0; };
+// a vertex input state with its buffers, a GL vertex array
+struct DeviceVertexInput { uint32_t id = 0; };
+
+struct ImageDesc
+{
+    GLenum target = GL_TEXTURE_2D;
+    GLenum format = GL_RGBA8;
+    unsigned int width = 1;
+    unsigned int height = 1;
+    unsigned int layers = 1;        // array layers or depth, 1 for a plain 2D image
+    unsigned int levels = 1;
+    const char* label = "device image";
+};
+
+// a program with the fixed-function state it is drawn with
+struct PipelineDesc
+{
+    Shader* shader = nullptr;
+    GLenum depthFunc = GL_LESS;
+    bool depthWrite = true;
+    bool colorWrite = true;
+    bool blend = false;             // premultiplied alpha
+    bool cullBackFaces = false;
+};
+
+// Commands recorded for a later submit. All of them take handles and values, none touches the API.
+class CommandList
+{
+public:
+    void reset() { commands.clear(); }
+    bool empty() const { return commands.empty(); }
+    size_t size() const { return commands.size(); }
+
+    void bindPipeline(DevicePipeline pipeline) { add(BIND_PIPELINE).a = pipeline.id; }
+    void bindVertexInput(DeviceVertexInput input) { add(BIND_VERTEX_INPUT).a = input.id; }
+
+    // a range of a buffer at a binding of GL_UNIFORM_BUFFER or GL_SHADER_STORAGE_BUFFER, bytes 0 for all of it
+    void bindBuffer(GLenum target, unsigned int binding, DeviceBuffer buffer, size_t offset = 0, size_t bytes = 0)
+    {
+        Command& c = add(BIND_BUFFER);
+        c.a = target;
+        c.b = binding;
+        c.c = buffer.id;
+        c.offset = offset;
+        c.bytes = bytes;
+    }
+
+    void bindImage(unsigned int unit, DeviceImage image)
+    {
+        Command& c = add(BIND_IMAGE);
+        c.a = unit;
+        c.b = image.id;
+        c.c = image.target;
+    }
+
+    // uniforms of the program in use when the command runs, the bound pipeline's or the caller's; push constants
+    // elsewhere
+    void setUInt(int location, unsigned int value) { Command& c = add(SET_UINT); c.a = static_cast<uint32_t>(location); c.b = value; }
+    void setFloat(int location, float value) { Command& c = add(SET_FLOAT); c.a = static_cast<uint32_t>(location); c.values[0] = value; }
+    void setVec4(int location, const glm::vec4& value)
+    {
+        Command& c = add(SET_VEC4);
+        c.a = static_cast<uint32_t>(location);
+        for (int k = 0; k < 4; k++) c.values[k] = value[k];
+    }
+
+    void drawIndexed(GLenum mode, unsigned int count, GLenum indexType, size_t indexOffset, int baseVertex,
+                     unsigned int instances = 1, unsigned int baseInstance = 0)
+    {
+        Command& c = add(DRAW_INDEXED);
+        c.a = mode;
+        c.b = count;
+        c.c = indexType;
+        c.offset = indexOffset;
+        c.baseVertex = baseVertex;
+        c.instances = instances;
+        c.baseInstance = baseInstance;
+    }
+
+    // drawCount GL_DRAW_INDIRECT_BUFFER commands from offset of buffer, stride apart
+    void drawIndexedIndirect(GLenum mode, GLenum indexType, DeviceBuffer buffer, size_t offset, unsigned int drawCount, unsigned int stride)
+    {
+        Command& c = add(DRAW_INDEXED_INDIRECT);
+        c.a = mode;
+        c.b = drawCount;
+        c.c = indexType;
+        c.offset = offset;
+        c.bytes = stride;
+        c.instances = buffer.id;
+    }
+
+    void dispatch(unsigned int x, unsigned int y = 1, unsigned int z = 1)
+    {
+        Command& c = add(DISPATCH);
+        c.a = x;
+        c.b = y;
+        c.c = z;
+    }
+
+    // what the following commands read that the previous ones wrote, glMemoryBarrier bits
+    void barrier(GLbitfield bits) { add(BARRIER).a = bits; }
+
+private:
+    friend class GlRenderDevice;
+
+    enum Opcode : uint8_t {
+        BIND_PIPELINE, BIND_VERTEX_INPUT, BIND_BUFFER, BIND_IMAGE, SET_UINT, SET_FLOAT, SET_VEC4,
+        DRAW_INDEXED, DRAW_INDEXED_INDIRECT, DISPATCH, BARRIER
+    };
+
+    struct Command
+    {
+        Opcode op;
+        uint32_t a = 0, b = 0, c = 0;
+        size_t offset = 0;
+        size_t bytes = 0;
+        int baseVertex = 0;
+        uint32_t instances = 0;
+        uint32_t baseInstance = 0;
+        float values[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    };
+
+    std::vector<Command> commands;
+
+    Command& add(Opcode op)
+    {
+        commands.emplace_back();
+        commands.back().op = op;
+        return commands.back();
+    }
+};
+
+// a mesh's level of detail, instanced
+inline void recordMesh(CommandList& list, const Mesh& mesh, unsigned int instances = 1, unsigned int baseInstance = 0, unsigned int level = 0)
+{
+    const MeshLod drawn = mesh.lod(level);
+    list.bindVertexInput(DeviceVertexInput{mesh.VAO});
+    list.drawIndexed(GL_TRIANGLES, drawn.count, mesh.indexType, static_cast<size_t>(drawn.firstIndex) * mesh.indexSize(),
+                     mesh.baseVertex(), instances, baseInstance);
+}
+
+class RenderDevice
+{
+public:
+    virtual ~RenderDevice() = default;
+
+    virtual const char* backendName() const = 0;
+
+    // bytes of data (null for undefined contents), updated with updateBuffer when dynamic
+    virtual DeviceBuffer createBuffer(size_t bytes, const void* data, bool dynamic, GpuMemoryCategory category, const char* label) = 0;
+    virtual void updateBuffer(DeviceBuffer buffer, size_t offset, size_t bytes, const void* data) = 0;
+    virtual void destroyBuffer(DeviceBuffer& buffer) = 0;
+
+    virtual DeviceImage createImage(const ImageDesc& desc) = 0;
+    virtual void destroyImage(DeviceImage& image) = 0;
+
+    virtual DevicePipeline createPipeline(const PipelineDesc& desc) = 0;
+    virtual void destroyPipeline(DevicePipeline& pipeline) = 0;
+
+    // runs the lists, in order, on a queue; on the device's thread
+    virtual void submit(const CommandList* lists, size_t count, RenderQueueType queue = QUEUE_GRAPHICS) = 0;
+
+    // fn(list, begin, end) for the pool's slices of [0, items), each into its own list, then the lists submitted in
+    // slice order; lists keeps its storage from one frame to the next
+    template <typename Fn>
+    void recordParallel(std::vector<CommandList>& lists, size_t items, const Fn& fn, RenderQueueType queue = QUEUE_GRAPHICS,
+                        ThreadPool& pool = workerPool())
+    {
+        lists.resize(std::max<size_t>(pool.size(), 1));
+        for (CommandList& list : lists)
+            list.reset();
+        pool.parallelFor(0, items, [&](size_t begin, size_t end, unsigned int slice) { fn(lists[slice], begin, end); });
+        submit(lists.data(), lists.size(), queue);
+    }
+};
+
+// The device over the current GL context. Buffers and images are immutable storage, a pipeline is an index into
+// its descriptions, applied through glState() when bound.
+class GlRenderDevice : public RenderDevice
+{
+public:
+    const char* backendName() const override { return "OpenGL"; }
+
+    DeviceBuffer createBuffer(size_t bytes, const void* data, bool dynamic, GpuMemoryCategory category, const char* label) override
+    {
+        GLuint id = 0;
+        glCreateBuffers(1, &id);
+        glNamedBufferStorage(id, static_cast<GLsizeiptr>(bytes), data, dynamic ? GL_DYNAMIC_STORAGE_BIT : 0);
+        labelObject(GL_BUFFER, id, label);
+        track(id, bytes, category);
+        return DeviceBuffer{id};
+    }
+
+    void updateBuffer(DeviceBuffer buffer, size_t offset, size_t bytes, const void* data) override
+    {
+        glNamedBufferSubData(buffer.id, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(bytes), data);
+    }
+
+    void destroyBuffer(DeviceBuffer& buffer) override
+    {
+        if (buffer.id == 0)
+            return;
+        untrack(buffer.id);
+        glState().deleteBuffers(1, &buffer.id);
+        buffer.id = 0;
+    }
+
+    DeviceImage createImage(const ImageDesc& desc) override
+    {
+        GLuint id = 0;
+        glCreateTextures(desc.target, 1, &id);
+        const GLsizei levels = static_cast<GLsizei>(std::max(desc.levels, 1u));
+        if (desc.target == GL_TEXTURE_2D_ARRAY || desc.target == GL_TEXTURE_3D)
+            glTextureStorage3D(id, levels, desc.format, desc.width, desc.height, desc.layers);
+        else
+            glTextureStorage2D(id, levels, desc.format, desc.width, desc.height);
+        labelObject(GL_TEXTURE, id, desc.label);
+        return DeviceImage{id, desc.target};
+    }
+
+    void destroyImage(DeviceImage& image) override
+    {
+        if (image.id == 0)
+            return;
+        glState().deleteTextures(1, &image.id);
+        image.id = 0;
+    }
+
+    DevicePipeline createPipeline(const PipelineDesc& desc) override
+    {
+        pipelines.push_back(desc);
+        return DevicePipeline{static_cast<uint32_t>(pipelines.size())};
+    }
+
+    void destroyPipeline(DevicePipeline& pipeline) override
+    {
+        if (pipeline.id != 0 && pipeline.id <= pipelines.size())
+            pipelines[pipeline.id - 1].shader = nullptr;
+        pipeline.id = 0;
+    }
+
+    void submit(const CommandList* lists, size_t count, RenderQueueType queue = QUEUE_GRAPHICS) override
+    {
+        GL_DEBUG_GROUP(queue == QUEUE_COMPUTE ? "device compute" : "device graphics");
+        for (size_t l = 0; l < count; l++)
+            for (const CommandList::Command& c : lists[l].commands)
+                execute(c);
+    }
+
+private:
+    struct Allocation
+    {
+        uint32_t id;
+        GpuAllocation bytes;
+    };
+
+    std::vector<PipelineDesc> pipelines;
+    std::vector<Allocation> allocations;
+
+    void track(uint32_t id, size_t bytes, GpuMemoryCategory category)
+    {
+        allocations.push_back(Allocation{id, GpuAllocation(category)});
+        allocations.back().bytes.set(bytes);
+    }
+
+    void untrack(uint32_t id)
+    {
+        for (size_t k = 0; k < allocations.size(); k++)
+            if (allocations[k].id == id)
+            {
+                allocations[k] = std::move(allocations.back());
+                allocations.pop_back();
+                return;
+            }
+    }
+
+    void execute(const CommandList::Command& c)
+    {
+        GlStateCache& state = glState();
+        switch (c.op)
+        {
+        case CommandList::BIND_PIPELINE:
+        {
+            const PipelineDesc* bound = c.a != 0 && c.a <= pipelines.size() ? &pipelines[c.a - 1] : nullptr;
+            if (bound && bound->shader)
+            {
+                const GLboolean write = bound->colorWrite ? GL_TRUE : GL_FALSE;
+                bound->shader->use();
+                state.depthFunc(bound->depthFunc);
+                state.colorMask(write, write, write, write);
+                // the cache has no depth mask, blending or culling, they are set as they are
+                glDepthMask(bound->depthWrite ? GL_TRUE : GL_FALSE);
+                if (bound->blend)
+                {
+                    glEnable(GL_BLEND);
+                    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+                }
+                else
+                    glDisable(GL_BLEND);
+                if (bound->cullBackFaces) glEnable(GL_CULL_FACE);
+                else glDisable(GL_CULL_FACE);
+            }
+            break;
+        }
+        case CommandList::BIND_VERTEX_INPUT:
+            state.bindVertexArray(c.a);
+            break;
+        case CommandList::BIND_BUFFER:
+            if (c.bytes == 0)
+                state.bindBufferBase(c.a, c.b, c.c);
+            else
+                state.bindBufferRange(c.a, c.b, c.c, static_cast<GLintptr>(c.offset), static_cast<GLsizeiptr>(c.bytes));
+            break;
+        case CommandList::BIND_IMAGE:
+            state.activeTexture(GL_TEXTURE0 + c.a);
+            state.bindTexture(c.c, c.b);
+            break;
+        case CommandList::SET_UINT:
+            glUniform1ui(static_cast<GLint>(c.a), c.b);
+            break;
+        case CommandList::SET_FLOAT:
+            glUniform1f(static_cast<GLint>(c.a), c.values[0]);
+            break;
+        case CommandList::SET_VEC4:
+            glUniform4fv(static_cast<GLint>(c.a), 1, c.values);
+            break;
+        case CommandList::DRAW_INDEXED:
+            glDrawElementsInstancedBaseVertexBaseInstance(c.a, static_cast<GLsizei>(c.b), c.c, reinterpret_cast<const void*>(c.offset),
+                                                          static_cast<GLsizei>(c.instances), c.baseVertex, c.baseInstance);
+            break;
+        case CommandList::DRAW_INDEXED_INDIRECT:
+            state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, c.instances);
+            glMultiDrawElementsIndirect(c.a, c.c, reinterpret_cast<const void*>(c.offset), static_cast<GLsizei>(c.b), static_cast<GLsizei>(c.bytes));
+            break;
+        case CommandList::DISPATCH:
+            glDispatchCompute(c.a, c.b, c.c);
+            break;
+        case CommandList::BARRIER:
+            glMemoryBarrier(c.a);
+            break;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef RENDER_PROFILE_H
+#define RENDER_PROFILE_H
+
+#include <glad/glad.h>
+
+#include <gles_compat.h>
+#include <shader.h>
+
+#include <string>
+
+// Which GL the window's context is made for, chosen before it is created, and what the renderer may use on it.
+// The desktop profile is the 4.6 core context everything is written against. The GLES profile asks for OpenGL ES
+// 3.2, or 3.1 where the driver has no 3.2, for low-end ARM devices: it fills in what glad leaves out of an ES
+// context (gles_compat.h) and has every program compiled as GLSL ES, with default precisions, GLES_PROFILE defined
+// and gl_BaseInstance and gl_DrawID read from uniforms (Shader::sourceProfile). Which of the viewer's features that
+// leaves and the lower body counts it starts with are the viewer's to apply, from the capabilities read here.
+enum RenderProfileKind
+{
+    RENDER_PROFILE_DESKTOP = 0,
+    RENDER_PROFILE_GLES = 1,
+};
+
+struct RenderProfile
+{
+    RenderProfileKind kind = RENDER_PROFILE_DESKTOP;
+    int major = 4;
+    int minor = 6;
+
+    // what the context has, read by detect()
+    bool clipControl = true;            // glClipControl, for reversed depth
+    bool baseInstance = true;           // draws start instanced attributes at their base instance in hardware
+    bool persistentMaps = true;         // buffer storage, which the streaming buffers map for their lifetime
+    bool textureViews = true;
+    bool timerQueries = true;
+    bool vertexStorageBlocks = true;    // shader storage read from vertex shaders, the GPU backends draw that way
+    bool tessellation = true;
+    bool geometryShaders = true;
+
+    bool es() const { return kind == RENDER_PROFILE_GLES; }
+
+    void useGles()
+    {
+        kind = RENDER_PROFILE_GLES;
+        major = 3;
+        minor = 2;
+    }
+
+    // the version line of ImGui's OpenGL3 backend
+    const char* imguiGlsl() const { return es() ? "#version 300 es" : "#version 460"; }
+
+    const char* name() const { return es() ? "gles" : "desktop"; }
+
+    // With the context current and glad loaded from loader, before any program is built: an ES context gets its
+    // entry points and the shader rewrites, and either reads what it has
+    void detect(GLADloadproc loader)
+    {
+        if (!es())
+            return;
+        GlesCompat::load(loader);
+        GLint version[2] = {major, minor};
+        glGetIntegerv(GL_MAJOR_VERSION, &version[0]);
+        glGetIntegerv(GL_MINOR_VERSION, &version[1]);
+        major = version[0];
+        minor = version[1];
+
+        Shader::SourceProfile& source = Shader::sourceProfile();
+        source.version = "#version " + std::to_string(major) + std::to_string(minor) + "0 es";
+        source.preamble = precisionPreamble(minor >= 2);
+        source.renames = {{"gl_BaseInstance", "glesBaseInstance"}, {"gl_DrawID", "glesDrawId"}};
+
+        clipControl = glClipControl != nullptr;
+        baseInstance = GlesCompat::baseInstance();
+        persistentMaps = GlesCompat::bufferStorage();
+        textureViews = glTextureView != nullptr;
+        timerQueries = GlesCompat::timerQueries();
+        GLint vertexBlocks = 0;
+        glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &vertexBlocks);
+        vertexStorageBlocks = vertexBlocks > 0;
+        tessellation = minor >= 2 || GlesCompat::hasExtension("GL_EXT_tessellation_shader");
+        geometryShaders = minor >= 2 || GlesCompat::hasExtension("GL_EXT_geometry_shader");
+    }
+
+private:
+    // GLSL ES gives fragment floats and most samplers and images no default precision; everything is highp,
+    // the sources being written for desktop GL's
+    static std::string precisionPreamble(bool es32)
+    {
+        std::string preamble = "#define GLES_PROFILE\n"
+                               "precision highp float;\nprecision highp int;\n";
+        static const char* types[] = {"sampler2D", "sampler3D", "samplerCube", "sampler2DArray", "sampler2DShadow",
+                                      "samplerCubeShadow", "sampler2DArrayShadow", "isampler2D", "usampler2D",
+                                      "isampler3D", "usampler3D", "isampler2DArray", "usampler2DArray", "image2D",
+                                      "uimage2D", "iimage2D", "image2DArray", "uimage2DArray", "image3D", "uimage3D",
+                                      "imageCube"};
+        for (const char* type : types)
+            preamble += std::string("precision highp ") + type + ";\n";
+        if (es32)
+            preamble += "precision highp samplerCubeArray;\nprecision highp samplerBuffer;\nprecision highp usamplerBuffer;\n";
+        return preamble;
+    }
+};
+
+// the profile of the one context the viewer makes
+inline RenderProfile& renderProfile()
+{
+    static RenderProfile profile;
+    return profile;
+}
+
+#endif
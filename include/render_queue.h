@@ -0,0 +1,447 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+
+#include <shader.h>
+#include <mesh.h>
+#include <gl_state_cache.h>
+#include <gl_debug.h>
+#include <frame_arena.h>
+#include <gpu_timers.h>
+#include <uniform_ring.h>
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// Draws collected over a frame and submitted sorted by a 64-bit key, so draws sharing a program, then textures,
+// then a vertex array run back to back and glState() filters out the binds they have in common. The key, from
+// the top bit down:
+//
+//     pass 4 | program 12 | material 16 | vertex array 12 | depth 20
+//
+// Passes run in order with the depth test and colour writes given by setPass; inside one, draws are nearest
+// first (or farthest, for a back-to-front pass). A depth-only pass can be made position-only: its mesh draws then
+// bind the mesh's position stream (Mesh::createPositionStream) where it has one instead of its full vertices. The program, material and vertex array fields are the low bits
+// of the GL names, two names sharing them only sort together, which costs a bind and nothing else. A material is
+// the name of the first texture bound.
+//
+// Each pass is a debug group of its name in frame captures (see gl_debug.h).
+//
+// With setTimers, each packet's GPU time goes to its timer scope, the queries switching where the scope changes.
+//
+// With setViews a frame has several views, the eyes of stereo_camera.h: each pass is drawn once per view, the view
+// hook called before, and its multiView packets once for all of them (instanced stereo) before the rest, after the
+// hook was called with ALL_VIEWS.
+//
+// A mesh packet from addMeshInstance carries its uniforms as one record instead of a callback, and the queue
+// instances them itself: when it sorts, the record packets under one key prefix (pass, program, material, vertex
+// array) that also share the mesh, level, textures and timer are gathered into one instanced draw at the nearest of
+// them, their records in a slice of the instancing ring bound as a storage block for the packets' instanced
+// program. A packet left alone binds its record as the uniform block its own program reads. So a scene drawing the
+// same model many times with per-draw transforms costs a draw per mesh, as if it had been instanced by hand.
+//
+// A packet's callback sets its uniforms and, for a packet without a mesh, draws. Callbacks are copied into
+// frameArena() and never destroyed, so they must be trivially destructible (lambdas capturing by reference or
+// plain values); reset() must run after the arena is reset each frame.
+class RenderQueue
+{
+public:
+    static const unsigned int MAX_PASSES = 16;
+    static const unsigned int NO_TIMER = 0xFFFFFFFFu;
+    static const unsigned int ALL_VIEWS = 0xFFFFFFFFu;
+    static const unsigned int MAX_MERGED_INSTANCES = 512;  // records in one instanced draw, a run past it takes several
+
+    // sets a view's viewport and camera, view is below the count or ALL_VIEWS
+    typedef void (*ViewHook)(unsigned int view, void* context);
+
+    // how a packet is bound and drawn
+    struct Draw
+    {
+        unsigned int pass = 0;
+        Shader* shader = nullptr;       // in use, through the cache, before the callback
+        unsigned int vertexArray = 0;   // bound before the callback, 0 leaves it alone
+        GLenum textureTarget = GL_TEXTURE_2D;
+        const TextureBinding* textures = nullptr;
+        unsigned int textureCount = 0;
+        const Mesh* mesh = nullptr;     // drawn after the callback with its samplers, textures and VAO, which then must not rebind
+        unsigned int lod = 0;           // the mesh's level of detail
+        float depth = 0.0f;             // distance from the camera
+        unsigned int timer = NO_TIMER;  // GpuTimers scope
+        bool multiView = false;         // draws every view at once, otherwise once per view
+        const void* record = nullptr;   // addMeshInstance's uniforms, in the frame arena
+        unsigned int recordBytes = 0;
+        Shader* instancedShader = nullptr;  // draws a gathered run of such packets from an array of their records
+    };
+
+    RenderQueue()
+    {
+        for (unsigned int p = 0; p < MAX_PASSES; p++)
+            passes[p] = Pass();
+    }
+
+    // the depth test and colour writes of a pass, the order its draws are sorted in and whether its meshes draw
+    // from their position streams. The name must outlive the queue; set before the pass's draws are added.
+    void setPass(unsigned int pass, const char* name, GLenum depthFunc, bool colorWrite = true, bool backToFront = false,
+                 bool positionOnly = false)
+    {
+        if (pass < MAX_PASSES)
+            passes[pass] = Pass{name, depthFunc, colorWrite, backToFront, positionOnly};
+    }
+
+    // where the packets' timer scopes are timed, null for untimed
+    void setTimers(GpuTimers* gpuTimers) { timers = gpuTimers; }
+
+    // where addMeshInstance's records are written: a lone packet's bound at uniformBinding, a gathered run's at
+    // storageBinding. Without a ring no record packet is drawn.
+    void setInstancing(UniformRing* ring, unsigned int uniformBinding, unsigned int storageBinding)
+    {
+        instanceRing = ring;
+        instanceUniformBinding = uniformBinding;
+        instanceStorageBinding = storageBinding;
+    }
+
+    // whether record packets are gathered, otherwise each is drawn alone as it would be through addMesh
+    void setMerging(bool enabled) { merging = enabled; }
+
+    // the views the next submits draw, 1 for a single one that needs no hook
+    void setViews(unsigned int count, ViewHook hook = nullptr, void* context = nullptr)
+    {
+        viewCount = hook ? std::max(count, 1u) : 1u;
+        viewHook = hook;
+        viewContext = context;
+    }
+
+    // empties the queue for a new frame, keeping its storage
+    void reset()
+    {
+        packets.clear();
+        order.clear();
+        next = 0;
+        sorted = false;
+        merged = 0;
+        instancedDraws = 0;
+    }
+
+    // a mesh with its own textures at a level of detail, the callback sets the uniforms
+    template <typename F>
+    void addMesh(unsigned int pass, Shader& shader, const Mesh& mesh, float depth, unsigned int timer, const F& uniforms, unsigned int lod = 0)
+    {
+        Draw draw;
+        draw.pass = pass;
+        draw.timer = timer;
+        draw.shader = &shader;
+        draw.vertexArray = mesh.VAO;
+        draw.textures = mesh.bindings().data();
+        draw.textureCount = static_cast<unsigned int>(mesh.bindings().size());
+        draw.mesh = &mesh;
+        draw.lod = lod;
+        draw.depth = depth;
+        add(draw, uniforms);
+    }
+
+    // a mesh with its own textures whose uniforms are all in record, drawn by shader alone or by instancedShader
+    // with others like it. Record is a struct the shaders read as a std140 uniform block and as an element of a
+    // std430 array, the same bytes for vec4s and matrices.
+    template <typename Record>
+    void addMeshInstance(unsigned int pass, Shader& shader, Shader& instancedShader, const Mesh& mesh, const Record& record, float depth,
+                         unsigned int timer, unsigned int lod = 0)
+    {
+        static_assert(std::is_trivially_copyable<Record>::value && std::is_trivially_destructible<Record>::value,
+                      "records are copied into the frame arena and from there into the instancing ring");
+        Draw draw;
+        draw.pass = pass;
+        draw.timer = timer;
+        draw.shader = &shader;
+        draw.vertexArray = mesh.VAO;
+        draw.textures = mesh.bindings().data();
+        draw.textureCount = static_cast<unsigned int>(mesh.bindings().size());
+        draw.mesh = &mesh;
+        draw.lod = lod;
+        draw.depth = depth;
+        draw.record = new (frameArena().allocate(sizeof(Record), alignof(Record))) Record(record);
+        draw.recordBytes = sizeof(Record);
+        draw.instancedShader = &instancedShader;
+        push(draw, nullptr, nullptr);
+    }
+
+    // a texture for a packet without a mesh, copied into the frame arena with the packet
+    template <typename F>
+    void addWithTexture(Draw draw, unsigned int unit, unsigned int texture, const F& callback)
+    {
+        TextureBinding* binding = frameArena().allocateArray<TextureBinding>(1);
+        *binding = TextureBinding{unit, texture};
+        draw.textures = binding;
+        draw.textureCount = 1;
+        add(draw, callback);
+    }
+
+    template <typename F>
+    void add(const Draw& draw, const F& callback)
+    {
+        static_assert(std::is_trivially_destructible<F>::value, "packet callbacks live in the frame arena and are never destroyed");
+        F* stored = new (frameArena().allocate(sizeof(F), alignof(F))) F(callback);
+        push(draw, &invoke<F>, stored);
+    }
+
+    // draws the queued packets of passes up to and including lastPass that are not drawn yet, in key order.
+    // Afterwards the depth test is GL_LESS with colour writes on.
+    void submit(unsigned int lastPass = MAX_PASSES - 1)
+    {
+        if (!sorted)
+        {
+            // packets of a pass already submitted stay where they are, the rest sort after them
+            std::sort(order.begin() + next, order.end(), [](const Entry& a, const Entry& b) { return a.key < b.key; });
+            sorted = true;
+            gatherInstances(next);
+        }
+        GlStateCache& state = glState();
+        unsigned int currentTimer = NO_TIMER;
+        while (next < order.size())
+        {
+            const unsigned int pass = packets[order[next].index].draw.pass;
+            if (pass > lastPass)
+                break;
+            size_t end = next;
+            bool multiView = false;
+            for (; end < order.size() && packets[order[end].index].draw.pass == pass; end++)
+                multiView = multiView || packets[order[end].index].draw.multiView;
+
+            const Pass& settings = passes[std::min(pass, MAX_PASSES - 1)];
+            pushDebugGroup(settings.name);
+            const GLboolean write = settings.colorWrite ? GL_TRUE : GL_FALSE;
+            state.depthFunc(settings.depthFunc);
+            state.colorMask(write, write, write, write);
+            if (viewCount <= 1)
+                drawPackets(next, end, true, true, currentTimer);
+            else
+            {
+                if (multiView)
+                {
+                    viewHook(ALL_VIEWS, viewContext);
+                    drawPackets(next, end, true, false, currentTimer);
+                }
+                for (unsigned int view = 0; view < viewCount; view++)
+                {
+                    viewHook(view, viewContext);
+                    drawPackets(next, end, false, true, currentTimer);
+                }
+            }
+            popDebugGroup();
+            next = end;
+        }
+        if (timers && currentTimer != NO_TIMER)
+            timers->end();
+        // what the rest of the frame expects
+        state.depthFunc(GL_LESS);
+        state.colorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    }
+
+    size_t size() const { return packets.size(); }
+    // packets drawn as instances of another's draw, and the instanced draws they went into, this frame so far
+    size_t mergedCount() const { return merged; }
+    size_t instancedDrawCount() const { return instancedDraws; }
+
+    // the sort key of a draw, see the layout above
+    uint64_t key(const Draw& draw) const
+    {
+        const Pass& pass = passes[std::min(draw.pass, MAX_PASSES - 1)];
+        const uint64_t program = draw.shader ? draw.shader->ID & 0xFFFu : 0u;
+        const uint64_t material = draw.textureCount > 0 ? draw.textures[0].id & 0xFFFFu : 0u;
+        const uint64_t vertexArray = draw.vertexArray & 0xFFFu;
+        uint64_t depth = depthBits(draw.depth);
+        if (pass.backToFront)
+            depth = 0xFFFFFu - depth;
+        return (uint64_t(draw.pass & 0xFu) << 60) | (program << 48) | (material << 32) | (vertexArray << 20) | depth;
+    }
+
+private:
+    struct Pass
+    {
+        const char* name = "pass";
+        GLenum depthFunc = GL_LESS;
+        bool colorWrite = true;
+        bool backToFront = false;
+        bool positionOnly = false;
+    };
+
+    struct Packet
+    {
+        Draw draw;
+        void (*call)(void*) = nullptr;
+        void* context = nullptr;
+        UniformRing::Slice records;     // a record packet's own record, or its run's
+        unsigned int instances = 0;     // the packets a record packet's draw stands for, 0 once gathered into another's
+        bool gathered = false;
+    };
+
+    struct Entry
+    {
+        uint64_t key;
+        unsigned int index;
+    };
+
+    Pass passes[MAX_PASSES];
+    std::vector<Packet> packets;
+    std::vector<Entry> order;
+    size_t next = 0;
+    bool sorted = false;
+    GpuTimers* timers = nullptr;
+    unsigned int viewCount = 1;
+    ViewHook viewHook = nullptr;
+    void* viewContext = nullptr;
+    UniformRing* instanceRing = nullptr;
+    unsigned int instanceUniformBinding = 0;
+    unsigned int instanceStorageBinding = 0;
+    bool merging = true;
+    size_t merged = 0;
+    size_t instancedDraws = 0;
+    std::vector<unsigned int> run;  // gatherInstances' scratch, positions in order
+
+    void push(const Draw& draw, void (*call)(void*), void* context)
+    {
+        Packet packet;
+        packet.draw = draw;
+        // the mesh's indices and levels are the same over its position stream
+        if (draw.mesh && draw.vertexArray == draw.mesh->VAO && passes[std::min(draw.pass, MAX_PASSES - 1)].positionOnly)
+            packet.draw.vertexArray = draw.mesh->depthVAO();
+        packet.call = call;
+        packet.context = context;
+        packets.push_back(packet);
+        order.push_back(Entry{key(packet.draw), static_cast<unsigned int>(packets.size() - 1)});
+        sorted = false;
+    }
+
+    // what two record packets must share to be one draw, ordered so the packets that do sort together
+    static bool instanceLess(const Draw& a, const Draw& b)
+    {
+        const auto fields = [](const Draw& d) {
+            return std::make_tuple(reinterpret_cast<uintptr_t>(d.mesh), d.lod, reinterpret_cast<uintptr_t>(d.shader),
+                                   reinterpret_cast<uintptr_t>(d.instancedShader), reinterpret_cast<uintptr_t>(d.textures),
+                                   d.textureCount, d.textureTarget, d.vertexArray, d.timer, d.multiView, d.recordBytes);
+        };
+        return fields(a) < fields(b);
+    }
+
+    // writes the records of the sorted packets from begin on that are not gathered yet: each run of alike packets
+    // under one key prefix gets a slice holding all their records, drawn by its nearest packet, the others are
+    // skipped. Keys only differ in depth inside a prefix, so gathering keeps the passes and the program order.
+    void gatherInstances(size_t begin)
+    {
+        if (!instanceRing)
+            return;
+        for (size_t s = begin; s < order.size();)
+        {
+            size_t e = s + 1;
+            while (e < order.size() && (order[e].key >> 20) == (order[s].key >> 20))
+                e++;
+            run.clear();
+            for (size_t i = s; i < e; i++)
+            {
+                const Packet& packet = packets[order[i].index];
+                if (packet.draw.record && !packet.gathered)
+                    run.push_back(static_cast<unsigned int>(i));
+            }
+            // stable, the first of each group is the nearest
+            std::stable_sort(run.begin(), run.end(), [this](unsigned int a, unsigned int b) {
+                return instanceLess(packets[order[a].index].draw, packets[order[b].index].draw);
+            });
+            for (size_t g = 0; g < run.size();)
+            {
+                Packet& first = packets[order[run[g]].index];
+                size_t h = g + 1;
+                if (merging && first.draw.instancedShader)
+                    while (h < run.size() && h - g < MAX_MERGED_INSTANCES && !instanceLess(first.draw, packets[order[run[h]].index].draw))
+                        h++;
+                const size_t bytes = first.draw.recordBytes;
+                first.records = instanceRing->allocate(bytes * (h - g));
+                for (size_t k = g; k < h; k++)
+                {
+                    Packet& packet = packets[order[run[k]].index];
+                    packet.gathered = true;
+                    packet.instances = 0;
+                    if (first.records.data)
+                        std::memcpy(static_cast<uint8_t*>(first.records.data) + (k - g) * bytes, packet.draw.record, bytes);
+                }
+                first.instances = static_cast<unsigned int>(h - g);
+                if (h - g > 1)
+                {
+                    merged += h - g - 1;
+                    instancedDraws++;
+                }
+                g = h;
+            }
+            s = e;
+        }
+    }
+
+    // the packets of [begin, end) in order, those multiView and those not as asked
+    void drawPackets(size_t begin, size_t end, bool multiView, bool singleView, unsigned int& currentTimer)
+    {
+        GlStateCache& state = glState();
+        for (size_t e = begin; e < end; e++)
+        {
+            const Packet& packet = packets[order[e].index];
+            const Draw& draw = packet.draw;
+            if (!(draw.multiView ? multiView : singleView))
+                continue;
+            // gathered into a nearer packet's draw, or never gathered without a ring
+            if (draw.record && packet.instances == 0)
+                continue;
+            if (timers && draw.timer != currentTimer)
+            {
+                currentTimer = draw.timer;
+                if (currentTimer == NO_TIMER)
+                    timers->end();
+                else
+                    timers->begin(currentTimer);
+            }
+            const bool instanced = draw.record && packet.instances > 1;
+            Shader* shader = instanced ? draw.instancedShader : draw.shader;
+            if (shader)
+                shader->use();
+            for (unsigned int t = 0; t < draw.textureCount; t++)
+            {
+                state.activeTexture(GL_TEXTURE0 + draw.textures[t].unit);
+                state.bindTexture(draw.textureTarget, draw.textures[t].id);
+            }
+            if (draw.vertexArray != 0)
+                state.bindVertexArray(draw.vertexArray);
+            if (draw.mesh && shader)
+                draw.mesh->bindSamplers(*shader);
+            if (instanced)
+                instanceRing->bindStorage(instanceStorageBinding, packet.records);
+            else if (draw.record)
+                instanceRing->bind(instanceUniformBinding, packet.records);
+            if (packet.call)
+                packet.call(packet.context);
+            if (draw.mesh && instanced)
+                draw.mesh->drawElementsInstanced(packet.instances, 0, draw.lod);
+            else if (draw.mesh)
+                draw.mesh->drawElements(draw.lod);
+        }
+    }
+
+    template <typename F>
+    static void invoke(void* callback)
+    {
+        (*static_cast<F*>(callback))();
+    }
+
+    // the top 20 bits of a non-negative float below the sign, which order the same way the floats do
+    static uint64_t depthBits(float depth)
+    {
+        depth = std::max(depth, 0.0f);
+        uint32_t bits;
+        std::memcpy(&bits, &depth, sizeof(bits));
+        return (bits >> 11) & 0xFFFFFu;
+    }
+};
+
+#endif
@@ -0,0 +1,357 @@
+#ifndef ROCK_VARIANTS_H
+#define ROCK_VARIANTS_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+#include <gtc/constants.hpp>
+
+#include <model.h>
+#include <texture_cache.h>
+#include <texture_image.h>
+#include <gpu_memory.h>
+#include <gl_state_cache.h>
+#include <profiler.h>
+
+#include <vector>
+#include <string>
+#include <random>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <map>
+#include <utility>
+
+// Asteroids that differ without costing draws or binds: variants of the rock, each its shape deformed by a few
+// seeded lobes (deformRock) and its diffuse texture tinted, the first the rock as it came. The shapes are pooled
+// in geometryPool() so every variant shares one VAO and GpuCuller's commands differ only in their offsets, the
+// textures are the layers of one GL_TEXTURE_2D_ARRAY bound once for all rocks. A GPU-resident rock's variant
+// follows from its body index (rockVariant, and rockVariantHash in shaders.2/rock_variant.glsl); the instance
+// streams of the CPU backends draw the first shape, with every texture layer.
+//
+// Procedural rocks (--procedural-rocks) start from an icosphere instead of the rock's mesh (icosphereRock) and every
+// rock vertex shader displaces it by noise seeded from the rock's own variant number, so no two rocks look alike
+// with no more geometry than one sphere and its levels of detail; the variants' lobes still come on top.
+static const unsigned int DEFAULT_ROCK_VARIANTS = 4;
+static const unsigned int MAX_ROCK_VARIANTS = 16;
+static const float ROCK_VARIANT_DEFORMATION = 0.35f;   // how far a lobe moves the surface, a fraction of its radius
+static const float DEFAULT_ROCK_RELIEF = 0.3f;          // the procedural rocks' noise, a fraction of the radius
+static const unsigned int PROCEDURAL_ROCK_SUBDIVISIONS = 4;
+
+// the variant of body among count, as shaders.2/asteroid.cull.cs and the rock fragment shader pick it
+inline unsigned int rockVariant(uint32_t body, unsigned int count)
+{
+    return ((body * 2654435761u) >> 16) % count;
+}
+
+// Moves every vertex radially by a sum of lobes around random directions, plus a stretch along a random axis, so
+// the rock keeps its silhouette's style but not its outline. A function of the position alone, so vertices split
+// at a UV seam stay together; normals and tangents follow through the Jacobian of the map. GL-free.
+inline void deformRock(std::vector<Vertex>& vertices, uint32_t seed, float amount = ROCK_VARIANT_DEFORMATION)
+{
+    static const unsigned int LOBES = 6;
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    // uniform on the sphere, by rejection from the cube
+    auto direction = [&]() {
+        glm::vec3 d;
+        do d = glm::vec3(unit(random), unit(random), unit(random));
+        while (glm::dot(d, d) < 1e-3f || glm::dot(d, d) > 1.0f);
+        return glm::normalize(d);
+    };
+    glm::vec3 directions[LOBES];
+    float weights[LOBES], sharpness[LOBES];
+    for (unsigned int k = 0; k < LOBES; k++)
+    {
+        directions[k] = direction();
+        weights[k] = unit(random) * amount;
+        sharpness[k] = 1.5f + 1.25f * (unit(random) + 1.0f);
+    }
+    const glm::vec3 stretchAxis = direction();
+    const float stretch = 1.0f + 0.35f * unit(random);
+
+    float radius = 0.0f;
+    for (const Vertex& v : vertices)
+        radius = std::max(radius, glm::length(v.Position));
+    if (radius <= 0.0f)
+        return;
+    auto map = [&](const glm::vec3& p) {
+        const float length = glm::length(p);
+        float scale = 1.0f;
+        if (length > 0.0f)
+            for (unsigned int k = 0; k < LOBES; k++)
+                scale += weights[k] * std::pow(std::max(glm::dot(p / length, directions[k]), 0.0f), sharpness[k]);
+        const glm::vec3 q = p * std::max(scale, 0.2f);
+        return q + stretchAxis * (glm::dot(q, stretchAxis) * (stretch - 1.0f));
+    };
+
+    const float h = radius * 1e-3f;
+    for (Vertex& v : vertices)
+    {
+        // central differences, the columns of the Jacobian
+        glm::mat3 jacobian;
+        for (int a = 0; a < 3; a++)
+        {
+            glm::vec3 step(0.0f);
+            step[a] = h;
+            jacobian[a] = (map(v.Position + step) - map(v.Position - step)) / (2.0f * h);
+        }
+        const glm::mat3 normalMatrix = glm::transpose(glm::inverse(jacobian));
+        v.Position = map(v.Position);
+        v.Normal = glm::normalize(normalMatrix * v.Normal);
+        if (glm::dot(v.Tangent, v.Tangent) > 0.0f)
+            v.Tangent = glm::normalize(jacobian * v.Tangent);
+        if (glm::dot(v.Bitangent, v.Bitangent) > 0.0f)
+            v.Bitangent = glm::normalize(jacobian * v.Bitangent);
+    }
+}
+
+// scales the colour of 8-bit pixels by a brightness and a warm or cool shift of the seed; alpha is left alone
+inline void tintPixels(unsigned char* pixels, size_t count, int components, uint32_t seed)
+{
+    if (components < 3)
+        return;
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    const float brightness = 0.9f + 0.15f * unit(random);
+    const float warmth = 0.08f * unit(random);
+    const float factors[3] = {brightness * (1.0f + warmth), brightness, brightness * (1.0f - warmth)};
+    for (size_t p = 0; p < count; p++)
+        for (int c = 0; c < 3; c++)
+        {
+            unsigned char& value = pixels[p * components + c];
+            value = static_cast<unsigned char>(std::min(255.0f, value * factors[c] + 0.5f));
+        }
+}
+
+// A unit icosphere subdivided that many times and scaled to radius, for the procedural rocks: no vertex is
+// favoured, so the noise of the rock vertex shaders (rockRelief in shaders.2/rock_variant.glsl) shapes it the same
+// way everywhere. UVs are the longitude and latitude, the vertices of triangles across the date line split so the
+// texture wraps once. GL-free.
+inline ImportedMesh icosphereRock(float radius, unsigned int subdivisions = PROCEDURAL_ROCK_SUBDIVISIONS)
+{
+    const float t = (1.0f + std::sqrt(5.0f)) * 0.5f;
+    std::vector<glm::vec3> points = {
+        {-1, t, 0}, {1, t, 0}, {-1, -t, 0}, {1, -t, 0}, {0, -1, t}, {0, 1, t},
+        {0, -1, -t}, {0, 1, -t}, {t, 0, -1}, {t, 0, 1}, {-t, 0, -1}, {-t, 0, 1}};
+    for (glm::vec3& p : points)
+        p = glm::normalize(p);
+    std::vector<unsigned int> triangles = {
+        0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11, 1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+        3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9, 4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1};
+    for (unsigned int level = 0; level < subdivisions; level++)
+    {
+        std::map<std::pair<unsigned int, unsigned int>, unsigned int> midpoints;
+        auto midpoint = [&](unsigned int a, unsigned int b) {
+            const auto key = std::make_pair(std::min(a, b), std::max(a, b));
+            auto it = midpoints.find(key);
+            if (it != midpoints.end())
+                return it->second;
+            points.push_back(glm::normalize(points[a] + points[b]));
+            return midpoints[key] = static_cast<unsigned int>(points.size() - 1);
+        };
+        std::vector<unsigned int> finer;
+        finer.reserve(triangles.size() * 4);
+        for (size_t i = 0; i < triangles.size(); i += 3)
+        {
+            const unsigned int a = triangles[i], b = triangles[i + 1], c = triangles[i + 2];
+            const unsigned int ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+            finer.insert(finer.end(), {a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca});
+        }
+        triangles.swap(finer);
+    }
+
+    ImportedMesh mesh;
+    auto vertexAt = [&](const glm::vec3& p, float u) {
+        Vertex v;
+        v.Position = p * radius;
+        v.Normal = p;
+        v.TexCoords = glm::vec2(u, 0.5f + std::asin(std::clamp(p.y, -1.0f, 1.0f)) / glm::pi<float>());
+        // along the parallels, north at the poles
+        const glm::vec3 east(-p.z, 0.0f, p.x);
+        v.Tangent = glm::dot(east, east) > 1e-8f ? glm::normalize(east) : glm::vec3(1.0f, 0.0f, 0.0f);
+        v.Bitangent = glm::cross(p, v.Tangent);
+        std::fill(std::begin(v.m_BoneIDs), std::end(v.m_BoneIDs), -1);
+        std::fill(std::begin(v.m_Weights), std::end(v.m_Weights), 0.0f);
+        mesh.vertices.push_back(v);
+        return static_cast<unsigned int>(mesh.vertices.size() - 1);
+    };
+    std::vector<float> longitude(points.size());
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        longitude[i] = 0.5f + std::atan2(points[i].z, points[i].x) / glm::two_pi<float>();
+        vertexAt(points[i], longitude[i]);
+    }
+    // a triangle spanning more than half the texture crosses the date line, its western corners get a copy past 1
+    std::map<unsigned int, unsigned int> wrapped;
+    for (size_t i = 0; i < triangles.size(); i += 3)
+    {
+        const float low = std::min({longitude[triangles[i]], longitude[triangles[i + 1]], longitude[triangles[i + 2]]});
+        const float high = std::max({longitude[triangles[i]], longitude[triangles[i + 1]], longitude[triangles[i + 2]]});
+        if (high - low <= 0.5f)
+            continue;
+        for (size_t k = i; k < i + 3; k++)
+        {
+            const unsigned int corner = triangles[k];
+            if (longitude[corner] >= 0.5f)
+                continue;
+            auto it = wrapped.find(corner);
+            triangles[k] = it != wrapped.end() ? it->second : wrapped[corner] = vertexAt(points[corner], longitude[corner] + 1.0f);
+        }
+    }
+    // the poles have no longitude of their own, a corner there takes its triangle's
+    for (size_t i = 0; i < triangles.size(); i += 3)
+        for (size_t k = i; k < i + 3; k++)
+        {
+            const unsigned int corner = triangles[k];
+            if (corner >= points.size() || std::abs(points[corner].y) < 0.9999f)
+                continue;
+            const float u = 0.5f * (mesh.vertices[triangles[i + (k - i + 1) % 3]].TexCoords.x + mesh.vertices[triangles[i + (k - i + 2) % 3]].TexCoords.x);
+            triangles[k] = vertexAt(points[corner], u);
+        }
+    mesh.indices = std::move(triangles);
+    return mesh;
+}
+
+// base with its meshes replaced by one icosphere as far out as base reaches, whose shape the vertex shaders make;
+// base's textures and number of levels of detail are kept, the levels simplified and the mesh optimized, its BVH
+// and meshlets built as an import's are. GL-free.
+inline ModelData proceduralRockData(const Model& base)
+{
+    ModelData data;
+    data.path = "procedural rock";
+    data.directory = base.directory;
+    float radius = 0.0f;
+    for (const Mesh& mesh : base.meshes)
+        radius = std::max(radius, mesh.boundingRadius);
+    ImportedMesh mesh = icosphereRock(radius > 0.0f ? radius : 1.0f);
+    for (const Mesh& baseMesh : base.meshes)
+        for (const Texture& texture : baseMesh.textures)
+            mesh.textures.push_back(Texture{0, texture.type, texture.path});
+    optimizeMesh(mesh.vertices, mesh.indices);
+    mesh.bvh.build(mesh.vertices, mesh.indices);
+    mesh.meshlets = buildMeshlets(mesh.vertices, mesh.indices);
+    if (base.lodCount() > 1)
+        mesh.lods = Mesh::simplifyLods(mesh.vertices, mesh.indices, base.lodCount(), 0.35f);
+    data.meshes.push_back(std::move(mesh));
+    return data;
+}
+
+// the shaders' relief moves the surface out by at most that fraction, culling and impostors go by the grown bound
+inline void growRockBounds(Model& model, float relief)
+{
+    for (Mesh& mesh : model.meshes)
+        mesh.boundingRadius *= 1.0f + relief;
+}
+
+class RockVariants
+{
+public:
+    // count variants of base, whose meshes must still have their CPU copies, pooled in layout. The texture array is
+    // made from base's first diffuse texture, deformed from seed on. The bounds grow by a procedural rock's relief.
+    RockVariants(const Model& base, unsigned int count, VertexLayout layout, uint32_t seed = 1, float relief = 0.0f)
+    {
+        PROFILE_SCOPE("RockVariants");
+        count = std::clamp(count, 1u, MAX_ROCK_VARIANTS);
+        variants.reserve(count);
+        for (unsigned int v = 0; v < count; v++)
+        {
+            ModelData data;
+            data.path = "rock variant " + std::to_string(v);
+            for (const Mesh& mesh : base.meshes)
+            {
+                ImportedMesh imported;
+                imported.vertices = mesh.vertices;
+                imported.indices = mesh.indices;
+                if (v > 0)
+                    deformRock(imported.vertices, seed + v);
+                imported.lods = Mesh::simplifyLods(imported.vertices, imported.indices, base.lodCount(), 0.35f);
+                data.meshes.push_back(std::move(imported));
+            }
+            variants.emplace_back(std::move(data), base.gammaCorrection, layout, true);
+            growRockBounds(variants.back(), relief);
+        }
+        for (const Model& model : variants)
+            pointers.push_back(&model);
+        buildTextures(base, count, seed);
+    }
+
+    RockVariants(const RockVariants&) = delete;
+    RockVariants& operator=(const RockVariants&) = delete;
+
+    unsigned int count() const { return static_cast<unsigned int>(variants.size()); }
+    const Model& model(unsigned int variant) const { return variants[variant]; }
+    // every variant in order, for GpuCuller
+    const Model* const* models() const { return pointers.data(); }
+    // the GL_TEXTURE_2D_ARRAY with a layer per variant, 0 when the rock had no diffuse texture
+    unsigned int texture() const { return textures.id(); }
+    unsigned int textureLayers() const { return layers; }
+
+    // the farthest vertex of any variant, a bound for all of them
+    float boundingRadius() const
+    {
+        float radius = 0.0f;
+        for (const Model& model : variants)
+            for (const Mesh& mesh : model.meshes)
+                radius = std::max(radius, mesh.boundingRadius);
+        return radius;
+    }
+
+    // the shapes are only drawn from the pool
+    void releaseCpuData()
+    {
+        for (Model& model : variants)
+            model.releaseCpuData();
+    }
+
+private:
+    std::vector<Model> variants;
+    std::vector<const Model*> pointers;
+    GlTexture textures{GPU_MEMORY_TEXTURES};
+    unsigned int layers = 0;
+
+    // decodes the texture once, uncompressed so it can be tinted, and fills one layer per variant
+    void buildTextures(const Model& base, unsigned int count, uint32_t seed)
+    {
+        const Texture* diffuse = nullptr;
+        for (const Texture& texture : base.textures_loaded)
+            if (texture.type == "texture_diffuse" && !diffuse)
+                diffuse = &texture;
+        if (!diffuse)
+            return;
+        TextureOptions options = textureCache().options(base.gammaCorrection);
+        options.compress = false;
+        options.flipVertically = true;
+        DecodedImage image = DecodeTextureFile(base.directory + '/' + diffuse->path, options);
+        if (!image.data || (image.components != 3 && image.components != 4))
+        {
+            freeImage(image);
+            return;
+        }
+        const GLenum format = base.gammaCorrection ? (image.components == 4 ? GL_SRGB8_ALPHA8 : GL_SRGB8) : (image.components == 4 ? GL_RGBA8 : GL_RGB8);
+        const GLenum pixelFormat = image.components == 4 ? GL_RGBA : GL_RGB;
+        const GLsizei levels = 1 + static_cast<GLsizei>(std::floor(std::log2(static_cast<float>(std::max(image.width, image.height)))));
+        textures.create(GL_TEXTURE_2D_ARRAY, "rock variant textures");
+        textures.storage3D(levels, format, image.width, image.height, static_cast<GLsizei>(count));
+        const size_t pixelCount = static_cast<size_t>(image.width) * image.height;
+        std::vector<unsigned char> layer(pixelCount * image.components);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (unsigned int v = 0; v < count; v++)
+        {
+            std::copy(image.data, image.data + layer.size(), layer.begin());
+            if (v > 0)
+                tintPixels(layer.data(), pixelCount, image.components, seed + v);
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, static_cast<GLint>(v), image.width, image.height, 1, pixelFormat, GL_UNSIGNED_BYTE, layer.data());
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glState().bindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        layers = count;
+        freeImage(image);
+    }
+};
+
+#endif
@@ -0,0 +1,459 @@
+#ifndef SCENARIO_FILE_H
+#define SCENARIO_FILE_H
+
+#include <glm.hpp>
+#include <gtc/constants.hpp>
+
+#include <body_store.h>
+#include <philox.h>
+#include <thread_pool.h>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+
+// A scenario as a text file: a few settings, the bodies placed one by one and the generators that fill in the
+// rest. '#' starts a comment, a [kind name] line starts a block and every other line is key = value:
+//
+//     G = 1000
+//     seed = 7
+//
+//     [body sun]
+//     type = sun
+//     mass = 20000
+//     radius = 15
+//
+//     [body planet]
+//     mass = 200
+//     around = sun            # a circular orbit about an earlier body
+//     distance = 200
+//
+//     [belt main]
+//     around = sun
+//     count = 1000000
+//     inner = 100
+//     outer = 180
+//
+// Bodies are sun, planet or asteroid (the default for a body is planet); position and velocity are "x, y, z" and
+// add to the orbit when there is one. Generators are belt (uniform in radius, like the built-in scene), ring (uniform
+// in area, thin and cold), disk (exponential in radius, sech^2 in height) and cluster (a Plummer sphere of its own
+// mass, velocities from its distribution function), all of asteroids about their around body or position, tilted
+// by inclination degrees about x. Nothing is generated while loading. A generator's item is a pure function of the
+// seed, the generator and the index (ScenarioGenerator::evaluate, a Philox stream each), so generateScenario opens
+// the whole range in the store at once and fills it over the worker pool, identically for any thread count.
+//
+// An "ephemeris = file" line, the path relative to the scenario, drives the sun and planets it has targets for from
+// that ephemeris (ephemeris.h) instead of integrating them.
+enum ScenarioGeneratorKind {
+    GENERATOR_BELT = 0,
+    GENERATOR_RING = 1,
+    GENERATOR_DISK = 2,
+    GENERATOR_CLUSTER = 3
+};
+
+struct ScenarioBody
+{
+    std::string name;
+    BodyType type = BODY_PLANET;
+    float mass = 1.0f;
+    float radius = 1.0f;
+    int around = -1;                    // index into the scenario's bodies, -1 for none
+    float distance = 0.0f;
+    float angle = 0.0f;                 // degrees along the orbit
+    float inclination = 0.0f;           // degrees about x
+    glm::dvec3 position = glm::dvec3(0.0);
+    glm::dvec3 velocity = glm::dvec3(0.0);
+};
+
+// one generated asteroid, before its centre's position and velocity are added
+struct GeneratedBody
+{
+    glm::dvec3 position;
+    glm::dvec3 velocity;
+    float mass;
+    float radiusScale;
+    glm::quat orientation;
+};
+
+struct ScenarioGenerator
+{
+    std::string name;
+    ScenarioGeneratorKind kind = GENERATOR_BELT;
+    int around = -1;
+    glm::dvec3 position = glm::dvec3(0.0);
+    glm::dvec3 velocity = glm::dvec3(0.0);
+    float inclination = 0.0f;
+    size_t count = 0;
+    float mass = 0.1f;                  // mean, each is 0.5 to 1.5 times it
+    float minScale = 0.05f;
+    float maxScale = 0.25f;
+    float inner = 100.0f;               // belt and ring
+    float outer = 180.0f;               // belt, ring and disk truncation
+    float height = 10.0f;               // full thickness of belt and ring, sech^2 scale of a disk
+    float scaleLength = 30.0f;          // disk exponential, cluster Plummer
+    float dispersion = 0.1f;            // random velocity as a fraction of the circular speed
+
+    // item i of the generator about a centre of mass centreMass; stream is the generator's index in the file
+    GeneratedBody evaluate(uint64_t seed, uint32_t stream, size_t i, float G, float centreMass) const
+    {
+        philox::Stream rng(seed, i, stream);
+        GeneratedBody b;
+        const double twoPi = glm::two_pi<double>();
+        double r = 0.0, phi = twoPi * rng.uniform(), y = 0.0;
+        switch (kind)
+        {
+        case GENERATOR_BELT:
+            r = rng.uniform(inner, outer);
+            y = height * (rng.uniform() - 0.5);
+            break;
+        case GENERATOR_RING:
+            r = std::sqrt(inner * inner + (outer * outer - inner * inner) * static_cast<double>(rng.uniform()));
+            y = height * (rng.uniform() - 0.5);
+            break;
+        case GENERATOR_DISK:
+            // R e^(-R/h) as the sum of two exponentials, redrawn past the truncation
+            do r = -scaleLength * std::log((1.0 - rng.uniform()) * (1.0 - rng.uniform()));
+            while (r > outer);
+            y = height * std::atanh(std::clamp(2.0 * rng.uniform() - 1.0, -0.999999, 0.999999));
+            break;
+        case GENERATOR_CLUSTER:
+            return cluster(rng, G);
+        }
+        const glm::dvec3 radial(std::cos(phi), 0.0, std::sin(phi));
+        const glm::dvec3 tangent(-std::sin(phi), 0.0, std::cos(phi));
+        const double v = (centreMass > 0.0f && r > 0.0) ? std::sqrt(G * centreMass / r) : 0.0;
+        b.position = r * radial + glm::dvec3(0.0, y, 0.0);
+        b.velocity = v * tangent;
+        const double dx = rng.uniform() - 0.5, dy = rng.uniform() - 0.5, dz = rng.uniform() - 0.5;
+        b.velocity += 2.0 * dispersion * v * glm::dvec3(dx, 0.1 * dy, dz);
+        finish(rng, b);
+        return b;
+    }
+
+private:
+    GeneratedBody cluster(philox::Stream& rng, float G) const
+    {
+        // the Plummer cumulative mass inverted, M(<r) / M = r^3 / (r^2 + a^2)^(3/2), and the speed as a fraction q of
+        // the escape speed from the rejection of Aarseth, Henon & Wielen (1974) for g(q) = q^2 (1 - q^2)^(7/2)
+        const double a = scaleLength;
+        double r;
+        do r = a / std::sqrt(std::pow(1.0 - rng.uniform() * 0.999999, -2.0 / 3.0) - 1.0 + 1e-12);
+        while (r > outer);
+        double q, g;
+        do
+        {
+            q = rng.uniform();
+            g = 0.1 * rng.uniform();
+        } while (g > q * q * std::pow(1.0 - q * q, 3.5));
+        const double clusterMass = static_cast<double>(mass) * static_cast<double>(count);
+        const double escape = std::sqrt(2.0 * G * clusterMass / std::sqrt(r * r + a * a));
+        GeneratedBody b;
+        b.position = r * direction(rng);
+        b.velocity = q * escape * direction(rng);
+        finish(rng, b);
+        return b;
+    }
+
+    static glm::dvec3 direction(philox::Stream& rng)
+    {
+        const double z = 2.0 * rng.uniform() - 1.0, phi = glm::two_pi<double>() * rng.uniform();
+        const double s = std::sqrt(std::max(0.0, 1.0 - z * z));
+        return glm::dvec3(s * std::cos(phi), s * std::sin(phi), z);
+    }
+
+    void finish(philox::Stream& rng, GeneratedBody& b) const
+    {
+        b.mass = mass * rng.uniform(0.5f, 1.5f);
+        b.radiusScale = rng.uniform(minScale, maxScale);
+        const glm::vec3 axis = glm::normalize(glm::vec3(rng.uniform(), rng.uniform(), rng.uniform()) + 0.001f);
+        b.orientation = glm::angleAxis(glm::two_pi<float>() * rng.uniform(), axis);
+    }
+};
+
+class ScenarioFile
+{
+public:
+    float G = 0.0f;                     // 0 keeps the world's
+    float softening = 0.0f;             // 0 keeps the world's
+    unsigned int seed = 1;
+    std::string ephemeris;              // relative to the scenario file, empty for none
+    std::vector<ScenarioBody> bodies;
+    std::vector<ScenarioGenerator> generators;
+
+    size_t generatedCount() const
+    {
+        size_t n = 0;
+        for (const ScenarioGenerator& g : generators) n += g.count;
+        return n;
+    }
+    size_t bodyCount() const { return bodies.size() + generatedCount(); }
+
+    // false with a message naming the line on a syntax error, an unknown key or a name that is not an earlier body
+    bool load(const char* path, std::string& error)
+    {
+        std::ifstream in(path);
+        if (!in)
+        {
+            error = std::string("cannot open ") + path;
+            return false;
+        }
+        *this = ScenarioFile();
+        error.clear();
+        std::string line;
+        ScenarioBody* body = nullptr;
+        ScenarioGenerator* generator = nullptr;
+        for (unsigned int number = 1; std::getline(in, line); number++)
+        {
+            line = trim(line.substr(0, line.find('#')));
+            if (line.empty())
+                continue;
+            const std::string where = std::string(path) + ":" + std::to_string(number) + ": ";
+            if (line.front() == '[')
+            {
+                std::stringstream header(line.back() == ']' ? line.substr(1, line.size() - 2) : std::string());
+                std::string kind, name;
+                header >> kind >> name;
+                body = nullptr;
+                generator = nullptr;
+                if (kind == "body")
+                {
+                    bodies.push_back(ScenarioBody());
+                    body = &bodies.back();
+                    body->name = name;
+                }
+                else if (kind == "belt" || kind == "ring" || kind == "disk" || kind == "cluster")
+                {
+                    generators.push_back(defaults(kind == "belt" ? GENERATOR_BELT : kind == "ring" ? GENERATOR_RING
+                                                  : kind == "disk" ? GENERATOR_DISK : GENERATOR_CLUSTER));
+                    generator = &generators.back();
+                    generator->name = name;
+                }
+                else
+                {
+                    error = where + "unknown block '" + line + "'";
+                    return false;
+                }
+                continue;
+            }
+            const size_t eq = line.find('=');
+            const std::string key = trim(line.substr(0, eq));
+            const std::string value = eq == std::string::npos ? std::string() : trim(line.substr(eq + 1));
+            bool ok = eq != std::string::npos;
+            if (ok && body) ok = setBody(*body, key, value, error);
+            else if (ok && generator) ok = setGenerator(*generator, key, value, error);
+            else if (ok && key == "ephemeris") ephemeris = relativeTo(path, value);
+            else if (ok) ok = setGlobal(key, value);
+            if (!ok)
+            {
+                error = where + (error.empty() ? "cannot parse '" + line + "'" : error);
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    static ScenarioGenerator defaults(ScenarioGeneratorKind kind)
+    {
+        ScenarioGenerator g;
+        g.kind = kind;
+        if (kind == GENERATOR_RING) { g.inner = 8.0f; g.outer = 14.0f; g.height = 0.05f; g.dispersion = 0.002f; g.mass = 0.001f; g.minScale = 0.01f; g.maxScale = 0.04f; }
+        else if (kind == GENERATOR_DISK) { g.outer = 200.0f; g.height = 1.0f; g.dispersion = 0.05f; }
+        else if (kind == GENERATOR_CLUSTER) { g.scaleLength = 10.0f; g.outer = 100.0f; }
+        return g;
+    }
+
+    // other files a scenario names are found next to it
+    static std::string relativeTo(const std::string& file, const std::string& path)
+    {
+        const size_t slash = file.find_last_of("/\\");
+        if (path.empty() || path.front() == '/' || slash == std::string::npos)
+            return path;
+        return file.substr(0, slash + 1) + path;
+    }
+
+    int bodyNamed(const std::string& name, size_t before) const
+    {
+        for (size_t k = 0; k < before; k++)
+            if (bodies[k].name == name)
+                return static_cast<int>(k);
+        return -1;
+    }
+
+    bool setGlobal(const std::string& key, const std::string& value)
+    {
+        double v;
+        if (!parseNumber(value, v)) return false;
+        if (key == "G") G = static_cast<float>(v);
+        else if (key == "softening") softening = static_cast<float>(v);
+        else if (key == "seed") seed = static_cast<unsigned int>(std::max(v, 0.0));
+        else return false;
+        return true;
+    }
+
+    bool setBody(ScenarioBody& b, const std::string& key, const std::string& value, std::string& error)
+    {
+        double v = 0.0;
+        if (key == "type")
+        {
+            if (value == "sun") b.type = BODY_SUN;
+            else if (value == "planet") b.type = BODY_PLANET;
+            else if (value == "asteroid") b.type = BODY_ASTEROID;
+            else return false;
+            return true;
+        }
+        // the body being read is the last one, it cannot orbit itself
+        if (key == "around") return (b.around = nameOf(value, bodies.size() - 1, error)) >= 0;
+        if (key == "position") return parseVector(value, b.position);
+        if (key == "velocity") return parseVector(value, b.velocity);
+        if (!parseNumber(value, v)) return false;
+        const float f = static_cast<float>(v);
+        if (key == "mass") b.mass = f;
+        else if (key == "radius") b.radius = f;
+        else if (key == "distance") b.distance = f;
+        else if (key == "angle") b.angle = f;
+        else if (key == "inclination") b.inclination = f;
+        else return false;
+        return true;
+    }
+
+    bool setGenerator(ScenarioGenerator& g, const std::string& key, const std::string& value, std::string& error)
+    {
+        double v = 0.0;
+        if (key == "around") return (g.around = nameOf(value, bodies.size(), error)) >= 0;
+        if (key == "position") return parseVector(value, g.position);
+        if (key == "velocity") return parseVector(value, g.velocity);
+        if (key == "scale")
+        {
+            glm::dvec3 range;
+            const size_t comma = value.find(',');
+            if (comma == std::string::npos || !parseNumber(value.substr(0, comma), range.x) ||
+                !parseNumber(value.substr(comma + 1), range.y))
+                return false;
+            g.minScale = static_cast<float>(range.x);
+            g.maxScale = static_cast<float>(range.y);
+            return true;
+        }
+        if (!parseNumber(value, v)) return false;
+        const float f = static_cast<float>(v);
+        if (key == "count") g.count = static_cast<size_t>(std::max(v, 0.0));
+        else if (key == "mass") g.mass = f;
+        else if (key == "inner") g.inner = f;
+        else if (key == "outer" || key == "radius") g.outer = f;
+        else if (key == "height") g.height = f;
+        else if (key == "scaleLength") g.scaleLength = f;
+        else if (key == "dispersion") g.dispersion = f;
+        else if (key == "inclination") g.inclination = f;
+        else return false;
+        return true;
+    }
+
+    int nameOf(const std::string& name, size_t before, std::string& error) const
+    {
+        const int k = bodyNamed(name, before);
+        if (k < 0) error = "no earlier body named '" + name + "'";
+        return k;
+    }
+
+    static std::string trim(const std::string& s)
+    {
+        size_t b = s.find_first_not_of(" \t\r"), e = s.find_last_not_of(" \t\r");
+        return b == std::string::npos ? std::string() : s.substr(b, e - b + 1);
+    }
+
+    static bool parseNumber(const std::string& s, double& out)
+    {
+        std::string t = trim(s);
+        char* end = nullptr;
+        out = std::strtod(t.c_str(), &end);
+        return !t.empty() && end == t.c_str() + t.size();
+    }
+
+    // "x, y, z"
+    static bool parseVector(const std::string& text, glm::dvec3& out)
+    {
+        std::stringstream list(text);
+        std::string item;
+        int n = 0;
+        while (std::getline(list, item, ','))
+            if (n >= 3 || !parseNumber(item, out[n++]))
+                return false;
+        return n == 3;
+    }
+};
+
+// rotates about x by degrees, the tilt of an orbit or a generator's plane
+inline glm::dvec3 tiltAboutX(const glm::dvec3& v, double degrees)
+{
+    const double c = std::cos(glm::radians(degrees)), s = std::sin(glm::radians(degrees));
+    return glm::dvec3(v.x, c * v.y - s * v.z, s * v.y + c * v.z);
+}
+
+// replaces the bodies with the scenario's: the placed bodies in file order, each orbit about where its centre
+// already is, then every generator's asteroids written straight into one range of the store from the worker pool
+inline void generateScenario(BodyStore& bodies, const ScenarioFile& file, float G, Mesh* sunMesh = nullptr,
+                             Model* planetModel = nullptr, Model* asteroidModel = nullptr)
+{
+    bodies.clear();
+    bodies.reserve(file.bodyCount());
+    std::vector<glm::dvec3> positions(file.bodies.size()), velocities(file.bodies.size());
+    std::vector<uint32_t> ids(file.bodies.size());
+    for (size_t k = 0; k < file.bodies.size(); k++)
+    {
+        const ScenarioBody& b = file.bodies[k];
+        positions[k] = b.position;
+        velocities[k] = b.velocity;
+        if (b.around >= 0)
+        {
+            const ScenarioBody& centre = file.bodies[b.around];
+            const double angle = glm::radians(static_cast<double>(b.angle));
+            const double v = (centre.mass > 0.0f && b.distance > 0.0f) ? std::sqrt(G * centre.mass / b.distance) : 0.0;
+            const glm::dvec3 radial(std::cos(angle), 0.0, std::sin(angle)), tangent(-std::sin(angle), 0.0, std::cos(angle));
+            positions[k] += positions[b.around] + tiltAboutX(static_cast<double>(b.distance) * radial, b.inclination);
+            velocities[k] += velocities[b.around] + tiltAboutX(v * tangent, b.inclination);
+        }
+        const size_t index = bodies.add(b.type, positions[k], velocities[k], b.mass, b.radius,
+                                        b.type == BODY_PLANET ? planetModel : b.type == BODY_ASTEROID ? asteroidModel : nullptr,
+                                        b.type == BODY_SUN ? sunMesh : nullptr);
+        ids[k] = bodies.id[index];
+        bodies.render[index].spin = b.type == BODY_ASTEROID ? tumbleFor(ids[k]) : bodies.render[index].spin;
+    }
+
+    const size_t total = file.generatedCount();
+    const size_t first = bodies.extend(BODY_ASTEROID, total);
+    std::vector<size_t> starts(file.generators.size() + 1, 0);
+    for (size_t g = 0; g < file.generators.size(); g++)
+        starts[g + 1] = starts[g] + file.generators[g].count;
+    workerPool().parallelFor(0, total, [&](size_t begin, size_t end, unsigned int) {
+        size_t g = std::upper_bound(starts.begin(), starts.end(), begin) - starts.begin() - 1;
+        for (size_t k = begin; k < end; k++)
+        {
+            while (k >= starts[g + 1]) g++;
+            const ScenarioGenerator& gen = file.generators[g];
+            glm::dvec3 centre = gen.position, centreVelocity = gen.velocity;
+            float centreMass = 0.0f;
+            if (gen.around >= 0)
+            {
+                centre += positions[gen.around];
+                centreVelocity += velocities[gen.around];
+                centreMass = file.bodies[gen.around].mass;
+            }
+            const GeneratedBody b = gen.evaluate(file.seed, static_cast<uint32_t>(g), k - starts[g], G, centreMass);
+            const size_t index = first + k;
+            bodies.position[index] = centre + tiltAboutX(b.position, gen.inclination);
+            bodies.velocity[index] = centreVelocity + tiltAboutX(b.velocity, gen.inclination);
+            bodies.mass[index] = b.mass;
+            BodyRenderData& render = bodies.render[index];
+            render.orientation = b.orientation;
+            render.radiusScale = b.radiusScale;
+            render.modelPtr = asteroidModel;
+            render.spin = tumbleFor(bodies.id[index]);
+        }
+    });
+}
+
+#endif
@@ -0,0 +1,267 @@
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <glm.hpp>
+
+#include <thread_pool.h>
+#include <profiler.h>
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+// A transform hierarchy in flat arrays. Nodes are named by stable ids, the arrays behind them are kept in depth
+// order (every node of depth d before any of depth d + 1), so one pass over them meets each parent's world
+// matrix before its children need it. setLocal marks a node dirty; update() recomputes the world matrices of the
+// dirty nodes and of everything below them, nothing else, a depth level at a time with each large level split
+// across a thread pool. Adding, removing or reparenting nodes re-sorts the arrays on the next update.
+class SceneGraph
+{
+public:
+    static constexpr uint32_t NO_PARENT = 0xFFFFFFFFu;
+    // levels smaller than this are updated on the calling thread, a wake-up costs more than the matrices
+    static const size_t PARALLEL_LEVEL = 2048;
+
+    size_t size() const { return slotParent.size(); }
+    bool empty() const { return slotParent.empty(); }
+    // world matrices the last update() recomputed
+    size_t updated() const { return updatedCount; }
+
+    // a node under parent (NO_PARENT for a root), its id
+    uint32_t add(const glm::mat4& local, uint32_t parent = NO_PARENT)
+    {
+        uint32_t id;
+        if (!freeIds.empty())
+        {
+            id = freeIds.back();
+            freeIds.pop_back();
+        }
+        else
+        {
+            id = static_cast<uint32_t>(slotOfId.size());
+            slotOfId.push_back(NO_PARENT);
+        }
+        const uint32_t slot = static_cast<uint32_t>(slotParent.size());
+        slotOfId[id] = slot;
+        idOfSlot.push_back(id);
+        slotParent.push_back(parent == NO_PARENT ? NO_PARENT : slotOfId[parent]);
+        locals.push_back(local);
+        worlds.push_back(local);
+        dirty.push_back(1);
+        changed.push_back(0);
+        // appending keeps the order as long as the new node is at least as deep as the last one
+        if (!structureChanged)
+        {
+            const size_t depth = depthOf(slot), levels = levelStart.empty() ? 0 : levelStart.size() - 1;
+            if (levels == 0)
+                levelStart.assign(1, 0);
+            if (depth == levels)
+                levelStart.push_back(slot + 1);
+            else if (depth + 1 == levels)
+                levelStart.back() = slot + 1;
+            else
+                structureChanged = true;
+        }
+        anyDirty = true;
+        return id;
+    }
+
+    // takes the node and everything below it out, their ids are reused
+    void remove(uint32_t node)
+    {
+        // parents come first, so one pass marks the whole subtree
+        sortIfNeeded();
+        std::vector<uint8_t> removed(size(), 0);
+        removed[slotOfId[node]] = 1;
+        for (size_t s = 0; s < size(); s++)
+            if (slotParent[s] != NO_PARENT && removed[slotParent[s]])
+                removed[s] = 1;
+        std::vector<uint32_t> newSlot(size(), NO_PARENT);
+        size_t kept = 0;
+        for (size_t s = 0; s < size(); s++)
+        {
+            if (removed[s])
+            {
+                slotOfId[idOfSlot[s]] = NO_PARENT;
+                freeIds.push_back(idOfSlot[s]);
+                continue;
+            }
+            newSlot[s] = static_cast<uint32_t>(kept);
+            idOfSlot[kept] = idOfSlot[s];
+            slotParent[kept] = slotParent[s] == NO_PARENT ? NO_PARENT : newSlot[slotParent[s]];
+            locals[kept] = locals[s];
+            worlds[kept] = worlds[s];
+            dirty[kept] = dirty[s];
+            slotOfId[idOfSlot[kept]] = static_cast<uint32_t>(kept);
+            kept++;
+        }
+        resizeSlots(kept);
+        rebuildLevels();
+    }
+
+    // moves a node (with its subtree) under another one, which must not be below it
+    void setParent(uint32_t node, uint32_t parent)
+    {
+        const uint32_t slot = slotOfId[node];
+        slotParent[slot] = parent == NO_PARENT ? NO_PARENT : slotOfId[parent];
+        dirty[slot] = 1;
+        anyDirty = true;
+        structureChanged = true;
+    }
+
+    void setLocal(uint32_t node, const glm::mat4& local)
+    {
+        const uint32_t slot = slotOfId[node];
+        locals[slot] = local;
+        dirty[slot] = 1;
+        anyDirty = true;
+    }
+
+    bool contains(uint32_t node) const { return node < slotOfId.size() && slotOfId[node] != NO_PARENT; }
+    uint32_t parent(uint32_t node) const
+    {
+        const uint32_t p = slotParent[slotOfId[node]];
+        return p == NO_PARENT ? NO_PARENT : idOfSlot[p];
+    }
+    const glm::mat4& local(uint32_t node) const { return locals[slotOfId[node]]; }
+    // as of the last update()
+    const glm::mat4& world(uint32_t node) const { return worlds[slotOfId[node]]; }
+
+    // the world matrices of the dirty subtrees, a level's nodes split across pool when there are enough of them
+    // (null for the calling thread alone)
+    void update(ThreadPool* pool = &workerPool())
+    {
+        PROFILE_FUNCTION();
+        updatedCount = 0;
+        if (!anyDirty)
+            return;
+        sortIfNeeded();
+        for (size_t level = 0; level + 1 < levelStart.size(); level++)
+        {
+            const size_t begin = levelStart[level], end = levelStart[level + 1];
+            if (pool && end - begin >= PARALLEL_LEVEL)
+            {
+                sliceUpdated.assign(pool->size(), 0);
+                pool->parallelFor(begin, end, [&](size_t b, size_t e, unsigned int slice) { sliceUpdated[slice] = updateSlots(b, e); });
+                for (size_t count : sliceUpdated)
+                    updatedCount += count;
+            }
+            else
+                updatedCount += updateSlots(begin, end);
+        }
+        anyDirty = false;
+    }
+
+private:
+    // by id
+    std::vector<uint32_t> slotOfId;     // NO_PARENT for a free id
+    std::vector<uint32_t> freeIds;
+    // by slot, in depth order
+    std::vector<uint32_t> idOfSlot;
+    std::vector<uint32_t> slotParent;
+    std::vector<glm::mat4> locals;
+    std::vector<glm::mat4> worlds;
+    std::vector<uint8_t> dirty;         // the local matrix or the parent changed since the last update
+    std::vector<uint8_t> changed;       // the world matrix was recomputed by this update, read by the children
+    std::vector<size_t> levelStart;     // first slot of each depth, and size() at the end
+    std::vector<size_t> sliceUpdated;
+    size_t updatedCount = 0;
+    bool anyDirty = false;
+    bool structureChanged = false;
+
+    // a slot's children sit in later levels, so each slice only reads the level above, which is finished
+    size_t updateSlots(size_t begin, size_t end)
+    {
+        size_t count = 0;
+        for (size_t s = begin; s < end; s++)
+        {
+            const uint32_t p = slotParent[s];
+            if (!dirty[s] && (p == NO_PARENT || !changed[p]))
+            {
+                changed[s] = 0;
+                continue;
+            }
+            worlds[s] = p == NO_PARENT ? locals[s] : worlds[p] * locals[s];
+            dirty[s] = 0;
+            changed[s] = 1;
+            count++;
+        }
+        return count;
+    }
+
+    // walks the parents of an arbitrary slot, for nodes whose order is not settled yet
+    size_t depthOf(size_t slot) const
+    {
+        size_t depth = 0;
+        for (uint32_t p = slotParent[slot]; p != NO_PARENT; p = slotParent[p])
+            depth++;
+        return depth;
+    }
+
+    void resizeSlots(size_t n)
+    {
+        idOfSlot.resize(n);
+        slotParent.resize(n);
+        locals.resize(n);
+        worlds.resize(n);
+        dirty.resize(n);
+        changed.assign(n, 0);
+    }
+
+    // a stable counting sort of the slots by depth, ids keep pointing at their nodes
+    void sortIfNeeded()
+    {
+        if (!structureChanged)
+            return;
+        const size_t n = size();
+        std::vector<size_t> depth(n);
+        size_t levels = 0;
+        for (size_t s = 0; s < n; s++)
+        {
+            depth[s] = depthOf(s);
+            levels = std::max(levels, depth[s] + 1);
+        }
+        std::vector<size_t> start(levels + 1, 0);
+        for (size_t s = 0; s < n; s++)
+            start[depth[s] + 1]++;
+        for (size_t l = 0; l < levels; l++)
+            start[l + 1] += start[l];
+        std::vector<uint32_t> order(n);     // order[newSlot] = oldSlot
+        std::vector<uint32_t> newSlot(n);
+        std::vector<size_t> next(start.begin(), start.end() - 1);
+        for (size_t s = 0; s < n; s++)
+        {
+            newSlot[s] = static_cast<uint32_t>(next[depth[s]]++);
+            order[newSlot[s]] = static_cast<uint32_t>(s);
+        }
+        std::vector<uint32_t> ids(n), parents(n);
+        std::vector<glm::mat4> newLocals(n), newWorlds(n);
+        std::vector<uint8_t> newDirty(n);
+        for (size_t s = 0; s < n; s++)
+        {
+            const uint32_t old = order[s];
+            ids[s] = idOfSlot[old];
+            parents[s] = slotParent[old] == NO_PARENT ? NO_PARENT : newSlot[slotParent[old]];
+            newLocals[s] = locals[old];
+            newWorlds[s] = worlds[old];
+            newDirty[s] = dirty[old];
+            slotOfId[ids[s]] = static_cast<uint32_t>(s);
+        }
+        idOfSlot.swap(ids);
+        slotParent.swap(parents);
+        locals.swap(newLocals);
+        worlds.swap(newWorlds);
+        dirty.swap(newDirty);
+        changed.assign(n, 0);
+        levelStart.swap(start);
+        structureChanged = false;
+    }
+
+    void rebuildLevels()
+    {
+        structureChanged = true;
+        sortIfNeeded();
+    }
+};
+
+#endif
@@ -0,0 +1,574 @@
+#ifndef SCENE_TARGET_H
+#define SCENE_TARGET_H
+
+#include <glad/glad.h>
+
+#include <glm.hpp>
+#include <gtc/matrix_transform.hpp>
+
+#include <shader.h>
+#include <bloom.h>
+#include <frame_graph.h>
+#include <gpu_memory.h>
+#include <depth_convention.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+// how the scene target's edges are smoothed: hardware multisampling, or one of the post-process filters over the
+// single-sampled frame before it is upscaled
+enum AntiAliasing {
+    AA_NONE = 0,
+    AA_MSAA = 1,
+    AA_FXAA = 2,
+    AA_SMAA = 3,
+    AA_TAA = 4,
+    AA_MODES = 5
+};
+
+inline const char* antiAliasingName(AntiAliasing mode)
+{
+    switch (mode)
+    {
+        case AA_NONE: return "none";
+        case AA_MSAA: return "msaa";
+        case AA_FXAA: return "fxaa";
+        case AA_SMAA: return "smaa";
+        case AA_TAA: return "taa";
+        default: return "unknown";
+    }
+}
+
+// The offscreen frame the scene is drawn into, at a fraction of the window's pixels, and its post-processing and
+// upscale into the default framebuffer, under which the UI is then drawn at native resolution. Colour is linear
+// R11F_G11F_B10F, the lit shaders write HDR and the frame is bloomed (Bloom), exposed, tone mapped and encoded
+// to sRGB once here (shaders.2/tonemap.fs) instead of per fragment. Depth is 24-bit with stencil so HiZ can copy
+// it, and a texture on the single-sampled path so TAA can reproject with it. The anti-aliasing, after the tone
+// mapping so the filters see display values:
+//   MSAA  the scene drawn into multisampled renderbuffers and resolved into the target
+//   FXAA  shaders.2/fxaa.fs, one pass
+//   SMAA  luma edges, blending weights and the blend (shaders.2/smaa.*.fs)
+//   TAA   the projection jittered on a Halton(2, 3) sequence and each frame resolved into a history
+//         (shaders.2/taa.resolve.fs), which follows the camera by depth reprojection
+// The result is filtered up bilinearly (shaders.2/upscale.fs). The post-processing is a FrameGraph rebuilt each
+// present(): what outlives the frame (the scene, the tone-mapped frame the shading rates read, TAA's history) is
+// imported, the bloom chain and the FXAA and SMAA targets are transients the graph places, so they take memory
+// only while their mode is in use and share it where their lives allow.
+class SceneTarget
+{
+public:
+    static const unsigned int JITTER_SAMPLES = 8;
+
+    float exposure = 1.0f;
+    bool logLuminance = false;      // tonemap.fs's logarithmic curve for point clouds instead of ACES
+    float logWhite = 1000.0f;       // the exposed luminance the log curve maps to white
+    bool bloomEnabled = true;
+    float bloomStrength = 0.1f;
+    Bloom bloom;
+    // the overdraw view: the scene passes between beginOverdraw() and endOverdraw() count every fragment they
+    // draw into the stencil, and present() shows the counts as a heat map (shaders.2/overdraw.fs) in place of the
+    // frame, overdrawScale layers and more white. Counts stop at 255; fragments a shader discards are not counted.
+    bool overdrawView = false;
+    bool overdrawHidden = true;     // count fragments the depth test rejects too, not only the ones drawn
+    float overdrawScale = 16.0f;
+
+    // shaderDirectory holds fullscreen.vs and the post-process fragment shaders
+    explicit SceneTarget(const std::string& shaderDirectory)
+        : bloom((shaderDirectory + "bloom.downsample.cs").c_str(), (shaderDirectory + "bloom.upsample.cs").c_str()),
+          upscaleShader((shaderDirectory + "fullscreen.vs").c_str(), (shaderDirectory + "upscale.fs").c_str()),
+          overdrawShader((shaderDirectory + "fullscreen.vs").c_str(), (shaderDirectory + "overdraw.fs").c_str()),
+          fxaaShader((shaderDirectory + "fullscreen.vs").c_str(), (shaderDirectory + "fxaa.fs").c_str()),
+          smaaEdgesShader((shaderDirectory + "fullscreen.vs").c_str(), (shaderDirectory + "smaa.edges.fs").c_str()),
+          smaaWeightsShader((shaderDirectory + "fullscreen.vs").c_str(), (shaderDirectory + "smaa.weights.fs").c_str()),
+          smaaBlendShader((shaderDirectory + "fullscreen.vs").c_str(), (shaderDirectory + "smaa.blend.fs").c_str()),
+          taaShader((shaderDirectory + "fullscreen.vs").c_str(), (shaderDirectory + "taa.resolve.fs").c_str()),
+          toneMapShader((shaderDirectory + "fullscreen.vs").c_str(), (shaderDirectory + "tonemap.fs").c_str()) {}
+
+    ~SceneTarget()
+    {
+        release();
+    }
+
+    int width() const { return targetWidth; }
+    int height() const { return targetHeight; }
+    int samples() const { return sampleCount; }
+    // last frame's tone-mapped colour, before the anti-aliasing; 0 until a frame was tone mapped at this size
+    unsigned int previousFrame() const { return toneMapped ? ldrColor.id() : 0; }
+    // the finished frame the last present() upscaled, at the target's size, for other windows to show until the
+    // next present() may place something else on it
+    unsigned int presented() const { return presentedColor; }
+    AntiAliasing antiAliasing() const { return mode; }
+    const FrameGraph::Stats& postProcessStats() const { return graph.stats(); }
+    // what the scene passes draw into and come back to
+    unsigned int framebuffer() const { return sampleCount > 1 ? msaaFbo : sceneFbo; }
+
+    // with framebuffer() bound after its clear: the stencil starts at 0 and every fragment from here on adds one
+    void beginOverdraw()
+    {
+        if (!overdrawView)
+            return;
+        glClearStencil(0);
+        glStencilMask(0xFF);
+        glClear(GL_STENCIL_BUFFER_BIT);
+        glEnable(GL_STENCIL_TEST);
+        glStencilFunc(GL_ALWAYS, 0, 0xFF);
+        const GLenum rejected = overdrawHidden ? GL_INCR : GL_KEEP;
+        glStencilOp(rejected, rejected, GL_INCR);
+    }
+
+    void endOverdraw()
+    {
+        if (!overdrawView)
+            return;
+        glDisable(GL_STENCIL_TEST);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+    }
+
+    // (re)allocates when the size, the mode or the sample count changed; samples only matter for MSAA
+    void resize(int w, int h, AntiAliasing antiAliasing, int samples)
+    {
+        w = std::max(w, 1);
+        h = std::max(h, 1);
+        samples = antiAliasing == AA_MSAA ? std::max(samples, 1) : 1;
+        if (sceneFbo != 0 && w == targetWidth && h == targetHeight && antiAliasing == mode && samples == sampleCount)
+            return;
+        release();
+        targetWidth = w;
+        targetHeight = h;
+        mode = antiAliasing;
+        sampleCount = samples;
+
+        sceneFbo = colorTarget(sceneColor, GL_R11F_G11F_B10F, GL_LINEAR, "scene color", "scene");
+        sceneDepth.create(GL_TEXTURE_2D, "scene depth");
+        sceneDepth.storage2D(1, depthConvention().depthFormat(), targetWidth, targetHeight);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glState().bindTexture(GL_TEXTURE_2D, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, sceneDepth.id(), 0);
+        checkComplete();
+
+        // multisampled the scene is drawn into renderbuffers and resolved, otherwise straight into the target
+        if (sampleCount > 1)
+        {
+            glGenFramebuffers(1, &msaaFbo);
+            glBindFramebuffer(GL_FRAMEBUFFER, msaaFbo);
+            labelObject(GL_FRAMEBUFFER, msaaFbo, "scene samples");
+            glGenRenderbuffers(1, &colorSamples);
+            glBindRenderbuffer(GL_RENDERBUFFER, colorSamples);
+            labelObject(GL_RENDERBUFFER, colorSamples, "scene color samples");
+            glRenderbufferStorageMultisample(GL_RENDERBUFFER, sampleCount, GL_R11F_G11F_B10F, targetWidth, targetHeight);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorSamples);
+            glGenRenderbuffers(1, &depthSamples);
+            glBindRenderbuffer(GL_RENDERBUFFER, depthSamples);
+            labelObject(GL_RENDERBUFFER, depthSamples, "scene depth samples");
+            glRenderbufferStorageMultisample(GL_RENDERBUFFER, sampleCount, depthConvention().depthFormat(), targetWidth, targetHeight);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthSamples);
+            glBindRenderbuffer(GL_RENDERBUFFER, 0);
+            checkComplete();
+            samplesMemory.set(static_cast<size_t>(targetWidth) * targetHeight * 8 * sampleCount);
+        }
+        ldrFbo = colorTarget(ldrColor, GL_RGBA8, GL_LINEAR, "tone mapped color", "tone mapped");
+        if (mode == AA_TAA)
+            for (int i = 0; i < 2; i++)
+                historyFbo[i] = colorTarget(history[i], GL_RGBA16F, GL_LINEAR, "taa history", "taa history");
+        historyValid = false;
+        toneMapped = false;
+        presentedColor = 0;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // binds the target for the scene passes, viewport and all
+    void bind() const
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer());
+        glViewport(0, 0, targetWidth, targetHeight);
+    }
+
+    // this frame's offset within its pixel, in pixels, zero unless TAA is on
+    glm::vec2 jitter() const
+    {
+        if (mode != AA_TAA)
+            return glm::vec2(0.0f);
+        const unsigned int index = frameIndex % JITTER_SAMPLES + 1;
+        return glm::vec2(halton(index, 2), halton(index, 3)) - 0.5f;
+    }
+
+    // the projection moved by this frame's jitter
+    glm::mat4 jittered(const glm::mat4& projection) const
+    {
+        const glm::vec2 offset = 2.0f * jitter() / glm::vec2(targetWidth, targetHeight);
+        return glm::translate(glm::mat4(1.0f), glm::vec3(offset, 0.0f)) * projection;
+    }
+
+    // TAA's reprojection, camera-relative matrices: this frame's jittered view-projection, last frame's without
+    // jitter and how far the camera moved in between
+    void setReprojection(const glm::mat4& viewProjection, const glm::mat4& previousViewProjection, const glm::vec3& cameraDelta)
+    {
+        inverseViewProjection = glm::inverse(viewProjection);
+        previous = previousViewProjection;
+        delta = cameraDelta;
+    }
+
+    // after a cut, where last frame's pixels say nothing about this one's
+    void invalidateHistory() { historyValid = false; }
+
+    // resolves the samples, runs the anti-aliasing and draws the scene over the whole of framebuffer (the default
+    // one unless a headless run gives its own), displayWidth x displayHeight, which is left bound. region is the
+    // part of the frame shown, its offset and size as fractions of the target.
+    void present(int displayWidth, int displayHeight, unsigned int framebuffer = 0, const glm::vec4& region = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f))
+    {
+        GL_DEBUG_GROUP("post-process");
+        if (emptyVAO == 0)
+            glGenVertexArrays(1, &emptyVAO);
+        // the passes run inside graph.execute() below, so they take this function's locals by reference
+        typedef FrameGraph::Resource Resource;
+        typedef FrameGraph::Builder Builder;
+        typedef FrameGraph::Context Context;
+        graph.reset();
+        const Resource scene = graph.import("scene color", sceneColor.id(), sceneFbo, targetDesc(GL_R11F_G11F_B10F, GL_LINEAR));
+        const Resource depth = graph.import("scene depth", sceneDepth.id(), 0, targetDesc(depthConvention().depthFormat(), GL_NEAREST));
+        // read by next frame's shading rates
+        const Resource ldr = graph.import("tone mapped color", ldrColor.id(), ldrFbo, targetDesc(GL_RGBA8, GL_LINEAR), true);
+        FrameGraph::TextureDesc displayDesc;
+        displayDesc.width = displayWidth;
+        displayDesc.height = displayHeight;
+        const Resource display = graph.import("display", 0, framebuffer, displayDesc, true);
+        const int current = static_cast<int>(frameIndex & 1);
+        Resource chain = FrameGraph::NO_RESOURCE, edges = FrameGraph::NO_RESOURCE, weights = FrameGraph::NO_RESOURCE;
+        Resource output = ldr;
+
+        if (sampleCount > 1)
+            graph.addPass("msaa resolve", [&](Builder& builder) {
+                builder.write(scene);
+                if (overdrawView) builder.write(depth);
+            }, [&](Context&) {
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, msaaFbo);
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, sceneFbo);
+                // the counts come across from one sample each
+                const GLbitfield mask = GL_COLOR_BUFFER_BIT | (overdrawView ? GL_STENCIL_BUFFER_BIT : 0);
+                glBlitFramebuffer(0, 0, targetWidth, targetHeight, 0, 0, targetWidth, targetHeight, mask, GL_NEAREST);
+            });
+        if (bloomEnabled)
+            graph.addPass("bloom", [&](Builder& builder) {
+                builder.read(scene);
+                chain = builder.write(builder.create("bloom chain", Bloom::chainDesc(targetWidth, targetHeight)), FrameGraph::WRITE_IMAGE);
+            }, [&](Context& context) { bloom.build(sceneColor.id(), targetWidth, targetHeight, context.texture(chain)); });
+
+        graph.addPass("tone map", [&](Builder& builder) {
+            builder.read(scene);
+            if (bloomEnabled) builder.read(chain);
+            builder.write(ldr);
+        }, [&](Context& context) {
+            glState().depthFunc(GL_ALWAYS);
+            glState().bindVertexArray(emptyVAO);
+            glViewport(0, 0, targetWidth, targetHeight);
+            glBindFramebuffer(GL_FRAMEBUFFER, ldrFbo);
+            toneMapShader.use();
+            toneMapShader.setInt("scene", 0);
+            toneMapShader.setInt("bloom", 1);
+            toneMapShader.setInt("bloomEnabled", bloomEnabled ? 1 : 0);
+            toneMapShader.setFloat("bloomStrength", bloomStrength);
+            toneMapShader.setFloat("exposure", exposure);
+            toneMapShader.setBool("logLuminance", logLuminance);
+            toneMapShader.setFloat("logWhite", std::max(logWhite, 1e-3f));
+            glState().activeTexture(GL_TEXTURE1);
+            glState().bindTexture(GL_TEXTURE_2D, bloomEnabled ? context.texture(chain) : 0);
+            drawFullscreen(0, sceneColor.id());
+            toneMapped = true;
+        });
+
+        if (mode == AA_FXAA)
+        {
+            graph.addPass("fxaa", [&](Builder& builder) {
+                builder.read(ldr);
+                output = builder.write(builder.create("post color", targetDesc(GL_RGBA8, GL_LINEAR)));
+            }, [&](Context& context) {
+                glBindFramebuffer(GL_FRAMEBUFFER, context.framebuffer(output));
+                fxaaShader.use();
+                fxaaShader.setInt("scene", 0);
+                fxaaShader.setVec2("texelSize", glm::vec2(1.0f / targetWidth, 1.0f / targetHeight));
+                drawFullscreen(0, ldrColor.id());
+            });
+        }
+        else if (mode == AA_SMAA)
+        {
+            graph.addPass("smaa edges", [&](Builder& builder) {
+                builder.read(ldr);
+                edges = builder.write(builder.create("smaa edges", targetDesc(GL_RG8, GL_NEAREST)));
+            }, [&](Context& context) {
+                // the weights pass reads zero wherever the edges pass discarded
+                glBindFramebuffer(GL_FRAMEBUFFER, context.framebuffer(edges));
+                glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+                glClear(GL_COLOR_BUFFER_BIT);
+                smaaEdgesShader.use();
+                smaaEdgesShader.setInt("scene", 0);
+                drawFullscreen(0, ldrColor.id());
+            });
+            graph.addPass("smaa weights", [&](Builder& builder) {
+                builder.read(edges);
+                weights = builder.write(builder.create("smaa weights", targetDesc(GL_RGBA8, GL_NEAREST)));
+            }, [&](Context& context) {
+                glBindFramebuffer(GL_FRAMEBUFFER, context.framebuffer(weights));
+                smaaWeightsShader.use();
+                smaaWeightsShader.setInt("edges", 0);
+                drawFullscreen(0, context.texture(edges));
+            });
+            graph.addPass("smaa blend", [&](Builder& builder) {
+                builder.read(ldr);
+                builder.read(weights);
+                output = builder.write(builder.create("post color", targetDesc(GL_RGBA8, GL_LINEAR)));
+            }, [&](Context& context) {
+                glBindFramebuffer(GL_FRAMEBUFFER, context.framebuffer(output));
+                smaaBlendShader.use();
+                smaaBlendShader.setInt("scene", 0);
+                smaaBlendShader.setInt("weights", 1);
+                glState().activeTexture(GL_TEXTURE1);
+                glState().bindTexture(GL_TEXTURE_2D, context.texture(weights));
+                drawFullscreen(0, ldrColor.id());
+            });
+        }
+        else if (mode == AA_TAA)
+        {
+            const Resource previousHistory = graph.import("taa history", history[1 - current].id(), historyFbo[1 - current], targetDesc(GL_RGBA16F, GL_LINEAR));
+            const Resource currentHistory = graph.import("taa history", history[current].id(), historyFbo[current], targetDesc(GL_RGBA16F, GL_LINEAR), true);
+            graph.addPass("taa resolve", [&](Builder& builder) {
+                builder.read(ldr);
+                builder.read(depth);
+                builder.read(previousHistory);
+                output = builder.write(currentHistory);
+            }, [&](Context&) {
+                glBindFramebuffer(GL_FRAMEBUFFER, historyFbo[current]);
+                taaShader.use();
+                taaShader.setInt("scene", 0);
+                taaShader.setInt("sceneDepth", 1);
+                taaShader.setInt("history", 2);
+                taaShader.setMat4("inverseViewProjection", inverseViewProjection);
+                taaShader.setMat4("previousViewProjection", previous);
+                taaShader.setVec3("cameraDelta", delta);
+                taaShader.setInt("historyValid", historyValid ? 1 : 0);
+                taaShader.setFloat("blend", 0.1f);
+                glState().activeTexture(GL_TEXTURE1);
+                glState().bindTexture(GL_TEXTURE_2D, sceneDepth.id());
+                glState().activeTexture(GL_TEXTURE2);
+                glState().bindTexture(GL_TEXTURE_2D, history[1 - current].id());
+                drawFullscreen(0, ldrColor.id());
+                historyValid = true;
+            });
+        }
+
+        graph.addPass("upscale", [&](Builder& builder) {
+            builder.read(output);
+            if (overdrawView) builder.read(depth);
+            builder.write(display);
+        }, [&](Context& context) {
+            presentedColor = context.texture(output);
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            glViewport(0, 0, displayWidth, displayHeight);
+            if (overdrawView)
+            {
+                // the depth texture sampled as its stencil for the one draw
+                glState().activeTexture(GL_TEXTURE0);
+                glState().bindTexture(GL_TEXTURE_2D, sceneDepth.id());
+                glTexParameteri(GL_TEXTURE_2D, GL_DEPTH_STENCIL_TEXTURE_MODE, GL_STENCIL_INDEX);
+                overdrawShader.use();
+                overdrawShader.setInt("counts", 0);
+                overdrawShader.setVec4("region", region);
+                overdrawShader.setFloat("scale", std::max(overdrawScale, 1.0f));
+                drawFullscreen(0, sceneDepth.id());
+                glTexParameteri(GL_TEXTURE_2D, GL_DEPTH_STENCIL_TEXTURE_MODE, GL_DEPTH_COMPONENT);
+                return;
+            }
+            upscaleShader.use();
+            upscaleShader.setInt("scene", 0);
+            upscaleShader.setVec4("region", region);
+            drawFullscreen(0, presentedColor);
+        });
+
+        graph.execute();
+        frameIndex++;
+        glState().bindVertexArray(0);
+        glState().depthFunc(GL_LESS);
+    }
+
+    void release()
+    {
+        unsigned int* framebuffers[] = { &sceneFbo, &msaaFbo, &ldrFbo, &historyFbo[0], &historyFbo[1] };
+        for (unsigned int* fbo : framebuffers)
+        {
+            if (*fbo != 0) glDeleteFramebuffers(1, fbo);
+            *fbo = 0;
+        }
+        if (colorSamples != 0) glDeleteRenderbuffers(1, &colorSamples);
+        if (depthSamples != 0) glDeleteRenderbuffers(1, &depthSamples);
+        colorSamples = depthSamples = 0;
+        sceneColor.release();
+        sceneDepth.release();
+        ldrColor.release();
+        history[0].release();
+        history[1].release();
+        samplesMemory.reset();
+        graph.release();
+        if (emptyVAO != 0) glState().deleteVertexArrays(1, &emptyVAO);
+        emptyVAO = 0;
+    }
+
+private:
+    Shader upscaleShader;
+    Shader overdrawShader;
+    Shader fxaaShader;
+    Shader smaaEdgesShader;
+    Shader smaaWeightsShader;
+    Shader smaaBlendShader;
+    Shader taaShader;
+    Shader toneMapShader;
+    unsigned int sceneFbo = 0;
+    unsigned int msaaFbo = 0;
+    unsigned int ldrFbo = 0;
+    unsigned int historyFbo[2] = { 0, 0 };
+    unsigned int colorSamples = 0;
+    unsigned int depthSamples = 0;
+    unsigned int emptyVAO = 0;
+    GlTexture sceneColor{GPU_MEMORY_RENDER_TARGETS};
+    GlTexture sceneDepth{GPU_MEMORY_RENDER_TARGETS};
+    GlTexture ldrColor{GPU_MEMORY_RENDER_TARGETS};
+    GlTexture history[2] = { GlTexture(GPU_MEMORY_RENDER_TARGETS), GlTexture(GPU_MEMORY_RENDER_TARGETS) };
+    GpuAllocation samplesMemory{GPU_MEMORY_RENDER_TARGETS};     // the renderbuffers
+    FrameGraph graph;
+    int targetWidth = 0;
+    int targetHeight = 0;
+    AntiAliasing mode = AA_NONE;
+    int sampleCount = 0;
+    unsigned long long frameIndex = 0;
+    bool historyValid = false;
+    bool toneMapped = false;
+    unsigned int presentedColor = 0;
+    glm::mat4 inverseViewProjection = glm::mat4(1.0f);
+    glm::mat4 previous = glm::mat4(1.0f);
+    glm::vec3 delta = glm::vec3(0.0f);
+
+    static float halton(unsigned int index, unsigned int base)
+    {
+        float result = 0.0f, fraction = 1.0f;
+        for (; index > 0; index /= base)
+        {
+            fraction /= static_cast<float>(base);
+            result += fraction * static_cast<float>(index % base);
+        }
+        return result;
+    }
+
+    FrameGraph::TextureDesc targetDesc(GLenum format, GLint filter) const
+    {
+        FrameGraph::TextureDesc desc;
+        desc.width = targetWidth;
+        desc.height = targetHeight;
+        desc.format = format;
+        desc.filter = filter;
+        return desc;
+    }
+
+    // a single-level texture of format, clamped and filtered, and a framebuffer around it, left bound
+    unsigned int colorTarget(GlTexture& texture, GLenum format, GLint filter, const char* textureLabel, const char* framebufferLabel)
+    {
+        texture.create(GL_TEXTURE_2D, textureLabel);
+        texture.storage2D(1, format, targetWidth, targetHeight);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glState().bindTexture(GL_TEXTURE_2D, 0);
+        unsigned int fbo = 0;
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        labelObject(GL_FRAMEBUFFER, fbo, framebufferLabel);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture.id(), 0);
+        checkComplete();
+        return fbo;
+    }
+
+    static void checkComplete()
+    {
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::SCENE_TARGET:: Framebuffer is not complete" << std::endl;
+    }
+
+    // a fullscreen triangle over the bound framebuffer with texture on unit
+    static void drawFullscreen(unsigned int unit, unsigned int texture)
+    {
+        glState().activeTexture(GL_TEXTURE0 + unit);
+        glState().bindTexture(GL_TEXTURE_2D, texture);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+};
+
+// Picks the scene target's scale from the measured GPU frame time. The cost of the scene is taken to go with its
+// pixels, the square of the scale, so one step moves the scale by sqrt(target / measured), limited to fall quickly
+// and rise slowly. The times arrive GpuTimers::LATENCY frames late, so after each change the controller waits for
+// frames drawn at the new scale before it measures again, and a band below the target keeps it from hunting.
+struct DynamicResolution
+{
+    bool enabled = true;
+    float targetMs = 15.0f;         // GPU time per frame to hold, under a 60 Hz frame with some room
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    float step = 1.0f / 32.0f;      // scales are multiples of this so the targets are not reallocated every frame
+    float scale = 1.0f;
+    unsigned int settle = 0;        // frames left before the measurements reflect the current scale
+    float smoothedMs = 0.0f;
+    unsigned int measuredFrames = 0;    // since the last change
+
+    // one frame's GPU time, true when the scale changed
+    bool update(float gpuMs, unsigned int latency)
+    {
+        // off, the scale stays wherever setScale put it
+        if (!enabled)
+        {
+            settle = 0;
+            smoothedMs = 0.0f;
+            measuredFrames = 0;
+            return false;
+        }
+        if (gpuMs <= 0.0f)
+            return false;
+        if (settle > 0)
+        {
+            settle--;
+            return false;
+        }
+        // the average of a few frames, one long frame alone does not drop the scale
+        smoothedMs = measuredFrames > 0 ? smoothedMs + 0.25f * (gpuMs - smoothedMs) : gpuMs;
+        if (++measuredFrames < 4)
+            return false;
+        const float measured = smoothedMs;
+        if (measured <= targetMs && measured >= 0.8f * targetMs)
+            return false;
+        if (measured < 0.8f * targetMs && scale >= maxScale)
+            return false;
+        // at least one step each way, so a small correction is not rounded away
+        const float ratio = std::max(0.8f, std::min(std::sqrt(targetMs / measured), 1.06f));
+        const float steps = scale * ratio / step;
+        if (!setScale((ratio > 1.0f ? std::ceil(steps) : std::floor(steps)) * step))
+            return false;
+        settle = latency + 1;
+        measuredFrames = 0;
+        return true;
+    }
+
+    bool setScale(float s)
+    {
+        s = std::max(minScale, std::min(s, maxScale));
+        s = std::max(minScale, std::floor(s / step + 0.5f) * step);
+        if (s == scale)
+            return false;
+        scale = s;
+        return true;
+    }
+
+    int scaled(int pixels) const { return std::max(1, static_cast<int>(std::lround(pixels * scale))); }
+};
+
+#endif
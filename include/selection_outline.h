@@ -0,0 +1,154 @@
+#ifndef SELECTION_OUTLINE_H
+#define SELECTION_OUTLINE_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <shader.h>
+#include <gpu_memory.h>
+
+#include <algorithm>
+#include <cmath>
+
+// Outlines around the selected objects as a post-process instead of a second, scaled draw of each one. The main
+// pass writes an object id per pixel to colour attachment ID_ATTACHMENT (0 where nothing selected is in front),
+// a jump flood in compute (shaders.2/selection.flood.cs) spreads the nearest selected pixel over a few pixels
+// around them, and a fullscreen pass (shaders.2/selection.outline.fs) blends the outline colour over the frame
+// wherever that pixel is within width. The cost goes with the screen, not with how many objects are selected or
+// how they were drawn, so instanced draws outline the same as single ones. Every draw of the main pass must write
+// the id output, 0 when it is not selected: what an attachment gets from a draw that does not is undefined.
+class SelectionOutline
+{
+public:
+    static const unsigned int ID_ATTACHMENT = 1;
+    static const unsigned int MAX_WIDTH = 32;
+
+    glm::vec4 color = glm::vec4(0.04f, 0.28f, 0.26f, 1.0f);
+    float width = 3.0f;     // in pixels, antialiased over the last one
+
+    SelectionOutline(const char* floodPath, const char* outlineVertexPath, const char* outlineFragmentPath)
+        : floodShader(floodPath), outlineShader(outlineVertexPath, outlineFragmentPath) {}
+
+    ~SelectionOutline()
+    {
+        release();
+    }
+
+    unsigned int ids() const { return idTexture.id(); }
+
+    // the id texture for a width x height framebuffer, attached to it next to its colour, both drawn into from
+    // now on; the ids are cleared for the frame
+    void begin(unsigned int framebuffer, int w, int h)
+    {
+        prepare(std::max(w, 1), std::max(h, 1));
+        glNamedFramebufferTexture(framebuffer, GL_COLOR_ATTACHMENT0 + ID_ATTACHMENT, idTexture.id(), 0);
+        const GLenum attachments[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT0 + ID_ATTACHMENT};
+        glNamedFramebufferDrawBuffers(framebuffer, 2, attachments);
+        const GLuint none = 0;
+        glClearTexImage(idTexture.id(), 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &none);
+    }
+
+    // the outlines over framebuffer's colour, which is left drawing into it alone
+    void apply(unsigned int framebuffer)
+    {
+        GL_DEBUG_GROUP("selection outline");
+        glNamedFramebufferDrawBuffer(framebuffer, GL_COLOR_ATTACHMENT0);
+        const float reach = std::clamp(width, 1.0f, static_cast<float>(MAX_WIDTH));
+
+        // seeds from the ids, then jumps halving down to one pixel, starting from the largest that matters
+        floodShader.use();
+        floodShader.setInt("source", 0);
+        glState().activeTexture(GL_TEXTURE0);
+        glState().bindTexture(GL_TEXTURE_2D, idTexture.id());
+        flood(0, 0);
+        unsigned int from = 0;
+        int jump = 1;
+        while (jump * 2 < static_cast<int>(std::ceil(reach)))
+            jump *= 2;
+        for (; jump >= 1; jump /= 2)
+        {
+            glState().bindTexture(GL_TEXTURE_2D, nearest[from].id());
+            flood(jump, 1 - from);
+            from = 1 - from;
+        }
+
+        if (emptyVAO == 0)
+            glGenVertexArrays(1, &emptyVAO);
+        outlineShader.use();
+        outlineShader.setInt("nearest", 0);
+        outlineShader.setInt("ids", 1);
+        outlineShader.setVec4("color", color);
+        outlineShader.setFloat("width", reach);
+        glState().bindTexture(GL_TEXTURE_2D, nearest[from].id());
+        glState().activeTexture(GL_TEXTURE1);
+        glState().bindTexture(GL_TEXTURE_2D, idTexture.id());
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glState().bindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glState().bindVertexArray(0);
+        glDisable(GL_BLEND);
+        glEnable(GL_DEPTH_TEST);
+        glState().bindTexture(GL_TEXTURE_2D, 0);
+        glState().activeTexture(GL_TEXTURE0);
+        glState().bindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    void release()
+    {
+        idTexture.release();
+        nearest[0].release();
+        nearest[1].release();
+        if (emptyVAO != 0) glState().deleteVertexArrays(1, &emptyVAO);
+        emptyVAO = 0;
+        targetWidth = targetHeight = 0;
+    }
+
+private:
+    Shader floodShader;
+    Shader outlineShader;
+    GlTexture idTexture{GPU_MEMORY_RENDER_TARGETS};
+    GlTexture nearest[2] = {GlTexture(GPU_MEMORY_RENDER_TARGETS), GlTexture(GPU_MEMORY_RENDER_TARGETS)};
+    unsigned int emptyVAO = 0;
+    int targetWidth = 0;
+    int targetHeight = 0;
+
+    // one pass from the bound source into nearest[destination], 0 jump for the seeds
+    void flood(int jump, unsigned int destination)
+    {
+        floodShader.setInt("jump", jump);
+        glBindImageTexture(0, nearest[destination].id(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG16UI);
+        glDispatchCompute((targetWidth + 7) / 8, (targetHeight + 7) / 8, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+
+    // (re)allocates the textures when the framebuffer changed size
+    void prepare(int w, int h)
+    {
+        if (idTexture.valid() && w == targetWidth && h == targetHeight)
+            return;
+        idTexture.create(GL_TEXTURE_2D, "selection ids");
+        idTexture.storage2D(1, GL_R32UI, w, h);
+        setNearestFilter();
+        for (unsigned int i = 0; i < 2; i++)
+        {
+            nearest[i].create(GL_TEXTURE_2D, "selection flood");
+            nearest[i].storage2D(1, GL_RG16UI, w, h);
+            setNearestFilter();
+        }
+        glState().bindTexture(GL_TEXTURE_2D, 0);
+        targetWidth = w;
+        targetHeight = h;
+    }
+
+    static void setNearestFilter()
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+};
+
+#endif
@@ -3,123 +3,453 @@
 
 #include <glad/glad.h>
 #include <glm.hpp>
+
+#include <program_cache.h>
+#include <parallel_shader_compile.h>
+#include <profiler.h>
+#include <gl_debug.h>
+#include <gl_state_cache.h>
+#include <asset_archive.h>
+
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+#include <utility>
+#include <memory>
+#include <cctype>
+
+// preprocessor symbols a program is compiled with, name and value ("" for a bare #define). Each set of them is a
+// permutation of the same source with its own program, cached on disk like any other (see program_cache.h).
+typedef std::vector<std::pair<std::string, std::string>> ShaderDefines;
 
 class Shader
 {
     public:
         unsigned int ID;
+        int samplerLayout = -1;     // the Mesh sampler layout the program's sampler uniforms were last set to
 
-        Shader(const char* vertexPath, const char* fragmentPath)
+        // the sources may #include "file" relative to themselves, defines are injected after their #version
+        Shader(const char* vertexPath, const char* fragmentPath, const ShaderDefines& defines = ShaderDefines())
         {
+            PROFILE_SCOPE_DETAIL("Shader", fragmentPath);
             std::string vertexCode;
             std::string fragmentCode;
-            std::ifstream vShaderFile;
-            std::ifstream fShaderFile;
+            if (!readFile(vertexPath, vertexCode))
+                std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << vertexPath << std::endl;
+            if (!readFile(fragmentPath, fragmentCode))
+                std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << fragmentPath << std::endl;
+            build({{GL_VERTEX_SHADER, preprocess(vertexCode, vertexPath, defines)},
+                   {GL_FRAGMENT_SHADER, preprocess(fragmentCode, fragmentPath, defines)}});
+            labelObject(GL_PROGRAM, ID, programLabel({vertexPath, fragmentPath}, defines));
+        }
 
-            vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-            fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-            try
+        // the same with a geometry stage between the two
+        Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath, const ShaderDefines& defines = ShaderDefines())
+        {
+            PROFILE_SCOPE_DETAIL("Shader", geometryPath);
+            const std::pair<GLenum, const char*> stages[3] = {{GL_VERTEX_SHADER, vertexPath}, {GL_GEOMETRY_SHADER, geometryPath}, {GL_FRAGMENT_SHADER, fragmentPath}};
+            program_cache::Sources sources;
+            for (const auto& stage : stages)
             {
-                vShaderFile.open(vertexPath);
-                fShaderFile.open(fragmentPath);
-                std::stringstream vShaderStream, fShaderStream;
-
-                vShaderStream << vShaderFile.rdbuf();
-                fShaderStream << fShaderFile.rdbuf();
-
-                vShaderFile.close();
-                fShaderFile.close();
-
-                vertexCode = vShaderStream.str();
-                fragmentCode = fShaderStream.str();
+                std::string code;
+                if (!readFile(stage.second, code))
+                    std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << stage.second << std::endl;
+                sources.emplace_back(stage.first, preprocess(code, stage.second, defines));
             }
-            catch(std::ifstream::failure& e)
+            build(sources);
+            labelObject(GL_PROGRAM, ID, programLabel({vertexPath, geometryPath, fragmentPath}, defines));
+        }
+
+        // any other set of stages, in pipeline order: the task, mesh and fragment stages of GL_NV_mesh_shader
+        // (meshlet_renderer.h), whose enums the bundled glad does not have
+        explicit Shader(const std::vector<std::pair<GLenum, const char*>>& stages, const ShaderDefines& defines = ShaderDefines())
+        {
+            PROFILE_SCOPE_DETAIL("Shader", stages.empty() ? "" : stages.back().second);
+            program_cache::Sources sources;
+            std::vector<const char*> paths;
+            for (const auto& stage : stages)
             {
-                std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
+                std::string code;
+                if (!readFile(stage.second, code))
+                    std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << stage.second << std::endl;
+                sources.emplace_back(stage.first, preprocess(code, stage.second, defines));
+                paths.push_back(stage.second);
             }
-            const char* vShaderCode = vertexCode.c_str();
-            const char* fShaderCode = fragmentCode.c_str();
+            build(sources);
+            labelObject(GL_PROGRAM, ID, programLabel(paths, defines));
+        }
 
-            unsigned int vertex, fragment;
-            vertex = glCreateShader(GL_VERTEX_SHADER);
-            glShaderSource(vertex, 1, &vShaderCode, NULL);
-            glCompileShader(vertex);
-            checkCompileErrors(vertex, "VERTEX");
+        // compute program from a single source file
+        explicit Shader(const char* computePath, const ShaderDefines& defines = ShaderDefines())
+        {
+            PROFILE_SCOPE_DETAIL("Shader", computePath);
+            std::string computeCode;
+            if (!readFile(computePath, computeCode))
+                std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << computePath << std::endl;
+            build({{GL_COMPUTE_SHADER, preprocess(computeCode, computePath, defines)}});
+            labelObject(GL_PROGRAM, ID, programLabel({computePath}, defines));
+        }
 
-            fragment = glCreateShader(GL_FRAGMENT_SHADER);
-            glShaderSource(fragment, 1, &fShaderCode, NULL);
-            glCompileShader(fragment);
-            checkCompileErrors(fragment, "FRAGMENT");
+        // Programs built while this is on are only submitted to the driver, each is resolved (its status checked,
+        // its uniforms reflected) on first use. Submitting every program before using any lets a driver with
+        // ParallelShaderCompile work on all of them at once.
+        static void setDeferredCompile(bool deferred) { deferredCompile() = deferred; }
 
-            ID = glCreateProgram();
-            glAttachShader(ID, vertex);
-            glAttachShader(ID, fragment);
-            glLinkProgram(ID);
-            checkCompileErrors(ID, "PROGRAM");
+        // symbols every program is compiled with ahead of its own, set before the first one is built (the depth
+        // convention's REVERSE_Z, depth_convention.h)
+        static ShaderDefines& sharedDefines()
+        {
+            static ShaderDefines defines;
+            return defines;
+        }
 
-            glDeleteShader(vertex);
-            glDeleteShader(fragment);
+        // What the sources are rewritten for when the context is not the desktop GL they are written against
+        // (render_profile.h): each file's #version line replaced, a preamble after it, and built-ins the target
+        // lacks renamed to uniforms, declared ahead of a stage that reads them. Set before the first program is built.
+        struct SourceProfile
+        {
+            std::string version;        // "" keeps each file's own
+            std::string preamble;
+            std::vector<std::pair<std::string, std::string>> renames;   // built-in, the int uniform read instead
+        };
+
+        static SourceProfile& sourceProfile()
+        {
+            static SourceProfile profile;
+            return profile;
+        }
+
+        // false while a deferred program is still being compiled or linked, using it then waits for it
+        bool ready() const
+        {
+            return !pending || ParallelShaderCompile::programDone(ID);
         }
 
         void use()
         {
-            glUseProgram(ID);
+            resolve();
+            glState().useProgram(ID);
         }
+        // the location of a uniform, from the table reflected after linking. Names the reflection does not list
+        // (elements of a plain array past the first) are asked of the driver once and remembered, -1 when unused.
+        int location(const std::string &name) const
+        {
+            resolve();
+            auto found = locations.find(name);
+            if (found != locations.end())
+                return found->second;
+            int loc = glGetUniformLocation(ID, name.c_str());
+            locations.emplace(name, loc);
+            return loc;
+        }
+
+        // a location resolved once, for uniforms set every frame or every object
+        template <typename T>
+        struct Uniform
+        {
+            int location = -1;
+        };
+
+        template <typename T>
+        Uniform<T> uniform(const std::string &name) const
+        {
+            return Uniform<T>{location(name)};
+        }
+
+        // the program must be in use, as with the named setters. The value converts to T, set(floatHandle, 1) works
+        template <typename T>
+        void set(Uniform<T> handle, const std::common_type_t<T> &value) const
+        {
+            upload(handle.location, value);
+        }
+
         void setBool(const std::string &name, bool value) const
         {
-            glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+            upload(location(name), value);
         }
         void setInt(const std::string &name, int value) const
         {
-            glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+            upload(location(name), value);
+        }
+        void setUInt(const std::string &name, unsigned int value) const
+        {
+            upload(location(name), value);
         }
         void setFloat(const std::string &name, float value) const
         {
-            glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+            upload(location(name), value);
         }
         void setVec2(const std::string &name, const glm::vec2 &value) const
         {
-            glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+            upload(location(name), value);
         }
         void setVec2(const std::string &name, float x, float y) const
         {
-            glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+            glUniform2f(location(name), x, y);
         }
         void setVec3(const std::string &name, const glm::vec3 &value) const
         { 
-            glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+            upload(location(name), value);
         }
         void setVec3(const std::string &name, float x, float y, float z) const
         { 
-            glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+            glUniform3f(location(name), x, y, z); 
         }
         void setVec4(const std::string &name, const glm::vec4 &value) const
         { 
-            glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+            upload(location(name), value);
         }
         void setVec4(const std::string &name, float x, float y, float z, float w) const
         { 
-            glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+            glUniform4f(location(name), x, y, z, w); 
         }
         void setMat2(const std::string &name, const glm::mat2 &mat) const
         {
-            glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+            upload(location(name), mat);
         }
         void setMat3(const std::string &name, const glm::mat3 &mat) const
         {
-            glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+            upload(location(name), mat);
         }
         void setMat4(const std::string &name, const glm::mat4 &mat) const
         {
-            glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+            upload(location(name), mat);
         }
 
     private:
-        void checkCompileErrors(unsigned int shader, std::string type)
+        // what build() submitted and resolve() has not looked at yet
+        struct Pending
+        {
+            std::vector<std::pair<GLenum, unsigned int>> shaders;
+            uint64_t key = 0;
+            bool cacheable = false;
+            bool resolved = false;
+        };
+
+        mutable std::unordered_map<std::string, int> locations;
+        mutable std::shared_ptr<Pending> pending;
+
+        static bool& deferredCompile()
+        {
+            static bool deferred = false;
+            return deferred;
+        }
+
+        static void upload(int loc, bool value) { glUniform1i(loc, (int)value); }
+        static void upload(int loc, int value) { glUniform1i(loc, value); }
+        static void upload(int loc, unsigned int value) { glUniform1ui(loc, value); }
+        static void upload(int loc, float value) { glUniform1f(loc, value); }
+        static void upload(int loc, const glm::vec2 &value) { glUniform2fv(loc, 1, &value[0]); }
+        static void upload(int loc, const glm::vec3 &value) { glUniform3fv(loc, 1, &value[0]); }
+        static void upload(int loc, const glm::vec4 &value) { glUniform4fv(loc, 1, &value[0]); }
+        static void upload(int loc, const glm::mat2 &mat) { glUniformMatrix2fv(loc, 1, GL_FALSE, &mat[0][0]); }
+        static void upload(int loc, const glm::mat3 &mat) { glUniformMatrix3fv(loc, 1, GL_FALSE, &mat[0][0]); }
+        static void upload(int loc, const glm::mat4 &mat) { glUniformMatrix4fv(loc, 1, GL_FALSE, &mat[0][0]); }
+
+        // the source with its #include "file" lines replaced by the files, found next to the including one, and the
+        // defines after the #version line, rewritten for the source profile. #line directives keep the compiler's line
+        // numbers those of each file.
+        static std::string preprocess(const std::string& code, const std::string& path, const ShaderDefines& defines, int depth = 0)
+        {
+            const std::string directory = path.find_last_of('/') == std::string::npos ? std::string() : path.substr(0, path.find_last_of('/') + 1);
+            std::string out;
+            std::istringstream lines(code);
+            std::string line;
+            int number = 0;
+            size_t preambleAt = 0;
+            while (std::getline(lines, line))
+            {
+                number++;
+                const size_t start = line.find_first_not_of(" \t");
+                if (start != std::string::npos && line.compare(start, 8, "#include") == 0)
+                {
+                    const size_t open = line.find('"', start + 8), close = open == std::string::npos ? open : line.find('"', open + 1);
+                    const std::string includePath = close == std::string::npos ? std::string() : directory + line.substr(open + 1, close - open - 1);
+                    std::string included;
+                    // the depth stops a file that includes itself
+                    if (includePath.empty() || depth >= 16 || !readFile(includePath, included))
+                    {
+                        std::cout << "ERROR::SHADER::INCLUDE_NOT_RESOLVED: " << line << " in " << path << std::endl;
+                        out += "\n";
+                        continue;
+                    }
+                    out += "#line 1\n" + preprocess(included, includePath, ShaderDefines(), depth + 1);
+                    out += "#line " + std::to_string(number + 1) + "\n";
+                    continue;
+                }
+                const SourceProfile& profile = sourceProfile();
+                const bool version = depth == 0 && start != std::string::npos && line.compare(start, 8, "#version") == 0;
+                out += (version && !profile.version.empty() ? profile.version : line) + "\n";
+                if (version && !profile.preamble.empty())
+                    out += profile.preamble;
+                if (version)
+                    preambleAt = out.size();
+                if (version && (!defines.empty() || !sharedDefines().empty() || !profile.preamble.empty()))
+                {
+                    for (const auto& define : sharedDefines())
+                        out += "#define " + define.first + " " + define.second + "\n";
+                    for (const auto& define : defines)
+                        out += "#define " + define.first + " " + define.second + "\n";
+                    out += "#line " + std::to_string(number + 1) + "\n";
+                }
+            }
+            if (depth == 0)
+                renameBuiltIns(out, preambleAt);
+            return out;
+        }
+
+        // the profile's renames over the whole stage, includes and all, and a declaration for each that was used
+        static void renameBuiltIns(std::string& code, size_t declareAt)
+        {
+            std::string declarations;
+            for (const auto& rename : sourceProfile().renames)
+            {
+                bool used = false;
+                for (size_t at = code.find(rename.first); at != std::string::npos; at = code.find(rename.first, at))
+                {
+                    const size_t end = at + rename.first.size();
+                    const char next = end < code.size() ? code[end] : ' ';
+                    if (std::isalnum(static_cast<unsigned char>(next)) || next == '_')
+                    {
+                        at = end;
+                        continue;
+                    }
+                    code.replace(at, rename.first.size(), rename.second);
+                    at += rename.second.size();
+                    used = true;
+                }
+                if (used)
+                    declarations += "uniform int " + rename.second + ";\n";
+            }
+            if (!declarations.empty())
+                code.insert(std::min(declareAt, code.size()), declarations);
+        }
+
+        // the program's file names and defines, for frame captures
+        static std::string programLabel(const std::vector<const char*>& paths, const ShaderDefines& defines)
+        {
+            std::string label;
+            for (const char* path : paths)
+                label += (label.empty() ? "" : " + ") + labelOf(path);
+            for (const auto& define : defines)
+                label += " " + define.first;
+            return label;
+        }
+
+        // through the asset archive when it has the file (asset_archive.h)
+        static bool readFile(const std::string& path, std::string& text)
+        {
+            return readAssetFile(path, text);
+        }
+
+        // compiles and links the stages into ID, or links it from the program cache when it has them
+        void build(const program_cache::Sources& sources)
+        {
+            PROFILE_SCOPE("Shader::build");
+            const bool cacheable = program_cache::supported();
+            const uint64_t key = cacheable ? program_cache::keyOf(sources) : 0;
+            ID = glCreateProgram();
+            if (cacheable)
+            {
+                if (program_cache::load(ID, key))
+                {
+                    reflectUniforms();
+                    return;
+                }
+                // a missing or refused binary can leave the program failed, start over with a fresh one
+                glState().deleteProgram(ID);
+                ID = glCreateProgram();
+            }
+
+            // the shaders go at once, flagged for deletion they live on as long as the program has them attached
+            std::shared_ptr<Pending> submitted = std::make_shared<Pending>();
+            submitted->key = key;
+            submitted->cacheable = cacheable;
+            for (const auto& stage : sources)
+            {
+                const char* code = stage.second.c_str();
+                unsigned int shader = glCreateShader(stage.first);
+                glShaderSource(shader, 1, &code, NULL);
+                glCompileShader(shader);
+                glAttachShader(ID, shader);
+                glDeleteShader(shader);
+                submitted->shaders.emplace_back(stage.first, shader);
+            }
+            if (cacheable)
+                glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+            glLinkProgram(ID);
+            pending = submitted;
+            if (!deferredCompile())
+                resolve();
+        }
+
+        // Waits for the compile and link submitted by build(): logs their errors, reflects the uniforms and caches
+        // the binary. The logging and caching happen once for copies of the Shader, which share the program.
+        void resolve() const
+        {
+            if (!pending)
+                return;
+            PROFILE_SCOPE("Shader::resolve");
+            std::shared_ptr<Pending> submitted = std::move(pending);
+            pending.reset();
+            if (!submitted->resolved)
+            {
+                submitted->resolved = true;
+                for (const auto& stage : submitted->shaders)
+                    checkCompileErrors(stage.second, stageName(stage.first));
+                checkCompileErrors(ID, "PROGRAM");
+                int linked = 0;
+                glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+                if (submitted->cacheable && linked)
+                    program_cache::store(ID, submitted->key);
+            }
+            reflectUniforms();
+        }
+
+        static const char* stageName(GLenum stage)
+        {
+            switch (stage)
+            {
+            case GL_VERTEX_SHADER: return "VERTEX";
+            case GL_GEOMETRY_SHADER: return "GEOMETRY";
+            case GL_FRAGMENT_SHADER: return "FRAGMENT";
+            case GL_COMPUTE_SHADER: return "COMPUTE";
+            case 0x955A: return "TASK";     // GL_TASK_SHADER_NV
+            case 0x9559: return "MESH";     // GL_MESH_SHADER_NV
+            default: return "SHADER";
+            }
+        }
+
+        // every active uniform's location, arrays also under their bare name. Block members have no location.
+        void reflectUniforms() const
+        {
+            locations.clear();
+            int count = 0, longest = 0;
+            glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+            glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &longest);
+            std::string name(static_cast<size_t>(std::max(longest, 1)), '\0');
+            for (int u = 0; u < count; u++)
+            {
+                GLsizei length = 0;
+                GLint size = 0;
+                GLenum type = 0;
+                glGetActiveUniform(ID, static_cast<GLuint>(u), static_cast<GLsizei>(name.size()), &length, &size, &type, &name[0]);
+                std::string uniformName(name.data(), static_cast<size_t>(length));
+                int loc = glGetUniformLocation(ID, uniformName.c_str());
+                if (loc < 0)
+                    continue;
+                locations[uniformName] = loc;
+                if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0)
+                    locations[uniformName.substr(0, uniformName.size() - 3)] = loc;
+            }
+        }
+
+        static void checkCompileErrors(unsigned int shader, std::string type)
         {
             int success;
             char infoLog[1024];
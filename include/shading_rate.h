@@ -0,0 +1,216 @@
+#ifndef SHADING_RATE_H
+#define SHADING_RATE_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <shader.h>
+#include <gpu_memory.h>
+#include <gl_state_cache.h>
+#include <gl_debug.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+// GL_NV_shading_rate_image, loaded by hand like meshlet_renderer.h's MeshShaders: the bundled glad is core 4.6
+// without extensions.
+class VariableRateShading
+{
+public:
+    static const GLenum SHADING_RATE_IMAGE = 0x9563;            // GL_SHADING_RATE_IMAGE_NV
+    static const GLenum RATE_1X1 = 0x9565;                      // GL_SHADING_RATE_1_INVOCATION_PER_PIXEL_NV
+    static const GLenum RATE_2X2 = 0x9568;                      // GL_SHADING_RATE_1_INVOCATION_PER_2X2_PIXELS_NV
+    static const GLenum RATE_4X4 = 0x956B;                      // GL_SHADING_RATE_1_INVOCATION_PER_4X4_PIXELS_NV
+    static const GLenum TEXEL_WIDTH = 0x955C;                   // GL_SHADING_RATE_IMAGE_TEXEL_WIDTH_NV
+    static const GLenum TEXEL_HEIGHT = 0x955D;                  // GL_SHADING_RATE_IMAGE_TEXEL_HEIGHT_NV
+    static const GLenum PALETTE_SIZE = 0x955E;                  // GL_SHADING_RATE_IMAGE_PALETTE_SIZE_NV
+
+    // looks for the extension and its entry points, call once after gladLoadGLLoader with the same loader
+    static bool load(GLADloadproc loader)
+    {
+        State& s = state();
+        s.available = false;
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        bool listed = false;
+        for (GLint e = 0; e < count && !listed; e++)
+        {
+            const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(e)));
+            listed = name && std::strcmp(name, "GL_NV_shading_rate_image") == 0;
+        }
+        if (!listed)
+            return false;
+        s.bindImage = reinterpret_cast<BindImage>(loader("glBindShadingRateImageNV"));
+        s.palette = reinterpret_cast<Palette>(loader("glShadingRateImagePaletteNV"));
+        GLint paletteSize = 0;
+        glGetIntegerv(PALETTE_SIZE, &paletteSize);
+        // the image's three levels each need an entry
+        s.available = s.bindImage && s.palette && paletteSize >= 3;
+        return s.available;
+    }
+
+    static bool available() { return state().available; }
+
+    static void bindImage(GLuint texture)
+    {
+        if (state().available)
+            state().bindImage(texture);
+    }
+
+    static void palette(GLuint viewport, GLuint first, GLsizei count, const GLenum* rates)
+    {
+        if (state().available)
+            state().palette(viewport, first, count, rates);
+    }
+
+private:
+    typedef void (APIENTRYP BindImage)(GLuint texture);
+    typedef void (APIENTRYP Palette)(GLuint viewport, GLuint first, GLsizei count, const GLenum* rates);
+
+    struct State
+    {
+        bool available = false;
+        BindImage bindImage = nullptr;
+        Palette palette = nullptr;
+    };
+
+    static State& state()
+    {
+        static State s;
+        return s;
+    }
+};
+
+// A shading rate image for the scene target, from the frame before: every texel covers a tile of the hardware's
+// rate texel size and holds 0 (one invocation per pixel), 1 (per 2x2) or 2 (per 4x4).
+// shaders.2/shading.rate.classify.cs sizes up the tile in last frame's tone-mapped colour, its brightest pixel and the largest step in luminance
+// between neighbours:
+//   a step of edgeContrast or more      full rate, an outline, a star or a small rock
+//   brighter than darkLuminance         full rate, lit surface
+//   darker                              4x4, the black of space
+// and outside the fovea, foveaRadius about foveaCentre in the frame's half-diagonals, the first two shade at 2x2.
+// shaders.2/shading.rate.dilate.cs then takes each tile's finest rate of its 3x3 neighbourhood, so something that
+// moved a tile since the frame the image was taken from is still shaded at full rate. Only the scene's own passes
+// shade at the image's rates, begin() to end(); the shadow map and probe faces have framebuffers of other sizes.
+class ShadingRateImage
+{
+public:
+    float darkLuminance = 0.08f;        // display luminance, after the tone mapping and the sRGB encoding
+    float edgeContrast = 0.08f;
+    float foveaRadius = 0.6f;           // 0 or less, no fovea: the whole frame shades as the inside
+    glm::vec2 foveaCentre{0.5f};        // of the frame, 0 to 1
+
+    // shaderDirectory holds shading.rate.classify.cs and shading.rate.dilate.cs
+    explicit ShadingRateImage(const std::string& shaderDirectory)
+        : classifyShader((shaderDirectory + "shading.rate.classify.cs").c_str()),
+          dilateShader((shaderDirectory + "shading.rate.dilate.cs").c_str()) {}
+
+    ~ShadingRateImage()
+    {
+        release();
+    }
+
+    bool valid() const { return built; }
+    glm::ivec2 tileSize() const { return glm::ivec2(tileWidth, tileHeight); }
+    glm::ivec2 size() const { return glm::ivec2(imageWidth, imageHeight); }
+
+    // the rates for a frame of width x height from source, last frame's tone-mapped colour at whatever size it had;
+    // none with source 0, so the frame shades at full rate
+    void build(unsigned int source, int width, int height)
+    {
+        built = false;
+        if (source == 0 || !VariableRateShading::available())
+            return;
+        GL_DEBUG_GROUP("shading rate image");
+        prepare(std::max(width, 1), std::max(height, 1));
+
+        classifyShader.use();
+        classifyShader.setInt("source", 0);
+        classifyShader.setVec2("frameSize", glm::vec2(width, height));
+        classifyShader.setInt("tileWidth", tileWidth);
+        classifyShader.setInt("tileHeight", tileHeight);
+        classifyShader.setFloat("darkLuminance", darkLuminance);
+        classifyShader.setFloat("edgeContrast", edgeContrast);
+        classifyShader.setFloat("foveaRadius", foveaRadius);
+        classifyShader.setVec2("foveaCentre", foveaCentre);
+        glState().activeTexture(GL_TEXTURE0);
+        glState().bindTexture(GL_TEXTURE_2D, source);
+        glBindImageTexture(0, classified.id(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R8UI);
+        glDispatchCompute(imageWidth, imageHeight, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+        dilateShader.use();
+        glBindImageTexture(0, classified.id(), 0, GL_FALSE, 0, GL_READ_ONLY, GL_R8UI);
+        glBindImageTexture(1, rates.id(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R8UI);
+        glDispatchCompute((imageWidth + 7) / 8, (imageHeight + 7) / 8, 1);
+        // the extension names no barrier bit of its own for the rasterizer's reads of the image
+        glMemoryBarrier(GL_ALL_BARRIER_BITS);
+        glState().bindTexture(GL_TEXTURE_2D, 0);
+        built = true;
+    }
+
+    // the draws until end() shade at the built image's rates; nothing changes without one
+    void begin() const
+    {
+        if (!built)
+            return;
+        const GLenum palette[3] = { VariableRateShading::RATE_1X1, VariableRateShading::RATE_2X2, VariableRateShading::RATE_4X4 };
+        VariableRateShading::bindImage(rates.id());
+        VariableRateShading::palette(0, 0, 3, palette);
+        glEnable(VariableRateShading::SHADING_RATE_IMAGE);
+    }
+
+    void end() const
+    {
+        if (!built)
+            return;
+        glDisable(VariableRateShading::SHADING_RATE_IMAGE);
+        VariableRateShading::bindImage(0);
+    }
+
+    void release()
+    {
+        classified.release();
+        rates.release();
+        imageWidth = imageHeight = 0;
+        built = false;
+    }
+
+private:
+    Shader classifyShader;
+    Shader dilateShader;
+    GlTexture classified{GPU_MEMORY_RENDER_TARGETS};    // before the dilation
+    GlTexture rates{GPU_MEMORY_RENDER_TARGETS};
+    int tileWidth = 16;
+    int tileHeight = 16;
+    int imageWidth = 0;
+    int imageHeight = 0;
+    bool built = false;
+
+    // (re)allocates the images when the frame changed size, a texel per tile
+    void prepare(int width, int height)
+    {
+        GLint texelWidth = 0, texelHeight = 0;
+        glGetIntegerv(VariableRateShading::TEXEL_WIDTH, &texelWidth);
+        glGetIntegerv(VariableRateShading::TEXEL_HEIGHT, &texelHeight);
+        tileWidth = std::max(texelWidth, 1);
+        tileHeight = std::max(texelHeight, 1);
+        const int w = (width + tileWidth - 1) / tileWidth;
+        const int h = (height + tileHeight - 1) / tileHeight;
+        if (w == imageWidth && h == imageHeight && rates.valid())
+            return;
+        imageWidth = w;
+        imageHeight = h;
+        for (GlTexture* texture : { &classified, &rates })
+        {
+            texture->create(GL_TEXTURE_2D, texture == &rates ? "shading rate image" : "shading rate tiles");
+            texture->storage2D(1, GL_R8UI, imageWidth, imageHeight);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        }
+        glState().bindTexture(GL_TEXTURE_2D, 0);
+    }
+};
+
+#endif
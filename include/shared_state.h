@@ -0,0 +1,371 @@
+#ifndef SHARED_STATE_H
+#define SHARED_STATE_H
+
+#include <body_store.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Live body state in a POSIX shared-memory object (shm_open), for analysis tools on the same machine to map and
+// read in place while the simulation runs. The object is a SharedStateHeader in its first page and two buffers
+// after it, each a SharedFrameHeader and the store's arrays as they are in memory: position and velocity as three
+// doubles a body, mass as a float, the stable id as a uint32 and the flags as a byte, every array 64-byte aligned
+// at arrayOffset[] from its buffer's start. A publish copies the arrays into the buffer readers are not pointed
+// at and then points them at it, so the producer's cost is the copies and a handful of stores.
+//
+// Each buffer carries a seqlock: its sequence is odd while it is written and even in between. A reader takes
+// latest, notes the sequence, reads whatever it wants straight from the mapping and accepts what it read if the
+// sequence is still the same, which it is unless the producer published twice meanwhile; SharedStateReader does
+// this and retries. When the bodies outgrow the buffers the object grows to twice the capacity and layout goes
+// up, which tells readers to map it again.
+static const uint32_t SHARED_STATE_MAGIC = 0x4d53424e;     // "NBSM"
+static const uint16_t SHARED_STATE_VERSION = 1;
+static const size_t SHARED_STATE_HEADER_BYTES = 4096;
+
+enum SharedStateArray {
+    SHARED_POSITION = 0,        // double[3] a body
+    SHARED_VELOCITY,            // double[3]
+    SHARED_MASS,                // float
+    SHARED_ID,                  // uint32
+    SHARED_FLAGS,               // uint8, BodyFlags
+    SHARED_ARRAYS
+};
+
+struct SharedStateHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t bufferCount;               // 2
+    std::atomic<uint32_t> layout;       // goes up when the object is resized, the fields below with it
+    uint32_t capacity;                  // bodies a buffer holds
+    uint64_t objectBytes;
+    uint64_t bufferOffset[2];           // from the object's start
+    uint64_t arrayOffset[SHARED_ARRAYS];    // from a buffer's start
+    std::atomic<uint32_t> latest;       // the buffer of the newest complete frame
+    uint32_t producerPid;
+    std::atomic<uint64_t> publishes;
+};
+
+struct SharedFrameHeader
+{
+    std::atomic<uint64_t> sequence;     // odd while the buffer is written
+    uint64_t frame;                     // the publish it holds, from 1
+    uint64_t step;
+    double simTime;
+    uint32_t count;                     // bodies
+    uint32_t layout;                    // of the object it was written for
+    uint32_t typeStart[BODY_TYPE_COUNT + 1];    // the sun, the planets and the asteroids are these index ranges
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+              "the shared counters must be address-free, that is lock-free");
+static_assert(sizeof(SharedStateHeader) <= SHARED_STATE_HEADER_BYTES, "the header fits its page");
+
+// the array offsets and buffer size for a capacity, the same on both sides
+inline uint64_t sharedStateLayout(uint32_t capacity, uint64_t (&arrayOffset)[SHARED_ARRAYS])
+{
+    static const size_t elementBytes[SHARED_ARRAYS] = {sizeof(glm::dvec3), sizeof(glm::dvec3), sizeof(float), sizeof(uint32_t),
+                                                       sizeof(uint8_t)};
+    uint64_t offset = (sizeof(SharedFrameHeader) + 63) & ~uint64_t(63);
+    for (unsigned int a = 0; a < SHARED_ARRAYS; a++)
+    {
+        arrayOffset[a] = offset;
+        offset = (offset + elementBytes[a] * capacity + 63) & ~uint64_t(63);
+    }
+    return offset;
+}
+
+// The producer's side, on the thread that steps the bodies.
+class SharedStateExport
+{
+public:
+    SharedStateExport() = default;
+    SharedStateExport(const SharedStateExport&) = delete;
+    SharedStateExport& operator=(const SharedStateExport&) = delete;
+
+    ~SharedStateExport()
+    {
+        stop();
+    }
+
+    // creates the object name ("/nbody_state"), replacing one left by an earlier run, with room for capacity bodies
+    bool start(const std::string& name, size_t capacity)
+    {
+        stop();
+        shm_unlink(name.c_str());
+        fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd < 0)
+        {
+            lastError = "cannot create shared memory " + name;
+            return false;
+        }
+        objectName = name;
+        if (!resize(static_cast<uint32_t>(std::max<size_t>(capacity, 1024))))
+        {
+            stop();
+            return false;
+        }
+        return true;
+    }
+
+    // copies the bodies into the buffer the readers are not on and points them at it
+    void publish(const BodyStore& bodies, double simTime, uint64_t step)
+    {
+        if (!base)
+            return;
+        const size_t count = bodies.size();
+        if (count > header()->capacity && !resize(static_cast<uint32_t>(std::max<size_t>(count, 2 * static_cast<size_t>(header()->capacity)))))
+            return;
+        SharedStateHeader* h = header();
+        const uint32_t target = h->latest.load(std::memory_order_relaxed) ^ 1u;
+        unsigned char* buffer = base + h->bufferOffset[target];
+        SharedFrameHeader* frame = reinterpret_cast<SharedFrameHeader*>(buffer);
+        const uint64_t sequence = frame->sequence.load(std::memory_order_relaxed);
+        frame->sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        frame->frame = ++published;
+        frame->step = step;
+        frame->simTime = simTime;
+        frame->count = static_cast<uint32_t>(count);
+        frame->layout = h->layout.load(std::memory_order_relaxed);
+        for (unsigned int t = 0; t <= BODY_TYPE_COUNT; t++)
+            frame->typeStart[t] = static_cast<uint32_t>(t < BODY_TYPE_COUNT ? bodies.range(static_cast<BodyType>(t)).begin : count);
+        std::memcpy(buffer + h->arrayOffset[SHARED_POSITION], bodies.position.data(), count * sizeof(glm::dvec3));
+        std::memcpy(buffer + h->arrayOffset[SHARED_VELOCITY], bodies.velocity.data(), count * sizeof(glm::dvec3));
+        std::memcpy(buffer + h->arrayOffset[SHARED_MASS], bodies.mass.data(), count * sizeof(float));
+        std::memcpy(buffer + h->arrayOffset[SHARED_ID], bodies.id.data(), count * sizeof(uint32_t));
+        std::memcpy(buffer + h->arrayOffset[SHARED_FLAGS], bodies.flags.data(), count * sizeof(uint8_t));
+
+        frame->sequence.store(sequence + 2, std::memory_order_release);
+        h->latest.store(target, std::memory_order_release);
+        h->publishes.store(published, std::memory_order_relaxed);
+    }
+
+    // unmaps and removes the object, readers keep what they mapped until they let go
+    void stop()
+    {
+        if (base)
+            munmap(base, bytes);
+        base = nullptr;
+        bytes = 0;
+        if (fd >= 0)
+        {
+            ::close(fd);
+            shm_unlink(objectName.c_str());
+        }
+        fd = -1;
+        objectName.clear();
+    }
+
+    bool running() const { return base != nullptr; }
+    const std::string& name() const { return objectName; }
+    uint64_t framesPublished() const { return published; }
+    size_t objectBytes() const { return bytes; }
+    const std::string& error() const { return lastError; }
+
+private:
+    int fd = -1;
+    std::string objectName;
+    unsigned char* base = nullptr;
+    size_t bytes = 0;
+    uint64_t published = 0;
+    std::string lastError;
+
+    SharedStateHeader* header() const { return reinterpret_cast<SharedStateHeader*>(base); }
+
+    // grows the object to two buffers of capacity bodies and lays it out again; readers see layout go up
+    bool resize(uint32_t capacity)
+    {
+        uint64_t offsets[SHARED_ARRAYS];
+        const uint64_t bufferBytes = sharedStateLayout(capacity, offsets);
+        const size_t total = SHARED_STATE_HEADER_BYTES + 2 * bufferBytes;
+        uint32_t layout = 0;
+        if (base)
+        {
+            layout = header()->layout.load(std::memory_order_relaxed);
+            munmap(base, bytes);
+            base = nullptr;
+        }
+        if (ftruncate(fd, static_cast<off_t>(total)) != 0)
+        {
+            lastError = "cannot size shared memory " + objectName + " to " + std::to_string(total) + " bytes";
+            return false;
+        }
+        void* mapped = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED)
+        {
+            lastError = "cannot map shared memory " + objectName;
+            return false;
+        }
+        base = static_cast<unsigned char*>(mapped);
+        bytes = total;
+        // the frames start over empty; publish() only fills the buffer readers are not on
+        SharedStateHeader* h = header();
+        h->magic = SHARED_STATE_MAGIC;
+        h->version = SHARED_STATE_VERSION;
+        h->bufferCount = 2;
+        h->capacity = capacity;
+        h->objectBytes = total;
+        h->bufferOffset[0] = SHARED_STATE_HEADER_BYTES;
+        h->bufferOffset[1] = SHARED_STATE_HEADER_BYTES + bufferBytes;
+        for (unsigned int a = 0; a < SHARED_ARRAYS; a++)
+            h->arrayOffset[a] = offsets[a];
+        h->producerPid = static_cast<uint32_t>(getpid());
+        for (unsigned int b = 0; b < 2; b++)
+        {
+            SharedFrameHeader* frame = reinterpret_cast<SharedFrameHeader*>(base + h->bufferOffset[b]);
+            frame->count = 0;
+            frame->frame = 0;
+            frame->layout = layout + 1;
+        }
+        h->layout.store(layout + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+// A reader's side, for tools in other processes:
+//     SharedStateReader reader;
+//     reader.open("/nbody_state");
+//     reader.read([](const SharedStateReader::Frame& f) { ... f.position[i] ... });
+// read() hands its function the latest frame in the mapping itself, nothing copied, and returns true only if the
+// producer did not overwrite it while the function ran; copy out what must outlive the call.
+class SharedStateReader
+{
+public:
+    struct Frame
+    {
+        uint64_t frame;
+        uint64_t step;
+        double simTime;
+        uint32_t count;
+        const uint32_t* typeStart;          // BODY_TYPE_COUNT + 1 entries
+        const glm::dvec3* position;
+        const glm::dvec3* velocity;
+        const float* mass;
+        const uint32_t* id;
+        const uint8_t* flags;
+    };
+
+    SharedStateReader() = default;
+    SharedStateReader(const SharedStateReader&) = delete;
+    SharedStateReader& operator=(const SharedStateReader&) = delete;
+
+    ~SharedStateReader()
+    {
+        close();
+    }
+
+    bool open(const std::string& name)
+    {
+        close();
+        fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0)
+            return false;
+        if (!map())
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+        if (base)
+            munmap(const_cast<unsigned char*>(base), bytes);
+        base = nullptr;
+        bytes = 0;
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+    }
+
+    bool isOpen() const { return base != nullptr; }
+
+    // the newest frame's number, 0 before the first, without reading it
+    uint64_t latestFrame() const { return base ? header()->publishes.load(std::memory_order_acquire) : 0; }
+
+    // fn(const Frame&) on the latest frame, retried up to attempts times while the producer overwrites it under
+    // the reader; false when there is no frame yet or every attempt was torn
+    template <typename Fn>
+    bool read(Fn&& fn, unsigned int attempts = 8)
+    {
+        for (unsigned int a = 0; base && a < attempts; a++)
+        {
+            const SharedStateHeader* h = header();
+            if (h->layout.load(std::memory_order_acquire) != mappedLayout && !map())
+                return false;
+            h = header();
+            const uint32_t latest = h->latest.load(std::memory_order_acquire) & 1u;
+            const unsigned char* buffer = base + h->bufferOffset[latest];
+            const SharedFrameHeader* frame = reinterpret_cast<const SharedFrameHeader*>(buffer);
+            const uint64_t sequence = frame->sequence.load(std::memory_order_acquire);
+            if ((sequence & 1u) != 0 || frame->layout != mappedLayout)
+                continue;
+            if (frame->frame == 0)
+                return false;
+            Frame view;
+            view.frame = frame->frame;
+            view.step = frame->step;
+            view.simTime = frame->simTime;
+            view.count = std::min(frame->count, h->capacity);
+            view.typeStart = frame->typeStart;
+            view.position = reinterpret_cast<const glm::dvec3*>(buffer + h->arrayOffset[SHARED_POSITION]);
+            view.velocity = reinterpret_cast<const glm::dvec3*>(buffer + h->arrayOffset[SHARED_VELOCITY]);
+            view.mass = reinterpret_cast<const float*>(buffer + h->arrayOffset[SHARED_MASS]);
+            view.id = reinterpret_cast<const uint32_t*>(buffer + h->arrayOffset[SHARED_ID]);
+            view.flags = buffer + h->arrayOffset[SHARED_FLAGS];
+            fn(static_cast<const Frame&>(view));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (frame->sequence.load(std::memory_order_relaxed) == sequence)
+                return true;
+        }
+        return false;
+    }
+
+private:
+    int fd = -1;
+    const unsigned char* base = nullptr;
+    size_t bytes = 0;
+    uint32_t mappedLayout = 0;
+
+    const SharedStateHeader* header() const { return reinterpret_cast<const SharedStateHeader*>(base); }
+
+    // maps the whole object at its current size, again after the producer grew it
+    bool map()
+    {
+        if (base)
+            munmap(const_cast<unsigned char*>(base), bytes);
+        base = nullptr;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < SHARED_STATE_HEADER_BYTES)
+            return false;
+        void* mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED)
+            return false;
+        base = static_cast<const unsigned char*>(mapped);
+        bytes = static_cast<size_t>(st.st_size);
+        const SharedStateHeader* h = header();
+        mappedLayout = h->layout.load(std::memory_order_acquire);
+        if (h->magic != SHARED_STATE_MAGIC || h->version != SHARED_STATE_VERSION || h->objectBytes > bytes)
+        {
+            munmap(mapped, bytes);
+            base = nullptr;
+            bytes = 0;
+            return false;
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef SIGNED_DISTANCE_FIELD_H
+#define SIGNED_DISTANCE_FIELD_H
+
+#include <glm.hpp>
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+// A model's signed distance field sampled on a resolution^3 grid of cubic cells over its bounds, negative inside the
+// surface: contact with the mesh for the price of one trilinear lookup instead of tests against the triangles near
+// the point. Baked at import (mesh_sdf.h) and kept in the cooked model cache, GL-free so the physics can hold it.
+// Outside the grid the distance to the grid's box is added to the value at the nearest point of the box, which
+// overestimates off the corners, but the whole surface is inside the grid so no contact is missed for it.
+struct SignedDistanceField
+{
+    glm::vec3 origin = glm::vec3(0.0f);     // the first sample, at the grid's low corner
+    float cellSize = 0.0f;
+    uint32_t resolution = 0;                // samples per axis
+    std::vector<float> values;              // x fastest, then y, then z
+
+    bool empty() const { return resolution < 2 || values.empty(); }
+
+    float at(uint32_t x, uint32_t y, uint32_t z) const
+    {
+        return values[(static_cast<size_t>(z) * resolution + y) * resolution + x];
+    }
+
+    glm::vec3 center() const { return origin + glm::vec3(0.5f * cellSize * static_cast<float>(resolution - 1)); }
+
+    // the radius of the sphere around center() holding the grid, outside it the distance is positive everywhere
+    float boundingRadius() const { return 0.5f * std::sqrt(3.0f) * cellSize * static_cast<float>(resolution - 1); }
+
+    // the distance at p in model space
+    float sample(const glm::vec3& p) const
+    {
+        if (empty())
+            return INFINITY;
+        const float last = static_cast<float>(resolution - 1);
+        const glm::vec3 g = (p - origin) / cellSize;
+        const glm::vec3 clamped = glm::clamp(g, glm::vec3(0.0f), glm::vec3(last));
+        const float outside = glm::length(g - clamped) * cellSize;
+        const glm::vec3 base = glm::min(glm::floor(clamped), glm::vec3(last - 1.0f));
+        const glm::vec3 f = clamped - base;
+        const uint32_t x = static_cast<uint32_t>(base.x), y = static_cast<uint32_t>(base.y), z = static_cast<uint32_t>(base.z);
+        const float c00 = glm::mix(at(x, y, z), at(x + 1, y, z), f.x);
+        const float c10 = glm::mix(at(x, y + 1, z), at(x + 1, y + 1, z), f.x);
+        const float c01 = glm::mix(at(x, y, z + 1), at(x + 1, y, z + 1), f.x);
+        const float c11 = glm::mix(at(x, y + 1, z + 1), at(x + 1, y + 1, z + 1), f.x);
+        return glm::mix(glm::mix(c00, c10, f.y), glm::mix(c01, c11, f.y), f.z) + outside;
+    }
+
+    // the outward direction at p, the field's central differences
+    glm::vec3 normal(const glm::vec3& p) const
+    {
+        const float h = 0.5f * cellSize;
+        const glm::vec3 g(sample(p + glm::vec3(h, 0.0f, 0.0f)) - sample(p - glm::vec3(h, 0.0f, 0.0f)),
+                          sample(p + glm::vec3(0.0f, h, 0.0f)) - sample(p - glm::vec3(0.0f, h, 0.0f)),
+                          sample(p + glm::vec3(0.0f, 0.0f, h)) - sample(p - glm::vec3(0.0f, 0.0f, h)));
+        const float length = glm::length(g);
+        return length > 0.0f ? g / length : glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+};
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef SKELETAL_ANIMATION_H
+#define SKELETAL_ANIMATION_H
+
+#include <glm.hpp>
+#include <gtc/quaternion.hpp>
+#include <gtc/matrix_transform.hpp>
+
+#include <thread_pool.h>
+#include <profiler.h>
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Skeletal animation on the CPU side: the bones of a model, its clips, and the evaluation of a pose into a bone
+// palette, the matrices the skinning vertex shader (shaders.2/skinned.instanced.vs) blends each vertex's up to
+// MAX_BONE_INFLUENCE bones with. Bones and channels are resolved to the model's nodes when it is imported
+// (model_import::loadSkeleton), so evaluating a pose compares no names. Nothing here touches GL.
+
+// A model's node hierarchy as the animation sees it, parents before children, and its bones. A bone's palette
+// matrix is globalInverse * (the world transform of its node) * inverseBind.
+struct Skeleton
+{
+    std::vector<int32_t> nodeParent;        // -1 for the root
+    std::vector<glm::mat4> nodeRest;        // relative to the parent, for nodes no channel drives
+    std::vector<std::string> boneNames;
+    std::vector<glm::mat4> inverseBind;     // mesh space to the bone's space in the bind pose
+    std::vector<uint32_t> boneNode;
+    std::unordered_map<std::string, uint32_t> boneIndex;
+    glm::mat4 globalInverse = glm::mat4(1.0f);
+
+    bool empty() const { return boneNames.empty(); }
+    size_t boneCount() const { return boneNames.size(); }
+    size_t nodeCount() const { return nodeParent.size(); }
+
+    // the bone of that name, added with its inverse bind matrix if it is new
+    uint32_t addBone(const std::string& name, const glm::mat4& offset)
+    {
+        auto found = boneIndex.find(name);
+        if (found != boneIndex.end())
+            return found->second;
+        const uint32_t bone = static_cast<uint32_t>(boneNames.size());
+        boneIndex.emplace(name, bone);
+        boneNames.push_back(name);
+        inverseBind.push_back(offset);
+        boneNode.push_back(0);
+        return bone;
+    }
+};
+
+// the keys of one node, each kind with its own times in seconds, ascending
+struct AnimationChannel
+{
+    uint32_t node;
+    std::vector<float> positionTimes;
+    std::vector<glm::vec3> positions;
+    std::vector<float> rotationTimes;
+    std::vector<glm::quat> rotations;
+    std::vector<float> scaleTimes;
+    std::vector<glm::vec3> scales;
+};
+
+struct AnimationClip
+{
+    std::string name;
+    float duration = 0.0f;      // seconds, the clip loops over it
+    std::vector<AnimationChannel> channels;
+};
+
+namespace animation_detail {
+
+// the key pair around time and how far between them, the first or last key alone outside them
+inline size_t keyAt(const std::vector<float>& times, float time, float& blend)
+{
+    blend = 0.0f;
+    if (times.size() < 2 || time <= times.front())
+        return 0;
+    if (time >= times.back())
+        return times.size() - 1;
+    const size_t next = static_cast<size_t>(std::upper_bound(times.begin(), times.end(), time) - times.begin());
+    const float span = times[next] - times[next - 1];
+    blend = span > 0.0f ? (time - times[next - 1]) / span : 0.0f;
+    return next - 1;
+}
+
+inline glm::vec3 sample(const std::vector<float>& times, const std::vector<glm::vec3>& keys, float time, const glm::vec3& fallback)
+{
+    if (keys.empty())
+        return fallback;
+    float blend;
+    const size_t k = keyAt(times, time, blend);
+    return k + 1 < keys.size() ? glm::mix(keys[k], keys[k + 1], blend) : keys[k];
+}
+
+inline glm::quat sample(const std::vector<float>& times, const std::vector<glm::quat>& keys, float time)
+{
+    if (keys.empty())
+        return glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    float blend;
+    const size_t k = keyAt(times, time, blend);
+    return k + 1 < keys.size() ? glm::normalize(glm::slerp(keys[k], keys[k + 1], blend)) : keys[k];
+}
+
+} // namespace animation_detail
+
+// the palette of skeleton posed by clip at time seconds (wrapped into the clip) into palette, boneCount() matrices.
+// nodes is scratch of nodeCount() matrices, kept by the caller so a pose does not allocate.
+inline void evaluatePose(const Skeleton& skeleton, const AnimationClip& clip, float time, glm::mat4* palette, std::vector<glm::mat4>& nodes)
+{
+    nodes.assign(skeleton.nodeRest.begin(), skeleton.nodeRest.end());
+    if (clip.duration > 0.0f)
+        time = std::fmod(std::fmod(time, clip.duration) + clip.duration, clip.duration);
+    for (const AnimationChannel& channel : clip.channels)
+    {
+        const glm::vec3 position = animation_detail::sample(channel.positionTimes, channel.positions, time, glm::vec3(0.0f));
+        const glm::quat rotation = animation_detail::sample(channel.rotationTimes, channel.rotations, time);
+        const glm::vec3 scale = animation_detail::sample(channel.scaleTimes, channel.scales, time, glm::vec3(1.0f));
+        nodes[channel.node] = glm::scale(glm::translate(glm::mat4(1.0f), position) * glm::mat4_cast(rotation), scale);
+    }
+    // parents come first, so one pass turns the locals into world transforms
+    for (size_t n = 0; n < nodes.size(); n++)
+        if (skeleton.nodeParent[n] >= 0)
+            nodes[n] = nodes[skeleton.nodeParent[n]] * nodes[n];
+    for (size_t b = 0; b < skeleton.boneCount(); b++)
+        palette[b] = skeleton.globalInverse * nodes[skeleton.boneNode[b]] * skeleton.inverseBind[b];
+}
+
+// one posed instance: which clip of the model, and where in it
+struct PoseRequest
+{
+    uint32_t clip;
+    float time;
+};
+
+// Poses many instances of one skeleton, each independent of the others, so the requests are split across a thread
+// pool and every slice keeps its own node scratch. Instance k's palette lands at palettes + k * boneCount().
+class PoseEvaluator
+{
+public:
+    void evaluate(const Skeleton& skeleton, const std::vector<AnimationClip>& clips, const PoseRequest* requests, size_t count,
+                  glm::mat4* palettes, ThreadPool* pool = &workerPool())
+    {
+        PROFILE_SCOPE("PoseEvaluator::evaluate");
+        if (count == 0 || skeleton.empty() || clips.empty())
+            return;
+        const size_t bones = skeleton.boneCount();
+        auto slice = [&](size_t begin, size_t end, unsigned int s) {
+            std::vector<glm::mat4>& nodes = scratch[s];
+            for (size_t k = begin; k < end; k++)
+            {
+                const AnimationClip& clip = clips[std::min<size_t>(requests[k].clip, clips.size() - 1)];
+                evaluatePose(skeleton, clip, requests[k].time, palettes + k * bones, nodes);
+            }
+        };
+        scratch.resize(pool ? pool->size() : 1);
+        if (pool)
+            pool->parallelFor(0, count, slice);
+        else
+            slice(0, count, 0);
+    }
+
+private:
+    std::vector<std::vector<glm::mat4>> scratch;    // per slice
+};
+
+#endif
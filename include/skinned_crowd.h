@@ -0,0 +1,278 @@
+#ifndef SKINNED_CROWD_H
+#define SKINNED_CROWD_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <model.h>
+#include <shader.h>
+#include <skeletal_animation.h>
+#include <streaming_buffer.h>
+#include <gpu_memory.h>
+#include <profiler.h>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Many instances of one skinned model, each playing a clip of its own. The poses are evaluated on the CPU across
+// workerPool() (PoseEvaluator) straight into a persistently mapped ring of bone palettes, and the model is drawn once
+// per mesh with every instance in it. The model needs VERTEX_LAYOUT_FULL, the only layout with bone ids and weights.
+//
+// Skinned in the vertex shader (shaders.2/skinned.instanced.vs) an instance finds its palette at gl_InstanceID *
+// boneCount in the storage buffer at PALETTE_SSBO and its model matrix at MATRIX_SSBO, and every pass that draws
+// the crowd skins it again. With preSkinning a compute pass (shaders.2/skinning.cs) skins each posed instance once
+// per frame into a vertex stream at SKINNED_SSBO, in model space, which every pass then reads as it is
+// (shaders.2/preskinned.instanced.vs). The stream outlives the frame, so an instance that was not posed keeps its
+// last skin: with animationLod, instances farther than animationLod are posed every second frame, twice that
+// distance every fourth and so on up to MAX_LOD_INTERVAL, staggered so the work evens out over the frames. The
+// stream takes 32 bytes per vertex per instance, which is what caps the crowds it suits.
+class SkinnedCrowd
+{
+public:
+    static const unsigned int PALETTE_SSBO = 16;
+    static const unsigned int MATRIX_SSBO = 17;
+    static const unsigned int SKINNED_SSBO = 18;
+    static const unsigned int SOURCE_SSBO = 19;     // the bind-pose vertices, for the compute pass
+    static const unsigned int POSED_SSBO = 20;      // which instance each palette of the compute pass is
+    static const unsigned int MAX_LOD_INTERVAL = 8;
+    static const unsigned int MAX_DISPATCH_ROWS = 65535;    // the least GL_MAX_COMPUTE_WORK_GROUP_COUNT in y
+
+    struct Instance
+    {
+        glm::mat4 model = glm::mat4(1.0f);
+        uint32_t clip = 0;
+        float timeOffset = 0.0f;    // seconds into the clip at time 0
+        float speed = 1.0f;
+    };
+
+    std::vector<Instance> instances;
+    bool preSkinning = false;
+    float animationLod = 0.0f;      // distance from the eye beyond which poses update less often, 0 for every frame
+
+    explicit SkinnedCrowd(const char* skinningPath) : skinningShader(skinningPath) {}
+    SkinnedCrowd(const SkinnedCrowd&) = delete;
+    SkinnedCrowd& operator=(const SkinnedCrowd&) = delete;
+
+    ~SkinnedCrowd()
+    {
+        release();
+    }
+
+    // instances posed by the last update
+    unsigned int posedCount() const { return posed; }
+
+    // poses the instances due at time seconds, seen from eye, and writes the palettes and model matrices for this
+    // frame's draws; with preSkinning they are skinned into the stream as well. The buffers are (re)allocated when
+    // the crowd outgrew them.
+    void update(const Model& model, float time, const glm::vec3& eye)
+    {
+        PROFILE_SCOPE("SkinnedCrowd::update");
+        bones = static_cast<unsigned int>(model.skeleton.boneCount());
+        count = static_cast<unsigned int>(instances.size());
+        posed = 0;
+        if (count == 0 || bones == 0)
+            return;
+        // a new buffer or stream, or a switch between them, holds nothing worth keeping
+        const bool everyone = reserve(model) || preSkinning != skinnedLast || animationLod <= 0.0f;
+        skinnedLast = preSkinning;
+        frame++;
+
+        dueInstances.clear();
+        requests.clear();
+        for (unsigned int k = 0; k < count; k++)
+        {
+            const Instance& instance = instances[k];
+            if (!everyone)
+            {
+                const float distance = glm::length(glm::vec3(instance.model[3]) - eye);
+                const unsigned int interval = lodInterval(distance);
+                if ((frame + k) % interval != 0)
+                    continue;
+            }
+            dueInstances.push_back(k);
+            requests.push_back(PoseRequest{instance.clip, instance.timeOffset + instance.speed * time});
+        }
+        posed = static_cast<unsigned int>(requests.size());
+
+        uint8_t* segment = static_cast<uint8_t*>(frames.beginWrite());
+        glm::mat4* palettes = reinterpret_cast<glm::mat4*>(segment);
+        glm::mat4* matrices = reinterpret_cast<glm::mat4*>(segment + paletteBytes);
+        for (unsigned int k = 0; k < count; k++)
+            matrices[k] = instances[k].model;
+        if (preSkinning || posed == count)
+        {
+            // the compute pass reads the palettes of the posed instances alone, in their order; the vertex
+            // shader of all of them when everyone was posed, which is the same order then
+            evaluator.evaluate(model.skeleton, model.animations, requests.data(), posed, palettes);
+            std::memcpy(segment + paletteBytes + matrixBytes, dueInstances.data(), posed * sizeof(uint32_t));
+            if (!preSkinning && animationLod > 0.0f)
+                poses.assign(palettes, palettes + static_cast<size_t>(count) * bones);
+        }
+        else
+        {
+            // the vertex shader skins every instance every frame, the ones not posed from their last palettes
+            posedPalettes.resize(static_cast<size_t>(posed) * bones);
+            evaluator.evaluate(model.skeleton, model.animations, requests.data(), posed, posedPalettes.data());
+            for (unsigned int p = 0; p < posed; p++)
+                std::copy_n(posedPalettes.data() + static_cast<size_t>(p) * bones, bones, poses.data() + static_cast<size_t>(dueInstances[p]) * bones);
+            std::memcpy(palettes, poses.data(), static_cast<size_t>(count) * bones * sizeof(glm::mat4));
+        }
+        if (preSkinning)
+            skin(model);
+    }
+
+    // draws the instances posed by the last update. shader is the skinned one (shaders.2/skinned.instanced.vs)
+    // without preSkinning and the pre-skinned one (shaders.2/preskinned.instanced.vs) with it, the Matrices block
+    // bound; any number of passes can draw the same update.
+    void draw(Shader& shader, Model& model)
+    {
+        if (count == 0 || bones == 0 || !frames.valid())
+            return;
+        GL_DEBUG_GROUP("skinned crowd");
+        const size_t offset = frames.readOffset();
+        glState().bindBufferRange(GL_SHADER_STORAGE_BUFFER, MATRIX_SSBO, frames.buffer(), static_cast<GLintptr>(offset + paletteBytes),
+                                  static_cast<GLsizeiptr>(static_cast<size_t>(count) * sizeof(glm::mat4)));
+        shader.use();
+        if (preSkinning)
+            glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, SKINNED_SSBO, skinnedVertices.id());
+        else
+        {
+            glState().bindBufferRange(GL_SHADER_STORAGE_BUFFER, PALETTE_SSBO, frames.buffer(), static_cast<GLintptr>(offset),
+                                      static_cast<GLsizeiptr>(static_cast<size_t>(count) * bones * sizeof(glm::mat4)));
+            shader.setInt("boneCount", static_cast<int>(bones));
+        }
+        for (size_t m = 0; m < model.meshes.size(); m++)
+        {
+            Mesh& mesh = model.meshes[m];
+            if (preSkinning)
+            {
+                shader.setInt("firstVertex", mesh.baseVertex());
+                shader.setInt("vertexCount", static_cast<int>(mesh.vertexCount));
+                shader.setInt("streamBase", static_cast<int>(streamBase[m]));
+            }
+            mesh.bindSamplers(shader);
+            mesh.bindTextures();
+            glState().bindVertexArray(mesh.VAO);
+            mesh.drawElementsInstanced(count);
+        }
+        glState().bindVertexArray(0);
+        frames.fenceRead();
+    }
+
+    void release()
+    {
+        frames.release();
+        skinnedVertices.release();
+        capacity = 0;
+    }
+
+private:
+    // one vertex of the stream, as shaders.2/skinning.cs writes it
+    struct SkinnedVertex
+    {
+        glm::vec4 position;
+        glm::vec4 normal;
+    };
+
+    Shader skinningShader;
+    StreamingBuffer frames{GPU_MEMORY_INSTANCES};   // per segment: the palettes, the model matrices, the posed instances
+    GlBuffer skinnedVertices{GPU_MEMORY_GEOMETRY};  // every mesh's vertices for capacity instances, mesh after mesh
+    PoseEvaluator evaluator;
+    std::vector<PoseRequest> requests;
+    std::vector<uint32_t> dueInstances;
+    std::vector<glm::mat4> poses;                   // last palettes of every instance, for animationLod without preSkinning
+    std::vector<glm::mat4> posedPalettes;
+    std::vector<size_t> streamBase;                 // first vertex of each mesh's instances in the stream
+    unsigned int bones = 0;
+    unsigned int count = 0;
+    unsigned int posed = 0;
+    unsigned int capacity = 0;      // instances the buffers have room for at bones bones
+    unsigned int capacityBones = 0;
+    size_t paletteBytes = 0;
+    size_t matrixBytes = 0;
+    size_t streamVertices = 0;      // of one instance, all meshes
+    unsigned int frame = 0;
+    bool skinnedLast = false;
+
+    unsigned int lodInterval(float distance) const
+    {
+        if (animationLod <= 0.0f || distance <= animationLod)
+            return 1;
+        const unsigned int doublings = static_cast<unsigned int>(std::log2(distance / animationLod)) + 1;
+        return doublings >= 3 ? MAX_LOD_INTERVAL : std::min(1u << doublings, MAX_LOD_INTERVAL);
+    }
+
+    // true when the buffers were (re)allocated, or when the poses have to be rebuilt for a crowd that changed size
+    bool reserve(const Model& model)
+    {
+        size_t vertices = 0;
+        for (const Mesh& mesh : model.meshes)
+            vertices += mesh.vertexCount;
+        if (frames.valid() && count <= capacity && bones == capacityBones && vertices == streamVertices)
+        {
+            const bool resized = poses.size() != static_cast<size_t>(count) * bones;
+            poses.resize(static_cast<size_t>(count) * bones);
+            return resized;
+        }
+        capacity = std::max(count, capacity + capacity / 2);
+        capacityBones = bones;
+        streamVertices = vertices;
+        // storage buffer ranges start at a multiple of the offset alignment, 256 covers every implementation
+        GLint alignment = 256;
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        const size_t align = static_cast<size_t>(std::max(alignment, 1));
+        auto aligned = [align](size_t bytes) { return (bytes + align - 1) / align * align; };
+        paletteBytes = aligned(static_cast<size_t>(capacity) * bones * sizeof(glm::mat4));
+        matrixBytes = aligned(static_cast<size_t>(capacity) * sizeof(glm::mat4));
+        frames.create(aligned(paletteBytes + matrixBytes + capacity * sizeof(uint32_t)), "skinned crowd");
+
+        streamBase.clear();
+        size_t base = 0;
+        for (const Mesh& mesh : model.meshes)
+        {
+            streamBase.push_back(base);
+            base += static_cast<size_t>(capacity) * mesh.vertexCount;
+        }
+        skinnedVertices.create(GL_SHADER_STORAGE_BUFFER, "skinned crowd vertices");
+        skinnedVertices.storage(std::max<size_t>(base, 1) * sizeof(SkinnedVertex), nullptr, 0);
+        glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        poses.assign(static_cast<size_t>(count) * bones, glm::mat4(1.0f));
+        return true;
+    }
+
+    // the posed instances of every mesh into the stream, a workgroup row per instance
+    void skin(const Model& model)
+    {
+        if (posed == 0)
+            return;
+        GL_DEBUG_GROUP("pre-skinning");
+        const size_t offset = frames.readOffset();
+        glState().bindBufferRange(GL_SHADER_STORAGE_BUFFER, PALETTE_SSBO, frames.buffer(), static_cast<GLintptr>(offset),
+                                  static_cast<GLsizeiptr>(static_cast<size_t>(posed) * bones * sizeof(glm::mat4)));
+        glState().bindBufferRange(GL_SHADER_STORAGE_BUFFER, POSED_SSBO, frames.buffer(), static_cast<GLintptr>(offset + paletteBytes + matrixBytes),
+                                  static_cast<GLsizeiptr>(posed * sizeof(uint32_t)));
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, SKINNED_SSBO, skinnedVertices.id());
+        skinningShader.use();
+        skinningShader.setInt("boneCount", static_cast<int>(bones));
+        for (size_t m = 0; m < model.meshes.size(); m++)
+        {
+            const Mesh& mesh = model.meshes[m];
+            if (mesh.vertexCount == 0)
+                continue;
+            glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, SOURCE_SSBO, mesh.vertexBuffer());
+            skinningShader.setInt("firstVertex", mesh.baseVertex());
+            skinningShader.setInt("vertexCount", static_cast<int>(mesh.vertexCount));
+            skinningShader.setInt("streamBase", static_cast<int>(streamBase[m]));
+            for (unsigned int first = 0; first < posed; first += MAX_DISPATCH_ROWS)
+            {
+                skinningShader.setInt("firstPosed", static_cast<int>(first));
+                glDispatchCompute((mesh.vertexCount + 63) / 64, std::min(posed - first, MAX_DISPATCH_ROWS), 1);
+            }
+        }
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+};
+
+#endif
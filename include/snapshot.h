@@ -0,0 +1,287 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <body_store.h>
+
+#include <mapped_file.h>
+
+#include <thread>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+// Binary simulation state, laid out so a load is a mmap and a few memcpys with nothing to parse.
+// The file is a fixed 256-byte little-endian header followed by one array per body field (structure of arrays,
+// each 64-byte aligned) in the BodyStore's own in-memory representation. Render pointers are not stored,
+// the loader re-attaches them by body type. Bump SNAPSHOT_VERSION whenever the layout changes.
+static const char SNAPSHOT_MAGIC[8] = {'N', 'B', 'O', 'D', 'Y', 'S', 'N', 'P'};
+static const uint32_t SNAPSHOT_VERSION = 1;
+
+enum SnapshotArray {
+    SNAPSHOT_POSITION = 0,      // dvec3
+    SNAPSHOT_VELOCITY = 1,      // dvec3
+    SNAPSHOT_MASS = 2,          // float
+    SNAPSHOT_FLAGS = 3,         // uint8
+    SNAPSHOT_ORIENTATION = 4,   // quat, x y z w
+    SNAPSHOT_RADIUS_SCALE = 5,  // float
+    SNAPSHOT_ID = 6,            // uint32
+    SNAPSHOT_ARRAY_COUNT = 7
+};
+
+struct SnapshotHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerBytes;
+    uint64_t fileBytes;
+    uint64_t typeCount[BODY_TYPE_COUNT];
+    double simTime;
+    uint64_t stepCount;
+    float G;
+    float epsilonSq;
+    uint64_t arrayOffset[SNAPSHOT_ARRAY_COUNT];
+    uint64_t arrayBytes[SNAPSHOT_ARRAY_COUNT];
+    unsigned char reserved[256 - 8 - 4 - 4 - 8 - 8 * BODY_TYPE_COUNT - 8 - 8 - 4 - 4 - 16 * SNAPSHOT_ARRAY_COUNT];
+};
+
+static_assert(sizeof(SnapshotHeader) == 256, "the snapshot header is part of the file format");
+static_assert(sizeof(glm::dvec3) == 24 && sizeof(glm::quat) == 16, "snapshot arrays are raw glm storage");
+
+// the format is little-endian and stored as-is, a big-endian host would have to byte-swap every array
+inline bool snapshotHostIsLittleEndian()
+{
+    const uint32_t probe = 1;
+    unsigned char first;
+    std::memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+// the simulation state a snapshot records besides the bodies
+struct SnapshotInfo
+{
+    double simTime = 0.0;
+    unsigned long stepCount = 0;
+    float G = 0.0f;
+    float epsilonSq = 0.0f;
+};
+
+// the header of a snapshot of bodies, its array offsets and the file size
+inline SnapshotHeader buildSnapshotHeader(const BodyStore& bodies, const SnapshotInfo& info)
+{
+    const size_t n = bodies.size();
+    const size_t elementBytes[SNAPSHOT_ARRAY_COUNT] = {sizeof(glm::dvec3), sizeof(glm::dvec3), sizeof(float), sizeof(uint8_t),
+                                                       sizeof(glm::quat), sizeof(float), sizeof(uint32_t)};
+    SnapshotHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.headerBytes = sizeof(SnapshotHeader);
+    for (unsigned int t = 0; t < BODY_TYPE_COUNT; t++)
+        header.typeCount[t] = bodies.count(static_cast<BodyType>(t));
+    header.simTime = info.simTime;
+    header.stepCount = info.stepCount;
+    header.G = info.G;
+    header.epsilonSq = info.epsilonSq;
+    uint64_t offset = sizeof(SnapshotHeader);
+    for (unsigned int a = 0; a < SNAPSHOT_ARRAY_COUNT; a++)
+    {
+        header.arrayOffset[a] = offset;
+        header.arrayBytes[a] = n * elementBytes[a];
+        offset = (offset + header.arrayBytes[a] + 63) & ~uint64_t(63);
+    }
+    header.fileBytes = offset;
+    return header;
+}
+
+// Serializes the state into one contiguous file image. This is the only part that runs on the caller,
+// the SnapshotWriter hands the image to its thread for the actual write.
+inline void buildSnapshotImage(const BodyStore& bodies, const SnapshotInfo& info, std::vector<unsigned char>& image)
+{
+    const size_t n = bodies.size();
+    const SnapshotHeader header = buildSnapshotHeader(bodies, info);
+    image.assign(header.fileBytes, 0);
+    std::memcpy(image.data(), &header, sizeof(header));
+    if (n == 0)
+        return;
+    std::memcpy(&image[header.arrayOffset[SNAPSHOT_POSITION]], bodies.position.data(), header.arrayBytes[SNAPSHOT_POSITION]);
+    std::memcpy(&image[header.arrayOffset[SNAPSHOT_VELOCITY]], bodies.velocity.data(), header.arrayBytes[SNAPSHOT_VELOCITY]);
+    std::memcpy(&image[header.arrayOffset[SNAPSHOT_MASS]], bodies.mass.data(), header.arrayBytes[SNAPSHOT_MASS]);
+    std::memcpy(&image[header.arrayOffset[SNAPSHOT_FLAGS]], bodies.flags.data(), header.arrayBytes[SNAPSHOT_FLAGS]);
+    std::memcpy(&image[header.arrayOffset[SNAPSHOT_ID]], bodies.id.data(), header.arrayBytes[SNAPSHOT_ID]);
+    glm::quat* orientation = reinterpret_cast<glm::quat*>(&image[header.arrayOffset[SNAPSHOT_ORIENTATION]]);
+    float* radiusScale = reinterpret_cast<float*>(&image[header.arrayOffset[SNAPSHOT_RADIUS_SCALE]]);
+    for (size_t i = 0; i < n; i++)
+    {
+        orientation[i] = bodies.render[i].orientation;
+        radiusScale[i] = bodies.render[i].radiusScale;
+    }
+}
+
+// Writes snapshots on a background thread. write() only copies the state into the writer's image, so the
+// simulation can keep stepping while the file goes out. The file appears under its name only once complete.
+class SnapshotWriter
+{
+public:
+    ~SnapshotWriter()
+    {
+        wait();
+    }
+
+    bool busy() const { return writing.load(std::memory_order_acquire); }
+
+    // false if the previous write has not finished yet
+    bool write(const std::string& path, const BodyStore& bodies, const SnapshotInfo& info)
+    {
+        if (busy() || !snapshotHostIsLittleEndian())
+            return false;
+        wait();
+        buildSnapshotImage(bodies, info, image);
+        writing.store(true, std::memory_order_release);
+        thread = std::thread([this, path]() {
+            std::string partial = path + ".partial";
+            bool ok = false;
+            if (FILE* f = std::fopen(partial.c_str(), "wb"))
+            {
+                ok = std::fwrite(image.data(), 1, image.size(), f) == image.size();
+                ok = std::fclose(f) == 0 && ok;
+                ok = ok && std::rename(partial.c_str(), path.c_str()) == 0;
+                if (!ok) std::remove(partial.c_str());
+            }
+            lastWriteOk.store(ok, std::memory_order_relaxed);
+            writing.store(false, std::memory_order_release);
+        });
+        return true;
+    }
+
+    void wait()
+    {
+        if (thread.joinable())
+            thread.join();
+    }
+
+    // result of the most recent completed write
+    bool lastSucceeded() const { return lastWriteOk.load(std::memory_order_relaxed); }
+
+private:
+    std::thread thread;
+    std::vector<unsigned char> image;
+    std::atomic<bool> writing{false};
+    std::atomic<bool> lastWriteOk{false};
+};
+
+// A snapshot file mapped read-only. open() validates the header and the array bounds, after that the arrays
+// can be read in place, e.g. by tools that only need positions, or restored into a BodyStore.
+class MappedSnapshot
+{
+public:
+    // the whole file is copied out by restore(), so it is mapped populated
+    bool open(const char* path)
+    {
+        close();
+        if (!snapshotHostIsLittleEndian() || !file.open(path, true))
+            return false;
+        data = file.data();
+        mappedBytes = file.size();
+        if (mappedBytes < sizeof(SnapshotHeader) || !validate())
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+        file.close();
+        data = nullptr;
+        mappedBytes = 0;
+    }
+
+    bool isOpen() const { return data != nullptr; }
+    const SnapshotHeader& header() const { return *reinterpret_cast<const SnapshotHeader*>(data); }
+
+    size_t bodyCount() const
+    {
+        size_t n = 0;
+        for (unsigned int t = 0; t < BODY_TYPE_COUNT; t++)
+            n += header().typeCount[t];
+        return n;
+    }
+
+    SnapshotInfo info() const
+    {
+        SnapshotInfo out;
+        out.simTime = header().simTime;
+        out.stepCount = static_cast<unsigned long>(header().stepCount);
+        out.G = header().G;
+        out.epsilonSq = header().epsilonSq;
+        return out;
+    }
+
+    template <typename T>
+    const T* array(SnapshotArray a) const { return reinterpret_cast<const T*>(data + header().arrayOffset[a]); }
+
+    // replaces the bodies with the snapshot's and attaches the render pointers by type, as initialize does
+    void restore(BodyStore& bodies, Mesh* sunMesh = nullptr, Model* planetModel = nullptr, Model* asteroidModel = nullptr) const
+    {
+        size_t counts[BODY_TYPE_COUNT];
+        for (unsigned int t = 0; t < BODY_TYPE_COUNT; t++)
+            counts[t] = static_cast<size_t>(header().typeCount[t]);
+        const size_t n = bodyCount();
+        bodies.assignLayout(counts, array<uint32_t>(SNAPSHOT_ID));
+        const glm::dvec3* position = array<glm::dvec3>(SNAPSHOT_POSITION);
+        const glm::dvec3* velocity = array<glm::dvec3>(SNAPSHOT_VELOCITY);
+        const float* mass = array<float>(SNAPSHOT_MASS);
+        const uint8_t* flags = array<uint8_t>(SNAPSHOT_FLAGS);
+        bodies.position.assign(position, position + n);
+        bodies.velocity.assign(velocity, velocity + n);
+        bodies.mass.assign(mass, mass + n);
+        bodies.flags.assign(flags, flags + n);
+        bodies.acceleration.assign(n, glm::vec3(0.0f));
+        const glm::quat* orientation = array<glm::quat>(SNAPSHOT_ORIENTATION);
+        const float* radiusScale = array<float>(SNAPSHOT_RADIUS_SCALE);
+        bodies.render.clear();
+        bodies.render.reserve(n);
+        for (unsigned int t = 0; t < BODY_TYPE_COUNT; t++)
+        {
+            const BodyRange r = bodies.range(static_cast<BodyType>(t));
+            Model* model = t == BODY_PLANET ? planetModel : t == BODY_ASTEROID ? asteroidModel : nullptr;
+            Mesh* mesh = t == BODY_SUN ? sunMesh : nullptr;
+            for (size_t i = r.begin; i < r.end; i++)
+            {
+                bodies.render.push_back(BodyRenderData{orientation[i], radiusScale[i], model, mesh});
+                if (t == BODY_ASTEROID)
+                    bodies.render.back().spin = tumbleFor(bodies.id[i]);
+            }
+        }
+    }
+
+private:
+    MappedFile file;
+    const unsigned char* data = nullptr;
+    size_t mappedBytes = 0;
+
+    bool validate() const
+    {
+        const SnapshotHeader& h = header();
+        if (std::memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic)) != 0 || h.version != SNAPSHOT_VERSION ||
+            h.headerBytes != sizeof(SnapshotHeader) || h.fileBytes > mappedBytes)
+            return false;
+        const size_t elementBytes[SNAPSHOT_ARRAY_COUNT] = {sizeof(glm::dvec3), sizeof(glm::dvec3), sizeof(float), sizeof(uint8_t),
+                                                           sizeof(glm::quat), sizeof(float), sizeof(uint32_t)};
+        const uint64_t n = bodyCount();
+        for (unsigned int a = 0; a < SNAPSHOT_ARRAY_COUNT; a++)
+        {
+            if (h.arrayBytes[a] != n * elementBytes[a] || h.arrayOffset[a] % 64 != 0 ||
+                h.arrayOffset[a] < sizeof(SnapshotHeader) || h.arrayOffset[a] + h.arrayBytes[a] > h.fileBytes)
+                return false;
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,190 @@
+#ifndef SPATIAL_HASH_H
+#define SPATIAL_HASH_H
+
+#include <glm.hpp>
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+// Uniform grid over unbounded space, stored as an open-addressing hash of occupied cells. Entries are keyed by a
+// stable body id, each cell holds an intrusive doubly linked list of ids, so update() only relinks a body when it
+// crossed into another cell and a step costs O(N) with no allocation once the tables have grown. Cells that have
+// emptied keep their slot until the table is more than half full, then it is rebuilt with just the occupied ones.
+// With the cell size at least the largest interaction distance, every partner of a body is in its own cell or
+// one of the 26 around it.
+class SpatialHash
+{
+public:
+    static constexpr uint32_t NONE = 0xffffffffu;
+
+    // drops every entry and switches to a new cell size
+    void reset(double size)
+    {
+        cell = size;
+        inverseCell = 1.0 / size;
+        entries.clear();
+        tracked = 0;
+        initTable(64);
+    }
+
+    double cellSize() const { return cell; }
+    size_t size() const { return tracked; }
+
+    // puts id at p, moving it to another cell only if p left its current one
+    void update(uint32_t id, const glm::dvec3& p)
+    {
+        if (id >= entries.size())
+            entries.resize(id + 1);
+        const uint64_t key = keyOf(p);
+        Entry& e = entries[id];
+        if (e.bucket != NONE && buckets[e.bucket].key == key)
+            return;
+        if (e.bucket != NONE)
+            unlink(id);
+        else
+            tracked++;
+        link(id, key);
+    }
+
+    void remove(uint32_t id)
+    {
+        if (id >= entries.size() || entries[id].bucket == NONE)
+            return;
+        unlink(id);
+        tracked--;
+    }
+
+    // calls fn(id) for every id in the cell of p and the 26 cells around it
+    template <typename Fn>
+    void forEachNear(const glm::dvec3& p, const Fn& fn) const
+    {
+        const int64_t cx = coordinate(p.x), cy = coordinate(p.y), cz = coordinate(p.z);
+        for (int64_t dz = -1; dz <= 1; dz++)
+            for (int64_t dy = -1; dy <= 1; dy++)
+                for (int64_t dx = -1; dx <= 1; dx++)
+                {
+                    uint32_t b = find(pack(cx + dx, cy + dy, cz + dz));
+                    if (b == NONE)
+                        continue;
+                    for (uint32_t id = buckets[b].head; id != NONE; id = entries[id].next)
+                        fn(id);
+                }
+    }
+
+private:
+    struct Entry
+    {
+        uint32_t bucket = NONE;     // slot of the cell holding the id, NONE when not tracked
+        uint32_t next = NONE;
+        uint32_t prev = NONE;
+    };
+    struct Bucket
+    {
+        uint64_t key;
+        uint32_t head;              // NONE for an empty cell that still holds its slot
+        bool used;
+    };
+
+    double cell = 1.0;
+    double inverseCell = 1.0;
+    std::vector<Entry> entries;     // indexed by id
+    std::vector<Bucket> buckets;
+    std::vector<Bucket> previous;   // kept for its storage, rehash swaps the tables
+    size_t usedBuckets = 0;
+    size_t tracked = 0;
+
+    // 21 bits per axis, cell coordinates beyond that wrap and only cost false candidates
+    static uint64_t pack(int64_t x, int64_t y, int64_t z)
+    {
+        const uint64_t mask = (uint64_t(1) << 21) - 1;
+        return (static_cast<uint64_t>(x) & mask) | (static_cast<uint64_t>(y) & mask) << 21 | (static_cast<uint64_t>(z) & mask) << 42;
+    }
+
+    int64_t coordinate(double v) const { return static_cast<int64_t>(std::floor(v * inverseCell)); }
+    uint64_t keyOf(const glm::dvec3& p) const { return pack(coordinate(p.x), coordinate(p.y), coordinate(p.z)); }
+
+    uint32_t slotOf(uint64_t key) const
+    {
+        return static_cast<uint32_t>((key * 0x9e3779b97f4a7c15ull) >> 32) & static_cast<uint32_t>(buckets.size() - 1);
+    }
+
+    uint32_t find(uint64_t key) const
+    {
+        for (uint32_t b = slotOf(key);; b = (b + 1) & static_cast<uint32_t>(buckets.size() - 1))
+        {
+            if (!buckets[b].used) return NONE;
+            if (buckets[b].key == key) return b;
+        }
+    }
+
+    void initTable(size_t capacity)
+    {
+        buckets.assign(capacity, Bucket{0, NONE, false});
+        usedBuckets = 0;
+    }
+
+    void link(uint32_t id, uint64_t key)
+    {
+        uint32_t b = find(key);
+        if (b == NONE)
+        {
+            if (2 * (usedBuckets + 1) > buckets.size())
+            {
+                rehash(2 * tracked + 64);
+                b = find(key);
+            }
+            if (b == NONE)
+            {
+                b = slotOf(key);
+                while (buckets[b].used)
+                    b = (b + 1) & static_cast<uint32_t>(buckets.size() - 1);
+                buckets[b] = Bucket{key, NONE, true};
+                usedBuckets++;
+            }
+        }
+        Entry& e = entries[id];
+        e.bucket = b;
+        e.prev = NONE;
+        e.next = buckets[b].head;
+        if (e.next != NONE)
+            entries[e.next].prev = id;
+        buckets[b].head = id;
+    }
+
+    void unlink(uint32_t id)
+    {
+        Entry& e = entries[id];
+        if (e.prev != NONE)
+            entries[e.prev].next = e.next;
+        else
+            buckets[e.bucket].head = e.next;
+        if (e.next != NONE)
+            entries[e.next].prev = e.prev;
+        e.bucket = e.next = e.prev = NONE;
+    }
+
+    // rebuilds the table with only the occupied cells, sized to at least twice capacity (a power of two)
+    void rehash(size_t capacity)
+    {
+        size_t size = 64;
+        while (size < 2 * capacity) size *= 2;
+        previous.swap(buckets);
+        initTable(size);
+        for (const Bucket& bucket : previous)
+        {
+            if (!bucket.used || bucket.head == NONE)
+                continue;
+            uint32_t b = slotOf(bucket.key);
+            while (buckets[b].used)
+                b = (b + 1) & static_cast<uint32_t>(buckets.size() - 1);
+            buckets[b] = Bucket{bucket.key, bucket.head, true};
+            usedBuckets++;
+            for (uint32_t id = bucket.head; id != NONE; id = entries[id].next)
+                entries[id].bucket = b;
+        }
+    }
+};
+
+#endif
@@ -3,16 +3,24 @@
 
 #include <mesh.h>
 #include <vector>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <unordered_map>
 #include <glm.hpp>
 #include <gtc/constants.hpp>
 
 class SphereCreator
 {
 public:
-    static Mesh CreateSphere(float radius, unsigned int sectorCount, unsigned int stackCount)
+    // nothing on a sphere needs bones or more than the packed precision
+    static Mesh CreateSphere(float radius, unsigned int sectorCount, unsigned int stackCount, VertexLayout layout = VERTEX_LAYOUT_PACKED,
+                             bool pooled = false)
     {
         std::vector<Vertex> vertices;
         std::vector<unsigned int> indices;
+        vertices.reserve(static_cast<size_t>(stackCount + 1) * (sectorCount + 1));
+        indices.reserve(static_cast<size_t>(stackCount) * sectorCount * 6);
 
         for (unsigned int i = 0; i <= stackCount; ++i)
         {
@@ -55,8 +63,128 @@ public:
             }
         }
 
-        return Mesh(vertices, indices, {});
+        return Mesh(std::move(vertices), std::move(indices), {}, layout, pooled);
+    }
+
+    static const unsigned int MAX_SUBDIVISIONS = 7;
+
+    // An icosahedron subdivided subdivisions times (20 * 4^n triangles), every new vertex pushed out onto the
+    // sphere, so the triangles are all about the same size instead of crowding at the poles. Each level keeps the
+    // vertices of the one before and adds its edge midpoints, so the coarser levels index the same vertices and
+    // become the mesh's LODs, up to lodLevels of them. 16-bit indices up to six subdivisions (40962 vertices),
+    // unless pooled. The texture coordinates are each vertex's longitude and latitude without a seam, fine for the
+    // untextured light sources.
+    static Mesh CreateIcosphere(float radius, unsigned int subdivisions, VertexLayout layout = VERTEX_LAYOUT_PACKED, bool pooled = false,
+                                unsigned int lodLevels = MAX_MESH_LODS)
+    {
+        std::vector<glm::vec3> points;
+        std::vector<std::vector<unsigned int>> levels;
+        subdivideIcosahedron(std::min(subdivisions, MAX_SUBDIVISIONS), points, levels);
+
+        std::vector<Vertex> vertices;
+        vertices.reserve(points.size());
+        for (const glm::vec3& p : points)
+        {
+            Vertex vertex;
+            vertex.Position = p * radius;
+            vertex.Normal = p;
+            vertex.TexCoords = glm::vec2(0.5f + std::atan2(p.y, p.x) / glm::two_pi<float>(), std::acos(glm::clamp(p.z, -1.0f, 1.0f)) / glm::pi<float>());
+            vertex.Tangent = glm::vec3(0.0f, 0.0f, 0.0f);
+            vertex.Bitangent = glm::vec3(0.0f, 0.0f, 0.0f);
+            std::fill(std::begin(vertex.m_BoneIDs), std::end(vertex.m_BoneIDs), -1);
+            std::fill(std::begin(vertex.m_Weights), std::end(vertex.m_Weights), 0.0f);
+            vertices.push_back(vertex);
+        }
+
+        std::vector<std::vector<unsigned int>> coarser;
+        for (size_t level = levels.size() - 1; level > 0 && coarser.size() + 1 < lodLevels; level--)
+            coarser.push_back(std::move(levels[level - 1]));
+        Mesh mesh(std::move(vertices), std::move(levels.back()), {}, layout, pooled, true);
+        mesh.adoptLods(coarser);
+        return mesh;
+    }
+
+private:
+    // the unit icosahedron's points and the triangles of every level from 0 to subdivisions, counter-clockwise
+    // seen from outside like CreateSphere's
+    static void subdivideIcosahedron(unsigned int subdivisions, std::vector<glm::vec3>& points, std::vector<std::vector<unsigned int>>& levels)
+    {
+        const float t = (1.0f + std::sqrt(5.0f)) * 0.5f;
+        const glm::vec3 corners[12] = {
+            {-1, t, 0}, {1, t, 0}, {-1, -t, 0}, {1, -t, 0}, {0, -1, t}, {0, 1, t},
+            {0, -1, -t}, {0, 1, -t}, {t, 0, -1}, {t, 0, 1}, {-t, 0, -1}, {-t, 0, 1}
+        };
+        const unsigned int faces[60] = {
+            0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11, 1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+            3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9, 4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1
+        };
+        // 10 * 4^n + 2 vertices at the finest level
+        points.clear();
+        points.reserve((static_cast<size_t>(10) << (2 * subdivisions)) + 2);
+        for (const glm::vec3& corner : corners)
+            points.push_back(glm::normalize(corner));
+        levels.assign(1, std::vector<unsigned int>(std::begin(faces), std::end(faces)));
+
+        for (unsigned int level = 0; level < subdivisions; level++)
+        {
+            const std::vector<unsigned int>& previous = levels.back();
+            std::vector<unsigned int> next;
+            next.reserve(previous.size() * 4);
+            // an edge's midpoint is shared by the two triangles on it
+            std::unordered_map<uint64_t, unsigned int> midpoints;
+            midpoints.reserve(previous.size() / 2);
+            auto midpoint = [&](unsigned int a, unsigned int b) {
+                const uint64_t key = (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+                auto found = midpoints.find(key);
+                if (found != midpoints.end())
+                    return found->second;
+                const unsigned int index = static_cast<unsigned int>(points.size());
+                points.push_back(glm::normalize(points[a] + points[b]));
+                midpoints.emplace(key, index);
+                return index;
+            };
+            for (size_t i = 0; i < previous.size(); i += 3)
+            {
+                const unsigned int a = previous[i], b = previous[i + 1], c = previous[i + 2];
+                const unsigned int ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+                const unsigned int split[12] = { a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca };
+                next.insert(next.end(), std::begin(split), std::end(split));
+            }
+            levels.push_back(std::move(next));
+        }
     }
 };
 
+// Icospheres of unit radius made once per subdivision level, layout and pooling, shared by everything drawing
+// one (scaled by its model matrix). Release it before the GL context goes.
+class SphereCache
+{
+public:
+    Mesh& icosphere(unsigned int subdivisions, VertexLayout layout = VERTEX_LAYOUT_PACKED, bool pooled = false)
+    {
+        const Key key(std::min(subdivisions, SphereCreator::MAX_SUBDIVISIONS), layout, pooled);
+        std::unique_ptr<Mesh>& mesh = meshes[key];
+        if (!mesh)
+            mesh.reset(new Mesh(SphereCreator::CreateIcosphere(1.0f, std::get<0>(key), layout, pooled)));
+        return *mesh;
+    }
+
+    size_t size() const { return meshes.size(); }
+
+    void release()
+    {
+        meshes.clear();
+    }
+
+private:
+    typedef std::tuple<unsigned int, VertexLayout, bool> Key;
+    std::map<Key, std::unique_ptr<Mesh>> meshes;
+};
+
+inline SphereCache& sphereCache()
+{
+    static SphereCache cache;
+    return cache;
+}
+
 #endif
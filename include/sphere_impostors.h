@@ -0,0 +1,104 @@
+#ifndef SPHERE_IMPOSTORS_H
+#define SPHERE_IMPOSTORS_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+#include <gtc/quaternion.hpp>
+
+#include <shader.h>
+#include <gpu_memory.h>
+
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+
+// Suns and planets as ray-cast spheres instead of meshes: one quad per body, drawn instanced without vertex
+// buffers (shaders.2/sphere.impostor.vs), placed in front of the sphere and sized to its silhouette, and a
+// fragment shader that intersects the view ray with the sphere and writes its depth (sphere.impostor.fs). The
+// silhouette is exact at any size for four vertices a body. Light sources are emissive; the other bodies are lit
+// by the first point light and wrap the bound texture by longitude and latitude.
+class SphereImpostors
+{
+public:
+    static const unsigned int BINDING = 15;     // SSBO of the shaders
+
+    // SphereImpostor of the shaders, std430
+    struct Instance
+    {
+        glm::vec4 centerRadius;     // camera-relative centre, radius in w
+        glm::vec4 orientation;      // quaternion, x y z w
+        glm::vec4 color;            // emission, or the albedo the texture is multiplied by; w 1 for emissive
+        glm::uvec4 pick;            // x the id written for GpuPicker, 0 for none
+    };
+
+    SphereImpostors(const char* vertexPath, const char* fragmentPath, const ShaderDefines& defines = ShaderDefines())
+        : shader(vertexPath, fragmentPath, defines) {}
+
+    ~SphereImpostors()
+    {
+        release();
+    }
+
+    Shader& program() { return shader; }
+    size_t size() const { return instances.size(); }
+    // empty, bound for draw(); there after the first upload
+    unsigned int vertexArray() const { return emptyVao.id(); }
+
+    void clear() { instances.clear(); }
+
+    void add(const glm::vec3& center, float radius, const glm::quat& orientation, const glm::vec3& color, bool emissive, uint32_t pick = 0)
+    {
+        instances.push_back(Instance{glm::vec4(center, radius), glm::vec4(orientation.x, orientation.y, orientation.z, orientation.w),
+                                     glm::vec4(color, emissive ? 1.0f : 0.0f), glm::uvec4(pick, 0u, 0u, 0u)});
+    }
+
+    // sends this frame's instances into the buffer, a new one of twice the instances when they outgrow it
+    void upload()
+    {
+        if (emptyVao.id() == 0)
+        {
+            emptyVao.create("sphere impostors");
+            glState().bindVertexArray(0);
+        }
+        if (!buffer.valid() || instances.size() > capacity)
+        {
+            capacity = std::max<size_t>(2 * instances.size(), 64);
+            buffer.create(GL_SHADER_STORAGE_BUFFER, "sphere impostors");
+            buffer.storage(capacity * sizeof(Instance), nullptr, GL_DYNAMIC_STORAGE_BIT);
+            glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        }
+        if (!instances.empty())
+            glNamedBufferSubData(buffer.id(), 0, instances.size() * sizeof(Instance), instances.data());
+    }
+
+    // the uploaded instances with the shader in use, its uniforms set and vertexArray() bound
+    void draw() const
+    {
+        draw(0, instances.size());
+    }
+
+    // count of them from first, e.g. those of one surface texture
+    void draw(size_t first, size_t count) const
+    {
+        count = std::min(count, instances.size() - std::min(first, instances.size()));
+        if (count == 0)
+            return;
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING, buffer.id());
+        glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(count), static_cast<GLuint>(first));
+    }
+
+    void release()
+    {
+        buffer.release();
+        emptyVao.release();
+    }
+
+private:
+    Shader shader;
+    GlBuffer buffer{GPU_MEMORY_INSTANCES};
+    size_t capacity = 0;            // instances the buffer holds
+    GlVertexArray emptyVao;
+    std::vector<Instance> instances;
+};
+
+#endif
@@ -0,0 +1,211 @@
+#ifndef STAR_CATALOG_H
+#define STAR_CATALOG_H
+
+#include <glm.hpp>
+#include <gtc/constants.hpp>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <random>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+// A star catalog in a compact binary: 16 bytes a star, a position in parsecs from the sun and its apparent
+// magnitude and B-V colour index in thousandths, the layout the GPU reads unchanged (shaders.2/star.field.vs).
+// The stars are grouped into chunks by direction, GRID x GRID cells on each face of a cube, and sorted brightest
+// first within a chunk, so everything down to a limiting magnitude is a prefix of each chunk: the GPU cull
+// (include/star_field.h) finds it with a binary search and skips chunks out of view. The file is a header, the
+// chunk table and the stars, in the order they are drawn in.
+namespace starcatalog {
+
+static const char MAGIC[8] = {'N', 'P', 'S', 'C', 'S', 'T', 'R', '1'};
+
+struct Star
+{
+    float position[3];          // parsecs, the direction is what is drawn
+    int16_t magnitude;          // apparent, thousandths
+    int16_t colorIndex;         // B-V, thousandths
+};
+
+// StarChunk of the shaders, std430
+struct Chunk
+{
+    float axis[3];              // the mean direction of its stars
+    float cosRadius;            // every star within this of the axis
+    uint32_t first;
+    uint32_t count;
+    float brightest;            // magnitudes
+    float faintest;
+};
+
+struct Header
+{
+    char magic[8];
+    uint32_t stars;
+    uint32_t chunks;
+    uint32_t grid;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(Star) == 16 && sizeof(Chunk) == 32 && sizeof(Header) == 24, "star catalog layout");
+
+struct Catalog
+{
+    std::vector<Star> stars;
+    std::vector<Chunk> chunks;
+    uint32_t grid = 0;
+};
+
+inline float magnitudeOf(const Star& star) { return star.magnitude * 0.001f; }
+
+inline int16_t thousandths(double value)
+{
+    return static_cast<int16_t>(std::clamp(std::lround(value * 1000.0), -32768L, 32767L));
+}
+
+// the chunk of a direction: its cube face and the cell on it
+inline uint32_t chunkOf(const glm::vec3& d, uint32_t grid)
+{
+    const glm::vec3 a = glm::abs(d);
+    uint32_t face;
+    float u, v, m;
+    if (a.x >= a.y && a.x >= a.z) { face = d.x > 0.0f ? 0 : 1; m = a.x; u = d.z; v = d.y; }
+    else if (a.y >= a.z) { face = d.y > 0.0f ? 2 : 3; m = a.y; u = d.x; v = d.z; }
+    else { face = d.z > 0.0f ? 4 : 5; m = a.z; u = d.x; v = d.y; }
+    const auto cell = [&](float t) {
+        return std::min(static_cast<uint32_t>((t / std::max(m, 1e-12f) * 0.5f + 0.5f) * grid), grid - 1);
+    };
+    return (face * grid + cell(v)) * grid + cell(u);
+}
+
+// sorts stars into chunks of a grid x grid cube and fills the chunk table; empty chunks are dropped
+inline Catalog build(std::vector<Star> stars, uint32_t grid)
+{
+    Catalog catalog;
+    catalog.grid = grid;
+    std::vector<uint32_t> keys(stars.size());
+    for (size_t i = 0; i < stars.size(); i++)
+        keys[i] = chunkOf(glm::normalize(glm::vec3(stars[i].position[0], stars[i].position[1], stars[i].position[2]) + glm::vec3(0.0f, 0.0f, 1e-30f)), grid);
+    std::vector<uint32_t> order(stars.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = static_cast<uint32_t>(i);
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return keys[a] != keys[b] ? keys[a] < keys[b] : stars[a].magnitude < stars[b].magnitude;
+    });
+    catalog.stars.reserve(stars.size());
+    for (size_t i = 0; i < order.size();)
+    {
+        const uint32_t key = keys[order[i]];
+        Chunk chunk{};
+        chunk.first = static_cast<uint32_t>(catalog.stars.size());
+        glm::dvec3 sum(0.0);
+        size_t end = i;
+        for (; end < order.size() && keys[order[end]] == key; end++)
+        {
+            const Star& s = stars[order[end]];
+            sum += glm::normalize(glm::dvec3(s.position[0], s.position[1], s.position[2]) + glm::dvec3(0.0, 0.0, 1e-30));
+            catalog.stars.push_back(s);
+        }
+        const glm::vec3 axis(glm::normalize(sum));
+        float cosRadius = 1.0f;
+        for (size_t k = chunk.first; k < catalog.stars.size(); k++)
+        {
+            const Star& s = catalog.stars[k];
+            const glm::vec3 d = glm::normalize(glm::vec3(s.position[0], s.position[1], s.position[2]) + glm::vec3(0.0f, 0.0f, 1e-30f));
+            cosRadius = std::min(cosRadius, glm::dot(axis, d));
+        }
+        std::memcpy(chunk.axis, &axis[0], sizeof(chunk.axis));
+        chunk.cosRadius = cosRadius;
+        chunk.count = static_cast<uint32_t>(end - i);
+        chunk.brightest = magnitudeOf(catalog.stars[chunk.first]);
+        chunk.faintest = magnitudeOf(catalog.stars.back());
+        catalog.chunks.push_back(chunk);
+        i = end;
+    }
+    return catalog;
+}
+
+inline bool write(const std::string& path, const Catalog& catalog)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.stars = static_cast<uint32_t>(catalog.stars.size());
+    header.chunks = static_cast<uint32_t>(catalog.chunks.size());
+    header.grid = catalog.grid;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(catalog.chunks.data()), static_cast<std::streamsize>(catalog.chunks.size() * sizeof(Chunk)));
+    out.write(reinterpret_cast<const char*>(catalog.stars.data()), static_cast<std::streamsize>(catalog.stars.size() * sizeof(Star)));
+    return static_cast<bool>(out);
+}
+
+inline bool read(const std::string& path, Catalog& catalog)
+{
+    std::ifstream in(path, std::ios::binary);
+    Header header{};
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+        return false;
+    catalog.grid = header.grid;
+    catalog.chunks.resize(header.chunks);
+    catalog.stars.resize(header.stars);
+    in.read(reinterpret_cast<char*>(catalog.chunks.data()), static_cast<std::streamsize>(catalog.chunks.size() * sizeof(Chunk)));
+    in.read(reinterpret_cast<char*>(catalog.stars.data()), static_cast<std::streamsize>(catalog.stars.size() * sizeof(Star)));
+    if (!in)
+        return false;
+    // a table that does not cover the stars would send the cull out of bounds
+    for (const Chunk& chunk : catalog.chunks)
+        if (static_cast<uint64_t>(chunk.first) + chunk.count > catalog.stars.size())
+            return false;
+    return true;
+}
+
+// A made-up sky for when there is no catalog: 60% of the stars isotropic and the rest in a band of the galactic
+// plane tilted 60 degrees to the ecliptic, counts growing by about 10^0.5 per magnitude down to faintest as real
+// counts do, absolute magnitudes around the sun's with the bright ones blue, and the distance from the distance
+// modulus.
+inline Catalog synthetic(unsigned int count, unsigned int seed, uint32_t grid = 16, float faintest = 11.0f)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    const double tilt = glm::radians(60.0);
+    const glm::dvec3 pole(0.0, std::cos(tilt), std::sin(tilt));
+    const glm::dvec3 e1(1.0, 0.0, 0.0);
+    const glm::dvec3 e2 = glm::cross(pole, e1);
+    const double c = 0.5 * std::log(10.0), a = std::exp(c * -1.5), b = std::exp(c * faintest);
+    std::vector<Star> stars(count);
+    for (Star& star : stars)
+    {
+        glm::dvec3 d;
+        if (uniform(rng) < 0.6)
+        {
+            const double z = 2.0 * uniform(rng) - 1.0, phi = glm::two_pi<double>() * uniform(rng);
+            const double s = std::sqrt(std::max(0.0, 1.0 - z * z));
+            d = glm::dvec3(s * std::cos(phi), s * std::sin(phi), z);
+        }
+        else
+        {
+            const double latitude = std::clamp(normal(rng) * glm::radians(8.0), -glm::half_pi<double>(), glm::half_pi<double>());
+            const double longitude = glm::two_pi<double>() * uniform(rng);
+            d = std::cos(latitude) * (std::cos(longitude) * e1 + std::sin(longitude) * e2) + std::sin(latitude) * pole;
+        }
+        const double m = std::log(a + uniform(rng) * (b - a)) / c;
+        const double absolute = 4.5 + 2.5 * normal(rng);
+        const double parsecs = 10.0 * std::pow(10.0, 0.2 * (m - absolute));
+        const double bv = std::clamp(0.65 + 0.15 * (absolute - 4.5) + 0.2 * normal(rng), -0.4, 2.0);
+        const glm::vec3 p(d * parsecs);
+        std::memcpy(star.position, &p[0], sizeof(star.position));
+        star.magnitude = thousandths(m);
+        star.colorIndex = thousandths(bv);
+    }
+    return build(std::move(stars), grid);
+}
+
+} // namespace starcatalog
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef STAR_FIELD_H
+#define STAR_FIELD_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <shader.h>
+#include <star_catalog.h>
+#include <gpu_cull.h>
+#include <gpu_memory.h>
+#include <gl_state_cache.h>
+#include <gl_debug.h>
+
+#include <cmath>
+#include <algorithm>
+
+// A catalog's stars as the sky, instead of the cubemap. The stars and the chunk table sit in SSBOs; every frame a
+// compute pass (shaders.2/star.cull.cs) gives each chunk one DrawArraysIndirectCommand: nothing if its cone is out
+// of view, otherwise its stars down to the limiting magnitude, the prefix a binary search over its brightness order
+// finds. One glMultiDrawArraysIndirect of points reads those commands, so nothing comes back to the CPU and the
+// drawn stars are what is in view and bright enough. Narrowing the view deepens the limit, zoomMagnitudes per
+// tenfold, as a telescope would. The points are added at infinity (depth 1, the skybox's) without depth writes,
+// their total brightness following the magnitude and their size only its fourth root.
+class StarField
+{
+public:
+    static const unsigned int BINDING_CHUNKS = 30;
+    static const unsigned int BINDING_STARS = 31;
+    static const unsigned int BINDING_DRAWS = 32;
+
+    float limitingMagnitude = 6.5f;     // at a 45 degree view, about the naked eye's
+    float zoomMagnitudes = 2.5f;
+    float pointSize = 1.5f;             // pixels of a star at the limit
+    float brightness = 0.6f;            // a star at the limit, summed over its sprite
+
+    StarField(const char* cullPath, const char* vertexPath, const char* fragmentPath)
+        : cullShader(cullPath), drawShader(vertexPath, fragmentPath) {}
+    StarField(const StarField&) = delete;
+    StarField& operator=(const StarField&) = delete;
+
+    ~StarField()
+    {
+        release();
+    }
+
+    Shader& program() { return drawShader; }
+    // empty, bound for draw()
+    unsigned int vertexArray() const { return emptyVao.id(); }
+    bool loaded() const { return stars.valid(); }
+    size_t starCount() const { return totalStars; }
+    size_t chunkCount() const { return chunks; }
+    size_t gpuBytes() const { return stars.bytes() + chunkTable.bytes() + draws.bytes(); }
+    // the limit of the last cull
+    float magnitudeLimit() const { return currentLimit; }
+
+    void upload(const starcatalog::Catalog& catalog)
+    {
+        release();
+        if (catalog.stars.empty() || catalog.chunks.empty())
+            return;
+        totalStars = catalog.stars.size();
+        chunks = catalog.chunks.size();
+        stars.create(GL_SHADER_STORAGE_BUFFER, "star catalog");
+        stars.storage(totalStars * sizeof(starcatalog::Star), catalog.stars.data(), 0);
+        chunkTable.create(GL_SHADER_STORAGE_BUFFER, "star chunks");
+        chunkTable.storage(chunks * sizeof(starcatalog::Chunk), catalog.chunks.data(), 0);
+        draws.create(GL_DRAW_INDIRECT_BUFFER, "star draws");
+        draws.storage(chunks * sizeof(GpuCuller::DrawArraysIndirectCommand), nullptr, 0);
+        glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        emptyVao.create("star field");
+        glState().bindVertexArray(0);
+    }
+
+    // the draw commands for a view looking along forward with the vertical field of view fovY (radians)
+    void cull(const glm::vec3& forward, float fovY, float aspect)
+    {
+        if (!loaded())
+            return;
+        GL_DEBUG_GROUP("star cull");
+        currentLimit = limitingMagnitude + zoomMagnitudes * std::log10(glm::radians(45.0f) / std::max(fovY, 1e-4f));
+        // the half angle to the view's corners
+        const float halfY = std::tan(0.5f * fovY);
+        const float viewRadius = std::atan(halfY * std::sqrt(1.0f + aspect * aspect));
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_CHUNKS, chunkTable.id());
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_STARS, stars.id());
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_DRAWS, draws.id());
+        cullShader.use();
+        cullShader.setUInt("chunkCount", static_cast<unsigned int>(chunks));
+        cullShader.setVec3("forward", glm::normalize(forward));
+        cullShader.setFloat("viewRadius", viewRadius);
+        cullShader.setInt("limit", static_cast<int>(std::lround(currentLimit * 1000.0f)));
+        glDispatchCompute(static_cast<GLuint>((chunks + 63) / 64), 1, 1);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+    }
+
+    // the culled stars with the draw shader in use and vertexArray() bound. Depth is tested but not written, and
+    // only the first colour attachment is written.
+    void draw()
+    {
+        if (!loaded())
+            return;
+        drawShader.setFloat("limit", currentLimit);
+        drawShader.setFloat("pointSize", pointSize);
+        drawShader.setFloat("brightness", brightness);
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_STARS, stars.id());
+        glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, draws.id());
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        glDepthMask(GL_FALSE);
+        glColorMaski(1, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glMultiDrawArraysIndirect(GL_POINTS, nullptr, static_cast<GLsizei>(chunks), 0);
+        glColorMaski(1, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthMask(GL_TRUE);
+        glDisable(GL_BLEND);
+        glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    void release()
+    {
+        stars.release();
+        chunkTable.release();
+        draws.release();
+        emptyVao.release();
+        totalStars = chunks = 0;
+    }
+
+private:
+    Shader cullShader;
+    Shader drawShader;
+    GlBuffer stars{GPU_MEMORY_OTHER};
+    GlBuffer chunkTable{GPU_MEMORY_OTHER};
+    GlBuffer draws{GPU_MEMORY_INSTANCES};
+    GlVertexArray emptyVao;
+    size_t totalStars = 0;
+    size_t chunks = 0;
+    float currentLimit = 0.0f;
+};
+
+#endif
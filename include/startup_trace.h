@@ -0,0 +1,386 @@
+#ifndef STARTUP_TRACE_H
+#define STARTUP_TRACE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iomanip>
+#include <ostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// what a startup phase keeps busy: the GL context, which only the main thread has, or just a CPU core
+enum StartupResource {
+    STARTUP_GL = 0,
+    STARTUP_CPU
+};
+
+// The viewer's cold start as phases with dependencies, from main() to the first frame on screen ("ready") and on to
+// the frame after which nothing is still streaming in ("complete"). The main thread marks its phases one after the
+// other, each from the mark before it, naming the phases it needs and whether it holds the GL context; skip()
+// leaves the time since the last mark out, a wait. Other threads (the model and texture loaders) time theirs with
+// StartupScope. A dependency names phases, every phase of that name that had ended by the time the dependent one
+// started is needed. Nothing is recorded once startup is complete.
+//
+// report() follows the critical path back from the first frame, at each phase to whichever of its dependencies or
+// its thread's previous phase ended last, the time between them waiting or untraced, and estimates what parallel
+// and async loading could reach: the same phases list scheduled with their measured times, the GL ones in their
+// order on the one context and the CPU ones on any core as soon as what they need is done, and, below that, the
+// longest chain of dependencies with nothing else in the way. writeTrace() writes the phases as Chrome trace JSON
+// (chrome://tracing, ui.perfetto.dev) with the dependencies as flow arrows and the critical path in red. Time
+// before main() (the loader and static constructors) is not in any of it.
+class StartupTrace
+{
+public:
+    struct Phase
+    {
+        std::string name;
+        std::string detail;
+        std::vector<std::string> after;     // the names of the phases it needs
+        StartupResource resource;
+        int thread;
+        int64_t startNs;
+        int64_t endNs;
+    };
+
+    StartupTrace() : epoch(std::chrono::steady_clock::now()) {}
+    StartupTrace(const StartupTrace&) = delete;
+    StartupTrace& operator=(const StartupTrace&) = delete;
+
+    int64_t now() const
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    bool recording() const { return !finished.load(std::memory_order_acquire); }
+    bool isReady() const { return readyNs >= 0; }
+    bool isComplete() const { return completeNs >= 0; }
+    double readyMs() const { return readyNs * 1e-6; }
+    double completeMs() const { return completeNs * 1e-6; }
+
+    // the calling thread's name in the report and the trace
+    void nameThread(const char* name)
+    {
+        const int thread = threadIndex();
+        std::lock_guard<std::mutex> lock(mutex);
+        threadNames[thread] = name;
+    }
+
+    void record(const std::string& name, const std::string& detail, std::vector<std::string> after, StartupResource resource,
+                int64_t startNs, int64_t endNs)
+    {
+        if (!recording())
+            return;
+        const int thread = threadIndex();
+        std::lock_guard<std::mutex> lock(mutex);
+        phases.push_back(Phase{name, detail, std::move(after), resource, thread, startNs, endNs});
+    }
+
+    // main thread: a phase from the last mark (or main's start) to now
+    void mark(const std::string& name, std::vector<std::string> after = {}, StartupResource resource = STARTUP_GL)
+    {
+        const int64_t nowNs = now();
+        record(name, "", std::move(after), resource, lastMarkNs, nowNs);
+        lastMarkNs = nowNs;
+    }
+
+    // main thread: the time since the last mark was spent waiting
+    void skip()
+    {
+        lastMarkNs = now();
+    }
+
+    // main thread, after a frame is swapped: the first is ready, needing every GL phase before it; the first with
+    // everything loaded completes startup. True on the frame that completes it.
+    bool frameShown(bool everythingLoaded)
+    {
+        if (!recording())
+            return false;
+        if (readyNs < 0)
+        {
+            const int thread = threadIndex();
+            std::vector<std::string> earlier;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (const Phase& p : phases)
+                    if (p.thread == thread && std::find(earlier.begin(), earlier.end(), p.name) == earlier.end())
+                        earlier.push_back(p.name);
+            }
+            mark("first frame", earlier);
+            readyNs = lastMarkNs;
+        }
+        if (!everythingLoaded)
+            return false;
+        completeNs = now();
+        finished.store(true, std::memory_order_release);
+        return true;
+    }
+
+    // the critical path, what waits on it and the estimates; the target in ms, 0 for none
+    void report(std::ostream& out, double targetMs = 0.0) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const int first = firstFrame();
+        if (first < 0)
+        {
+            out << "startup: no frame was shown" << std::endl;
+            return;
+        }
+        const std::vector<std::vector<int>> needs = dependencies();
+        const std::vector<int> path = criticalPath(first, needs);
+        const unsigned int cores = std::max(2u, std::thread::hardware_concurrency());
+        const double scheduledMs = schedule(needs, cores - 1)[first] * 1e-6;
+        const double chainMs = schedule(needs, 0)[first] * 1e-6;
+        double summedMs = 0.0, offMainMs = 0.0, loaderBeforeReadyMs = 0.0;
+        for (const Phase& p : phases)
+        {
+            summedMs += (p.endNs - p.startNs) * 1e-6;
+            if (p.thread != phases[first].thread)
+            {
+                offMainMs += (p.endNs - p.startNs) * 1e-6;
+                if (p.endNs <= readyNs)
+                    loaderBeforeReadyMs += (p.endNs - p.startNs) * 1e-6;
+            }
+        }
+
+        out << std::fixed << std::setprecision(1)
+            << "startup: ready in " << readyMs() << " ms (first frame presented)";
+        if (isComplete())
+            out << ", complete in " << completeMs() << " ms (nothing left streaming)";
+        out << "\n  " << phases.size() << " phases summing to " << summedMs << " ms, " << offMainMs << " ms of it off the main thread ("
+            << loaderBeforeReadyMs << " ms before ready)\n"
+            << std::left << std::setw(32) << "  phase" << std::setw(16) << "thread" << std::right << std::setw(10) << "start"
+            << std::setw(10) << "ms" << "  needs\n";
+        for (size_t i = 0; i < phases.size(); i++)
+        {
+            const Phase& p = phases[i];
+            if (p.startNs > readyNs)
+                continue;
+            std::string needed;
+            for (const std::string& name : p.after)
+                needed += (needed.empty() ? "" : ", ") + name;
+            const bool critical = std::find(path.begin(), path.end(), static_cast<int>(i)) != path.end();
+            out << (critical ? "* " : "  ") << std::left << std::setw(30) << (p.detail.empty() ? p.name : p.name + " " + shortened(p.detail))
+                << std::setw(16) << threadNames[p.thread] << std::right << std::setw(10) << p.startNs * 1e-6
+                << std::setw(10) << (p.endNs - p.startNs) * 1e-6 << "  " << (p.name == "first frame" ? "every main phase" : needed) << '\n';
+        }
+        out << "  critical path (*):";
+        double waitedMs = 0.0;
+        for (size_t k = 0; k < path.size(); k++)
+        {
+            const Phase& p = phases[path[k]];
+            out << (k ? " > " : " ") << p.name << " " << (p.endNs - p.startNs) * 1e-6;
+            if (k + 1 < path.size())
+                waitedMs += std::max<int64_t>(0, phases[path[k + 1]].startNs - p.endNs) * 1e-6;
+        }
+        waitedMs += phases[path.front()].startNs * 1e-6;
+        out << "\n  " << waitedMs << " ms of it waiting or untraced\n"
+            << "  parallel and async loading: " << scheduledMs << " ms with the GL phases in order on one context and the rest on "
+            << cores - 1 << " cores, saving " << readyMs() - scheduledMs << " ms; " << chainMs
+            << " ms with nothing but the dependencies in the way\n";
+        if (targetMs > 0.0)
+            out << "  target " << targetMs << " ms: " << (readyMs() <= targetMs ? "met, " : "missed by ")
+                << std::abs(targetMs - readyMs()) << (readyMs() <= targetMs ? " ms to spare" : " ms") << '\n';
+        out << std::defaultfloat << std::flush;
+    }
+
+    // the phases as Chrome trace JSON; false when the file cannot be written
+    bool writeTrace(const std::string& path) const
+    {
+        std::FILE* file = std::fopen(path.c_str(), "w");
+        if (!file)
+            return false;
+        std::lock_guard<std::mutex> lock(mutex);
+        const std::vector<std::vector<int>> needs = dependencies();
+        const int first = firstFrame();
+        const std::vector<int> critical = first >= 0 ? criticalPath(first, needs) : std::vector<int>();
+        std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        for (size_t t = 0; t < threadNames.size(); t++)
+            std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%zu,\"args\":{\"name\":\"%s\"}}",
+                         t ? ",\n" : "", t, escaped(threadNames[t]).c_str());
+        unsigned int flow = 0;
+        for (size_t i = 0; i < phases.size(); i++)
+        {
+            const Phase& p = phases[i];
+            const bool onPath = std::find(critical.begin(), critical.end(), static_cast<int>(i)) != critical.end();
+            std::fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"startup\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f%s,"
+                         "\"args\":{\"resource\":\"%s\",\"detail\":\"%s\",\"critical\":%s}}",
+                         escaped(p.name).c_str(), p.thread, p.startNs * 1e-3, (p.endNs - p.startNs) * 1e-3,
+                         onPath ? ",\"cname\":\"terrible\"" : "", p.resource == STARTUP_GL ? "gl" : "cpu", escaped(p.detail).c_str(),
+                         onPath ? "true" : "false");
+            // an arrow from the end of each phase it needed, first frame's only from the loader threads
+            for (int d : needs[i])
+            {
+                if (p.name == "first frame" && phases[d].thread == p.thread)
+                    continue;
+                flow++;
+                std::fprintf(file, ",\n{\"name\":\"needs\",\"cat\":\"startup\",\"ph\":\"s\",\"id\":%u,\"pid\":0,\"tid\":%d,\"ts\":%.3f}"
+                             ",\n{\"name\":\"needs\",\"cat\":\"startup\",\"ph\":\"f\",\"bp\":\"e\",\"id\":%u,\"pid\":0,\"tid\":%d,\"ts\":%.3f}",
+                             flow, phases[d].thread, phases[d].endNs * 1e-3 - 0.001, flow, p.thread, p.startNs * 1e-3);
+            }
+        }
+        if (isReady())
+            std::fprintf(file, ",\n{\"name\":\"ready\",\"ph\":\"i\",\"s\":\"g\",\"pid\":0,\"tid\":0,\"ts\":%.3f}", readyNs * 1e-3);
+        if (isComplete())
+            std::fprintf(file, ",\n{\"name\":\"complete\",\"ph\":\"i\",\"s\":\"g\",\"pid\":0,\"tid\":0,\"ts\":%.3f}", completeNs * 1e-3);
+        std::fprintf(file, "\n]}\n");
+        return std::fclose(file) == 0;
+    }
+
+private:
+    std::chrono::steady_clock::time_point epoch;
+    mutable std::mutex mutex;
+    std::vector<Phase> phases;              // in the order they ended
+    std::vector<const char*> threadNames;
+    std::atomic<int> threads{0};
+    std::atomic<bool> finished{false};
+    int64_t lastMarkNs = 0;                 // main thread only
+    int64_t readyNs = -1;
+    int64_t completeNs = -1;
+
+    int threadIndex()
+    {
+        thread_local int index = -1;
+        if (index < 0)
+        {
+            index = threads.fetch_add(1);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (threadNames.size() <= static_cast<size_t>(index))
+                threadNames.resize(index + 1, "worker");
+        }
+        return index;
+    }
+
+    int firstFrame() const
+    {
+        for (size_t i = 0; i < phases.size(); i++)
+            if (phases[i].name == "first frame")
+                return static_cast<int>(i);
+        return -1;
+    }
+
+    // the phases each one needs: those of a name it lists that had ended when it started
+    std::vector<std::vector<int>> dependencies() const
+    {
+        std::vector<std::vector<int>> needs(phases.size());
+        for (size_t i = 0; i < phases.size(); i++)
+            for (size_t j = 0; j < phases.size(); j++)
+                if (j != i && phases[j].endNs <= phases[i].startNs &&
+                    std::find(phases[i].after.begin(), phases[i].after.end(), phases[j].name) != phases[i].after.end())
+                    needs[i].push_back(static_cast<int>(j));
+        return needs;
+    }
+
+    // back from the phase to the latest ending of what it needed and its thread's previous phase, root first
+    std::vector<int> criticalPath(int last, const std::vector<std::vector<int>>& needs) const
+    {
+        std::vector<int> path{last};
+        for (int at = last;;)
+        {
+            std::vector<int> before = needs[at];
+            int previous = -1;
+            for (size_t j = 0; j < phases.size(); j++)
+                if (phases[j].thread == phases[at].thread && phases[j].endNs <= phases[at].startNs &&
+                    (previous < 0 || phases[j].endNs > phases[previous].endNs))
+                    previous = static_cast<int>(j);
+            if (previous >= 0)
+                before.push_back(previous);
+            if (before.empty())
+                break;
+            at = *std::max_element(before.begin(), before.end(), [this](int a, int b) { return phases[a].endNs < phases[b].endNs; });
+            path.push_back(at);
+        }
+        std::reverse(path.begin(), path.end());
+        return path;
+    }
+
+    // the end of every phase list scheduled in the order they started with their measured durations: each as soon
+    // as what it needs has ended, a GL one when the context is free and a CPU one on the earliest free of cores, or
+    // unconstrained with 0 cores
+    std::vector<int64_t> schedule(const std::vector<std::vector<int>>& needs, unsigned int cores) const
+    {
+        std::vector<int> order(phases.size());
+        for (size_t i = 0; i < order.size(); i++)
+            order[i] = static_cast<int>(i);
+        std::sort(order.begin(), order.end(), [this](int a, int b) { return phases[a].startNs < phases[b].startNs; });
+        std::vector<int64_t> end(phases.size(), 0);
+        std::vector<int64_t> coreFree(cores, 0);
+        int64_t contextFree = 0;
+        for (int i : order)
+        {
+            int64_t start = 0;
+            for (int d : needs[i])
+                start = std::max(start, end[d]);
+            const int64_t duration = phases[i].endNs - phases[i].startNs;
+            if (cores > 0 && phases[i].resource == STARTUP_GL)
+            {
+                start = std::max(start, contextFree);
+                contextFree = start + duration;
+            }
+            else if (cores > 0)
+            {
+                auto core = std::min_element(coreFree.begin(), coreFree.end());
+                start = std::max(start, *core);
+                *core = start + duration;
+            }
+            end[i] = start + duration;
+        }
+        return end;
+    }
+
+    static std::string shortened(const std::string& path)
+    {
+        const size_t slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+
+    static std::string escaped(const std::string& text)
+    {
+        std::string out;
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                out += '\\';
+            if (static_cast<unsigned char>(c) >= 0x20)
+                out += c;
+        }
+        return out;
+    }
+};
+
+// the process's startup, its epoch the first call (the start of main)
+inline StartupTrace& startupTrace()
+{
+    static StartupTrace instance;
+    return instance;
+}
+
+// a phase of a thread other than main's, its lifetime, on a core
+class StartupScope
+{
+public:
+    StartupScope(const char* name, const std::string& detail, std::vector<std::string> after = {})
+        : name(name), detail(detail), after(std::move(after)), startNs(startupTrace().recording() ? startupTrace().now() : -1) {}
+
+    ~StartupScope()
+    {
+        if (startNs >= 0)
+            startupTrace().record(name, detail, std::move(after), STARTUP_CPU, startNs, startupTrace().now());
+    }
+
+    StartupScope(const StartupScope&) = delete;
+    StartupScope& operator=(const StartupScope&) = delete;
+
+private:
+    const char* name;
+    std::string detail;
+    std::vector<std::string> after;
+    int64_t startNs;
+};
+
+#endif
@@ -0,0 +1,888 @@
+#ifndef STATE_STREAM_H
+#define STATE_STREAM_H
+
+#include <body_store.h>
+#include <trajectory.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Body state from one simulating process to any number of viewers over UDP. Every datagram starts with a
+// StatePacketHeader. A viewer says HELLO and is sent the body table (LAYOUT, one record per slot: uint8 type,
+// uint32 id, float radiusScale, quat orientation) until it acknowledges it; from then on each SNAPSHOT is the
+// positions of every slot on a grid of quantum world units, as zigzag varints of the difference to the snapshot
+// the viewer last acknowledged (its baseline), or of the grid index itself until it has acknowledged one. Viewers
+// ACK every snapshot they complete, so a lost datagram only costs that snapshot: the next is coded against what
+// the viewer has, not against what was sent. A snapshot is split at slot boundaries into datagrams below a
+// typical MTU, each decodable on its own once its baseline is there. Orientations are the layout's, the tumble
+// follows from the id like a replay's.
+//
+// Between consecutive snapshots a body moves a few dozen grid steps, one or two bytes a coordinate: 100k bodies
+// at 60 Hz are 20 to 40 MB/s to each viewer, about 150 to 300 Mbps including headers, and viewers acknowledging
+// the same snapshot are sent the same coded datagrams.
+static const uint32_t STATE_STREAM_MAGIC = 0x5353424e;     // "NBSS"
+static const uint8_t STATE_STREAM_VERSION = 1;
+static const uint16_t STATE_STREAM_PORT = 47800;
+static const size_t STATE_DATAGRAM_BYTES = 1200;
+
+enum StatePacketType : uint8_t {
+    STATE_PACKET_HELLO = 1,     // viewer to server, asks for the body table
+    STATE_PACKET_ACK,           // viewer to server, the table it has and the last snapshot it completed, also a keepalive
+    STATE_PACKET_BYE,           // viewer to server
+    STATE_PACKET_LAYOUT,        // server to viewer, slots of the body table
+    STATE_PACKET_SNAPSHOT       // server to viewer, positions of a run of slots
+};
+
+struct StatePacketHeader
+{
+    uint32_t magic;
+    uint8_t type;
+    uint8_t version;
+    uint16_t reserved;
+    uint32_t layout;            // generation of the body table, a new one whenever bodies come or go
+    uint32_t sequence;          // snapshot number, or the one acknowledged; 0 is none
+    uint32_t baseline;          // the snapshot a snapshot's values are differences to, 0 for grid indices
+    uint32_t firstSlot;
+    uint32_t slotCount;
+    uint32_t totalSlots;
+    double simTime;
+    double quantum;
+};
+
+static_assert(sizeof(StatePacketHeader) == 48, "part of the wire format");
+
+inline size_t stateLayoutRecordBytes() { return 1 + sizeof(uint32_t) + sizeof(float) + sizeof(glm::quat); }
+
+inline StatePacketHeader statePacketHeader(StatePacketType type)
+{
+    StatePacketHeader header = {};
+    header.magic = STATE_STREAM_MAGIC;
+    header.type = type;
+    header.version = STATE_STREAM_VERSION;
+    return header;
+}
+
+inline bool readStatePacketHeader(const unsigned char* data, size_t bytes, StatePacketHeader& header)
+{
+    if (bytes < sizeof(StatePacketHeader))
+        return false;
+    std::memcpy(&header, data, sizeof(header));
+    return header.magic == STATE_STREAM_MAGIC && header.version == STATE_STREAM_VERSION;
+}
+
+// Publishes a PhysicsWorld's bodies, from the headless runner's step loop. Single-threaded: publish reads what
+// the viewers sent, then sends each of them the new snapshot.
+class StateServer
+{
+public:
+    static const unsigned int HISTORY = 16;             // snapshots kept as baselines, an ack older than this restarts a viewer from grid indices
+    static const unsigned int LAYOUT_BURST = 256;       // layout datagrams per viewer per publish
+
+    struct Options
+    {
+        uint16_t port = STATE_STREAM_PORT;
+        double rate = 60.0;                 // snapshots per wall second
+        double quantum = 1.0 / 1024.0;      // position grid in world units
+        double timeout = 5.0;               // wall seconds of silence before a viewer is forgotten
+    };
+
+    StateServer() = default;
+    StateServer(const StateServer&) = delete;
+    StateServer& operator=(const StateServer&) = delete;
+
+    ~StateServer()
+    {
+        stop();
+    }
+
+    bool start(const Options& o)
+    {
+        stop();
+        options = o;
+        options.rate = std::max(options.rate, 0.1);
+        options.quantum = options.quantum > 0.0 ? options.quantum : 1.0 / 1024.0;
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_DGRAM;
+        hints.ai_flags = AI_PASSIVE;
+        addrinfo* found = nullptr;
+        const std::string port = std::to_string(options.port);
+        if (getaddrinfo(nullptr, port.c_str(), &hints, &found) != 0 || !found)
+        {
+            lastError = "cannot resolve port " + port;
+            return false;
+        }
+        // the IPv6 wildcard also takes IPv4 viewers where the system allows it
+        addrinfo* chosen = found;
+        for (addrinfo* a = found; a; a = a->ai_next)
+            if (a->ai_family == AF_INET6)
+                chosen = a;
+        for (int attempt = 0; attempt < 2 && socketFd < 0; attempt++)
+            for (addrinfo* a = attempt == 0 ? chosen : found; a && socketFd < 0; a = attempt == 0 ? nullptr : a->ai_next)
+            {
+                socketFd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+                if (socketFd < 0)
+                    continue;
+                if (a->ai_family == AF_INET6)
+                {
+                    int v6only = 0;
+                    setsockopt(socketFd, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, sizeof(v6only));
+                }
+                if (bind(socketFd, a->ai_addr, a->ai_addrlen) != 0)
+                {
+                    close(socketFd);
+                    socketFd = -1;
+                }
+            }
+        freeaddrinfo(found);
+        if (socketFd < 0)
+        {
+            lastError = "cannot listen on UDP port " + port;
+            return false;
+        }
+        // a snapshot of 100k bodies is a few hundred datagrams sent back to back to each viewer
+        int bufferBytes = 8 << 20;
+        setsockopt(socketFd, SOL_SOCKET, SO_SNDBUF, &bufferBytes, sizeof(bufferBytes));
+        // a generation that a restarted server will not repeat, so a viewer of the last run asks again
+        layoutGeneration = static_cast<uint32_t>(std::chrono::steady_clock::now().time_since_epoch().count()) | 1u;
+        layoutIds.clear();
+        nextDue = 0.0;
+        return true;
+    }
+
+    void stop()
+    {
+        if (socketFd >= 0)
+            close(socketFd);
+        socketFd = -1;
+        viewers.clear();
+        for (Snapshot& s : history)
+            s.sequence = 0;
+    }
+
+    bool running() const { return socketFd >= 0; }
+    const std::string& error() const { return lastError; }
+    const Options& settings() const { return options; }
+
+    // whether a snapshot is due at now, wall seconds on any steady clock
+    bool due(double now) const { return running() && now >= nextDue; }
+
+    void publish(const BodyStore& bodies, double simTime, double now)
+    {
+        if (!running())
+            return;
+        nextDue = std::max(nextDue + 1.0 / options.rate, now);
+        receive(now);
+        viewers.erase(std::remove_if(viewers.begin(), viewers.end(),
+                                     [&](const Viewer& v) { return now - v.lastHeard > options.timeout; }), viewers.end());
+        if (!sameBodies(bodies))
+            buildLayout(bodies);
+        if (viewers.empty())
+            return;
+
+        Snapshot& snapshot = history[++sequence % HISTORY];
+        snapshot.sequence = sequence;
+        snapshot.simTime = simTime;
+        snapshot.values.resize(layoutIds.size() * 3);
+        for (size_t k = 0; k < layoutIds.size(); k++)
+        {
+            const size_t i = bodies.id[k] == layoutIds[k] ? k : bodies.indexOf(layoutIds[k]);
+            for (int c = 0; c < 3; c++)
+                snapshot.values[k * 3 + c] = quantize(bodies.position[i][c]);
+        }
+
+        lastPublishBytes = 0;
+        usedEncodings = 0;
+        for (Viewer& viewer : viewers)
+        {
+            if (viewer.layout != layoutGeneration)
+            {
+                sendLayout(viewer);
+                continue;
+            }
+            const Snapshot* baseline = find(viewer.acked);
+            const Encoding& encoding = encode(snapshot, baseline);
+            for (size_t d = 0; d + 1 < encoding.ends.size(); d++)
+                sendTo(viewer, encoding.bytes.data() + encoding.ends[d], encoding.ends[d + 1] - encoding.ends[d]);
+        }
+        published++;
+    }
+
+    size_t viewerCount() const { return viewers.size(); }
+    size_t bodyCount() const { return layoutIds.size(); }
+    unsigned long long snapshotsPublished() const { return published; }
+    unsigned long long bytesSent() const { return totalBytes; }
+    size_t bytesLastPublish() const { return lastPublishBytes; }
+    // datagrams the socket refused, a send buffer too small for the rate
+    unsigned long long sendFailures() const { return failures; }
+
+private:
+    struct Viewer
+    {
+        sockaddr_storage address;
+        socklen_t addressLength;
+        uint32_t layout = 0;        // the table generation it has
+        uint32_t acked = 0;         // last snapshot it completed in that table
+        uint32_t layoutCursor = 0;  // next slot of the table to send it
+        double lastHeard = 0.0;
+    };
+
+    struct Snapshot
+    {
+        uint32_t sequence = 0;
+        double simTime = 0.0;
+        std::vector<int32_t> values;
+    };
+
+    // a snapshot coded against one baseline, datagram d is bytes[ends[d], ends[d + 1])
+    struct Encoding
+    {
+        uint32_t baseline = 0;
+        std::vector<unsigned char> bytes;
+        std::vector<size_t> ends;
+    };
+
+    Options options;
+    int socketFd = -1;
+    std::string lastError;
+    std::vector<Viewer> viewers;
+    std::vector<uint32_t> layoutIds;
+    std::vector<unsigned char> layoutRecords;
+    uint32_t layoutGeneration = 1;
+    uint32_t sequence = 0;
+    Snapshot history[HISTORY];
+    std::vector<Encoding> encodings;
+    size_t usedEncodings = 0;
+    double nextDue = 0.0;
+    unsigned long long published = 0;
+    unsigned long long totalBytes = 0;
+    unsigned long long failures = 0;
+    size_t lastPublishBytes = 0;
+
+    int32_t quantize(double v) const
+    {
+        const double q = std::floor(v / options.quantum + 0.5);
+        return static_cast<int32_t>(std::clamp(q, -2147483647.0, 2147483647.0));
+    }
+
+    void receive(double now)
+    {
+        unsigned char buffer[STATE_DATAGRAM_BYTES];
+        for (;;)
+        {
+            sockaddr_storage from;
+            socklen_t fromLength = sizeof(from);
+            const ssize_t bytes = recvfrom(socketFd, buffer, sizeof(buffer), MSG_DONTWAIT, reinterpret_cast<sockaddr*>(&from), &fromLength);
+            if (bytes < 0)
+                break;
+            StatePacketHeader header;
+            if (!readStatePacketHeader(buffer, static_cast<size_t>(bytes), header))
+                continue;
+            Viewer* viewer = nullptr;
+            for (Viewer& v : viewers)
+                if (v.addressLength == fromLength && std::memcmp(&v.address, &from, fromLength) == 0)
+                    viewer = &v;
+            if (header.type == STATE_PACKET_BYE)
+            {
+                if (viewer)
+                    viewers.erase(viewers.begin() + (viewer - viewers.data()));
+                continue;
+            }
+            if (header.type != STATE_PACKET_HELLO && header.type != STATE_PACKET_ACK)
+                continue;
+            if (!viewer)
+            {
+                viewers.emplace_back();
+                viewer = &viewers.back();
+                viewer->address = from;
+                viewer->addressLength = fromLength;
+            }
+            viewer->lastHeard = now;
+            if (header.type == STATE_PACKET_HELLO)
+            {
+                viewer->layout = 0;
+                viewer->acked = 0;
+                viewer->layoutCursor = 0;
+            }
+            else if (header.layout != viewer->layout)
+            {
+                // a table acknowledged, or one from before a restart that the next snapshot must not assume
+                viewer->layout = header.layout;
+                viewer->acked = header.layout == layoutGeneration ? header.sequence : 0;
+            }
+            else if (header.sequence > viewer->acked)
+                viewer->acked = header.sequence;
+        }
+    }
+
+    bool sameBodies(const BodyStore& bodies) const
+    {
+        if (bodies.size() != layoutIds.size())
+            return false;
+        for (size_t k = 0; k < layoutIds.size(); k++)
+            if (bodies.id[k] != layoutIds[k] && bodies.indexOf(layoutIds[k]) == BodyStore::INVALID_INDEX)
+                return false;
+        return true;
+    }
+
+    // the bodies' order now becomes the slot order, which keeps each type a dense range as a BodyStore needs it
+    void buildLayout(const BodyStore& bodies)
+    {
+        layoutIds = bodies.id;
+        layoutRecords.resize(layoutIds.size() * stateLayoutRecordBytes());
+        for (size_t k = 0; k < layoutIds.size(); k++)
+        {
+            unsigned char* record = layoutRecords.data() + k * stateLayoutRecordBytes();
+            record[0] = static_cast<unsigned char>(bodies.typeOf(k));
+            std::memcpy(record + 1, &layoutIds[k], sizeof(uint32_t));
+            std::memcpy(record + 1 + sizeof(uint32_t), &bodies.render[k].radiusScale, sizeof(float));
+            std::memcpy(record + 1 + sizeof(uint32_t) + sizeof(float), &bodies.render[k].orientation, sizeof(glm::quat));
+        }
+        layoutGeneration += 2;
+        for (Snapshot& s : history)
+            s.sequence = 0;
+    }
+
+    // the next LAYOUT_BURST datagrams of the table, round and round until the viewer acknowledges it
+    void sendLayout(Viewer& viewer)
+    {
+        const uint32_t total = static_cast<uint32_t>(layoutIds.size());
+        const uint32_t perDatagram = static_cast<uint32_t>((STATE_DATAGRAM_BYTES - sizeof(StatePacketHeader)) / stateLayoutRecordBytes());
+        unsigned char buffer[STATE_DATAGRAM_BYTES];
+        StatePacketHeader header = statePacketHeader(STATE_PACKET_LAYOUT);
+        header.layout = layoutGeneration;
+        header.totalSlots = total;
+        header.quantum = options.quantum;
+        for (unsigned int d = 0; d < LAYOUT_BURST; d++)
+        {
+            if (viewer.layoutCursor >= total)
+                viewer.layoutCursor = 0;
+            header.firstSlot = viewer.layoutCursor;
+            header.slotCount = std::min(perDatagram, total - viewer.layoutCursor);
+            std::memcpy(buffer, &header, sizeof(header));
+            std::memcpy(buffer + sizeof(header), layoutRecords.data() + header.firstSlot * stateLayoutRecordBytes(), header.slotCount * stateLayoutRecordBytes());
+            sendTo(viewer, buffer, sizeof(header) + header.slotCount * stateLayoutRecordBytes());
+            viewer.layoutCursor += header.slotCount;
+            if (total == 0 || (d + 1) * perDatagram >= total)
+                break;
+        }
+    }
+
+    const Snapshot* find(uint32_t s) const
+    {
+        const Snapshot& snapshot = history[s % HISTORY];
+        return s != 0 && snapshot.sequence == s ? &snapshot : nullptr;
+    }
+
+    // codes snapshot against baseline, or reuses the coding another viewer with the same baseline was sent
+    const Encoding& encode(const Snapshot& snapshot, const Snapshot* baseline)
+    {
+        const uint32_t base = baseline ? baseline->sequence : 0;
+        for (size_t e = 0; e < usedEncodings; e++)
+            if (encodings[e].baseline == base)
+                return encodings[e];
+        if (usedEncodings == encodings.size())
+            encodings.emplace_back();
+        Encoding& encoding = encodings[usedEncodings++];
+        encoding.baseline = base;
+        encoding.bytes.clear();
+        encoding.ends.assign(1, 0);
+
+        StatePacketHeader header = statePacketHeader(STATE_PACKET_SNAPSHOT);
+        header.layout = layoutGeneration;
+        header.sequence = snapshot.sequence;
+        header.baseline = base;
+        header.totalSlots = static_cast<uint32_t>(layoutIds.size());
+        header.simTime = snapshot.simTime;
+        header.quantum = options.quantum;
+        // a zigzag varint of the difference of two int32 is at most five bytes
+        const size_t worstSlot = 3 * 5;
+        size_t start = 0;
+        auto finish = [&](uint32_t endSlot) {
+            header.slotCount = endSlot - header.firstSlot;
+            std::memcpy(encoding.bytes.data() + start, &header, sizeof(header));
+            encoding.ends.push_back(encoding.bytes.size());
+        };
+        for (uint32_t k = 0; k < header.totalSlots; k++)
+        {
+            if (k == 0 || encoding.bytes.size() - start + worstSlot > STATE_DATAGRAM_BYTES)
+            {
+                if (k > 0)
+                    finish(k);
+                start = encoding.bytes.size();
+                header.firstSlot = k;
+                encoding.bytes.resize(start + sizeof(header));
+            }
+            for (int c = 0; c < 3; c++)
+            {
+                const int64_t value = snapshot.values[k * 3 + c];
+                putVarint(encoding.bytes, zigzag(baseline ? value - baseline->values[k * 3 + c] : value));
+            }
+        }
+        if (header.totalSlots > 0)
+            finish(header.totalSlots);
+        return encoding;
+    }
+
+    void sendTo(const Viewer& viewer, const unsigned char* data, size_t bytes)
+    {
+        if (sendto(socketFd, data, bytes, 0, reinterpret_cast<const sockaddr*>(&viewer.address), viewer.addressLength) < 0)
+        {
+            failures++;
+            return;
+        }
+        totalBytes += bytes;
+        lastPublishBytes += bytes;
+    }
+};
+
+// The viewer's end: assembles the server's snapshots, acknowledges each one completed and plays them back like a
+// TrajectoryPlayer, frameA and frameB the snapshots around the playback time, which runs a few snapshots behind the
+// newest at the rate sim time arrives so that late or lost datagrams do not stall it.
+class StateClient
+{
+public:
+    static const unsigned int KEPT = 8;             // completed snapshots kept, baselines and frames to interpolate
+    static constexpr double DELAY_SNAPSHOTS = 2.5;  // how far behind the newest snapshot playback runs
+    static constexpr double KEEPALIVE_SECONDS = 0.5;
+
+    StateClient() = default;
+    StateClient(const StateClient&) = delete;
+    StateClient& operator=(const StateClient&) = delete;
+
+    ~StateClient()
+    {
+        close();
+    }
+
+    // address is host:port or a host on STATE_STREAM_PORT
+    bool connect(const std::string& address)
+    {
+        close();
+        std::string host = address, port = std::to_string(STATE_STREAM_PORT);
+        const size_t colon = address.rfind(':');
+        if (colon != std::string::npos && address.find(':') == colon)
+        {
+            host = address.substr(0, colon);
+            port = address.substr(colon + 1);
+        }
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_DGRAM;
+        addrinfo* found = nullptr;
+        if (host.empty() || port.empty() || getaddrinfo(host.c_str(), port.c_str(), &hints, &found) != 0 || !found)
+        {
+            lastError = "cannot resolve " + address;
+            return false;
+        }
+        for (addrinfo* a = found; a && socketFd < 0; a = a->ai_next)
+        {
+            socketFd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+            if (socketFd >= 0 && ::connect(socketFd, a->ai_addr, a->ai_addrlen) != 0)
+            {
+                ::close(socketFd);
+                socketFd = -1;
+            }
+        }
+        freeaddrinfo(found);
+        if (socketFd < 0)
+        {
+            lastError = "cannot open a socket to " + address;
+            return false;
+        }
+        int bufferBytes = 8 << 20;
+        setsockopt(socketFd, SOL_SOCKET, SO_RCVBUF, &bufferBytes, sizeof(bufferBytes));
+        serverAddress = address;
+        sendControl(STATE_PACKET_HELLO);
+        return true;
+    }
+
+    void close()
+    {
+        if (socketFd >= 0)
+        {
+            sendControl(STATE_PACKET_BYE);
+            ::close(socketFd);
+        }
+        socketFd = -1;
+        layoutGeneration = 0;
+        pendingLayout = 0;
+        records.clear();
+        assembly.sequence = 0;
+        for (Frame& f : frames)
+            f.sequence = 0;
+        newest = 0;
+        clock = 0.0;
+        clockStarted = false;
+        sequenceA = sequenceB = 0;
+        a.clear();
+        b.clear();
+    }
+
+    bool connected() const { return socketFd >= 0; }
+    const std::string& error() const { return lastError; }
+    const std::string& address() const { return serverAddress; }
+
+    // reads every datagram waiting, true when a new body table arrived and the bodies must be laid out again
+    bool poll()
+    {
+        if (!connected())
+            return false;
+        const double now = seconds();
+        bool layoutChanged = false;
+        unsigned char buffer[2048];
+        for (;;)
+        {
+            const ssize_t bytes = recv(socketFd, buffer, sizeof(buffer), MSG_DONTWAIT);
+            if (bytes < 0)
+                break;
+            StatePacketHeader header;
+            if (!readStatePacketHeader(buffer, static_cast<size_t>(bytes), header))
+                continue;
+            receivedBytes += static_cast<size_t>(bytes);
+            if (header.type == STATE_PACKET_LAYOUT)
+                layoutChanged |= receiveLayout(header, buffer + sizeof(header), buffer + bytes);
+            else if (header.type == STATE_PACKET_SNAPSHOT)
+                receiveSnapshot(header, buffer + sizeof(header), buffer + bytes, now);
+        }
+        // the server forgets viewers it has not heard from; one restarted since takes the ack of an unknown table
+        // as a request for its own
+        if (now - lastSent > KEEPALIVE_SECONDS)
+            sendControl(layoutGeneration == 0 ? STATE_PACKET_HELLO : STATE_PACKET_ACK);
+        return layoutChanged;
+    }
+
+    // a table and a snapshot in it have arrived
+    bool ready() const { return layoutGeneration != 0 && newest != 0; }
+    size_t bodyCount() const { return records.size() / stateLayoutRecordBytes(); }
+    BodyType bodyType(size_t k) const { return static_cast<BodyType>(records[k * stateLayoutRecordBytes()]); }
+
+    // rebuilds a body store laid out like the server's table, positions at the newest snapshot
+    void initializeBodies(BodyStore& bodies, Mesh* sunMesh = nullptr, Model* planetModel = nullptr, Model* asteroidModel = nullptr)
+    {
+        const size_t n = bodyCount();
+        size_t counts[BODY_TYPE_COUNT] = {0, 0, 0};
+        std::vector<uint32_t> ids(n);
+        for (size_t k = 0; k < n; k++)
+        {
+            const unsigned char* record = records.data() + k * stateLayoutRecordBytes();
+            counts[std::min<unsigned int>(record[0], BODY_TYPE_COUNT - 1)]++;
+            std::memcpy(&ids[k], record + 1, sizeof(uint32_t));
+        }
+        bodies.assignLayout(counts, ids.data());
+        bodies.velocity.assign(n, glm::dvec3(0.0));
+        bodies.acceleration.assign(n, glm::vec3(0.0f));
+        bodies.mass.assign(n, 0.0f);
+        bodies.flags.assign(n, 0);
+        bodies.render.clear();
+        for (size_t k = 0; k < n; k++)
+        {
+            const unsigned char* record = records.data() + k * stateLayoutRecordBytes();
+            BodyRenderData r;
+            std::memcpy(&r.radiusScale, record + 1 + sizeof(uint32_t), sizeof(float));
+            std::memcpy(&r.orientation, record + 1 + sizeof(uint32_t) + sizeof(float), sizeof(glm::quat));
+            BodyType type = bodies.typeOf(k);
+            r.modelPtr = type == BODY_PLANET ? planetModel : type == BODY_ASTEROID ? asteroidModel : nullptr;
+            r.meshPtr = type == BODY_SUN ? sunMesh : nullptr;
+            if (type == BODY_ASTEROID)
+                r.spin = tumbleFor(ids[k]);
+            bodies.render.push_back(r);
+        }
+        sequenceA = sequenceB = 0;
+        bodies.position.assign(n, glm::dvec3(0.0));
+        if (ready())
+        {
+            seek(endTime());
+            bodies.position.assign(a.begin(), a.end());
+        }
+    }
+
+    // completed snapshots on hand, by sim time
+    double startTime() const
+    {
+        double t = endTime();
+        for (const Frame& f : frames)
+            if (f.sequence != 0)
+                t = std::min(t, f.simTime);
+        return t;
+    }
+    double endTime() const { return newest != 0 ? frame(newest)->simTime : 0.0; }
+
+    // the sim time to show after frameSeconds more of wall time: DELAY_SNAPSHOTS behind the newest, advanced at
+    // the rate sim time has been arriving and eased toward that target so arrival jitter neither stalls nor skips
+    double advance(double frameSeconds)
+    {
+        if (!ready())
+            return clock;
+        const double interval = snapshotInterval();
+        const double target = std::max(endTime() - DELAY_SNAPSHOTS * interval, startTime());
+        if (!clockStarted || std::abs(target - clock) > 8.0 * interval + 1e-9)
+            clock = target;
+        else
+        {
+            clock += frameSeconds * simRate();
+            clock += (target - clock) * std::min(1.0, 2.0 * frameSeconds);
+        }
+        clockStarted = true;
+        clock = std::clamp(clock, startTime(), endTime());
+        return clock;
+    }
+
+    // brings the completed snapshots around t into frameA/frameB
+    bool seek(double t)
+    {
+        const Frame* before = nullptr;
+        const Frame* after = nullptr;
+        for (const Frame& f : frames)
+        {
+            if (f.sequence == 0)
+                continue;
+            if (f.simTime <= t && (!before || f.simTime > before->simTime))
+                before = &f;
+            if (f.simTime > t && (!after || f.simTime < after->simTime))
+                after = &f;
+        }
+        if (!before)
+            before = after;
+        if (!after)
+            after = before;
+        if (!before)
+            return false;
+        if (before->sequence != sequenceA)
+            decode(*before, a);
+        if (after->sequence != sequenceB)
+            decode(*after, b);
+        sequenceA = before->sequence;
+        sequenceB = after->sequence;
+        timeA = before->simTime;
+        timeB = after->simTime;
+        return true;
+    }
+
+    // interpolation weight of frameB at t, valid after seek(t)
+    double blend(double t) const
+    {
+        return timeB > timeA ? std::clamp((t - timeA) / (timeB - timeA), 0.0, 1.0) : 0.0;
+    }
+
+    const std::vector<glm::dvec3>& frameA() const { return a; }
+    const std::vector<glm::dvec3>& frameB() const { return b; }
+
+    // sim seconds per wall second over the snapshots on hand, 1 until there are two
+    double simRate() const
+    {
+        const Frame* first = oldestFrame();
+        const Frame* last = frame(newest);
+        if (!first || !last || last->arrival <= first->arrival)
+            return 1.0;
+        return (last->simTime - first->simTime) / (last->arrival - first->arrival);
+    }
+
+    unsigned long long snapshotsCompleted() const { return completed; }
+    unsigned long long snapshotsAbandoned() const { return abandoned; }
+    unsigned long long bytesReceived() const { return receivedBytes; }
+
+private:
+    struct Frame
+    {
+        uint32_t sequence = 0;
+        double simTime = 0.0;
+        double arrival = 0.0;
+        std::vector<int32_t> values;
+    };
+
+    struct Assembly
+    {
+        uint32_t sequence = 0;
+        uint32_t baseline = 0;
+        double simTime = 0.0;
+        size_t slotsReceived = 0;
+        bool broken = false;
+        std::vector<int32_t> values;
+        std::vector<uint8_t> received;
+    };
+
+    int socketFd = -1;
+    std::string lastError;
+    std::string serverAddress;
+    double lastSent = 0.0;
+
+    uint32_t layoutGeneration = 0;      // of the table in records, 0 before one is complete
+    std::vector<unsigned char> records;
+    uint32_t pendingLayout = 0;         // the table being received
+    std::vector<unsigned char> pendingRecords;
+    std::vector<uint8_t> pendingReceived;
+    size_t pendingSlots = 0;
+
+    double quantum = 1.0 / 1024.0;
+    Assembly assembly;
+    Frame frames[KEPT];
+    uint32_t newest = 0;
+    unsigned long long completed = 0;
+    unsigned long long abandoned = 0;
+    unsigned long long receivedBytes = 0;
+
+    double clock = 0.0;
+    bool clockStarted = false;
+    std::vector<glm::dvec3> a, b;
+    uint32_t sequenceA = 0, sequenceB = 0;
+    double timeA = 0.0, timeB = 0.0;
+
+    static double seconds()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void sendControl(StatePacketType type)
+    {
+        StatePacketHeader header = statePacketHeader(type);
+        header.layout = layoutGeneration;
+        header.sequence = newest;
+        send(socketFd, &header, sizeof(header), 0);     // nobody listening yet is not an error
+        lastSent = seconds();
+    }
+
+    const Frame* frame(uint32_t s) const
+    {
+        const Frame& f = frames[s % KEPT];
+        return s != 0 && f.sequence == s ? &f : nullptr;
+    }
+
+    const Frame* oldestFrame() const
+    {
+        const Frame* oldest = nullptr;
+        for (const Frame& f : frames)
+            if (f.sequence != 0 && (!oldest || f.sequence < oldest->sequence))
+                oldest = &f;
+        return oldest;
+    }
+
+    double snapshotInterval() const
+    {
+        const Frame* first = oldestFrame();
+        const Frame* last = frame(newest);
+        if (!first || !last || last->sequence == first->sequence)
+            return 0.0;
+        return (last->simTime - first->simTime) / (last->sequence - first->sequence);
+    }
+
+    bool receiveLayout(const StatePacketHeader& header, const unsigned char* p, const unsigned char* end)
+    {
+        if (header.layout == layoutGeneration)
+        {
+            // our ack was lost, the table keeps coming until one arrives
+            if (seconds() - lastSent > 0.05)
+                sendControl(STATE_PACKET_ACK);
+            return false;
+        }
+        const size_t recordBytes = stateLayoutRecordBytes();
+        if (header.layout != pendingLayout)
+        {
+            pendingLayout = header.layout;
+            pendingRecords.assign(static_cast<size_t>(header.totalSlots) * recordBytes, 0);
+            pendingReceived.assign(header.totalSlots, 0);
+            pendingSlots = 0;
+        }
+        if (header.totalSlots != pendingReceived.size() || header.firstSlot > header.totalSlots ||
+            header.slotCount > header.totalSlots - header.firstSlot || static_cast<size_t>(end - p) < header.slotCount * recordBytes)
+            return false;
+        std::memcpy(pendingRecords.data() + header.firstSlot * recordBytes, p, header.slotCount * recordBytes);
+        for (uint32_t k = header.firstSlot; k < header.firstSlot + header.slotCount; k++)
+            if (!pendingReceived[k])
+            {
+                pendingReceived[k] = 1;
+                pendingSlots++;
+            }
+        if (pendingSlots < pendingReceived.size())
+            return false;
+
+        // complete: the old table's snapshots are no baselines for the new one
+        records.swap(pendingRecords);
+        layoutGeneration = pendingLayout;
+        quantum = header.quantum;
+        for (Frame& f : frames)
+            f.sequence = 0;
+        newest = 0;
+        assembly.sequence = 0;
+        clockStarted = false;
+        sequenceA = sequenceB = 0;
+        sendControl(STATE_PACKET_ACK);
+        return true;
+    }
+
+    void receiveSnapshot(const StatePacketHeader& header, const unsigned char* p, const unsigned char* end, double now)
+    {
+        const size_t slots = bodyCount();
+        if (header.layout != layoutGeneration || header.totalSlots != slots || header.sequence <= newest ||
+            header.firstSlot > slots || header.slotCount > slots - header.firstSlot)
+            return;
+        if (header.sequence != assembly.sequence)
+        {
+            if (header.sequence < assembly.sequence)
+                return;
+            if (assembly.sequence != 0)
+                abandoned++;
+            assembly.sequence = header.sequence;
+            assembly.baseline = header.baseline;
+            assembly.simTime = header.simTime;
+            assembly.slotsReceived = 0;
+            assembly.broken = header.baseline != 0 && !frame(header.baseline);
+            assembly.values.resize(slots * 3);
+            assembly.received.assign(slots, 0);
+        }
+        if (assembly.broken)
+            return;
+        const Frame* baseline = frame(assembly.baseline);
+        for (uint32_t k = header.firstSlot; k < header.firstSlot + header.slotCount; k++)
+            for (int c = 0; c < 3; c++)
+            {
+                uint64_t v;
+                if (!getVarint(p, end, v))
+                {
+                    assembly.broken = true;
+                    return;
+                }
+                const int64_t value = unzigzag(v) + (baseline ? baseline->values[k * 3 + c] : 0);
+                assembly.values[k * 3 + c] = static_cast<int32_t>(value);
+            }
+        for (uint32_t k = header.firstSlot; k < header.firstSlot + header.slotCount; k++)
+            if (!assembly.received[k])
+            {
+                assembly.received[k] = 1;
+                assembly.slotsReceived++;
+            }
+        if (assembly.slotsReceived < slots)
+            return;
+
+        Frame& f = frames[assembly.sequence % KEPT];
+        f.sequence = assembly.sequence;
+        f.simTime = assembly.simTime;
+        f.arrival = now;
+        f.values.swap(assembly.values);
+        newest = assembly.sequence;
+        assembly.sequence = 0;
+        completed++;
+        sendControl(STATE_PACKET_ACK);
+    }
+
+    void decode(const Frame& f, std::vector<glm::dvec3>& positions) const
+    {
+        const size_t n = f.values.size() / 3;
+        positions.resize(n);
+        for (size_t k = 0; k < n; k++)
+            positions[k] = glm::dvec3(f.values[k * 3], f.values[k * 3 + 1], f.values[k * 3 + 2]) * quantum;
+    }
+};
+
+#endif
@@ -0,0 +1,225 @@
+#ifndef STD140_H
+#define STD140_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstddef>
+#include <iostream>
+
+// Uniform block mirrors laid out by the std140 rules at compile time. A mirror is declared with STD140_STRUCT from
+// the list of its members, M(type, name) each:
+//     #define SPOT_LIGHT_MEMBERS(M) M(float, cutOff) M(glm::vec3, ambient)
+//     STD140_STRUCT(SpotLight, SPOT_LIGHT_MEMBERS);
+// Every member gets the alignment std140 gives its type, so a float may sit in the last 4 bytes of a vec3 and no
+// padding is written by hand, the struct is rounded to 16 bytes as std140 rounds a struct and an array element, and
+// a static_assert compares each member's offsetof and the size with what the rules compute from the list. Members
+// are float, int, unsigned int, their glm vectors, glm::mat4, other mirrors and Std140Array of mirrors or vec4s
+// (an array of scalars has a 16-byte stride in std140, no C++ array matches it). checkUniformBlock compares the
+// same offsets with the ones the linker gave a program's block.
+
+// what std140 does with a member type, a mirror by default
+template <typename T>
+struct Std140Rules
+{
+    static constexpr size_t align = 16;
+    static constexpr size_t size = T::std140Size();
+    static constexpr bool leaf = false;
+};
+
+#define STD140_BASIC(type, alignment, bytes) \
+    template <> struct Std140Rules<type> { static constexpr size_t align = alignment, size = bytes; static constexpr bool leaf = true; }
+STD140_BASIC(float, 4, 4);
+STD140_BASIC(int, 4, 4);
+STD140_BASIC(unsigned int, 4, 4);
+STD140_BASIC(glm::vec2, 8, 8);
+STD140_BASIC(glm::ivec2, 8, 8);
+STD140_BASIC(glm::uvec2, 8, 8);
+STD140_BASIC(glm::vec3, 16, 12);
+STD140_BASIC(glm::ivec3, 16, 12);
+STD140_BASIC(glm::uvec3, 16, 12);
+STD140_BASIC(glm::vec4, 16, 16);
+STD140_BASIC(glm::ivec4, 16, 16);
+STD140_BASIC(glm::uvec4, 16, 16);
+STD140_BASIC(glm::mat4, 16, 64);
+#undef STD140_BASIC
+
+template <typename T, size_t N>
+struct Std140Array
+{
+    static_assert(Std140Rules<T>::size % 16 == 0, "a std140 array of mirrors or vec4s, whose stride is their size");
+    T items[N];
+
+    T& operator[](size_t i) { return items[i]; }
+    const T& operator[](size_t i) const { return items[i]; }
+};
+
+template <typename T, size_t N>
+struct Std140Rules<Std140Array<T, N>>
+{
+    static constexpr size_t align = 16;
+    static constexpr size_t size = N * Std140Rules<T>::size;
+    static constexpr bool leaf = false;
+};
+
+struct Std140Member
+{
+    size_t align;
+    size_t size;
+};
+
+namespace std140 {
+
+constexpr size_t roundUp(size_t bytes, size_t to) { return (bytes + to - 1) / to * to; }
+
+// offset of member k of a struct of count members
+constexpr size_t offset(const Std140Member* members, size_t k)
+{
+    size_t at = 0;
+    for (size_t m = 0; m < k; m++)
+        at = roundUp(at, members[m].align) + members[m].size;
+    return roundUp(at, members[k].align);
+}
+
+constexpr size_t structSize(const Std140Member* members, size_t count)
+{
+    return roundUp(count > 0 ? offset(members, count - 1) + members[count - 1].size : 0, 16);
+}
+
+template <typename T>
+struct ArrayOf
+{
+    static constexpr bool array = false;
+};
+
+template <typename T, size_t N>
+struct ArrayOf<Std140Array<T, N>>
+{
+    static constexpr bool array = true;
+    static constexpr size_t count = N;
+    typedef T Element;
+};
+
+// fn(name, offset) for every basic member under a member of type T named name at offset; an array of basic types
+// as its first element only, as program introspection lists it
+template <typename T, typename Fn>
+void visit(Fn& fn, const std::string& name, size_t at)
+{
+    if constexpr (Std140Rules<T>::leaf)
+    {
+        fn(name, at);
+    }
+    else if constexpr (ArrayOf<T>::array)
+    {
+        typedef typename ArrayOf<T>::Element Element;
+        const size_t elements = Std140Rules<Element>::leaf ? 1 : ArrayOf<T>::count;
+        for (size_t i = 0; i < elements; i++)
+            visit<Element>(fn, name + '[' + std::to_string(i) + ']', at + i * Std140Rules<Element>::size);
+    }
+    else
+    {
+        T::visitMembers(fn, name + '.', at);
+    }
+}
+
+} // namespace std140
+
+#define STD140_DECLARE(type, name) alignas(Std140Rules<type>::align) type name;
+#define STD140_RULES(type, name) Std140Member{Std140Rules<type>::align, Std140Rules<type>::size},
+#define STD140_OFFSET(type, name) offsetof(Self, name),
+#define STD140_VISIT(type, name) std140::visit<type>(fn, prefix + #name, base + offsetof(Self, name));
+
+#define STD140_STRUCT(Name, MEMBERS) \
+    struct alignas(16) Name \
+    { \
+        MEMBERS(STD140_DECLARE) \
+        static constexpr size_t std140Size() \
+        { \
+            const Std140Member members[] = { MEMBERS(STD140_RULES) }; \
+            return std140::structSize(members, sizeof(members) / sizeof(members[0])); \
+        } \
+        static constexpr bool std140Laid() \
+        { \
+            typedef Name Self; \
+            const Std140Member members[] = { MEMBERS(STD140_RULES) }; \
+            const size_t offsets[] = { MEMBERS(STD140_OFFSET) }; \
+            for (size_t m = 0; m < sizeof(offsets) / sizeof(offsets[0]); m++) \
+                if (offsets[m] != std140::offset(members, m)) \
+                    return false; \
+            return sizeof(Name) == std140Size(); \
+        } \
+        template <typename Fn> \
+        static void visitMembers(Fn& fn, const std::string& prefix, size_t base) \
+        { \
+            typedef Name Self; \
+            MEMBERS(STD140_VISIT) \
+        } \
+    }; \
+    static_assert(Name::std140Laid(), #Name " is not laid out the way std140 lays out its members")
+
+// Compares mirror T with program's uniform block of that name, its members named as the block declares them
+// (a block without an instance name): every basic member at the same offset on both sides and none on only one.
+// Prints what disagrees and returns false then; true as well when the program has no such block.
+template <typename T>
+inline bool checkUniformBlock(GLuint program, const char* block)
+{
+    const GLuint index = glGetProgramResourceIndex(program, GL_UNIFORM_BLOCK, block);
+    if (index == GL_INVALID_INDEX)
+        return true;
+    std::unordered_map<std::string, size_t> mirrored;
+    auto collect = [&mirrored](const std::string& name, size_t at) { mirrored.emplace(name, at); };
+    T::visitMembers(collect, std::string(), 0);
+
+    bool agree = true;
+    GLint linked[2] = {0, 0};
+    const GLenum blockProperties[2] = {GL_BUFFER_DATA_SIZE, GL_NUM_ACTIVE_VARIABLES};
+    glGetProgramResourceiv(program, GL_UNIFORM_BLOCK, index, 2, blockProperties, 2, nullptr, linked);
+    if (static_cast<size_t>(linked[0]) > sizeof(T))
+    {
+        std::cout << block << ": the program's block takes " << linked[0] << " bytes, the mirror " << sizeof(T) << std::endl;
+        agree = false;
+    }
+    std::vector<GLint> variables(static_cast<size_t>(linked[1]));
+    const GLenum activeVariables = GL_ACTIVE_VARIABLES;
+    if (!variables.empty())
+        glGetProgramResourceiv(program, GL_UNIFORM_BLOCK, index, 1, &activeVariables, linked[1], nullptr, variables.data());
+    size_t matched = 0;
+    for (GLint variable : variables)
+    {
+        char name[256];
+        glGetProgramResourceName(program, GL_UNIFORM, static_cast<GLuint>(variable), sizeof(name), nullptr, name);
+        GLint at = 0;
+        const GLenum offsetProperty = GL_OFFSET;
+        glGetProgramResourceiv(program, GL_UNIFORM, static_cast<GLuint>(variable), 1, &offsetProperty, 1, nullptr, &at);
+        auto found = mirrored.find(name);
+        if (found == mirrored.end())
+        {
+            std::cout << block << ": " << name << " at " << at << " has no member in the mirror" << std::endl;
+            agree = false;
+        }
+        else if (found->second != static_cast<size_t>(at))
+        {
+            std::cout << block << ": " << name << " is at " << at << ", the mirror has it at " << found->second << std::endl;
+            agree = false;
+        }
+        else
+        {
+            matched++;
+        }
+    }
+    if (matched < mirrored.size())
+    {
+        for (const auto& member : mirrored)
+        {
+            if (glGetProgramResourceIndex(program, GL_UNIFORM, member.first.c_str()) == GL_INVALID_INDEX)
+                std::cout << block << ": the mirror's " << member.first << " is not in the program's block" << std::endl;
+        }
+        agree = false;
+    }
+    return agree;
+}
+
+#endif
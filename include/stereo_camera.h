@@ -0,0 +1,71 @@
+#ifndef STEREO_CAMERA_H
+#define STEREO_CAMERA_H
+
+#include <glm.hpp>
+#include <gtc/matrix_transform.hpp>
+
+#include <depth_convention.h>
+
+#include <algorithm>
+#include <cmath>
+
+// Two eyes either side of the camera along its right axis, looking the same way, with off-axis frusta that meet at
+// the convergence distance, where a point has no parallax; nearer points stand out of the screen, farther ones
+// sink into it. The frame is side by side, the left eye in the left half of the scene target. Besides the eyes'
+// matrices, frame() gives:
+//   the centre camera   a symmetric frustum of one eye's aspect from between the eyes, which the lighting, the
+//                       light clusters and the levels of detail use for both eyes
+//   the cull camera     one frustum holding both eyes': their outer planes, met behind the camera, and the
+//                       eyes' top and bottom, so one cull pass serves both
+// Matrices are camera-relative like the mono ones, the view a rotation with the eyes' offsets in front of it. The
+// centre and eye projections follow depthConvention(); the cull camera keeps its far plane.
+class StereoCamera
+{
+public:
+    bool enabled = false;
+    float separation = 0.5f;        // between the eyes, in world units
+    float convergence = 150.0f;     // distance of the zero-parallax plane
+
+    struct Frame
+    {
+        glm::mat4 centreView;
+        glm::mat4 centreProjection;
+        glm::mat4 eyeProjection[2];     // 0 the left eye
+        glm::mat4 eyeView[2];
+        glm::mat4 cullProjection;
+        glm::mat4 cullView;
+    };
+
+    // x of an eye in the camera's frame, the left one negative
+    float eyeOffset(unsigned int eye) const { return (eye == 0 ? -0.5f : 0.5f) * separation; }
+
+    // the matrices of a frame seen with view (camera-relative) and a vertical field of view fovy, for eyes of
+    // aspect width over height each
+    Frame frame(const glm::mat4& view, float fovy, float aspect, float nearPlane, float farPlane) const
+    {
+        Frame f;
+        f.centreView = view;
+        const float top = nearPlane * std::tan(0.5f * fovy);
+        const float halfWidth = top * aspect;
+        const float distance = std::max(convergence, nearPlane);
+        f.centreProjection = depthConvention().frustum(-halfWidth, halfWidth, -top, top, nearPlane, farPlane);
+        for (unsigned int eye = 0; eye < 2; eye++)
+        {
+            // the eye's window slid toward the centre so both windows coincide at the convergence distance
+            const float shift = -eyeOffset(eye) * nearPlane / distance;
+            f.eyeProjection[eye] = depthConvention().frustum(-halfWidth + shift, halfWidth + shift, -top, top, nearPlane, farPlane);
+            f.eyeView[eye] = glm::translate(glm::mat4(1.0f), glm::vec3(-eyeOffset(eye), 0.0f, 0.0f)) * view;
+        }
+        // the outer planes' slope, they cross behind the camera at pullback; top and bottom keep their slope from
+        // there, which only widens them
+        const float outer = std::max(halfWidth / nearPlane - 0.5f * separation / distance, 1e-3f);
+        const float pullback = 0.5f * separation / outer;
+        const float cullNear = nearPlane + pullback;
+        f.cullProjection = glm::frustum(-outer * cullNear, outer * cullNear, -top / nearPlane * cullNear, top / nearPlane * cullNear,
+                                        cullNear, farPlane + pullback);
+        f.cullView = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -pullback)) * view;
+        return f;
+    }
+};
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef STREAMING_BUFFER_H
+#define STREAMING_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <gl_state_cache.h>
+#include <gl_debug.h>
+#include <gpu_memory.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// Persistently mapped ring of equally sized segments for data the CPU rewrites every frame (GL 4.4 buffer storage).
+// The CPU writes into one segment while the GPU may still be reading the others, a fence per segment makes
+// beginWrite wait only if the GPU is a full ring behind. Draws select the segment through baseInstance.
+class StreamingBuffer
+{
+public:
+    static const unsigned int SEGMENTS = 3;
+
+    explicit StreamingBuffer(GpuMemoryCategory category = GPU_MEMORY_INSTANCES) : storage(category) {}
+    StreamingBuffer(const StreamingBuffer&) = delete;
+    StreamingBuffer& operator=(const StreamingBuffer&) = delete;
+
+    ~StreamingBuffer()
+    {
+        release();
+    }
+
+    // allocates SEGMENTS * segmentBytes of immutable storage and maps it for the buffer's lifetime, named label in
+    // frame captures
+    void create(size_t segmentBytes, const char* label = "streaming buffer")
+    {
+        release();
+        this->segmentBytes = segmentBytes;
+        if (segmentBytes == 0)
+            return;
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        storage.create(GL_ARRAY_BUFFER, label);
+        storage.storage(SEGMENTS * segmentBytes, nullptr, flags);
+        mapped = static_cast<uint8_t*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, SEGMENTS * segmentBytes, flags));
+        glState().bindBuffer(GL_ARRAY_BUFFER, 0);
+        head = 0;
+        written = false;
+    }
+
+    // moves to the next segment and returns its mapped memory, waiting for the GPU to finish reading it
+    void* beginWrite()
+    {
+        if (!mapped)
+            return nullptr;
+        head = (head + 1) % SEGMENTS;
+        waitFor(head);
+        written = true;
+        return mapped + head * segmentBytes;
+    }
+
+    // fences the segment the last draws read from, call once after those draws were issued
+    void fenceRead()
+    {
+        if (!written)
+            return;
+        if (fences[head]) glDeleteSync(fences[head]);
+        fences[head] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    // most recently written segment, the one to draw from
+    unsigned int readSegment() const { return head; }
+    size_t readOffset() const { return head * segmentBytes; }
+    size_t capacityBytes() const { return SEGMENTS * segmentBytes; }
+
+    unsigned int buffer() const { return storage.id(); }
+    bool valid() const { return mapped != nullptr; }
+
+    void release()
+    {
+        for (unsigned int s = 0; s < SEGMENTS; s++)
+        {
+            if (fences[s]) glDeleteSync(fences[s]);
+            fences[s] = nullptr;
+        }
+        if (storage.valid())
+        {
+            glState().bindBuffer(GL_ARRAY_BUFFER, storage.id());
+            if (mapped) glUnmapBuffer(GL_ARRAY_BUFFER);
+            glState().bindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+        storage.release();
+        mapped = nullptr;
+        written = false;
+    }
+
+private:
+    GlBuffer storage;
+    uint8_t* mapped = nullptr;
+    size_t segmentBytes = 0;
+    unsigned int head = 0;
+    bool written = false;
+    GLsync fences[SEGMENTS] = {nullptr, nullptr, nullptr};
+
+    void waitFor(unsigned int segment)
+    {
+        if (!fences[segment])
+            return;
+        // flush on the first wait in case the fence has not been submitted yet
+        GLbitfield waitFlags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        for (;;)
+        {
+            GLenum result = glClientWaitSync(fences[segment], waitFlags, 1000000);
+            if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED)
+                break;
+            waitFlags = 0;
+        }
+        glDeleteSync(fences[segment]);
+        fences[segment] = nullptr;
+    }
+};
+
+#endif
@@ -0,0 +1,243 @@
+#ifndef TASK_GRAPH_H
+#define TASK_GRAPH_H
+
+#include <frame_arena.h>
+#include <profiler.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <initializer_list>
+#include <type_traits>
+#include <utility>
+#include <new>
+#include <chrono>
+#include <vector>
+#include <deque>
+#include <algorithm>
+
+// Per-frame job graph. Tasks are added with the ids of the tasks they depend on, then run() executes the whole
+// graph with the calling thread plus a few persistent helpers, starting each task as soon as its dependencies are
+// done. MAIN_THREAD tasks only ever run on the caller, which is where anything touching the GL context belongs.
+// The graph is rebuilt (clear + add) every frame and keeps the timings of the last run for a schedule view, with when
+// each task became ready and the deepest the ready queues got, the latency a busy caller or helper adds. The task
+// callables live in the graph's own arena and the task records are reused, so rebuilding does not allocate.
+// Tasks that split their work with workerPool() must be ordered by dependencies, the pool takes one loop at a time.
+class TaskGraph
+{
+public:
+    typedef unsigned int TaskId;
+
+    enum Affinity {
+        ANY_THREAD = 0,
+        MAIN_THREAD = 1
+    };
+
+    // times are in milliseconds from the start of run(), thread 0 is the caller
+    struct TaskTiming
+    {
+        const char* name;
+        float startMs;
+        float endMs;
+        unsigned int thread;
+        float readyMs;      // its dependencies were done, startMs - readyMs is what it waited for a thread
+    };
+
+    explicit TaskGraph(unsigned int helperThreads = 1)
+    {
+        for (unsigned int i = 1; i <= helperThreads; i++)
+            workers.emplace_back([this, i]() { workerLoop(i); });
+    }
+
+    ~TaskGraph()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& t : workers)
+            t.join();
+        clear();
+    }
+
+    TaskGraph(const TaskGraph&) = delete;
+    TaskGraph& operator=(const TaskGraph&) = delete;
+
+    // participants including the caller
+    unsigned int threadCount() const { return static_cast<unsigned int>(workers.size()) + 1; }
+
+    void clear()
+    {
+        for (size_t i = 0; i < taskCount; i++)
+            if (tasks[i].destroy) tasks[i].destroy(tasks[i].callable);
+        taskCount = 0;
+        callables.reset();
+    }
+
+    // dependencies must already have been added, which keeps the graph acyclic by construction
+    template <typename Fn>
+    TaskId add(const char* name, Fn&& fn, std::initializer_list<TaskId> dependencies = {}, Affinity affinity = ANY_THREAD)
+    {
+        typedef typename std::decay<Fn>::type Callable;
+        void* storage = callables.allocate(sizeof(Callable), alignof(Callable));
+        TaskId id = static_cast<TaskId>(taskCount);
+        if (taskCount == tasks.size())
+            tasks.emplace_back();
+        Task& task = tasks[taskCount++];
+        task.name = name;
+        task.callable = new (storage) Callable(std::forward<Fn>(fn));
+        task.invoke = &invokeTask<Callable>;
+        task.destroy = std::is_trivially_destructible<Callable>::value ? nullptr : &destroyTask<Callable>;
+        task.affinity = affinity;
+        task.dependencyCount = static_cast<unsigned int>(dependencies.size());
+        task.dependents.clear();
+        for (TaskId d : dependencies)
+            tasks[d].dependents.push_back(id);
+        return id;
+    }
+
+    // runs every task once and returns when all have finished
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        start = std::chrono::steady_clock::now();
+        remaining = taskCount;
+        lastTimings.assign(taskCount, TaskTiming{nullptr, 0.0f, 0.0f, 0, 0.0f});
+        readyAny.clear();
+        readyMain.clear();
+        peakReady = 0;
+        for (TaskId id = 0; id < taskCount; id++)
+        {
+            tasks[id].pending = tasks[id].dependencyCount;
+            if (tasks[id].pending == 0)
+                pushReady(id);
+        }
+        running = true;
+        wake.notify_all();
+
+        // the caller prefers its own tasks, and otherwise helps with the shared queue instead of idling
+        while (remaining > 0)
+        {
+            if (!readyMain.empty())
+            {
+                TaskId id = readyMain.front();
+                readyMain.pop_front();
+                execute(id, 0, lock);
+            }
+            else if (!readyAny.empty())
+            {
+                TaskId id = readyAny.front();
+                readyAny.pop_front();
+                execute(id, 0, lock);
+            }
+            else
+            {
+                progress.wait(lock);
+            }
+        }
+        running = false;
+    }
+
+    const std::vector<TaskTiming>& timings() const { return lastTimings; }
+
+    // the most tasks ready at once in the last run, on both queues
+    size_t peakReadyTasks() const { return peakReady; }
+
+private:
+    struct Task
+    {
+        const char* name = nullptr;
+        void* callable = nullptr;
+        void (*invoke)(void*) = nullptr;
+        void (*destroy)(void*) = nullptr;
+        Affinity affinity = ANY_THREAD;
+        unsigned int dependencyCount = 0;
+        unsigned int pending = 0;
+        std::vector<TaskId> dependents;
+    };
+
+    std::vector<Task> tasks;            // the first taskCount are the current graph, the rest are kept for reuse
+    size_t taskCount = 0;
+    FrameArena callables;
+    std::vector<TaskTiming> lastTimings;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;       // helpers wait for shared work
+    std::condition_variable progress;   // the caller waits for its own work or the end of the run
+    std::deque<TaskId> readyAny;
+    std::deque<TaskId> readyMain;
+    size_t remaining = 0;
+    size_t peakReady = 0;
+    bool running = false;
+    bool stopping = false;
+    std::chrono::steady_clock::time_point start;
+
+    // called with the mutex held
+    void pushReady(TaskId id)
+    {
+        lastTimings[id].readyMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (tasks[id].affinity == MAIN_THREAD)
+        {
+            readyMain.push_back(id);
+        }
+        else
+        {
+            readyAny.push_back(id);
+            wake.notify_one();
+        }
+        peakReady = std::max(peakReady, readyAny.size() + readyMain.size());
+        progress.notify_one();
+    }
+
+    // runs one task with the mutex released, then releases its dependents
+    void execute(TaskId id, unsigned int thread, std::unique_lock<std::mutex>& lock)
+    {
+        Task& task = tasks[id];
+        lock.unlock();
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        {
+            PROFILE_SCOPE(task.name);
+            task.invoke(task.callable);
+        }
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        lock.lock();
+
+        lastTimings[id] = TaskTiming{task.name, std::chrono::duration<float, std::milli>(begin - start).count(),
+                                     std::chrono::duration<float, std::milli>(end - start).count(), thread, lastTimings[id].readyMs};
+        for (TaskId d : task.dependents)
+            if (--tasks[d].pending == 0)
+                pushReady(d);
+        if (--remaining == 0)
+            progress.notify_all();
+    }
+
+    template <typename Callable>
+    static void invokeTask(void* callable)
+    {
+        (*static_cast<Callable*>(callable))();
+    }
+
+    template <typename Callable>
+    static void destroyTask(void* callable)
+    {
+        static_cast<Callable*>(callable)->~Callable();
+    }
+
+    void workerLoop(unsigned int index)
+    {
+        profiler().nameThread("frame graph helper");
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;)
+        {
+            wake.wait(lock, [this]() { return stopping || (running && !readyAny.empty()); });
+            if (stopping)
+                return;
+            TaskId id = readyAny.front();
+            readyAny.pop_front();
+            execute(id, index, lock);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,287 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <alloc_tracker.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// one frame's numbers for monitoring
+struct TelemetrySample
+{
+    double time = 0.0;                  // seconds since the viewer started
+    unsigned long long frame = 0;
+    float frameMs = 0.0f;               // wall time of the frame
+    float cpuFrameMs = 0.0f;
+    float gpuFrameMs = 0.0f;            // GpuTimers' latest, a few frames old
+    float physicsMs = 0.0f;
+    unsigned int bodies = 0;
+    long long visibleInstances = -1;    // asteroids packed for drawing, -1 when they are culled on the GPU
+    unsigned int drawCalls = 0;         // the render queue's draws
+    unsigned long long gpuMemoryBytes = 0;      // what the engine allocated: textures, geometry, instance streams
+    long long driverFreeMemoryKB = -1;  // the driver's free video memory where it tells, otherwise -1
+    unsigned long long uploadBytes = 0; // instance and texture data sent this frame
+    unsigned long long heapAllocations = 0;     // operator new and ImGui's allocations in the last frame
+    // with allocation tracking, the last frame's bytes and peak live bytes over every subsystem and the allocations
+    // of each, otherwise -1
+    long long heapBytes = -1;
+    long long heapPeakBytes = -1;
+    long long heapTagAllocations[ALLOC_TAGS] = {-1, -1, -1, -1, -1, -1};
+};
+
+// Samples written off the render thread at a fixed rate. The frame calls due() and, when it is, submit(); the
+// writer thread formats what was submitted as CSV (a path ending in .csv) or JSON lines (anything else) into a
+// file rotated by size, path -> path.1 -> ... -> path.keepFiles, and sends each as a JSON line in one UDP
+// datagram to "host:port". A writer that falls behind drops samples instead of holding the frame up.
+class Telemetry
+{
+public:
+    struct Options
+    {
+        std::string path;                   // empty for no file
+        std::string udp;                    // host:port, empty for none
+        double rate = 1.0;                  // samples per second, 0 for every frame
+        size_t maxFileBytes = 16u << 20;
+        unsigned int keepFiles = 4;
+    };
+
+    static const size_t MAX_PENDING = 1024;
+
+    ~Telemetry()
+    {
+        stop();
+    }
+
+    bool running() const { return worker.joinable(); }
+    unsigned long long written() const { return writtenCount.load(std::memory_order_relaxed); }
+    unsigned long long dropped() const { return droppedCount.load(std::memory_order_relaxed); }
+
+    // false, with the reason in error(), when a sink cannot be opened
+    bool start(const Options& o)
+    {
+        stop();
+        options = o;
+        csv = options.path.size() >= 4 && options.path.compare(options.path.size() - 4, 4, ".csv") == 0;
+        if (!options.path.empty() && !openFile())
+        {
+            lastError = "cannot open " + options.path;
+            return false;
+        }
+        if (!options.udp.empty() && !openSocket())
+        {
+            closeSinks();
+            return false;
+        }
+        if (!file && socketFd < 0)
+        {
+            lastError = "no telemetry file or address";
+            return false;
+        }
+        nextDue = 0.0;
+        quit = false;
+        worker = std::thread([this]() { run(); });
+        return true;
+    }
+
+    void stop()
+    {
+        if (!worker.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        wake.notify_one();
+        worker.join();
+        closeSinks();
+    }
+
+    const std::string& error() const { return lastError; }
+
+    // whether a sample is wanted at now, in the same clock as TelemetrySample::time
+    bool due(double now) const { return running() && now >= nextDue; }
+
+    void submit(const TelemetrySample& sample)
+    {
+        nextDue = options.rate > 0.0 ? std::max(nextDue + 1.0 / options.rate, sample.time) : sample.time;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (pending.size() >= MAX_PENDING)
+            {
+                droppedCount.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            pending.push_back(sample);
+        }
+        wake.notify_one();
+    }
+
+private:
+    Options options;
+    bool csv = false;
+    std::FILE* file = nullptr;
+    size_t fileBytes = 0;
+    int socketFd = -1;
+    std::string lastError;
+    double nextDue = 0.0;       // the render thread's alone
+
+    std::thread worker;
+    std::mutex mutex;           // guards pending and quit
+    std::condition_variable wake;
+    std::vector<TelemetrySample> pending;
+    bool quit = false;
+    std::atomic<unsigned long long> writtenCount{0};
+    std::atomic<unsigned long long> droppedCount{0};
+
+    void run()
+    {
+        std::vector<TelemetrySample> batch;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this]() { return quit || !pending.empty(); });
+                if (pending.empty() && quit)
+                    return;
+                batch.swap(pending);
+            }
+            for (const TelemetrySample& sample : batch)
+                write(sample);
+            if (file)
+                std::fflush(file);
+            batch.clear();
+        }
+    }
+
+    void write(const TelemetrySample& s)
+    {
+        char line[1024];
+        if (file)
+        {
+            const int length = csv ? format(line, sizeof(line), s, "%.3f,%llu,%.3f,%.3f,%.3f,%.3f,%u,%lld,%u,%llu,%lld,%llu,%llu,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld\n")
+                                   : json(line, sizeof(line), s);
+            if (length > 0)
+            {
+                if (fileBytes + length > options.maxFileBytes && fileBytes > 0)
+                    rotate();
+                if (file)
+                {
+                    std::fwrite(line, 1, static_cast<size_t>(length), file);
+                    fileBytes += static_cast<size_t>(length);
+                }
+            }
+        }
+        if (socketFd >= 0)
+        {
+            const int length = json(line, sizeof(line), s);
+            if (length > 0)
+                send(socketFd, line, static_cast<size_t>(length), 0);   // nobody listening is not an error
+        }
+        writtenCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static int format(char* out, size_t size, const TelemetrySample& s, const char* pattern)
+    {
+        const int length = std::snprintf(out, size, pattern, s.time, s.frame, s.frameMs, s.cpuFrameMs, s.gpuFrameMs, s.physicsMs,
+                                         s.bodies, s.visibleInstances, s.drawCalls, s.gpuMemoryBytes, s.driverFreeMemoryKB, s.uploadBytes,
+                                         s.heapAllocations, s.heapBytes, s.heapPeakBytes, s.heapTagAllocations[ALLOC_OTHER],
+                                         s.heapTagAllocations[ALLOC_MODEL_IMPORT], s.heapTagAllocations[ALLOC_RENDERING],
+                                         s.heapTagAllocations[ALLOC_UI], s.heapTagAllocations[ALLOC_PHYSICS],
+                                         s.heapTagAllocations[ALLOC_STREAMING]);
+        return length < static_cast<int>(size) ? length : -1;
+    }
+
+    static int json(char* out, size_t size, const TelemetrySample& s)
+    {
+        return format(out, size, s,
+                      "{\"time\":%.3f,\"frame\":%llu,\"frameMs\":%.3f,\"cpuFrameMs\":%.3f,\"gpuFrameMs\":%.3f,\"physicsMs\":%.3f,"
+                      "\"bodies\":%u,\"visibleInstances\":%lld,\"drawCalls\":%u,\"gpuMemoryBytes\":%llu,\"driverFreeMemoryKB\":%lld,"
+                      "\"uploadBytes\":%llu,\"heapAllocations\":%llu,\"heapBytes\":%lld,\"heapPeakBytes\":%lld,"
+                      "\"heapByTag\":{\"other\":%lld,\"modelImport\":%lld,\"rendering\":%lld,\"ui\":%lld,\"physics\":%lld,"
+                      "\"streaming\":%lld}}\n");
+    }
+
+    bool openFile()
+    {
+        file = std::fopen(options.path.c_str(), "w");
+        fileBytes = 0;
+        if (!file)
+            return false;
+        if (csv)
+        {
+            const char* header = "time,frame,frameMs,cpuFrameMs,gpuFrameMs,physicsMs,bodies,visibleInstances,drawCalls,gpuMemoryBytes,"
+                                 "driverFreeMemoryKB,uploadBytes,heapAllocations,heapBytes,heapPeakBytes,heapOther,heapModelImport,"
+                                 "heapRendering,heapUi,heapPhysics,heapStreaming\n";
+            fileBytes = std::fputs(header, file) >= 0 ? std::char_traits<char>::length(header) : 0;
+        }
+        return true;
+    }
+
+    // the full file becomes path.1, the oldest of the kept ones goes
+    void rotate()
+    {
+        std::fclose(file);
+        file = nullptr;
+        for (unsigned int k = options.keepFiles; k > 1; k--)
+            std::rename((options.path + "." + std::to_string(k - 1)).c_str(), (options.path + "." + std::to_string(k)).c_str());
+        if (options.keepFiles > 0)
+            std::rename(options.path.c_str(), (options.path + ".1").c_str());
+        openFile();
+    }
+
+    bool openSocket()
+    {
+        const size_t colon = options.udp.rfind(':');
+        if (colon == std::string::npos || colon == 0 || colon + 1 == options.udp.size())
+        {
+            lastError = "telemetry address " + options.udp + " is not host:port";
+            return false;
+        }
+        const std::string host = options.udp.substr(0, colon), port = options.udp.substr(colon + 1);
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_DGRAM;
+        addrinfo* found = nullptr;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &found) != 0 || !found)
+        {
+            lastError = "cannot resolve " + options.udp;
+            return false;
+        }
+        for (addrinfo* a = found; a && socketFd < 0; a = a->ai_next)
+        {
+            socketFd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+            if (socketFd >= 0 && connect(socketFd, a->ai_addr, a->ai_addrlen) != 0)
+            {
+                close(socketFd);
+                socketFd = -1;
+            }
+        }
+        freeaddrinfo(found);
+        if (socketFd < 0)
+            lastError = "cannot open a socket to " + options.udp;
+        return socketFd >= 0;
+    }
+
+    void closeSinks()
+    {
+        if (file)
+            std::fclose(file);
+        file = nullptr;
+        if (socketFd >= 0)
+            close(socketFd);
+        socketFd = -1;
+    }
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef TESSELLATED_SPHERE_H
+#define TESSELLATED_SPHERE_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <shader.h>
+#include <mesh.h>
+#include <sphere.h>
+#include <gl_state_cache.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cmath>
+
+// Spheres whose triangles follow their size on screen, made by the tessellation stages instead of picked from a
+// fixed mesh's levels. The patches are a twice-subdivided icosphere's 320 triangles (the shared one of
+// sphereCache()); shaders.2/sphere.tess.tcs splits every edge into segments about pixelsPerEdge pixels long on
+// screen and drops the patches behind the sphere's horizon, sphere.tess.tes puts the points on the sphere and, with
+// DISPLACEMENT, out by the planet terrain's height cube (planet_terrain.h). A sun filling the view then gets
+// triangles of a few pixels with no facets on its silhouette, one a few pixels across a patch or two. The levels
+// stop at GL_MAX_TESS_GEN_LEVEL (64 at least), 1.3 million triangles over the whole sphere.
+class TessellatedSphere
+{
+public:
+    static const unsigned int PATCH_SUBDIVISIONS = 2;
+
+    float pixelsPerEdge = 8.0f;     // screen length a triangle edge may have
+
+    // the patches' vertex array, the icosphere's
+    unsigned int vertexArray() { return patches().VAO; }
+
+    // draws a sphere of radius (object space) with its program in use and vertexArray() bound, the model matrix and
+    // the rest of the object's uniforms already set; projScale the pixels a unit spans at unit distance, heightScale
+    // the most the displacement adds (0 without it), heightTexel the height cube's texel in object units
+    void draw(Shader& shader, float projScale, float radius, float heightScale = 0.0f, float heightTexel = 1.0f)
+    {
+        if (maxLevel == 0)
+        {
+            GLint level = 64;
+            glGetIntegerv(GL_MAX_TESS_GEN_LEVEL, &level);
+            maxLevel = static_cast<unsigned int>(std::max(level, 1));
+        }
+        shader.setFloat("radius", radius);
+        shader.setFloat("heightScale", heightScale);
+        shader.setFloat("heightTexel", heightTexel);
+        shader.setFloat("projScale", projScale);
+        shader.setFloat("pixelsPerEdge", std::max(pixelsPerEdge, 1.0f));
+        shader.setFloat("maxLevel", static_cast<float>(maxLevel));
+        const Mesh& mesh = patches();
+        const MeshLod drawn = mesh.lod(0);
+        glPatchParameteri(GL_PATCH_VERTICES, 3);
+        glDrawElementsBaseVertex(GL_PATCHES, static_cast<GLsizei>(drawn.count), mesh.indexType,
+                                 reinterpret_cast<const void*>(static_cast<size_t>(drawn.firstIndex) * mesh.indexSize()), mesh.baseVertex());
+    }
+
+    // about the triangles a sphere of that many pixels across is drawn with, the half facing the camera
+    size_t trianglesFor(float pixelDiameter) const
+    {
+        const size_t patchCount = patchTriangles();
+        // a patch edge spans about the sphere's diameter over the square root of the patches across it
+        const float edgePixels = pixelDiameter / std::sqrt(static_cast<float>(patchCount) / 4.0f);
+        const float level = std::clamp(edgePixels / std::max(pixelsPerEdge, 1.0f), 1.0f, maxLevel == 0 ? 64.0f : static_cast<float>(maxLevel));
+        return static_cast<size_t>(0.5f * static_cast<float>(patchCount) * level * level);
+    }
+
+private:
+    unsigned int maxLevel = 0;      // queried on the first draw
+
+    static Mesh& patches() { return sphereCache().icosphere(PATCH_SUBDIVISIONS); }
+    static size_t patchTriangles() { return size_t(20) << (2 * PATCH_SUBDIVISIONS); }
+};
+
+#endif
@@ -0,0 +1,435 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <glad/glad.h>
+
+#include <gl_state_cache.h>
+#include <texture_image.h>
+#include <texture_streamer.h>
+#include <thread_pool.h>
+#include <gpu_memory.h>
+
+#include <stdlib.h>
+#include <limits.h>
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <iostream>
+#include <climits>
+
+// Engine-wide GL textures by canonical file path and the options they were made with, so a texture referenced by
+// several models (or loaded again by a demo) is decoded and uploaded once. Every acquire adds a reference that its
+// owner gives back with release(), the texture is deleted with the last one. With streaming on, acquire returns at
+// once with a placeholder in the texture and the image arrives a few frames later through the TextureStreamer,
+// call update() every frame. GL thread only.
+//
+// With mip streaming on as well, a streamed 2D texture cooked to a .ktx2 is resident only down to the mip level
+// it is seen at. It first comes in with levels of at most MIP_INITIAL_EXTENT texels a side, the base level raised
+// past the rest, and requestExtent() says how many texels across it is sampled at (AssetPriorities estimates it
+// from the model's size on screen). update() then queues the file again for the finer levels when they fit in the
+// budget, the loader reading only those levels of the mapped .ktx2 and up, and while the textures take more than
+// the budget drops the finest level of the texture with the most texels per wanted texel, raising its base level
+// and emptying the level. A texture nobody asked about keeps every level.
+class TextureCache
+{
+public:
+    TextureCache() = default;
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    // the path with symlinks and ./.. resolved, as given if it does not exist
+    static std::string canonicalPath(const std::string& path)
+    {
+        char resolved[PATH_MAX];
+        return realpath(path.c_str(), resolved) ? std::string(resolved) : path;
+    }
+
+    // what acquire() without options loads with: flipped or not (as stbi_set_flip_vertically_on_load was), and
+    // block-compressed or not
+    void setFlipVertically(bool flip) { defaults.flipVertically = flip; }
+    void setCompression(bool compress) { defaults.compress = compress; }
+
+    // loader threads decode from now on and update() uploads at most frameBudget bytes a frame
+    void startStreaming(unsigned int loaderThreads, size_t frameBudget)
+    {
+        streamer.start(loaderThreads, frameBudget);
+    }
+
+    static const unsigned int MIP_INITIAL_EXTENT = 256;
+
+    // mip streaming for the textures acquired from now on, within budget bytes of texture memory
+    void setMipStreaming(bool enabled, size_t budget)
+    {
+        mipStreaming = enabled;
+        mipBudget = budget;
+    }
+
+    bool mipStreamingEnabled() const { return mipStreaming; }
+    size_t mipStreamingBudget() const { return mipBudget; }
+
+    // the texels across the texture it is sampled at this frame, see above; ignored for what is not mip streamed
+    void requestExtent(unsigned int id, unsigned int extent)
+    {
+        auto found = byId.find(id);
+        if (found != byId.end())
+            entries.find(found->second)->second.chain.wanted = extent;
+    }
+
+    bool streaming() const { return streamer.running(); }
+    size_t streamingPending() const { return streamer.pending(); }
+
+    // once per frame, uploads what the loaders finished
+    void update()
+    {
+        streamer.pump([this](unsigned int id, size_t bytes, const DecodedImage& image) { uploaded(id, bytes, image); });
+        if (mipStreaming)
+            updateMips();
+    }
+
+    // ranks a texture still streaming in, see TextureStreamer::prioritize
+    void prioritizeStreaming(unsigned int id, float importance)
+    {
+        streamer.prioritize(id, importance);
+    }
+
+    // waits for every queued image, the textures are final afterwards
+    void finishStreaming()
+    {
+        streamer.finish([this](unsigned int id, size_t bytes, const DecodedImage& image) { uploaded(id, bytes, image); });
+    }
+
+    // the defaults for one kind of texture
+    TextureOptions options(bool srgb, TextureUsage usage = TEXTURE_COLOR) const
+    {
+        TextureOptions o = defaults;
+        o.srgb = srgb;
+        o.usage = usage;
+        return o;
+    }
+
+    bool contains(const std::string& path, const TextureOptions& options) const
+    {
+        return entries.count(keyFor(path, options)) != 0;
+    }
+
+    // a 2D texture, decoded and uploaded on first use
+    unsigned int acquire(const std::string& path, const TextureOptions& options)
+    {
+        const Key key = keyFor(path, options);
+        if (unsigned int id = addReference(key))
+            return id;
+        if (streaming())
+            return insert(key, placeholder({path}, options, false), 0);
+        DecodedImage image = DecodeTextureFile(path, options);
+        const size_t bytes = image.gpuBytes;
+        return insert(key, UploadTexture(image, path.c_str(), options.srgb), bytes);
+    }
+
+    unsigned int acquire(const std::string& path, bool srgb)
+    {
+        return acquire(path, options(srgb));
+    }
+
+    // the same with an image decoded elsewhere (e.g. on a worker thread), which is uploaded and freed unless the
+    // path is already cached
+    unsigned int acquire(const std::string& path, const TextureOptions& options, DecodedImage& image)
+    {
+        const Key key = keyFor(path, options);
+        if (unsigned int id = addReference(key))
+        {
+            freeImage(image);
+            return id;
+        }
+        const size_t bytes = image.gpuBytes;
+        return insert(key, UploadTexture(image, path.c_str(), options.srgb), bytes);
+    }
+
+    // a cube map from six faces in +X -X +Y -Y +Z -Z order, keyed by all of them. Faces are never flipped and have
+    // no mipmaps, they are decoded in parallel (or streamed); srgb for colour the shaders should read as linear.
+    unsigned int acquireCubemap(const std::vector<std::string>& faces, bool srgb = false)
+    {
+        TextureOptions faceOptions = options(srgb);
+        faceOptions.mipmaps = false;
+        faceOptions.flipVertically = false;
+        Key key{std::string(), faceOptions.srgb, faceOptions.usage, faceOptions.compress, false, true};
+        for (const std::string& face : faces)
+            key.path += canonicalPath(face) + '\n';
+        if (unsigned int id = addReference(key))
+            return id;
+        if (streaming())
+            return insert(key, placeholder(faces, faceOptions, true), 0);
+
+        std::vector<DecodedImage> images(faces.size());
+        workerPool().parallelFor(0, faces.size(), [&](size_t begin, size_t end, unsigned int) {
+            for (size_t i = begin; i < end; i++)
+                images[i] = DecodeTextureFile(faces[i], faceOptions);
+        }, static_cast<unsigned int>(faces.size()));
+        size_t bytes = 0;
+        for (const DecodedImage& image : images)
+            bytes += image.gpuBytes;
+        return insert(key, uploadCubemap(faces, images, faceOptions.srgb), bytes);
+    }
+
+    // gives back one reference, deletes the texture with the last
+    void release(unsigned int id)
+    {
+        auto found = byId.find(id);
+        if (found == byId.end())
+            return;
+        auto entry = entries.find(found->second);
+        if (--entry->second.references > 0)
+            return;
+        streamer.cancel(id);
+        glState().deleteTextures(1, &id);
+        entries.erase(entry);
+        byId.erase(found);
+    }
+
+    // deletes everything regardless of references, before the GL context goes
+    void releaseAll()
+    {
+        streamer.stop();
+        for (const auto& entry : entries)
+            glState().deleteTextures(1, &entry.second.id);
+        entries.clear();
+        byId.clear();
+    }
+
+    size_t size() const { return entries.size(); }
+
+    // texture memory of everything cached, mip levels included
+    size_t gpuBytes() const
+    {
+        size_t total = 0;
+        for (const auto& entry : entries)
+            total += entry.second.bytes;
+        return total;
+    }
+
+    // every streamed texture's bytes uploaded so far, the difference across a frame is what it uploaded
+    size_t streamedBytes() const { return streamed; }
+
+private:
+    struct Key
+    {
+        std::string path;       // canonical, the faces one per line for a cube map
+        bool srgb;
+        TextureUsage usage;
+        bool compress;
+        bool flip;
+        bool cubemap;
+        bool operator==(const Key& o) const
+        {
+            return srgb == o.srgb && usage == o.usage && compress == o.compress && flip == o.flip && cubemap == o.cubemap && path == o.path;
+        }
+    };
+    struct KeyHash
+    {
+        size_t operator()(const Key& k) const
+        {
+            const size_t bits = size_t(k.srgb) | size_t(k.usage) << 1 | size_t(k.compress) << 3 | size_t(k.flip) << 4 | size_t(k.cubemap) << 5;
+            return std::hash<std::string>()(k.path) ^ (bits * 0x9e3779b97f4a7c15ull);
+        }
+    };
+    // the full mip chain of a mip streamed texture, levels 0 until its first image is in
+    struct Chain
+    {
+        GLenum format = 0;
+        int width = 0, height = 0;
+        unsigned int blockBytes = 0;
+        unsigned int levels = 0;
+        unsigned int top = 0;               // the finest level resident, the texture's base level
+        unsigned int wanted = UINT_MAX;     // texels across, as requested
+
+        unsigned int extent(unsigned int level) const { return static_cast<unsigned int>(std::max(std::max(width >> level, height >> level), 1)); }
+
+        // the coarsest level still at least wanted texels across
+        unsigned int wantedLevel() const
+        {
+            unsigned int level = 0;
+            while (level + 1 < levels && extent(level + 1) >= wanted)
+                level++;
+            return level;
+        }
+
+        size_t bytesFrom(unsigned int level) const
+        {
+            size_t total = 0;
+            for (unsigned int l = level; l < levels; l++)
+                total += static_cast<size_t>((std::max(width >> l, 1) + 3) / 4) * ((std::max(height >> l, 1) + 3) / 4) * blockBytes;
+            return total;
+        }
+    };
+
+    struct Entry
+    {
+        unsigned int id;
+        unsigned int references;
+        size_t bytes;
+        GpuAllocation memory{GPU_MEMORY_TEXTURES};   // bytes, entered into gpuMemory() while cached
+        Chain chain = Chain();
+    };
+
+    TextureOptions defaults;
+    TextureStreamer streamer;
+    std::unordered_map<Key, Entry, KeyHash> entries;
+    std::unordered_map<unsigned int, Key> byId;
+    size_t streamed = 0;
+    bool mipStreaming = false;
+    size_t mipBudget = 0;
+
+    static Key keyFor(const std::string& path, const TextureOptions& options)
+    {
+        return Key{canonicalPath(path), options.srgb, options.usage, options.compress, options.flipVertically, false};
+    }
+
+    // the cached texture with one more reference, 0 if it is not cached
+    unsigned int addReference(const Key& key)
+    {
+        auto found = entries.find(key);
+        if (found == entries.end())
+            return 0;
+        found->second.references++;
+        return found->second.id;
+    }
+
+    unsigned int insert(const Key& key, unsigned int id, size_t bytes)
+    {
+        Entry& entry = entries.emplace(key, Entry{id, 1, bytes}).first->second;
+        entry.memory.set(bytes);
+        byId.emplace(id, key);
+        return id;
+    }
+
+    static unsigned int uploadCubemap(const std::vector<std::string>& faces, std::vector<DecodedImage>& images, bool srgb)
+    {
+        unsigned int textureID;
+        glCreateTextures(GL_TEXTURE_CUBE_MAP, 1, &textureID);
+        glState().bindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+        if (!faces.empty())
+            labelObject(GL_TEXTURE, textureID, "cubemap " + labelOf(faces[0]));
+        // the storage is sized by the first face that decoded, and the faces that do not match it are left out
+        const DecodedImage* shape = nullptr;
+        for (const DecodedImage& image : images)
+            if (!shape && allocateImage(textureID, true, image, srgb))
+                shape = &image;
+        for (unsigned int i = 0; i < faces.size(); i++)
+        {
+            std::vector<const void*> sources;
+            for (const auto& level : imageLevels(images[i]))
+                sources.push_back(level.first);
+            if (shape && !sources.empty() && images[i].width == shape->width && images[i].height == shape->height
+                && images[i].compressed.internalFormat == shape->compressed.internalFormat && images[i].components == shape->components)
+                storeImage(textureID, true, static_cast<GLint>(i), images[i], sources);
+            else
+                std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
+        }
+        for (unsigned int i = 0; i < faces.size(); i++)
+            freeImage(images[i]);
+        finishCubemap();
+        return textureID;
+    }
+
+    // a new texture holding a placeholder, its files queued on the streamer. Its storage stays mutable: the name is
+    // handed out now and the streamer specifies the image into it in place
+    unsigned int placeholder(const std::vector<std::string>& files, const TextureOptions& options, bool cubemap)
+    {
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        glState().bindTexture(cubemap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D, textureID);
+        if (!files.empty())
+            labelObject(GL_TEXTURE, textureID, (cubemap ? "cubemap " : "") + labelOf(files[0]));
+        specifyPlaceholder(cubemap, options.usage);
+        streamer.enqueue(textureID, files, options, cubemap, mipStreaming && !cubemap ? MIP_INITIAL_EXTENT : 0);
+        return textureID;
+    }
+
+    void uploaded(unsigned int id, size_t bytes, const DecodedImage& image)
+    {
+        streamed += bytes;
+        auto found = byId.find(id);
+        if (found == byId.end())
+            return;
+        Entry& entry = entries.find(found->second)->second;
+        entry.bytes = bytes;
+        entry.memory.set(bytes);
+        const CompressedImage& compressed = image.compressed;
+        if (!mipStreaming || found->second.cubemap || compressed.internalFormat == 0 || image.data != nullptr)
+            return;
+        Chain& chain = entry.chain;
+        chain.format = compressed.internalFormat;
+        chain.width = compressed.width;
+        chain.height = compressed.height;
+        chain.blockBytes = compressed.blockBytes;
+        chain.levels = static_cast<unsigned int>(compressed.levels.size());
+        chain.top = compressed.firstLevel;
+    }
+
+    // the refinements that fit in the budget, then the drops that bring the textures back into it
+    void updateMips()
+    {
+        size_t total = gpuBytes();
+        for (auto& cached : entries)
+        {
+            Entry& entry = cached.second;
+            const Chain& chain = entry.chain;
+            if (chain.levels == 0 || streamer.waiting(entry.id))
+                continue;
+            const unsigned int level = chain.wantedLevel();
+            const size_t more = level < chain.top ? chain.bytesFrom(level) - entry.bytes : 0;
+            if (more == 0 || total + more > mipBudget)
+                continue;
+            const Key& key = cached.first;
+            TextureOptions o = options(key.srgb, key.usage);
+            o.compress = key.compress;
+            o.flipVertically = key.flip;
+            streamer.enqueue(entry.id, {key.path}, o, false, chain.extent(level));
+            total += more;
+        }
+        while (total > mipBudget)
+        {
+            Entry* coarsest = nullptr;
+            double excess = 0.0;
+            for (auto& cached : entries)
+            {
+                const Chain& chain = cached.second.chain;
+                if (chain.levels == 0 || chain.top + 1 >= chain.levels || streamer.waiting(cached.second.id))
+                    continue;
+                const double ratio = static_cast<double>(chain.extent(chain.top)) / std::max(chain.wanted, 1u);
+                if (!coarsest || ratio > excess)
+                {
+                    coarsest = &cached.second;
+                    excess = ratio;
+                }
+            }
+            if (!coarsest)
+                break;
+            total -= coarsest->bytes;
+            dropLevel(*coarsest);
+            total += coarsest->bytes;
+        }
+    }
+
+    // empties the finest resident level of a mip streamed texture
+    void dropLevel(Entry& entry)
+    {
+        Chain& chain = entry.chain;
+        glState().bindTexture(GL_TEXTURE_2D, entry.id);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, static_cast<GLint>(chain.top + 1));
+        glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(chain.top), chain.format, 0, 0, 0, 0, nullptr);
+        chain.top++;
+        entry.bytes = chain.bytesFrom(chain.top);
+        entry.memory.set(entry.bytes);
+    }
+};
+
+// the cache Model and the viewer load their textures through
+inline TextureCache& textureCache()
+{
+    static TextureCache cache;
+    return cache;
+}
+
+#endif
@@ -0,0 +1,330 @@
+#ifndef TEXTURE_COMPRESS_H
+#define TEXTURE_COMPRESS_H
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+// How a texture is sampled, which decides its block format: colour maps are BC7 (RGBA, sRGB or linear), normal
+// maps BC5 (x and y in red and green, a shader rebuilds z = sqrt(1 - x*x - y*y)), single-channel maps BC4.
+enum TextureUsage {
+    TEXTURE_COLOR = 0,
+    TEXTURE_NORMAL = 1
+};
+
+// A block-compressed image with its whole mip chain, levels[0] the full size. Each level is 4x4 blocks of
+// blockBytes (8 for BC4, 16 for BC5 and BC7), partial blocks at the edges are padded by repeating the border.
+struct CompressedImage
+{
+    GLenum internalFormat = 0;      // 0 when there is no compressed image
+    int width = 0, height = 0;
+    unsigned int blockBytes = 0;
+    std::vector<std::vector<uint8_t>> levels;
+    unsigned int firstLevel = 0;    // the levels before it were left out and are empty, see firstLevelWithin
+
+    size_t bytes() const
+    {
+        size_t total = 0;
+        for (const std::vector<uint8_t>& level : levels)
+            total += level.size();
+        return total;
+    }
+};
+
+// the first mip level of a width x height chain of levels no more than maxExtent texels a side, the last level
+// when none is that small; 0 (every level) for a maxExtent of 0
+inline unsigned int firstLevelWithin(int width, int height, size_t levels, unsigned int maxExtent)
+{
+    unsigned int first = 0;
+    while (maxExtent > 0 && first + 1 < levels && static_cast<unsigned int>(std::max(width >> first, height >> first)) > maxExtent)
+        first++;
+    return first;
+}
+
+namespace texture_compress {
+
+// BC4: two 8-bit endpoints and a 3-bit index per texel. The endpoints are the block's extremes in the eight-value
+// mode (r0 > r1), every texel takes the nearest of the eight.
+inline void encodeBC4Block(const uint8_t texels[16], uint8_t out[8])
+{
+    uint8_t lo = 255, hi = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        lo = std::min(lo, texels[i]);
+        hi = std::max(hi, texels[i]);
+    }
+    std::memset(out, 0, 8);
+    out[0] = hi;
+    out[1] = lo;
+    if (hi == lo)
+        return;     // index 0 everywhere is r0
+    int palette[8] = {hi, lo};
+    for (int k = 1; k < 7; k++)
+        palette[k + 1] = ((7 - k) * hi + k * lo) / 7;
+    uint64_t bits = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        int best = 0, bestError = 256;
+        for (int k = 0; k < 8; k++)
+        {
+            const int error = std::abs(palette[k] - texels[i]);
+            if (error < bestError) { bestError = error; best = k; }
+        }
+        bits |= static_cast<uint64_t>(best) << (3 * i);
+    }
+    for (int b = 0; b < 6; b++)
+        out[2 + b] = static_cast<uint8_t>(bits >> (8 * b));
+}
+
+// appends count bits of value at bit position pos of a little-endian 128-bit block
+inline void putBits(uint8_t block[16], int& pos, uint32_t value, int count)
+{
+    for (int b = 0; b < count; b++, pos++)
+        if (value >> b & 1u)
+            block[pos >> 3] |= static_cast<uint8_t>(1u << (pos & 7));
+}
+
+// BC7 mode 6: one subset, RGBA endpoints of 7 bits plus a shared low bit each, 4-bit indices. The endpoints are
+// the texels' extent along their principal axis, each rounded with the low bit that keeps it closest, and every
+// texel takes the nearest of the sixteen interpolated colours.
+inline void encodeBC7Block(const uint8_t rgba[64], uint8_t out[16])
+{
+    static const int weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    float mean[4] = {0, 0, 0, 0};
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 4; c++)
+            mean[c] += rgba[4 * i + c];
+    for (int c = 0; c < 4; c++)
+        mean[c] /= 16.0f;
+    float cov[4][4] = {};
+    for (int i = 0; i < 16; i++)
+        for (int a = 0; a < 4; a++)
+            for (int b = 0; b < 4; b++)
+                cov[a][b] += (rgba[4 * i + a] - mean[a]) * (rgba[4 * i + b] - mean[b]);
+    // power iteration from the largest-variance channel's direction
+    float axis[4] = {1, 1, 1, 1};
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[4] = {0, 0, 0, 0};
+        for (int a = 0; a < 4; a++)
+            for (int b = 0; b < 4; b++)
+                next[a] += cov[a][b] * axis[b];
+        float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+        if (length < 1e-6f)
+            break;
+        for (int c = 0; c < 4; c++)
+            axis[c] = next[c] / length;
+    }
+    float tMin = 1e30f, tMax = -1e30f;
+    for (int i = 0; i < 16; i++)
+    {
+        float t = 0.0f;
+        for (int c = 0; c < 4; c++)
+            t += (rgba[4 * i + c] - mean[c]) * axis[c];
+        tMin = std::min(tMin, t);
+        tMax = std::max(tMax, t);
+    }
+
+    // each endpoint is 7 bits per channel and one low bit shared by its channels
+    int endpoint[2][4];
+    for (int e = 0; e < 2; e++)
+    {
+        const float t = e == 0 ? tMin : tMax;
+        float ideal[4];
+        for (int c = 0; c < 4; c++)
+            ideal[c] = std::min(255.0f, std::max(0.0f, mean[c] + t * axis[c]));
+        float bestError = 1e30f;
+        for (int p = 0; p < 2; p++)
+        {
+            int candidate[4];
+            float error = 0.0f;
+            for (int c = 0; c < 4; c++)
+            {
+                const int q = std::min(127, std::max(0, static_cast<int>(std::lround((ideal[c] - p) / 2.0f))));
+                candidate[c] = q << 1 | p;
+                error += (candidate[c] - ideal[c]) * (candidate[c] - ideal[c]);
+            }
+            if (error < bestError)
+            {
+                bestError = error;
+                std::memcpy(endpoint[e], candidate, sizeof(candidate));
+            }
+        }
+    }
+
+    int palette[16][4];
+    for (int k = 0; k < 16; k++)
+        for (int c = 0; c < 4; c++)
+            palette[k][c] = ((64 - weights[k]) * endpoint[0][c] + weights[k] * endpoint[1][c] + 32) >> 6;
+    int index[16];
+    for (int i = 0; i < 16; i++)
+    {
+        int best = 0, bestError = 1 << 30;
+        for (int k = 0; k < 16; k++)
+        {
+            int error = 0;
+            for (int c = 0; c < 4; c++)
+                error += (palette[k][c] - rgba[4 * i + c]) * (palette[k][c] - rgba[4 * i + c]);
+            if (error < bestError) { bestError = error; best = k; }
+        }
+        index[i] = best;
+    }
+    // the first texel's index is stored without its top bit, so it must be below 8: swap the ends if it is not
+    if (index[0] >= 8)
+    {
+        std::swap(endpoint[0], endpoint[1]);
+        for (int i = 0; i < 16; i++)
+            index[i] = 15 - index[i];
+    }
+
+    std::memset(out, 0, 16);
+    int pos = 0;
+    putBits(out, pos, 1u << 6, 7);
+    for (int c = 0; c < 4; c++)
+    {
+        putBits(out, pos, static_cast<uint32_t>(endpoint[0][c] >> 1), 7);
+        putBits(out, pos, static_cast<uint32_t>(endpoint[1][c] >> 1), 7);
+    }
+    putBits(out, pos, static_cast<uint32_t>(endpoint[0][0] & 1), 1);
+    putBits(out, pos, static_cast<uint32_t>(endpoint[1][0] & 1), 1);
+    putBits(out, pos, static_cast<uint32_t>(index[0]), 3);
+    for (int i = 1; i < 16; i++)
+        putBits(out, pos, static_cast<uint32_t>(index[i]), 4);
+}
+
+inline float srgbToLinear(float c)
+{
+    return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+inline float linearToSrgb(float c)
+{
+    return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+}
+
+// The next mip level by a 2x2 box filter, sizes halve and round down as in glGenerateMipmap. sRGB colour is
+// averaged in linear light, normals (in the first three channels) are averaged and renormalized.
+inline std::vector<uint8_t> downsample(const std::vector<uint8_t>& image, int width, int height, int channels, bool srgb, TextureUsage usage)
+{
+    const int w = std::max(width / 2, 1), h = std::max(height / 2, 1);
+    std::vector<uint8_t> out(static_cast<size_t>(w) * h * channels);
+    float toLinear[256];
+    for (int v = 0; v < 256; v++)
+        toLinear[v] = srgbToLinear(v / 255.0f);
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+        {
+            float sum[4] = {0, 0, 0, 0};
+            for (int dy = 0; dy < 2; dy++)
+                for (int dx = 0; dx < 2; dx++)
+                {
+                    const int sx = std::min(2 * x + dx, width - 1), sy = std::min(2 * y + dy, height - 1);
+                    const uint8_t* texel = &image[(static_cast<size_t>(sy) * width + sx) * channels];
+                    for (int c = 0; c < channels; c++)
+                    {
+                        const bool colour = srgb && usage == TEXTURE_COLOR && c < 3;
+                        const bool normal = usage == TEXTURE_NORMAL && channels >= 3 && c < 3;
+                        sum[c] += colour ? toLinear[texel[c]] : normal ? texel[c] / 127.5f - 1.0f : texel[c] / 255.0f;
+                    }
+                }
+            uint8_t* target = &out[(static_cast<size_t>(y) * w + x) * channels];
+            if (usage == TEXTURE_NORMAL && channels >= 3)
+            {
+                const float length = std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+                for (int c = 0; c < 3; c++)
+                    sum[c] = length > 1e-6f ? (sum[c] / length * 0.5f + 0.5f) * 4.0f : 2.0f;
+            }
+            for (int c = 0; c < channels; c++)
+            {
+                float v = sum[c] / 4.0f;
+                if (srgb && usage == TEXTURE_COLOR && c < 3)
+                    v = linearToSrgb(v);
+                target[c] = static_cast<uint8_t>(std::lround(std::min(1.0f, std::max(0.0f, v)) * 255.0f));
+            }
+        }
+    return out;
+}
+
+// one level in blocks, the 4x4 texels of each block gathered with the border repeated past the edges
+inline std::vector<uint8_t> compressLevel(const std::vector<uint8_t>& image, int width, int height, int channels, GLenum format)
+{
+    const int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    const unsigned int blockBytes = format == GL_COMPRESSED_RED_RGTC1 ? 8 : 16;
+    std::vector<uint8_t> out(static_cast<size_t>(blocksX) * blocksY * blockBytes);
+    uint8_t rgba[64], red[16], green[16];
+    for (int by = 0; by < blocksY; by++)
+        for (int bx = 0; bx < blocksX; bx++)
+        {
+            for (int i = 0; i < 16; i++)
+            {
+                const int x = std::min(4 * bx + (i & 3), width - 1), y = std::min(4 * by + (i >> 2), height - 1);
+                const uint8_t* texel = &image[(static_cast<size_t>(y) * width + x) * channels];
+                for (int c = 0; c < 4; c++)
+                    rgba[4 * i + c] = c < channels ? texel[c] : c == 3 ? 255 : texel[0];
+                red[i] = texel[0];
+                green[i] = channels > 1 ? texel[1] : texel[0];
+            }
+            uint8_t* block = &out[(static_cast<size_t>(by) * blocksX + bx) * blockBytes];
+            if (format == GL_COMPRESSED_RED_RGTC1)
+            {
+                encodeBC4Block(red, block);
+            }
+            else if (format == GL_COMPRESSED_RG_RGTC2)
+            {
+                encodeBC4Block(red, block);
+                encodeBC4Block(green, block + 8);
+            }
+            else
+            {
+                encodeBC7Block(rgba, block);
+            }
+        }
+    return out;
+}
+
+} // namespace texture_compress
+
+// the block format an image of this many channels and usage compresses to, 0 if it stays uncompressed
+inline GLenum compressedFormatFor(int channels, bool srgb, TextureUsage usage)
+{
+    if (channels == 1)
+        return GL_COMPRESSED_RED_RGTC1;
+    if (usage == TEXTURE_NORMAL && channels >= 2)
+        return GL_COMPRESSED_RG_RGTC2;
+    if (channels == 3 || channels == 4)
+        return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+    return 0;
+}
+
+// Compresses 8-bit pixels (channels per texel, rows top to bottom as decoded) with a mip chain down to 1x1, or
+// only the full size without mipmaps. The image is left empty if there is no block format for it.
+inline CompressedImage compressImage(const uint8_t* pixels, int width, int height, int channels, bool srgb, TextureUsage usage, bool mipmaps)
+{
+    CompressedImage image;
+    const GLenum format = compressedFormatFor(channels, srgb, usage);
+    if (format == 0 || width <= 0 || height <= 0)
+        return image;
+    image.internalFormat = format;
+    image.width = width;
+    image.height = height;
+    image.blockBytes = format == GL_COMPRESSED_RED_RGTC1 ? 8 : 16;
+    std::vector<uint8_t> level(pixels, pixels + static_cast<size_t>(width) * height * channels);
+    int w = width, h = height;
+    for (;;)
+    {
+        image.levels.push_back(texture_compress::compressLevel(level, w, h, channels, format));
+        if (!mipmaps || (w == 1 && h == 1))
+            break;
+        level = texture_compress::downsample(level, w, h, channels, srgb, usage);
+        w = std::max(w / 2, 1);
+        h = std::max(h / 2, 1);
+    }
+    return image;
+}
+
+#endif
@@ -0,0 +1,301 @@
+#ifndef TEXTURE_IMAGE_H
+#define TEXTURE_IMAGE_H
+
+#include <glad/glad.h>
+
+#include <gl_state_cache.h>
+#include <stb_image.h>
+
+#include <texture_compress.h>
+#include <ktx2.h>
+#include <profiler.h>
+#include <gl_debug.h>
+#include <asset_archive.h>
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <iostream>
+
+// how a file is turned into a texture. Everything that changes the texels is part of its cache key.
+struct TextureOptions
+{
+    bool srgb = false;
+    TextureUsage usage = TEXTURE_COLOR;
+    bool mipmaps = true;
+    bool flipVertically = false;
+    bool compress = true;       // block-compressed through a .ktx2 next to the image, see DecodeTextureFile
+};
+
+// an image file decoded into memory, which needs no GL context and so can run on any thread. Either data holds
+// the 8-bit pixels or compressed the blocks and their mip levels.
+struct DecodedImage
+{
+    unsigned char* data = nullptr;
+    int width = 0, height = 0, components = 0;
+    CompressedImage compressed;
+    size_t gpuBytes = 0;        // what the texture will take, mip levels included
+};
+
+// the cooked file of an image, one per colour space and usage since those change the blocks
+inline std::string compressedTexturePath(const std::string& filename, const TextureOptions& options)
+{
+    const char* kind = options.usage == TEXTURE_NORMAL ? "normal" : options.srgb ? "srgb" : "linear";
+    return filename + '.' + kind + (options.mipmaps ? "" : ".nomips") + (options.flipVertically ? ".flipped" : "") + ".ktx2";
+}
+
+// identifies the source image a cooked file was made from, a changed image makes it stale
+inline std::string compressedTextureSource(const std::string& filename)
+{
+    int64_t mtimeNs = 0;
+    uint64_t bytes = 0;
+    if (!assetStamp(filename, mtimeNs, bytes))
+        return std::string();
+    return std::to_string(static_cast<long long>(mtimeNs)) + ' ' + std::to_string(static_cast<long long>(bytes));
+}
+
+// Decodes an image file. With options.compress the blocks come from its .ktx2 when that is up to date, otherwise
+// the image is decoded, compressed (BC7 colour, BC5 normals, BC4 single channel, see texture_compress.h) and the
+// .ktx2 written for the next launch; images without a block format stay uncompressed. Safe on any thread: the
+// vertical flip is set per thread. A maxExtent leaves out the compressed levels larger than that, as far as the
+// chain goes (see firstLevelWithin); an 8-bit image is always whole.
+inline DecodedImage DecodeTextureFile(const std::string &filename, const TextureOptions& options = TextureOptions(), unsigned int maxExtent = 0)
+{
+    PROFILE_SCOPE_DETAIL("DecodeTextureFile", filename);
+    DecodedImage image;
+    const std::string source = options.compress ? compressedTextureSource(filename) : std::string();
+    const std::string cooked = compressedTexturePath(filename, options);
+    if (!source.empty() && ktx2::read(cooked, source, image.compressed, maxExtent))
+    {
+        image.width = image.compressed.width;
+        image.height = image.compressed.height;
+        image.gpuBytes = image.compressed.bytes();
+        return image;
+    }
+
+    stbi_set_flip_vertically_on_load_thread(options.flipVertically);
+    AssetFile encoded;
+    if (encoded.open(filename.c_str(), true))
+        image.data = stbi_load_from_memory(encoded.data(), static_cast<int>(encoded.size()), &image.width, &image.height, &image.components, 0);
+    encoded.close();
+    if (!image.data)
+        return image;
+    image.gpuBytes = static_cast<size_t>(image.width) * image.height * image.components * (options.mipmaps ? 4 : 3) / 3;
+    if (source.empty())
+        return image;
+    image.compressed = compressImage(image.data, image.width, image.height, image.components, options.srgb && options.usage == TEXTURE_COLOR,
+                                     options.usage, options.mipmaps);
+    if (image.compressed.internalFormat == 0)
+        return image;
+    // a read-only directory only costs the cooked file, the texture is still compressed
+    ktx2::write(cooked, image.compressed, source);
+    image.compressed.firstLevel = firstLevelWithin(image.width, image.height, image.compressed.levels.size(), maxExtent);
+    for (unsigned int l = 0; l < image.compressed.firstLevel; l++)
+        std::vector<uint8_t>().swap(image.compressed.levels[l]);
+    stbi_image_free(image.data);
+    image.data = nullptr;
+    image.gpuBytes = image.compressed.bytes();
+    return image;
+}
+
+// the image's pixels as upload sources: every mip level of a compressed image from its first, or its one 8-bit level
+inline std::vector<std::pair<const void*, size_t>> imageLevels(const DecodedImage& image)
+{
+    std::vector<std::pair<const void*, size_t>> levels;
+    if (image.compressed.internalFormat != 0 && image.data == nullptr)
+    {
+        for (size_t l = image.compressed.firstLevel; l < image.compressed.levels.size(); l++)
+            levels.emplace_back(image.compressed.levels[l].data(), image.compressed.levels[l].size());
+    }
+    else if (image.data)
+    {
+        levels.emplace_back(image.data, static_cast<size_t>(image.width) * image.height * image.components);
+    }
+    return levels;
+}
+
+// Specifies target (GL_TEXTURE_2D or a cube map face) of the bound texture from image, level l read from
+// sources[l - first level]: the image's own memory, or offsets into a bound pixel unpack buffer. The levels before a
+// compressed image's first are emptied. False if there is nothing to specify (the image failed to decode). The
+// storage is mutable, for the streamer's textures whose names are handed out before their images arrive; textures
+// made whole at once go through allocateImage and storeImage.
+inline bool specifyImage(GLenum target, const DecodedImage& image, bool gammaCorrection, const std::vector<const void*>& sources)
+{
+    if (image.compressed.internalFormat != 0 && image.data == nullptr)
+    {
+        const unsigned int first = image.compressed.firstLevel;
+        int w = image.width, h = image.height;
+        for (size_t level = 0; level < image.compressed.levels.size(); level++)
+        {
+            if (level < first)
+                glCompressedTexImage2D(target, static_cast<GLint>(level), image.compressed.internalFormat, 0, 0, 0, 0, nullptr);
+            else
+                glCompressedTexImage2D(target, static_cast<GLint>(level), image.compressed.internalFormat, w, h, 0,
+                                       static_cast<GLsizei>(image.compressed.levels[level].size()), sources[level - first]);
+            w = std::max(w / 2, 1);
+            h = std::max(h / 2, 1);
+        }
+        return true;
+    }
+    if (sources.empty())
+        return false;
+    GLenum internalFormat = GL_RGB;
+    GLenum dataFormat = GL_RGB;
+    if (image.components == 1)
+    {
+        internalFormat = dataFormat = GL_RED;
+    }
+    else if (image.components == 3)
+    {
+        internalFormat = gammaCorrection ? GL_SRGB : GL_RGB;
+        dataFormat = GL_RGB;
+    }
+    else if (image.components == 4)
+    {
+        internalFormat = gammaCorrection ? GL_SRGB_ALPHA : GL_RGBA;
+        dataFormat = GL_RGBA;
+    }
+    glTexImage2D(target, 0, internalFormat, image.width, image.height, 0, dataFormat, GL_UNSIGNED_BYTE, sources[0]);
+    return true;
+}
+
+// the sized internal format of an 8-bit image's texels, which immutable storage takes in place of GL_RGB and the
+// like, and the format of its pixels
+inline GLenum sizedFormat(const DecodedImage& image, bool gammaCorrection, GLenum& dataFormat)
+{
+    switch (image.components)
+    {
+    case 1: dataFormat = GL_RED; return GL_R8;
+    case 2: dataFormat = GL_RG; return GL_RG8;
+    case 4: dataFormat = GL_RGBA; return gammaCorrection ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+    default: dataFormat = GL_RGB; return gammaCorrection ? GL_SRGB8 : GL_RGB8;
+    }
+}
+
+// Immutable storage in texture (created with glCreateTextures, GL_TEXTURE_2D or GL_TEXTURE_CUBE_MAP) for image: a
+// compressed image's whole chain, the levels before its first left unfilled, or an 8-bit image's chain down to
+// 1x1 for glGenerateTextureMipmap, a cube map's face having the one level. False, and no storage, if there is
+// nothing to store (the image failed to decode).
+inline bool allocateImage(GLuint texture, bool cubemap, const DecodedImage& image, bool gammaCorrection)
+{
+    if (image.compressed.internalFormat != 0 && image.data == nullptr)
+    {
+        glTextureStorage2D(texture, static_cast<GLsizei>(image.compressed.levels.size()), image.compressed.internalFormat, image.width, image.height);
+        return true;
+    }
+    if (image.data == nullptr)
+        return false;
+    GLsizei levels = 1;
+    if (!cubemap)
+        while ((std::max(image.width, image.height) >> levels) > 0)
+            levels++;
+    GLenum dataFormat;
+    glTextureStorage2D(texture, levels, sizedFormat(image, gammaCorrection, dataFormat), image.width, image.height);
+    return true;
+}
+
+// fills face (0 for a 2D texture) of the storage allocateImage gave texture from image, the sources as
+// specifyImage takes them
+inline void storeImage(GLuint texture, bool cubemap, GLint face, const DecodedImage& image, const std::vector<const void*>& sources)
+{
+    if (image.compressed.internalFormat != 0 && image.data == nullptr)
+    {
+        const unsigned int first = image.compressed.firstLevel;
+        for (size_t level = first; level < image.compressed.levels.size(); level++)
+        {
+            const GLsizei w = std::max(image.width >> level, 1), h = std::max(image.height >> level, 1);
+            const GLsizei bytes = static_cast<GLsizei>(image.compressed.levels[level].size());
+            if (cubemap)
+                glCompressedTextureSubImage3D(texture, static_cast<GLint>(level), 0, 0, face, w, h, 1, image.compressed.internalFormat, bytes,
+                                              sources[level - first]);
+            else
+                glCompressedTextureSubImage2D(texture, static_cast<GLint>(level), 0, 0, w, h, image.compressed.internalFormat, bytes,
+                                              sources[level - first]);
+        }
+        return;
+    }
+    if (sources.empty())
+        return;
+    GLenum dataFormat;
+    sizedFormat(image, false, dataFormat);
+    if (cubemap)
+        glTextureSubImage3D(texture, 0, 0, 0, face, image.width, image.height, 1, dataFormat, GL_UNSIGNED_BYTE, sources[0]);
+    else
+        glTextureSubImage2D(texture, 0, 0, 0, image.width, image.height, dataFormat, GL_UNSIGNED_BYTE, sources[0]);
+}
+
+// mipmaps and sampler state of the bound GL_TEXTURE_2D once specifyImage filled it: a compressed image brings its
+// levels from its first, an uncompressed one has them generated
+inline void finishTexture2D(const DecodedImage& image)
+{
+    const bool prebuilt = image.compressed.internalFormat != 0 && image.data == nullptr;
+    const size_t levels = prebuilt ? image.compressed.levels.size() : 0;
+    if (!prebuilt)
+        glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, prebuilt ? static_cast<GLint>(image.compressed.firstLevel) : 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, prebuilt ? static_cast<GLint>(levels) - 1 : 1000);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, prebuilt && levels == 1 ? GL_LINEAR : GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+inline void freeImage(DecodedImage& image)
+{
+    stbi_image_free(image.data);
+    image = DecodedImage();
+}
+
+// sampler state of a cube map, its faces have no mipmaps
+inline void finishCubemap()
+{
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+}
+
+// a 1x1 stand-in in the bound texture until the real image arrives: mid grey for colour, flat for normal maps,
+// black on every face of a cube map
+inline void specifyPlaceholder(bool cubemap, TextureUsage usage)
+{
+    const uint8_t grey[4] = {128, 128, 128, 255}, flat[4] = {128, 128, 255, 255}, black[4] = {0, 0, 0, 255};
+    if (cubemap)
+    {
+        for (unsigned int face = 0; face < 6; face++)
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, black);
+        finishCubemap();
+        return;
+    }
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, usage == TEXTURE_NORMAL ? flat : grey);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+// uploads the image to a new texture and frees it, the texture stays empty if it failed to decode
+inline unsigned int UploadTexture(DecodedImage &image, char const * path, bool gammaCorrection)
+{
+    PROFILE_SCOPE_DETAIL("UploadTexture", path);
+    unsigned int textureID;
+    glCreateTextures(GL_TEXTURE_2D, 1, &textureID);
+    glState().bindTexture(GL_TEXTURE_2D, textureID);
+    labelObject(GL_TEXTURE, textureID, labelOf(path));
+    std::vector<const void*> sources;
+    for (const auto& level : imageLevels(image))
+        sources.push_back(level.first);
+    if (allocateImage(textureID, false, image, gammaCorrection))
+    {
+        storeImage(textureID, false, 0, image, sources);
+        finishTexture2D(image);
+    }
+    else
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+    freeImage(image);
+    return textureID;
+}
+
+#endif
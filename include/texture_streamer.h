@@ -0,0 +1,361 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <glad/glad.h>
+
+#include <gl_state_cache.h>
+#include <texture_image.h>
+#include <streaming_buffer.h>
+#include <profiler.h>
+#include <alloc_tracker.h>
+#include <startup_trace.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <cfloat>
+#include <unordered_map>
+
+// Fills textures after they are handed out. enqueue() takes a texture that already holds a placeholder, loader
+// threads decode its file (or six cube map faces, reading or cooking the KTX2 as DecodeTextureFile does), and
+// pump() on the GL thread re-specifies the texture from the decoded image, in place, so whatever already refers
+// to the texture name picks the image up. Uploads are staged through a StreamingBuffer used as a pixel unpack
+// ring, one segment per frame: a frame copies at most frameBudget bytes of finished images into its segment
+// (at least one image, a larger one is uploaded from client memory) so the frame time stays bounded while a
+// model's textures come in. A texture's levels are all specified in the same pump, it is never seen incomplete.
+// prioritize() ranks a texture: the loaders decode the highest ranked first and a pump uploads them first, what is
+// not ranked goes ahead in the order it was queued, and one ranked 0 is held back undecoded, a decoded image of it
+// freed and its file queued again, until it is ranked above 0.
+class TextureStreamer
+{
+public:
+    TextureStreamer() = default;
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    ~TextureStreamer()
+    {
+        stop();
+    }
+
+    // GL thread, the staging ring is frameBudget bytes per segment
+    void start(unsigned int threads, size_t frameBudget)
+    {
+        stop();
+        budget = frameBudget;
+        staging.create(frameBudget, "texture streaming staging");
+        stopping = false;
+        for (unsigned int t = 0; t < std::max(threads, 1u); t++)
+            loaders.emplace_back([this]() { loaderLoop(); });
+    }
+
+    // joins the loaders and drops whatever has not been uploaded, the textures keep their placeholders
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& t : loaders)
+            t.join();
+        loaders.clear();
+        for (Result& result : finished)
+            for (DecodedImage& image : result.images)
+                freeImage(image);
+        queue.clear();
+        finished.clear();
+        importances.clear();
+        serials.clear();
+        staging.release();
+    }
+
+    bool running() const { return !loaders.empty(); }
+
+    // images queued or decoded but not uploaded
+    size_t pending() const { return serials.size(); }
+    bool waiting(unsigned int texture) const { return serials.count(texture) != 0; }
+
+    // queues the files of a texture: one image, or the six faces of a cube map in +X -X +Y -Y +Z -Z order. A
+    // maxExtent loads a compressed image's levels up to that size only (see DecodeTextureFile). Queued again, the
+    // texture waits for the new load, the earlier one is dropped.
+    void enqueue(unsigned int texture, const std::vector<std::string>& files, const TextureOptions& options, bool cubemap,
+                 unsigned int maxExtent = 0)
+    {
+        const unsigned long serial = ++nextSerial;
+        const bool queued = serials.count(texture) != 0;
+        serials[texture] = serial;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (queued)
+                queue.erase(std::remove_if(queue.begin(), queue.end(), [texture](const Job& job) { return job.texture == texture; }), queue.end());
+            queue.push_back(Job{texture, serial, files, options, cubemap, maxExtent});
+        }
+        wake.notify_one();
+    }
+
+    // the texture is going away, an image still on its way for it is dropped
+    void cancel(unsigned int texture)
+    {
+        if (serials.erase(texture) == 0)
+            return;
+        std::lock_guard<std::mutex> lock(mutex);
+        importances.erase(texture);
+        queue.erase(std::remove_if(queue.begin(), queue.end(), [texture](const Job& job) { return job.texture == texture; }), queue.end());
+    }
+
+    // GL thread, the texture's importance, see above; a texture with nothing on its way is ignored
+    void prioritize(unsigned int texture, float importance)
+    {
+        if (serials.count(texture) == 0)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            importances[texture] = std::max(importance, 0.0f);
+        }
+        if (importance > 0.0f)
+            wake.notify_one();
+    }
+
+    // Uploads finished images up to the frame budget, call once per frame on the GL thread. uploaded(texture,
+    // bytes, image) is called for each, with the memory the texture now takes and its (first) image.
+    template <typename Fn>
+    void pump(const Fn& uploaded)
+    {
+        if (serials.empty())
+            return;
+        std::vector<Result> ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            parkCancelled();
+            size_t bytes = 0;
+            for (;;)
+            {
+                std::deque<Result>::iterator best = finished.end();
+                for (auto it = finished.begin(); it != finished.end(); ++it)
+                    if (best == finished.end() || priority(it->texture) > priority(best->texture))
+                        best = it;
+                if (best == finished.end() || (!ready.empty() && bytes + best->bytes > budget))
+                    break;
+                bytes += best->bytes;
+                ready.push_back(std::move(*best));
+                finished.erase(best);
+            }
+        }
+        if (ready.empty())
+            return;
+        upload(ready, uploaded);
+    }
+
+    // blocks until everything queued is uploaded, for callers that need the final textures (bindless handles
+    // are immutable once taken)
+    template <typename Fn>
+    void finish(const Fn& uploaded)
+    {
+        {
+            // what was held back is needed now
+            std::lock_guard<std::mutex> lock(mutex);
+            importances.clear();
+        }
+        wake.notify_all();
+        while (!serials.empty() && running())
+        {
+            std::vector<Result> ready;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                done.wait(lock, [this]() { return !finished.empty(); });
+                while (!finished.empty())
+                {
+                    ready.push_back(std::move(finished.front()));
+                    finished.pop_front();
+                }
+            }
+            upload(ready, uploaded);
+        }
+    }
+
+private:
+    struct Job
+    {
+        unsigned int texture;
+        unsigned long serial;       // a name can be deleted and handed out again, the serial tells the loads apart
+        std::vector<std::string> files;
+        TextureOptions options;
+        bool cubemap;
+        unsigned int maxExtent;
+    };
+    struct Result
+    {
+        unsigned int texture;
+        unsigned long serial;
+        std::vector<DecodedImage> images;
+        std::vector<std::string> files;
+        TextureOptions options;
+        bool cubemap;
+        unsigned int maxExtent;
+        size_t bytes;               // staged through the ring
+    };
+
+    std::vector<std::thread> loaders;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::deque<Job> queue;
+    std::deque<Result> finished;
+    std::unordered_map<unsigned int, float> importances;        // the ranked textures
+    bool stopping = false;
+    // GL thread only
+    std::unordered_map<unsigned int, unsigned long> serials;    // the load each texture waits for
+    unsigned long nextSerial = 0;
+    StreamingBuffer staging{GPU_MEMORY_TEXTURES};
+    size_t budget = 0;
+
+    // under the mutex
+    float priority(unsigned int texture) const
+    {
+        auto ranked = importances.find(texture);
+        return ranked == importances.end() ? FLT_MAX : ranked->second;
+    }
+
+    std::deque<Job>::iterator next()
+    {
+        std::deque<Job>::iterator best = queue.end();
+        for (auto it = queue.begin(); it != queue.end(); ++it)
+            if (priority(it->texture) > 0.0f && (best == queue.end() || priority(it->texture) > priority(best->texture)))
+                best = it;
+        return best;
+    }
+
+    // finished images of textures ranked 0 go back to the queue as files, the memory is not held for them
+    void parkCancelled()
+    {
+        for (auto it = finished.begin(); it != finished.end();)
+        {
+            if (priority(it->texture) > 0.0f)
+            {
+                ++it;
+                continue;
+            }
+            for (DecodedImage& image : it->images)
+                freeImage(image);
+            queue.push_back(Job{it->texture, it->serial, std::move(it->files), it->options, it->cubemap, it->maxExtent});
+            it = finished.erase(it);
+        }
+    }
+
+    void loaderLoop()
+    {
+        profiler().nameThread("texture loader");
+        ALLOC_SCOPE(ALLOC_STREAMING);
+        startupTrace().nameThread("texture loader");
+        for (;;)
+        {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this]() { return stopping || next() != queue.end(); });
+                if (stopping)
+                    return;
+                auto it = next();
+                job = std::move(*it);
+                queue.erase(it);
+            }
+            Result result{job.texture, job.serial, {}, job.files, job.options, job.cubemap, job.maxExtent, 0};
+            StartupScope phase("texture decode", job.files.empty() ? std::string() : job.files.front());
+            for (const std::string& file : job.files)
+            {
+                result.images.push_back(DecodeTextureFile(file, job.options, job.maxExtent));
+                for (const auto& level : imageLevels(result.images.back()))
+                    result.bytes += level.second;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished.push_back(std::move(result));
+            }
+            done.notify_one();
+        }
+    }
+
+    template <typename Fn>
+    void upload(std::vector<Result>& ready, const Fn& uploaded)
+    {
+        uint8_t* segment = nullptr;
+        size_t used = 0;
+        for (Result& result : ready)
+        {
+            auto waiting = serials.find(result.texture);
+            if (waiting == serials.end() || waiting->second != result.serial)
+            {
+                for (DecodedImage& image : result.images)
+                    freeImage(image);
+                continue;
+            }
+            serials.erase(waiting);
+
+            // stage the levels in this frame's segment when they fit, each 16-byte aligned for the block formats
+            size_t needed = used;
+            for (const DecodedImage& image : result.images)
+                for (const auto& level : imageLevels(image))
+                    needed = ((needed + 15) & ~size_t(15)) + level.second;
+            const bool staged = staging.valid() && needed <= budget;
+            if (staged && segment == nullptr)
+                segment = static_cast<uint8_t*>(staging.beginWrite());
+            if (staged)
+                glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer());
+
+            const GLenum target = result.cubemap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+            glState().bindTexture(target, result.texture);
+            size_t bytes = 0;
+            bool any = false;
+            for (size_t i = 0; i < result.images.size(); i++)
+            {
+                DecodedImage& image = result.images[i];
+                std::vector<const void*> sources;
+                for (const auto& level : imageLevels(image))
+                {
+                    if (staged)
+                    {
+                        used = (used + 15) & ~size_t(15);
+                        std::memcpy(segment + used, level.first, level.second);
+                        sources.push_back(reinterpret_cast<const void*>(staging.readOffset() + used));
+                        used += level.second;
+                    }
+                    else
+                    {
+                        sources.push_back(level.first);
+                    }
+                }
+                const GLenum face = result.cubemap ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + static_cast<GLenum>(i) : GL_TEXTURE_2D;
+                if (specifyImage(face, image, result.options.srgb, sources))
+                {
+                    any = true;
+                    bytes += image.gpuBytes;
+                }
+                else
+                {
+                    std::cout << "Texture failed to load at path: " << result.files[i] << std::endl;
+                }
+            }
+            if (staged)
+                glState().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            // the first image of a texture decides how it finishes, a failed one keeps the placeholder's state
+            if (any && result.cubemap)
+                finishCubemap();
+            else if (any)
+                finishTexture2D(result.images[0]);
+            if (any)
+                uploaded(result.texture, bytes, result.images[0]);
+            for (DecodedImage& image : result.images)
+                freeImage(image);
+        }
+        if (segment != nullptr)
+            staging.fenceRead();
+    }
+};
+
+#endif
@@ -0,0 +1,398 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <profiler.h>
+
+// where pin() puts the pool's participants, participant i being the one that runs slice i of every parallelFor
+enum ThreadPinning {
+    PIN_NONE = 0,
+    PIN_CORES = 1,      // each on one CPU, filling a NUMA node before the next
+    PIN_NODES = 2       // the participants in contiguous blocks over the NUMA nodes, each free within its node
+};
+
+// the CPUs this process may run on by NUMA node, from /sys/devices/system/node; one node of all of them where
+// there is no such directory
+inline const std::vector<std::vector<int>>& cpuNodes()
+{
+    static const std::vector<std::vector<int>> nodes = []() {
+        std::vector<std::vector<int>> found;
+#ifdef __linux__
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        sched_getaffinity(0, sizeof(allowed), &allowed);
+        for (int node = 0; node < 1024; node++)
+        {
+            std::ifstream list("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            if (!list)
+                break;
+            // ranges like 0-15,32-47
+            std::vector<int> cpus;
+            std::string range;
+            while (std::getline(list, range, ','))
+            {
+                const size_t dash = range.find('-');
+                const int first = std::atoi(range.c_str());
+                const int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+                for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+                    if (CPU_ISSET(cpu, &allowed)) cpus.push_back(cpu);
+            }
+            if (!cpus.empty()) found.push_back(cpus);
+        }
+        if (found.empty())
+        {
+            found.emplace_back();
+            for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+                if (CPU_ISSET(cpu, &allowed)) found.back().push_back(cpu);
+        }
+#endif
+        return found;
+    }();
+    return nodes;
+}
+
+// Persistent worker pool. Threads are created once and sleep between jobs, so splitting a loop across cores
+// costs a wake-up rather than a thread launch. parallelFor hands each participant one contiguous slice of the
+// range, which lets callers write results into per-slice output without atomics. The callable is only referenced
+// for the duration of the call, never copied, so a parallel loop does not allocate. Slice i always runs on
+// participant i, so with the participants pinned (pin()) a slice of the bodies stays on one core or NUMA node from
+// one loop to the next, the node first touch put its pages on (body_memory.h).
+//
+// The pool keeps counters all the time, at two clock reads a slice: each participant's busy time and slices, how
+// long a worker took from the dispatch to the start of its slice, and how long the caller waited for the last slice
+// after finishing its own, which is the load imbalance of the static split. There is no queue to steal from, so the
+// loops that could not be spread are counted instead: the serial ones too small to split and the contended ones that
+// found the pool on another loop and ran whole on their own thread. beginFrame() snapshots a frame of them, and in
+// a trace each slice is a span named after the PROFILE_SCOPE its parallelFor was called in.
+class ThreadPool
+{
+public:
+    // one participant's share of a frame
+    struct ParticipantFrame
+    {
+        double busyMs = 0.0;
+        unsigned long long slices = 0;
+        double wakeMs = 0.0;            // dispatch to slice start in total, the caller's is always 0
+        double maxWakeMs = 0.0;
+    };
+
+    // what the pool did between two beginFrame() calls
+    struct Frame
+    {
+        double frameMs = 0.0;
+        unsigned long long loops = 0;           // spread over the workers
+        unsigned long long serialLoops = 0;     // one slice, on the caller
+        unsigned long long contendedLoops = 0;  // run whole on their caller because the pool was busy
+        double contendedMs = 0.0;
+        double callerWaitMs = 0.0;              // the callers' wait for the slowest slice
+        std::vector<ParticipantFrame> participants;
+
+        // a participant's busy time over the frame's
+        float utilization(unsigned int participant) const
+        {
+            return frameMs > 0.0 ? static_cast<float>(std::min(participants[participant].busyMs / frameMs, 1.0)) : 0.0f;
+        }
+    };
+
+    explicit ThreadPool(unsigned int threadCount = defaultThreadCount())
+    {
+        resize(threadCount);
+    }
+
+    ~ThreadPool()
+    {
+        stopWorkers();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    static unsigned int defaultThreadCount()
+    {
+        unsigned int n = std::thread::hardware_concurrency();
+        return n > 0 ? n : 1;
+    }
+
+    // total participants, including the calling thread
+    unsigned int size() const { return static_cast<unsigned int>(workers.size()) + 1; }
+
+    void resize(unsigned int threadCount)
+    {
+        threadCount = std::max(threadCount, 1u);
+        if (threadCount == size() && !workers.empty())
+            return;
+        stopWorkers();
+        stopping = false;
+        counters.reset(new ParticipantCounters[threadCount]);
+        counterCount = threadCount;
+        frameStart.assign(threadCount, ParticipantFrame());
+        // new workers must not pick up the job of a generation that already finished
+        unsigned long current = generation;
+        for (unsigned int i = 1; i < threadCount; i++)
+            workers.emplace_back([this, i, current]() { workerLoop(i, current); });
+        if (pinning != PIN_NONE)
+            pin(pinning);
+    }
+
+    // pins every worker, and the calling thread as participant 0, by mode; PIN_NONE lets them run anywhere again.
+    // Kept through resize(). Without the affinity calls (not Linux) it only remembers the mode.
+    void pin(ThreadPinning mode)
+    {
+        pinning = mode;
+#ifdef __linux__
+        setAffinity(pthread_self(), 0);
+        for (unsigned int i = 1; i < size(); i++)
+            setAffinity(workers[i - 1].native_handle(), i);
+#endif
+    }
+
+    ThreadPinning pinned() const { return pinning; }
+
+    // calls fn(sliceBegin, sliceEnd, sliceIndex) for up to maxSlices contiguous slices of [begin, end).
+    // Slice 0 runs on the caller, the call returns once every slice has finished. A call from another thread, or
+    // from inside a slice, while the pool is on a loop runs the whole range on its caller as slice 0.
+    template <typename Fn>
+    void parallelFor(size_t begin, size_t end, const Fn& fn, unsigned int maxSlices = 0)
+    {
+        if (end <= begin)
+            return;
+        unsigned int slices = maxSlices == 0 ? size() : std::min(maxSlices, size());
+        slices = static_cast<unsigned int>(std::min<size_t>(slices, end - begin));
+        if (slices <= 1)
+        {
+            const int64_t startNs = clock();
+            fn(begin, end, 0);
+            ParticipantCounters& caller = counters[0];
+            caller.busyNs.fetch_add(static_cast<unsigned long long>(clock() - startNs), std::memory_order_relaxed);
+            caller.slices.fetch_add(1, std::memory_order_relaxed);
+            serialLoops.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (busy.exchange(true, std::memory_order_acquire))
+        {
+            const int64_t startNs = clock();
+            fn(begin, end, 0);
+            contendedNs.fetch_add(static_cast<unsigned long long>(clock() - startNs), std::memory_order_relaxed);
+            contendedLoops.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        size_t chunk = (end - begin + slices - 1) / slices;
+        const char* name = Profiler::currentScope() ? Profiler::currentScope() : "parallel slice";
+        (void)name;     // without profiling
+        int64_t dispatchNs = 0;
+        auto runSlice = [&](unsigned int slice) {
+            const int64_t startNs = clock();
+            {
+                PROFILE_SCOPE_DETAIL(name, "parallel slice");
+                size_t b = begin + slice * chunk;
+                size_t e = std::min(end, b + chunk);
+                if (b < e) fn(b, e, slice);
+            }
+            ParticipantCounters& participant = counters[slice];
+            participant.busyNs.fetch_add(static_cast<unsigned long long>(clock() - startNs), std::memory_order_relaxed);
+            participant.slices.fetch_add(1, std::memory_order_relaxed);
+            if (slice == 0)
+                return;
+            const unsigned long long wakeNs = static_cast<unsigned long long>(std::max<int64_t>(startNs - dispatchNs, 0));
+            participant.wakeNs.fetch_add(wakeNs, std::memory_order_relaxed);
+            unsigned long long seen = participant.maxWakeNs.load(std::memory_order_relaxed);
+            while (wakeNs > seen && !participant.maxWakeNs.compare_exchange_weak(seen, wakeNs, std::memory_order_relaxed)) {}
+        };
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &invokeSlice<decltype(runSlice)>;
+            jobContext = &runSlice;
+            jobSlices = slices;
+            pending = slices - 1;
+            dispatchNs = clock();
+            generation++;
+        }
+        wake.notify_all();
+        runSlice(0);
+
+        const int64_t waitNs = clock();
+        {
+            PROFILE_SCOPE("pool wait");
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [this]() { return pending == 0; });
+            job = nullptr;
+            jobContext = nullptr;
+        }
+        callerWaitNs.fetch_add(static_cast<unsigned long long>(clock() - waitNs), std::memory_order_relaxed);
+        loops.fetch_add(1, std::memory_order_relaxed);
+        busy.store(false, std::memory_order_release);
+    }
+
+    // ends a frame of the counters and starts the next, on the thread that runs the frames
+    void beginFrame()
+    {
+        const int64_t nowNs = clock();
+        frame.frameMs = frameStartNs > 0 ? (nowNs - frameStartNs) * 1e-6 : 0.0;
+        frameStartNs = nowNs;
+        frame.loops = take(loops, loopsStart);
+        frame.serialLoops = take(serialLoops, serialStart);
+        frame.contendedLoops = take(contendedLoops, contendedStart);
+        frame.contendedMs = take(contendedNs, contendedNsStart) * 1e-6;
+        frame.callerWaitMs = take(callerWaitNs, callerWaitStart) * 1e-6;
+        frame.participants.resize(counterCount);
+        for (unsigned int i = 0; i < counterCount; i++)
+        {
+            ParticipantCounters& c = counters[i];
+            ParticipantFrame now;
+            now.busyMs = c.busyNs.load(std::memory_order_relaxed) * 1e-6;
+            now.slices = c.slices.load(std::memory_order_relaxed);
+            now.wakeMs = c.wakeNs.load(std::memory_order_relaxed) * 1e-6;
+            ParticipantFrame& out = frame.participants[i];
+            out.busyMs = now.busyMs - frameStart[i].busyMs;
+            out.slices = now.slices - frameStart[i].slices;
+            out.wakeMs = now.wakeMs - frameStart[i].wakeMs;
+            out.maxWakeMs = c.maxWakeNs.exchange(0, std::memory_order_relaxed) * 1e-6;
+            frameStart[i] = now;
+        }
+    }
+
+    // the frame the last beginFrame() ended
+    const Frame& lastFrame() const { return frame; }
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    void (*job)(void*, unsigned int) = nullptr;    // type-erased runSlice of the current parallelFor
+    void* jobContext = nullptr;
+    unsigned int jobSlices = 0;
+    unsigned int pending = 0;
+    unsigned long generation = 0;
+    bool stopping = false;
+    std::atomic<bool> busy{false};     // a loop is on the workers
+    ThreadPinning pinning = PIN_NONE;
+
+    // a cache line each, the participants add to their own at the end of every slice
+    struct alignas(64) ParticipantCounters
+    {
+        std::atomic<unsigned long long> busyNs{0};
+        std::atomic<unsigned long long> slices{0};
+        std::atomic<unsigned long long> wakeNs{0};
+        std::atomic<unsigned long long> maxWakeNs{0};      // since the last beginFrame()
+    };
+
+    std::unique_ptr<ParticipantCounters[]> counters;
+    unsigned int counterCount = 0;
+    std::atomic<unsigned long long> loops{0};
+    std::atomic<unsigned long long> serialLoops{0};
+    std::atomic<unsigned long long> contendedLoops{0};
+    std::atomic<unsigned long long> contendedNs{0};
+    std::atomic<unsigned long long> callerWaitNs{0};
+    // beginFrame()'s side, the counters as the frame started
+    unsigned long long loopsStart = 0, serialStart = 0, contendedStart = 0, contendedNsStart = 0, callerWaitStart = 0;
+    std::vector<ParticipantFrame> frameStart;
+    int64_t frameStartNs = 0;
+    Frame frame;
+
+    static int64_t clock() { return profiler().now(); }
+
+    static unsigned long long take(const std::atomic<unsigned long long>& counter, unsigned long long& start)
+    {
+        const unsigned long long now = counter.load(std::memory_order_relaxed);
+        const unsigned long long delta = now - start;
+        start = now;
+        return delta;
+    }
+
+#ifdef __linux__
+    void setAffinity(pthread_t thread, unsigned int participant) const
+    {
+        const std::vector<std::vector<int>>& nodes = cpuNodes();
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (pinning == PIN_CORES)
+        {
+            std::vector<int> cpus;
+            for (const std::vector<int>& node : nodes) cpus.insert(cpus.end(), node.begin(), node.end());
+            if (!cpus.empty()) CPU_SET(cpus[participant % cpus.size()], &set);
+        }
+        else
+        {
+            // PIN_NONE is every node
+            const size_t first = pinning == PIN_NODES ? static_cast<size_t>(participant) * nodes.size() / size() : 0;
+            const size_t last = pinning == PIN_NODES ? first + 1 : nodes.size();
+            for (size_t n = first; n < last && n < nodes.size(); n++)
+                for (int cpu : nodes[n]) CPU_SET(cpu, &set);
+        }
+        if (CPU_COUNT(&set) > 0)
+            pthread_setaffinity_np(thread, sizeof(set), &set);
+    }
+#endif
+
+    void workerLoop(unsigned int index, unsigned long seen)
+    {
+        profiler().nameThread("pool worker");
+        for (;;)
+        {
+            void (*current)(void*, unsigned int) = nullptr;
+            void* context = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&]() { return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+                if (index >= jobSlices)
+                    continue;
+                current = job;
+                context = jobContext;
+            }
+            current(context, index);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--pending == 0)
+                    done.notify_one();
+            }
+        }
+    }
+
+    template <typename SliceFn>
+    static void invokeSlice(void* context, unsigned int slice)
+    {
+        (*static_cast<const SliceFn*>(context))(slice);
+    }
+
+    void stopWorkers()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& t : workers)
+            t.join();
+        workers.clear();
+    }
+};
+
+// the engine-wide pool, shared by physics and any other subsystem that wants to split work across cores
+inline ThreadPool& workerPool()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+#endif
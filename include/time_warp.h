@@ -0,0 +1,178 @@
+#ifndef TIME_WARP_H
+#define TIME_WARP_H
+
+#include <physics_world.h>
+
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+// Time warp for the interactive loop. Instead of scaling the step size with the speed, each frame covers
+// requested * frameDt of sim time with as many substeps as stability asks for: the substep is eta times the
+// shortest orbital timescale |v| / |a| of any body (the same estimate the block stepper starts from), and never
+// longer than maxStep. The substep count is capped by what fits in the frame's wall-time budget, measured from
+// the cost of the previous substeps, so a warp the CPU cannot afford runs slower rather than unstable.
+//
+// When even that is not enough the world falls back to cheaper physics, one tier at a time: first the vectorized
+// O(N*M) test-particle solver, then Keplerian asteroids, whose analytic orbits take any step and leave only the
+// massive bodies to limit it. The user's settings are put back once the warp fits comfortably again.
+class TimeWarp
+{
+public:
+    enum Tier {
+        TIER_USER = 0,          // the world's own settings
+        TIER_VECTORIZED = 1,    // test-particle solver on the best SIMD kernel
+        TIER_KEPLER = 2,        // plus analytic orbits for asteroids away from the planets
+        TIER_COUNT = 3
+    };
+
+    bool enabled = false;
+    float eta = 0.02f;              // substep as a fraction of the shortest orbital timescale
+    float maxStep = 0.05f;          // longest substep in sim seconds, also used before accelerations are known
+    float frameBudget = 0.012f;     // wall seconds of physics per frame
+    unsigned int maxSubsteps = 512;
+    bool allowFallbacks = true;
+
+    // last frame, for display
+    float requestedWarp = 0.0f;
+    float achievedWarp = 0.0f;      // smoothed sim time advanced per wall second
+    unsigned int substeps = 0;
+    float substepSize = 0.0f;
+    float stableStep = 0.0f;
+    int tier = TIER_USER;
+
+    static const char* tierName(int t)
+    {
+        switch (t)
+        {
+            case TIER_USER: return "settings as chosen";
+            case TIER_VECTORIZED: return "vectorized test particles";
+            case TIER_KEPLER: return "Keplerian asteroids";
+            default: return "unknown";
+        }
+    }
+
+    // advances world by up to warp * frameDt of sim time, stepFn(dt) takes one substep. Returns the sim time covered.
+    template <typename StepFn>
+    double advance(PhysicsWorld& world, float warp, float frameDt, StepFn&& stepFn)
+    {
+        requestedWarp = warp;
+        substeps = 0;
+        const double wanted = static_cast<double>(warp) * frameDt;
+        if (wanted <= 0.0 || frameDt <= 0.0f)
+            return 0.0;
+
+        stableStep = stableStepFor(world);
+        // substeps the budget allows at the measured cost, a single one until there is a measurement
+        const bool measured = costPerStep > 0.0;
+        const unsigned int affordable = measured ? static_cast<unsigned int>(std::clamp(frameBudget / costPerStep, 1.0, 1e9)) : 1u;
+        const unsigned int needed = static_cast<unsigned int>(std::min(std::ceil(wanted / stableStep), 1e9));
+        if (allowFallbacks && measured)
+            chooseTier(world, needed, std::min(affordable, maxSubsteps));
+
+        const unsigned int count = std::max(1u, std::min({needed, affordable, maxSubsteps}));
+        // divide the frame evenly when it is affordable, otherwise run at the stable step and fall behind
+        const float dt = static_cast<float>(count >= needed ? wanted / count : stableStep);
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int k = 0; k < count; k++)
+            stepFn(dt);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const double perStep = seconds / count;
+        costPerStep = costPerStep > 0.0 ? 0.8 * costPerStep + 0.2 * perStep : perStep;
+
+        substeps = count;
+        substepSize = dt;
+        const float warpThisFrame = static_cast<float>(count * static_cast<double>(dt) / frameDt);
+        achievedWarp = achievedWarp > 0.0f ? 0.9f * achievedWarp + 0.1f * warpThisFrame : warpThisFrame;
+        return count * static_cast<double>(dt);
+    }
+
+    // back to the user's settings, e.g. when warp is switched off
+    void restore(PhysicsWorld& world)
+    {
+        if (tier != TIER_USER)
+            world.applySettings(userSettings);
+        tier = TIER_USER;
+        costPerStep = 0.0;
+        achievedWarp = 0.0f;
+    }
+
+private:
+    PhysicsSettings userSettings{};
+    double costPerStep = 0.0;       // smoothed wall seconds per substep at the current tier
+    unsigned int comfortableFrames = 0;
+
+    // eta * min |v| / |a|, with v taken in the centre-of-mass frame: a sun drifting with the system's net momentum
+    // could otherwise pass through zero velocity. In Keplerian mode the analytic asteroids take any step, the
+    // massive bodies decide, and asteroids in a close encounter are on two-body orbits that do not limit it either.
+    float stableStepFor(const PhysicsWorld& world) const
+    {
+        const BodyStore& bodies = world.bodies;
+        const BodyRange asteroids = bodies.range(BODY_ASTEROID);
+        const size_t end = world.keplerAsteroids ? asteroids.begin : bodies.size();
+        glm::dvec3 momentum(0.0);
+        double mass = 0.0;
+        for (size_t i = 0; i < bodies.size(); i++)
+        {
+            momentum += static_cast<double>(bodies.mass[i]) * bodies.velocity[i];
+            mass += bodies.mass[i];
+        }
+        const glm::dvec3 frame = mass > 0.0 ? momentum / mass : glm::dvec3(0.0);
+        float shortest = maxStep / eta;
+        const bool encounters = world.encountersActive();
+        for (size_t i = 0; i < end; i++)
+        {
+            if (bodies.flags[i] & BODY_FLAG_STATIC)
+                continue;
+            if (encounters && i >= asteroids.begin && world.encounterPrimaryOf(i) != BodyStore::INVALID_INDEX)
+                continue;
+            const float a = glm::length(bodies.acceleration[i]);
+            if (a > 0.0f)
+                shortest = std::min(shortest, static_cast<float>(glm::length(bodies.velocity[i] - frame)) / a);
+        }
+        return std::max(std::min(eta * shortest, maxStep), 1e-6f);
+    }
+
+    // one tier up when the needed substeps do not fit, one down after a while with plenty of room
+    void chooseTier(PhysicsWorld& world, unsigned int needed, unsigned int affordable)
+    {
+        if (needed > affordable && tier + 1 < TIER_COUNT)
+        {
+            if (tier == TIER_USER)
+                userSettings = world.settings();
+            setTier(world, tier + 1);
+            comfortableFrames = 0;
+        }
+        else if (tier > TIER_USER && 4 * static_cast<unsigned long>(needed) < affordable)
+        {
+            // the cheaper tier is cheaper per step, so stepping back down needs a wide margin to not flip-flop
+            if (++comfortableFrames >= 120)
+            {
+                setTier(world, tier - 1);
+                comfortableFrames = 0;
+            }
+        }
+        else
+        {
+            comfortableFrames = 0;
+        }
+    }
+
+    void setTier(PhysicsWorld& world, int t)
+    {
+        PhysicsSettings s = userSettings;
+        if (t >= TIER_VECTORIZED)
+        {
+            s.solver = SOLVER_TEST_PARTICLES;
+            s.forceKernel = bestGravityKernel();
+        }
+        if (t >= TIER_KEPLER)
+            s.keplerAsteroids = true;
+        world.applySettings(s);
+        tier = t;
+        // the new tier has its own cost, measure it afresh
+        costPerStep = 0.0;
+    }
+};
+
+#endif
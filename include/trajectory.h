@@ -0,0 +1,162 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <glm.hpp>
+#include <gtc/quaternion.hpp>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+
+// Trajectory recording format, little-endian like the snapshots:
+//   TrajectoryFileHeader
+//   per recorded body: uint8 type, float radiusScale, quat orientation (x y z w), in the header's body order
+//   chunks until the end of the file, each a TrajectoryChunkHeader, frameCount doubles of sim time and the payload
+// Frames are coded per chunk, so any chunk decodes on its own. Each coordinate becomes an integer, its grid index
+// when quantized or its IEEE bits mapped to an order-preserving integer when lossless, and is predicted by linear
+// extrapolation from the two frames before it. Only the zigzag varint of the prediction error is stored, and for
+// smooth orbits that error is a small fraction of the per-frame motion.
+static const char TRAJECTORY_MAGIC[8] = {'N', 'B', 'O', 'D', 'Y', 'T', 'R', 'J'};
+static const uint32_t TRAJECTORY_VERSION = 1;
+static const uint32_t TRAJECTORY_CHUNK_MAGIC = 0x4b4e4843;   // "CHNK"
+
+enum TrajectoryFlags : uint32_t {
+    TRAJECTORY_QUANTIZED = 1 << 0
+};
+
+struct TrajectoryFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t bodyCount;
+    double quantum;             // grid spacing in world units when quantized
+    uint32_t stepInterval;      // physics steps between recorded frames
+    float stepSize;             // sim seconds per physics step when the recording started, 0 if unknown
+    unsigned char reserved[64 - 8 - 4 - 4 - 8 - 8 - 4 - 4];
+};
+
+struct TrajectoryChunkHeader
+{
+    uint32_t magic;
+    uint32_t frameCount;
+    uint64_t firstStep;
+    uint64_t payloadBytes;
+};
+
+static_assert(sizeof(TrajectoryFileHeader) == 64 && sizeof(TrajectoryChunkHeader) == 24, "part of the file format");
+
+inline size_t trajectoryBodyRecordBytes() { return 1 + sizeof(float) + sizeof(glm::quat); }
+
+inline void putVarint(std::vector<unsigned char>& out, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        out.push_back(static_cast<unsigned char>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<unsigned char>(v));
+}
+
+// false on a truncated or overlong value
+inline bool getVarint(const unsigned char*& p, const unsigned char* end, uint64_t& v)
+{
+    v = 0;
+    for (unsigned int shift = 0; shift < 64 && p < end; shift += 7)
+    {
+        unsigned char byte = *p++;
+        v |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+inline uint64_t zigzag(int64_t v) { return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63); }
+inline int64_t unzigzag(uint64_t v) { return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1); }
+
+// Predictive coder for one chunk's frames. The encoder and decoder keep the previous two frames' coded values, so
+// both must see the frames of a chunk in order and be reset at each chunk start.
+class TrajectoryCodec
+{
+public:
+    void reset(size_t bodyCount, double quantumSize)
+    {
+        quantum = quantumSize;
+        previous.assign(bodyCount * 3, 0);
+        beforePrevious.assign(bodyCount * 3, 0);
+        frames = 0;
+    }
+
+    void encode(const glm::dvec3* positions, std::vector<unsigned char>& out)
+    {
+        const size_t values = previous.size();
+        const double* p = reinterpret_cast<const double*>(positions);
+        for (size_t k = 0; k < values; k++)
+        {
+            uint64_t coded = code(p[k]);
+            putVarint(out, zigzag(static_cast<int64_t>(coded - predict(k))));
+            beforePrevious[k] = previous[k];
+            previous[k] = coded;
+        }
+        frames++;
+    }
+
+    // reads one frame, false if the payload ends early
+    bool decode(const unsigned char*& p, const unsigned char* end, glm::dvec3* positions)
+    {
+        const size_t values = previous.size();
+        double* out = reinterpret_cast<double*>(positions);
+        for (size_t k = 0; k < values; k++)
+        {
+            uint64_t v;
+            if (!getVarint(p, end, v))
+                return false;
+            uint64_t coded = predict(k) + static_cast<uint64_t>(unzigzag(v));
+            beforePrevious[k] = previous[k];
+            previous[k] = coded;
+            out[k] = value(coded);
+        }
+        frames++;
+        return true;
+    }
+
+private:
+    double quantum = 0.0;
+    std::vector<uint64_t> previous, beforePrevious;
+    unsigned int frames = 0;
+
+    // wrapping arithmetic, the encoder and decoder agree bit for bit
+    uint64_t predict(size_t k) const
+    {
+        if (frames == 0) return 0;
+        if (frames == 1) return previous[k];
+        return 2 * previous[k] - beforePrevious[k];
+    }
+
+    uint64_t code(double x) const
+    {
+        if (quantum > 0.0)
+            return static_cast<uint64_t>(static_cast<int64_t>(std::llround(x / quantum)));
+        uint64_t bits;
+        std::memcpy(&bits, &x, sizeof(bits));
+        // negative values count down, so flip them to keep neighbouring values numerically close
+        return (bits & SIGN) ? ~bits : bits | SIGN;
+    }
+
+    double value(uint64_t coded) const
+    {
+        if (quantum > 0.0)
+            return static_cast<double>(static_cast<int64_t>(coded)) * quantum;
+        uint64_t bits = (coded & SIGN) ? coded & ~SIGN : ~coded;
+        double x;
+        std::memcpy(&x, &bits, sizeof(x));
+        return x;
+    }
+
+    static const uint64_t SIGN = 0x8000000000000000ull;
+};
+
+#endif
@@ -0,0 +1,250 @@
+#ifndef TRAJECTORY_PLAYER_H
+#define TRAJECTORY_PLAYER_H
+
+#include <body_store.h>
+#include <trajectory.h>
+#include <mapped_file.h>
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+// Plays back a recording from TrajectoryRecorder. open() maps the file and builds a chunk index from the chunk
+// headers, nothing else is read until a time is requested. seek(t) brings the two recorded frames around t into
+// frameA() and frameB(): moving forward decodes on from where the cursor is, moving backwards or far ahead
+// restarts at the chunk holding the target. The next chunk is prefetched while the current one plays, so a large
+// recording streams from disk instead of having to fit in memory.
+class TrajectoryPlayer
+{
+public:
+    bool open(const char* path)
+    {
+        close();
+        if (!file.open(path))
+            return false;
+        const unsigned char* data = file.data();
+        const size_t size = file.size();
+        if (size < sizeof(TrajectoryFileHeader))
+            return fail();
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.magic, TRAJECTORY_MAGIC, sizeof(header.magic)) != 0 || header.version != TRAJECTORY_VERSION)
+            return fail();
+        const size_t n = static_cast<size_t>(header.bodyCount);
+        size_t offset = sizeof(TrajectoryFileHeader);
+        if (n > (size - offset) / trajectoryBodyRecordBytes())
+            return fail();
+        bodyTable = data + offset;
+        offset += n * trajectoryBodyRecordBytes();
+
+        // chunk index, a truncated last chunk (recording cut short) is ignored
+        while (offset + sizeof(TrajectoryChunkHeader) <= size)
+        {
+            TrajectoryChunkHeader chunk;
+            std::memcpy(&chunk, data + offset, sizeof(chunk));
+            size_t timesBytes = static_cast<size_t>(chunk.frameCount) * sizeof(double);
+            if (chunk.magic != TRAJECTORY_CHUNK_MAGIC || chunk.frameCount == 0 ||
+                chunk.payloadBytes > size - offset - sizeof(chunk) || timesBytes > size - offset - sizeof(chunk) - chunk.payloadBytes)
+                break;
+            ChunkEntry entry;
+            entry.firstFrame = frameTimes.size();
+            entry.frameCount = chunk.frameCount;
+            entry.payloadOffset = offset + sizeof(chunk) + timesBytes;
+            entry.payloadBytes = static_cast<size_t>(chunk.payloadBytes);
+            for (uint32_t f = 0; f < chunk.frameCount; f++)
+            {
+                double t;
+                std::memcpy(&t, data + offset + sizeof(chunk) + f * sizeof(double), sizeof(double));
+                frameTimes.push_back(t);
+            }
+            chunks.push_back(entry);
+            offset = entry.payloadOffset + entry.payloadBytes;
+        }
+        if (frameTimes.empty())
+            return fail();
+        for (size_t i = 1; i < frameTimes.size(); i++)
+            if (frameTimes[i] < frameTimes[i - 1])
+                return fail();
+        a.assign(n, glm::dvec3(0.0));
+        b.assign(n, glm::dvec3(0.0));
+        cursorChunk = chunks.size();
+        indexA = indexB = NO_FRAME;
+        return true;
+    }
+
+    void close()
+    {
+        file.close();
+        chunks.clear();
+        frameTimes.clear();
+        a.clear();
+        b.clear();
+        bodyTable = nullptr;
+        indexA = indexB = NO_FRAME;
+    }
+
+    bool isOpen() const { return file.isOpen(); }
+    size_t bodyCount() const { return static_cast<size_t>(header.bodyCount); }
+    size_t frameCount() const { return frameTimes.size(); }
+    size_t chunkCount() const { return chunks.size(); }
+    double startTime() const { return frameTimes.front(); }
+    double endTime() const { return frameTimes.back(); }
+    const TrajectoryFileHeader& fileHeader() const { return header; }
+
+    BodyType bodyType(size_t k) const { return static_cast<BodyType>(bodyTable[k * trajectoryBodyRecordBytes()]); }
+
+    // rebuilds a body store laid out like the recording, positions at the first frame, for drawing the replay
+    void initializeBodies(BodyStore& bodies, Mesh* sunMesh = nullptr, Model* planetModel = nullptr, Model* asteroidModel = nullptr)
+    {
+        const size_t n = bodyCount();
+        size_t counts[BODY_TYPE_COUNT] = {0, 0, 0};
+        std::vector<uint32_t> ids(n);
+        for (size_t k = 0; k < n; k++)
+        {
+            counts[std::min<unsigned int>(bodyType(k), BODY_TYPE_COUNT - 1)]++;
+            ids[k] = static_cast<uint32_t>(k);
+        }
+        bodies.assignLayout(counts, ids.data());
+        bodies.velocity.assign(n, glm::dvec3(0.0));
+        bodies.acceleration.assign(n, glm::vec3(0.0f));
+        bodies.mass.assign(n, 0.0f);
+        bodies.flags.assign(n, 0);
+        bodies.render.clear();
+        for (size_t k = 0; k < n; k++)
+        {
+            const unsigned char* record = bodyTable + k * trajectoryBodyRecordBytes();
+            BodyRenderData r;
+            std::memcpy(&r.radiusScale, record + 1, sizeof(float));
+            std::memcpy(&r.orientation, record + 1 + sizeof(float), sizeof(glm::quat));
+            BodyType type = bodies.typeOf(k);
+            r.modelPtr = type == BODY_PLANET ? planetModel : type == BODY_ASTEROID ? asteroidModel : nullptr;
+            r.meshPtr = type == BODY_SUN ? sunMesh : nullptr;
+            if (type == BODY_ASTEROID)
+                r.spin = tumbleFor(static_cast<uint32_t>(k));
+            bodies.render.push_back(r);
+        }
+        seek(startTime());
+        bodies.position.assign(a.begin(), a.end());
+    }
+
+    // brings the frames around t (clamped to the recording) into frameA/frameB, false on a corrupt payload
+    bool seek(double t)
+    {
+        t = std::clamp(t, startTime(), endTime());
+        size_t target = static_cast<size_t>(std::upper_bound(frameTimes.begin(), frameTimes.end(), t) - frameTimes.begin());
+        target = target > 0 ? target - 1 : 0;
+        size_t next = std::min(target + 1, frameTimes.size() - 1);
+        if (indexA == target && indexB == next)
+            return true;
+        if (indexB == target && next == target + 1 && cursorFrame == next)
+        {
+            // the common case during playback: step the pair forward by one decoded frame
+            a.swap(b);
+            indexA = target;
+            if (!decodeNext(b)) return false;
+            indexB = next;
+            return true;
+        }
+        // restart at the target's chunk unless the cursor is already before the target in it
+        size_t chunk = chunkOf(target);
+        if (chunk != cursorChunk || cursorFrame > target)
+            startChunk(chunk);
+        while (cursorFrame < target)
+            if (!decodeNext(a)) return false;
+        if (!decodeNext(a)) return false;
+        indexA = target;
+        if (next != target)
+        {
+            if (!decodeNext(b)) return false;
+        }
+        else
+        {
+            b = a;
+        }
+        indexB = next;
+        return true;
+    }
+
+    // interpolation weight of frameB at t, valid after seek(t)
+    double blend(double t) const
+    {
+        if (indexA == NO_FRAME || indexA == indexB)
+            return 0.0;
+        double ta = frameTimes[indexA], tb = frameTimes[indexB];
+        return tb > ta ? std::clamp((t - ta) / (tb - ta), 0.0, 1.0) : 0.0;
+    }
+
+    const std::vector<glm::dvec3>& frameA() const { return a; }
+    const std::vector<glm::dvec3>& frameB() const { return b; }
+
+private:
+    struct ChunkEntry
+    {
+        size_t firstFrame;
+        uint32_t frameCount;
+        size_t payloadOffset;
+        size_t payloadBytes;
+    };
+
+    static const size_t NO_FRAME = ~size_t(0);
+
+    MappedFile file;
+    TrajectoryFileHeader header;
+    const unsigned char* bodyTable = nullptr;
+    std::vector<ChunkEntry> chunks;
+    std::vector<double> frameTimes;         // every recorded frame, for seeking by time
+    std::vector<glm::dvec3> a, b;
+    size_t indexA = NO_FRAME, indexB = NO_FRAME;
+
+    // decode cursor: cursorFrame is the global index of the next frame decodeNext() produces
+    TrajectoryCodec codec;
+    size_t cursorChunk = 0;
+    size_t cursorFrame = 0;
+    const unsigned char* cursor = nullptr;
+    const unsigned char* cursorEnd = nullptr;
+
+    bool fail()
+    {
+        close();
+        return false;
+    }
+
+    size_t chunkOf(size_t frame) const
+    {
+        size_t lo = 0, hi = chunks.size();
+        while (hi - lo > 1)
+        {
+            size_t mid = (lo + hi) / 2;
+            if (chunks[mid].firstFrame <= frame) lo = mid; else hi = mid;
+        }
+        return lo;
+    }
+
+    void startChunk(size_t c)
+    {
+        cursorChunk = c;
+        cursorFrame = chunks[c].firstFrame;
+        cursor = file.data() + chunks[c].payloadOffset;
+        cursorEnd = cursor + chunks[c].payloadBytes;
+        codec.reset(bodyCount(), header.quantum);
+        if (c + 1 < chunks.size())
+            file.prefetch(chunks[c + 1].payloadOffset, chunks[c + 1].payloadBytes);
+    }
+
+    bool decodeNext(std::vector<glm::dvec3>& out)
+    {
+        if (cursorChunk >= chunks.size() || cursorFrame >= chunks[cursorChunk].firstFrame + chunks[cursorChunk].frameCount)
+        {
+            size_t c = cursorChunk >= chunks.size() ? chunkOf(cursorFrame) : cursorChunk + 1;
+            if (c >= chunks.size())
+                return false;
+            startChunk(c);
+        }
+        if (!codec.decode(cursor, cursorEnd, out.data()))
+            return false;
+        cursorFrame++;
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,224 @@
+#ifndef TRAJECTORY_RECORDER_H
+#define TRAJECTORY_RECORDER_H
+
+#include <body_store.h>
+#include <trajectory.h>
+
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+
+// Records body positions every stepInterval steps. capture() runs on the simulating thread and only copies the
+// positions into a free slot of a single-producer single-consumer ring, a full ring drops the frame instead of
+// waiting. A writer thread drains the ring, delta-codes the frames into chunks (see trajectory.h) and writes each
+// chunk when it is full. Bodies are recorded in the order they had at start(), followed through reordering by id.
+// A body being added or removed ends the recording, the file stays valid up to the last written chunk.
+class TrajectoryRecorder
+{
+public:
+    struct Options
+    {
+        unsigned int stepInterval = 10;
+        double quantum = 0.0;           // grid spacing in world units, 0 records positions losslessly
+        unsigned int framesPerChunk = 32;
+        float stepSize = 0.0f;          // stored for playback
+    };
+
+    ~TrajectoryRecorder()
+    {
+        stop();
+    }
+
+    bool recording() const { return active.load(std::memory_order_acquire); }
+
+    bool start(const std::string& path, const BodyStore& bodies, const Options& opts)
+    {
+        stop();
+        file = std::fopen(path.c_str(), "wb");
+        if (!file)
+            return false;
+        options = opts;
+        if (options.stepInterval == 0) options.stepInterval = 1;
+        if (options.framesPerChunk == 0) options.framesPerChunk = 1;
+
+        // record order is the current body order, kept by id from here on
+        const size_t n = bodies.size();
+        recordedIds = bodies.id;
+        TrajectoryFileHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, TRAJECTORY_MAGIC, sizeof(header.magic));
+        header.version = TRAJECTORY_VERSION;
+        header.flags = options.quantum > 0.0 ? static_cast<uint32_t>(TRAJECTORY_QUANTIZED) : 0u;
+        header.bodyCount = n;
+        header.quantum = options.quantum;
+        header.stepInterval = options.stepInterval;
+        header.stepSize = options.stepSize;
+        std::vector<unsigned char> bodyTable(n * trajectoryBodyRecordBytes());
+        unsigned char* out = bodyTable.data();
+        for (size_t i = 0; i < n; i++)
+        {
+            uint8_t type = static_cast<uint8_t>(bodies.typeOf(i));
+            std::memcpy(out, &type, 1); out += 1;
+            std::memcpy(out, &bodies.render[i].radiusScale, sizeof(float)); out += sizeof(float);
+            std::memcpy(out, &bodies.render[i].orientation, sizeof(glm::quat)); out += sizeof(glm::quat);
+        }
+        bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+                  (bodyTable.empty() || std::fwrite(bodyTable.data(), bodyTable.size(), 1, file) == 1);
+        if (!ok)
+        {
+            std::fclose(file);
+            file = nullptr;
+            return false;
+        }
+        for (Frame& f : ring)
+            f.position.assign(n, glm::dvec3(0.0));
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+        framesWritten.store(0, std::memory_order_relaxed);
+        framesDropped.store(0, std::memory_order_relaxed);
+        bytesWritten.store(sizeof(header) + bodyTable.size(), std::memory_order_relaxed);
+        stopRequested.store(false, std::memory_order_relaxed);
+        active.store(true, std::memory_order_release);
+        writer = std::thread([this]() { writerLoop(); });
+        return true;
+    }
+
+    // called after every step, never blocks
+    void capture(const BodyStore& bodies, double simTime, unsigned long step)
+    {
+        if (!recording() || step % options.stepInterval != 0)
+            return;
+        uint64_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == RING_SIZE)
+        {
+            framesDropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        Frame& f = ring[h % RING_SIZE];
+        const size_t n = recordedIds.size();
+        if (bodies.size() != n)
+        {
+            endRecording();
+            return;
+        }
+        for (size_t k = 0; k < n; k++)
+        {
+            // bodies usually sit where they were, the id map is only consulted after a reorder moved them
+            uint32_t i = bodies.id[k] == recordedIds[k] ? static_cast<uint32_t>(k) : bodies.indexOf(recordedIds[k]);
+            if (i == BodyStore::INVALID_INDEX)
+            {
+                endRecording();
+                return;
+            }
+            f.position[k] = bodies.position[i];
+        }
+        f.simTime = simTime;
+        f.step = step;
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    // flushes what was captured and closes the file
+    void stop()
+    {
+        stopRequested.store(true, std::memory_order_release);
+        if (writer.joinable())
+            writer.join();
+        if (file)
+        {
+            std::fclose(file);
+            file = nullptr;
+        }
+        active.store(false, std::memory_order_release);
+    }
+
+    unsigned long long writtenFrames() const { return framesWritten.load(std::memory_order_relaxed); }
+    unsigned long long droppedFrames() const { return framesDropped.load(std::memory_order_relaxed); }
+    unsigned long long writtenBytes() const { return bytesWritten.load(std::memory_order_relaxed); }
+
+private:
+    struct Frame
+    {
+        std::vector<glm::dvec3> position;
+        double simTime = 0.0;
+        uint64_t step = 0;
+    };
+
+    static const unsigned int RING_SIZE = 8;
+    Frame ring[RING_SIZE];
+    std::atomic<uint64_t> head{0};          // next slot the producer fills
+    std::atomic<uint64_t> tail{0};          // next slot the writer drains
+    std::atomic<bool> active{false};
+    std::atomic<bool> stopRequested{false};
+    std::atomic<unsigned long long> framesWritten{0};
+    std::atomic<unsigned long long> framesDropped{0};
+    std::atomic<unsigned long long> bytesWritten{0};
+    Options options;
+    std::vector<uint32_t> recordedIds;
+    std::thread writer;
+    FILE* file = nullptr;
+
+    // writer thread state
+    TrajectoryCodec codec;
+    std::vector<unsigned char> payload;
+    std::vector<double> chunkTimes;
+    uint64_t chunkFirstStep = 0;
+
+    // the recorded set changed: stop taking frames and let the writer finish what it has
+    void endRecording()
+    {
+        stopRequested.store(true, std::memory_order_release);
+        active.store(false, std::memory_order_release);
+    }
+
+    void writerLoop()
+    {
+        codec.reset(recordedIds.size(), options.quantum);
+        chunkTimes.clear();
+        payload.clear();
+        for (;;)
+        {
+            // the stop flag is read before the ring, so frames published before the stop are still drained
+            bool stopping = stopRequested.load(std::memory_order_acquire);
+            uint64_t t = tail.load(std::memory_order_relaxed);
+            if (t == head.load(std::memory_order_acquire))
+            {
+                if (stopping)
+                    break;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            const Frame& f = ring[t % RING_SIZE];
+            if (chunkTimes.empty())
+                chunkFirstStep = f.step;
+            chunkTimes.push_back(f.simTime);
+            codec.encode(f.position.data(), payload);
+            tail.store(t + 1, std::memory_order_release);
+            if (chunkTimes.size() >= options.framesPerChunk)
+                writeChunk();
+        }
+        writeChunk();
+        if (file)
+            std::fflush(file);
+    }
+
+    void writeChunk()
+    {
+        if (chunkTimes.empty() || !file)
+            return;
+        TrajectoryChunkHeader header{TRAJECTORY_CHUNK_MAGIC, static_cast<uint32_t>(chunkTimes.size()), chunkFirstStep, payload.size()};
+        std::fwrite(&header, sizeof(header), 1, file);
+        std::fwrite(chunkTimes.data(), sizeof(double), chunkTimes.size(), file);
+        std::fwrite(payload.data(), 1, payload.size(), file);
+        framesWritten.fetch_add(chunkTimes.size(), std::memory_order_relaxed);
+        bytesWritten.fetch_add(sizeof(header) + chunkTimes.size() * sizeof(double) + payload.size(), std::memory_order_relaxed);
+        chunkTimes.clear();
+        payload.clear();
+        codec.reset(recordedIds.size(), options.quantum);
+    }
+};
+
+#endif
@@ -0,0 +1,251 @@
+#ifndef UNIFORM_RING_H
+#define UNIFORM_RING_H
+
+#include <glad/glad.h>
+
+#include <gl_state_cache.h>
+#include <gl_debug.h>
+#include <gpu_memory.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+
+// Small uniform data written once per frame per draw, a model matrix or a camera, out of a persistently mapped
+// ring: a segment per frame in flight, carved front to back into slices aligned for glBindBufferRange, so a draw
+// binds its own slice instead of issuing glUniform calls and nothing a queued draw reads is overwritten.
+// beginFrame fences the segment the last frame wrote and waits only if the GPU is a full ring behind, like
+// StreamingBuffer. A frame that outgrows its segment waits for the GPU to read it and starts it over.
+class UniformRing
+{
+public:
+    static const unsigned int SEGMENTS = 3;
+
+    struct Slice
+    {
+        void* data = nullptr;
+        size_t offset = 0;
+        size_t size = 0;
+    };
+
+    explicit UniformRing(GpuMemoryCategory category = GPU_MEMORY_OTHER) : storage(category) {}
+    UniformRing(const UniformRing&) = delete;
+    UniformRing& operator=(const UniformRing&) = delete;
+
+    ~UniformRing()
+    {
+        release();
+    }
+
+    // at least segmentBytes per frame, rounded to whole slices of the offset alignment, that of uniform and of
+    // storage blocks both so a slice can be bound as either
+    void create(size_t segmentBytes, const char* label = "uniform ring")
+    {
+        release();
+        GLint offsetAlignment = 256, storageAlignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+        alignment = static_cast<size_t>(std::max(std::max(offsetAlignment, storageAlignment), 1));
+        this->segmentBytes = aligned(std::max<size_t>(segmentBytes, 1));
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        storage.create(GL_UNIFORM_BUFFER, label);
+        storage.storage(SEGMENTS * this->segmentBytes, nullptr, flags);
+        mapped = static_cast<uint8_t*>(glMapBufferRange(GL_UNIFORM_BUFFER, 0, SEGMENTS * this->segmentBytes, flags));
+        glState().bindBuffer(GL_UNIFORM_BUFFER, 0);
+        segment = 0;
+        used = 0;
+    }
+
+    // fences what the last frame wrote and moves to the next segment, once per frame before its first allocate
+    void beginFrame()
+    {
+        if (!mapped)
+            return;
+        if (frameBytes > 0)
+        {
+            if (fences[segment]) glDeleteSync(fences[segment]);
+            fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+        lastFrameBytes = frameBytes;
+        lastFrameSlices = frameSlices;
+        frameBytes = 0;
+        frameSlices = 0;
+        segment = (segment + 1) % SEGMENTS;
+        waitFor(fences[segment]);
+        used = 0;
+    }
+
+    // bytes of this frame's segment to write before the draw that binds them is issued; data is null before create
+    // or for more than a segment
+    Slice allocate(size_t bytes)
+    {
+        Slice slice;
+        const size_t size = aligned(bytes);
+        if (!mapped || size > segmentBytes)
+            return slice;
+        if (used + size > segmentBytes)
+        {
+            GLsync drained = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            waitFor(drained);
+            used = 0;
+            overflows++;
+        }
+        slice.offset = segment * segmentBytes + used;
+        slice.data = mapped + slice.offset;
+        slice.size = bytes;
+        used += size;
+        frameBytes += size;
+        frameSlices++;
+        return slice;
+    }
+
+    // a copy of value in a new slice
+    template <typename T>
+    Slice push(const T& value)
+    {
+        Slice slice = allocate(sizeof(T));
+        if (slice.data)
+            std::memcpy(slice.data, &value, sizeof(T));
+        return slice;
+    }
+
+    void bind(unsigned int binding, const Slice& slice) const
+    {
+        if (slice.data)
+            glState().bindBufferRange(GL_UNIFORM_BUFFER, binding, storage.id(), slice.offset, slice.size);
+    }
+
+    // the slice as a shader storage block, an array of records
+    void bindStorage(unsigned int binding, const Slice& slice) const
+    {
+        if (slice.data)
+            glState().bindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, storage.id(), slice.offset, slice.size);
+    }
+
+    size_t bytesLastFrame() const { return lastFrameBytes; }
+    unsigned int slicesLastFrame() const { return lastFrameSlices; }
+    // frames that filled their segment and waited for the GPU, since create
+    unsigned int overflowCount() const { return overflows; }
+    bool valid() const { return mapped != nullptr; }
+
+    void release()
+    {
+        for (GLsync& fence : fences)
+        {
+            if (fence) glDeleteSync(fence);
+            fence = nullptr;
+        }
+        if (storage.valid())
+        {
+            glState().bindBuffer(GL_UNIFORM_BUFFER, storage.id());
+            if (mapped) glUnmapBuffer(GL_UNIFORM_BUFFER);
+            glState().bindBuffer(GL_UNIFORM_BUFFER, 0);
+        }
+        storage.release();
+        mapped = nullptr;
+        used = frameBytes = 0;
+        frameSlices = 0;
+    }
+
+private:
+    GlBuffer storage;
+    uint8_t* mapped = nullptr;
+    size_t alignment = 256;
+    size_t segmentBytes = 0;
+    size_t used = 0;
+    size_t frameBytes = 0;
+    size_t lastFrameBytes = 0;
+    unsigned int segment = 0;
+    unsigned int frameSlices = 0;
+    unsigned int lastFrameSlices = 0;
+    unsigned int overflows = 0;
+    GLsync fences[SEGMENTS] = {nullptr, nullptr, nullptr};
+
+    size_t aligned(size_t bytes) const
+    {
+        return (bytes + alignment - 1) / alignment * alignment;
+    }
+
+    static void waitFor(GLsync& fence)
+    {
+        if (!fence)
+            return;
+        // flush on the first wait in case the fence has not been submitted yet
+        GLbitfield waitFlags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        for (;;)
+        {
+            const GLenum result = glClientWaitSync(fence, waitFlags, 1000000);
+            if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED)
+                break;
+            waitFlags = 0;
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+};
+
+// A uniform block that is mostly the same from frame to frame, the lights: the bytes last uploaded are kept and
+// upload sends only the span from the first to the last that changed, in 16-byte steps (a std140 vec4), or
+// nothing. The buffer is an ordinary one, glBufferSubData orders the write after the draws that read the old data.
+class UniformMirror
+{
+public:
+    explicit UniformMirror(GpuMemoryCategory category = GPU_MEMORY_OTHER) : storage(category) {}
+    UniformMirror(const UniformMirror&) = delete;
+    UniformMirror& operator=(const UniformMirror&) = delete;
+
+    void create(size_t bytes, unsigned int binding, const char* label)
+    {
+        storage.create(GL_UNIFORM_BUFFER, label);
+        storage.storage(bytes, nullptr, GL_DYNAMIC_STORAGE_BIT);
+        glState().bindBuffer(GL_UNIFORM_BUFFER, 0);
+        glState().bindBufferBase(GL_UNIFORM_BUFFER, binding, storage.id());
+        shadow.assign(bytes, 0);
+        uploaded = false;
+    }
+
+    // the bytes uploaded, 0 when nothing changed
+    template <typename T>
+    size_t upload(const T& value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "a uniform block is plain data");
+        const size_t bytes = std::min(sizeof(T), shadow.size());
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(&value);
+        size_t first = 0, last = bytes;
+        if (uploaded)
+        {
+            while (first < bytes && data[first] == shadow[first]) first++;
+            if (first == bytes)
+                return lastBytes = 0;
+            while (last > first && data[last - 1] == shadow[last - 1]) last--;
+            first = first / 16 * 16;
+            last = std::min(bytes, (last + 15) / 16 * 16);
+        }
+        std::memcpy(shadow.data() + first, data + first, last - first);
+        glState().bindBuffer(GL_UNIFORM_BUFFER, storage.id());
+        glBufferSubData(GL_UNIFORM_BUFFER, static_cast<GLintptr>(first), static_cast<GLsizeiptr>(last - first), data + first);
+        uploaded = true;
+        return lastBytes = last - first;
+    }
+
+    size_t lastUploadBytes() const { return lastBytes; }
+    unsigned int id() const { return storage.id(); }
+
+    void release()
+    {
+        storage.release();
+        shadow.clear();
+        uploaded = false;
+    }
+
+private:
+    GlBuffer storage;
+    std::vector<uint8_t> shadow;
+    size_t lastBytes = 0;
+    bool uploaded = false;
+};
+
+#endif
@@ -0,0 +1,270 @@
+#ifndef VERTEX_LAYOUT_H
+#define VERTEX_LAYOUT_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+#include <gtc/packing.hpp>
+#include <gpu_memory.h>
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#define MAX_BONE_INFLUENCE 4
+
+struct Vertex
+{
+    glm::vec3 Position;
+    glm::vec3 Normal;
+    glm::vec2 TexCoords;
+    glm::vec3 Tangent;
+    glm::vec3 Bitangent;
+    int m_BoneIDs[MAX_BONE_INFLUENCE];
+    float m_Weights[MAX_BONE_INFLUENCE];
+};
+
+// How a mesh's vertices are stored on the GPU, chosen per asset. The CPU side always keeps the full Vertex. The
+// attribute locations stay the same in every layout (0 position, 1 normal, 2 UV, 3 tangent, 4 bitangent, 5 bone
+// ids, 6 weights) and the packed formats are normalized, so shaders read them unchanged; attributes a layout
+// drops read as their default (0, 0, 0, 1).
+enum VertexLayout {
+    VERTEX_LAYOUT_FULL = 0,     // Vertex as it is, 88 bytes, for skinned meshes
+    VERTEX_LAYOUT_STATIC = 1,   // without the bone data, 56 bytes
+    VERTEX_LAYOUT_PACKED = 2    // float position, 10:10:10:2 normal and tangent (w the bitangent's handedness), half UVs, 24 bytes
+};
+
+struct StaticVertex
+{
+    glm::vec3 Position;
+    glm::vec3 Normal;
+    glm::vec2 TexCoords;
+    glm::vec3 Tangent;
+    glm::vec3 Bitangent;
+};
+
+struct PackedVertex
+{
+    glm::vec3 Position;
+    uint32_t Normal;        // GL_INT_2_10_10_10_REV
+    uint32_t Tangent;       // GL_INT_2_10_10_10_REV, w = +-1
+    uint32_t TexCoords;     // two halves, u in the low bits
+};
+
+// One attribute of a vertex format: where the shader reads it, how GL fetches it from the vertex and what the
+// shader declares it as. GL converts the fetched components to the declared type, a 4-component normal feeds a
+// vec3 aNormal.
+struct VertexAttribute
+{
+    unsigned int location;
+    int components;
+    GLenum type;
+    bool normalized;
+    bool integer;               // glVertexAttribIPointer, an ivec in the shader
+    size_t offset;
+    const char* declaration;    // type and name in the shader, "vec3 aPos"
+};
+
+// The formats as compile-time attribute tables, one specialization per layout with the vertex it stores (Type),
+// its attributes and how a Vertex is packed into it. The VAO setup, the GLSL inputs and the checks below are all
+// generated from the table; a new layout is an enum value, a vertex struct and a specialization, and code that
+// already knows its layout uses the templates directly, without going through withVertexFormat.
+template <VertexLayout L>
+struct VertexFormat;
+
+template <>
+struct VertexFormat<VERTEX_LAYOUT_FULL>
+{
+    typedef Vertex Type;
+    static constexpr VertexAttribute attributes[] = {
+        {0, 3, GL_FLOAT, false, false, offsetof(Vertex, Position), "vec3 aPos"},
+        {1, 3, GL_FLOAT, false, false, offsetof(Vertex, Normal), "vec3 aNormal"},
+        {2, 2, GL_FLOAT, false, false, offsetof(Vertex, TexCoords), "vec2 aTexCoords"},
+        {3, 3, GL_FLOAT, false, false, offsetof(Vertex, Tangent), "vec3 aTangent"},
+        {4, 3, GL_FLOAT, false, false, offsetof(Vertex, Bitangent), "vec3 aBitangent"},
+        {5, MAX_BONE_INFLUENCE, GL_INT, false, true, offsetof(Vertex, m_BoneIDs), "ivec4 aBoneIds"},
+        {6, MAX_BONE_INFLUENCE, GL_FLOAT, false, false, offsetof(Vertex, m_Weights), "vec4 aWeights"},
+    };
+    static void pack(const Vertex& in, Vertex& out) { out = in; }
+};
+
+template <>
+struct VertexFormat<VERTEX_LAYOUT_STATIC>
+{
+    typedef StaticVertex Type;
+    static constexpr VertexAttribute attributes[] = {
+        {0, 3, GL_FLOAT, false, false, offsetof(StaticVertex, Position), "vec3 aPos"},
+        {1, 3, GL_FLOAT, false, false, offsetof(StaticVertex, Normal), "vec3 aNormal"},
+        {2, 2, GL_FLOAT, false, false, offsetof(StaticVertex, TexCoords), "vec2 aTexCoords"},
+        {3, 3, GL_FLOAT, false, false, offsetof(StaticVertex, Tangent), "vec3 aTangent"},
+        {4, 3, GL_FLOAT, false, false, offsetof(StaticVertex, Bitangent), "vec3 aBitangent"},
+    };
+    static void pack(const Vertex& in, StaticVertex& out)
+    {
+        out = StaticVertex{in.Position, in.Normal, in.TexCoords, in.Tangent, in.Bitangent};
+    }
+};
+
+template <>
+struct VertexFormat<VERTEX_LAYOUT_PACKED>
+{
+    typedef PackedVertex Type;
+    static constexpr VertexAttribute attributes[] = {
+        {0, 3, GL_FLOAT, false, false, offsetof(PackedVertex, Position), "vec3 aPos"},
+        {1, 4, GL_INT_2_10_10_10_REV, true, false, offsetof(PackedVertex, Normal), "vec3 aNormal"},
+        {2, 2, GL_HALF_FLOAT, false, false, offsetof(PackedVertex, TexCoords), "vec2 aTexCoords"},
+        {3, 4, GL_INT_2_10_10_10_REV, true, false, offsetof(PackedVertex, Tangent), "vec4 aTangent"},     // w the handedness
+    };
+    static void pack(const Vertex& in, PackedVertex& out)
+    {
+        const float handedness = glm::dot(glm::cross(in.Normal, in.Tangent), in.Bitangent) < 0.0f ? -1.0f : 1.0f;
+        out.Position = in.Position;
+        out.Normal = glm::packSnorm3x10_1x2(glm::vec4(in.Normal, 0.0f));
+        out.Tangent = glm::packSnorm3x10_1x2(glm::vec4(in.Tangent, handedness));
+        out.TexCoords = glm::packHalf2x16(in.TexCoords);
+    }
+};
+
+// bytes of one attribute in the vertex
+constexpr size_t attributeBytes(const VertexAttribute& a)
+{
+    return a.type == GL_INT_2_10_10_10_REV ? 4
+         : static_cast<size_t>(a.components) * (a.type == GL_HALF_FLOAT ? 2 : 4);
+}
+
+// every attribute inside the vertex, 4-byte aligned as GL wants offsets and strides, at a location of its own and
+// clear of the others' bytes
+template <typename Format>
+constexpr bool validVertexFormat()
+{
+    const size_t count = sizeof(Format::attributes) / sizeof(VertexAttribute);
+    const size_t stride = sizeof(typename Format::Type);
+    if (stride % 4 != 0)
+        return false;
+    for (size_t a = 0; a < count; a++)
+    {
+        const VertexAttribute& x = Format::attributes[a];
+        if (x.offset % 4 != 0 || x.offset + attributeBytes(x) > stride || x.location >= 16)
+            return false;
+        for (size_t b = a + 1; b < count; b++)
+        {
+            const VertexAttribute& y = Format::attributes[b];
+            if (x.location == y.location || (x.offset < y.offset + attributeBytes(y) && y.offset < x.offset + attributeBytes(x)))
+                return false;
+        }
+    }
+    return true;
+}
+
+static_assert(validVertexFormat<VertexFormat<VERTEX_LAYOUT_FULL>>(), "bad VERTEX_LAYOUT_FULL attributes");
+static_assert(validVertexFormat<VertexFormat<VERTEX_LAYOUT_STATIC>>(), "bad VERTEX_LAYOUT_STATIC attributes");
+static_assert(validVertexFormat<VertexFormat<VERTEX_LAYOUT_PACKED>>(), "bad VERTEX_LAYOUT_PACKED attributes");
+static_assert(sizeof(Vertex) == 88 && sizeof(StaticVertex) == 56 && sizeof(PackedVertex) == 24, "vertex sizes the layouts are documented with");
+
+// calls fn with the VertexFormat of a runtime layout, once per buffer or VAO rather than per vertex
+template <typename Fn>
+inline auto withVertexFormat(VertexLayout layout, const Fn& fn)
+{
+    switch (layout)
+    {
+    case VERTEX_LAYOUT_PACKED:
+        return fn(VertexFormat<VERTEX_LAYOUT_PACKED>());
+    case VERTEX_LAYOUT_STATIC:
+        return fn(VertexFormat<VERTEX_LAYOUT_STATIC>());
+    default:
+        return fn(VertexFormat<VERTEX_LAYOUT_FULL>());
+    }
+}
+
+inline size_t vertexSize(VertexLayout layout)
+{
+    return withVertexFormat(layout, [](auto format) { return sizeof(typename decltype(format)::Type); });
+}
+
+// the vertices in the format, as the bytes of the vertex buffer
+template <typename Format>
+inline std::vector<uint8_t> packVertices(const std::vector<Vertex>& vertices)
+{
+    typedef typename Format::Type Packed;
+    std::vector<uint8_t> bytes(vertices.size() * sizeof(Packed));
+    for (size_t v = 0; v < vertices.size(); v++)
+    {
+        Packed packed;
+        Format::pack(vertices[v], packed);
+        std::memcpy(bytes.data() + v * sizeof(Packed), &packed, sizeof(packed));
+    }
+    return bytes;
+}
+
+inline std::vector<uint8_t> packVertices(const std::vector<Vertex>& vertices, VertexLayout layout)
+{
+    return withVertexFormat(layout, [&](auto format) { return packVertices<decltype(format)>(vertices); });
+}
+
+// points the bound VAO's attributes at the bound GL_ARRAY_BUFFER, vertices of the format starting at byte 0
+template <typename Format>
+inline void setVertexAttributes()
+{
+    const GLsizei stride = static_cast<GLsizei>(sizeof(typename Format::Type));
+    for (const VertexAttribute& a : Format::attributes)
+    {
+        glEnableVertexAttribArray(a.location);
+        if (a.integer)
+            glVertexAttribIPointer(a.location, a.components, a.type, stride, reinterpret_cast<void*>(a.offset));
+        else
+            glVertexAttribPointer(a.location, a.components, a.type, a.normalized ? GL_TRUE : GL_FALSE, stride, reinterpret_cast<void*>(a.offset));
+    }
+}
+
+inline void setVertexAttributes(VertexLayout layout)
+{
+    withVertexFormat(layout, [](auto format) { setVertexAttributes<decltype(format)>(); });
+}
+
+// The format's inputs as GLSL declarations on one line, for a vertex shader that takes them from the VERTEX_INPUTS
+// define instead of declaring its own, so each layout's permutation declares exactly what the VAO feeds it
+template <typename Format>
+inline std::string vertexInputs()
+{
+    std::string declarations;
+    for (const VertexAttribute& a : Format::attributes)
+        declarations += "layout(location = " + std::to_string(a.location) + ") in " + a.declaration + "; ";
+    return declarations;
+}
+
+// the VERTEX_INPUTS define of a layout, an entry for a ShaderDefines
+inline std::pair<std::string, std::string> vertexInputsDefine(VertexLayout layout)
+{
+    return {"VERTEX_INPUTS", withVertexFormat(layout, [](auto format) { return vertexInputs<decltype(format)>(); })};
+}
+
+// The position-only stream depth and shadow passes may draw from instead, 12 bytes a vertex whatever the layout,
+// at location 0 like every layout's position and from the same floats, so a pre-pass drawn from it and a shaded
+// pass drawn from the full vertices land on the same depths
+inline std::vector<glm::vec3> packPositions(const std::vector<Vertex>& vertices)
+{
+    std::vector<glm::vec3> positions(vertices.size());
+    for (size_t v = 0; v < vertices.size(); v++)
+        positions[v] = vertices[v].Position;
+    return positions;
+}
+
+// points the bound VAO's position at the bound GL_ARRAY_BUFFER of packPositions
+inline void setPositionAttribute()
+{
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, static_cast<GLsizei>(sizeof(glm::vec3)), nullptr);
+}
+
+// gives buffer, created and bound to GL_ARRAY_BUFFER, immutable storage of the vertices in the given layout and
+// points the bound VAO's attributes at it
+inline void uploadVertices(GlBuffer& buffer, const std::vector<Vertex>& vertices, VertexLayout layout)
+{
+    const std::vector<uint8_t> bytes = packVertices(vertices, layout);
+    buffer.storage(bytes.size(), bytes.data(), 0);
+    setVertexAttributes(layout);
+}
+
+#endif
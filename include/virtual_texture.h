@@ -0,0 +1,909 @@
+#ifndef VIRTUAL_TEXTURE_H
+#define VIRTUAL_TEXTURE_H
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include <shader.h>
+#include <asset_archive.h>
+#include <texture_image.h>
+#include <gpu_memory.h>
+#include <gl_state_cache.h>
+#include <gl_debug.h>
+#include <profiler.h>
+#include <stb_image.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <iostream>
+
+// The tiled file a virtual texture streams from: one equirectangular image cooked into TILE x TILE pages with a
+// BORDER of neighbouring texels around each, every mip level down to a single page, uncompressed RGBA8 so a page
+// is a read and a copy. Cooked next to its image (image + ".vt") and stamped with the image's identity like the
+// .ktx2 files of the texture cache, a changed image is cooked again. Levels are stored finest first, each page
+// row by row; pages past the image's edge at a level are not stored.
+namespace vtfile {
+
+static const char MAGIC[8] = {'N', 'P', 'S', 'C', 'V', 'T', '0', '1'};
+
+struct Header
+{
+    char magic[8];
+    uint32_t width;
+    uint32_t height;
+    uint32_t tile;
+    uint32_t border;
+    uint32_t sourceLength;      // bytes of the source stamp right after the header
+    uint32_t reserved;
+    uint64_t dataOffset;        // the first page, 4 KB aligned
+};
+
+static_assert(sizeof(Header) == 40, "virtual texture header layout");
+
+// where the pages of an image are, in the file and in the virtual page grid. The grid of level 0 is rounded up to
+// powers of two so every level's grid is its finer one's halved; a level's pages past the image are never used.
+struct Layout
+{
+    uint32_t width = 0, height = 0, tile = 0, border = 0;
+    uint32_t levels = 0;
+    uint32_t pagesX = 0, pagesY = 0;    // level 0's grid
+    std::vector<uint64_t> firstTile;    // per level, the stored pages before it
+    std::vector<uint32_t> firstPage;    // per level, the grid pages before it
+    uint64_t tiles = 0;
+    uint32_t pages = 0;
+
+    Layout() = default;
+    Layout(uint32_t w, uint32_t h, uint32_t t, uint32_t b) : width(w), height(h), tile(t), border(b)
+    {
+        pagesX = pagesY = 1;
+        while (pagesX * tile < width) pagesX *= 2;
+        while (pagesY * tile < height) pagesY *= 2;
+        levels = 1;
+        while ((std::max(pagesX, pagesY) >> (levels - 1)) > 1) levels++;
+        for (uint32_t l = 0; l < levels; l++)
+        {
+            firstTile.push_back(tiles);
+            firstPage.push_back(pages);
+            tiles += static_cast<uint64_t>(tilesX(l)) * tilesY(l);
+            pages += gridX(l) * gridY(l);
+        }
+    }
+
+    uint32_t levelWidth(uint32_t level) const { return std::max(1u, (width + (1u << level) - 1) >> level); }
+    uint32_t levelHeight(uint32_t level) const { return std::max(1u, (height + (1u << level) - 1) >> level); }
+    // stored pages of a level
+    uint32_t tilesX(uint32_t level) const { return (levelWidth(level) + tile - 1) / tile; }
+    uint32_t tilesY(uint32_t level) const { return (levelHeight(level) + tile - 1) / tile; }
+    // the level's virtual grid
+    uint32_t gridX(uint32_t level) const { return std::max(1u, pagesX >> level); }
+    uint32_t gridY(uint32_t level) const { return std::max(1u, pagesY >> level); }
+    uint32_t stride() const { return tile + 2 * border; }
+    size_t tileBytes() const { return static_cast<size_t>(stride()) * stride() * 4; }
+};
+
+inline std::string cookedPath(const std::string& image)
+{
+    return image + ".vt";
+}
+
+// decodes image and writes its pages to path, through a temporary file so an interrupted cook leaves nothing
+inline bool cook(const std::string& image, const std::string& path, const std::string& source, uint32_t tile,
+                 uint32_t border, std::string& error)
+{
+    PROFILE_SCOPE_DETAIL("cook virtual texture", image);
+    int w = 0, h = 0, components = 0;
+    stbi_set_flip_vertically_on_load_thread(false);
+    AssetFile encoded;
+    unsigned char* pixels = encoded.open(image.c_str(), true)
+        ? stbi_load_from_memory(encoded.data(), static_cast<int>(encoded.size()), &w, &h, &components, 4) : nullptr;
+    if (!pixels)
+    {
+        error = "cannot decode " + image;
+        return false;
+    }
+    const Layout layout(static_cast<uint32_t>(w), static_cast<uint32_t>(h), tile, border);
+    const std::string part = path + ".part";
+    std::ofstream out(part, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        stbi_image_free(pixels);
+        error = "cannot write " + part;
+        return false;
+    }
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.width = layout.width;
+    header.height = layout.height;
+    header.tile = tile;
+    header.border = border;
+    header.sourceLength = static_cast<uint32_t>(source.size());
+    header.dataOffset = (sizeof(Header) + source.size() + 4095) & ~uint64_t(4095);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(source.data(), static_cast<std::streamsize>(source.size()));
+    const std::vector<char> padding(header.dataOffset - sizeof(Header) - source.size(), 0);
+    out.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+
+    const uint32_t stride = layout.stride();
+    std::vector<uint8_t> page(layout.tileBytes());
+    std::vector<uint8_t> level, next;
+    const uint8_t* src = pixels;
+    for (uint32_t l = 0; l < layout.levels; l++)
+    {
+        const int lw = static_cast<int>(layout.levelWidth(l)), lh = static_cast<int>(layout.levelHeight(l));
+        for (uint32_t ty = 0; ty < layout.tilesY(l); ty++)
+            for (uint32_t tx = 0; tx < layout.tilesX(l); tx++)
+            {
+                // the border from the neighbours: the longitude wraps, the latitude stops at the poles
+                for (uint32_t r = 0; r < stride; r++)
+                {
+                    const int sy = std::clamp(static_cast<int>(ty * tile + r) - static_cast<int>(border), 0, lh - 1);
+                    for (uint32_t c = 0; c < stride; c++)
+                    {
+                        const int sx = ((static_cast<int>(tx * tile + c) - static_cast<int>(border)) % lw + lw) % lw;
+                        std::memcpy(&page[(r * stride + c) * 4], src + (static_cast<size_t>(sy) * lw + sx) * 4, 4);
+                    }
+                }
+                out.write(reinterpret_cast<const char*>(page.data()), static_cast<std::streamsize>(page.size()));
+            }
+        if (l + 1 == layout.levels)
+            break;
+        // a 2x2 box down to the next level, the last row and column repeated on odd sizes
+        const int nw = static_cast<int>(layout.levelWidth(l + 1)), nh = static_cast<int>(layout.levelHeight(l + 1));
+        next.assign(static_cast<size_t>(nw) * nh * 4, 0);
+        for (int y = 0; y < nh; y++)
+        {
+            const int y0 = std::min(2 * y, lh - 1), y1 = std::min(2 * y + 1, lh - 1);
+            for (int x = 0; x < nw; x++)
+            {
+                const int x0 = std::min(2 * x, lw - 1), x1 = std::min(2 * x + 1, lw - 1);
+                for (int k = 0; k < 4; k++)
+                {
+                    const unsigned int sum = src[(static_cast<size_t>(y0) * lw + x0) * 4 + k] + src[(static_cast<size_t>(y0) * lw + x1) * 4 + k]
+                                           + src[(static_cast<size_t>(y1) * lw + x0) * 4 + k] + src[(static_cast<size_t>(y1) * lw + x1) * 4 + k];
+                    next[(static_cast<size_t>(y) * nw + x) * 4 + k] = static_cast<uint8_t>((sum + 2) / 4);
+                }
+            }
+        }
+        if (src == pixels)
+        {
+            stbi_image_free(pixels);
+            pixels = nullptr;
+        }
+        level.swap(next);
+        src = level.data();
+    }
+    if (pixels)
+        stbi_image_free(pixels);
+    out.close();
+    if (!out || std::rename(part.c_str(), path.c_str()) != 0)
+    {
+        std::remove(part.c_str());
+        error = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
+
+} // namespace vtfile
+
+// Tile-based virtual texturing for planet surfaces too large to upload (a 32k equirectangular image is 2.7 GB with
+// its mips). The image is cooked once into pages (vtfile above), and only the pages the view samples are on the
+// GPU. The shaders (shaders.2/virtual_texture.glsl) write the page each pixel needs into a feedback buffer; a copy
+// of it comes back a frame or two later behind a fence, and the pages asked for are read from the mapped file on
+// loader threads and uploaded, uploadsPerFrame at most, over the least recently used. Residency is kept closed
+// under parents (a page is placed only after its parent, only pages without resident children are evicted), so
+// the indirection texture can point every page, resident or not, at its finest resident ancestor and a pixel
+// always samples something, sharpening as the pages arrive. The coarsest level is loaded at open and never goes.
+// The pages live in one of two ways:
+//   sparse        with GL_ARB_sparse_texture and a 128 x 128 RGBA8 page size, in a sparse texture of the whole
+//                 image whose pages are committed and decommitted, filtered by the hardware across pages and mips;
+//                 the indirection only clamps the level to what is resident
+//   page cache    otherwise, in an atlas of cachePages x cachePages bordered pages that the indirection maps every
+//                 page into, filtered bilinearly inside the page and blended between two levels in the shader
+// VRAM then follows what is visible: the atlas or the committed pages, the indirection and the feedback buffer.
+class VirtualTexture
+{
+public:
+    static const unsigned int TILE = 128;
+    static const unsigned int BORDER = 4;
+    static const unsigned int MAX_LEVELS = 16;          // vtLevelOffsets of the shader
+    static const unsigned int PHYSICAL_UNIT = 20;       // layout(binding) of the pages, after the terrain's cubes
+    static const unsigned int INDIRECTION_UNIT = 21;
+    static const unsigned int BINDING_FEEDBACK = 29;
+
+    unsigned int uploadsPerFrame = 16;
+    unsigned int requestsPerFrame = 64;     // pages queued per feedback read, coarsest first
+    float lodBias = 0.0f;
+
+    VirtualTexture() = default;
+    VirtualTexture(const VirtualTexture&) = delete;
+    VirtualTexture& operator=(const VirtualTexture&) = delete;
+
+    ~VirtualTexture()
+    {
+        release();
+    }
+
+    // GL_ARB_sparse_texture, loaded by hand like the bindless entry points; call once after gladLoadGLLoader
+    static bool loadSparse(GLADloadproc loader)
+    {
+        SparseState& s = sparseState();
+        s.available = false;
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        bool listed = false;
+        for (GLint e = 0; e < count && !listed; e++)
+        {
+            const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(e)));
+            listed = name && std::strcmp(name, "GL_ARB_sparse_texture") == 0;
+        }
+        if (!listed)
+            return false;
+        s.pageCommitment = reinterpret_cast<TexPageCommitment>(loader("glTexPageCommitmentARB"));
+        s.available = s.pageCommitment != nullptr;
+        return s.available;
+    }
+
+    // The virtual texture of an equirectangular image, or of an already cooked .vt file. The image is cooked
+    // first when its .vt is missing or stale, which takes a while for a large one. False with error() set.
+    bool open(const std::string& image, unsigned int cachePages = 24, unsigned int threads = 2, bool allowSparse = true)
+    {
+        release();
+        GL_DEBUG_GROUP("virtual texture open");
+        const bool cooked = image.size() > 3 && image.compare(image.size() - 3, 3, ".vt") == 0;
+        const std::string path = cooked ? image : vtfile::cookedPath(image);
+        const std::string source = cooked ? std::string() : compressedTextureSource(image);
+        if (!cooked && source.empty())
+            return fail("cannot read " + image);
+        if (!mapFile(path, source))
+        {
+            std::cout << "cooking virtual texture " << path << std::endl;
+            std::string cookError;
+            if (!vtfile::cook(image, path, source, TILE, BORDER, cookError))
+                return fail(cookError);
+            if (!mapFile(path, source))
+                return fail("cannot read " + path);
+        }
+        if (layout.levels > MAX_LEVELS)
+            return fail(path + " has more levels than the shaders address");
+
+        slot.assign(layout.pages, -1);
+        lastUsed.assign(layout.pages, 0);
+        children.assign(layout.pages, 0);
+        flags.assign(layout.pages, 0);
+        table.assign(static_cast<size_t>(layout.pages) * 4, 0);
+        feedbackValues.assign(layout.pages, 0);
+
+        GLint maxSize = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+        cachePages = std::clamp(cachePages, 2u, std::min(255u, static_cast<unsigned int>(maxSize) / layout.stride()));
+        capacity = cachePages * cachePages;
+        isSparse = allowSparse && createSparse();
+        if (!isSparse)
+            createCache(cachePages);
+        createIndirection();
+        createFeedback();
+
+        // the levels that never go: the top, or with a sparse texture its whole mip tail
+        for (uint32_t l = pinnedLevel; l < layout.levels; l++)
+            for (uint32_t y = 0; y < layout.tilesY(l); y++)
+                for (uint32_t x = 0; x < layout.tilesX(l); x++)
+                {
+                    const uint32_t page = pageIndex(l, x, y);
+                    std::vector<uint8_t> data(layout.tileBytes());
+                    readTile(l, x, y, data.data());
+                    flags[page] |= PINNED;
+                    place(page, data.data());
+                }
+        rebuildIndirection();
+
+        stopping = false;
+        for (unsigned int t = 0; t < std::max(threads, 1u); t++)
+            loaders.emplace_back([this]() { loaderLoop(); });
+        return true;
+    }
+
+    bool isOpen() const { return file.isOpen(); }
+    bool sparse() const { return isSparse; }
+    const std::string& error() const { return lastError; }
+    unsigned int width() const { return layout.width; }
+    unsigned int height() const { return layout.height; }
+    unsigned int levels() const { return layout.levels; }
+    size_t residentPages() const { return resident.size(); }
+    unsigned int residentCapacity() const { return capacity; }
+    size_t loading() const { return inFlight; }
+    unsigned long uploads() const { return uploadCount; }
+    unsigned long evictions() const { return evictionCount; }
+    unsigned int feedbackLatency() const { return lastLatency; }
+    // what the pages take on the GPU now, and what the whole image would with its mips
+    size_t gpuBytes() const { return physical.bytes() + indirection.bytes() + feedback.bytes() + readback.bytes(); }
+    size_t virtualBytes() const
+    {
+        size_t total = 0;
+        for (uint32_t l = 0; l < layout.levels; l++)
+            total += static_cast<size_t>(layout.levelWidth(l)) * layout.levelHeight(l) * 4;
+        return total;
+    }
+
+    // Once per frame on the GL thread, before the draws: the pages of the last feedback that arrived are queued
+    // and the loaded ones placed.
+    void update()
+    {
+        if (!isOpen())
+            return;
+        if (pollFeedback())
+        {
+            generation++;
+            queueRequested();
+        }
+        placeLoaded();
+        if (dirty)
+            rebuildIndirection();
+    }
+
+    // the pages, the indirection and the feedback buffer for a shader with virtual_texture.glsl, in use
+    void bind(Shader& shader)
+    {
+        if (!isOpen())
+            return;
+        glState().activeTexture(GL_TEXTURE0 + PHYSICAL_UNIT);
+        glState().bindTexture(GL_TEXTURE_2D, physical.id());
+        glState().activeTexture(GL_TEXTURE0 + INDIRECTION_UNIT);
+        glState().bindTexture(GL_TEXTURE_2D, indirection.id());
+        glState().activeTexture(GL_TEXTURE0);
+        glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_FEEDBACK, feedback.id());
+        shader.setVec2("vtImageSize", glm::vec2(layout.width, layout.height));
+        shader.setVec2("vtPaddedScale", glm::vec2(static_cast<float>(layout.width) / (layout.pagesX * TILE),
+                                                  static_cast<float>(layout.height) / (layout.pagesY * TILE)));
+        shader.setFloat("vtTileSize", static_cast<float>(TILE));
+        shader.setFloat("vtBorder", static_cast<float>(BORDER));
+        shader.setInt("vtLevels", static_cast<int>(layout.levels));
+        shader.setUInt("vtStamp", stamp);
+        shader.setFloat("vtLodBias", lodBias);
+        shader.setBool("vtSparse", isSparse);
+        for (uint32_t l = 0; l < layout.levels; l++)
+            shader.setUInt("vtLevelOffsets[" + std::to_string(l) + "]", layout.firstPage[l]);
+    }
+
+    // after the frame's draws: a copy of the feedback to read back, unless one is still on its way
+    void requestFeedback()
+    {
+        if (!isOpen())
+            return;
+        if (fence == nullptr)
+        {
+            GL_DEBUG_GROUP("virtual texture feedback");
+            glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+            glCopyNamedBufferSubData(feedback.id(), readback.id(), 0, 0, static_cast<GLsizeiptr>(layout.pages * sizeof(uint32_t)));
+            fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            copiedStamp = stamp;
+            framesWaited = 0;
+        }
+        // stamps of frames that were not copied are never looked for
+        stamp++;
+    }
+
+    void release()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& t : loaders)
+            t.join();
+        loaders.clear();
+        queue.clear();
+        finished.clear();
+        waiting.clear();
+        if (fence) glDeleteSync(fence);
+        fence = nullptr;
+        physical.release();
+        indirection.release();
+        feedback.release();
+        readback.release();
+        file.close();
+        slot.clear();
+        lastUsed.clear();
+        children.clear();
+        flags.clear();
+        table.clear();
+        slotPage.clear();
+        freeSlots.clear();
+        resident.clear();
+        inFlight = 0;
+        isSparse = false;
+    }
+
+private:
+    typedef void (APIENTRYP TexPageCommitment)(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset,
+                                               GLsizei width, GLsizei height, GLsizei depth, GLboolean commit);
+    // GL_ARB_sparse_texture's enums, the bundled glad has none
+    static const GLenum TEXTURE_SPARSE = 0x91A6;
+    static const GLenum VIRTUAL_PAGE_SIZE_X = 0x9195;
+    static const GLenum VIRTUAL_PAGE_SIZE_Y = 0x9196;
+    static const GLenum MAX_SPARSE_TEXTURE_SIZE = 0x9198;
+    static const GLenum NUM_VIRTUAL_PAGE_SIZES = 0x91A8;
+    static const GLenum NUM_SPARSE_LEVELS = 0x91AA;
+
+    struct SparseState
+    {
+        bool available = false;
+        TexPageCommitment pageCommitment = nullptr;
+    };
+    static SparseState& sparseState()
+    {
+        static SparseState s;
+        return s;
+    }
+
+    enum : uint8_t { LOADING = 1, PINNED = 2 };
+
+    struct Loaded
+    {
+        uint32_t page;
+        uint32_t level;
+        std::vector<uint8_t> data;
+    };
+
+    AssetFile file;
+    vtfile::Layout layout;
+    uint64_t dataOffset = 0;
+    std::string lastError;
+    bool isSparse = false;
+    uint32_t pinnedLevel = 0;           // it and the levels above are loaded at open and kept
+    uint32_t tailLevel = 0;             // the sparse texture's first level smaller than a page
+    unsigned int capacity = 0;          // resident pages at most
+    unsigned int cacheSide = 0;         // the atlas's pages per side
+
+    GlTexture physical{GPU_MEMORY_TEXTURES};
+    GlTexture indirection{GPU_MEMORY_TEXTURES};
+    GlBuffer feedback{GPU_MEMORY_OTHER};
+    GlBuffer readback{GPU_MEMORY_OTHER};
+    GLsync fence = nullptr;
+    uint32_t stamp = 1;                 // what this frame's pixels write
+    uint32_t copiedStamp = 0;           // what the copy on its way looks for
+    unsigned int framesWaited = 0;
+    unsigned int lastLatency = 0;
+    std::vector<uint32_t> feedbackValues;
+
+    // per page of the virtual grid
+    std::vector<int32_t> slot;          // where it is resident, -1 if not
+    std::vector<uint32_t> lastUsed;     // the feedback it was last asked for in, or a descendant was
+    std::vector<uint8_t> children;      // resident children
+    std::vector<uint8_t> flags;
+    std::vector<uint8_t> table;         // the indirection: x, y of the resident page in the atlas, its level, 1
+    std::vector<uint32_t> slotPage;     // per slot, the page in it
+    std::vector<int32_t> freeSlots;
+    std::vector<uint32_t> resident;     // pages with a slot, unordered
+    uint32_t generation = 0;            // feedback reads that arrived
+    bool dirty = false;
+    size_t inFlight = 0;
+    unsigned long uploadCount = 0;
+    unsigned long evictionCount = 0;
+    std::vector<Loaded> waiting;        // loaded before their parent
+
+    std::vector<std::thread> loaders;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Loaded> queue;           // data empty until loaded
+    std::deque<Loaded> finished;
+    bool stopping = false;
+
+    bool fail(const std::string& message)
+    {
+        lastError = message;
+        release();
+        return false;
+    }
+
+    // the file at path if it is a cooked file of source (of anything for an empty source)
+    bool mapFile(const std::string& path, const std::string& source)
+    {
+        if (!file.open(path.c_str()))
+            return false;
+        vtfile::Header header;
+        bool ok = file.size() >= sizeof(header);
+        if (ok)
+        {
+            std::memcpy(&header, file.data(), sizeof(header));
+            ok = std::memcmp(header.magic, vtfile::MAGIC, sizeof(vtfile::MAGIC)) == 0 && header.tile == TILE && header.border == BORDER
+              && sizeof(header) + header.sourceLength <= file.size();
+        }
+        if (ok && !source.empty())
+            ok = std::string(reinterpret_cast<const char*>(file.data()) + sizeof(header), header.sourceLength) == source;
+        if (ok)
+        {
+            layout = vtfile::Layout(header.width, header.height, header.tile, header.border);
+            dataOffset = header.dataOffset;
+            ok = header.width > 0 && header.height > 0 && dataOffset + layout.tiles * layout.tileBytes() <= file.size();
+        }
+        if (!ok)
+            file.close();
+        return ok;
+    }
+
+    uint32_t pageIndex(uint32_t level, uint32_t x, uint32_t y) const
+    {
+        return layout.firstPage[level] + y * layout.gridX(level) + x;
+    }
+
+    uint32_t levelOf(uint32_t page) const
+    {
+        uint32_t l = 0;
+        while (l + 1 < layout.levels && layout.firstPage[l + 1] <= page) l++;
+        return l;
+    }
+
+    // the page's parent, or the page itself at the top
+    uint32_t parentOf(uint32_t page, uint32_t level) const
+    {
+        if (level + 1 >= layout.levels)
+            return page;
+        const uint32_t local = page - layout.firstPage[level];
+        const uint32_t x = local % layout.gridX(level), y = local / layout.gridX(level);
+        return pageIndex(level + 1, x >> 1, y >> 1);
+    }
+
+    bool stored(uint32_t page, uint32_t level) const
+    {
+        const uint32_t local = page - layout.firstPage[level];
+        return local % layout.gridX(level) < layout.tilesX(level) && local / layout.gridX(level) < layout.tilesY(level);
+    }
+
+    void readTile(uint32_t level, uint32_t x, uint32_t y, uint8_t* out) const
+    {
+        const uint64_t tile = layout.firstTile[level] + static_cast<uint64_t>(y) * layout.tilesX(level) + x;
+        std::memcpy(out, file.data() + dataOffset + tile * layout.tileBytes(), layout.tileBytes());
+    }
+
+    bool createSparse()
+    {
+        const SparseState& s = sparseState();
+        if (!s.available)
+            return false;
+        GLint sizes = 0, pageX = 0, pageY = 0, maxSize = 0;
+        glGetInternalformativ(GL_TEXTURE_2D, GL_RGBA8, NUM_VIRTUAL_PAGE_SIZES, 1, &sizes);
+        if (sizes <= 0)
+            return false;
+        glGetInternalformativ(GL_TEXTURE_2D, GL_RGBA8, VIRTUAL_PAGE_SIZE_X, 1, &pageX);
+        glGetInternalformativ(GL_TEXTURE_2D, GL_RGBA8, VIRTUAL_PAGE_SIZE_Y, 1, &pageY);
+        glGetIntegerv(MAX_SPARSE_TEXTURE_SIZE, &maxSize);
+        const unsigned int side = std::max(layout.pagesX, layout.pagesY) * TILE;
+        if (pageX != static_cast<GLint>(TILE) || pageY != static_cast<GLint>(TILE) || side > static_cast<unsigned int>(maxSize))
+            return false;
+        physical.create(GL_TEXTURE_2D, "virtual texture (sparse)");
+        glTexParameteri(GL_TEXTURE_2D, TEXTURE_SPARSE, GL_TRUE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexStorage2D(GL_TEXTURE_2D, static_cast<GLsizei>(layout.levels), GL_RGBA8, layout.pagesX * TILE, layout.pagesY * TILE);
+        GLint sparseLevels = 0;
+        glGetTexParameteriv(GL_TEXTURE_2D, NUM_SPARSE_LEVELS, &sparseLevels);
+        // the tail below the last level of whole pages is committed all at once, and kept
+        tailLevel = static_cast<uint32_t>(std::max(sparseLevels, 0));
+        pinnedLevel = std::min(tailLevel, layout.levels - 1);
+        if (tailLevel < layout.levels)
+            s.pageCommitment(GL_TEXTURE_2D, static_cast<GLint>(tailLevel), 0, 0, 0, levelSize(layout.pagesX, tailLevel),
+                             levelSize(layout.pagesY, tailLevel), 1, GL_TRUE);
+        slotPage.assign(capacity, UINT32_MAX);
+        for (int32_t i = static_cast<int32_t>(capacity) - 1; i >= 0; i--)
+            freeSlots.push_back(i);
+        physical.track(0);
+        return true;
+    }
+
+    // a level's texels along an axis of the sparse texture, whose level 0 is pages * TILE
+    static GLsizei levelSize(uint32_t pages, uint32_t level)
+    {
+        return std::max(1, static_cast<GLsizei>((pages * TILE) >> level));
+    }
+
+    void createCache(unsigned int side)
+    {
+        cacheSide = side;
+        pinnedLevel = layout.levels - 1;
+        physical.create(GL_TEXTURE_2D, "virtual texture page cache");
+        physical.storage2D(1, GL_RGBA8, side * layout.stride(), side * layout.stride());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        slotPage.assign(capacity, UINT32_MAX);
+        for (int32_t i = static_cast<int32_t>(capacity) - 1; i >= 0; i--)
+            freeSlots.push_back(i);
+    }
+
+    void createIndirection()
+    {
+        indirection.create(GL_TEXTURE_2D, "virtual texture indirection");
+        glTexStorage2D(GL_TEXTURE_2D, static_cast<GLsizei>(layout.levels), GL_RGBA8UI, layout.pagesX, layout.pagesY);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        indirection.track(table.size());
+    }
+
+    void createFeedback()
+    {
+        const std::vector<uint32_t> zeros(layout.pages, 0);
+        feedback.create(GL_SHADER_STORAGE_BUFFER, "virtual texture feedback");
+        feedback.storage(zeros.size() * sizeof(uint32_t), zeros.data(), 0);
+        readback.create(GL_COPY_WRITE_BUFFER, "virtual texture feedback readback");
+        readback.storage(zeros.size() * sizeof(uint32_t), nullptr, GL_CLIENT_STORAGE_BIT);
+        glState().bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        glState().bindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    // the latest copy if it arrived, never blocks
+    bool pollFeedback()
+    {
+        if (fence == nullptr)
+            return false;
+        framesWaited++;
+        const GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            return false;
+        glDeleteSync(fence);
+        fence = nullptr;
+        lastLatency = framesWaited;
+        glGetNamedBufferSubData(readback.id(), 0, static_cast<GLsizeiptr>(layout.pages * sizeof(uint32_t)), feedbackValues.data());
+        return true;
+    }
+
+    // every page asked for and its ancestors are in use; the missing ones on the way to each are queued
+    void queueRequested()
+    {
+        std::vector<std::pair<uint32_t, uint32_t>> missing;     // level, page
+        for (uint32_t l = 0; l < layout.levels; l++)
+            for (uint32_t page = layout.firstPage[l]; page < layout.firstPage[l] + layout.gridX(l) * layout.gridY(l); page++)
+            {
+                if (feedbackValues[page] != copiedStamp || !stored(page, l))
+                    continue;
+                uint32_t p = page, level = l;
+                for (;;)
+                {
+                    const bool seen = lastUsed[p] == generation;
+                    lastUsed[p] = generation;
+                    if (slot[p] < 0 && !(flags[p] & LOADING) && !seen)
+                        missing.emplace_back(level, p);
+                    const uint32_t parent = parentOf(p, level);
+                    if (seen || parent == p)
+                        break;
+                    p = parent;
+                    level++;
+                }
+            }
+        if (missing.empty())
+            return;
+        // coarse first, a finer page cannot be placed before them
+        std::sort(missing.begin(), missing.end(), [](const std::pair<uint32_t, uint32_t>& a, const std::pair<uint32_t, uint32_t>& b) {
+            return a.first != b.first ? a.first > b.first : a.second < b.second;
+        });
+        const size_t room = inFlight < 4 * size_t(requestsPerFrame) ? 4 * size_t(requestsPerFrame) - inFlight : 0;
+        const size_t count = std::min({missing.size(), size_t(requestsPerFrame), room});
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t i = 0; i < count; i++)
+            {
+                flags[missing[i].second] |= LOADING;
+                queue.push_back(Loaded{missing[i].second, missing[i].first, {}});
+            }
+        }
+        inFlight += count;
+        wake.notify_all();
+    }
+
+    void placeLoaded()
+    {
+        std::vector<Loaded> ready;
+        ready.swap(waiting);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            while (!finished.empty())
+            {
+                ready.push_back(std::move(finished.front()));
+                finished.pop_front();
+            }
+        }
+        if (ready.empty())
+            return;
+        std::stable_sort(ready.begin(), ready.end(), [](const Loaded& a, const Loaded& b) { return a.level > b.level; });
+        unsigned int placed = 0;
+        for (Loaded& loaded : ready)
+        {
+            const uint32_t page = loaded.page;
+            const uint32_t parent = parentOf(page, loaded.level);
+            if (slot[page] >= 0)
+            {
+                finishLoad(page);
+                continue;
+            }
+            // a page whose parent is still coming waits for it, one over the budget for the next frame
+            if (parent != page && slot[parent] < 0)
+            {
+                if (flags[parent] & LOADING)
+                    waiting.push_back(std::move(loaded));
+                else
+                    finishLoad(page);
+                continue;
+            }
+            if (placed >= uploadsPerFrame)
+            {
+                waiting.push_back(std::move(loaded));
+                continue;
+            }
+            // dropped when every slot is in use, the feedback asks again
+            if (place(page, loaded.data.data()))
+                placed++;
+            finishLoad(page);
+        }
+    }
+
+    void finishLoad(uint32_t page)
+    {
+        flags[page] &= static_cast<uint8_t>(~LOADING);
+        inFlight--;
+    }
+
+    // a slot for page, uploads it; false when every slot holds a page still in use
+    bool place(uint32_t page, const uint8_t* data)
+    {
+        if (freeSlots.empty() && !evict())
+            return false;
+        const int32_t s = freeSlots.back();
+        freeSlots.pop_back();
+        const uint32_t level = levelOf(page);
+        const uint32_t local = page - layout.firstPage[level];
+        const uint32_t x = local % layout.gridX(level), y = local / layout.gridX(level);
+        upload(s, level, x, y, data, true);
+        slot[page] = s;
+        slotPage[s] = page;
+        lastUsed[page] = generation;
+        resident.push_back(page);
+        const uint32_t parent = parentOf(page, level);
+        if (parent != page)
+            children[parent]++;
+        uploadCount++;
+        dirty = true;
+        return true;
+    }
+
+    // the least recently used page without resident children that neither of the last two feedbacks asked for
+    bool evict()
+    {
+        size_t best = resident.size();
+        for (size_t i = 0; i < resident.size(); i++)
+        {
+            const uint32_t page = resident[i];
+            if ((flags[page] & PINNED) || children[page] > 0 || lastUsed[page] + 1 >= generation)
+                continue;
+            if (best == resident.size() || lastUsed[page] < lastUsed[resident[best]])
+                best = i;
+        }
+        if (best == resident.size())
+            return false;
+        const uint32_t page = resident[best];
+        resident[best] = resident.back();
+        resident.pop_back();
+        const uint32_t level = levelOf(page);
+        const uint32_t local = page - layout.firstPage[level];
+        upload(slot[page], level, local % layout.gridX(level), local / layout.gridX(level), nullptr, false);
+        freeSlots.push_back(slot[page]);
+        slotPage[slot[page]] = UINT32_MAX;
+        slot[page] = -1;
+        const uint32_t parent = parentOf(page, level);
+        if (parent != page)
+            children[parent]--;
+        evictionCount++;
+        dirty = true;
+        return true;
+    }
+
+    // a page into slot s, or out of it without data. The atlas takes the bordered page; the sparse texture commits
+    // or decommits the page's memory and takes its inside.
+    void upload(int32_t s, uint32_t level, uint32_t x, uint32_t y, const uint8_t* data, bool in)
+    {
+        if (!isSparse)
+        {
+            if (!in)
+                return;
+            const unsigned int stride = layout.stride();
+            glTextureSubImage2D(physical.id(), 0, static_cast<GLint>((s % cacheSide) * stride), static_cast<GLint>((s / cacheSide) * stride),
+                                stride, stride, GL_RGBA, GL_UNSIGNED_BYTE, data);
+            return;
+        }
+        const GLsizei w = std::min<GLsizei>(TILE, levelSize(layout.pagesX, level) - static_cast<GLsizei>(x * TILE));
+        const GLsizei h = std::min<GLsizei>(TILE, levelSize(layout.pagesY, level) - static_cast<GLsizei>(y * TILE));
+        const bool tail = level >= tailLevel;
+        glState().bindTexture(GL_TEXTURE_2D, physical.id());
+        if (!tail)
+        {
+            sparseState().pageCommitment(GL_TEXTURE_2D, static_cast<GLint>(level), static_cast<GLint>(x * TILE), static_cast<GLint>(y * TILE),
+                                         0, TILE, TILE, 1, in ? GL_TRUE : GL_FALSE);
+            const size_t pageBytes = static_cast<size_t>(TILE) * TILE * 4;
+            physical.track(in ? physical.bytes() + pageBytes : physical.bytes() - std::min(physical.bytes(), pageBytes));
+        }
+        else if (in)
+        {
+            physical.track(physical.bytes() + static_cast<size_t>(w) * h * 4);
+        }
+        if (!in)
+            return;
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, static_cast<GLint>(layout.stride()));
+        glTextureSubImage2D(physical.id(), static_cast<GLint>(level), static_cast<GLint>(x * TILE), static_cast<GLint>(y * TILE), w, h,
+                            GL_RGBA, GL_UNSIGNED_BYTE, data + (static_cast<size_t>(BORDER) * layout.stride() + BORDER) * 4);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    }
+
+    // every page to its finest resident ancestor, from the top down, and the levels uploaded
+    void rebuildIndirection()
+    {
+        for (int32_t l = static_cast<int32_t>(layout.levels) - 1; l >= 0; l--)
+        {
+            const uint32_t level = static_cast<uint32_t>(l);
+            const uint32_t gx = layout.gridX(level), gy = layout.gridY(level);
+            for (uint32_t y = 0; y < gy; y++)
+                for (uint32_t x = 0; x < gx; x++)
+                {
+                    const uint32_t page = pageIndex(level, x, y);
+                    uint8_t* entry = &table[static_cast<size_t>(page) * 4];
+                    if (slot[page] >= 0)
+                    {
+                        const uint32_t s = static_cast<uint32_t>(slot[page]);
+                        entry[0] = static_cast<uint8_t>(isSparse ? 0 : s % cacheSide);
+                        entry[1] = static_cast<uint8_t>(isSparse ? 0 : s / cacheSide);
+                        entry[2] = static_cast<uint8_t>(level);
+                        entry[3] = 1;
+                    }
+                    else if (level + 1 < layout.levels)
+                    {
+                        std::memcpy(entry, &table[static_cast<size_t>(pageIndex(level + 1, x >> 1, y >> 1)) * 4], 4);
+                    }
+                    else
+                    {
+                        std::memset(entry, 0, 4);
+                    }
+                }
+            glTextureSubImage2D(indirection.id(), l, 0, 0, gx, gy, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE,
+                                &table[static_cast<size_t>(layout.firstPage[level]) * 4]);
+        }
+        dirty = false;
+    }
+
+    void loaderLoop()
+    {
+        profiler().nameThread("virtual texture loader");
+        for (;;)
+        {
+            Loaded job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this]() { return stopping || !queue.empty(); });
+                if (stopping)
+                    return;
+                job = std::move(queue.front());
+                queue.pop_front();
+            }
+            // the mapping faults the page in from disk here, off the GL thread
+            const uint32_t local = job.page - layout.firstPage[job.level];
+            job.data.resize(layout.tileBytes());
+            readTile(job.level, local % layout.gridX(job.level), local / layout.gridX(job.level), job.data.data());
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished.push_back(std::move(job));
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,237 @@
+#ifndef WINDOW_EVENTS_H
+#define WINDOW_EVENTS_H
+
+#include <GLFW/glfw3.h>
+
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// one callback's arguments, replayed on the frame thread
+struct WindowEvent
+{
+    enum Type { KEY, CHAR, MOUSE_BUTTON, CURSOR_POS, SCROLL, FOCUS, CURSOR_ENTER, FRAMEBUFFER_SIZE, REFRESH };
+    Type type = REFRESH;
+    int a = 0, b = 0, c = 0, d = 0;     // key, scancode, action, mods; button, action, mods; codepoint; focused; width, height
+    double x = 0.0, y = 0.0;            // the cursor, or the scroll offsets
+};
+
+// what GLFW's getters would say about the window, which only the main thread may ask it, as of the last event taken
+struct WindowInputState
+{
+    bool keys[GLFW_KEY_LAST + 1] = {};
+    bool buttons[GLFW_MOUSE_BUTTON_LAST + 1] = {};
+    double cursorX = 0.0, cursorY = 0.0;
+    int width = 0, height = 0;                      // in screen coordinates
+    int framebufferWidth = 0, framebufferHeight = 0;
+
+    bool key(int k) const { return k >= 0 && k <= GLFW_KEY_LAST && keys[k]; }
+    bool button(int b) const { return b >= 0 && b <= GLFW_MOUSE_BUTTON_LAST && buttons[b]; }
+};
+
+// --render-thread: the main thread only waits for one window's events, a frame thread owning its context builds and
+// submits the frames. The callbacks, run by glfwWaitEvents on the main thread, append their events here and keep the
+// state; the frame thread takes both once or twice a frame and replays the events into ImGui and the camera, so a
+// window being dragged or resized (which blocks the main thread on some platforms) no longer stops the frames. What
+// only the main thread may do to the window, the cursor mode and the title, goes the other way as requests that
+// glfwPostEmptyEvent wakes it for. Bounded: behind by CAPACITY events, cursor moves merge into the last one and the
+// rest are dropped and counted.
+class WindowEventQueue
+{
+public:
+    static const size_t CAPACITY = 1024;
+
+    WindowEventQueue() = default;
+    WindowEventQueue(const WindowEventQueue&) = delete;
+    WindowEventQueue& operator=(const WindowEventQueue&) = delete;
+
+    // installs the callbacks on window and takes its sizes and cursor, on the main thread
+    void attach(GLFWwindow* window)
+    {
+        glfwSetWindowUserPointer(window, this);
+        glfwGetWindowSize(window, &state.width, &state.height);
+        glfwGetFramebufferSize(window, &state.framebufferWidth, &state.framebufferHeight);
+        glfwGetCursorPos(window, &state.cursorX, &state.cursorY);
+        glfwSetKeyCallback(window, [](GLFWwindow* w, int key, int scancode, int action, int mods) {
+            WindowEventQueue& queue = of(w);
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (key >= 0 && key <= GLFW_KEY_LAST) queue.state.keys[key] = action != GLFW_RELEASE;
+            queue.push(event(WindowEvent::KEY, key, scancode, action, mods));
+        });
+        glfwSetCharCallback(window, [](GLFWwindow* w, unsigned int codepoint) {
+            of(w).add(event(WindowEvent::CHAR, static_cast<int>(codepoint)));
+        });
+        glfwSetMouseButtonCallback(window, [](GLFWwindow* w, int button, int action, int mods) {
+            WindowEventQueue& queue = of(w);
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (button >= 0 && button <= GLFW_MOUSE_BUTTON_LAST) queue.state.buttons[button] = action != GLFW_RELEASE;
+            queue.push(event(WindowEvent::MOUSE_BUTTON, button, action, mods));
+        });
+        glfwSetCursorPosCallback(window, [](GLFWwindow* w, double x, double y) {
+            WindowEventQueue& queue = of(w);
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.state.cursorX = x;
+            queue.state.cursorY = y;
+            queue.push(event(WindowEvent::CURSOR_POS, 0, 0, 0, 0, x, y));
+        });
+        glfwSetScrollCallback(window, [](GLFWwindow* w, double x, double y) {
+            of(w).add(event(WindowEvent::SCROLL, 0, 0, 0, 0, x, y));
+        });
+        glfwSetWindowFocusCallback(window, [](GLFWwindow* w, int focused) {
+            WindowEventQueue& queue = of(w);
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            // the keys held when focus went elsewhere are never released here
+            if (!focused)
+                for (bool& k : queue.state.keys) k = false;
+            queue.push(event(WindowEvent::FOCUS, focused));
+        });
+        glfwSetCursorEnterCallback(window, [](GLFWwindow* w, int entered) {
+            of(w).add(event(WindowEvent::CURSOR_ENTER, entered));
+        });
+        glfwSetWindowSizeCallback(window, [](GLFWwindow* w, int width, int height) {
+            WindowEventQueue& queue = of(w);
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.state.width = width;
+            queue.state.height = height;
+        });
+        glfwSetFramebufferSizeCallback(window, [](GLFWwindow* w, int width, int height) {
+            WindowEventQueue& queue = of(w);
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.state.framebufferWidth = width;
+            queue.state.framebufferHeight = height;
+            queue.push(event(WindowEvent::FRAMEBUFFER_SIZE, width, height));
+        });
+        glfwSetWindowRefreshCallback(window, [](GLFWwindow* w) { of(w).add(event(WindowEvent::REFRESH)); });
+        // wakes the frame thread from an on-demand wait to see glfwWindowShouldClose
+        glfwSetWindowCloseCallback(window, [](GLFWwindow* w) { of(w).add(event(WindowEvent::REFRESH)); });
+    }
+
+    // the events since the last call, and the state after them, on the frame thread
+    void take(std::vector<WindowEvent>& taken, WindowInputState& takenState)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        taken.swap(events);
+        events.clear();
+        takenState = state;
+    }
+
+    // the state as of the last event, without taking any
+    WindowInputState current() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return state;
+    }
+
+    // true when there are events to take, waiting up to seconds for them
+    bool wait(double seconds)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        return arrived.wait_for(lock, std::chrono::duration<double>(seconds), [this] { return !events.empty(); });
+    }
+
+    // from any thread, the main thread carries them out
+    void requestCursorMode(int mode)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            cursorMode = mode;
+        }
+        glfwPostEmptyEvent();
+    }
+
+    void requestTitle(const std::string& title)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pendingTitle = title;
+        }
+        glfwPostEmptyEvent();
+    }
+
+    // the frame thread is done with the window, the main thread stops waiting for its events
+    void finish()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished = true;
+        }
+        glfwPostEmptyEvent();
+    }
+
+    // the main thread's loop: waits for events, runs their callbacks and then the requests; false once finish() was
+    // called. The requests are carried out unlocked, setting the cursor mode calls back into the queue
+    bool serviceEvents(GLFWwindow* window)
+    {
+        glfwWaitEvents();
+        int mode = -1;
+        std::string title;
+        bool running;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            mode = cursorMode;
+            cursorMode = -1;
+            title.swap(pendingTitle);
+            running = !finished;
+        }
+        if (mode >= 0) glfwSetInputMode(window, GLFW_CURSOR, mode);
+        if (!title.empty()) glfwSetWindowTitle(window, title.c_str());
+        return running;
+    }
+
+    unsigned long dropped() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return droppedEvents;
+    }
+
+private:
+    mutable std::mutex mutex;
+    std::condition_variable arrived;
+    std::vector<WindowEvent> events;
+    WindowInputState state;
+    int cursorMode = -1;            // none requested
+    std::string pendingTitle;
+    bool finished = false;
+    unsigned long droppedEvents = 0;
+
+    static WindowEventQueue& of(GLFWwindow* window)
+    {
+        return *static_cast<WindowEventQueue*>(glfwGetWindowUserPointer(window));
+    }
+
+    static WindowEvent event(WindowEvent::Type type, int a = 0, int b = 0, int c = 0, int d = 0, double x = 0.0, double y = 0.0)
+    {
+        WindowEvent e;
+        e.type = type;
+        e.a = a;
+        e.b = b;
+        e.c = c;
+        e.d = d;
+        e.x = x;
+        e.y = y;
+        return e;
+    }
+
+    void add(const WindowEvent& e)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        push(e);
+    }
+
+    // the mutex is held
+    void push(const WindowEvent& e)
+    {
+        if (events.size() < CAPACITY)
+            events.push_back(e);
+        else if (e.type == WindowEvent::CURSOR_POS && events.back().type == WindowEvent::CURSOR_POS)
+            events.back() = e;
+        else
+            droppedEvents++;
+        arrived.notify_one();
+    }
+};
+
+#endif
@@ -0,0 +1,457 @@
+#ifndef WORLD_STREAMING_H
+#define WORLD_STREAMING_H
+
+#include <glm.hpp>
+#include <gtc/quaternion.hpp>
+
+#include <physics_world.h>
+#include <philox.h>
+#include <texture_cache.h>
+#include <profiler.h>
+#include <alloc_tracker.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A universe of star systems streamed around the camera. Space is cut into cubic cells cellSize across, the home
+// cell around the origin holds the viewer's own system and each other cell a system with probability density, its
+// sun, planet and belt varied from the home scenario by a Philox stream keyed by the cell, so a cell is the same
+// system every time it comes back. A system nearer the camera than loadRadius is loaded: its planets' surface
+// texture starts streaming in through textureCache() and the streamer's thread generates its bodies into a
+// PhysicsWorld of its own, placed at the cell's centre. A resident system beyond evictRadius is evicted, bodies and
+// texture; coming back it is generated again from its cell, its planet put where its circular orbit has carried it
+// by then, the belt's asteroids drawn afresh.
+//
+// The system nearest the camera is the active one and lives in the viewer's PhysicsWorld, simulated and drawn as
+// any other; activate() swaps the next one's bodies in and parks the old ones in its place. The others are stepped
+// on the streamer's thread toward the viewer's sim time, a step of baseStep * 2^level once every 2^level base steps
+// with the level one more for every doubling of the distance past a cell, up to maxLevel, and inside them the belt
+// runs multi-rate (belt_sectors.h) with no focus, every sector on its slowest rate, so the asteroids mostly follow
+// their two-body orbits analytically and the force sum comes round every 2^sectorMaxLevel steps. A far system is
+// behind by at most a few of its steps and drops a backlog of more than a second, as the viewer's fixed step does.
+// Systems are far apart and do not pull on each other.
+class WorldStreamer
+{
+public:
+    enum SystemState {
+        SYSTEM_LOADING = 0,
+        SYSTEM_RESIDENT
+    };
+
+    // a sun or planet of a far system, as of its last step
+    struct FarBody
+    {
+        glm::dvec3 position;
+        float radiusScale;
+        glm::quat orientation;
+        bool sun;
+    };
+
+    struct System
+    {
+        glm::ivec3 cell{0};
+        glm::dvec3 centre{0.0};
+        ScenarioConfig scenario;
+        bool home = false;
+        unsigned int surface = 0;               // seen from afar its planets wrap this texture
+        std::atomic<int> state{SYSTEM_LOADING};
+        std::atomic<unsigned int> level{0};
+        // the streamer thread's while the system is far, locked for each step and by activate()
+        std::mutex mutex;
+        bool active = false;                    // under mutex, its bodies are the viewer's world's
+        PhysicsWorld world;
+        std::vector<FarBody> farBodies;         // under the streamer's mutex
+        size_t bodyCount = 0;                   // likewise
+        double publishedTime = 0.0;             // likewise
+    };
+
+    struct Stats
+    {
+        size_t resident = 0;
+        size_t loading = 0;
+        size_t farBodies = 0;                   // bodies of the far systems, stepped on the streamer's thread
+        unsigned long loaded = 0;               // since start()
+        unsigned long evicted = 0;
+        double lag = 0.0;                       // sim seconds the furthest behind far system is behind
+        glm::ivec3 activeCell{0};
+    };
+
+    // the planets' textures, the first one the home system's
+    static const unsigned int SURFACE_COUNT = 3;
+
+    double cellSize = 2500.0;
+    float density = 0.6f;                       // of the cells but the home one, those with a system
+    double loadRadius = 4000.0;
+    double evictRadius = 6000.0;
+    float switchRatio = 0.8f;                   // another system becomes active when this much nearer than the active one
+    unsigned int maxAsteroids = 20000;          // a generated belt's at most
+    unsigned int maxLevel = 3;
+    float baseStep = 1.0f / 120.0f;
+    uint64_t seed = 1;
+
+    WorldStreamer() = default;
+    WorldStreamer(const WorldStreamer&) = delete;
+    WorldStreamer& operator=(const WorldStreamer&) = delete;
+
+    ~WorldStreamer()
+    {
+        stop();
+    }
+
+    bool running() const { return streamer.joinable(); }
+
+    // GL thread. The home system, base, is active with the viewer's bodies; generate makes a system's bodies from
+    // its scenario on the streamer's thread, the home one's too when it comes back after an eviction. Far worlds run
+    // the viewer's settings with the belt multi-rate as above.
+    void start(std::function<void(PhysicsWorld&, const ScenarioConfig&)> generate, const ScenarioConfig& base,
+               const PhysicsSettings& settings)
+    {
+        stop();
+        generator = std::move(generate);
+        baseScenario = base;
+        farSettings = settings;
+        farSettings.beltSectors = true;
+        farSettings.sectorFocusRadius = 0.0f;
+        farSettings.threads = 1;
+        farSettings.diagnosticsInterval = 0;
+        std::shared_ptr<System> homeSystem = makeSystem(glm::ivec3(0));
+        homeSystem->state.store(SYSTEM_RESIDENT, std::memory_order_release);
+        homeSystem->active = true;
+        systems.push_back(homeSystem);
+        active = homeSystem;
+        loadedCount = evictedCount = 0;
+        stopping = false;
+        streamer = std::thread([this]() { streamLoop(); });
+    }
+
+    // GL thread, every system and its texture go
+    void stop()
+    {
+        if (!running())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            loads.clear();
+        }
+        wake.notify_all();
+        streamer.join();
+        for (const std::shared_ptr<System>& s : systems)
+            textureCache().release(s->surface);
+        systems.clear();
+        active.reset();
+    }
+
+    // GL thread, once a frame: loads what came within loadRadius of the camera and evicts what is beyond
+    // evictRadius, sets the far systems' rates and the sim time they step toward. The system to activate() when
+    // another one is nearer enough than the active one, otherwise null.
+    System* update(const glm::dvec3& camera, double simTime)
+    {
+        if (!running())
+            return nullptr;
+        PROFILE_SCOPE("WorldStreamer::update");
+        std::lock_guard<std::mutex> lock(mutex);
+        const glm::ivec3 at = cellOf(camera);
+        const int reach = static_cast<int>(std::ceil(loadRadius / cellSize)) + 1;
+        for (int x = at.x - reach; x <= at.x + reach; x++)
+            for (int y = at.y - reach; y <= at.y + reach; y++)
+                for (int z = at.z - reach; z <= at.z + reach; z++)
+                {
+                    const glm::ivec3 cell(x, y, z);
+                    if (!hasSystem(cell) || glm::length(centreOf(cell) - camera) > loadRadius || find(cell))
+                        continue;
+                    std::shared_ptr<System> system = makeSystem(cell);
+                    systems.push_back(system);
+                    loads.push_back(system);
+                }
+        // the active system stays whatever the distance, a loading one goes once it is resident
+        systems.erase(std::remove_if(systems.begin(), systems.end(), [&](const std::shared_ptr<System>& s) {
+            if (s == active || s->state.load(std::memory_order_acquire) != SYSTEM_RESIDENT || glm::length(s->centre - camera) <= evictRadius)
+                return false;
+            textureCache().release(s->surface);
+            evictedCount++;
+            return true;
+        }), systems.end());
+
+        std::shared_ptr<System> nearest;
+        double nearestDistance = INFINITY;
+        for (const std::shared_ptr<System>& s : systems)
+        {
+            const double d = glm::length(s->centre - camera);
+            s->level.store(std::min(maxLevel, 1u + static_cast<unsigned int>(std::log2(std::max(d / cellSize, 1.0)))), std::memory_order_relaxed);
+            if (s->state.load(std::memory_order_acquire) == SYSTEM_RESIDENT && d < nearestDistance)
+            {
+                nearest = s;
+                nearestDistance = d;
+            }
+        }
+        targetTime = simTime;
+        wake.notify_all();
+        if (!nearest || nearest == active || nearestDistance >= switchRatio * glm::length(active->centre - camera))
+            return nullptr;
+        return nearest.get();
+    }
+
+    // GL thread, with nothing else stepping the viewer's world: next's bodies go into world, caught up to its sim
+    // time, and the active system's are parked in next's place to be stepped from afar
+    void activate(System& next, PhysicsWorld& world)
+    {
+        std::shared_ptr<System> previous = active;
+        std::lock(next.mutex, previous->mutex);
+        std::lock_guard<std::mutex> nextLock(next.mutex, std::adopt_lock);
+        std::lock_guard<std::mutex> previousLock(previous->mutex, std::adopt_lock);
+        catchUp(next.world, world.simTime);
+        next.world.simTime = world.simTime;
+        world.adopt(next.world);            // next.world now has the previous system's bodies
+        previous->world.applySettings(farSettings);
+        previous->world.adopt(next.world);  // and they move into its own, next.world ends up empty
+        next.active = true;
+        previous->active = false;
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const std::shared_ptr<System>& s : systems)
+            if (s.get() == &next)
+                active = s;
+        publish(*previous);
+    }
+
+    System* activeSystem() const { return active.get(); }
+
+    // GL thread, fn(system, its suns and planets) for every resident system but the active one
+    template <typename Fn>
+    void forEachFarSystem(const Fn& fn) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const std::shared_ptr<System>& s : systems)
+            if (s != active && s->state.load(std::memory_order_acquire) == SYSTEM_RESIDENT)
+                fn(*s, s->farBodies);
+    }
+
+    Stats stats() const
+    {
+        Stats out;
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const std::shared_ptr<System>& s : systems)
+        {
+            if (s->state.load(std::memory_order_acquire) != SYSTEM_RESIDENT)
+            {
+                out.loading++;
+                continue;
+            }
+            out.resident++;
+            if (s != active)
+            {
+                out.farBodies += s->bodyCount;
+                out.lag = std::max(out.lag, targetTime - s->publishedTime);
+            }
+        }
+        out.loaded = loadedCount;
+        out.evicted = evictedCount;
+        out.activeCell = active ? active->cell : glm::ivec3(0);
+        return out;
+    }
+
+    glm::ivec3 cellOf(const glm::dvec3& p) const
+    {
+        return glm::ivec3(glm::floor(p / cellSize + 0.5));
+    }
+
+    bool hasSystem(const glm::ivec3& cell) const
+    {
+        return cell == glm::ivec3(0) || philox::Stream(seed, cellKey(cell), 0).uniform() < density;
+    }
+
+    // the sun's place in the cell, away from its faces so neighbours keep apart
+    glm::dvec3 centreOf(const glm::ivec3& cell) const
+    {
+        if (cell == glm::ivec3(0))
+            return glm::dvec3(0.0);
+        philox::Stream random(seed, cellKey(cell), 1);
+        const glm::dvec3 jitter(random.uniform(-0.3f, 0.3f), random.uniform(-0.05f, 0.05f), random.uniform(-0.3f, 0.3f));
+        return (glm::dvec3(cell) + jitter) * cellSize;
+    }
+
+private:
+    std::function<void(PhysicsWorld&, const ScenarioConfig&)> generator;
+    ScenarioConfig baseScenario;
+    PhysicsSettings farSettings{};
+    std::vector<std::shared_ptr<System>> systems;   // GL thread, the streamer's thread reads under mutex
+    std::shared_ptr<System> active;
+    std::deque<std::shared_ptr<System>> loads;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::thread streamer;
+    bool stopping = false;
+    double targetTime = 0.0;
+    unsigned long loadedCount = 0;
+    unsigned long evictedCount = 0;
+
+    static uint64_t cellKey(const glm::ivec3& cell)
+    {
+        // 21 bits a coordinate, two's complement
+        auto bits = [](int v) { return static_cast<uint64_t>(static_cast<uint32_t>(v) & 0x1fffffu); };
+        return bits(cell.x) | (bits(cell.y) << 21) | (bits(cell.z) << 42);
+    }
+
+    std::shared_ptr<System> find(const glm::ivec3& cell) const
+    {
+        for (const std::shared_ptr<System>& s : systems)
+            if (s->cell == cell)
+                return s;
+        return nullptr;
+    }
+
+    // the cell's system: the home scenario with the sun, planet and belt varied
+    std::shared_ptr<System> makeSystem(const glm::ivec3& cell)
+    {
+        std::shared_ptr<System> system = std::make_shared<System>();
+        system->cell = cell;
+        system->centre = centreOf(cell);
+        system->home = cell == glm::ivec3(0);
+        ScenarioConfig& s = system->scenario;
+        s = baseScenario;
+        unsigned int surface = 0;
+        if (!system->home)
+        {
+            philox::Stream random(seed, cellKey(cell), 2);
+            const float mass = random.uniform(0.5f, 2.0f);
+            s.sunMass = baseScenario.sunMass * mass;
+            s.sunRadiusScale = baseScenario.sunRadiusScale * std::cbrt(mass);
+            s.planetMass = baseScenario.planetMass * random.uniform(0.5f, 2.0f);
+            s.planetRadiusScale = baseScenario.planetRadiusScale * random.uniform(0.6f, 1.6f);
+            s.asteroidBeltInnerRadius = baseScenario.asteroidBeltInnerRadius * random.uniform(0.6f, 1.4f);
+            s.asteroidBeltOuterRadius = s.asteroidBeltInnerRadius + (baseScenario.asteroidBeltOuterRadius - baseScenario.asteroidBeltInnerRadius) * random.uniform(0.5f, 1.5f);
+            s.asteroidBeltHeight = baseScenario.asteroidBeltHeight * random.uniform(0.4f, 1.6f);
+            s.planetOrbitRadius = s.asteroidBeltOuterRadius + random.uniform(20.0f, 150.0f);
+            s.planetInitialAngle = random.uniform(0.0f, 360.0f);
+            s.asteroidAmount = static_cast<unsigned int>(std::min(maxAsteroids, std::max(baseScenario.asteroidAmount, 1000u)) * random.uniform(0.1f, 1.0f));
+            s.seed = random.next();
+            surface = 1 + random.next() % (SURFACE_COUNT - 1);
+        }
+        static const char* const surfaces[SURFACE_COUNT] = {"../resources/objects/planet/mars.png", "../textures/kaguya.jpg", "../textures/marble.jpg"};
+        system->surface = textureCache().acquire(surfaces[surface], true);
+        return system;
+    }
+
+    // the streamer's thread: the loads first, then the far systems toward the target time
+    void streamLoop()
+    {
+        profiler().nameThread("world streamer");
+        ALLOC_SCOPE(ALLOC_STREAMING);
+        std::vector<std::shared_ptr<System>> far;
+        for (;;)
+        {
+            std::shared_ptr<System> load;
+            double target = 0.0;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&]() { return stopping || !loads.empty() || behind(); });
+                if (stopping)
+                    return;
+                if (!loads.empty())
+                {
+                    load = loads.front();
+                    loads.pop_front();
+                }
+                target = targetTime;
+                far.clear();
+                for (const std::shared_ptr<System>& s : systems)
+                    if (s != active && s->state.load(std::memory_order_acquire) == SYSTEM_RESIDENT)
+                        far.push_back(s);
+            }
+            if (load)
+            {
+                build(*load, target);
+                continue;
+            }
+            for (const std::shared_ptr<System>& s : far)
+            {
+                {
+                    std::lock_guard<std::mutex> systemLock(s->mutex);
+                    if (s->active)
+                        continue;
+                    catchUp(s->world, target, s->level.load(std::memory_order_relaxed));
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                publish(*s);
+            }
+        }
+    }
+
+    // under mutex: a far system has a step of its own to take
+    bool behind() const
+    {
+        for (const std::shared_ptr<System>& s : systems)
+            if (s != active && s->state.load(std::memory_order_acquire) == SYSTEM_RESIDENT &&
+                s->publishedTime + baseStep * static_cast<double>(1u << s->level.load(std::memory_order_relaxed)) <= targetTime)
+                return true;
+        return false;
+    }
+
+    void build(System& system, double simTime)
+    {
+        PROFILE_SCOPE("WorldStreamer::build");
+        {
+            std::lock_guard<std::mutex> lock(system.mutex);
+            PhysicsWorld& world = system.world;
+            world.applySettings(farSettings);
+            // the planet where its circular orbit has taken it by now
+            ScenarioConfig scenario = system.scenario;
+            const double r = scenario.planetOrbitRadius;
+            const double rate = r > 0.0 ? std::sqrt(world.G * scenario.sunMass / (r * r * r)) : 0.0;
+            scenario.planetInitialAngle = static_cast<float>(std::fmod(scenario.planetInitialAngle + glm::degrees(rate * simTime), 360.0));
+            generator(world, scenario);
+            for (size_t i = 0; i < world.bodies.size(); i++)
+                world.bodies.position[i] += system.centre;
+            world.simTime = simTime;
+            world.bodiesChanged();
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        system.state.store(SYSTEM_RESIDENT, std::memory_order_release);
+        loadedCount++;
+        publish(system);
+    }
+
+    // steps of baseStep * 2^level toward t, a backlog of more than a second dropped
+    void catchUp(PhysicsWorld& world, double t, unsigned int level = 0) const
+    {
+        if (world.bodies.empty())
+        {
+            world.simTime = t;
+            return;
+        }
+        const double dt = baseStep * static_cast<double>(1u << level);
+        if (t - world.simTime > 1.0 + dt)
+            world.simTime = t - dt;
+        while (world.simTime + dt <= t + 1e-9)
+            world.step(static_cast<float>(dt));
+        if (level == 0 && world.simTime < t)
+            world.step(static_cast<float>(t - world.simTime));
+    }
+
+    // under mutex, the system copied out for drawing from afar
+    void publish(System& system)
+    {
+        system.farBodies.clear();
+        const BodyStore& bodies = system.world.bodies;
+        for (BodyType type : {BODY_SUN, BODY_PLANET})
+        {
+            const BodyRange range = bodies.range(type);
+            for (size_t i = range.begin; i < range.end; i++)
+                system.farBodies.push_back(FarBody{bodies.position[i], bodies.render[i].radiusScale, bodies.render[i].orientation, type == BODY_SUN});
+        }
+        system.bodyCount = bodies.size();
+        system.publishedTime = system.world.simTime;
+    }
+};
+
+#endif
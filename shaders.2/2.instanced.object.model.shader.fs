@@ -1,70 +1,109 @@
 #version 460 core
-#define NR_POINT_LIGHTS 1
-
-struct Material {
-    float shininess;
-};
-
-struct DirLight {
-    vec3 direction;
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct PointLight {
-    vec4 position;
-    float constant;
-    float linear;
-    float quadratic;
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct SpotLight {
-    float cutOff;
-    float outerCutOff;
-    float constant;
-    float linear;
-    float quadratic;
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-layout(std140, binding = 1) uniform LightData {
-    Material material;
-    DirLight dirLight;
-    PointLight pointLights[NR_POINT_LIGHTS];
-    SpotLight spotLight;
-};
+#include "lights.glsl"
 
 in vec3 Normal;
 in vec3 FragPos;
+flat in uint Pick;          // what include/gpu_picker.h reads back for the pixel
+#ifdef CUBE_ALBEDO
+// the planet terrain's colour by object-space direction (include/planet_terrain.h), which has no specular map
+in vec3 SurfaceDirection;
+layout(binding = 18) uniform samplerCube albedoCube;
+#define DIFFUSE_SAMPLE texture(albedoCube, SurfaceDirection)
+#define SPECULAR_SAMPLE vec4(0.0, 0.0, 0.0, 1.0)
+#elif defined(VIRTUAL_ALBEDO)
+// the same terrain coloured from a streamed equirectangular image, read once per pixel; the feedback writes would
+// otherwise keep occluded pixels from being rejected before shading
+layout(early_fragment_tests) in;
+in vec3 SurfaceDirection;
+#include "virtual_texture.glsl"
+vec4 virtualAlbedo;
+#define DIFFUSE_SAMPLE virtualAlbedo
+#define SPECULAR_SAMPLE vec4(0.0, 0.0, 0.0, 1.0)
+#elif defined(MATERIAL_ARRAY)
+// instanced planets and moons (include/planet_instances.h): the instance's layer of one texture array, which
+// doubles as the specular map as the model's own texture does without a specular one
 in vec2 TexCoords;
+flat in uint MaterialLayer;
+layout(binding = 0) uniform sampler2DArray planetMaterials;
+#define DIFFUSE_SAMPLE texture(planetMaterials, vec3(TexCoords, float(MaterialLayer)))
+#define SPECULAR_SAMPLE DIFFUSE_SAMPLE
+#else
+in vec2 TexCoords;
+#define DIFFUSE_SAMPLE texture(texture_diffuse1, TexCoords)
+#define SPECULAR_SAMPLE texture(texture_specular1, TexCoords)
+#endif
 
-out vec4 FragColor;
+#ifdef GBUFFER_OUTPUT
+#include "gbuffer.glsl"
+#else
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out uint PickId;
+#endif
 
+#ifndef MATERIAL_ARRAY
 uniform sampler2D texture_diffuse1;
 uniform sampler2D texture_specular1;
+#endif
 uniform mat4 viewMat;
-uniform bool gamma;
+
+#ifndef GBUFFER_OUTPUT
+layout(std140, binding = 0) uniform Matrices {
+    mat4 projection;
+    mat4 view;
+};
+// the dynamic reflection probe (include/reflection_probe.h), 0 reflectivity skips it; only the planet sets it,
+// whose Normal is in world axes, drawn alone or as the first of the instances
+layout(binding = 17) uniform samplerCube reflectionProbe;
+#if defined(MATERIAL_ARRAY) || defined(OBJECT_INSTANCES)
+flat in float InstanceReflectivity;
+flat in float InstanceReflectionLod;
+#define reflectivity InstanceReflectivity
+#define reflectionLod InstanceReflectionLod
+#elif !defined(OBJECT_BLOCK)
+uniform float reflectivity;
+uniform float reflectionLod;
+#endif
+#endif
+#if defined(OBJECT_BLOCK) && !defined(OBJECT_INSTANCES)
+#include "object_block.glsl"
+#endif
 
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 
 void main() {
+    PickId = Pick;
+#ifdef VIRTUAL_ALBEDO
+    virtualAlbedo = sampleVirtualTexture(SurfaceDirection);
+#endif
     vec3 norm = normalize(Normal);
+#ifdef GBUFFER_OUTPUT
+    writeGBuffer(DIFFUSE_SAMPLE.rgb, SPECULAR_SAMPLE.rgb, norm);
+#else
     vec3 viewDir = normalize(-FragPos);
     vec3 result = CalcDirLight(dirLight, norm, viewDir);
-    for(int i = 0; i < NR_POINT_LIGHTS; i++)
+#ifdef CLUSTERED_LIGHTS
+    uint cluster = fragmentCluster(FragPos);
+    for (uint i = 0u; i < clusterCounts[cluster]; i++) {
+        pointShadow = pointLightShadow(clusterLightIndex(cluster, i), FragPos, norm);
+        result += CalcPointLight(clusterLight(cluster, i), norm, FragPos, viewDir);
+    }
+#else
+    for(int i = 0; i < NR_POINT_LIGHTS; i++) {
+        pointShadow = pointLightShadow(uint(i), FragPos, norm);
         result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
+    }
+#endif
     result += CalcSpotLight(spotLight, norm, FragPos, viewDir);
-    if (gamma)
-        result = pow(result, vec3(1.0 / 2.2));
+    if (reflectivity > 0.0) {
+        // Schlick's Fresnel term over the prefiltered level for the surface's roughness
+        vec3 toEye = -normalize(transpose(mat3(view)) * FragPos);
+        float fresnel = reflectivity + (1.0 - reflectivity) * pow(1.0 - max(dot(norm, toEye), 0.0), 5.0);
+        result += fresnel * textureLod(reflectionProbe, reflect(-toEye, norm), reflectionLod).rgb;
+    }
     FragColor = vec4(result, 1.0);
+#endif
 }
 
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir) {
@@ -72,9 +111,9 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir) {
     float diff = max(dot(normal, lightDir), 0.0);
     vec3 halfwayDir = normalize(lightDir + viewDir);
     float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
-    vec3 ambient = light.ambient * vec3(texture(texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(texture_specular1, TexCoords));
+    vec3 ambient = light.ambient * vec3(DIFFUSE_SAMPLE);
+    vec3 diffuse = light.diffuse * diff * vec3(DIFFUSE_SAMPLE);
+    vec3 specular = light.specular * spec * vec3(SPECULAR_SAMPLE);
     return (ambient + diffuse + specular);
 }
 
@@ -90,9 +129,9 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float distance = length(vec3(viewMat * light.position) - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(texture_specular1, TexCoords));
+    vec3 ambient = light.ambient * vec3(DIFFUSE_SAMPLE);
+    vec3 diffuse = light.diffuse * diff * pointShadow * vec3(DIFFUSE_SAMPLE);
+    vec3 specular = light.specular * spec * pointShadow * vec3(SPECULAR_SAMPLE);
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
@@ -113,9 +152,9 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float epsilon = light.cutOff - light.outerCutOff;
     float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
     // Combine
-    vec3 ambient = light.ambient * vec3(texture(texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(texture_specular1, TexCoords));
+    vec3 ambient = light.ambient * vec3(DIFFUSE_SAMPLE);
+    vec3 diffuse = light.diffuse * diff * vec3(DIFFUSE_SAMPLE);
+    vec3 specular = light.specular * spec * vec3(SPECULAR_SAMPLE);
     ambient *= attenuation * intensity;
     diffuse *= attenuation * intensity;
     specular *= attenuation * intensity;
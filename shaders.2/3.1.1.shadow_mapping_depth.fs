@@ -1,6 +1,8 @@
 #version 460 core
+// the depth's moments for the filtered cascades, dropped when the cascades only keep depth
+layout(location = 0) out vec2 Moments;
 
 void main()
-{             
-    // gl_FragDepth = gl_FragCoord.z;
-}
\ No newline at end of file
+{
+    Moments = vec2(gl_FragCoord.z, gl_FragCoord.z * gl_FragCoord.z);
+}
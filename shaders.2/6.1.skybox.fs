@@ -1,5 +1,6 @@
 #version 460 core
-out vec4 FragColor;
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out uint PickId;
 
 in vec3 TexCoords;
 
@@ -8,4 +9,5 @@ uniform samplerCube skybox;
 void main()
 {    
     FragColor = texture(skybox, TexCoords);
+    PickId = 0u;
 }
\ No newline at end of file
@@ -0,0 +1,127 @@
+#version 460 core
+// frustum culling and LOD selection for the GPU-resident asteroids: every visible instance appends its body index
+// to the list of its level of detail and bumps the instance count of that level's indirect draw commands. Beyond
+// the impostor distance it goes to the point list instead, drawn as one lit point per rock. With occlusion set, an
+// instance hidden behind last frame's depth (the Hi-Z pyramid of include/hiz.h, reprojected) is culled as well.
+// A level's list is split into one run per rock variant (include/rock_variants.h), each drawn by its own commands.
+// With frontToBack set the visible bodies are appended to one list with a key of their run and distance instead,
+// radix sorted and put in their runs nearest first by asteroid.order.cs.
+layout(local_size_x = 256) in;
+
+layout(std140, binding = 0) uniform Matrices {
+    mat4 projection;
+    mat4 view;
+};
+layout(std430, binding = 0) readonly buffer PositionMass {
+    vec4 posMass[];
+};
+layout(std430, binding = 3) readonly buffer Scale {
+    float scale[];
+};
+struct DrawElementsIndirectCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+layout(std430, binding = 7) writeonly buffer Visible {
+    uint visible[];
+};
+layout(std430, binding = 8) buffer Commands {
+    DrawElementsIndirectCommand commands[];     // (lod * variantCount + variant) * meshCount + mesh, baseInstance is the run's offset
+};
+
+struct DrawArraysIndirectCommand {
+    uint count;
+    uint instanceCount;
+    uint first;
+    uint baseInstance;
+};
+layout(std430, binding = 9) buffer Impostors {
+    DrawArraysIndirectCommand impostors;
+};
+layout(std430, binding = 44) writeonly buffer SortKeys {
+    uint sortKeys[];        // run << 16 | distance, the run the impostors' after every level's
+};
+layout(std430, binding = 45) writeonly buffer SortValues {
+    uint sortValues[];
+};
+layout(std430, binding = 46) buffer SortCount {
+    uint sortCount;
+};
+
+const int MAX_LODS = 4;
+
+uniform uint firstInstance;    // body index of the first asteroid
+uniform uint instanceCount;
+uniform uint meshCount;        // one command per mesh of the model, all draw the same instances
+uniform uint variantCount;     // shapes of the model, 1 for a single one
+uniform vec3 cameraPosition;   // positions are world space, the view matrix is rotation only
+uniform float modelRadius;     // bounding sphere of the unscaled model
+uniform uint lodCount;
+uniform float lodPixels[MAX_LODS - 1];     // a level is used below this projected diameter, coarsest last
+uniform float viewportHeight;
+uniform float impostorDistance;    // 0 keeps every rock a mesh
+uniform uint views;                // every visible rock is drawn this many times, twice for instanced stereo
+uniform bool frontToBack;
+
+uniform bool occlusion;
+#include "hiz.glsl"
+#include "rock_variant.glsl"
+
+// the upper bits of a positive float order as the float does, sign, exponent and 7 bits of mantissa
+void appendSorted(uint run, float distance, uint body)
+{
+    uint k = atomicAdd(sortCount, 1u);
+    sortKeys[k] = (run << 16) | (floatBitsToUint(distance) >> 15);
+    sortValues[k] = body;
+}
+
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= instanceCount)
+        return;
+    uint body = firstInstance + i;
+    vec3 center = posMass[body].xyz - cameraPosition;
+    float radius = modelRadius * scale[body];
+
+    // Gribb-Hartmann planes of projection * view, a sphere is culled when it is wholly outside one of them
+    mat4 m = transpose(projection * view);
+    vec4 planes[6] = vec4[6](m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[3] + m[2], m[3] - m[2]);
+    for (int p = 0; p < 6; p++)
+    {
+        if (dot(planes[p].xyz, center) + planes[p].w < -radius * length(planes[p].xyz))
+            return;
+    }
+    if (occlusion && occluded(center + hizCameraOffset, radius))
+        return;
+
+    float distance = length(center);
+    if (impostorDistance > 0.0 && distance > impostorDistance)
+    {
+        uint slot = atomicAdd(impostors.instanceCount, views) / views;
+        if (frontToBack)
+            appendSorted(lodCount * variantCount, distance, body);
+        else
+            visible[impostors.baseInstance + slot] = body;
+        return;
+    }
+
+    // projected diameter in pixels, projection[1][1] is cot(fov / 2)
+    float pixels = radius * projection[1][1] / max(distance, 1e-4) * viewportHeight;
+    uint lod = 0u;
+    while (lod + 1u < lodCount && pixels < lodPixels[lod])
+        lod++;
+
+    uint run = lod * variantCount + rockVariantHash(body) % variantCount;
+    uint first = run * meshCount;
+    uint slot = atomicAdd(commands[first].instanceCount, views) / views;
+    for (uint k = 1u; k < meshCount; k++)
+        atomicAdd(commands[first + k].instanceCount, views);
+    if (frontToBack)
+        appendSorted(run, distance, body);
+    else
+        visible[commands[first].baseInstance + slot] = body;
+}
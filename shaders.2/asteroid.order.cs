@@ -0,0 +1,59 @@
+#version 460 core
+// after a front-to-back cull (asteroid.cull.cs with frontToBack) and the radix sort of its list, every body goes to
+// its run's list at its place in the run: the sorted list holds the runs one after another, each nearest first, and
+// a run starts after as many entries as the runs before it counted.
+layout(local_size_x = 256) in;
+
+struct DrawElementsIndirectCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+struct DrawArraysIndirectCommand {
+    uint count;
+    uint instanceCount;
+    uint first;
+    uint baseInstance;
+};
+layout(std430, binding = 7) writeonly buffer Visible {
+    uint visible[];
+};
+layout(std430, binding = 8) readonly buffer Commands {
+    DrawElementsIndirectCommand commands[];
+};
+layout(std430, binding = 9) readonly buffer Impostors {
+    DrawArraysIndirectCommand impostors;
+};
+layout(std430, binding = 44) readonly buffer SortKeys {
+    uint sortKeys[];
+};
+layout(std430, binding = 45) readonly buffer SortValues {
+    uint sortValues[];
+};
+layout(std430, binding = 46) readonly buffer SortCount {
+    uint sortCount;
+};
+
+uniform uint meshCount;
+uniform uint runCount;          // levels times variants, the impostors' run after them
+uniform uint views;
+
+uint runSize(uint run)
+{
+    return (run < runCount ? commands[run * meshCount].instanceCount : impostors.instanceCount) / views;
+}
+
+void main()
+{
+    uint k = gl_GlobalInvocationID.x;
+    if (k >= sortCount)
+        return;
+    uint run = sortKeys[k] >> 16;
+    uint start = 0u;
+    for (uint r = 0u; r < run; r++)
+        start += runSize(r);
+    uint base = run < runCount ? commands[run * meshCount].baseInstance : impostors.baseInstance;
+    visible[base + k - start] = sortValues[k];
+}
@@ -0,0 +1,100 @@
+#version 460 core
+// a planet's atmosphere over the finished scene (include/atmosphere.h), drawn on a triangle over the screen with
+// fullscreen.vs. The view ray is cut to the top of the atmosphere and, when it meets the planet, to the ground,
+// the planet taken as the sphere of its radius: the light scattered in along it comes from the LUTs in a few
+// lookups, and what is behind is dimmed by its transmittance through the blend, dst * alpha + src. The ground
+// adds the sky's light on it, the terminator's glow. The depth is that of the ray's entry into the atmosphere,
+// so whatever is in front of it hides it.
+#include "atmosphere.glsl"
+#include "depth.glsl"
+
+in vec2 TexCoords;
+
+layout(location = 0) out vec4 FragColor;
+
+layout(binding = 0) uniform sampler2D transmittanceTexture;
+layout(binding = 1) uniform sampler3D scatteringTexture;
+layout(binding = 2) uniform sampler3D singleMieTexture;
+layout(binding = 3) uniform sampler2D irradianceTexture;
+
+uniform mat4 projection;
+uniform mat4 inverseProjection;
+uniform vec3 planetCenter;      // view space
+uniform float planetRadius;
+uniform vec3 sunDirection;      // view space, from the planet
+uniform float brightness;
+
+void combinedScattering(float r, float mu, float muS, float nu, bool rayIntersectsGround, out vec3 rayleigh, out vec3 mie)
+{
+    rayleigh = scatteringLookup(scatteringTexture, r, mu, muS, nu, rayIntersectsGround);
+    mie = scatteringLookup(singleMieTexture, r, mu, muS, nu, rayIntersectsGround);
+}
+
+// from camera, inside the atmosphere or on its top, to space
+vec3 skyRadiance(vec3 camera, vec3 viewRay, out vec3 transmittance)
+{
+    float r = length(camera);
+    float mu = dot(camera, viewRay) / r;
+    float muS = dot(camera, sunDirection) / r;
+    float nu = dot(viewRay, sunDirection);
+    transmittance = transmittanceToTopAtmosphereBoundary(transmittanceTexture, r, mu);
+    vec3 rayleigh, mie;
+    combinedScattering(r, mu, muS, nu, false, rayleigh, mie);
+    return rayleigh * rayleighPhase(nu) + mie * miePhase(nu);
+}
+
+// from camera to point on the ground, the scattering beyond the point taken off the scattering to the ground
+vec3 skyRadianceToPoint(vec3 camera, vec3 point, out vec3 transmittance)
+{
+    vec3 viewRay = normalize(point - camera);
+    float r = length(camera);
+    float rMu = dot(camera, viewRay);
+    float mu = rMu / r;
+    float muS = dot(camera, sunDirection) / r;
+    float nu = dot(viewRay, sunDirection);
+    float d = length(point - camera);
+    bool towardGround = rayIntersectsGround(r, mu);
+    transmittance = transmittanceAlong(transmittanceTexture, r, mu, d, towardGround);
+    vec3 rayleigh, mie;
+    combinedScattering(r, mu, muS, nu, towardGround, rayleigh, mie);
+    float rP = clampRadius(sqrt(d * d + 2.0 * r * mu * d + r * r));
+    float muP = (r * mu + d) / rP;
+    float muSP = (r * muS + d * nu) / rP;
+    vec3 rayleighP, mieP;
+    combinedScattering(rP, muP, muSP, nu, towardGround, rayleighP, mieP);
+    rayleigh = max(rayleigh - transmittance * rayleighP, vec3(0.0));
+    // Mie's forward peak magnifies the difference's error with the sun below the horizon
+    mie = max(mie - transmittance * mieP, vec3(0.0)) * smoothstep(0.0, 0.01, muS);
+    return rayleigh * rayleighPhase(nu) + mie * miePhase(nu);
+}
+
+void main()
+{
+    vec4 target = inverseProjection * vec4(ndcFromWindow(TexCoords, windowDepth(vec4(0.0, 0.0, NDC_BEYOND, 1.0))), 1.0);
+    vec3 viewRay = normalize(target.xyz / target.w);
+    // the camera from the planet, in planet radii
+    vec3 camera = -planetCenter / planetRadius;
+    float r = length(camera);
+    float rMu = dot(camera, viewRay);
+    float discriminant = rMu * rMu - r * r + topRadius * topRadius;
+    if (discriminant < 0.0 || (r > topRadius && rMu > 0.0))
+        discard;
+    float entry = max(-rMu - sqrt(discriminant), 0.0);
+    vec3 start = camera + viewRay * entry;
+    float groundDiscriminant = rMu * rMu - r * r + bottomRadius * bottomRadius;
+    float ground = groundDiscriminant >= 0.0 ? -rMu - sqrt(groundDiscriminant) : -1.0;
+
+    vec3 transmittance;
+    vec3 radiance;
+    if (ground > entry)
+    {
+        vec3 point = camera + viewRay * ground;
+        radiance = skyRadianceToPoint(start, point, transmittance);
+        radiance += transmittance * groundAlbedo * (1.0 / PI) * irradianceLookup(irradianceTexture, bottomRadius, dot(normalize(point), sunDirection));
+    }
+    else
+        radiance = skyRadiance(start, viewRay, transmittance);
+
+    FragColor = vec4(radiance * brightness, dot(transmittance, vec3(1.0 / 3.0)));
+    gl_FragDepth = entry > 0.0 ? windowDepth(projection * vec4(viewRay * (entry * planetRadius), 1.0)) : windowDepth(vec4(0.0, 0.0, NDC_NEAR, 1.0));
+}
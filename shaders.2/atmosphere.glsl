@@ -0,0 +1,240 @@
+// Precomputed atmospheric scattering after Bruneton ("Precomputed Atmospheric Scattering: a New Implementation",
+// 2017), shared by the precomputation (atmosphere.precompute.cs) and the draw (atmosphere.fs), see
+// include/atmosphere.h. Lengths are in planet radii, the ground at radius 1 and the top of the atmosphere at
+// topRadius. Rayleigh and Mie densities fall off exponentially, each with its own scale height; no ozone layer.
+// The LUTs: transmittance to the top by (r, mu), scattering by (r, mu, mu_s, nu) with nu folded into the 3D
+// texture's x beside mu_s, and the sky's irradiance on the ground by (r, mu_s).
+
+#define TRANSMITTANCE_WIDTH 256
+#define TRANSMITTANCE_HEIGHT 64
+#define SCATTERING_R 32
+#define SCATTERING_MU 128
+#define SCATTERING_MU_S 32
+#define SCATTERING_NU 8
+#define IRRADIANCE_WIDTH 64
+#define IRRADIANCE_HEIGHT 16
+
+const float PI = 3.14159265358979;
+const float bottomRadius = 1.0;
+
+uniform float topRadius;
+uniform vec3 rayleighScattering;    // per planet radius at the ground
+uniform float rayleighScaleHeight;
+uniform vec3 mieScattering;
+uniform vec3 mieExtinction;
+uniform float mieScaleHeight;
+uniform float miePhaseG;
+uniform vec3 groundAlbedo;
+uniform vec3 solarIrradiance;
+uniform float sunAngularRadius;
+uniform float muSMin;               // the lowest sun the scattering texture keeps
+
+float clampCosine(float mu) { return clamp(mu, -1.0, 1.0); }
+float clampDistance(float d) { return max(d, 0.0); }
+float clampRadius(float r) { return clamp(r, bottomRadius, topRadius); }
+float safeSqrt(float a) { return sqrt(max(a, 0.0)); }
+
+float distanceToTopAtmosphereBoundary(float r, float mu)
+{
+    float discriminant = r * r * (mu * mu - 1.0) + topRadius * topRadius;
+    return clampDistance(-r * mu + safeSqrt(discriminant));
+}
+
+float distanceToBottomAtmosphereBoundary(float r, float mu)
+{
+    float discriminant = r * r * (mu * mu - 1.0) + bottomRadius * bottomRadius;
+    return clampDistance(-r * mu - safeSqrt(discriminant));
+}
+
+bool rayIntersectsGround(float r, float mu)
+{
+    return mu < 0.0 && r * r * (mu * mu - 1.0) + bottomRadius * bottomRadius >= 0.0;
+}
+
+float distanceToNearestAtmosphereBoundary(float r, float mu, bool rayIntersectsGround)
+{
+    return rayIntersectsGround ? distanceToBottomAtmosphereBoundary(r, mu) : distanceToTopAtmosphereBoundary(r, mu);
+}
+
+float rayleighDensity(float r) { return exp(-(r - bottomRadius) / rayleighScaleHeight); }
+float mieDensity(float r) { return exp(-(r - bottomRadius) / mieScaleHeight); }
+
+float rayleighPhase(float nu)
+{
+    return 3.0 / (16.0 * PI) * (1.0 + nu * nu);
+}
+
+float miePhase(float nu)
+{
+    float g = miePhaseG;
+    float k = 3.0 / (8.0 * PI) * (1.0 - g * g) / (2.0 + g * g);
+    return k * (1.0 + nu * nu) / pow(1.0 + g * g - 2.0 * g * nu, 1.5);
+}
+
+// texel centres at the ends of the range, so a lookup never blends across the edge
+float textureCoordFromUnitRange(float x, int size) { return 0.5 / float(size) + x * (1.0 - 1.0 / float(size)); }
+float unitRangeFromTextureCoord(float u, int size) { return (u - 0.5 / float(size)) / (1.0 - 1.0 / float(size)); }
+
+// transmittance: x the distance to the top between its least and most for r, y the distance to the horizon
+
+vec2 transmittanceUvFromRMu(float r, float mu)
+{
+    float H = sqrt(topRadius * topRadius - bottomRadius * bottomRadius);
+    float rho = safeSqrt(r * r - bottomRadius * bottomRadius);
+    float d = distanceToTopAtmosphereBoundary(r, mu);
+    float dMin = topRadius - r;
+    float dMax = rho + H;
+    float xMu = (d - dMin) / (dMax - dMin);
+    float xR = rho / H;
+    return vec2(textureCoordFromUnitRange(xMu, TRANSMITTANCE_WIDTH), textureCoordFromUnitRange(xR, TRANSMITTANCE_HEIGHT));
+}
+
+void rMuFromTransmittanceUv(vec2 uv, out float r, out float mu)
+{
+    float xMu = unitRangeFromTextureCoord(uv.x, TRANSMITTANCE_WIDTH);
+    float xR = unitRangeFromTextureCoord(uv.y, TRANSMITTANCE_HEIGHT);
+    float H = sqrt(topRadius * topRadius - bottomRadius * bottomRadius);
+    float rho = H * xR;
+    r = sqrt(rho * rho + bottomRadius * bottomRadius);
+    float dMin = topRadius - r;
+    float dMax = rho + H;
+    float d = dMin + xMu * (dMax - dMin);
+    mu = d == 0.0 ? 1.0 : (H * H - rho * rho - d * d) / (2.0 * r * d);
+    mu = clampCosine(mu);
+}
+
+vec3 transmittanceToTopAtmosphereBoundary(sampler2D transmittance, float r, float mu)
+{
+    return texture(transmittance, transmittanceUvFromRMu(r, mu)).rgb;
+}
+
+// from (r, mu) over d, by the ratio of two lookups toward the top (or from the ground, for a ray that meets it)
+vec3 transmittanceAlong(sampler2D transmittance, float r, float mu, float d, bool rayIntersectsGround)
+{
+    float rD = clampRadius(sqrt(d * d + 2.0 * r * mu * d + r * r));
+    float muD = clampCosine((r * mu + d) / rD);
+    if (rayIntersectsGround)
+        return min(transmittanceToTopAtmosphereBoundary(transmittance, rD, -muD) / transmittanceToTopAtmosphereBoundary(transmittance, r, -mu), vec3(1.0));
+    return min(transmittanceToTopAtmosphereBoundary(transmittance, r, mu) / transmittanceToTopAtmosphereBoundary(transmittance, rD, muD), vec3(1.0));
+}
+
+// to the sun, the fraction of its disc above the horizon taken in
+vec3 transmittanceToSun(sampler2D transmittance, float r, float muS)
+{
+    float sinThetaH = bottomRadius / r;
+    float cosThetaH = -sqrt(max(1.0 - sinThetaH * sinThetaH, 0.0));
+    return transmittanceToTopAtmosphereBoundary(transmittance, r, muS) *
+           smoothstep(-sinThetaH * sunAngularRadius, sinThetaH * sunAngularRadius, muS - cosThetaH);
+}
+
+// scattering: w r, z mu with rays to the ground in the lower half, y mu_s up to muSMin, x nu
+
+vec4 scatteringUvwzFromRMuMuSNu(float r, float mu, float muS, float nu, bool rayIntersectsGround)
+{
+    float H = sqrt(topRadius * topRadius - bottomRadius * bottomRadius);
+    float rho = safeSqrt(r * r - bottomRadius * bottomRadius);
+    float uR = textureCoordFromUnitRange(rho / H, SCATTERING_R);
+    float rMu = r * mu;
+    float discriminant = rMu * rMu - r * r + bottomRadius * bottomRadius;
+    float uMu;
+    if (rayIntersectsGround)
+    {
+        float d = -rMu - safeSqrt(discriminant);
+        float dMin = r - bottomRadius;
+        float dMax = rho;
+        uMu = 0.5 - 0.5 * textureCoordFromUnitRange(dMax == dMin ? 0.0 : (d - dMin) / (dMax - dMin), SCATTERING_MU / 2);
+    }
+    else
+    {
+        float d = -rMu + safeSqrt(discriminant + H * H);
+        float dMin = topRadius - r;
+        float dMax = rho + H;
+        uMu = 0.5 + 0.5 * textureCoordFromUnitRange((d - dMin) / (dMax - dMin), SCATTERING_MU / 2);
+    }
+    float d = distanceToTopAtmosphereBoundary(bottomRadius, muS);
+    float dMin = topRadius - bottomRadius;
+    float dMax = H;
+    float a = (d - dMin) / (dMax - dMin);
+    float D = distanceToTopAtmosphereBoundary(bottomRadius, muSMin);
+    float A = (D - dMin) / (dMax - dMin);
+    float uMuS = textureCoordFromUnitRange(max(1.0 - a / A, 0.0) / (1.0 + a), SCATTERING_MU_S);
+    float uNu = (nu + 1.0) / 2.0;
+    return vec4(uNu, uMuS, uMu, uR);
+}
+
+void rMuMuSNuFromScatteringUvwz(vec4 uvwz, out float r, out float mu, out float muS, out float nu, out bool rayIntersectsGround)
+{
+    float H = sqrt(topRadius * topRadius - bottomRadius * bottomRadius);
+    float rho = H * unitRangeFromTextureCoord(uvwz.w, SCATTERING_R);
+    r = sqrt(rho * rho + bottomRadius * bottomRadius);
+    if (uvwz.z < 0.5)
+    {
+        float dMin = r - bottomRadius;
+        float dMax = rho;
+        float d = dMin + (dMax - dMin) * unitRangeFromTextureCoord(1.0 - 2.0 * uvwz.z, SCATTERING_MU / 2);
+        mu = d == 0.0 ? -1.0 : clampCosine(-(rho * rho + d * d) / (2.0 * r * d));
+        rayIntersectsGround = true;
+    }
+    else
+    {
+        float dMin = topRadius - r;
+        float dMax = rho + H;
+        float d = dMin + (dMax - dMin) * unitRangeFromTextureCoord(2.0 * uvwz.z - 1.0, SCATTERING_MU / 2);
+        mu = d == 0.0 ? 1.0 : clampCosine((H * H - rho * rho - d * d) / (2.0 * r * d));
+        rayIntersectsGround = false;
+    }
+    float xMuS = unitRangeFromTextureCoord(uvwz.y, SCATTERING_MU_S);
+    float dMin = topRadius - bottomRadius;
+    float dMax = H;
+    float D = distanceToTopAtmosphereBoundary(bottomRadius, muSMin);
+    float A = (D - dMin) / (dMax - dMin);
+    float a = (A - xMuS * A) / (1.0 + xMuS * A);
+    float d = dMin + min(a, A) * (dMax - dMin);
+    muS = d == 0.0 ? 1.0 : clampCosine((H * H - d * d) / (2.0 * d));
+    nu = clampCosine(uvwz.x * 2.0 - 1.0);
+}
+
+// the parameters of a texel of the 3D texture, nu kept possible for mu and mu_s
+void rMuMuSNuFromScatteringTexel(vec3 fragCoord, out float r, out float mu, out float muS, out float nu, out bool rayIntersectsGround)
+{
+    const vec4 size = vec4(SCATTERING_NU - 1, SCATTERING_MU_S, SCATTERING_MU, SCATTERING_R);
+    float fragNu = floor(fragCoord.x / float(SCATTERING_MU_S));
+    float fragMuS = mod(fragCoord.x, float(SCATTERING_MU_S));
+    vec4 uvwz = vec4(fragNu, fragMuS, fragCoord.y, fragCoord.z) / size;
+    rMuMuSNuFromScatteringUvwz(uvwz, r, mu, muS, nu, rayIntersectsGround);
+    nu = clamp(nu, mu * muS - sqrt((1.0 - mu * mu) * (1.0 - muS * muS)), mu * muS + sqrt((1.0 - mu * mu) * (1.0 - muS * muS)));
+}
+
+// nu between its two nearest slices
+vec3 scatteringLookup(sampler3D scattering, float r, float mu, float muS, float nu, bool rayIntersectsGround)
+{
+    vec4 uvwz = scatteringUvwzFromRMuMuSNu(r, mu, muS, nu, rayIntersectsGround);
+    float texCoordX = uvwz.x * float(SCATTERING_NU - 1);
+    float texX = floor(texCoordX);
+    float lerpX = texCoordX - texX;
+    vec3 uvw0 = vec3((texX + uvwz.y) / float(SCATTERING_NU), uvwz.z, uvwz.w);
+    vec3 uvw1 = vec3((texX + 1.0 + uvwz.y) / float(SCATTERING_NU), uvwz.z, uvwz.w);
+    return texture(scattering, uvw0).rgb * (1.0 - lerpX) + texture(scattering, uvw1).rgb * lerpX;
+}
+
+// irradiance: x mu_s, y the altitude
+
+vec2 irradianceUvFromRMuS(float r, float muS)
+{
+    float xR = (r - bottomRadius) / (topRadius - bottomRadius);
+    float xMuS = muS * 0.5 + 0.5;
+    return vec2(textureCoordFromUnitRange(xMuS, IRRADIANCE_WIDTH), textureCoordFromUnitRange(xR, IRRADIANCE_HEIGHT));
+}
+
+void rMuSFromIrradianceUv(vec2 uv, out float r, out float muS)
+{
+    float xMuS = unitRangeFromTextureCoord(uv.x, IRRADIANCE_WIDTH);
+    float xR = unitRangeFromTextureCoord(uv.y, IRRADIANCE_HEIGHT);
+    r = bottomRadius + xR * (topRadius - bottomRadius);
+    muS = clampCosine(2.0 * xMuS - 1.0);
+}
+
+vec3 irradianceLookup(sampler2D irradiance, float r, float muS)
+{
+    return texture(irradiance, irradianceUvFromRMuS(r, muS)).rgb;
+}
@@ -0,0 +1,243 @@
+#version 460 core
+// the atmosphere's LUTs (include/atmosphere.h, shaders.2/atmosphere.glsl), one stage per dispatch and the 3D ones
+// a slice of r at a time: transmittance (stage 0), the sun's direct irradiance on the ground (1), single Rayleigh
+// and Mie scattering (2), then for every further order the light scattered at each point from the last order's
+// (3), the ground's irradiance from the last order's sky (4) and this order's scattering, the density gathered along
+// the ray (5). The Rayleigh texture's rgb accumulates every order over the Rayleigh phase, so a lookup times the
+// Rayleigh phase is the whole sky but single Mie, which has its own texture.
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+
+#include "atmosphere.glsl"
+
+layout(binding = 0) uniform sampler2D transmittanceTexture;
+layout(binding = 1) uniform sampler3D singleRayleighTexture;
+layout(binding = 2) uniform sampler3D singleMieTexture;
+layout(binding = 3) uniform sampler3D multipleScatteringTexture;   // the last order's, from the third on
+layout(binding = 4) uniform sampler2D deltaIrradianceTexture;      // the last order's
+layout(binding = 5) uniform sampler3D scatteringDensityTexture;
+
+layout(rgba32f, binding = 0) uniform writeonly image2D transmittanceImage;
+layout(rgba32f, binding = 1) uniform writeonly image2D deltaIrradianceImage;
+layout(rgba32f, binding = 2) uniform image2D irradianceImage;
+layout(rgba32f, binding = 3) uniform writeonly image3D deltaScatteringImage;   // single Rayleigh, then each order
+layout(rgba16f, binding = 4) uniform writeonly image3D singleMieImage;
+layout(rgba32f, binding = 5) uniform image3D scatteringImage;
+layout(rgba32f, binding = 6) uniform writeonly image3D scatteringDensityImage;
+
+uniform int stage;
+uniform int slice;          // the r slice of a 3D stage
+uniform int order;          // the scattering order being computed
+
+// transmittance
+
+float opticalLengthToTopAtmosphereBoundary(float r, float mu, float scaleHeight)
+{
+    const int SAMPLE_COUNT = 500;
+    float dx = distanceToTopAtmosphereBoundary(r, mu) / float(SAMPLE_COUNT);
+    float result = 0.0;
+    for (int i = 0; i <= SAMPLE_COUNT; i++)
+    {
+        float di = float(i) * dx;
+        float ri = sqrt(di * di + 2.0 * r * mu * di + r * r);
+        float weight = i == 0 || i == SAMPLE_COUNT ? 0.5 : 1.0;
+        result += exp(-(ri - bottomRadius) / scaleHeight) * weight * dx;
+    }
+    return result;
+}
+
+vec3 computeTransmittanceToTopAtmosphereBoundary(float r, float mu)
+{
+    return exp(-(rayleighScattering * opticalLengthToTopAtmosphereBoundary(r, mu, rayleighScaleHeight) +
+                 mieExtinction * opticalLengthToTopAtmosphereBoundary(r, mu, mieScaleHeight)));
+}
+
+// single scattering
+
+void singleScatteringIntegrand(float r, float mu, float muS, float nu, float d, bool rayIntersectsGround, out vec3 rayleigh, out vec3 mie)
+{
+    float rD = clampRadius(sqrt(d * d + 2.0 * r * mu * d + r * r));
+    float muSD = clampCosine((r * muS + d * nu) / rD);
+    vec3 transmittance = transmittanceAlong(transmittanceTexture, r, mu, d, rayIntersectsGround) * transmittanceToSun(transmittanceTexture, rD, muSD);
+    rayleigh = transmittance * rayleighDensity(rD);
+    mie = transmittance * mieDensity(rD);
+}
+
+void computeSingleScattering(float r, float mu, float muS, float nu, bool rayIntersectsGround, out vec3 rayleigh, out vec3 mie)
+{
+    const int SAMPLE_COUNT = 50;
+    float dx = distanceToNearestAtmosphereBoundary(r, mu, rayIntersectsGround) / float(SAMPLE_COUNT);
+    vec3 rayleighSum = vec3(0.0);
+    vec3 mieSum = vec3(0.0);
+    for (int i = 0; i <= SAMPLE_COUNT; i++)
+    {
+        vec3 rayleighI, mieI;
+        singleScatteringIntegrand(r, mu, muS, nu, float(i) * dx, rayIntersectsGround, rayleighI, mieI);
+        float weight = i == 0 || i == SAMPLE_COUNT ? 0.5 : 1.0;
+        rayleighSum += rayleighI * weight;
+        mieSum += mieI * weight;
+    }
+    rayleigh = rayleighSum * dx * solarIrradiance * rayleighScattering;
+    mie = mieSum * dx * solarIrradiance * mieScattering;
+}
+
+// the radiance of an order as it arrives: single scattering with its phase functions, the later orders with theirs
+vec3 scatteringOfOrder(float r, float mu, float muS, float nu, bool rayIntersectsGround, int scatteringOrder)
+{
+    if (scatteringOrder == 1)
+        return scatteringLookup(singleRayleighTexture, r, mu, muS, nu, rayIntersectsGround) * rayleighPhase(nu) +
+               scatteringLookup(singleMieTexture, r, mu, muS, nu, rayIntersectsGround) * miePhase(nu);
+    return scatteringLookup(multipleScatteringTexture, r, mu, muS, nu, rayIntersectsGround);
+}
+
+// multiple scattering
+
+vec3 computeScatteringDensity(float r, float mu, float muS, float nu)
+{
+    // the view and sun directions in a frame with the zenith on z
+    vec3 zenith = vec3(0.0, 0.0, 1.0);
+    vec3 omega = vec3(sqrt(1.0 - mu * mu), 0.0, mu);
+    float sunX = omega.x == 0.0 ? 0.0 : (nu - mu * muS) / omega.x;
+    float sunY = sqrt(max(1.0 - sunX * sunX - muS * muS, 0.0));
+    vec3 omegaS = vec3(sunX, sunY, muS);
+
+    const int SAMPLE_COUNT = 16;
+    const float dPhi = PI / float(SAMPLE_COUNT);
+    const float dTheta = PI / float(SAMPLE_COUNT);
+    vec3 density = vec3(0.0);
+    for (int l = 0; l < SAMPLE_COUNT; l++)
+    {
+        float theta = (float(l) + 0.5) * dTheta;
+        float cosTheta = cos(theta);
+        float sinTheta = sin(theta);
+        bool towardGround = rayIntersectsGround(r, cosTheta);
+        // light off the ground, as seen from direction omega_i
+        float distanceToGround = 0.0;
+        vec3 transmittanceToGround = vec3(0.0);
+        vec3 albedo = vec3(0.0);
+        if (towardGround)
+        {
+            distanceToGround = distanceToBottomAtmosphereBoundary(r, cosTheta);
+            transmittanceToGround = transmittanceAlong(transmittanceTexture, r, cosTheta, distanceToGround, true);
+            albedo = groundAlbedo;
+        }
+        for (int m = 0; m < 2 * SAMPLE_COUNT; m++)
+        {
+            float phi = (float(m) + 0.5) * dPhi;
+            vec3 omegaI = vec3(cos(phi) * sinTheta, sin(phi) * sinTheta, cosTheta);
+            float domegaI = dTheta * dPhi * sin(theta);
+            float nu1 = dot(omegaS, omegaI);
+            vec3 incident = scatteringOfOrder(r, omegaI.z, muS, nu1, towardGround, order - 1);
+            vec3 groundNormal = normalize(zenith * r + omegaI * distanceToGround);
+            vec3 groundIrradiance = irradianceLookup(deltaIrradianceTexture, bottomRadius, dot(groundNormal, omegaS));
+            incident += transmittanceToGround * albedo * (1.0 / PI) * groundIrradiance;
+            float nu2 = dot(omega, omegaI);
+            density += incident * (rayleighScattering * rayleighDensity(r) * rayleighPhase(nu2) +
+                                   mieScattering * mieDensity(r) * miePhase(nu2)) * domegaI;
+        }
+    }
+    return density;
+}
+
+vec3 computeMultipleScattering(float r, float mu, float muS, float nu, bool rayIntersectsGround)
+{
+    const int SAMPLE_COUNT = 50;
+    float dx = distanceToNearestAtmosphereBoundary(r, mu, rayIntersectsGround) / float(SAMPLE_COUNT);
+    vec3 sum = vec3(0.0);
+    for (int i = 0; i <= SAMPLE_COUNT; i++)
+    {
+        float di = float(i) * dx;
+        float ri = clampRadius(sqrt(di * di + 2.0 * r * mu * di + r * r));
+        float muI = clampCosine((r * mu + di) / ri);
+        float muSI = clampCosine((r * muS + di * nu) / ri);
+        vec3 scattered = scatteringLookup(scatteringDensityTexture, ri, muI, muSI, nu, rayIntersectsGround) *
+                         transmittanceAlong(transmittanceTexture, r, mu, di, rayIntersectsGround) * dx;
+        float weight = i == 0 || i == SAMPLE_COUNT ? 0.5 : 1.0;
+        sum += scattered * weight;
+    }
+    return sum;
+}
+
+// irradiance
+
+vec3 computeDirectIrradiance(float r, float muS)
+{
+    // the sun's disc partly below the horizon
+    float alphaS = sunAngularRadius;
+    float averageCosine = muS < -alphaS ? 0.0 : (muS > alphaS ? muS : (muS + alphaS) * (muS + alphaS) / (4.0 * alphaS));
+    return solarIrradiance * transmittanceToTopAtmosphereBoundary(transmittanceTexture, r, muS) * averageCosine;
+}
+
+vec3 computeIndirectIrradiance(float r, float muS, int scatteringOrder)
+{
+    const int SAMPLE_COUNT = 32;
+    const float dPhi = PI / float(SAMPLE_COUNT);
+    const float dTheta = PI / float(SAMPLE_COUNT);
+    vec3 result = vec3(0.0);
+    vec3 omegaS = vec3(sqrt(1.0 - muS * muS), 0.0, muS);
+    for (int j = 0; j < SAMPLE_COUNT / 2; j++)
+    {
+        float theta = (float(j) + 0.5) * dTheta;
+        for (int i = 0; i < 2 * SAMPLE_COUNT; i++)
+        {
+            float phi = (float(i) + 0.5) * dPhi;
+            vec3 omega = vec3(cos(phi) * sin(theta), sin(phi) * sin(theta), cos(theta));
+            float domega = dTheta * dPhi * sin(theta);
+            float nu = dot(omega, omegaS);
+            result += scatteringOfOrder(r, omega.z, muS, nu, false, scatteringOrder) * omega.z * domega;
+        }
+    }
+    return result;
+}
+
+void main()
+{
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    if (stage == 0 || stage == 1 || stage == 4)
+    {
+        ivec2 size = stage == 0 ? ivec2(TRANSMITTANCE_WIDTH, TRANSMITTANCE_HEIGHT) : ivec2(IRRADIANCE_WIDTH, IRRADIANCE_HEIGHT);
+        if (any(greaterThanEqual(texel, size)))
+            return;
+        vec2 uv = (vec2(texel) + 0.5) / vec2(size);
+        float r, mu;
+        if (stage == 0)
+        {
+            rMuFromTransmittanceUv(uv, r, mu);
+            imageStore(transmittanceImage, texel, vec4(computeTransmittanceToTopAtmosphereBoundary(r, mu), 1.0));
+            return;
+        }
+        rMuSFromIrradianceUv(uv, r, mu);
+        if (stage == 1)
+        {
+            imageStore(deltaIrradianceImage, texel, vec4(computeDirectIrradiance(r, mu), 1.0));
+            return;
+        }
+        // this order's light on the ground is from the last order's sky
+        vec3 indirect = computeIndirectIrradiance(r, mu, order - 1);
+        imageStore(deltaIrradianceImage, texel, vec4(indirect, 1.0));
+        imageStore(irradianceImage, texel, imageLoad(irradianceImage, texel) + vec4(indirect, 0.0));
+        return;
+    }
+
+    if (any(greaterThanEqual(texel, ivec2(SCATTERING_NU * SCATTERING_MU_S, SCATTERING_MU))))
+        return;
+    ivec3 voxel = ivec3(texel, slice);
+    float r, mu, muS, nu;
+    bool towardGround;
+    rMuMuSNuFromScatteringTexel(vec3(voxel) + 0.5, r, mu, muS, nu, towardGround);
+    if (stage == 2)
+    {
+        vec3 rayleigh, mie;
+        computeSingleScattering(r, mu, muS, nu, towardGround, rayleigh, mie);
+        imageStore(deltaScatteringImage, voxel, vec4(rayleigh, 1.0));
+        imageStore(singleMieImage, voxel, vec4(mie, 1.0));
+        imageStore(scatteringImage, voxel, vec4(rayleigh, 1.0));
+    }
+    else if (stage == 3)
+        imageStore(scatteringDensityImage, voxel, vec4(computeScatteringDensity(r, mu, muS, nu), 1.0));
+    else
+    {
+        vec3 multiple = computeMultipleScattering(r, mu, muS, nu, towardGround);
+        imageStore(deltaScatteringImage, voxel, vec4(multiple, 1.0));
+        imageStore(scatteringImage, voxel, imageLoad(scatteringImage, voxel) + vec4(multiple / rayleighPhase(nu), 0.0));
+    }
+}
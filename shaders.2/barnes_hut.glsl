@@ -0,0 +1,13 @@
+// a node of the GPU Barnes-Hut tree (include/gpu_barnes_hut.h), 64 bytes: the mass and its centre, the bounds with
+// their largest side in high.w, the children of an internal node or the body of a leaf in children.x, and the
+// parent, TREE_NONE at the root
+struct TreeNode {
+    vec4 massCenter;
+    vec4 low;
+    vec4 high;
+    uvec2 children;
+    uint parent;
+    uint visits;        // children that reached it while building
+};
+
+const uint TREE_NONE = 0xffffffffu;
@@ -0,0 +1,37 @@
+#version 460 core
+// structured.object.model.shader.vs for ModelBatch, every mesh of the model is one command of a multi-draw
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoords;
+layout(std140, binding = 0) uniform Matrices {
+    mat4 projection;
+    mat4 view;
+};
+// per mesh, xy the diffuse and zw the specular texture as 64-bit values: the unit in batchTextures + 1, or a
+// bindless handle. 0 for none.
+layout(std430, binding = 10) readonly buffer Materials {
+    uvec4 materials[];
+};
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+flat out uint Pick;
+flat out uvec4 MaterialTextures;   // the mesh's material, the same for the whole draw
+
+uniform mat4 model;
+uniform mat3 normalMatrix;
+uniform uint pickId;        // include/gpu_picker.h
+
+// the depth pre-pass draws with the light cube shader, the lit draws must meet its depth exactly
+invariant gl_Position;
+
+void main()
+{
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    FragPos = vec3(view * model * vec4(aPos, 1.0));
+    Normal = normalMatrix * aNormal;
+    TexCoords = aTexCoords;
+    MaterialTextures = materials[gl_DrawID];
+    Pick = pickId;
+}
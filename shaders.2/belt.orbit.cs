@@ -0,0 +1,42 @@
+#version 460 core
+// advances the GPU-only belt: circular Keplerian orbits around the sun and a constant spin per rock. Writes the
+// same position and orientation buffers the GPU N-body backend uses, so the same instanced shader draws it.
+layout(local_size_x = 256) in;
+
+struct Rock {
+    vec4 orbit;     // radius, angle, height above the orbital plane, spin rate
+    vec4 spin;      // spin axis, spin angle
+};
+
+layout(std430, binding = 0) writeonly buffer PositionMass {
+    vec4 posMass[];
+};
+layout(std430, binding = 2) writeonly buffer Orientation {
+    vec4 orientation[];
+};
+layout(std430, binding = 5) buffer Rocks {
+    Rock rocks[];
+};
+
+uniform uint rockCount;
+uniform float dt;
+uniform float mu;       // G times the sun's mass
+uniform vec3 center;    // the sun's position
+
+const float TWO_PI = 6.28318530718;
+
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= rockCount)
+        return;
+    Rock rock = rocks[i];
+    float radius = rock.orbit.x;
+    // kept in [0, 2pi) so float precision does not run out over a long session
+    float angle = mod(rock.orbit.y + sqrt(mu / (radius * radius * radius)) * dt, TWO_PI);
+    float spinAngle = mod(rock.spin.w + rock.orbit.w * dt, TWO_PI);
+    rocks[i].orbit.y = angle;
+    rocks[i].spin.w = spinAngle;
+    posMass[i] = vec4(center + vec3(radius * cos(angle), rock.orbit.z, radius * sin(angle)), 0.0);
+    orientation[i] = vec4(rock.spin.xyz * sin(0.5 * spinAngle), cos(0.5 * spinAngle));
+}
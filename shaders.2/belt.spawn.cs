@@ -0,0 +1,56 @@
+#version 460 core
+// places every rock of the GPU-only belt from a hash of its index, nothing is uploaded from the CPU
+layout(local_size_x = 256) in;
+
+struct Rock {
+    vec4 orbit;     // radius, angle, height above the orbital plane, spin rate
+    vec4 spin;      // spin axis, spin angle
+};
+
+layout(std430, binding = 3) writeonly buffer Scale {
+    float scale[];
+};
+layout(std430, binding = 5) writeonly buffer Rocks {
+    Rock rocks[];
+};
+
+uniform uint rockCount;
+uniform uint seed;
+uniform float innerRadius;
+uniform float outerRadius;
+uniform float height;
+uniform float minScale;
+uniform float maxScale;
+
+const float TWO_PI = 6.28318530718;
+
+// PCG hash, one well mixed 32-bit value per call
+uint pcg(inout uint state)
+{
+    state = state * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+float uniform01(inout uint state)
+{
+    return float(pcg(state) >> 8) * (1.0 / 16777216.0);
+}
+
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= rockCount)
+        return;
+    uint state = i * 0x9e3779b9u ^ seed;
+    float radius = mix(innerRadius, outerRadius, uniform01(state));
+    float angle = TWO_PI * uniform01(state);
+    float y = (uniform01(state) - 0.5) * height;
+    float spinRate = mix(-2.0, 2.0, uniform01(state));
+    float z = 2.0 * uniform01(state) - 1.0;
+    float phi = TWO_PI * uniform01(state);
+    vec3 axis = vec3(sqrt(1.0 - z * z) * cos(phi), z, sqrt(1.0 - z * z) * sin(phi));
+    rocks[i].orbit = vec4(radius, angle, y, spinRate);
+    rocks[i].spin = vec4(axis, TWO_PI * uniform01(state));
+    scale[i] = mix(minScale, maxScale, uniform01(state));
+}
@@ -0,0 +1,43 @@
+#version 460 core
+// one level of the bloom chain, the 13-tap downsample of Jimenez's "Next Generation Post Processing in Call of
+// Duty: Advanced Warfare": overlapping 2x2 boxes weighted so the result does not flicker as bright pixels move.
+// The first level also keeps only what is brighter than the threshold, with a soft knee below it.
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(r11f_g11f_b10f, binding = 0) writeonly uniform image2D destination;
+uniform sampler2D source;      // the HDR scene for the first level, the chain itself after that
+uniform int sourceLod;
+uniform bool prefilter;
+uniform float threshold;
+uniform float knee;
+
+vec3 tap(vec2 uv, vec2 texel, vec2 offset)
+{
+    return textureLod(source, uv + texel * offset, float(sourceLod)).rgb;
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = imageSize(destination);
+    if (pixel.x >= size.x || pixel.y >= size.y)
+        return;
+    vec2 uv = (vec2(pixel) + 0.5) / vec2(size);
+    vec2 texel = 1.0 / vec2(textureSize(source, sourceLod));
+
+    vec3 a = tap(uv, texel, vec2(-2.0, 2.0)), b = tap(uv, texel, vec2(0.0, 2.0)), c = tap(uv, texel, vec2(2.0, 2.0));
+    vec3 d = tap(uv, texel, vec2(-2.0, 0.0)), e = tap(uv, texel, vec2(0.0, 0.0)), f = tap(uv, texel, vec2(2.0, 0.0));
+    vec3 g = tap(uv, texel, vec2(-2.0, -2.0)), h = tap(uv, texel, vec2(0.0, -2.0)), i = tap(uv, texel, vec2(2.0, -2.0));
+    vec3 j = tap(uv, texel, vec2(-1.0, 1.0)), k = tap(uv, texel, vec2(1.0, 1.0));
+    vec3 l = tap(uv, texel, vec2(-1.0, -1.0)), m = tap(uv, texel, vec2(1.0, -1.0));
+    vec3 color = e * 0.125 + (a + c + g + i) * 0.03125 + (b + d + f + h) * 0.0625 + (j + k + l + m) * 0.125;
+
+    if (prefilter)
+    {
+        float brightness = max(color.r, max(color.g, color.b));
+        float soft = clamp(brightness - threshold + knee, 0.0, 2.0 * knee);
+        soft = soft * soft / (4.0 * knee + 1e-4);
+        color *= max(soft, brightness - threshold) / max(brightness, 1e-4);
+    }
+    imageStore(destination, pixel, vec4(color, 1.0));
+}
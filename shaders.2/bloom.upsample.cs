@@ -0,0 +1,27 @@
+#version 460 core
+// one level of the bloom chain on the way back up: the smaller level below filtered with a 3x3 tent and added to
+// this one, so level 0 ends up with every level's blur
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(r11f_g11f_b10f, binding = 0) uniform image2D destination;
+uniform sampler2D source;      // the chain, read one level below the destination
+uniform int sourceLod;
+uniform float radius;          // of the tent, in source texels
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = imageSize(destination);
+    if (pixel.x >= size.x || pixel.y >= size.y)
+        return;
+    vec2 uv = (vec2(pixel) + 0.5) / vec2(size);
+    vec2 d = radius / vec2(textureSize(source, sourceLod));
+    float lod = float(sourceLod);
+
+    vec3 up = textureLod(source, uv, lod).rgb * 4.0;
+    up += (textureLod(source, uv + vec2(-d.x, 0.0), lod).rgb + textureLod(source, uv + vec2(d.x, 0.0), lod).rgb
+         + textureLod(source, uv + vec2(0.0, -d.y), lod).rgb + textureLod(source, uv + vec2(0.0, d.y), lod).rgb) * 2.0;
+    up += textureLod(source, uv + vec2(-d.x, -d.y), lod).rgb + textureLod(source, uv + vec2(d.x, -d.y), lod).rgb
+        + textureLod(source, uv + vec2(-d.x, d.y), lod).rgb + textureLod(source, uv + vec2(d.x, d.y), lod).rgb;
+    imageStore(destination, pixel, imageLoad(destination, pixel) + vec4(up / 16.0, 0.0));
+}
@@ -0,0 +1,30 @@
+// the point lights binned into view-space clusters by light.cluster.cs, see include/clustered_lights.h. A cluster
+// is a screen tile times a depth slice, slices grow exponentially with depth so each is about as deep as wide.
+#define CLUSTER_MAX_LIGHTS 64u    // ClusteredLights::MAX_LIGHTS_PER_CLUSTER
+
+// a point light as PointLight holds it, position camera-relative with its range in w
+struct ClusterLight {
+    vec4 position;
+    vec4 attenuation;   // constant, linear, quadratic
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+};
+
+layout(std430, binding = 12) readonly buffer ClusterLights {
+    ClusterLight clusterLights[];
+};
+
+// lights per cluster, then CLUSTER_MAX_LIGHTS light indices per cluster
+layout(std430, binding = 13) buffer ClusterCounts {
+    uint clusterCounts[];
+};
+layout(std430, binding = 14) buffer ClusterIndices {
+    uint clusterIndices[];
+};
+
+layout(std140, binding = 2) uniform ClusterParams {
+    uvec4 clusterGrid;      // clusters across, down and in depth, lights in ClusterLights
+    vec4 clusterTile;       // tile width and height in pixels, scale and bias from log(view depth) to the slice
+    vec4 clusterDepth;      // near and far plane, the width of a view when several are side by side (0 for one)
+};
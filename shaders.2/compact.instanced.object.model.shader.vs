@@ -0,0 +1,88 @@
+#version 460 core
+// asteroid instances from a 40-byte record, the model matrix is rebuilt here instead of on the CPU
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoords;
+layout(location = 8) in vec4 aInstancePositionScale;   // xyz position relative to the camera, w uniform scale
+layout(location = 9) in vec4 aInstanceOrientation;     // quaternion stored as xyzw
+layout(location = 10) in vec3 aInstanceSpinAxis;       // body-frame tumble axis
+layout(location = 11) in float aInstanceSpinRate;      // radians per sim second
+#include "picking.glsl"
+#include "rock_variant.glsl"
+
+#include "stereo.glsl"
+
+uniform float spinTime;        // sim time, wrapped on the CPU so the float keeps its precision
+uniform bool impostor;         // one point per instance for impostor.point.fs instead of the mesh
+uniform float modelRadius;     // bounding sphere of the unscaled model, sizes the point
+uniform float viewportHeight;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+out float ImpostorRadius;      // view-space radius of the point's sphere
+flat out uint Variant;         // a number fixed per rock, picks its texture layer in rock.instanced.object.model.shader.fs
+flat out uint Pick;            // the record in the stream, the viewer knows whose it is
+#ifdef SHADOW_PASS
+flat out vec4 ShadowSphere;      // the rock's bounding sphere for shadow.cube.gs
+#endif
+
+mat3 quatToMat3(vec4 q)
+{
+    vec3 q2 = q.xyz * 2.0;
+    float xx = q.x * q2.x, yy = q.y * q2.y, zz = q.z * q2.z;
+    float xy = q.x * q2.y, xz = q.x * q2.z, yz = q.y * q2.z;
+    float wx = q.w * q2.x, wy = q.w * q2.y, wz = q.w * q2.z;
+    return mat3(1.0 - (yy + zz), xy + wz, xz - wy,
+                xy - wz, 1.0 - (xx + zz), yz + wx,
+                xz + wy, yz - wx, 1.0 - (xx + yy));
+}
+
+// rotation by angle about a unit axis (Rodrigues)
+mat3 axisAngleToMat3(vec3 axis, float angle)
+{
+    float s = sin(angle), c = cos(angle);
+    vec3 t = axis * (1.0 - c);
+    return mat3(t.x * axis.x + c, t.x * axis.y + s * axis.z, t.x * axis.z - s * axis.y,
+                t.y * axis.x - s * axis.z, t.y * axis.y + c, t.y * axis.z + s * axis.x,
+                t.z * axis.x + s * axis.y, t.z * axis.y - s * axis.x, t.z * axis.z + c);
+}
+
+void main()
+{
+    // the spin axis comes from the body id, so it names the rock wherever the record lands in the stream
+    uvec3 axisBits = floatBitsToUint(aInstanceSpinAxis);
+    Pick = PICK_RECORD | (uint(gl_BaseInstance) + stereoInstance());
+    Variant = (axisBits.x * 73856093u ^ axisBits.y * 19349663u ^ axisBits.z * 83492791u) >> 16;
+    if (impostor)
+    {
+        // a lit disc the size of the rock's bounding sphere, drawn as a single point
+        vec4 viewCenter = view * vec4(aInstancePositionScale.xyz, 1.0);
+        ImpostorRadius = modelRadius * aInstancePositionScale.w;
+        gl_Position = stereoPosition(aInstancePositionScale.xyz);
+        gl_PointSize = max(ImpostorRadius * projection[1][1] * viewportHeight / max(-viewCenter.z, 1e-4), 1.0);
+        FragPos = viewCenter.xyz;
+        Normal = vec3(0.0, 0.0, 1.0);
+        TexCoords = vec2(0.5);
+        return;
+    }
+    // spawn orientation followed by a steady spin about the body-frame axis
+    vec3 axis = normalize(aInstanceSpinAxis);
+    mat3 rotation = quatToMat3(aInstanceOrientation) * axisAngleToMat3(axis, aInstanceSpinRate * spinTime);
+    // a procedural rock's own shape, nothing for the rock's mesh
+    vec3 localPos = aPos;
+    vec3 localNormal = aNormal;
+    reliefRock(Variant, localPos, localNormal);
+    vec3 worldPos = aInstancePositionScale.xyz + rotation * (localPos * aInstancePositionScale.w);
+#ifdef SHADOW_PASS
+    // camera-relative, shadow.cube.gs projects it into every face of the sun's cube map
+    gl_Position = vec4(worldPos, 1.0);
+    ShadowSphere = vec4(aInstancePositionScale.xyz, modelRadius * aInstancePositionScale.w);
+    return;
+#endif
+    gl_Position = stereoPosition(worldPos);
+    FragPos = vec3(view * vec4(worldPos, 1.0));
+    // uniform scale, so the normal matrix is just the rotation
+    Normal = mat3(view) * rotation * localNormal;
+    TexCoords = aTexCoords;
+}
@@ -0,0 +1,84 @@
+#version 460 core
+#include "moment_shadows.glsl"
+
+out vec4 FragColor;
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+in float ViewDepth;
+
+#define MAX_CASCADES 4
+
+uniform sampler2D diffuseTexture;
+uniform sampler2DArrayShadow shadowMap;
+uniform sampler2DArray shadowMoments;   // blurred depth moments, with filteredShadows
+
+uniform mat4 cascadeMatrices[MAX_CASCADES];
+uniform float cascadeSplits[MAX_CASCADES];
+uniform int cascadeCount;
+uniform float cascadeTexel;
+uniform bool filteredShadows;
+uniform float bleedReduction;
+
+uniform vec3 lightDir;
+uniform vec3 viewPos;
+uniform bool showCascades;
+
+const vec3 cascadeTints[MAX_CASCADES] = vec3[](vec3(1.0, 0.6, 0.6), vec3(0.6, 1.0, 0.6), vec3(0.6, 0.6, 1.0), vec3(1.0, 1.0, 0.6));
+
+// the first cascade whose slice reaches the fragment, past the last one it is lit
+int cascadeIndex()
+{
+    for (int c = 0; c < cascadeCount; c++)
+        if (ViewDepth < cascadeSplits[c])
+            return c;
+    return cascadeCount;
+}
+
+float ShadowCalculation(int cascade, vec3 normal, vec3 light)
+{
+    if (cascade >= cascadeCount)
+        return 0.0;
+    // out along the normal by a texel of this cascade, wider cascades have wider texels
+    float texelWorld = 2.0 / (cascadeMatrices[cascade][0][0] * textureSize(shadowMap, 0).x);
+    vec3 offsetPos = FragPos + normal * texelWorld * (1.0 - 0.5 * max(dot(normal, light), 0.0));
+    vec4 lightSpace = cascadeMatrices[cascade] * vec4(offsetPos, 1.0);
+    vec3 projCoords = lightSpace.xyz / lightSpace.w * 0.5 + 0.5;
+    if (projCoords.z > 1.0)
+        return 0.0;
+    // one bilinear sample of the blurred moments
+    if (filteredShadows)
+        return 1.0 - momentShadow(texture(shadowMoments, vec3(projCoords.xy, float(cascade))).rg, projCoords.z, 1e-6, bleedReduction);
+    // 3x3 of hardware-compared bilinear taps
+    float lit = 0.0;
+    for (int x = -1; x <= 1; ++x)
+        for (int y = -1; y <= 1; ++y)
+            lit += texture(shadowMap, vec4(projCoords.xy + vec2(x, y) * cascadeTexel, float(cascade), projCoords.z));
+    return 1.0 - lit / 9.0;
+}
+
+void main()
+{
+    vec3 color = texture(diffuseTexture, TexCoords).rgb;
+    vec3 normal = normalize(Normal);
+    vec3 lightColor = vec3(0.3);
+    vec3 light = normalize(-lightDir);
+    // ambient
+    vec3 ambient = 0.3 * lightColor;
+    // diffuse
+    float diff = max(dot(light, normal), 0.0);
+    vec3 diffuse = diff * lightColor;
+    // specular
+    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 halfwayDir = normalize(light + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), 64.0);
+    vec3 specular = spec * lightColor;
+
+    int cascade = cascadeIndex();
+    float shadow = ShadowCalculation(cascade, normal, light);
+    vec3 lighting = (ambient + (1.0 - shadow) * (diffuse + specular)) * color;
+    if (showCascades && cascade < cascadeCount)
+        lighting *= cascadeTints[cascade];
+    FragColor = vec4(lighting, 1.0);
+}
@@ -0,0 +1,25 @@
+#version 460 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+out float ViewDepth;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform mat4 model;
+
+void main()
+{
+    vec4 world = model * vec4(aPos, 1.0);
+    vec4 viewPos = view * world;
+    FragPos = world.xyz;
+    Normal = transpose(inverse(mat3(model))) * aNormal;
+    TexCoords = aTexCoords;
+    // distance along the view axis, what the cascade splits are measured in
+    ViewDepth = -viewPos.z;
+    gl_Position = projection * viewPos;
+}
@@ -0,0 +1,12 @@
+#version 460 core
+// unlit, a click on a debug primitive picks nothing as on the orbit lines
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out uint PickId;
+
+in vec4 Color;
+
+void main()
+{
+    FragColor = vec4(Color.rgb, 1.0);
+    PickId = 0u;
+}
@@ -0,0 +1,16 @@
+#version 460 core
+// a debug line's end, camera-relative, include/debug_draw.h
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec4 aColor;
+layout(std140, binding = 0) uniform Matrices {
+    mat4 projection;
+    mat4 view;
+};
+
+out vec4 Color;
+
+void main()
+{
+    Color = aColor;
+    gl_Position = projection * view * vec4(aPos, 1.0);
+}
@@ -0,0 +1,44 @@
+#version 460 core
+// a debug box or sphere per instance, include/debug_draw.h: its outline as a line list made from gl_VertexID, the
+// box's 12 edges or the sphere's three great circles of 16 segments. A box's vertices past its 24 collapse to a
+// point outside the clip volume.
+layout (location = 0) in vec4 aCenter;     // camera-relative, the kind in w: 0 a box, 1 a sphere
+layout (location = 1) in vec3 aExtent;     // the box's half extents, the sphere's radius in x
+layout (location = 2) in vec4 aColor;
+layout(std140, binding = 0) uniform Matrices {
+    mat4 projection;
+    mat4 view;
+};
+
+out vec4 Color;
+
+const float TAU = 6.28318530718;
+
+void main()
+{
+    uint v = uint(gl_VertexID);
+    vec3 offset;
+    if (aCenter.w < 0.5) {
+        if (v >= 24u) {
+            gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+            Color = vec4(0.0);
+            return;
+        }
+        // four edges along each axis, the other two axes' signs from the edge's low bits
+        uint edge = v >> 1u;
+        uint axis = edge >> 2u;
+        vec3 corner;
+        corner[axis] = (v & 1u) == 0u ? -1.0 : 1.0;
+        corner[(axis + 1u) % 3u] = (edge & 1u) == 0u ? -1.0 : 1.0;
+        corner[(axis + 2u) % 3u] = (edge & 2u) == 0u ? -1.0 : 1.0;
+        offset = corner * aExtent;
+    } else {
+        uint circle = v >> 5u;
+        float angle = float(((v & 31u) >> 1u) + (v & 1u)) * (TAU / 16.0);
+        offset = vec3(0.0);
+        offset[(circle + 1u) % 3u] = cos(angle) * aExtent.x;
+        offset[(circle + 2u) % 3u] = sin(angle) * aExtent.x;
+    }
+    Color = aColor;
+    gl_Position = projection * view * vec4(aCenter.xyz + offset, 1.0);
+}
@@ -0,0 +1,106 @@
+#version 460 core
+// the lighting pass of the deferred path: the lights of the lit fragment shaders evaluated once per pixel from the
+// G-buffer (gbuffer.glsl) instead of once per rasterized fragment
+#include "lights.glsl"
+#include "depth.glsl"
+
+in vec2 TexCoords;
+
+out vec4 FragColor;
+
+uniform sampler2D gAlbedoSpecular;
+uniform sampler2D gNormalShininess;
+uniform sampler2D gDepth;
+uniform mat4 inverseProjection;
+uniform mat4 viewMat;
+
+vec3 diffuseColor;
+vec3 specularColor;
+float shininess;
+
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+
+// octEncode of gbuffer.glsl undone
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+void main() {
+    float depth = texture(gDepth, TexCoords).r;
+    // nothing was drawn here, the skybox fills it in later
+    if (isFarDepth(depth))
+        discard;
+    vec4 albedoSpecular = texture(gAlbedoSpecular, TexCoords);
+    vec4 normalShininess = texture(gNormalShininess, TexCoords);
+    diffuseColor = albedoSpecular.rgb;
+    specularColor = vec3(albedoSpecular.a);
+    shininess = normalShininess.b * 256.0;
+    vec3 norm = octDecode(normalShininess.rg * 2.0 - 1.0);
+    vec4 view = inverseProjection * vec4(ndcFromWindow(TexCoords, depth), 1.0);
+    vec3 FragPos = view.xyz / view.w;
+
+    vec3 viewDir = normalize(-FragPos);
+    vec3 result = CalcDirLight(dirLight, norm, viewDir);
+#ifdef CLUSTERED_LIGHTS
+    uint cluster = fragmentCluster(FragPos);
+    for (uint i = 0u; i < clusterCounts[cluster]; i++) {
+        pointShadow = pointLightShadow(clusterLightIndex(cluster, i), FragPos, norm);
+        result += CalcPointLight(clusterLight(cluster, i), norm, FragPos, viewDir);
+    }
+#else
+    for(int i = 0; i < NR_POINT_LIGHTS; i++) {
+        pointShadow = pointLightShadow(uint(i), FragPos, norm);
+        result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
+    }
+#endif
+    result += CalcSpotLight(spotLight, norm, FragPos, viewDir);
+    FragColor = vec4(result, 1.0);
+    // the geometry's depth, so the sun and the skybox drawn afterwards still test against it
+    gl_FragDepth = depth;
+}
+
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir) {
+    vec3 lightDir = normalize(- (viewMat * vec4(light.direction, 0.0)).xyz);
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), shininess);
+    vec3 ambient = light.ambient * diffuseColor;
+    vec3 diffuse = light.diffuse * diff * diffuseColor;
+    vec3 specular = light.specular * spec * specularColor;
+    return (ambient + diffuse + specular);
+}
+
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    vec3 lightDir = normalize(vec3(viewMat * light.position) - fragPos);
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), shininess);
+    float distance = length(vec3(viewMat * light.position) - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    vec3 ambient = light.ambient * diffuseColor;
+    vec3 diffuse = light.diffuse * diff * pointShadow * diffuseColor;
+    vec3 specular = light.specular * spec * pointShadow * specularColor;
+    return (ambient + diffuse + specular) * attenuation;
+}
+
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    float diff = max(dot(normal, viewDir), 0.0);
+    float spec = pow(max(dot(normal, viewDir), 0.0), shininess);
+    float distance = length(-fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    float theta = dot(viewDir, normalize(-vec3(0.0, 0.0, -1.0)));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    vec3 ambient = light.ambient * diffuseColor;
+    vec3 diffuse = light.diffuse * diff * diffuseColor;
+    vec3 specular = light.specular * spec * specularColor;
+    return (ambient + diffuse + specular) * attenuation * intensity;
+}
@@ -0,0 +1,46 @@
+#version 460 core
+// one direction of the density map's separable Gaussian: across from the counts into the first image, then down
+// from it into the second
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(std430, binding = 5) readonly buffer Counts {
+    uint count[];
+};
+layout(r32f, binding = 0) uniform image2D across;
+layout(r32f, binding = 1) writeonly uniform image2D blurred;
+
+uniform uint resolution;
+uniform int radius;     // taps either side
+uniform float sigma;
+uniform int vertical;
+
+float source(ivec2 cell)
+{
+    if (vertical == 0)
+        return float(count[uint(cell.y) * resolution + uint(cell.x)]);
+    return imageLoad(across, cell).r;
+}
+
+void main()
+{
+    ivec2 cell = ivec2(gl_GlobalInvocationID.xy);
+    int size = int(resolution);
+    if (cell.x >= size || cell.y >= size)
+        return;
+    ivec2 step = vertical == 0 ? ivec2(1, 0) : ivec2(0, 1);
+    float sum = 0.0;
+    for (int k = -radius; k <= radius; k++) {
+        ivec2 at = cell + k * step;
+        if (any(lessThan(at, ivec2(0))) || any(greaterThanEqual(at, ivec2(size))))
+            continue;
+        sum += exp(-0.5 * float(k * k) / (sigma * sigma)) * source(at);
+    }
+    // the weights of a full kernel, so the edges fade like the belt does instead of being renormalized up
+    float total = 0.0;
+    for (int k = -radius; k <= radius; k++)
+        total += exp(-0.5 * float(k * k) / (sigma * sigma));
+    if (vertical == 0)
+        imageStore(across, cell, vec4(sum / total));
+    else
+        imageStore(blurred, cell, vec4(sum / total));
+}
@@ -0,0 +1,32 @@
+#version 460 core
+// bodies per texel through a log scale and an inferno-like colour map, transparent where there are none
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out uint PickId;
+
+in vec2 TexCoords;
+
+uniform sampler2D density;
+uniform float exposure;
+uniform float opacity;
+
+vec3 inferno(float t)
+{
+    const vec3 c0 = vec3(0.0002, 0.0016, -0.0194);
+    const vec3 c1 = vec3(0.1065, 0.5640, 3.9327);
+    const vec3 c2 = vec3(11.6025, -3.9728, -15.9423);
+    const vec3 c3 = vec3(-41.7040, 17.4364, 44.3541);
+    const vec3 c4 = vec3(77.1629, -33.4023, -81.8073);
+    const vec3 c5 = vec3(-71.3194, 32.6261, 73.2095);
+    const vec3 c6 = vec3(25.0930, -12.2427, -23.0703);
+    return clamp(c0 + t * (c1 + t * (c2 + t * (c3 + t * (c4 + t * (c5 + t * c6))))), 0.0, 1.0);
+}
+
+void main()
+{
+    float n = texture(density, TexCoords).r;
+    if (n <= 1e-3)
+        discard;
+    float t = clamp(log(1.0 + n) * exposure / 8.0, 0.0, 1.0);
+    FragColor = vec4(inferno(t), opacity * smoothstep(0.0, 0.05, t));
+    PickId = 0u;
+}
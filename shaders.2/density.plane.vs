@@ -0,0 +1,20 @@
+#version 460 core
+// the density map's quad on the ecliptic, no vertex buffers: four corners from the vertex id around the grid's centre
+layout(std140, binding = 0) uniform Matrices {
+    mat4 projection;
+    mat4 view;
+};
+
+uniform vec3 origin;        // the camera, the grid is placed in world units
+uniform vec3 center;
+uniform float extent;
+
+out vec2 TexCoords;
+
+void main()
+{
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    TexCoords = corner;
+    vec3 world = vec3(center.x + (2.0 * corner.x - 1.0) * extent, center.y, center.z + (2.0 * corner.y - 1.0) * extent);
+    gl_Position = projection * view * vec4(world - origin, 1.0);
+}
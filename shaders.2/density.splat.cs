@@ -0,0 +1,28 @@
+#version 460 core
+// one count per body into the grid cell under it on the ecliptic (include/density_map.h), off the grid not counted
+layout(local_size_x = 256) in;
+
+layout(std430, binding = 0) readonly buffer PositionMass {
+    vec4 posMass[];
+};
+layout(std430, binding = 5) buffer Counts {
+    uint count[];       // resolution x resolution, x along world x and y along world z
+};
+
+uniform uint first;
+uniform uint bodyCount;
+uniform uint resolution;
+uniform vec3 center;
+uniform float extent;   // half the grid's side
+
+void main()
+{
+    uint i = first + gl_GlobalInvocationID.x;
+    if (i >= bodyCount)
+        return;
+    vec2 uv = (posMass[i].xz - center.xz) / (2.0 * extent) + 0.5;
+    if (any(lessThan(uv, vec2(0.0))) || any(greaterThanEqual(uv, vec2(1.0))))
+        return;
+    uvec2 cell = min(uvec2(uv * float(resolution)), uvec2(resolution - 1u));
+    atomicAdd(count[cell.y * resolution + cell.x], 1u);
+}
@@ -0,0 +1,62 @@
+// The camera's depth convention (include/depth_convention.h) for shaders that read or write depth themselves.
+// Every program is built with REVERSE_Z when the camera is reversed: the near plane at window depth 1, infinity
+// at 0 and normalized device z in [0, 1]. Otherwise it is GL's, the near plane at 0, the far one at 1 and device
+// z in [-1, 1].
+#ifdef REVERSE_Z
+const float FAR_DEPTH = 0.0;       // cleared depth, and that of points at infinity
+const float NDC_NEAR = 1.0;        // device z of the near plane
+const float NDC_BEYOND = 0.5;      // device z of a point past it that still unprojects to a finite one
+#else
+const float FAR_DEPTH = 1.0;
+const float NDC_NEAR = -1.0;
+const float NDC_BEYOND = 1.0;
+#endif
+
+// window depth of a clip position
+float windowDepth(vec4 clip)
+{
+#ifdef REVERSE_Z
+    return clip.z / clip.w;
+#else
+    return clip.z / clip.w * 0.5 + 0.5;
+#endif
+}
+
+// device coordinates of a texture coordinate and the window depth there
+vec3 ndcFromWindow(vec2 uv, float depth)
+{
+#ifdef REVERSE_Z
+    return vec3(uv * 2.0 - 1.0, depth);
+#else
+    return vec3(uv, depth) * 2.0 - 1.0;
+#endif
+}
+
+// nothing was drawn at this depth
+bool isFarDepth(float depth)
+{
+#ifdef REVERSE_Z
+    return depth <= 0.0;
+#else
+    return depth >= 1.0;
+#endif
+}
+
+float farthestDepth(float a, float b)
+{
+#ifdef REVERSE_Z
+    return min(a, b);
+#else
+    return max(a, b);
+#endif
+}
+
+// a direction's clip position at the farthest depth, for the sky
+vec4 atFarPlane(vec4 clip)
+{
+#ifdef REVERSE_Z
+    return vec4(clip.xy, 0.0, clip.w);
+#else
+    return clip.xyww;
+#endif
+}
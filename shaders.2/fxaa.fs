@@ -0,0 +1,111 @@
+#version 460 core
+// FXAA 3.11's quality path on the scene target: where the local luma contrast is high enough, the edge direction
+// is found from the 3x3 neighbourhood, walked both ways to its ends and the pixel resampled across it, with
+// subpixel blending for features narrower than a pixel
+in vec2 TexCoords;
+
+out vec4 FragColor;
+
+uniform sampler2D scene;
+uniform vec2 texelSize;
+
+const float EDGE_THRESHOLD = 0.125;
+const float EDGE_THRESHOLD_MIN = 0.0312;
+const float SUBPIXEL_QUALITY = 0.75;
+const int SEARCH_STEPS = 12;
+const float SEARCH_STEP[SEARCH_STEPS] = float[](1.0, 1.0, 1.0, 1.0, 1.0, 1.5, 2.0, 2.0, 2.0, 2.0, 4.0, 8.0);
+
+float luma(vec3 color)
+{
+    return dot(color, vec3(0.299, 0.587, 0.114));
+}
+
+float lumaAt(vec2 uv)
+{
+    return luma(texture(scene, uv).rgb);
+}
+
+float lumaOffset(ivec2 offset)
+{
+    return luma(textureOffset(scene, TexCoords, offset).rgb);
+}
+
+void main()
+{
+    vec3 center = texture(scene, TexCoords).rgb;
+    float lumaM = luma(center);
+    float lumaN = lumaOffset(ivec2(0, 1));
+    float lumaS = lumaOffset(ivec2(0, -1));
+    float lumaE = lumaOffset(ivec2(1, 0));
+    float lumaW = lumaOffset(ivec2(-1, 0));
+    float lumaMax = max(lumaM, max(max(lumaN, lumaS), max(lumaE, lumaW)));
+    float lumaMin = min(lumaM, min(min(lumaN, lumaS), min(lumaE, lumaW)));
+    float range = lumaMax - lumaMin;
+    if (range < max(EDGE_THRESHOLD_MIN, lumaMax * EDGE_THRESHOLD))
+    {
+        FragColor = vec4(center, 1.0);
+        return;
+    }
+
+    float lumaNW = lumaOffset(ivec2(-1, 1));
+    float lumaNE = lumaOffset(ivec2(1, 1));
+    float lumaSW = lumaOffset(ivec2(-1, -1));
+    float lumaSE = lumaOffset(ivec2(1, -1));
+    float edgeHorizontal = abs(lumaNW + lumaSW - 2.0 * lumaW) + 2.0 * abs(lumaN + lumaS - 2.0 * lumaM) + abs(lumaNE + lumaSE - 2.0 * lumaE);
+    float edgeVertical = abs(lumaNW + lumaNE - 2.0 * lumaN) + 2.0 * abs(lumaW + lumaE - 2.0 * lumaM) + abs(lumaSW + lumaSE - 2.0 * lumaS);
+    bool horizontal = edgeHorizontal >= edgeVertical;
+
+    // which side of the pixel the edge lies on: the steeper of the two gradients across it
+    float luma1 = horizontal ? lumaS : lumaW;
+    float luma2 = horizontal ? lumaN : lumaE;
+    float gradient1 = luma1 - lumaM;
+    float gradient2 = luma2 - lumaM;
+    bool steepest1 = abs(gradient1) >= abs(gradient2);
+    float gradientScaled = 0.25 * max(abs(gradient1), abs(gradient2));
+    float stepLength = horizontal ? texelSize.y : texelSize.x;
+    float lumaLocalAverage = 0.5 * ((steepest1 ? luma1 : luma2) + lumaM);
+    if (steepest1)
+        stepLength = -stepLength;
+
+    // along the edge, half a pixel over onto it, until the luma leaves the edge's average at both ends
+    vec2 edgeUv = TexCoords + (horizontal ? vec2(0.0, 0.5 * stepLength) : vec2(0.5 * stepLength, 0.0));
+    vec2 along = horizontal ? vec2(texelSize.x, 0.0) : vec2(0.0, texelSize.y);
+    vec2 uv1 = edgeUv - along;
+    vec2 uv2 = edgeUv + along;
+    float lumaEnd1 = lumaAt(uv1) - lumaLocalAverage;
+    float lumaEnd2 = lumaAt(uv2) - lumaLocalAverage;
+    bool reached1 = abs(lumaEnd1) >= gradientScaled;
+    bool reached2 = abs(lumaEnd2) >= gradientScaled;
+    for (int i = 1; i < SEARCH_STEPS && !(reached1 && reached2); i++)
+    {
+        if (!reached1)
+        {
+            uv1 -= along * SEARCH_STEP[i];
+            lumaEnd1 = lumaAt(uv1) - lumaLocalAverage;
+            reached1 = abs(lumaEnd1) >= gradientScaled;
+        }
+        if (!reached2)
+        {
+            uv2 += along * SEARCH_STEP[i];
+            lumaEnd2 = lumaAt(uv2) - lumaLocalAverage;
+            reached2 = abs(lumaEnd2) >= gradientScaled;
+        }
+    }
+
+    float distance1 = horizontal ? TexCoords.x - uv1.x : TexCoords.y - uv1.y;
+    float distance2 = horizontal ? uv2.x - TexCoords.x : uv2.y - TexCoords.y;
+    bool nearer1 = distance1 < distance2;
+    float pixelOffset = 0.5 - min(distance1, distance2) / (distance1 + distance2);
+    // only when the nearer end turns the way the centre does, otherwise the pixel is past the edge's middle
+    bool centerSmaller = lumaM < lumaLocalAverage;
+    bool correctVariation = ((nearer1 ? lumaEnd1 : lumaEnd2) < 0.0) != centerSmaller;
+    float finalOffset = correctVariation ? pixelOffset : 0.0;
+
+    float lumaAverage = (2.0 * (lumaN + lumaS + lumaE + lumaW) + lumaNW + lumaNE + lumaSW + lumaSE) / 12.0;
+    float subpixel = clamp(abs(lumaAverage - lumaM) / range, 0.0, 1.0);
+    subpixel = (-2.0 * subpixel + 3.0) * subpixel * subpixel;
+    finalOffset = max(finalOffset, subpixel * subpixel * SUBPIXEL_QUALITY);
+
+    vec2 finalUv = TexCoords + (horizontal ? vec2(0.0, finalOffset * stepLength) : vec2(finalOffset * stepLength, 0.0));
+    FragColor = vec4(texture(scene, finalUv).rgb, 1.0);
+}
@@ -0,0 +1,19 @@
+// the G-buffer outputs of the deferred path, see include/gbuffer.h: albedo with the specular intensity, and the
+// view-space normal octahedrally encoded with the material's shininess. Depth is the depth attachment.
+layout(location = 0) out vec4 gAlbedoSpecular;
+layout(location = 1) out vec4 gNormalShininess;
+layout(location = 2) out uint PickId;     // include/gpu_picker.h
+
+// a unit vector folded onto the octahedron and flattened to [-1, 1]^2
+vec2 octEncode(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 folded = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return n.z >= 0.0 ? n.xy : folded;
+}
+
+void writeGBuffer(vec3 albedo, vec3 specular, vec3 normal)
+{
+    gAlbedoSpecular = vec4(albedo, dot(specular, vec3(0.2126, 0.7152, 0.0722)));
+    gNormalShininess = vec4(octEncode(normal) * 0.5 + 0.5, clamp(material.shininess / 256.0, 0.0, 1.0), 0.0);
+}
@@ -0,0 +1,103 @@
+#version 460 core
+// asteroid instances placed straight from the GPU N-body buffers
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoords;
+#include "picking.glsl"
+#include "rock_variant.glsl"
+
+#include "stereo.glsl"
+layout(std430, binding = 0) readonly buffer PositionMass {
+    vec4 posMass[];
+};
+layout(std430, binding = 2) readonly buffer Orientation {
+    vec4 orientation[];  // quaternion stored as xyzw
+};
+layout(std430, binding = 3) readonly buffer Scale {
+    float scale[];
+};
+layout(std430, binding = 4) readonly buffer Spin {
+    vec4 spin[];         // body-frame axis xyz, w radians per sim second
+};
+layout(std430, binding = 7) readonly buffer Visible {
+    uint visible[];      // body indices that passed the frustum cull, one list per level of detail
+};
+
+uniform uint instanceOffset;   // index of the first asteroid in the body buffers
+uniform vec3 cameraPosition;   // the view matrix is rotation only, geometry is placed relative to the camera
+uniform bool culled;           // instances come from the visible lists, baseInstance picks the level's list
+uniform bool tumble;           // false when the orientation buffer already spins, as for the visual belt
+uniform float spinTime;        // sim time modulo the tumble period
+uniform bool impostor;         // one point per instance for impostor.point.fs instead of the mesh
+uniform float modelRadius;     // bounding sphere of the unscaled model, sizes the point
+uniform float viewportHeight;
+uniform bool pickable;         // the buffers hold the body store's bodies in its order, not the visual belt
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+out float ImpostorRadius;      // view-space radius of the point's sphere
+flat out uint Variant;         // a number fixed per rock, picks its texture layer in rock.instanced.object.model.shader.fs
+flat out uint Pick;
+#ifdef SHADOW_PASS
+flat out vec4 ShadowSphere;      // the rock's bounding sphere for shadow.cube.gs
+#endif
+
+mat3 quatToMat3(vec4 q)
+{
+    vec3 q2 = q.xyz * 2.0;
+    float xx = q.x * q2.x, yy = q.y * q2.y, zz = q.z * q2.z;
+    float xy = q.x * q2.y, xz = q.x * q2.z, yz = q.y * q2.z;
+    float wx = q.w * q2.x, wy = q.w * q2.y, wz = q.w * q2.z;
+    return mat3(1.0 - (yy + zz), xy + wz, xz - wy,
+                xy - wz, 1.0 - (xx + zz), yz + wx,
+                xz + wy, yz - wx, 1.0 - (xx + yy));
+}
+
+// rotation by angle about a unit axis (Rodrigues)
+mat3 axisAngleToMat3(vec3 axis, float angle)
+{
+    float s = sin(angle), c = cos(angle);
+    vec3 t = axis * (1.0 - c);
+    return mat3(t.x * axis.x + c, t.x * axis.y + s * axis.z, t.x * axis.z - s * axis.y,
+                t.y * axis.x - s * axis.z, t.y * axis.y + c, t.y * axis.z + s * axis.x,
+                t.z * axis.x + s * axis.y, t.z * axis.y - s * axis.x, t.z * axis.z + c);
+}
+
+void main()
+{
+    uint body = culled ? visible[gl_BaseInstance + stereoInstance()] : instanceOffset + stereoInstance();
+    Variant = rockVariantHash(body);    // the shape asteroid.cull.cs drew it with
+    Pick = pickable ? PICK_BODY | body : 0u;
+    if (impostor)
+    {
+        // a lit disc the size of the rock's bounding sphere, drawn as a single point
+        vec4 viewCenter = view * vec4(posMass[body].xyz - cameraPosition, 1.0);
+        ImpostorRadius = modelRadius * scale[body];
+        gl_Position = stereoPosition(posMass[body].xyz - cameraPosition);
+        gl_PointSize = max(ImpostorRadius * projection[1][1] * viewportHeight / max(-viewCenter.z, 1e-4), 1.0);
+        FragPos = viewCenter.xyz;
+        Normal = vec3(0.0, 0.0, 1.0);
+        TexCoords = vec2(0.5);
+        return;
+    }
+    mat3 rotation = quatToMat3(orientation[body]);
+    if (tumble)
+        rotation = rotation * axisAngleToMat3(spin[body].xyz, spin[body].w * spinTime);
+    // a procedural rock's own shape, nothing for the rock's mesh
+    vec3 localPos = aPos;
+    vec3 localNormal = aNormal;
+    reliefRock(Variant, localPos, localNormal);
+    vec3 worldPos = (posMass[body].xyz - cameraPosition) + rotation * (localPos * scale[body]);
+#ifdef SHADOW_PASS
+    // camera-relative, shadow.cube.gs projects it into every face of the sun's cube map
+    gl_Position = vec4(worldPos, 1.0);
+    ShadowSphere = vec4(posMass[body].xyz - cameraPosition, modelRadius * scale[body]);
+    return;
+#endif
+    gl_Position = stereoPosition(worldPos);
+    FragPos = vec3(view * vec4(worldPos, 1.0));
+    // uniform scale, so the normal matrix is just the rotation
+    Normal = mat3(view) * rotation * localNormal;
+    TexCoords = aTexCoords;
+}
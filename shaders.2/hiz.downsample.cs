@@ -0,0 +1,26 @@
+#version 460 core
+// one level of the hierarchical-Z pyramid: every texel is the farthest depth of the source texels it covers, the
+// odd row and column of an odd-sized source folded into the last texel so nothing falls between levels
+layout(local_size_x = 8, local_size_y = 8) in;
+
+#include "depth.glsl"
+
+layout(r32f, binding = 0) writeonly uniform image2D destination;
+uniform sampler2D source;      // the captured depth for level 0, the pyramid itself after that
+uniform int sourceLod;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = imageSize(destination);
+    ivec2 sourceSize = textureSize(source, sourceLod);
+    if (texel.x >= size.x || texel.y >= size.y)
+        return;
+    ivec2 base = texel * 2;
+    ivec2 extent = ivec2(texel.x == size.x - 1 && (sourceSize.x & 1) != 0 ? 3 : 2, texel.y == size.y - 1 && (sourceSize.y & 1) != 0 ? 3 : 2);
+    float farthest = 1.0 - FAR_DEPTH;
+    for (int y = 0; y < extent.y; y++)
+        for (int x = 0; x < extent.x; x++)
+            farthest = farthestDepth(farthest, texelFetch(source, min(base + ivec2(x, y), sourceSize - 1), sourceLod).r);
+    imageStore(destination, texel, vec4(farthest));
+}
@@ -0,0 +1,48 @@
+// Occlusion against a Hi-Z pyramid (include/hiz.h) of last frame's depth, for the culling passes: the uniforms
+// HiZ's owner sets and the sphere test, in camera-relative coordinates of the frame being culled.
+#include "depth.glsl"
+
+uniform sampler2D hiz;             // farthest depth per texel, level 0 at half resolution
+uniform int hizLevels;
+uniform mat4 hizProjection;        // the camera the pyramid was captured with
+uniform mat4 hizView;
+uniform vec3 hizCameraOffset;      // this frame's camera position minus that one's
+
+// whether a sphere, camera-relative to the capture, lies wholly behind the captured depth. Its screen rectangle
+// is bounded with the distance of its nearest point and tested at the level where it covers at most 2x2 texels.
+bool occluded(vec3 center, float radius)
+{
+    vec3 viewCenter = (hizView * vec4(center, 1.0)).xyz;
+    float nearest = -viewCenter.z - radius;
+    // near plane of the projection, a sphere reaching it is always drawn
+#ifdef REVERSE_Z
+    float nearPlane = hizProjection[3][2];
+#else
+    float nearPlane = hizProjection[3][2] / (hizProjection[2][2] - 1.0);
+#endif
+    if (nearest <= nearPlane)
+        return false;
+    vec4 clip = hizProjection * vec4(viewCenter, 1.0);
+    vec2 uv = clip.xy / clip.w * 0.5 + 0.5;
+    vec2 extent = radius * vec2(hizProjection[0][0], hizProjection[1][1]) / nearest * 0.5;
+    vec2 lo = clamp(uv - extent, 0.0, 1.0);
+    vec2 hi = clamp(uv + extent, 0.0, 1.0);
+    if (any(greaterThanEqual(lo, hi)))
+        return false;
+
+    vec2 size = vec2(textureSize(hiz, 0));
+    vec2 texels = (hi - lo) * size;
+    int level = clamp(int(ceil(log2(max(max(texels.x, texels.y), 1.0)))), 0, hizLevels - 1);
+    ivec2 levelSize = textureSize(hiz, level);
+    ivec2 a = clamp(ivec2(lo * vec2(levelSize)), ivec2(0), levelSize - 1);
+    ivec2 b = clamp(ivec2(hi * vec2(levelSize)), ivec2(0), levelSize - 1);
+    float farthest = farthestDepth(farthestDepth(texelFetch(hiz, a, level).r, texelFetch(hiz, ivec2(b.x, a.y), level).r),
+                                   farthestDepth(texelFetch(hiz, ivec2(a.x, b.y), level).r, texelFetch(hiz, b, level).r));
+    // window depth of the nearest point, behind the farthest captured one
+    float depth = windowDepth(hizProjection * vec4(0.0, 0.0, -nearest, 1.0));
+#ifdef REVERSE_Z
+    return depth < farthest;
+#else
+    return depth > farthest;
+#endif
+}
@@ -0,0 +1,44 @@
+#version 460 core
+// distant asteroids as lit discs: a sphere normal from the point coordinate, the rock's average albedo, and the
+// sun's diffuse and ambient terms of the full shader without the specular and spot lookups
+#include "lights.glsl"
+
+in vec3 FragPos;            // view-space centre of the point
+in float ImpostorRadius;
+flat in uint Pick;          // what include/gpu_picker.h reads back for the pixel
+
+#ifdef GBUFFER_OUTPUT
+#include "gbuffer.glsl"
+#else
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out uint PickId;
+#endif
+
+uniform sampler2D texture_diffuse1;
+uniform mat4 viewMat;
+
+void main() {
+    PickId = Pick;
+    vec2 disc = gl_PointCoord * 2.0 - 1.0;
+    float r2 = dot(disc, disc);
+    if (r2 > 1.0)
+        discard;
+    // gl_PointCoord runs down the screen, view space up
+    vec3 normal = vec3(disc.x, -disc.y, sqrt(1.0 - r2));
+    vec3 surface = FragPos + normal * ImpostorRadius;
+    // the coarsest mip is the texture's average colour
+    vec3 albedo = textureLod(texture_diffuse1, vec2(0.5), 16.0).rgb;
+#ifdef GBUFFER_OUTPUT
+    // lit like any surface by the deferred pass, without a highlight
+    writeGBuffer(albedo, vec3(0.0), normal);
+#else
+
+    PointLight sun = pointLights[0];
+    vec3 toLight = vec3(viewMat * sun.position) - surface;
+    float distance = length(toLight);
+    float attenuation = 1.0 / (sun.constant + sun.linear * distance + sun.quadratic * (distance * distance));
+    float diff = max(dot(normal, toLight / distance), 0.0) * pointLightShadow(0u, surface, normal);
+    vec3 result = (sun.ambient + sun.diffuse * diff) * albedo * attenuation + dirLight.ambient * albedo;
+    FragColor = vec4(result, 1.0);
+#endif
+}
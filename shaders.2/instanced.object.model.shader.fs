@@ -1,44 +1,5 @@
 #version 460 core
-#define NR_POINT_LIGHTS 1
-
-struct Material {
-    float shininess;
-};
-
-struct DirLight {
-    vec3 direction;
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct PointLight {
-    vec4 position;
-    float constant;
-    float linear;
-    float quadratic;
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct SpotLight {
-    float cutOff;
-    float outerCutOff;
-    float constant;
-    float linear;
-    float quadratic;
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-layout(std140, binding = 1) uniform LightData {
-    Material material;
-    DirLight dirLight;
-    PointLight pointLights[NR_POINT_LIGHTS];
-    SpotLight spotLight;
-};
+#include "lights.glsl"
 
 in vec3 Normal;
 in vec3 FragPos;
@@ -58,8 +19,18 @@ void main() {
     vec3 norm = normalize(Normal);
     vec3 viewDir = normalize(-FragPos);
     vec3 result = CalcDirLight(dirLight, norm, viewDir);
-    for(int i = 0; i < NR_POINT_LIGHTS; i++)
+#ifdef CLUSTERED_LIGHTS
+    uint cluster = fragmentCluster(FragPos);
+    for (uint i = 0u; i < clusterCounts[cluster]; i++) {
+        pointShadow = pointLightShadow(clusterLightIndex(cluster, i), FragPos, norm);
+        result += CalcPointLight(clusterLight(cluster, i), norm, FragPos, viewDir);
+    }
+#else
+    for(int i = 0; i < NR_POINT_LIGHTS; i++) {
+        pointShadow = pointLightShadow(uint(i), FragPos, norm);
         result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
+    }
+#endif
     result += CalcSpotLight(spotLight, norm, FragPos, viewDir);
 
     FragColor = vec4(result, 1.0);
@@ -89,8 +60,8 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
     // combine results
     vec3 ambient = light.ambient * vec3(texture(texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(texture_specular1, TexCoords));
+    vec3 diffuse = light.diffuse * diff * pointShadow * vec3(texture(texture_diffuse1, TexCoords));
+    vec3 specular = light.specular * spec * pointShadow * vec3(texture(texture_specular1, TexCoords));
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
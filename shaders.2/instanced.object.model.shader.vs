@@ -2,8 +2,8 @@
 layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoords;
-layout(location = 3) in mat4 aInstanceModelMatrix;
-layout(location = 7) in mat3 aInstanceNormalMatrix;
+layout(location = 8) in mat4 aInstanceModelMatrix;
+layout(location = 12) in mat3 aInstanceNormalMatrix;
 layout(std140, binding = 0) uniform Matrices {
     mat4 projection;
     mat4 view;
@@ -12,6 +12,7 @@ layout(std140, binding = 0) uniform Matrices {
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
+flat out uint Pick;
 
 void main()
 {
@@ -19,4 +20,5 @@ void main()
     FragPos = vec3(view * aInstanceModelMatrix * vec4(aPos, 1.0f));
     Normal = mat3(view) * aInstanceNormalMatrix * aNormal;
     TexCoords = aTexCoords;
+    Pick = 0u;
 }
\ No newline at end of file
@@ -0,0 +1,65 @@
+#version 460 core
+// bins the point lights into the clusters of clusters.glsl: one invocation per cluster tests every light's sphere
+// against the cluster's view-space box, reading the lights in batches through shared memory
+layout(local_size_x = 128) in;
+
+#include "clusters.glsl"
+#include "depth.glsl"
+
+layout(std140, binding = 0) uniform Matrices {
+    mat4 projection;
+    mat4 view;
+};
+
+uniform mat4 inverseProjection;
+
+shared vec4 batch[128];   // view-space centre and range
+
+// the view-space point at a depth (positive distance) on the ray through a point of the screen in NDC
+vec3 onRay(vec2 ndc, float depth)
+{
+    vec4 p = inverseProjection * vec4(ndc, NDC_NEAR, 1.0);
+    p /= p.w;
+    return p.xyz * (depth / -p.z);
+}
+
+void main()
+{
+    uint cluster = gl_GlobalInvocationID.x;
+    uint clusterCount = clusterGrid.x * clusterGrid.y * clusterGrid.z;
+    bool active = cluster < clusterCount;
+
+    uvec3 c = uvec3(cluster % clusterGrid.x, (cluster / clusterGrid.x) % clusterGrid.y, cluster / (clusterGrid.x * clusterGrid.y));
+    float nearZ = clusterDepth.x * pow(clusterDepth.y / clusterDepth.x, float(c.z) / float(clusterGrid.z));
+    float farZ = clusterDepth.x * pow(clusterDepth.y / clusterDepth.x, float(c.z + 1u) / float(clusterGrid.z));
+    vec2 ndcMin = vec2(c.xy) / vec2(clusterGrid.xy) * 2.0 - 1.0;
+    vec2 ndcMax = vec2(c.xy + 1u) / vec2(clusterGrid.xy) * 2.0 - 1.0;
+    vec3 boxMin = vec3(1e30), boxMax = vec3(-1e30);
+    for (int corner = 0; corner < 8; corner++)
+    {
+        vec2 ndc = vec2((corner & 1) != 0 ? ndcMax.x : ndcMin.x, (corner & 2) != 0 ? ndcMax.y : ndcMin.y);
+        vec3 p = onRay(ndc, (corner & 4) != 0 ? farZ : nearZ);
+        boxMin = min(boxMin, p);
+        boxMax = max(boxMax, p);
+    }
+
+    uint count = 0u;
+    for (uint base = 0u; base < clusterGrid.w; base += 128u)
+    {
+        uint l = base + gl_LocalInvocationIndex;
+        if (l < clusterGrid.w)
+            batch[gl_LocalInvocationIndex] = vec4((view * vec4(clusterLights[l].position.xyz, 1.0)).xyz, clusterLights[l].position.w);
+        barrier();
+        uint batchSize = min(128u, clusterGrid.w - base);
+        for (uint i = 0u; active && i < batchSize && count < CLUSTER_MAX_LIGHTS; i++)
+        {
+            // the sphere touches the box when the box point nearest its centre is within the range
+            vec3 d = clamp(batch[i].xyz, boxMin, boxMax) - batch[i].xyz;
+            if (dot(d, d) <= batch[i].w * batch[i].w)
+                clusterIndices[cluster * CLUSTER_MAX_LIGHTS + count++] = base + i;
+        }
+        barrier();
+    }
+    if (active)
+        clusterCounts[cluster] = count;
+}
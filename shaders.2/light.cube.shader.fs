@@ -1,7 +1,18 @@
 #version 460
-out vec4 FragColor;
+// the light sources drawn as what they are, brighter than white so the bloom picks them out of the HDR scene
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out uint PickId;
+
+#ifdef OBJECT_BLOCK
+#include "object_block.glsl"
+#else
+uniform uint pickId;        // include/gpu_picker.h, 0 where the light is not a body
+#endif
+
+const vec3 EMISSION = vec3(4.0, 3.6, 3.0);
 
 void main()
 {
-    FragColor = vec4(1.0);
+    FragColor = vec4(EMISSION, 1.0);
+    PickId = pickId;
 }
\ No newline at end of file
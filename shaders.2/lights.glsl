@@ -0,0 +1,99 @@
+// the lights of the LightData block, shared by the lit fragment shaders. Shader injects NR_POINT_LIGHTS to match
+// the viewer's block, one by default. With CLUSTERED_LIGHTS the point lights come from the fragment's cluster
+// instead, see clusters.glsl. With SUN_SHADOWS the first point light casts shadows, see shadows.glsl.
+#ifndef NR_POINT_LIGHTS
+#define NR_POINT_LIGHTS 1
+#endif
+
+struct Material {
+    float shininess;
+};
+
+struct DirLight {
+    vec3 direction;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct PointLight {
+    vec4 position;
+    float constant;
+    float linear;
+    float quadratic;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct SpotLight {
+    float cutOff;
+    float outerCutOff;
+    float constant;
+    float linear;
+    float quadratic;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+layout(std140, binding = 1) uniform LightData {
+    Material material;
+    DirLight dirLight;
+    PointLight pointLights[NR_POINT_LIGHTS];
+    SpotLight spotLight;
+};
+
+// what reaches the fragment of the point light being evaluated, set before each CalcPointLight
+float pointShadow = 1.0;
+
+#ifdef SUN_SHADOWS
+#include "shadows.glsl"
+#endif
+
+// the shadow of a point light by its index in LightData or ClusterLights, both hold the shadowed sun first
+float pointLightShadow(uint light, vec3 fragPos, vec3 normal)
+{
+#ifdef SUN_SHADOWS
+    if (light == 0u)
+        return sunShadow(fragPos, normal);
+#endif
+    return 1.0;
+}
+
+#ifdef CLUSTERED_LIGHTS
+#include "clusters.glsl"
+
+// the cluster of the fragment at view-space position fragPos
+uint fragmentCluster(vec3 fragPos)
+{
+    vec2 pixel = gl_FragCoord.xy;
+    if (clusterDepth.z > 0.0)
+        pixel.x = mod(pixel.x, clusterDepth.z);
+    uvec2 tile = min(uvec2(pixel / clusterTile.xy), clusterGrid.xy - 1u);
+    float slice = log(max(-fragPos.z, clusterDepth.x)) * clusterTile.z + clusterTile.w;
+    uint z = uint(clamp(slice, 0.0, float(clusterGrid.z - 1u)));
+    return (z * clusterGrid.y + tile.y) * clusterGrid.x + tile.x;
+}
+
+// the index in ClusterLights of the i-th light of a cluster
+uint clusterLightIndex(uint cluster, uint i)
+{
+    return clusterIndices[cluster * CLUSTER_MAX_LIGHTS + i];
+}
+
+// the i-th light of a cluster
+PointLight clusterLight(uint cluster, uint i)
+{
+    ClusterLight l = clusterLights[clusterLightIndex(cluster, i)];
+    PointLight light;
+    light.position = vec4(l.position.xyz, 1.0);
+    light.constant = l.attenuation.x;
+    light.linear = l.attenuation.y;
+    light.quadratic = l.attenuation.z;
+    light.ambient = l.ambient.rgb;
+    light.diffuse = l.diffuse.rgb;
+    light.specular = l.specular.rgb;
+    return light;
+}
+#endif
@@ -0,0 +1,23 @@
+// The meshlets of one mesh (include/meshlet.h, include/meshlet_renderer.h) as the task and mesh stages read them.
+struct Meshlet {
+    vec4 sphere;    // center, radius, in the mesh's space
+    vec4 cone;      // axis, cutoff
+    uvec4 range;    // vertex offset, triangle offset, vertex count, triangle count
+};
+
+layout(std430, binding = 21) readonly buffer Meshlets {
+    Meshlet meshlets[];
+};
+layout(std430, binding = 22) readonly buffer MeshletVertices {
+    uint meshletVertices[];     // the mesh's vertex indices, a run per meshlet
+};
+layout(std430, binding = 23) readonly buffer MeshletTriangles {
+    uint meshletTriangles[];    // three bytes, low first, into the meshlet's run
+};
+
+layout(std140, binding = 0) uniform Matrices {
+    mat4 projection;
+    mat4 view;
+};
+
+uniform mat4 model;
@@ -0,0 +1,14 @@
+// the receivers' side of the variance shadow maps, see include/moment_shadows.h
+
+// the lit fraction at depth reference from the filtered moments, the upper bound of Chebyshev's inequality. The
+// variance is floored at minVariance against acne where the blur has flattened it, and bleedReduction cuts off the
+// bottom of the bound, the faint light that leaks where casters overlap at different depths.
+float momentShadow(vec2 moments, float reference, float minVariance, float bleedReduction)
+{
+    if (reference <= moments.x)
+        return 1.0;
+    float variance = max(moments.y - moments.x * moments.x, minVariance);
+    float d = reference - moments.x;
+    float bound = variance / (variance + d * d);
+    return clamp((bound - bleedReduction) / (1.0 - bleedReduction), 0.0, 1.0);
+}
@@ -0,0 +1,83 @@
+#version 460 core
+// the Barnes-Hut kick of the GPU backend (include/gpu_barnes_hut.h): the sun and planets summed directly, then
+// the asteroids' tree walked from the root. A node is taken whole where the largest side of its bounds is under
+// theta times the distance to its centre of mass and the body is outside them, otherwise its children go on the
+// stack; a leaf is one body, the body itself skipped.
+#define STACK_SIZE 64
+layout(local_size_x = 256) in;
+
+#include "barnes_hut.glsl"
+
+layout(std430, binding = 0) readonly buffer PositionMass {
+    vec4 posMass[];      // xyz position, w mass
+};
+layout(std430, binding = 1) buffer Velocity {
+    vec4 velocity[];     // xyz velocity, w 1.0 for dynamic bodies and 0.0 for static ones
+};
+layout(std430, binding = 55) readonly buffer TreeNodes {
+    TreeNode nodes[];
+};
+
+uniform uint bodyCount;
+uniform uint massiveCount;          // sun and planets come first in the buffers
+uniform uint leafCount;             // asteroids in the tree, bodyCount - massiveCount
+uniform bool asteroidSelfGravity;
+uniform float thetaSq;
+uniform float G;
+uniform float dt;
+uniform float epsilonSq;
+
+vec3 pull(vec4 source, vec3 pos)
+{
+    vec3 r = source.xyz - pos;
+    float invR = inversesqrt(max(dot(r, r), epsilonSq));
+    return r * (source.w * invR * invR * invR);
+}
+
+vec3 treeAcceleration(uint self, vec3 pos)
+{
+    // no tree is built for a single asteroid
+    if (leafCount == 1u)
+        return self == massiveCount ? vec3(0.0) : pull(posMass[massiveCount], pos);
+    uint leafBase = leafCount - 1u;
+    vec3 acc = vec3(0.0);
+    uint stack[STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0u;
+    while (top > 0)
+    {
+        uint n = stack[--top];
+        TreeNode node = nodes[n];
+        if (n >= leafBase)
+        {
+            if (node.children.x != self)
+                acc += pull(node.massCenter, pos);
+            continue;
+        }
+        vec3 r = node.massCenter.xyz - pos;
+        bool inside = all(greaterThanEqual(pos, node.low.xyz)) && all(lessThanEqual(pos, node.high.xyz));
+        // a full stack takes the node whole rather than lose it
+        if ((!inside && node.high.w * node.high.w < thetaSq * dot(r, r)) || top + 2 > STACK_SIZE)
+        {
+            acc += pull(node.massCenter, pos);
+            continue;
+        }
+        stack[top++] = node.children.x;
+        stack[top++] = node.children.y;
+    }
+    return acc;
+}
+
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= bodyCount)
+        return;
+    vec3 pos = posMass[i].xyz;
+    vec3 acc = vec3(0.0);
+    for (uint k = 0u; k < massiveCount; k++)
+        acc += pull(posMass[k], pos);
+    if (leafCount > 0u && (i < massiveCount || asteroidSelfGravity))
+        acc += treeAcceleration(i, pos);
+    velocity[i].xyz += G * acc * dt * velocity[i].w;
+}
@@ -0,0 +1,20 @@
+#version 460 core
+layout(local_size_x = 256) in;
+
+layout(std430, binding = 0) buffer PositionMass {
+    vec4 posMass[];
+};
+layout(std430, binding = 1) readonly buffer Velocity {
+    vec4 velocity[];
+};
+
+uniform uint bodyCount;
+uniform float dt;
+
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= bodyCount)
+        return;
+    posMass[i].xyz += velocity[i].xyz * dt * velocity[i].w;
+}
@@ -0,0 +1,55 @@
+#version 460 core
+// all-pairs gravity, sources are staged through shared memory one tile at a time
+#define TILE_SIZE 256
+layout(local_size_x = TILE_SIZE) in;
+
+layout(std430, binding = 0) buffer PositionMass {
+    vec4 posMass[];      // xyz position, w mass
+};
+layout(std430, binding = 1) buffer Velocity {
+    vec4 velocity[];     // xyz velocity, w 1.0 for dynamic bodies and 0.0 for static ones
+};
+
+uniform uint bodyCount;
+uniform uint massiveCount;          // sun and planets come first in the buffers
+uniform bool asteroidSelfGravity;
+uniform bool testParticles;         // asteroids are massless, nobody sums the asteroid tiles
+uniform float G;
+uniform float dt;
+uniform float epsilonSq;
+
+shared vec4 tile[TILE_SIZE];
+
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    vec3 pos = i < bodyCount ? posMass[i].xyz : vec3(0.0);
+    bool isAsteroid = i >= massiveCount;
+
+    // a workgroup holding only asteroids never needs the asteroid tiles
+    uint groupFirst = gl_WorkGroupID.x * TILE_SIZE;
+    uint sourceEnd = (!testParticles && (asteroidSelfGravity || groupFirst < massiveCount)) ? bodyCount : massiveCount;
+
+    vec3 acc = vec3(0.0);
+    for (uint tileStart = 0; tileStart < sourceEnd; tileStart += TILE_SIZE)
+    {
+        uint j = tileStart + gl_LocalInvocationID.x;
+        tile[gl_LocalInvocationID.x] = j < sourceEnd ? posMass[j] : vec4(0.0);
+        barrier();
+
+        uint tileCount = min(uint(TILE_SIZE), sourceEnd - tileStart);
+        for (uint k = 0; k < tileCount; k++)
+        {
+            vec4 source = tile[k];
+            // asteroid targets drop asteroid sources unless self-gravity is on
+            float m = (!asteroidSelfGravity && isAsteroid && tileStart + k >= massiveCount) ? 0.0 : source.w;
+            vec3 r = source.xyz - pos;
+            float invR = inversesqrt(max(dot(r, r), epsilonSq));
+            acc += r * (m * invR * invR * invR);
+        }
+        barrier();
+    }
+
+    if (i < bodyCount)
+        velocity[i].xyz += G * acc * dt * velocity[i].w;
+}
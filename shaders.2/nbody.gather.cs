@@ -0,0 +1,28 @@
+#version 460 core
+// one buffer of a permutation of the GPU backend's bodies (GpuNBody::reorder): slot first + k of the copy receives
+// what the source held at first + order[k], an element being words uints
+layout(local_size_x = 256) in;
+
+layout(std430, binding = 49) readonly buffer Order {
+    uint order[];
+};
+layout(std430, binding = 50) readonly buffer Source {
+    uint source[];
+};
+layout(std430, binding = 51) writeonly buffer Target {
+    uint target[];
+};
+
+uniform uint first;
+uniform uint count;
+uniform uint words;
+
+void main()
+{
+    uint k = gl_GlobalInvocationID.x;
+    if (k >= count)
+        return;
+    uint from = (first + order[k]) * words, to = (first + k) * words;
+    for (uint w = 0u; w < words; w++)
+        target[to + w] = source[from + w];
+}
@@ -0,0 +1,55 @@
+#version 460 core
+// test particles against the massive bodies the CPU stepped (hybrid_nbody.h), one leapfrog step:
+// half kick at the step's start positions, drift, half kick at its end positions
+#define MAX_MASSIVE 64
+layout(local_size_x = 256) in;
+
+layout(std430, binding = 0) buffer PositionMass {
+    vec4 posMass[];      // xyz position, w mass
+};
+layout(std430, binding = 1) buffer Velocity {
+    vec4 velocity[];     // xyz velocity, w 1.0 for dynamic bodies and 0.0 for static ones
+};
+layout(std140, binding = 5) uniform MassiveBodies {
+    vec4 before[MAX_MASSIVE];   // xyz position, w mass
+    vec4 after[MAX_MASSIVE];
+    uint massiveCount;          // sun and planets come first in the buffers
+};
+
+uniform uint bodyCount;
+uniform float G;
+uniform float dt;
+uniform float epsilonSq;
+
+vec3 accelerationAt(vec3 pos, bool atEnd)
+{
+    vec3 acc = vec3(0.0);
+    for (uint k = 0; k < massiveCount; k++)
+    {
+        vec4 source = atEnd ? after[k] : before[k];
+        vec3 r = source.xyz - pos;
+        float invR = inversesqrt(max(dot(r, r), epsilonSq));
+        acc += r * (source.w * invR * invR * invR);
+    }
+    return G * acc;
+}
+
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= bodyCount)
+        return;
+    // the CPU has the massive bodies, their entries only follow it for whatever reads the buffer
+    if (i < massiveCount)
+    {
+        posMass[i].xyz = after[i].xyz;
+        return;
+    }
+    vec3 pos = posMass[i].xyz;
+    vec4 vel = velocity[i];
+    vel.xyz += 0.5 * dt * vel.w * accelerationAt(pos, false);
+    pos += dt * vel.w * vel.xyz;
+    vel.xyz += 0.5 * dt * vel.w * accelerationAt(pos, true);
+    posMass[i].xyz = pos;
+    velocity[i].xyz = vel.xyz;
+}
@@ -0,0 +1,111 @@
+#version 460 core
+// Z-order keys of the GPU backend's asteroids (include/gpu_morton.h), one stage per dispatch: the bounding box of
+// the bodies (stage 0), a 63-bit key of each on a 2^21 grid over the box's largest side with the body's offset
+// from the first as its value (stage 1), and how many neighbouring pairs are out of key order (stage 2).
+layout(local_size_x = 256) in;
+
+layout(std430, binding = 0) readonly buffer PositionMass {
+    vec4 posMass[];
+};
+layout(std430, binding = 47) buffer MortonBounds {
+    uint boundsLow[3];      // ordered float bits, atomicMin
+    uint boundsHigh[3];     // atomicMax
+    uint descents;
+};
+layout(std430, binding = 48) buffer MortonKeys {
+    uvec2 keys[];           // low word first, as the radix sort reads 64-bit keys
+};
+layout(std430, binding = 49) writeonly buffer MortonOrder {
+    uint order[];
+};
+
+uniform int stage;
+uniform uint first;         // body index of the first asteroid
+uniform uint count;
+
+shared vec3 low[256];
+shared vec3 high[256];
+
+// floats as uints that compare in the same order
+uint orderedBits(float f)
+{
+    uint u = floatBitsToUint(f);
+    return (u & 0x80000000u) != 0u ? ~u : u | 0x80000000u;
+}
+
+float orderedFloat(uint u)
+{
+    return uintBitsToFloat((u & 0x80000000u) != 0u ? u & 0x7fffffffu : ~u);
+}
+
+// the 21 bits of x, y and z interleaved, x highest
+uvec2 mortonKey(uvec3 q)
+{
+    uvec2 key = uvec2(0u);
+    for (uint b = 0u; b < 21u; b++)
+    {
+        uint bits = (((q.x >> b) & 1u) << 2) | (((q.y >> b) & 1u) << 1) | ((q.z >> b) & 1u);
+        uint at = 3u * b;
+        if (at < 30u)
+            key.x |= bits << at;
+        else if (at == 30u)
+        {
+            key.x |= (bits & 3u) << 30;
+            key.y |= bits >> 2;
+        }
+        else
+            key.y |= bits << (at - 32u);
+    }
+    return key;
+}
+
+bool less(uvec2 a, uvec2 b)
+{
+    return a.y < b.y || (a.y == b.y && a.x < b.x);
+}
+
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    uint l = gl_LocalInvocationID.x;
+    if (stage == 0)
+    {
+        vec3 p = posMass[first + min(i, count - 1u)].xyz;
+        low[l] = p;
+        high[l] = p;
+        barrier();
+        for (uint s = 128u; s > 0u; s >>= 1)
+        {
+            if (l < s)
+            {
+                low[l] = min(low[l], low[l + s]);
+                high[l] = max(high[l], high[l + s]);
+            }
+            barrier();
+        }
+        if (l == 0u)
+        {
+            for (int a = 0; a < 3; a++)
+            {
+                atomicMin(boundsLow[a], orderedBits(low[0][a]));
+                atomicMax(boundsHigh[a], orderedBits(high[0][a]));
+            }
+        }
+        return;
+    }
+    if (i >= count)
+        return;
+    if (stage == 1)
+    {
+        vec3 lo = vec3(orderedFloat(boundsLow[0]), orderedFloat(boundsLow[1]), orderedFloat(boundsLow[2]));
+        vec3 hi = vec3(orderedFloat(boundsHigh[0]), orderedFloat(boundsHigh[1]), orderedFloat(boundsHigh[2]));
+        vec3 extent = hi - lo;
+        float size = max(max(extent.x, extent.y), extent.z);
+        float scale = size > 0.0 ? 2097151.0 / size : 0.0;
+        uvec3 q = uvec3(clamp((posMass[first + i].xyz - lo) * scale, vec3(0.0), vec3(2097151.0)));
+        keys[i] = mortonKey(q);
+        order[i] = i;
+    }
+    else if (i > 0u && less(keys[i], keys[i - 1u]))
+        atomicAdd(descents, 1u);
+}
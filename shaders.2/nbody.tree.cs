@@ -0,0 +1,180 @@
+#version 460 core
+// the GPU Barnes-Hut tree over the asteroids (include/gpu_barnes_hut.h), one stage per dispatch: the bounding box
+// (stage 0), a 30-bit Morton code of each body on a 1024^3 grid over the box's largest side with its index as the
+// value (stage 1), then, once the codes are sorted, the internal nodes of the radix tree (stage 2) and the leaves'
+// climb to the root that fills in every node's mass, centre of mass and bounds (stage 3). Nodes 0 to count - 2
+// are internal, 0 the root, and leaf k of the sorted order is node count - 1 + k.
+layout(local_size_x = 256) in;
+
+#include "barnes_hut.glsl"
+
+layout(std430, binding = 0) readonly buffer PositionMass {
+    vec4 posMass[];
+};
+layout(std430, binding = 52) buffer TreeBounds {
+    uint boundsLow[3];      // ordered float bits, atomicMin
+    uint boundsHigh[3];     // atomicMax
+};
+layout(std430, binding = 53) buffer TreeKeys {
+    uint keys[];
+};
+layout(std430, binding = 54) buffer TreeOrder {
+    uint order[];           // body index, sorted with the keys
+};
+// coherent, a node's children are read by whichever invocation arrives there second
+layout(std430, binding = 55) coherent buffer TreeNodes {
+    TreeNode nodes[];
+};
+
+uniform int stage;
+uniform uint first;         // body index of the first asteroid
+uniform uint count;
+
+shared vec3 low[256];
+shared vec3 high[256];
+
+uint orderedBits(float f)
+{
+    uint u = floatBitsToUint(f);
+    return (u & 0x80000000u) != 0u ? ~u : u | 0x80000000u;
+}
+
+float orderedFloat(uint u)
+{
+    return uintBitsToFloat((u & 0x80000000u) != 0u ? u & 0x7fffffffu : ~u);
+}
+
+// 10 bits spread to every third
+uint spread(uint v)
+{
+    v = (v | (v << 16)) & 0x030000ffu;
+    v = (v | (v << 8)) & 0x0300f00fu;
+    v = (v | (v << 4)) & 0x030c30c3u;
+    v = (v | (v << 2)) & 0x09249249u;
+    return v;
+}
+
+// the length of the common prefix of the codes at i and j, the index breaking ties between equal codes; -1 outside
+int delta(int i, int j)
+{
+    if (j < 0 || j >= int(count))
+        return -1;
+    uint a = keys[i], b = keys[j];
+    if (a == b)
+        return 32 + 31 - findMSB(uint(i ^ j));
+    return 31 - findMSB(a ^ b);
+}
+
+void buildInternal(int i)
+{
+    // the direction of the node's range and its other end, by the longer prefix with a neighbour
+    int d = delta(i, i + 1) - delta(i, i - 1) >= 0 ? 1 : -1;
+    int shortest = delta(i, i - d);
+    int reach = 2;
+    while (delta(i, i + reach * d) > shortest)
+        reach *= 2;
+    int length = 0;
+    for (int t = reach / 2; t >= 1; t /= 2)
+        if (delta(i, i + (length + t) * d) > shortest)
+            length += t;
+    int j = i + length * d;
+    // where the prefix of the range grows, by binary search
+    int prefix = delta(i, j);
+    int split = 0;
+    int t = length;
+    do
+    {
+        t = (t + 1) / 2;
+        if (delta(i, i + (split + t) * d) > prefix)
+            split += t;
+    } while (t > 1);
+    int gamma = i + split * d + min(d, 0);
+    uint leafBase = count - 1u;
+    uint left = min(i, j) == gamma ? leafBase + uint(gamma) : uint(gamma);
+    uint right = max(i, j) == gamma + 1 ? leafBase + uint(gamma + 1) : uint(gamma + 1);
+    nodes[i].children = uvec2(left, right);
+    nodes[i].visits = 0u;
+    nodes[left].parent = uint(i);
+    nodes[right].parent = uint(i);
+    if (i == 0)
+        nodes[0].parent = TREE_NONE;
+}
+
+// the leaf, then each node whose other child has already arrived
+void climb(uint k)
+{
+    uint node = count - 1u + k;
+    vec4 body = posMass[order[k]];
+    nodes[node].massCenter = body;
+    nodes[node].low = vec4(body.xyz, 0.0);
+    nodes[node].high = vec4(body.xyz, 0.0);
+    nodes[node].children = uvec2(order[k], TREE_NONE);
+    while (node != 0u)
+    {
+        node = nodes[node].parent;
+        memoryBarrierBuffer();
+        if (atomicAdd(nodes[node].visits, 1u) == 0u)
+            return;
+        uvec2 children = nodes[node].children;
+        vec4 a = nodes[children.x].massCenter, b = nodes[children.y].massCenter;
+        float mass = a.w + b.w;
+        vec3 center = mass > 0.0 ? (a.xyz * a.w + b.xyz * b.w) / mass : 0.5 * (a.xyz + b.xyz);
+        vec3 lo = min(nodes[children.x].low.xyz, nodes[children.y].low.xyz);
+        vec3 hi = max(nodes[children.x].high.xyz, nodes[children.y].high.xyz);
+        vec3 extent = hi - lo;
+        nodes[node].massCenter = vec4(center, mass);
+        nodes[node].low = vec4(lo, 0.0);
+        nodes[node].high = vec4(hi, max(max(extent.x, extent.y), extent.z));
+    }
+}
+
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    uint l = gl_LocalInvocationID.x;
+    if (stage == 0)
+    {
+        vec3 p = posMass[first + min(i, count - 1u)].xyz;
+        low[l] = p;
+        high[l] = p;
+        barrier();
+        for (uint s = 128u; s > 0u; s >>= 1)
+        {
+            if (l < s)
+            {
+                low[l] = min(low[l], low[l + s]);
+                high[l] = max(high[l], high[l + s]);
+            }
+            barrier();
+        }
+        if (l == 0u)
+        {
+            for (int a = 0; a < 3; a++)
+            {
+                atomicMin(boundsLow[a], orderedBits(low[0][a]));
+                atomicMax(boundsHigh[a], orderedBits(high[0][a]));
+            }
+        }
+        return;
+    }
+    if (i >= count)
+        return;
+    if (stage == 1)
+    {
+        vec3 lo = vec3(orderedFloat(boundsLow[0]), orderedFloat(boundsLow[1]), orderedFloat(boundsLow[2]));
+        vec3 hi = vec3(orderedFloat(boundsHigh[0]), orderedFloat(boundsHigh[1]), orderedFloat(boundsHigh[2]));
+        vec3 extent = hi - lo;
+        float size = max(max(extent.x, extent.y), extent.z);
+        float scale = size > 0.0 ? 1023.0 / size : 0.0;
+        uvec3 q = uvec3(clamp((posMass[first + i].xyz - lo) * scale, vec3(0.0), vec3(1023.0)));
+        keys[i] = (spread(q.x) << 2) | (spread(q.y) << 1) | spread(q.z);
+        order[i] = first + i;
+    }
+    else if (stage == 2)
+    {
+        if (i + 1u < count)
+            buildInternal(int(i));
+    }
+    else
+        climb(i);
+}
@@ -0,0 +1,24 @@
+// one object's uniforms, the slice of the frame's uniform ring its draw binds (include/uniform_ring.h, ObjectBlock
+// in src/simulation.cpp). Compiled in with OBJECT_BLOCK, without it the programs keep plain uniforms.
+#ifdef OBJECT_INSTANCES
+// the render queue's instanced draw of alike objects (include/render_queue.h): the same blocks as an array, one per
+// instance, which the vertex stage reads and passes on
+struct ObjectData {
+    mat4 model;
+    mat3 normalMatrix;
+    float reflectivity;
+    float reflectionLod;
+    uint pickId;
+};
+layout(std430, binding = 56) readonly buffer Objects {
+    ObjectData objects[];
+};
+#else
+layout(std140, binding = 4) uniform Object {
+    mat4 model;
+    mat3 normalMatrix;
+    float reflectivity;
+    float reflectionLod;
+    uint pickId;            // include/gpu_picker.h
+};
+#endif
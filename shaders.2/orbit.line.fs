@@ -0,0 +1,14 @@
+#version 460 core
+// emissive like the light sources, dimmed toward the horizon instead of blended so the lines need no sorting
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out uint PickId;
+
+in vec4 Color;
+
+uniform float brightness;
+
+void main()
+{
+    FragColor = vec4(Color.rgb * brightness * Color.a, 1.0);
+    PickId = 0u;
+}
@@ -0,0 +1,17 @@
+#version 460 core
+// a predicted path's vertex, camera-relative, include/orbit_lines.h. The colour's alpha fades with how far ahead
+// of the clock the point is.
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec4 aColor;
+layout(std140, binding = 0) uniform Matrices {
+    mat4 projection;
+    mat4 view;
+};
+
+out vec4 Color;
+
+void main()
+{
+    Color = aColor;
+    gl_Position = projection * view * vec4(aPos, 1.0);
+}
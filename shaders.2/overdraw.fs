@@ -0,0 +1,29 @@
+#version 460 core
+// the overdraw view: the fragments the scene passes drew at each pixel, counted in the stencil, as a heat ramp
+// over fullscreen.vs
+in vec2 TexCoords;
+
+out vec4 FragColor;
+
+uniform usampler2D counts;  // the scene depth read as its stencil
+uniform vec4 region;        // the part of the target shown, offset in xy and size in zw
+uniform float scale;        // the count drawn white
+
+// black, blue, cyan, green, yellow, red, white
+vec3 heat(float t)
+{
+    const vec3 stops[7] = vec3[7](vec3(0.0), vec3(0.0, 0.0, 1.0), vec3(0.0, 1.0, 1.0), vec3(0.0, 1.0, 0.0),
+                                  vec3(1.0, 1.0, 0.0), vec3(1.0, 0.0, 0.0), vec3(1.0));
+    float x = clamp(t, 0.0, 1.0) * 6.0;
+    int i = min(int(x), 5);
+    return mix(stops[i], stops[i + 1], x - float(i));
+}
+
+void main()
+{
+    // nearest texel, the counts do not filter
+    ivec2 size = textureSize(counts, 0);
+    ivec2 texel = clamp(ivec2((region.xy + TexCoords * region.zw) * vec2(size)), ivec2(0), size - 1);
+    float n = float(texelFetch(counts, texel, 0).r);
+    FragColor = vec4(heat(n / scale), 1.0);
+}
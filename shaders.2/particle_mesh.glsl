@@ -0,0 +1,65 @@
+// shared by the particle-mesh passes (include/gpu_particle_mesh.h): the buffers and where the mesh sits. The
+// frame is the CPU solver's (particle_mesh.h), the bounding cube of the bodies three nodes clear of either edge.
+layout(std430, binding = 33) buffer MeshBounds {
+    uint boundsLow[3];      // ordered float bits, atomicMin
+    uint boundsHigh[3];     // atomicMax
+};
+layout(std430, binding = 34) buffer MeshMass {
+    uint nodeMass[];        // fixed point, massScale per unit mass
+};
+layout(std430, binding = 35) buffer MeshWork {
+    vec2 work[];            // (2 grid)^3 complex values, the convolution in the real parts of the first octant
+};
+layout(std430, binding = 36) readonly buffer MeshSpectrum {
+    float spectrum[];
+};
+
+uniform uint grid;          // nodes per side, the transform is twice that
+
+// floats as uints that compare in the same order
+uint orderedBits(float f)
+{
+    uint u = floatBitsToUint(f);
+    return (u & 0x80000000u) != 0u ? ~u : u | 0x80000000u;
+}
+
+float orderedFloat(uint u)
+{
+    return uintBitsToFloat((u & 0x80000000u) != 0u ? u & 0x7fffffffu : ~u);
+}
+
+struct MeshFrame {
+    vec3 origin;
+    float cellSize;
+};
+
+MeshFrame meshFrame()
+{
+    vec3 lo = vec3(orderedFloat(boundsLow[0]), orderedFloat(boundsLow[1]), orderedFloat(boundsLow[2]));
+    vec3 hi = vec3(orderedFloat(boundsHigh[0]), orderedFloat(boundsHigh[1]), orderedFloat(boundsHigh[2]));
+    vec3 extent = hi - lo;
+    MeshFrame f;
+    f.cellSize = max(max(extent.x, extent.y), max(extent.z, 1e-3)) / float(grid - 8u);
+    f.origin = 0.5 * (lo + hi) - 0.5 * f.cellSize * float(grid - 1u);
+    return f;
+}
+
+// the lower of the eight nodes around a grid coordinate, and the weights' fractions
+ivec3 meshBase(vec3 u, out vec3 f)
+{
+    ivec3 base = clamp(ivec3(floor(u)), ivec3(0), ivec3(int(grid) - 2));
+    f = clamp(u - vec3(base), 0.0, 1.0);
+    return base;
+}
+
+float meshWeight(vec3 f, uint k)
+{
+    return ((k & 1u) != 0u ? f.x : 1.0 - f.x) * ((k & 2u) != 0u ? f.y : 1.0 - f.y) * ((k & 4u) != 0u ? f.z : 1.0 - f.z);
+}
+
+// index of a node in the transform's layout
+uint workIndex(ivec3 n)
+{
+    uint m = 2u * grid;
+    return (uint(n.z) * m + uint(n.y)) * m + uint(n.x);
+}
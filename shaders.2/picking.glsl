@@ -0,0 +1,4 @@
+// the ids the lit passes write for include/gpu_picker.h: a body's slot in the body store, or one of the frame's
+// asteroid instance records for the streamed paths, whose records carry no body. 0 is nothing pickable.
+const uint PICK_BODY = 0x40000000u;
+const uint PICK_RECORD = 0x80000000u;
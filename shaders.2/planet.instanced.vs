@@ -0,0 +1,57 @@
+#version 460 core
+// planets and moons from the frame's instances (include/planet_instances.h), one draw per mesh of the model for
+// all of them; the normal stays in world axes as structured.object.model.shader.vs has it for the planet
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoords;
+layout(std140, binding = 0) uniform Matrices {
+    mat4 projection;
+    mat4 view;
+};
+
+struct PlanetInstance {
+    mat4 model;             // camera-relative
+    uint layer;
+    uint pickId;            // include/gpu_picker.h
+    float reflectivity;
+    float reflectionLod;
+};
+layout(std430, binding = 37) readonly buffer PlanetInstances {
+    PlanetInstance planets[];
+};
+
+uniform mat4 meshTransform;     // where the model's node hierarchy puts the mesh
+uniform float modelRadius;      // bounding sphere of the unscaled model, for the shadow pass
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+flat out uint Pick;
+flat out uint MaterialLayer;
+flat out float InstanceReflectivity;
+flat out float InstanceReflectionLod;
+#ifdef SHADOW_PASS
+flat out vec4 ShadowSphere;     // the planet's bounding sphere for shadow.cube.gs
+#endif
+
+invariant gl_Position;
+
+void main()
+{
+    PlanetInstance planet = planets[gl_BaseInstance + gl_InstanceID];
+    mat4 model = planet.model * meshTransform;
+#ifdef SHADOW_PASS
+    gl_Position = model * vec4(aPos, 1.0);
+    ShadowSphere = vec4(planet.model[3].xyz, modelRadius * length(planet.model[0].xyz));
+    return;
+#endif
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    FragPos = vec3(view * model * vec4(aPos, 1.0));
+    // uniform scale, the normal matrix is the model's rotation up to a factor the fragment shader normalizes away
+    Normal = mat3(model) * aNormal;
+    TexCoords = aTexCoords;
+    Pick = planet.pickId;
+    MaterialLayer = planet.layer;
+    InstanceReflectivity = planet.reflectivity;
+    InstanceReflectionLod = planet.reflectionLod;
+}
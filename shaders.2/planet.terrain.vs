@@ -0,0 +1,92 @@
+#version 460 core
+// one vertex of a CDLOD terrain node (include/planet_terrain.h): the shared grid placed on its cube face, pushed
+// onto the sphere and out by the height cube. Toward the node's morph end the vertex slides onto the parent's
+// grid, to the linear interpolation of the parent's vertices it lies between, where a coarser neighbour's edge is.
+layout(location = 0) in vec2 aGrid;     // 0 to gridSize on both axes
+
+layout(std140, binding = 0) uniform Matrices {
+    mat4 projection;
+    mat4 view;
+};
+
+struct TerrainNode {
+    vec4 originSize;    // xy the corner in face coordinates, z the size, w the face
+    vec4 morph;         // x y the object-space distances the morph starts and ends at, z the level
+};
+
+layout(std430, binding = 28) readonly buffer TerrainNodes {
+    TerrainNode nodes[];
+};
+
+layout(binding = 19) uniform samplerCube heightCube;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec3 SurfaceDirection;  // object space, what the albedo cube is read by
+flat out uint Pick;
+
+#ifdef OBJECT_BLOCK
+#include "object_block.glsl"
+#else
+uniform mat4 model;
+uniform mat3 normalMatrix;
+uniform uint pickId;
+#endif
+
+uniform float gridSize;
+uniform float radius;
+uniform float heightScale;
+uniform vec3 cameraObject;
+uniform float lodScale;     // height mip per log2 of object-space distance
+
+invariant gl_Position;
+
+const vec3 normals[6] = vec3[](vec3(1, 0, 0), vec3(-1, 0, 0), vec3(0, 1, 0), vec3(0, -1, 0), vec3(0, 0, 1), vec3(0, 0, -1));
+const vec3 tangents[6] = vec3[](vec3(0, 0, -1), vec3(0, 0, 1), vec3(1, 0, 0), vec3(1, 0, 0), vec3(1, 0, 0), vec3(-1, 0, 0));
+const vec3 bitangents[6] = vec3[](vec3(0, 1, 0), vec3(0, 1, 0), vec3(0, 0, -1), vec3(0, 0, 1), vec3(0, 1, 0), vec3(0, 1, 0));
+
+vec3 faceDirection(int face, vec2 uv)
+{
+    uv = tan(uv * 0.78539816);
+    return normalize(normals[face] + uv.x * tangents[face] + uv.y * bitangents[face]);
+}
+
+// the displaced surface at face coordinates uv, its mip chosen by distance alone so that every node computing a
+// point computes the same one
+vec3 surface(int face, vec2 uv)
+{
+    vec3 direction = faceDirection(face, uv);
+    float lod = max(log2(max(distance(direction * radius, cameraObject) * lodScale, 1.0)), 0.0);
+    return direction * (radius + heightScale * textureLod(heightCube, direction, lod).r);
+}
+
+void main()
+{
+    TerrainNode node = nodes[gl_InstanceID];
+    int face = int(node.originSize.w);
+    float step = node.originSize.z / gridSize;
+    vec2 uv = node.originSize.xy + aGrid * step;
+    vec3 fine = surface(face, uv);
+
+    // odd grid lines lie between the parent's; both odd is the middle of a parent quad, on its diagonal
+    vec2 odd = mod(aGrid, 2.0);
+    vec3 coarse = fine;
+    if (odd.x + odd.y > 0.0) {
+        vec2 offset = odd.x > 0.0 && odd.y > 0.0 ? vec2(step) : odd * step;
+        coarse = 0.5 * (surface(face, uv - offset) + surface(face, uv + offset));
+    }
+    float d = distance(faceDirection(face, uv) * radius, cameraObject);
+    float k = clamp((d - node.morph.x) / max(node.morph.y - node.morph.x, 1e-6), 0.0, 1.0);
+    vec3 position = mix(fine, coarse, k);
+
+    // the normal across a quad of the node's level
+    vec3 du = surface(face, uv + vec2(step, 0.0)) - surface(face, uv - vec2(step, 0.0));
+    vec3 dv = surface(face, uv + vec2(0.0, step)) - surface(face, uv - vec2(0.0, step));
+    vec3 normal = normalize(cross(du, dv));
+
+    gl_Position = projection * view * model * vec4(position, 1.0);
+    FragPos = vec3(view * model * vec4(position, 1.0));
+    Normal = normalMatrix * normal;
+    SurfaceDirection = position;
+    Pick = pickId;
+}
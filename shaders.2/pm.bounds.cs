@@ -0,0 +1,37 @@
+#version 460 core
+// the bounding box of every body for the particle mesh, one atomic per workgroup and axis
+layout(local_size_x = 256) in;
+
+#include "particle_mesh.glsl"
+
+layout(std430, binding = 0) readonly buffer PositionMass {
+    vec4 posMass[];
+};
+
+uniform uint bodyCount;
+
+shared vec3 low[256];
+shared vec3 high[256];
+
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    uint l = gl_LocalInvocationID.x;
+    vec3 p = posMass[min(i, bodyCount - 1u)].xyz;
+    low[l] = p;
+    high[l] = p;
+    barrier();
+    for (uint s = 128u; s > 0u; s >>= 1) {
+        if (l < s) {
+            low[l] = min(low[l], low[l + s]);
+            high[l] = max(high[l], high[l + s]);
+        }
+        barrier();
+    }
+    if (l == 0u) {
+        for (int a = 0; a < 3; a++) {
+            atomicMin(boundsLow[a], orderedBits(low[0][a]));
+            atomicMax(boundsHigh[a], orderedBits(high[0][a]));
+        }
+    }
+}
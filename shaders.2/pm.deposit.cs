@@ -0,0 +1,28 @@
+#version 460 core
+// cloud-in-cell masses onto the nodes, in fixed point so the sums are integer atomics
+layout(local_size_x = 256) in;
+
+#include "particle_mesh.glsl"
+
+layout(std430, binding = 0) readonly buffer PositionMass {
+    vec4 posMass[];
+};
+
+uniform uint bodyCount;
+uniform float massScale;    // fixed-point units per unit mass, the total mass fits in 32 bits
+
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= bodyCount)
+        return;
+    MeshFrame frame = meshFrame();
+    vec4 body = posMass[i];
+    vec3 f;
+    ivec3 base = meshBase((body.xyz - frame.origin) / frame.cellSize, f);
+    for (uint k = 0u; k < 8u; k++) {
+        ivec3 n = base + ivec3(k & 1u, (k >> 1) & 1u, k >> 2);
+        uint index = (uint(n.z) * grid + uint(n.y)) * grid + uint(n.x);
+        atomicAdd(nodeMass[index], uint(meshWeight(f, k) * body.w * massScale + 0.5));
+    }
+}
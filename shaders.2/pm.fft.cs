@@ -0,0 +1,68 @@
+#version 460 core
+// one radix-2 transform per workgroup, of the line starting at firstStride * x + secondStride * y of the work
+// grid with stride between its elements. With convolve the forward transform is multiplied by the kernel's
+// spectrum and transformed back before it is written, the z pass in the middle of a convolution.
+layout(local_size_x = 128) in;
+
+#include "particle_mesh.glsl"
+
+uniform uint lineLength;    // 2 grid, at most 256
+uniform uint bits;          // log2 lineLength
+uniform uint stride;
+uniform uint firstStride;
+uniform uint secondStride;
+uniform bool inverse;
+uniform bool convolve;
+
+shared vec2 line[256];
+
+// bit-reversed order, in place
+void permute()
+{
+    vec2 held[2];
+    uint count = 0u;
+    for (uint k = gl_LocalInvocationID.x; k < lineLength; k += 128u)
+        held[count++] = line[k];
+    barrier();
+    count = 0u;
+    for (uint k = gl_LocalInvocationID.x; k < lineLength; k += 128u)
+        line[bitfieldReverse(k) >> (32u - bits)] = held[count++];
+    barrier();
+}
+
+// decimation in time over bit-reversed input, unnormalized; sign -1 forward, +1 inverse
+void transform(float sign)
+{
+    for (uint span = 1u; span < lineLength; span <<= 1) {
+        for (uint b = gl_LocalInvocationID.x; b < lineLength / 2u; b += 128u) {
+            uint k = b & (span - 1u);
+            uint i = (b - k) * 2u + k;
+            uint j = i + span;
+            float angle = sign * 3.14159265 * float(k) / float(span);
+            vec2 w = vec2(cos(angle), sin(angle));
+            vec2 x = line[j];
+            vec2 t = vec2(w.x * x.x - w.y * x.y, w.x * x.y + w.y * x.x);
+            line[j] = line[i] - t;
+            line[i] += t;
+        }
+        barrier();
+    }
+}
+
+void main()
+{
+    uint base = gl_WorkGroupID.x * firstStride + gl_WorkGroupID.y * secondStride;
+    for (uint k = gl_LocalInvocationID.x; k < lineLength; k += 128u)
+        line[bitfieldReverse(k) >> (32u - bits)] = work[base + k * stride];
+    barrier();
+    transform(inverse ? 1.0 : -1.0);
+    if (convolve) {
+        for (uint k = gl_LocalInvocationID.x; k < lineLength; k += 128u)
+            line[k] *= spectrum[base + k * stride];
+        barrier();
+        permute();
+        transform(1.0);
+    }
+    for (uint k = gl_LocalInvocationID.x; k < lineLength; k += 128u)
+        work[base + k * stride] = line[k];
+}
@@ -0,0 +1,81 @@
+#version 460 core
+// kicks every body with the mesh force: the four-point gradient of the convolution at the eight nodes around it,
+// with the deposit's weights. With shortRange the massive bodies' pull within the cutoff is added pair by pair,
+// the part the long-range kernel leaves out.
+layout(local_size_x = 256) in;
+
+#include "particle_mesh.glsl"
+
+layout(std430, binding = 0) readonly buffer PositionMass {
+    vec4 posMass[];
+};
+layout(std430, binding = 1) buffer Velocity {
+    vec4 velocity[];
+};
+
+uniform uint bodyCount;
+uniform uint massiveCount;
+uniform bool shortRange;
+uniform float splitCells;   // r_s in cells
+uniform float cutoffSplits; // pairs within this many r_s
+uniform float G;
+uniform float dt;
+uniform float epsilonSq;
+
+float convolution(ivec3 n)
+{
+    return work[workIndex(n)].x;
+}
+
+vec3 nodeGradient(ivec3 n)
+{
+    vec3 g;
+    for (int a = 0; a < 3; a++) {
+        ivec3 e = ivec3(0);
+        e[a] = 1;
+        g[a] = (2.0 / 3.0) * (convolution(n + e) - convolution(n - e)) - (1.0 / 12.0) * (convolution(n + 2 * e) - convolution(n - 2 * e));
+    }
+    return g;
+}
+
+// Abramowitz and Stegun 7.1.26, to 1.5e-7
+float erfcApprox(float x)
+{
+    float t = 1.0 / (1.0 + 0.3275911 * x);
+    float poly = t * (0.254829592 + t * (-0.284496736 + t * (1.421413741 + t * (-1.453152027 + t * 1.061405429))));
+    return poly * exp(-x * x);
+}
+
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= bodyCount)
+        return;
+    MeshFrame frame = meshFrame();
+    vec3 p = posMass[i].xyz;
+    vec3 f;
+    ivec3 base = meshBase((p - frame.origin) / frame.cellSize, f);
+    vec3 acc = vec3(0.0);
+    for (uint k = 0u; k < 8u; k++)
+        acc += meshWeight(f, k) * nodeGradient(base + ivec3(k & 1u, (k >> 1) & 1u, k >> 2));
+    acc /= frame.cellSize * frame.cellSize;
+
+    if (shortRange) {
+        float split = splitCells * frame.cellSize;
+        float cutoff = cutoffSplits * split;
+        for (uint j = 0u; j < massiveCount; j++) {
+            if (j == i)
+                continue;
+            vec3 r = posMass[j].xyz - p;
+            float d2 = dot(r, r);
+            if (d2 >= cutoff * cutoff)
+                continue;
+            float r2 = max(d2, epsilonSq);
+            float dist = sqrt(r2);
+            float x = dist / (2.0 * split);
+            float rest = erfcApprox(x) + dist / (split * 1.7724539) * exp(-x * x);
+            acc += r * (posMass[j].w * rest / (r2 * dist));
+        }
+    }
+    velocity[i].xyz += G * acc * dt * velocity[i].w;
+}
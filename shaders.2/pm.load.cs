@@ -0,0 +1,19 @@
+#version 460 core
+// the node masses into the zero-padded transform grid
+layout(local_size_x = 64) in;
+
+#include "particle_mesh.glsl"
+
+uniform float massScale;
+
+void main()
+{
+    uvec3 n = gl_GlobalInvocationID;
+    uint m = 2u * grid;
+    if (n.x >= m)
+        return;
+    float mass = 0.0;
+    if (all(lessThan(n, uvec3(grid))))
+        mass = float(nodeMass[(n.z * grid + n.y) * grid + n.x]) / massScale;
+    work[(n.z * m + n.y) * m + n.x] = vec2(mass, 0.0);
+}
@@ -0,0 +1,35 @@
+#version 460 core
+// one star per vertex, no vertex buffers: the position straight from the GPU n-body buffer and the luminosity
+// from its scale buffer (include/point_cloud.h). A point's pixel size is fixed, so a dense region brightens by
+// adding up points and not by growing them.
+layout(std140, binding = 0) uniform Matrices {
+    mat4 projection;
+    mat4 view;
+};
+
+layout(std430, binding = 0) readonly buffer PositionMass {
+    vec4 posMass[];
+};
+layout(std430, binding = 3) readonly buffer Scale {
+    float scale[];
+};
+
+uniform uint first;         // the stars follow the massive bodies
+uniform vec3 origin;        // the camera, the buffer holds world positions
+uniform float pointSize;    // pixels for a luminosity of 1
+uniform float brightness;  // a star of luminosity 1, summed over its sprite
+uniform vec3 warmColor;
+uniform vec3 coolColor;
+
+out vec3 Emission;
+
+void main()
+{
+    uint i = first + uint(gl_VertexID);
+    float luminosity = scale[i];
+    gl_Position = projection * view * vec4(posMass[i].xyz - origin, 1.0);
+    // the brighter ones a little larger, the emission spread over the sprite so a star's total is its luminosity
+    float size = clamp(pointSize * sqrt(luminosity), 1.0, 8.0);
+    gl_PointSize = size;
+    Emission = mix(warmColor, coolColor, smoothstep(0.8, 2.0, luminosity)) * (brightness * luminosity / (size * size));
+}
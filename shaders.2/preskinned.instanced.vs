@@ -0,0 +1,39 @@
+#version 460 core
+// Instances of a crowd skinned ahead by shaders.2/skinning.cs (include/skinned_crowd.h): position and normal come
+// from the stream, instance after instance, the UVs from the mesh's own vertex buffer.
+layout(location = 2) in vec2 aTexCoords;
+layout(std140, binding = 0) uniform Matrices {
+    mat4 projection;
+    mat4 view;
+};
+
+struct SkinnedVertex {
+    vec4 position;
+    vec4 normal;
+};
+
+layout(std430, binding = 17) readonly buffer InstanceMatrices {
+    mat4 instanceModels[];
+};
+layout(std430, binding = 18) readonly buffer SkinnedVertices {
+    SkinnedVertex skinned[];
+};
+
+uniform int firstVertex;    // what gl_VertexID counts from, the mesh's base vertex
+uniform int vertexCount;
+uniform int streamBase;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+
+void main()
+{
+    SkinnedVertex vertex = skinned[streamBase + gl_InstanceID * vertexCount + (gl_VertexID - firstVertex)];
+    mat4 model = instanceModels[gl_InstanceID];
+    vec4 viewPos = view * model * vertex.position;
+    gl_Position = projection * viewPos;
+    FragPos = viewPos.xyz;
+    Normal = mat3(view) * transpose(inverse(mat3(model))) * vertex.normal.xyz;
+    TexCoords = aTexCoords;
+}
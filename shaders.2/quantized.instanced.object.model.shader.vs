@@ -0,0 +1,114 @@
+#version 460 core
+// asteroid instances from a 16-byte quantized record, decoded against the bounds of their chunk
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoords;
+layout(location = 8) in uint aInstanceOrientation;     // smallest three 10:10:10, top 2 bits the dropped component
+layout(location = 9) in vec3 aInstanceSpinAxis;        // body-frame tumble axis
+layout(location = 10) in uvec4 aInstancePositionScale; // xyz unorm16 position in the chunk, w scale byte | turns << 8
+#include "picking.glsl"
+#include "rock_variant.glsl"
+
+#include "stereo.glsl"
+struct Chunk {
+    vec4 origin;    // xyz lowest corner relative to the camera, w smallest scale
+    vec4 extent;    // xyz size of the bounds, w scale range
+};
+layout(std430, binding = 6) readonly buffer Chunks {
+    Chunk chunks[];
+};
+
+uniform float spinTime;        // sim time modulo the tumble period
+uniform float turnRate;        // radians per sim second of one turn per tumble period
+uniform uint chunkBase;        // first chunk of this draw, each level of detail is drawn from its own chunks
+uniform bool impostor;         // one point per instance for impostor.point.fs instead of the mesh
+uniform float modelRadius;     // bounding sphere of the unscaled model, sizes the point
+uniform float viewportHeight;
+
+const uint INSTANCE_CHUNK = 256u;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+out float ImpostorRadius;      // view-space radius of the point's sphere
+flat out uint Variant;         // a number fixed per rock, picks its texture layer in rock.instanced.object.model.shader.fs
+flat out uint Pick;            // the record in the stream, the viewer knows whose it is
+#ifdef SHADOW_PASS
+flat out vec4 ShadowSphere;      // the rock's bounding sphere for shadow.cube.gs
+#endif
+
+vec4 unpackSmallestThree(uint packed)
+{
+    uint largest = packed >> 30;
+    vec3 small = vec3(uvec3(packed >> 20, packed >> 10, packed) & 1023u) / 1023.0 * 1.41421356 - 0.70710678;
+    float rebuilt = sqrt(max(0.0, 1.0 - dot(small, small)));
+    if (largest == 0u) return vec4(rebuilt, small);
+    if (largest == 1u) return vec4(small.x, rebuilt, small.yz);
+    if (largest == 2u) return vec4(small.xy, rebuilt, small.z);
+    return vec4(small, rebuilt);
+}
+
+mat3 quatToMat3(vec4 q)
+{
+    vec3 q2 = q.xyz * 2.0;
+    float xx = q.x * q2.x, yy = q.y * q2.y, zz = q.z * q2.z;
+    float xy = q.x * q2.y, xz = q.x * q2.z, yz = q.y * q2.z;
+    float wx = q.w * q2.x, wy = q.w * q2.y, wz = q.w * q2.z;
+    return mat3(1.0 - (yy + zz), xy + wz, xz - wy,
+                xy - wz, 1.0 - (xx + zz), yz + wx,
+                xz + wy, yz - wx, 1.0 - (xx + yy));
+}
+
+// rotation by angle about a unit axis (Rodrigues)
+mat3 axisAngleToMat3(vec3 axis, float angle)
+{
+    float s = sin(angle), c = cos(angle);
+    vec3 t = axis * (1.0 - c);
+    return mat3(t.x * axis.x + c, t.x * axis.y + s * axis.z, t.x * axis.z - s * axis.y,
+                t.y * axis.x - s * axis.z, t.y * axis.y + c, t.y * axis.z + s * axis.x,
+                t.z * axis.x + s * axis.y, t.z * axis.y - s * axis.x, t.z * axis.z + c);
+}
+
+void main()
+{
+    // the spin axis comes from the body id, so it names the rock wherever the record lands in the stream
+    uvec3 axisBits = floatBitsToUint(aInstanceSpinAxis);
+    Pick = PICK_RECORD | (uint(gl_BaseInstance) + stereoInstance());
+    Variant = (axisBits.x * 73856093u ^ axisBits.y * 19349663u ^ axisBits.z * 83492791u) >> 16;
+    // gl_InstanceID does not include baseInstance, so it counts from the start of this frame's records
+    Chunk chunk = chunks[chunkBase + stereoInstance() / INSTANCE_CHUNK];
+    vec3 position = chunk.origin.xyz + vec3(aInstancePositionScale.xyz) / 65535.0 * chunk.extent.xyz;
+    float scale = chunk.origin.w + float(aInstancePositionScale.w & 255u) / 255.0 * chunk.extent.w;
+    float rate = float(aInstancePositionScale.w >> 8) * turnRate;
+    if (impostor)
+    {
+        // a lit disc the size of the rock's bounding sphere, drawn as a single point
+        vec4 viewCenter = view * vec4(position, 1.0);
+        ImpostorRadius = modelRadius * scale;
+        gl_Position = stereoPosition(position);
+        gl_PointSize = max(ImpostorRadius * projection[1][1] * viewportHeight / max(-viewCenter.z, 1e-4), 1.0);
+        FragPos = viewCenter.xyz;
+        Normal = vec3(0.0, 0.0, 1.0);
+        TexCoords = vec2(0.5);
+        return;
+    }
+
+    vec3 axis = normalize(aInstanceSpinAxis);
+    mat3 rotation = quatToMat3(unpackSmallestThree(aInstanceOrientation)) * axisAngleToMat3(axis, rate * spinTime);
+    // a procedural rock's own shape, nothing for the rock's mesh
+    vec3 localPos = aPos;
+    vec3 localNormal = aNormal;
+    reliefRock(Variant, localPos, localNormal);
+    vec3 worldPos = position + rotation * (localPos * scale);
+#ifdef SHADOW_PASS
+    // camera-relative, shadow.cube.gs projects it into every face of the sun's cube map
+    gl_Position = vec4(worldPos, 1.0);
+    ShadowSphere = vec4(position, modelRadius * scale);
+    return;
+#endif
+    gl_Position = stereoPosition(worldPos);
+    FragPos = vec3(view * vec4(worldPos, 1.0));
+    // uniform scale, so the normal matrix is just the rotation
+    Normal = mat3(view) * rotation * localNormal;
+    TexCoords = aTexCoords;
+}
@@ -0,0 +1,21 @@
+#version 460 core
+// first pass of a radix sort digit: how many of each tile's keys have each value of the digit
+layout(local_size_x = 256) in;
+
+#include "radix_sort.glsl"
+
+shared uint bins[RADIX];
+
+void main()
+{
+    uint l = gl_LocalInvocationID.x;
+    if (l < RADIX)
+        bins[l] = 0u;
+    barrier();
+    uint i = gl_GlobalInvocationID.x;
+    if (i < elements())
+        atomicAdd(bins[digitOf(i)], 1u);
+    barrier();
+    if (l < RADIX)
+        histograms[l * gl_NumWorkGroups.x + gl_WorkGroupID.x] = bins[l];
+}
@@ -0,0 +1,34 @@
+#version 460 core
+// second pass of a radix sort digit: an exclusive prefix sum over every tile's counts, digit-major, so each entry
+// becomes where that tile's keys of that digit start in the output. One workgroup walks the counts 1024 at a time.
+layout(local_size_x = 1024) in;
+
+#include "radix_sort.glsl"
+
+uniform uint histogramCount;    // RADIX * tiles
+
+shared uint partial[1024];
+
+void main()
+{
+    uint l = gl_LocalInvocationID.x;
+    uint carry = 0u;
+    for (uint first = 0u; first < histogramCount; first += 1024u)
+    {
+        uint value = first + l < histogramCount ? histograms[first + l] : 0u;
+        partial[l] = value;
+        barrier();
+        // Hillis-Steele, inclusive
+        for (uint offset = 1u; offset < 1024u; offset <<= 1)
+        {
+            uint add = l >= offset ? partial[l - offset] : 0u;
+            barrier();
+            partial[l] += add;
+            barrier();
+        }
+        if (first + l < histogramCount)
+            histograms[first + l] = carry + partial[l] - value;
+        carry += partial[1023];
+        barrier();
+    }
+}
@@ -0,0 +1,38 @@
+#version 460 core
+// last pass of a radix sort digit: every key and value goes to its tile's start for its digit plus how many keys of
+// the tile before it have the same digit, which keeps the sort stable. Those ranks come from one scan over the tile
+// of all sixteen digit counts at once, two 16-bit counts to a uint (a tile holds at most 256 of a digit).
+layout(local_size_x = 256) in;
+
+#include "radix_sort.glsl"
+
+shared uint counts[RADIX / 2u][TILE];
+
+void main()
+{
+    uint l = gl_LocalInvocationID.x;
+    uint i = gl_GlobalInvocationID.x;
+    bool valid = i < elements();
+    uint digit = valid ? digitOf(i) : 0u;
+    uint word = digit >> 1, lane = (digit & 1u) * 16u;
+    for (uint w = 0u; w < RADIX / 2u; w++)
+        counts[w][l] = valid && w == word ? 1u << lane : 0u;
+    barrier();
+    for (uint offset = 1u; offset < TILE; offset <<= 1)
+    {
+        uint add[RADIX / 2u];
+        for (uint w = 0u; w < RADIX / 2u; w++)
+            add[w] = l >= offset ? counts[w][l - offset] : 0u;
+        barrier();
+        for (uint w = 0u; w < RADIX / 2u; w++)
+            counts[w][l] += add[w];
+        barrier();
+    }
+    if (!valid)
+        return;
+    uint rank = ((counts[word][l] >> lane) & 0xffffu) - 1u;
+    uint slot = histograms[digit * gl_NumWorkGroups.x + gl_WorkGroupID.x] + rank;
+    for (uint k = 0u; k < keyWords; k++)
+        keysOut[slot * keyWords + k] = keysIn[i * keyWords + k];
+    valuesOut[slot] = valuesIn[i];
+}
@@ -0,0 +1,38 @@
+// shared by the radix sort passes (include/gpu_radix_sort.h): the buffers of one pass and the digit it sorts on.
+// Keys are keyWords uints per element, the low word first, values one uint.
+layout(std430, binding = 38) readonly buffer KeysIn {
+    uint keysIn[];
+};
+layout(std430, binding = 39) readonly buffer ValuesIn {
+    uint valuesIn[];
+};
+layout(std430, binding = 40) writeonly buffer KeysOut {
+    uint keysOut[];
+};
+layout(std430, binding = 41) writeonly buffer ValuesOut {
+    uint valuesOut[];
+};
+layout(std430, binding = 42) buffer Histograms {
+    uint histograms[];      // digit * tiles + tile, counts and then, scanned, where the tiles' digits go
+};
+layout(std430, binding = 43) readonly buffer ElementCount {
+    uint elementCount;      // with countOnGpu, how many of the elements to sort
+};
+
+const uint RADIX = 16u;         // 4-bit digits
+const uint TILE = 256u;         // elements per workgroup, one per invocation
+
+uniform uint count;             // elements, or the capacity with countOnGpu
+uniform bool countOnGpu;
+uniform uint keyWords;          // 1 for 32-bit keys, 2 for 64-bit
+uniform uint shift;             // of the digit, bits from the key's lowest
+
+uint elements()
+{
+    return countOnGpu ? min(elementCount, count) : count;
+}
+
+uint digitOf(uint i)
+{
+    return (keysIn[i * keyWords + (shift >> 5)] >> (shift & 31u)) & (RADIX - 1u);
+}
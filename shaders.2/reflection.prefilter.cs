@@ -0,0 +1,71 @@
+#version 460 core
+// one mip level of a reflection probe, prefiltered for the roughness of that level (0 at level 0, 1 at the last)
+// from the finished levels above it: GGX importance sampling about the texel's direction with view = normal, and
+// each sample read from the level whose texels match its share of the lobe (Karis, "Real Shading in Unreal
+// Engine 4", with the filtered importance sampling of Colbert and Krivanek).
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(r11f_g11f_b10f, binding = 0) writeonly uniform imageCube destination;
+uniform samplerCube source;
+uniform int level;
+uniform int levels;
+uniform float sourceSize;      // of level 0
+
+const uint SAMPLE_COUNT = 32u;
+const float PI = 3.14159265359;
+
+// the direction through a texel of a face, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face order
+vec3 faceDirection(uint face, vec2 uv)
+{
+    vec2 p = uv * 2.0 - 1.0;
+    if (face == 0u) return vec3(1.0, -p.y, -p.x);
+    if (face == 1u) return vec3(-1.0, -p.y, p.x);
+    if (face == 2u) return vec3(p.x, 1.0, p.y);
+    if (face == 3u) return vec3(p.x, -1.0, -p.y);
+    if (face == 4u) return vec3(p.x, -p.y, 1.0);
+    return vec3(-p.x, -p.y, -1.0);
+}
+
+vec2 hammersley(uint i)
+{
+    uint bits = bitfieldReverse(i);
+    return vec2(float(i) / float(SAMPLE_COUNT), float(bits) * 2.3283064365386963e-10);
+}
+
+void main()
+{
+    ivec3 texel = ivec3(gl_GlobalInvocationID);
+    int size = imageSize(destination).x;
+    if (texel.x >= size || texel.y >= size)
+        return;
+    vec3 N = normalize(faceDirection(uint(texel.z), (vec2(texel.xy) + 0.5) / float(size)));
+    float roughness = float(level) / float(max(levels - 1, 1));
+    float a = roughness * roughness;
+
+    vec3 up = abs(N.z) < 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0);
+    vec3 tangent = normalize(cross(up, N));
+    vec3 bitangent = cross(N, tangent);
+    float texelSolidAngle = 4.0 * PI / (6.0 * sourceSize * sourceSize);
+
+    vec3 sum = vec3(0.0);
+    float weight = 0.0;
+    for (uint i = 0u; i < SAMPLE_COUNT; i++)
+    {
+        vec2 xi = hammersley(i);
+        float cosTheta = sqrt((1.0 - xi.y) / (1.0 + (a * a - 1.0) * xi.y));
+        float sinTheta = sqrt(1.0 - cosTheta * cosTheta);
+        float phi = 2.0 * PI * xi.x;
+        vec3 H = normalize(tangent * (cos(phi) * sinTheta) + bitangent * (sin(phi) * sinTheta) + N * cosTheta);
+        vec3 L = reflect(-N, H);
+        float NdotL = dot(N, L);
+        if (NdotL <= 0.0)
+            continue;
+        // the pdf of L is D * NdotH / (4 * VdotH), with V = N that is D / 4
+        float d = a * a / (PI * pow(cosTheta * cosTheta * (a * a - 1.0) + 1.0, 2.0));
+        float sampleSolidAngle = 4.0 / (float(SAMPLE_COUNT) * max(d, 1e-6));
+        float lod = clamp(0.5 * log2(sampleSolidAngle / texelSolidAngle) + 1.0, 0.0, float(level - 1));
+        sum += textureLod(source, L, lod).rgb * NdotL;
+        weight += NdotL;
+    }
+    imageStore(destination, texel, vec4(sum / max(weight, 1e-4), 1.0));
+}
@@ -0,0 +1,109 @@
+#version 460 core
+// 2.instanced.object.model.shader.fs for asteroids, each rock samples its variant's layer of one texture array
+// (include/rock_variants.h), bound once for every rock
+#include "lights.glsl"
+
+in vec3 Normal;
+in vec3 FragPos;
+in vec2 TexCoords;
+flat in uint Variant;
+flat in uint Pick;          // what include/gpu_picker.h reads back for the pixel
+
+#ifdef GBUFFER_OUTPUT
+#include "gbuffer.glsl"
+#else
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out uint PickId;
+#endif
+
+uniform sampler2DArray rockTextures;   // unit 0
+uniform uint variantCount;
+uniform mat4 viewMat;
+
+vec3 diffuseColor;
+
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+
+void main() {
+    PickId = Pick;
+    // the diffuse layer doubles as specular, like the bound path where both samplers default to unit 0
+    diffuseColor = texture(rockTextures, vec3(TexCoords, float(Variant % variantCount))).rgb;
+    vec3 norm = normalize(Normal);
+#ifdef GBUFFER_OUTPUT
+    writeGBuffer(diffuseColor, diffuseColor, norm);
+#else
+    vec3 viewDir = normalize(-FragPos);
+    vec3 result = CalcDirLight(dirLight, norm, viewDir);
+#ifdef CLUSTERED_LIGHTS
+    uint cluster = fragmentCluster(FragPos);
+    for (uint i = 0u; i < clusterCounts[cluster]; i++) {
+        pointShadow = pointLightShadow(clusterLightIndex(cluster, i), FragPos, norm);
+        result += CalcPointLight(clusterLight(cluster, i), norm, FragPos, viewDir);
+    }
+#else
+    for(int i = 0; i < NR_POINT_LIGHTS; i++) {
+        pointShadow = pointLightShadow(uint(i), FragPos, norm);
+        result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
+    }
+#endif
+    result += CalcSpotLight(spotLight, norm, FragPos, viewDir);
+    FragColor = vec4(result, 1.0);
+#endif
+}
+
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir) {
+    vec3 lightDir = normalize(- (viewMat * vec4(light.direction, 0.0)).xyz);
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+    vec3 ambient = light.ambient * diffuseColor;
+    vec3 diffuse = light.diffuse * diff * diffuseColor;
+    vec3 specular = light.specular * spec * diffuseColor;
+    return (ambient + diffuse + specular);
+}
+
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    vec3 lightDir = normalize(vec3(viewMat * light.position) - fragPos);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+    // attenuation
+    float distance = length(vec3(viewMat * light.position) - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
+    // combine results
+    vec3 ambient = light.ambient * diffuseColor;
+    vec3 diffuse = light.diffuse * diff * pointShadow * diffuseColor;
+    vec3 specular = light.specular * spec * pointShadow * diffuseColor;
+    ambient *= attenuation;
+    diffuse *= attenuation;
+    specular *= attenuation;
+    return (ambient + diffuse + specular);
+}
+
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    // Diffuse
+    float diff = max(dot(normal, viewDir), 0.0);
+    // Specular
+    float spec = pow(max(dot(normal, viewDir), 0.0), material.shininess);
+    // Attenuation
+    float distance = length(-fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    // Spotlight Intensity
+    float theta = dot(viewDir, normalize(-vec3(0.0, 0.0, -1.0)));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    // Combine
+    vec3 ambient = light.ambient * diffuseColor;
+    vec3 diffuse = light.diffuse * diff * diffuseColor;
+    vec3 specular = light.specular * spec * diffuseColor;
+    ambient *= attenuation * intensity;
+    diffuse *= attenuation * intensity;
+    specular *= attenuation * intensity;
+    return (ambient + diffuse + specular);
+}
\ No newline at end of file
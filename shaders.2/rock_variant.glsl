@@ -0,0 +1,79 @@
+// a number fixed per GPU-resident rock, its variant modulo the variant count: the mesh shape the cull
+// (asteroid.cull.cs) bins it under and the texture layer rock.instanced.object.model.shader.fs samples.
+// rockVariant() in include/rock_variants.h is the same on the CPU.
+uint rockVariantHash(uint body)
+{
+    return body * 2654435761u >> 16;
+}
+
+// Procedural rocks (include/rock_variants.h): the mesh is an icosphere, each rock moves its vertices radially by
+// a few octaves of gradient noise over the direction from its centre, sampled at an offset of its own number, and
+// bends the normal by the noise's analytic gradient. rockRelief is the largest move as a fraction of the radius,
+// 0 for the rock's own mesh, which is then left alone.
+uniform float rockRelief;
+
+#define ROCK_RELIEF_OCTAVES 4
+#define ROCK_RELIEF_FREQUENCY 1.5
+
+// a unit gradient of the lattice point, different for every rock
+vec3 reliefLatticeGradient(ivec3 c, uint seed)
+{
+    uint h = uint(c.x) * 1597334677u ^ uint(c.y) * 3812015801u ^ uint(c.z) * 2798796415u ^ seed * 2654435761u;
+    h = (h ^ (h >> 16)) * 2246822519u;
+    h ^= h >> 13;
+    uvec3 bits = uvec3(h, h * 16807u, h * 48271u) >> 8;
+    vec3 g = vec3(bits) * (2.0 / 16777216.0) - 1.0;
+    return dot(g, g) > 1e-6 ? normalize(g) : vec3(1.0, 0.0, 0.0);
+}
+
+// gradient noise at x, in w its derivative (quintic interpolation, so both are continuous)
+vec4 reliefNoise(vec3 x, uint seed)
+{
+    ivec3 i = ivec3(floor(x));
+    vec3 f = fract(x);
+    vec3 u = f * f * f * (f * (f * 6.0 - 15.0) + 10.0);
+    vec3 du = 30.0 * f * f * (f * (f - 2.0) + 1.0);
+    vec3 ga = reliefLatticeGradient(i, seed), gb = reliefLatticeGradient(i + ivec3(1, 0, 0), seed);
+    vec3 gc = reliefLatticeGradient(i + ivec3(0, 1, 0), seed), gd = reliefLatticeGradient(i + ivec3(1, 1, 0), seed);
+    vec3 ge = reliefLatticeGradient(i + ivec3(0, 0, 1), seed), gf = reliefLatticeGradient(i + ivec3(1, 0, 1), seed);
+    vec3 gg = reliefLatticeGradient(i + ivec3(0, 1, 1), seed), gh = reliefLatticeGradient(i + ivec3(1, 1, 1), seed);
+    float va = dot(ga, f), vb = dot(gb, f - vec3(1.0, 0.0, 0.0));
+    float vc = dot(gc, f - vec3(0.0, 1.0, 0.0)), vd = dot(gd, f - vec3(1.0, 1.0, 0.0));
+    float ve = dot(ge, f - vec3(0.0, 0.0, 1.0)), vf = dot(gf, f - vec3(1.0, 0.0, 1.0));
+    float vg = dot(gg, f - vec3(0.0, 1.0, 1.0)), vh = dot(gh, f - vec3(1.0, 1.0, 1.0));
+    float value = va + u.x * (vb - va) + u.y * (vc - va) + u.z * (ve - va) + u.x * u.y * (va - vb - vc + vd) +
+                  u.y * u.z * (va - vc - ve + vg) + u.z * u.x * (va - vb - ve + vf) + u.x * u.y * u.z * (-va + vb + vc - vd + ve - vf - vg + vh);
+    vec3 gradient = ga + u.x * (gb - ga) + u.y * (gc - ga) + u.z * (ge - ga) + u.x * u.y * (ga - gb - gc + gd) +
+                    u.y * u.z * (ga - gc - ge + gg) + u.z * u.x * (ga - gb - ge + gf) + u.x * u.y * u.z * (-ga + gb + gc - gd + ge - gf - gg + gh) +
+                    du * (vec3(vb - va, vc - va, ve - va) + u.yzx * vec3(va - vb - vc + vd, va - vc - ve + vg, va - vb - ve + vf) +
+                          u.zxy * vec3(va - vb - ve + vf, va - vb - vc + vd, va - vc - ve + vg) + u.yzx * u.zxy * (-va + vb + vc - vd + ve - vf - vg + vh));
+    return vec4(value, gradient);
+}
+
+// the rock's vertex and normal, in its own frame, displaced by its relief
+void reliefRock(uint seed, inout vec3 position, inout vec3 normal)
+{
+    float r = length(position);
+    if (rockRelief <= 0.0 || r <= 0.0)
+        return;
+    vec3 d = position / r;
+    vec3 offset = vec3(uvec3(seed, seed >> 5, seed >> 10) & 31u) * 3.7;
+    float value = 0.0;
+    vec3 gradient = vec3(0.0);
+    float amplitude = 1.0 / (2.0 - exp2(1.0 - float(ROCK_RELIEF_OCTAVES)));  // the octaves' amplitudes sum to 1
+    float frequency = ROCK_RELIEF_FREQUENCY;
+    for (int o = 0; o < ROCK_RELIEF_OCTAVES; o++)
+    {
+        vec4 n = reliefNoise(d * frequency + offset, seed);
+        value += amplitude * n.x;
+        gradient += amplitude * frequency * n.yzw;
+        amplitude *= 0.5;
+        frequency *= 2.0;
+    }
+    // p * s(p) with s = 1 + relief * noise(p / |p|): the normal transforms by the inverse transpose of
+    // s I + p grad(s)^T, and grad(s) is perpendicular to p
+    float s = 1.0 + rockRelief * value;
+    vec3 g = rockRelief * (gradient - d * dot(gradient, d)) / r;
+    normal = normalize(normal - g * (dot(position, normal) / s));
+    position *= s;
+}
@@ -0,0 +1,42 @@
+#version 460 core
+// one jump-flood pass over the selection: each texel keeps the nearest selected texel it knows of, itself or one
+// of the eight jump texels away, so after passes halving the jump down to 1 every texel near the selection holds
+// its nearest selected texel. jump 0 is the seed pass, from the object ids.
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(rg16ui, binding = 0) writeonly uniform uimage2D destination;
+uniform usampler2D source;      // the ids for the seeds, the last pass's nearest texels after that
+uniform int jump;
+
+const uint NONE = 0xFFFFu;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = imageSize(destination);
+    if (texel.x >= size.x || texel.y >= size.y)
+        return;
+    if (jump == 0) {
+        uint id = texelFetch(source, texel, 0).r;
+        imageStore(destination, texel, id != 0u ? uvec4(uvec2(texel), 0u, 0u) : uvec4(NONE, NONE, 0u, 0u));
+        return;
+    }
+    uvec2 best = uvec2(NONE);
+    float bestDistance = 1e30;
+    for (int y = -1; y <= 1; y++)
+        for (int x = -1; x <= 1; x++) {
+            ivec2 at = texel + ivec2(x, y) * jump;
+            if (any(lessThan(at, ivec2(0))) || any(greaterThanEqual(at, size)))
+                continue;
+            uvec2 seed = texelFetch(source, at, 0).rg;
+            if (seed.x == NONE)
+                continue;
+            vec2 offset = vec2(ivec2(seed) - texel);
+            float distance = dot(offset, offset);
+            if (distance < bestDistance) {
+                bestDistance = distance;
+                best = seed;
+            }
+        }
+    imageStore(destination, texel, uvec4(best, 0u, 0u));
+}
@@ -0,0 +1,24 @@
+#version 460 core
+// the outline over the frame: pixels off the selection within width of it, from the jump flood's nearest
+// selected texel, the last pixel faded for a smooth edge
+out vec4 FragColor;
+
+uniform usampler2D nearest;
+uniform usampler2D ids;
+uniform vec4 color;
+uniform float width;
+
+const uint NONE = 0xFFFFu;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    uvec2 seed = texelFetch(nearest, texel, 0).rg;
+    if (seed.x == NONE || texelFetch(ids, texel, 0).r != 0u)
+        discard;
+    float distance = length(vec2(ivec2(seed) - texel));
+    float coverage = 1.0 - smoothstep(width - 1.0, width, distance);
+    if (coverage <= 0.0)
+        discard;
+    FragColor = vec4(color.rgb, color.a * coverage);
+}
@@ -0,0 +1,68 @@
+#version 460 core
+// one tile of the shading rate image from last frame's tone-mapped colour: its brightest pixel and the largest
+// step in luminance to a right or upper neighbour decide the rate, 0 a pixel, 1 2x2, 2 4x4 (include/shading_rate.h)
+layout(local_size_x = 16, local_size_y = 16) in;
+
+layout(r8ui, binding = 0) writeonly uniform uimage2D rates;
+uniform sampler2D source;       // at last frame's size, which need not be this one's
+uniform vec2 frameSize;
+uniform int tileWidth;
+uniform int tileHeight;
+uniform float darkLuminance;
+uniform float edgeContrast;
+uniform float foveaRadius;
+uniform vec2 foveaCentre;
+
+shared uint brightest;
+shared uint steepest;
+
+float luminance(ivec2 pixel, ivec2 sourceSize)
+{
+    // this frame's pixel to the nearest of the source's
+    ivec2 texel = clamp(ivec2((vec2(pixel) + 0.5) * vec2(sourceSize) / frameSize), ivec2(0), sourceSize - 1);
+    return dot(texelFetch(source, texel, 0).rgb, vec3(0.2126, 0.7152, 0.0722));
+}
+
+void main()
+{
+    if (gl_LocalInvocationIndex == 0)
+    {
+        brightest = 0u;
+        steepest = 0u;
+    }
+    barrier();
+
+    ivec2 tile = ivec2(gl_WorkGroupID.xy);
+    ivec2 origin = tile * ivec2(tileWidth, tileHeight);
+    ivec2 last = ivec2(frameSize) - 1;
+    ivec2 sourceSize = textureSize(source, 0);
+    float localBrightest = 0.0, localSteepest = 0.0;
+    for (int y = int(gl_LocalInvocationID.y); y < tileHeight; y += 16)
+        for (int x = int(gl_LocalInvocationID.x); x < tileWidth; x += 16)
+        {
+            ivec2 pixel = min(origin + ivec2(x, y), last);
+            float l = luminance(pixel, sourceSize);
+            localBrightest = max(localBrightest, l);
+            // the tile's last row and column step into the next tile, so an edge on the border counts on both sides
+            localSteepest = max(localSteepest, abs(l - luminance(min(pixel + ivec2(1, 0), last), sourceSize)));
+            localSteepest = max(localSteepest, abs(l - luminance(min(pixel + ivec2(0, 1), last), sourceSize)));
+        }
+    // luminance to 16-bit fixed point for the shared maxima
+    atomicMax(brightest, uint(clamp(localBrightest, 0.0, 1.0) * 65535.0));
+    atomicMax(steepest, uint(clamp(localSteepest, 0.0, 1.0) * 65535.0));
+    barrier();
+
+    if (gl_LocalInvocationIndex == 0)
+    {
+        uint rate = 2u;
+        if (float(steepest) / 65535.0 >= edgeContrast || float(brightest) / 65535.0 >= darkLuminance)
+        {
+            // the distance to the fovea's centre in half-diagonals, the same in x and y of the screen
+            vec2 centre = (vec2(origin) + 0.5 * vec2(tileWidth, tileHeight)) / frameSize;
+            float aspect = frameSize.x / frameSize.y;
+            vec2 offset = (centre - foveaCentre) * vec2(aspect, 1.0) / (0.5 * sqrt(aspect * aspect + 1.0));
+            rate = foveaRadius > 0.0 && length(offset) > foveaRadius ? 1u : 0u;
+        }
+        imageStore(rates, tile, uvec4(rate));
+    }
+}
@@ -0,0 +1,20 @@
+#version 460 core
+// every tile of the shading rate image takes the finest rate of its 3x3 neighbourhood, so what moved by up to a
+// tile since the frame its rate was classified from is still shaded at that rate
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(r8ui, binding = 0) readonly uniform uimage2D classified;
+layout(r8ui, binding = 1) writeonly uniform uimage2D rates;
+
+void main()
+{
+    ivec2 tile = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = imageSize(rates);
+    if (tile.x >= size.x || tile.y >= size.y)
+        return;
+    uint finest = 2u;
+    for (int y = -1; y <= 1; y++)
+        for (int x = -1; x <= 1; x++)
+            finest = min(finest, imageLoad(classified, clamp(tile + ivec2(x, y), ivec2(0), size - 1)).r);
+    imageStore(rates, tile, uvec4(finest));
+}
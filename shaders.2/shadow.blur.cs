@@ -0,0 +1,42 @@
+#version 460 core
+// one direction of the moment shadow maps' separable Gaussian, see include/moment_shadows.h: across from the
+// moments into the scratch image, then down from it back. Each layer, a cube face with CUBE_MAP, is blurred on its
+// own and clamped at its edges.
+layout(local_size_x = 8, local_size_y = 8) in;
+
+#define MAX_RADIUS 8
+
+#ifdef CUBE_MAP
+layout(rg32f, binding = 0) readonly uniform imageCube source;
+layout(rg32f, binding = 1) writeonly uniform imageCube blurred;
+#else
+layout(rg32f, binding = 0) readonly uniform image2DArray source;
+layout(rg32f, binding = 1) writeonly uniform image2DArray blurred;
+#endif
+
+uniform int radius;     // taps either side, at most MAX_RADIUS
+uniform float sigma;
+uniform int vertical;
+uniform int firstLayer;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    int size = imageSize(source).x;
+    if (texel.x >= size || texel.y >= size)
+        return;
+    int layer = firstLayer + int(gl_GlobalInvocationID.z);
+    ivec2 step = vertical == 0 ? ivec2(1, 0) : ivec2(0, 1);
+    vec2 sum = vec2(0.0);
+    float total = 0.0;
+    for (int k = -MAX_RADIUS; k <= MAX_RADIUS; k++)
+    {
+        if (abs(k) > radius)
+            continue;
+        float weight = exp(-0.5 * float(k * k) / (sigma * sigma));
+        ivec2 at = clamp(texel + k * step, ivec2(0), ivec2(size - 1));
+        sum += weight * imageLoad(source, ivec3(at, layer)).rg;
+        total += weight;
+    }
+    imageStore(blurred, ivec3(texel, layer), vec4(sum / total, 0.0, 0.0));
+}
@@ -0,0 +1,14 @@
+#version 460 core
+// distance from the sun over the far plane, what shadows.glsl compares against, and its moments for the filtered map
+in vec3 FromLight;
+
+layout(location = 0) out vec2 Moments;
+
+uniform float farPlane;
+
+void main()
+{
+    float distance = length(FromLight) / farPlane;
+    gl_FragDepth = distance;
+    Moments = vec2(distance, distance * distance);
+}
@@ -0,0 +1,34 @@
+#version 460 core
+// the sun's cube shadow map in one pass: each invocation is a face, it passes on the triangles of casters whose
+// bounding sphere reaches into its frustum and routes them to its layer
+layout(triangles, invocations = 6) in;
+layout(triangle_strip, max_vertices = 3) out;
+
+flat in vec4 ShadowSphere[];    // the caster's centre, camera-relative, and radius
+out vec3 FromLight;
+
+uniform mat4 faceMatrices[6];   // projection * view of each face, about the sun at the origin
+uniform vec3 lightPosition;     // camera-relative
+
+void main()
+{
+    mat4 face = faceMatrices[gl_InvocationID];
+    vec3 center = ShadowSphere[0].xyz - lightPosition;
+    float radius = ShadowSphere[0].w;
+    // Gribb-Hartmann planes as in asteroid.cull.cs
+    mat4 m = transpose(face);
+    vec4 planes[6] = vec4[6](m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[3] + m[2], m[3] - m[2]);
+    for (int p = 0; p < 6; p++)
+    {
+        if (dot(planes[p].xyz, center) + planes[p].w < -radius * length(planes[p].xyz))
+            return;
+    }
+    for (int v = 0; v < 3; v++)
+    {
+        FromLight = gl_in[v].gl_Position.xyz - lightPosition;
+        gl_Position = face * vec4(FromLight, 1.0);
+        gl_Layer = gl_InvocationID;
+        EmitVertex();
+    }
+    EndPrimitive();
+}
@@ -0,0 +1,14 @@
+#version 460 core
+// a single caster of the sun's shadow, placed for shadow.cube.gs
+layout(location = 0) in vec3 aPos;
+
+uniform mat4 model;
+uniform float modelRadius;      // bounding sphere of the unscaled model
+
+flat out vec4 ShadowSphere;
+
+void main()
+{
+    gl_Position = model * vec4(aPos, 1.0);
+    ShadowSphere = vec4(model[3].xyz, modelRadius * length(model[0].xyz));
+}
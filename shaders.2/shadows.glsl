@@ -0,0 +1,31 @@
+// the sun's omnidirectional shadow, see include/cube_shadow_map.h. The cube map holds each direction's distance to
+// the nearest caster over the far plane, compared in hardware with 2x2 filtering, or filtered its moments are
+// blurred and a single bilinear sample of them bounds the lit part (moment_shadows.glsl).
+#include "moment_shadows.glsl"
+
+layout(std140, binding = 3) uniform SunShadow {
+    mat4 shadowInverseView;     // view space back to camera-relative world
+    vec4 shadowLight;           // the sun camera-relative, the far plane in w, 0 with shadows off
+    vec4 shadowBias;            // fraction of the distance taken off, and pushed along the normal per unit of distance;
+                                // z 1 when filtered, w the light bleeding cut off then
+};
+layout(binding = 16) uniform samplerCubeShadow sunShadowMap;
+layout(binding = 22) uniform samplerCube sunShadowMoments;
+
+// how much of the sun reaches a view-space point with the given view-space normal, 1 lit and 0 shadowed
+float sunShadow(vec3 fragPos, vec3 normal)
+{
+    if (shadowLight.w <= 0.0)
+        return 1.0;
+    vec3 fromLight = vec3(shadowInverseView * vec4(fragPos, 1.0)) - shadowLight.xyz;
+    // off the surface by about a texel at its distance, against acne
+    fromLight += mat3(shadowInverseView) * normal * (shadowBias.y * length(fromLight));
+    float reference = length(fromLight) * (1.0 - shadowBias.x) / shadowLight.w;
+    // one level, explicit gradients so the lookup may sit in the light loop's divergent branch
+    if (shadowBias.z > 0.0)
+    {
+        vec2 moments = textureGrad(sunShadowMoments, fromLight, vec3(0.0), vec3(0.0)).rg;
+        return momentShadow(moments, reference, (shadowBias.x * reference) * (shadowBias.x * reference), shadowBias.w);
+    }
+    return textureGrad(sunShadowMap, vec4(fromLight, reference), vec3(0.0), vec3(0.0));
+}
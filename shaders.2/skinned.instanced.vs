@@ -0,0 +1,43 @@
+#version 460 core
+// Skinned instances of one model (include/skinned_crowd.h): every vertex blends up to four bones of its instance's
+// palette, boneCount matrices from gl_InstanceID * boneCount on, then goes through the instance's model matrix.
+// the inputs of VERTEX_LAYOUT_FULL, aPos, aNormal, aTexCoords, aBoneIds and aWeights among them (vertex_layout.h)
+VERTEX_INPUTS
+layout(std140, binding = 0) uniform Matrices {
+    mat4 projection;
+    mat4 view;
+};
+layout(std430, binding = 16) readonly buffer BonePalettes {
+    mat4 palettes[];
+};
+layout(std430, binding = 17) readonly buffer InstanceMatrices {
+    mat4 instanceModels[];
+};
+
+uniform int boneCount;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+
+void main()
+{
+    mat4 skin = mat4(0.0);
+    float weight = 0.0;
+    int first = gl_InstanceID * boneCount;
+    for (int i = 0; i < 4; i++) {
+        if (aBoneIds[i] < 0 || aBoneIds[i] >= boneCount)
+            continue;
+        skin += palettes[first + aBoneIds[i]] * aWeights[i];
+        weight += aWeights[i];
+    }
+    // a vertex no bone holds stays in the bind pose
+    if (weight <= 0.0)
+        skin = mat4(1.0);
+    mat4 model = instanceModels[gl_InstanceID] * skin;
+    vec4 viewPos = view * model * vec4(aPos, 1.0);
+    gl_Position = projection * viewPos;
+    FragPos = viewPos.xyz;
+    Normal = mat3(view) * transpose(inverse(mat3(model))) * aNormal;
+    TexCoords = aTexCoords;
+}
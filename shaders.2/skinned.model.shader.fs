@@ -0,0 +1,18 @@
+#version 460 core
+// the demos' shading (src/crowd.cpp, src/meshlets.cpp): the diffuse texture under one directional light, in view space
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+
+out vec4 FragColor;
+
+uniform sampler2D texture_diffuse1;
+uniform vec3 lightDirection;    // towards the light, view space
+uniform float ambient;
+
+void main()
+{
+    vec3 albedo = texture(texture_diffuse1, TexCoords).rgb;
+    float diffuse = max(dot(normalize(Normal), normalize(lightDirection)), 0.0);
+    FragColor = vec4(albedo * (ambient + (1.0 - ambient) * diffuse), 1.0);
+}
@@ -0,0 +1,63 @@
+#version 460 core
+// Pre-skinning (include/skinned_crowd.h): skins one mesh's bind-pose vertices for the instances posed this frame
+// into the crowd's vertex stream, in model space, so every pass drawing the crowd reads them as they are. x is the
+// vertex, y the posed instance, whose palette is the y-th and whose place in the stream posed[y] says.
+layout(local_size_x = 64) in;
+
+// the mesh's vertex buffer in VERTEX_LAYOUT_FULL, Vertex of include/vertex_layout.h as 22 words: position 0,
+// normal 3, uv 6, tangent 8, bitangent 11, bone ids 14, weights 18
+const uint VERTEX_WORDS = 22u;
+
+struct SkinnedVertex {
+    vec4 position;
+    vec4 normal;
+};
+
+layout(std430, binding = 16) readonly buffer BonePalettes {
+    mat4 palettes[];
+};
+layout(std430, binding = 18) writeonly buffer SkinnedVertices {
+    SkinnedVertex skinned[];
+};
+layout(std430, binding = 19) readonly buffer SourceVertices {
+    float source[];
+};
+layout(std430, binding = 20) readonly buffer PosedInstances {
+    uint posed[];
+};
+
+uniform int boneCount;
+uniform int firstVertex;    // of the mesh in its vertex buffer
+uniform int vertexCount;
+uniform int streamBase;     // of the mesh's instances in the stream
+uniform int firstPosed;     // of this dispatch's rows
+
+void main()
+{
+    uint v = gl_GlobalInvocationID.x;
+    if (v >= uint(vertexCount))
+        return;
+    uint row = uint(firstPosed) + gl_WorkGroupID.y;
+    uint base = (uint(firstVertex) + v) * VERTEX_WORDS;
+    vec3 position = vec3(source[base], source[base + 1u], source[base + 2u]);
+    vec3 normal = vec3(source[base + 3u], source[base + 4u], source[base + 5u]);
+
+    mat4 skin = mat4(0.0);
+    float weight = 0.0;
+    uint first = row * uint(boneCount);
+    for (uint i = 0u; i < 4u; i++) {
+        int bone = floatBitsToInt(source[base + 14u + i]);
+        float w = source[base + 18u + i];
+        if (bone < 0 || bone >= boneCount)
+            continue;
+        skin += palettes[first + uint(bone)] * w;
+        weight += w;
+    }
+    // a vertex no bone holds stays in the bind pose
+    if (weight <= 0.0)
+        skin = mat4(1.0);
+
+    uint target = uint(streamBase) + posed[row] * uint(vertexCount) + v;
+    skinned[target].position = vec4(vec3(skin * vec4(position, 1.0)), 1.0);
+    skinned[target].normal = vec4(normalize(mat3(skin) * normal), 0.0);
+}
@@ -0,0 +1,41 @@
+#version 460 core
+// SMAA's last pass: each pixel mixed with the neighbours across its edges by the weights smaa.weights.fs left,
+// its own for the edges below and to the left and its neighbours' for those above and to the right
+out vec4 FragColor;
+
+uniform sampler2D scene;
+uniform sampler2D weights;
+
+vec4 weightsAt(ivec2 pixel)
+{
+    ivec2 size = textureSize(weights, 0);
+    if (any(greaterThanEqual(pixel, size)))
+        return vec4(0.0);
+    return texelFetch(weights, pixel, 0);
+}
+
+vec3 colorAt(ivec2 pixel)
+{
+    return texelFetch(scene, clamp(pixel, ivec2(0), textureSize(scene, 0) - 1), 0).rgb;
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 own = weightsAt(pixel);
+    // below, left, above, right
+    vec4 w = vec4(own.r, own.b, weightsAt(pixel + ivec2(0, 1)).g, weightsAt(pixel + ivec2(1, 0)).a);
+    float total = w.x + w.y + w.z + w.w;
+    vec3 color = colorAt(pixel);
+    if (total > 0.0)
+    {
+        if (total > 1.0)
+        {
+            w /= total;
+            total = 1.0;
+        }
+        color = color * (1.0 - total) + w.x * colorAt(pixel + ivec2(0, -1)) + w.y * colorAt(pixel + ivec2(-1, 0))
+              + w.z * colorAt(pixel + ivec2(0, 1)) + w.w * colorAt(pixel + ivec2(1, 0));
+    }
+    FragColor = vec4(color, 1.0);
+}
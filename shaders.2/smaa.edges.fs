@@ -0,0 +1,34 @@
+#version 460 core
+// SMAA's first pass, luma edges: x marks an edge between the pixel and its left neighbour, y one between it and
+// the pixel below. An edge much weaker than another next to it is dropped, SMAA's local contrast adaptation, so
+// the blending follows the dominant silhouette
+out vec2 Edges;
+
+uniform sampler2D scene;
+
+const float THRESHOLD = 0.1;
+const float LOCAL_CONTRAST_FACTOR = 2.0;
+
+float lumaAt(ivec2 pixel)
+{
+    pixel = clamp(pixel, ivec2(0), textureSize(scene, 0) - 1);
+    return dot(texelFetch(scene, pixel, 0).rgb, vec3(0.299, 0.587, 0.114));
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float lumaM = lumaAt(pixel);
+    float lumaLeft = lumaAt(pixel + ivec2(-1, 0));
+    float lumaBelow = lumaAt(pixel + ivec2(0, -1));
+    vec2 delta = abs(lumaM - vec2(lumaLeft, lumaBelow));
+    vec2 edges = step(THRESHOLD, delta);
+    if (edges.x + edges.y == 0.0)
+        discard;
+
+    vec2 maxDelta = max(delta, abs(lumaM - vec2(lumaAt(pixel + ivec2(1, 0)), lumaAt(pixel + ivec2(0, 1)))));
+    maxDelta = max(maxDelta, abs(vec2(lumaLeft, lumaBelow) - vec2(lumaAt(pixel + ivec2(-2, 0)), lumaAt(pixel + ivec2(0, -2)))));
+    float finalDelta = max(maxDelta.x, maxDelta.y);
+    edges *= step(finalDelta, LOCAL_CONTRAST_FACTOR * delta);
+    Edges = edges;
+}
@@ -0,0 +1,87 @@
+#version 460 core
+// SMAA's second pass, the blending weights. Each edge is followed both ways to its ends (up to MAX_SEARCH pixels)
+// and the crossing edges there tell whether the silhouette turns toward this pixel's side of the line or the
+// other's. The silhouette is reconstructed as MLAA does, a line from half a pixel's height at a turning end to
+// the middle of the run, and the area it covers out of each pixel computed directly in place of SMAA's
+// precomputed area texture. No diagonal or corner patterns.
+//   r: how much of the pixel below this one takes     g: how much of this one the pixel below takes
+//   b: how much of the left neighbour this one takes    a: how much of this one the left neighbour takes
+out vec4 Weights;
+
+uniform sampler2D edges;
+
+const int MAX_SEARCH = 16;
+
+vec2 edgeAt(ivec2 pixel)
+{
+    ivec2 size = textureSize(edges, 0);
+    if (any(lessThan(pixel, ivec2(0))) || any(greaterThanEqual(pixel, size)))
+        return vec2(0.0);
+    return texelFetch(edges, pixel, 0).rg;
+}
+
+// +1 when the silhouette turns toward this pixel's side of the line at an end, -1 toward the other's, 0 for none
+float crossing(float thisSide, float otherSide)
+{
+    return thisSide > 0.5 && otherSide <= 0.5 ? 1.0 : (otherSide > 0.5 && thisSide <= 0.5 ? -1.0 : 0.0);
+}
+
+// the silhouette's height over the line at t pixels along a run, signed toward this side
+float heightAt(float t, float runLength, float end1, float end2)
+{
+    if (end1 != 0.0 && end2 != 0.0)
+    {
+        float middle = 0.5 * runLength;
+        return t < middle ? end1 * 0.5 * (1.0 - t / middle) : end2 * 0.5 * (t - middle) / middle;
+    }
+    if (end1 != 0.0)
+        return end1 * 0.5 * (1.0 - t / runLength);
+    return end2 * 0.5 * t / runLength;
+}
+
+// the area between the line and the silhouette over the pixel `before` pixels into the run: x on this side, y on
+// the other. A run turning at both ends reaches zero height in its middle, a pixel over it is taken in two pieces
+// so each keeps one sign.
+vec2 area(int before, int after, float end1, float end2)
+{
+    float runLength = float(before + after + 1);
+    float from = float(before), to = from + 1.0, middle = 0.5 * runLength;
+    float split = end1 != 0.0 && end2 != 0.0 && from < middle && middle < to ? middle : to;
+    float first = 0.5 * (split - from) * (heightAt(from, runLength, end1, end2) + heightAt(split, runLength, end1, end2));
+    float second = 0.5 * (to - split) * (heightAt(split, runLength, end1, end2) + heightAt(to, runLength, end1, end2));
+    return vec2(max(first, 0.0) + max(second, 0.0), max(-first, 0.0) + max(-second, 0.0));
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec2 e = edgeAt(pixel);
+    vec4 weights = vec4(0.0);
+    // a horizontal line along the pixel's bottom, this side above, ends marked by vertical edges
+    if (e.y > 0.5)
+    {
+        int left = 0, right = 0;
+        while (left < MAX_SEARCH && edgeAt(pixel + ivec2(-left - 1, 0)).y > 0.5)
+            left++;
+        while (right < MAX_SEARCH && edgeAt(pixel + ivec2(right + 1, 0)).y > 0.5)
+            right++;
+        float end1 = crossing(edgeAt(pixel + ivec2(-left, 0)).x, edgeAt(pixel + ivec2(-left, -1)).x);
+        float end2 = crossing(edgeAt(pixel + ivec2(right + 1, 0)).x, edgeAt(pixel + ivec2(right + 1, -1)).x);
+        if (end1 != 0.0 || end2 != 0.0)
+            weights.rg = area(left, right, end1, end2);
+    }
+    // a vertical line along the pixel's left, this side to the right, ends marked by horizontal edges
+    if (e.x > 0.5)
+    {
+        int down = 0, up = 0;
+        while (down < MAX_SEARCH && edgeAt(pixel + ivec2(0, -down - 1)).x > 0.5)
+            down++;
+        while (up < MAX_SEARCH && edgeAt(pixel + ivec2(0, up + 1)).x > 0.5)
+            up++;
+        float end1 = crossing(edgeAt(pixel + ivec2(0, -down)).y, edgeAt(pixel + ivec2(-1, -down)).y);
+        float end2 = crossing(edgeAt(pixel + ivec2(0, up + 1)).y, edgeAt(pixel + ivec2(-1, up + 1)).y);
+        if (end1 != 0.0 || end2 != 0.0)
+            weights.ba = area(down, up, end1, end2);
+    }
+    Weights = weights;
+}
@@ -0,0 +1,36 @@
+#version 460 core
+// the gas's pull on the massive bodies (include/gpu_sph.h), a workgroup per body summing over every particle
+layout(local_size_x = 256) in;
+
+#include "sph.glsl"
+
+layout(std430, binding = 66) buffer SourceVelocity {
+    vec4 sourceVelocity[];  // xyz velocity, w 1.0 for dynamic bodies and 0.0 for static ones
+};
+
+shared vec3 partial[256];
+
+void main()
+{
+    uint s = gl_WorkGroupID.x;
+    uint l = gl_LocalInvocationID.x;
+    vec3 at = sources[s].xyz;
+    vec3 acc = vec3(0.0);
+    for (uint i = l; i < gasCount; i += 256u)
+    {
+        vec4 gas = gasPosMass[i];
+        vec3 r = gas.xyz - at;
+        float invR = inversesqrt(max(dot(r, r), epsilonSq));
+        acc += gas.w * invR * invR * invR * r;
+    }
+    partial[l] = acc;
+    barrier();
+    for (uint stride = 128u; stride > 0u; stride >>= 1)
+    {
+        if (l < stride)
+            partial[l] += partial[l + stride];
+        barrier();
+    }
+    if (l == 0u)
+        sourceVelocity[s].xyz += G * partial[0] * dt * sourceVelocity[s].w;
+}
@@ -0,0 +1,48 @@
+#version 460 core
+// the gas density by summation over the neighbours, and from it the isothermal pressure (include/gpu_sph.h); one
+// invocation per particle in grid order, so a workgroup walks a compact region of the sorted list
+layout(local_size_x = 256) in;
+
+#include "sph.glsl"
+
+uniform float aspectRatio;      // sound speed over the Keplerian speed
+uniform float referenceDensity; // the spawn's mean, a luminosity of 1
+
+void main()
+{
+    uint k = gl_GlobalInvocationID.x;
+    if (k >= gasCount)
+        return;
+    vec4 self = sortedGas[k].posMass;
+    if (self.w == 0.0)
+    {
+        gasState[k] = vec4(0.0);
+        gasLuminosity[cellOrder[k]] = 0.0;
+        return;
+    }
+    ivec3 cell = cellOf(self.xyz);
+    float support = 4.0 * smoothingLength * smoothingLength;
+    float density = 0.0;
+    for (int z = -1; z <= 1; z++)
+        for (int y = -1; y <= 1; y++)
+            for (int x = -1; x <= 1; x++)
+            {
+                ivec3 neighbour = cell + ivec3(x, y, z);
+                uvec2 range = cellRanges[cellHash(neighbour)];
+                for (uint j = range.x; j < range.y; j++)
+                {
+                    vec4 other = sortedGas[j].posMass;
+                    // another cell hashed into the same entry is not this one
+                    if (cellOf(other.xyz) != neighbour)
+                        continue;
+                    vec3 d = self.xyz - other.xyz;
+                    float r2 = dot(d, d);
+                    if (r2 < support)
+                        density += other.w * kernel(sqrt(r2));
+                }
+            }
+    float radius = max(length(self.xyz - sources[0].xyz), 1e-3);
+    float sound = aspectRatio * sqrt(G * sources[0].w / radius);
+    gasState[k] = vec4(density, sound * sound / density, sound, 0.0);
+    gasLuminosity[cellOrder[k]] = density / referenceDensity;
+}
@@ -0,0 +1,84 @@
+#version 460 core
+// the gas's kick and drift (include/gpu_sph.h), one stage per dispatch. Stage 0, in grid order: pressure and
+// artificial viscosity over the neighbours in the symmetric form, so a pair's forces cancel, and the pull of the
+// massive bodies. Stage 1, by particle: the drift, and the accretion of what came too close to the sun.
+layout(local_size_x = 256) in;
+
+#include "sph.glsl"
+
+uniform int stage;
+uniform float alpha;
+uniform float beta;
+uniform float accretionRadius;
+
+void drift(uint i)
+{
+    vec4 v = gasVelocity[i];
+    if (v.w == 0.0)
+        return;
+    vec3 position = gasPosMass[i].xyz + v.xyz * dt;
+    if (distance(position, sources[0].xyz) < accretionRadius)
+    {
+        gasPosMass[i] = vec4(position, 0.0);
+        gasVelocity[i] = vec4(0.0);
+        gasLuminosity[i] = 0.0;
+        return;
+    }
+    gasPosMass[i].xyz = position;
+}
+
+void main()
+{
+    uint k = gl_GlobalInvocationID.x;
+    if (k >= gasCount)
+        return;
+    if (stage == 1)
+    {
+        drift(k);
+        return;
+    }
+    vec4 self = sortedGas[k].posMass;
+    vec4 velocity = sortedGas[k].velocity;
+    vec4 own = gasState[k];
+    if (self.w == 0.0 || velocity.w == 0.0)
+        return;
+    ivec3 cell = cellOf(self.xyz);
+    float h = smoothingLength;
+    float support = 4.0 * h * h;
+    vec3 acc = vec3(0.0);
+    for (int z = -1; z <= 1; z++)
+        for (int y = -1; y <= 1; y++)
+            for (int x = -1; x <= 1; x++)
+            {
+                ivec3 neighbour = cell + ivec3(x, y, z);
+                uvec2 range = cellRanges[cellHash(neighbour)];
+                for (uint j = range.x; j < range.y; j++)
+                {
+                    vec4 other = sortedGas[j].posMass;
+                    vec4 theirs = gasState[j];
+                    if (theirs.x == 0.0 || cellOf(other.xyz) != neighbour)
+                        continue;
+                    vec3 d = self.xyz - other.xyz;
+                    float r2 = dot(d, d);
+                    if (r2 >= support || r2 == 0.0)
+                        continue;
+                    float r = sqrt(r2);
+                    // Monaghan's viscosity, on pairs closing in only
+                    float closing = dot(velocity.xyz - sortedGas[j].velocity.xyz, d);
+                    float viscosity = 0.0;
+                    if (closing < 0.0)
+                    {
+                        float mu = h * closing / (r2 + 0.01 * h * h);
+                        viscosity = (-alpha * 0.5 * (own.z + theirs.z) * mu + beta * mu * mu) / (0.5 * (own.x + theirs.x));
+                    }
+                    acc -= other.w * (own.y + theirs.y + viscosity) * kernelSlope(r) / r * d;
+                }
+            }
+    for (uint s = 0u; s < sourceCount; s++)
+    {
+        vec3 r = sources[s].xyz - self.xyz;
+        float invR = inversesqrt(max(dot(r, r), epsilonSq));
+        acc += G * sources[s].w * invR * invR * invR * r;
+    }
+    gasVelocity[cellOrder[k]].xyz += acc * dt;
+}
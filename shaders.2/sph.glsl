@@ -0,0 +1,73 @@
+// shared by the SPH passes (include/gpu_sph.h): the gas's buffers, the hashed grid and the M4 cubic spline kernel
+struct GasParticle {
+    vec4 posMass;       // xyz position, w mass, 0 once accreted
+    vec4 velocity;      // xyz velocity, w 1 while the particle moves
+};
+
+layout(std430, binding = 57) buffer GasPositionMass {
+    vec4 gasPosMass[];
+};
+layout(std430, binding = 58) buffer GasVelocity {
+    vec4 gasVelocity[];
+};
+layout(std430, binding = 59) buffer GasLuminosity {
+    float gasLuminosity[];
+};
+layout(std430, binding = 60) buffer GasKeys {
+    uint cellKeys[];        // the hash of each particle's cell, sorted in place
+};
+layout(std430, binding = 61) buffer GasOrder {
+    uint cellOrder[];       // the particle at each sorted position
+};
+layout(std430, binding = 62) buffer GasSorted {
+    GasParticle sortedGas[];
+};
+layout(std430, binding = 63) buffer GasState {
+    vec4 gasState[];        // density, pressure over density squared, sound speed, by sorted position
+};
+layout(std430, binding = 64) buffer GasCells {
+    uvec2 cellRanges[];     // [begin, end) of each table entry's particles in the sorted order, empty when equal
+};
+layout(std430, binding = 65) readonly buffer GasSources {
+    vec4 sources[];         // the massive bodies, xyz position and w mass, the sun first
+};
+
+uniform uint gasCount;
+uniform uint tableMask;
+uniform float smoothingLength;
+uniform uint sourceCount;
+uniform float G;
+uniform float epsilonSq;
+uniform float dt;
+
+const float INV_PI = 0.318309886;
+
+// cells are one kernel support on a side, so a particle's neighbours are all in the 27 around its own
+ivec3 cellOf(vec3 position)
+{
+    return ivec3(floor(position / (2.0 * smoothingLength)));
+}
+
+uint cellHash(ivec3 cell)
+{
+    return ((uint(cell.x) * 73856093u) ^ (uint(cell.y) * 19349663u) ^ (uint(cell.z) * 83492791u)) & tableMask;
+}
+
+float kernel(float r)
+{
+    float q = r / smoothingLength;
+    float h3 = smoothingLength * smoothingLength * smoothingLength;
+    float near = 1.0 - 1.5 * q * q + 0.75 * q * q * q;
+    float far = 0.25 * (2.0 - q) * (2.0 - q) * (2.0 - q);
+    return INV_PI / h3 * (q < 1.0 ? near : (q < 2.0 ? far : 0.0));
+}
+
+// dW/dr, negative inside the support
+float kernelSlope(float r)
+{
+    float q = r / smoothingLength;
+    float h4 = smoothingLength * smoothingLength * smoothingLength * smoothingLength;
+    float near = -3.0 * q + 2.25 * q * q;
+    float far = -0.75 * (2.0 - q) * (2.0 - q);
+    return INV_PI / h4 * (q < 1.0 ? near : (q < 2.0 ? far : 0.0));
+}
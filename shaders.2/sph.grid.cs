@@ -0,0 +1,30 @@
+#version 460 core
+// the hashed grid of the gas (include/gpu_sph.h), one stage per dispatch: each particle's cell hash with its
+// index as the order (stage 0), and after the radix sort the particles gathered into the sorted order with each
+// table entry's range of it (stage 1)
+layout(local_size_x = 256) in;
+
+#include "sph.glsl"
+
+uniform int stage;
+
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= gasCount)
+        return;
+    if (stage == 0)
+    {
+        cellKeys[i] = cellHash(cellOf(gasPosMass[i].xyz));
+        cellOrder[i] = i;
+        return;
+    }
+    uint particle = cellOrder[i];
+    sortedGas[i].posMass = gasPosMass[particle];
+    sortedGas[i].velocity = gasVelocity[particle];
+    uint key = cellKeys[i];
+    if (i == 0u || cellKeys[i - 1u] != key)
+        cellRanges[key].x = i;
+    if (i + 1u == gasCount || cellKeys[i + 1u] != key)
+        cellRanges[key].y = i + 1u;
+}
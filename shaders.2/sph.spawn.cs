@@ -0,0 +1,49 @@
+#version 460 core
+// places every gas particle of the disk from a hash of its index (include/gpu_sph.h), nothing is uploaded
+layout(local_size_x = 256) in;
+
+#include "sph.glsl"
+
+uniform uint seed;
+uniform float innerRadius;
+uniform float outerRadius;
+uniform float aspectRatio;
+uniform float particleMass;
+uniform float mu;               // G times the sun's mass
+uniform vec3 center;
+uniform vec3 centerVelocity;
+
+const float TWO_PI = 6.28318530718;
+
+// PCG hash, one well mixed 32-bit value per call
+uint pcg(inout uint state)
+{
+    state = state * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+float uniform01(inout uint state)
+{
+    return float(pcg(state) >> 8) * (1.0 / 16777216.0);
+}
+
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= gasCount)
+        return;
+    uint state = i * 0x9e3779b9u ^ seed;
+    // a surface density of 1/r puts as many particles in every ring of the same width
+    float radius = mix(innerRadius, outerRadius, uniform01(state));
+    float angle = TWO_PI * uniform01(state);
+    // Box-Muller, the vertical profile of an isothermal disk
+    float u = max(uniform01(state), 1e-7);
+    float y = aspectRatio * radius * sqrt(-2.0 * log(u)) * cos(TWO_PI * uniform01(state));
+    float keplerian = sqrt(mu / radius);
+    // the pressure gradient of this profile carries a part of the weight, to first order in the aspect ratio
+    float speed = keplerian * sqrt(max(1.0 - 3.0 * aspectRatio * aspectRatio, 0.0));
+    gasPosMass[i] = vec4(center + vec3(radius * cos(angle), y, radius * sin(angle)), particleMass);
+    gasVelocity[i] = vec4(centerVelocity + speed * vec3(-sin(angle), 0.0, cos(angle)), 1.0);
+    gasLuminosity[i] = 1.0;
+}
@@ -0,0 +1,88 @@
+#version 460 core
+// a sphere impostor: the view ray through the fragment intersected with the sphere, its depth written so the
+// sphere meets the rest of the scene where a mesh would. Emissive spheres are their colour; lit ones take the
+// first point light's diffuse and ambient terms like impostor.point.fs, over the texture wrapped by longitude
+// and latitude about the body's Y axis.
+#include "lights.glsl"
+#include "depth.glsl"
+
+// the surface is never nearer than the front face of the quad the sphere is drawn on
+#ifdef REVERSE_Z
+layout(depth_less) out float gl_FragDepth;
+#else
+layout(depth_greater) out float gl_FragDepth;
+#endif
+
+layout(std140, binding = 0) uniform Matrices {
+    mat4 projection;
+    mat4 view;
+};
+
+struct SphereImpostor {
+    vec4 centerRadius;
+    vec4 orientation;
+    vec4 color;
+    uvec4 pick;     // x the id for include/gpu_picker.h
+};
+
+layout(std430, binding = 15) readonly buffer SphereImpostors {
+    SphereImpostor impostors[];
+};
+
+in vec3 RayTarget;
+flat in vec3 Center;
+flat in float Radius;
+flat in int Instance;
+
+layout(location = 0) out vec4 FragColor;
+layout(location = 1) out uint PickId;
+
+uniform sampler2D surfaceTexture;
+uniform bool textured;
+
+const float PI = 3.14159265358979;
+
+vec3 rotate(vec4 q, vec3 v)
+{
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main()
+{
+    vec3 direction = normalize(RayTarget);
+    float b = dot(direction, Center);
+    float h = b * b - (dot(Center, Center) - Radius * Radius);
+    if (h < 0.0)
+        discard;
+    vec3 surface = direction * (b - sqrt(h));
+    vec3 normal = (surface - Center) / Radius;
+    vec4 clip = projection * vec4(surface, 1.0);
+    gl_FragDepth = windowDepth(clip);
+
+    SphereImpostor impostor = impostors[Instance];
+    PickId = impostor.pick.x;
+    if (impostor.color.a > 0.5)
+    {
+        FragColor = vec4(impostor.color.rgb, 1.0);
+        return;
+    }
+
+    vec3 albedo = impostor.color.rgb;
+    if (textured)
+    {
+        // into the body's frame, then longitude, with the seam's derivatives taken from whichever of two
+        // wrappings is continuous here so the mip level does not jump along it
+        vec3 local = rotate(vec4(-impostor.orientation.xyz, impostor.orientation.w), transpose(mat3(view)) * normal);
+        float longitude = atan(local.x, local.z) / (2.0 * PI);
+        float u1 = fract(longitude), u2 = fract(longitude + 0.5) - 0.5;
+        float u = fwidth(u1) <= fwidth(u2) + 1e-5 ? u1 : u2;
+        albedo *= texture(surfaceTexture, vec2(u, acos(clamp(local.y, -1.0, 1.0)) / PI)).rgb;
+    }
+    PointLight sun = pointLights[0];
+    vec3 toLight = vec3(view * sun.position) - surface;
+    float distance = length(toLight);
+    float attenuation = 1.0 / (sun.constant + sun.linear * distance + sun.quadratic * (distance * distance));
+    float diff = max(dot(normal, toLight / distance), 0.0) * pointLightShadow(0u, surface, normal);
+    vec3 result = (sun.ambient + sun.diffuse * diff) * albedo * attenuation + dirLight.ambient * albedo;
+    FragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,52 @@
+#version 460 core
+// one sphere impostor's quad, four vertices of a strip per instance and no vertex buffers. The quad is
+// perpendicular to the ray to the centre at the sphere's nearest distance and exactly covers the cone of rays
+// that touch it, so every fragment the sphere needs is drawn and every hit lies behind the quad (the fragment
+// shader's depth_greater). A camera inside a sphere gets nothing.
+layout(std140, binding = 0) uniform Matrices {
+    mat4 projection;
+    mat4 view;
+};
+
+struct SphereImpostor {
+    vec4 centerRadius;
+    vec4 orientation;
+    vec4 color;
+    uvec4 pick;     // x the id for include/gpu_picker.h
+};
+
+layout(std430, binding = 15) readonly buffer SphereImpostors {
+    SphereImpostor impostors[];
+};
+
+out vec3 RayTarget;         // view space, on the quad
+flat out vec3 Center;       // view space
+flat out float Radius;
+flat out int Instance;
+
+void main()
+{
+    // a draw of a range of the instances starts at its base instance
+    int instance = gl_BaseInstance + gl_InstanceID;
+    SphereImpostor impostor = impostors[instance];
+    vec3 center = vec3(view * vec4(impostor.centerRadius.xyz, 1.0));
+    float radius = impostor.centerRadius.w;
+    float distance = length(center);
+    Center = center;
+    Radius = radius;
+    Instance = instance;
+    if (distance <= radius * 1.0001)
+    {
+        RayTarget = vec3(0.0);
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        return;
+    }
+    vec3 axis = center / distance;
+    vec3 right = normalize(cross(axis, abs(axis.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0)));
+    vec3 up = cross(right, axis);
+    float planeDistance = distance - radius;
+    float halfSize = planeDistance * radius / sqrt(distance * distance - radius * radius);
+    vec2 corner = vec2((gl_VertexID & 1) != 0 ? 1.0 : -1.0, (gl_VertexID & 2) != 0 ? 1.0 : -1.0);
+    RayTarget = axis * planeDistance + (right * corner.x + up * corner.y) * halfSize;
+    gl_Position = projection * vec4(RayTarget, 1.0);
+}
@@ -0,0 +1,10 @@
+#version 460 core
+// a corner of one of the base icosphere's patches (include/tessellated_sphere.h), a unit direction
+layout(location = 0) in vec3 aPos;
+
+out vec3 ControlDirection;
+
+void main()
+{
+    ControlDirection = normalize(aPos);
+}
@@ -0,0 +1,60 @@
+#version 460 core
+// one draw command per chunk of the star catalog (include/star_field.h): none if the chunk's cone misses the view,
+// otherwise its stars down to the limiting magnitude, a prefix since a chunk is sorted brightest first
+layout(local_size_x = 64) in;
+
+struct StarChunk {
+    vec4 axisCos;       // the mean direction, the cosine of the angle every star is within
+    uint first;
+    uint count;
+    float brightest;
+    float faintest;
+};
+struct Star {
+    vec3 position;
+    uint magnitudeColor;    // the magnitude in thousandths in the low 16 bits, signed, the colour index above
+};
+struct DrawArraysIndirectCommand {
+    uint count;
+    uint instanceCount;
+    uint first;
+    uint baseInstance;
+};
+
+layout(std430, binding = 30) readonly buffer StarChunks {
+    StarChunk chunks[];
+};
+layout(std430, binding = 31) readonly buffer Stars {
+    Star stars[];
+};
+layout(std430, binding = 32) writeonly buffer StarDraws {
+    DrawArraysIndirectCommand draws[];
+};
+
+uniform uint chunkCount;
+uniform vec3 forward;
+uniform float viewRadius;   // the half angle of the view to its corners
+uniform int limit;          // thousandths
+
+void main()
+{
+    uint c = gl_GlobalInvocationID.x;
+    if (c >= chunkCount)
+        return;
+    StarChunk chunk = chunks[c];
+    uint count = 0u;
+    float away = acos(clamp(dot(chunk.axisCos.xyz, forward), -1.0, 1.0));
+    if (away <= viewRadius + acos(clamp(chunk.axisCos.w, -1.0, 1.0)) && int(round(chunk.brightest * 1000.0)) <= limit) {
+        // the first star fainter than the limit
+        uint lo = 0u, hi = chunk.count;
+        while (lo < hi) {
+            uint mid = (lo + hi) / 2u;
+            if (bitfieldExtract(int(stars[chunk.first + mid].magnitudeColor), 0, 16) <= limit)
+                lo = mid + 1u;
+            else
+                hi = mid;
+        }
+        count = lo;
+    }
+    draws[c] = DrawArraysIndirectCommand(count, 1u, chunk.first, 0u);
+}
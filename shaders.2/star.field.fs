@@ -0,0 +1,11 @@
+#version 460 core
+// a catalog star added onto the sky with a Gaussian falloff over its point sprite
+layout(location = 0) out vec4 FragColor;
+
+in vec3 Emission;
+
+void main()
+{
+    vec2 d = gl_PointCoord * 2.0 - 1.0;
+    FragColor = vec4(Emission * exp(-3.0 * dot(d, d)), 1.0);
+}
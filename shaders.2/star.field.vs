@@ -0,0 +1,45 @@
+#version 460 core
+// one catalog star per vertex, at infinity: only the view's rotation applies and the depth is the far plane's, as
+// the skybox's. The total brightness follows the magnitude, the sprite grows with its fourth root and the stars
+// near the limit fade in, so a change of the limit does not pop.
+#include "depth.glsl"
+
+layout(std140, binding = 0) uniform Matrices {
+    mat4 projection;
+    mat4 view;
+};
+
+struct Star {
+    vec3 position;
+    uint magnitudeColor;
+};
+layout(std430, binding = 31) readonly buffer Stars {
+    Star stars[];
+};
+
+uniform float limit;        // the magnitude culled at
+uniform float pointSize;    // pixels of a star at the limit
+uniform float brightness;   // a star at the limit, summed over its sprite
+
+out vec3 Emission;
+
+// the colour of a B-V index, blue-white through the sun's to red
+vec3 starColor(float bv)
+{
+    vec3 hot = vec3(0.62, 0.72, 1.0), sun = vec3(1.0, 0.96, 0.9), cool = vec3(1.0, 0.58, 0.32);
+    return bv < 0.65 ? mix(hot, sun, smoothstep(-0.4, 0.65, bv)) : mix(sun, cool, smoothstep(0.65, 2.0, bv));
+}
+
+void main()
+{
+    Star star = stars[gl_VertexID];
+    float magnitude = float(bitfieldExtract(int(star.magnitudeColor), 0, 16)) * 0.001;
+    float bv = float(bitfieldExtract(int(star.magnitudeColor), 16, 16)) * 0.001;
+    vec4 position = projection * mat4(mat3(view)) * vec4(normalize(star.position), 1.0);
+    gl_Position = atFarPlane(position);
+    float flux = pow(10.0, -0.4 * (magnitude - limit));
+    float size = clamp(pointSize * pow(flux, 0.25), 1.0, 16.0);
+    gl_PointSize = size;
+    float fade = smoothstep(limit, limit - 0.5, magnitude);
+    Emission = starColor(bv) * (brightness * flux * fade / (size * size));
+}
@@ -0,0 +1,33 @@
+// the Matrices block with both eyes' matrices (include/camera_uniforms.h), and instanced stereo: with stereo set
+// the draw has twice the instances, even ones for the left eye and odd ones for the right, and a vertex lands in
+// its eye's half of the side-by-side target, squeezed there in clip space and cut at the middle by gl_ClipDistance[0]
+// (include/stereo_camera.h). Lighting stays in the centre view, projection and view.
+layout(std140, binding = 0) uniform Matrices {
+    mat4 projection;
+    mat4 view;
+    mat4 eyeProjection[2];
+    mat4 eyeView[2];
+};
+
+uniform bool stereo;
+
+// the instance this vertex belongs to, the same for both of its eyes
+uint stereoInstance()
+{
+    return stereo ? uint(gl_InstanceID) >> 1 : uint(gl_InstanceID);
+}
+
+// the clip position of a camera-relative point, in its eye's half with stereo set
+vec4 stereoPosition(vec3 position)
+{
+    if (!stereo)
+        return projection * view * vec4(position, 1.0);
+    uint eye = uint(gl_InstanceID) & 1u;
+    vec4 clip = eyeProjection[eye] * eyeView[eye] * vec4(position, 1.0);
+#ifndef SHADOW_PASS
+    // the shadow pass's geometry shader has no clip distances to take
+    gl_ClipDistance[0] = eye == 0u ? clip.w - clip.x : clip.w + clip.x;
+#endif
+    clip.x = 0.5 * clip.x + (eye == 0u ? -0.5 : 0.5) * clip.w;
+    return clip;
+}
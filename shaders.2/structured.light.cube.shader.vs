@@ -5,7 +5,14 @@ layout(std140, binding = 0) uniform Matrices {
     mat4 view;
 };
 
+#ifdef OBJECT_BLOCK
+#include "object_block.glsl"
+#else
 uniform mat4 model;
+#endif
+
+// the depth pre-pass draws with the light cube shader, the lit draws must meet its depth exactly
+invariant gl_Position;
 
 void main()
 {
@@ -10,14 +10,36 @@ layout(std140, binding = 0) uniform Matrices {
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
+flat out uint Pick;
+#ifdef OBJECT_INSTANCES
+flat out float InstanceReflectivity;
+flat out float InstanceReflectionLod;
+#endif
 
+#ifdef OBJECT_BLOCK
+#include "object_block.glsl"
+#else
 uniform mat4 model;
 uniform mat3 normalMatrix;
+uniform uint pickId;        // include/gpu_picker.h
+#endif
+
+// the depth pre-pass draws with the light cube shader, the lit draws must meet its depth exactly
+invariant gl_Position;
 
 void main()
 {
+#ifdef OBJECT_INSTANCES
+    const ObjectData object = objects[gl_BaseInstance + gl_InstanceID];
+    const mat4 model = object.model;
+    const mat3 normalMatrix = object.normalMatrix;
+    const uint pickId = object.pickId;
+    InstanceReflectivity = object.reflectivity;
+    InstanceReflectionLod = object.reflectionLod;
+#endif
     gl_Position = projection * view * model * vec4(aPos, 1.0);
     FragPos = vec3(view * model * vec4(aPos, 1.0));
     Normal = normalMatrix * aNormal;
     TexCoords = aTexCoords;
+    Pick = pickId;
 }
\ No newline at end of file
@@ -1,4 +1,6 @@
 #version 460 core
+#include "depth.glsl"
+
 layout (location = 0) in vec3 aPos;
 layout(std140, binding = 0) uniform Matrices {
     mat4 projection;
@@ -11,5 +13,5 @@ void main()
 {
     TexCoords = aPos;
     vec4 pos = projection * mat4(mat3(view)) * vec4(aPos, 1.0);
-    gl_Position = pos.xyww;
+    gl_Position = atFarPlane(pos);
 }
\ No newline at end of file
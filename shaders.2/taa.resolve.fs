@@ -0,0 +1,85 @@
+#version 460 core
+// Temporal anti-aliasing: the jittered frame blended into the history of earlier ones. The pixel's position is
+// rebuilt from depth and projected with last frame's camera, which moves the history with the camera; anything
+// that moved on its own is held back by clipping the history to the current 3x3 neighbourhood's colour box in
+// YCoCg. Pixels whose history fell off screen start over from the current frame.
+#include "depth.glsl"
+
+in vec2 TexCoords;
+
+out vec4 FragColor;
+
+uniform sampler2D scene;
+uniform sampler2D sceneDepth;
+uniform sampler2D history;
+uniform mat4 inverseViewProjection;     // this frame's, camera-relative and jittered
+uniform mat4 previousViewProjection;    // last frame's, camera-relative and not jittered
+uniform vec3 cameraDelta;               // this frame's camera position less last frame's
+uniform bool historyValid;
+uniform float blend;                    // the current frame's share
+
+vec3 toYCoCg(vec3 c)
+{
+    return vec3(dot(c, vec3(0.25, 0.5, 0.25)), dot(c, vec3(0.5, 0.0, -0.5)), dot(c, vec3(-0.25, 0.5, -0.25)));
+}
+
+vec3 fromYCoCg(vec3 c)
+{
+    return vec3(c.x + c.y - c.z, c.x + c.z, c.x - c.y - c.z);
+}
+
+vec3 colorAt(ivec2 pixel)
+{
+    return texelFetch(scene, clamp(pixel, ivec2(0), textureSize(scene, 0) - 1), 0).rgb;
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec3 current = colorAt(pixel);
+    if (!historyValid)
+    {
+        FragColor = vec4(current, 1.0);
+        return;
+    }
+
+    // where this pixel was last frame; the sky is at infinity and only turns with the camera
+    float depth = texelFetch(sceneDepth, pixel, 0).r;
+    vec4 ndc = vec4(ndcFromWindow(TexCoords, depth), 1.0);
+    vec4 previousClip;
+    if (isFarDepth(depth))
+    {
+        // a point on the pixel's ray; reversed, infinity itself does not unproject
+        vec4 far = inverseViewProjection * vec4(ndc.xy, NDC_BEYOND, 1.0);
+        previousClip = previousViewProjection * vec4(far.xyz / far.w, 0.0);
+    }
+    else
+    {
+        vec4 position = inverseViewProjection * ndc;
+        previousClip = previousViewProjection * vec4(position.xyz / position.w + cameraDelta, 1.0);
+    }
+    vec2 previousUv = previousClip.xy / previousClip.w * 0.5 + 0.5;
+    if (previousClip.w <= 0.0 || any(lessThan(previousUv, vec2(0.0))) || any(greaterThan(previousUv, vec2(1.0))))
+    {
+        FragColor = vec4(current, 1.0);
+        return;
+    }
+
+    vec3 low = toYCoCg(current), high = low;
+    for (int y = -1; y <= 1; y++)
+        for (int x = -1; x <= 1; x++)
+        {
+            vec3 c = toYCoCg(colorAt(pixel + ivec2(x, y)));
+            low = min(low, c);
+            high = max(high, c);
+        }
+    // clipped toward the box's centre rather than clamped per channel, which keeps the history's hue
+    vec3 previous = toYCoCg(texture(history, previousUv).rgb);
+    vec3 center = 0.5 * (high + low), extent = max(0.5 * (high - low), vec3(1e-4));
+    vec3 offset = previous - center;
+    vec3 units = abs(offset / extent);
+    float outside = max(units.x, max(units.y, units.z));
+    if (outside > 1.0)
+        previous = center + offset / outside;
+    FragColor = vec4(mix(max(fromYCoCg(previous), vec3(0.0)), current, blend), 1.0);
+}
@@ -0,0 +1,15 @@
+#version 460 core
+// the surface colour by direction, and its luminance as a height from 0 to 1
+in vec2 TexCoords;
+
+layout(location = 0) out vec4 Albedo;
+layout(location = 1) out float Height;
+
+uniform sampler2D texture_diffuse1;
+
+void main()
+{
+    vec3 color = texture(texture_diffuse1, TexCoords).rgb;
+    Albedo = vec4(color, 1.0);
+    Height = dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
@@ -0,0 +1,14 @@
+#version 460 core
+// the planet model seen from its centre into one face of the terrain cubes (include/planet_terrain.h)
+layout(location = 0) in vec3 aPos;
+layout(location = 2) in vec2 aTexCoords;
+
+out vec2 TexCoords;
+
+uniform mat4 viewProjection;
+
+void main()
+{
+    TexCoords = aTexCoords;
+    gl_Position = viewProjection * vec4(aPos, 1.0);
+}
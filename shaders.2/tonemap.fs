@@ -0,0 +1,42 @@
+#version 460 core
+// the HDR scene and its bloom exposed, tone mapped with Narkowicz's fit of the ACES curve and encoded to sRGB,
+// the one place the frame leaves linear light. For point clouds of stars, whose sums span many orders of
+// magnitude, a logarithmic curve of luminance instead, keeping the hue and reaching white at logWhite.
+in vec2 TexCoords;
+
+out vec4 FragColor;
+
+uniform sampler2D scene;
+uniform sampler2D bloom;
+uniform bool bloomEnabled;
+uniform float bloomStrength;
+uniform float exposure;
+uniform bool logLuminance;
+uniform float logWhite;
+
+vec3 aces(vec3 x)
+{
+    return clamp((x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0);
+}
+
+vec3 logCurve(vec3 x)
+{
+    float l = dot(x, vec3(0.2126, 0.7152, 0.0722));
+    if (l <= 0.0)
+        return vec3(0.0);
+    return clamp(x * (log(1.0 + l) / (l * log(1.0 + logWhite))), 0.0, 1.0);
+}
+
+vec3 toSrgb(vec3 c)
+{
+    return mix(c * 12.92, 1.055 * pow(c, vec3(1.0 / 2.4)) - 0.055, step(vec3(0.0031308), c));
+}
+
+void main()
+{
+    vec3 color = texture(scene, TexCoords).rgb;
+    if (bloomEnabled)
+        color += bloomStrength * texture(bloom, TexCoords).rgb;
+    color *= exposure;
+    FragColor = vec4(toSrgb(logLuminance ? logCurve(color) : aces(color)), 1.0);
+}
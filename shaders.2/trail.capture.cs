@@ -0,0 +1,25 @@
+#version 460 core
+// one sample of every trail: each body's current position into its ring at the head slot, include/gpu_trails.h.
+// The positions are GpuNBody's layout, or the CPU's upload with w 0 for a body that is gone.
+layout(local_size_x = 256) in;
+
+layout(std430, binding = 27) readonly buffer TrailSource {
+    vec4 source[];
+};
+layout(std430, binding = 26) writeonly buffer Trails {
+    vec4 trail[];
+};
+
+uniform uint bodyCount;
+uniform uint trailLength;
+uniform uint head;
+uniform bool validInW;      // false for a GPU source, whose w is a mass
+
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= bodyCount)
+        return;
+    vec4 p = source[i];
+    trail[i * trailLength + head] = vec4(p.xyz, validInW ? p.w : 1.0);
+}
@@ -0,0 +1,12 @@
+#version 460 core
+// added onto the scene, the fade drops the older part of a trail to nothing
+layout(location = 0) out vec4 FragColor;
+
+in float Fade;
+
+uniform vec3 color;
+
+void main()
+{
+    FragColor = vec4(color * Fade * Fade, 1.0);
+}
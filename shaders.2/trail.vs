@@ -0,0 +1,36 @@
+#version 460 core
+// one trail per instance, a line strip from the newest sample back, without vertex buffers. A trail whose newest
+// sample is invalid (the body is gone) collapses to a point outside the clip volume.
+layout(std140, binding = 0) uniform Matrices {
+    mat4 projection;
+    mat4 view;
+};
+
+layout(std430, binding = 26) readonly buffer Trails {
+    vec4 trail[];
+};
+
+uniform uint trailLength;
+uniform uint head;
+uniform uint filled;        // samples written since the trails were cleared, at most trailLength
+uniform vec3 origin;        // the camera, the samples are world positions
+
+out float Fade;
+
+void main()
+{
+    uint body = uint(gl_InstanceID);
+    uint k = uint(gl_VertexID);
+    vec4 newest = trail[body * trailLength + head];
+    if (newest.w == 0.0) {
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        Fade = 0.0;
+        return;
+    }
+    // a sample from before the body existed falls back onto the newest, the trail just stops short
+    vec4 p = trail[body * trailLength + (head + trailLength - k) % trailLength];
+    if (p.w == 0.0)
+        p = newest;
+    Fade = 1.0 - float(k) / float(max(filled, 1u));
+    gl_Position = projection * view * vec4(p.xyz - origin, 1.0);
+}
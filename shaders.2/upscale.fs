@@ -0,0 +1,13 @@
+#version 460 core
+// the scene target filtered up to the window, drawn over fullscreen.vs
+in vec2 TexCoords;
+
+out vec4 FragColor;
+
+uniform sampler2D scene;
+uniform vec4 region;    // the part of the target shown, offset in xy and size in zw
+
+void main()
+{
+    FragColor = vec4(texture(scene, region.xy + TexCoords * region.zw).rgb, 1.0);
+}
@@ -0,0 +1,68 @@
+// An equirectangular image as a virtual texture (include/virtual_texture.h). Each pixel writes the page it wants
+// into the feedback buffer, at the finer of the two levels it blends, and samples whatever the indirection says is
+// resident for it: its page, or the finest resident ancestor. Call sampleVirtualTexture in uniform control flow,
+// it takes derivatives.
+layout(binding = 20) uniform sampler2D vtPhysical;      // the page cache atlas, or the sparse texture
+layout(binding = 21) uniform usampler2D vtIndirection;  // per page and level: x, y of the resident page, its level
+
+layout(std430, binding = 29) buffer VirtualTextureFeedback {
+    uint vtRequests[];
+};
+
+uniform vec2 vtImageSize;       // level 0 texels
+uniform vec2 vtPaddedScale;     // the image's share of the sparse texture, whose size is whole pages
+uniform float vtTileSize;
+uniform float vtBorder;
+uniform int vtLevels;
+uniform uint vtLevelOffsets[16];
+uniform uint vtStamp;
+uniform float vtLodBias;
+uniform bool vtSparse;
+
+// longitude along u from -z through +x, latitude along v from the north pole down
+vec2 equirectCoordinates(vec3 direction)
+{
+    vec3 d = normalize(direction);
+    return vec2(0.5 + atan(d.x, -d.z) * 0.15915494, acos(clamp(d.y, -1.0, 1.0)) * 0.31830989);
+}
+
+// bilinear inside the resident page covering uv at level
+vec4 vtSampleCache(vec2 uv, int level)
+{
+    ivec2 pages = textureSize(vtIndirection, level);
+    vec2 pageCoord = uv * vtImageSize / (vtTileSize * exp2(float(level)));
+    uvec4 entry = texelFetch(vtIndirection, clamp(ivec2(pageCoord), ivec2(0), pages - 1), level);
+    // the resident page is entry.b - level levels coarser
+    vec2 within = fract(pageCoord * exp2(float(level) - float(entry.b)));
+    vec2 texel = vec2(entry.rg) * (vtTileSize + 2.0 * vtBorder) + vtBorder + within * vtTileSize;
+    return textureLod(vtPhysical, texel / vec2(textureSize(vtPhysical, 0)), 0.0);
+}
+
+vec4 sampleVirtualTexture(vec3 direction)
+{
+    vec2 uv = equirectCoordinates(direction);
+    // u jumps by one across the seam behind -z, the derivatives do not
+    vec2 dx = dFdx(uv), dy = dFdy(uv);
+    dx.x -= round(dx.x);
+    dy.x -= round(dy.x);
+    dx *= vtImageSize;
+    dy *= vtImageSize;
+    float lod = clamp(0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8)) + vtLodBias, 0.0, float(vtLevels - 1));
+    int level = int(lod);
+
+    ivec2 pages = textureSize(vtIndirection, level);
+    ivec2 page = clamp(ivec2(uv * vtImageSize / (vtTileSize * exp2(float(level)))), ivec2(0), pages - 1);
+    uint request = vtLevelOffsets[level] + uint(page.y * pages.x + page.x);
+    if (vtRequests[request] != vtStamp)
+        vtRequests[request] = vtStamp;
+
+    if (vtSparse) {
+        // the hardware filters, no finer than what is committed
+        float resident = float(texelFetch(vtIndirection, page, level).b);
+        return textureLod(vtPhysical, uv * vtPaddedScale, max(lod, resident));
+    }
+    vec4 fine = vtSampleCache(uv, level);
+    if (level + 1 >= vtLevels)
+        return fine;
+    return mix(fine, vtSampleCache(uv, level + 1), lod - float(level));
+}
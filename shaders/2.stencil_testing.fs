@@ -1,11 +1,15 @@
 #version 460 core
-out vec4 FragColor;
+layout (location = 0) out vec4 FragColor;
+// for the selection outline (include/selection_outline.h), 0 when the object is not selected
+layout (location = 1) out uint ObjectId;
 
 in vec2 TexCoords;
 
 uniform sampler2D texture1;
+uniform uint objectId;
 
 void main()
 {    
     FragColor = texture(texture1, TexCoords);
-}
\ No newline at end of file
+    ObjectId = objectId;
+}
@@ -0,0 +1,208 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm.hpp>
+#include <gtc/matrix_transform.hpp>
+#include <gtc/type_ptr.hpp>
+
+#include <camera.h>
+#include <model.h>
+#include <shader.h>
+#include <skinned_crowd.h>
+#include <gl_state_cache.h>
+
+#include <iostream>
+#include <string>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <algorithm>
+
+// A crowd of skinned, animated models, the load this engine's skinning path is sized for: every instance plays the
+// model's clips at its own phase and speed, posed across the worker pool and drawn with one instanced call per mesh
+// (include/skinned_crowd.h). --preskin skins in compute once a frame for every pass, --prepass adds a depth pre-pass
+// to have two of them. WASD and the mouse fly the camera, escape quits.
+
+static const unsigned int SCR_WIDTH = 1600;
+static const unsigned int SCR_HEIGHT = 900;
+
+static Camera camera(glm::vec3(0.0f, 2.0f, 12.0f));
+static float lastX = SCR_WIDTH / 2.0f;
+static float lastY = SCR_HEIGHT / 2.0f;
+static bool firstMouse = true;
+
+static void framebuffer_size_callback(GLFWwindow*, int width, int height)
+{
+    glViewport(0, 0, width, height);
+}
+
+static void mouse_callback(GLFWwindow*, double xpos, double ypos)
+{
+    if (firstMouse)
+    {
+        lastX = static_cast<float>(xpos);
+        lastY = static_cast<float>(ypos);
+        firstMouse = false;
+    }
+    camera.ProcessMouseMovement(static_cast<float>(xpos) - lastX, lastY - static_cast<float>(ypos));
+    lastX = static_cast<float>(xpos);
+    lastY = static_cast<float>(ypos);
+}
+
+static void processInput(GLFWwindow* window, float deltaTime)
+{
+    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true);
+    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) camera.ProcessKeyboard(FORWARD, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) camera.ProcessKeyboard(BACKWARD, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) camera.ProcessKeyboard(LEFT, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) camera.ProcessKeyboard(RIGHT, deltaTime);
+}
+
+static void printUsage(const char* program)
+{
+    std::cout << "usage: " << program << " [options]\n"
+              << "  --count N            instances in the crowd (default 100)\n"
+              << "  --spacing X          distance between neighbours (default 2)\n"
+              << "  --model PATH         skinned model to draw (default the dancing vampire)\n"
+              << "  --preskin            skin once a frame in a compute pass instead of in every pass's vertex shader\n"
+              << "  --prepass            draw a depth pre-pass before the lit one\n"
+              << "  --animation-lod D    pose instances farther than D less often (default every frame)\n";
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int count = 100;
+    float spacing = 2.0f;
+    std::string path = "../resources/objects/objects/vampire/dancing_vampire.dae";
+    bool preSkinning = false;
+    bool depthPrepass = false;
+    float animationLod = 0.0f;
+    for (int a = 1; a < argc; a++)
+    {
+        const std::string arg = argv[a];
+        const bool hasValue = a + 1 < argc;
+        if (arg == "--help" || arg == "-h") { printUsage(argv[0]); return 0; }
+        else if (arg == "--count" && hasValue) count = static_cast<unsigned int>(std::strtoul(argv[++a], nullptr, 10));
+        else if (arg == "--spacing" && hasValue) spacing = std::strtof(argv[++a], nullptr);
+        else if (arg == "--model" && hasValue) path = argv[++a];
+        else if (arg == "--preskin") preSkinning = true;
+        else if (arg == "--prepass") depthPrepass = true;
+        else if (arg == "--animation-lod" && hasValue) animationLod = std::strtof(argv[++a], nullptr);
+        else { std::cerr << "unknown option " << arg << std::endl; printUsage(argv[0]); return 1; }
+    }
+
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Skinned crowd", NULL, NULL);
+    if (window == NULL)
+    {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetCursorPosCallback(window, mouse_callback);
+    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return -1;
+    }
+    glEnable(GL_DEPTH_TEST);
+
+    Shader* shader = preSkinning ? new Shader("../shaders.2/preskinned.instanced.vs", "../shaders.2/skinned.model.shader.fs")
+                                 : new Shader("../shaders.2/skinned.instanced.vs", "../shaders.2/skinned.model.shader.fs",
+                                              ShaderDefines{vertexInputsDefine(VERTEX_LAYOUT_FULL)});
+    Model* model = new Model(path, false, VERTEX_LAYOUT_FULL);
+    if (!model->skinned() || model->animations.empty())
+        std::cout << "Crowd: " << path << " has no bones or no animation, it is drawn in its bind pose" << std::endl;
+    std::cout << "Crowd: " << count << " instances of " << model->skeleton.boneCount() << " bones, "
+              << model->animations.size() << " clips" << std::endl;
+
+    // a square grid facing the camera, each at its own phase and a slightly different speed
+    SkinnedCrowd* crowd = new SkinnedCrowd("../shaders.2/skinning.cs");
+    crowd->preSkinning = preSkinning;
+    crowd->animationLod = animationLod;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    const unsigned int side = static_cast<unsigned int>(std::ceil(std::sqrt(static_cast<float>(count))));
+    crowd->instances.resize(count);
+    for (unsigned int k = 0; k < count; k++)
+    {
+        SkinnedCrowd::Instance& instance = crowd->instances[k];
+        const float x = (static_cast<float>(k % side) - 0.5f * (side - 1)) * spacing;
+        const float z = -static_cast<float>(k / side) * spacing;
+        instance.model = glm::translate(glm::mat4(1.0f), glm::vec3(x, 0.0f, z));
+        instance.clip = model->animations.empty() ? 0 : k % static_cast<uint32_t>(model->animations.size());
+        const float duration = model->animations.empty() ? 1.0f : model->animations[instance.clip].duration;
+        instance.timeOffset = unit(random) * duration;
+        instance.speed = 0.8f + 0.4f * unit(random);
+    }
+
+    unsigned int uboMatrices;
+    glCreateBuffers(1, &uboMatrices);
+    labelObject(GL_BUFFER, uboMatrices, "Matrices block");
+    glNamedBufferStorage(uboMatrices, 2 * sizeof(glm::mat4), NULL, GL_DYNAMIC_STORAGE_BIT);
+    glState().bindBufferBase(GL_UNIFORM_BUFFER, 0, uboMatrices);
+
+    float lastFrame = static_cast<float>(glfwGetTime());
+    float fpsTime = lastFrame;
+    unsigned int frames = 0;
+    while (!glfwWindowShouldClose(window))
+    {
+        const float currentFrame = static_cast<float>(glfwGetTime());
+        const float deltaTime = currentFrame - lastFrame;
+        lastFrame = currentFrame;
+        processInput(window, deltaTime);
+
+        crowd->update(*model, currentFrame, camera.Position);
+
+        int width, height;
+        glfwGetFramebufferSize(window, &width, &height);
+        glClearColor(0.08f, 0.08f, 0.1f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        const glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), static_cast<float>(width) / std::max(height, 1), 0.1f, 500.0f);
+        const glm::mat4 view = camera.GetViewMatrix();
+        glNamedBufferSubData(uboMatrices, 0, sizeof(glm::mat4), glm::value_ptr(projection));
+        glNamedBufferSubData(uboMatrices, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(view));
+
+        shader->use();
+        shader->setVec3("lightDirection", glm::vec3(view * glm::vec4(glm::normalize(glm::vec3(0.4f, 1.0f, 0.6f)), 0.0f)));
+        shader->setFloat("ambient", 0.25f);
+        if (depthPrepass)
+        {
+            // the lit pass then shades each pixel once, at the depth the pre-pass left
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            crowd->draw(*shader, *model);
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            glDepthFunc(GL_LEQUAL);
+            glDepthMask(GL_FALSE);
+        }
+        crowd->draw(*shader, *model);
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+
+        frames++;
+        if (currentFrame - fpsTime >= 2.0f)
+        {
+            std::cout << "Crowd: " << (currentFrame - fpsTime) * 1000.0f / frames << " ms a frame, " << crowd->posedCount()
+                      << " posed" << std::endl;
+            fpsTime = currentFrame;
+            frames = 0;
+        }
+    }
+
+    delete crowd;
+    delete model;
+    delete shader;
+    glState().deleteBuffers(1, &uboMatrices);
+    glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,1081 @@
+#include <physics_world.h>
+#include <snapshot.h>
+#include <checkpoint.h>
+#include <trajectory_recorder.h>
+#include <parameter_sweep.h>
+#include <pareto_benchmark.h>
+#include <state_stream.h>
+#include <shared_state.h>
+#include <perf_counters.h>
+#include <out_of_core.h>
+#ifdef NBODY_MPI
+#include <distributed_nbody.h>
+#endif
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <csignal>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include <sys/resource.h>
+
+// Runs the simulation's scenario without a window or GL context, for long integrations on compute nodes and
+// for comparing solvers, kernels and integrators on the same seed.
+
+static void printUsage(const char* program)
+{
+    std::cout << "usage: " << program << " [options]\n"
+              << "  --asteroids N        asteroid count (default 10000)\n"
+              << "  --steps N            steps to run (default 1000)\n"
+              << "  --duration T         sim time to run instead of a step count\n"
+              << "  --dt DT              step size in sim seconds (default 1/120)\n"
+              << "  --solver S           brute | barnes-hut | test-particles | fmm | pm\n"
+              << "  --theta X            Barnes-Hut opening angle (default 0.5)\n"
+              << "  --fmm-order P        multipole expansion order, 1 to 8 (default 4)\n"
+              << "  --fmm-theta X        multipole acceptance angle, below 1 (default 0.5)\n"
+              << "  --fmm-validate N     compare N bodies against the direct sum, O(N) each\n"
+              << "  --mesh-grid N        particle-mesh nodes per side, a power of two from 16 to 128 (default 64)\n"
+              << "  --p3m                direct short-range pairs on top of the particle mesh\n"
+              << "  --self-gravity       asteroid-asteroid gravity for the brute-force solver\n"
+              << "  --kernel K           scalar | avx2 | avx512 (default: best available)\n"
+              << "  --force-law L        newtonian | plummer | spline, for brute, barnes-hut and test-particles\n"
+              << "  --precision P        float | double | mixed, the arithmetic of the same pairs (default float)\n"
+              << "  --integrator I       euler | leapfrog | verlet | yoshida4\n"
+              << "  --block-timesteps    per-body power-of-two steps\n"
+              << "  --kepler             analytic orbits for asteroids away from the planets\n"
+              << "  --close-encounters   two-body orbits for asteroids passing close to the sun or a planet\n"
+              << "  --respa K            multiple timesteps: the sun's pull every step, the rest of the forces every K steps\n"
+              << "  --sectors            multi-rate belt: sectors away from the focus get the force sum less often\n"
+              << "  --sector-grid AxR    angular x radial sectors (default 16x4)\n"
+              << "  --sector-levels L    the farthest sectors are summed every 2^L steps (default 3)\n"
+              << "  --sector-focus X,Y,Z region of interest kept at full rate (default the origin)\n"
+              << "  --sector-radius R    distance from the focus within which sectors are at full rate (default 150)\n"
+              << "  --collisions         merge touching asteroids, the sun and planets absorb what hits them\n"
+              << "  --no-morton          keep spawn order instead of periodic Z-order re-sorting\n"
+              << "  --threads N          worker threads (default: all cores)\n"
+              << "  --pin MODE           cores | nodes: pin the worker threads to a core each or to NUMA nodes\n"
+              << "  --huge-pages SIZE    2m | 1g: back the body arrays with huge pages (1g needs reserved hugetlbfs pages)\n"
+              << "  --first-touch        each worker first touches the part of the body arrays it steps, for NUMA placement\n"
+              << "  --seed N             scenario seed (default 1)\n"
+              << "  --scenario FILE      bodies and generators from a scenario file instead of the built-in belt\n"
+              << "  --load PATH          start from a snapshot instead of the scenario\n"
+              << "  --save PATH          write a snapshot of the final state\n"
+              << "  --checkpoint PATH    write a snapshot to PATH every --checkpoint-every steps while stepping on\n"
+              << "  --checkpoint-every K steps between checkpoints (default 10000)\n"
+              << "  --resume             start from the --checkpoint file when there is one, for the steps it had left\n"
+              << "  --record PATH        record a trajectory while running\n"
+              << "  --record-every K     steps between recorded frames (default 10)\n"
+              << "  --record-quantum Q   quantize recorded positions to a Q grid (default lossless)\n"
+              << "  --energy             report the relative energy error (O(N^2) at start and end)\n"
+              << "  --counters           hardware counters of the step, force, tree and mesh regions (Linux perf_event_open),\n"
+              << "                       with IPC, cache misses, bytes and cycles per interaction and a roofline position\n"
+              << "  --peak-gflops X      the machine's peak GFLOP/s for the roofline of --counters\n"
+              << "  --peak-gbs X         and its memory bandwidth in GB/s\n"
+              << "  --diagnostics K      sample energy and momenta every K steps from the force pass, report the drift\n"
+              << "  --sweep SPEC         run every combination of the parameters in SPEC, one summary row each\n"
+              << "  --sweep-out PATH     CSV the sweep writes (default sweep.csv)\n"
+              << "  --jobs N             concurrent sweep runs, each single-threaded (default: all cores)\n"
+              << "  --pareto PATH        every solver and integrator on the two-body, belt and Plummer scenarios, --steps\n"
+              << "                       steps each, errors against a Yoshida direct-sum reference; a table and CSV PATH\n"
+              << "  --pareto-bodies N    belt asteroids and cluster bodies of --pareto (default 2000)\n"
+              << "  --ephemeris PATH     the sun and planets from a Chebyshev ephemeris instead of integrating them\n"
+              << "  --write-ephemeris P  integrate the sun and planets for --steps steps and fit an ephemeris to P\n"
+              << "  --ephemeris-segment K steps per Chebyshev segment of --write-ephemeris (default 256)\n"
+              << "  --ephemeris-degree N coefficients per coordinate and segment, 2 to 32 (default 14)\n"
+              << "  --out-of-core DIR    the belt in memory-mapped chunk files in DIR, for more bodies than fit in memory;\n"
+              << "                       Barnes-Hut with leapfrog, the final state left in DIR\n"
+              << "  --chunk-bodies N     bodies to a chunk file of --out-of-core (default 1048576)\n"
+              << "  --resort-every K     steps between the Z-order re-sorts of --out-of-core, 0 for never (default 64)\n"
+              << "  --serve PORT         stream the bodies to viewers over UDP (simulation --connect), in real time and\n"
+              << "                       until interrupted unless --steps or --duration is given\n"
+              << "  --serve-rate HZ      snapshots per second (default 60)\n"
+              << "  --serve-quantum Q    grid the streamed positions are quantized to (default 1/1024)\n"
+              << "  --shared-state NAME  publish the bodies in the POSIX shared memory /NAME for tools on this machine\n"
+              << "                       to map (shared_state.h), removed again when the run ends\n"
+              << "  --shared-state-every K  steps between publishes (default 1)\n"
+#ifdef NBODY_MPI
+              << "  --distributed        Barnes-Hut with leapfrog across the MPI ranks (mpirun -n P)\n"
+              << "  --scaling MODE       strong | weak: time --steps steps on 1, 2, 4 ... of the ranks\n"
+              << "  --scaling-out PATH   CSV of the scaling rows\n"
+#endif
+              ;
+}
+
+static std::atomic<bool> interrupted{false};
+
+static void onInterrupt(int)
+{
+    interrupted = true;
+}
+
+// One sweep run from the scenario. Its world is single-threaded, so the parallel loops run inline and any number
+// of runs can step side by side without sharing the worker pool.
+static std::string runSweepPoint(const SweepSpec& spec, size_t run, ScenarioConfig scenario, PhysicsSettings settings,
+                                 unsigned long steps, float dt)
+{
+    std::vector<double> values;
+    spec.point(run, values);
+    for (size_t k = 0; k < values.size(); k++)
+        applySweepParameter(spec.axes[k].name, values[k], scenario, settings);
+    settings.threads = 1;
+
+    auto start = std::chrono::steady_clock::now();
+    PhysicsWorld world;
+    world.applySettings(settings);    // before initialize, the planet's orbital speed depends on G
+    world.initialize(scenario);
+    const size_t asteroidCount = world.bodies.count(BODY_ASTEROID);
+    world.sampleConservedNow();
+
+    // the planet's distance from the sun over the run tells a stable orbit from a perturbed one
+    const bool havePlanet = world.bodies.count(BODY_SUN) > 0 && world.bodies.count(BODY_PLANET) > 0;
+    const uint32_t sunId = havePlanet ? world.bodies.id[world.bodies.range(BODY_SUN).begin] : 0;
+    const uint32_t planetId = havePlanet ? world.bodies.id[world.bodies.range(BODY_PLANET).begin] : 0;
+    double minDistance = 0.0, maxDistance = 0.0;
+    for (unsigned long s = 0; s <= steps; s++)
+    {
+        if (s > 0) world.step(dt);
+        if (!havePlanet) continue;
+        double d = glm::length(world.bodies.position[world.bodies.indexOf(planetId)] - world.bodies.position[world.bodies.indexOf(sunId)]);
+        minDistance = s == 0 ? d : std::min(minDistance, d);
+        maxDistance = s == 0 ? d : std::max(maxDistance, d);
+    }
+    const ConservedQuantities reference = world.conservedReference;
+    world.sampleConservedNow();
+
+    // asteroids still on a bound orbit around the sun
+    size_t bound = 0;
+    if (world.bodies.count(BODY_SUN) > 0) {
+        const size_t sun = world.bodies.indexOf(world.bodies.id[world.bodies.range(BODY_SUN).begin]);
+        const double mu = static_cast<double>(world.G) * world.bodies.mass[sun];
+        const BodyRange asteroids = world.bodies.range(BODY_ASTEROID);
+        for (size_t i = asteroids.begin; i < asteroids.end; i++) {
+            glm::dvec3 v = world.bodies.velocity[i] - world.bodies.velocity[sun];
+            double r = glm::length(world.bodies.position[i] - world.bodies.position[sun]);
+            if (r > 0.0 && 0.5 * glm::dot(v, v) - mu / r < 0.0) bound++;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::ostringstream row;
+    row << std::setprecision(9) << run;
+    for (double v : values) row << ',' << v;
+    row << ',' << world.bodies.size() << ',' << world.stepCount << ',' << world.simTime << ',' << seconds
+        << ',' << relativeDrift(world.conserved.total, reference.total)
+        << ',' << relativeDrift(world.conserved.momentum, reference.momentum)
+        << ',' << relativeDrift(world.conserved.angularMomentum, reference.angularMomentum)
+        << ',' << minDistance << ',' << maxDistance
+        << ',' << (asteroidCount > 0 ? static_cast<double>(bound) / asteroidCount : 0.0) << ',' << world.mergers;
+    return row.str();
+}
+
+// runs spec.runCount() simulations on jobs threads, writing each summary row as soon as its run finishes
+static int runSweep(const SweepSpec& spec, const ScenarioConfig& scenario, const PhysicsSettings& settings,
+                    unsigned long steps, float dt, unsigned int jobs, const std::string& outPath)
+{
+    std::ofstream out(outPath);
+    if (!out) { std::cerr << "cannot write " << outPath << std::endl; return 1; }
+    out << "run";
+    for (const SweepAxis& axis : spec.axes) out << ',' << axis.name;
+    out << ",bodies,steps,sim_time,wall_seconds,energy_drift,momentum_drift,angular_momentum_drift,"
+           "planet_min_distance,planet_max_distance,bound_asteroid_fraction,mergers\n";
+
+    const size_t runs = spec.runCount();
+    jobs = static_cast<unsigned int>(std::max<size_t>(1, std::min<size_t>(jobs, runs)));
+    std::cout << "sweep: " << runs << " runs of " << steps << " steps on " << jobs << " threads" << std::endl;
+    // the runs never touch the shared pool, keep it from holding idle threads
+    workerPool().resize(1);
+
+    std::atomic<size_t> next{0};
+    std::mutex outMutex;
+    size_t finished = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned int j = 0; j < jobs; j++)
+        workers.emplace_back([&]() {
+            for (size_t run; (run = next.fetch_add(1)) < runs;) {
+                std::string row = runSweepPoint(spec, run, scenario, settings, steps, dt);
+                std::lock_guard<std::mutex> lock(outMutex);
+                out << row << '\n';
+                out.flush();
+                finished++;
+            }
+        });
+    for (std::thread& t : workers) t.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << std::fixed << std::setprecision(3)
+              << "wall time: " << seconds << " s\n"
+              << "runs/hour: " << (seconds > 0.0 ? finished * 3600.0 / seconds : 0.0) << "\n"
+              << "wrote " << outPath << std::endl;
+    return out ? 0 : 1;
+}
+
+// steps one pareto run from the scenario, the reference when reference is null, and scores it against reference
+static ParetoResult runParetoPoint(const ParetoScenario& scenario, const std::string& label, const PhysicsSettings& settings,
+                                   unsigned long steps, float dt, const PhysicsWorld* reference, PhysicsWorld& world)
+{
+    world.applySettings(settings);    // before the build, orbital speeds depend on G
+    scenario.build(world);
+    world.sampleConservedNow();
+    const unsigned int substeps = reference ? 1 : PARETO_REFERENCE_SUBSTEPS;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long s = 0; s < steps * substeps && !interrupted; s++)
+        world.step(dt / static_cast<float>(substeps));
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const ConservedQuantities initial = world.conservedReference;
+    world.sampleConservedNow();
+
+    ParetoResult result;
+    result.scenario = scenario.name;
+    result.config = label;
+    result.bodies = world.bodies.size();
+    result.secondsPerStep = steps > 0 ? seconds / static_cast<double>(steps) : 0.0;
+    result.energyError = std::abs(relativeDrift(world.conserved.total, initial.total));
+    result.momentumError = relativeDrift(world.conserved.momentum, initial.momentum);
+    result.positionError = reference ? paretoPositionError(world.bodies, reference->bodies) : 0.0;
+    return result;
+}
+
+// --write-ephemeris: fits an ephemeris (ephemeris.h) of the world's sun and planets over steps of dt from where the
+// world is. They alone are integrated, by the direct sum and 4th-order Yoshida at a quarter of the step: asteroids
+// pull on nothing where the ephemeris is meant to be used, the test-particle solver. Every step's state is kept and
+// the fit samples between them by cubic Hermite interpolation, then the series are checked against the kept states.
+static int writeEphemeris(const PhysicsWorld& world, unsigned long steps, float dt, unsigned long segmentSteps,
+                          unsigned int coefficients, const std::string& path)
+{
+    PhysicsWorld massive;
+    PhysicsSettings settings = world.settings();
+    settings.solver = SOLVER_BRUTE_FORCE;
+    settings.integrator = INTEGRATOR_YOSHIDA4;
+    settings.keplerAsteroids = settings.blockTimesteps = settings.closeEncounters = settings.beltSectors = false;
+    settings.collisions = false;
+    settings.diagnosticsInterval = 0;
+    massive.applySettings(settings);
+    const size_t count = world.bodies.range(BODY_ASTEROID).begin;
+    if (count == 0 || steps == 0) { std::cerr << "--write-ephemeris needs a sun or planet and --steps" << std::endl; return 1; }
+    for (size_t i = 0; i < count; i++)
+        massive.bodies.add(i < world.bodies.range(BODY_PLANET).begin ? BODY_SUN : BODY_PLANET, world.bodies.position[i],
+                           world.bodies.velocity[i], world.bodies.mass[i], world.bodies.render[i].radiusScale);
+    massive.simTime = world.simTime;
+    massive.bodiesChanged();
+
+    const unsigned int substeps = PARETO_REFERENCE_SUBSTEPS;
+    std::vector<glm::dvec3> position((steps + 1) * count), velocity((steps + 1) * count);
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long s = 0; s <= steps; s++)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            position[s * count + i] = massive.bodies.position[i];
+            velocity[s * count + i] = massive.bodies.velocity[i];
+        }
+        if (s < steps)
+            for (unsigned int k = 0; k < substeps; k++)
+                massive.step(dt / substeps);
+        if (interrupted) return 1;
+    }
+    const double h = dt;
+    auto hermite = [&](size_t i, double t) {
+        const double u = (t - world.simTime) / h;
+        const unsigned long k = std::min(static_cast<unsigned long>(std::max(u, 0.0)), steps - 1);
+        const double x = u - static_cast<double>(k), x2 = x * x, x3 = x2 * x;
+        const glm::dvec3 &p0 = position[k * count + i], &p1 = position[(k + 1) * count + i];
+        const glm::dvec3 m0 = velocity[k * count + i] * h, m1 = velocity[(k + 1) * count + i] * h;
+        return (2.0 * x3 - 3.0 * x2 + 1.0) * p0 + (x3 - 2.0 * x2 + x) * m0 + (-2.0 * x3 + 3.0 * x2) * p1 + (x3 - x2) * m1;
+    };
+
+    Ephemeris ephemeris;
+    ephemeris.start = world.simTime;
+    ephemeris.end = world.simTime + steps * h;
+    const uint32_t segments = static_cast<uint32_t>(std::max(1ul, (steps + segmentSteps / 2) / std::max(segmentSteps, 1ul)));
+    for (size_t i = 0; i < count; i++)
+    {
+        const BodyType type = i < world.bodies.range(BODY_PLANET).begin ? BODY_SUN : BODY_PLANET;
+        const uint32_t ordinal = static_cast<uint32_t>(i - world.bodies.range(type).begin);
+        ephemeris.fit((type == BODY_SUN ? "sun " : "planet ") + std::to_string(ordinal), type, ordinal, world.bodies.mass[i],
+                      coefficients, segments, [&](double t) { return hermite(i, t); });
+    }
+    if (!ephemeris.write(path)) { std::cerr << "cannot write " << path << std::endl; return 1; }
+
+    double worst = 0.0;
+    for (unsigned long s = 0; s <= steps; s++)
+        for (size_t i = 0; i < count; i++)
+            worst = std::max(worst, glm::length(ephemeris.position(i, world.simTime + s * h) - position[s * count + i]));
+    std::cout << "ephemeris of " << count << " bodies over t = " << ephemeris.start << " to " << ephemeris.end << ", "
+              << segments << " segments of " << ephemeris.segmentLength(0) << ", " << ephemeris.bytes() / 1024 << " KB in "
+              << path << " (" << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s)\n"
+              << "largest position error at the steps: " << std::scientific << std::setprecision(3) << worst << std::endl;
+    return 0;
+}
+
+// --pareto: every configuration on every scenario, one after the other on the whole pool so the timings are the
+// configurations' own, then the table of each scenario by time per step with its Pareto front marked
+static int runPareto(const PhysicsSettings& base, unsigned long steps, float dt, unsigned int bodies, unsigned int seed,
+                     const std::string& outPath)
+{
+    std::ofstream out(outPath);
+    if (!out) { std::cerr << "cannot write " << outPath << std::endl; return 1; }
+    out << "scenario,config,bodies,steps,dt,seconds_per_step,energy_error,momentum_error,position_error,pareto\n";
+    workerPool().resize(static_cast<unsigned int>(base.threads));
+    std::signal(SIGINT, onInterrupt);
+
+    const std::vector<ParetoConfig> configs = paretoConfigs();
+    std::vector<ParetoResult> results;
+    for (const ParetoScenario& scenario : paretoScenarios(bodies, seed)) {
+        PhysicsSettings referenceSettings = base;
+        ParetoConfig direct;
+        direct.solver = SOLVER_BRUTE_FORCE;
+        direct.integrator = INTEGRATOR_YOSHIDA4;
+        direct.apply(referenceSettings);
+        referenceSettings.forceKernel = KERNEL_SCALAR;
+        PhysicsWorld reference;
+        const ParetoResult ref = runParetoPoint(scenario, "reference", referenceSettings, steps, dt, nullptr, reference);
+        std::cout << scenario.name << ": " << ref.bodies << " bodies, reference in " << std::fixed << std::setprecision(1)
+                  << ref.secondsPerStep * steps << " s" << std::endl;
+        for (const ParetoConfig& config : configs) {
+            if (config.needsBelt && !scenario.hasBelt)
+                continue;
+            PhysicsSettings settings = base;
+            config.apply(settings);
+            PhysicsWorld world;
+            results.push_back(runParetoPoint(scenario, config.label, settings, steps, dt, &reference, world));
+            if (interrupted) break;
+        }
+        if (interrupted) break;
+    }
+    markParetoFront(results);
+    // each scenario's runs are together, fastest first
+    for (auto first = results.begin(); first != results.end();) {
+        auto last = std::find_if(first, results.end(), [&](const ParetoResult& r) { return r.scenario != first->scenario; });
+        std::sort(first, last, [](const ParetoResult& a, const ParetoResult& b) { return a.secondsPerStep < b.secondsPerStep; });
+        first = last;
+    }
+
+    std::string scenario;
+    for (const ParetoResult& r : results) {
+        if (r.scenario != scenario) {
+            scenario = r.scenario;
+            std::cout << "\n" << scenario << " (* on the Pareto front of time per step and position error)\n"
+                      << std::left << std::setw(28) << "  config" << std::right << std::setw(12) << "ms/step"
+                      << std::setw(14) << "energy" << std::setw(14) << "momentum" << std::setw(14) << "position" << '\n';
+        }
+        std::cout << (r.front ? "* " : "  ") << std::left << std::setw(26) << r.config << std::right
+                  << std::fixed << std::setprecision(3) << std::setw(12) << r.secondsPerStep * 1000.0
+                  << std::scientific << std::setprecision(2) << std::setw(14) << r.energyError
+                  << std::setw(14) << r.momentumError << std::setw(14) << r.positionError << '\n';
+        out << std::setprecision(9) << r.scenario << ',' << r.config << ',' << r.bodies << ',' << steps << ',' << dt << ','
+            << r.secondsPerStep << ',' << r.energyError << ',' << r.momentumError << ',' << r.positionError << ','
+            << (r.front ? 1 : 0) << '\n';
+    }
+    std::cout << "\nwrote " << outPath << std::endl;
+    return out ? 0 : 1;
+}
+
+#ifdef NBODY_MPI
+static const unsigned int SCALING_WARMUP_STEPS = 2;
+
+static void configureDistributed(DistributedNBody& world, const PhysicsWorld& physics)
+{
+    world.G = physics.G;
+    world.epsilonSq = physics.epsilonSq;
+    world.theta = physics.theta;
+    world.threads = static_cast<unsigned int>(physics.threads);
+}
+
+// --distributed: the first rank sets up the scenario or snapshot and deals it out, every rank steps its share, and
+// the first one gathers it back for the report and --save
+static int runDistributed(PhysicsWorld& physics, const ScenarioConfig& scenario, const std::string& loadPath,
+                          const std::string& savePath, unsigned long steps, float dt, bool reportEnergy)
+{
+    int rank = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    int loaded = 1;
+    if (rank == 0) {
+        if (loadPath.empty()) physics.initialize(scenario);
+        else loaded = physics.loadSnapshot(loadPath.c_str()) ? 1 : 0;
+    }
+    MPI_Bcast(&loaded, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (!loaded) { if (rank == 0) std::cerr << "cannot load snapshot " << loadPath << std::endl; return 1; }
+    workerPool().resize(static_cast<unsigned int>(physics.threads));
+
+    DistributedNBody world(MPI_COMM_WORLD);
+    configureDistributed(world, physics);
+    world.simTime = physics.simTime;
+    MPI_Bcast(&world.simTime, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    world.scatter(rank == 0 ? &physics.bodies : nullptr);
+    const unsigned long long bodies = world.globalCount();
+    const double initialEnergy = rank == 0 && reportEnergy ? physics.totalEnergy() : 0.0;
+    std::cout << "bodies: " << bodies << " on " << world.ranks() << " ranks, steps: " << steps << ", dt: " << dt
+              << ", integrator: leapfrog, barnes-hut theta " << world.theta << ", threads per rank: " << physics.threads << std::endl;
+
+    unsigned long stepsRun = 0;
+    unsigned long long interactions = 0, imported = 0, bytes = 0;
+    double imbalance = 0.0;
+    MPI_Barrier(MPI_COMM_WORLD);
+    const double start = MPI_Wtime();
+    for (unsigned long s = 0; s < steps; s++) {
+        world.step(dt);
+        const DistributedNBody::StepStats& last = world.lastStep();
+        interactions += last.interactions;
+        imported += last.imported;
+        bytes += last.bytesSent;
+        imbalance += last.imbalance;
+        stepsRun++;
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    const double seconds = MPI_Wtime() - start;
+    unsigned long long totals[3] = {interactions, imported, bytes};
+    MPI_Reduce(rank == 0 ? MPI_IN_PLACE : totals, totals, 3, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    world.gather(rank == 0 ? &physics.bodies : nullptr);
+
+    const double perStep = stepsRun > 0 ? 1.0 / stepsRun : 0.0;
+    std::cout << std::fixed << std::setprecision(3)
+              << "wall time: " << seconds << " s\n"
+              << "steps/sec: " << (seconds > 0.0 ? stepsRun / seconds : 0.0) << "\n"
+              << "load imbalance: " << imbalance * perStep << " (slowest force pass over the mean), "
+              << world.rebalanceCount() << " re-cuts\n"
+              << "LET particles per rank and step: " << static_cast<double>(totals[1]) * perStep / world.ranks() << "\n"
+              << "exchanged per step: " << static_cast<double>(totals[2]) * perStep / (1024.0 * 1024.0) << " MB\n"
+              << std::scientific << std::setprecision(3)
+              << "interactions/sec: " << (seconds > 0.0 ? totals[0] / seconds : 0.0) << std::endl;
+
+    int status = 0;
+    if (rank == 0) {
+        physics.simTime = world.simTime;
+        physics.stepCount += stepsRun;
+        if (reportEnergy && initialEnergy != 0.0)
+            std::cout << "relative energy error: " << (physics.totalEnergy() - initialEnergy) / std::abs(initialEnergy) << std::endl;
+        if (!savePath.empty()) {
+            SnapshotWriter writer;
+            writer.write(savePath, physics.bodies, physics.snapshotInfo());
+            writer.wait();
+            if (!writer.lastSucceeded()) { std::cerr << "cannot write snapshot " << savePath << std::endl; status = 1; }
+        }
+    }
+    MPI_Bcast(&status, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    return status;
+}
+
+// --scaling: the same run on 1, 2, 4 ... of the ranks. Strong scaling spreads the scenario's bodies thinner, weak
+// scaling gives every rank a belt of its own (its own seed, the sun and planet only once) so the work per rank stays.
+static int runScaling(bool weak, const ScenarioConfig& scenario, const PhysicsWorld& physics, unsigned long steps, float dt,
+                      const std::string& outPath)
+{
+    int rank = 0, worldRanks = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &worldRanks);
+    workerPool().resize(static_cast<unsigned int>(physics.threads));
+    std::vector<int> rankCounts;
+    for (int p = 1; p < worldRanks; p *= 2) rankCounts.push_back(p);
+    rankCounts.push_back(worldRanks);
+    steps = std::max(1ul, steps);
+
+    std::ofstream out;
+    const char* header = "ranks,bodies,seconds_per_step,speedup,efficiency,imbalance,let_particles_per_rank,exchanged_mb_per_step,re_cuts";
+    if (rank == 0 && !outPath.empty()) {
+        out.open(outPath);
+        if (!out) std::cerr << "cannot write " << outPath << std::endl;
+        else out << header << '\n';
+    }
+    std::cout << (weak ? "weak" : "strong") << " scaling: " << steps << " steps after " << SCALING_WARMUP_STEPS
+              << " warm-up steps, " << physics.threads << " threads per rank\n" << header << std::endl;
+
+    double baseline = 0.0;
+    for (int p : rankCounts) {
+        MPI_Comm group;
+        MPI_Comm_split(MPI_COMM_WORLD, rank < p ? 0 : MPI_UNDEFINED, rank, &group);
+        if (group != MPI_COMM_NULL) {
+            DistributedNBody world(group);
+            configureDistributed(world, physics);
+            PhysicsWorld source;
+            source.applySettings(physics.settings());
+            if (weak) {
+                ScenarioConfig share = scenario;
+                share.seed = scenario.seed + static_cast<unsigned int>(world.rank());
+                source.initialize(share);
+                const size_t first = world.rank() == 0 ? 0 : source.bodies.range(BODY_ASTEROID).begin;
+                world.assign(source.bodies, first, source.bodies.size(), static_cast<uint32_t>(world.rank() * source.bodies.size()));
+            } else {
+                if (world.rank() == 0) source.initialize(scenario);
+                world.scatter(world.rank() == 0 ? &source.bodies : nullptr);
+            }
+            source.bodies.clear();
+            const unsigned long long bodies = world.globalCount();
+            for (unsigned int w = 0; w < SCALING_WARMUP_STEPS; w++) world.step(dt);
+
+            unsigned long long totals[2] = {0, 0};
+            double imbalance = 0.0;
+            const unsigned long cutsBefore = world.rebalanceCount();
+            MPI_Barrier(group);
+            const double start = MPI_Wtime();
+            for (unsigned long s = 0; s < steps; s++) {
+                world.step(dt);
+                totals[0] += world.lastStep().imported;
+                totals[1] += world.lastStep().bytesSent;
+                imbalance += world.lastStep().imbalance;
+            }
+            MPI_Barrier(group);
+            const double secondsPerStep = (MPI_Wtime() - start) / steps;
+            MPI_Reduce(world.rank() == 0 ? MPI_IN_PLACE : totals, totals, 2, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, group);
+            if (world.rank() == 0) {
+                if (p == 1) baseline = secondsPerStep;
+                const double speedup = secondsPerStep > 0.0 ? baseline / secondsPerStep : 0.0;
+                std::ostringstream row;
+                row << std::setprecision(6) << p << ',' << bodies << ',' << secondsPerStep << ',' << speedup << ','
+                    << (weak ? speedup : speedup / p) << ',' << imbalance / steps << ','
+                    << static_cast<double>(totals[0]) / steps / p << ',' << static_cast<double>(totals[1]) / steps / (1024.0 * 1024.0) << ','
+                    << world.rebalanceCount() - cutsBefore;
+                std::cout << row.str() << std::endl;
+                if (out) out << row.str() << '\n';
+            }
+            MPI_Comm_free(&group);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+    return 0;
+}
+#endif
+
+// a pair interaction as floating-point operations, the usual count for a softened inverse square (three
+// differences, the squared distance and softening, the reciprocal square root and cube, three multiply-adds)
+static const double FLOPS_PER_INTERACTION = 20.0;
+
+// --counters: every region's counts and what follows from them, then where the force pass sits on the roofline.
+// The counts are of every thread, so cycles are core cycles summed and interactions per cycle per core.
+static void printCounters(double peakGflops, double peakGbs)
+{
+    const PerfCounters& counters = perfCounters();
+    const std::vector<PerfCounters::Region> regions = counters.regions();
+    auto ratio = [](double a, double b, bool valid, int precision) {
+        std::ostringstream text;
+        if (!valid || b <= 0.0) text << "-";
+        else text << std::fixed << std::setprecision(precision) << a / b;
+        return text.str();
+    };
+    const bool cycles = counters.valid(PERF_CYCLES), instructions = counters.valid(PERF_INSTRUCTIONS);
+    const bool l1 = counters.valid(PERF_L1D_MISSES), llc = counters.valid(PERF_LLC_MISSES), branches = counters.valid(PERF_BRANCH_MISSES);
+    std::cout << "hardware counters, all threads in user mode, memory traffic as a 64-byte line per LLC miss:\n"
+              << std::left << std::setw(16) << "region" << std::right << std::setw(10) << "calls" << std::setw(12) << "ms"
+              << std::setw(10) << "Gcycles" << std::setw(7) << "IPC" << std::setw(10) << "L1D/kin" << std::setw(10) << "LLC/kin"
+              << std::setw(10) << "br/kin" << std::setw(9) << "GB/s" << std::setw(11) << "B/inter" << std::setw(12) << "inter/cyc" << '\n';
+    for (const PerfCounters::Region& r : regions) {
+        const PerfReading& t = r.total;
+        const double kiloInstructions = t.value[PERF_INSTRUCTIONS] * 1e-3;
+        std::cout << std::left << std::setw(16) << r.name << std::right << std::setw(10) << r.entries
+                  << std::setw(12) << ratio(t.seconds() * 1e3, 1.0, true, 1)
+                  << std::setw(10) << ratio(t.value[PERF_CYCLES] * 1e-9, 1.0, cycles, 3)
+                  << std::setw(7) << ratio(t.value[PERF_INSTRUCTIONS], t.value[PERF_CYCLES], cycles && instructions, 2)
+                  << std::setw(10) << ratio(t.value[PERF_L1D_MISSES], kiloInstructions, l1 && instructions, 2)
+                  << std::setw(10) << ratio(t.value[PERF_LLC_MISSES], kiloInstructions, llc && instructions, 3)
+                  << std::setw(10) << ratio(t.value[PERF_BRANCH_MISSES], kiloInstructions, branches && instructions, 2)
+                  << std::setw(9) << ratio(t.bytes() * 1e-9, t.seconds(), llc, 2)
+                  << std::setw(11) << ratio(t.bytes(), r.items, llc, 3)
+                  << std::setw(12) << ratio(r.items, t.value[PERF_CYCLES], cycles, 4) << '\n';
+    }
+    // the roofline of the force pass, or of whole steps when the solver's work is counted elsewhere
+    auto force = std::find_if(regions.begin(), regions.end(), [](const PerfCounters::Region& r) { return r.name == "force" && r.items > 0.0; });
+    if (force == regions.end())
+        force = std::find_if(regions.begin(), regions.end(), [](const PerfCounters::Region& r) { return r.items > 0.0; });
+    if (force == regions.end() || !llc || force->total.value[PERF_LLC_MISSES] == 0 || force->total.ns <= 0) {
+        std::cout << std::flush;
+        return;
+    }
+    const double flops = force->items * FLOPS_PER_INTERACTION;
+    const double intensity = flops / force->total.bytes();
+    const double gflops = flops / force->total.seconds() * 1e-9;
+    std::cout << "roofline (" << force->name << "): " << std::fixed << std::setprecision(2) << intensity << " flop/byte at "
+              << gflops << " GFLOP/s, " << FLOPS_PER_INTERACTION << " flops an interaction";
+    if (peakGflops > 0.0 && peakGbs > 0.0) {
+        const double ridge = peakGflops / peakGbs;
+        const double roof = std::min(peakGflops, intensity * peakGbs);
+        std::cout << "; " << (intensity < ridge ? "memory" : "compute") << "-bound (ridge at " << ridge << " flop/byte), "
+                  << 100.0 * gflops / roof << "% of the " << roof << " GFLOP/s attainable there";
+    } else {
+        std::cout << "; --peak-gflops and --peak-gbs place it under the machine's roof";
+    }
+    std::cout << std::scientific << std::setprecision(3) << std::endl;
+}
+
+static long majorFaults()
+{
+    struct rusage usage;
+    return getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_majflt : 0;
+}
+
+// --out-of-core: the scenario's sun and planet, and its belt generated straight into chunk files in directory,
+// stepped by OutOfCoreNBody with only the top of its tree in memory
+static int runOutOfCore(PhysicsWorld& physics, ScenarioConfig scenario, const std::string& directory, size_t chunkBodies,
+                        unsigned int resortEvery, unsigned long steps, float dt)
+{
+    const size_t asteroids = scenario.asteroidAmount;
+    scenario.asteroidAmount = 0;
+    physics.initialize(scenario);
+    workerPool().resize(static_cast<unsigned int>(physics.threads));
+
+    OutOfCoreNBody world;
+    world.G = physics.G;
+    world.epsilonSq = physics.epsilonSq;
+    world.theta = physics.theta;
+    world.threads = static_cast<unsigned int>(physics.threads);
+    world.chunkBodies = chunkBodies;
+    world.resortInterval = resortEvery;
+    auto buildStart = std::chrono::steady_clock::now();
+    if (!world.create(directory, physics.bodies, scenario, asteroids)) { std::cerr << world.error() << std::endl; return 1; }
+    std::cout << "wrote " << world.size() << " bodies to " << world.files().fileCount() << " chunk files in " << directory
+              << " (" << world.fileBytes() / (1024 * 1024) << " MB with the spare set) in "
+              << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count() << " ms" << std::endl;
+    std::cout << "bodies: " << world.size() << ", steps: " << steps << ", dt: " << dt << ", integrator: leapfrog, barnes-hut theta "
+              << world.theta << ", top tree: " << world.topNodeCount() << " nodes over " << world.bucketCount() << " buckets, "
+              << world.groupCount() << " groups, threads: " << physics.threads << std::endl;
+
+    unsigned long long interactions = 0, nearBodies = 0, farNodes = 0, groups = 0;
+    double driftSeconds = 0.0, forceSeconds = 0.0, sortSeconds = 0.0;
+    unsigned long stepsRun = 0, resorts = 0;
+    const long faultsBefore = majorFaults();
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long s = 0; s < steps; s++) {
+        world.step(dt);
+        const OutOfCoreNBody::StepStats& last = world.lastStep();
+        interactions += last.interactions;
+        nearBodies += last.nearBodies;
+        farNodes += last.farNodes;
+        groups += last.groups;
+        driftSeconds += last.driftSeconds;
+        forceSeconds += last.forceSeconds;
+        sortSeconds += last.sortSeconds;
+        if (last.resorted) resorts++;
+        stepsRun++;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const long faults = majorFaults() - faultsBefore;
+
+    const double perStep = stepsRun > 0 ? 1000.0 / stepsRun : 0.0;
+    const double perGroup = groups > 0 ? 1.0 / groups : 0.0;
+    std::cout << std::fixed << std::setprecision(3)
+              << "wall time: " << seconds << " s\n"
+              << "steps/sec: " << (seconds > 0.0 ? stepsRun / seconds : 0.0) << "\n"
+              << "per step: drift " << driftSeconds * perStep << " ms, force " << forceSeconds * perStep << " ms, "
+              << resorts << " re-sorts " << (resorts > 0 ? sortSeconds * 1000.0 / resorts : 0.0) << " ms each\n"
+              << "per group: " << static_cast<double>(nearBodies) * perGroup << " near bodies, "
+              << static_cast<double>(farNodes) * perGroup << " far nodes\n"
+              << "resident: " << world.residentBytes() / (1024.0 * 1024.0) << " MB besides the mapped pages, "
+              << (stepsRun > 0 ? static_cast<double>(faults) / stepsRun : 0.0) << " major faults per step\n"
+              << std::scientific << std::setprecision(3)
+              << "interactions/sec: " << (seconds > 0.0 ? interactions / seconds : 0.0) << std::endl;
+    const std::string firstFile = world.files().path(0);
+    world.close(true);
+    std::cout << "final state in " << firstFile.substr(0, firstFile.size() - std::strlen(".00000.bodies")) << ".*.bodies" << std::endl;
+    return 0;
+}
+
+static int run(int argc, char** argv)
+{
+    ScenarioConfig scenario;
+    scenario.asteroidAmount = 10000;
+    PhysicsWorld physics;
+    unsigned long steps = 1000;
+    double duration = 0.0;
+    float dt = 1.0f / 120.0f;
+    bool reportEnergy = false;
+    std::string loadPath, savePath, recordPath, sweepPath, sweepOutPath = "sweep.csv", scenarioPath, paretoPath;
+    unsigned int paretoBodies = 2000;
+    std::string ephemerisPath, writeEphemerisPath;
+    unsigned long ephemerisSegment = 256;
+    unsigned int ephemerisCoefficients = 14;
+    unsigned int jobs = ThreadPool::defaultThreadCount();
+    TrajectoryRecorder::Options recordOptions;
+    StateServer::Options serveOptions;
+    bool serve = false, stepsGiven = false;
+    std::string sharedStateName;
+    unsigned long sharedStateEvery = 1;
+    bool distributed = false;
+    Checkpoints checkpoints;
+    checkpoints.interval = 10000;
+    bool resume = false;
+    std::string scalingMode, scalingOutPath;
+    std::string outOfCorePath;
+    size_t chunkBodies = size_t(1) << 20;
+    unsigned int resortEvery = 64;
+    bool counters = false;
+    double peakGflops = 0.0, peakGbs = 0.0;
+    ThreadPinning pinning = PIN_NONE;
+
+    for (int a = 1; a < argc; a++)
+    {
+        std::string arg = argv[a];
+        bool hasValue = a + 1 < argc;
+        const char* value = hasValue ? argv[a + 1] : "";
+        if (arg == "--help" || arg == "-h") { printUsage(argv[0]); return 0; }
+        else if (arg == "--self-gravity") physics.asteroidSelfGravity = true;
+        else if (arg == "--block-timesteps") physics.blockTimesteps = true;
+        else if (arg == "--kepler") physics.keplerAsteroids = true;
+        else if (arg == "--close-encounters") physics.closeEncounters = true;
+        else if (arg == "--sectors") physics.beltSectors = true;
+        else if (arg == "--p3m") physics.particleMesh.shortRange = true;
+        else if (arg == "--collisions") physics.collisions = true;
+        else if (arg == "--no-morton") physics.mortonSort = false;
+        else if (arg == "--energy") reportEnergy = true;
+        else if (arg == "--distributed") distributed = true;
+        else if (arg == "--resume") resume = true;
+        else if (arg == "--first-touch") bodyMemory().firstTouch = true;
+        else if (arg == "--counters") counters = true;
+        else if (!hasValue) { std::cerr << "missing value for " << arg << std::endl; return 1; }
+        else
+        {
+            a++;
+            if (arg == "--asteroids") scenario.asteroidAmount = static_cast<unsigned int>(std::strtoul(value, nullptr, 10));
+            else if (arg == "--steps") { steps = std::strtoul(value, nullptr, 10); stepsGiven = true; }
+            else if (arg == "--duration") { duration = std::atof(value); stepsGiven = true; }
+            else if (arg == "--dt") dt = static_cast<float>(std::atof(value));
+            else if (arg == "--respa") { physics.respaSteps = static_cast<unsigned int>(std::strtoul(value, nullptr, 10)); physics.respa = true; }
+            else if (arg == "--theta") physics.theta = static_cast<float>(std::atof(value));
+            else if (arg == "--fmm-order") physics.fmm.order = static_cast<unsigned int>(std::strtoul(value, nullptr, 10));
+            else if (arg == "--mesh-grid") physics.particleMesh.grid = static_cast<unsigned int>(std::strtoul(value, nullptr, 10));
+            else if (arg == "--fmm-theta") physics.fmm.theta = static_cast<float>(std::atof(value));
+            else if (arg == "--diagnostics") physics.diagnosticsInterval = static_cast<unsigned int>(std::strtoul(value, nullptr, 10));
+            else if (arg == "--fmm-validate") physics.fmmValidationSample = static_cast<unsigned int>(std::strtoul(value, nullptr, 10));
+            else if (arg == "--threads") physics.threads = std::max(1, std::atoi(value));
+            else if (arg == "--peak-gflops") peakGflops = std::max(0.0, std::atof(value));
+            else if (arg == "--peak-gbs") peakGbs = std::max(0.0, std::atof(value));
+            else if (arg == "--seed") scenario.seed = static_cast<unsigned int>(std::strtoul(value, nullptr, 10));
+            else if (arg == "--scenario") scenarioPath = value;
+            else if (arg == "--sector-levels") physics.sectors.maxLevel = static_cast<unsigned int>(std::strtoul(value, nullptr, 10));
+            else if (arg == "--sector-radius") physics.sectors.focusRadius = static_cast<float>(std::atof(value));
+            else if (arg == "--sector-grid")
+            {
+                if (std::sscanf(value, "%ux%u", &physics.sectors.angularCount, &physics.sectors.radialCount) != 2)
+                { std::cerr << "--sector-grid expects AxR, got " << value << std::endl; return 1; }
+            }
+            else if (arg == "--sector-focus")
+            {
+                glm::dvec3& f = physics.sectors.focus;
+                if (std::sscanf(value, "%lf,%lf,%lf", &f.x, &f.y, &f.z) != 3)
+                { std::cerr << "--sector-focus expects X,Y,Z, got " << value << std::endl; return 1; }
+            }
+            else if (arg == "--load") loadPath = value;
+            else if (arg == "--save") savePath = value;
+            else if (arg == "--checkpoint") checkpoints.path = value;
+            else if (arg == "--checkpoint-every") checkpoints.interval = std::strtoul(value, nullptr, 10);
+            else if (arg == "--record") recordPath = value;
+            else if (arg == "--record-every") recordOptions.stepInterval = static_cast<unsigned int>(std::strtoul(value, nullptr, 10));
+            else if (arg == "--sweep") sweepPath = value;
+            else if (arg == "--sweep-out") sweepOutPath = value;
+            else if (arg == "--pareto") paretoPath = value;
+            else if (arg == "--pareto-bodies") paretoBodies = static_cast<unsigned int>(std::strtoul(value, nullptr, 10));
+            else if (arg == "--ephemeris") ephemerisPath = value;
+            else if (arg == "--write-ephemeris") writeEphemerisPath = value;
+            else if (arg == "--ephemeris-segment") ephemerisSegment = std::max(1ul, std::strtoul(value, nullptr, 10));
+            else if (arg == "--ephemeris-degree") ephemerisCoefficients = static_cast<unsigned int>(std::strtoul(value, nullptr, 10));
+            else if (arg == "--jobs") jobs = static_cast<unsigned int>(std::max(1, std::atoi(value)));
+            else if (arg == "--record-quantum") recordOptions.quantum = std::atof(value);
+            else if (arg == "--serve") { serveOptions.port = static_cast<uint16_t>(std::strtoul(value, nullptr, 10)); serve = true; }
+            else if (arg == "--serve-rate") serveOptions.rate = std::atof(value);
+            else if (arg == "--serve-quantum") serveOptions.quantum = std::atof(value);
+            else if (arg == "--shared-state") sharedStateName = value[0] == '/' ? value : std::string("/") + value;
+            else if (arg == "--shared-state-every") sharedStateEvery = std::max(1ul, std::strtoul(value, nullptr, 10));
+            else if (arg == "--scaling") scalingMode = value;
+            else if (arg == "--scaling-out") scalingOutPath = value;
+            else if (arg == "--out-of-core") outOfCorePath = value;
+            else if (arg == "--chunk-bodies") chunkBodies = std::max<size_t>(1, std::strtoull(value, nullptr, 10));
+            else if (arg == "--resort-every") resortEvery = static_cast<unsigned int>(std::strtoul(value, nullptr, 10));
+            else if (arg == "--solver")
+            {
+                if (!std::strcmp(value, "brute")) physics.solver = SOLVER_BRUTE_FORCE;
+                else if (!std::strcmp(value, "barnes-hut")) physics.solver = SOLVER_BARNES_HUT;
+                else if (!std::strcmp(value, "test-particles")) physics.solver = SOLVER_TEST_PARTICLES;
+                else if (!std::strcmp(value, "fmm")) physics.solver = SOLVER_FMM;
+                else if (!std::strcmp(value, "pm")) physics.solver = SOLVER_PARTICLE_MESH;
+                else { std::cerr << "unknown solver " << value << std::endl; return 1; }
+            }
+            else if (arg == "--force-law")
+            {
+                if (!std::strcmp(value, "newtonian")) physics.forceLaw = FORCE_NEWTONIAN;
+                else if (!std::strcmp(value, "plummer")) physics.forceLaw = FORCE_PLUMMER;
+                else if (!std::strcmp(value, "spline")) physics.forceLaw = FORCE_SPLINE;
+                else { std::cerr << "unknown force law " << value << std::endl; return 1; }
+            }
+            else if (arg == "--precision")
+            {
+                if (!std::strcmp(value, "float")) physics.forcePrecision = PRECISION_FLOAT;
+                else if (!std::strcmp(value, "double")) physics.forcePrecision = PRECISION_DOUBLE;
+                else if (!std::strcmp(value, "mixed")) physics.forcePrecision = PRECISION_MIXED;
+                else { std::cerr << "unknown precision " << value << std::endl; return 1; }
+            }
+            else if (arg == "--kernel")
+            {
+                if (!std::strcmp(value, "scalar")) physics.forceKernel = KERNEL_SCALAR;
+                else if (!std::strcmp(value, "avx2")) physics.forceKernel = KERNEL_AVX2;
+                else if (!std::strcmp(value, "avx512")) physics.forceKernel = KERNEL_AVX512;
+                else { std::cerr << "unknown kernel " << value << std::endl; return 1; }
+                if (!gravityKernelSupported(static_cast<GravityKernel>(physics.forceKernel)))
+                {
+                    std::cerr << value << " is not supported on this CPU" << std::endl;
+                    return 1;
+                }
+            }
+            else if (arg == "--pin")
+            {
+                if (!std::strcmp(value, "cores")) pinning = PIN_CORES;
+                else if (!std::strcmp(value, "nodes")) pinning = PIN_NODES;
+                else { std::cerr << "unknown pinning " << value << std::endl; return 1; }
+            }
+            else if (arg == "--huge-pages")
+            {
+                if (!std::strcmp(value, "2m")) bodyMemory().pages = BODY_PAGES_2M;
+                else if (!std::strcmp(value, "1g")) bodyMemory().pages = BODY_PAGES_1G;
+                else { std::cerr << "unknown huge page size " << value << std::endl; return 1; }
+            }
+            else if (arg == "--integrator")
+            {
+                if (!std::strcmp(value, "euler")) physics.integrator.type = INTEGRATOR_SEMI_IMPLICIT_EULER;
+                else if (!std::strcmp(value, "leapfrog")) physics.integrator.type = INTEGRATOR_LEAPFROG_KDK;
+                else if (!std::strcmp(value, "verlet")) physics.integrator.type = INTEGRATOR_VELOCITY_VERLET;
+                else if (!std::strcmp(value, "yoshida4")) physics.integrator.type = INTEGRATOR_YOSHIDA4;
+                else { std::cerr << "unknown integrator " << value << std::endl; return 1; }
+            }
+            else { std::cerr << "unknown option " << arg << std::endl; printUsage(argv[0]); return 1; }
+        }
+    }
+    if (dt <= 0.0f) { std::cerr << "dt must be positive" << std::endl; return 1; }
+    if (duration > 0.0) steps = static_cast<unsigned long>(std::ceil(duration / dt));
+    if (resume && checkpoints.path.empty()) { std::cerr << "--resume needs --checkpoint" << std::endl; return 1; }
+    if (!checkpoints.path.empty() && (!sweepPath.empty() || distributed || !scalingMode.empty())) {
+        std::cerr << "--checkpoint cannot be combined with --sweep, --distributed or --scaling" << std::endl;
+        return 1;
+    }
+    // the latest checkpoint stands in for whatever the run started from
+    if (resume && std::ifstream(checkpoints.path)) {
+        scenarioPath.clear();
+        loadPath = checkpoints.path;
+    }
+    if (!scenarioPath.empty() && (!sweepPath.empty() || distributed || !scalingMode.empty() || !loadPath.empty())) {
+        std::cerr << "--scenario cannot be combined with --sweep, --distributed, --scaling or --load" << std::endl;
+        return 1;
+    }
+    // before the worker pool starts, its threads inherit the counters
+    if (counters && !perfCounters().open())
+        std::cerr << "no hardware counters: " << perfCounters().error() << std::endl;
+    // before the first body is allocated, so first touch splits the arrays over the threads that will step them
+    bodyMemory().threads = static_cast<unsigned int>(physics.threads);
+    if (bodyMemory().firstTouch || pinning != PIN_NONE) {
+        workerPool().resize(static_cast<unsigned int>(physics.threads));
+        workerPool().pin(pinning);
+    }
+
+#ifdef NBODY_MPI
+    int ranks = 1;
+    MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+    if (!scalingMode.empty()) {
+        if (scalingMode != "strong" && scalingMode != "weak") { std::cerr << "unknown scaling " << scalingMode << std::endl; return 1; }
+        return runScaling(scalingMode == "weak", scenario, physics, steps, dt, scalingOutPath);
+    }
+    if (distributed) {
+        if (!recordPath.empty() || serve) {
+            std::cerr << "--distributed cannot be combined with --record or --serve" << std::endl;
+            return 1;
+        }
+        return runDistributed(physics, scenario, loadPath, savePath, steps, dt, reportEnergy);
+    }
+    if (ranks > 1) { std::cerr << "only --distributed and --scaling run on more than one rank" << std::endl; return 1; }
+#else
+    if (distributed || !scalingMode.empty()) {
+        std::cerr << "--distributed and --scaling need nbody_headless_mpi, built where CMake finds MPI" << std::endl;
+        return 1;
+    }
+#endif
+
+    if (!outOfCorePath.empty()) {
+        if (!loadPath.empty() || !savePath.empty() || !recordPath.empty() || serve || !sweepPath.empty() || !paretoPath.empty()
+            || !scenarioPath.empty() || !checkpoints.path.empty() || !ephemerisPath.empty() || !writeEphemerisPath.empty()) {
+            std::cerr << "--out-of-core runs the built-in belt from its files, it cannot be combined with --load, --save, --record, "
+                         "--serve, --sweep, --pareto, --scenario, --checkpoint or the ephemeris options" << std::endl;
+            return 1;
+        }
+        return runOutOfCore(physics, scenario, outOfCorePath, chunkBodies, resortEvery, steps, dt);
+    }
+
+    if (!paretoPath.empty()) {
+        if (!sweepPath.empty() || !loadPath.empty() || !savePath.empty() || !recordPath.empty() || serve || !scenarioPath.empty()) {
+            std::cerr << "--pareto runs its own scenarios, it cannot be combined with --sweep, --load, --save, --record, --serve or --scenario" << std::endl;
+            return 1;
+        }
+        return runPareto(physics.settings(), steps, dt, paretoBodies, scenario.seed, paretoPath);
+    }
+
+    if (!sweepPath.empty()) {
+        if (!loadPath.empty() || !savePath.empty() || !recordPath.empty() || serve) {
+            std::cerr << "--sweep starts every run from the scenario, it cannot be combined with --load, --save, --record or --serve" << std::endl;
+            return 1;
+        }
+        SweepSpec spec;
+        std::string error;
+        if (!spec.load(sweepPath.c_str(), error)) { std::cerr << error << std::endl; return 1; }
+        return runSweep(spec, scenario, physics.settings(), steps, dt, jobs, sweepOutPath);
+    }
+
+    if (!scenarioPath.empty()) {
+        ScenarioFile file;
+        std::string error;
+        if (!file.load(scenarioPath.c_str(), error)) { std::cerr << error << std::endl; return 1; }
+        // the generators fill the belt over the pool
+        workerPool().resize(static_cast<unsigned int>(physics.threads));
+        auto buildStart = std::chrono::steady_clock::now();
+        physics.initializeScenario(file);
+        if (!file.ephemeris.empty() && physics.ephemeris.empty()) { std::cerr << "cannot load ephemeris " << file.ephemeris << std::endl; return 1; }
+        std::cout << "generated " << file.bodyCount() << " bodies from " << scenarioPath << " in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count() << " ms" << std::endl;
+    } else if (loadPath.empty()) {
+        physics.initialize(scenario);
+    } else {
+        auto loadStart = std::chrono::steady_clock::now();
+        if (!physics.loadSnapshot(loadPath.c_str())) { std::cerr << "cannot load snapshot " << loadPath << std::endl; return 1; }
+        std::cout << "loaded " << loadPath << " (t = " << physics.simTime << ") in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count() << " ms" << std::endl;
+    }
+    workerPool().resize(static_cast<unsigned int>(physics.threads));
+    if (!writeEphemerisPath.empty())
+        return writeEphemeris(physics, steps, dt, ephemerisSegment, ephemerisCoefficients, writeEphemerisPath);
+    if (!ephemerisPath.empty() && !physics.loadEphemeris(ephemerisPath)) {
+        std::cerr << "cannot load ephemeris " << ephemerisPath << std::endl;
+        return 1;
+    }
+    if (!physics.ephemeris.empty())
+        std::cout << "ephemeris: " << physics.ephemerisBodies() << " bodies driven over t = " << physics.ephemeris.start
+                  << " to " << physics.ephemeris.end << std::endl;
+    if (resume && loadPath == checkpoints.path) {
+        steps = steps > physics.stepCount ? steps - physics.stepCount : 0;
+        std::cout << "resuming at step " << physics.stepCount << ", " << steps << " left" << std::endl;
+    }
+
+    std::cout << "bodies: " << physics.bodies.size() << ", steps: " << steps << ", dt: " << dt
+              << ", integrator: " << (physics.keplerAsteroids ? "keplerian" : physics.beltSectors ? "multi-rate sectors" :
+                                      physics.blockTimesteps ? "block timesteps" : integratorName(physics.integrator.type))
+              << ", threads: " << physics.threads << std::endl;
+
+    double initialEnergy = reportEnergy ? physics.totalEnergy() : 0.0;
+
+    TrajectoryRecorder recorder;
+    recordOptions.stepSize = dt;
+    if (!recordPath.empty() && !recorder.start(recordPath, physics.bodies, recordOptions)) {
+        std::cerr << "cannot record to " << recordPath << std::endl;
+        return 1;
+    }
+
+    StateServer server;
+    if (serve) {
+        if (!server.start(serveOptions)) { std::cerr << server.error() << std::endl; return 1; }
+        std::cout << "serving on UDP port " << serveOptions.port << " at " << serveOptions.rate << " Hz"
+                  << (stepsGiven ? "" : " until interrupted") << std::endl;
+        std::signal(SIGINT, onInterrupt);
+        std::signal(SIGTERM, onInterrupt);
+    }
+    SharedStateExport sharedState;
+    if (!sharedStateName.empty()) {
+        if (!sharedState.start(sharedStateName, physics.bodies.size())) { std::cerr << sharedState.error() << std::endl; return 1; }
+        sharedState.publish(physics.bodies, physics.simTime, physics.stepCount);
+        std::cout << "publishing to shared memory " << sharedStateName << " every " << sharedStateEvery << " steps" << std::endl;
+    }
+    const bool runForever = serve && !stepsGiven;
+
+    unsigned long long interactions = 0, sectorTargets = 0;
+    unsigned long stepsRun = 0;
+    // setup and the first touch of the arrays are not the steps' counts
+    perfCounters().clearRegions();
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long s = 0; (runForever || s < steps) && !interrupted; s++)
+    {
+        physics.step(dt);
+        recorder.capture(physics.bodies, physics.simTime, physics.stepCount);
+        interactions += physics.interactionsLastStep;
+        sectorTargets += physics.sectorTargetsLastStep;
+        stepsRun++;
+        checkpoints.step(physics.bodies, physics.snapshotInfo());
+        if (sharedState.running() && stepsRun % sharedStateEvery == 0)
+            sharedState.publish(physics.bodies, physics.simTime, physics.stepCount);
+        if (server.running()) {
+            // viewers watch in real time: a step per dt of wall time, or slower if the physics cannot keep up
+            const double now = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (server.due(now)) server.publish(physics.bodies, physics.simTime, now);
+            std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                      std::chrono::duration<double>((s + 1) * static_cast<double>(dt))));
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (checkpoints.enabled()) {
+        checkpoints.finish();
+        std::cout << "checkpoints: " << checkpoints.written() << " written, " << checkpoints.failed() << " failed, last in "
+                  << checkpoints.path << std::endl;
+    }
+    if (server.running()) {
+        std::cout << "served " << server.snapshotsPublished() << " snapshots, " << server.bytesSent() / (1024 * 1024) << " MB, "
+                  << server.sendFailures() << " datagrams refused" << std::endl;
+        server.stop();
+    }
+    if (sharedState.running()) {
+        std::cout << "published " << sharedState.framesPublished() << " frames to " << sharedState.name() << ", "
+                  << sharedState.objectBytes() / 1024 << " KB" << std::endl;
+        sharedState.stop();
+    }
+    if (!recordPath.empty()) {
+        recorder.stop();
+        std::cout << "recorded " << recorder.writtenFrames() << " frames (" << recorder.droppedFrames() << " dropped), "
+                  << recorder.writtenBytes() / 1024 << " KB" << std::endl;
+    }
+
+    std::cout << std::fixed << std::setprecision(3)
+              << "wall time: " << seconds << " s\n"
+              << "steps/sec: " << (seconds > 0.0 ? stepsRun / seconds : 0.0) << "\n"
+              << std::scientific << std::setprecision(3)
+              << "interactions/sec: " << (seconds > 0.0 ? interactions / seconds : 0.0) << std::endl;
+    if (physics.sectorsActive() && stepsRun > 0)
+        std::cout << "force targets/step: " << std::fixed << std::setprecision(1) << static_cast<double>(sectorTargets) / stepsRun
+                  << " of " << physics.bodies.size() << std::scientific << std::setprecision(3) << std::endl;
+    if (physics.collisions)
+        std::cout << "mergers: " << physics.mergers << ", bodies left: " << physics.bodies.size() << std::endl;
+    if (perfCounters().enabled())
+        printCounters(peakGflops, peakGbs);
+    if (physics.solver == SOLVER_FMM && physics.fmmValidationSample > 0)
+        std::cout << "fmm max relative error: " << physics.fmmError << std::endl;
+    if (physics.haveConserved)
+        std::cout << "conserved drift over " << physics.conservedReference.simTime << " to " << physics.conserved.simTime
+                  << ": energy " << relativeDrift(physics.conserved.total, physics.conservedReference.total)
+                  << ", momentum " << relativeDrift(physics.conserved.momentum, physics.conservedReference.momentum)
+                  << ", angular momentum " << relativeDrift(physics.conserved.angularMomentum, physics.conservedReference.angularMomentum)
+                  << std::endl;
+    if (reportEnergy && initialEnergy != 0.0)
+        std::cout << "relative energy error: " << (physics.totalEnergy() - initialEnergy) / std::abs(initialEnergy) << std::endl;
+    if (!savePath.empty()) {
+        SnapshotWriter writer;
+        writer.write(savePath, physics.bodies, physics.snapshotInfo());
+        writer.wait();
+        if (!writer.lastSucceeded()) { std::cerr << "cannot write snapshot " << savePath << std::endl; return 1; }
+    }
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+#ifdef NBODY_MPI
+    MPI_Init(&argc, &argv);
+    int rank = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    // every rank parses the same arguments and takes the same path, only the first one reports
+    if (rank != 0) std::cout.setstate(std::ios::failbit);
+    const int status = run(argc, argv);
+    MPI_Finalize();
+    return status;
+#else
+    return run(argc, argv);
+#endif
+}
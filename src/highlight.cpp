@@ -11,6 +11,7 @@
 #include <shader.h>
 #include <camera.h>
 #include <model.h>
+#include <selection_outline.h>
 
 #include <iostream>
 
@@ -19,10 +20,13 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
 unsigned int loadTexture(const char *path);
+void createSceneTarget(unsigned int framebuffer, GlTexture& color, GlTexture& depth, int width, int height);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+int frameWidth = SCR_WIDTH;
+int frameHeight = SCR_HEIGHT;
 
 // camera
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
@@ -56,6 +60,7 @@ int main()
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
+    glfwGetFramebufferSize(window, &frameWidth, &frameHeight);
 
     // tell GLFW to capture our mouse
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -71,15 +76,19 @@ int main()
     // configure global opengl state
     // -----------------------------
     glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LESS);
-    glEnable(GL_STENCIL_TEST);
-    glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-    glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+    glState().depthFunc(GL_LESS);
 
     // build and compile shaders
     // -------------------------
     Shader shader("../shaders/2.stencil_testing.vs", "../shaders/2.stencil_testing.fs");
-    Shader shaderSingleColor("../shaders/2.stencil_testing.vs", "../shaders/2.stencil_single_color.fs");
+    // the outline is worked out from the ids the cubes write while they are drawn, no second pass over them
+    SelectionOutline outline("../shaders.2/selection.flood.cs", "../shaders.2/fullscreen.vs", "../shaders.2/selection.outline.fs");
+
+    // the scene is drawn off screen so the ids can go next to its colour, then blitted to the window
+    unsigned int sceneFBO;
+    glGenFramebuffers(1, &sceneFBO);
+    GlTexture sceneColor(GPU_MEMORY_RENDER_TARGETS), sceneDepth(GPU_MEMORY_RENDER_TARGETS);
+    int sceneWidth = 0, sceneHeight = 0;
 
     // set up vertex data (and buffer(s)) and configure vertex attributes
     // ------------------------------------------------------------------
@@ -141,26 +150,26 @@ int main()
     unsigned int cubeVAO, cubeVBO;
     glGenVertexArrays(1, &cubeVAO);
     glGenBuffers(1, &cubeVBO);
-    glBindVertexArray(cubeVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+    glState().bindVertexArray(cubeVAO);
+    glState().bindBuffer(GL_ARRAY_BUFFER, cubeVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), &cubeVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    glBindVertexArray(0);
+    glState().bindVertexArray(0);
     // plane VAO
     unsigned int planeVAO, planeVBO;
     glGenVertexArrays(1, &planeVAO);
     glGenBuffers(1, &planeVBO);
-    glBindVertexArray(planeVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
+    glState().bindVertexArray(planeVAO);
+    glState().bindBuffer(GL_ARRAY_BUFFER, planeVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(planeVertices), &planeVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    glBindVertexArray(0);
+    glState().bindVertexArray(0);
 
     // load textures
     // -------------
@@ -188,72 +197,53 @@ int main()
 
         // render
         // ------
+        if (frameWidth != sceneWidth || frameHeight != sceneHeight)
+        {
+            sceneWidth = std::max(frameWidth, 1);
+            sceneHeight = std::max(frameHeight, 1);
+            createSceneTarget(sceneFBO, sceneColor, sceneDepth, sceneWidth, sceneHeight);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+        glViewport(0, 0, sceneWidth, sceneHeight);
+        outline.begin(sceneFBO, sceneWidth, sceneHeight);
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT); // don't forget to clear the stencil buffer!
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         // set uniforms
-        shaderSingleColor.use();
         glm::mat4 model = glm::mat4(1.0f);
         glm::mat4 view = camera.GetViewMatrix();
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        shaderSingleColor.setMat4("view", view);
-        shaderSingleColor.setMat4("projection", projection);
-
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)sceneWidth / (float)sceneHeight, 0.1f, 100.0f);
         shader.use();
         shader.setMat4("view", view);
         shader.setMat4("projection", projection);
 
-        // draw floor as normal, but don't write the floor to the stencil buffer, we only care about the containers. We set its mask to 0x00 to not write to the stencil buffer.
-        glStencilMask(0x00);
-        // floor
-        glBindVertexArray(planeVAO);
-        glBindTexture(GL_TEXTURE_2D, floorTexture);
+        // floor, not selected
+        glState().bindVertexArray(planeVAO);
+        glState().bindTexture(GL_TEXTURE_2D, floorTexture);
         shader.setMat4("model", glm::mat4(1.0f));
+        shader.setUInt("objectId", 0u);
         glDrawArrays(GL_TRIANGLES, 0, 6);
-        glBindVertexArray(0);
-
-        // 1st. render pass, draw objects as normal, writing to the stencil buffer
-        // --------------------------------------------------------------------
-        glStencilFunc(GL_ALWAYS, 1, 0xFF);
-        glStencilMask(0xFF);
-        // cubes
-        glBindVertexArray(cubeVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, cubeTexture);
+        glState().bindVertexArray(0);
+
+        // cubes, both selected
+        glState().bindVertexArray(cubeVAO);
+        glState().activeTexture(GL_TEXTURE0);
+        glState().bindTexture(GL_TEXTURE_2D, cubeTexture);
         model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
         shader.setMat4("model", model);
+        shader.setUInt("objectId", 1u);
         glDrawArrays(GL_TRIANGLES, 0, 36);
         model = glm::mat4(1.0f);
         model = glm::translate(model, glm::vec3(2.0f, 0.0f, 0.0f));
         shader.setMat4("model", model);
+        shader.setUInt("objectId", 2u);
         glDrawArrays(GL_TRIANGLES, 0, 36);
+        glState().bindVertexArray(0);
 
-        // 2nd. render pass: now draw slightly scaled versions of the objects, this time disabling stencil writing.
-        // Because the stencil buffer is now filled with several 1s. The parts of the buffer that are 1 are not drawn, thus only drawing 
-        // the objects' size differences, making it look like borders.
-        // -----------------------------------------------------------------------------------------------------------------------------
-        glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-        glStencilMask(0x00);
-        glDisable(GL_DEPTH_TEST);
-        shaderSingleColor.use();
-        float scale = 1.1f;
-        // cubes
-        glBindVertexArray(cubeVAO);
-        glBindTexture(GL_TEXTURE_2D, cubeTexture);
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
-        model = glm::scale(model, glm::vec3(scale, scale, scale));
-        shaderSingleColor.setMat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(2.0f, 0.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(scale, scale, scale));
-        shaderSingleColor.setMat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glStencilMask(0xFF);
-        glStencilFunc(GL_ALWAYS, 0, 0xFF);
-        glEnable(GL_DEPTH_TEST);
+        // the outlines around whatever wrote an id, then the frame to the window
+        outline.apply(sceneFBO);
+        glBlitNamedFramebuffer(sceneFBO, 0, 0, 0, sceneWidth, sceneHeight, 0, 0, frameWidth, frameHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
@@ -263,10 +253,14 @@ int main()
 
     // optional: de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
-    glDeleteVertexArrays(1, &cubeVAO);
-    glDeleteVertexArrays(1, &planeVAO);
-    glDeleteBuffers(1, &cubeVBO);
-    glDeleteBuffers(1, &planeVBO);
+    glState().deleteVertexArrays(1, &cubeVAO);
+    glState().deleteVertexArrays(1, &planeVAO);
+    glState().deleteBuffers(1, &cubeVBO);
+    glState().deleteBuffers(1, &planeVBO);
+    outline.release();
+    sceneColor.release();
+    sceneDepth.release();
+    glDeleteFramebuffers(1, &sceneFBO);
 
     glfwTerminate();
     return 0;
@@ -296,6 +290,8 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
     // make sure the viewport matches the new window dimensions; note that width and 
     // height will be significantly larger than specified on retina displays.
     glViewport(0, 0, width, height);
+    frameWidth = width;
+    frameHeight = height;
 }
 
 // glfw: whenever the mouse moves, this callback is called
@@ -347,7 +343,7 @@ unsigned int loadTexture(char const * path)
         else if (nrComponents == 4)
             format = GL_RGBA;
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
+        glState().bindTexture(GL_TEXTURE_2D, textureID);
         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -367,3 +363,20 @@ unsigned int loadTexture(char const * path)
     return textureID;
 }
 
+
+// the off-screen colour and depth of the scene at width x height, attached to framebuffer
+// ---------------------------------------------------------------------------------------
+void createSceneTarget(unsigned int framebuffer, GlTexture& color, GlTexture& depth, int width, int height)
+{
+    color.create(GL_TEXTURE_2D, "highlight scene color");
+    color.storage2D(1, GL_RGBA8, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    depth.create(GL_TEXTURE_2D, "highlight scene depth");
+    depth.storage2D(1, GL_DEPTH_COMPONENT24, width, height);
+    glState().bindTexture(GL_TEXTURE_2D, 0);
+    glNamedFramebufferTexture(framebuffer, GL_COLOR_ATTACHMENT0, color.id(), 0);
+    glNamedFramebufferTexture(framebuffer, GL_DEPTH_ATTACHMENT, depth.id(), 0);
+    if (glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::FRAMEBUFFER:: Scene framebuffer is not complete" << std::endl;
+}
@@ -137,11 +137,11 @@ int main()
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
     
-    glBindVertexArray(lightCubeVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glState().bindVertexArray(lightCubeVAO);
+    glState().bindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
     
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
     
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
@@ -236,7 +236,7 @@ int main()
         lightCubeShader.setMat4("view", view);
 
         // Draw Light Cube
-        glBindVertexArray(lightCubeVAO);
+        glState().bindVertexArray(lightCubeVAO);
         for (unsigned int i = 0; i < 4; i++)
         {
             model = glm::mat4(1.0f);
@@ -251,9 +251,9 @@ int main()
         glfwPollEvents();
     }    
 
-    glDeleteVertexArrays(1, &lightCubeVAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
+    glState().deleteVertexArrays(1, &lightCubeVAO);
+    glState().deleteBuffers(1, &VBO);
+    glState().deleteBuffers(1, &EBO);
 
     glfwTerminate();
     return 0;
@@ -364,7 +364,7 @@ unsigned int loadTexture(char const * path)
         else if (nrComponents == 4)
             format = GL_RGBA;
         
-        glBindTexture(GL_TEXTURE_2D, textureID);
+        glState().bindTexture(GL_TEXTURE_2D, textureID);
         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -0,0 +1,217 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm.hpp>
+#include <gtc/matrix_transform.hpp>
+#include <gtc/type_ptr.hpp>
+
+#include <camera.h>
+#include <model.h>
+#include <shader.h>
+#include <hiz.h>
+#include <meshlet_renderer.h>
+#include <gl_state_cache.h>
+
+#include <iostream>
+#include <string>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+// A large static model drawn as meshlets through GL_NV_mesh_shader (include/meshlet_renderer.h): the task stage
+// drops the clusters that are off screen, facing away or behind last frame's depth before any of their triangles
+// reach the rasterizer. Without the extension, or with --no-mesh-shaders, the model is drawn per mesh as usual.
+// WASD and the mouse fly the camera, escape quits.
+
+static const unsigned int SCR_WIDTH = 1600;
+static const unsigned int SCR_HEIGHT = 900;
+
+static Camera camera(glm::vec3(0.0f, 0.0f, 10.0f));
+static float lastX = SCR_WIDTH / 2.0f;
+static float lastY = SCR_HEIGHT / 2.0f;
+static bool firstMouse = true;
+
+static void framebuffer_size_callback(GLFWwindow*, int width, int height)
+{
+    glViewport(0, 0, width, height);
+}
+
+static void mouse_callback(GLFWwindow*, double xpos, double ypos)
+{
+    if (firstMouse)
+    {
+        lastX = static_cast<float>(xpos);
+        lastY = static_cast<float>(ypos);
+        firstMouse = false;
+    }
+    camera.ProcessMouseMovement(static_cast<float>(xpos) - lastX, lastY - static_cast<float>(ypos));
+    lastX = static_cast<float>(xpos);
+    lastY = static_cast<float>(ypos);
+}
+
+static void processInput(GLFWwindow* window, float deltaTime)
+{
+    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true);
+    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) camera.ProcessKeyboard(FORWARD, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) camera.ProcessKeyboard(BACKWARD, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) camera.ProcessKeyboard(LEFT, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) camera.ProcessKeyboard(RIGHT, deltaTime);
+}
+
+static void printUsage(const char* program)
+{
+    std::cout << "usage: " << program << " [options]\n"
+              << "  --model PATH         model to draw (default the buddha statue)\n"
+              << "  --no-mesh-shaders    draw through the vertex pipeline even where GL_NV_mesh_shader is available\n"
+              << "  --no-cones           keep meshlets that face away from the camera\n"
+              << "  --no-occlusion       keep meshlets behind last frame's depth\n";
+}
+
+int main(int argc, char** argv)
+{
+    std::string path = "../resources/objects/the_buddha_statue_in_a_mountain/the_buddha_statue_in_a_mountain.obj";
+    bool meshShaders = true;
+    bool coneCulling = true;
+    bool occlusion = true;
+    for (int a = 1; a < argc; a++)
+    {
+        const std::string arg = argv[a];
+        const bool hasValue = a + 1 < argc;
+        if (arg == "--help" || arg == "-h") { printUsage(argv[0]); return 0; }
+        else if (arg == "--model" && hasValue) path = argv[++a];
+        else if (arg == "--no-mesh-shaders") meshShaders = false;
+        else if (arg == "--no-cones") coneCulling = false;
+        else if (arg == "--no-occlusion") occlusion = false;
+        else { std::cerr << "unknown option " << arg << std::endl; printUsage(argv[0]); return 1; }
+    }
+
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Meshlets", NULL, NULL);
+    if (window == NULL)
+    {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetCursorPosCallback(window, mouse_callback);
+    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return -1;
+    }
+    if (meshShaders && !MeshShaders::load((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cout << "Meshlets: GL_NV_mesh_shader is not available, drawing through the vertex pipeline" << std::endl;
+        meshShaders = false;
+    }
+    glEnable(GL_DEPTH_TEST);
+
+    Shader* shader = new Shader("../shaders.2/structured.object.model.shader.vs", "../shaders.2/skinned.model.shader.fs");
+    MeshletRenderer* renderer = meshShaders
+        ? new MeshletRenderer("../shaders.2/meshlet.task", "../shaders.2/meshlet.mesh", "../shaders.2/skinned.model.shader.fs")
+        : nullptr;
+    HiZ* hiz = meshShaders && occlusion ? new HiZ("../shaders.2/hiz.downsample.cs") : nullptr;
+    Model* model = new Model(path, false, VERTEX_LAYOUT_FULL);
+
+    // the camera backs off to see the whole model, bounded by its meshlets' spheres
+    size_t meshletCount = 0, triangleCount = 0;
+    glm::vec3 lo(INFINITY), hi(-INFINITY);
+    for (const Mesh& mesh : model->meshes)
+    {
+        meshletCount += mesh.meshlets.meshlets.size();
+        for (const Meshlet& meshlet : mesh.meshlets.meshlets)
+        {
+            const glm::vec3 center(meshlet.center[0], meshlet.center[1], meshlet.center[2]);
+            lo = glm::min(lo, center - meshlet.radius);
+            hi = glm::max(hi, center + meshlet.radius);
+            triangleCount += meshlet.triangleCount;
+        }
+    }
+    if (meshletCount > 0)
+    {
+        const float extent = glm::length(hi - lo);
+        camera.Position = (lo + hi) * 0.5f + glm::vec3(0.0f, 0.0f, extent);
+        camera.MovementSpeed = std::max(extent * 0.25f, camera.MovementSpeed);
+    }
+    std::cout << "Meshlets: " << model->meshes.size() << " meshes, " << meshletCount << " meshlets over " << triangleCount
+              << " triangles" << std::endl;
+    if (renderer)
+        renderer->coneCulling = coneCulling;
+    const float farPlane = std::max(500.0f, glm::length(hi - lo) * 4.0f);
+
+    unsigned int uboMatrices;
+    glCreateBuffers(1, &uboMatrices);
+    labelObject(GL_BUFFER, uboMatrices, "Matrices block");
+    glNamedBufferStorage(uboMatrices, 2 * sizeof(glm::mat4), NULL, GL_DYNAMIC_STORAGE_BIT);
+    glState().bindBufferBase(GL_UNIFORM_BUFFER, 0, uboMatrices);
+
+    float lastFrame = static_cast<float>(glfwGetTime());
+    float fpsTime = lastFrame;
+    unsigned int frames = 0;
+    while (!glfwWindowShouldClose(window))
+    {
+        const float currentFrame = static_cast<float>(glfwGetTime());
+        const float deltaTime = currentFrame - lastFrame;
+        lastFrame = currentFrame;
+        processInput(window, deltaTime);
+
+        int width, height;
+        glfwGetFramebufferSize(window, &width, &height);
+        glClearColor(0.08f, 0.08f, 0.1f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        const glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), static_cast<float>(width) / std::max(height, 1), 0.1f, farPlane);
+        const glm::mat4 view = camera.GetViewMatrix();
+        glNamedBufferSubData(uboMatrices, 0, sizeof(glm::mat4), glm::value_ptr(projection));
+        glNamedBufferSubData(uboMatrices, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(view));
+
+        const glm::vec3 lightDirection = glm::vec3(view * glm::vec4(glm::normalize(glm::vec3(0.4f, 1.0f, 0.6f)), 0.0f));
+        shader->use();
+        shader->setVec3("lightDirection", lightDirection);
+        shader->setFloat("ambient", 0.25f);
+        if (renderer)
+        {
+            renderer->program().use();
+            renderer->program().setVec3("lightDirection", lightDirection);
+            renderer->program().setFloat("ambient", 0.25f);
+            renderer->draw(*model, glm::mat4(1.0f), camera.Position, hiz, *shader);
+            // this frame's depth culls the next one's meshlets
+            if (hiz)
+                hiz->capture(width, height, projection, glm::mat4(glm::mat3(view)), camera.Position);
+        }
+        else
+        {
+            shader->setMat4("model", glm::mat4(1.0f));
+            shader->setMat3("normalMatrix", glm::mat3(1.0f));
+            model->Draw(*shader);
+        }
+
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+
+        frames++;
+        if (currentFrame - fpsTime >= 2.0f)
+        {
+            std::cout << "Meshlets: " << (currentFrame - fpsTime) * 1000.0f / frames << " ms a frame";
+            if (renderer)
+                std::cout << ", " << renderer->visibleMeshlets() << " of " << renderer->submittedMeshlets() << " meshlets drawn";
+            std::cout << std::endl;
+            fpsTime = currentFrame;
+            frames = 0;
+        }
+    }
+
+    delete model;
+    delete hiz;
+    delete renderer;
+    delete shader;
+    glState().deleteBuffers(1, &uboMatrices);
+    glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,703 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <physics_world.h>
+#include <instance_data.h>
+#include <batch_transforms.h>
+#include <gpu_nbody.h>
+#include <sphere.h>
+#include <model.h>
+#include <rock_variants.h>
+#include <shader.h>
+#include <texture_image.h>
+#include <program_cache.h>
+#include <gl_state_cache.h>
+#include <perf_baseline.h>
+#include <perf_counters.h>
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <functional>
+#include <filesystem>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+#include <random>
+
+// Microbenchmarks of the engine's hot paths, google-benchmark style, so a regression shows up as a number. Each
+// case runs batches of iterations until one batch takes --min-time, then times --repetitions more batches of that
+// size and reports the median time per iteration. Physics, instance packing, model matrices, model import, mesh
+// reordering and meshlets, BVH queries, pose evaluation and texture decoding run without a window; the sphere,
+// texture and shader uploads and the GPU n-body step need a GL context and run in a hidden window, skipped with
+// --no-gl or when none can be created. Paths are relative to the build directory, like the viewer's. --save-baseline keeps every
+// repetition of every case for this machine, --compare checks a run against it and exits with 2 when a case got
+// significantly slower. --counters adds the hardware counters of the timed batches (perf_counters.h): IPC, and
+// cycles and last-level misses per item or per iteration.
+
+// keeps the compiler from dropping a result nothing reads
+template <typename T>
+static void keep(const T& value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+class Bench
+{
+public:
+    struct Result
+    {
+        std::string name;
+        unsigned long long iterations;
+        double median;      // ns per iteration
+        double min;
+        double max;
+        double items;       // processed per iteration, 0 when it does not apply
+        std::vector<double> samples;    // ns per iteration of each repetition
+        PerfReading counts;             // of the timed batches together, with --counters
+        unsigned long long countedIterations = 0;
+    };
+
+    double minTime = 0.2;
+    unsigned int repetitions = 5;
+    std::string filter;     // substring a case's name must contain
+    std::vector<Result> results;
+
+    bool wanted(const std::string& name) const { return filter.empty() || name.find(filter) != std::string::npos; }
+
+    void measure(const std::string& name, double items, const std::function<void()>& body)
+    {
+        if (!wanted(name))
+            return;
+        unsigned long long iterations = 1;
+        double seconds = batch(iterations, body);
+        while (seconds < minTime && iterations < (1ull << 30))
+        {
+            // aim a little past the target from the last batch's rate, at least doubling
+            const double scale = seconds > 0.0 ? minTime / seconds * 1.2 : 10.0;
+            iterations = std::max(iterations * 2, static_cast<unsigned long long>(iterations * std::min(scale, 100.0)));
+            seconds = batch(iterations, body);
+        }
+        std::vector<double> perIteration;
+        const PerfReading countsStart = perfCounters().read();
+        for (unsigned int r = 0; r < std::max(repetitions, 1u); r++)
+            perIteration.push_back(batch(iterations, body) * 1e9 / iterations);
+        const PerfReading counts = perfCounters().read() - countsStart;
+        std::sort(perIteration.begin(), perIteration.end());
+        Result result{name, iterations, perIteration[perIteration.size() / 2], perIteration.front(), perIteration.back(), items, perIteration,
+                      counts, iterations * std::max(repetitions, 1u)};
+        print(result);
+        results.push_back(result);
+    }
+
+    PerfSamples samples() const
+    {
+        PerfSamples out;
+        for (const Result& r : results)
+            out.add(r.name, r.samples);
+        return out;
+    }
+
+    bool writeJson(const std::string& path) const
+    {
+        std::ofstream out(path);
+        if (!out)
+            return false;
+        out << "{\"benchmarks\": [";
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const Result& r = results[i];
+            out << (i ? ",\n  " : "\n  ") << "{\"name\": \"" << r.name << "\", \"iterations\": " << r.iterations
+                << ", \"median_ns\": " << r.median << ", \"min_ns\": " << r.min << ", \"max_ns\": " << r.max;
+            if (r.items > 0.0)
+                out << ", \"items_per_second\": " << r.items * 1e9 / r.median;
+            if (perfCounters().enabled())
+            {
+                const double units = unitsCounted(r);
+                out << ", \"ipc\": " << r.counts.ipc() << ", \"cycles_per_item\": " << r.counts.value[PERF_CYCLES] / units
+                    << ", \"llc_misses_per_item\": " << r.counts.value[PERF_LLC_MISSES] / units;
+            }
+            out << "}";
+        }
+        out << "\n]}\n";
+        return static_cast<bool>(out);
+    }
+
+    static void printHeader()
+    {
+        const bool counters = perfCounters().enabled();
+        std::cout << std::left << std::setw(64) << "benchmark" << std::right << std::setw(14) << "time" << std::setw(12)
+                  << "iterations" << std::setw(16) << "items/s";
+        if (counters)
+            std::cout << std::setw(8) << "IPC" << std::setw(14) << "cycles/item" << std::setw(12) << "LLC/item";
+        std::cout << '\n' << std::string(counters ? 140 : 106, '-') << '\n';
+    }
+
+private:
+    // items over the timed batches, or iterations for a case without items
+    static double unitsCounted(const Result& r)
+    {
+        return static_cast<double>(r.countedIterations) * (r.items > 0.0 ? r.items : 1.0);
+    }
+
+    static double batch(unsigned long long iterations, const std::function<void()>& body)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (unsigned long long i = 0; i < iterations; i++)
+            body();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    static std::string duration(double ns)
+    {
+        std::ostringstream text;
+        text << std::fixed << std::setprecision(ns < 10e3 ? 1 : 3);
+        if (ns < 10e3) text << ns << " ns";
+        else if (ns < 10e6) text << ns * 1e-3 << " us";
+        else text << ns * 1e-6 << " ms";
+        return text.str();
+    }
+
+    static void print(const Result& r)
+    {
+        std::cout << std::left << std::setw(64) << r.name << std::right << std::setw(14) << duration(r.median)
+                  << std::setw(12) << r.iterations;
+        if (r.items > 0.0)
+        {
+            std::ostringstream rate;
+            rate << std::fixed << std::setprecision(2) << r.items * 1e3 / r.median << " M/s";
+            std::cout << std::setw(16) << rate.str();
+        }
+        else if (perfCounters().enabled())
+        {
+            std::cout << std::setw(16) << "";
+        }
+        if (perfCounters().enabled())
+        {
+            const double units = unitsCounted(r);
+            std::ostringstream counts;
+            counts << std::fixed << std::setprecision(2) << std::setw(8) << r.counts.ipc()
+                   << std::setw(14) << r.counts.value[PERF_CYCLES] / units
+                   << std::setprecision(3) << std::setw(12) << r.counts.value[PERF_LLC_MISSES] / units;
+            std::cout << counts.str();
+        }
+        std::cout << std::endl;
+    }
+};
+
+static const unsigned int BODY_COUNTS[] = {1000, 10000, 100000};
+static const float STEP = 1.0f / 120.0f;
+
+static void initializeWorld(PhysicsWorld& world, unsigned int asteroids)
+{
+    ScenarioConfig scenario;
+    scenario.asteroidAmount = asteroids;
+    scenario.seed = 1;
+    world.initialize(scenario);
+}
+
+// one step of each CPU solver, with asteroid self-gravity since that is where they differ
+static void physicsCases(Bench& bench)
+{
+    const struct { const char* name; int solver; } solvers[] = {
+        {"brute", SOLVER_BRUTE_FORCE}, {"barnes-hut", SOLVER_BARNES_HUT}, {"fmm", SOLVER_FMM}, {"pm", SOLVER_PARTICLE_MESH},
+        {"test-particles", SOLVER_TEST_PARTICLES}};
+    for (unsigned int n : BODY_COUNTS)
+        for (const auto& solver : solvers)
+        {
+            const std::string name = std::string("PhysicsWorld::step/") + solver.name + "/" + std::to_string(n);
+            if (!bench.wanted(name))
+                continue;
+            PhysicsWorld world;
+            world.solver = solver.solver;
+            world.asteroidSelfGravity = true;
+            initializeWorld(world, n);
+            bench.measure(name, n, [&]() { world.step(STEP); });
+        }
+}
+
+// what the viewer does per asteroid per frame in place of building a model matrix: the full and the quantized record
+static void packingCases(Bench& bench)
+{
+    for (unsigned int n : BODY_COUNTS)
+    {
+        const std::string fullName = "packInstance/" + std::to_string(n);
+        const std::string quantizedName = "QuantizedInstanceWriter/" + std::to_string(n);
+        if (!bench.wanted(fullName) && !bench.wanted(quantizedName))
+            continue;
+        PhysicsWorld world;
+        initializeWorld(world, n);
+        const BodyStore& bodies = world.bodies;
+        const BodyRange asteroids = bodies.range(BODY_ASTEROID);
+        const glm::dvec3 camera(0.0, 20.0, 150.0);
+        std::vector<AsteroidInstance> instances(asteroids.size());
+        bench.measure(fullName, n, [&]() {
+            for (size_t i = asteroids.begin; i < asteroids.end; i++)
+                instances[i - asteroids.begin] = packInstance(bodies, i, glm::vec3(bodies.position[i] - camera));
+            keep(instances);
+        });
+        std::vector<QuantizedInstance> records(asteroids.size());
+        std::vector<InstanceChunk> chunks((asteroids.size() + INSTANCE_CHUNK - 1) / INSTANCE_CHUNK);
+        bench.measure(quantizedName, n, [&]() {
+            QuantizedInstanceWriter writer(records.data(), chunks.data());
+            for (size_t i = asteroids.begin; i < asteroids.end; i++)
+                writer.add(bodies, i, glm::vec3(bodies.position[i] - camera));
+            writer.finish(bodies);
+            keep(records);
+        });
+    }
+}
+
+// model matrices of every asteroid: glm's translate * mat4_cast * scale against batch_transforms.h
+static void transformCases(Bench& bench)
+{
+    for (unsigned int n : BODY_COUNTS)
+    {
+        const std::string glmName = "modelMatrix.glm/" + std::to_string(n);
+        const std::string batchName = "composeTransforms/" + std::to_string(n);
+        if (!bench.wanted(glmName) && !bench.wanted(batchName))
+            continue;
+        PhysicsWorld world;
+        initializeWorld(world, n);
+        const BodyStore& bodies = world.bodies;
+        const BodyRange asteroids = bodies.range(BODY_ASTEROID);
+        const glm::dvec3 camera(0.0, 20.0, 150.0);
+        std::vector<glm::mat4> matrices(asteroids.size());
+        bench.measure(glmName, n, [&]() {
+            for (size_t i = asteroids.begin; i < asteroids.end; i++) {
+                const BodyRenderData& r = bodies.render[i];
+                matrices[i - asteroids.begin] = glm::translate(glm::mat4(1.0f), glm::vec3(bodies.position[i] - camera)) *
+                                                glm::mat4_cast(r.orientation) * glm::scale(glm::mat4(1.0f), glm::vec3(r.radiusScale));
+            }
+            keep(matrices);
+        });
+        TransformBatch batch;
+        bench.measure(batchName, n, [&]() {
+            batch.clear();
+            for (size_t i = asteroids.begin; i < asteroids.end; i++)
+                batch.push(glm::vec3(bodies.position[i] - camera), bodies.render[i].orientation, bodies.render[i].radiusScale);
+            composeTransforms(batch, 0, batch.size(), matrices.data());
+            keep(matrices);
+        });
+    }
+}
+
+// every .obj, .glb and .gltf under resources/objects, relative to it
+static std::vector<std::string> modelAssets(const std::string& root)
+{
+    std::vector<std::string> assets;
+    std::error_code error;
+    for (std::filesystem::recursive_directory_iterator it(root, error), end; !error && it != end; it.increment(error))
+        if (it->is_regular_file() && (it->path().extension() == ".obj" || gltf::isGltfPath(it->path().string())))
+            assets.push_back(std::filesystem::relative(it->path(), root).generic_string());
+    std::sort(assets.begin(), assets.end());
+    return assets;
+}
+
+// importModel as the viewer calls it, which reads the cooked cache once the first import wrote it, and the Assimp
+// import the cache replaces, and for glTF the native reader next to it
+static void importCases(Bench& bench, const std::string& root)
+{
+    for (const std::string& asset : modelAssets(root))
+    {
+        const std::string path = root + "/" + asset;
+        bench.measure("importModel/" + asset, 0.0, [&]() {
+            ModelData data = importModel(path);
+            keep(data);
+        });
+        bench.measure("Assimp::ReadFile/" + asset, 0.0, [&]() {
+            Assimp::Importer importer;
+            const aiScene* scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
+            std::vector<ImportedMesh> meshes;
+            std::vector<ImportedNode> nodes;
+            if (scene && scene->mRootNode)
+                model_import::processNode(scene->mRootNode, scene, meshes, nodes);
+            keep(meshes);
+        });
+        if (!gltf::isGltfPath(path))
+            continue;
+        bench.measure("gltf::importGltf/" + asset, 0.0, [&]() {
+            std::vector<ImportedMesh> meshes;
+            std::vector<ImportedNode> nodes;
+            gltf::importGltf(path, meshes, nodes);
+            keep(meshes);
+        });
+    }
+}
+
+// the triangle BVH of every mesh of a model: its build, and rays from around the model at its centre, one at a
+// time and 8 to a packet (AVX2 when the CPU has it, the scalar fallback separately)
+static void bvhCases(Bench& bench, const std::string& root)
+{
+    for (const std::string& asset : modelAssets(root))
+    {
+        ModelData data = importModel(root + "/" + asset);
+        if (data.meshes.empty())
+            continue;
+        ImportedMesh& mesh = data.meshes.front();
+        bench.measure("MeshBvh::build/" + asset, static_cast<double>(mesh.indices.size() / 3), [&]() {
+            MeshBvh bvh;
+            bvh.build(mesh.vertices, mesh.indices);
+            keep(bvh);
+        });
+        glm::vec3 boundsMin(0.0f), boundsMax(0.0f);
+        float radius = 0.0f;
+        vertexBounds(mesh.vertices, boundsMin, boundsMax, radius);
+        const glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+        std::vector<BvhRay> rays(1024);
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        for (size_t r = 0; r < rays.size(); r += BvhRayPacket::SIZE)
+        {
+            // packets of neighbouring rays, as a pick or the segments of nearby rocks would be
+            const glm::vec3 from = center + glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng))) * radius * 2.0f;
+            for (size_t k = r; k < r + BvhRayPacket::SIZE; k++)
+            {
+                const glm::vec3 target = center + glm::vec3(unit(rng), unit(rng), unit(rng)) * radius * 0.05f;
+                rays[k] = BvhRay{from, target - from, 2.0f};
+            }
+        }
+        const MeshBvh& bvh = mesh.bvh;
+        bench.measure("MeshBvh::intersect/ray/" + asset, static_cast<double>(rays.size()), [&]() {
+            for (const BvhRay& ray : rays)
+            {
+                BvhHit hit;
+                bvh.intersect(ray, hit);
+                keep(hit);
+            }
+        });
+        auto packets = [&](bool simd) {
+            for (size_t r = 0; r < rays.size(); r += BvhRayPacket::SIZE)
+            {
+                BvhRayPacket packet;
+                for (unsigned int lane = 0; lane < BvhRayPacket::SIZE; lane++)
+                    packet.set(lane, rays[r + lane]);
+                if (simd)
+                    bvh.intersect(packet);
+                else
+                    bvh.intersectPacketScalar(packet);
+                keep(packet);
+            }
+        };
+        if (bvhPacketSimdSupported())
+            bench.measure("MeshBvh::intersect/packet/" + asset, static_cast<double>(rays.size()), [&]() { packets(true); });
+        bench.measure("MeshBvh::intersect/packet-scalar/" + asset, static_cast<double>(rays.size()), [&]() { packets(false); });
+    }
+}
+
+// the import's reordering of the first mesh of every model (already in that order, which costs the same), its
+// meshlets and the deformation of a rock variant
+static void optimizeCases(Bench& bench, const std::string& root)
+{
+    for (const std::string& asset : modelAssets(root))
+    {
+        ModelData data = importModel(root + "/" + asset);
+        if (data.meshes.empty())
+            continue;
+        const ImportedMesh& mesh = data.meshes.front();
+        bench.measure("optimizeMesh/" + asset, static_cast<double>(mesh.indices.size() / 3), [&]() {
+            std::vector<Vertex> vertices = mesh.vertices;
+            std::vector<unsigned int> indices = mesh.indices;
+            optimizeMesh(vertices, indices);
+            keep(indices);
+        });
+        bench.measure("buildMeshlets/" + asset, static_cast<double>(mesh.indices.size() / 3), [&]() {
+            MeshletSet meshlets = buildMeshlets(mesh.vertices, mesh.indices);
+            keep(meshlets.meshlets);
+        });
+        bench.measure("deformRock/" + asset, static_cast<double>(mesh.vertices.size()), [&]() {
+            std::vector<Vertex> vertices = mesh.vertices;
+            deformRock(vertices, 1);
+            keep(vertices);
+        });
+    }
+}
+
+// the bone palettes of a crowd of the rigged model, on the worker pool and on the calling thread alone
+static void poseCases(Bench& bench, const std::string& path)
+{
+    ModelData data = importModel(path);
+    if (data.skeleton.empty() || data.animations.empty())
+        return;
+    const size_t bones = data.skeleton.boneCount();
+    PoseEvaluator evaluator;
+    for (size_t n : {16, 256, 1024})
+    {
+        std::vector<PoseRequest> requests(n);
+        for (size_t k = 0; k < n; k++)
+            requests[k] = PoseRequest{0, 0.013f * static_cast<float>(k)};
+        std::vector<glm::mat4> palettes(n * bones);
+        bench.measure("PoseEvaluator::evaluate/" + std::to_string(n), static_cast<double>(n), [&]() {
+            evaluator.evaluate(data.skeleton, data.animations, requests.data(), n, palettes.data());
+            keep(palettes.back());
+        });
+        bench.measure("PoseEvaluator::evaluate/serial/" + std::to_string(n), static_cast<double>(n), [&]() {
+            evaluator.evaluate(data.skeleton, data.animations, requests.data(), n, palettes.data(), nullptr);
+            keep(palettes.back());
+        });
+    }
+}
+
+// world matrices of a two-level hierarchy, n children under 64 parents: everything after a parent moved, and
+// one child alone
+static void sceneGraphCases(Bench& bench)
+{
+    for (unsigned int n : BODY_COUNTS)
+    {
+        SceneGraph graph;
+        std::vector<uint32_t> parents, children;
+        for (unsigned int p = 0; p < 64; p++)
+            parents.push_back(graph.add(glm::translate(glm::mat4(1.0f), glm::vec3(static_cast<float>(p), 0.0f, 0.0f))));
+        for (unsigned int c = 0; c < n; c++)
+            children.push_back(graph.add(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, static_cast<float>(c), 0.0f)), parents[c % 64]));
+        graph.update();
+        float angle = 0.0f;
+        bench.measure("SceneGraph::update/all/" + std::to_string(n), n, [&]() {
+            angle += 0.01f;
+            for (uint32_t p : parents)
+                graph.setLocal(p, glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f, 1.0f, 0.0f)));
+            graph.update();
+        });
+        bench.measure("SceneGraph::update/one/" + std::to_string(n), 1, [&]() {
+            angle += 0.01f;
+            graph.setLocal(children[n / 2], glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f, 1.0f, 0.0f)));
+            graph.update();
+        });
+    }
+}
+
+static const char* TEXTURE_DIRECTORIES[] = {"../resources/objects/planet", "../resources/objects/rock"};
+static const char* TEXTURE_FILES[] = {"mars.png", "rock.png"};
+
+static void decodeCases(Bench& bench)
+{
+    for (size_t t = 0; t < 2; t++)
+    {
+        const std::string path = std::string(TEXTURE_DIRECTORIES[t]) + "/" + TEXTURE_FILES[t];
+        bench.measure(std::string("DecodeTextureFile/") + TEXTURE_FILES[t], 0.0, [&]() {
+            DecodedImage image = DecodeTextureFile(path);
+            freeImage(image);
+        });
+    }
+}
+
+// the rest needs a context; GL objects are deleted inside the timed loop, their deletion is part of the number
+static void sphereCases(Bench& bench)
+{
+    for (unsigned int sectors : {18u, 36u, 72u, 144u, 288u})
+    {
+        const unsigned int stacks = sectors / 2;
+        bench.measure("SphereCreator::CreateSphere/" + std::to_string(sectors) + "x" + std::to_string(stacks), 0.0, [&]() {
+            Mesh sphere = SphereCreator::CreateSphere(1.0f, sectors, stacks);
+            sphere.releaseGpuData();
+        });
+    }
+    for (unsigned int subdivisions = 2; subdivisions <= 6; subdivisions++)
+        bench.measure("SphereCreator::CreateIcosphere/" + std::to_string(subdivisions), 0.0, [&]() {
+            Mesh sphere = SphereCreator::CreateIcosphere(1.0f, subdivisions);
+            sphere.releaseGpuData();
+        });
+}
+
+static void textureCases(Bench& bench)
+{
+    for (size_t t = 0; t < 2; t++)
+        bench.measure(std::string("TextureFromFile/") + TEXTURE_FILES[t], 0.0, [&]() {
+            const unsigned int texture = TextureFromFile(TEXTURE_FILES[t], TEXTURE_DIRECTORIES[t], false);
+            glState().deleteTextures(1, &texture);
+            glFinish();
+        });
+}
+
+// GLSL compiled and linked with the program cache off, then loaded from it. Drivers keep caches of their own, so
+// the compile is only cold on the first run after a driver or shader change.
+static void shaderCases(Bench& bench)
+{
+    const struct { const char* name; const char* vertex; const char* fragment; } programs[] = {
+        {"planet", "../shaders.2/structured.object.model.shader.vs", "../shaders.2/2.instanced.object.model.shader.fs"},
+        {"asteroids", "../shaders.2/compact.instanced.object.model.shader.vs", "../shaders.2/2.instanced.object.model.shader.fs"},
+        {"skybox", "../shaders.2/structured.skybox.vs", "../shaders.2/6.1.skybox.fs"}};
+    for (const auto& program : programs)
+    {
+        for (bool cached : {false, true})
+        {
+            program_cache::enabled() = cached;
+            if (cached)
+            {
+                Shader primed(program.vertex, program.fragment);
+                glState().deleteProgram(primed.ID);
+            }
+            bench.measure(std::string("Shader/") + program.name + (cached ? "/cached" : "/compile"), 0.0, [&]() {
+                Shader shader(program.vertex, program.fragment);
+                glGetError();   // waits for the link like the first use would
+                glState().deleteProgram(shader.ID);
+            });
+        }
+    }
+    for (bool cached : {false, true})
+    {
+        program_cache::enabled() = cached;
+        bench.measure(std::string("Shader/nbody.force/") + (cached ? "cached" : "compile"), 0.0, [&]() {
+            Shader shader("../shaders.2/nbody.force.cs");
+            glGetError();
+            glState().deleteProgram(shader.ID);
+        });
+    }
+    program_cache::enabled() = true;
+}
+
+// the GPU backend's step, waited for so the GPU's time is what is measured
+static void gpuPhysicsCases(Bench& bench)
+{
+    for (unsigned int n : BODY_COUNTS)
+    {
+        const std::string name = "GpuNBody::step/" + std::to_string(n);
+        if (!bench.wanted(name))
+            continue;
+        PhysicsWorld world;
+        initializeWorld(world, n);
+        GpuNBody nbody("../shaders.2/nbody.force.cs", "../shaders.2/nbody.drift.cs");
+        nbody.upload(world.bodies);
+        bench.measure(name, n, [&]() {
+            nbody.step(STEP, world.G, world.epsilonSq, true);
+            glFinish();
+        });
+    }
+}
+
+static GLFWwindow* createHiddenContext()
+{
+    if (!glfwInit())
+        return nullptr;
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(64, 64, "microbench", NULL, NULL);
+    if (window == NULL)
+    {
+        glfwTerminate();
+        return nullptr;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return nullptr;
+    }
+    return window;
+}
+
+static void printUsage(const char* program)
+{
+    std::cout << "usage: " << program << " [options]\n"
+              << "  --filter TEXT        only the cases whose name contains TEXT\n"
+              << "  --min-time S         seconds a timed batch takes at least (default 0.2)\n"
+              << "  --repetitions N      timed batches per case, the median is reported (default 5)\n"
+              << "  --json PATH          also write the results as JSON\n"
+              << "  --no-gl              skip the cases that need a GL context\n"
+              << "  --save-baseline      store the results as this machine's baseline\n"
+              << "  --compare            compare against this machine's baseline, exit 2 on a significant slowdown\n"
+              << "  --baseline-dir DIR   where baselines are kept (default baselines)\n"
+              << "  --machine NAME       the baseline's machine (default: the host name)\n"
+              << "  --threshold X        relative slowdown below which nothing is flagged (default 0.03)\n"
+              << "  --counters           hardware counters of the timed batches: IPC, cycles and LLC misses per item\n"
+              << "  use 10 or more repetitions for a baseline, the intervals come from them\n";
+}
+
+int main(int argc, char** argv)
+{
+    Bench bench;
+    std::string jsonPath;
+    bool gl = true;
+    bool saveBaseline = false, compare = false, counters = false;
+    std::string baselineDir = "baselines", machine = perfMachineName();
+    PerfCompareOptions compareOptions;
+    for (int a = 1; a < argc; a++)
+    {
+        std::string arg = argv[a];
+        bool hasValue = a + 1 < argc;
+        const char* value = hasValue ? argv[a + 1] : "";
+        if (arg == "--help" || arg == "-h") { printUsage(argv[0]); return 0; }
+        else if (arg == "--no-gl") gl = false;
+        else if (arg == "--save-baseline") saveBaseline = true;
+        else if (arg == "--compare") compare = true;
+        else if (arg == "--counters") counters = true;
+        else if (!hasValue) { std::cerr << "missing value for " << arg << std::endl; return 1; }
+        else
+        {
+            a++;
+            if (arg == "--filter") bench.filter = value;
+            else if (arg == "--min-time") bench.minTime = std::max(0.0, std::atof(value));
+            else if (arg == "--repetitions") bench.repetitions = static_cast<unsigned int>(std::max(1, std::atoi(value)));
+            else if (arg == "--json") jsonPath = value;
+            else if (arg == "--baseline-dir") baselineDir = value;
+            else if (arg == "--machine") machine = value;
+            else if (arg == "--threshold") compareOptions.threshold = std::max(0.0, std::atof(value));
+            else { std::cerr << "unknown option " << arg << std::endl; printUsage(argv[0]); return 1; }
+        }
+    }
+
+    // before the solvers start the worker pool, its threads inherit the counters
+    if (counters && !perfCounters().open())
+        std::cerr << "no hardware counters: " << perfCounters().error() << std::endl;
+    Bench::printHeader();
+    physicsCases(bench);
+    packingCases(bench);
+    transformCases(bench);
+    sceneGraphCases(bench);
+    importCases(bench, "../resources/objects");
+    bvhCases(bench, "../resources/objects");
+    optimizeCases(bench, "../resources/objects");
+    poseCases(bench, "../resources/objects/objects/vampire/dancing_vampire.dae");
+    decodeCases(bench);
+
+    GLFWwindow* window = gl ? createHiddenContext() : nullptr;
+    if (window)
+    {
+        sphereCases(bench);
+        textureCases(bench);
+        shaderCases(bench);
+        gpuPhysicsCases(bench);
+        textureCache().releaseAll();
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
+    else if (gl)
+    {
+        std::cout << "no GL 4.6 context, the GL cases were skipped" << std::endl;
+    }
+
+    if (!jsonPath.empty() && !bench.writeJson(jsonPath))
+    {
+        std::cerr << "cannot write " << jsonPath << std::endl;
+        return 1;
+    }
+    const std::string baselinePath = perfBaselinePath(baselineDir, machine, "microbench");
+    unsigned int regressions = 0;
+    if (compare)
+    {
+        PerfSamples baseline;
+        if (!baseline.load(baselinePath))
+        {
+            std::cerr << "no baseline at " << baselinePath << std::endl;
+            return 1;
+        }
+        std::cout << "\nagainst " << baselinePath << ":\n";
+        regressions = printPerfComparison(std::cout, comparePerf(baseline, bench.samples(), compareOptions), "ns");
+    }
+    if (saveBaseline)
+    {
+        if (!bench.samples().save(baselinePath))
+        {
+            std::cerr << "cannot write " << baselinePath << std::endl;
+            return 1;
+        }
+        std::cout << "saved " << baselinePath << std::endl;
+    }
+    return regressions > 0 ? 2 : 0;
+}
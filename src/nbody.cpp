@@ -0,0 +1,413 @@
+// The C interface of nbody.h over PhysicsWorld. Nothing here loops over bodies except to copy whole arrays, and no
+// exception crosses into the caller: each entry point catches them and turns them into a status.
+#include <nbody.h>
+
+#include <physics_world.h>
+#include <snapshot.h>
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <string>
+
+static_assert(sizeof(glm::dvec3) == 3 * sizeof(double), "positions are passed as packed x y z doubles");
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "accelerations are passed as packed x y z floats");
+
+struct nbody_world
+{
+    PhysicsWorld physics;
+    mutable std::string error;      // the last failure, for nbody_error
+};
+
+namespace {
+
+int fail(const nbody_world* world, int status, const char* message)
+{
+    if (world)
+        world->error = message;
+    return status;
+}
+
+// runs body and maps what it throws onto a status
+template <typename F>
+int guarded(const nbody_world* world, F&& body)
+{
+    try {
+        return body();
+    } catch (const std::bad_alloc&) {
+        return fail(world, NBODY_ERROR_MEMORY, "out of memory");
+    } catch (const std::exception& e) {
+        return fail(world, NBODY_ERROR_ARGUMENT, e.what());
+    }
+}
+
+nbody_settings toSettings(const PhysicsSettings& s)
+{
+    nbody_settings out;
+    out.struct_size = sizeof(nbody_settings);
+    out.G = s.G;
+    out.softening_sq = s.epsilonSq;
+    out.solver = s.solver;
+    out.theta = s.theta;
+    out.integrator = s.integrator;
+    out.threads = s.threads;
+    out.asteroid_self_gravity = s.asteroidSelfGravity;
+    out.collisions = s.collisions;
+    out.morton_sort = s.mortonSort;
+    out.block_timesteps = s.blockTimesteps;
+    out.kepler_asteroids = s.keplerAsteroids;
+    out.fmm_order = s.fmmOrder;
+    out.fmm_theta = s.fmmTheta;
+    return out;
+}
+
+const char* invalidSetting(const nbody_settings& s)
+{
+    if (s.solver < NBODY_SOLVER_BRUTE_FORCE || s.solver > NBODY_SOLVER_PARTICLE_MESH) return "unknown solver";
+    if (s.integrator < NBODY_INTEGRATOR_EULER || s.integrator > NBODY_INTEGRATOR_YOSHIDA4) return "unknown integrator";
+    if (s.threads < 1) return "threads must be at least 1";
+    if (!(s.theta >= 0.0f) || !(s.fmm_theta > 0.0f)) return "opening angles must be positive";
+    if (!(s.softening_sq >= 0.0f)) return "softening must not be negative";
+    if (s.fmm_order < 1 || s.fmm_order > FastMultipole::MAX_ORDER) return "fmm_order out of range";
+    return nullptr;
+}
+
+void applyTo(PhysicsWorld& physics, const nbody_settings& in)
+{
+    PhysicsSettings s = physics.settings();
+    s.G = in.G;
+    s.epsilonSq = in.softening_sq;
+    s.solver = in.solver;
+    s.theta = in.theta;
+    s.integrator = static_cast<IntegratorType>(in.integrator);
+    s.threads = in.threads;
+    s.asteroidSelfGravity = in.asteroid_self_gravity != 0;
+    s.collisions = in.collisions != 0;
+    s.mortonSort = in.morton_sort != 0;
+    s.blockTimesteps = in.block_timesteps != 0;
+    s.keplerAsteroids = in.kepler_asteroids != 0;
+    s.fmmOrder = in.fmm_order;
+    s.fmmTheta = in.fmm_theta;
+    physics.applySettings(s);
+}
+
+// the fields of what the caller passed that its struct_size covers, over base for the rest
+template <typename T>
+bool overlay(T& base, const T* in)
+{
+    if (in->struct_size < sizeof(uint32_t))
+        return false;
+    std::memcpy(&base, in, std::min<size_t>(in->struct_size, sizeof(T)));
+    base.struct_size = sizeof(T);
+    return true;
+}
+
+template <typename T, typename A>
+void copyOut(const std::vector<T, A>& v, void* out)
+{
+    if (!v.empty())
+        std::memcpy(out, v.data(), v.size() * sizeof(T));
+}
+
+}
+
+extern "C" {
+
+uint32_t nbody_api_version(void)
+{
+    return NBODY_API_VERSION;
+}
+
+void nbody_default_settings(nbody_settings* settings)
+{
+    if (settings)
+        *settings = toSettings(PhysicsWorld().settings());
+}
+
+void nbody_default_scenario(nbody_scenario* scenario)
+{
+    if (!scenario)
+        return;
+    ScenarioConfig c;
+    scenario->struct_size = sizeof(nbody_scenario);
+    scenario->sun_mass = c.sunMass;
+    scenario->planet_mass = c.planetMass;
+    scenario->planet_orbit_radius = c.planetOrbitRadius;
+    scenario->asteroid_count = c.asteroidAmount;
+    scenario->asteroid_mass = c.avgAsteroidMass;
+    scenario->belt_inner_radius = c.asteroidBeltInnerRadius;
+    scenario->belt_outer_radius = c.asteroidBeltOuterRadius;
+    scenario->belt_height = c.asteroidBeltHeight;
+    scenario->seed = c.seed;
+}
+
+nbody_world* nbody_create(const nbody_settings* settings)
+{
+    nbody_world* world = new (std::nothrow) nbody_world;
+    if (!world)
+        return nullptr;
+    if (settings && nbody_set_settings(world, settings) != NBODY_OK)
+    {
+        delete world;
+        return nullptr;
+    }
+    return world;
+}
+
+void nbody_destroy(nbody_world* world)
+{
+    delete world;
+}
+
+const char* nbody_error(const nbody_world* world)
+{
+    return world ? world->error.c_str() : "null world";
+}
+
+int nbody_get_settings(const nbody_world* world, nbody_settings* settings)
+{
+    if (!world || !settings || settings->struct_size < sizeof(uint32_t))
+        return fail(world, NBODY_ERROR_ARGUMENT, "null world or settings, or struct_size not set");
+    const uint32_t size = settings->struct_size;
+    nbody_settings current = toSettings(world->physics.settings());
+    std::memcpy(settings, &current, std::min<size_t>(size, sizeof(nbody_settings)));
+    settings->struct_size = size;
+    return NBODY_OK;
+}
+
+int nbody_set_settings(nbody_world* world, const nbody_settings* settings)
+{
+    if (!world || !settings)
+        return fail(world, NBODY_ERROR_ARGUMENT, "null world or settings");
+    nbody_settings s = toSettings(world->physics.settings());
+    if (!overlay(s, settings))
+        return fail(world, NBODY_ERROR_ARGUMENT, "struct_size not set");
+    if (const char* why = invalidSetting(s))
+        return fail(world, NBODY_ERROR_ARGUMENT, why);
+    return guarded(world, [&]() {
+        applyTo(world->physics, s);
+        return NBODY_OK;
+    });
+}
+
+int nbody_init_scenario(nbody_world* world, const nbody_scenario* scenario)
+{
+    if (!world)
+        return fail(world, NBODY_ERROR_ARGUMENT, "null world");
+    nbody_scenario s;
+    nbody_default_scenario(&s);
+    if (scenario && !overlay(s, scenario))
+        return fail(world, NBODY_ERROR_ARGUMENT, "struct_size not set");
+    ScenarioConfig c;
+    c.sunMass = s.sun_mass;
+    c.planetMass = s.planet_mass;
+    c.planetOrbitRadius = s.planet_orbit_radius;
+    c.asteroidAmount = s.asteroid_count;
+    c.avgAsteroidMass = s.asteroid_mass;
+    c.asteroidBeltInnerRadius = s.belt_inner_radius;
+    c.asteroidBeltOuterRadius = s.belt_outer_radius;
+    c.asteroidBeltHeight = s.belt_height;
+    c.seed = s.seed;
+    return guarded(world, [&]() {
+        world->physics.initialize(c);
+        return NBODY_OK;
+    });
+}
+
+int nbody_clear(nbody_world* world)
+{
+    if (!world)
+        return fail(world, NBODY_ERROR_ARGUMENT, "null world");
+    world->physics.bodies.clear();
+    world->physics.simTime = 0.0;
+    world->physics.stepCount = 0;
+    world->physics.bodiesChanged();
+    return NBODY_OK;
+}
+
+int nbody_add_bodies(nbody_world* world, size_t count, const uint8_t* types, const double* positions,
+                     const double* velocities, const float* masses, const float* radii, uint32_t* ids_out)
+{
+    if (!world)
+        return fail(world, NBODY_ERROR_ARGUMENT, "null world");
+    if (count == 0)
+        return NBODY_OK;
+    if (!types || !positions || !velocities || !masses)
+        return fail(world, NBODY_ERROR_ARGUMENT, "types, positions, velocities and masses are required");
+    for (size_t k = 0; k < count; k++)
+        if (types[k] > NBODY_ASTEROID)
+            return fail(world, NBODY_ERROR_ARGUMENT, "unknown body type");
+    if (world->physics.bodies.size() + count >= BodyStore::INVALID_INDEX)
+        return fail(world, NBODY_ERROR_ARGUMENT, "too many bodies");
+    return guarded(world, [&]() {
+        world->physics.bodies.addBatch(count, types, reinterpret_cast<const glm::dvec3*>(positions),
+                                       reinterpret_cast<const glm::dvec3*>(velocities), masses, radii, ids_out);
+        world->physics.bodiesChanged();
+        return NBODY_OK;
+    });
+}
+
+int nbody_remove_bodies(nbody_world* world, size_t count, const uint32_t* ids)
+{
+    if (!world || (count > 0 && !ids))
+        return fail(world, NBODY_ERROR_ARGUMENT, "null world or ids");
+    return guarded(world, [&]() {
+        BodyStore& bodies = world->physics.bodies;
+        std::vector<uint32_t> indices;
+        indices.reserve(count);
+        for (size_t k = 0; k < count; k++)
+        {
+            const uint32_t index = bodies.indexOf(ids[k]);
+            if (index != BodyStore::INVALID_INDEX)
+                indices.push_back(index);
+        }
+        if (indices.empty())
+            return NBODY_OK;
+        std::sort(indices.begin(), indices.end());
+        indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+        bodies.remove(indices);
+        world->physics.bodiesChanged();
+        return NBODY_OK;
+    });
+}
+
+int nbody_step(nbody_world* world, float dt, uint32_t steps)
+{
+    if (!world)
+        return fail(world, NBODY_ERROR_ARGUMENT, "null world");
+    if (!(dt > 0.0f))
+        return fail(world, NBODY_ERROR_ARGUMENT, "dt must be positive");
+    return guarded(world, [&]() {
+        for (uint32_t s = 0; s < steps; s++)
+            world->physics.step(dt);
+        return NBODY_OK;
+    });
+}
+
+size_t nbody_body_count(const nbody_world* world)
+{
+    return world ? world->physics.bodies.size() : 0;
+}
+
+double nbody_sim_time(const nbody_world* world)
+{
+    return world ? world->physics.simTime : 0.0;
+}
+
+uint64_t nbody_step_count(const nbody_world* world)
+{
+    return world ? world->physics.stepCount : 0;
+}
+
+uint64_t nbody_interactions(const nbody_world* world)
+{
+    return world ? world->physics.interactionsLastStep : 0;
+}
+
+double nbody_total_energy(const nbody_world* world)
+{
+    return world ? world->physics.totalEnergy() : 0.0;
+}
+
+int nbody_read(const nbody_world* world, uint32_t fields, const nbody_buffers* buffers)
+{
+    if (!world || !buffers)
+        return fail(world, NBODY_ERROR_ARGUMENT, "null world or buffers");
+    const BodyStore& bodies = world->physics.bodies;
+    const size_t n = bodies.size();
+    if (buffers->capacity < n)
+        return fail(world, NBODY_ERROR_CAPACITY, "buffers hold fewer bodies than the world");
+    if (((fields & NBODY_FIELD_POSITION) && !buffers->position) ||
+        ((fields & NBODY_FIELD_VELOCITY) && !buffers->velocity) ||
+        ((fields & NBODY_FIELD_ACCELERATION) && !buffers->acceleration) ||
+        ((fields & NBODY_FIELD_MASS) && !buffers->mass) || ((fields & NBODY_FIELD_ID) && !buffers->id) ||
+        ((fields & NBODY_FIELD_TYPE) && !buffers->type) || ((fields & NBODY_FIELD_RADIUS) && !buffers->radius))
+        return fail(world, NBODY_ERROR_ARGUMENT, "a requested field has no buffer");
+
+    if (fields & NBODY_FIELD_POSITION) copyOut(bodies.position, buffers->position);
+    if (fields & NBODY_FIELD_VELOCITY) copyOut(bodies.velocity, buffers->velocity);
+    if (fields & NBODY_FIELD_ACCELERATION) copyOut(bodies.acceleration, buffers->acceleration);
+    if (fields & NBODY_FIELD_MASS) copyOut(bodies.mass, buffers->mass);
+    if (fields & NBODY_FIELD_ID) copyOut(bodies.id, buffers->id);
+    if (fields & NBODY_FIELD_TYPE)
+    {
+        for (unsigned int t = 0; t < BODY_TYPE_COUNT; t++)
+        {
+            BodyRange r = bodies.range(static_cast<BodyType>(t));
+            std::fill(buffers->type + r.begin, buffers->type + r.end, static_cast<uint8_t>(t));
+        }
+    }
+    if (fields & NBODY_FIELD_RADIUS)
+        for (size_t i = 0; i < n; i++)
+            buffers->radius[i] = bodies.render[i].radiusScale;
+    return NBODY_OK;
+}
+
+int nbody_write(nbody_world* world, uint32_t fields, const nbody_buffers* buffers)
+{
+    if (!world || !buffers)
+        return fail(world, NBODY_ERROR_ARGUMENT, "null world or buffers");
+    BodyStore& bodies = world->physics.bodies;
+    const size_t n = bodies.size();
+    if (buffers->capacity < n)
+        return fail(world, NBODY_ERROR_CAPACITY, "buffers hold fewer bodies than the world");
+    if (((fields & NBODY_FIELD_POSITION) && !buffers->position) ||
+        ((fields & NBODY_FIELD_VELOCITY) && !buffers->velocity) || ((fields & NBODY_FIELD_MASS) && !buffers->mass))
+        return fail(world, NBODY_ERROR_ARGUMENT, "a written field has no buffer");
+    if (n == 0)
+        return NBODY_OK;
+
+    if (fields & NBODY_FIELD_POSITION) std::memcpy(bodies.position.data(), buffers->position, n * sizeof(glm::dvec3));
+    if (fields & NBODY_FIELD_VELOCITY) std::memcpy(bodies.velocity.data(), buffers->velocity, n * sizeof(glm::dvec3));
+    if (fields & NBODY_FIELD_MASS) std::memcpy(bodies.mass.data(), buffers->mass, n * sizeof(float));
+    if (fields & (NBODY_FIELD_POSITION | NBODY_FIELD_VELOCITY | NBODY_FIELD_MASS))
+        world->physics.bodiesChanged();
+    return NBODY_OK;
+}
+
+int nbody_view_state(const nbody_world* world, nbody_view* view)
+{
+    if (!world || !view)
+        return fail(world, NBODY_ERROR_ARGUMENT, "null world or view");
+    const BodyStore& bodies = world->physics.bodies;
+    view->count = bodies.size();
+    for (unsigned int t = 0; t < BODY_TYPE_COUNT; t++)
+    {
+        BodyRange r = bodies.range(static_cast<BodyType>(t));
+        view->type_begin[t] = r.begin;
+        view->type_count[t] = r.size();
+    }
+    view->position = reinterpret_cast<const double*>(bodies.position.data());
+    view->velocity = reinterpret_cast<const double*>(bodies.velocity.data());
+    view->acceleration = reinterpret_cast<const float*>(bodies.acceleration.data());
+    view->mass = bodies.mass.data();
+    view->id = bodies.id.data();
+    return NBODY_OK;
+}
+
+int nbody_load_snapshot(nbody_world* world, const char* path)
+{
+    if (!world || !path)
+        return fail(world, NBODY_ERROR_ARGUMENT, "null world or path");
+    return guarded(world, [&]() {
+        if (!world->physics.loadSnapshot(path))
+            return fail(world, NBODY_ERROR_IO, "cannot read the snapshot or it is not valid");
+        return static_cast<int>(NBODY_OK);
+    });
+}
+
+int nbody_save_snapshot(const nbody_world* world, const char* path)
+{
+    if (!world || !path)
+        return fail(world, NBODY_ERROR_ARGUMENT, "null world or path");
+    return guarded(world, [&]() {
+        SnapshotWriter writer;
+        const bool started = writer.write(path, world->physics.bodies, world->physics.snapshotInfo());
+        writer.wait();
+        if (!started || !writer.lastSucceeded())
+            return fail(world, NBODY_ERROR_IO, "cannot write the snapshot");
+        return static_cast<int>(NBODY_OK);
+    });
+}
+
+}
@@ -177,8 +177,8 @@ int main()
     unsigned int VBO, lightCubeVAO;
     glGenVertexArrays(1, &lightCubeVAO);
     glGenBuffers(1, &VBO);
-    glBindVertexArray(lightCubeVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glState().bindVertexArray(lightCubeVAO);
+    glState().bindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), &cubeVertices, GL_STATIC_DRAW);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
@@ -187,8 +187,8 @@ int main()
     unsigned int skyboxVAO, skyboxVBO;
     glGenVertexArrays(1, &skyboxVAO);
     glGenBuffers(1, &skyboxVBO);
-    glBindVertexArray(skyboxVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
+    glState().bindVertexArray(skyboxVAO);
+    glState().bindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
@@ -210,10 +210,21 @@ int main()
     Mesh sphereMesh = SphereCreator::CreateSphere(1.0f, 36, 18);
     
     unsigned int amount = 100000;
-    glm::mat4* modelMatrices;
-    glm::mat3* normalMatrices;
-    normalMatrices = new glm::mat3[amount];
-    modelMatrices = new glm::mat4[amount];
+    // a model and a normal matrix per rock, read by instanced.object.model.shader.vs
+    struct RockInstance
+    {
+        glm::mat4 model;
+        glm::mat3 normal;
+    };
+    const InstanceLayout rockLayout{"rock", sizeof(RockInstance), {
+        {INSTANCE_FIRST_LOCATION + 0, 4, GL_FLOAT, false, false, offsetof(RockInstance, model)},
+        {INSTANCE_FIRST_LOCATION + 1, 4, GL_FLOAT, false, false, offsetof(RockInstance, model) + sizeof(glm::vec4)},
+        {INSTANCE_FIRST_LOCATION + 2, 4, GL_FLOAT, false, false, offsetof(RockInstance, model) + 2 * sizeof(glm::vec4)},
+        {INSTANCE_FIRST_LOCATION + 3, 4, GL_FLOAT, false, false, offsetof(RockInstance, model) + 3 * sizeof(glm::vec4)},
+        {INSTANCE_FIRST_LOCATION + 4, 3, GL_FLOAT, false, false, offsetof(RockInstance, normal)},
+        {INSTANCE_FIRST_LOCATION + 5, 3, GL_FLOAT, false, false, offsetof(RockInstance, normal) + sizeof(glm::vec3)},
+        {INSTANCE_FIRST_LOCATION + 6, 3, GL_FLOAT, false, false, offsetof(RockInstance, normal) + 2 * sizeof(glm::vec3)}}};
+    std::vector<RockInstance> rockInstances(amount);
     srand(static_cast<unsigned int>(glfwGetTime())); // initialize random seed
     float radius = 150.0;
     float offset = 25.0f;
@@ -239,75 +250,27 @@ int main()
         model = glm::rotate(model, rotAngle, glm::vec3(0.4f, 0.6f, 0.8f));
 
         // 4. now add to list of matrices
-        normalMatrices[i] = glm::transpose(glm::inverse(glm::mat3(model)));
-        modelMatrices[i] = model;
+        rockInstances[i].normal = glm::transpose(glm::inverse(glm::mat3(model)));
+        rockInstances[i].model = model;
     }
 
-    unsigned int buffer;
-    glGenBuffers(1, &buffer);
-    glBindBuffer(GL_ARRAY_BUFFER, buffer);
-    glBufferData(GL_ARRAY_BUFFER, amount * sizeof(glm::mat4), &modelMatrices[0], GL_STATIC_DRAW);
-
-    for (unsigned int i = 0; i < rock.meshes.size(); i++)
-    {
-        unsigned int VAO = rock.meshes[i].VAO;
-        glBindVertexArray(VAO);
-        // set attribute pointers for matrix (4 times vec4)
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)0);
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(sizeof(glm::vec4)));
-        glEnableVertexAttribArray(5);
-        glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(2 * sizeof(glm::vec4)));
-        glEnableVertexAttribArray(6);
-        glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(3 * sizeof(glm::vec4)));
-
-        glVertexAttribDivisor(3, 1);
-        glVertexAttribDivisor(4, 1);
-        glVertexAttribDivisor(5, 1);
-        glVertexAttribDivisor(6, 1);
-
-        glBindVertexArray(0);
-    }
-
-    unsigned int normalBuffer;
-    glGenBuffers(1, &normalBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
-    glBufferData(GL_ARRAY_BUFFER, amount * sizeof(glm::mat3), &normalMatrices[0], GL_STATIC_DRAW);
-
-    for (unsigned int i = 0; i < rock.meshes.size(); i++)
-    {
-        unsigned int VAO = rock.meshes[i].VAO;
-        glBindVertexArray(VAO);
-        
-        glEnableVertexAttribArray(7);
-        glVertexAttribPointer(7, 3, GL_FLOAT, GL_FALSE, sizeof(glm::mat3), (void*)0);
-        glEnableVertexAttribArray(8);
-        glVertexAttribPointer(8, 3, GL_FLOAT, GL_FALSE, sizeof(glm::mat3), (void*)(sizeof(glm::vec3)));
-        glEnableVertexAttribArray(9);
-        glVertexAttribPointer(9, 3, GL_FLOAT, GL_FALSE, sizeof(glm::mat3), (void*)(2 * sizeof(glm::vec3)));
-        
-        glVertexAttribDivisor(7, 1);
-        glVertexAttribDivisor(8, 1);
-        glVertexAttribDivisor(9, 1);
-        
-        glBindVertexArray(0);
-    }
+    InstanceBuffer rocks(rockLayout);
+    rocks.upload(rockInstances.data(), rockInstances.size());
 
     unsigned int uboMatrices;
     glGenBuffers(1, &uboMatrices);
-    glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
+    glState().bindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
     glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4), NULL, GL_STATIC_DRAW);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glState().bindBuffer(GL_UNIFORM_BUFFER, 0);
 
     // define the range of the buffer that links to a uniform binding point
-    glBindBufferBase(GL_UNIFORM_BUFFER, 0, uboMatrices);
+    glState().bindBufferBase(GL_UNIFORM_BUFFER, 0, uboMatrices);
 
     // store the projection matrix (we only do this once now) (note: we're not using zoom anymore by changing the FoV)
     glm::mat4 projection = glm::perspective(45.0f, (float)windowedWidth / (float)windowedHeight, 0.1f, 1000.0f);
-    glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
+    glState().bindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
     glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(projection));
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glState().bindBuffer(GL_UNIFORM_BUFFER, 0);
 
     struct Material {
         float shininess;  // 4 bytes
@@ -364,9 +327,9 @@ int main()
 
     GLuint uboLightData;
     glGenBuffers(1, &uboLightData);
-    glBindBuffer(GL_UNIFORM_BUFFER, uboLightData);
+    glState().bindBuffer(GL_UNIFORM_BUFFER, uboLightData);
     glBufferData(GL_UNIFORM_BUFFER, sizeof(LightData), NULL, GL_STATIC_DRAW);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glState().bindBuffer(GL_UNIFORM_BUFFER, 0);
 
     LightData lighting;
     lighting.material.shininess = 64.0f;
@@ -399,12 +362,12 @@ int main()
     lighting.spotLight.specular = glm::vec3(1.0f);
 
     // Upload to UBO
-    glBindBuffer(GL_UNIFORM_BUFFER, uboLightData);
+    glState().bindBuffer(GL_UNIFORM_BUFFER, uboLightData);
     glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(LightData), &lighting);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glState().bindBuffer(GL_UNIFORM_BUFFER, 0);
 
     // Bind UBO to binding point 1
-    glBindBufferBase(GL_UNIFORM_BUFFER, 1, uboLightData);
+    glState().bindBufferBase(GL_UNIFORM_BUFFER, 1, uboLightData);
 
     skyboxShader.use();
     skyboxShader.setInt("skybox", 0);
@@ -429,9 +392,9 @@ int main()
     
         // Calculations
         glm::mat4 view = camera.GetViewMatrix();
-        glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
+        glState().bindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
         glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(view));
-        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glState().bindBuffer(GL_UNIFORM_BUFFER, 0);
 
         // draw planet
         planetShader.use();
@@ -448,21 +411,14 @@ int main()
         planet.Draw(planetShader);
         
         asteroidShader.use();
-        asteroidShader.setInt("texture_diffuse1", 0);
         asteroidShader.setMat4("viewMat", view);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, rock.textures_loaded[0].id);
-        for (unsigned int i = 0; i < rock.meshes.size(); i++)
-        {
-            glBindVertexArray(rock.meshes[i].VAO);
-            glDrawElementsInstanced(GL_TRIANGLES, static_cast<unsigned int>(rock.meshes[i].indices.size()), GL_UNSIGNED_INT, 0, amount);
-            glBindVertexArray(0);
-        }
+        rock.DrawInstanced(asteroidShader, rocks, amount);
+        glState().bindVertexArray(0);
 
         // Light Cube Shader
         lightCubeShader.use();
         // Draw Light Cube
-        glBindVertexArray(lightCubeVAO);
+        glState().bindVertexArray(lightCubeVAO);
         for (unsigned int i = 0; i < NR_POINT_LIGHTS; i++)
         {
             model = glm::mat4(1.0f);
@@ -477,25 +433,25 @@ int main()
         lightCubeShader.setMat4("model", model);
         sphereMesh.Draw(lightCubeShader);
 
-        glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
+        glState().depthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
         skyboxShader.use();
         // skybox cube
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+        glState().bindVertexArray(skyboxVAO);
+        glState().activeTexture(GL_TEXTURE0);
+        glState().bindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
         glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthFunc(GL_LESS); // set depth function back to default
+        glState().bindVertexArray(0);
+        glState().depthFunc(GL_LESS); // set depth function back to default
         
         // Swap buffers and poll events
         glfwSwapBuffers(window);
         glfwPollEvents();
     }    
 
-    glDeleteVertexArrays(1, &lightCubeVAO);
-    glDeleteVertexArrays(1, &skyboxVAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &skyboxVBO);
+    glState().deleteVertexArrays(1, &lightCubeVAO);
+    glState().deleteVertexArrays(1, &skyboxVAO);
+    glState().deleteBuffers(1, &VBO);
+    glState().deleteBuffers(1, &skyboxVBO);
 
     glfwTerminate();
     return 0;
@@ -609,7 +565,7 @@ unsigned int loadTexture(char const * path, bool gammaCorrection)
             dataFormat = GL_RGBA;
         }
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
+        glState().bindTexture(GL_TEXTURE_2D, textureID);
         glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, dataFormat, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -633,7 +589,7 @@ unsigned int loadCubemap(std::vector<std::string> faces)
 {
     unsigned int textureID;
     glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    glState().bindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 
     int width, height, nrChannels;
     for (unsigned int i = 0; i < faces.size(); i++)
@@ -0,0 +1,75 @@
+#include <asset_archive.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+
+// Packs the viewer's assets into one archive (asset_archive.h), mounted with its --assets option. Paths are
+// relative to the build directory, like the viewer's; the names in the archive are the files' paths below the root,
+// so the viewer finds them under the same relative paths it always used.
+
+static void printUsage(const char* program)
+{
+    std::cout << "usage: " << program << " [options] ARCHIVE PATH...\n"
+              << "  packs every file of the PATHs (directories recursively) into ARCHIVE\n"
+              << "  --root DIR      the names are the paths below DIR (default: the archive's directory)\n"
+              << "  --store         no compression\n"
+              << "  example: " << program << " ../assets.pak ../resources ../textures ../shaders.2" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    std::string archive, root;
+    std::vector<std::string> inputs;
+    bool compress = true;
+    for (int a = 1; a < argc; a++) {
+        const std::string arg = argv[a];
+        if (arg == "--help" || arg == "-h") { printUsage(argv[0]); return 0; }
+        else if (arg == "--root" && a + 1 < argc) root = argv[++a];
+        else if (arg == "--store") compress = false;
+        else if (!arg.empty() && arg[0] == '-') { std::cerr << "unknown option " << arg << std::endl; printUsage(argv[0]); return 1; }
+        else if (archive.empty()) archive = arg;
+        else inputs.push_back(arg);
+    }
+    if (archive.empty() || inputs.empty()) { printUsage(argv[0]); return 1; }
+    if (root.empty()) {
+        const size_t slash = archive.find_last_of('/');
+        root = slash == std::string::npos ? "." : archive.substr(0, slash);
+    }
+
+    std::vector<std::string> files;
+    std::error_code error;
+    for (const std::string& input : inputs) {
+        if (std::filesystem::is_regular_file(input, error)) {
+            files.push_back(input);
+            continue;
+        }
+        if (!std::filesystem::is_directory(input, error)) { std::cerr << input << " is neither a file nor a directory" << std::endl; return 1; }
+        for (auto it = std::filesystem::recursive_directory_iterator(input, error); it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+            if (error) break;
+            // the archive and its partial copy are not assets of their own
+            const std::string path = it->path().generic_string();
+            if (it->is_regular_file(error) && normalizeAssetPath(path) != normalizeAssetPath(archive)
+                && normalizeAssetPath(path) != normalizeAssetPath(archive + ".partial"))
+                files.push_back(path);
+        }
+    }
+    std::sort(files.begin(), files.end());
+    files.erase(std::unique(files.begin(), files.end(), [](const std::string& a, const std::string& b) {
+        return normalizeAssetPath(a) == normalizeAssetPath(b);
+    }), files.end());
+
+    size_t compressed = 0;
+    if (!packAssetArchive(archive, root, files, compress, &compressed)) {
+        std::cerr << "cannot pack " << files.size() << " files below " << root << " into " << archive << std::endl;
+        return 1;
+    }
+    AssetArchive check;
+    if (!check.mount(archive, root, false)) { std::cerr << archive << " does not read back" << std::endl; return 1; }
+    std::cout << "packed " << check.size() << " files (" << compressed << " compressed) into " << archive << ", "
+              << check.bytes() / (1024 * 1024) << " MB" << std::endl;
+    return 0;
+}
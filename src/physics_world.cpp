@@ -0,0 +1,1305 @@
+#include <physics_world.h>
+#include <kepler.h>
+#include <snapshot.h>
+#include <profiler.h>
+#include <perf_counters.h>
+
+#include <gtc/constants.hpp>
+
+#include <cmath>
+#include <algorithm>
+
+void PhysicsWorld::initialize(const ScenarioConfig& scenario, Mesh* sunMesh, Model* planetModel, Model* asteroidModel)
+{
+    PROFILE_SCOPE("PhysicsWorld::initialize");
+    bodies.clear();
+    bodies.reserve(2 + scenario.asteroidAmount);
+    simTime = 0.0;
+    stepCount = 0;
+    mergers = 0;
+    mergersLastStep = 0;
+    removedIndices.clear();
+    collisionHashValid = false;
+    resetConservedReference();
+
+    glm::dvec3 sunPos(0.0);
+    glm::dvec3 sunVel(0.0);
+
+    bodies.add(BODY_SUN, sunPos, sunVel, scenario.sunMass, scenario.sunRadiusScale, nullptr, sunMesh, glm::quat(1.0f,0,0,0), false);
+    float angleRad = glm::radians(scenario.planetInitialAngle);
+    glm::vec3 planetPos(scenario.planetOrbitRadius * cos(angleRad), 0.0f, scenario.planetOrbitRadius * sin(angleRad));
+    float orbitalVelMag = (scenario.sunMass > 0 && scenario.planetOrbitRadius > 0) ? sqrt((G * scenario.sunMass) / scenario.planetOrbitRadius) : 0.0f;
+    glm::vec3 planetVel(-orbitalVelMag * sin(angleRad), 0.0f, orbitalVelMag * cos(angleRad));
+    bodies.add(BODY_PLANET, planetPos, planetVel, scenario.planetMass, scenario.planetRadiusScale, planetModel, nullptr, glm::angleAxis(glm::radians(0.0f), glm::vec3(0,1,0)), false);
+
+    addAsteroids(scenario, 0, scenario.asteroidAmount, asteroidModel);
+    bindEphemeris();
+    invalidate();
+    // spawn order is spatially random, start out sorted
+    if (mortonSort) reorderIfDisordered();
+}
+
+void PhysicsWorld::initializeGalaxies(const GalaxySetup& setup, Mesh* coreMesh)
+{
+    PROFILE_SCOPE("PhysicsWorld::initializeGalaxies");
+    simTime = 0.0;
+    stepCount = 0;
+    mergers = 0;
+    mergersLastStep = 0;
+    removedIndices.clear();
+    epsilonSq = setup.softening * setup.softening;
+    solver = SOLVER_TEST_PARTICLES;
+    generateGalaxies(bodies, setup, G, coreMesh);
+    bodiesChanged();
+    if (mortonSort) reorderIfDisordered();
+}
+
+void PhysicsWorld::initializeScenario(const ScenarioFile& file, Mesh* sunMesh, Model* planetModel, Model* asteroidModel)
+{
+    PROFILE_SCOPE("PhysicsWorld::initializeScenario");
+    simTime = 0.0;
+    stepCount = 0;
+    mergers = 0;
+    mergersLastStep = 0;
+    removedIndices.clear();
+    if (file.G > 0.0f) G = file.G;
+    if (file.softening > 0.0f) epsilonSq = file.softening * file.softening;
+    generateScenario(bodies, file, G, sunMesh, planetModel, asteroidModel);
+    // the file's ephemeris replaces the world's, one that cannot be read leaves none
+    if (!file.ephemeris.empty() && !ephemeris.load(file.ephemeris)) ephemeris.clear();
+    bodiesChanged();
+    if (mortonSort) reorderIfDisordered();
+}
+
+void PhysicsWorld::addAsteroids(const ScenarioConfig& scenario, size_t firstOrdinal, size_t count, Model* asteroidModel)
+{
+    PROFILE_SCOPE("PhysicsWorld::addAsteroids");
+    // around the sun as it is now, it may have drifted since the belt was first set up
+    const bool hasSun = bodies.count(BODY_SUN) > 0;
+    const size_t sun = bodies.range(BODY_SUN).begin;
+    const float sunMass = hasSun ? bodies.mass[sun] : scenario.sunMass;
+    const glm::dvec3 sunPos = hasSun ? bodies.position[sun] : glm::dvec3(0.0);
+    const glm::dvec3 sunVel = hasSun ? bodies.velocity[sun] : glm::dvec3(0.0);
+    const size_t first = bodies.extend(BODY_ASTEROID, count);
+
+    // asteroid n of the belt draws from the stream of (seed, n), whichever slice makes it
+    workerPool().parallelFor(0, count, [&](size_t begin, size_t end, unsigned int) {
+        for (size_t k = begin; k < end; k++) {
+            philox::Stream rng(scenario.seed, firstOrdinal + k);
+            const BeltAsteroid asteroid = beltAsteroid(scenario, G, sunMass, rng);
+            const size_t index = first + k;
+            bodies.position[index] = asteroid.position + sunPos;
+            bodies.velocity[index] = asteroid.velocity + sunVel;
+            bodies.mass[index] = asteroid.mass;
+            BodyRenderData& render = bodies.render[index];
+            render.radiusScale = rng.uniform(scenario.minAsteroidScale, scenario.maxAsteroidScale);
+            render.modelPtr = asteroidModel;
+            const float ax = rng.uniform(0.0f, 360.0f), ay = rng.uniform(0.0f, 360.0f), az = rng.uniform(0.0f, 360.0f);
+            glm::vec3 randomAxis = glm::normalize(glm::vec3(ax + 0.1f, ay + 0.1f, az + 0.1f));
+            render.orientation = glm::angleAxis(glm::radians(rng.uniform(0.0f, 360.0f)), randomAxis);
+            render.spin = tumbleFor(bodies.id[index]);
+        }
+    });
+}
+
+void PhysicsWorld::setAsteroidCount(const ScenarioConfig& scenario, Model* asteroidModel)
+{
+    size_t current = bodies.count(BODY_ASTEROID);
+    if (scenario.asteroidAmount < current) {
+        bodies.truncate(BODY_ASTEROID, scenario.asteroidAmount);
+    } else if (scenario.asteroidAmount > current) {
+        addAsteroids(scenario, current, scenario.asteroidAmount - current, asteroidModel);
+    } else {
+        return;
+    }
+    bodiesChanged();
+}
+
+void PhysicsWorld::adopt(PhysicsWorld& built)
+{
+    std::swap(bodies, built.bodies);
+    simTime = built.simTime;
+    stepCount = built.stepCount;
+    G = built.G;
+    epsilonSq = built.epsilonSq;
+    solver = built.solver;
+    if (!built.ephemeris.empty()) std::swap(ephemeris, built.ephemeris);
+    mergers = 0;
+    mergersLastStep = 0;
+    removedIndices.clear();
+    bodiesChanged();
+}
+
+void PhysicsWorld::bodiesChanged()
+{
+    collisionHashValid = false;
+    sectorClock.clear();
+    sectors.invalidate();
+    // new bodies owe nothing to the old ones' cycle
+    respaPhase = 0;
+    bindEphemeris();
+    resetConservedReference();
+    invalidate();
+}
+
+bool PhysicsWorld::loadEphemeris(const std::string& path)
+{
+    clearEphemeris();
+    if (!ephemeris.load(path))
+        return false;
+    bindEphemeris();
+    invalidate();
+    return true;
+}
+
+void PhysicsWorld::clearEphemeris()
+{
+    ephemeris.clear();
+    bindEphemeris();
+    invalidate();
+}
+
+// hands the previously driven bodies back to the integrators and flags the ones with a target now static
+void PhysicsWorld::bindEphemeris()
+{
+    for (size_t k = 0; k < ephemerisIds.size(); k++) {
+        const uint32_t i = bodies.indexOf(ephemerisIds[k]);
+        if (i != BodyStore::INVALID_INDEX && !ephemerisWasStatic[k]) bodies.flags[i] &= static_cast<uint8_t>(~BODY_FLAG_STATIC);
+    }
+    ephemerisIds.clear();
+    ephemerisTargets.clear();
+    ephemerisWasStatic.clear();
+    for (unsigned int type = BODY_SUN; type < BODY_ASTEROID; type++) {
+        const BodyRange range = bodies.range(static_cast<BodyType>(type));
+        for (size_t i = range.begin; i < range.end; i++) {
+            const int target = ephemeris.targetFor(static_cast<BodyType>(type), static_cast<uint32_t>(i - range.begin));
+            if (target < 0) continue;
+            ephemerisIds.push_back(bodies.id[i]);
+            ephemerisTargets.push_back(static_cast<uint32_t>(target));
+            ephemerisWasStatic.push_back(bodies.isStatic(i) ? 1 : 0);
+            bodies.flags[i] |= BODY_FLAG_STATIC;
+        }
+    }
+    placeEphemerisBodies(simTime);
+}
+
+void PhysicsWorld::placeEphemerisBodies(double t)
+{
+    for (size_t k = 0; k < ephemerisIds.size(); k++) {
+        const uint32_t i = bodies.indexOf(ephemerisIds[k]);
+        if (i == BodyStore::INVALID_INDEX) continue;
+        ephemeris.evaluate(ephemerisTargets[k], t, bodies.position[i], bodies.velocity[i]);
+        bodies.acceleration[i] = glm::vec3(0.0f);
+    }
+}
+
+SnapshotInfo PhysicsWorld::snapshotInfo() const
+{
+    SnapshotInfo info;
+    info.simTime = simTime;
+    info.stepCount = stepCount;
+    info.G = G;
+    info.epsilonSq = epsilonSq;
+    return info;
+}
+
+bool PhysicsWorld::loadSnapshot(const char* path, Mesh* sunMesh, Model* planetModel, Model* asteroidModel)
+{
+    MappedSnapshot snapshot;
+    if (!snapshot.open(path))
+        return false;
+    snapshot.restore(bodies, sunMesh, planetModel, asteroidModel);
+    SnapshotInfo info = snapshot.info();
+    simTime = info.simTime;
+    stepCount = info.stepCount;
+    G = info.G;
+    epsilonSq = info.epsilonSq;
+    bodiesChanged();
+    return true;
+}
+
+void PhysicsWorld::step(float dt)
+{
+    PROFILE_SCOPE("PhysicsWorld::step");
+    PerfScope perf("step", &interactionsLastStep);
+    interactionsLastStep = 0;
+    keplerBodiesLastStep = 0;
+    encountersLastStep = 0;
+    sectorFullRateLastStep = 0;
+    sectorTargetsLastStep = 0;
+    reorderedLastStep = false;
+    mergersLastStep = 0;
+    removedIndices.clear();
+    // leapfrog and Verlet end on a force pass at the final positions, which can leave the potential behind for free
+    const bool sample = diagnosticsInterval > 0 && (stepCount + 1) % diagnosticsInterval == 0;
+    wantPotential = sample && !keplerAsteroids && !beltSectors && !blockTimesteps && !respaActive() &&
+                    (integrator.type == INTEGRATOR_LEAPFROG_KDK || integrator.type == INTEGRATOR_VELOCITY_VERLET);
+    const bool potentialFromStep = wantPotential;
+    // a multi-rate run starts with nothing owed to anyone
+    if (!sectorsActive()) {
+        sectorClock.clear();
+        sectorForcesCurrent = false;
+    }
+    const bool driven = !ephemerisIds.empty();
+    if (driven) placeEphemerisBodies(simTime);
+    // a multiple-timestep cycle left open by switching the scheme off owes its slow impulse first
+    if (!respaActive() && respaPhase > 0)
+        closeRespaCycle();
+    if (keplerAsteroids)
+        stepKepler(dt);
+    else if (beltSectors)
+        stepSectors(dt);
+    else if (blockTimesteps)
+        blockStepper.step(bodies, dt, [this](const std::vector<unsigned int>& targets) { computeAccelerationsFor(targets); });
+    else if (respaActive())
+        stepRespa(dt);
+    else if (!closeEncounters || !stepEncounters(dt)) {
+        const double start = simTime;
+        integrator.step(bodies, dt, [this, driven, start]() {
+            if (driven) placeEphemerisBodies(start + integrator.stageTime);
+            computeAccelerations();
+        });
+        encounterForcesCurrent = false;
+    }
+    wantPotential = false;
+    simTime += dt;
+    stepCount++;
+    if (driven) placeEphemerisBodies(simTime);
+    if (collisions)
+        resolveCollisions();
+    if (sample)
+        sampleConserved(potentialFromStep && mergersLastStep == 0);
+
+    // keyed to the step count so a run restored from a snapshot re-sorts on the same steps
+    if (mortonSort && mortonCheckInterval > 0 && stepCount % mortonCheckInterval == 0)
+        reorderIfDisordered();
+}
+
+void PhysicsWorld::setSurface(const Model* model, const SignedDistanceField* field)
+{
+    surfaces.erase(std::remove_if(surfaces.begin(), surfaces.end(), [model](const std::pair<const Model*, const SignedDistanceField*>& s) {
+        return s.first == model;
+    }), surfaces.end());
+    if (model && field && !field->empty()) surfaces.emplace_back(model, field);
+}
+
+// detects contacts on the positions the step ended with, merges them and compacts the store
+void PhysicsWorld::resolveCollisions()
+{
+    PROFILE_SCOPE("PhysicsWorld::resolveCollisions");
+    PerfScope perf("collisions");
+    const BodyRange asteroids = bodies.range(BODY_ASTEROID);
+    if (asteroids.size() == 0) return;
+    const glm::dvec3* position = bodies.position.data();
+    const BodyRenderData* render = bodies.render.data();
+    float maxRadius = 0.0f;
+    for (size_t i = asteroids.begin; i < asteroids.end; ++i) maxRadius = std::max(maxRadius, render[i].radiusScale);
+    if (maxRadius <= 0.0f) return;
+
+    // the sun and planets with a surface are reached at the field's bounding sphere, and only hit at the surface
+    struct MassiveShape { const SignedDistanceField* field; glm::mat3 toModel; glm::vec3 center; double reach; float scale; };
+    std::vector<MassiveShape> shapes(asteroids.begin);
+    for (size_t m = 0; m < asteroids.begin; ++m) {
+        MassiveShape& shape = shapes[m];
+        shape.field = nullptr;
+        shape.reach = render[m].radiusScale;
+        shape.scale = render[m].radiusScale;
+        for (const std::pair<const Model*, const SignedDistanceField*>& surface : surfaces)
+            if (surface.first == render[m].modelPtr && render[m].radiusScale > 0.0f) shape.field = surface.second;
+        if (!shape.field) continue;
+        shape.toModel = glm::mat3_cast(glm::conjugate(render[m].orientation)) / render[m].radiusScale;
+        shape.center = shape.field->center();
+        shape.reach = (glm::length(shape.center) + shape.field->boundingRadius()) * render[m].radiusScale;
+    }
+
+    // merged asteroids grow, the cells have to stay at least as wide as the largest contact distance
+    const double cellSize = 2.0 * maxRadius;
+    if (!collisionHashValid || collisionHash.cellSize() < cellSize) {
+        collisionHash.reset(cellSize);
+        collisionHashValid = true;
+    }
+    for (size_t i = asteroids.begin; i < asteroids.end; ++i) collisionHash.update(bodies.id[i], position[i]);
+
+    // the hash is only read while the slices look for contacts, each pair is reported by its lower index
+    sliceContacts.resize(workerPool().size());
+    for (std::vector<glm::uvec2>& c : sliceContacts) c.clear();
+    workerPool().parallelFor(asteroids.begin, asteroids.end, [&](size_t begin, size_t end, unsigned int slice) {
+        std::vector<glm::uvec2>& out = sliceContacts[slice];
+        for (size_t i = begin; i < end; ++i) {
+            const glm::dvec3 p = position[i];
+            const double r = render[i].radiusScale;
+            for (size_t m = 0; m < asteroids.begin; ++m) {
+                glm::dvec3 d = position[m] - p;
+                double reach = shapes[m].reach + r;
+                if (glm::dot(d, d) >= reach * reach) continue;
+                if (shapes[m].field && shapes[m].field->sample(shapes[m].toModel * glm::vec3(-d)) * shapes[m].scale >= r) continue;
+                out.push_back(glm::uvec2(m, i));
+            }
+            collisionHash.forEachNear(p, [&](uint32_t otherId) {
+                uint32_t j = bodies.indexOf(otherId);
+                if (j == BodyStore::INVALID_INDEX || j <= i) return;
+                glm::dvec3 d = position[j] - p;
+                double reach = render[j].radiusScale + r;
+                if (glm::dot(d, d) < reach * reach) out.push_back(glm::uvec2(i, j));
+            });
+        }
+    }, static_cast<unsigned int>(threads));
+
+    contacts.clear();
+    for (const std::vector<glm::uvec2>& c : sliceContacts) contacts.insert(contacts.end(), c.begin(), c.end());
+    if (contacts.empty()) return;
+    // resolved in index order, so the outcome does not depend on how the range was sliced
+    std::sort(contacts.begin(), contacts.end(), [](const glm::uvec2& a, const glm::uvec2& b) {
+        return a.x != b.x ? a.x < b.x : a.y < b.y;
+    });
+    mergedAway.assign(bodies.size(), 0);
+    for (const glm::uvec2& c : contacts) {
+        if (mergedAway[c.x] || mergedAway[c.y]) continue;
+        size_t keep = c.x, gone = c.y;
+        if (keep >= asteroids.begin && bodies.mass[gone] > bodies.mass[keep]) std::swap(keep, gone);
+        mergeBodies(keep, gone);
+        mergedAway[gone] = 1;
+        removedIndices.push_back(static_cast<uint32_t>(gone));
+    }
+    std::sort(removedIndices.begin(), removedIndices.end());
+    for (uint32_t k : removedIndices) collisionHash.remove(bodies.id[k]);
+    bodies.remove(removedIndices);
+    if (sectorClock.size() == bodies.size() + removedIndices.size()) eraseIndices(sectorClock, removedIndices);
+    mergersLastStep = static_cast<unsigned int>(removedIndices.size());
+    mergers += removedIndices.size();
+    // merged bodies changed mass and velocity, and per-slot stepper state no longer lines up
+    invalidate();
+}
+
+// perfectly inelastic: gone's mass and momentum go to keep, which moves to the pair's center of mass.
+// Asteroids grow to the combined volume, the sun and planets keep their size.
+void PhysicsWorld::mergeBodies(size_t keep, size_t gone)
+{
+    const double m1 = bodies.mass[keep], m2 = bodies.mass[gone], m = m1 + m2;
+    if (m > 0.0 && !bodies.isStatic(keep)) {
+        bodies.position[keep] = (m1 * bodies.position[keep] + m2 * bodies.position[gone]) / m;
+        bodies.velocity[keep] = (m1 * bodies.velocity[keep] + m2 * bodies.velocity[gone]) / m;
+    }
+    bodies.mass[keep] = static_cast<float>(m);
+    if (bodies.typeOf(keep) == BODY_ASTEROID) {
+        float r1 = bodies.render[keep].radiusScale, r2 = bodies.render[gone].radiusScale;
+        bodies.render[keep].radiusScale = std::cbrt(r1 * r1 * r1 + r2 * r2 * r2);
+    }
+}
+
+// Z-order sort of the asteroid range, skipped while the previous order is still mostly intact
+void PhysicsWorld::reorderIfDisordered()
+{
+    const BodyRange asteroids = bodies.range(BODY_ASTEROID);
+    if (asteroids.size() < 2) return;
+    morton.computeKeys(bodies.position.data() + asteroids.begin, asteroids.size());
+    mortonDisorder = morton.disorder();
+    if (mortonDisorder <= mortonThreshold) return;
+    morton.sort(static_cast<unsigned int>(threads));
+    bodies.reorder(BODY_ASTEROID, morton.sortedOrder());
+    if (sectorClock.size() == bodies.size()) applyOrder(sectorClock, asteroids.begin, morton.sortedOrder(), sortScratch);
+    if (respaSlow.size() == bodies.size()) applyOrder(respaSlow, asteroids.begin, morton.sortedOrder(), sortScratch);
+    sectorForcesCurrent = false;
+    // cached accelerations moved along with their bodies, only the block stepper keeps per-slot state
+    blockStepper.invalidate();
+    mortonDisorder = 0.0f;
+    mortonSorts++;
+    reorderedLastStep = true;
+}
+
+PhysicsSettings PhysicsWorld::settings() const
+{
+    return PhysicsSettings{G, epsilonSq, solver, theta, asteroidSelfGravity, forceKernel, forceLaw, forcePrecision,
+                           validateForceKernel, threads,
+                           integrator.type, blockTimesteps, blockStepper.eta, blockStepper.maxLevel,
+                           keplerAsteroids, keplerHillFactor, mortonSort, mortonThreshold, fmm.order, fmm.theta,
+                           fmmValidationSample, collisions, diagnosticsInterval, closeEncounters, encounterTimescale,
+                           particleMesh.grid, particleMesh.shortRange, beltSectors, respa, respaSteps,
+                           sectors.angularCount, sectors.radialCount, sectors.maxLevel, sectors.focusRadius};
+}
+
+void PhysicsWorld::applySettings(const PhysicsSettings& s)
+{
+    // threads, kernel choice and validation do not change the forces, eta only changes future level choices
+    bool forcesChanged = s.G != G || s.epsilonSq != epsilonSq || s.solver != solver || s.theta != theta ||
+                         s.asteroidSelfGravity != asteroidSelfGravity || s.forceLaw != forceLaw ||
+                         s.forcePrecision != forcePrecision || s.fmmOrder != fmm.order || s.fmmTheta != fmm.theta ||
+                         s.meshGrid != particleMesh.grid || s.meshShortRange != particleMesh.shortRange;
+    bool schemeChanged = s.integrator != integrator.type || s.blockTimesteps != blockTimesteps ||
+                         s.blockMaxLevel != blockStepper.maxLevel || s.keplerAsteroids != keplerAsteroids ||
+                         s.closeEncounters != closeEncounters || s.beltSectors != beltSectors || s.respa != respa ||
+                         s.respaSteps != respaSteps;
+    G = s.G;
+    epsilonSq = s.epsilonSq;
+    solver = s.solver;
+    theta = s.theta;
+    asteroidSelfGravity = s.asteroidSelfGravity;
+    forceKernel = s.forceKernel;
+    forceLaw = s.forceLaw;
+    forcePrecision = s.forcePrecision;
+    validateForceKernel = s.validateForceKernel;
+    threads = s.threads;
+    integrator.type = s.integrator;
+    blockTimesteps = s.blockTimesteps;
+    blockStepper.eta = s.blockEta;
+    blockStepper.maxLevel = s.blockMaxLevel;
+    keplerAsteroids = s.keplerAsteroids;
+    keplerHillFactor = s.keplerHillFactor;
+    mortonSort = s.mortonSort;
+    mortonThreshold = s.mortonThreshold;
+    fmm.order = s.fmmOrder;
+    fmm.theta = s.fmmTheta;
+    fmmValidationSample = s.fmmValidationSample;
+    collisions = s.collisions;
+    diagnosticsInterval = s.diagnosticsInterval;
+    closeEncounters = s.closeEncounters;
+    encounterTimescale = s.encounterTimescale;
+    particleMesh.grid = s.meshGrid;
+    particleMesh.shortRange = s.meshShortRange;
+    beltSectors = s.beltSectors;
+    respa = s.respa;
+    respaSteps = s.respaSteps;
+    sectors.angularCount = s.sectorAngular;
+    sectors.radialCount = s.sectorRadial;
+    sectors.maxLevel = s.sectorMaxLevel;
+    sectors.focusRadius = s.sectorFocusRadius;
+    if (forcesChanged || schemeChanged)
+        invalidate();
+}
+
+PhysicsStats PhysicsWorld::stats() const
+{
+    PhysicsStats out;
+    stats(out);
+    return out;
+}
+
+void PhysicsWorld::stats(PhysicsStats& out) const
+{
+    out.interactions = interactionsLastStep;
+    out.treeNodes = solver == SOLVER_FMM ? fmm.tree.nodes.size() : tree.nodes.size();
+    out.massiveBodies = massiveSoA.count;
+    out.forceKernelError = forceKernelError;
+    out.respaSlowSums = respaSlowSums;
+    out.blockEvents = blockStepper.eventsLastStep;
+    out.blockForceEvaluations = blockStepper.forceEvaluations;
+    out.levelHistogram = blockStepper.levelHistogram;
+    out.keplerBodies = keplerBodiesLastStep;
+    out.keplerEncounters = keplerAsteroids ? bodies.count(BODY_ASTEROID) - keplerBodiesLastStep : 0;
+    out.closeEncounters = encountersLastStep;
+    out.mortonDisorder = mortonDisorder;
+    out.mortonSorts = mortonSorts;
+    out.fmmError = fmmError;
+    out.meshCellSize = particleMesh.cellSize;
+    out.meshPairs = particleMesh.shortRangePairs;
+    out.mergers = mergers;
+    out.mergersLastStep = mergersLastStep;
+    out.sectorFullRate = sectorFullRateLastStep;
+    out.sectorTargets = sectorTargetsLastStep;
+    out.ephemerisBodies = ephemerisIds.size();
+    out.sectorLevelBodies.assign(sectors.maxLevel + 1, 0);
+    if (beltSectors)
+        for (const BeltSectors::Sector& sector : sectors.sectors())
+            if (sector.level < out.sectorLevelBodies.size()) out.sectorLevelBodies[sector.level] += sector.bodies;
+    out.haveConserved = haveConserved;
+    out.conserved = conserved;
+    out.conservedReference = conservedReference;
+    out.conservedHistory = conservedHistory;
+}
+
+// potential holds the current positions' potential (without G) unless potentialCurrent is false, in which case one
+// extra force pass fills it and the integrator's cached accelerations are put back untouched
+void PhysicsWorld::sampleConserved(bool potentialCurrent)
+{
+    if (!potentialCurrent) {
+        savedAccelerations = bodies.acceleration;
+        wantPotential = true;
+        computeAccelerations();
+        wantPotential = false;
+        bodies.acceleration.swap(savedAccelerations);
+    }
+    ConservedQuantities q;
+    q.simTime = simTime;
+    for (size_t i = 0; i < bodies.size(); ++i) {
+        const double m = bodies.mass[i];
+        const glm::dvec3& v = bodies.velocity[i];
+        q.kinetic += 0.5 * m * glm::dot(v, v);
+        q.momentum += m * v;
+        q.angularMomentum += m * glm::cross(bodies.position[i], v);
+    }
+    q.potential = potentialEnergy();
+    q.total = q.kinetic + q.potential;
+    conserved = q;
+    if (!haveConserved) {
+        conservedReference = q;
+        haveConserved = true;
+    }
+    if (conservedHistory.size() >= CONSERVED_HISTORY)
+        conservedHistory.erase(conservedHistory.begin());
+    conservedHistory.push_back(q);
+}
+
+// every pair appears in the potential of both its bodies, except that test particles pull on nothing: there the
+// massive bodies' potential counts the massive pairs twice and each asteroid's counts its own pairs once
+double PhysicsWorld::potentialEnergy() const
+{
+    const BodyRange asteroids = bodies.range(BODY_ASTEROID);
+    double sum = 0.0;
+    for (size_t i = 0; i < bodies.size(); ++i) {
+        const bool once = solver == SOLVER_TEST_PARTICLES && i >= asteroids.begin && i < asteroids.end;
+        sum += (once ? 1.0 : 0.5) * bodies.mass[i] * potential[i];
+    }
+    return G * sum;
+}
+
+double PhysicsWorld::totalEnergy() const
+{
+    const size_t n = bodies.size();
+    double kinetic = 0.0, potential = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        glm::dvec3 v(bodies.velocity[i]);
+        kinetic += 0.5 * bodies.mass[i] * glm::dot(v, v);
+        for (size_t j = i + 1; j < n; ++j) {
+            glm::dvec3 r = glm::dvec3(bodies.position[j]) - glm::dvec3(bodies.position[i]);
+            double dist = std::sqrt(std::max(glm::dot(r, r), static_cast<double>(epsilonSq)));
+            potential -= G * static_cast<double>(bodies.mass[i]) * bodies.mass[j] / dist;
+        }
+    }
+    return kinetic + potential;
+}
+
+// pair terms of the direct solver: massive targets sum every body, asteroid targets skip the belt without self-gravity
+unsigned long long PhysicsWorld::directInteractions(size_t massiveTargets, size_t asteroidTargets, size_t asteroidCount) const
+{
+    const unsigned long long n = bodies.size();
+    const unsigned long long asteroidSources = asteroidSelfGravity ? n : n - asteroidCount;
+    return massiveTargets * n + asteroidTargets * asteroidSources;
+}
+
+// packs every non-asteroid body into massiveSoA. M is a handful of bodies, so the whole list stays in L1
+// while the kernel streams the asteroids past it.
+void PhysicsWorld::loadMassiveSources()
+{
+    const BodyRange asteroids = bodies.range(BODY_ASTEROID);
+    massiveIndices.clear();
+    for (size_t i = 0; i < bodies.size(); ++i)
+        if (i < asteroids.begin || i >= asteroids.end) massiveIndices.push_back(static_cast<unsigned int>(i));
+    massiveSoA.gather(bodies.position.data(), bodies.mass.data(), massiveIndices.data(), massiveIndices.size(), forceOrigin);
+}
+
+// the sun is where resolution matters most, so float force sums are taken relative to it
+void PhysicsWorld::updateForceOrigin()
+{
+    forceOrigin = bodies.count(BODY_SUN) > 0 ? bodies.position[bodies.range(BODY_SUN).begin] : glm::dvec3(0.0);
+}
+
+void PhysicsWorld::loadTreePositions()
+{
+    const size_t n = bodies.size();
+    treePositions.resize(n);
+    for (size_t i = 0; i < n; ++i) treePositions[i] = glm::vec3(bodies.position[i] - forceOrigin);
+}
+
+void PhysicsWorld::buildTree()
+{
+    PROFILE_SCOPE("PhysicsWorld::buildTree");
+    PerfScope perf("tree build");
+    loadTreePositions();
+    tree.build(treePositions.data(), bodies.mass.data(), bodies.size());
+}
+
+// fills fmmAccelerations (without G) for every body, the field costs the same however many targets need it
+void PhysicsWorld::evaluateMultipole(float* potentials)
+{
+    PerfScope perf("multipole", &interactionsLastStep);
+    loadTreePositions();
+    fmmAccelerations.resize(bodies.size());
+    fmm.evaluate(treePositions.data(), bodies.mass.data(), bodies.size(), epsilonSq, fmmAccelerations.data(),
+                 static_cast<unsigned int>(threads), &interactionsLastStep, potentials);
+    if (fmmValidationSample > 0)
+        validateMultipole();
+}
+
+void PhysicsWorld::evaluateParticleMesh(float* potentials)
+{
+    PROFILE_SCOPE("PhysicsWorld::evaluateParticleMesh");
+    PerfScope perf("particle mesh", &interactionsLastStep);
+    loadTreePositions();
+    meshAccelerations.resize(bodies.size());
+    particleMesh.evaluate(treePositions.data(), bodies.mass.data(), bodies.size(), epsilonSq, meshAccelerations.data(),
+                          static_cast<unsigned int>(threads), &interactionsLastStep, potentials);
+}
+
+// the direct sum in double is the reference, on fmmValidationSample bodies spread evenly over the index range
+void PhysicsWorld::validateMultipole()
+{
+    const size_t n = bodies.size();
+    const size_t sample = std::min<size_t>(n, fmmValidationSample);
+    fmmError = 0.0f;
+    for (size_t s = 0; s < sample; ++s) {
+        const size_t i = s * n / sample;
+        glm::dvec3 reference(0.0);
+        for (size_t j = 0; j < n; ++j) {
+            if (j == i) continue;
+            glm::dvec3 r = bodies.position[j] - bodies.position[i];
+            double distSq = std::max(glm::dot(r, r), static_cast<double>(epsilonSq));
+            reference += r * (bodies.mass[j] / (distSq * std::sqrt(distSq)));
+        }
+        double len = glm::length(reference);
+        if (len > 0.0)
+            fmmError = std::max(fmmError, static_cast<float>(glm::length(glm::dvec3(fmmAccelerations[i]) - reference) / len));
+    }
+}
+
+// the force evaluation shared by every integrator: overwrites bodies.acceleration from the current positions
+void PhysicsWorld::computeAccelerations()
+{
+    PROFILE_SCOPE("PhysicsWorld::computeAccelerations");
+    PerfScope perf("force", &interactionsLastStep);
+    const size_t n = bodies.size();
+    const glm::dvec3* position = bodies.position.data();
+    const float* mass = bodies.mass.data();
+    const uint8_t* flags = bodies.flags.data();
+    glm::vec3* acceleration = bodies.acceleration.data();
+    const BodyRange asteroids = bodies.range(BODY_ASTEROID);
+    std::fill(bodies.acceleration.begin(), bodies.acceleration.end(), glm::vec3(0.0f));
+    updateForceOrigin();
+    if (wantPotential) potential.assign(n, 0.0f);
+    float* phi = wantPotential ? potential.data() : nullptr;
+
+    if (solver == SOLVER_BARNES_HUT) {
+        buildTree();
+        PROFILE_SCOPE("tree traversal");
+        sliceInteractions.assign(workerPool().size(), 0);
+        // the tree is read-only during traversal and each slice owns its range of acceleration
+        workerPool().parallelFor(0, n, [&](size_t begin, size_t end, unsigned int slice) {
+            for (size_t i = begin; i < end; ++i) {
+                if ((flags[i] & BODY_FLAG_STATIC) && !phi) continue;
+                glm::vec3 a = tree.accelerationAt(treePositions[i], theta, epsilonSq, &sliceInteractions[slice], phi ? phi + i : nullptr,
+                                                  static_cast<ForceLaw>(forceLaw), static_cast<ForcePrecision>(forcePrecision));
+                if (!(flags[i] & BODY_FLAG_STATIC)) acceleration[i] += G * a;
+            }
+        }, static_cast<unsigned int>(threads));
+        for (unsigned long long count : sliceInteractions) interactionsLastStep += count;
+    } else if (solver == SOLVER_FMM) {
+        evaluateMultipole(phi);
+        for (size_t i = 0; i < n; ++i) {
+            if (flags[i] & BODY_FLAG_STATIC) continue;
+            acceleration[i] = G * fmmAccelerations[i];
+        }
+    } else if (solver == SOLVER_PARTICLE_MESH) {
+        evaluateParticleMesh(phi);
+        for (size_t i = 0; i < n; ++i) {
+            if (flags[i] & BODY_FLAG_STATIC) continue;
+            acceleration[i] = G * meshAccelerations[i];
+        }
+    } else if (solver == SOLVER_TEST_PARTICLES) {
+        // O(N*M): every target, massive or not, only sums the compact massive list
+        soa.load(position, mass, n, forceOrigin);
+        loadMassiveSources();
+        workerPool().parallelFor(0, n, [&](size_t begin, size_t end, unsigned int) {
+            pairForces(soa, begin, end, massiveSoA, 0, massiveSoA.count, wantPotential);
+        }, static_cast<unsigned int>(threads));
+        interactionsLastStep += static_cast<unsigned long long>(n) * massiveSoA.count;
+        if (phi) std::copy(soa.pot.begin(), soa.pot.begin() + n, phi);
+        for (size_t i = 0; i < n; ++i) {
+            if (flags[i] & BODY_FLAG_STATIC) continue;
+            acceleration[i] += G * glm::vec3(soa.ax[i], soa.ay[i], soa.az[i]);
+        }
+    } else {
+        // massive bodies feel everything, asteroids skip the asteroid range unless self-gravity is on
+        soa.load(position, mass, n, forceOrigin);
+        GravityKernel kernel = static_cast<GravityKernel>(forceKernel);
+        workerPool().parallelFor(0, n, [&](size_t begin, size_t end, unsigned int) {
+            size_t massiveEnd = std::min(end, asteroids.begin);
+            pairForces(soa, begin, massiveEnd, soa, 0, n, wantPotential);
+            size_t astBegin = std::max(begin, asteroids.begin), astEnd = std::min(end, asteroids.end);
+            if (astBegin >= astEnd) return;
+            if (asteroidSelfGravity) {
+                pairForces(soa, astBegin, astEnd, soa, 0, n, wantPotential);
+            } else {
+                pairForces(soa, astBegin, astEnd, soa, 0, asteroids.begin, wantPotential);
+                pairForces(soa, astBegin, astEnd, soa, asteroids.end, n, wantPotential);
+            }
+        }, static_cast<unsigned int>(threads));
+        interactionsLastStep += directInteractions(asteroids.begin, asteroids.size(), asteroids.size());
+        if (phi) std::copy(soa.pot.begin(), soa.pot.begin() + n, phi);
+
+        if (validateForceKernel && kernel != KERNEL_SCALAR && forceLaw == FORCE_NEWTONIAN && forcePrecision == PRECISION_FLOAT) {
+            // the scalar loop is the reference, checked on a small sample of targets
+            GravitySoA& reference = referenceSoA;
+            reference = soa;
+            size_t sample = std::min<size_t>(n, 64);
+            std::fill(reference.ax.begin(), reference.ax.begin() + sample, 0.0f);
+            std::fill(reference.ay.begin(), reference.ay.begin() + sample, 0.0f);
+            std::fill(reference.az.begin(), reference.az.begin() + sample, 0.0f);
+            gravityKernelScalar(reference, 0, std::min(sample, asteroids.begin), 0, n, epsilonSq);
+            if (sample > asteroids.begin) {
+                size_t sourceEnd = asteroidSelfGravity ? n : asteroids.begin;
+                gravityKernelScalar(reference, asteroids.begin, sample, 0, sourceEnd, epsilonSq);
+                if (!asteroidSelfGravity)
+                    gravityKernelScalar(reference, asteroids.begin, sample, asteroids.end, n, epsilonSq);
+            }
+            forceKernelError = 0.0f;
+            for (size_t i = 0; i < sample; ++i) {
+                glm::vec3 simd(soa.ax[i], soa.ay[i], soa.az[i]);
+                glm::vec3 scalar(reference.ax[i], reference.ay[i], reference.az[i]);
+                float len = glm::length(scalar);
+                if (len > 0.0f) forceKernelError = std::max(forceKernelError, glm::length(simd - scalar) / len);
+            }
+        }
+
+        for (size_t i = 0; i < n; ++i) {
+            if ((flags[i] & BODY_FLAG_STATIC) || mass[i] == 0.0f) continue;
+            acceleration[i] += G * glm::vec3(soa.ax[i], soa.ay[i], soa.az[i]);
+        }
+    }
+}
+
+// block-timestep force evaluation: overwrites the acceleration of just the listed (sorted) targets
+void PhysicsWorld::computeAccelerationsFor(const std::vector<unsigned int>& targets)
+{
+    const size_t n = bodies.size();
+    const size_t k = targets.size();
+    const glm::dvec3* position = bodies.position.data();
+    const float* mass = bodies.mass.data();
+    const uint8_t* flags = bodies.flags.data();
+    glm::vec3* acceleration = bodies.acceleration.data();
+    const BodyRange asteroids = bodies.range(BODY_ASTEROID);
+    for (unsigned int i : targets) acceleration[i] = glm::vec3(0.0f);
+    updateForceOrigin();
+
+    if (solver == SOLVER_BARNES_HUT) {
+        buildTree();
+        sliceInteractions.assign(workerPool().size(), 0);
+        workerPool().parallelFor(0, k, [&](size_t begin, size_t end, unsigned int slice) {
+            for (size_t t = begin; t < end; ++t) {
+                unsigned int i = targets[t];
+                if (flags[i] & BODY_FLAG_STATIC) continue;
+                acceleration[i] = G * tree.accelerationAt(treePositions[i], theta, epsilonSq, &sliceInteractions[slice], nullptr,
+                                                              static_cast<ForceLaw>(forceLaw), static_cast<ForcePrecision>(forcePrecision));
+            }
+        }, static_cast<unsigned int>(threads));
+        for (unsigned long long count : sliceInteractions) interactionsLastStep += count;
+        return;
+    }
+
+    if (solver == SOLVER_FMM) {
+        evaluateMultipole();
+        for (unsigned int i : targets) {
+            if (flags[i] & BODY_FLAG_STATIC) continue;
+            acceleration[i] = G * fmmAccelerations[i];
+        }
+        return;
+    }
+
+    // the mesh is solved for everyone at once, like the multipoles
+    if (solver == SOLVER_PARTICLE_MESH) {
+        evaluateParticleMesh();
+        for (unsigned int i : targets) {
+            if (flags[i] & BODY_FLAG_STATIC) continue;
+            acceleration[i] = G * meshAccelerations[i];
+        }
+        return;
+    }
+
+    if (solver == SOLVER_TEST_PARTICLES) {
+        testParticleAccelerationsFor(targets);
+        return;
+    }
+
+    // targets are gathered so the SIMD kernels still see contiguous lanes
+    activeSoA.gather(position, mass, targets.data(), k, forceOrigin);
+    soa.load(position, mass, n, forceOrigin);
+    const size_t firstAsteroid = std::lower_bound(targets.begin(), targets.end(), asteroids.begin) - targets.begin();
+    workerPool().parallelFor(0, k, [&](size_t begin, size_t end, unsigned int) {
+        size_t massiveEnd = std::min(end, firstAsteroid);
+        pairForces(activeSoA, begin, massiveEnd, soa, 0, n);
+        size_t astBegin = std::max(begin, firstAsteroid);
+        if (astBegin >= end) return;
+        if (asteroidSelfGravity) {
+            pairForces(activeSoA, astBegin, end, soa, 0, n);
+        } else {
+            pairForces(activeSoA, astBegin, end, soa, 0, asteroids.begin);
+            pairForces(activeSoA, astBegin, end, soa, asteroids.end, n);
+        }
+    }, static_cast<unsigned int>(threads));
+    interactionsLastStep += directInteractions(firstAsteroid, k - firstAsteroid, asteroids.size());
+
+    for (size_t t = 0; t < k; ++t) {
+        unsigned int i = targets[t];
+        if ((flags[i] & BODY_FLAG_STATIC) || mass[i] == 0.0f) continue;
+        acceleration[i] = G * glm::vec3(activeSoA.ax[t], activeSoA.ay[t], activeSoA.az[t]);
+    }
+}
+
+
+void PhysicsWorld::pairForces(GravitySoA& targets, size_t tBegin, size_t tEnd, const GravitySoA& sources, size_t sBegin, size_t sEnd,
+                              bool potential) const
+{
+    gravityKernel(static_cast<GravityKernel>(forceKernel), static_cast<ForceLaw>(forceLaw), static_cast<ForcePrecision>(forcePrecision),
+                  targets, tBegin, tEnd, sources, sBegin, sEnd, epsilonSq, potential);
+}
+
+// overwrites the acceleration of the listed targets with the pull of the massive bodies alone
+void PhysicsWorld::testParticleAccelerationsFor(const std::vector<unsigned int>& targets)
+{
+    const size_t k = targets.size();
+    const uint8_t* flags = bodies.flags.data();
+    glm::vec3* acceleration = bodies.acceleration.data();
+    updateForceOrigin();
+    activeSoA.gather(bodies.position.data(), bodies.mass.data(), targets.data(), k, forceOrigin);
+    loadMassiveSources();
+    workerPool().parallelFor(0, k, [&](size_t begin, size_t end, unsigned int) {
+        pairForces(activeSoA, begin, end, massiveSoA, 0, massiveSoA.count);
+    }, static_cast<unsigned int>(threads));
+    interactionsLastStep += static_cast<unsigned long long>(k) * massiveSoA.count;
+    for (size_t t = 0; t < k; ++t) {
+        unsigned int i = targets[t];
+        acceleration[i] = (flags[i] & BODY_FLAG_STATIC) ? glm::vec3(0.0f) : G * glm::vec3(activeSoA.ax[t], activeSoA.ay[t], activeSoA.az[t]);
+    }
+}
+
+// encounter spheres: keplerHillFactor Hill radii around each planet, r_H = d * cbrt(m / 3M)
+void PhysicsWorld::keplerEncounterSpheres(size_t sun)
+{
+    const BodyRange planets = bodies.range(BODY_PLANET);
+    const glm::dvec3* position = bodies.position.data();
+    keplerSpheres.clear();
+    for (size_t p = planets.begin; p < planets.end; ++p) {
+        double d = glm::length(position[p] - position[sun]);
+        double hill = bodies.mass[sun] > 0.0f ? d * std::cbrt(bodies.mass[p] / (3.0 * bodies.mass[sun])) : d;
+        double radius = keplerHillFactor * hill;
+        keplerSpheres.push_back(glm::dvec4(position[p], radius * radius));
+    }
+}
+
+// Keplerian step. The massive bodies and the asteroids near a planet take one leapfrog step under the massive
+// bodies' gravity, every other asteroid is advanced exactly along its heliocentric two-body orbit and carried
+// along with the sun. The planets' pull on those asteroids is neglected, which is what keeps them O(1) for any dt.
+void PhysicsWorld::stepKepler(float dt)
+{
+    const BodyRange asteroids = bodies.range(BODY_ASTEROID);
+    glm::dvec3* position = bodies.position.data();
+    glm::dvec3* velocity = bodies.velocity.data();
+    const uint8_t* flags = bodies.flags.data();
+    if (bodies.count(BODY_SUN) == 0) {
+        integrator.step(bodies, dt, [this]() { computeAccelerations(); });
+        return;
+    }
+    const size_t sun = bodies.range(BODY_SUN).begin;
+    const double mu = static_cast<double>(G) * bodies.mass[sun];
+    const glm::dvec3 sunPosBefore(position[sun]), sunVelBefore(velocity[sun]);
+
+    keplerEncounterSpheres(sun);
+    const std::vector<glm::dvec4>& spheres = keplerSpheres;
+    keplerNear.assign(asteroids.size(), 0);
+    workerPool().parallelFor(asteroids.begin, asteroids.end, [&](size_t begin, size_t end, unsigned int) {
+        for (size_t i = begin; i < end; ++i) {
+            for (const glm::dvec4& s : spheres) {
+                glm::dvec3 r = position[i] - glm::dvec3(s);
+                if (glm::dot(r, r) < s.w) { keplerNear[i - asteroids.begin] = 1; break; }
+            }
+        }
+    }, static_cast<unsigned int>(threads));
+
+    keplerNumerical.clear();
+    for (size_t i = 0; i < bodies.size(); ++i)
+        if (i < asteroids.begin || i >= asteroids.end || keplerNear[i - asteroids.begin])
+            keplerNumerical.push_back(static_cast<unsigned int>(i));
+
+    // KDK leapfrog for the numerical set, the handful of targets makes the two force sums cheap
+    const float halfDt = 0.5f * dt;
+    testParticleAccelerationsFor(keplerNumerical);
+    for (unsigned int i : keplerNumerical) {
+        if (flags[i] & BODY_FLAG_STATIC) continue;
+        velocity[i] += halfDt * bodies.acceleration[i];
+        position[i] += static_cast<double>(dt) * velocity[i];
+    }
+    testParticleAccelerationsFor(keplerNumerical);
+    for (unsigned int i : keplerNumerical) {
+        if (flags[i] & BODY_FLAG_STATIC) continue;
+        velocity[i] += halfDt * bodies.acceleration[i];
+    }
+
+    const glm::dvec3 sunPosAfter(position[sun]), sunVelAfter(velocity[sun]);
+    sliceInteractions.assign(workerPool().size(), 0);
+    workerPool().parallelFor(asteroids.begin, asteroids.end, [&](size_t begin, size_t end, unsigned int slice) {
+        unsigned long long analytic = 0;
+        for (size_t i = begin; i < end; ++i) {
+            if (keplerNear[i - asteroids.begin] || (flags[i] & BODY_FLAG_STATIC)) continue;
+            glm::dvec3 r = position[i] - sunPosBefore;
+            glm::dvec3 v = velocity[i] - sunVelBefore;
+            if (keplerPropagate(r, v, mu, dt)) {
+                position[i] = sunPosAfter + r;
+                velocity[i] = sunVelAfter + v;
+            } else {
+                // degenerate orbit (e.g. sun mass zero), coast instead
+                position[i] += static_cast<double>(dt) * velocity[i];
+            }
+            analytic++;
+        }
+        sliceInteractions[slice] += analytic;
+    }, static_cast<unsigned int>(threads));
+    for (unsigned long long count : sliceInteractions) keplerBodiesLastStep += count;
+
+    // the cached accelerations no longer match the positions of the analytic bodies
+    integrator.invalidate();
+    blockStepper.invalidate();
+}
+
+// Multi-rate step. The massive bodies take a KDK leapfrog step, every asteroid drifts along its heliocentric
+// two-body orbit carried with the sun, and the force sums kick each asteroid by what that orbit leaves out: its
+// acceleration less the sun's pull on it and less the sun's own acceleration, the frame it orbits in. Full-rate
+// asteroids take both kicks like the massive bodies, those of a sector due this step only the closing one, for all
+// the time since they were last kicked; everyone else only drifts.
+void PhysicsWorld::stepSectors(float dt)
+{
+    PROFILE_SCOPE("PhysicsWorld::stepSectors");
+    const BodyRange asteroids = bodies.range(BODY_ASTEROID);
+    glm::dvec3* position = bodies.position.data();
+    glm::dvec3* velocity = bodies.velocity.data();
+    if (bodies.count(BODY_SUN) == 0 || asteroids.size() == 0) {
+        integrator.step(bodies, dt, [this]() { computeAccelerations(); });
+        return;
+    }
+    const size_t sun = bodies.range(BODY_SUN).begin;
+    const double mu = static_cast<double>(G) * bodies.mass[sun];
+    const double stepStart = simTime, halfDt = 0.5 * dt;
+    if (sectorClock.size() != bodies.size()) sectorClock.assign(bodies.size(), stepStart);
+
+    sectors.assign(bodies, position[sun], static_cast<unsigned int>(threads));
+    keplerEncounterSpheres(sun);
+    sectorRate.swap(sectorRatePrevious);
+    sectorRate.assign(asteroids.size(), 0);
+    workerPool().parallelFor(asteroids.begin, asteroids.end, [&](size_t begin, size_t end, unsigned int) {
+        for (size_t i = begin; i < end; ++i) {
+            const unsigned int s = sectors.sectorOfAsteroid(i - asteroids.begin);
+            uint8_t rate = sectors.sectors()[s].level == 0 ? 2 : sectors.due(s, stepCount) ? 1 : 0;
+            for (size_t p = 0; rate < 2 && p < keplerSpheres.size(); ++p) {
+                const glm::dvec3 r = position[i] - glm::dvec3(keplerSpheres[p]);
+                if (glm::dot(r, r) < keplerSpheres[p].w) rate = 2;
+            }
+            sectorRate[i - asteroids.begin] = rate;
+        }
+    }, static_cast<unsigned int>(threads));
+
+    // what the last step's closing sums left at these positions is reused, only bodies that had none are summed
+    const bool reuse = sectorForcesCurrent && sectorRatePrevious.size() == asteroids.size();
+    sectorFull.clear();
+    sectorDue.clear();
+    sectorMissing.clear();
+    for (size_t i = 0; i < bodies.size(); ++i) {
+        const bool asteroid = i >= asteroids.begin && i < asteroids.end;
+        const uint8_t rate = asteroid ? sectorRate[i - asteroids.begin] : 2;
+        if (rate == 2) {
+            sectorFull.push_back(static_cast<unsigned int>(i));
+            if (!reuse || (asteroid && sectorRatePrevious[i - asteroids.begin] == 0))
+                sectorMissing.push_back(static_cast<unsigned int>(i));
+        }
+        if (rate >= 1) sectorDue.push_back(static_cast<unsigned int>(i));
+    }
+
+    // half a step for the massive bodies, and every asteroid is carried along with the sun's half-step kick. Those
+    // of at least minRate are kicked by their perturbation as well, from their clock up to until, and a due one on
+    // through half of its next stride: each stride is then a leapfrog step of its own, kick, drift, kick, with the
+    // two kicks between strides merged. A change of rate only changes how far ahead the clock is.
+    auto kick = [&](uint8_t minRate, double until) {
+        const glm::dvec3 sunAcceleration(bodies.acceleration[sun]);
+        const glm::dvec3 sunKick = bodies.isStatic(sun) ? glm::dvec3(0.0) : sunAcceleration * halfDt;
+        const glm::dvec3 sunPos(position[sun]);
+        workerPool().parallelFor(0, bodies.size(), [&](size_t begin, size_t end, unsigned int) {
+            for (size_t i = begin; i < end; ++i) {
+                if (bodies.isStatic(i)) continue;
+                glm::dvec3 a(bodies.acceleration[i]);
+                if (i < asteroids.begin || i >= asteroids.end) {
+                    velocity[i] += a * halfDt;
+                    continue;
+                }
+                velocity[i] += sunKick;
+                if (sectorRate[i - asteroids.begin] < minRate) continue;
+                const glm::dvec3 r = position[i] - sunPos;
+                const double r2 = std::max(glm::dot(r, r), static_cast<double>(epsilonSq));
+                a += r * (mu / (r2 * std::sqrt(r2))) - sunAcceleration;
+                const uint8_t rate = sectorRate[i - asteroids.begin];
+                const double to = rate == 1 ? until + halfDt * sectors.stride(sectors.sectorOfAsteroid(i - asteroids.begin)) : until;
+                velocity[i] += a * (to - sectorClock[i]);
+                sectorClock[i] = to;
+            }
+        }, static_cast<unsigned int>(threads));
+    };
+
+    if (!sectorMissing.empty()) computeAccelerationsFor(sectorMissing);
+    kick(2, stepStart + halfDt);
+
+    const glm::dvec3 sunPosBefore(position[sun]), sunVel(velocity[sun]);
+    for (size_t m = 0; m < asteroids.begin; ++m)
+        if (!bodies.isStatic(m)) position[m] += velocity[m] * static_cast<double>(dt);
+    for (size_t i = asteroids.end; i < bodies.size(); ++i)
+        if (!bodies.isStatic(i)) position[i] += velocity[i] * static_cast<double>(dt);
+    const glm::dvec3 sunPosAfter(position[sun]);
+    workerPool().parallelFor(asteroids.begin, asteroids.end, [&](size_t begin, size_t end, unsigned int) {
+        for (size_t i = begin; i < end; ++i) {
+            if (bodies.isStatic(i)) continue;
+            glm::dvec3 r = position[i] - sunPosBefore;
+            glm::dvec3 v = velocity[i] - sunVel;
+            if (keplerPropagate(r, v, mu, dt)) {
+                position[i] = sunPosAfter + r;
+                velocity[i] = sunVel + v;
+            } else {
+                // degenerate orbit, coast instead
+                position[i] += static_cast<double>(dt) * velocity[i];
+            }
+        }
+    }, static_cast<unsigned int>(threads));
+
+    computeAccelerationsFor(sectorDue);
+    kick(1, stepStart + dt);
+
+    const size_t massive = bodies.size() - asteroids.size();
+    sectorFullRateLastStep = sectorFull.size() - massive;
+    sectorTargetsLastStep = sectorDue.size() + sectorMissing.size();
+    // only the closing targets' accelerations are at the new positions
+    integrator.invalidate();
+    blockStepper.invalidate();
+    encounterForcesCurrent = false;
+    sectorForcesCurrent = true;
+}
+
+uint32_t PhysicsWorld::encounterPrimaryOf(size_t i, double lookahead) const
+{
+    const BodyRange asteroids = bodies.range(BODY_ASTEROID);
+    if (i < asteroids.begin || i >= asteroids.end) return BodyStore::INVALID_INDEX;
+    // inside the encounter radius cbrt(GM T^2), compared as r^3 < GM T^2
+    const double reach = static_cast<double>(G) * encounterTimescale * encounterTimescale;
+    uint32_t primary = BodyStore::INVALID_INDEX;
+    double strongest = 0.0;
+    for (size_t m = 0; m < asteroids.begin; ++m) {
+        const double mass = bodies.mass[m];
+        glm::dvec3 r = bodies.position[i] - bodies.position[m];
+        if (lookahead > 0.0) {
+            const glm::dvec3 v = bodies.velocity[i] - bodies.velocity[m];
+            const double vv = glm::dot(v, v);
+            if (vv > 0.0) r += v * std::clamp(-glm::dot(r, v) / vv, 0.0, lookahead);
+        }
+        const double r2 = glm::dot(r, r);
+        if (mass <= 0.0 || r2 * std::sqrt(r2) >= reach * mass) continue;
+        const double pull = mass / std::max(r2, static_cast<double>(epsilonSq));
+        if (pull > strongest) {
+            strongest = pull;
+            primary = static_cast<uint32_t>(m);
+        }
+    }
+    return primary;
+}
+
+// KDK leapfrog split for the asteroids in an encounter: the drift follows the two-body orbit around the primary,
+// the kicks everything but the primary's pull. Returns false without touching the bodies when there is no
+// encounter, the integrator takes the step then.
+bool PhysicsWorld::stepEncounters(float dt)
+{
+    PROFILE_SCOPE("PhysicsWorld::stepEncounters");
+    const BodyRange asteroids = bodies.range(BODY_ASTEROID);
+    encounterPrimary.assign(asteroids.size(), BodyStore::INVALID_INDEX);
+    if (asteroids.size() == 0 || asteroids.begin == 0) return false;
+    workerPool().parallelFor(asteroids.begin, asteroids.end, [&](size_t begin, size_t end, unsigned int) {
+        for (size_t i = begin; i < end; ++i)
+            if (!bodies.isStatic(i)) encounterPrimary[i - asteroids.begin] = encounterPrimaryOf(i, dt);
+    }, static_cast<unsigned int>(threads));
+    size_t count = 0;
+    for (uint32_t m : encounterPrimary) count += m != BodyStore::INVALID_INDEX;
+    if (count == 0) return false;
+
+    if (!encounterForcesCurrent) computeAccelerations();
+    encounterKick(0.5 * dt);
+    encounterDrift(dt);
+    computeAccelerations();
+    encounterKick(0.5 * dt);
+    encountersLastStep = count;
+    // the accelerations are at the final positions, but the integrator's own cache may be from before this step
+    encounterForcesCurrent = true;
+    integrator.invalidate();
+    return true;
+}
+
+// v += h * (a - the primary's pull), the pull taken as the force pass softens it. In float the pass's sum keeps
+// the primary's pull to about 1e-7 of itself, which bounds how well the rest is resolved that close.
+void PhysicsWorld::encounterKick(double h)
+{
+    const BodyRange asteroids = bodies.range(BODY_ASTEROID);
+    const glm::dvec3* position = bodies.position.data();
+    glm::dvec3* velocity = bodies.velocity.data();
+    const double mu = G;
+    workerPool().parallelFor(0, bodies.size(), [&](size_t begin, size_t end, unsigned int) {
+        for (size_t i = begin; i < end; ++i) {
+            if (bodies.isStatic(i)) continue;
+            glm::dvec3 a(bodies.acceleration[i]);
+            const uint32_t m = i >= asteroids.begin && i < asteroids.end ? encounterPrimary[i - asteroids.begin] : BodyStore::INVALID_INDEX;
+            if (m != BodyStore::INVALID_INDEX) {
+                const glm::dvec3 r = position[i] - position[m];
+                const double r2 = std::max(glm::dot(r, r), static_cast<double>(epsilonSq));
+                a += r * (mu * bodies.mass[m] / (r2 * std::sqrt(r2)));
+            }
+            velocity[i] += a * h;
+        }
+    }, static_cast<unsigned int>(threads));
+}
+
+// straight lines for everything outside an encounter, the primary's included, and two-body orbits around the
+// primary's moving frame for the rest
+void PhysicsWorld::encounterDrift(double h)
+{
+    const BodyRange asteroids = bodies.range(BODY_ASTEROID);
+    glm::dvec3* position = bodies.position.data();
+    glm::dvec3* velocity = bodies.velocity.data();
+    primaryPositions.assign(position, position + asteroids.begin);
+    for (size_t m = 0; m < asteroids.begin; ++m)
+        if (!bodies.isStatic(m)) position[m] += velocity[m] * h;
+    for (size_t i = asteroids.end; i < bodies.size(); ++i)
+        if (!bodies.isStatic(i)) position[i] += velocity[i] * h;
+    const double mu = G;
+    workerPool().parallelFor(asteroids.begin, asteroids.end, [&](size_t begin, size_t end, unsigned int) {
+        for (size_t i = begin; i < end; ++i) {
+            if (bodies.isStatic(i)) continue;
+            const uint32_t m = encounterPrimary[i - asteroids.begin];
+            if (m != BodyStore::INVALID_INDEX) {
+                glm::dvec3 r = position[i] - primaryPositions[m];
+                glm::dvec3 v = velocity[i] - velocity[m];
+                if (keplerPropagate(r, v, mu * bodies.mass[m], h)) {
+                    position[i] = position[m] + r;
+                    velocity[i] = velocity[m] + v;
+                    continue;
+                }
+            }
+            // a degenerate orbit (a head-on fall) coasts like the rest
+            position[i] += velocity[i] * h;
+        }
+    }, static_cast<unsigned int>(threads));
+}
+
+// One step of the multiple-timestep scheme, a leapfrog step in the fast force with the slow impulses at the ends of
+// the cycle. The first step of a cycle opens it with half the cycle's slow impulse, from the sum the previous cycle
+// closed with; the last sums the slow part at its end positions and kicks the rest of the cycle's impulse.
+void PhysicsWorld::stepRespa(float dt)
+{
+    PROFILE_SCOPE("PhysicsWorld::stepRespa");
+    if (bodies.count(BODY_SUN) == 0) {
+        integrator.step(bodies, dt, [this]() { computeAccelerations(); });
+        return;
+    }
+    const double h = dt;
+    if (respaPhase == 0) {
+        if (!respaSlowCurrent) respaSlowForces();
+        respaCycleSteps = respaSteps;
+        respaImpulse = 0.5 * h * respaCycleSteps;
+        respaElapsed = 0.0;
+        respaKick(respaImpulse, true);
+    }
+    if (!respaFastCurrent) respaFastForces();
+    respaKick(0.5 * h, false);
+    glm::dvec3* position = bodies.position.data();
+    const glm::dvec3* velocity = bodies.velocity.data();
+    workerPool().parallelFor(0, bodies.size(), [&](size_t begin, size_t end, unsigned int) {
+        for (size_t i = begin; i < end; ++i)
+            if (!bodies.isStatic(i)) position[i] += velocity[i] * h;
+    }, static_cast<unsigned int>(threads));
+    respaElapsed += h;
+    respaPhase++;
+    if (!ephemerisIds.empty()) placeEphemerisBodies(simTime + h);
+
+    if (respaPhase >= respaCycleSteps) {
+        respaSlowForces();
+        respaKick(0.5 * h, false);
+        respaKick(respaElapsed - respaImpulse, true);
+        respaPhase = 0;
+        respaSlowCurrent = true;
+    } else {
+        respaFastForces();
+        respaKick(0.5 * h, false);
+        respaSlowCurrent = false;
+    }
+    // bodies.acceleration is only the fast part
+    integrator.invalidate();
+    blockStepper.invalidate();
+    encounterForcesCurrent = false;
+    sectorForcesCurrent = false;
+}
+
+// ends a cycle cut short with the slow impulse it owes for the time it ran, which may take some of the opening back
+void PhysicsWorld::closeRespaCycle()
+{
+    respaSlowForces();
+    respaKick(respaElapsed - respaImpulse, true);
+    respaPhase = 0;
+    integrator.invalidate();
+}
+
+// the fast part into bodies.acceleration: each pair with a sun, both ways, in double under the solver's force law.
+// A sun's own term vanishes at zero separation, and its pull from the other bodies is summed per slice.
+void PhysicsWorld::respaFastForces()
+{
+    const BodyRange suns = bodies.range(BODY_SUN);
+    const size_t n = bodies.size();
+    const glm::dvec3* position = bodies.position.data();
+    const float* mass = bodies.mass.data();
+    glm::vec3* acceleration = bodies.acceleration.data();
+    const double g = G;
+    respaFast.resize(n);
+    respaReactions.assign(static_cast<size_t>(workerPool().size()) * suns.size(), glm::dvec3(0.0));
+    withForcePolicies(static_cast<ForceLaw>(forceLaw), PRECISION_DOUBLE, epsilonSq, [&](const auto& law, auto precision) {
+        typedef typename decltype(precision)::Real Real;
+        workerPool().parallelFor(0, n, [&](size_t begin, size_t end, unsigned int slice) {
+            glm::dvec3* reactions = respaReactions.data() + static_cast<size_t>(slice) * suns.size();
+            for (size_t i = begin; i < end; ++i) {
+                const double reacts = i >= suns.begin && i < suns.end ? 0.0 : static_cast<double>(mass[i]);
+                glm::dvec3 a(0.0);
+                for (size_t s = suns.begin; s < suns.end; ++s) {
+                    const glm::dvec3 d = position[s] - position[i];
+                    Real factor, phi;
+                    law.template evaluate<false>(static_cast<Real>(glm::dot(d, d)), factor, phi);
+                    a += d * (static_cast<double>(mass[s]) * factor);
+                    reactions[s - suns.begin] -= d * (reacts * factor);
+                }
+                respaFast[i] = g * a;
+                acceleration[i] = glm::vec3(respaFast[i]);
+            }
+        }, static_cast<unsigned int>(threads));
+    });
+    for (size_t slice = 0; slice < workerPool().size(); ++slice)
+        for (size_t s = suns.begin; s < suns.end; ++s)
+            respaFast[s] += g * respaReactions[slice * suns.size() + (s - suns.begin)];
+    for (size_t s = suns.begin; s < suns.end; ++s)
+        acceleration[s] = glm::vec3(respaFast[s]);
+    interactionsLastStep += static_cast<unsigned long long>(n) * suns.size();
+    respaFastCurrent = true;
+}
+
+// the slow part at the current positions into respaSlow, the solver's full sum less the fast part, leaving the fast
+// part in bodies.acceleration
+void PhysicsWorld::respaSlowForces()
+{
+    respaFastForces();
+    computeAccelerations();
+    const size_t n = bodies.size();
+    glm::vec3* acceleration = bodies.acceleration.data();
+    respaSlow.resize(n);
+    workerPool().parallelFor(0, n, [&](size_t begin, size_t end, unsigned int) {
+        for (size_t i = begin; i < end; ++i) {
+            const glm::vec3 fast(respaFast[i]);
+            respaSlow[i] = acceleration[i] - fast;
+            acceleration[i] = fast;
+        }
+    }, static_cast<unsigned int>(threads));
+    respaSlowSums++;
+}
+
+// kicks every moving body by the slow part or by the fast one for h
+void PhysicsWorld::respaKick(double h, bool slow)
+{
+    const glm::vec3* a = slow ? respaSlow.data() : bodies.acceleration.data();
+    glm::dvec3* velocity = bodies.velocity.data();
+    workerPool().parallelFor(0, bodies.size(), [&](size_t begin, size_t end, unsigned int) {
+        for (size_t i = begin; i < end; ++i)
+            if (!bodies.isStatic(i)) velocity[i] += glm::dvec3(a[i]) * h;
+    }, static_cast<unsigned int>(threads));
+}
@@ -9,6 +9,7 @@
 #include <shader.h>
 #include <camera.h>
 #include <model.h>
+#include <cascaded_shadow_map.h>
 
 #include <iostream>
 
@@ -17,9 +18,11 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
 unsigned int loadTexture(const char *path);
-void renderScene(const Shader &shader);
+// which of the scene's casters renderScene draws: the ones that stay put are cached, the moving one composited
+enum SceneCasters { STATIC_CASTERS = 1, DYNAMIC_CASTERS = 2, ALL_CASTERS = 3 };
+void renderScene(const Shader &shader, unsigned int casters = ALL_CASTERS);
 void renderCube();
-void renderQuad();
+glm::vec3 movingCasterPosition(float time);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
@@ -38,6 +41,17 @@ float lastFrame = 0.0f;
 // meshes
 unsigned int planeVAO;
 
+// the one caster that moves, drawn over the cached cascades each frame; the others are static and stay in them
+const float MOVING_CASTER_RADIUS = 0.9f;      // bounding sphere of the 0.5 scaled cube
+float sceneTime = 0.0f;
+
+// tints the lit scene by the cascade it reads
+bool showCascades = false;
+bool showCascadesKeyPressed = false;
+// F switches between 3x3 compared taps and one sample of the blurred moments
+bool filteredShadows = true;
+bool filteredShadowsKeyPressed = false;
+
 int main()
 {
     // glfw: initialize and configure
@@ -83,26 +97,26 @@ int main()
     // build and compile shaders
     // -------------------------
     Shader simpleDepthShader("../shaders.2/3.1.1.shadow_mapping_depth.vs", "../shaders.2/3.1.1.shadow_mapping_depth.fs");
-    Shader debugDepthQuad("../shaders.2/3.1.1.debug_quad.vs", "../shaders.2/3.1.1.debug_quad_depth.fs");
+    Shader shader("../shaders.2/csm.shadow_mapping.vs", "../shaders.2/csm.shadow_mapping.fs");
 
     // set up vertex data (and buffer(s)) and configure vertex attributes
     // ------------------------------------------------------------------
     float planeVertices[] = {
         // positions            // normals         // texcoords
-         25.0f, -0.5f,  25.0f,  0.0f, 1.0f, 0.0f,  25.0f,  0.0f,
-        -25.0f, -0.5f,  25.0f,  0.0f, 1.0f, 0.0f,   0.0f,  0.0f,
-        -25.0f, -0.5f, -25.0f,  0.0f, 1.0f, 0.0f,   0.0f, 25.0f,
+         100.0f, -0.5f,  100.0f,  0.0f, 1.0f, 0.0f,  100.0f,   0.0f,
+        -100.0f, -0.5f,  100.0f,  0.0f, 1.0f, 0.0f,    0.0f,   0.0f,
+        -100.0f, -0.5f, -100.0f,  0.0f, 1.0f, 0.0f,    0.0f, 100.0f,
 
-         25.0f, -0.5f,  25.0f,  0.0f, 1.0f, 0.0f,  25.0f,  0.0f,
-        -25.0f, -0.5f, -25.0f,  0.0f, 1.0f, 0.0f,   0.0f, 25.0f,
-         25.0f, -0.5f, -25.0f,  0.0f, 1.0f, 0.0f,  25.0f, 25.0f
+         100.0f, -0.5f,  100.0f,  0.0f, 1.0f, 0.0f,  100.0f,   0.0f,
+        -100.0f, -0.5f, -100.0f,  0.0f, 1.0f, 0.0f,    0.0f, 100.0f,
+         100.0f, -0.5f, -100.0f,  0.0f, 1.0f, 0.0f,  100.0f, 100.0f
     };
     // plane VAO
     unsigned int planeVBO;
     glGenVertexArrays(1, &planeVAO);
     glGenBuffers(1, &planeVBO);
-    glBindVertexArray(planeVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
+    glState().bindVertexArray(planeVAO);
+    glState().bindBuffer(GL_ARRAY_BUFFER, planeVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(planeVertices), planeVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
@@ -110,42 +124,31 @@ int main()
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(2);
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glBindVertexArray(0);
+    glState().bindVertexArray(0);
 
     // load textures
     // -------------
     unsigned int woodTexture = loadTexture("../textures/wood.png");
 
-    // configure depth map FBO
-    // -----------------------
-    const unsigned int SHADOW_WIDTH = 1024, SHADOW_HEIGHT = 1024;
-    unsigned int depthMapFBO;
-    glGenFramebuffers(1, &depthMapFBO);
-    // create depth texture
-    unsigned int depthMap;
-    glGenTextures(1, &depthMap);
-    glBindTexture(GL_TEXTURE_2D, depthMap);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // attach depth texture as FBO's depth buffer
-    glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
-    glDrawBuffer(GL_NONE);
-    glReadBuffer(GL_NONE);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
+    // configure cascaded depth maps
+    // ------------------------------
+    // one 2048x2048 layer per cascade, the static casters drawn again only where the cascade is fitted again
+    const unsigned int SHADOW_WIDTH = 2048;
+    CascadedShadowMap cascades(SHADOW_WIDTH, 4, "../shaders.2/shadow.blur.cs");
+    cascades.setFarRefresh(0);
+    cascades.setCasterDistance(20.0f);
 
     // shader configuration
     // --------------------
-    debugDepthQuad.use();
-    debugDepthQuad.setInt("depthMap", 0);
+    shader.use();
+    shader.setInt("diffuseTexture", 0);
+    shader.setInt("shadowMap", 1);
+    shader.setInt("shadowMoments", 2);
 
     // lighting info
     // -------------
     glm::vec3 lightPos(-2.0f, 4.0f, -1.0f);
+    const glm::vec3 lightDir = glm::normalize(-lightPos);
 
     // render loop
     // -----------
@@ -156,48 +159,58 @@ int main()
         float currentFrame = static_cast<float>(glfwGetTime());
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
+        sceneTime = currentFrame;
 
         // input
         // -----
         processInput(window);
 
-        // render
-        // ------
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        int width, height;
+        glfwGetFramebufferSize(window, &width, &height);
+        const float aspect = height > 0 ? (float)width / (float)height : 1.0f;
+        const float near_plane = 0.1f, far_plane = 150.0f;
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), aspect, near_plane, far_plane);
+        glm::mat4 view = camera.GetViewMatrix();
+
+        // 1. render depth of the casters into the cascades that need it (from light's perspective)
+        // -----------------------------------------------------------------------------------------
+        // the static casters into the stale tiles of the cache, then the tiles the moving caster covers now or
+        // covered last frame copied back and the moving caster drawn over them
+        cascades.setFiltered(filteredShadows);
+        cascades.update(view, glm::radians(camera.Zoom), aspect, near_plane, far_plane, lightDir);
+        cascades.addDynamicCaster(movingCasterPosition(sceneTime), MOVING_CASTER_RADIUS);
 
-        // 1. render depth of scene to texture (from light's perspective)
-        // --------------------------------------------------------------
-        glm::mat4 lightProjection, lightView;
-        glm::mat4 lightSpaceMatrix;
-        float near_plane = 1.0f, far_plane = 7.5f;
-        lightProjection = glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, near_plane, far_plane);
-        lightView = glm::lookAt(lightPos, glm::vec3(0.0f), glm::vec3(0.0, 1.0, 0.0));
-        lightSpaceMatrix = lightProjection * lightView;
-        // render scene from light's point of view
         simpleDepthShader.use();
-        simpleDepthShader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
-
-        glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-        glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-            glClear(GL_DEPTH_BUFFER_BIT);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, woodTexture);
-            renderScene(simpleDepthShader);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-        // reset viewport
-        glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+        // casters between the light and a cascade's near plane are flattened onto it rather than clipped
+        glEnable(GL_DEPTH_CLAMP);
+        for (unsigned int c = 0; c < cascades.cascadeCount(); c++)
+        {
+            if (!cascades.needsRender(c))
+                continue;
+            simpleDepthShader.setMat4("lightSpaceMatrix", cascades.lightMatrix(c));
+            for (unsigned int r = 0; cascades.beginStatic(c, r); r++)
+                renderScene(simpleDepthShader, STATIC_CASTERS);
+            if (cascades.composite(c))
+                renderScene(simpleDepthShader, DYNAMIC_CASTERS);
+        }
+        glDisable(GL_DEPTH_CLAMP);
+        cascades.end(width, height);
+
+        // 2. render the scene as normal, each fragment compared against its cascade
+        // ------------------------------------------------------------------------
+        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        // render Depth map to quad for visual debugging
-        // ---------------------------------------------
-        debugDepthQuad.use();
-        debugDepthQuad.setFloat("near_plane", near_plane);
-        debugDepthQuad.setFloat("far_plane", far_plane);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, depthMap);
-        renderQuad();
+        shader.use();
+        shader.setMat4("projection", projection);
+        shader.setMat4("view", view);
+        shader.setVec3("viewPos", glm::vec3(camera.Position));
+        shader.setVec3("lightDir", lightDir);
+        shader.setBool("showCascades", showCascades);
+        cascades.setUniforms(shader);
+        glState().activeTexture(GL_TEXTURE0);
+        glState().bindTexture(GL_TEXTURE_2D, woodTexture);
+        cascades.bind(1);
+        renderScene(shader);
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
@@ -207,39 +220,74 @@ int main()
 
     // optional: de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
-    glDeleteVertexArrays(1, &planeVAO);
-    glDeleteBuffers(1, &planeVBO);
+    glState().deleteVertexArrays(1, &planeVAO);
+    glState().deleteBuffers(1, &planeVBO);
 
     glfwTerminate();
     return 0;
 }
 
-// renders the 3D scene
+// renders the 3D scene, or only its static or its moving casters
 // --------------------
-void renderScene(const Shader &shader)
+void renderScene(const Shader &shader, unsigned int casters)
+{
+    glm::mat4 model;
+    if (casters & STATIC_CASTERS)
+    {
+        // floor
+        model = glm::mat4(1.0f);
+        shader.setMat4("model", model);
+        glState().bindVertexArray(planeVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+        // cubes
+        model = glm::mat4(1.0f);
+        model = glm::translate(model, glm::vec3(0.0f, 1.5f, 0.0));
+        model = glm::scale(model, glm::vec3(0.5f));
+        shader.setMat4("model", model);
+        renderCube();
+        model = glm::mat4(1.0f);
+        model = glm::translate(model, glm::vec3(2.0f, 0.0f, 1.0));
+        model = glm::scale(model, glm::vec3(0.5f));
+        shader.setMat4("model", model);
+        renderCube();
+        model = glm::mat4(1.0f);
+        model = glm::translate(model, glm::vec3(-1.0f, 0.0f, 2.0));
+        model = glm::rotate(model, glm::radians(60.0f), glm::normalize(glm::vec3(1.0, 0.0, 1.0)));
+        model = glm::scale(model, glm::vec3(0.25));
+        shader.setMat4("model", model);
+        renderCube();
+        // a field of pillars out to the far cascades
+        for (int x = -6; x <= 6; x++)
+        {
+            for (int z = -6; z <= 6; z++)
+            {
+                if (x == 0 && z == 0)
+                    continue;
+                model = glm::mat4(1.0f);
+                model = glm::translate(model, glm::vec3(x * 15.0f, 1.5f, z * 15.0f));
+                model = glm::scale(model, glm::vec3(0.5f, 2.0f, 0.5f));
+                shader.setMat4("model", model);
+                renderCube();
+            }
+        }
+    }
+    // the moving caster
+    if (casters & DYNAMIC_CASTERS)
+    {
+        model = glm::mat4(1.0f);
+        model = glm::translate(model, movingCasterPosition(sceneTime));
+        model = glm::rotate(model, sceneTime, glm::vec3(0.0f, 1.0f, 0.0f));
+        model = glm::scale(model, glm::vec3(0.5f));
+        shader.setMat4("model", model);
+        renderCube();
+    }
+}
+
+// where the moving caster circles, slowly enough to stay in one far cascade for a while
+// -------------------------------------------------------------------------------------
+glm::vec3 movingCasterPosition(float time)
 {
-    // floor
-    glm::mat4 model = glm::mat4(1.0f);
-    shader.setMat4("model", model);
-    glBindVertexArray(planeVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    // cubes
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(0.0f, 1.5f, 0.0));
-    model = glm::scale(model, glm::vec3(0.5f));
-    shader.setMat4("model", model);
-    renderCube();
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(2.0f, 0.0f, 1.0));
-    model = glm::scale(model, glm::vec3(0.5f));
-    shader.setMat4("model", model);
-    renderCube();
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(-1.0f, 0.0f, 2.0));
-    model = glm::rotate(model, glm::radians(60.0f), glm::normalize(glm::vec3(1.0, 0.0, 1.0)));
-    model = glm::scale(model, glm::vec3(0.25));
-    shader.setMat4("model", model);
-    renderCube();
+    return glm::vec3(30.0f * std::cos(time * 0.2f), 1.0f, 30.0f * std::sin(time * 0.2f));
 }
 
 
@@ -299,54 +347,23 @@ void renderCube()
         glGenVertexArrays(1, &cubeVAO);
         glGenBuffers(1, &cubeVBO);
         // fill buffer
-        glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+        glState().bindBuffer(GL_ARRAY_BUFFER, cubeVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
         // link vertex attributes
-        glBindVertexArray(cubeVAO);
+        glState().bindVertexArray(cubeVAO);
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
         glEnableVertexAttribArray(1);
         glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
         glEnableVertexAttribArray(2);
         glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+        glState().bindBuffer(GL_ARRAY_BUFFER, 0);
+        glState().bindVertexArray(0);
     }
     // render Cube
-    glBindVertexArray(cubeVAO);
+    glState().bindVertexArray(cubeVAO);
     glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
-}
-
-// renderQuad() renders a 1x1 XY quad in NDC
-// -----------------------------------------
-unsigned int quadVAO = 0;
-unsigned int quadVBO;
-void renderQuad()
-{
-    if (quadVAO == 0)
-    {
-        float quadVertices[] = {
-            // positions        // texture Coords
-            -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
-            -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
-             1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
-             1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
-        };
-        // setup plane VAO
-        glGenVertexArrays(1, &quadVAO);
-        glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    }
-    glBindVertexArray(quadVAO);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
+    glState().bindVertexArray(0);
 }
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
@@ -364,6 +381,22 @@ void processInput(GLFWwindow *window)
         camera.ProcessKeyboard(LEFT, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.ProcessKeyboard(RIGHT, deltaTime);
+
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS && !showCascadesKeyPressed)
+    {
+        showCascades = !showCascades;
+        showCascadesKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_RELEASE)
+        showCascadesKeyPressed = false;
+
+    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS && !filteredShadowsKeyPressed)
+    {
+        filteredShadows = !filteredShadows;
+        filteredShadowsKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_RELEASE)
+        filteredShadowsKeyPressed = false;
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -424,7 +457,7 @@ unsigned int loadTexture(char const * path)
         else if (nrComponents == 4)
             format = GL_RGBA;
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
+        glState().bindTexture(GL_TEXTURE_2D, textureID);
         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -10,12 +10,94 @@
 #include <shader.h>
 #include <camera.h>
 #include <model.h>
+#include <model_batch.h>
+#include <model_loader.h>
+#include <asset_priorities.h>
+#include <texture_cache.h>
+#include <bindless_textures.h>
 #include <sphere.h>
+#include <tessellated_sphere.h>
+#include <render_device.h>
+#include <physics_world.h>
+#include <gpu_nbody.h>
+#include <hybrid_nbody.h>
+#include <gpu_readback.h>
+#include <gpu_particle_mesh.h>
+#include <gpu_belt.h>
+#include <gpu_cull.h>
+#include <gpu_radix_sort.h>
+#include <gpu_morton.h>
+#include <gpu_barnes_hut.h>
+#include <clustered_lights.h>
+#include <gbuffer.h>
+#include <hiz.h>
+#include <shading_rate.h>
+#include <stereo_camera.h>
+#include <output_windows.h>
+#include <cube_shadow_map.h>
+#include <scene_target.h>
+#include <quality_governor.h>
+#include <depth_convention.h>
+#include <sphere_impostors.h>
+#include <reflection_probe.h>
+#include <gpu_picker.h>
+#include <frame_capture.h>
+#include <headless.h>
+#include <rock_variants.h>
+#include <planet_instances.h>
+#include <camera_uniforms.h>
+#include <frame_pacing.h>
+#include <uniform_ring.h>
+#include <std140.h>
+#include <render_queue.h>
+#include <loose_octree.h>
+#include <debug_draw.h>
+#include <gpu_timers.h>
+#include <benchmark.h>
+#include <camera_path.h>
+#include <perf_baseline.h>
+#include <telemetry.h>
+#include <profiler.h>
+#include <alloc_tracker.h>
+#include <instance_data.h>
+#include <streaming_buffer.h>
+#include <gpu_memory.h>
+#include <async_physics.h>
+#include <startup_trace.h>
+#include <world_streaming.h>
+#include <task_graph.h>
+#include <frame_arena.h>
+#include <snapshot.h>
+#include <trajectory_recorder.h>
+#include <trajectory_player.h>
+#include <state_stream.h>
+#include <time_warp.h>
+#include <orbit_lines.h>
+#include <gpu_trails.h>
+#include <point_cloud.h>
+#include <gpu_sph.h>
+#include <density_map.h>
+#include <atmosphere.h>
+#include <planet_terrain.h>
+#include <virtual_texture.h>
+#include <star_field.h>
+#include <window_events.h>
+#include <render_profile.h>
 
 #include <iostream>
 #include <vector>
 #include <string>
 #include <random>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <new>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <csignal>
 #include <iomanip>    // For std::fixed and std::setprecision in updateFPS
 
 #include "imgui.h"
@@ -24,6 +106,23 @@
 
 #define NR_POINT_LIGHTS 1
 
+// the LightData block of shaders.2/lights.glsl, member for member (std140.h). The spotlight is the camera's
+// headlight, which the shaders light along the view axis, so it has no position or direction.
+#define MATERIAL_MEMBERS(M) M(float, shininess)
+STD140_STRUCT(Material, MATERIAL_MEMBERS);
+#define DIR_LIGHT_MEMBERS(M) M(glm::vec3, direction) M(glm::vec3, ambient) M(glm::vec3, diffuse) M(glm::vec3, specular)
+STD140_STRUCT(DirLight, DIR_LIGHT_MEMBERS);
+#define POINT_LIGHT_MEMBERS(M) M(glm::vec4, position) M(float, constant) M(float, linear) M(float, quadratic) \
+    M(glm::vec3, ambient) M(glm::vec3, diffuse) M(glm::vec3, specular)
+STD140_STRUCT(PointLight, POINT_LIGHT_MEMBERS);
+#define SPOT_LIGHT_MEMBERS(M) M(float, cutOff) M(float, outerCutOff) M(float, constant) M(float, linear) M(float, quadratic) \
+    M(glm::vec3, ambient) M(glm::vec3, diffuse) M(glm::vec3, specular)
+STD140_STRUCT(SpotLight, SPOT_LIGHT_MEMBERS);
+typedef Std140Array<PointLight, NR_POINT_LIGHTS> PointLights;
+#define LIGHT_DATA_MEMBERS(M) M(Material, material) M(DirLight, dirLight) M(PointLights, pointLights) M(SpotLight, spotLight)
+STD140_STRUCT(LightData, LIGHT_DATA_MEMBERS);
+const unsigned int LIGHT_BLOCK_BINDING = 1;
+
 void framebuffer_size_callback([[maybe_unused]] GLFWwindow* window, int width, int height);
 void mouse_callback([[maybe_unused]] GLFWwindow* window, double xpos, double ypos);
 void scroll_callback([[maybe_unused]] GLFWwindow* window, [[maybe_unused]] double xoffset, double yoffset);
@@ -32,6 +131,29 @@ void updateFPS(GLFWwindow* window);
 unsigned int loadTexture(char const* path, bool gammaCorrection);
 unsigned int loadCubemap(std::vector<std::string> faces);
 void resetSimulation();
+void startUniverse();
+void setupAsteroidInstanceBuffers();
+
+// Every operator new in the process, and ImGui's allocations, go through allocTracker() so the stats can show heap
+// allocations per frame; --track-allocations also counts them by subsystem (alloc_tracker.h). The GL driver
+// allocates with malloc and is not included.
+unsigned long long heapAllocationsAtFrameStart = 0;
+unsigned long long heapAllocationsLastFrame = 0;
+bool trackAllocations = false;
+GlStateCache::Stats glStateLastFrame;
+
+void* operator new(std::size_t size) {
+    if (void* p = allocTracker().allocate(size)) return p;
+    throw std::bad_alloc();
+}
+void* operator new(std::size_t size, std::align_val_t align) {
+    if (void* p = allocTracker().allocate(size, static_cast<std::size_t>(align))) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { allocTracker().release(p); }
+void operator delete(void* p, std::size_t) noexcept { allocTracker().release(p); }
+void operator delete(void* p, std::align_val_t) noexcept { allocTracker().release(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { allocTracker().release(p); }
 
 // Camera
 Camera camera(glm::vec3(0.0f, 20.0f, 150.0f));
@@ -45,78 +167,571 @@ float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 float simulationSpeed = 1.0f;
 
+// seconds since the first call, glfwGetTime without needing GLFW, which a headless run never initialises
+double clockSeconds() {
+    static const auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
 // Physics & Scene Objects
-const float GRAVITATIONAL_CONSTANT_BASE = 6.674e-11f; // Not directly used, G_scaled is used
-float G_scaled = 1000.0f;
-
-struct CelestialBody {
-    glm::vec3 position;
-    glm::vec3 velocity;
-    glm::vec3 acceleration;
-    float mass;
-    float radiusScale;
-    Model* modelPtr;
-    Mesh* meshPtr;
-    glm::quat orientation;
-    glm::mat4 modelMatrix;
-    bool isStatic;
-    bool isAsteroid;
-    int type; // 0: Sun, 1: Planet, 2: Asteroid
-
-    CelestialBody(glm::vec3 pos, glm::vec3 vel, float m, float rScale,
-                  Model* mod = nullptr, Mesh* mesh = nullptr,
-                  glm::quat orient = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
-                  bool stat = false, bool asteroid = false, int t = 2)
-        : position(pos),
-          velocity(vel),
-          acceleration(0.0f),
-          mass(m),
-          radiusScale(rScale),
-          modelPtr(mod),
-          meshPtr(mesh),
-          orientation(orient),
-          isStatic(stat),
-          isAsteroid(asteroid),
-          type(t)
-    {
-        updateModelMatrix();
-    }
-
-    void applyForce(glm::vec3 force) {
-        if (isStatic || mass == 0.0f) return;
-        acceleration += force / mass;
-    }
-
-    void update(float dt) {
-        if (isStatic) {
-            acceleration = glm::vec3(0.0f);
-            updateModelMatrix(); // Still update matrix if scale changes via ImGui (not yet implemented for static objects)
-            return;
-        }
-        velocity += acceleration * dt;
-        position += velocity * dt;
-        acceleration = glm::vec3(0.0f);
-        updateModelMatrix();
-    }
+const float GRAVITATIONAL_CONSTANT_BASE = 6.674e-11f; // Not directly used, physics.G is used
+PhysicsWorld physics;   // bodies, solver and integrator settings
 
-    void updateModelMatrix() {
-        glm::mat4 trans = glm::translate(glm::mat4(1.0f), position);
-        glm::mat4 rot = glm::mat4_cast(orientation);
-        glm::mat4 scale_mat = glm::scale(glm::mat4(1.0f), glm::vec3(radiusScale));
-        modelMatrix = trans * rot * scale_mat;
+enum PhysicsBackend {
+    BACKEND_CPU = 0,
+    BACKEND_GPU_COMPUTE = 1,
+    BACKEND_HYBRID = 2          // sun and planets on the CPU in double, asteroids on the GPU (hybrid_nbody.h)
+};
+int physicsBackend = BACKEND_CPU;
+GpuNBody* gpuNBody = nullptr;
+GpuMortonOrder* gpuMorton = nullptr;        // the Z-order re-sort of the asteroids in gpuNBody's buffers
+GpuParticleMesh* gpuParticleMesh = nullptr;   // the GPU backend's kick with the particle-mesh solver
+GpuBarnesHut* gpuBarnesHut = nullptr;         // and with Barnes-Hut, its tree rebuilt on the GPU every step
+HybridNBody* hybridNBody = nullptr;
+// buffers, images, pipelines and command lists recordable off the GL thread (render_device.h)
+GlRenderDevice renderDevice;
+std::vector<CommandList> rockCommandLists;  // the instanced rocks, a list per worker
+GpuReadback* gpuReadback = nullptr;         // what the CPU needs of the GPU backends' bodies, a frame or two late
+unsigned int gpuBodiesGeneration = 0;       // bumped when the CPU bodies are replaced, older reads are dropped
+
+// the asteroids live in gpuNBody's buffers, with either GPU backend
+bool bodiesOnGpu() {
+    return physicsBackend == BACKEND_GPU_COMPUTE || physicsBackend == BACKEND_HYBRID;
+}
+
+// the CPU bodies to the GPU backend; the hybrid one falls back to GPU compute with more massive bodies than it takes
+void uploadGpuBodies() {
+    gpuBodiesGeneration++;
+    gpuNBody->upload(physics.bodies);
+    if (physicsBackend != BACKEND_HYBRID) return;
+    if (!hybridNBody->upload(physics.bodies)) {
+        std::cout << "hybrid physics takes at most " << HYBRID_MAX_MASSIVE << " massive bodies, using GPU compute" << std::endl;
+        physicsBackend = BACKEND_GPU_COMPUTE;
     }
+}
+
+// the GPU backend's state back into the CPU bodies, the hybrid one's massive bodies from its double copy
+void downloadGpuBodies() {
+    gpuBodiesGeneration++;
+    gpuNBody->download(physics.bodies);
+    if (physicsBackend == BACKEND_HYBRID) hybridNBody->readMassive(physics.bodies);
+}
+
+// purely visual belt spawned and moved on the GPU, drawn next to (or instead of) the simulated asteroids
+GpuBelt* gpuBelt = nullptr;
+bool gpuBeltEnabled = false;
+int gpuBeltCount = 1000000;
+double gpuBeltClock = 0.0;      // sim time the belt was last advanced to
+
+// Galaxy encounters (galaxy.h) in place of the solar system: a core per galaxy and millions of test-particle
+// stars, stepped by the GPU backend and drawn as additive points (point_cloud.h) under the log tone mapping
+bool galaxyScene = false;
+int galaxyStars = 1000000;
+float galaxyPericentre = 120.0f;
+float galaxyTilt = 60.0f;
+PhysicsSettings solarSystemSettings;    // what entering a galaxy scene changed, put back on leaving it
+
+// --gas: a protoplanetary gas disk of smoothed particles around the sun (gpu_sph.h), stepped in compute with
+// whichever backend moves the bodies and drawn as points, respawned from gasParams on every reset
+GpuSph* gasDisk = nullptr;
+PointCloud* gasCloud = nullptr;
+bool gasEnabled = false;
+GpuSph::Params gasParams;
+std::vector<glm::vec4> gasSources;      // the CPU backends' massive bodies, uploaded every step
+
+// --scenario: the bodies and generators of a scenario file (scenario_file.h) in place of the built-in sun, planet
+// and belt, regenerated from the file on every reset
+ScenarioFile scenarioFile;
+std::string scenarioPath;
+bool pointCloudMode = false;            // GPU backend bodies as points instead of rocks
+PointCloud* pointCloud = nullptr;
+bool densityMapMode = false;            // GPU backend belt bodies as a heat map on the ecliptic instead of rocks
+DensityMap* densityMap = nullptr;
+// the planets' atmospheres from precomputed scattering tables, rebuilt over a few frames when a parameter changes
+bool planetAtmospheres = false;
+Atmosphere* atmosphere = nullptr;
+Atmosphere::Parameters atmosphereParameters;
+bool atmosphereStale = true;            // the tables are not of atmosphereParameters
+const unsigned int MAX_ATMOSPHERES = 8; // the nearest planets in view get one
+
+// Motion trails of the first trailBodies bodies (by id, or the belt's rocks), a sample every trailInterval sim
+// seconds into rings on the GPU. From the GPU backends a sample is one dispatch, the CPU uploads a vec4 a body.
+enum TrailSource {
+    TRAILS_NONE = 0,
+    TRAILS_CPU = 1,
+    TRAILS_GPU_NBODY = 2,
+    TRAILS_GPU_BELT = 3
+};
+bool motionTrails = false;
+bool trailBeltRocks = false;    // the visual belt's rocks instead of the bodies, while it is drawn
+int trailBodies = 4096;
+int trailLength = 64;
+float trailInterval = 1.0f / 30.0f;
+glm::vec3 trailColor(0.25f, 0.35f, 0.5f);
+float trailBrightness = 1.0f;
+GpuTrails* gpuTrails = nullptr;
+int trailSource = TRAILS_NONE;  // what the rings hold, a change starts them over
+double lastTrailCapture = 0.0;
+
+// fixed-step integration, drawing interpolates between the last two states
+bool fixedTimestep = true;
+float physicsStepSize = 1.0f / 120.0f;  // sim-time seconds per step
+int maxPhysicsStepsPerFrame = 8;
+float physicsAccumulator = 0.0f;
+float renderAlpha = 1.0f;
+int physicsStepsLastFrame = 0;
+std::vector<glm::dvec3> previousPositions;
+std::vector<unsigned char> reorderScratch;
+// adaptive substepping for Sim Speed (synchronous CPU physics), replaces the fixed step while enabled
+TimeWarp timeWarp;
+
+// optional dedicated physics thread (CPU backend), rendering then draws its latest published snapshot
+AsyncPhysics asyncPhysics;
+SnapshotWriter snapshotWriter;
+const char* snapshotPath = "simulation.snapshot";
+std::string snapshotStatus;
+// F9 writes the profiler's timeline of every thread, for chrome://tracing or ui.perfetto.dev
+const char* tracePath = "simulation.trace.json";
+std::string traceStatus;
+// --startup-report, --startup-trace: the cold start's phases, its critical path and what parallel loading would save
+struct StartupOptions {
+    bool report = false;
+    std::string tracePath;
+    bool exitAfter = false;         // once startup is complete
+    double targetMs = 1000.0;       // ready within it, or an exit with 2 after --exit-after-startup
+    bool missed = false;
+} startupOptions;
+// F7 appends the camera's pose to a path, saved for --camera-path to fly
+CameraPath recordedCameraPath;
+const char* cameraPathFile = "camera.path";
+std::string cameraPathStatus;
+// F12 saves a screenshot, F10 starts and stops a video (--video starts one with the run), read back without a stall
+FrameCapture* frameCapture = nullptr;
+std::string videoPath = "simulation.mp4";
+bool videoFromStart = false;
+int videoFps = 60;
+unsigned int screenshotCount = 0;
+// --headless: no window or display server, an EGL context (headless.h) presenting into an offscreen framebuffer
+// whose frames only leave through frameCapture, stepped at the video's frame rate so every machine renders the same
+struct HeadlessRun {
+    bool active = false;
+    int device = -1;            // --gpu, an EGL device, -1 for the default display or else the first device
+    int width = 1920;
+    int height = 1080;
+    unsigned int frames = 0;    // 0 renders until SIGINT or SIGTERM, a benchmark ends by itself
+    unsigned int frame = 0;
 };
+HeadlessRun headless;
+HeadlessFramebuffer* headlessTarget = nullptr;
+volatile std::sig_atomic_t stopRequested = 0;
+// how frames reach the screen: the swap interval, a frame rate limit and how far the CPU may run ahead of the GPU,
+// set explicitly rather than left to the driver
+PresentMode presentMode = PRESENT_VSYNC;
+FramePacer framePacer;
+// on-demand rendering: while nothing on screen would change the loop sleeps in glfwWaitEventsTimeout and the last
+// frame stays up; input, a moved camera, a running simulation or loading assets draw again, and a few frames after
+// the last change (ImGui's hover states) settle it
+bool onDemandRendering = false;
+const unsigned int ON_DEMAND_SETTLE_FRAMES = 3;
+const double ON_DEMAND_WAIT_SECONDS = 0.5;  // the longest sleep, for what changes without an event
+unsigned long windowEvents = 0;             // input and window events from the callbacks
+unsigned long idleWaits = 0;                // frames not drawn since startup
+// --render-thread: the frames are built and submitted on a thread of their own holding the context, the main thread
+// only waits for the window's events and hands them over (window_events.h)
+bool renderThread = false;
+WindowEventQueue windowEventQueue;
+WindowInputState windowInput;               // the frame thread's, as of its last drainWindowEvents
+std::vector<WindowEvent> windowEventBatch;
+
+// --benchmark: a fixed scenario from a fixed seed, flown along a camera path at a fixed time step for a fixed number
+// of frames, its frame times written as JSON so runs before and after a change can be compared
+struct BenchmarkRun {
+    bool active = false;
+    std::string scenario;
+    std::string outPath = "benchmark.json";
+    std::string cameraPath;         // empty flies the built-in path through the belt
+    unsigned int seed = 1;
+    unsigned int frames = 1000;
+    unsigned int warmup = 120;      // held at the path's start first, while textures stream in and the GPU clocks up
+    unsigned int frame = 0;         // frames finished, warm-up included
+    CameraPath path;
+    FrameSeries frameMs;            // wall time from one frame's start to the next
+    FrameSeries cpuFrameMs;
+    FrameSeries gpuFrameMs;
+    FrameSeries physicsMs;          // the CPU side by stage
+    FrameSeries uploadMs;
+    FrameSeries uiMs;
+    std::vector<FrameSeries> passMs;    // per GPU timer scope
+    unsigned long long gpuCollected = 0;
+    // every frame of every series kept as this machine's baseline, or checked against it
+    bool saveBaseline = false;
+    bool compare = false;
+    std::string baselineDir = "baselines";
+    std::string machine;
+    PerfCompareOptions compareOptions;
+    unsigned int regressions = 0;   // what --compare found, the exit code
+};
+BenchmarkRun benchmark;
+
+// --telemetry: frame numbers written off-thread at a fixed rate to a rotated CSV or JSON-lines file and/or over UDP
+Telemetry telemetry;
+Telemetry::Options telemetryOptions;
+unsigned long long telemetryFrame = 0;
+size_t telemetryStreamedBytes = 0;  // textureCache().streamedBytes() at the last frame
+const float BENCHMARK_FRAME_TIME = 1.0f / 60.0f;    // deltaTime of every benchmark frame, whatever the frame really took
+TrajectoryRecorder trajectoryRecorder;
+const char* trajectoryPath = "simulation.trajectory";
+int recordInterval = 10;
+float recordQuantum = 0.0f;     // 0 records lossless
+TrajectoryPlayer trajectoryPlayer;
+bool replayActive = false;      // drawing a recording instead of simulating
+double replayTime = 0.0;
+double replayBlend = 0.0;       // weight of the later of the two recorded frames around replayTime
+float replaySpeed = 1.0f;       // sim seconds per second, negative plays backwards
+bool replayLoop = true;
+// --connect: drawing what a headless --serve process simulates, received snapshots played back like a replay
+StateClient stateClient;
+std::string remoteAddress;
+bool remoteActive = false;
+double remoteTime = 0.0;
+double remoteBlend = 0.0;       // weight of the later of the two snapshots around remoteTime
+bool asyncPhysicsEnabled = false;
+
+int integratorType = INTEGRATOR_SEMI_IMPLICIT_EULER;   // CPU backends only, the GPU backend always uses semi-implicit Euler
+bool sectorFocusOnCamera = true;    // the multi-rate belt keeps the sectors around the camera at full rate
 
-std::vector<CelestialBody> celestialBodies;
 Model* planetModelPtr = nullptr;
 Model* rockModelPtr = nullptr;
-Mesh sphereMesh; // For the sun - REQUIRES Mesh TO HAVE A DEFAULT CONSTRUCTOR
+// the two models and their textures, ranked by size on screen while they load
+AssetPriorities assetPriorities;
+AssetPriorities::AssetId planetAsset = 0, rockAsset = 0;
+ModelBatch* planetBatchPtr = nullptr;       // the planet's meshes as one multi-draw
+bool batchedModelDraws = true;
+// every planet and moon in one instanced draw per mesh (planet_instances.h), otherwise each is queued mesh by mesh
+// as its own object, which the render queue instances when autoInstancing is on
+PlanetInstances* planetInstances = nullptr;
+bool instancedPlanets = true;
+bool autoInstancing = true;
+// lit geometry into the G-buffer and one lighting pass over it, instead of lighting every fragment as it is drawn
+bool deferredShading = false;
+bool bindlessTextures = false;              // GL_ARB_bindless_texture is there, the shaders are chosen at startup
+// shapes and texture layers of the rock (rock_variants.h), every GPU-culled variant drawn by one multi-draw
+RockVariants* rockVariants = nullptr;
+unsigned int rockVariantCount = DEFAULT_ROCK_VARIANTS;
+bool proceduralRocks = false;       // an icosphere shaped by each rock's noise instead of rock.obj
+float rockRelief = DEFAULT_ROCK_RELIEF;
+// textures stream in after startup: loader threads decode, each frame uploads at most this much of what they finished
+const unsigned int TEXTURE_LOADER_THREADS = 2;
+const size_t TEXTURE_UPLOAD_BUDGET = 8 << 20;
+unsigned int textureBudgetMB = 0;   // mip streaming within this much texture memory, 0 keeps every level resident
+// the planet and the rock import side by side while the shaders compile
+const unsigned int MODEL_LOADER_THREADS = 2;
+// the sun's icosphere, out of sphereCache(), its coarser subdivisions the LODs
+Mesh* sphereMesh = nullptr;
+const unsigned int SUN_SUBDIVISIONS = 4;
 
 unsigned int asteroidAmount = 0;
-glm::mat4* asteroidModelMatrices = nullptr;
-glm::mat3* asteroidNormalMatrices = nullptr;
-unsigned int asteroidInstanceVBO = 0;
-unsigned int asteroidNormalInstanceVBO = 0;
+StreamingBuffer asteroidInstanceStream;    // physics writes instances straight into its mapped segments
+unsigned int asteroidInstanceCapacity = 0;  // instances per stream segment, grows geometrically
+unsigned int asteroidSegmentRecords = 0;    // records per segment including the quantized chunk table, for baseInstance
+bool quantizedInstances = false;            // 16-byte records decoded against per-chunk bounds instead of 40-byte ones
+bool instanceStreamQuantized = false;       // the format the stream and vertex attributes were last set up for
+// the two record formats as the asteroid vertex shaders read them, and the stream as the rocks' instances
+const InstanceLayout ASTEROID_INSTANCE_LAYOUT{"asteroid", sizeof(AsteroidInstance), {
+    {INSTANCE_FIRST_LOCATION + 0, 4, GL_FLOAT, false, false, offsetof(AsteroidInstance, position)},
+    {INSTANCE_FIRST_LOCATION + 1, 4, GL_FLOAT, false, false, offsetof(AsteroidInstance, orientation)},
+    {INSTANCE_FIRST_LOCATION + 2, 4, GL_INT_2_10_10_10_REV, true, false, offsetof(AsteroidInstance, spinAxis)},
+    {INSTANCE_FIRST_LOCATION + 3, 1, GL_FLOAT, false, false, offsetof(AsteroidInstance, spinRate)}}};
+const InstanceLayout QUANTIZED_INSTANCE_LAYOUT{"quantized asteroid", sizeof(QuantizedInstance), {
+    {INSTANCE_FIRST_LOCATION + 0, 1, GL_UNSIGNED_INT, false, true, offsetof(QuantizedInstance, orientation)},
+    {INSTANCE_FIRST_LOCATION + 1, 4, GL_INT_2_10_10_10_REV, true, false, offsetof(QuantizedInstance, spinAxis)},
+    {INSTANCE_FIRST_LOCATION + 2, 4, GL_UNSIGNED_SHORT, false, true, offsetof(QuantizedInstance, position)}}};
+InstanceBuffer asteroidInstances(ASTEROID_INSTANCE_LAYOUT);
+unsigned int asteroidInstancesPacked = 0;   // records in the last packed segment, what the draw covers
+// the packed records are grouped by level of detail, each level drawn with its own index range, and the impostors
+// beyond impostorDistance come last, drawn as one lit point each
+const unsigned int IMPOSTOR_BIN = MAX_MESH_LODS;
+const unsigned int ASTEROID_BINS = MAX_MESH_LODS + 1;
+unsigned int asteroidLodFirst[ASTEROID_BINS] = {0, 0, 0, 0, 0};  // first record of each bin in the segment
+unsigned int asteroidLodCount[ASTEROID_BINS] = {0, 0, 0, 0, 0};
+float asteroidLodPixels[MAX_MESH_LODS - 1] = {48.0f, 16.0f, 5.0f};  // projected diameter below which the next level is used
+bool asteroidImpostors = true;
+float impostorDistance = 350.0f;
+struct PackCandidate { uint32_t index; uint32_t lod; glm::vec3 at; };
+std::vector<PackCandidate> packCandidates;   // visible asteroids of the frame being packed, reused across frames
+
+// asteroids outside the view are skipped while packing on the CPU paths and by a compute pass on the GPU ones
+bool frustumCulling = true;
+Frustum viewFrustum;            // camera-relative, set before the frame's instances are packed
+float pixelsPerRadian = 1.0f;   // projection[1][1] times the viewport height, projected diameter = radius * this / distance
+float rockBoundingRadius = 0.0f;
+GpuCuller* gpuCuller = nullptr;
+// the GPU cull's lists drawn nearest first, radix sorted on the GPU, so early-Z rejects the rocks behind them
+bool frontToBackRocks = true;
+GpuRadixSort* radixSort = nullptr;
+// the GPU cull also rejects rocks behind last frame's depth, kept as a Hi-Z pyramid
+bool occlusionCulling = false;
+HiZ* hiZ = nullptr;
+// the scene's passes shaded at 2x2 or 4x4 over dark, flat tiles of last frame and in the periphery, through
+// GL_NV_shading_rate_image where it is there
+bool variableRateShading = false;
+bool shadingRatesAvailable = false;
+ShadingRateImage* shadingRates = nullptr;
+// the sun and the planet laid into depth before anything is shaded, so the rocks behind them fail the depth test early
+bool depthPrepass = false;
+// the pre-pass and the sun's shadow draw the meshes from their 12-byte position streams instead of the full vertices
+bool positionStreams = true;
+// every sun and planet ray-cast on a quad of its own, with the light sources, instead of drawn as a mesh
+bool sphereImpostors = false;
+SphereImpostors* sphereImpostorRenderer = nullptr;
+float planetBoundingRadius = 1.0f;
+// the planet drawn as a quadtree of terrain patches (planet_terrain.h) instead of its model, for close flybys
+bool planetTerrainEnabled = true;
+PlanetTerrain* planetTerrain = nullptr;
+// the sun, and the terrain's planet displaced by its height cube, tessellated on the GPU to their size on screen
+// (tessellated_sphere.h) instead of the icosphere's levels and the quadtree
+bool tessellatedSpheres = false;
+TessellatedSphere tessellatedSphere;
+size_t tessellatedSunTriangles = 0;    // last frame's estimate, for the UI
+// the terrain coloured from a large equirectangular image (--planet-surface) streamed as a virtual texture, only the
+// pages in view on the GPU (virtual_texture.h); the baked albedo cube otherwise
+std::string planetSurfacePath;
+unsigned int planetSurfaceCachePages = 24;
+bool planetSurfaceEnabled = true;
+bool sparseTextures = false;                // GL_ARB_sparse_texture is there
+VirtualTexture* planetSurface = nullptr;
+// the sky from a star catalog (--star-catalog) drawn as culled points (star_field.h) instead of the cubemap
+std::string starCatalogPath;
+unsigned int syntheticStars = 300000;   // written to the catalog path when there is no file there
+bool starCatalogSky = false;
+StarField* starField = nullptr;
+const glm::vec3 SUN_EMISSION(4.0f, 3.6f, 3.0f);    // EMISSION of light.cube.shader.fs
+// the scene is drawn offscreen at a scale of the window that follows the GPU frame time, anti-aliased and then
+// filtered up under the UI; the window itself has no samples
+SceneTarget* sceneTarget = nullptr;
+DynamicResolution dynamicResolution;
+AntiAliasing antiAliasing = AA_MSAA;
+int sceneSamples = 4;
+// past what the resolution can take, the governor turns the costlier settings down to hold the frame time; the
+// frame reads the effective values below, remade from the user's only when the governor changes its levels
+QualityGovernor qualityGovernor;
+float effectiveLodPixels[MAX_MESH_LODS - 1] = {48.0f, 16.0f, 5.0f};
+float effectiveImpostorDistance = 350.0f;
+unsigned int sunShadowAge = 0;      // frames since the shadow cube was drawn
+// the command line's tone mapping, handed to the scene target once it exists
+float sceneExposure = 1.0f;
+bool sceneBloom = true;
+// debugging what the frame costs: the overdraw heat map in place of the frame, and per-pass pipeline statistics
+bool overdrawView = false;
+bool pipelineStatistics = false;
+// the camera's depth reversed with an infinite far plane into float depth (depth_convention.h), or GL's with 24 bits
+bool reverseDepth = true;
+// last frame's unjittered camera-relative view-projection and camera, for TAA's reprojection
+glm::mat4 previousViewProjection(1.0f);
+glm::dvec3 previousCameraPosition(0.0);
+// the Matrices block, rewritten into mapped slots; with late latching the mouse is read again and the view written
+// once more just before the scene's draws are submitted, so they show where the camera points by then
+CameraUniforms cameraUniforms(0);
+bool lateLatching = true;
+float lateLatchDegrees = 0.0f;  // how far the last frame's latch turned the camera
+// side-by-side stereo (stereo_camera.h): the rocks of both eyes in one cull and one instanced draw per path, the
+// other packets drawn once per eye. Deferred shading, occlusion culling, TAA and variable-rate shading read a
+// single camera's frame and are off while it is on.
+StereoCamera stereoCamera;
+StereoCamera::Frame stereoFrame;
+int stereoEyeWidth = 1, stereoEyeHeight = 1;
+// projector panels beside the main window's (output_windows.h), each the main window's size; stereo is off with them
+OutputWindows outputWindows;
+unsigned int outputWindowCount = 0;
+unsigned long long resolutionFramesSeen = 0;    // GpuTimers::collectedFrames() the controller last saw
+
+// passes of the frame's render queue, in the order they draw
+enum RenderPass {
+    PASS_DEPTH_PREPASS = 0,
+    PASS_OPAQUE,
+    PASS_LIGHT_SOURCES,
+    PASS_SKY,
+    PASS_ATMOSPHERE,
+    PASS_DEBUG,
+    PASS_DEBUG_OVERLAY
+};
+RenderQueue renderQueue;
+
+// GPU time per pass, read a few frames late so nothing waits on the GPU, and the CPU side of the frame, for the
+// performance overlay
+GpuTimers* gpuTimers = nullptr;
+struct PassTimers {
+    unsigned int shadows, reflections, shadingRates, prepass, planet, asteroids, lighting, sun, hiZ, sky, atmospheres, debugDraw, postProcess, ui;
+};
+PassTimers passTimers;
+TimeHistory cpuFrameHistory;    // the loop's CPU work, without the wait in glfwSwapBuffers
+TimeHistory cpuPhysicsHistory;
+TimeHistory cpuUploadHistory;   // mapping, packing and the camera, from the frame graph
+TimeHistory cpuUiHistory;       // building the ImGui windows
+bool showPerformanceOverlay = false;
+
+// every sun is a point light, binned into clusters each frame so the lit shaders only loop over lights near a fragment
+ClusteredLights* clusteredLights = nullptr;
+std::vector<ClusteredLights::Light> frameLights;    // reused across frames
+GBuffer* gBuffer = nullptr;     // the deferred path's targets and lighting pass
+// the first sun casts shadows from the planet and every rock, a cube map redrawn each frame
+bool sunShadows = true;
+CubeShadowMap* sunShadow = nullptr;
+// soft, one sample of blurred distance moments per fragment in place of the 2x2 comparison
+bool softSunShadows = false;
+int sunShadowBlur = 3;          // texels either side
+// the planet reflects the sky and the sun through a probe at its centre, a face or two redrawn per frame
+bool planetReflections = false;
+unsigned int reflectionFacesPerFrame = 1;
+unsigned int reflectionProbeSize = 128;
+float planetReflectivity = 0.04f;   // Fresnel at normal incidence
+float planetRoughness = 0.6f;       // picks the prefiltered level
+ReflectionProbe* reflectionProbe = nullptr;
+// a click selects the body under the cursor through the id buffer the lit passes write, held by its stable id so
+// the selection survives the asteroid reordering
+bool gpuPicking = true;
+GpuPicker* gpuPicker = nullptr;
+uint32_t selectedBodyId = BodyStore::INVALID_INDEX;
+bool pickRequested = false;
+glm::vec2 pickPoint(0.5f);              // the click, a fraction of the scene target from its lower left
+// what the ids meant in the frame the read was queued for, the answer arrives a frame or two later
+std::vector<uint32_t> pickSlotIds;      // the body id in each slot
+std::vector<uint32_t> pickRecordSlots;  // the body slot of each streamed instance record from pickRecordBase
+uint32_t pickRecordBase = 0;
+// predicted paths of the planets, the selected body and the pinned ones, extended on the predictor's thread and
+// drawn with the light sources
+bool orbitPredictions = false;
+bool predictPlanets = true;
+OrbitPredictor::Settings predictionSettings;
+OrbitPredictor orbitPredictor;
+OrbitLines* orbitLines = nullptr;
+std::vector<uint32_t> pinnedPredictionIds;
+std::vector<uint32_t> predictedIds;     // what the last update asked for, planets first
+float orbitLineBrightness = 1.5f;
+// lines, boxes and spheres over the scene (debug_draw.h) for what the simulation and the culling do, drawn after
+// everything else through the scene's depth or over it
+DebugDraw* debugDraw = nullptr;
+bool debugVelocities = false;
+bool debugBodyBounds = false;       // bounding spheres, green in view and red culled
+bool debugOctreeCells = false;      // bodyOctree's cells
+bool debugTreeCells = false;        // the CPU Barnes-Hut tree's cells down to debugTreeDepth
+bool debugLightRanges = false;
+bool debugOverlay = false;
+float debugVelocityScale = 1.0f;    // sim seconds of travel an arrow spans
+int debugTreeDepth = 6;
+int debugAsteroidLimit = 100000;    // asteroids given an arrow or a sphere
+const unsigned int SUN_SHADOW_RESOLUTION = 1024;
+const float SUN_SHADOW_NEAR = 1.0f;
+const float SUN_SHADOW_FAR = 2000.0f;
+
+// the uniforms of a draw of the sun or the planet, shaders.2/object_block.glsl's Object block in std140: written
+// into the frame's ring while the render queue is built, each draw only binds its slice
+const unsigned int OBJECT_BLOCK_BINDING = 4;
+const size_t OBJECT_RING_BYTES = 256 * 1024;    // a frame's objects, a few thousand at 256-byte alignment
+const unsigned int OBJECT_INSTANCES_BINDING = 56;   // the render queue's merged draws read the blocks as an array there
+struct ObjectBlock {
+    glm::mat4 model;
+    glm::vec4 normalMatrix[3];  // a std140 mat3, three vec4 columns
+    float reflectivity;
+    float reflectionLod;
+    uint32_t pickId;
+    float padding;
+};
+UniformRing objectUniformRing;
+
+ObjectBlock objectBlock(const glm::mat4& model, uint32_t pickId, float reflectivity = 0.0f, float reflectionLod = 0.0f) {
+    ObjectBlock block;
+    block.model = model;
+    const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+    for (int c = 0; c < 3; c++) block.normalMatrix[c] = glm::vec4(normalMatrix[c], 0.0f);
+    block.reflectivity = reflectivity;
+    block.reflectionLod = reflectionLod;
+    block.pickId = pickId;
+    block.padding = 0.0f;
+    return block;
+}
+
+UniformRing::Slice pushObject(const glm::mat4& model, uint32_t pickId, float reflectivity = 0.0f, float reflectionLod = 0.0f) {
+    return objectUniformRing.push(objectBlock(model, pickId, reflectivity, reflectionLod));
+}
+
+ShaderDefines withObjectBlock(ShaderDefines defines) {
+    defines.emplace_back("OBJECT_BLOCK", "");
+    return defines;
+}
+
+// ... or, for the render queue's instanced draws of them, an instance's block out of the array
+ShaderDefines withObjectInstances(ShaderDefines defines) {
+    defines.emplace_back("OBJECT_INSTANCES", "");
+    return withObjectBlock(defines);
+}
+
+// the object fragment shader reading the terrain's albedo cube instead of the model's texture
+ShaderDefines withCubeAlbedo(ShaderDefines defines) {
+    defines.emplace_back("CUBE_ALBEDO", "");
+    return defines;
+}
+
+// ... or sampling the planet surface's virtual texture by the same direction
+ShaderDefines withVirtualAlbedo(ShaderDefines defines) {
+    defines.emplace_back("VIRTUAL_ALBEDO", "");
+    return defines;
+}
+
+// the tessellated sphere pushed out by the terrain's height cube
+ShaderDefines withDisplacement(ShaderDefines defines) {
+    defines.emplace_back("DISPLACEMENT", "");
+    return defines;
+}
+
+// the tessellated sphere's stages in front of a fragment shader
+std::vector<std::pair<GLenum, const char*>> tessellatedStages(const char* fragmentPath) {
+    return {{GL_VERTEX_SHADER, "../shaders.2/sphere.tess.vs"}, {GL_TESS_CONTROL_SHADER, "../shaders.2/sphere.tess.tcs"},
+            {GL_TESS_EVALUATION_SHADER, "../shaders.2/sphere.tess.tes"}, {GL_FRAGMENT_SHADER, fragmentPath}};
+}
+
+// ... or the instance's layer of the planets' texture array
+ShaderDefines withMaterialArray(ShaderDefines defines) {
+    defines.emplace_back("MATERIAL_ARRAY", "");
+    return defines;
+}
+
+// the lit shaders of one output, the forward ones or the same sources compiled to write the G-buffer
+struct LitShaders {
+    Shader objectShader;
+    Shader objectInstancesShader;
+    Shader batchedObjectShader;
+    Shader asteroidShader;
+    Shader quantizedAsteroidShader;
+    Shader gpuAsteroidShader;
+    // the same vertex shaders in their one-point-per-instance mode
+    Shader asteroidImpostorShader;
+    Shader quantizedImpostorShader;
+    Shader gpuImpostorShader;
+    Shader terrainShader;
+    Shader virtualTerrainShader;
+    Shader planetInstancedShader;
+    Shader tessellatedPlanetShader;
+
+    LitShaders(const char* batchedFragment, const char* asteroidFragment, const ShaderDefines& defines)
+        : objectShader("../shaders.2/structured.object.model.shader.vs", "../shaders.2/2.instanced.object.model.shader.fs", withObjectBlock(defines)),
+          objectInstancesShader("../shaders.2/structured.object.model.shader.vs", "../shaders.2/2.instanced.object.model.shader.fs", withObjectInstances(defines)),
+          batchedObjectShader("../shaders.2/batched.object.model.shader.vs", batchedFragment, defines),
+          asteroidShader("../shaders.2/compact.instanced.object.model.shader.vs", asteroidFragment, defines),
+          quantizedAsteroidShader("../shaders.2/quantized.instanced.object.model.shader.vs", asteroidFragment, defines),
+          gpuAsteroidShader("../shaders.2/gpu.instanced.object.model.shader.vs", asteroidFragment, defines),
+          asteroidImpostorShader("../shaders.2/compact.instanced.object.model.shader.vs", "../shaders.2/impostor.point.fs", defines),
+          quantizedImpostorShader("../shaders.2/quantized.instanced.object.model.shader.vs", "../shaders.2/impostor.point.fs", defines),
+          gpuImpostorShader("../shaders.2/gpu.instanced.object.model.shader.vs", "../shaders.2/impostor.point.fs", defines),
+          terrainShader("../shaders.2/planet.terrain.vs", "../shaders.2/2.instanced.object.model.shader.fs", withCubeAlbedo(withObjectBlock(defines))),
+          virtualTerrainShader("../shaders.2/planet.terrain.vs", "../shaders.2/2.instanced.object.model.shader.fs", withVirtualAlbedo(withObjectBlock(defines))),
+          planetInstancedShader("../shaders.2/planet.instanced.vs", "../shaders.2/2.instanced.object.model.shader.fs", withMaterialArray(defines)),
+          tessellatedPlanetShader(tessellatedStages("../shaders.2/2.instanced.object.model.shader.fs"), withDisplacement(withCubeAlbedo(withObjectBlock(defines)))) {}
+};
+
+PhysicsStats viewerStats;   // kept across frames so its histogram storage is reused
+std::vector<float> conservedPlot;   // one drift series of the conserved-quantity history at a time, for PlotLines
+TaskGraph frameGraph;   // rebuilt every frame, one helper is enough since physics fans out over the worker pool
 
 float sunMass = 20000.0f;
 float sunRadiusScale = 15.0f;
@@ -136,205 +751,2036 @@ float asteroidBeltHeight = 10.0f;
 bool pauseSimulation = false;
 
 
-void initializeCelestialBodies() {
-    celestialBodies.clear();
-
-    glm::vec3 sunPos(0.0f, 0.0f, 0.0f);
-    glm::vec3 sunVel(0.0f, 0.0f, 0.0f);
-
-    celestialBodies.emplace_back(sunPos, sunVel, sunMass, sunRadiusScale, nullptr, &sphereMesh, glm::quat(1.0f,0,0,0), false, false, 0);
-    float angleRad = glm::radians(planetInitialAngle);
-    glm::vec3 planetPos(planetOrbitRadius * cos(angleRad), 0.0f, planetOrbitRadius * sin(angleRad));
-    float orbitalVelMag = (sunMass > 0 && planetOrbitRadius > 0) ? sqrt((G_scaled * sunMass) / planetOrbitRadius) : 0.0f;
-    glm::vec3 planetVel(-orbitalVelMag * sin(angleRad), 0.0f, orbitalVelMag * cos(angleRad));
-    celestialBodies.emplace_back(planetPos, planetVel, planetMass, planetRadiusScale, planetModelPtr, nullptr, glm::angleAxis(glm::radians(0.0f), glm::vec3(0,1,0)), false, false, 1);
-
-    if (asteroidModelMatrices) delete[] asteroidModelMatrices;
-    if (asteroidNormalMatrices) delete[] asteroidNormalMatrices;
-    if (asteroidAmount > 0) {
-        asteroidModelMatrices = new glm::mat4[asteroidAmount];
-        asteroidNormalMatrices = new glm::mat3[asteroidAmount];
+unsigned int scenarioSeed = 0;     // picked on reset, incremental belt changes keep drawing from it
+
+// the scenario described by the UI parameters
+ScenarioConfig currentScenario() {
+    ScenarioConfig scenario;
+    scenario.sunMass = sunMass;
+    scenario.sunRadiusScale = sunRadiusScale;
+    scenario.planetMass = planetMass;
+    scenario.planetRadiusScale = planetRadiusScale;
+    scenario.planetOrbitRadius = planetOrbitRadius;
+    scenario.planetInitialAngle = planetInitialAngle;
+    scenario.asteroidAmount = asteroidAmount;
+    scenario.avgAsteroidMass = avgAsteroidMass;
+    scenario.minAsteroidScale = minAsteroidScale;
+    scenario.maxAsteroidScale = maxAsteroidScale;
+    scenario.asteroidBeltInnerRadius = asteroidBeltInnerRadius;
+    scenario.asteroidBeltOuterRadius = asteroidBeltOuterRadius;
+    scenario.asteroidBeltHeight = asteroidBeltHeight;
+    scenario.seed = scenarioSeed;
+    return scenario;
+}
+
+// what a reset initializes a world with, picking the seed; everything it reads from the settings is captured, so
+// the returned function can run on any thread
+std::function<void(PhysicsWorld&)> celestialBodiesRecipe() {
+    // a headless run too, so every shard of a farm renders the same simulation
+    scenarioSeed = benchmark.active || headless.active ? benchmark.seed : static_cast<unsigned int>(clockSeconds());
+    if (galaxyScene) {
+        const GalaxySetup setup = galaxyCollision(static_cast<unsigned int>(galaxyStars), physics.G, scenarioSeed, 700.0f,
+                                                  galaxyPericentre, galaxyTilt);
+        return [setup](PhysicsWorld& world) { world.initializeGalaxies(setup, sphereMesh); };
+    }
+    if (!scenarioPath.empty())
+        return [](PhysicsWorld& world) { world.initializeScenario(scenarioFile, sphereMesh, planetModelPtr, rockModelPtr); };
+    const ScenarioConfig scenario = currentScenario();
+    return [scenario](PhysicsWorld& world) { world.initialize(scenario, sphereMesh, planetModelPtr, rockModelPtr); };
+}
+
+void initializeCelestialBodies() {
+    PROFILE_SCOPE("initializeCelestialBodies");
+    celestialBodiesRecipe()(physics);
+}
+
+// the CPU world's Z-order re-sort for the asteroids on the GPU, on its schedule and threshold: a check's disorder
+// comes back a frame or two late and the next check sorts when it was over the threshold
+void reorderGpuBodiesIfDisordered() {
+    if (!physics.mortonSort || physics.mortonCheckInterval == 0 || physics.stepCount % physics.mortonCheckInterval != 0) return;
+    if (!gpuMorton || !gpuReadback) return;
+    if (gpuMorton->disorder > physics.mortonThreshold) {
+        gpuMorton->sort(*gpuNBody, physics.bodies);
+        // reads in flight name the slots as they were
+        gpuBodiesGeneration++;
+        physics.mortonSorts++;
+    }
+    gpuMorton->check(*gpuNBody, *gpuReadback);
+    physics.mortonDisorder = gpuMorton->disorder;
+}
+
+// the gas disk's step of dt against the massive bodies where the backend keeps them: the GPU compute backend's are
+// pulled back by the gas, the CPU's and the hybrid backend's double copy are only followed
+void stepGas(float dt) {
+    if (!gasDisk || gasDisk->particleCount() == 0) return;
+    const BodyRange suns = physics.bodies.range(BODY_SUN);
+    if (suns.begin == suns.end) return;
+    const float mu = physics.G * physics.bodies.mass[suns.begin];
+    if (bodiesOnGpu() && gpuNBody && gpuNBody->massiveCount > 0) {
+        const GLuint velocities = physicsBackend == BACKEND_GPU_COMPUTE ? gpuNBody->buffer(GpuNBody::BINDING_VELOCITY) : 0;
+        gasDisk->step(dt, physics.G, physics.epsilonSq, gpuNBody->positionBuffer(), velocities, gpuNBody->massiveCount, mu);
+        return;
+    }
+    const bool async = asyncPhysics.running();
+    const size_t available = async ? asyncPhysics.latest().position.size() : physics.bodies.size();
+    const size_t massive = std::min({physics.bodies.range(BODY_ASTEROID).begin, available, static_cast<size_t>(GpuSph::MAX_SOURCES)});
+    gasSources.clear();
+    for (size_t i = 0; i < massive; i++) {
+        const glm::dvec3& position = async ? asyncPhysics.latest().position[i] : physics.bodies.position[i];
+        gasSources.push_back(glm::vec4(glm::vec3(position), physics.bodies.mass[i]));
+    }
+    gasDisk->step(dt, physics.G, physics.epsilonSq, gasDisk->uploadSources(gasSources), 0, static_cast<unsigned int>(massive), mu);
+}
+
+// advances the simulation by exactly dt of sim time
+void stepPhysics(float dt) {
+    if (physicsBackend == BACKEND_HYBRID && hybridNBody) {
+        hybridNBody->step(*gpuNBody, dt, physics.G, physics.epsilonSq);
+        stepGas(dt);
+        physics.simTime += dt;
+        physics.stepCount++;
+        reorderGpuBodiesIfDisordered();
+        return;
+    }
+    if (bodiesOnGpu() && gpuNBody) {
+        // bodies stay on the GPU
+        if (physics.solver == SOLVER_PARTICLE_MESH && gpuParticleMesh) {
+            gpuParticleMesh->kick(*gpuNBody, physics.particleMesh, dt, physics.G, physics.epsilonSq);
+            gpuNBody->drift(dt);
+        } else if (physics.solver == SOLVER_BARNES_HUT && gpuBarnesHut) {
+            gpuBarnesHut->kick(*gpuNBody, dt, physics.G, physics.epsilonSq, physics.theta, physics.asteroidSelfGravity);
+            gpuNBody->drift(dt);
+        } else {
+            gpuNBody->step(dt, physics.G, physics.epsilonSq, physics.asteroidSelfGravity, physics.solver == SOLVER_TEST_PARTICLES);
+        }
+        stepGas(dt);
+        physics.simTime += dt;
+        physics.stepCount++;
+        reorderGpuBodiesIfDisordered();
+        return;
+    }
+    physics.step(dt);
+    stepGas(dt);
+    trajectoryRecorder.capture(physics.bodies, physics.simTime, physics.stepCount);
+    // bodies merged away leave the interpolation source before a re-sort permutes what is left
+    if (physics.mergersLastStep > 0) {
+        if (previousPositions.size() == physics.bodies.size() + physics.mergersLastStep)
+            eraseIndices(previousPositions, physics.lastRemoved());
+        asteroidAmount = static_cast<unsigned int>(physics.bodies.count(BODY_ASTEROID));
+    }
+    // the step may have re-sorted the asteroids, the interpolation source has to follow them
+    if (physics.reorderedLastStep && previousPositions.size() == physics.bodies.size())
+        applyOrder(previousPositions, physics.bodies.range(BODY_ASTEROID).begin, physics.lastReorder(), reorderScratch);
+}
+
+// position a body is drawn at: the last two physics states blended by how far the accumulator is into the next step
+glm::dvec3 renderPosition(size_t i) {
+    if (asyncPhysics.running()) {
+        const std::vector<glm::dvec3>& latest = asyncPhysics.latest().position;
+        return i < latest.size() ? latest[i] : physics.bodies.position[i];
+    }
+    if (i >= previousPositions.size()) return physics.bodies.position[i];
+    return glm::mix(previousPositions[i], physics.bodies.position[i], static_cast<double>(renderAlpha));
+}
+
+// Everything is drawn relative to the camera with a rotation-only view matrix. The subtraction happens in double,
+// so only the small camera-relative offsets are rounded to float and distant scenes do not jitter.
+glm::vec3 cameraRelative(const glm::dvec3& position) {
+    return glm::vec3(position - camera.Position);
+}
+
+// takes the next stream segment, which may wait on the GPU, so the frame graph runs it apart from the packing
+void* beginAsteroidInstances() {
+    if (bodiesOnGpu() || !asteroidInstanceStream.valid()) return nullptr;
+    return asteroidInstanceStream.beginWrite();
+}
+
+// calls fn(body index, camera-relative position) for up to asteroidAmount asteroids, from wherever the frame's
+// positions come from
+template <typename Fn>
+void forEachAsteroidInstance(const Fn& fn) {
+    const BodyRange asteroids = physics.bodies.range(BODY_ASTEROID);
+    unsigned int asteroidInstanceIdx = 0;
+    if (asyncPhysics.running()) {
+        // the physics thread sorts its own copy, so snapshot slots are matched to bodies by id
+        const PhysicsSnapshot& latest = asyncPhysics.latest();
+        for (size_t k = asteroids.begin; k < latest.id.size() && asteroidInstanceIdx < asteroidAmount; ++k) {
+            uint32_t i = physics.bodies.indexOf(latest.id[k]);
+            if (i == BodyStore::INVALID_INDEX) continue;
+            fn(i, cameraRelative(latest.position[k]));
+            asteroidInstanceIdx++;
+        }
+        return;
+    }
+    if (replayActive) {
+        // interpolated straight from the decoded frames, the asteroid positions never go through the body store
+        const std::vector<glm::dvec3>& a = trajectoryPlayer.frameA();
+        const std::vector<glm::dvec3>& b = trajectoryPlayer.frameB();
+        for (size_t i = asteroids.begin; i < asteroids.end && asteroidInstanceIdx < asteroidAmount; ++i, ++asteroidInstanceIdx)
+            fn(i, cameraRelative(glm::mix(a[i], b[i], replayBlend)));
+        return;
+    }
+    if (remoteActive) {
+        const std::vector<glm::dvec3>& a = stateClient.frameA();
+        const std::vector<glm::dvec3>& b = stateClient.frameB();
+        if (a.size() != physics.bodies.size() || b.size() != a.size()) return;
+        for (size_t i = asteroids.begin; i < asteroids.end && asteroidInstanceIdx < asteroidAmount; ++i, ++asteroidInstanceIdx)
+            fn(i, cameraRelative(glm::mix(a[i], b[i], remoteBlend)));
+        return;
+    }
+    for (size_t i = asteroids.begin; i < asteroids.end && asteroidInstanceIdx < asteroidAmount; ++i, ++asteroidInstanceIdx)
+        fn(i, cameraRelative(renderPosition(i)));
+}
+
+// plain writes into mapped memory, no GL calls, so any thread may do it. Visible asteroids are binned by level of
+// detail first, then every level is written as one run of records.
+void packAsteroidInstances(void* out) {
+    if (!out) return;
+    const unsigned int lodCount = rockModelPtr ? rockModelPtr->lodCount() : 1;
+    unsigned int counts[ASTEROID_BINS] = {0, 0, 0, 0, 0};
+    packCandidates.clear();
+    forEachAsteroidInstance([&](size_t i, const glm::vec3& at) {
+        const float radius = physics.bodies.render[i].radiusScale * rockBoundingRadius;
+        if (frustumCulling && !viewFrustum.intersectsSphere(at, radius)) return;
+        const float distance = glm::length(at);
+        const float pixels = radius * pixelsPerRadian / std::max(distance, 1e-4f);
+        uint32_t lod = 0;
+        if (asteroidImpostors && distance > effectiveImpostorDistance) lod = IMPOSTOR_BIN;
+        else while (lod + 1 < lodCount && pixels < effectiveLodPixels[lod]) lod++;
+        packCandidates.push_back(PackCandidate{static_cast<uint32_t>(i), lod, at});
+        counts[lod]++;
+    });
+
+    // quantized levels start on a chunk boundary so each draw can find its chunks, the capacity leaves room for it
+    unsigned int next = 0;
+    for (unsigned int l = 0; l < ASTEROID_BINS; l++) {
+        if (instanceStreamQuantized) next = (next + INSTANCE_CHUNK - 1) / INSTANCE_CHUNK * INSTANCE_CHUNK;
+        asteroidLodFirst[l] = next;
+        asteroidLodCount[l] = counts[l];
+        next += counts[l];
+    }
+    if (instanceStreamQuantized) {
+        // records first, the chunk table after the segment's full capacity of them
+        QuantizedInstance* records = static_cast<QuantizedInstance*>(out);
+        InstanceChunk* chunks = reinterpret_cast<InstanceChunk*>(records + asteroidInstanceCapacity);
+        for (unsigned int l = 0; l < ASTEROID_BINS; l++) {
+            if (counts[l] == 0) continue;
+            QuantizedInstanceWriter writer(records + asteroidLodFirst[l], chunks + asteroidLodFirst[l] / INSTANCE_CHUNK);
+            for (const PackCandidate& c : packCandidates)
+                if (c.lod == l) writer.add(physics.bodies, c.index, c.at);
+            writer.finish(physics.bodies);
+        }
+    } else {
+        AsteroidInstance* instances = static_cast<AsteroidInstance*>(out);
+        unsigned int fill[ASTEROID_BINS] = {0, 0, 0, 0, 0};
+        for (const PackCandidate& c : packCandidates)
+            instances[asteroidLodFirst[c.lod] + fill[c.lod]++] = packInstance(physics.bodies, c.index, c.at);
+    }
+    asteroidInstancesPacked = static_cast<unsigned int>(packCandidates.size());
+}
+
+void updateAsteroidInstances() {
+    packAsteroidInstances(beginAsteroidInstances());
+}
+
+// keeps what the frame's pick ids refer to, for a read queued now: the body ids by slot, and the slot of every
+// instance record packed into the drawn segment, laid out as packAsteroidInstances placed them
+void snapshotPickIds() {
+    pickSlotIds = physics.bodies.id;
+    pickRecordSlots.clear();
+    if (bodiesOnGpu() || !asteroidInstanceStream.valid()) return;
+    pickRecordBase = static_cast<uint32_t>(asteroidInstanceStream.readSegment() * asteroidSegmentRecords);
+    unsigned int end = 0;
+    for (unsigned int l = 0; l < ASTEROID_BINS; l++)
+        end = std::max(end, asteroidLodFirst[l] + asteroidLodCount[l]);
+    pickRecordSlots.assign(end, BodyStore::INVALID_INDEX);
+    unsigned int fill[ASTEROID_BINS] = {0, 0, 0, 0, 0};
+    for (const PackCandidate& c : packCandidates)
+        pickRecordSlots[asteroidLodFirst[c.lod] + fill[c.lod]++] = c.index;
+}
+
+// the body a pick id names, by its meaning in the snapshot; nothing selected for an empty pixel
+void resolvePick(uint32_t pick) {
+    const uint32_t index = pick & GpuPicker::PICK_INDEX;
+    uint32_t slot = BodyStore::INVALID_INDEX;
+    if (pick & GpuPicker::PICK_BODY)
+        slot = index;
+    else if ((pick & GpuPicker::PICK_RECORD) && index >= pickRecordBase && index - pickRecordBase < pickRecordSlots.size())
+        slot = pickRecordSlots[index - pickRecordBase];
+    selectedBodyId = slot < pickSlotIds.size() ? pickSlotIds[slot] : BodyStore::INVALID_INDEX;
+}
+
+// runs as many fixed steps as the elapsed sim time calls for
+// advances the replay clock and decodes the frames around it. Only the few massive bodies are written back,
+// lighting and their draws read them from the body store as usual.
+void updateReplay(float frameDt) {
+    physicsStepsLastFrame = 0;
+    renderAlpha = 1.0f;
+    if (!pauseSimulation) replayTime += static_cast<double>(frameDt) * replaySpeed;
+    double start = trajectoryPlayer.startTime(), end = trajectoryPlayer.endTime();
+    if (replayLoop && end > start) {
+        if (replayTime > end) replayTime = start + std::fmod(replayTime - start, end - start);
+        if (replayTime < start) replayTime = end - std::fmod(start - replayTime, end - start);
+    }
+    replayTime = std::clamp(replayTime, start, end);
+    trajectoryPlayer.seek(replayTime);
+    replayBlend = trajectoryPlayer.blend(replayTime);
+    const std::vector<glm::dvec3>& a = trajectoryPlayer.frameA();
+    const std::vector<glm::dvec3>& b = trajectoryPlayer.frameB();
+    for (size_t i = 0; i < physics.bodies.range(BODY_ASTEROID).begin; ++i)
+        physics.bodies.position[i] = glm::mix(a[i], b[i], replayBlend);
+}
+
+// takes in what the server sent, lays the bodies out again when its body table changed, and plays the snapshots
+// back a little behind the newest; like a replay only the massive bodies are written back
+void updateRemote(float frameDt) {
+    physicsStepsLastFrame = 0;
+    renderAlpha = 1.0f;
+    if (stateClient.poll() || (stateClient.ready() && physics.bodies.size() != stateClient.bodyCount())) {
+        stateClient.initializeBodies(physics.bodies, sphereMesh, planetModelPtr, rockModelPtr);
+        asteroidAmount = static_cast<unsigned int>(physics.bodies.count(BODY_ASTEROID));
+        setupAsteroidInstanceBuffers();
+        previousPositions.clear();
+    }
+    if (!stateClient.ready()) return;
+    remoteTime = stateClient.advance(frameDt);
+    stateClient.seek(remoteTime);
+    remoteBlend = stateClient.blend(remoteTime);
+    const std::vector<glm::dvec3>& a = stateClient.frameA();
+    const std::vector<glm::dvec3>& b = stateClient.frameB();
+    if (a.size() != physics.bodies.size() || b.size() != a.size()) return;
+    for (size_t i = 0; i < physics.bodies.range(BODY_ASTEROID).begin; ++i)
+        physics.bodies.position[i] = glm::mix(a[i], b[i], remoteBlend);
+}
+
+// one read of the body store's slots `first` onwards from a GPU backend buffer into their positions or velocities,
+// dropped if the bodies were replaced in between. The capture stays small enough for std::function to keep inline.
+void readGpuBodies(GpuNBody::Binding binding, uint32_t first, uint32_t count) {
+    const unsigned int generation = gpuBodiesGeneration;
+    const bool velocities = binding == GpuNBody::BINDING_VELOCITY;
+    gpuReadback->request(gpuNBody->buffer(binding), first * sizeof(glm::vec4), count * sizeof(glm::vec4),
+                         [generation, first, velocities](const void* data, size_t bytes, unsigned int) {
+        if (generation != gpuBodiesGeneration) return;
+        BodyArray<glm::dvec3>& into = velocities ? physics.bodies.velocity : physics.bodies.position;
+        const glm::vec4* values = static_cast<const glm::vec4*>(data);
+        for (size_t k = 0; k < bytes / sizeof(glm::vec4) && first + k < into.size(); k++)
+            into[first + k] = glm::dvec3(glm::vec3(values[k]));
+    });
+}
+
+// asks for what the CPU shows of the GPU backends' bodies: the sun and planets the GPU compute backend moves, and
+// the selected body for its panel
+void requestGpuBodies() {
+    const uint32_t massive = static_cast<uint32_t>(physics.bodies.range(BODY_ASTEROID).begin);
+    if (physicsBackend == BACKEND_GPU_COMPUTE && massive > 0) readGpuBodies(GpuNBody::BINDING_POSITION_MASS, 0, massive);
+    const uint32_t selected = physics.bodies.indexOf(selectedBodyId);
+    if (selected == BodyStore::INVALID_INDEX || selected >= gpuNBody->bodyCount) return;
+    if (physicsBackend == BACKEND_HYBRID && selected < massive) return;
+    if (selected >= massive) readGpuBodies(GpuNBody::BINDING_POSITION_MASS, selected, 1);
+    readGpuBodies(GpuNBody::BINDING_VELOCITY, selected, 1);
+}
+
+// the fixed steps a frame may take, the user's cap or the governor's when that is lower
+int physicsStepCap() {
+    const unsigned int governed = qualityGovernor.settings().maxPhysicsSteps;
+    return governed > 0 ? std::min(maxPhysicsStepsPerFrame, static_cast<int>(governed)) : maxPhysicsStepsPerFrame;
+}
+
+// the governor's settings over the user's, once per frame before anything reads them
+void applyQualitySettings() {
+    const QualitySettings& quality = qualityGovernor.settings();
+    for (unsigned int l = 0; l + 1 < MAX_MESH_LODS; l++)
+        effectiveLodPixels[l] = asteroidLodPixels[l] * quality.lodPixelScale;
+    effectiveImpostorDistance = impostorDistance * quality.impostorDistanceScale;
+    sunShadow->setResolution(SUN_SHADOW_RESOLUTION >> quality.shadowResolutionShift);
+}
+
+void updatePhysics(float frameDt) {
+    PROFILE_FUNCTION();
+    // a fallback tier only belongs to the warp loop below, anything else runs the user's settings
+    bool warpActive = timeWarp.enabled && physicsBackend == BACKEND_CPU && !asyncPhysics.running() && !replayActive && !remoteActive;
+    if (!warpActive && timeWarp.tier != TimeWarp::TIER_USER) timeWarp.restore(physics);
+    if (replayActive) {
+        updateReplay(frameDt);
+        return;
+    }
+    if (remoteActive) {
+        updateRemote(frameDt);
+        return;
+    }
+    if (physics.beltSectors && sectorFocusOnCamera) {
+        const glm::dvec3 focus = camera.Position;
+        if (asyncPhysics.running()) asyncPhysics.post([focus](PhysicsWorld& world) { world.sectors.focus = focus; });
+        else physics.sectors.focus = focus;
+    }
+    if (asyncPhysics.running()) {
+        // the physics thread keeps its own accumulator, this only forwards the pacing and picks up new states
+        asyncPhysics.setPacing(simulationSpeed, fixedTimestep ? physicsStepSize : 1.0f / 120.0f, physicsStepCap(), pauseSimulation);
+        physicsStepsLastFrame = 0;
+        renderAlpha = 1.0f;
+        // the gas stays on this thread, stepped by the frame against the latest state
+        if (!pauseSimulation) stepGas(std::min(frameDt, 0.1f) * simulationSpeed);
+        if (asyncPhysics.acquire()) {
+            physicsStepsLastFrame = static_cast<int>(asyncPhysics.latest().stepsLastBatch);
+            // mergers on the physics thread shrink the snapshot, the massive bodies are never removed
+            if (physics.collisions)
+                asteroidAmount = static_cast<unsigned int>(asyncPhysics.latest().id.size() - physics.bodies.range(BODY_ASTEROID).begin);
+        }
+        return;
+    }
+    if (pauseSimulation) return;
+
+    float simDt = frameDt * simulationSpeed;
+    if (simDt <= 0.0f) return;
+
+    physicsStepsLastFrame = 0;
+    if (warpActive) {
+        previousPositions.assign(physics.bodies.position.begin(), physics.bodies.position.end());
+        timeWarp.advance(physics, simulationSpeed, frameDt, [](float dt) {
+            stepPhysics(dt);
+            physicsStepsLastFrame++;
+        });
+        renderAlpha = 1.0f;
+    } else if (fixedTimestep) {
+        physicsAccumulator += simDt;
+        const int stepCap = physicsStepCap();
+        while (physicsAccumulator >= physicsStepSize && physicsStepsLastFrame < stepCap) {
+            previousPositions.assign(physics.bodies.position.begin(), physics.bodies.position.end());
+            stepPhysics(physicsStepSize);
+            physicsAccumulator -= physicsStepSize;
+            physicsStepsLastFrame++;
+        }
+        // when the cap is hit the backlog is dropped, running slow is better than spiralling
+        if (physicsStepsLastFrame == stepCap && physicsAccumulator > physicsStepSize)
+            physicsAccumulator = physicsStepSize;
+        renderAlpha = physicsAccumulator / physicsStepSize;
+    } else {
+        previousPositions.assign(physics.bodies.position.begin(), physics.bodies.position.end());
+        stepPhysics(simDt);
+        physicsStepsLastFrame = 1;
+        renderAlpha = 1.0f;
+    }
+
+    if (bodiesOnGpu() && gpuNBody) {
+        // only the sun and planets come back for lighting and their draws, and they are drawn where they are
+        if (physicsBackend == BACKEND_HYBRID) hybridNBody->readMassive(physics.bodies);
+        requestGpuBodies();
+        previousPositions.clear();
+    }
+}
+
+// hands the predictor this frame's state of the bodies whose paths are shown. The GPU backend only reads back
+// the massive bodies' positions, without velocities nothing can be predicted from it.
+void updatePredictions() {
+    if (!orbitPredictions || replayActive || remoteActive || bodiesOnGpu()) {
+        orbitPredictor.stop();
+        return;
+    }
+    predictedIds.clear();
+    if (predictPlanets) {
+        const BodyRange planets = physics.bodies.range(BODY_PLANET);
+        for (size_t i = planets.begin; i < planets.end; i++) predictedIds.push_back(physics.bodies.id[i]);
+    }
+    for (uint32_t id : pinnedPredictionIds)
+        if (physics.bodies.indexOf(id) != BodyStore::INVALID_INDEX) predictedIds.push_back(id);
+    if (physics.bodies.indexOf(selectedBodyId) != BodyStore::INVALID_INDEX) predictedIds.push_back(selectedBodyId);
+    if (asyncPhysics.running()) {
+        // the physics thread has the velocities, it copies the few bodies between two steps
+        const std::vector<uint32_t> ids = predictedIds;
+        const OrbitPredictor::Settings settings = predictionSettings;
+        asyncPhysics.post([ids, settings](PhysicsWorld& world) {
+            orbitPredictor.update(world.bodies, world.simTime, ids, world.G, world.epsilonSq, settings);
+        });
+    } else {
+        orbitPredictor.update(physics.bodies, physics.simTime, predictedIds, physics.G, physics.epsilonSq, predictionSettings);
+    }
+    orbitPredictor.acquire();
+}
+
+// makes sure a stream segment holds asteroidAmount instances in the chosen format. The capacity at least doubles
+// when it has to grow, so sweeping the count slider reallocates a handful of times rather than on every tick.
+void setupAsteroidInstanceBuffers() {
+    PROFILE_FUNCTION();
+    if (asteroidAmount == 0 || !rockModelPtr) return;
+    const bool formatChanged = quantizedInstances != instanceStreamQuantized;
+    const unsigned int slack = quantizedInstances ? ASTEROID_BINS * INSTANCE_CHUNK : 0;
+    if (asteroidInstanceStream.valid() && asteroidAmount + slack <= asteroidInstanceCapacity && !formatChanged) {
+        rockModelPtr->bindInstances(asteroidInstances);   // a reloaded rock model has VAOs that were never pointed at it
+        return;
+    }
+
+    if (formatChanged) asteroidInstanceCapacity = 0;
+    asteroidInstanceCapacity = std::max(asteroidAmount, 2 * asteroidInstanceCapacity);
+    instanceStreamQuantized = quantizedInstances;
+    if (instanceStreamQuantized) {
+        // the chunk table (32 bytes per 256 records) is padded out to whole records, and a capacity of whole
+        // 2048s keeps both it and every segment at a 256-byte SSBO offset alignment. Each level of detail and the
+        // impostors start on a chunk of their own, which can leave up to a chunk unused per bin.
+        asteroidInstanceCapacity += ASTEROID_BINS * INSTANCE_CHUNK;
+        asteroidInstanceCapacity = (asteroidInstanceCapacity + 8 * INSTANCE_CHUNK - 1) / (8 * INSTANCE_CHUNK) * (8 * INSTANCE_CHUNK);
+        asteroidSegmentRecords = asteroidInstanceCapacity + asteroidInstanceCapacity / INSTANCE_CHUNK * sizeof(InstanceChunk) / sizeof(QuantizedInstance);
+        asteroidInstanceStream.create(asteroidSegmentRecords * sizeof(QuantizedInstance), "asteroid instances (quantized)");
+    } else {
+        asteroidSegmentRecords = asteroidInstanceCapacity;
+        // one segment per frame in flight, draws pick theirs with baseInstance so the attribute offsets stay fixed
+        asteroidInstanceStream.create(asteroidInstanceCapacity * sizeof(AsteroidInstance), "asteroid instances");
+    }
+
+    // the new buffer may have the old one's name, use() makes it a new version either way
+    asteroidInstances.setLayout(instanceStreamQuantized ? QUANTIZED_INSTANCE_LAYOUT : ASTEROID_INSTANCE_LAYOUT);
+    asteroidInstances.use(asteroidInstanceStream.buffer());
+    rockModelPtr->bindInstances(asteroidInstances);
+}
+
+// Reset Simulation Full builds the new world on a worker thread while the old one keeps running and rendering,
+// the first frame after it is done swaps it in (finishWorldRebuild), leaving only the instance buffers and a GPU
+// backend's upload to the frame boundary. The generators' loops run on the builder thread alone while the pool is
+// stepping the old world.
+struct WorldRebuild {
+    PhysicsWorld world;
+    std::thread thread;
+    std::atomic<bool> done{false};
+};
+WorldRebuild* worldRebuild = nullptr;
+
+// --universe: star systems in a grid of cells around the camera, the nearest one in physics (world_streaming.h)
+bool universeEnabled = false;
+double universeCellSize = 2500.0;
+WorldStreamer universe;
+
+// drops a rebuild in progress, waiting for its thread
+void abandonWorldRebuild() {
+    if (!worldRebuild) return;
+    worldRebuild->thread.join();
+    delete worldRebuild;
+    worldRebuild = nullptr;
+}
+
+// The sun and the planets' bounding spheres, the model's farthest vertex (Mesh::boundingRadius, found at import)
+// times the body's scale, in a loose octree kept in step with the drawn positions: the CPU pick and the planets drawn
+// mesh by mesh ask it for what they could touch instead of walking every body. Positions are stored relative to
+// bodyOctreeOrigin, the system's sun when it was built, so they stay small enough for float. The asteroids keep to
+// their instanced paths, culled on the GPU or while packing.
+LooseOctree bodyOctree;
+glm::dvec3 bodyOctreeOrigin(0.0);
+
+float bodyBoundingRadius(size_t i) {
+    const BodyRenderData& body = physics.bodies.render[i];
+    const Model* model = body.modelPtr;
+    return body.radiusScale * (!model ? 1.0f : model == rockModelPtr ? rockBoundingRadius : planetBoundingRadius);
+}
+
+glm::vec3 bodyOctreePosition(size_t i) {
+    return glm::vec3(renderPosition(i) - bodyOctreeOrigin);
+}
+
+// the drawn positions of this frame into the tree, bodies that are gone drop out
+void updateBodyOctree() {
+    PROFILE_FUNCTION();
+    for (BodyType type : {BODY_SUN, BODY_PLANET}) {
+        const BodyRange bodies = physics.bodies.range(type);
+        for (size_t i = bodies.begin; i < bodies.end; i++)
+            bodyOctree.update(physics.bodies.id[i], bodyOctreePosition(i), bodyBoundingRadius(i));
+    }
+    bodyOctree.removeStale();
+}
+
+// a new tree around the new bodies, its root cell a quarter again past the farthest of them
+void rebuildBodyOctree() {
+    const BodyRange suns = physics.bodies.range(BODY_SUN);
+    bodyOctreeOrigin = suns.begin < suns.end ? physics.bodies.position[suns.begin] : glm::dvec3(0.0);
+    double extent = 1.0;
+    for (BodyType type : {BODY_SUN, BODY_PLANET}) {
+        const BodyRange bodies = physics.bodies.range(type);
+        for (size_t i = bodies.begin; i < bodies.end; i++)
+            extent = std::max(extent, glm::length(physics.bodies.position[i] - bodyOctreeOrigin) + bodyBoundingRadius(i));
+    }
+    bodyOctree.reset(glm::vec3(0.0f), static_cast<float>(1.25 * extent));
+    updateBodyOctree();
+}
+
+// spawns the gas disk around the sun as it is now, or releases it when the gas is off
+void respawnGas() {
+    if (!gasDisk) return;
+    const BodyRange suns = physics.bodies.range(BODY_SUN);
+    if (!gasEnabled || suns.begin == suns.end) {
+        gasDisk->release();
+        return;
+    }
+    gasParams.seed = scenarioSeed + 2;
+    gasParams.outerRadius = std::max(gasParams.outerRadius, gasParams.innerRadius);
+    gasDisk->spawn(gasParams, glm::vec3(physics.bodies.position[suns.begin]), glm::vec3(physics.bodies.velocity[suns.begin]),
+                   physics.G * physics.bodies.mass[suns.begin]);
+}
+
+// the rest of a reset once physics has its new bodies
+void resetAfterInitialize(bool wasAsync) {
+    if (galaxyScene || !scenarioPath.empty()) asteroidAmount = static_cast<unsigned int>(physics.bodies.count(BODY_ASTEROID));
+    // millions of stars on the GPU would otherwise get a CPU instance stream they never use
+    if (!galaxyScene || !bodiesOnGpu()) setupAsteroidInstanceBuffers();
+    previousPositions.clear();
+    physicsAccumulator = 0.0f;
+    renderAlpha = 1.0f;
+    updateAsteroidInstances(); // so a paused simulation still shows the new belt
+    rebuildBodyOctree();
+    if (bodiesOnGpu() && gpuNBody) uploadGpuBodies();
+    if (gasEnabled) respawnGas();
+    if (wasAsync) asyncPhysics.start(physics);
+}
+
+void resetSimulation() {
+    PROFILE_FUNCTION();
+    abandonWorldRebuild();
+    bool wasAsync = asyncPhysics.running();
+    if (wasAsync) asyncPhysics.stop(physics);
+    initializeCelestialBodies();
+    resetAfterInitialize(wasAsync);
+    startUniverse();
+}
+
+// resetSimulation with the bodies generated in the background, see WorldRebuild
+void resetSimulationInBackground() {
+    if (worldRebuild) return;
+    worldRebuild = new WorldRebuild();
+    worldRebuild->world.applySettings(physics.settings());
+    worldRebuild->thread = std::thread([recipe = celestialBodiesRecipe(), rebuild = worldRebuild]() {
+        PROFILE_SCOPE("world rebuild");
+        recipe(rebuild->world);
+        rebuild->done.store(true, std::memory_order_release);
+    });
+}
+
+// swaps a finished rebuild in, at the start of a frame; the old bodies go with the rebuild
+void finishWorldRebuild() {
+    if (!worldRebuild || !worldRebuild->done.load(std::memory_order_acquire)) return;
+    PROFILE_FUNCTION();
+    worldRebuild->thread.join();
+    bool wasAsync = asyncPhysics.running();
+    if (wasAsync) asyncPhysics.stop(physics);
+    physics.adopt(worldRebuild->world);
+    resetAfterInitialize(wasAsync);
+    delete worldRebuild;
+    worldRebuild = nullptr;
+    startUniverse();
+}
+
+// the universe around the freshly made home system; a galaxy, a scenario file, a replay or a server has none
+void startUniverse() {
+    universe.stop();
+    if (!universeEnabled || galaxyScene || !scenarioPath.empty() || replayActive || remoteActive) return;
+    universe.cellSize = universeCellSize;
+    universe.loadRadius = 1.6 * universeCellSize;
+    universe.evictRadius = 2.4 * universeCellSize;
+    universe.seed = benchmark.seed;
+    universe.start([](PhysicsWorld& world, const ScenarioConfig& scenario) { world.initialize(scenario, sphereMesh, planetModelPtr, rockModelPtr); },
+                   currentScenario(), physics.settings());
+}
+
+// like finishWorldRebuild, with the system the camera came to
+void activateSystem(WorldStreamer::System& next) {
+    PROFILE_FUNCTION();
+    bool wasAsync = asyncPhysics.running();
+    if (wasAsync) asyncPhysics.stop(physics);
+    universe.activate(next, physics);
+    asteroidAmount = static_cast<unsigned int>(physics.bodies.count(BODY_ASTEROID));
+    resetAfterInitialize(wasAsync);
+}
+
+// applies a new asteroid count without regenerating the belt: surviving bodies keep their state
+void resizeAsteroidBelt() {
+    PROFILE_FUNCTION();
+    bool wasAsync = asyncPhysics.running();
+    if (wasAsync) asyncPhysics.stop(physics);
+    physics.setAsteroidCount(currentScenario(), rockModelPtr);
+    setupAsteroidInstanceBuffers();
+    previousPositions.clear();
+    updateAsteroidInstances();
+    if (bodiesOnGpu() && gpuNBody) uploadGpuBodies();
+    if (wasAsync) asyncPhysics.start(physics);
+}
+
+// sim time of what is on screen, whichever of the physics thread, a replay, a server or the world is driving it
+double displayedSimTime() {
+    if (asyncPhysics.running()) return asyncPhysics.latest().simTime;
+    if (replayActive) return replayTime;
+    if (remoteActive) return remoteTime;
+    return physics.simTime;
+}
+
+// at the start of a frame, before anything looks at the bodies
+void updateUniverse() {
+    if (!universe.running()) return;
+    if (WorldStreamer::System* next = universe.update(camera.Position, displayedSimTime())) activateSystem(*next);
+}
+
+// Without GPU picking, the ray from the camera through pickPoint against the bodies as drawn: the sun's sphere, and
+// the planet's and the rocks' triangles through their BVHs for the bodies whose bounding sphere it passes through.
+// viewProjection is the unjittered camera-relative one.
+void cpuPick(const glm::mat4& viewProjection) {
+    PROFILE_FUNCTION();
+    const glm::mat4 unproject = glm::inverse(viewProjection);
+    const glm::vec2 ndc = pickPoint * 2.0f - 1.0f;
+    const glm::vec4 nearPoint = unproject * glm::vec4(ndc, depthConvention().nearNdc(), 1.0f);
+    const glm::vec4 farPoint = unproject * glm::vec4(ndc, depthConvention().beyondNdc(), 1.0f);
+    const glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+    const glm::vec3 direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
+    const float spinTime = static_cast<float>(std::fmod(displayedSimTime(), TUMBLE_PERIOD));
+    float nearest = INFINITY;
+    uint32_t picked = BodyStore::INVALID_INDEX;
+    auto test = [&](size_t i, const glm::vec3& at, bool tumbles) {
+        const BodyRenderData& body = physics.bodies.render[i];
+        const Model* model = body.modelPtr;
+        const float radius = bodyBoundingRadius(i);
+        const glm::vec3 toCenter = at - origin;
+        const float along = glm::dot(toCenter, direction), missSq = glm::dot(toCenter, toCenter) - along * along;
+        if (along + radius < 0.0f || missSq > radius * radius || along - radius > nearest) return;
+        if (!model) {
+            const float t = along - std::sqrt(radius * radius - missSq);
+            if (t > 0.0f && t < nearest) {
+                nearest = t;
+                picked = static_cast<uint32_t>(i);
+            }
+            return;
+        }
+        // the tumble as the asteroid shaders apply it, after the spawn orientation
+        glm::quat orientation = body.orientation;
+        if (tumbles) orientation = orientation * glm::angleAxis(body.spin.w * spinTime, glm::vec3(body.spin));
+        const glm::mat4 toModel = glm::inverse(glm::translate(glm::mat4(1.0f), at) * glm::mat4_cast(orientation)
+                                               * glm::scale(glm::mat4(1.0f), glm::vec3(body.radiusScale)));
+        BvhHit hit;
+        if (model->intersect(BvhRay{glm::vec3(toModel * glm::vec4(origin, 1.0f)), glm::vec3(toModel * glm::vec4(direction, 0.0f)), nearest}, hit)) {
+            nearest = hit.t;
+            picked = static_cast<uint32_t>(i);
+        }
+    };
+    bodyOctree.forEachOnRay(origin + glm::vec3(camera.Position - bodyOctreeOrigin), direction, INFINITY, [&](uint32_t id) {
+        const uint32_t i = physics.bodies.indexOf(id);
+        if (i != BodyStore::INVALID_INDEX) test(i, cameraRelative(renderPosition(i)), false);
+    });
+    forEachAsteroidInstance([&](size_t i, const glm::vec3& at) { test(i, at, true); });
+    selectedBodyId = picked == BodyStore::INVALID_INDEX ? picked : physics.bodies.id[picked];
+}
+
+bool debugDrawActive() {
+    return debugVelocities || debugBodyBounds || debugOctreeCells || debugTreeCells || debugLightRanges;
+}
+
+// the frame's primitives of the debug views turned on, camera-relative as the frame sees them
+void buildDebugDraw() {
+    PROFILE_FUNCTION();
+    debugDraw->begin(camera.Position);
+    const DebugDraw::Layer layer = debugOverlay ? DebugDraw::OVERLAY : DebugDraw::DEPTH_TESTED;
+    const size_t asteroidLimit = static_cast<size_t>(std::max(debugAsteroidLimit, 0));
+    if (debugVelocities && !bodiesOnGpu()) {
+        const uint32_t color = DebugDraw::color(glm::vec3(1.0f, 0.8f, 0.2f));
+        for (BodyType type : {BODY_SUN, BODY_PLANET, BODY_ASTEROID}) {
+            const BodyRange bodies = physics.bodies.range(type);
+            const size_t end = type == BODY_ASTEROID ? std::min(bodies.end, bodies.begin + asteroidLimit) : bodies.end;
+            for (size_t i = bodies.begin; i < end; i++)
+                debugDraw->arrow(renderPosition(i), physics.bodies.velocity[i] * static_cast<double>(debugVelocityScale), color, layer);
+        }
+    }
+    if (debugBodyBounds) {
+        const uint32_t inView = DebugDraw::color(glm::vec3(0.3f, 1.0f, 0.4f)), culled = DebugDraw::color(glm::vec3(1.0f, 0.25f, 0.2f));
+        auto bound = [&](const glm::vec3& at, float radius) {
+            const bool visible = !frustumCulling || viewFrustum.intersectsSphere(at, radius);
+            debugDraw->sphere(camera.Position + glm::dvec3(at), radius, visible ? inView : culled, layer);
+        };
+        for (BodyType type : {BODY_SUN, BODY_PLANET}) {
+            const BodyRange bodies = physics.bodies.range(type);
+            for (size_t i = bodies.begin; i < bodies.end; i++)
+                bound(cameraRelative(renderPosition(i)), bodyBoundingRadius(i));
+        }
+        size_t asteroids = 0;
+        forEachAsteroidInstance([&](size_t i, const glm::vec3& at) {
+            if (asteroids++ < asteroidLimit) bound(at, physics.bodies.render[i].radiusScale * rockBoundingRadius);
+        });
+    }
+    if (debugOctreeCells) {
+        const uint32_t color = DebugDraw::color(glm::vec3(0.3f, 0.6f, 1.0f));
+        bodyOctree.forEachCell([&](const glm::vec3& center, float halfSize, uint32_t) {
+            debugDraw->box(bodyOctreeOrigin + glm::dvec3(center), glm::vec3(halfSize), color, layer);
+        });
+    }
+    // the tree the last CPU tree step built; the physics thread keeps its own
+    const BarnesHutTree& tree = physics.tree;
+    if (debugTreeCells && !asyncPhysics.running() && !tree.nodes.empty()) {
+        std::vector<std::pair<int, int>> stack{{0, 0}};
+        while (!stack.empty()) {
+            const auto [n, depth] = stack.back();
+            stack.pop_back();
+            const BarnesHutTree::Node& node = tree.nodes[n];
+            const float fade = 1.0f - 0.8f * static_cast<float>(depth) / static_cast<float>(std::max(debugTreeDepth, 1));
+            debugDraw->box(physics.treeOrigin() + glm::dvec3(node.center), glm::vec3(node.halfSize),
+                           DebugDraw::color(glm::vec3(0.8f, 0.4f, 1.0f) * fade), layer);
+            if (node.firstChild < 0 || depth >= debugTreeDepth) continue;
+            for (unsigned int c = 0; c < node.childCount; c++) stack.push_back({node.firstChild + static_cast<int>(c), depth + 1});
+        }
+    }
+    if (debugLightRanges) {
+        const uint32_t color = DebugDraw::color(glm::vec3(1.0f, 0.95f, 0.6f));
+        for (const ClusteredLights::Light& light : frameLights)
+            if (light.position.w > 0.0f && light.position.w < 1e6f)
+                debugDraw->sphere(camera.Position + glm::dvec3(glm::vec3(light.position)), light.position.w, color, layer);
+    }
+}
+
+// ranks what is still loading by the frame's view: the sun and the planets for the planet model, a sample of the
+// asteroids for the rock's
+void rankAssets() {
+    if (modelLoader().pending() == 0 && textureCache().streamingPending() == 0 && !textureCache().mipStreamingEnabled()) return;
+    assetPriorities.begin(viewFrustum, pixelsPerRadian);
+    for (BodyType type : {BODY_SUN, BODY_PLANET}) {
+        const BodyRange bodies = physics.bodies.range(type);
+        for (size_t i = bodies.begin; i < bodies.end; i++)
+            assetPriorities.observe(planetAsset, cameraRelative(renderPosition(i)), physics.bodies.render[i].radiusScale * planetBoundingRadius);
+    }
+    // the GPU belt's and the GPU backend's rocks are not where the body store has them
+    const BodyRange asteroids = physics.bodies.range(BODY_ASTEROID);
+    if (gpuBeltEnabled || bodiesOnGpu()) {
+        assetPriorities.observeEverywhere(rockAsset);
+    } else {
+        const size_t stride = std::max<size_t>((asteroids.end - asteroids.begin) / 256, 1);
+        for (size_t i = asteroids.begin; i < asteroids.end; i += stride)
+            assetPriorities.observe(rockAsset, cameraRelative(renderPosition(i)), physics.bodies.render[i].radiusScale * rockBoundingRadius);
+    }
+    assetPriorities.rank();
+}
+
+// spawns the visual belt from the asteroid shape sliders, entirely on the GPU
+void respawnGpuBelt() {
+    PROFILE_FUNCTION();
+    if (!gpuBelt) return;
+    GpuBelt::Params params;
+    params.count = static_cast<unsigned int>(std::max(gpuBeltCount, 0));
+    params.seed = scenarioSeed + 1;
+    params.innerRadius = asteroidBeltInnerRadius;
+    params.outerRadius = std::max(asteroidBeltOuterRadius, asteroidBeltInnerRadius);
+    params.height = asteroidBeltHeight;
+    params.minScale = minAsteroidScale;
+    params.maxScale = std::max(maxAsteroidScale, minAsteroidScale);
+    gpuBelt->spawn(params);
+    gpuBeltClock = displayedSimTime();
+}
+
+// moves the visual belt by however much sim time passed since the last frame, around the sun as drawn
+void advanceGpuBelt() {
+    if (!gpuBelt || gpuBelt->rockCount() == 0 || physics.bodies.count(BODY_SUN) == 0) return;
+    double now = displayedSimTime();
+    double dt = now - gpuBeltClock;
+    gpuBeltClock = now;
+    // a reset, load or replay seek jumps the clock, the belt just carries on from where it is
+    if (dt < 0.0 || dt > 1.0) dt = 0.0;
+    size_t sun = physics.bodies.range(BODY_SUN).begin;
+    gpuBelt->advance(static_cast<float>(dt), physics.G * physics.bodies.mass[sun], glm::vec3(renderPosition(sun)));
+}
+
+// a trail sample when trailInterval of sim time has passed since the last. The rings start over when their source
+// or size changes or the clock goes back (a reset, a load, a replay seek).
+void captureTrails(bool drawBelt) {
+    if (!motionTrails || !gpuTrails) {
+        trailSource = TRAILS_NONE;
+        return;
+    }
+    int source = TRAILS_CPU;
+    unsigned int available = static_cast<unsigned int>(physics.bodies.size());
+    if (drawBelt && trailBeltRocks) {
+        source = TRAILS_GPU_BELT;
+        available = gpuBelt->rockCount();
+    } else if (bodiesOnGpu() && gpuNBody) {
+        source = TRAILS_GPU_NBODY;
+        available = gpuNBody->bodyCount;
+    }
+    const unsigned int count = std::min(available, static_cast<unsigned int>(std::max(trailBodies, 0)));
+    const double now = displayedSimTime();
+    const unsigned int length = static_cast<unsigned int>(std::max(2, static_cast<int>(trailLength * qualityGovernor.settings().trailLengthScale)));
+    if (source != trailSource || count != gpuTrails->bodyCount() || length != gpuTrails->length() || now < lastTrailCapture) {
+        gpuTrails->resize(count, length);
+        gpuTrails->clear();
+        trailSource = source;
+    }
+    if (count == 0 || (gpuTrails->samples() > 0 && now - lastTrailCapture < trailInterval)) return;
+    lastTrailCapture = now;
+    if (source == TRAILS_GPU_BELT) {
+        gpuTrails->captureBuffer(gpuBelt->positionBuffer());
+        return;
+    }
+    if (source == TRAILS_GPU_NBODY) {
+        gpuTrails->captureBuffer(gpuNBody->positionBuffer());
+        return;
+    }
+    // by id, so a trail stays with its body when the asteroids are re-sorted; ids past the rings have none
+    glm::vec4* out = gpuTrails->beginUpload();
+    if (!out) return;
+    std::fill(out, out + count, glm::vec4(0.0f));
+    const BodyRange asteroids = physics.bodies.range(BODY_ASTEROID);
+    for (size_t i = 0; i < asteroids.begin; i++) {
+        const uint32_t id = physics.bodies.id[i];
+        if (id < count) out[id] = glm::vec4(glm::vec3(renderPosition(i)), 1.0f);
+    }
+    forEachAsteroidInstance([&](size_t i, const glm::vec3& at) {
+        const uint32_t id = physics.bodies.id[i];
+        if (id < count) out[id] = glm::vec4(glm::vec3(camera.Position + glm::dvec3(at)), 1.0f);
+    });
+    gpuTrails->captureUpload();
+}
+
+// copies the current state for the writer thread, the simulation keeps running while the file is written
+void saveSnapshot() {
+    PROFILE_FUNCTION();
+    bool wasAsync = asyncPhysics.running();
+    if (wasAsync) asyncPhysics.stop(physics);
+    if (bodiesOnGpu() && gpuNBody) downloadGpuBodies();
+    bool started = snapshotWriter.write(snapshotPath, physics.bodies, physics.snapshotInfo());
+    snapshotStatus = started ? "writing " + std::string(snapshotPath) : "previous snapshot still writing";
+    if (wasAsync) asyncPhysics.start(physics);
+}
+
+// the recorder's producer side belongs to whichever thread steps the world, so with the physics thread
+// running the start and stop are posted to it
+void toggleRecording() {
+    TrajectoryRecorder::Options options;
+    options.stepInterval = static_cast<unsigned int>(std::max(recordInterval, 1));
+    options.quantum = recordQuantum;
+    options.stepSize = fixedTimestep ? physicsStepSize : 0.0f;
+    bool recording = trajectoryRecorder.recording();
+    if (asyncPhysics.running()) {
+        if (recording) asyncPhysics.post([](PhysicsWorld&) { trajectoryRecorder.stop(); });
+        else asyncPhysics.post([options](PhysicsWorld& world) { trajectoryRecorder.start(trajectoryPath, world.bodies, options); });
+    } else {
+        if (recording) trajectoryRecorder.stop();
+        else trajectoryRecorder.start(trajectoryPath, physics.bodies, options);
+    }
+}
+
+// replaces the simulation with the recording at trajectoryPath, the physics settings are left alone
+void startReplay() {
+    if (asyncPhysics.running()) { asyncPhysics.stop(physics); asyncPhysicsEnabled = false; }
+    if (trajectoryRecorder.recording()) trajectoryRecorder.stop();
+    if (!trajectoryPlayer.open(trajectoryPath)) {
+        snapshotStatus = "cannot open " + std::string(trajectoryPath);
+        return;
+    }
+    universe.stop();
+    trajectoryPlayer.initializeBodies(physics.bodies, sphereMesh, planetModelPtr, rockModelPtr);
+    asteroidAmount = static_cast<unsigned int>(physics.bodies.count(BODY_ASTEROID));
+    setupAsteroidInstanceBuffers();
+    previousPositions.clear();
+    replayTime = trajectoryPlayer.startTime();
+    replayBlend = 0.0;
+    replayActive = true;
+    updateAsteroidInstances();
+}
+
+// back to a freshly generated simulation
+void stopReplay() {
+    replayActive = false;
+    trajectoryPlayer.close();
+    resetSimulation();
+}
+
+// replaces the simulation with the server at remoteAddress; the bodies appear once its body table has arrived
+void startRemote() {
+    if (asyncPhysics.running()) { asyncPhysics.stop(physics); asyncPhysicsEnabled = false; }
+    if (trajectoryRecorder.recording()) trajectoryRecorder.stop();
+    if (replayActive) { replayActive = false; trajectoryPlayer.close(); }
+    if (!stateClient.connect(remoteAddress)) {
+        snapshotStatus = stateClient.error();
+        return;
+    }
+    if (bodiesOnGpu()) { gpuNBody->release(); hybridNBody->release(); physicsBackend = BACKEND_CPU; }
+    universe.stop();
+    physics.bodies.clear();
+    asteroidAmount = 0;
+    setupAsteroidInstanceBuffers();
+    previousPositions.clear();
+    remoteTime = 0.0;
+    remoteBlend = 0.0;
+    remoteActive = true;
+}
+
+void stopRemote() {
+    remoteActive = false;
+    stateClient.close();
+    resetSimulation();
+}
+
+// replaces the solar system with a galaxy encounter on the GPU backend, drawn as points
+void startGalaxyScene() {
+    if (asyncPhysics.running()) { asyncPhysics.stop(physics); asyncPhysicsEnabled = false; }
+    if (replayActive) { replayActive = false; trajectoryPlayer.close(); }
+    if (remoteActive) { remoteActive = false; stateClient.close(); }
+    if (!galaxyScene) solarSystemSettings = physics.settings();
+    galaxyScene = true;
+    gpuBeltEnabled = false;
+    gpuBelt->release();
+    gasEnabled = false;
+    gasDisk->release();
+    physicsBackend = BACKEND_GPU_COMPUTE;
+    pointCloudMode = true;
+    sceneTarget->logLuminance = true;
+    resetSimulation();
+    // above the encounter, which plays out within a few hundred units of the origin
+    camera.Position = glm::dvec3(0.0, 500.0, 1400.0);
+}
+
+void stopGalaxyScene() {
+    galaxyScene = false;
+    pointCloudMode = false;
+    sceneTarget->logLuminance = false;
+    physics.applySettings(solarSystemSettings);
+    asteroidAmount = ScenarioConfig().asteroidAmount;
+    resetSimulation();
+}
+
+void writeTrace() {
+    size_t events = 0;
+    if (profiler().writeTrace(tracePath, &events))
+        traceStatus = "wrote " + std::to_string(events) + " events to " + std::string(tracePath);
+    else
+        traceStatus = "cannot write " + std::string(tracePath);
+    std::cout << traceStatus << std::endl;
+}
+
+// appends where the camera is and what it looks at, two seconds after the last key, and saves the path
+void recordCameraKey() {
+    const double time = recordedCameraPath.empty() ? 0.0 : recordedCameraPath.endTime() + 2.0;
+    recordedCameraPath.add(time, camera.Position, camera.Position + glm::dvec3(camera.Front) * 100.0);
+    if (recordedCameraPath.save(cameraPathFile))
+        cameraPathStatus = std::to_string(recordedCameraPath.size()) + " keys in " + std::string(cameraPathFile);
+    else
+        cameraPathStatus = "cannot write " + std::string(cameraPathFile);
+    std::cout << cameraPathStatus << std::endl;
+}
+
+void takeScreenshot() {
+    frameCapture->screenshot("screenshot-" + std::to_string(++screenshotCount) + ".png");
+    std::cout << frameCapture->status() << std::endl;
+}
+
+void toggleVideo() {
+    if (frameCapture->recording())
+        frameCapture->stopRecording();
+    else
+        frameCapture->startRecording(videoPath, videoFps);
+    std::cout << frameCapture->status() << std::endl;
+}
+
+// something on screen may change next frame for another reason than input: the simulation running or streaming
+// in, assets arriving, the GPU's reads still coming back, or frames that must be drawn (benchmarks, recordings)
+bool sceneChanging() {
+    if (!pauseSimulation || remoteActive || benchmark.active || headless.active || frameCapture->recording()) return true;
+    if (asyncPhysics.running() || worldRebuild) return true;
+    if (modelLoader().pending() > 0 || textureCache().streamingPending() > 0) return true;
+    if (planetSurface && planetSurface->loading() > 0) return true;
+    return gpuReadback->bytesInFlight() > 0;
+}
+
+// whether on-demand rendering skips this frame, after waiting for events; the camera and the event count at the
+// last frame drawn tell what changed
+bool skipIdleFrame(GLFWwindow* window) {
+    static unsigned long eventsDrawn = ~0ul;
+    static glm::dvec3 positionDrawn;
+    static glm::vec3 frontDrawn;
+    static float zoomDrawn = 0.0f;
+    static unsigned int settle = 0;
+    if (!window || !onDemandRendering) {
+        eventsDrawn = ~0ul;
+        return false;
+    }
+    const bool changed = windowEvents != eventsDrawn || camera.Position != positionDrawn || camera.Front != frontDrawn ||
+                         camera.Zoom != zoomDrawn || sceneChanging();
+    if (changed) settle = ON_DEMAND_SETTLE_FRAMES;
+    else if (settle > 0) settle--;
+    eventsDrawn = windowEvents;
+    positionDrawn = camera.Position;
+    frontDrawn = camera.Front;
+    zoomDrawn = camera.Zoom;
+    if (changed || settle > 0) return false;
+    // the render thread's events only count once a frame drains them, so events in its queue draw the frame
+    bool queued = false;
+    if (renderThread) queued = windowEventQueue.wait(ON_DEMAND_WAIT_SECONDS);
+    else glfwWaitEventsTimeout(ON_DEMAND_WAIT_SECONDS);
+    idleWaits++;
+    // the frame after a wait moves the camera by its own time, not the sleep's
+    lastFrame = static_cast<float>(clockSeconds());
+    return !queued;
+}
+
+// --render-thread's glfwPollEvents: the events the main thread queued since the last call, replayed into ImGui's
+// backend and the callbacks GLFW would otherwise have called itself
+void drainWindowEvents(GLFWwindow* window) {
+    windowEventQueue.take(windowEventBatch, windowInput);
+    for (const WindowEvent& e : windowEventBatch) {
+        switch (e.type) {
+        case WindowEvent::KEY: ImGui_ImplGlfw_KeyCallback(window, e.a, e.b, e.c, e.d); windowEvents++; break;
+        case WindowEvent::CHAR: ImGui_ImplGlfw_CharCallback(window, static_cast<unsigned int>(e.a)); windowEvents++; break;
+        case WindowEvent::MOUSE_BUTTON: ImGui_ImplGlfw_MouseButtonCallback(window, e.a, e.b, e.c); windowEvents++; break;
+        case WindowEvent::CURSOR_POS: ImGui_ImplGlfw_CursorPosCallback(window, e.x, e.y); mouse_callback(window, e.x, e.y); break;
+        case WindowEvent::SCROLL: ImGui_ImplGlfw_ScrollCallback(window, e.x, e.y); scroll_callback(window, e.x, e.y); break;
+        case WindowEvent::FOCUS: ImGui_ImplGlfw_WindowFocusCallback(window, e.a); windowEvents++; break;
+        case WindowEvent::CURSOR_ENTER: ImGui_ImplGlfw_CursorEnterCallback(window, e.a); windowEvents++; break;
+        case WindowEvent::FRAMEBUFFER_SIZE: framebuffer_size_callback(window, e.a, e.b); break;
+        case WindowEvent::REFRESH: windowEvents++; break;
+        }
+    }
+}
+
+// processInput's view of the window, the queued state with --render-thread
+bool keyDown(GLFWwindow* window, int key) {
+    return renderThread ? windowInput.key(key) : glfwGetKey(window, key) == GLFW_PRESS;
+}
+
+bool mouseButtonDown(GLFWwindow* window, int button) {
+    return renderThread ? windowInput.button(button) : glfwGetMouseButton(window, button) == GLFW_PRESS;
+}
+
+// the swap interval of presentMode; adaptive vsync falls back to vsync where the driver has no late swap tearing
+void applyPresentMode(GLFWwindow* window) {
+    if (!window) return;
+    if (presentMode == PRESENT_ADAPTIVE && !glfwExtensionSupported("GLX_EXT_swap_control_tear")
+        && !glfwExtensionSupported("WGL_EXT_swap_control_tear")) {
+        std::cout << "adaptive vsync is not supported, presenting with vsync" << std::endl;
+        presentMode = PRESENT_VSYNC;
+    }
+    glfwSwapInterval(swapInterval(presentMode));
+}
+
+// the eyes' matrices for view, at the frame's eye size
+void updateStereoFrame(const glm::mat4& view) {
+    stereoFrame = stereoCamera.frame(view, glm::radians(camera.Zoom), static_cast<float>(stereoEyeWidth) / static_cast<float>(stereoEyeHeight),
+                                     0.1f, 3000.0f);
+}
+
+// the frame's camera into the Matrices block, with both eyes in stereo
+void writeFrameCamera(const glm::mat4& projection, const glm::mat4& view) {
+    if (stereoCamera.enabled)
+        cameraUniforms.write(projection, view, stereoFrame.eyeProjection, stereoFrame.eyeView);
+    else
+        cameraUniforms.write(projection, view);
+}
+
+// RenderQueue's view hook in stereo: an eye's half of the scene target with its own camera, or the whole target
+// with the centre camera and both eyes for the instanced stereo packets, which cut at the middle
+void beginStereoView(unsigned int view, void*) {
+    if (view == RenderQueue::ALL_VIEWS) {
+        glViewport(0, 0, 2 * stereoEyeWidth, stereoEyeHeight);
+        glEnable(GL_CLIP_DISTANCE0);
+        cameraUniforms.write(stereoFrame.centreProjection, stereoFrame.centreView, stereoFrame.eyeProjection, stereoFrame.eyeView);
+        return;
+    }
+    glDisable(GL_CLIP_DISTANCE0);
+    glViewport(static_cast<int>(view) * stereoEyeWidth, 0, stereoEyeWidth, stereoEyeHeight);
+    cameraUniforms.write(stereoFrame.eyeProjection[view], stereoFrame.eyeView[view], stereoFrame.eyeProjection, stereoFrame.eyeView);
+}
+
+// the window's framebuffer size, or the headless one's
+void framebufferSize(GLFWwindow* window, int& width, int& height) {
+    if (window && renderThread) {
+        width = windowInput.framebufferWidth;
+        height = windowInput.framebufferHeight;
+    } else if (window) {
+        glfwGetFramebufferSize(window, &width, &height);
     } else {
-        asteroidModelMatrices = nullptr;
-        asteroidNormalMatrices = nullptr;
+        width = headlessTarget->width();
+        height = headlessTarget->height();
     }
+}
 
+// what the scene is presented into and captured from
+unsigned int outputFramebuffer() {
+    return headlessTarget ? headlessTarget->id() : 0;
+}
 
-    std::mt19937 rng(static_cast<unsigned int>(glfwGetTime()));
-    std::uniform_real_distribution<float> distribRadius(asteroidBeltInnerRadius, asteroidBeltOuterRadius);
-    std::uniform_real_distribution<float> distribAngle(0.0f, 2.0f * glm::pi<float>());
-    std::uniform_real_distribution<float> distribHeight(-asteroidBeltHeight / 2.0f, asteroidBeltHeight / 2.0f);
-    std::uniform_real_distribution<float> distribScale(minAsteroidScale, maxAsteroidScale);
-    std::uniform_real_distribution<float> distribRot(0.0f, 360.0f);
-    std::uniform_real_distribution<float> distribMassFactor(0.5f, 1.5f);
-
-    for (unsigned int i = 0; i < asteroidAmount; i++) {
-        float r = distribRadius(rng);
-        float angle = distribAngle(rng);
-        float y = distribHeight(rng);
-        glm::vec3 pos(r * cos(angle), y, r * sin(angle));
-
-        float velMag = (sunMass > 0 && r > 0) ? sqrt((G_scaled * sunMass) / r) : 0.0f;
-        glm::vec3 vel(-velMag * sin(angle), 0.0f, velMag * cos(angle));
-
-        std::uniform_real_distribution<float> distribVelPerturb(-velMag*0.1f, velMag*0.1f);
-        vel.x += distribVelPerturb(rng);
-        vel.y += distribVelPerturb(rng) * 0.1f;
-        vel.z += distribVelPerturb(rng);
+// a headless run finishes the frame it is on and shuts down as it would at its last
+void requestStop(int) {
+    stopRequested = 1;
+}
 
-        float currentAsteroidMass = avgAsteroidMass * distribMassFactor(rng);
-        float currentAsteroidScale = distribScale(rng);
-        
-        glm::vec3 randomAxis = glm::normalize(glm::vec3(distribRot(rng) + 0.1f, distribRot(rng) + 0.1f, distribRot(rng) + 0.1f));
-        glm::quat orientation = glm::angleAxis(glm::radians(distribRot(rng)), randomAxis);
+// What the GLES profile (render_profile.h) leaves of the viewer, over the command line's settings: no bindless or
+// virtual textures and no multi-draws, the 16-byte instance records, the asteroids as point impostors from nearer
+// on and the planets as sphere impostors, FXAA for MSAA, none of the costlier passes and fewer bodies to start
+// with. Once the context is there and before the first program is built, some of it chooses programs.
+void applyRenderProfile() {
+    const RenderProfile& profile = renderProfile();
+    if (!profile.es()) return;
+    bindlessTextures = false;
+    sparseTextures = false;
+    shadingRatesAvailable = false;
+    variableRateShading = false;
+    batchedModelDraws = false;
+    starCatalogSky = false;
+    quantizedInstances = true;
+    asteroidImpostors = true;
+    impostorDistance = std::min(impostorDistance, 150.0f);
+    effectiveImpostorDistance = impostorDistance;
+    sphereImpostors = true;
+    if (antiAliasing == AA_MSAA) antiAliasing = AA_FXAA;
+    sceneBloom = false;
+    occlusionCulling = false;
+    deferredShading = false;
+    planetAtmospheres = false;
+    // the moments are RG32F rendered six faces at a time
+    sunShadows = false;
+    tessellatedSpheres = false;
+    planetTerrainEnabled = false;
+    planetSurfaceEnabled = false;
+    reverseDepth = reverseDepth && profile.clipControl;
+    // the GPU backends' bodies are read from storage buffers in the vertex shaders
+    if (!profile.vertexStorageBlocks) physicsBackend = BACKEND_CPU;
+    gpuBeltCount = std::min(gpuBeltCount, 100000);
+    galaxyStars = std::min(galaxyStars, 100000);
+    gasParams.count = std::min(gasParams.count, 20000u);
+    std::cout << "GLES " << profile.major << "." << profile.minor << " profile"
+              << (profile.baseInstance ? "" : ", base instances emulated")
+              << (profile.timerQueries ? "" : ", no GPU timers")
+              << (profile.vertexStorageBlocks ? "" : ", CPU physics only") << std::endl;
+    if (!profile.persistentMaps)
+        std::cout << "GL_EXT_buffer_storage is missing, the streaming buffers cannot be mapped" << std::endl;
+}
 
-        celestialBodies.emplace_back(pos, vel, currentAsteroidMass, currentAsteroidScale, rockModelPtr, nullptr, orientation, false, true, 2);
+// the scenes --benchmark knows, false for any other name
+bool applyBenchmarkScenario(const std::string& name) {
+    if (name == "planets") {
+        asteroidAmount = 0;
+    } else if (name == "belt") {
+        asteroidAmount = 20000;
+    } else if (name == "gpu-belt") {
+        asteroidAmount = 100000;
+        physicsBackend = BACKEND_GPU_COMPUTE;
+    } else if (name == "hybrid-belt") {
+        asteroidAmount = 1000000;
+        physicsBackend = BACKEND_HYBRID;
+    } else if (name == "galaxies") {
+        // the point-cloud target: ten million stars at 60 fps
+        galaxyScene = true;
+        galaxyStars = 10000000;
+        physicsBackend = BACKEND_GPU_COMPUTE;
+        pointCloudMode = true;
+    } else if (name == "visual-belt") {
+        asteroidAmount = 0;
+        gpuBeltEnabled = true;
+        gpuBeltCount = 1000000;
+    } else {
+        return false;
     }
+    return true;
 }
 
-void updatePhysics(float dt) {
-    if (pauseSimulation) return;
+void printUsage(const char* program) {
+    std::cout << "usage: " << program << " [options]\n"
+              << "  --benchmark <scenario>  fly a camera path for a fixed number of frames and write the frame times\n"
+              << "                          scenarios: planets, belt, gpu-belt, hybrid-belt, visual-belt, galaxies\n"
+              << "  --frames N              measured frames (default 1000)\n"
+              << "  --warmup N              frames before measuring (default 120)\n"
+              << "  --seed N                scenario seed of a benchmark or headless run (default 1)\n"
+              << "  --startup-report        the startup phases when everything is loaded: critical path, waits and the\n"
+              << "                          time parallel and async loading would save\n"
+              << "  --startup-trace FILE    that report, and the phases as Chrome trace JSON\n"
+              << "  --startup-target MS     the time to the first frame the report checks (default 1000)\n"
+              << "  --exit-after-startup    quit once startup is complete, exit 2 when the target was missed\n"
+              << "  --universe              star systems in a grid of cells around the home one, streamed in and out as the\n"
+              << "                          camera travels, the nearest simulated in full\n"
+              << "  --universe-cell N       the cells' size (default 2500)\n"
+              << "  --camera-path FILE      keys recorded with F7 instead of the built-in belt flythrough\n"
+              << "  --benchmark-out FILE    JSON report (default benchmark.json)\n"
+              << "  --save-baseline         store the frame times as this machine's baseline of the scenario\n"
+              << "  --compare               compare against that baseline, exit 2 on a significant slowdown\n"
+              << "  --baseline-dir DIR      where baselines are kept (default baselines)\n"
+              << "  --machine NAME          the baseline's machine (default: the host name)\n"
+              << "  --threshold X           relative slowdown below which nothing is flagged (default 0.03)\n"
+              << "  --telemetry FILE        per-frame metrics, CSV for a .csv file and JSON lines otherwise\n"
+              << "  --telemetry-udp H:P     the same as JSON lines, one UDP datagram each\n"
+              << "  --telemetry-rate HZ     samples per second, 0 for every frame (default 1)\n"
+              << "  --telemetry-max-mb N    rotate the file beyond N MB, keeping 4 old ones (default 16)\n"
+              << "  --resolution-scale S    draw the scene at S times the window's pixels, no dynamic scaling\n"
+              << "  --dynamic-resolution    scale with the GPU frame time in a benchmark too (on otherwise)\n"
+              << "  --gpu-target-ms MS      GPU frame time dynamic resolution holds (default 15)\n"
+              << "  --quality-governor      turn LODs, impostors, the shadow, MSAA, physics steps and trails down to hold the frame time\n"
+              << "  --frame-target-ms MS    CPU and GPU frame time the quality governor holds (default 15)\n"
+              << "  --aa MODE               anti-aliasing: none, msaa, fxaa, smaa or taa (default msaa)\n"
+              << "  --msaa N                samples of the scene target with --aa msaa (default 4)\n"
+              << "  --exposure X            scene exposure before tone mapping (default 1)\n"
+              << "  --galaxies N            two colliding galaxies of N stars in all, on the GPU backend as points\n"
+              << "  --gas N                 a gas disk of N smoothed particles around the sun, on the GPU with any backend\n"
+              << "  --density-map           GPU backend belt bodies as a density heat map on the ecliptic instead of rocks\n"
+              << "  --atmospheres           the planets' atmospheres from precomputed scattering tables\n"
+              << "  --scenario FILE         bodies and generators from a scenario file instead of the built-in sun, planet and belt\n"
+              << "  --ephemeris FILE        the sun and planets from a Chebyshev ephemeris (nbody_headless --write-ephemeris), CPU physics\n"
+              << "  --planet-surface IMAGE  colour the planet's terrain from a large equirectangular image (or its cooked .vt),\n"
+              << "                          streamed as a virtual texture; cooked to IMAGE.vt on first use\n"
+              << "  --surface-cache N       pages per side of the virtual texture's cache, 128 texels each (default 24)\n"
+              << "  --star-catalog FILE     draw the sky from a binary star catalog instead of the cubemap; a missing FILE\n"
+              << "                          gets a synthetic catalog written to it\n"
+              << "  --catalog-stars N       stars of a synthetic catalog (default 300000)\n"
+              << "  --video FILE            record a video of the run, through ffmpeg for .mp4/.mkv/.mov/.webm, raw BGRA otherwise\n"
+              << "  --video-fps N           frame rate the video is encoded at (default 60)\n"
+              << "  --headless              no window, render through EGL into --video, --frames N frames (or until SIGINT)\n"
+              << "  --gpu N                 the EGL device a headless run renders on (default: the display, else device 0)\n"
+              << "  --size WxH              a headless run's resolution (default 1920x1080)\n"
+              << "  --rock-variants N       asteroid shapes and textures, 1 to 16 (default 4)\n"
+              << "  --procedural-rocks      every asteroid its own shape: an icosphere displaced by per-rock noise\n"
+              << "  --rock-relief F         how far the noise moves a procedural rock's surface, of its radius (default 0.3)\n"
+              << "  --connect HOST[:PORT]   draw the bodies nbody_headless --serve simulates (port 47800 by default)\n"
+              << "  --present MODE          vsync, adaptive or uncapped (default vsync, a benchmark is uncapped)\n"
+              << "  --fps-limit N           start frames at most N times a second, 0 for no limit (default 0)\n"
+              << "  --frames-in-flight N    frames the CPU may queue ahead of the GPU, 1 to 4, 0 for no cap (default 2)\n"
+              << "  --on-demand             redraw only on input or change, the last frame stays up while paused and still\n"
+              << "  --render-thread         build and submit frames on a thread of their own, the main one only handles window events\n"
+              << "  --gles                  an OpenGL ES 3.2 (or 3.1) context and the reduced-feature profile for low-end devices\n"
+              << "  --track-allocations     count heap allocations, bytes and peaks by subsystem, in the overlay and the telemetry\n"
+              << "  --no-bloom              no bloom around the sun\n"
+              << "  --overdraw              show the scene's overdraw as a heat map instead of the frame\n"
+              << "  --pipeline-statistics   count vertices, primitives and fragments per GPU pass, in the overlay and the report\n"
+              << "  --standard-depth        GL's depth convention with a far plane and 24-bit depth instead of reverse-Z\n"
+              << "  --no-picking            no id buffer, clicking selects nothing\n"
+              << "  --variable-rate-shading dark, flat tiles and the periphery shaded at lower rates (GL_NV_shading_rate_image)\n"
+              << "  --stereo                side-by-side stereo, the rocks of both eyes drawn in one pass\n"
+              << "  --outputs N             N more windows continuing the view to either side, one per projector (default 0)\n"
+              << "  --texture-budget MB     model textures resident only down to the mip level they are seen at, within MB (not with bindless textures)\n"
+              << "  --assets PATH           models, textures and shaders from an archive made by pack_assets, loose files for the rest\n"
+              << "  --soft-shadows          the sun's shadow filtered from blurred variance moments\n"
+              << "  --reflections           the planet reflects a dynamic environment probe (forward shading)\n"
+              << "  --reflection-faces N    probe faces redrawn per frame, 0 to 6 (default 1)\n"
+              << "  --reflection-size N     probe face resolution (default 128)\n"
+              << "  --deferred, --no-culling, --occlusion-culling, --depth-prepass, --no-shadows, --sphere-impostors,\n"
+              << "  --tessellated-spheres, --no-position-streams, --no-front-to-back\n"
+              << "                          renderer settings to benchmark with" << std::endl;
+}
 
-    dt *= simulationSpeed;
-    if (dt == 0.0f) return;
+// -1 to run, otherwise the exit code
+int parseArguments(int argc, char** argv) {
+    bool forceDynamicResolution = false;
+    for (int a = 1; a < argc; a++) {
+        std::string arg = argv[a];
+        bool hasValue = a + 1 < argc;
+        const char* value = hasValue ? argv[a + 1] : "";
+        if (arg == "--help" || arg == "-h") { printUsage(argv[0]); return 0; }
+        else if (arg == "--deferred") deferredShading = true;
+        else if (arg == "--no-culling") frustumCulling = false;
+        else if (arg == "--occlusion-culling") occlusionCulling = true;
+        else if (arg == "--no-front-to-back") frontToBackRocks = false;
+        else if (arg == "--depth-prepass") depthPrepass = true;
+        else if (arg == "--no-position-streams") positionStreams = false;
+        else if (arg == "--sphere-impostors") sphereImpostors = true;
+        else if (arg == "--tessellated-spheres") tessellatedSpheres = true;
+        else if (arg == "--on-demand") onDemandRendering = true;
+        else if (arg == "--render-thread") renderThread = true;
+        else if (arg == "--gles") renderProfile().useGles();
+        else if (arg == "--track-allocations") trackAllocations = true;
+        else if (arg == "--density-map") densityMapMode = true;
+        else if (arg == "--atmospheres") planetAtmospheres = true;
+        else if (arg == "--no-shadows") sunShadows = false;
+        else if (arg == "--soft-shadows") softSunShadows = true;
+        else if (arg == "--quality-governor") qualityGovernor.enabled = true;
+        else if (arg == "--no-bloom") sceneBloom = false;
+        else if (arg == "--overdraw") overdrawView = true;
+        else if (arg == "--pipeline-statistics") pipelineStatistics = true;
+        else if (arg == "--standard-depth") reverseDepth = false;
+        else if (arg == "--reflections") planetReflections = true;
+        else if (arg == "--no-picking") gpuPicking = false;
+        else if (arg == "--variable-rate-shading") variableRateShading = true;
+        else if (arg == "--stereo") stereoCamera.enabled = true;
+        else if (arg == "--headless") headless.active = true;
+        else if (arg == "--dynamic-resolution") forceDynamicResolution = true;
+        else if (arg == "--save-baseline") benchmark.saveBaseline = true;
+        else if (arg == "--compare") benchmark.compare = true;
+        else if (arg == "--startup-report") startupOptions.report = true;
+        else if (arg == "--exit-after-startup") startupOptions.exitAfter = startupOptions.report = true;
+        else if (arg == "--universe") universeEnabled = true;
+        else if (arg == "--procedural-rocks") proceduralRocks = true;
+        else if (!hasValue) { std::cerr << "missing value for " << arg << std::endl; return 1; }
+        else {
+            a++;
+            if (arg == "--benchmark") {
+                benchmark.active = true;
+                benchmark.scenario = value;
+                if (!applyBenchmarkScenario(benchmark.scenario)) { std::cerr << "unknown scenario " << value << std::endl; printUsage(argv[0]); return 1; }
+            }
+            else if (arg == "--frames") {
+                benchmark.frames = std::max(1u, static_cast<unsigned int>(std::strtoul(value, nullptr, 10)));
+                headless.frames = benchmark.frames;
+            }
+            else if (arg == "--warmup") benchmark.warmup = static_cast<unsigned int>(std::strtoul(value, nullptr, 10));
+            else if (arg == "--seed") benchmark.seed = static_cast<unsigned int>(std::strtoul(value, nullptr, 10));
+            else if (arg == "--camera-path") benchmark.cameraPath = value;
+            else if (arg == "--benchmark-out") benchmark.outPath = value;
+            else if (arg == "--startup-trace") startupOptions.tracePath = value;
+            else if (arg == "--startup-target") startupOptions.targetMs = std::max(0.0, std::atof(value));
+            else if (arg == "--universe-cell") universeCellSize = std::max(500.0, std::atof(value));
+            else if (arg == "--baseline-dir") benchmark.baselineDir = value;
+            else if (arg == "--telemetry") telemetryOptions.path = value;
+            else if (arg == "--telemetry-udp") telemetryOptions.udp = value;
+            else if (arg == "--telemetry-rate") telemetryOptions.rate = std::max(0.0, std::atof(value));
+            else if (arg == "--telemetry-max-mb") telemetryOptions.maxFileBytes = std::max<size_t>(1, std::strtoul(value, nullptr, 10)) << 20;
+            else if (arg == "--machine") benchmark.machine = value;
+            else if (arg == "--threshold") benchmark.compareOptions.threshold = std::max(0.0, std::atof(value));
+            else if (arg == "--resolution-scale") {
+                dynamicResolution.enabled = false;
+                dynamicResolution.setScale(static_cast<float>(std::atof(value)));
+            }
+            else if (arg == "--gpu-target-ms") dynamicResolution.targetMs = std::max(1.0f, static_cast<float>(std::atof(value)));
+            else if (arg == "--frame-target-ms") qualityGovernor.targetMs = std::max(1.0f, static_cast<float>(std::atof(value)));
+            else if (arg == "--video") {
+                videoPath = value;
+                videoFromStart = true;
+            }
+            else if (arg == "--video-fps") videoFps = std::max(1, std::atoi(value));
+            else if (arg == "--gpu") headless.device = std::atoi(value);
+            else if (arg == "--connect") remoteAddress = value;
+            else if (arg == "--fps-limit") framePacer.fpsLimit = std::max(0.0, std::atof(value));
+            else if (arg == "--frames-in-flight") framePacer.framesInFlight = static_cast<unsigned int>(std::clamp(std::atoi(value), 0, static_cast<int>(FramePacer::MAX_FRAMES_IN_FLIGHT)));
+            else if (arg == "--present") {
+                int mode = 0;
+                while (mode < PRESENT_MODES && std::string(value) != presentModeName(static_cast<PresentMode>(mode))) mode++;
+                if (mode == PRESENT_MODES) { std::cerr << "unknown present mode " << value << std::endl; printUsage(argv[0]); return 1; }
+                presentMode = static_cast<PresentMode>(mode);
+            }
+            else if (arg == "--outputs") outputWindowCount = static_cast<unsigned int>(std::clamp(std::atoi(value), 0, 8));
+            else if (arg == "--texture-budget") textureBudgetMB = static_cast<unsigned int>(std::max(std::atoi(value), 0));
+            else if (arg == "--assets") {
+                // before anything loads, every loader looks in it first
+                if (!assetArchive().mount(value)) {
+                    std::cerr << "cannot mount asset archive " << value << std::endl;
+                    return 1;
+                }
+            }
+            else if (arg == "--rock-relief") rockRelief = std::clamp(static_cast<float>(std::atof(value)), 0.0f, 0.8f);
+            else if (arg == "--rock-variants") rockVariantCount = static_cast<unsigned int>(std::clamp(std::atoi(value), 1, static_cast<int>(MAX_ROCK_VARIANTS)));
+            else if (arg == "--size") {
+                if (std::sscanf(value, "%dx%d", &headless.width, &headless.height) != 2 || headless.width <= 0 || headless.height <= 0) {
+                    std::cerr << "bad size " << value << ", expected WxH" << std::endl;
+                    return 1;
+                }
+            }
+            else if (arg == "--gas") {
+                gasEnabled = true;
+                gasParams.count = static_cast<unsigned int>(std::max(0, std::atoi(value)));
+            }
+            else if (arg == "--galaxies") {
+                galaxyScene = true;
+                galaxyStars = std::max(0, std::atoi(value));
+                physicsBackend = BACKEND_GPU_COMPUTE;
+                pointCloudMode = true;
+            }
+            else if (arg == "--scenario") {
+                std::string error;
+                if (!scenarioFile.load(value, error)) {
+                    std::cerr << error << std::endl;
+                    return 1;
+                }
+                scenarioPath = value;
+            }
+            else if (arg == "--ephemeris") {
+                if (!physics.loadEphemeris(value)) {
+                    std::cerr << "cannot load ephemeris " << value << std::endl;
+                    return 1;
+                }
+            }
+            else if (arg == "--planet-surface") planetSurfacePath = value;
+            else if (arg == "--surface-cache") planetSurfaceCachePages = static_cast<unsigned int>(std::clamp(std::atoi(value), 2, 255));
+            else if (arg == "--star-catalog") starCatalogPath = value;
+            else if (arg == "--catalog-stars") syntheticStars = static_cast<unsigned int>(std::max(1, std::atoi(value)));
+            else if (arg == "--exposure") sceneExposure = std::max(0.01f, static_cast<float>(std::atof(value)));
+            else if (arg == "--reflection-faces") reflectionFacesPerFrame = static_cast<unsigned int>(std::clamp(std::atoi(value), 0, 6));
+            else if (arg == "--reflection-size") reflectionProbeSize = static_cast<unsigned int>(std::max(8, std::atoi(value)));
+            else if (arg == "--msaa") sceneSamples = std::max(1, std::atoi(value));
+            else if (arg == "--aa") {
+                int mode = 0;
+                while (mode < AA_MODES && std::string(value) != antiAliasingName(static_cast<AntiAliasing>(mode))) mode++;
+                if (mode == AA_MODES) { std::cerr << "unknown anti-aliasing " << value << std::endl; printUsage(argv[0]); return 1; }
+                antiAliasing = static_cast<AntiAliasing>(mode);
+            }
+            else { std::cerr << "unknown option " << arg << std::endl; printUsage(argv[0]); return 1; }
+        }
+    }
+    // the output windows are closed on the frame thread, which GLFW only allows on the main one
+    if (renderThread && (headless.active || outputWindowCount > 0)) {
+        std::cerr << "--render-thread needs a window of its own, not with --headless or --outputs" << std::endl;
+        return 1;
+    }
+    // the headless EGL context is always desktop GL
+    if (renderProfile().es() && headless.active) {
+        std::cerr << "--gles asks for the window's context, not with --headless" << std::endl;
+        return 1;
+    }
+    if ((!telemetryOptions.path.empty() || !telemetryOptions.udp.empty()) && !telemetry.start(telemetryOptions)) {
+        std::cerr << telemetry.error() << std::endl;
+        return 1;
+    }
+    if (!benchmark.active) return -1;
+    // the same pixels every run unless asked otherwise
+    if (!forceDynamicResolution) dynamicResolution.enabled = false;
+    if (benchmark.cameraPath.empty()) {
+        benchmark.path = CameraPath::beltFlythrough(asteroidBeltInnerRadius, asteroidBeltOuterRadius, asteroidBeltHeight);
+    } else if (!benchmark.path.load(benchmark.cameraPath) || benchmark.path.empty()) {
+        std::cerr << "cannot read camera path " << benchmark.cameraPath << std::endl;
+        return 1;
+    }
+    return -1;
+}
 
-    for (size_t i = 0; i < celestialBodies.size(); ++i) {
-        if (celestialBodies[i].isStatic) continue;
+// bytes of asteroid instances the CPU paths wrote for the frame
+double instanceUploadBytes() {
+    if (bodiesOnGpu()) return 0.0;
+    return asteroidInstancesPacked * (instanceStreamQuantized ? sizeof(QuantizedInstance) + sizeof(InstanceChunk) / double(INSTANCE_CHUNK)
+                                                              : sizeof(AsteroidInstance));
+}
 
-        for (size_t j = 0; j < celestialBodies.size(); ++j) {
-            if (i == j) continue;
-            if (celestialBodies[i].isAsteroid && celestialBodies[j].isAsteroid) continue;
+// the frame's numbers to the telemetry writer when a sample is due
+void submitTelemetry(float wallFrameMs, bool gpuCulled) {
+    const size_t streamed = textureCache().streamedBytes();
+    const size_t textureUpload = streamed - telemetryStreamedBytes;
+    telemetryStreamedBytes = streamed;
+    telemetryFrame++;
+    const double now = clockSeconds();
+    if (!telemetry.due(now)) return;
+    TelemetrySample sample;
+    sample.time = now;
+    sample.frame = telemetryFrame;
+    sample.frameMs = wallFrameMs;
+    sample.cpuFrameMs = cpuFrameHistory.latest();
+    sample.gpuFrameMs = gpuTimers->frameHistory().latest();
+    sample.physicsMs = cpuPhysicsHistory.latest();
+    sample.bodies = static_cast<unsigned int>(asyncPhysics.running() ? asyncPhysics.latest().id.size() : physics.bodies.size());
+    sample.visibleInstances = gpuCulled ? -1 : static_cast<long long>(asteroidInstancesPacked);
+    sample.drawCalls = static_cast<unsigned int>(renderQueue.size() - renderQueue.mergedCount());
+    sample.gpuMemoryBytes = static_cast<unsigned long long>(gpuMemory().totalBytes());
+    sample.driverFreeMemoryKB = gpuMemory().driver().availableKB;
+    sample.uploadBytes = static_cast<unsigned long long>(instanceUploadBytes()) + textureUpload;
+    sample.heapAllocations = heapAllocationsLastFrame;
+    if (allocTracker().isEnabled()) {
+        sample.heapBytes = static_cast<long long>(allocTracker().lastFrameTotal().bytes);
+        sample.heapPeakBytes = allocTracker().lastFrameTotal().peakBytes;
+        for (unsigned int t = 0; t < ALLOC_TAGS; t++)
+            sample.heapTagAllocations[t] = static_cast<long long>(allocTracker().lastFrame(static_cast<AllocTag>(t)).allocations);
+    }
+    telemetry.submit(sample);
+}
 
-            glm::vec3 r_vec = celestialBodies[j].position - celestialBodies[i].position;
-            float r_mag_sq = glm::dot(r_vec, r_vec);
-            
-            const float epsilon_sq = 1e-4f; // Softening factor squared
-            if (r_mag_sq < epsilon_sq) {
-                 r_mag_sq = epsilon_sq;
-            }
-            
-            float r_mag = sqrt(r_mag_sq);
-            glm::vec3 r_hat = (r_mag > 0.0f) ? (r_vec / r_mag) : glm::vec3(0.0f);
+// a frame's GPU times once GpuTimers has read them back, LATENCY frames after it was drawn, so the warm-up's are
+// still arriving for a few measured frames
+void collectBenchmarkGpu() {
+    if (gpuTimers->collectedFrames() == benchmark.gpuCollected) return;
+    benchmark.gpuCollected = gpuTimers->collectedFrames();
+    if (benchmark.frame < benchmark.warmup + GpuTimers::LATENCY) return;
+    benchmark.gpuFrameMs.push(gpuTimers->frameHistory().latest());
+    benchmark.passMs.resize(gpuTimers->scopeCount());
+    for (unsigned int s = 0; s < gpuTimers->scopeCount(); s++)
+        benchmark.passMs[s].push(gpuTimers->history(s).latest());
+}
 
-            float force_mag = (G_scaled * celestialBodies[i].mass * celestialBodies[j].mass) / r_mag_sq;
-            glm::vec3 force_vec = force_mag * r_hat;
+// reads back the frames still in flight and writes the report
+// the first frame with nothing left streaming in: the report, the trace and the exit of --exit-after-startup
+void finishStartup(GLFWwindow* window) {
+    if (!startupOptions.report && startupOptions.tracePath.empty()) return;
+    startupTrace().report(std::cout, startupOptions.targetMs);
+    if (!startupOptions.tracePath.empty()) {
+        if (startupTrace().writeTrace(startupOptions.tracePath)) std::cout << "wrote the startup trace to " << startupOptions.tracePath << std::endl;
+        else std::cout << "cannot write " << startupOptions.tracePath << std::endl;
+    }
+    if (startupOptions.exitAfter) {
+        startupOptions.missed = startupOptions.targetMs > 0.0 && startupTrace().readyMs() > startupOptions.targetMs;
+        if (window) glfwSetWindowShouldClose(window, true);
+        else stopRequested = 1;
+    }
+}
 
-            celestialBodies[i].applyForce(force_vec);
-        }
+void finishBenchmark(GLFWwindow* window) {
+    glFinish();
+    for (unsigned int i = 0; i < GpuTimers::LATENCY; i++) {
+        gpuTimers->beginFrame();
+        collectBenchmarkGpu();
+        gpuTimers->endFrame();
+    }
+    int width = 0, height = 0;
+    framebufferSize(window, width, height);
+    BenchmarkReport report;
+    report.text("scenario", benchmark.scenario);
+    report.text("cameraPath", benchmark.cameraPath.empty() ? "belt flythrough" : benchmark.cameraPath);
+    report.number("frames", benchmark.frames);
+    report.number("warmupFrames", benchmark.warmup);
+    report.number("seed", scenarioSeed);
+    report.number("width", width);
+    report.number("height", height);
+    report.number("asteroids", asteroidAmount);
+    report.number("visualBeltRocks", gpuBeltEnabled ? gpuBelt->rockCount() : 0);
+    report.number("gasParticles", gasDisk ? gasDisk->particleCount() : 0);
+    report.text("physicsBackend", physicsBackend == BACKEND_HYBRID ? "hybrid" : bodiesOnGpu() ? "gpu" : "cpu");
+    report.text("renderProfile", renderProfile().name());
+    report.flag("frustumCulling", frustumCulling);
+    report.flag("occlusionCulling", occlusionCulling);
+    report.flag("sphereImpostors", sphereImpostors);
+    report.flag("depthPrepass", depthPrepass);
+    report.flag("positionStreams", positionStreams);
+    report.flag("variableRateShading", variableRateShading && shadingRatesAvailable);
+    report.flag("deferredShading", deferredShading);
+    report.flag("stereo", stereoCamera.enabled && outputWindows.panels() == 1);
+    report.number("outputPanels", outputWindows.panels());
+    report.flag("sunShadows", sunShadows);
+    report.flag("softSunShadows", sunShadows && softSunShadows);
+    report.flag("reflections", planetReflections);
+    report.number("reflectionFacesPerFrame", planetReflections ? reflectionFacesPerFrame : 0);
+    report.flag("gpuPicking", gpuPicking);
+    report.flag("asteroidImpostors", asteroidImpostors);
+    report.flag("dynamicResolution", dynamicResolution.enabled);
+    report.flag("qualityGovernor", qualityGovernor.enabled);
+    report.number("resolutionScale", dynamicResolution.scale);
+    report.text("antiAliasing", antiAliasingName(antiAliasing));
+    report.number("exposure", sceneExposure);
+    report.number("bloom", sceneBloom ? 1 : 0);
+    report.flag("overdraw", sceneTarget->overdrawView);
+    report.flag("pipelineStatistics", gpuTimers->statistics);
+    // the asteroids' counts per frame, where a regression in their pass shows first
+    if (gpuTimers->statistics) {
+        static const char* keys[GpuTimers::STATISTICS] = {"asteroidVertices", "asteroidPrimitives", "asteroidClipIn",
+                                                          "asteroidClipOut", "asteroidFragments"};
+        for (unsigned int s = 0; s < GpuTimers::STATISTICS; s++)
+            report.number(keys[s], gpuTimers->statisticHistory(passTimers.asteroids, s).average());
     }
+    report.number("msaaSamples", antiAliasing == AA_MSAA ? sceneSamples : 1);
+    report.number("droppedGpuFrames", gpuTimers->droppedFrames());
+    report.series.emplace_back("frameMs", &benchmark.frameMs);
+    report.series.emplace_back("cpuFrameMs", &benchmark.cpuFrameMs);
+    report.series.emplace_back("gpuFrameMs", &benchmark.gpuFrameMs);
+    report.series.emplace_back("physicsMs", &benchmark.physicsMs);
+    report.series.emplace_back("uploadMs", &benchmark.uploadMs);
+    report.series.emplace_back("uiMs", &benchmark.uiMs);
+    for (unsigned int s = 0; s < benchmark.passMs.size(); s++)
+        report.gpuPasses.emplace_back(gpuTimers->name(s), &benchmark.passMs[s]);
+    if (!report.write(benchmark.outPath)) {
+        std::cerr << "cannot write " << benchmark.outPath << std::endl;
+        return;
+    }
+    const FrameSeries::Summary frame = benchmark.frameMs.summary();
+    std::cout << std::fixed << std::setprecision(3) << benchmark.scenario << ": " << frame.count << " frames, avg " << frame.mean
+              << " ms, p50 " << frame.p50 << " ms, p95 " << frame.p95 << " ms, p99 " << frame.p99 << " ms\n"
+              << "wrote " << benchmark.outPath << std::endl;
 
-    unsigned int asteroidInstanceIdx = 0;
-    for (size_t i = 0; i < celestialBodies.size(); ++i) {
-        celestialBodies[i].update(dt);
-        if (celestialBodies[i].isAsteroid && asteroidInstanceIdx < asteroidAmount) {
-            asteroidModelMatrices[asteroidInstanceIdx] = celestialBodies[i].modelMatrix;
-            asteroidNormalMatrices[asteroidInstanceIdx] = glm::transpose(glm::inverse(glm::mat3(celestialBodies[i].modelMatrix)));
-            asteroidInstanceIdx++;
+    if (!benchmark.saveBaseline && !benchmark.compare) return;
+    // totals under their own names, the parts as cpu/ and gpu/ so a slower frame is pinned on the stage or pass
+    PerfSamples samples;
+    auto addSeries = [&samples](const std::string& name, const FrameSeries& series) {
+        samples.add(name, std::vector<double>(series.values().begin(), series.values().end()));
+    };
+    addSeries("frameMs", benchmark.frameMs);
+    addSeries("cpuFrameMs", benchmark.cpuFrameMs);
+    addSeries("gpuFrameMs", benchmark.gpuFrameMs);
+    addSeries("cpu/physics", benchmark.physicsMs);
+    addSeries("cpu/upload", benchmark.uploadMs);
+    addSeries("cpu/ui", benchmark.uiMs);
+    for (unsigned int s = 0; s < benchmark.passMs.size(); s++)
+        addSeries(std::string("gpu/") + gpuTimers->name(s), benchmark.passMs[s]);
+    const std::string machine = benchmark.machine.empty() ? perfMachineName() : benchmark.machine;
+    const std::string baselinePath = perfBaselinePath(benchmark.baselineDir, machine, "benchmark-" + benchmark.scenario);
+    if (benchmark.compare) {
+        PerfSamples baseline;
+        if (baseline.load(baselinePath)) {
+            std::cout << "against " << baselinePath << ":\n";
+            benchmark.regressions = printPerfComparison(std::cout, comparePerf(baseline, samples, benchmark.compareOptions), "ms", "frameMs");
+        } else {
+            std::cerr << "no baseline at " << baselinePath << std::endl;
         }
     }
-    
-    if (asteroidAmount > 0 && asteroidInstanceIdx > 0 && asteroidInstanceVBO != 0 && asteroidNormalInstanceVBO != 0) {
-        glBindBuffer(GL_ARRAY_BUFFER, asteroidInstanceVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, asteroidInstanceIdx * sizeof(glm::mat4), asteroidModelMatrices);
-        glBindBuffer(GL_ARRAY_BUFFER, asteroidNormalInstanceVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, asteroidInstanceIdx * sizeof(glm::mat3), asteroidNormalMatrices);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    if (benchmark.saveBaseline) {
+        if (samples.save(baselinePath)) std::cout << "saved " << baselinePath << std::endl;
+        else std::cerr << "cannot write " << baselinePath << std::endl;
     }
 }
 
-void setupAsteroidInstanceBuffers() {
-    if (asteroidInstanceVBO != 0) { glDeleteBuffers(1, &asteroidInstanceVBO); asteroidInstanceVBO = 0; }
-    if (asteroidNormalInstanceVBO != 0) { glDeleteBuffers(1, &asteroidNormalInstanceVBO); asteroidNormalInstanceVBO = 0; }
-    
-    if (asteroidAmount == 0 || !rockModelPtr) return;
-
-    glGenBuffers(1, &asteroidInstanceVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, asteroidInstanceVBO);
-    glBufferData(GL_ARRAY_BUFFER, asteroidAmount * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
-
-    glGenBuffers(1, &asteroidNormalInstanceVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, asteroidNormalInstanceVBO);
-    glBufferData(GL_ARRAY_BUFFER, asteroidAmount * sizeof(glm::mat3), nullptr, GL_DYNAMIC_DRAW);
-
-    for (unsigned int i = 0; i < rockModelPtr->meshes.size(); i++) {
-        unsigned int VAO = rockModelPtr->meshes[i].VAO;
-        glBindVertexArray(VAO);
-
-        glBindBuffer(GL_ARRAY_BUFFER, asteroidInstanceVBO);
-        glEnableVertexAttribArray(3); glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)0);
-        glEnableVertexAttribArray(4); glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(sizeof(glm::vec4)));
-        glEnableVertexAttribArray(5); glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(2 * sizeof(glm::vec4)));
-        glEnableVertexAttribArray(6); glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(3 * sizeof(glm::vec4)));
-        glVertexAttribDivisor(3, 1); glVertexAttribDivisor(4, 1); glVertexAttribDivisor(5, 1); glVertexAttribDivisor(6, 1);
-
-        glBindBuffer(GL_ARRAY_BUFFER, asteroidNormalInstanceVBO);
-        glEnableVertexAttribArray(7); glVertexAttribPointer(7, 3, GL_FLOAT, GL_FALSE, sizeof(glm::mat3), (void*)0);
-        glEnableVertexAttribArray(8); glVertexAttribPointer(8, 3, GL_FLOAT, GL_FALSE, sizeof(glm::mat3), (void*)(sizeof(glm::vec3)));
-        glEnableVertexAttribArray(9); glVertexAttribPointer(9, 3, GL_FLOAT, GL_FALSE, sizeof(glm::mat3), (void*)(2 * sizeof(glm::vec3)));
-        glVertexAttribDivisor(7, 1); glVertexAttribDivisor(8, 1); glVertexAttribDivisor(9, 1);
-        
-        glBindVertexArray(0);
+void loadSnapshot() {
+    PROFILE_FUNCTION();
+    bool wasAsync = asyncPhysics.running();
+    if (wasAsync) asyncPhysics.stop(physics);
+    double start = clockSeconds();
+    if (physics.loadSnapshot(snapshotPath, sphereMesh, planetModelPtr, rockModelPtr)) {
+        char status[128];
+        std::snprintf(status, sizeof(status), "loaded %zu bodies in %.1f ms", physics.bodies.size(), (clockSeconds() - start) * 1000.0);
+        snapshotStatus = status;
+        asteroidAmount = static_cast<unsigned int>(physics.bodies.count(BODY_ASTEROID));
+        setupAsteroidInstanceBuffers();
+        previousPositions.clear();
+        physicsAccumulator = 0.0f;
+        renderAlpha = 1.0f;
+        updateAsteroidInstances();
+        if (bodiesOnGpu() && gpuNBody) uploadGpuBodies();
+    } else {
+        snapshotStatus = "cannot load " + std::string(snapshotPath);
     }
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    if (wasAsync) asyncPhysics.start(physics);
 }
 
-void resetSimulation() {
-    initializeCelestialBodies();
-    setupAsteroidInstanceBuffers();
+// a rolling history as a histogram, oldest sample on the left
+void plotHistory(const char* label, const TimeHistory& history, const char* unit) {
+    char overlay[64];
+    std::snprintf(overlay, sizeof(overlay), "%.2f %s (avg %.2f, peak %.2f)", history.latest(), unit, history.average(), history.peak());
+    ImGui::PlotHistogram(label, history.samples, static_cast<int>(TimeHistory::SAMPLES), static_cast<int>(history.next),
+                         overlay, 0.0f, std::max(history.peak() * 1.2f, 1e-3f), ImVec2(0.0f, 50.0f));
+}
+
+// where the frame's time goes: GPU time per pass next to the CPU's, and which side the frame waits on
+void drawPerformanceOverlay() {
+    ImGui::SetNextWindowBgAlpha(0.8f);
+    if (!ImGui::Begin("Performance", &showPerformanceOverlay)) {
+        ImGui::End();
+        return;
+    }
+    const TimeHistory& gpuFrame = gpuTimers->frameHistory();
+    const float gpuMs = gpuFrame.average();
+    const float cpuMs = cpuFrameHistory.average();
+    // the slower side sets the frame rate, the other one idles behind it
+    ImGui::Text("%s: GPU %.2f ms, CPU %.2f ms per frame", gpuMs > cpuMs ? "GPU-bound" : "CPU-bound", gpuMs, cpuMs);
+    ImGui::Text("Draws: %zu queued packets, %.0f primitives", renderQueue.size(), gpuTimers->primitiveHistory().latest());
+    if (renderQueue.mergedCount() > 0)
+        ImGui::Text("Instanced by the queue: %zu packets into %zu draws", renderQueue.mergedCount() + renderQueue.instancedDrawCount(),
+                    renderQueue.instancedDrawCount());
+    ImGui::Text("Scene: %d x %d, %.0f%% of the window%s", sceneTarget->width(), sceneTarget->height(), dynamicResolution.scale * 100.0f,
+                dynamicResolution.enabled ? " (dynamic)" : "");
+    if (gpuTimers->droppedFrames() > 0)
+        ImGui::Text("GPU results not ready in time: %u frames", gpuTimers->droppedFrames());
+    if (qualityGovernor.enabled) {
+        const QualityGovernor::Ladder& gpuLadder = qualityGovernor.gpuLadder();
+        const QualityGovernor::Ladder& cpuLadder = qualityGovernor.cpuLadder();
+        const QualitySettings& quality = qualityGovernor.settings();
+        ImGui::Text("Governor: GPU level %u (%s), CPU level %u (%s)", gpuLadder.level, QualityGovernor::gpuLevelName(gpuLadder.level),
+                    cpuLadder.level, QualityGovernor::cpuLevelName(cpuLadder.level));
+        ImGui::Text("  LOD x%.2f, impostors at %.0f, shadow %u every %u, MSAA %d, steps %d, trails %d", quality.lodPixelScale,
+                    effectiveImpostorDistance, sunShadow->resolution(), quality.shadowInterval, sceneTarget->samples(), physicsStepCap(),
+                    static_cast<int>(trailLength * quality.trailLengthScale));
+    }
+    plotHistory("GPU frame", gpuFrame, "ms");
+    plotHistory("CPU frame", cpuFrameHistory, "ms");
+
+    if (ImGui::CollapsingHeader("GPU Passes", ImGuiTreeNodeFlags_DefaultOpen)) {
+        for (unsigned int i = 0; i < gpuTimers->scopeCount(); i++)
+            ImGui::Text("%-18s %7.3f ms (peak %.3f)", gpuTimers->name(i), gpuTimers->history(i).average(), gpuTimers->history(i).peak());
+    }
+    if (ImGui::CollapsingHeader("CPU Work", ImGuiTreeNodeFlags_DefaultOpen)) {
+        plotHistory("physics", cpuPhysicsHistory, "ms");
+        plotHistory("upload", cpuUploadHistory, "ms");
+        plotHistory("UI build", cpuUiHistory, "ms");
+    }
+    if (ImGui::CollapsingHeader("Primitives"))
+        plotHistory("primitives", gpuTimers->primitiveHistory(), "");
+    // what each pass asked of the pipeline, in thousands per frame; fragments per pixel is the pass's overdraw
+    if (!renderProfile().es() && ImGui::CollapsingHeader("Pipeline Statistics")) {
+        ImGui::Checkbox("Count per pass", &gpuTimers->statistics);
+        const double pixels = std::max(1.0, static_cast<double>(sceneTarget->width()) * sceneTarget->height());
+        if (gpuTimers->statistics && ImGui::BeginTable("statistics", GpuTimers::STATISTICS + 2, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            ImGui::TableSetupColumn("pass");
+            for (unsigned int s = 0; s < GpuTimers::STATISTICS; s++)
+                ImGui::TableSetupColumn(GpuTimers::statisticName(s));
+            ImGui::TableSetupColumn("frag/px");
+            ImGui::TableHeadersRow();
+            for (unsigned int i = 0; i < gpuTimers->scopeCount(); i++) {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn(); ImGui::Text("%s", gpuTimers->name(i));
+                for (unsigned int s = 0; s < GpuTimers::STATISTICS; s++) {
+                    ImGui::TableNextColumn(); ImGui::Text("%.1fk", gpuTimers->statisticHistory(i, s).average() * 1e-3f);
+                }
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2f", gpuTimers->statisticHistory(i, GpuTimers::FRAGMENT_INVOCATIONS).average() / pixels);
+            }
+            ImGui::EndTable();
+            plotHistory("asteroid fragments", gpuTimers->statisticHistory(passTimers.asteroids, GpuTimers::FRAGMENT_INVOCATIONS), "");
+            plotHistory("asteroid vertices", gpuTimers->statisticHistory(passTimers.asteroids, GpuTimers::VERTEX_INVOCATIONS), "");
+        }
+    }
+    // operator new and ImGui's allocations of the last frame, by the subsystem that asked; the goal is none at all
+    if (ImGui::CollapsingHeader("Heap")) {
+        ImGui::Text("Allocations last frame: %llu", heapAllocationsLastFrame);
+        if (!allocTracker().isEnabled()) {
+            ImGui::TextDisabled("By subsystem with --track-allocations");
+        } else if (ImGui::BeginTable("heap", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            const double KB = 1024.0;
+            ImGui::TableSetupColumn("subsystem");
+            ImGui::TableSetupColumn("allocs/frame");
+            ImGui::TableSetupColumn("KB/frame");
+            ImGui::TableSetupColumn("frame peak KB");
+            ImGui::TableSetupColumn("peak KB");
+            ImGui::TableHeadersRow();
+            for (unsigned int t = 0; t < ALLOC_TAGS; t++) {
+                const AllocTag tag = static_cast<AllocTag>(t);
+                const AllocTracker::Counts& frame = allocTracker().lastFrame(tag);
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn(); ImGui::Text("%s", AllocTracker::name(tag));
+                ImGui::TableNextColumn(); ImGui::Text("%llu", frame.allocations);
+                ImGui::TableNextColumn(); ImGui::Text("%.1f", frame.bytes / KB);
+                ImGui::TableNextColumn(); ImGui::Text("%.1f", frame.peakBytes / KB);
+                ImGui::TableNextColumn(); ImGui::Text("%.1f", allocTracker().total(tag).peakBytes / KB);
+            }
+            ImGui::EndTable();
+        }
+    }
+    // each participant's busy share of the last frame; a long caller wait is a split whose slices took unequal time,
+    // serial and contended loops are work that ran on one core while the others could have helped
+    if (ImGui::CollapsingHeader("Worker Pool")) {
+        const ThreadPool::Frame& pool = workerPool().lastFrame();
+        for (unsigned int i = 0; i < pool.participants.size(); i++) {
+            const ThreadPool::ParticipantFrame& p = pool.participants[i];
+            char label[96];
+            if (i == 0)
+                std::snprintf(label, sizeof(label), "caller: %.2f ms, %llu slices", p.busyMs, p.slices);
+            else
+                std::snprintf(label, sizeof(label), "worker %u: %.2f ms, %llu slices, wake %.0f us (max %.0f)", i, p.busyMs, p.slices,
+                              p.slices > 0 ? p.wakeMs * 1e3 / p.slices : 0.0, p.maxWakeMs * 1e3);
+            ImGui::ProgressBar(pool.utilization(i), ImVec2(-1.0f, 0.0f), label);
+        }
+        ImGui::Text("Loops: %llu parallel, %llu serial, %llu contended (%.2f ms)", pool.loops, pool.serialLoops, pool.contendedLoops,
+                    pool.contendedMs);
+        ImGui::Text("Caller waited %.2f ms for the slowest slices", pool.callerWaitMs);
+        ImGui::Text("Frame graph: %zu tasks ready at most", frameGraph.peakReadyTasks());
+    }
+    if (ImGui::CollapsingHeader("GPU Memory")) {
+        const double MB = 1024.0 * 1024.0;
+        for (unsigned int c = 0; c < GPU_MEMORY_CATEGORIES; c++) {
+            const GpuMemoryCategory category = static_cast<GpuMemoryCategory>(c);
+            ImGui::Text("%-18s %8.1f MB in %lld", GpuMemoryTracker::name(category), gpuMemory().bytes(category) / MB,
+                        gpuMemory().objects(category));
+        }
+        ImGui::Text("%-18s %8.1f MB", "tracked", gpuMemory().totalBytes() / MB);
+        // the driver's budget where it reports one: what is in use of the dedicated memory, whoever allocated it
+        const GpuMemoryTracker::DriverMemory driver = gpuMemory().driver();
+        if (driver.totalKB > 0 && driver.availableKB >= 0) {
+            const double usedKB = static_cast<double>(driver.totalKB - driver.availableKB);
+            char budget[64];
+            std::snprintf(budget, sizeof(budget), "%.0f / %.0f MB", usedKB / 1024.0, driver.totalKB / 1024.0);
+            ImGui::ProgressBar(static_cast<float>(usedKB / driver.totalKB), ImVec2(-1.0f, 0.0f), budget);
+            if (driver.evictedKB > 0)
+                ImGui::Text("Evicted to system memory: %.1f MB", driver.evictedKB / 1024.0);
+        } else if (driver.availableKB >= 0) {
+            ImGui::Text("Driver: %.1f MB free", driver.availableKB / 1024.0);
+        } else {
+            ImGui::TextDisabled("No driver memory report (%s)", driver.source);
+        }
+        // the post-process frame graph: what its transients would take apart, and what they share
+        const FrameGraph::Stats& post = sceneTarget->postProcessStats();
+        ImGui::Text("Post passes: %u (%u culled), %u barriers", post.passes - post.culled, post.culled, post.barriers);
+        ImGui::Text("Post transients: %u in %u textures, %.1f MB for %.1f MB (pool %.1f MB)", post.transients, post.allocations,
+                    post.allocatedBytes / MB, post.transientBytes / MB, post.pooledBytes / MB);
+    }
+    ImGui::End();
 }
 
 
-int main()
+int main(int argc, char** argv)
 {
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    // glfwWindowHint(GLFW_MAXIMIZED, GLFW_TRUE); // Can cause issues on some systems / WM
-    glfwWindowHint(GLFW_SAMPLES, 4);
+    // its epoch, the phases are timed from here
+    startupTrace().nameThread("main");
+    const int parsed = parseArguments(argc, argv);
+    if (parsed >= 0) return parsed;
+    profiler().nameThread("main");
+    allocTracker().setEnabled(trackAllocations);
+    startupTrace().mark("arguments", {}, STARTUP_CPU);
+    unsigned int windowedWidth = 1280, windowedHeight = 720;     // without a monitor to size the window by
+    if (!headless.active) {
+        glfwInit();
+        const RenderProfile& profile = renderProfile();
+        if (profile.es()) glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, profile.major);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, profile.minor);
+        if (!profile.es()) glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        // glfwWindowHint(GLFW_MAXIMIZED, GLFW_TRUE); // Can cause issues on some systems / WM
+        // multisampling is the scene target's, the window only receives the upscaled scene and the UI
+        glfwWindowHint(GLFW_SAMPLES, 0);
 
-    // Get primary monitor video mode for window size
-    GLFWmonitor* primaryMonitor = glfwGetPrimaryMonitor();
-    const GLFWvidmode* mode = glfwGetVideoMode(primaryMonitor);
-    unsigned int windowedWidth = mode->width * 0.9;  // Use 90% of screen for non-maximized
-    unsigned int windowedHeight = mode->height * 0.9;
-    if (windowedWidth == 0 || windowedHeight == 0) { // Fallback
-        windowedWidth = 1280; windowedHeight = 720;
+        // Get primary monitor video mode for window size; there is none without a display
+        GLFWmonitor* primaryMonitor = glfwGetPrimaryMonitor();
+        const GLFWvidmode* mode = primaryMonitor ? glfwGetVideoMode(primaryMonitor) : nullptr;
+        if (mode && mode->width > 0 && mode->height > 0) {
+            windowedWidth = mode->width * 0.9;  // Use 90% of screen for non-maximized
+            windowedHeight = mode->height * 0.9;
+        }
+    }
+    // the same pixels on every machine, the camera is flown instead of steered
+    if (benchmark.active) {
+        windowedWidth = 1600; windowedHeight = 900;
+        cameraEnabled = false;
+    }
+    if (headless.active) {
+        windowedWidth = headless.width; windowedHeight = headless.height;
+        cameraEnabled = false;
     }
-
 
     lastX = windowedWidth / 2.0f;
     lastY = windowedHeight / 2.0f;
 
-    GLFWwindow* window = glfwCreateWindow(windowedWidth, windowedHeight, "Solar System Sim", NULL, NULL);
-    if (window == NULL) { std::cout << "Failed to create GLFW window" << std::endl; glfwTerminate(); return -1; }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
-    
-    glfwSetInputMode(window, GLFW_CURSOR, cameraEnabled ? GLFW_CURSOR_DISABLED : GLFW_CURSOR_NORMAL);
+    GLFWwindow* window = nullptr;
+    EglContext eglContext;
+    GLADloadproc loader = (GLADloadproc)glfwGetProcAddress;
+    if (headless.active) {
+        if (!eglContext.create(headless.device)) { std::cout << "Failed to create EGL context: " << eglContext.error() << std::endl; return -1; }
+        loader = (GLADloadproc)EglContext::getProcAddress;
+        std::signal(SIGINT, requestStop);
+        std::signal(SIGTERM, requestStop);
+    } else {
+        window = glfwCreateWindow(windowedWidth, windowedHeight, "Solar System Sim", NULL, NULL);
+        // a driver without ES 3.2 may still have 3.1, which the profile works with
+        if (window == NULL && renderProfile().es() && renderProfile().minor == 2) {
+            renderProfile().minor = 1;
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+            window = glfwCreateWindow(windowedWidth, windowedHeight, "Solar System Sim", NULL, NULL);
+        }
+        if (window == NULL) { std::cout << "Failed to create GLFW window (--headless renders without a display)" << std::endl; glfwTerminate(); return -1; }
+        glfwMakeContextCurrent(window);
+        if (renderThread) {
+            // the events are queued for the frame thread, drainWindowEvents calls the callbacks below with them
+            windowEventQueue.attach(window);
+            windowInput = windowEventQueue.current();
+        } else {
+            glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+            glfwSetCursorPosCallback(window, mouse_callback);
+            glfwSetScrollCallback(window, scroll_callback);
+            // the rest only wake on-demand rendering, ImGui chains them when it installs its own
+            glfwSetKeyCallback(window, [](GLFWwindow*, int, int, int, int) { windowEvents++; });
+            glfwSetCharCallback(window, [](GLFWwindow*, unsigned int) { windowEvents++; });
+            glfwSetMouseButtonCallback(window, [](GLFWwindow*, int, int, int) { windowEvents++; });
+            glfwSetWindowFocusCallback(window, [](GLFWwindow*, int) { windowEvents++; });
+            glfwSetCursorEnterCallback(window, [](GLFWwindow*, int) { windowEvents++; });
+            glfwSetWindowRefreshCallback(window, [](GLFWwindow*) { windowEvents++; });
+        }
+        if (benchmark.active) {
+            // frame times, not the refresh rate
+            presentMode = PRESENT_UNCAPPED;
+            framePacer.fpsLimit = 0.0;
+        }
+        applyPresentMode(window);
+
+        glfwSetInputMode(window, GLFW_CURSOR, cameraEnabled ? GLFW_CURSOR_DISABLED : GLFW_CURSOR_NORMAL);
+    }
 
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) { std::cout << "Failed to initialize GLAD" << std::endl; return -1; }
+    if (!gladLoadGLLoader(loader)) { std::cout << "Failed to initialize GLAD" << std::endl; return -1; }
+    renderProfile().detect(loader);
+    bindlessTextures = BindlessTextures::load(loader);
+    sparseTextures = VirtualTexture::loadSparse(loader);
+    shadingRatesAvailable = VariableRateShading::load(loader);
+    applyRenderProfile();
+    if (window && outputWindowCount > 0 && !outputWindows.open(window, outputWindowCount, windowedWidth, windowedHeight))
+        std::cout << "Opened " << outputWindows.panels() - 1 << " of " << outputWindowCount << " output windows" << std::endl;
+    if (headless.active)
+        headlessTarget = new HeadlessFramebuffer(headless.width, headless.height);
+    startupTrace().mark("context", {"arguments"});
+    // neither is skinned, and the rock's vertices are fetched once per instance. The rock keeps its own VAOs for
+    // the instance attributes, the planet and the sun share the geometry pool's.
+    modelLoader().start(MODEL_LOADER_THREADS);
+    ModelHandle planetLoad = modelLoader().load("../resources/objects/planet/planet.obj", true, VERTEX_LAYOUT_PACKED, true);
+    ModelHandle rockLoad = modelLoader().load("../resources/objects/rock/rock.obj", true, VERTEX_LAYOUT_PACKED, false, MAX_MESH_LODS);
+    planetAsset = assetPriorities.add(planetLoad);
+    rockAsset = assetPriorities.add(rockLoad);
 
     glEnable(GL_DEPTH_TEST);
+    // before the first program is built, they are compiled for it
+    depthConvention().enable(reverseDepth);
     glEnable(GL_CULL_FACE);
-    glEnable(GL_MULTISAMPLE);  
+    // both always on in ES
+    if (!renderProfile().es()) {
+        glEnable(GL_MULTISAMPLE);
+        glEnable(GL_PROGRAM_POINT_SIZE);    // asteroid impostors size their points in the vertex shader
+    }
     camera.MovementSpeed = 50.0f;
 
     IMGUI_CHECKVERSION();
+    ImGui::SetAllocatorFunctions(allocTrackerImGuiAlloc, allocTrackerImGuiFree);
     ImGui::CreateContext();
     ImGuiIO& io = ImGui::GetIO(); (void)io;
     io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
     ImGui::StyleColorsDark();
-    ImGui_ImplGlfw_InitForOpenGL(window, true);
-    ImGui_ImplOpenGL3_Init("#version 460"); // Ensure this matches your shader capabilities
+    // a headless run still builds the UI every frame, it is only never drawn
+    // with --render-thread ImGui's callbacks are called by drainWindowEvents, not by GLFW
+    if (window) ImGui_ImplGlfw_InitForOpenGL(window, !renderThread);
+    ImGui_ImplOpenGL3_Init(renderProfile().imguiGlsl());
+    startupTrace().mark("imgui", {"context"});
 
-    // Shaders (Paths from original, VS then FS)
-    Shader lightSourceShader("../shaders.2/structured.light.cube.shader.vs", "../shaders.2/light.cube.shader.fs");
+    // Shaders (Paths from original, VS then FS). All are submitted before any is used, so a driver that compiles in
+    // parallel has them at once; each is waited for on first use.
+    ParallelShaderCompile::load(loader);
+    Shader::setDeferredCompile(true);
+    Shader lightSourceShader("../shaders.2/structured.light.cube.shader.vs", "../shaders.2/light.cube.shader.fs", withObjectBlock(ShaderDefines()));
+    Shader tessellatedSunShader(tessellatedStages("../shaders.2/light.cube.shader.fs"), withObjectBlock(ShaderDefines()));
     Shader skyboxShader("../shaders.2/structured.skybox.vs", "../shaders.2/6.1.skybox.fs");
-    Shader objectShader("../shaders.2/structured.object.model.shader.vs", "../shaders.2/2.instanced.object.model.shader.fs");
-    Shader asteroidShader("../shaders.2/instanced.object.model.shader.vs", "../shaders.2/2.instanced.object.model.shader.fs");
+    // the lit shaders are compiled for the LightData block below and write linear HDR, SceneTarget tone maps it
+    const ShaderDefines litDefines{{"NR_POINT_LIGHTS", std::to_string(NR_POINT_LIGHTS)}, {"CLUSTERED_LIGHTS", ""}, {"SUN_SHADOWS", ""}};
+    // the bindless shaders only compile with the extension, without it everything samples bound textures
+    const char* batchedFragment = bindlessTextures ? "../shaders.2/batched.bindless.object.model.shader.fs" : "../shaders.2/batched.object.model.shader.fs";
+    // the rocks sample their variant's layer of one texture array either way
+    const char* asteroidFragment = "../shaders.2/rock.instanced.object.model.shader.fs";
+    // every lit shader twice, lighting as it draws and writing the G-buffer for the deferred lighting pass
+    ShaderDefines gBufferDefines = litDefines;
+    gBufferDefines.emplace_back("GBUFFER_OUTPUT", "");
+    LitShaders forwardLit(batchedFragment, asteroidFragment, litDefines);
+    LitShaders deferredLit(batchedFragment, asteroidFragment, gBufferDefines);
+    // the same instanced vertex shaders placing the sun's shadow casters for the layered cube pass
+    const ShaderDefines shadowDefines{{"SHADOW_PASS", ""}};
+    Shader objectShadowShader("../shaders.2/shadow.cube.vs", "../shaders.2/shadow.cube.fs", "../shaders.2/shadow.cube.gs");
+    Shader asteroidShadowShader("../shaders.2/compact.instanced.object.model.shader.vs", "../shaders.2/shadow.cube.fs", "../shaders.2/shadow.cube.gs", shadowDefines);
+    Shader quantizedShadowShader("../shaders.2/quantized.instanced.object.model.shader.vs", "../shaders.2/shadow.cube.fs", "../shaders.2/shadow.cube.gs", shadowDefines);
+    Shader gpuShadowShader("../shaders.2/gpu.instanced.object.model.shader.vs", "../shaders.2/shadow.cube.fs", "../shaders.2/shadow.cube.gs", shadowDefines);
+    Shader planetShadowShader("../shaders.2/planet.instanced.vs", "../shaders.2/shadow.cube.fs", "../shaders.2/shadow.cube.gs", shadowDefines);
+    gpuNBody = new GpuNBody("../shaders.2/nbody.force.cs", "../shaders.2/nbody.drift.cs");
+    hybridNBody = new HybridNBody("../shaders.2/nbody.hybrid.cs");
+    gpuParticleMesh = new GpuParticleMesh("../shaders.2/");
+    gpuBelt = new GpuBelt("../shaders.2/belt.spawn.cs", "../shaders.2/belt.orbit.cs");
+    gpuCuller = new GpuCuller("../shaders.2/asteroid.cull.cs", "../shaders.2/asteroid.order.cs");
+    radixSort = new GpuRadixSort("../shaders.2/radix.histogram.cs", "../shaders.2/radix.scan.cs", "../shaders.2/radix.scatter.cs");
+    gpuMorton = new GpuMortonOrder("../shaders.2/nbody.morton.cs", "../shaders.2/nbody.gather.cs", *radixSort);
+    gpuBarnesHut = new GpuBarnesHut("../shaders.2/nbody.tree.cs", "../shaders.2/nbody.barnes_hut.cs", *radixSort);
+    hiZ = new HiZ("../shaders.2/hiz.downsample.cs");
+    shadingRates = new ShadingRateImage("../shaders.2/");
+    sphereImpostorRenderer = new SphereImpostors("../shaders.2/sphere.impostor.vs", "../shaders.2/sphere.impostor.fs", litDefines);
+    planetTerrain = new PlanetTerrain("../shaders.2/terrain.bake.vs", "../shaders.2/terrain.bake.fs");
+    orbitLines = new OrbitLines("../shaders.2/orbit.line.vs", "../shaders.2/orbit.line.fs");
+    debugDraw = new DebugDraw("../shaders.2/debug.line.vs", "../shaders.2/debug.shape.vs", "../shaders.2/debug.fs");
+    pointCloud = new PointCloud("../shaders.2/point.cloud.vs", "../shaders.2/point.cloud.fs");
+    gasDisk = new GpuSph("../shaders.2/", *radixSort);
+    gasCloud = new PointCloud("../shaders.2/point.cloud.vs", "../shaders.2/point.cloud.fs");
+    // a dim orange where the disk is thin, white in its dense midplane
+    gasCloud->brightness = 0.02f;
+    gasCloud->warmColor = glm::vec3(0.9f, 0.45f, 0.2f);
+    gasCloud->coolColor = glm::vec3(1.0f, 0.9f, 0.8f);
+    densityMap = new DensityMap("../shaders.2/density.splat.cs", "../shaders.2/density.blur.cs", "../shaders.2/density.plane.vs", "../shaders.2/density.plane.fs");
+    densityMap->extent = 1.25f * asteroidBeltOuterRadius;
+    atmosphere = new Atmosphere("../shaders.2/atmosphere.precompute.cs", "../shaders.2/fullscreen.vs", "../shaders.2/atmosphere.fs");
+    gpuTrails = new GpuTrails("../shaders.2/trail.capture.cs", "../shaders.2/trail.vs", "../shaders.2/trail.fs");
+    starField = new StarField("../shaders.2/star.cull.cs", "../shaders.2/star.field.vs", "../shaders.2/star.field.fs");
+    reflectionProbe = new ReflectionProbe("../shaders.2/reflection.prefilter.cs", reflectionProbeSize);
+    gpuPicker = new GpuPicker();
+    gpuReadback = new GpuReadback();
+    gpuReadback->create(64 * 1024, "GPU body readback");
+    frameCapture = new FrameCapture();
+    if (videoFromStart)
+        toggleVideo();
+    else if (headless.active)
+        std::cout << "no --video given, the headless frames are rendered but not written" << std::endl;
+    gpuTimers = new GpuTimers();
+    passTimers.shadows = gpuTimers->scope("sun shadow");
+    passTimers.reflections = gpuTimers->scope("reflection probe");
+    passTimers.shadingRates = gpuTimers->scope("shading rate image");
+    passTimers.prepass = gpuTimers->scope("depth pre-pass");
+    passTimers.planet = gpuTimers->scope("planet");
+    passTimers.asteroids = gpuTimers->scope("asteroids");
+    passTimers.lighting = gpuTimers->scope("deferred lighting");
+    passTimers.sun = gpuTimers->scope("sun");
+    passTimers.hiZ = gpuTimers->scope("hi-z capture");
+    passTimers.sky = gpuTimers->scope("skybox");
+    passTimers.atmospheres = gpuTimers->scope("atmospheres");
+    passTimers.debugDraw = gpuTimers->scope("debug draw");
+    passTimers.postProcess = gpuTimers->scope("post-process");
+    passTimers.ui = gpuTimers->scope("ui");
+    renderQueue.setTimers(gpuTimers);
+    sunShadow = new CubeShadowMap(SUN_SHADOW_RESOLUTION, "../shaders.2/shadow.blur.cs");
+    clusteredLights = new ClusteredLights("../shaders.2/light.cluster.cs");
+    gBuffer = new GBuffer("../shaders.2/fullscreen.vs", "../shaders.2/deferred.lighting.fs", litDefines);
+    sceneTarget = new SceneTarget("../shaders.2/");
+    sceneTarget->exposure = sceneExposure;
+    sceneTarget->logLuminance = pointCloudMode;
+    sceneTarget->bloomEnabled = sceneBloom;
+    sceneTarget->overdrawView = overdrawView;
+    // the statistics queries are desktop GL's
+    gpuTimers->statistics = pipelineStatistics && !renderProfile().es();
+    Shader::setDeferredCompile(false);
+    asyncPhysics.setRecorder(&trajectoryRecorder);
+    // compiles that are not done yet are waited for where the programs are first used
+    startupTrace().mark("shaders and passes", {"context"});
 
     // Skybox
     float skyboxVertices[] = {
@@ -346,9 +2792,11 @@ int main()
         -1.0f, -1.0f, -1.0f, -1.0f, -1.0f,  1.0f,  1.0f, -1.0f, -1.0f,  1.0f, -1.0f, -1.0f, -1.0f, -1.0f,  1.0f,  1.0f, -1.0f,  1.0f
     };
     unsigned int skyboxVAO, skyboxVBO;
-    glGenVertexArrays(1, &skyboxVAO); glGenBuffers(1, &skyboxVBO);
-    glBindVertexArray(skyboxVAO); glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
+    glGenVertexArrays(1, &skyboxVAO); glCreateBuffers(1, &skyboxVBO);
+    glNamedBufferStorage(skyboxVBO, sizeof(skyboxVertices), &skyboxVertices, 0);
+    glState().bindVertexArray(skyboxVAO); glState().bindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
+    labelObject(GL_VERTEX_ARRAY, skyboxVAO, "skybox VAO");
+    labelObject(GL_BUFFER, skyboxVBO, "skybox vertices");
     glEnableVertexAttribArray(0); glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
     
     std::vector<std::string> faces {
@@ -356,44 +2804,106 @@ int main()
         "../textures/space_skybox/GalaxyTex_PositiveY.png", "../textures/space_skybox/GalaxyTex_NegativeY.png",
         "../textures/space_skybox/GalaxyTex_PositiveZ.png", "../textures/space_skybox/GalaxyTex_NegativeZ.png"
     };
+    textureCache().startStreaming(TEXTURE_LOADER_THREADS, TEXTURE_UPLOAD_BUDGET);
+    // a bindless handle freezes the texture's levels
+    if (textureBudgetMB > 0 && !bindlessTextures) textureCache().setMipStreaming(true, static_cast<size_t>(textureBudgetMB) << 20);
     unsigned int cubemapTexture = loadCubemap(faces);
-    stbi_set_flip_vertically_on_load(true); // For model textures if they need it (often they do)
-    planetModelPtr = new Model("../resources/objects/planet/planet.obj", true);
-    rockModelPtr = new Model("../resources/objects/rock/rock.obj", true);
-    stbi_set_flip_vertically_on_load(false); // Reset if other images don't need it
+    if (!starCatalogPath.empty()) {
+        starcatalog::Catalog catalog;
+        if (!starcatalog::read(starCatalogPath, catalog)) {
+            std::cout << "no star catalog at " << starCatalogPath << ", writing a synthetic one of " << syntheticStars << " stars" << std::endl;
+            catalog = starcatalog::synthetic(syntheticStars, benchmark.seed);
+            if (!starcatalog::write(starCatalogPath, catalog)) std::cout << "could not write " << starCatalogPath << std::endl;
+        }
+        starField->upload(catalog);
+        starCatalogSky = starField->loaded();
+    }
+    startupTrace().mark("sky", {"context"});
+    textureCache().setFlipVertically(true); // For model textures if they need it (often they do)
+    // the rock's LODs were simplified on its loader thread
+    modelLoader().wait(planetLoad);
+    modelLoader().wait(rockLoad);
+    startupTrace().skip();
+    planetModelPtr = planetLoad->take();
+    rockModelPtr = rockLoad->take();
+    if (proceduralRocks) {
+        // the textures outlive the swap, the icosphere takes them from the cache before rock.obj gives them back
+        Model* imported = rockModelPtr;
+        rockModelPtr = new Model(proceduralRockData(*imported), imported->gammaCorrection, VERTEX_LAYOUT_PACKED);
+        growRockBounds(*rockModelPtr, rockRelief);
+        delete imported;
+    }
+    assetPriorities.resident(planetAsset, *planetModelPtr);
+    assetPriorities.resident(rockAsset, *rockModelPtr);
+    // a bindless handle freezes its texture, so the placeholders have to be replaced before any is taken
+    if (bindlessTextures) textureCache().finishStreaming();
+    planetBatchPtr = new ModelBatch(*planetModelPtr, bindlessTextures);
+    planetInstances = new PlanetInstances(*planetModelPtr);
+    // the variants are deformed from the rock's CPU copy, pooled in the same layout
+    rockVariants = new RockVariants(*rockModelPtr, rockVariantCount, VERTEX_LAYOUT_PACKED, 1, proceduralRocks ? rockRelief : 0.0f);
+    rockVariantCount = rockVariants->count();
+    rockBoundingRadius = GpuCuller::boundingRadius(*rockModelPtr);
+    planetBoundingRadius = GpuCuller::boundingRadius(*planetModelPtr);
+    // asteroids hit the planet's surface rather than its bounding sphere, through the field baked with the import
+    physics.setSurface(planetModelPtr, &planetModelPtr->sdf);
+    startupTrace().mark("model upload", {"model import", "context"});
+    planetTerrain->bake(*planetModelPtr, planetBoundingRadius);
+    // the bake leaves the framebuffer unbound and the viewport at its cube size
+    glViewport(0, 0, windowedWidth, windowedHeight);
+    startupTrace().mark("terrain bake", {"model upload", "shaders and passes"});
+    if (!planetSurfacePath.empty()) {
+        planetSurface = new VirtualTexture();
+        if (!planetSurface->open(planetSurfacePath, planetSurfaceCachePages, TEXTURE_LOADER_THREADS, sparseTextures)) {
+            std::cout << "Planet surface not loaded: " << planetSurface->error() << std::endl;
+            delete planetSurface;
+            planetSurface = nullptr;
+        }
+    }
+    textureCache().setFlipVertically(false); // Reset if other images don't need it
 
-    sphereMesh = SphereCreator::CreateSphere(1.0f, 36, 18);
-    resetSimulation();
+    startupTrace().mark("planet surface", {"context"});
+    sphereMesh = &sphereCache().icosphere(SUN_SUBDIVISIONS);
+    sphereMesh->label("sun sphere");
+    startupTrace().mark("sphere", {"context"});
+    // the pre-pass and shadow casters' own streams, from the CPU copies like the rest
+    planetModelPtr->createPositionStreams();
+    rockModelPtr->createPositionStreams();
+    sphereMesh->createPositionStream();
+    // nothing picks or collides against the meshes, once the LODs, bounds and batches are built the GPU copy is all
+    // that is drawn from
+    planetModelPtr->releaseCpuData();
+    rockModelPtr->releaseCpuData();
+    rockVariants->releaseCpuData();
+    sphereMesh->releaseCpuData();
+    startupTrace().mark("position streams", {"model upload", "sphere"});
+    solarSystemSettings = physics.settings();
+    // resetSimulation, in its halves: the bodies could be generated on any core, their buffers need the context
+    initializeCelestialBodies();
+    startupTrace().mark("bodies", {"model upload", "sphere"}, STARTUP_CPU);
+    resetAfterInitialize(false);
+    startupTrace().mark("body upload", {"bodies", "model upload", "shaders and passes"});
+    startUniverse();
+    if (galaxyScene) camera.Position = glm::dvec3(0.0, 500.0, 1400.0);
+    if (gpuBeltEnabled) respawnGpuBelt();
+    if (gasEnabled) respawnGas();
+    if (!remoteAddress.empty()) startRemote();
 
-    unsigned int uboMatrices;
-    glGenBuffers(1, &uboMatrices);
-    glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
-    glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4), NULL, GL_STATIC_DRAW);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
-    glBindBufferBase(GL_UNIFORM_BUFFER, 0, uboMatrices);
+    cameraUniforms.create();
 
     // Projection matrix update will happen in the loop or framebuffer_size_callback
     // For now, set initial projection (will be updated if window resizes or zoom changes)
-    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)windowedWidth / (float)windowedHeight, 0.1f, 3000.0f);
-    glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
-    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(projection));
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glm::mat4 projection = depthConvention().perspective(glm::radians(camera.Zoom), (float)windowedWidth / (float)windowedHeight, 0.1f, 3000.0f);
+    cameraUniforms.beginFrame();
+    cameraUniforms.write(projection, camera.GetCameraRelativeViewMatrix());
 
 
-    struct Material { float shininess; float padding[3]; };
-    struct DirLight { glm::vec3 direction; float padding1; glm::vec3 ambient; float padding2; glm::vec3 diffuse; float padding3; glm::vec3 specular; float padding4; };
-    struct PointLight { glm::vec4 position; float constant, linear, quadratic, padding0; glm::vec3 ambient; float padding1; glm::vec3 diffuse; float padding2; glm::vec3 specular; float padding3; };
-    struct SpotLight { glm::vec3 position_spot; float padding0_spot; glm::vec3 direction_spot; float cutOff; float outerCutOff; float constant_spot; float linear_spot; float quadratic_spot; glm::vec3 ambient_spot; float padding4_spot; glm::vec3 diffuse_spot; float padding5_spot; glm::vec3 specular_spot; float padding6_spot;}; // Adjusted Spotlight for vec4 alignment
-    struct LightData { Material material; DirLight dirLight; PointLight pointLights[NR_POINT_LIGHTS]; SpotLight spotLight; };
-    
-    GLuint uboLightData;
-    glGenBuffers(1, &uboLightData);
-    glBindBuffer(GL_UNIFORM_BUFFER, uboLightData);
-    glBufferData(GL_UNIFORM_BUFFER, sizeof(LightData), NULL, GL_DYNAMIC_DRAW);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
-    glBindBufferBase(GL_UNIFORM_BUFFER, 1, uboLightData);
-
-    LightData lighting;
+    // the lights are stored whole into the object ring once a frame, plain writes to mapped memory
+    objectUniformRing.create(OBJECT_RING_BYTES, "Object blocks");
+    renderQueue.setInstancing(&objectUniformRing, OBJECT_BLOCK_BINDING, OBJECT_INSTANCES_BINDING);
+    for (Shader* lit : {&forwardLit.batchedObjectShader, &deferredLit.batchedObjectShader})
+        if (!checkUniformBlock<LightData>(lit->ID, "LightData")) std::cout << "LightData does not match the shaders' block" << std::endl;
+
+    LightData lighting{};
     lighting.material.shininess = 32.0f;
     lighting.dirLight.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
     lighting.dirLight.ambient = glm::vec3(0.0f); //glm::vec3(0.02f);
@@ -408,196 +2918,1973 @@ int main()
     lighting.pointLights[0].specular = glm::vec3(1.0f);
     
     // Initialize Spotlight (e.g. camera flashlight)
-    lighting.spotLight.position_spot = camera.Position; // Will be updated
-    lighting.spotLight.direction_spot = camera.Front;   // Will be updated
     lighting.spotLight.cutOff = glm::cos(glm::radians(12.5f));
     lighting.spotLight.outerCutOff = glm::cos(glm::radians(15.0f));
-    lighting.spotLight.constant_spot = 1.0f;
-    lighting.spotLight.linear_spot = 0.022f;
-    lighting.spotLight.quadratic_spot = 0.0019f;
-    lighting.spotLight.ambient_spot = glm::vec3(0.0f);
-    lighting.spotLight.diffuse_spot = glm::vec3(0.8f);
-    lighting.spotLight.specular_spot = glm::vec3(0.5f);
+    lighting.spotLight.constant = 1.0f;
+    lighting.spotLight.linear = 0.022f;
+    lighting.spotLight.quadratic = 0.0019f;
+    lighting.spotLight.ambient = glm::vec3(0.0f);
+    lighting.spotLight.diffuse = glm::vec3(0.8f);
+    lighting.spotLight.specular = glm::vec3(0.5f);
+
+    // the uniforms set for every object every frame, resolved once so the loop never looks up names
+    struct ObjectUniforms {
+        Shader::Uniform<glm::mat4> model;
+        Shader::Uniform<glm::mat3> normalMatrix;
+        Shader::Uniform<glm::vec3> viewPos;
+        Shader::Uniform<float> reflectivity;
+        Shader::Uniform<float> reflectionLod;
+        Shader::Uniform<unsigned int> pickId;
+    };
+    auto objectUniformsOf = [](const Shader& shader) {
+        return ObjectUniforms{shader.uniform<glm::mat4>("model"), shader.uniform<glm::mat3>("normalMatrix"), shader.uniform<glm::vec3>("viewPos"),
+                              shader.uniform<float>("reflectivity"), shader.uniform<float>("reflectionLod"), shader.uniform<unsigned int>("pickId")};
+    };
+    // forward then deferred, indexed by deferredShading
+    const ObjectUniforms batchedObjectUniforms[2] = {objectUniformsOf(forwardLit.batchedObjectShader), objectUniformsOf(deferredLit.batchedObjectShader)};
+    const auto sunProjection = lightSourceShader.uniform<glm::mat4>("projection");
+    const auto sunView = lightSourceShader.uniform<glm::mat4>("view");
+    const auto skyboxViewUniform = skyboxShader.uniform<glm::mat4>("view");
+    const auto skyboxProjection = skyboxShader.uniform<glm::mat4>("projection");
 
     skyboxShader.use(); skyboxShader.setInt("skybox", 0);
-    objectShader.use(); objectShader.setBool("gamma", true); // Assuming shaders handle gamma
-    asteroidShader.use(); asteroidShader.setBool("gamma", true); //asteroidShader.setInt("texture_diffuse1", 0);
-
-    float lastFrame = static_cast<float>(glfwGetTime());
-    while (!glfwWindowShouldClose(window)) {
-        float currentFrame = static_cast<float>(glfwGetTime());
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
-
-        glfwPollEvents(); // Poll events early
-        processInput(window); // Process input after polling
-        ImGuiIO& io = ImGui::GetIO();
-        if (cameraEnabled) {
-            io.ConfigFlags |= ImGuiConfigFlags_NoMouse;
-        } else {
-            io.ConfigFlags &= ~ImGuiConfigFlags_NoMouse;
-        }
-        ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame();
-
-        ImGui::Begin("Simulation Controls");
-        ImGui::Text("FPS: %.1f (%.3f ms/frame)", ImGui::GetIO().Framerate, 1000.0f / ImGui::GetIO().Framerate);
-        ImGui::Checkbox("Pause Simulation", &pauseSimulation);
-        ImGui::SliderFloat("Sim Speed", &simulationSpeed, 0.0f, 10.0f);
-        ImGui::Separator();
-        ImGui::Text("Physics:");
-        ImGui::SliderFloat("G Scaled", &G_scaled, 0.0f, 20000.0f, "%.0f");
-        ImGui::Separator();
-        if (ImGui::CollapsingHeader("Sun Properties")) {
-            bool sunChanged = ImGui::SliderFloat("Sun Mass", &sunMass, 1000.0f, 100000.0f, "%.0f");
-            sunChanged |= ImGui::SliderFloat("Sun Radius Scale", &sunRadiusScale, 1.0f, 50.0f);
-            if (sunChanged && !celestialBodies.empty()) {
-                celestialBodies[0].mass = sunMass;
-                celestialBodies[0].radiusScale = sunRadiusScale;
-                // No full reset needed for sun mass/scale only, but orbits will be affected.
-            }
-        }
-        if (ImGui::CollapsingHeader("Planet Properties")) {
-             ImGui::SliderFloat("Planet Mass", &planetMass, 1.0f, 1000.0f);
-             ImGui::SliderFloat("Planet Radius Scale", &planetRadiusScale, 0.1f, 10.0f);
-             ImGui::SliderFloat("Planet Orbit Radius", &planetOrbitRadius, 10.0f, 300.0f);
-             ImGui::SliderFloat("Planet Initial Angle", &planetInitialAngle, 0.0f, 360.0f);
-        }
-        if (ImGui::CollapsingHeader("Asteroid Properties")) {
-            bool asteroidAmountChanged = ImGui::SliderInt("Asteroid Count", (int*)&asteroidAmount, 0, 5000); // Reduced max for stability
-            ImGui::SliderFloat("Avg. Asteroid Mass", &avgAsteroidMass, 0.001f, 1.0f, "%.3f");
-            ImGui::SliderFloat("Min Asteroid Scale", &minAsteroidScale, 0.01f, 0.5f);
-            ImGui::SliderFloat("Max Asteroid Scale", &maxAsteroidScale, 0.05f, 1.0f);
-            ImGui::SliderFloat("Belt Inner Radius", &asteroidBeltInnerRadius, 20.0f, 500.0f);
-            ImGui::SliderFloat("Belt Outer Radius", &asteroidBeltOuterRadius, 50.0f, 600.0f);
-            ImGui::SliderFloat("Belt Height", &asteroidBeltHeight, 1.0f, 50.0f);
-            if (asteroidAmountChanged) resetSimulation(); // Reset if count changes
-        }
-        if (ImGui::Button("Reset Simulation Full")) {
-            resetSimulation();
+    for (LitShaders* lit : {&forwardLit, &deferredLit}) {
+        lit->quantizedAsteroidShader.use();
+        lit->quantizedAsteroidShader.setFloat("turnRate", static_cast<float>(6.283185307179586 / TUMBLE_PERIOD));
+        for (Shader* rockShader : {&lit->asteroidShader, &lit->quantizedAsteroidShader, &lit->gpuAsteroidShader}) {
+            rockShader->use();
+            rockShader->setUInt("variantCount", std::max(rockVariantCount, 1u));
+            rockShader->setFloat("rockRelief", proceduralRocks ? rockRelief : 0.0f);
         }
-        ImGui::End();
+        for (Shader* impostorShader : {&lit->asteroidImpostorShader, &lit->quantizedImpostorShader, &lit->gpuImpostorShader}) {
+            impostorShader->use();
+            impostorShader->setBool("impostor", true);
+            impostorShader->setFloat("modelRadius", rockBoundingRadius);
+        }
+    }
+
+    quantizedShadowShader.use();
+    quantizedShadowShader.setFloat("turnRate", static_cast<float>(6.283185307179586 / TUMBLE_PERIOD));
+    for (Shader* rockShader : {&asteroidShadowShader, &quantizedShadowShader, &gpuShadowShader}) {
+        rockShader->use();
+        rockShader->setFloat("modelRadius", rockBoundingRadius);
+        rockShader->setFloat("rockRelief", proceduralRocks ? rockRelief : 0.0f);
+    }
+    objectShadowShader.use();
+    objectShadowShader.setFloat("modelRadius", planetModelPtr ? GpuCuller::boundingRadius(*planetModelPtr) : 0.0f);
+    planetShadowShader.use();
+    planetShadowShader.setFloat("modelRadius", planetModelPtr ? GpuCuller::boundingRadius(*planetModelPtr) : 0.0f);
+    // rocks cast with their coarsest level, the shadow is a texel or two across at most
+    auto drawRockShadows = [](unsigned int instances, unsigned int baseInstance) {
+        const unsigned int coarsest = rockModelPtr->lodCount() - 1;
+        for (const Mesh& mesh : rockModelPtr->meshes) {
+            glState().bindVertexArray(positionStreams ? mesh.depthVAO() : mesh.VAO);
+            mesh.drawElementsInstanced(instances, baseInstance, coarsest);
+        }
+    };
+
+    // setting the uniforms waits for the programs' compiles
+    startupTrace().mark("uniforms", {"shaders and passes", "body upload"});
+    // the global skipIdleFrame() also resets after a wait
+    lastFrame = static_cast<float>(clockSeconds());
+    // --render-thread runs it on a thread of its own, this one then only waits for the window's events
+    auto frameLoop = [&]() {
+        while (window ? !glfwWindowShouldClose(window) : !stopRequested) {
+            if (skipIdleFrame(window)) continue;
+            PROFILE_SCOPE("frame");
+            ALLOC_SCOPE(ALLOC_RENDERING);
+            framePacer.beginFrame();
+            ProfileStages stages;
+            // transient per-frame data from the last frame is dropped here, the counter covers the whole previous frame
+            frameArena().reset();
+            unsigned long long allocationsNow = allocTracker().allocationCount();
+            heapAllocationsLastFrame = allocationsNow - heapAllocationsAtFrameStart;
+            heapAllocationsAtFrameStart = allocationsNow;
+            allocTracker().beginFrame();
+            workerPool().beginFrame();
+            // the filtered GL calls likewise, checked against glGet first when validating
+            if (glState().validation())
+                glState().validate();
+            glStateLastFrame = glState().statistics();
+            glState().resetStatistics();
+            const auto cpuFrameStart = std::chrono::steady_clock::now();
+            gpuTimers->beginFrame();
+            // the GPU bodies' reads that arrived, before anything this frame looks at the bodies
+            gpuReadback->poll();
+            finishWorldRebuild();
+            updateUniverse();
+            float currentFrame = static_cast<float>(clockSeconds());
+            deltaTime = currentFrame - lastFrame;
+            lastFrame = currentFrame;
+            // the time since the last frame started is the last frame's
+            const float wallFrameMs = deltaTime * 1000.0f;
+            if (benchmark.active) {
+                if (benchmark.frame > benchmark.warmup) benchmark.frameMs.push(wallFrameMs);
+                deltaTime = BENCHMARK_FRAME_TIME;
+                collectBenchmarkGpu();
+            } else if (headless.active) {
+                deltaTime = 1.0f / videoFps;    // one video frame of simulation per frame
+            }
+
+            if (window) {
+                if (renderThread) drainWindowEvents(window);
+                else glfwPollEvents(); // Poll events early
+                processInput(window); // Process input after polling
+            }
+            if (benchmark.active) {
+                const double progress = benchmark.frame < benchmark.warmup ? 0.0
+                                      : double(benchmark.frame - benchmark.warmup) / std::max(benchmark.frames - 1, 1u);
+                CameraPath::apply(benchmark.path.sample(benchmark.path.startTime() + progress * benchmark.path.duration()), camera);
+            }
+            textureCache().update();
+            if (planetSurface) planetSurface->update();
+            modelLoader().poll();
+            stages.mark("input and streaming");
+            ImGuiIO& io = ImGui::GetIO();
+            if (cameraEnabled) {
+                io.ConfigFlags |= ImGuiConfigFlags_NoMouse;
+            } else {
+                io.ConfigFlags &= ~ImGuiConfigFlags_NoMouse;
+            }
+            const auto uiStart = std::chrono::steady_clock::now();
+            const AllocTag frameTag = AllocTracker::swapTag(ALLOC_UI);
+            ImGui_ImplOpenGL3_NewFrame();
+            if (window && !renderThread) {
+                ImGui_ImplGlfw_NewFrame();
+            } else if (window) {
+                // what the backend's NewFrame reads from GLFW, from the event thread's state instead
+                io.DisplaySize = ImVec2(static_cast<float>(windowInput.width), static_cast<float>(windowInput.height));
+                if (windowInput.width > 0 && windowInput.height > 0)
+                    io.DisplayFramebufferScale = ImVec2(static_cast<float>(windowInput.framebufferWidth) / windowInput.width,
+                                                        static_cast<float>(windowInput.framebufferHeight) / windowInput.height);
+                io.DeltaTime = deltaTime > 0.0f ? deltaTime : 1.0f / 60.0f;
+            } else {
+                io.DisplaySize = ImVec2(static_cast<float>(headless.width), static_cast<float>(headless.height));
+                io.DeltaTime = deltaTime;
+            }
+            ImGui::NewFrame();
+
+            ImGui::Begin("Simulation Controls");
+            ImGui::Text("FPS: %.1f (%.3f ms/frame)", ImGui::GetIO().Framerate, 1000.0f / ImGui::GetIO().Framerate);
+            ImGui::Text("Heap allocations last frame: %llu, frame arena %zu / %zu KB", heapAllocationsLastFrame,
+                        frameArena().highWaterBytes() / 1024, frameArena().capacityBytes() / 1024);
+            ImGui::Text("GL binds last frame: %u issued, %u filtered, render queue %zu draws", glStateLastFrame.issued,
+                        glStateLastFrame.filtered, renderQueue.size());
+            ImGui::Text("Uniform ring last frame: %u blocks in %zu KB, %u overflows; lights %zu bytes",
+                        objectUniformRing.slicesLastFrame(), objectUniformRing.bytesLastFrame() / 1024, objectUniformRing.overflowCount(),
+                        sizeof(LightData));
+            ImGui::Checkbox("Performance Overlay", &showPerformanceOverlay);
+            bool validateGlState = glState().validation();
+            if (ImGui::Checkbox("Validate GL State Cache", &validateGlState)) glState().setValidation(validateGlState);
+            if (validateGlState) ImGui::Text("Stale binds caught: %u", glStateLastFrame.stale);
+            ImGui::Text("Textures: %zu, %.1f MB, %zu streaming", textureCache().size(), textureCache().gpuBytes() / (1024.0 * 1024.0),
+                        textureCache().streamingPending());
+            if (textureCache().mipStreamingEnabled())
+                ImGui::Text("Mip streaming within %.0f MB", textureCache().mipStreamingBudget() / (1024.0 * 1024.0));
+            ImGui::Checkbox("Pause Simulation", &pauseSimulation);
+            if (timeWarp.enabled)
+                ImGui::SliderFloat("Sim Speed", &simulationSpeed, 0.0f, 1000.0f, "%.1fx", ImGuiSliderFlags_Logarithmic);
+            else
+                ImGui::SliderFloat("Sim Speed", &simulationSpeed, 0.0f, 10.0f);
+            ImGui::Checkbox("Time Warp (adaptive substeps)", &timeWarp.enabled);
+            if (timeWarp.enabled) {
+                if (physicsBackend != BACKEND_CPU || asyncPhysics.running()) ImGui::Text("(synchronous CPU physics only)");
+                ImGui::SliderFloat("Stability Eta", &timeWarp.eta, 0.002f, 0.1f, "%.3f", ImGuiSliderFlags_Logarithmic);
+                float maxStepMs = timeWarp.maxStep * 1000.0f;
+                if (ImGui::SliderFloat("Max Substep (ms)", &maxStepMs, 1.0f, 500.0f, "%.1f", ImGuiSliderFlags_Logarithmic))
+                    timeWarp.maxStep = maxStepMs / 1000.0f;
+                float budgetMs = timeWarp.frameBudget * 1000.0f;
+                if (ImGui::SliderFloat("Physics Budget (ms/frame)", &budgetMs, 1.0f, 100.0f, "%.1f"))
+                    timeWarp.frameBudget = budgetMs / 1000.0f;
+                ImGui::Checkbox("Cheaper Physics When Behind", &timeWarp.allowFallbacks);
+                ImGui::Text("Warp: %.1fx achieved of %.1fx requested", timeWarp.achievedWarp, timeWarp.requestedWarp);
+                ImGui::Text("%u substeps of %.2f ms (stable %.2f ms)", timeWarp.substeps, timeWarp.substepSize * 1000.0f,
+                            timeWarp.stableStep * 1000.0f);
+                if (timeWarp.tier != TimeWarp::TIER_USER) ImGui::Text("Fallback: %s", TimeWarp::tierName(timeWarp.tier));
+            }
+            ImGui::Checkbox("Fixed Timestep", &fixedTimestep);
+            if (fixedTimestep && !timeWarp.enabled) {
+                float stepMs = physicsStepSize * 1000.0f;
+                if (ImGui::SliderFloat("Physics Step (ms)", &stepMs, 1.0f, 50.0f, "%.2f")) physicsStepSize = stepMs / 1000.0f;
+                ImGui::SliderInt("Max Steps / Frame", &maxPhysicsStepsPerFrame, 1, 64);
+                ImGui::Text("Steps this frame: %d (alpha %.2f)", physicsStepsLastFrame, renderAlpha);
+            }
+            ImGui::Separator();
+            ImGui::Text("Physics:");
+            const char* backendNames[] = { "CPU", "GPU Compute", "Hybrid (CPU planets, GPU asteroids)" };
+            int previousBackend = physicsBackend;
+            // only the CPU's where vertex shaders cannot read the GPU backends' storage buffers (render_profile.h)
+            const int backendCount = renderProfile().vertexStorageBlocks ? 3 : 1;
+            if (ImGui::Combo("Physics Backend", &physicsBackend, backendNames, backendCount) && physicsBackend != previousBackend) {
+                // hand the current state over instead of restarting the simulation, a replay has no state to hand over
+                if (replayActive) stopReplay();
+                if (remoteActive) stopRemote();
+                if (asyncPhysics.running()) { asyncPhysics.stop(physics); asyncPhysicsEnabled = false; }
+                // out of the backend being left, then into the chosen one
+                const int chosenBackend = physicsBackend;
+                physicsBackend = previousBackend;
+                if (bodiesOnGpu()) downloadGpuBodies();
+                physicsBackend = chosenBackend;
+                if (physicsBackend != BACKEND_HYBRID) hybridNBody->release();
+                if (bodiesOnGpu()) uploadGpuBodies();
+                else {
+                    gpuNBody->release();
+                    setupAsteroidInstanceBuffers();
+                    updateAsteroidInstances();
+                }
+                physics.invalidate();
+            }
+            if (physicsBackend == BACKEND_HYBRID)
+                ImGui::Text("%u massive bodies in double, %u substeps last step", hybridNBody->massiveCount(), hybridNBody->substepsLastStep);
+            if (bodiesOnGpu())
+                ImGui::Text("Readback: %u frames late, %zu bytes in flight, %lu refused", gpuReadback->latency(), gpuReadback->bytesInFlight(),
+                            gpuReadback->refusedCount());
+            if (physicsBackend == BACKEND_CPU && !replayActive && !remoteActive && ImGui::Checkbox("Async Physics Thread", &asyncPhysicsEnabled)) {
+                if (asyncPhysicsEnabled) { timeWarp.restore(physics); asyncPhysics.start(physics); }
+                else asyncPhysics.stop(physics);
+                previousPositions.clear();
+            }
+            // while the physics thread owns the world, widgets edit this copy and the changes are posted to it below
+            const PhysicsSettings settingsBefore = physics.settings();
+            if (!asyncPhysics.running()) physics.stats(viewerStats);
+            const PhysicsStats& stats = asyncPhysics.running() ? asyncPhysics.latest().stats : viewerStats;
+            if (asyncPhysics.running())
+                ImGui::Text("Sim time: %.2f s, steps: %lu", asyncPhysics.latest().simTime, asyncPhysics.latest().stepCount);
+            if (ImGui::SliderFloat("G Scaled", &physics.G, 0.0f, 20000.0f, "%.0f")) physics.invalidate();
+            const char* integratorNames[INTEGRATOR_COUNT];
+            for (int t = 0; t < INTEGRATOR_COUNT; t++) integratorNames[t] = integratorName(static_cast<IntegratorType>(t));
+            if (ImGui::Combo("Integrator", &integratorType, integratorNames, INTEGRATOR_COUNT)) {
+                physics.integrator.type = static_cast<IntegratorType>(integratorType);
+                physics.integrator.invalidate();
+            }
+            if (ImGui::Checkbox("Block Timesteps", &physics.blockTimesteps)) physics.invalidate();
+            if (physics.blockTimesteps) {
+                ImGui::SliderFloat("Timestep Eta", &physics.blockStepper.eta, 0.001f, 0.2f, "%.3f", ImGuiSliderFlags_Logarithmic);
+                int maxLevel = static_cast<int>(physics.blockStepper.maxLevel);
+                if (ImGui::SliderInt("Max Level", &maxLevel, 0, 12)) {
+                    physics.blockStepper.maxLevel = static_cast<unsigned int>(maxLevel);
+                    physics.blockStepper.invalidate();
+                }
+                size_t n = std::max<size_t>(physics.bodies.size(), 1);
+                ImGui::Text("Events: %u, force evals: %lu (%.2f x N)", stats.blockEvents,
+                            stats.blockForceEvaluations, static_cast<double>(stats.blockForceEvaluations) / n);
+                for (size_t l = 0; l < stats.levelHistogram.size(); ++l)
+                    if (stats.levelHistogram[l] > 0)
+                        ImGui::Text("  level %zu (dt/%u): %u bodies", l, 1u << l, stats.levelHistogram[l]);
+            } else {
+                ImGui::Text("Force evaluations / step: %u", forceEvaluationsPerStep(physics.integrator.type));
+            }
+            if (ImGui::Checkbox("Keplerian Asteroids", &physics.keplerAsteroids)) physics.invalidate();
+            if (physics.keplerAsteroids) {
+                if (bodiesOnGpu()) ImGui::Text("(CPU backend only)");
+                ImGui::SliderFloat("Encounter Radius (Hill)", &physics.keplerHillFactor, 0.0f, 10.0f, "%.1f");
+                ImGui::Text("Analytic: %zu, integrated near planets: %zu", stats.keplerBodies, stats.keplerEncounters);
+            }
+            if (ImGui::Checkbox("Two-Body Close Encounters", &physics.closeEncounters)) physics.invalidate();
+            if (physics.closeEncounters) {
+                if (bodiesOnGpu()) ImGui::Text("(CPU backend only)");
+                if (!physics.encountersActive()) ImGui::Text("(Keplerian mode and block timesteps take precedence)");
+                ImGui::SliderFloat("Encounter Timescale", &physics.encounterTimescale, 0.001f, 1.0f, "%.3f s", ImGuiSliderFlags_Logarithmic);
+                ImGui::Text("Asteroids in an encounter: %zu", stats.closeEncounters);
+            }
+            if (ImGui::Checkbox("Multiple Timesteps (RESPA)", &physics.respa)) physics.invalidate();
+            if (physics.respa) {
+                if (bodiesOnGpu()) ImGui::Text("(CPU backend only)");
+                if (!physics.respaActive()) ImGui::Text("(Keplerian mode, belt sectors and block timesteps take precedence)");
+                int cycle = static_cast<int>(physics.respaSteps);
+                if (ImGui::SliderInt("Slow Force Every", &cycle, 2, 16, "%d steps")) physics.respaSteps = static_cast<unsigned int>(cycle);
+                ImGui::Text("Full force sums: %lu", stats.respaSlowSums);
+            }
+            if (ImGui::Checkbox("Multi-Rate Belt Sectors", &physics.beltSectors)) physics.invalidate();
+            if (physics.beltSectors) {
+                if (bodiesOnGpu()) ImGui::Text("(CPU backend only)");
+                if (!physics.sectorsActive()) ImGui::Text("(Keplerian mode takes precedence)");
+                int angular = static_cast<int>(physics.sectors.angularCount), radial = static_cast<int>(physics.sectors.radialCount);
+                if (ImGui::SliderInt("Angular Sectors", &angular, 1, 64)) physics.sectors.angularCount = static_cast<unsigned int>(angular);
+                if (ImGui::SliderInt("Radial Rings", &radial, 1, 16)) physics.sectors.radialCount = static_cast<unsigned int>(radial);
+                int levels = static_cast<int>(physics.sectors.maxLevel);
+                if (ImGui::SliderInt("Slowest Level", &levels, 0, 8, "every 2^%d steps"))
+                    physics.sectors.maxLevel = static_cast<unsigned int>(levels);
+                ImGui::SliderFloat("Full-Rate Radius", &physics.sectors.focusRadius, 0.0f, 1000.0f, "%.0f");
+                ImGui::Checkbox("Focus on Camera", &sectorFocusOnCamera);
+                // pins live next to the sectors on whichever thread owns the world
+                auto editPins = [](std::function<void(BeltSectors&)> edit) {
+                    if (asyncPhysics.running()) asyncPhysics.post([edit](PhysicsWorld& world) { edit(world.sectors); });
+                    else edit(physics.sectors);
+                };
+                const bool hasSun = physics.bodies.count(BODY_SUN) > 0;
+                const glm::dvec3 sunPos = hasSun ? renderPosition(physics.bodies.range(BODY_SUN).begin) : glm::dvec3(0.0);
+                if (ImGui::Button("Pin at Camera")) {
+                    const glm::dvec3 at = camera.Position - sunPos;
+                    editPins([at](BeltSectors& sectors) { sectors.togglePinAt(at); });
+                }
+                const uint32_t selected = physics.bodies.indexOf(selectedBodyId);
+                if (selected != BodyStore::INVALID_INDEX) {
+                    ImGui::SameLine();
+                    if (ImGui::Button("Pin at Selection")) {
+                        const glm::dvec3 at = renderPosition(selected) - sunPos;
+                        editPins([at](BeltSectors& sectors) { sectors.togglePinAt(at); });
+                    }
+                }
+                ImGui::SameLine();
+                if (ImGui::Button("Clear Pins"))
+                    editPins([](BeltSectors& sectors) { std::fill(sectors.pinned.begin(), sectors.pinned.end(), 0); });
+                ImGui::Text("Full rate: %zu asteroids, force sums: %zu of %zu bodies per step", stats.sectorFullRate,
+                            stats.sectorTargets, physics.bodies.size());
+                for (size_t l = 0; l < stats.sectorLevelBodies.size(); ++l)
+                    if (stats.sectorLevelBodies[l] > 0)
+                        ImGui::Text("  level %zu (every %u steps): %u asteroids", l, 1u << l, stats.sectorLevelBodies[l]);
+            }
+            ImGui::Checkbox("Asteroid Collisions", &physics.collisions);
+            if (physics.collisions) {
+                if (bodiesOnGpu()) ImGui::Text("(CPU backend only)");
+                ImGui::Text("Mergers: %lu (last step %u)", stats.mergers, stats.mergersLastStep);
+            }
+            ImGui::Checkbox("Morton Order Sorting", &physics.mortonSort);
+            if (physics.mortonSort) {
+                ImGui::SliderFloat("Re-sort Threshold", &physics.mortonThreshold, 0.0f, 0.5f, "%.2f");
+                ImGui::Text("Disorder: %.3f, sorts: %lu", stats.mortonDisorder, stats.mortonSorts);
+            }
+            ImGui::SliderInt("Physics Threads", &physics.threads, 1, static_cast<int>(workerPool().size()));
+            const char* solverNames[] = { "Brute Force O(N^2)", "Barnes-Hut Octree", "Test Particles O(N*M)", "Fast Multipole O(N)", "Particle Mesh (FFT)" };
+            if (ImGui::Combo("Gravity Solver", &physics.solver, solverNames, 5)) {
+                physics.invalidate();
+            }
+            if (physics.solver == SOLVER_BARNES_HUT) {
+                ImGui::SliderFloat("Opening Angle (theta)", &physics.theta, 0.0f, 1.5f, "%.2f");
+                if (bodiesOnGpu() && gpuBarnesHut) ImGui::Text("Tree nodes: %u (GPU)", gpuBarnesHut->nodeCount());
+                else ImGui::Text("Tree nodes: %zu", stats.treeNodes);
+            } else if (physics.solver == SOLVER_FMM) {
+                int order = static_cast<int>(physics.fmm.order);
+                if (ImGui::SliderInt("Expansion Order", &order, 1, static_cast<int>(FastMultipole::MAX_ORDER)))
+                    physics.fmm.order = static_cast<unsigned int>(order);
+                ImGui::SliderFloat("Acceptance Angle", &physics.fmm.theta, 0.1f, 0.9f, "%.2f");
+                int sample = static_cast<int>(physics.fmmValidationSample);
+                if (ImGui::SliderInt("Validation Sample", &sample, 0, 256))
+                    physics.fmmValidationSample = static_cast<unsigned int>(sample);
+                ImGui::Text("Tree nodes: %zu", stats.treeNodes);
+                if (physics.fmmValidationSample > 0) ImGui::Text("Max rel. error vs direct: %.2e", stats.fmmError);
+            } else if (physics.solver == SOLVER_PARTICLE_MESH) {
+                int gridLog = static_cast<int>(std::lround(std::log2(static_cast<double>(ParticleMesh::gridSize(physics.particleMesh.grid)))));
+                char gridLabel[16];
+                std::snprintf(gridLabel, sizeof(gridLabel), "%u^3", 1u << gridLog);
+                if (ImGui::SliderInt("Mesh Grid", &gridLog, 4, 7, gridLabel))
+                    physics.particleMesh.grid = 1u << gridLog;
+                ImGui::Checkbox("P3M Short-Range Pairs", &physics.particleMesh.shortRange);
+                if (physics.particleMesh.shortRange) {
+                    ImGui::SliderFloat("Split (cells)", &physics.particleMesh.splitCells, 0.5f, 3.0f, "%.2f");
+                    if (bodiesOnGpu()) ImGui::Text("(on the GPU only the sun and planets' pairs)");
+                    else ImGui::Text("Short-range pairs: %llu", stats.meshPairs);
+                }
+                if (physicsBackend == BACKEND_CPU) ImGui::Text("Cell size: %.2f", stats.meshCellSize);
+            } else {
+                if (physics.solver == SOLVER_TEST_PARTICLES)
+                    ImGui::Text("Massive bodies: %zu", stats.massiveBodies);
+                else
+                    ImGui::Checkbox("Asteroid Self-Gravity", &physics.asteroidSelfGravity);
+                const char* kernelNames[] = { "Scalar", "AVX2 (8-wide)", "AVX-512 (16-wide)" };
+                if (ImGui::Combo("Force Kernel", &physics.forceKernel, kernelNames, 3) && !gravityKernelSupported(static_cast<GravityKernel>(physics.forceKernel)))
+                    physics.forceKernel = bestGravityKernel();
+                if (physics.solver == SOLVER_BRUTE_FORCE) {
+                    ImGui::Checkbox("Validate Against Scalar", &physics.validateForceKernel);
+                    if (physics.validateForceKernel) ImGui::Text("Max rel. error: %.2e", stats.forceKernelError);
+                }
+            }
+            // the pair law and arithmetic of the CPU direct and tree solvers, each combination its own compiled loop
+            if (!bodiesOnGpu() && (physics.solver == SOLVER_BRUTE_FORCE || physics.solver == SOLVER_BARNES_HUT ||
+                                   physics.solver == SOLVER_TEST_PARTICLES)) {
+                const char* lawNames[] = { "Newtonian", "Plummer", "Cubic Spline" };
+                const char* precisionNames[] = { "Float", "Double", "Mixed (float pairs, double sums)" };
+                bool changed = ImGui::Combo("Force Law", &physics.forceLaw, lawNames, FORCE_LAWS);
+                changed |= ImGui::Combo("Force Precision", &physics.forcePrecision, precisionNames, FORCE_PRECISIONS);
+                if (changed) physics.invalidate();
+                if (physics.solver != SOLVER_BARNES_HUT && (physics.forceLaw != FORCE_NEWTONIAN || physics.forcePrecision != PRECISION_FLOAT))
+                    ImGui::TextDisabled("scalar loops, the SIMD kernels are Newtonian float");
+            }
+            if (ImGui::CollapsingHeader("Conserved Quantities")) {
+                int interval = static_cast<int>(physics.diagnosticsInterval);
+                if (ImGui::SliderInt("Sample Every N Steps (0 = off)", &interval, 0, 100))
+                    physics.diagnosticsInterval = static_cast<unsigned int>(interval);
+                if (stats.haveConserved) {
+                    const ConservedQuantities& q = stats.conserved;
+                    const ConservedQuantities& ref = stats.conservedReference;
+                    ImGui::Text("E %.6e (K %.3e, U %.3e)", q.total, q.kinetic, q.potential);
+                    const struct { const char* label; double (*drift)(const ConservedQuantities&, const ConservedQuantities&); } series[] = {
+                        { "Energy", [](const ConservedQuantities& a, const ConservedQuantities& b) { return relativeDrift(a.total, b.total); } },
+                        { "Momentum", [](const ConservedQuantities& a, const ConservedQuantities& b) { return relativeDrift(a.momentum, b.momentum); } },
+                        { "Angular Mom.", [](const ConservedQuantities& a, const ConservedQuantities& b) { return relativeDrift(a.angularMomentum, b.angularMomentum); } },
+                    };
+                    for (const auto& sr : series) {
+                        conservedPlot.clear();
+                        for (const ConservedQuantities& h : stats.conservedHistory)
+                            conservedPlot.push_back(static_cast<float>(sr.drift(h, ref)));
+                        char overlay[48];
+                        std::snprintf(overlay, sizeof(overlay), "%.2e", sr.drift(q, ref));
+                        ImGui::PlotLines(sr.label, conservedPlot.data(), static_cast<int>(conservedPlot.size()), 0, overlay,
+                                         FLT_MAX, FLT_MAX, ImVec2(0.0f, 50.0f));
+                    }
+                    ImGui::Text("Reference at t = %.2f s", ref.simTime);
+                } else if (physics.diagnosticsInterval > 0) {
+                    ImGui::Text("Waiting for the first sample");
+                }
+                if (ImGui::Button("Reset Reference")) {
+                    if (asyncPhysics.running()) asyncPhysics.post([](PhysicsWorld& world) { world.resetConservedReference(); });
+                    else physics.resetConservedReference();
+                }
+            }
+            const PhysicsSettings settingsAfter = physics.settings();
+            if (asyncPhysics.running() && settingsAfter != settingsBefore)
+                asyncPhysics.post([settingsAfter](PhysicsWorld& world) { world.applySettings(settingsAfter); });
+            ImGui::Separator();
+            if (ImGui::CollapsingHeader("Selection")) {
+                ImGui::Checkbox("GPU Picking", &gpuPicking);
+                ImGui::SameLine();
+                ImGui::TextDisabled(gpuPicking ? "(id buffer)" : "(CPU ray against the BVHs)");
+                static const char* typeNames[] = {"Sun", "Planet", "Asteroid"};
+                const uint32_t selected = physics.bodies.indexOf(selectedBodyId);
+                if (selected != BodyStore::INVALID_INDEX) {
+                    const glm::dvec3 p = physics.bodies.position[selected], v = physics.bodies.velocity[selected];
+                    ImGui::Text("Body %u: %s", selectedBodyId, typeNames[physics.bodies.typeOf(selected)]);
+                    ImGui::Text("Mass: %.3f", physics.bodies.mass[selected]);
+                    ImGui::Text("Position: %.2f, %.2f, %.2f", p.x, p.y, p.z);
+                    ImGui::Text("Velocity: %.3f, %.3f, %.3f", v.x, v.y, v.z);
+                    if (ImGui::Button("Clear Selection"))
+                        selectedBodyId = BodyStore::INVALID_INDEX;
+                    ImGui::SameLine();
+                    const auto pinned = std::find(pinnedPredictionIds.begin(), pinnedPredictionIds.end(), selectedBodyId);
+                    if (pinned == pinnedPredictionIds.end()) {
+                        if (ImGui::Button("Pin Prediction") && pinnedPredictionIds.size() + 1 < OrbitLines::MAX_PATHS) {
+                            pinnedPredictionIds.push_back(selectedBodyId);
+                            orbitPredictions = true;
+                        }
+                    } else if (ImGui::Button("Unpin Prediction")) {
+                        pinnedPredictionIds.erase(pinned);
+                    }
+                } else {
+                    ImGui::Text("Nothing selected, click a body");
+                }
+                ImGui::Text("Readback latency: %u frames", gpuPicker->latency());
+            }
+            if (ImGui::CollapsingHeader("Motion Trails")) {
+                ImGui::Checkbox("Show Trails", &motionTrails);
+                ImGui::SliderInt("Trailed Bodies", &trailBodies, 1, 1 << 20, "%d", ImGuiSliderFlags_Logarithmic);
+                ImGui::SliderInt("Trail Length", &trailLength, 2, 1024, "%d", ImGuiSliderFlags_Logarithmic);
+                ImGui::SliderFloat("Sample Interval (sim s)", &trailInterval, 1.0f / 240.0f, 1.0f, "%.4f", ImGuiSliderFlags_Logarithmic);
+                ImGui::SliderFloat("Trail Brightness", &trailBrightness, 0.05f, 4.0f, "%.2f", ImGuiSliderFlags_Logarithmic);
+                ImGui::Checkbox("Belt Rocks", &trailBeltRocks);
+                ImGui::SameLine();
+                ImGui::TextDisabled("(the GPU belt's instead of the bodies)");
+                static const char* sourceNames[] = {"off", "CPU upload", "GPU n-body", "GPU belt"};
+                ImGui::Text("Source: %s, %u trails of %u samples", sourceNames[trailSource], gpuTrails->bodyCount(), gpuTrails->samples());
+                ImGui::Text("Ring memory: %.1f MB", static_cast<double>(gpuTrails->bytes()) / (1024.0 * 1024.0));
+            }
+            if (ImGui::CollapsingHeader("Orbit Predictions")) {
+                ImGui::Checkbox("Show Predicted Paths", &orbitPredictions);
+                ImGui::SameLine();
+                ImGui::TextDisabled("(planets, selection, pinned)");
+                ImGui::Checkbox("Planets", &predictPlanets);
+                float horizon = static_cast<float>(predictionSettings.horizon);
+                if (ImGui::SliderFloat("Horizon (sim s)", &horizon, 0.5f, 60.0f, "%.1f", ImGuiSliderFlags_Logarithmic))
+                    predictionSettings.horizon = horizon;
+                int samples = static_cast<int>(predictionSettings.samples);
+                if (ImGui::SliderInt("Samples", &samples, 16, 4096, "%d", ImGuiSliderFlags_Logarithmic))
+                    predictionSettings.samples = static_cast<unsigned int>(samples);
+                int substeps = static_cast<int>(predictionSettings.substeps);
+                if (ImGui::SliderInt("Leapfrog Substeps", &substeps, 1, 32))
+                    predictionSettings.substeps = static_cast<unsigned int>(substeps);
+                float tolerance = static_cast<float>(predictionSettings.tolerance);
+                if (ImGui::SliderFloat("Recompute Tolerance", &tolerance, 1e-5f, 1e-1f, "%.5f", ImGuiSliderFlags_Logarithmic))
+                    predictionSettings.tolerance = tolerance;
+                ImGui::Checkbox("Kepler Orbits", &predictionSettings.kepler);
+                ImGui::SameLine();
+                ImGui::TextDisabled("(around the sun only)");
+                ImGui::SliderFloat("Line Brightness", &orbitLineBrightness, 0.1f, 8.0f);
+                if (!pinnedPredictionIds.empty() && ImGui::Button("Unpin All")) pinnedPredictionIds.clear();
+                if (bodiesOnGpu()) ImGui::TextDisabled("Not available with the GPU backend");
+                ImGui::Text("Paths: %zu, %zu vertices", orbitLines->pathCount(), orbitLines->vertexCount());
+                ImGui::Text("Recomputes: %lu, samples integrated: %lu", orbitPredictor.recomputes(), orbitPredictor.samplesComputed());
+                ImGui::Text("Worker: %.3f ms last update", orbitPredictor.workerMsLastUpdate());
+            }
+            if (ImGui::CollapsingHeader("Debug Draw")) {
+                ImGui::Checkbox("Velocities", &debugVelocities);
+                if (debugVelocities) ImGui::SliderFloat("Arrow Length (sim s)", &debugVelocityScale, 0.01f, 100.0f, "%.2f", ImGuiSliderFlags_Logarithmic);
+                ImGui::Checkbox("Bounding Spheres", &debugBodyBounds);
+                ImGui::SameLine();
+                ImGui::TextDisabled("(green in view, red culled)");
+                ImGui::SliderInt("Asteroid Limit", &debugAsteroidLimit, 0, 250000);
+                ImGui::Checkbox("Body Octree Cells", &debugOctreeCells);
+                ImGui::Checkbox("Barnes-Hut Cells", &debugTreeCells);
+                if (debugTreeCells) ImGui::SliderInt("Tree Depth", &debugTreeDepth, 0, 16);
+                if (debugTreeCells && asyncPhysics.running()) ImGui::TextDisabled("Not available with async physics");
+                ImGui::Checkbox("Light Ranges", &debugLightRanges);
+                ImGui::Checkbox("Over the Scene", &debugOverlay);
+                ImGui::Text("Primitives: %zu lines, %zu shapes, %zu dropped", debugDraw->lineCount(), debugDraw->shapeCount(), debugDraw->droppedCount());
+            }
+            if (ImGui::CollapsingHeader("Sun Properties")) {
+                bool sunChanged = ImGui::SliderFloat("Sun Mass", &sunMass, 1000.0f, 100000.0f, "%.0f");
+                sunChanged |= ImGui::SliderFloat("Sun Radius Scale", &sunRadiusScale, 1.0f, 50.0f);
+                if (sunChanged && physics.bodies.count(BODY_SUN) > 0) {
+                    size_t sun = physics.bodies.range(BODY_SUN).begin;
+                    physics.bodies.mass[sun] = sunMass;
+                    physics.bodies.render[sun].radiusScale = sunRadiusScale;
+                    physics.invalidate();
+                    if (asyncPhysics.running()) {
+                        float mass = sunMass;
+                        asyncPhysics.post([sun, mass](PhysicsWorld& world) {
+                            world.bodies.mass[sun] = mass;
+                            world.invalidate();
+                        });
+                    }
+                    if (bodiesOnGpu()) {
+                        gpuNBody->setMass(static_cast<unsigned int>(sun), sunMass);
+                        gpuNBody->setScale(static_cast<unsigned int>(sun), sunRadiusScale);
+                    }
+                    if (physicsBackend == BACKEND_HYBRID) hybridNBody->setMass(static_cast<unsigned int>(sun), sunMass);
+                    // No full reset needed for sun mass/scale only, but orbits will be affected.
+                }
+            }
+            if (ImGui::CollapsingHeader("Planet Properties")) {
+                 ImGui::SliderFloat("Planet Mass", &planetMass, 1.0f, 1000.0f);
+                 ImGui::SliderFloat("Planet Radius Scale", &planetRadiusScale, 0.1f, 10.0f);
+                 ImGui::SliderFloat("Planet Orbit Radius", &planetOrbitRadius, 10.0f, 300.0f);
+                 ImGui::SliderFloat("Planet Initial Angle", &planetInitialAngle, 0.0f, 360.0f);
+                 ImGui::Checkbox("Multi-Draw Indirect", &batchedModelDraws);
+                 ImGui::Checkbox("Instanced Planets and Moons", &instancedPlanets);
+                 ImGui::Checkbox("Automatic Instancing", &autoInstancing);
+                 if (instancedPlanets && planetInstances)
+                     ImGui::Text("Planet instances: %u shaded of %u, %zu draws", planetInstances->visibleCount(), planetInstances->count(),
+                                 planetModelPtr ? planetModelPtr->meshes.size() : size_t(0));
+                 ImGui::Checkbox("Deferred Shading", &deferredShading);
+                 ImGui::Checkbox("Sun Shadows", &sunShadows);
+                 if (sunShadows) {
+                     ImGui::Checkbox("Soft Sun Shadows", &softSunShadows);
+                     if (softSunShadows)
+                         ImGui::SliderInt("Shadow Blur", &sunShadowBlur, 1, static_cast<int>(MomentBlur::MAX_RADIUS), "%d texels");
+                 }
+                 if (planetBatchPtr && planetBatchPtr->valid())
+                     ImGui::Text("Draw calls: %u", batchedModelDraws ? 1u : planetBatchPtr->drawCount());
+                 ImGui::Checkbox("Quadtree Terrain", &planetTerrainEnabled);
+                 if (planetTerrainEnabled) {
+                     ImGui::SliderFloat("Terrain Pixel Error", &planetTerrain->pixelError, 1.0f, 16.0f, "%.1f px");
+                     int terrainLevels = static_cast<int>(planetTerrain->maxLevel);
+                     if (ImGui::SliderInt("Terrain Max Level", &terrainLevels, 0, 20)) planetTerrain->maxLevel = static_cast<unsigned int>(terrainLevels);
+                     ImGui::SliderFloat("Terrain Relief", &planetTerrain->heightScale, 0.0f, 0.2f, "%.3f");
+                     ImGui::Text("%zu nodes to level %u, %.1fk triangles", planetTerrain->nodeCount(), planetTerrain->deepestLevel(),
+                                 planetTerrain->triangles() / 1000.0);
+                 }
+                 ImGui::Checkbox("Atmospheres", &planetAtmospheres);
+                 if (planetAtmospheres) {
+                     // the tables are rebuilt once a slider is let go, not on every step of the drag
+                     Atmosphere::Parameters& air = atmosphereParameters;
+                     ImGui::SliderFloat("Atmosphere Thickness", &air.thickness, 0.01f, 0.5f, "%.3f radii");
+                     atmosphereStale |= ImGui::IsItemDeactivatedAfterEdit();
+                     ImGui::SliderFloat3("Rayleigh Depth", &air.rayleighDepth.x, 0.0f, 1.0f, "%.3f");
+                     atmosphereStale |= ImGui::IsItemDeactivatedAfterEdit();
+                     ImGui::SliderFloat("Mie Depth", &air.mieDepth, 0.0f, 0.5f, "%.4f", ImGuiSliderFlags_Logarithmic);
+                     atmosphereStale |= ImGui::IsItemDeactivatedAfterEdit();
+                     ImGui::SliderFloat("Mie Anisotropy", &air.mieG, 0.0f, 0.95f, "%.2f");
+                     atmosphereStale |= ImGui::IsItemDeactivatedAfterEdit();
+                     ImGui::SliderInt("Scattering Orders", &air.scatteringOrders, 1, 8);
+                     atmosphereStale |= ImGui::IsItemDeactivatedAfterEdit();
+                     ImGui::SliderFloat("Atmosphere Brightness", &atmosphere->brightness, 0.1f, 32.0f, "%.1f", ImGuiSliderFlags_Logarithmic);
+                     if (atmosphere->ready())
+                         ImGui::Text("Scattering tables ready");
+                     else
+                         ImGui::Text("Scattering tables %.0f%%", 100.0f * atmosphere->progress());
+                 }
+                 if (planetSurface) {
+                     ImGui::Checkbox("Virtual Surface", &planetSurfaceEnabled);
+                     ImGui::SameLine();
+                     ImGui::Text("%ux%u, %s", planetSurface->width(), planetSurface->height(), planetSurface->sparse() ? "sparse" : "page cache");
+                     ImGui::SliderFloat("Surface LOD Bias", &planetSurface->lodBias, -2.0f, 4.0f, "%.1f");
+                     int surfaceUploads = static_cast<int>(planetSurface->uploadsPerFrame);
+                     if (ImGui::SliderInt("Surface Pages/Frame", &surfaceUploads, 1, 64)) planetSurface->uploadsPerFrame = static_cast<unsigned int>(surfaceUploads);
+                     ImGui::Text("%zu/%u pages resident, %zu loading, feedback %u frames", planetSurface->residentPages(),
+                                 planetSurface->residentCapacity(), planetSurface->loading(), planetSurface->feedbackLatency());
+                     ImGui::Text("%.1f MB on the GPU of %.1f MB, %lu uploads, %lu evictions", planetSurface->gpuBytes() / (1024.0 * 1024.0),
+                                 planetSurface->virtualBytes() / (1024.0 * 1024.0), planetSurface->uploads(), planetSurface->evictions());
+                 }
+            }
+            if (ImGui::CollapsingHeader("Asteroid Properties")) {
+                // the direct sum is O(N^2), so large belts are only offered with the tree solver
+                int maxAsteroids = (physics.solver != SOLVER_BRUTE_FORCE || bodiesOnGpu()) ? 1000000 : 5000;
+                if (renderProfile().es()) maxAsteroids = std::min(maxAsteroids, 50000);
+                bool asteroidAmountChanged = ImGui::SliderInt("Asteroid Count", (int*)&asteroidAmount, 0, maxAsteroids);
+                ImGui::SliderFloat("Avg. Asteroid Mass", &avgAsteroidMass, 0.001f, 1.0f, "%.3f");
+                ImGui::SliderFloat("Min Asteroid Scale", &minAsteroidScale, 0.01f, 0.5f);
+                ImGui::SliderFloat("Max Asteroid Scale", &maxAsteroidScale, 0.05f, 1.0f);
+                ImGui::SliderFloat("Belt Inner Radius", &asteroidBeltInnerRadius, 20.0f, 500.0f);
+                ImGui::SliderFloat("Belt Outer Radius", &asteroidBeltOuterRadius, 50.0f, 600.0f);
+                ImGui::SliderFloat("Belt Height", &asteroidBeltHeight, 1.0f, 50.0f);
+                if (!scenarioPath.empty()) ImGui::TextDisabled("%s sets the bodies, these apply without it", scenarioPath.c_str());
+                if (asteroidAmountChanged && (galaxyScene || !scenarioPath.empty())) asteroidAmount = static_cast<unsigned int>(physics.bodies.count(BODY_ASTEROID));
+                else if (asteroidAmountChanged && !replayActive && !remoteActive) resizeAsteroidBelt();
+                // positions relative to 256-instance chunks, tight when Morton sorting keeps a chunk together
+                if (ImGui::Checkbox("Quantized Instances", &quantizedInstances)) {
+                    setupAsteroidInstanceBuffers();
+                    updateAsteroidInstances();
+                }
+                ImGui::Checkbox("Frustum Culling", &frustumCulling);
+                if (frustumCulling) ImGui::Checkbox("Occlusion Culling (GPU paths)", &occlusionCulling);
+                if (frustumCulling) ImGui::Checkbox("Front-to-Back Rocks (GPU paths)", &frontToBackRocks);
+                ImGui::Checkbox("Depth Pre-pass", &depthPrepass);
+                ImGui::Checkbox("Position-Only Depth Streams", &positionStreams);
+                ImGui::Checkbox("Sphere Impostors (suns, planets)", &sphereImpostors);
+                if (!sphereImpostors) {
+                    ImGui::Checkbox("Tessellated Spheres (sun, terrain planet)", &tessellatedSpheres);
+                    if (tessellatedSpheres) {
+                        ImGui::SliderFloat("Pixels per Edge", &tessellatedSphere.pixelsPerEdge, 1.0f, 64.0f, "%.0f px", ImGuiSliderFlags_Logarithmic);
+                        ImGui::Text("Sun: about %.1fk triangles", tessellatedSunTriangles / 1000.0);
+                    }
+                }
+                ImGui::Text("Rock variants: %u shapes (GPU-culled belts), %u texture layers", rockVariantCount, rockVariants->textureLayers());
+                ImGui::SliderFloat3("LOD Pixels", asteroidLodPixels, 1.0f, 200.0f, "%.0f", ImGuiSliderFlags_Logarithmic);
+                ImGui::Checkbox("Point Impostors", &asteroidImpostors);
+                if (asteroidImpostors) ImGui::SliderFloat("Impostor Distance", &impostorDistance, 20.0f, 2000.0f, "%.0f", ImGuiSliderFlags_Logarithmic);
+                if (!bodiesOnGpu()) {
+                    ImGui::Text("Drawn: %u of %u", asteroidInstancesPacked, asteroidAmount);
+                    ImGui::Text("Per LOD: %u / %u / %u / %u, impostors %u", asteroidLodCount[0], asteroidLodCount[1], asteroidLodCount[2], asteroidLodCount[3],
+                                asteroidLodCount[IMPOSTOR_BIN]);
+                }
+                if (!bodiesOnGpu())
+                    ImGui::Text("Instance upload: %.1f MB/frame", instanceUploadBytes() / (1024.0 * 1024.0));
+            }
+            if (ImGui::CollapsingHeader("Visual Belt (GPU only)")) {
+                // the rocks are not bodies: no gravity, no collisions, and no CPU work however many there are
+                if (ImGui::Checkbox("GPU Visual Belt", &gpuBeltEnabled)) {
+                    if (gpuBeltEnabled) {
+                        // the belt replaces the simulated asteroids, the CPU then only steps the sun and planets
+                        if (!replayActive && !remoteActive && asteroidAmount > 0) {
+                            asteroidAmount = 0;
+                            resizeAsteroidBelt();
+                        }
+                        respawnGpuBelt();
+                    } else {
+                        gpuBelt->release();
+                    }
+                }
+                ImGui::SliderInt("Rocks", &gpuBeltCount, 0, 4000000, "%d", ImGuiSliderFlags_Logarithmic);
+                if (gpuBeltEnabled && ImGui::Button("Respawn Belt")) respawnGpuBelt();
+                if (gpuBeltEnabled) ImGui::Text("%u rocks, shape from Asteroid Properties", gpuBelt->rockCount());
+            }
+            if (ImGui::CollapsingHeader("Gas Disk (SPH)")) {
+                // the gas is stepped and drawn on the GPU whatever the backend, only the CPU's massive bodies go up
+                if (ImGui::Checkbox("Gas Disk", &gasEnabled)) respawnGas();
+                int particles = static_cast<int>(gasParams.count);
+                if (ImGui::SliderInt("Particles", &particles, 1000, 4000000, "%d", ImGuiSliderFlags_Logarithmic))
+                    gasParams.count = static_cast<unsigned int>(particles);
+                ImGui::SliderFloat("Inner Radius", &gasParams.innerRadius, 10.0f, 400.0f, "%.0f");
+                ImGui::SliderFloat("Outer Radius", &gasParams.outerRadius, 20.0f, 800.0f, "%.0f");
+                ImGui::SliderFloat("Aspect Ratio", &gasParams.aspectRatio, 0.01f, 0.2f, "%.3f");
+                ImGui::SliderFloat("Disk Mass", &gasParams.diskMass, 1.0f, 4000.0f, "%.0f", ImGuiSliderFlags_Logarithmic);
+                if (gasEnabled && ImGui::Button("Respawn Gas")) respawnGas();
+                ImGui::SliderFloat("Viscosity", &gasDisk->alpha, 0.0f, 2.0f, "%.2f");
+                ImGui::SliderFloat("Accretion Radius", &gasDisk->accretionRadius, 0.0f, 50.0f, "%.1f");
+                ImGui::SliderFloat("Gas Brightness", &gasCloud->brightness, 0.001f, 1.0f, "%.3f", ImGuiSliderFlags_Logarithmic);
+                if (gasEnabled)
+                    ImGui::Text("%u particles, h %.2f, %u substeps, %.1f MB", gasDisk->particleCount(), gasDisk->smoothingLength(),
+                                gasDisk->substepsLastStep, gasDisk->gpuBytes() / (1024.0 * 1024.0));
+                if (gasEnabled && bodiesOnGpu() && physicsBackend != BACKEND_GPU_COMPUTE)
+                    ImGui::TextDisabled("The hybrid backend's bodies pull the gas, it does not pull them");
+                else if (gasEnabled && !bodiesOnGpu())
+                    ImGui::TextDisabled("The CPU's bodies pull the gas, it does not pull them");
+            }
+            if (ImGui::CollapsingHeader("Galaxy Collision")) {
+                // the cores carry the mass, the stars feel only them, so a step is one core per star
+                ImGui::SliderInt("Stars", &galaxyStars, 10000, 10000000, "%d", ImGuiSliderFlags_Logarithmic);
+                ImGui::SliderFloat("Pericentre", &galaxyPericentre, 10.0f, 600.0f, "%.0f");
+                ImGui::SliderFloat("Disk Tilt", &galaxyTilt, 0.0f, 180.0f, "%.0f deg");
+                if (renderProfile().vertexStorageBlocks && ImGui::Button(galaxyScene ? "Restart Collision" : "Start Galaxy Collision")) startGalaxyScene();
+                if (galaxyScene) {
+                    ImGui::SameLine();
+                    if (ImGui::Button("Back to the Solar System")) stopGalaxyScene();
+                }
+                ImGui::Checkbox("Bodies as Points (GPU backend)", &pointCloudMode);
+                if (pointCloudMode) {
+                    ImGui::SliderFloat("Star Brightness", &pointCloud->brightness, 0.001f, 10.0f, "%.3f", ImGuiSliderFlags_Logarithmic);
+                    ImGui::SliderFloat("Point Size", &pointCloud->pointSize, 1.0f, 6.0f, "%.1f px");
+                }
+                ImGui::Checkbox("Log-Luminance Tone Mapping", &sceneTarget->logLuminance);
+                if (sceneTarget->logLuminance) ImGui::SliderFloat("Log White", &sceneTarget->logWhite, 1.0f, 100000.0f, "%.0f", ImGuiSliderFlags_Logarithmic);
+                if (pointCloudMode && !bodiesOnGpu()) ImGui::TextDisabled("Points need the GPU backend, the CPU draws rocks");
+                ImGui::Checkbox("Belt as Density Map (GPU backend)", &densityMapMode);
+                if (densityMapMode) {
+                    int resolution = static_cast<int>(densityMap->resolution);
+                    if (ImGui::SliderInt("Map Resolution", &resolution, 64, 2048)) densityMap->resolution = static_cast<unsigned int>(resolution);
+                    ImGui::SliderFloat("Map Extent", &densityMap->extent, 10.0f, 5000.0f, "%.0f", ImGuiSliderFlags_Logarithmic);
+                    ImGui::SliderFloat("Map Blur", &densityMap->blurRadius, 0.0f, 8.0f, "%.1f texels");
+                    ImGui::SliderFloat("Map Exposure", &densityMap->exposure, 0.1f, 4.0f, "%.2f");
+                    ImGui::SliderFloat("Map Opacity", &densityMap->opacity, 0.0f, 1.0f, "%.2f");
+                    if (!bodiesOnGpu()) ImGui::TextDisabled("The map needs the GPU backend, the CPU draws rocks");
+                }
+            }
+            if (universe.running() && ImGui::CollapsingHeader("Universe")) {
+                const WorldStreamer::Stats stats = universe.stats();
+                ImGui::Text("Cell (%d, %d, %d)", stats.activeCell.x, stats.activeCell.y, stats.activeCell.z);
+                ImGui::Text("%zu systems resident, %zu loading, %lu loaded, %lu evicted", stats.resident, stats.loading, stats.loaded, stats.evicted);
+                ImGui::Text("%zu far bodies, %.2f s behind at most", stats.farBodies, stats.lag);
+                float loadRadius = static_cast<float>(universe.loadRadius), evictRadius = static_cast<float>(universe.evictRadius);
+                if (ImGui::SliderFloat("Load Radius", &loadRadius, 500.0f, 20000.0f, "%.0f", ImGuiSliderFlags_Logarithmic))
+                    universe.loadRadius = loadRadius;
+                // a system evicted within the load radius would come straight back
+                if (ImGui::SliderFloat("Evict Radius", &evictRadius, loadRadius, 30000.0f, "%.0f", ImGuiSliderFlags_Logarithmic))
+                    universe.evictRadius = evictRadius;
+                universe.evictRadius = std::max(universe.evictRadius, universe.loadRadius * 1.2);
+            }
+            if (worldRebuild) {
+                ImGui::TextDisabled("Building the new world...");
+            } else if (ImGui::Button(remoteActive ? "Disconnect" : "Reset Simulation Full")) {
+                if (replayActive) stopReplay();
+                else if (remoteActive) stopRemote();
+                else resetSimulationInBackground();
+            }
+            if (remoteActive && ImGui::CollapsingHeader("Remote Server")) {
+                ImGui::Text("%s: %s", stateClient.address().c_str(), stateClient.ready() ? "streaming" : "waiting for the body table");
+                ImGui::Text("%zu bodies, %llu snapshots, %llu incomplete, %.1f MB received", stateClient.bodyCount(),
+                            stateClient.snapshotsCompleted(), stateClient.snapshotsAbandoned(), stateClient.bytesReceived() / (1024.0 * 1024.0));
+                ImGui::Text("%.3f s behind the newest snapshot, sim rate %.2fx", stateClient.endTime() - remoteTime, stateClient.simRate());
+            }
+            if (ImGui::CollapsingHeader("Trajectory Recording")) {
+                bool recording = trajectoryRecorder.recording();
+                if (!recording) {
+                    ImGui::SliderInt("Record Every N Steps", &recordInterval, 1, 100);
+                    ImGui::SliderFloat("Quantum (0 = lossless)", &recordQuantum, 0.0f, 0.1f, "%.4f");
+                }
+                if (bodiesOnGpu()) ImGui::Text("(CPU backend only)");
+                else if (!replayActive && !remoteActive && ImGui::Button(recording ? "Stop Recording" : "Start Recording")) toggleRecording();
+                ImGui::Text("%s: %llu frames, %llu dropped, %.1f MB", trajectoryPath, trajectoryRecorder.writtenFrames(),
+                            trajectoryRecorder.droppedFrames(), trajectoryRecorder.writtenBytes() / (1024.0 * 1024.0));
+                if (physicsBackend == BACKEND_CPU && !recording && !remoteActive && ImGui::Button(replayActive ? "Stop Replay" : "Replay Recording")) {
+                    if (replayActive) stopReplay();
+                    else startReplay();
+                }
+                if (replayActive) {
+                    float t = static_cast<float>(replayTime);
+                    if (ImGui::SliderFloat("Replay Time", &t, static_cast<float>(trajectoryPlayer.startTime()),
+                                           static_cast<float>(trajectoryPlayer.endTime()), "%.2f s"))
+                        replayTime = t;
+                    ImGui::SliderFloat("Replay Speed", &replaySpeed, -20.0f, 20.0f, "%.2fx");
+                    ImGui::Checkbox("Loop", &replayLoop);
+                    ImGui::Text("%zu bodies, %zu frames in %zu chunks", trajectoryPlayer.bodyCount(),
+                                trajectoryPlayer.frameCount(), trajectoryPlayer.chunkCount());
+                }
+            }
+            if (!replayActive && !remoteActive) {
+                if (ImGui::Button("Save Snapshot")) saveSnapshot();
+                ImGui::SameLine();
+                if (ImGui::Button("Load Snapshot")) loadSnapshot();
+            }
+            if (!snapshotStatus.empty()) {
+                if (!snapshotWriter.busy() && snapshotStatus.compare(0, 7, "writing") == 0)
+                    snapshotStatus = snapshotWriter.lastSucceeded() ? "saved " + std::string(snapshotPath) : "snapshot write failed";
+                ImGui::Text("%s", snapshotStatus.c_str());
+            }
+            if (ImGui::CollapsingHeader("Resolution")) {
+                // the scene's pixels, the UI is always drawn at the window's
+                ImGui::Checkbox("Dynamic Resolution", &dynamicResolution.enabled);
+                if (dynamicResolution.enabled) {
+                    ImGui::SliderFloat("GPU Target (ms)", &dynamicResolution.targetMs, 4.0f, 33.0f, "%.1f");
+                    ImGui::SliderFloat("Min Scale", &dynamicResolution.minScale, 0.25f, 1.0f, "%.2f");
+                } else {
+                    float fixedScale = dynamicResolution.scale;
+                    if (ImGui::SliderFloat("Scale", &fixedScale, dynamicResolution.minScale, dynamicResolution.maxScale, "%.2f"))
+                        dynamicResolution.setScale(fixedScale);
+                }
+                const char* antiAliasingNames[] = { "None", "MSAA", "FXAA", "SMAA", "TAA" };
+                int mode = antiAliasing;
+                if (ImGui::Combo("Anti-aliasing", &mode, antiAliasingNames, AA_MODES))
+                    antiAliasing = static_cast<AntiAliasing>(mode);
+                if (antiAliasing == AA_MSAA)
+                    ImGui::SliderInt("MSAA Samples", &sceneSamples, 2, 8);
+                ImGui::Text("Scene: %d x %d (%.0f%%)", sceneTarget->width(), sceneTarget->height(), dynamicResolution.scale * 100.0f);
+                // past the resolution: LODs, impostors, the shadow, MSAA, physics steps and trails
+                ImGui::Checkbox("Quality Governor", &qualityGovernor.enabled);
+                if (qualityGovernor.enabled) {
+                    ImGui::SliderFloat("Frame Target (ms)", &qualityGovernor.targetMs, 4.0f, 33.0f, "%.1f");
+                    ImGui::Text("GPU level %u: %s", qualityGovernor.gpuLadder().level, QualityGovernor::gpuLevelName(qualityGovernor.gpuLadder().level));
+                    ImGui::Text("CPU level %u: %s", qualityGovernor.cpuLadder().level, QualityGovernor::cpuLevelName(qualityGovernor.cpuLadder().level));
+                }
+                if (outputWindows.panels() > 1)
+                    ImGui::Text("%u panels, this window shows panel %u", outputWindows.panels(), outputWindows.mainPanel() + 1);
+                if (!shadingRatesAvailable)
+                    ImGui::TextDisabled("Variable-rate shading needs GL_NV_shading_rate_image");
+                else {
+                    ImGui::Checkbox("Variable-Rate Shading", &variableRateShading);
+                    if (variableRateShading) {
+                        ImGui::SliderFloat("Dark Below", &shadingRates->darkLuminance, 0.0f, 0.5f, "%.3f");
+                        ImGui::SliderFloat("Edge Contrast", &shadingRates->edgeContrast, 0.01f, 0.5f, "%.3f");
+                        ImGui::SliderFloat("Fovea Radius", &shadingRates->foveaRadius, 0.0f, 1.5f, "%.2f");
+                        ImGui::SliderFloat2("Fovea Centre", &shadingRates->foveaCentre.x, 0.0f, 1.0f, "%.2f");
+                        const glm::ivec2 rateSize = shadingRates->size(), tile = shadingRates->tileSize();
+                        ImGui::Text("Rate image: %d x %d tiles of %d x %d", rateSize.x, rateSize.y, tile.x, tile.y);
+                    }
+                }
+            }
+            if (ImGui::CollapsingHeader("Stereo")) {
+                ImGui::Checkbox("Side-by-Side Stereo", &stereoCamera.enabled);
+                if (outputWindows.panels() > 1) ImGui::TextDisabled("off while there are output windows");
+                if (stereoCamera.enabled) {
+                    ImGui::SliderFloat("Eye Separation", &stereoCamera.separation, 0.0f, 5.0f, "%.2f");
+                    ImGui::SliderFloat("Convergence", &stereoCamera.convergence, 1.0f, 3000.0f, "%.0f", ImGuiSliderFlags_Logarithmic);
+                    ImGui::Text("Eyes: %d x %d each", stereoEyeWidth, stereoEyeHeight);
+                    ImGui::TextDisabled("forward shading, no occlusion culling, TAA or variable-rate shading");
+                }
+            }
+            if (ImGui::CollapsingHeader("Tone Mapping")) {
+                ImGui::SliderFloat("Exposure", &sceneTarget->exposure, 0.1f, 4.0f, "%.2f");
+                ImGui::Checkbox("Bloom", &sceneTarget->bloomEnabled);
+                if (sceneTarget->bloomEnabled) {
+                    ImGui::SliderFloat("Bloom Strength", &sceneTarget->bloomStrength, 0.0f, 0.5f, "%.3f");
+                    ImGui::SliderFloat("Bloom Threshold", &sceneTarget->bloom.threshold, 0.0f, 4.0f, "%.2f");
+                    ImGui::SliderFloat("Bloom Knee", &sceneTarget->bloom.knee, 0.0f, 1.0f, "%.2f");
+                    ImGui::Text("Bloom levels: %u", sceneTarget->bloom.levels());
+                }
+            }
+            if (ImGui::CollapsingHeader("Overdraw")) {
+                ImGui::Checkbox("Overdraw Heat Map", &sceneTarget->overdrawView);
+                if (sceneTarget->overdrawView) {
+                    ImGui::Checkbox("Count Depth-Rejected Fragments", &sceneTarget->overdrawHidden);
+                    ImGui::SliderFloat("Layers to White", &sceneTarget->overdrawScale, 2.0f, 255.0f, "%.0f", ImGuiSliderFlags_Logarithmic);
+                    ImGui::TextDisabled("black, blue, green, yellow, red, white; discarded fragments are not counted");
+                }
+            }
+            if (starField->loaded() && ImGui::CollapsingHeader("Star Catalog")) {
+                ImGui::Checkbox("Catalog Sky", &starCatalogSky);
+                ImGui::SliderFloat("Limiting Magnitude", &starField->limitingMagnitude, 0.0f, 12.0f, "%.1f");
+                ImGui::SliderFloat("Zoom Gain", &starField->zoomMagnitudes, 0.0f, 5.0f, "%.1f mag");
+                ImGui::SliderFloat("Star Size", &starField->pointSize, 1.0f, 4.0f, "%.1f px");
+                ImGui::SliderFloat("Star Brightness", &starField->brightness, 0.05f, 4.0f, "%.2f");
+                ImGui::Text("%zu stars in %zu chunks, %.1f MB, limit %.1f", starField->starCount(), starField->chunkCount(),
+                            starField->gpuBytes() / (1024.0 * 1024.0), starField->magnitudeLimit());
+            }
+            if (ImGui::CollapsingHeader("Reflections")) {
+                ImGui::Checkbox("Planet Reflections", &planetReflections);
+                if (planetReflections) {
+                    int faces = static_cast<int>(reflectionFacesPerFrame);
+                    if (ImGui::SliderInt("Faces / Frame", &faces, 0, 6)) reflectionFacesPerFrame = static_cast<unsigned int>(faces);
+                    int size = static_cast<int>(reflectionProbe->resolution());
+                    if (ImGui::SliderInt("Probe Size", &size, 32, 512)) reflectionProbe->setResolution(static_cast<unsigned int>(size));
+                    ImGui::SliderFloat("Reflectivity", &planetReflectivity, 0.0f, 1.0f, "%.3f");
+                    ImGui::SliderFloat("Roughness", &planetRoughness, 0.0f, 1.0f, "%.2f");
+                    ImGui::Text("Faces drawn: %u, levels: %u", reflectionProbe->facesDrawn(), reflectionProbe->levels());
+                    if (deferredShading || sphereImpostors) ImGui::TextDisabled("forward shading without impostors only");
+                }
+            }
+            if (ImGui::CollapsingHeader("Frame Schedule")) {
+                const char* presentModeNames[] = { "Vsync", "Adaptive Vsync", "Uncapped" };
+                int mode = presentMode;
+                if (ImGui::Combo("Present Mode", &mode, presentModeNames, PRESENT_MODES) && mode != presentMode) {
+                    presentMode = static_cast<PresentMode>(mode);
+                    applyPresentMode(window);
+                }
+                float fpsLimit = static_cast<float>(framePacer.fpsLimit);
+                if (ImGui::SliderFloat("FPS Limit (0 = off)", &fpsLimit, 0.0f, 240.0f, "%.0f"))
+                    framePacer.fpsLimit = fpsLimit;
+                int framesInFlight = static_cast<int>(framePacer.framesInFlight);
+                if (ImGui::SliderInt("Frames in Flight (0 = driver)", &framesInFlight, 0, static_cast<int>(FramePacer::MAX_FRAMES_IN_FLIGHT)))
+                    framePacer.framesInFlight = static_cast<unsigned int>(framesInFlight);
+                ImGui::Text("Waited %.2f ms for the GPU queue, %.2f ms in the limiter", framePacer.queueWaitMs(), framePacer.limiterWaitMs());
+                ImGui::Checkbox("On-Demand Rendering", &onDemandRendering);
+                if (onDemandRendering) {
+                    ImGui::SameLine();
+                    ImGui::Text("%lu idle waits", idleWaits);
+                }
+                ImGui::Checkbox("Late-Latched Camera", &lateLatching);
+                if (lateLatching) {
+                    ImGui::SameLine();
+                    ImGui::Text("turned %.3f deg, %u camera writes", lateLatchDegrees, cameraUniforms.writesLastFrame());
+                }
+                if (ImGui::Button("Write Trace (F9)")) writeTrace();
+                if (!traceStatus.empty()) {
+                    ImGui::SameLine();
+                    ImGui::Text("%s", traceStatus.c_str());
+                }
+                if (ImGui::Button("Record Camera Key (F7)")) recordCameraKey();
+                if (!cameraPathStatus.empty()) {
+                    ImGui::SameLine();
+                    ImGui::Text("%s", cameraPathStatus.c_str());
+                }
+                if (ImGui::Button("Screenshot (F12)")) takeScreenshot();
+                ImGui::SameLine();
+                if (ImGui::Button(frameCapture->recording() ? "Stop Recording (F10)" : "Record Video (F10)")) toggleVideo();
+                if (frameCapture->recording())
+                    ImGui::Text("%lu frames to %s, %lu stalls", frameCapture->frames(), videoPath.c_str(), frameCapture->stalls());
+                else if (!frameCapture->status().empty())
+                    ImGui::Text("%s", frameCapture->status().c_str());
+                // last frame's graph on a shared time axis, main thread tasks in blue, helper tasks in orange
+                const std::vector<TaskGraph::TaskTiming>& schedule = frameGraph.timings();
+                float span = 0.0f;
+                for (const TaskGraph::TaskTiming& t : schedule) span = std::max(span, t.endMs);
+                ImDrawList* drawList = ImGui::GetWindowDrawList();
+                const float barWidth = ImGui::GetContentRegionAvail().x * 0.4f;
+                const float barHeight = ImGui::GetTextLineHeight();
+                for (const TaskGraph::TaskTiming& t : schedule) {
+                    if (!t.name) continue;
+                    ImVec2 origin = ImGui::GetCursorScreenPos();
+                    float x0 = origin.x + (span > 0.0f ? barWidth * t.startMs / span : 0.0f);
+                    float x1 = std::max(origin.x + (span > 0.0f ? barWidth * t.endMs / span : 0.0f), x0 + 1.0f);
+                    drawList->AddRectFilled(ImVec2(x0, origin.y), ImVec2(x1, origin.y + barHeight),
+                                            t.thread == 0 ? IM_COL32(90, 160, 255, 255) : IM_COL32(255, 170, 60, 255));
+                    ImGui::Dummy(ImVec2(barWidth, barHeight));
+                    ImGui::SameLine();
+                    ImGui::Text("%s (thread %u): %.3f ms, %.3f ms ready", t.name, t.thread, t.endMs - t.startMs, t.startMs - t.readyMs);
+                }
+            }
+            ImGui::End();
+
+            if (showPerformanceOverlay)
+                drawPerformanceOverlay();
+            cpuUiHistory.push(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - uiStart).count());
+            AllocTracker::swapTag(frameTag);
+            stages.mark("ui build");
+
+            // Frame graph: physics runs on the helper while the main thread waits for a free instance segment and
+            // uploads the camera, then the camera-relative instances are packed (every frame, even when nothing
+            // stepped) and the lights follow the new state. Anything with GL calls is pinned to the main thread.
+            int display_w, display_h;
+            framebufferSize(window, display_w, display_h);
+            outputWindows.poll();
+            // the panels of a projector wall side by side in the target, through one frustum as wide as all of them
+            const unsigned int panels = outputWindows.panels();
+            // the scale follows each GPU frame time as it is read back, the scene passes all draw at scene_w x scene_h
+            float governedGpuMs = 0.0f;
+            if (gpuTimers->collectedFrames() != resolutionFramesSeen) {
+                resolutionFramesSeen = gpuTimers->collectedFrames();
+                governedGpuMs = gpuTimers->frameHistory().latest();
+                dynamicResolution.update(governedGpuMs, GpuTimers::LATENCY);
+            }
+            // the governor takes over where the resolution can give no more, and hands back before it grows again
+            qualityGovernor.update(cpuFrameHistory.latest(), governedGpuMs, GpuTimers::LATENCY,
+                                   dynamicResolution.enabled && dynamicResolution.scale > dynamicResolution.minScale,
+                                   !dynamicResolution.enabled || dynamicResolution.scale >= dynamicResolution.maxScale);
+            applyQualitySettings();
+            const unsigned int governedSamples = qualityGovernor.settings().maxSamples;
+            const int scene_w = static_cast<int>(panels) * dynamicResolution.scaled(display_w), scene_h = dynamicResolution.scaled(display_h);
+            const bool stereo = stereoCamera.enabled && panels == 1;
+            if (stereo) {
+                deferredShading = occlusionCulling = variableRateShading = false;
+                if (antiAliasing == AA_TAA) antiAliasing = AA_FXAA;
+            }
+            sceneTarget->resize(scene_w, scene_h, antiAliasing,
+                                governedSamples > 0 ? std::min(sceneSamples, static_cast<int>(governedSamples)) : sceneSamples);
+            projection = depthConvention().perspective(glm::radians(camera.Zoom), (float)(panels * display_w) / (float)display_h, 0.1f, 3000.0f);
+            glm::mat4 view = camera.GetCameraRelativeViewMatrix();
+            // each eye half the target, the centre camera of one eye's aspect standing in for the mono one
+            stereoEyeWidth = std::max(scene_w / 2, 1);
+            stereoEyeHeight = std::max(scene_h, 1);
+            if (stereo) {
+                updateStereoFrame(view);
+                projection = stereoFrame.centreProjection;
+            }
+            // point-cloud bodies replace the rocks in every pass, point_cloud.h draws them with the light sources
+            const bool drawPointCloud = pointCloudMode && bodiesOnGpu() && gpuNBody->bodyCount > gpuNBody->massiveCount;
+            // and so does the density map, a plane over the ecliptic (density_map.h)
+            const bool drawDensityMap = densityMapMode && bodiesOnGpu() && gpuNBody->bodyCount > gpuNBody->massiveCount;
+            const bool drawRocks = asteroidAmount > 0 && rockModelPtr && !drawPointCloud && !drawDensityMap;
+            const bool drawGas = gasDisk && gasDisk->particleCount() > 0;
+            viewFrustum.fromMatrix(stereo ? stereoFrame.cullProjection * stereoFrame.cullView : projection * view);
+            pixelsPerRadian = projection[1][1] * static_cast<float>(scene_h);
+            rankAssets();
+            // culling and level of detail above use the unjittered projection, everything drawn the jittered one
+            const glm::mat4 unjitteredProjection = projection;
+            projection = sceneTarget->jittered(projection);
+            const bool haveBodies = !physics.bodies.empty();
+            void* instanceTarget = nullptr;
+
+            frameGraph.clear();
+            TaskGraph::TaskId physicsTask = frameGraph.add("physics", [&]() {
+                ALLOC_SCOPE(ALLOC_PHYSICS);
+                if (haveBodies) updatePhysics(deltaTime);
+                if (haveBodies) updatePredictions();
+            }, {}, bodiesOnGpu() ? TaskGraph::MAIN_THREAD : TaskGraph::ANY_THREAD);
+            TaskGraph::TaskId mapTask = frameGraph.add("instance map", [&]() {
+                if (haveBodies) instanceTarget = beginAsteroidInstances();
+            }, {}, TaskGraph::MAIN_THREAD);
+            TaskGraph::TaskId cameraTask = frameGraph.add("camera uniforms", [&]() {
+                cameraUniforms.beginFrame();
+                writeFrameCamera(projection, view);
+                objectUniformRing.beginFrame();
+            }, {}, TaskGraph::MAIN_THREAD);
+            frameGraph.add("instance pack", [&]() {
+                packAsteroidInstances(instanceTarget);
+            }, {physicsTask, mapTask});
+            frameGraph.add("lighting", [&]() {
+                if (haveBodies)
+                    lighting.pointLights[0].position = glm::vec4(cameraRelative(renderPosition(physics.bodies.range(BODY_SUN).begin)), 1.0f);
+                objectUniformRing.bind(LIGHT_BLOCK_BINDING, objectUniformRing.push(lighting));
+                // the suns with the first point light's terms, binned against the view the camera task uploaded
+                const PointLight& sun = lighting.pointLights[0];
+                frameLights.clear();
+                if (haveBodies) {
+                    const BodyRange suns = physics.bodies.range(BODY_SUN);
+                    for (size_t i = suns.begin; i < suns.end; i++)
+                        frameLights.push_back(ClusteredLights::light(cameraRelative(renderPosition(i)), sun.constant, sun.linear, sun.quadratic,
+                                                                     sun.ambient, sun.diffuse, sun.specular));
+                }
+                if (stereo)
+                    clusteredLights->build(frameLights, projection, 0.1f, 3000.0f, stereoEyeWidth, scene_h, 2);
+                else
+                    clusteredLights->build(frameLights, projection, 0.1f, 3000.0f, scene_w, scene_h);
+            }, {physicsTask, cameraTask}, TaskGraph::MAIN_THREAD);
+            frameGraph.run();
+            gpuReadback->endFrame();
+            float physicsMs = 0.0f, uploadMs = 0.0f;
+            for (const TaskGraph::TaskTiming& t : frameGraph.timings()) {
+                if (!t.name) continue;
+                const std::string task = t.name;
+                if (task == "physics")
+                    physicsMs += t.endMs - t.startMs;
+                else if (task == "instance map" || task == "instance pack" || task == "camera uniforms")
+                    uploadMs += t.endMs - t.startMs;
+            }
+            cpuPhysicsHistory.push(physicsMs);
+            cpuUploadHistory.push(uploadMs);
+            stages.mark("frame graph");
+
+            sceneTarget->bind();
+            glClearColor(0.01f, 0.01f, 0.01f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            sceneTarget->beginOverdraw();
+
+            if (physics.bodies.empty()) {
+                sceneTarget->endOverdraw();
+                sceneTarget->setReprojection(projection * view, previousViewProjection, glm::vec3(camera.Position - previousCameraPosition));
+                previousViewProjection = unjitteredProjection * view;
+                previousCameraPosition = camera.Position;
+                sceneTarget->present(display_w, display_h, outputFramebuffer(), outputWindows.region(outputWindows.mainPanel()));
+                outputWindows.present(sceneTarget->presented(), scene_w, scene_h);
+                frameCapture->capture(outputFramebuffer(), display_w, display_h);
+                ImGui::Render();
+                gpuTimers->begin(passTimers.ui);
+                pushDebugGroup("ui");
+                if (window) ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+                popDebugGroup();
+                gpuTimers->endFrame();
+                cpuFrameHistory.push(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - cpuFrameStart).count());
+                stages.mark("ui render");
+                if (window) glfwSwapBuffers(window);
+                else if (headless.frames > 0 && ++headless.frame == headless.frames) stopRequested = 1;
+                framePacer.endFrame();
+                if (startupTrace().frameShown(textureCache().streamingPending() == 0)) finishStartup(window);
+                continue;
+            }
+
+            const bool drawBelt = gpuBeltEnabled && rockModelPtr && gpuBelt->rockCount() > 0;
+            if (drawBelt)
+                advanceGpuBelt();
+            captureTrails(drawBelt);
+
+            updateBodyOctree();
+
+            // planets and moons as one instance list, those to shade first: the terrain draws the scene's planet itself
+            // and frustum culling drops what is out of view, the sun's shadow takes them all
+            const bool planetsInstanced = instancedPlanets && planetInstances && planetModelPtr && !sphereImpostors &&
+                                          physics.bodies.count(BODY_PLANET) > 0;
+            if (planetsInstanced) {
+                const BodyRange planets = physics.bodies.range(BODY_PLANET);
+                const bool terrainPlanet = planetTerrainEnabled && planetTerrain->baked();
+                const float reflectivity = planetReflections && !deferredShading ? planetReflectivity : 0.0f;
+                const float lod = planetRoughness * static_cast<float>(std::max(reflectionProbe->levels(), 1u) - 1);
+                planetInstances->begin();
+                for (size_t i = planets.begin; i < planets.end; i++) {
+                    const bool primary = i == planets.begin;
+                    const glm::vec3 at = cameraRelative(renderPosition(i));
+                    const float radius = physics.bodies.render[i].radiusScale * planetBoundingRadius;
+                    const PlanetInstances::Properties properties{planetInstances->layerOf(physics.bodies.id[i], primary),
+                                                                 GpuPicker::PICK_BODY | static_cast<uint32_t>(i), primary ? reflectivity : 0.0f, lod};
+                    planetInstances->add(at, physics.bodies.render[i].orientation, physics.bodies.render[i].radiusScale, properties,
+                                         !(primary && terrainPlanet) && (!frustumCulling || viewFrustum.intersectsSphere(at, radius)));
+                }
+                planetInstances->upload();
+            }
+
+            // the sun's shadow: the planet and every rock, not only those in view, once into all six faces
+            const bool castShadows = sunShadows && !frameLights.empty();
+            // redrawn every shadowInterval frames under the governor, in between the faces follow the camera
+            const bool drawShadows = castShadows && (++sunShadowAge >= qualityGovernor.settings().shadowInterval || !sunShadow->rendered());
+            if (castShadows && !drawShadows)
+                sunShadow->follow(glm::vec3(frameLights[0].position));
+            if (drawShadows) {
+                sunShadowAge = 0;
+                GL_DEBUG_GROUP("sun shadow");
+                // the cube's faces are GL's usual perspective, and the lit shaders compare against it as such
+                DepthConvention::StandardDepth standardDepth(depthConvention());
+                gpuTimers->begin(passTimers.shadows);
+                sunShadow->setFiltered(softSunShadows);
+                sunShadow->setBlurRadius(static_cast<unsigned int>(sunShadowBlur));
+                sunShadow->begin(glm::vec3(frameLights[0].position), SUN_SHADOW_NEAR, SUN_SHADOW_FAR);
+                if (planetsInstanced) {
+                    planetShadowShader.use();
+                    sunShadow->setCaster(planetShadowShader);
+                    planetInstances->draw(*planetModelPtr, planetShadowShader, planetInstances->count());
+                } else if (physics.bodies.count(BODY_PLANET) > 0 && planetModelPtr) {
+                    size_t planetIndex = physics.bodies.range(BODY_PLANET).begin;
+                    objectShadowShader.use();
+                    sunShadow->setCaster(objectShadowShader);
+                    objectShadowShader.setMat4("model", physics.bodies.modelMatrix(planetIndex, cameraRelative(renderPosition(planetIndex))));
+                    if (positionStreams) planetModelPtr->DrawDepth();
+                    else planetModelPtr->Draw(objectShadowShader);
+                }
+                if (drawRocks && bodiesOnGpu() && gpuNBody->bodyCount > 0) {
+                    gpuShadowShader.use();
+                    sunShadow->setCaster(gpuShadowShader);
+                    gpuShadowShader.setUInt("instanceOffset", gpuNBody->massiveCount);
+                    gpuShadowShader.setVec3("cameraPosition", glm::vec3(camera.Position));
+                    gpuShadowShader.setBool("tumble", true);
+                    gpuShadowShader.setFloat("spinTime", static_cast<float>(std::fmod(displayedSimTime(), TUMBLE_PERIOD)));
+                    gpuShadowShader.setBool("culled", false);
+                    gpuNBody->bind();
+                    drawRockShadows(gpuNBody->bodyCount - gpuNBody->massiveCount, 0u);
+                } else if (drawRocks && asteroidInstanceStream.valid()) {
+                    // what was packed for the view, the CPU paths cull against the camera frustum before this
+                    Shader& shadowShader = instanceStreamQuantized ? quantizedShadowShader : asteroidShadowShader;
+                    shadowShader.use();
+                    sunShadow->setCaster(shadowShader);
+                    shadowShader.setFloat("spinTime", static_cast<float>(std::fmod(displayedSimTime(), TUMBLE_PERIOD)));
+                    if (instanceStreamQuantized)
+                        glState().bindBufferRange(GL_SHADER_STORAGE_BUFFER, INSTANCE_CHUNK_BINDING, asteroidInstanceStream.buffer(),
+                                          asteroidInstanceStream.readOffset() + asteroidInstanceCapacity * sizeof(QuantizedInstance),
+                                          asteroidInstanceCapacity / INSTANCE_CHUNK * sizeof(InstanceChunk));
+                    for (unsigned int l = 0; l <= IMPOSTOR_BIN; l++) {
+                        if (asteroidLodCount[l] == 0 || (l >= rockModelPtr->lodCount() && l != IMPOSTOR_BIN)) continue;
+                        if (instanceStreamQuantized) shadowShader.setUInt("chunkBase", asteroidLodFirst[l] / INSTANCE_CHUNK);
+                        drawRockShadows(asteroidLodCount[l], asteroidInstanceStream.readSegment() * asteroidSegmentRecords + asteroidLodFirst[l]);
+                    }
+                }
+                if (drawBelt) {
+                    gpuShadowShader.use();
+                    sunShadow->setCaster(gpuShadowShader);
+                    gpuShadowShader.setUInt("instanceOffset", 0u);
+                    gpuShadowShader.setVec3("cameraPosition", glm::vec3(camera.Position));
+                    gpuShadowShader.setBool("tumble", false);
+                    gpuShadowShader.setBool("culled", false);
+                    gpuBelt->bind();
+                    drawRockShadows(gpuBelt->rockCount(), 0u);
+                }
+                sunShadow->end(scene_w, scene_h, sceneTarget->framebuffer());
+                gpuTimers->end();
+            }
+            stages.mark("sun shadow");
+
+            // the lit geometry, into the G-buffer on the deferred path
+            LitShaders& lit = deferredShading ? deferredLit : forwardLit;
+            size_t sunIndex = physics.bodies.range(BODY_SUN).begin;
+            const glm::vec3 sunOffset = cameraRelative(renderPosition(sunIndex));
+            const glm::mat4 sunMatrix = physics.bodies.modelMatrix(sunIndex, sunOffset);
+            // a subdivision less each time the sun's projected diameter quarters, the pre-pass and the shading alike
+            const float sunPixels = pixelsPerRadian * physics.bodies.render[sunIndex].radiusScale / std::max(glm::length(sunOffset), 1e-3f);
+            const unsigned int sunLod = sunPixels > 256.0f ? 0 : sunPixels > 64.0f ? 1 : sunPixels > 16.0f ? 2 : 3;
+            const UniformRing::Slice sunObject = pushObject(sunMatrix, GpuPicker::PICK_BODY | static_cast<uint32_t>(sunIndex));
+            lightSourceShader.use();
+            lightSourceShader.set(sunProjection, projection); // Ensure these shaders take P and V
+            lightSourceShader.set(sunView, view);
+            const bool drawPlanet = !sphereImpostors && physics.bodies.count(BODY_PLANET) > 0 && planetModelPtr;
+            const size_t planetIndex = drawPlanet ? physics.bodies.range(BODY_PLANET).begin : 0;
+            const glm::vec3 planetOffset = drawPlanet ? cameraRelative(renderPosition(planetIndex)) : glm::vec3(0.0f);
+            const glm::mat4 planetMatrix = drawPlanet ? physics.bodies.modelMatrix(planetIndex, planetOffset) : glm::mat4(1.0f);
+            const uint32_t planetPick = GpuPicker::PICK_BODY | static_cast<uint32_t>(planetIndex);
+            const bool drawTerrain = drawPlanet && planetTerrainEnabled && planetTerrain->baked();
+            const bool drawSurface = drawTerrain && planetSurface && planetSurfaceEnabled;
+
+            // the next faces of the planet's reflection probe: the sky and the sun seen from its centre
+            const bool reflectPlanet = planetReflections && drawPlanet && !deferredShading;
+            if (reflectPlanet) {
+                gpuTimers->begin(passTimers.reflections);
+                reflectionProbe->facesPerFrame = reflectionFacesPerFrame;
+                reflectionProbe->farPlane = 2.0f * SUN_SHADOW_FAR;
+                reflectionProbe->update(planetOffset, [&](const glm::mat4& faceView, const glm::mat4& faceProjection) {
+                    cameraUniforms.write(faceProjection, faceView);
+                    glState().depthFunc(GL_LESS);
+                    lightSourceShader.use();
+                    objectUniformRing.bind(OBJECT_BLOCK_BINDING, sunObject);
+                    glState().bindVertexArray(sphereMesh->VAO);
+                    sphereMesh->drawElements(std::min(sunLod + 1, 3u));
+                    glState().depthFunc(GL_LEQUAL);
+                    skyboxShader.use();
+                    glState().activeTexture(GL_TEXTURE0);
+                    glState().bindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+                    glState().bindVertexArray(skyboxVAO);
+                    glDrawArrays(GL_TRIANGLES, 0, 36);
+                    glState().depthFunc(GL_LESS);
+                });
+                writeFrameCamera(projection, view);
+                glBindFramebuffer(GL_FRAMEBUFFER, sceneTarget->framebuffer());
+                glViewport(0, 0, scene_w, scene_h);
+                gpuTimers->end();
+            }
+            if (reflectionProbe->texture() != 0)
+                reflectionProbe->bind();
+            const float planetReflection = reflectPlanet ? planetReflectivity : 0.0f;
+            const float reflectionLod = planetRoughness * static_cast<float>(std::max(reflectionProbe->levels(), 1u) - 1);
+            const UniformRing::Slice planetObject = drawPlanet ? pushObject(planetMatrix, planetPick, planetReflection, reflectionLod) : UniformRing::Slice();
+            stages.mark("reflection probe");
+
+            if (deferredShading)
+                gBuffer->bindGeometry(scene_w, scene_h);
+            // the ids go with the lit geometry: the G-buffer's third target, or next to the forward scene's colour
+            if (!gpuPicking)
+                gpuPicker->detach();
+            else if (deferredShading)
+                gpuPicker->attach(gBuffer->framebuffer(), 2, scene_w, scene_h, 1);
+            else
+                gpuPicker->attach(sceneTarget->framebuffer(), 1, scene_w, scene_h, sceneTarget->samples());
+
+            // the frame's draws, sorted by pass, then program, textures and vertex array, before any is issued
+            renderQueue.reset();
+            renderQueue.setMerging(autoInstancing);
+            renderQueue.setPass(PASS_DEPTH_PREPASS, "depth pre-pass", GL_LESS, false, false, positionStreams);
+            // after a pre-pass the shaded draws test equal to its depth, the same positions (invariant gl_Position)
+            renderQueue.setPass(PASS_OPAQUE, deferredShading ? "opaque (g-buffer)" : "opaque", depthPrepass ? GL_LEQUAL : GL_LESS);
+            renderQueue.setPass(PASS_LIGHT_SOURCES, "light sources", GL_LEQUAL);
+            renderQueue.setPass(PASS_SKY, "skybox", GL_LEQUAL);
+            renderQueue.setPass(PASS_ATMOSPHERE, "atmospheres", GL_LEQUAL, true, true);
+            renderQueue.setPass(PASS_DEBUG, "debug draw", GL_LEQUAL);
+            renderQueue.setPass(PASS_DEBUG_OVERLAY, "debug overlay", GL_ALWAYS);
+            // the sun tessellated to its size on screen, the same patches in the pre-pass and the shading
+            const float projScale = 0.5f * pixelsPerRadian;
+            tessellatedSunTriangles = tessellatedSphere.trianglesFor(sunPixels);
+            auto addTessellatedSun = [&](unsigned int pass, unsigned int timer) {
+                RenderQueue::Draw draw;
+                draw.pass = pass;
+                draw.shader = &tessellatedSunShader;
+                draw.vertexArray = tessellatedSphere.vertexArray();
+                draw.depth = glm::length(sunOffset);
+                draw.timer = timer;
+                renderQueue.add(draw, [&]() {
+                    objectUniformRing.bind(OBJECT_BLOCK_BINDING, sunObject);
+                    tessellatedSphere.draw(tessellatedSunShader, projScale, 1.0f);
+                });
+            };
+            if (depthPrepass && !sphereImpostors) {
+                // depth only, the sun and the planet
+                if (tessellatedSpheres)
+                    addTessellatedSun(PASS_DEPTH_PREPASS, passTimers.prepass);
+                else
+                    renderQueue.addMesh(PASS_DEPTH_PREPASS, lightSourceShader, *sphereMesh, glm::length(sunOffset), passTimers.prepass,
+                                        [&]() { objectUniformRing.bind(OBJECT_BLOCK_BINDING, sunObject); }, sunLod);
+                // the terrain is not the model's shape, it tests against its own depth; instances only test against it
+                if (drawPlanet && !drawTerrain && !planetsInstanced)
+                    for (const Mesh& mesh : planetModelPtr->meshes)
+                        renderQueue.addMesh(PASS_DEPTH_PREPASS, lightSourceShader, mesh, glm::length(planetOffset), passTimers.prepass,
+                                            [&]() { objectUniformRing.bind(OBJECT_BLOCK_BINDING, planetObject); });
+            }
+
+            // Planet, as terrain patches picked for this view, the sphere tessellated and displaced by their height, or its model
+            if (drawTerrain && tessellatedSpheres) {
+                Shader& planetShader = lit.tessellatedPlanetShader;
+                RenderQueue::Draw draw;
+                draw.pass = PASS_OPAQUE;
+                draw.shader = &planetShader;
+                draw.vertexArray = tessellatedSphere.vertexArray();
+                draw.depth = glm::length(planetOffset);
+                draw.timer = passTimers.planet;
+                renderQueue.add(draw, [&]() {
+                    objectUniformRing.bind(OBJECT_BLOCK_BINDING, planetObject);
+                    planetTerrain->bindCubes();
+                    tessellatedSphere.draw(planetShader, projScale, planetTerrain->radius(), planetTerrain->heightScale, planetTerrain->heightTexel());
+                });
+            } else if (drawTerrain) {
+                planetTerrain->select(planetMatrix, frustumCulling ? &viewFrustum : nullptr, static_cast<float>(scene_h), glm::radians(camera.Zoom));
+                Shader& terrainShader = drawSurface ? lit.virtualTerrainShader : lit.terrainShader;
+                RenderQueue::Draw terrainDraw;
+                terrainDraw.pass = PASS_OPAQUE;
+                terrainDraw.shader = &terrainShader;
+                terrainDraw.vertexArray = planetTerrain->vertexArray();
+                terrainDraw.depth = glm::length(planetOffset);
+                terrainDraw.timer = passTimers.planet;
+                renderQueue.add(terrainDraw, [&]() {
+                    objectUniformRing.bind(OBJECT_BLOCK_BINDING, planetObject);
+                    if (drawSurface) planetSurface->bind(terrainShader);
+                    planetTerrain->draw(terrainShader);
+                });
+            } else if (drawPlanet && !planetsInstanced) {
+                 // one multi-draw for all meshes when the model could be batched
+                 const bool batched = batchedModelDraws && planetBatchPtr && planetBatchPtr->valid();
+                 Shader& planetShader = batched ? lit.batchedObjectShader : lit.objectShader;
+                 const ObjectUniforms& planetUniforms = batchedObjectUniforms[deferredShading];
+                 auto setPlanetUniforms = [&]() {
+                     planetShader.set(planetUniforms.viewPos, glm::vec3(0.0f));
+                     planetShader.set(planetUniforms.model, planetMatrix);
+                     planetShader.set(planetUniforms.normalMatrix, glm::transpose(glm::inverse(glm::mat3(planetMatrix))));
+                     planetShader.set(planetUniforms.reflectivity, planetReflection);
+                     planetShader.set(planetUniforms.reflectionLod, reflectionLod);
+                     planetShader.set(planetUniforms.pickId, planetPick);
+                 };
+                 if (batched) {
+                     RenderQueue::Draw draw;
+                     draw.pass = PASS_OPAQUE;
+                     draw.shader = &planetShader;
+                     draw.depth = glm::length(planetOffset);
+                     draw.timer = passTimers.planet;
+                     renderQueue.add(draw, [&, setPlanetUniforms]() { setPlanetUniforms(); planetBatchPtr->Draw(planetShader); });
+                 } else {
+                     for (size_t m = 0; m < planetModelPtr->meshes.size(); m++) {
+                         // each mesh where the model's node hierarchy puts it
+                         renderQueue.addMeshInstance(PASS_OPAQUE, planetShader, lit.objectInstancesShader, planetModelPtr->meshes[m],
+                                                     objectBlock(planetMatrix * planetModelPtr->meshTransform(m), planetPick, planetReflection, reflectionLod),
+                                                     glm::length(planetOffset), passTimers.planet);
+                     }
+                 }
+            }
+            // the other planets and moons as a scene without hand instancing would draw them, mesh by mesh per body;
+            // the queue gathers the same meshes into instanced draws
+            if (drawPlanet && !planetsInstanced) {
+                const BodyRange planets = physics.bodies.range(BODY_PLANET);
+                auto drawBody = [&](size_t i) {
+                    if (i <= planets.begin || i >= planets.end) return;
+                    const glm::vec3 at = cameraRelative(renderPosition(i));
+                    const glm::mat4 bodyMatrix = physics.bodies.modelMatrix(i, at);
+                    const uint32_t bodyPick = GpuPicker::PICK_BODY | static_cast<uint32_t>(i);
+                    for (size_t m = 0; m < planetModelPtr->meshes.size(); m++)
+                        renderQueue.addMeshInstance(PASS_OPAQUE, lit.objectShader, lit.objectInstancesShader, planetModelPtr->meshes[m],
+                                                    objectBlock(bodyMatrix * planetModelPtr->meshTransform(m), bodyPick),
+                                                    glm::length(at), passTimers.planet);
+                };
+                if (frustumCulling)
+                    bodyOctree.forEachIntersecting(viewFrustum, glm::vec3(camera.Position - bodyOctreeOrigin),
+                                                   [&](uint32_t id) { drawBody(physics.bodies.indexOf(id)); });
+                else
+                    for (size_t i = planets.begin + 1; i < planets.end; i++) drawBody(i);
+            }
+
+            // every other planet and moon, and the scene's planet unless it is terrain, in a draw per mesh
+            if (planetsInstanced && planetInstances->visibleCount() > 0 && planetInstances->texture() != 0) {
+                RenderQueue::Draw instancedDraw;
+                instancedDraw.pass = PASS_OPAQUE;
+                instancedDraw.shader = &lit.planetInstancedShader;
+                instancedDraw.textureTarget = GL_TEXTURE_2D_ARRAY;
+                instancedDraw.depth = glm::length(planetOffset);
+                instancedDraw.timer = passTimers.planet;
+                // shaded as the single planet is, with its uniforms left as they are
+                renderQueue.addWithTexture(instancedDraw, 0, planetInstances->texture(), [&]() {
+                    planetInstances->draw(*planetModelPtr, lit.planetInstancedShader, planetInstances->visibleCount());
+                });
+            }
+
+            // Asteroids, each path one packet that binds and culls on its own
+            RenderQueue::Draw rockDraw;
+            rockDraw.pass = PASS_OPAQUE;
+            rockDraw.timer = passTimers.asteroids;
+            rockDraw.textureTarget = GL_TEXTURE_2D_ARRAY;
+            // in stereo every rock is two instances, one per eye, culled once against the frustum holding both
+            rockDraw.multiView = stereo;
+            const unsigned int rockViews = stereo ? 2u : 1u;
+            auto cullRocks = [&](unsigned int first, unsigned int count) {
+                gpuCuller->views = rockViews;
+                gpuCuller->frontToBack = frontToBackRocks ? radixSort : nullptr;
+                if (stereo) cameraUniforms.write(stereoFrame.cullProjection, stereoFrame.cullView);
+                gpuCuller->cull(rockVariants->models(), rockVariants->count(), first, count, glm::vec3(camera.Position),
+                                static_cast<float>(scene_h), effectiveLodPixels, asteroidImpostors ? effectiveImpostorDistance : 0.0f,
+                                occlusionCulling ? hiZ : nullptr);
+                if (stereo) beginStereoView(RenderQueue::ALL_VIEWS, nullptr);
+            };
+            auto addRocks = [&](const RenderQueue::Draw& draw, const auto& callback) {
+                if (rockVariants->texture() == 0)
+                    renderQueue.add(draw, callback);
+                else
+                    renderQueue.addWithTexture(draw, 0, rockVariants->texture(), callback);
+            };
+            if (drawRocks && bodiesOnGpu() && gpuNBody->bodyCount > 0) {
+                rockDraw.shader = &lit.gpuAsteroidShader;
+                addRocks(rockDraw, [&]() {
+                    // instance transforms come straight from the N-body SSBOs
+                    lit.gpuAsteroidShader.setMat4("viewMat", view);
+                    lit.gpuAsteroidShader.setUInt("instanceOffset", gpuNBody->massiveCount);
+                    lit.gpuAsteroidShader.setBool("pickable", true);
+                    lit.gpuAsteroidShader.setVec3("cameraPosition", glm::vec3(camera.Position));
+                    lit.gpuAsteroidShader.setBool("tumble", true);
+                    lit.gpuAsteroidShader.setFloat("spinTime", static_cast<float>(std::fmod(displayedSimTime(), TUMBLE_PERIOD)));
+                    lit.gpuAsteroidShader.setBool("culled", frustumCulling);
+                    lit.gpuAsteroidShader.setBool("stereo", stereo);
+                    gpuNBody->bind();
+                    if (frustumCulling) {
+                        cullRocks(gpuNBody->massiveCount, gpuNBody->bodyCount - gpuNBody->massiveCount);
+                        lit.gpuAsteroidShader.use();
+                        gpuCuller->draw(rockVariants->models(), rockVariants->count());
+                        if (asteroidImpostors) {
+                            lit.gpuImpostorShader.use();
+                            lit.gpuImpostorShader.setMat4("viewMat", view);
+                            lit.gpuImpostorShader.setVec3("cameraPosition", glm::vec3(camera.Position));
+                            lit.gpuImpostorShader.setBool("culled", true);
+                            lit.gpuImpostorShader.setBool("pickable", true);
+                            lit.gpuImpostorShader.setBool("stereo", stereo);
+                            lit.gpuImpostorShader.setFloat("viewportHeight", static_cast<float>(scene_h));
+                            gpuCuller->drawImpostors(*rockModelPtr);
+                        }
+                    } else {
+                        for (unsigned int i = 0; i < rockModelPtr->meshes.size(); i++) {
+                            glState().bindVertexArray(rockModelPtr->meshes[i].VAO);
+                            rockModelPtr->meshes[i].drawElementsInstanced((gpuNBody->bodyCount - gpuNBody->massiveCount) * rockViews);
+                        }
+                    }
+                });
+            } else if (drawRocks && asteroidInstanceStream.valid()) {
+                Shader& instancedShader = instanceStreamQuantized ? lit.quantizedAsteroidShader : lit.asteroidShader;
+                rockDraw.shader = &instancedShader;
+                addRocks(rockDraw, [&]() {
+                    instancedShader.setMat4("viewMat", view);
+                    instancedShader.setVec3("viewPos", glm::vec3(0.0f));
+                    instancedShader.setFloat("spinTime", static_cast<float>(std::fmod(displayedSimTime(), TUMBLE_PERIOD)));
+                    instancedShader.setBool("stereo", stereo);
+                    // a record per two instances in stereo, both eyes read it
+                    if (stereo)
+                        for (const Mesh& mesh : rockModelPtr->meshes) glVertexArrayBindingDivisor(mesh.VAO, INSTANCE_BINDING, 2);
+                    if (instanceStreamQuantized)
+                        glState().bindBufferRange(GL_SHADER_STORAGE_BUFFER, INSTANCE_CHUNK_BINDING, asteroidInstanceStream.buffer(),
+                                          asteroidInstanceStream.readOffset() + asteroidInstanceCapacity * sizeof(QuantizedInstance),
+                                          asteroidInstanceCapacity / INSTANCE_CHUNK * sizeof(InstanceChunk));
+                    // every mesh's levels recorded by the worker pool, a list per slice, and replayed in order
+                    const unsigned int lods = rockModelPtr->lodCount();
+                    const int chunkBase = instanceStreamQuantized ? instancedShader.location("chunkBase") : -1;
+                    const unsigned int segmentBase = static_cast<unsigned int>(asteroidInstanceStream.readSegment() * asteroidSegmentRecords);
+                    renderDevice.recordParallel(rockCommandLists, rockModelPtr->meshes.size() * lods, [&](CommandList& list, size_t begin, size_t end) {
+                        for (size_t item = begin; item < end; item++) {
+                            const unsigned int l = static_cast<unsigned int>(item % lods);
+                            if (asteroidLodCount[l] == 0) continue;
+                            if (chunkBase >= 0) list.setUInt(chunkBase, asteroidLodFirst[l] / INSTANCE_CHUNK);
+                            recordMesh(list, rockModelPtr->meshes[item / lods], asteroidLodCount[l] * rockViews, segmentBase + asteroidLodFirst[l], l);
+                        }
+                    });
+                    if (asteroidLodCount[IMPOSTOR_BIN] > 0) {
+                        // the impostor bin is read from the same segment, one point per instance
+                        Shader& impostorShader = instanceStreamQuantized ? lit.quantizedImpostorShader : lit.asteroidImpostorShader;
+                        impostorShader.use();
+                        impostorShader.setMat4("viewMat", view);
+                        impostorShader.setFloat("viewportHeight", static_cast<float>(scene_h));
+                        impostorShader.setBool("stereo", stereo);
+                        if (instanceStreamQuantized) impostorShader.setUInt("chunkBase", asteroidLodFirst[IMPOSTOR_BIN] / INSTANCE_CHUNK);
+                        glState().bindVertexArray(rockModelPtr->meshes[0].VAO);
+                        glDrawArraysInstancedBaseInstance(GL_POINTS, 0, 1, asteroidLodCount[IMPOSTOR_BIN] * rockViews,
+                                                          asteroidInstanceStream.readSegment() * asteroidSegmentRecords + asteroidLodFirst[IMPOSTOR_BIN]);
+                    }
+                    if (stereo)
+                        for (const Mesh& mesh : rockModelPtr->meshes) glVertexArrayBindingDivisor(mesh.VAO, INSTANCE_BINDING, 1);
+                    asteroidInstanceStream.fenceRead();
+                });
+            }
+            if (drawBelt) {
+                rockDraw.shader = &lit.gpuAsteroidShader;
+                addRocks(rockDraw, [&]() {
+                    lit.gpuAsteroidShader.setMat4("viewMat", view);
+                    lit.gpuAsteroidShader.setUInt("instanceOffset", 0u);
+                    lit.gpuAsteroidShader.setBool("pickable", false);
+                    lit.gpuAsteroidShader.setVec3("cameraPosition", glm::vec3(camera.Position));
+                    lit.gpuAsteroidShader.setBool("tumble", false);
+                    lit.gpuAsteroidShader.setBool("culled", frustumCulling);
+                    lit.gpuAsteroidShader.setBool("stereo", stereo);
+                    gpuBelt->bind();
+                    if (frustumCulling) {
+                        cullRocks(0u, gpuBelt->rockCount());
+                        lit.gpuAsteroidShader.use();
+                        gpuCuller->draw(rockVariants->models(), rockVariants->count());
+                        if (asteroidImpostors) {
+                            lit.gpuImpostorShader.use();
+                            lit.gpuImpostorShader.setMat4("viewMat", view);
+                            lit.gpuImpostorShader.setVec3("cameraPosition", glm::vec3(camera.Position));
+                            lit.gpuImpostorShader.setBool("culled", true);
+                            lit.gpuImpostorShader.setBool("pickable", false);
+                            lit.gpuImpostorShader.setBool("stereo", stereo);
+                            lit.gpuImpostorShader.setFloat("viewportHeight", static_cast<float>(scene_h));
+                            gpuCuller->drawImpostors(*rockModelPtr);
+                        }
+                    } else {
+                        for (unsigned int i = 0; i < rockModelPtr->meshes.size(); i++) {
+                            glState().bindVertexArray(rockModelPtr->meshes[i].VAO);
+                            rockModelPtr->meshes[i].drawElementsInstanced(gpuBelt->rockCount() * rockViews);
+                        }
+                    }
+                });
+            }
+
+            // Sun, equal to its own pre-pass depth when there was one
+            if (!sphereImpostors && tessellatedSpheres)
+                addTessellatedSun(PASS_LIGHT_SOURCES, passTimers.sun);
+            else if (!sphereImpostors)
+                renderQueue.addMesh(PASS_LIGHT_SOURCES, lightSourceShader, *sphereMesh, glm::length(sunOffset), passTimers.sun, [&]() {
+                    objectUniformRing.bind(OBJECT_BLOCK_BINDING, sunObject);
+                }, sunLod);
+            if (sphereImpostors || universe.running()) {
+                // all of the suns and planets in view, one instanced draw after the opaque pass (and its deferred lighting)
+                sphereImpostorRenderer->clear();
+                if (sphereImpostors) {
+                    for (unsigned int type : {BODY_SUN, BODY_PLANET}) {
+                        const BodyRange bodies = physics.bodies.range(static_cast<BodyType>(type));
+                        for (size_t i = bodies.begin; i < bodies.end; i++) {
+                            const glm::vec3 at = cameraRelative(renderPosition(i));
+                            const BodyRenderData& body = physics.bodies.render[i];
+                            const float radius = body.radiusScale * (type == BODY_SUN ? 1.0f : planetBoundingRadius);
+                            if (frustumCulling && !viewFrustum.intersectsSphere(at, radius)) continue;
+                            sphereImpostorRenderer->add(at, radius, body.orientation, type == BODY_SUN ? SUN_EMISSION : glm::vec3(1.0f), type == BODY_SUN,
+                                                        GpuPicker::PICK_BODY | static_cast<uint32_t>(i));
+                        }
+                    }
+                }
+                // then the far systems of --universe, a range each drawn with its planets' texture, not pickable
+                struct FarRange { size_t first, count; unsigned int surface; };
+                std::vector<FarRange> farRanges;
+                const size_t nearCount = sphereImpostorRenderer->size();
+                universe.forEachFarSystem([&](const WorldStreamer::System& system, const std::vector<WorldStreamer::FarBody>& bodies) {
+                    const size_t first = sphereImpostorRenderer->size();
+                    for (const WorldStreamer::FarBody& body : bodies) {
+                        const glm::vec3 at = cameraRelative(body.position);
+                        const float radius = body.radiusScale * (body.sun ? 1.0f : planetBoundingRadius);
+                        if (frustumCulling && !viewFrustum.intersectsSphere(at, radius)) continue;
+                        sphereImpostorRenderer->add(at, radius, body.orientation, body.sun ? SUN_EMISSION : glm::vec3(1.0f), body.sun);
+                    }
+                    if (sphereImpostorRenderer->size() > first) farRanges.push_back(FarRange{first, sphereImpostorRenderer->size() - first, system.surface});
+                });
+                sphereImpostorRenderer->upload();
+                const bool textured = planetModelPtr && !planetModelPtr->textures_loaded.empty();
+                RenderQueue::Draw impostorDraw;
+                impostorDraw.pass = PASS_LIGHT_SOURCES;
+                impostorDraw.shader = &sphereImpostorRenderer->program();
+                impostorDraw.vertexArray = sphereImpostorRenderer->vertexArray();
+                impostorDraw.timer = passTimers.sun;
+                if (nearCount > 0)
+                    renderQueue.addWithTexture(impostorDraw, 0, textured ? planetModelPtr->textures_loaded[0].id : 0, [&, textured, nearCount]() {
+                        sphereImpostorRenderer->program().setInt("surfaceTexture", 0);
+                        sphereImpostorRenderer->program().setBool("textured", textured);
+                        sphereImpostorRenderer->draw(0, nearCount);
+                    });
+                for (const FarRange& range : farRanges)
+                    renderQueue.addWithTexture(impostorDraw, 0, range.surface, [&, range]() {
+                        sphereImpostorRenderer->program().setInt("surfaceTexture", 0);
+                        sphereImpostorRenderer->program().setBool("textured", range.surface != 0);
+                        sphereImpostorRenderer->draw(range.first, range.count);
+                    });
+            }
+
+            // the predicted paths, written camera-relative into their stream segment now, drawn with the light sources
+            if (orbitPredictions && orbitPredictor.ready()) {
+                const BodyStore& bodies = physics.bodies;
+                orbitLines->upload(orbitPredictor.latest(), displayedSimTime(), camera.Position,
+                    [&](uint32_t id, glm::dvec3& at) {
+                        const uint32_t i = bodies.indexOf(id);
+                        if (i == BodyStore::INVALID_INDEX) return false;
+                        at = renderPosition(i);
+                        return true;
+                    },
+                    [&](uint32_t id) {
+                        const uint32_t i = bodies.indexOf(id);
+                        if (id == selectedBodyId) return glm::vec3(1.0f, 0.85f, 0.3f);
+                        return i != BodyStore::INVALID_INDEX && bodies.typeOf(i) == BODY_PLANET ? glm::vec3(0.35f, 0.6f, 1.0f) : glm::vec3(0.5f, 1.0f, 0.6f);
+                    });
+                if (orbitLines->pathCount() > 0) {
+                    RenderQueue::Draw lineDraw;
+                    lineDraw.pass = PASS_LIGHT_SOURCES;
+                    lineDraw.shader = &orbitLines->program();
+                    lineDraw.vertexArray = orbitLines->vertexArray();
+                    lineDraw.timer = passTimers.sun;
+                    renderQueue.add(lineDraw, [&]() { orbitLines->draw(orbitLineBrightness); });
+                }
+            }
+
+            // the debug views, copied up in one go and drawn after everything else
+            if (debugDrawActive()) {
+                buildDebugDraw();
+                debugDraw->flush();
+                for (DebugDraw::Layer layer : {DebugDraw::DEPTH_TESTED, DebugDraw::OVERLAY}) {
+                    if (debugDraw->empty(layer)) continue;
+                    RenderQueue::Draw debugLines;
+                    debugLines.pass = layer == DebugDraw::OVERLAY ? PASS_DEBUG_OVERLAY : PASS_DEBUG;
+                    debugLines.shader = &debugDraw->lineProgram();
+                    debugLines.vertexArray = debugDraw->lineVertexArray();
+                    debugLines.timer = passTimers.debugDraw;
+                    renderQueue.add(debugLines, [layer]() { debugDraw->drawLines(layer); });
+                    RenderQueue::Draw debugShapes = debugLines;
+                    debugShapes.shader = &debugDraw->shapeProgram();
+                    debugShapes.vertexArray = debugDraw->shapeVertexArray();
+                    renderQueue.add(debugShapes, [layer]() { debugDraw->drawShapes(layer); });
+                }
+            }
+
+            if (drawPointCloud) {
+                RenderQueue::Draw pointDraw;
+                pointDraw.pass = PASS_LIGHT_SOURCES;
+                pointDraw.shader = &pointCloud->program();
+                pointDraw.vertexArray = pointCloud->vertexArray();
+                pointDraw.timer = passTimers.asteroids;
+                renderQueue.add(pointDraw, [&]() { pointCloud->draw(*gpuNBody, gpuNBody->massiveCount, glm::vec3(camera.Position)); });
+            }
+
+            if (drawGas) {
+                RenderQueue::Draw gasDraw;
+                gasDraw.pass = PASS_LIGHT_SOURCES;
+                gasDraw.shader = &gasCloud->program();
+                gasDraw.vertexArray = gasCloud->vertexArray();
+                gasDraw.timer = passTimers.asteroids;
+                renderQueue.add(gasDraw, [&]() {
+                    gasCloud->draw(gasDisk->positionBuffer(), gasDisk->luminosityBuffer(), gasDisk->particleCount(), glm::vec3(camera.Position));
+                    if (gpuNBody) gpuNBody->bind();
+                });
+            }
+
+            if (drawDensityMap) {
+                // counted and blurred now, ahead of the passes that draw it
+                densityMap->update(*gpuNBody, gpuNBody->massiveCount);
+                RenderQueue::Draw mapDraw;
+                mapDraw.pass = PASS_LIGHT_SOURCES;
+                mapDraw.shader = &densityMap->program();
+                mapDraw.vertexArray = densityMap->vertexArray();
+                mapDraw.timer = passTimers.asteroids;
+                renderQueue.add(mapDraw, [&]() { densityMap->draw(glm::vec3(camera.Position)); });
+            }
+
+            if (motionTrails && gpuTrails->samples() > 1) {
+                RenderQueue::Draw trailDraw;
+                trailDraw.pass = PASS_LIGHT_SOURCES;
+                trailDraw.shader = &gpuTrails->program();
+                trailDraw.vertexArray = gpuTrails->vertexArray();
+                trailDraw.timer = passTimers.sun;
+                renderQueue.add(trailDraw, [&]() { gpuTrails->draw(glm::vec3(camera.Position), trailColor * trailBrightness); });
+            }
+
+            // the catalog's stars in view and bright enough, or the cubemap
+            if (starCatalogSky && starField->loaded()) {
+                starField->cull(camera.Front, glm::radians(camera.Zoom), static_cast<float>(scene_w) / static_cast<float>(std::max(scene_h, 1)));
+                RenderQueue::Draw starDraw;
+                starDraw.pass = PASS_SKY;
+                starDraw.shader = &starField->program();
+                starDraw.vertexArray = starField->vertexArray();
+                starDraw.timer = passTimers.sky;
+                renderQueue.add(starDraw, [&]() { starField->draw(); });
+            } else {
+                RenderQueue::Draw skyDraw;
+                skyDraw.pass = PASS_SKY;
+                skyDraw.shader = &skyboxShader;
+                skyDraw.vertexArray = skyboxVAO;
+                skyDraw.textureTarget = GL_TEXTURE_CUBE_MAP;
+                skyDraw.timer = passTimers.sky;
+                renderQueue.addWithTexture(skyDraw, 0, cubemapTexture, [&]() {
+                    skyboxShader.set(skyboxViewUniform, glm::mat4(glm::mat3(view)));
+                    skyboxShader.set(skyboxProjection, projection);
+                    glDrawArrays(GL_TRIANGLES, 0, 36);
+                });
+            }
+
+            // the planets' atmospheres over the finished scene, the nearest few in view, farthest first
+            if (planetAtmospheres && physics.bodies.count(BODY_PLANET) > 0) {
+                if (atmosphereStale) {
+                    atmosphere->rebuild(atmosphereParameters);
+                    atmosphereStale = false;
+                }
+                atmosphere->update();
+                const BodyRange planets = physics.bodies.range(BODY_PLANET);
+                const float top = 1.0f + atmosphere->parameters().thickness;
+                std::vector<std::pair<float, size_t>> nearest;
+                for (size_t i = planets.begin; i < planets.end; i++) {
+                    const glm::vec3 at = cameraRelative(renderPosition(i));
+                    const float radius = physics.bodies.render[i].radiusScale * planetBoundingRadius;
+                    if (!frustumCulling || viewFrustum.intersectsSphere(at, radius * top))
+                        nearest.emplace_back(glm::length(at), i);
+                }
+                std::sort(nearest.begin(), nearest.end());
+                nearest.resize(std::min<size_t>(nearest.size(), MAX_ATMOSPHERES));
+                for (const auto& [distance, i] : nearest) {
+                    if (!atmosphere->ready()) break;
+                    const glm::vec3 at = cameraRelative(renderPosition(i));
+                    const float radius = physics.bodies.render[i].radiusScale * planetBoundingRadius;
+                    RenderQueue::Draw airDraw;
+                    airDraw.pass = PASS_ATMOSPHERE;
+                    airDraw.shader = &atmosphere->program();
+                    airDraw.vertexArray = atmosphere->vertexArray();
+                    airDraw.depth = distance;
+                    airDraw.timer = passTimers.atmospheres;
+                    // view is read at submission, after the late latch
+                    renderQueue.add(airDraw, [&, at, radius]() {
+                        const glm::mat3 rotation(view);
+                        atmosphere->draw(projection, rotation * at, radius, rotation * (sunOffset - at));
+                    });
+                }
+            }
+
+            stages.mark("render queue build");
+
+            // late latch: the mouse moved while the frame was being prepared turns the camera once more, the draws
+            // read view when they are submitted. Culling, the packed instances and the light clusters keep the early
+            // view, a latch turns it by a fraction of a degree. Keys still move the camera once per frame.
+            lateLatchDegrees = 0.0f;
+            if (lateLatching && window && !benchmark.active) {
+                const glm::vec3 earlyFront = camera.Front;
+                if (renderThread) drainWindowEvents(window);
+                else glfwPollEvents();
+                if (camera.Front != earlyFront) {
+                    lateLatchDegrees = glm::degrees(std::acos(std::clamp(glm::dot(earlyFront, camera.Front), -1.0f, 1.0f)));
+                    view = camera.GetCameraRelativeViewMatrix();
+                    if (stereo) updateStereoFrame(view);
+                    writeFrameCamera(projection, view);
+                    lightSourceShader.use();
+                    lightSourceShader.set(sunView, view);
+                }
+            }
+            sunShadow->bind(view, castShadows);
+            sceneTarget->setReprojection(projection * view, previousViewProjection, glm::vec3(camera.Position - previousCameraPosition));
+            previousViewProjection = unjitteredProjection * view;
+            previousCameraPosition = camera.Position;
+            stages.mark("late latch");
+            // rated from last frame's picture, for the scene's own passes only
+            const bool shadeAtRates = variableRateShading && shadingRatesAvailable;
+            if (shadeAtRates) {
+                gpuTimers->begin(passTimers.shadingRates);
+                shadingRates->build(sceneTarget->previousFrame(), scene_w, scene_h);
+                gpuTimers->end();
+                shadingRates->begin();
+            }
+            if (stereo)
+                renderQueue.setViews(2, beginStereoView);
+            else
+                renderQueue.setViews(1);
+            renderQueue.submit(PASS_OPAQUE);
+
+            // lit once per pixel, the depth copied along for the sun and the skybox
+            if (deferredShading) {
+                gpuTimers->begin(passTimers.lighting);
+                gBuffer->light(projection, view, sceneTarget->framebuffer());
+                gpuTimers->end();
+            }
+
+            renderQueue.submit(PASS_LIGHT_SOURCES);
 
+            // the finished depth, for next frame's occlusion culling
+            if (occlusionCulling && frustumCulling) {
+                gpuTimers->begin(passTimers.hiZ);
+                hiZ->capture(scene_w, scene_h, projection, view, glm::vec3(camera.Position), sceneTarget->framebuffer());
+                gpuTimers->end();
+            } else
+                hiZ->invalidate();
+
+            renderQueue.submit();
+            if (stereo) {
+                // the whole target and the centre camera again for what follows
+                glDisable(GL_CLIP_DISTANCE0);
+                glViewport(0, 0, scene_w, scene_h);
+                writeFrameCamera(projection, view);
+            }
+            if (shadeAtRates) shadingRates->end();
+            if (planetsInstanced) planetInstances->fenceRead();
+            // the pages this frame's pixels asked for, read back a frame or two later
+            if (drawSurface) planetSurface->requestFeedback();
+            sceneTarget->endOverdraw();
+            stages.mark("render queue submit");
+
+            // the answer to an earlier click, then a read for a new one behind this frame's draws
+            uint32_t pick = 0;
+            if (gpuPicker->poll(pick))
+                resolvePick(pick);
+            if (pickRequested && !gpuPicking) {
+                cpuPick(unjitteredProjection * view);
+                pickRequested = false;
+            }
+            if (pickRequested && !gpuPicker->pending()) {
+                const int x = std::clamp(static_cast<int>(pickPoint.x * scene_w), 0, scene_w - 1);
+                const int y = std::clamp(static_cast<int>(pickPoint.y * scene_h), 0, scene_h - 1);
+                if (gpuPicker->request(x, y))
+                    snapshotPickIds();
+                pickRequested = false;
+            }
+
+            gpuTimers->begin(passTimers.postProcess);
+            sceneTarget->present(display_w, display_h, outputFramebuffer(), outputWindows.region(outputWindows.mainPanel()));
+            gpuTimers->end();
+            outputWindows.present(sceneTarget->presented(), scene_w, scene_h);
+            // the finished image, without the UI
+            frameCapture->capture(outputFramebuffer(), display_w, display_h);
+
+            ImGui::Render();
+            gpuTimers->begin(passTimers.ui);
+            pushDebugGroup("ui");
+            if (window) ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+            popDebugGroup();
+            gpuTimers->endFrame();
+            cpuFrameHistory.push(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - cpuFrameStart).count());
+            if (benchmark.active && benchmark.frame >= benchmark.warmup) {
+                benchmark.cpuFrameMs.push(cpuFrameHistory.latest());
+                benchmark.physicsMs.push(cpuPhysicsHistory.latest());
+                benchmark.uploadMs.push(cpuUploadHistory.latest());
+                benchmark.uiMs.push(cpuUiHistory.latest());
+            }
+            stages.mark("ui render");
 
-        if (!celestialBodies.empty()) {
-            updatePhysics(deltaTime);
-            lighting.pointLights[0].position = glm::vec4(celestialBodies[0].position, 1.0f);
-        }
-        lighting.spotLight.position_spot = camera.Position;
-        lighting.spotLight.direction_spot = camera.Front;
-        glBindBuffer(GL_UNIFORM_BUFFER, uboLightData);
-        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(LightData), &lighting); // Update all light data
-        glBindBuffer(GL_UNIFORM_BUFFER, 0);
-
-        glClearColor(0.01f, 0.01f, 0.01f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        int display_w, display_h;
-        glfwGetFramebufferSize(window, &display_w, &display_h);
-        projection = glm::perspective(glm::radians(camera.Zoom), (float)display_w / (float)display_h, 0.1f, 3000.0f);
-        glm::mat4 view = camera.GetViewMatrix();
-        glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
-        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(projection));
-        glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(view));
-        glBindBuffer(GL_UNIFORM_BUFFER, 0);
-
-        if (celestialBodies.empty()) {
-            ImGui::Render(); ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-            glfwSwapBuffers(window);
-            continue;
-        }
-
-        // Sun
-        lightSourceShader.use();
-        lightSourceShader.setMat4("projection", projection); // Ensure these shaders take P and V
-        lightSourceShader.setMat4("view", view);
-        lightSourceShader.setMat4("model", celestialBodies[0].modelMatrix);
-        sphereMesh.Draw(lightSourceShader);
-
-        // Planet
-        if (celestialBodies.size() > 1 && planetModelPtr) {
-             objectShader.use();
-             objectShader.setVec3("viewPos", camera.Position);
-             objectShader.setMat4("model", celestialBodies[1].modelMatrix);
-             objectShader.setMat3("normalMatrix", glm::transpose(glm::inverse(glm::mat3(celestialBodies[1].modelMatrix))));
-             planetModelPtr->Draw(objectShader);
-        }
-
-        // Asteroids
-        if (asteroidAmount > 0 && rockModelPtr && asteroidInstanceVBO != 0) {
-            asteroidShader.use();
-            asteroidShader.setMat4("viewMat", view);
-            asteroidShader.setVec3("viewPos", camera.Position);
-            if (!rockModelPtr->textures_loaded.empty()) {
-                 glActiveTexture(GL_TEXTURE0); // Ensure texture unit 0 for diffuse
-                 glBindTexture(GL_TEXTURE_2D, rockModelPtr->textures_loaded[0].id);
-                 // asteroidShader.setInt("texture_diffuse1", 0); // Set once at init or ensure it's set
-            }
-            for (unsigned int i = 0; i < rockModelPtr->meshes.size(); i++) {
-                glBindVertexArray(rockModelPtr->meshes[i].VAO);
-                glDrawElementsInstanced(GL_TRIANGLES, static_cast<unsigned int>(rockModelPtr->meshes[i].indices.size()), GL_UNSIGNED_INT, 0, asteroidAmount);
-                glBindVertexArray(0);
+            if (window) glfwSwapBuffers(window);
+            framePacer.endFrame();
+            stages.mark("swap");
+            if (startupTrace().frameShown(textureCache().streamingPending() == 0)) finishStartup(window);
+            updateFPS(window); // Call after swap potentially, or before, depends on what it measures
+            submitTelemetry(wallFrameMs, bodiesOnGpu() || drawBelt);
+            if (benchmark.active && ++benchmark.frame == benchmark.warmup + benchmark.frames) {
+                benchmark.frameMs.push(static_cast<float>((clockSeconds() - lastFrame) * 1000.0));
+                finishBenchmark(window);
+                if (window) glfwSetWindowShouldClose(window, true);
+                else stopRequested = 1;
+            } else if (!benchmark.active && headless.frames > 0 && ++headless.frame == headless.frames) {
+                stopRequested = 1;
             }
         }
-        
-        glDepthFunc(GL_LEQUAL);
-        skyboxShader.use();
-        glm::mat4 skyboxView = glm::mat4(glm::mat3(camera.GetViewMatrix()));
-        skyboxShader.setMat4("view", skyboxView);
-        skyboxShader.setMat4("projection", projection);
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthFunc(GL_LESS);
-
-        ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-
-        glfwSwapBuffers(window);
-        updateFPS(window); // Call after swap potentially, or before, depends on what it measures
-    }
-
-    if (asteroidModelMatrices) delete[] asteroidModelMatrices;
-    if (asteroidNormalMatrices) delete[] asteroidNormalMatrices;
-    if (asteroidInstanceVBO != 0) glDeleteBuffers(1, &asteroidInstanceVBO);
-    if (asteroidNormalInstanceVBO != 0) glDeleteBuffers(1, &asteroidNormalInstanceVBO);
+    };
+    if (renderThread) {
+        // the context moves to the frame thread, it hands it back for the shutdown
+        glfwMakeContextCurrent(nullptr);
+        std::thread frames([&]() {
+            profiler().nameThread("frames");
+            startupTrace().nameThread("frames");
+            glfwMakeContextCurrent(window);
+            frameLoop();
+            glfwMakeContextCurrent(nullptr);
+            windowEventQueue.finish();
+        });
+        while (windowEventQueue.serviceEvents(window)) {}
+        frames.join();
+        glfwMakeContextCurrent(window);
+        if (windowEventQueue.dropped() > 0)
+            std::cout << windowEventQueue.dropped() << " window events dropped, the frame thread fell behind" << std::endl;
+    } else {
+        frameLoop();
+    }
 
+    asyncPhysics.stop(physics);
+    abandonWorldRebuild();
+    universe.stop();
+    orbitPredictor.stop();
+    trajectoryRecorder.stop();
+    stateClient.close();
+    telemetry.stop();
+    asteroidInstanceStream.release();
+    asteroidInstances.release();
+
+    // the last frames' readbacks are written out before the video closes
+    delete frameCapture;
+    delete headlessTarget;
+    delete gpuCuller;
+    delete gpuMorton;
+    delete gpuBarnesHut;
+    delete radixSort;
+    delete sphereImpostorRenderer;
+    if (orbitLines) orbitLines->release();
+    delete orbitLines;
+    if (debugDraw) debugDraw->release();
+    delete debugDraw;
+    delete reflectionProbe;
+    delete gpuPicker;
+    delete gpuReadback;
+    delete sceneTarget;
+    delete hiZ;
+    delete shadingRates;
+    delete gpuTimers;
+    delete sunShadow;
+    delete clusteredLights;
+    delete gBuffer;
+    delete gpuTrails;
+    delete starField;
+    delete pointCloud;
+    delete gasCloud;
+    delete gasDisk;
+    delete densityMap;
+    delete atmosphere;
+    delete planetSurface;
+    delete planetTerrain;
+    delete gpuBelt;
+    delete gpuParticleMesh;
+    delete hybridNBody;
+    delete gpuNBody;
+    delete planetBatchPtr;
+    delete planetInstances;
+    BindlessTextures::releaseAll();
     delete planetModelPtr;
+    delete rockVariants;
     delete rockModelPtr;
-    // sphereMesh is not dynamically allocated, so no delete needed if it's an object.
-    // Its internal GL resources (VAO/VBO) should be cleaned up if Mesh dtor doesn't do it.
-    // For simplicity, assuming Mesh doesn't auto-cleanup its GL buffers on destruction.
-    // If it does, then SphereCreator created mesh's buffers would be cleaned when sphereMesh goes out of scope.
-
-    glDeleteVertexArrays(1, &skyboxVAO);
-    glDeleteBuffers(1, &skyboxVBO);
-    glDeleteBuffers(1, &uboMatrices);
-    glDeleteBuffers(1, &uboLightData);
+    modelLoader().stop();
+    geometryPool().release();
+    textureCache().releaseAll();
+    // a global, it would only be destroyed after the context
+    sphereCache().release();
+
+    glState().deleteVertexArrays(1, &skyboxVAO);
+    glState().deleteBuffers(1, &skyboxVBO);
+    cameraUniforms.release();
+    framePacer.release();
+    objectUniformRing.release();
+    outputWindows.close();
     
     ImGui_ImplOpenGL3_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
+    if (window) ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
-    glfwTerminate();
-    return 0;
+    if (window) glfwTerminate();
+    return benchmark.regressions > 0 || startupOptions.missed ? 2 : 0;
 }
 
 void processInput(GLFWwindow *window) {
     ImGuiIO& io = ImGui::GetIO();
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) // Escape always works
+    if (keyDown(window, GLFW_KEY_ESCAPE)) // Escape always works
         glfwSetWindowShouldClose(window, true);
+    static bool tracePressed = false; // also while ImGui has the keyboard
+    if (keyDown(window, GLFW_KEY_F9)) {
+        if (!tracePressed) writeTrace();
+        tracePressed = true;
+    } else {
+        tracePressed = false;
+    }
+    static bool screenshotPressed = false, recordPressed = false;
+    if (keyDown(window, GLFW_KEY_F12)) {
+        if (!screenshotPressed) takeScreenshot();
+        screenshotPressed = true;
+    } else {
+        screenshotPressed = false;
+    }
+    if (keyDown(window, GLFW_KEY_F10)) {
+        if (!recordPressed) toggleVideo();
+        recordPressed = true;
+    } else {
+        recordPressed = false;
+    }
+    // the benchmark flies the camera itself
+    if (benchmark.active) return;
+    static bool cameraKeyPressed = false;
+    if (keyDown(window, GLFW_KEY_F7)) {
+        if (!cameraKeyPressed) recordCameraKey();
+        cameraKeyPressed = true;
+    } else {
+        cameraKeyPressed = false;
+    }
+    // a left click picks what is under the cursor, or under the crosshair while the camera has the mouse
+    static bool clickPressed = false;
+    if (mouseButtonDown(window, GLFW_MOUSE_BUTTON_LEFT)) {
+        if (!clickPressed && (cameraEnabled || !io.WantCaptureMouse)) {
+            glm::vec2 inWindow(0.5f);
+            if (!cameraEnabled) {
+                double x, y;
+                int w, h;
+                if (renderThread) {
+                    x = windowInput.cursorX;
+                    y = windowInput.cursorY;
+                    w = windowInput.width;
+                    h = windowInput.height;
+                } else {
+                    glfwGetCursorPos(window, &x, &y);
+                    glfwGetWindowSize(window, &w, &h);
+                }
+                if (w > 0 && h > 0)
+                    inWindow = glm::vec2(static_cast<float>(x / w), 1.0f - static_cast<float>(y / h));
+            }
+            // the main window shows one panel of the target
+            pickPoint = glm::vec2((outputWindows.mainPanel() + inWindow.x) / outputWindows.panels(), inWindow.y);
+            pickRequested = true;
+        }
+        clickPressed = true;
+    } else {
+        clickPressed = false;
+    }
 
     if (io.WantCaptureKeyboard && !cameraEnabled) return; // If ImGui wants keyboard and camera is off, let ImGui have it.
                                                           // If camera is on, special handling for backspace.
     
     static bool backspacePressed = false; // Toggle camera/UI mode
-    if (glfwGetKey(window, GLFW_KEY_BACKSPACE) == GLFW_PRESS) {
+    if (keyDown(window, GLFW_KEY_BACKSPACE)) {
         if (!backspacePressed) {
             cameraEnabled = !cameraEnabled;
-            glfwSetInputMode(window, GLFW_CURSOR, cameraEnabled ? GLFW_CURSOR_DISABLED : GLFW_CURSOR_NORMAL);
+            const int cursorMode = cameraEnabled ? GLFW_CURSOR_DISABLED : GLFW_CURSOR_NORMAL;
+            if (renderThread) windowEventQueue.requestCursorMode(cursorMode);
+            else glfwSetInputMode(window, GLFW_CURSOR, cursorMode);
             if (cameraEnabled) firstMouse = true;
             backspacePressed = true;
         }
@@ -610,18 +4897,19 @@ void processInput(GLFWwindow *window) {
     // Camera movement keys are processed only if camera is enabled OR ImGui doesn't want keyboard input
     if (cameraEnabled || !io.WantCaptureKeyboard) {
         float actualDeltaTime = deltaTime;
-        if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) actualDeltaTime *= 3.5f;
+        if (keyDown(window, GLFW_KEY_LEFT_SHIFT)) actualDeltaTime *= 3.5f;
 
-        if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) camera.ProcessKeyboard(FORWARD, actualDeltaTime);
-        if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) camera.ProcessKeyboard(BACKWARD, actualDeltaTime);
-        if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) camera.ProcessKeyboard(LEFT, actualDeltaTime);
-        if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) camera.ProcessKeyboard(RIGHT, actualDeltaTime);
-        if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) camera.ProcessKeyboard(UP, actualDeltaTime);
-        if (glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS) camera.ProcessKeyboard(DOWN, actualDeltaTime);
+        if (keyDown(window, GLFW_KEY_W)) camera.ProcessKeyboard(FORWARD, actualDeltaTime);
+        if (keyDown(window, GLFW_KEY_S)) camera.ProcessKeyboard(BACKWARD, actualDeltaTime);
+        if (keyDown(window, GLFW_KEY_A)) camera.ProcessKeyboard(LEFT, actualDeltaTime);
+        if (keyDown(window, GLFW_KEY_D)) camera.ProcessKeyboard(RIGHT, actualDeltaTime);
+        if (keyDown(window, GLFW_KEY_SPACE)) camera.ProcessKeyboard(UP, actualDeltaTime);
+        if (keyDown(window, GLFW_KEY_LEFT_CONTROL)) camera.ProcessKeyboard(DOWN, actualDeltaTime);
     }
 }
 
 void framebuffer_size_callback([[maybe_unused]] GLFWwindow* window, int width, int height) {
+    windowEvents++;
     glViewport(0, 0, width, height);
     // Projection matrix should be updated here or in the main loop when camera.Zoom changes
     // If camera.Zoom can change, or aspect ratio needs to be strictly tied to resize:
@@ -634,6 +4922,7 @@ void framebuffer_size_callback([[maybe_unused]] GLFWwindow* window, int width, i
 }
 
 void mouse_callback([[maybe_unused]] GLFWwindow* window, double xposIn, double yposIn) {
+    windowEvents++;
     ImGuiIO& io = ImGui::GetIO();
     if (io.WantCaptureMouse || !cameraEnabled) {
         return;
@@ -654,6 +4943,7 @@ void mouse_callback([[maybe_unused]] GLFWwindow* window, double xposIn, double y
 }
 
 void scroll_callback([[maybe_unused]] GLFWwindow* window, [[maybe_unused]] double xoffset, double yoffset) {
+    windowEvents++;
     ImGuiIO& io = ImGui::GetIO();
      if (io.WantCaptureMouse || !cameraEnabled) {
         return;
@@ -662,20 +4952,28 @@ void scroll_callback([[maybe_unused]] GLFWwindow* window, [[maybe_unused]] doubl
 }
 
 void updateFPS(GLFWwindow* window) {
-    static double lastTime = glfwGetTime();
+    static double lastTime = clockSeconds();
     static int nbFrames = 0;
     static double lastFPSTitleUpdateTime = 0.0;
 
-    double currentTime = glfwGetTime();
+    double currentTime = clockSeconds();
     nbFrames++;
     if (currentTime - lastTime >= 1.0) { // If last prinf() was more than 1 sec ago
         // Convert nbFrames to FPS
         double fps = double(nbFrames) / (currentTime - lastTime);
         
+        // a headless run logs its progress instead
+        if (!window) {
+            std::cout << "frame " << headless.frame;
+            if (headless.frames > 0) std::cout << " / " << headless.frames;
+            std::cout << ", " << static_cast<int>(fps) << " fps" << std::endl;
+        }
         // Update title only every 0.25 seconds or so to avoid excessive updates
-        if (currentTime - lastFPSTitleUpdateTime >= 0.25) {
-            std::string title = "Solar System Sim - FPS: " + std::to_string(static_cast<int>(fps));
-            glfwSetWindowTitle(window, title.c_str());
+        else if (currentTime - lastFPSTitleUpdateTime >= 0.25) {
+            char title[64];
+            std::snprintf(title, sizeof(title), "Solar System Sim - FPS: %d", static_cast<int>(fps));
+            if (renderThread) windowEventQueue.requestTitle(title);
+            else glfwSetWindowTitle(window, title);
             lastFPSTitleUpdateTime = currentTime;
         }
 
@@ -684,89 +4982,13 @@ void updateFPS(GLFWwindow* window) {
     }
 }
 
+// both go through textureCache(), a file already loaded (by a model or earlier here) is shared rather than reloaded
 unsigned int loadTexture(char const * path, bool gammaCorrection)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum internalFormat = GL_RGB; // Default
-        GLenum dataFormat = GL_RGB;     // Default
-
-        if (nrComponents == 1)
-        {
-            internalFormat = dataFormat = GL_RED;
-        }
-        else if (nrComponents == 3) // GL_RGB
-        {
-            internalFormat = gammaCorrection ? GL_SRGB : GL_RGB;
-            dataFormat = GL_RGB;
-        }
-        else if (nrComponents == 4) // GL_RGBA
-        {
-            internalFormat = gammaCorrection ? GL_SRGB_ALPHA : GL_RGBA;
-            dataFormat = GL_RGBA;
-        }
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, dataFormat, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data); // stbi_load sets data to NULL on failure, safe to call free.
-        textureID = 0; // Return 0 on failure
-    }
-
-    return textureID;
+    return textureCache().acquire(path, gammaCorrection);
 }
 
 unsigned int loadCubemap(std::vector<std::string> faces)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
-    stbi_set_flip_vertically_on_load(false); // Cubemaps generally don't need flipping
-    for (unsigned int i = 0; i < faces.size(); i++)
-    {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            GLenum format = GL_RGB;
-            if (nrChannels == 1) format = GL_RED;
-            else if (nrChannels == 4) format = GL_RGBA;
-            
-            // For cubemaps, often SRGB is not used for internal format unless specifically needed
-            // and handled by shader. Standard is GL_RGB/GL_RGBA.
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else
-        {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
-            // Consider returning 0 or handling error more robustly
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    // stbi_set_flip_vertically_on_load(true); // Set back if models need it - done in main where models are loaded
-
-    return textureID;
-}
\ No newline at end of file
+    return textureCache().acquireCubemap(faces, true);
+}